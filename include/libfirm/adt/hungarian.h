@@ -109,6 +109,23 @@ FIRM_API void hungarian_free(hungarian_problem_t *p);
 FIRM_API int hungarian_solve(hungarian_problem_t *p, unsigned *assignment,
                              unsigned *final_cost, unsigned cost_threshold);
 
+/** Maximal number of columns hungarian_solve_small() handles. */
+#define HUNGARIAN_SMALL_MAX 32
+
+/**
+ * Computes a perfect matching maximizing the utility without allocating
+ * memory. Meant for the small and sparse matrices of register assignment,
+ * rows and columns whose only edge connects them are matched right away.
+ *
+ * @param num_rows   Number of rows, at most num_cols
+ * @param num_cols   Number of columns, at most HUNGARIAN_SMALL_MAX
+ * @param util       The utility matrix in row major order, 0 if no edge
+ * @param assignment The column of each row
+ */
+FIRM_API void hungarian_solve_small(unsigned num_rows, unsigned num_cols,
+                                    const unsigned *util,
+                                    unsigned *assignment);
+
 /**
  * Print the cost matrix.
  * @param p          The hungarian object
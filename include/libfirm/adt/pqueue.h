@@ -53,6 +53,32 @@ FIRM_API void pqueue_put(pqueue_t *q, void *data, int priority);
  */
 FIRM_API void *pqueue_pop_front(pqueue_t *q);
 
+/**
+ * Returns the first element, i.e. that one with the highest priority, without
+ * removing it from the queue.
+ * @param q   The priority queue.
+ * @return The first element of the queue. Panics if the queue is empty.
+ */
+FIRM_API void *pqueue_front(const pqueue_t *q);
+
+/**
+ * Returns the priority of the first element of the queue.
+ * @param q   The priority queue.
+ * @return The highest priority in the queue. Panics if the queue is empty.
+ */
+FIRM_API int pqueue_front_priority(const pqueue_t *q);
+
+/**
+ * Replaces the first element of the queue. This is equivalent to
+ * pqueue_pop_front() followed by pqueue_put() but only needs a single pass
+ * through the heap. Passing the current first element with a changed priority
+ * changes the priority of that element.
+ * @param q         The priority queue.
+ * @param data      The data replacing the first element.
+ * @param priority  The priority for the data.
+ */
+FIRM_API void pqueue_replace_front(pqueue_t *q, void *data, int priority);
+
 /**
  * Get the length of the priority queue.
  * @param q   The priority queue.
@@ -52,6 +52,20 @@ FIRM_API unsigned get_method_param_weight(ir_entity *ent, size_t pos);
  */
 FIRM_API void analyze_irg_args_weight(ir_graph *irg);
 
+/**
+ * Assure that the summary of the entity of a graph describes the graph.
+ *
+ * The summary of a method entity consists of the parameter access and
+ * weights and the properties found by optimize_funccalls(). It is computed
+ * once and reused by all later queries and pass invocations while the graph
+ * has the property IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY. Without the
+ * property the graph changed since, and the summary is dropped to be
+ * recomputed on demand.
+ *
+ * @param irg The ir graph.
+ */
+FIRM_API void assure_irg_entity_summary(ir_graph *irg);
+
 #include "end.h"
 
 #endif
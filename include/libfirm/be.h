@@ -154,6 +154,19 @@ typedef struct backend_params {
 
 	/** Alignment of stack parameters */
 	unsigned stack_param_align;
+
+	/**
+	 * Number of independent operations the target starts per cycle,
+	 * 0 if unknown.
+	 */
+	unsigned issue_width;
+
+	/**
+	 * Cycles lost by a mispredicted branch, 0 if unknown. If-conversion
+	 * weighs it against the cost of a Mux, without it every Mux allowed by
+	 * allow_ifconv is created.
+	 */
+	unsigned branch_mispredict_penalty;
 } backend_params;
 
 /**
@@ -214,6 +227,48 @@ FIRM_API void be_lower_for_target(void);
  */
 FIRM_API void be_main(FILE *output, const char *compilation_unit_name);
 
+/** Machine code of a set of graphs placed in executable memory. */
+typedef struct ir_jit_code_t ir_jit_code_t;
+
+/**
+ * Callback returning the address of an entity which is referenced by JIT
+ * compiled code but not defined by it, or NULL if the entity is unknown.
+ */
+typedef void *(*be_jit_resolver_t)(ir_entity *entity, void *data);
+
+/**
+ * Compiles graphs directly into executable memory without running an
+ * assembler or linker.
+ *
+ * References between the compiled graphs are resolved directly, all other
+ * entities are resolved with @p resolver. Constant entities created by the
+ * backend itself (like floating point constants) are placed next to the code
+ * if the resolver does not know them. The memory is never writable and
+ * executable at the same time.
+ * Currently only the ia32 backend supports JIT compilation.
+ *
+ * @param n_irgs    number of graphs to compile
+ * @param irgs      the graphs to compile
+ * @param resolver  callback resolving external entities
+ * @param data      passed to @p resolver
+ * @returns the compiled code or NULL if an entity could not be resolved
+ */
+FIRM_API ir_jit_code_t *be_jit_compile(size_t n_irgs, ir_graph *const *irgs,
+                                       be_jit_resolver_t resolver, void *data);
+
+/**
+ * Returns the address of the machine code of the function @p entity or NULL
+ * if it is not part of @p code.
+ */
+FIRM_API void *be_jit_get_entity_address(const ir_jit_code_t *code,
+                                         const ir_entity *entity);
+
+/** Returns the size in bytes of the executable memory of @p code. */
+FIRM_API size_t be_jit_get_code_size(const ir_jit_code_t *code);
+
+/** Releases the executable memory of @p code. */
+FIRM_API void be_jit_free(ir_jit_code_t *code);
+
 /**
  * parse assembler constraint strings and returns flags (so the frontend knows
  * which operands are inputs/outputs and whether memory is required)
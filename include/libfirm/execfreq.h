@@ -28,11 +28,46 @@
  * @{
  */
 
+/** Methods to estimate execution frequencies. */
+typedef enum ir_execfreq_estimator {
+	/** Solve the linear system of the probabilities of all control flow
+	 * edges. */
+	ir_execfreq_system,
+	/** Combine the loop weights along the loop tree in linear time, falls
+	 * back to solving the system for irreducible control flow. */
+	ir_execfreq_loop_tree,
+} ir_execfreq_estimator;
+
+/** Selects the method used by ir_estimate_execfreq(). */
+FIRM_API void ir_set_execfreq_estimator(ir_execfreq_estimator estimator);
+
+/** Returns the method used by ir_estimate_execfreq(). */
+FIRM_API ir_execfreq_estimator ir_get_execfreq_estimator(void);
+
 /** Estimates execution frequency of a graph.
  * You can query the frequencies with get_block_execfreq().
  */
 FIRM_API void ir_estimate_execfreq(ir_graph *irg);
 
+/**
+ * Reads a sampled profile in the text format of AutoFDO (create_llvm_prof).
+ * Returns non-zero on success. The samples are mapped to blocks by the source
+ * lines of the debug info, so the graphs need dbg_info on their entities and
+ * nodes.
+ */
+FIRM_API int ir_sample_profile_read(const char *filename);
+
+/**
+ * Sets the execution frequencies of @p irg from the sampled profile read with
+ * ir_sample_profile_read(). Blocks without samples keep estimated
+ * frequencies. Returns zero and leaves the frequencies alone if the profile
+ * has no samples for the graph.
+ */
+FIRM_API int ir_sample_profile_apply(ir_graph *irg);
+
+/** Frees the sampled profile. */
+FIRM_API void ir_sample_profile_free(void);
+
 /** Returns execution frequency of block @p block. */
 FIRM_API double get_block_execfreq(const ir_node *block);
 
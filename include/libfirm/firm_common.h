@@ -31,6 +31,14 @@ FIRM_API void ir_init(void);
  */
 FIRM_API void ir_finish(void);
 
+/**
+ * Frees the current program and everything depending on it and starts a new
+ * empty program named @p name. Options, modes, idents and the selected
+ * target stay as they are, so a process may compile any number of programs
+ * without running ir_finish() and ir_init() in between.
+ */
+FIRM_API void ir_reset_prog(const char *name);
+
 /** returns the libFirm major version number */
 FIRM_API unsigned ir_get_version_major(void);
 /** returns libFirm minor version number */
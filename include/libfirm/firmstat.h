@@ -11,6 +11,8 @@
 #ifndef FIRM_STAT_FIRMSTAT_H
 #define FIRM_STAT_FIRMSTAT_H
 
+#include <stddef.h>
+
 #include "firm_types.h"
 #include "begin.h"
 
@@ -39,6 +41,46 @@ FIRM_API void stat_term(void);
  */
 FIRM_API int stat_is_active(void);
 
+/**
+ * The parts of the memory allocated for a graph.
+ */
+typedef enum ir_graph_memory_kind {
+	ir_graph_memory_nodes,    /**< the node obstack */
+	ir_graph_memory_edges,    /**< out edges and their hash sets */
+	ir_graph_memory_outs,     /**< the Def-Use arrays of the outs */
+	ir_graph_memory_backend,  /**< backend info and register constraints */
+	ir_graph_memory_liveness, /**< backend liveness sets and check */
+	ir_graph_memory_last = ir_graph_memory_liveness
+} ir_graph_memory_kind;
+
+/**
+ * Returns the number of bytes currently allocated for a part of a graph.
+ * Unlike ir_get_heap_used_bytes() this works on all hosts and attributes the
+ * memory to a single graph.
+ *
+ * @param irg   the graph
+ * @param kind  the part of the memory
+ */
+FIRM_API size_t ir_get_irg_memory_used(const ir_graph *irg,
+                                       ir_graph_memory_kind kind);
+
+/**
+ * Returns the number of bytes currently allocated for all parts of a graph.
+ */
+FIRM_API size_t ir_get_irg_memory_total(const ir_graph *irg);
+
+/**
+ * Sets the memory budget of a single graph in bytes, 0 means unlimited.
+ * Expensive optimizations (gvn_pre, combo, loop unrolling and ILP copy
+ * coalescing) switch to cheaper variants for graphs which exceed it.
+ */
+FIRM_API void ir_set_irg_memory_budget(size_t bytes);
+
+/**
+ * Returns the memory budget of a single graph in bytes, 0 means unlimited.
+ */
+FIRM_API size_t ir_get_irg_memory_budget(void);
+
 #include "end.h"
 
 #endif
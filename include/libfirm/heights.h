@@ -34,11 +34,12 @@
  * @param irn  The node.
  * @return     The height of the node.
  */
-FIRM_API unsigned get_irn_height(const ir_heights_t *h, const ir_node *irn);
+FIRM_API unsigned get_irn_height(ir_heights_t *h, const ir_node *irn);
 
 /**
  * Checks if a certain node is reachable according to data dependence edges
  * from another node. Both nodes must be in the same block.
+ * Answers are memoized per block, so repeated queries are cheap.
  * @param h The heights object.
  * @param n The first node.
  * @param m The other node.
@@ -47,6 +48,16 @@ FIRM_API unsigned get_irn_height(const ir_heights_t *h, const ir_node *irn);
 FIRM_API int heights_reachable_in_block(ir_heights_t *h, const ir_node *n,
                                         const ir_node *m);
 
+/**
+ * Marks the height information of a block as outdated, for example after nodes
+ * of the block have been rewired. The block is recomputed lazily when one of
+ * its nodes is queried next. Nodes created after the last computation of their
+ * block cause a recomputation as well.
+ * @param h     The heights object.
+ * @param block The block
+ */
+FIRM_API void heights_invalidate_block(ir_heights_t *h, ir_node *block);
+
 /**
  * Recomputes the height information for a certain block.
  * This can be used to recompute the height information of a block.
@@ -907,6 +907,24 @@ FIRM_API void set_r_store(ir_graph *irg, ir_node *store);
  */
 FIRM_API void keep_alive(ir_node *ka);
 
+/**
+ * Starts a bulk construction on graph @p irg.
+ *
+ * Until irg_end_bulk_cons() is called, the node constructors only create
+ * nodes and skip constant folding, local optimizations and common
+ * subexpression elimination; Phi nodes are still optimized as they are part
+ * of the SSA construction. This speeds up frontends and code generators that
+ * create large amounts of straight-line code.
+ */
+FIRM_API void irg_begin_bulk_cons(ir_graph *irg);
+
+/**
+ * Ends a bulk construction on graph @p irg and optimizes all nodes created
+ * since irg_begin_bulk_cons() in one pass in creation order. Optimized nodes
+ * are exchanged, so references to them kept by the frontend stay valid.
+ */
+FIRM_API void irg_end_bulk_cons(ir_graph *irg);
+
 /** Puts the graph into state "phase_high" */
 FIRM_API void irg_finalize_cons(ir_graph *irg);
 
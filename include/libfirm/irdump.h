@@ -124,6 +124,25 @@ FIRM_API int ir_should_dump(const char *name);
  */
 FIRM_API void dump_ir_graph_file(FILE *out, ir_graph *graph);
 
+/**
+ * Dumps all Firm nodes of a single graph in GraphViz DOT format.
+ * The graph is written in a single walk without buffering, which makes this
+ * preferable over dump_ir_graph_file() for very large graphs. Only nodes
+ * selected by ir_set_dump_node_range() are written.
+ *
+ * @param out    Output stream the graph is written to
+ * @param graph  The firm graph to be dumped.
+ */
+FIRM_API void dump_ir_graph_dot(FILE *out, ir_graph *graph);
+
+/**
+ * Restricts dump_ir_graph_dot() to nodes whose node number or whose block's
+ * node number lies in [@p first, @p last]. Passing the number of a block for
+ * both dumps that block with all its nodes. The default range contains all
+ * nodes.
+ */
+FIRM_API void ir_set_dump_node_range(long first, long last);
+
 /**
  * Dump the control flow graph of a procedure.
  *
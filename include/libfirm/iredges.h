@@ -159,6 +159,21 @@ FIRM_API void edges_activate_kind(ir_graph *irg, ir_edge_kind_t kind);
  */
 FIRM_API void edges_deactivate_kind(ir_graph *irg, ir_edge_kind_t kind);
 
+/**
+ * Suspends the maintenance of the edges of an irg.
+ *
+ * While suspended, changes to the graph are not recorded and
+ * edges_activated_kind() reports the edges as inactive, but the edge lists
+ * built so far stay readable. This makes bulk rewrites which create many
+ * nodes but only inspect the users of unchanged nodes cheaper.
+ * edges_activate_kind() rebuilds the edges in one pass and reuses their
+ * memory, edges_deactivate_kind() drops them.
+ *
+ * @param irg   The graph.
+ * @param kind  The edge kind.
+ */
+FIRM_API void edges_suspend_kind(ir_graph *irg, ir_edge_kind_t kind);
+
 /**
  * Reroutes edges of a specified kind from an old node to a new one.
  *
@@ -209,6 +224,14 @@ FIRM_API void edges_init_dbg(int do_dbg);
  */
 FIRM_API void edges_activate(ir_graph *irg);
 
+/**
+ * Suspends the maintenance of data, block and dependency edges for an irg.
+ * @see edges_suspend_kind()
+ *
+ * @param irg  The graph.
+ */
+FIRM_API void edges_suspend(ir_graph *irg);
+
 /**
  * Deactivates data and block edges for an irg.
  * If the irg phase is phase_backend, Dependence edges are
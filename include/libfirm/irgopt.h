@@ -11,6 +11,8 @@
 #ifndef FIRM_IR_IRGOPT_H
 #define FIRM_IR_IRGOPT_H
 
+#include <stddef.h>
+
 #include "firm_types.h"
 #include "begin.h"
 
@@ -43,6 +45,21 @@ FIRM_API ir_node *optimize_node(ir_node *n);
  */
 FIRM_API void local_optimize_graph(ir_graph *irg);
 
+/** Applies local optimizations (see iropt.h) to the given nodes and, until a
+ * fixpoint is reached, to the users of every node changed on the way.
+ *
+ * Passes which transform only a part of a graph should use this instead of
+ * local_optimize_graph() to clean up after themselves: Instead of walking the
+ * whole graph again, only the nodes depending on a changed node are revisited.
+ * Uses (and activates) the out edges of the graph.
+ *
+ * @param irg      The graph to be optimized.
+ * @param nodes    The nodes changed by the pass.
+ * @param n_nodes  The number of nodes.
+ */
+FIRM_API void local_optimize_nodes(ir_graph *irg, ir_node *const *nodes,
+                                   size_t n_nodes);
+
 /** Applies local optimizations (see iropt.h) to all nodes in the graph.
  *
  * After applying optimize_graph_df() to a IR-graph, Bad nodes
@@ -77,7 +77,7 @@
  * - n_loc           An int giving the number of local variables in this
  *                   procedure.  This is needed for ir construction.
  *
- * - value_table     This hash table (pset) is used for global value numbering
+ * - value_table     This hash table (cpset) is used for global value numbering
  *                   for optimizing use in iropt.c.
  *
  * - visited         A int used as flag to traverse the ir_graph.
@@ -134,6 +134,13 @@ FIRM_API ir_graph *new_ir_graph(ir_entity *ent, int n_loc);
  */
 FIRM_API void free_ir_graph(ir_graph *irg);
 
+/** Frees all nodes of the passed irgraph.
+ * The graph stays in the program and only contains the nodes of an empty
+ * graph afterwards. This is useful to drop graphs which are not needed
+ * anymore, for example after code for them has been emitted.
+ */
+FIRM_API void free_irg_body(ir_graph *irg);
+
 /**
  *   Checks whether a pointer points to a ir graph.
  *
@@ -418,6 +425,20 @@ typedef enum ir_graph_properties_t {
 	IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE        = 1U << 11,
 	/** graph contains as many returns as possible */
 	IR_GRAPH_PROPERTY_MANY_RETURNS                   = 1U << 12,
+	/**
+	 * the liveness check information of the backend is computed and up to
+	 * date. It only depends on the control flow, so it is maintained by the
+	 * backend and cannot be assured with assure_irg_properties().
+	 */
+	IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK        = 1U << 13,
+	/** the alias query cache of the graph is valid */
+	IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE         = 1U << 14,
+	/**
+	 * the interprocedural summary of the graph's entity (parameter access
+	 * and weights, properties found by optimize_funccalls()) describes the
+	 * current graph
+	 */
+	IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY      = 1U << 15,
 
 	/**
 	 * List of all graph properties that are only affected by control flow
@@ -430,7 +451,8 @@ typedef enum ir_graph_properties_t {
 		| IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO
 		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
 		| IR_GRAPH_PROPERTY_CONSISTENT_POSTDOMINANCE
-		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE_FRONTIERS,
+		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE_FRONTIERS
+		| IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK,
 
 	/**
 	 * List of all graph properties.
@@ -442,6 +464,8 @@ typedef enum ir_graph_properties_t {
 	    | IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
 	    | IR_GRAPH_PROPERTY_CONSISTENT_OUTS
 	    | IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE
+	    | IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE
+	    | IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY
 	    | IR_GRAPH_PROPERTY_MANY_RETURNS,
 
 } ir_graph_properties_t;
@@ -455,6 +479,45 @@ FIRM_API void clear_irg_properties(ir_graph *irg, ir_graph_properties_t props);
 FIRM_API int irg_has_properties(const ir_graph *irg,
                                 ir_graph_properties_t props);
 
+/**
+ * Memory of a graph which can be mapped directly from the operating system
+ * instead of being allocated from the heap.
+ */
+typedef enum ir_graph_memory_t {
+	IR_GRAPH_MEMORY_NONE       = 0,
+	/** the obstack holding the nodes */
+	IR_GRAPH_MEMORY_NODES      = 1U << 0,
+	/** the obstacks holding the out edges */
+	IR_GRAPH_MEMORY_EDGES      = 1U << 1,
+	/** the def-use edges computed by compute_irg_outs() */
+	IR_GRAPH_MEMORY_OUTS       = 1U << 2,
+	/** advise the operating system to back the mapped memory by huge pages */
+	IR_GRAPH_MEMORY_HUGE_PAGES = 1U << 3,
+} ir_graph_memory_t;
+ENUM_BITSET(ir_graph_memory_t)
+
+/**
+ * Selects the memory of graphs created from now on which is mapped from the
+ * operating system. Mapped memory is allocated in chunks of some megabytes
+ * and returned to the operating system when the graph is freed, which
+ * avoids fragmenting the heap with very large graphs.
+ */
+FIRM_API void set_irg_default_memory(ir_graph_memory_t memory);
+
+/** Returns the memory of new graphs which is mapped from the OS. */
+FIRM_API ir_graph_memory_t get_irg_default_memory(void);
+
+/**
+ * Selects the memory of graph @p irg which is mapped from the operating
+ * system. Memory already allocated stays where it is; the setting applies
+ * when the nodes are moved to a new obstack (for example by dead node
+ * elimination), the edges are activated or the outs are computed.
+ */
+FIRM_API void set_irg_memory(ir_graph *irg, ir_graph_memory_t memory);
+
+/** Returns the memory of graph @p irg which is mapped from the OS. */
+FIRM_API ir_graph_memory_t get_irg_memory(const ir_graph *irg);
+
 /** Sets a description for local value n. */
 FIRM_API void set_irg_loc_description(ir_graph *irg, int n, void *description);
 
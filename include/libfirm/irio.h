@@ -12,6 +12,7 @@
 #define FIRM_IR_IRIO_H
 
 #include <stdio.h>
+#include <stdint.h>
 
 #include "firm_types.h"
 #include "begin.h"
@@ -38,6 +39,23 @@ FIRM_API int ir_export(const char *filename);
  */
 FIRM_API void ir_export_file(FILE *output);
 
+/**
+ * Exports the whole irp to the given file in a compact binary form.
+ * The binary form contains the same information as the textual one but is
+ * faster to write and read. Every graph is stored in a section of its own
+ * so readers are able to skip graphs.
+ *
+ * @param filename  the name of the resulting file
+ * @return  0 if no errors occured, other values in case of errors
+ */
+FIRM_API int ir_export_binary(const char *filename);
+
+/**
+ * same as ir_export_binary but writes to a FILE*
+ * @note As with any FILE* errors are indicated by ferror(output)
+ */
+FIRM_API void ir_export_binary_file(FILE *output);
+
 /**
  * Imports the data stored in the given file.
  * Imports any type graphs and ir graphs contained in the file.
@@ -49,9 +67,91 @@ FIRM_API int ir_import(const char *filename);
 
 /**
  * same as ir_import but imports from a FILE*
+ * Files in the binary format are detected automatically.
  */
 FIRM_API int ir_import_file(FILE *input, const char *inputname);
 
+/**
+ * Imports the given file into the current program like ir_import() and links
+ * it with the program.
+ *
+ * Members of the segments are linked by their linker name: entities which
+ * are not externally visible are renamed if their name is taken, externally
+ * visible ones are merged with the entity of the program of the same name.
+ * The merged entity takes the stronger definition: a definition beats a
+ * weak, mergeable or inline one, which beats a declaration. Two definitions
+ * of a symbol are an error. References to the imported entity are redirected
+ * to the entity of the program.
+ * Primitive, pointer and method types are shared with structurally equal
+ * types of the program.
+ *
+ * Afterwards optimizations like inlining and garbage collection of entities
+ * see the functions of all linked files.
+ *
+ * @param filename  the name of the file
+ * @returns 0 if no errors occured, other values in case of errors
+ */
+FIRM_API int ir_import_link(const char *filename);
+
+/**
+ * Imports data in the binary format from a memory buffer, for example a
+ * memory mapped file. The buffer is only accessed during the call.
+ *
+ * @param data       start of the buffer
+ * @param size       size of the buffer in bytes
+ * @param inputname  name of the input used in error messages
+ * @returns 0 if no errors occured, other values in case of errors
+ */
+FIRM_API int ir_import_buffer(const void *data, size_t size,
+                              const char *inputname);
+
+/**
+ * Imports data in the binary format from a memory buffer but leaves the
+ * graph bodies where they are. Types and entities are imported immediately,
+ * the body of a graph is read when its anchors are first accessed, so
+ * walking a graph or calling get_irg_start() and similar functions loads
+ * it. Graphs which are never touched do not occupy memory.
+ *
+ * The buffer and @p inputname have to stay valid until
+ * ir_finish_lazy_import() is called. Only one lazy import may be active at a
+ * time.
+ *
+ * @param data       start of the buffer
+ * @param size       size of the buffer in bytes
+ * @param inputname  name of the input used in error messages
+ * @returns 0 if no errors occured, other values in case of errors
+ */
+FIRM_API int ir_import_buffer_lazy(const void *data, size_t size,
+                                   const char *inputname);
+
+/**
+ * Reads the body of a graph from a lazy import if this did not happen yet.
+ * There is usually no need to call this explicitely.
+ */
+FIRM_API void ir_load_irg_body(ir_graph *irg);
+
+/**
+ * Ends the active lazy import. Graphs whose bodies were not read until now
+ * stay empty. The buffer passed to ir_import_buffer_lazy() may be released
+ * afterwards.
+ */
+FIRM_API void ir_finish_lazy_import(void);
+
+/**
+ * Computes a structural hash of a graph from its binary export.
+ *
+ * The hash covers the opcodes, modes and attributes of the nodes, the
+ * entities and types they reference and the properties of called entities.
+ * Instead of node, type and entity numbers it uses graph local node numbers,
+ * linker names and layouts, so it stays the same when other graphs of the
+ * program change. Graphs with equal hashes compile to the same code if the
+ * backend options are equal, which allows reusing the output of an earlier
+ * compilation for unchanged functions.
+ *
+ * The generic function pointers of the opcodes are overwritten.
+ */
+FIRM_API uint64_t ir_hash_irg(ir_graph *irg);
+
 /** @} */
 
 #include "end.h"
@@ -92,8 +92,6 @@ FIRM_API void *get_loop_link(const ir_loop *loop);
  *  The resulting loop tree is a possible visiting order for dataflow
  *  analysis.
  *
- *  This algorithm destoyes the link field of block nodes.
- *
  *  @remark
  *  One assumes, the Phi nodes in a block with a backedge have backedges
  *  at the same positions as the block.  This is not the case, as
@@ -115,8 +113,6 @@ FIRM_API void construct_backedges(ir_graph *irg);
  * This algorithm computes only back edge information for Block nodes, not
  * for Phi nodes.
  *
- * This algorithm destroyes the link field of block nodes.
- *
  * @param irg  the graph
  */
 FIRM_API void construct_cf_backedges(ir_graph *irg);
@@ -131,6 +131,17 @@ FIRM_API ir_alias_relation get_alias_relation(
 	const ir_node *adr1, const ir_mode *mode1,
 	const ir_node *adr2, const ir_mode *mode2);
 
+/**
+ * Assure that the alias query cache of a graph is valid.
+ *
+ * While the graph has the property IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE,
+ * get_alias_relation() remembers its results for addresses of the graph in a
+ * bounded cache, so passes asking for the same pairs again (and passes
+ * following each other without changing the graph) do not recompute them.
+ * Clearing the property invalidates the cache.
+ */
+FIRM_API void assure_irg_alias_cache(ir_graph *irg);
+
 /**
  * Sets a source language specific memory disambiguator function.
  *
@@ -138,6 +149,31 @@ FIRM_API ir_alias_relation get_alias_relation(
  */
 FIRM_API void set_language_memory_disambiguator(DISAMBIGUATOR_FUNC func);
 
+/** Precision of the points-to analysis. */
+typedef enum ir_points_to_precision {
+	ir_points_to_steensgaard, /**< unification based, almost linear time */
+	ir_points_to_andersen,    /**< inclusion based, more precise but slower */
+} ir_points_to_precision;
+
+/**
+ * Computes an interprocedural, flow insensitive points-to analysis of all
+ * graphs of the program and lets get_alias_relation() use it: Two addresses
+ * whose points-to sets are disjoint do not alias.
+ *
+ * The result stays valid while transformations preserve semantics: Nodes
+ * created later are unknown to the analysis and may alias anything. Graphs
+ * whose nodes are copied (dead node elimination) are forgotten.
+ *
+ * @param precision  Steensgaard's or Andersen's algorithm
+ */
+FIRM_API void compute_points_to(ir_points_to_precision precision);
+
+/**
+ * Frees the points-to information and stops get_alias_relation() from using
+ * it.
+ */
+FIRM_API void free_points_to(void);
+
 /**
  * Initialize the relation cache.
  */
@@ -191,11 +227,13 @@ FIRM_API void set_irp_globals_entity_usage_state(ir_entity_usage_computed_state
  * This is an interprocedural analysis that computes the address_taken state
  * for all global and TLS variables.
  *
- * Note that this is a conservative estimation that by no Firm transformation
- * can be invalidated, so it's only recomputed if manually triggered by calling
- * set_irp_globals_entity_usage_state(ir_entity_usage_not_computed).
- * Even then the information is not cleaned from the variables, call
- * assure_irp_globals_entity_usage_computed() again for recomputation.
+ * Once computed, the graphs using global addresses are tracked. New users of
+ * global addresses created by later transformations are noticed and calling
+ * this function again only recomputes the flags of the entities addressed in
+ * the changed graphs. A full recomputation (needed for example after the
+ * visibility of entities changed) is triggered by calling
+ * set_irp_globals_entity_usage_state(ir_entity_usage_not_computed) and
+ * assure_irp_globals_entity_usage_computed() again.
  */
 FIRM_API void assure_irp_globals_entity_usage_computed(void);
 
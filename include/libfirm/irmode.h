@@ -93,6 +93,20 @@ FIRM_API ir_mode *new_float_mode(const char *name,
                                  unsigned exponent_size,
                                  unsigned mantissa_size);
 
+/**
+ * Create a new vector mode.
+ *
+ * The values of a vector mode consist of @p n_elems values of the element
+ * mode, the element with index 0 at the lowest address in memory. Constants
+ * of vector modes do not exist, values are built and taken apart element
+ * by element.
+ * @param name       the name of the mode to be created
+ * @param elem_mode  mode of the elements, a number or reference mode
+ * @param n_elems    number of elements, at least 2
+ */
+FIRM_API ir_mode *new_vector_mode(const char *name, ir_mode *elem_mode,
+                                  unsigned n_elems);
+
 /**
  * Checks whether a pointer points to a mode.
  *
@@ -306,6 +320,14 @@ FIRM_API int mode_is_float (const ir_mode *mode);
 FIRM_API int mode_is_int (const ir_mode *mode);
 /** Returns 1 if @p mode is for references/pointers, 0 otherwise */
 FIRM_API int mode_is_reference (const ir_mode *mode);
+/** Returns 1 if @p mode is a vector mode, 0 otherwise */
+FIRM_API int mode_is_vector (const ir_mode *mode);
+
+/** Returns the number of elements of a vector mode, 1 for other modes. */
+FIRM_API unsigned get_mode_n_vector_elems(const ir_mode *mode);
+
+/** Returns the element mode of a vector mode, the mode itself for others. */
+FIRM_API ir_mode *get_mode_vector_elem_mode(const ir_mode *mode);
 /** Returns 1 if @p mode is for numeric values, 0 otherwise */
 FIRM_API int mode_is_num (const ir_mode *mode);
 /** Returns 1 if @p mode is for data values, 0 otherwise */
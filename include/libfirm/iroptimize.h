@@ -31,6 +31,20 @@
  */
 FIRM_API void optimize_cf(ir_graph *irg);
 
+/**
+ * Combined control flow cleanup.
+ *
+ * Removes Tuples, unreachable code and Bad control flow predecessors, skips
+ * empty blocks consisting of a single Jmp and merges blocks with their
+ * predecessor if it is the only one and ends in a Jmp. This is cheaper than
+ * calling remove_tuples(), remove_unreachable_code(), remove_bads() and
+ * optimize_cf() in a row: the graph is walked once and the dominance
+ * information stays consistent.
+ * Unlike optimize_cf() it does not remove blocks containing Phis and does
+ * not simplify Conds.
+ */
+FIRM_API void cleanup_cf(ir_graph *irg);
+
 /**
  * Perform path-sensitive jump threading on the given graph.
  *
@@ -53,6 +67,20 @@ FIRM_API void opt_bool(ir_graph *irg);
  */
 FIRM_API void conv_opt(ir_graph *irg);
 
+/**
+ * Computes integer arithmetic, Phis and Loads in the smallest integer mode
+ * covering the bits their users care for, as found by the don't care bit
+ * analysis. A value is only narrowed if all its users are narrowed as well
+ * or truncate it, so the Convs between narrowed operations vanish.
+ *
+ * Targets without cheap 8 or 16 bit operations should not narrow below their
+ * register width, as the backend has to extend the narrowed values again.
+ *
+ * @param irg       the graph
+ * @param min_bits  the smallest width to narrow to, rounded up to 8, 16 or 32
+ */
+FIRM_API void opt_narrow_modes(ir_graph *irg, unsigned min_bits);
+
 /**
  * A callback that checks whether a entity is an allocation
  * routine.
@@ -85,6 +113,11 @@ FIRM_API void escape_enalysis_irg(ir_graph *irg,
  *
  * This optimization removes allocation which are not used (rare) and replace
  * allocation that can be proved dead at the end of the graph which stack variables.
+ * The allocation routines must take the size in bytes as their only
+ * parameter like malloc(). Allocations of a small constant size are placed on
+ * the frame, others become Alloc nodes unless they are inside a loop.
+ * Whether a pointer escapes into a callee is decided with the parameter
+ * access of the callee, see get_method_param_access().
  *
  * The creation of stack variable allows scalar replacement to be run only
  * on those graphs that have been changed.
@@ -160,6 +193,14 @@ FIRM_API void opt_if_conv(ir_graph *irg);
  */
 FIRM_API void opt_parallelize_mem(ir_graph *irg);
 
+/**
+ * Combines Stores of constants to neighbouring, aligned memory which follow
+ * each other directly on the memory chain into Stores of up to the machine
+ * word size.
+ * @param irg   the graph
+ */
+FIRM_API void opt_combine_stores(ir_graph *irg);
+
 /**
  * Check if we can replace the load by a given const from
  * the const code irg.
@@ -328,9 +369,24 @@ FIRM_API void remove_phi_cycles(ir_graph *irg);
  * The threshold is an estimation of how many instructions are saved
  * when executing a cloned method. If threshold is 0.0, every possible
  * call is cloned.
+ *
+ * Clones made by earlier runs are reused for calls with the same constant
+ * argument, regardless of the threshold.
  */
 FIRM_API void proc_cloning(float threshold);
 
+/**
+ * Profile guided variant of proc_cloning(). Every call counts with the
+ * execution frequency of its block, so the execution frequencies of all
+ * graphs have to be valid, see ir_estimate_execfreq().
+ *
+ * @param threshold   the threshold for cloning
+ * @param budget      maximum number of nodes the new clones may add to the
+ *                    whole program, handed out to the heaviest
+ *                    specializations first; 0 for no limit
+ */
+FIRM_API void proc_cloning_profiled(float threshold, unsigned budget);
+
 /**
  * Reassociation.
  *
@@ -347,6 +403,20 @@ FIRM_API void proc_cloning(float threshold);
  */
 FIRM_API void optimize_reassociation(ir_graph *irg);
 
+/**
+ * Tree height reduction.
+ *
+ * Rebalances chains of the same associative operation, like
+ * ((a+b)+c)+d, into trees whose operations may execute in parallel, like
+ * (a+b)+(c+d). The operands available first are combined first, at most as
+ * many operations per cycle as the issue width of the backend parameters.
+ * Loop carried Phis are combined last, so reductions in loops only wait for
+ * one operation per iteration.
+ * Works on integer Add, Mul, And, Eor and Or and on floating point Add and
+ * Mul if imprecise float transformations are allowed.
+ */
+FIRM_API void optimize_tree_height(ir_graph *irg);
+
 /**
  * Normalize the Returns of a graph by creating a new End block
  * with One Return(Phi).
@@ -457,6 +527,68 @@ typedef void (*opt_ptr)(ir_graph *irg);
 FIRM_API void inline_functions(unsigned maxsize, int inline_threshold,
                                opt_ptr after_inline_opt);
 
+/** Flags for inline_functions_profiled(). */
+typedef enum inline_profile_flags {
+	inline_profile_none = 0,      /**< static heuristics only */
+	/** rank call sites by their execution frequency instead of their loop
+	 * depth, scaled by the profiled number of calls of the caller if an
+	 * execution count profile is loaded */
+	inline_profile_hot  = 1 << 0,
+	/** do not inline call sites executed less often than the cold
+	 * threshold, unless this removes the only call of a local function */
+	inline_profile_cold = 1 << 1,
+} inline_profile_flags;
+ENUM_BITSET(inline_profile_flags)
+
+/**
+ * Profile guided variant of inline_functions(). The execution frequencies of
+ * all graphs have to be valid, see ir_estimate_execfreq() and
+ * ir_sample_profile_apply().
+ *
+ * @param maxsize             Do not inline any calls if a method has more than
+ *                            maxsize firm nodes.
+ * @param inline_threshold    inlining threshold
+ * @param flags               a combination of inline_profile_flags
+ * @param budget              maximum number of nodes added to the whole
+ *                            program, handed out to the most beneficial call
+ *                            sites first; 0 for no limit
+ * @param cold_threshold      call sites below this frequency are cold
+ * @param after_inline_opt    optimizations performed immediately after inlining
+ *                            some calls
+ */
+FIRM_API void inline_functions_profiled(unsigned maxsize, int inline_threshold,
+                                        unsigned flags, unsigned budget,
+                                        double cold_threshold,
+                                        opt_ptr after_inline_opt);
+
+/**
+ * Speculative devirtualization. Indirect calls whose most frequent target,
+ * as recorded by the execution count profile, makes up at least
+ * @p min_ratio of the majority vote of the call (see
+ * ir_profile_get_call_target()) are guarded by a comparison of the callee
+ * with that target. The direct call for the common case can then be inlined,
+ * so run this before the inliner and while the node numbers of the graph
+ * still match the profile.
+ *
+ * @param irg        the graph to optimize
+ * @param min_ratio  minimal ratio of the target count and the executions of
+ *                   the call
+ */
+FIRM_API void opt_speculative_devirt(ir_graph *irg, double min_ratio);
+
+/**
+ * Devirtualization by class hierarchy analysis. A Sel of a method is
+ * replaced by the address of the method's implementation if no method
+ * overwriting it has another one, so the Calls using it become direct calls.
+ * Abstract methods (peculiarity_description) do not count as
+ * implementations. The class hierarchy must be complete, i.e. it must not
+ * be extended by code outside of the program.
+ *
+ * Uses the transitive closure of the inheritance relations; it is computed
+ * for the pass if it is not valid.
+ */
+FIRM_API void opt_class_devirt(void);
+
 /**
  * Combines congruent blocks into one.
  *
@@ -483,6 +615,16 @@ FIRM_API void do_loop_unrolling(ir_graph *irg);
  */
 FIRM_API void do_loop_peeling(ir_graph *irg);
 
+/**
+ * Perform loop unswitching on a given graph.
+ * A branch on a loop invariant condition inside an innermost loop is moved
+ * in front of the loop, which is duplicated for both outcomes. Loop size and
+ * the execution frequencies of the blocks, if present, limit the
+ * transformation. The branches in the loops become constant and are removed
+ * by a following control flow optimization.
+ */
+FIRM_API void do_loop_unswitching(ir_graph *irg);
+
 /**
  * Removes all entities which are unused.
  *
@@ -530,6 +672,19 @@ FIRM_API void dead_node_elimination(ir_graph *irg);
  */
 FIRM_API void place_code(ir_graph *irg);
 
+/**
+ * Profile guided variant of place_code(). Instead of moving a node out of as
+ * many loops as possible, it is placed in the dominance-deepest block with
+ * the smallest execution frequency between its earliest and latest legal
+ * block. A node is only hoisted if this strictly lowers its frequency, so
+ * computations used on a rarely taken path only are sunk into that path.
+ * The execution frequencies have to be valid, see ir_estimate_execfreq() and
+ * ir_sample_profile_apply(); without them this behaves like place_code().
+ *
+ * @param irg  the graph
+ */
+FIRM_API void place_code_profiled(ir_graph *irg);
+
 /**
  * Determines information about the values of nodes and perform simplifications
  * using this information.  This optimization performs a data-flow analysis to
@@ -543,6 +698,16 @@ FIRM_API void fixpoint_vrp(ir_graph*);
  */
 FIRM_API void occult_consts(ir_graph*);
 
+/**
+ * Replaces comparisons whose outcome follows from the dominating conditions,
+ * Confirms and the ranges of integer values by constants. Phis on cycles get
+ * ranges if they only grow or only shrink, so the bounds checks of counted
+ * loops are eliminated. Null checks use value_not_null() as well.
+ *
+ * @param irg  the graph
+ */
+FIRM_API void opt_range_checks(ir_graph *irg);
+
 /**
  * Checks if the value of a node is != 0.
  *
@@ -581,6 +746,57 @@ FIRM_API int value_not_null(const ir_node *n, const ir_node **confirm);
 FIRM_API ir_tarval *computed_value_Cmp_Confirm(
 	const ir_node *cmp, ir_node *left, ir_node *right, ir_relation relation);
 
+/** A list of graph passes, see new_graph_passes(). */
+typedef struct ir_graph_passes_t ir_graph_passes_t;
+
+/**
+ * Creates an empty list of graph passes. Graph passes are optimizations
+ * working on one graph at a time like optimize_cf(), combo() or opt_ldst().
+ */
+FIRM_API ir_graph_passes_t *new_graph_passes(void);
+
+/** Frees a list of graph passes. */
+FIRM_API void free_graph_passes(ir_graph_passes_t *passes);
+
+/**
+ * Appends a pass to a list of graph passes. Passes needing additional
+ * parameters have to be wrapped in a function taking only the graph.
+ *
+ * @param passes  the list of passes
+ * @param name    the name of the pass, used in diagnostics
+ * @param func    the pass
+ */
+FIRM_API void graph_passes_add(ir_graph_passes_t *passes, const char *name,
+                               opt_ptr func);
+
+/**
+ * Enables or disables verification of the graph after every pass.
+ */
+FIRM_API void graph_passes_set_verify(ir_graph_passes_t *passes, int enable);
+
+/**
+ * Runs all passes of the list in order on one graph.
+ */
+FIRM_API void graph_passes_run_irg(const ir_graph_passes_t *passes,
+                                   ir_graph *irg);
+
+/**
+ * Runs all passes of the list on every graph of the program. Each graph
+ * goes through the complete list before the next one is processed.
+ */
+FIRM_API void graph_passes_run(const ir_graph_passes_t *passes);
+
+/**
+ * Runs all passes of the list on every graph of the program in bottom-up
+ * callgraph order: a graph is processed after all graphs it calls, except
+ * for graphs of the same recursion, which are processed one after another.
+ * Passes looking at their callees (inlining, call optimizations) thus see
+ * the callees in their final state.
+ *
+ * The callgraph must have been computed with compute_callgraph().
+ */
+FIRM_API void graph_passes_run_bottom_up(const ir_graph_passes_t *passes);
+
 /** Type of callbacks for creating entities of the compiler library */
 typedef ident *(*compilerlib_name_mangle_t)(ident *id, ir_type *mt);
 
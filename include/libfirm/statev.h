@@ -60,6 +60,15 @@ FIRM_API void stat_ev(const char *name);
  */
 FIRM_API void stat_ev_begin(const char *filename_prefix, const char *filter);
 
+/**
+ * Initialize the stat ev machinery to write events in a compact binary format
+ * to the file filename_prefix.evb. Emitting an event costs much less than in
+ * the text format. scripts/statev_sql.py reads both formats.
+ * @see stat_ev_begin()
+ */
+FIRM_API void stat_ev_begin_binary(const char *filename_prefix,
+                                   const char *filter);
+
 /**
  * Shuts down stat ev machinery
  */
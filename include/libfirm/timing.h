@@ -12,6 +12,7 @@
 
 #include <stdlib.h>
 
+#include "firm_types.h"
 #include "begin.h"
 
 /**
@@ -44,6 +45,55 @@ FIRM_API int ir_timer_leave_high_priority(void);
  */
 FIRM_API size_t ir_get_heap_used_bytes(void);
 
+/**
+ * Returns the current wallclock time in seconds.
+ * Unlike the timers this does not interact with the timer stack.
+ */
+FIRM_API double ir_get_time_sec(void);
+
+/**
+ * Hardware events counted by the timers while hardware counters are enabled.
+ */
+typedef enum ir_timer_counter_t {
+	ir_timer_counter_cycles,        /**< CPU cycles */
+	ir_timer_counter_instructions,  /**< retired instructions */
+	ir_timer_counter_cache_misses,  /**< last level cache misses */
+	ir_timer_counter_branch_misses, /**< mispredicted branches */
+	ir_timer_counter_last = ir_timer_counter_branch_misses
+} ir_timer_counter_t;
+
+/**
+ * Starts counting hardware events. Timers started afterwards count the events
+ * between their start and stop calls in addition to the time.
+ * Only available on Linux with perf events. Events the CPU does not support
+ * are counted as 0.
+ * @return non-zero if the counters are available
+ */
+FIRM_API int ir_timer_enable_counters(void);
+
+/**
+ * Stops counting hardware events.
+ */
+FIRM_API void ir_timer_disable_counters(void);
+
+/**
+ * Returns non-zero if hardware events are counted.
+ */
+FIRM_API int ir_timer_counters_enabled(void);
+
+/**
+ * Returns the name of a hardware counter, like "cycles".
+ */
+FIRM_API const char *ir_timer_counter_name(ir_timer_counter_t counter);
+
+/**
+ * Reads the current values of all hardware counters into @p values, which
+ * must have room for ir_timer_counter_last+1 entries. All values are 0 if the
+ * counters are not enabled.
+ * Unlike the timers this does not interact with the timer stack.
+ */
+FIRM_API void ir_get_counters(unsigned long long *values);
+
 /**
  * Create a new timer
  * @return The timer.
@@ -122,6 +172,67 @@ FIRM_API unsigned long ir_timer_elapsed_usec(const ir_timer_t *timer);
  */
 FIRM_API double ir_timer_elapsed_sec(const ir_timer_t *timer);
 
+/**
+ * Returns the number of hardware events of kind @p counter counted while the
+ * timer was running.
+ * @see ir_timer_enable_counters()
+ */
+FIRM_API unsigned long long ir_timer_elapsed_counter(const ir_timer_t *timer,
+                                                     ir_timer_counter_t counter);
+
+/**
+ * Enables or disables the per pass statistics.
+ *
+ * While enabled and statistic events are active (see stat_ev_begin()), every
+ * pass bracketed by ir_pass_stat_begin() and ir_pass_stat_end() emits the
+ * statistic events
+ *  - pass_time            wallclock time of the pass in microseconds
+ *  - pass_heap_delta      change of the heap size in bytes
+ *  - pass_nodes_before    node count of the graph before the pass
+ *  - pass_nodes_after     node count of the graph after the pass
+ *  - pass_irg_bytes       memory of the graph after the pass, see
+ *                         ir_get_irg_memory_total()
+ *  - pass_cycles, pass_instructions, pass_cache_misses, pass_branch_misses
+ *                         hardware events during the pass, only while
+ *                         ir_timer_enable_counters() is in effect
+ * in the contexts "pass" (the name of the pass) and "pass_irg" (the graph).
+ * The node count is the number of node indices handed out by the graph, so
+ * it includes dead nodes. Nested passes are included in the numbers of the
+ * enclosing pass.
+ */
+FIRM_API void ir_pass_stat_enable(int enable);
+
+/**
+ * Returns non-zero if per pass statistics are recorded.
+ */
+FIRM_API int ir_pass_stat_enabled(void);
+
+/**
+ * Starts writing every pass bracketed by ir_pass_stat_begin() and
+ * ir_pass_stat_end() as a span in the Chrome trace event format to the file
+ * @p filename. The file can be loaded into chrome://tracing or Perfetto.
+ * @return non-zero on success, zero if the file could not be opened
+ */
+FIRM_API int ir_pass_trace_begin(const char *filename);
+
+/**
+ * Finishes and closes the trace file opened by ir_pass_trace_begin().
+ */
+FIRM_API void ir_pass_trace_end(void);
+
+/**
+ * Marks the begin of a pass.
+ * @param irg   the graph the pass works on, NULL for the graph of the
+ *              enclosing pass or if the pass works on the whole program
+ * @param name  the name of the pass, must stay valid until the pass ends
+ */
+FIRM_API void ir_pass_stat_begin(ir_graph *irg, const char *name);
+
+/**
+ * Marks the end of the pass started last with ir_pass_stat_begin().
+ */
+FIRM_API void ir_pass_stat_end(void);
+
 #include "end.h"
 
 #endif
@@ -476,7 +476,9 @@ typedef enum ir_initializer_kind_t {
 	/** initializes type with default values (usually 0) */
 	IR_INITIALIZER_NULL,
 	/** list of initializers used to initializer a compound or array type */
-	IR_INITIALIZER_COMPOUND
+	IR_INITIALIZER_COMPOUND,
+	/** raw bytes used verbatim as memory contents */
+	IR_INITIALIZER_BYTES
 } ir_initializer_kind_t;
 
 /** Returns kind of an initializer */
@@ -520,6 +522,42 @@ FIRM_API void set_initializer_compound_value(ir_initializer_t *initializer,
 FIRM_API ir_initializer_t *get_initializer_compound_value(
 		const ir_initializer_t *initializer, size_t index);
 
+/**
+ * Creates an initializer containing @p size raw bytes which are used verbatim
+ * (in target byte order) as the memory contents of the initialized object.
+ * Bytes initializers cannot contain addresses. If the object is larger than
+ * @p size the remaining bytes are zero.
+ * Large tables should use this instead of compound initializers, as they are
+ * emitted without building an intermediate representation of the values.
+ * @note The data is not copied and must stay valid as long as the
+ *       initializer is used.
+ */
+FIRM_API ir_initializer_t *create_initializer_bytes(const void *data,
+                                                    size_t size);
+
+/**
+ * Creates a bytes initializer with the contents of the file @p filename.
+ * The file is mapped into memory instead of being read if the host supports
+ * it. The assembler output references the file with .incbin, so it must
+ * still exist when the assembler runs.
+ * @returns the initializer or NULL if the file could not be read
+ */
+FIRM_API ir_initializer_t *create_initializer_file(const char *filename);
+
+/** Returns the number of bytes of a bytes initializer */
+FIRM_API size_t get_initializer_bytes_size(const ir_initializer_t *initializer);
+
+/** Returns the data of a bytes initializer */
+FIRM_API const void *get_initializer_bytes_data(
+		const ir_initializer_t *initializer);
+
+/**
+ * Returns the name of the file containing the data of a bytes initializer
+ * or NULL if it was not created by create_initializer_file().
+ */
+FIRM_API const char *get_initializer_bytes_file(
+		const ir_initializer_t *initializer);
+
 /** @} */
 
 /** Sets the new style initializers of an entity. */
@@ -885,10 +923,12 @@ FIRM_API void resolve_inheritance(mangle_inherited_name_func *mfunc);
 /* some other way invalidates the transitive closure, i.e., it is not      */
 /* updated by the basic functions.                                         */
 /*                                                                         */
-/* The transitive edges are held in a set, not in an array as the          */
-/* underlying relation.                                                    */
+/* The elements of each relation are numbered in depth first order, so    */
+/* that the transitive subtypes of a class in single inheritance are an    */
+/* interval of numbers.  Other closures are held in sorted arrays or       */
+/* bitsets.  Queries are O(1) (O(log n) for arrays).                       */
 /*                                                                         */
-/* Do the sets contain the node itself?  I assume NOT!                     */
+/* The closures do not contain the element itself.                         */
 /* ----------------------------------------------------------------------- */
 
 /**
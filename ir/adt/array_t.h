@@ -44,6 +44,31 @@
     (void)(ARR_DESCR((var))->nelts = nelts);                       \
   } while (0)
 
+/**
+ * Returns the number of bytes needed for a dynamic array with @p n elements
+ * of a given type including its header.
+ */
+#define ARR_D_SIZE(type, n) (ARR_ELTS_OFFS + sizeof(type) * (n))
+
+/**
+ * Creates a dynamic array in memory provided by the caller, which must have
+ * room for ARR_D_SIZE() bytes and live as long as the array. The array
+ * behaves like one created with NEW_ARR_D().
+ *
+ * @param type     The element type of the new array.
+ * @param memory   The memory for the array and its header.
+ * @param n        number of elements in this array.
+ */
+#define INIT_ARR_D(type, memory, n) ((type *)ir_init_arr_d((memory), (n)))
+
+static inline void *ir_init_arr_d(void *memory, size_t nelts)
+{
+	ir_arr_descr *dp = (ir_arr_descr*)memory;
+	ARR_SET_DBGINF(dp, ARR_D_MAGIC);
+	dp->allocated = dp->nelts = nelts;
+	return dp->elts;
+}
+
 /**
  * Creates a new automatic array with the same number of elements as a
  * given one.
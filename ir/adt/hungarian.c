@@ -28,9 +28,12 @@
  * @file
  * @brief   Solving the Minimum Assignment Problem using the Hungarian Method.
  */
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
+#include <string.h>
 
 #include "util.h"
 #include "xmalloc.h"
@@ -431,3 +434,117 @@ done:
 
 	return 0;
 }
+
+void hungarian_solve_small(unsigned num_rows, unsigned num_cols,
+                           const unsigned *util, unsigned *assignment)
+{
+	assert(num_rows <= num_cols && num_cols <= HUNGARIAN_SMALL_MAX);
+	FIRM_DBG_REGISTER(dbg, "firm.hungarian");
+
+	/* Greedy pre-pass: a row and a column connected only to each other are
+	 * part of an optimal matching. */
+	unsigned row_edges[HUNGARIAN_SMALL_MAX];
+	unsigned col_edges[HUNGARIAN_SMALL_MAX];
+	unsigned row_last[HUNGARIAN_SMALL_MAX];
+	unsigned max_util = 0;
+	memset(col_edges, 0, sizeof(col_edges));
+	for (unsigned r = 0; r < num_rows; ++r) {
+		row_edges[r] = 0;
+		for (unsigned c = 0; c < num_cols; ++c) {
+			unsigned u = util[r*num_cols + c];
+			if (u == 0)
+				continue;
+			++row_edges[r];
+			++col_edges[c];
+			row_last[r] = c;
+			max_util    = MAX(max_util, u);
+		}
+	}
+	assert(max_util <= INT_MAX / 2);
+
+	/* The remaining rows and columns are solved by the Hungarian method with
+	 * potentials, the indices are shifted by one to use 0 as sentinel. */
+	unsigned rows[HUNGARIAN_SMALL_MAX + 1];
+	unsigned cols[HUNGARIAN_SMALL_MAX + 1];
+	bool     col_done[HUNGARIAN_SMALL_MAX];
+	unsigned n_rows = 0;
+	unsigned n_cols = 0;
+	memset(col_done, 0, sizeof(col_done));
+	for (unsigned r = 0; r < num_rows; ++r) {
+		if (row_edges[r] == 1 && col_edges[row_last[r]] == 1) {
+			assignment[r]          = row_last[r];
+			col_done[row_last[r]] = true;
+			DBG((dbg, LEVEL_1, "trivially matching row %u == col %u\n", r,
+			     row_last[r]));
+		} else {
+			rows[++n_rows] = r;
+		}
+	}
+	if (n_rows == 0)
+		return;
+	for (unsigned c = 0; c < num_cols; ++c) {
+		if (!col_done[c])
+			cols[++n_cols] = c;
+	}
+
+	int      row_pot[HUNGARIAN_SMALL_MAX + 1];
+	int      col_pot[HUNGARIAN_SMALL_MAX + 1];
+	int      min_slack[HUNGARIAN_SMALL_MAX + 1];
+	unsigned col_mate[HUNGARIAN_SMALL_MAX + 1];
+	unsigned way[HUNGARIAN_SMALL_MAX + 1];
+	bool     used[HUNGARIAN_SMALL_MAX + 1];
+	memset(row_pot, 0, sizeof(row_pot));
+	memset(col_pot, 0, sizeof(col_pot));
+	memset(col_mate, 0, sizeof(col_mate));
+	for (unsigned i = 1; i <= n_rows; ++i) {
+		/* find a shortest augmenting path from row i */
+		unsigned j0 = 0;
+		col_mate[0] = i;
+		for (unsigned j = 0; j <= n_cols; ++j) {
+			min_slack[j] = INT_MAX;
+			used[j]      = false;
+		}
+		do {
+			used[j0] = true;
+			unsigned i0    = col_mate[j0];
+			unsigned r     = rows[i0];
+			int      delta = INT_MAX;
+			unsigned j1    = 0;
+			for (unsigned j = 1; j <= n_cols; ++j) {
+				if (used[j])
+					continue;
+				int cost = (int)(max_util - util[r*num_cols + cols[j]]);
+				int cur  = cost - row_pot[i0] - col_pot[j];
+				if (cur < min_slack[j]) {
+					min_slack[j] = cur;
+					way[j]       = j0;
+				}
+				if (min_slack[j] < delta) {
+					delta = min_slack[j];
+					j1    = j;
+				}
+			}
+			for (unsigned j = 0; j <= n_cols; ++j) {
+				if (used[j]) {
+					row_pot[col_mate[j]] += delta;
+					col_pot[j]           -= delta;
+				} else {
+					min_slack[j] -= delta;
+				}
+			}
+			j0 = j1;
+		} while (col_mate[j0] != 0);
+
+		/* flip the matching along the path */
+		do {
+			unsigned j1  = way[j0];
+			col_mate[j0] = col_mate[j1];
+			j0           = j1;
+		} while (j0 != 0);
+	}
+
+	for (unsigned j = 1; j <= n_cols; ++j) {
+		if (col_mate[j] != 0)
+			assignment[rows[col_mate[j]]] = cols[j];
+	}
+}
@@ -0,0 +1,132 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   memory mapped directly from the operating system
+ */
+/* MAP_ANONYMOUS and madvise() are not part of C99/POSIX */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pagealloc.h"
+#include "error.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+/** Size of the chunks of page obstacks, one huge page on most systems. */
+#define PAGE_CHUNK_SIZE (2 * 1024 * 1024)
+
+/** Alignment of memory to be backed by huge pages. */
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+static NORETURN page_nomem(void)
+{
+	fputs("out of memory", stderr);
+	abort();
+}
+
+#ifdef HAVE_MMAP
+
+static size_t get_page_size(void)
+{
+	static size_t page_size;
+	if (page_size == 0)
+		page_size = (size_t)sysconf(_SC_PAGESIZE);
+	return page_size;
+}
+
+void *page_alloc(size_t size, bool huge_pages)
+{
+	size_t const page_size = get_page_size();
+	size = (size + page_size - 1) & ~(page_size - 1);
+
+	int const prot  = PROT_READ | PROT_WRITE;
+	int const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MADV_HUGEPAGE
+	if (huge_pages && size >= HUGE_PAGE_SIZE) {
+		/* map more than needed and trim, so the memory starts at a huge
+		 * page boundary */
+		size_t const map_size = size + HUGE_PAGE_SIZE;
+		char  *const map      = (char*)mmap(NULL, map_size, prot, flags, -1, 0);
+		if (map == MAP_FAILED)
+			page_nomem();
+		char *const res = (char*)(((size_t)map + HUGE_PAGE_SIZE - 1)
+		                          & ~(size_t)(HUGE_PAGE_SIZE - 1));
+		if (res != map)
+			munmap(map, res - map);
+		size_t const tail = map + map_size - (res + size);
+		if (tail != 0)
+			munmap(res + size, tail);
+		/* only a hint, the memory works without huge pages as well */
+		madvise(res, size, MADV_HUGEPAGE);
+		return res;
+	}
+#else
+	(void)huge_pages;
+#endif
+	void *const res = mmap(NULL, size, prot, flags, -1, 0);
+	if (res == MAP_FAILED)
+		page_nomem();
+	return res;
+}
+
+void page_free(void *ptr, size_t size)
+{
+	if (ptr != NULL)
+		munmap(ptr, size);
+}
+
+#else
+
+void *page_alloc(size_t size, bool huge_pages)
+{
+	(void)huge_pages;
+	void *const res = calloc(1, size);
+	if (res == NULL)
+		page_nomem();
+	return res;
+}
+
+void page_free(void *ptr, size_t size)
+{
+	(void)size;
+	free(ptr);
+}
+
+#endif
+
+static bool const use_huge_pages = true;
+static bool const use_small_pages = false;
+
+static void *page_chunk_alloc(void *arg, PTR_INT_TYPE size)
+{
+	bool const huge_pages = *(bool const*)arg;
+	return page_alloc((size_t)size, huge_pages);
+}
+
+static void page_chunk_free(void *arg, void *chunk)
+{
+	(void)arg;
+	struct _obstack_chunk *const c = (struct _obstack_chunk*)chunk;
+	page_free(c, c->limit - (char*)c);
+}
+
+void page_obstack_init(struct obstack *obst, bool huge_pages)
+{
+	void *const arg = (void*)(huge_pages ? &use_huge_pages : &use_small_pages);
+	obstack_specify_allocation_with_arg(obst, PAGE_CHUNK_SIZE, 0,
+	                                    page_chunk_alloc, page_chunk_free, arg);
+}
@@ -0,0 +1,43 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   memory mapped directly from the operating system
+ *
+ * Large allocations which live as long as a graph are better served by
+ * anonymous mappings than by the heap: they do not fragment the heap, can
+ * be backed by huge pages and are returned to the operating system as soon
+ * as they are freed. On systems without mmap() the heap is used.
+ */
+#ifndef FIRM_ADT_PAGEALLOC_H
+#define FIRM_ADT_PAGEALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "obstack.h"
+
+/**
+ * Allocates @p size bytes of zeroed memory mapped from the operating system.
+ * Aborts if no memory is available.
+ *
+ * @param huge_pages  advise the kernel to back the memory by huge pages
+ */
+void *page_alloc(size_t size, bool huge_pages);
+
+/**
+ * Frees memory allocated by page_alloc(), @p size must be the size it was
+ * allocated with.
+ */
+void page_free(void *ptr, size_t size);
+
+/**
+ * Initializes an obstack whose chunks are allocated by page_alloc(). The
+ * chunks are large, so this only pays off for obstacks growing large.
+ */
+void page_obstack_init(struct obstack *obst, bool huge_pages);
+
+#endif
@@ -13,22 +13,14 @@
 #include "error.h"
 
 /*
- * Implements a heap.
- *
- * Implementation note: It might seem strange that we start indexing at 0
- * but use 2*i and 2*i+1 to find the left and right sucessor of an index.
- * The trick is that for index 0 the left successor is 0 again, and the
- * right successor is 1 in this scheme. For the right successor 1 everything
- * works like usual. We simply took care in the algorithms that they still
- * work with the left child of 0 being 0 again. This was possible without
- * any extra ifs or arithmetic.
- * Thus we can save the wastage of 1 array position you can see in other
- * implementations or the ugly (i+1)*2 - 1 and (i+1)*2 for calculating the
- * left and right child. (At the expense that stuff easily breaks when you make
- * changes and don't think that the left child of 0 is 0 :-/)
- *
+ * Implements a 4-ary heap stored in an array. The children of the element at
+ * position i are at positions 4*i+1 to 4*i+4. Compared to a binary heap the
+ * tree has half the height and the children of an element lie next to each
+ * other in memory, which makes popping and sifting down cheaper.
  */
 
+#define PQUEUE_ARITY 4
+
 typedef struct pqueue_el_t {
 	void *data;
 	int  priority;
@@ -39,51 +31,54 @@ struct pqueue_t {
 };
 
 /**
- * Enforces the heap characteristics if the queue
- * starting from element at position @p pos.
+ * Moves the element @p el down starting at position @p pos until the heap
+ * property is restored.
  */
-static void pqueue_heapify(pqueue_t *q, size_t pos)
+static void pqueue_sift_down(pqueue_t *q, size_t pos, pqueue_el_t el)
 {
-	size_t len = ARR_LEN(q->elems);
+	pqueue_el_t *elems = q->elems;
+	size_t       len   = ARR_LEN(elems);
 
-	while (pos * 2 < len) {
-		pqueue_el_t tmp;
-		size_t      exchange = pos;
+	for (;;) {
+		size_t first = pos * PQUEUE_ARITY + 1;
+		if (first >= len)
+			break;
 
-		if (q->elems[exchange].priority < q->elems[pos * 2].priority) {
-			exchange = pos * 2;
-		}
+		size_t last = first + PQUEUE_ARITY;
+		if (last > len)
+			last = len;
 
-		if ((pos * 2 + 1) < len
-				&& q->elems[exchange].priority < q->elems[pos * 2 + 1].priority) {
-			exchange = pos * 2 + 1;
+		size_t max = first;
+		for (size_t c = first + 1; c < last; ++c) {
+			if (elems[c].priority > elems[max].priority)
+				max = c;
 		}
 
-		if (exchange == pos)
+		if (elems[max].priority <= el.priority)
 			break;
 
-		tmp                = q->elems[pos];
-		q->elems[pos]      = q->elems[exchange];
-		q->elems[exchange] = tmp;
-
-		pos = exchange;
+		elems[pos] = elems[max];
+		pos        = max;
 	}
+	elems[pos] = el;
 }
 
 /**
- * Sifts up a newly inserted element at position @p pos.
+ * Moves the element @p el up starting at position @p pos until the heap
+ * property is restored.
  */
-static void pqueue_sift_up(pqueue_t *q, size_t pos)
+static void pqueue_sift_up(pqueue_t *q, size_t pos, pqueue_el_t el)
 {
-	while (q->elems[pos].priority > q->elems[pos / 2].priority) {
-		pqueue_el_t tmp;
-
-		tmp               = q->elems[pos];
-		q->elems[pos]     = q->elems[pos / 2];
-		q->elems[pos / 2] = tmp;
+	pqueue_el_t *elems = q->elems;
 
-		pos /= 2;
+	while (pos > 0) {
+		size_t parent = (pos - 1) / PQUEUE_ARITY;
+		if (elems[parent].priority >= el.priority)
+			break;
+		elems[pos] = elems[parent];
+		pos        = parent;
 	}
+	elems[pos] = el;
 }
 
 pqueue_t *new_pqueue(void)
@@ -108,28 +103,50 @@ void pqueue_put(pqueue_t *q, void *data, int priority)
 
 	ARR_APP1(pqueue_el_t, q->elems, el);
 
-	pqueue_sift_up(q, ARR_LEN(q->elems) - 1);
+	pqueue_sift_up(q, ARR_LEN(q->elems) - 1, el);
 }
 
 void *pqueue_pop_front(pqueue_t *q)
 {
-	switch (ARR_LEN(q->elems)) {
-		case 0:
-			panic("Attempt to retrieve element from empty priority queue.");
-		case 1:
-			ARR_SHRINKLEN(q->elems, 0);
-			return q->elems[0].data;
-		default: {
-			void   *data = q->elems[0].data;
-			size_t len   = ARR_LEN(q->elems) - 1;
-
-			q->elems[0] = q->elems[len];
-			ARR_SHRINKLEN(q->elems, len);
-			pqueue_heapify(q, 0);
-
-			return data;
-		}
-	}
+	size_t len = ARR_LEN(q->elems);
+	if (len == 0)
+		panic("Attempt to retrieve element from empty priority queue.");
+
+	void *data = q->elems[0].data;
+	--len;
+	pqueue_el_t last = q->elems[len];
+	ARR_SHRINKLEN(q->elems, len);
+	if (len > 0)
+		pqueue_sift_down(q, 0, last);
+
+	return data;
+}
+
+void *pqueue_front(const pqueue_t *q)
+{
+	if (ARR_LEN(q->elems) == 0)
+		panic("Attempt to retrieve element from empty priority queue.");
+	return q->elems[0].data;
+}
+
+int pqueue_front_priority(const pqueue_t *q)
+{
+	if (ARR_LEN(q->elems) == 0)
+		panic("Attempt to retrieve element from empty priority queue.");
+	return q->elems[0].priority;
+}
+
+void pqueue_replace_front(pqueue_t *q, void *data, int priority)
+{
+	if (ARR_LEN(q->elems) == 0)
+		panic("Attempt to replace element of empty priority queue.");
+
+	pqueue_el_t el;
+	el.data     = data;
+	el.priority = priority;
+
+	/* the front has no parent, so the new element can only move down */
+	pqueue_sift_down(q, 0, el);
 }
 
 size_t pqueue_length(const pqueue_t *q)
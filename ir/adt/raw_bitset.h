@@ -20,6 +20,10 @@
  *
  *     The bitset is built as an array of unsigned integers. The unused bits
  *     must be zero.
+ *
+ *     When the compiler targets SSE2 the bulk operations and the search for
+ *     the next set bit process RBITSET_VEC_ELEMS elements at once. The
+ *     remaining elements and all other targets use the plain loops.
  */
 #ifndef FIRM_ADT_RAW_BITSET_H
 #define FIRM_ADT_RAW_BITSET_H
@@ -34,6 +38,50 @@
 #define BITSET_SIZE_BYTES(size_bits) (BITSET_SIZE_ELEMS(size_bits) * sizeof(unsigned))
 #define BITSET_ELEM(bitset,pos)      bitset[pos / BITS_PER_ELEM]
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define RBITSET_SSE2
+/** Number of bitset elements processed by one vector operation. */
+#define RBITSET_VEC_ELEMS            (sizeof(__m128i) / sizeof(unsigned))
+
+static inline __m128i rbitset_vec_load_(const unsigned *elems)
+{
+	return _mm_loadu_si128((const __m128i*)elems);
+}
+
+static inline void rbitset_vec_store_(unsigned *elems, __m128i v)
+{
+	_mm_storeu_si128((__m128i*)elems, v);
+}
+
+static inline bool rbitset_vec_is_zero_(__m128i v)
+{
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF;
+}
+#endif
+
+/**
+ * Returns the index of the first element in [pos, n) that differs from mask
+ * or n if there is none.
+ */
+static inline size_t rbitset_next_elem_(const unsigned *bitset, size_t pos,
+                                        size_t n, unsigned mask)
+{
+#ifdef RBITSET_SSE2
+	__m128i const vmask = _mm_set1_epi32((int)mask);
+	for (; pos + RBITSET_VEC_ELEMS <= n; pos += RBITSET_VEC_ELEMS) {
+		__m128i const v = _mm_xor_si128(rbitset_vec_load_(&bitset[pos]), vmask);
+		if (!rbitset_vec_is_zero_(v))
+			break;
+	}
+#endif
+	for (; pos < n; ++pos) {
+		if (bitset[pos] != mask)
+			break;
+	}
+	return pos;
+}
+
 /**
  * Allocate an empty raw bitset on the heap.
  *
@@ -92,15 +140,8 @@ static inline unsigned *rbitset_duplicate_obstack_alloc(struct obstack *obst,
  */
 static inline bool rbitset_is_empty(const unsigned *bitset, size_t size)
 {
-	size_t i;
 	size_t n = BITSET_SIZE_ELEMS(size);
-
-	for (i = 0; i < n; ++i) {
-		if (bitset[i] != 0) {
-			return false;
-		}
-	}
-	return true;
+	return rbitset_next_elem_(bitset, 0, n, 0) == n;
 }
 
 /**
@@ -317,15 +358,9 @@ static inline size_t rbitset_next_max(const unsigned *bitset, size_t pos,
 	} else {
 		size_t n = BITSET_SIZE_ELEMS(last);
 		/* Else search for set bits in the next units. */
-		for (elem_pos++; elem_pos < n; elem_pos++) {
-			elem = bitset[elem_pos] ^ mask;
-
-			p = ntz(elem);
-			if (p < BITS_PER_ELEM) {
-				res = elem_pos * BITS_PER_ELEM + p;
-				break;
-			}
-		}
+		elem_pos = rbitset_next_elem_(bitset, elem_pos + 1, n, mask);
+		if (elem_pos < n)
+			res = elem_pos * BITS_PER_ELEM + ntz(bitset[elem_pos] ^ mask);
 	}
 	if (res >= last)
 		res = (size_t)-1;
@@ -342,9 +377,16 @@ static inline size_t rbitset_next_max(const unsigned *bitset, size_t pos,
  */
 static inline void rbitset_and(unsigned *dst, const unsigned *src, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const d = rbitset_vec_load_(&dst[i]);
+		__m128i const s = rbitset_vec_load_(&src[i]);
+		rbitset_vec_store_(&dst[i], _mm_and_si128(d, s));
+	}
+#endif
+	for (; i < n; ++i) {
 		dst[i] &= src[i];
 	}
 }
@@ -358,9 +400,16 @@ static inline void rbitset_and(unsigned *dst, const unsigned *src, size_t size)
  */
 static inline void rbitset_or(unsigned *dst, const unsigned *src, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const d = rbitset_vec_load_(&dst[i]);
+		__m128i const s = rbitset_vec_load_(&src[i]);
+		rbitset_vec_store_(&dst[i], _mm_or_si128(d, s));
+	}
+#endif
+	for (; i < n; ++i) {
 		dst[i] |= src[i];
 	}
 }
@@ -374,9 +423,16 @@ static inline void rbitset_or(unsigned *dst, const unsigned *src, size_t size)
  */
 static inline void rbitset_andnot(unsigned *dst, const unsigned *src, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const d = rbitset_vec_load_(&dst[i]);
+		__m128i const s = rbitset_vec_load_(&src[i]);
+		rbitset_vec_store_(&dst[i], _mm_andnot_si128(s, d));
+	}
+#endif
+	for (; i < n; ++i) {
 		dst[i] &= ~src[i];
 	}
 }
@@ -390,9 +446,16 @@ static inline void rbitset_andnot(unsigned *dst, const unsigned *src, size_t siz
  */
 static inline void rbitset_xor(unsigned *dst, const unsigned *src, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const d = rbitset_vec_load_(&dst[i]);
+		__m128i const s = rbitset_vec_load_(&src[i]);
+		rbitset_vec_store_(&dst[i], _mm_xor_si128(d, s));
+	}
+#endif
+	for (; i < n; ++i) {
 		dst[i] ^= src[i];
 	}
 }
@@ -421,35 +484,38 @@ static inline void rbitset_set_range(unsigned *bitset, size_t from,
 
 	size_t from_bit         = from % BITS_PER_ELEM;
 	size_t from_pos         = from / BITS_PER_ELEM;
-	unsigned from_unit_mask = ~((1 << from_bit) - 1);
+	unsigned from_unit_mask = ~((1u << from_bit) - 1);
 
 	size_t to_bit         = to % BITS_PER_ELEM;
 	size_t to_pos         = to / BITS_PER_ELEM;
-	unsigned to_unit_mask = (1 << to_bit) - 1;
+	unsigned to_unit_mask = (1u << to_bit) - 1;
 
 	assert(from < to);
 
 	/* do we want to set the bits in the range? */
 	if (val) {
 		if (from_pos == to_pos) {
-			BITSET_ELEM(bitset, from_pos) |= from_unit_mask & to_unit_mask;
+			bitset[from_pos] |= from_unit_mask & to_unit_mask;
 		} else {
 			size_t i;
-			BITSET_ELEM(bitset, from_pos) |= from_unit_mask;
-			BITSET_ELEM(bitset, to_pos)   |= to_unit_mask;
+			bitset[from_pos] |= from_unit_mask;
+			/* to may be the size of the bitset */
+			if (to_bit != 0)
+				bitset[to_pos] |= to_unit_mask;
 			for (i = from_pos + 1; i < to_pos; ++i)
-				BITSET_ELEM(bitset, i) = ~0u;
+				bitset[i] = ~0u;
 		}
 	} else {
 		/* ... or clear them? */
 		if (from_pos == to_pos) {
-			BITSET_ELEM(bitset, from_pos) &= ~(from_unit_mask & to_unit_mask);
+			bitset[from_pos] &= ~(from_unit_mask & to_unit_mask);
 		} else {
 			size_t i;
-			BITSET_ELEM(bitset, from_pos) &= ~from_unit_mask;
-			BITSET_ELEM(bitset, to_pos)   &= ~to_unit_mask;
+			bitset[from_pos] &= ~from_unit_mask;
+			if (to_bit != 0)
+				bitset[to_pos] &= ~to_unit_mask;
 			for (i = from_pos + 1; i < to_pos; ++i)
-				BITSET_ELEM(bitset, i) = 0;
+				bitset[i] = 0;
 		}
 	}
 }
@@ -478,9 +544,17 @@ static inline bool rbitsets_equal(const unsigned *bitset1,
 static inline bool rbitsets_have_common(const unsigned *bitset1,
                                         const unsigned *bitset2, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const a = rbitset_vec_load_(&bitset1[i]);
+		__m128i const b = rbitset_vec_load_(&bitset2[i]);
+		if (!rbitset_vec_is_zero_(_mm_and_si128(a, b)))
+			return true;
+	}
+#endif
+	for (; i < n; ++i) {
 		if ((bitset1[i] & bitset2[i]) != 0)
 			return true;
 	}
@@ -497,9 +571,17 @@ static inline bool rbitsets_have_common(const unsigned *bitset1,
 static inline bool rbitset_contains(const unsigned *bitset1,
                                     const unsigned *bitset2, size_t size)
 {
-	size_t i, n = BITSET_SIZE_ELEMS(size);
+	size_t i = 0, n = BITSET_SIZE_ELEMS(size);
 
-	for (i = 0; i < n; ++i) {
+#ifdef RBITSET_SSE2
+	for (; i + RBITSET_VEC_ELEMS <= n; i += RBITSET_VEC_ELEMS) {
+		__m128i const a = rbitset_vec_load_(&bitset1[i]);
+		__m128i const b = rbitset_vec_load_(&bitset2[i]);
+		if (!rbitset_vec_is_zero_(_mm_andnot_si128(b, a)))
+			return false;
+	}
+#endif
+	for (; i < n; ++i) {
 		if ((bitset1[i] & bitset2[i]) != bitset1[i])
 			return false;
 	}
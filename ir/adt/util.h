@@ -35,6 +35,20 @@
  */
 #define QSORT_CMP(c, d) (((c) > (d)) - ((c) < (d)))
 
+/**
+ * Storage class specifier for variables of which every thread has its own
+ * instance, used for scratch state that must not be shared between threads.
+ */
+#if defined(__GNUC__)
+#define FIRM_THREAD_LOCAL __thread
+#elif defined(_MSC_VER)
+#define FIRM_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define FIRM_THREAD_LOCAL _Thread_local
+#else
+#define FIRM_THREAD_LOCAL
+#endif
+
 /**
  * convert an integer into pointer
  */
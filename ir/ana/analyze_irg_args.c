@@ -16,6 +16,7 @@
 #include "array_t.h"
 #include "irprog.h"
 #include "entity_t.h"
+#include "irgraph_t.h"
 
 #include "analyze_irg_args.h"
 
@@ -115,6 +116,11 @@ static ptr_access_kind analyze_arg(ir_node *arg, ptr_access_kind bits)
 			/* search stops here anyway */
 			continue;
 
+		case iro_Return:
+			/* the reference leaves the method like a stored one */
+			bits |= ptr_access_store;
+			continue;
+
 		case iro_Conv:
 			/* our address is casted into something unknown. Break our search. */
 			bits = ptr_access_all;
@@ -191,6 +197,8 @@ static void analyze_ent_args(ir_entity *ent)
 
 	/* search for arguments with mode reference
 	   to analyze them.*/
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_VISITED);
+	inc_irg_visited(irg);
 	for (int i = get_irn_n_outs(irg_args); i-- > 0; ) {
 		ir_node *arg      = get_irn_out(irg_args, i);
 		ir_mode *arg_mode = get_irn_mode(arg);
@@ -199,12 +207,24 @@ static void analyze_ent_args(ir_entity *ent)
 		if (mode_is_reference(arg_mode))
 			rw_info[proj_nr] |= analyze_arg(arg, rw_info[proj_nr]);
 	}
+	ir_free_resources(irg, IR_RESOURCE_IRN_VISITED);
 
 	/* copy the temporary info */
 	memcpy(ent->attr.mtd_attr.param_access, rw_info,
 	       nparams * sizeof(ent->attr.mtd_attr.param_access[0]));
 }
 
+/**
+ * Drops the summary of a method entity if its graph changed since the
+ * summary was computed.
+ */
+static void assure_entity_summary(ir_entity *ent)
+{
+	ir_graph *irg = get_entity_irg(ent);
+	if (irg != NULL)
+		assure_irg_entity_summary(irg);
+}
+
 void analyze_irg_args(ir_graph *irg)
 {
 	if (irg == get_const_code_irg())
@@ -214,6 +234,7 @@ void analyze_irg_args(ir_graph *irg)
 	if (! entity)
 		return;
 
+	assure_irg_entity_summary(irg);
 	if (! entity->attr.mtd_attr.param_access)
 		analyze_ent_args(entity);
 }
@@ -226,6 +247,7 @@ ptr_access_kind get_method_param_access(ir_entity *ent, size_t pos)
 	assert(is_variadic || pos < get_method_n_params(mtp));
 #endif
 
+	assure_entity_summary(ent);
 	if (ent->attr.mtd_attr.param_access) {
 		if (pos < ARR_LEN(ent->attr.mtd_attr.param_access))
 			return ent->attr.mtd_attr.param_access[pos];
@@ -393,6 +415,7 @@ static void analyze_method_params_weight(ir_entity *ent)
 
 unsigned get_method_param_weight(ir_entity *ent, size_t pos)
 {
+	assure_entity_summary(ent);
 	if (ent->attr.mtd_attr.param_weight) {
 		if (pos < ARR_LEN(ent->attr.mtd_attr.param_weight))
 			return ent->attr.mtd_attr.param_weight[pos];
@@ -415,6 +438,7 @@ void analyze_irg_args_weight(ir_graph *irg)
 		return;
 
 	assert(is_method_entity(entity));
+	assure_irg_entity_summary(irg);
 	if (entity->attr.mtd_attr.param_weight != NULL)
 		return;
 
@@ -423,3 +447,24 @@ void analyze_irg_args_weight(ir_graph *irg)
 	analyze_method_params_weight(entity);
 	ir_free_resources(irg, IR_RESOURCE_IRN_VISITED);
 }
+
+void assure_irg_entity_summary(ir_graph *irg)
+{
+	if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY))
+		return;
+
+	ir_entity *entity = get_irg_entity(irg);
+	if (entity != NULL) {
+		method_ent_attr *const attr = &entity->attr.mtd_attr;
+		if (attr->param_access != NULL) {
+			DEL_ARR_F(attr->param_access);
+			attr->param_access = NULL;
+		}
+		if (attr->param_weight != NULL) {
+			DEL_ARR_F(attr->param_weight);
+			attr->param_weight = NULL;
+		}
+		attr->summary = method_summary_none;
+	}
+	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY);
+}
@@ -27,6 +27,7 @@
 #include "error.h"
 
 #include "irgwalk.h"
+#include "loopscc_t.h"
 
 static ir_visited_t master_cg_visited = 0;
 
@@ -331,447 +332,43 @@ void callgraph_walk(callgraph_walk_func *pre, callgraph_walk_func *post, void *e
 	}
 }
 
-static ir_graph *outermost_ir_graph;   /**< The outermost graph the scc is computed
-                                            for */
-static ir_loop *current_loop;      /**< Current cfloop construction is working
-                                        on. */
-static size_t loop_node_cnt = 0;   /**< Counts the number of allocated cfloop nodes.
-                                        Each cfloop node gets a unique number.
-                                        What for? ev. remove. @@@ */
-static size_t current_dfn = 1;     /**< Counter to generate depth first numbering
-                                        of visited nodes.  */
-
-typedef struct scc_info {
-	size_t dfn;            /**< Depth first search number. */
-	size_t uplink;         /**< dfn number of ancestor. */
-	ir_visited_t visited;  /**< visited counter */
-	int in_stack;          /**< Marks whether node is on the stack. */
-} scc_info;
-
-/**
- * allocates a new scc_info on the obstack
- */
-static inline scc_info *new_scc_info(struct obstack *obst)
-{
-	return OALLOCZ(obst, scc_info);
-}
-
-/**
- * Set a graphs visited flag to i.
- */
-static inline void set_cg_irg_visited(ir_graph *irg, ir_visited_t i)
-{
-	irg->self_visited = i;
-}
-
-/**
- * Returns the visited flag of a graph.
- */
-static inline ir_visited_t get_cg_irg_visited(const ir_graph *irg)
-{
-	return irg->self_visited;
-}
-
-static inline void mark_irg_in_stack(ir_graph *irg)
-{
-	scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	info->in_stack = 1;
-}
-
-static inline void mark_irg_not_in_stack(ir_graph *irg)
-{
-	scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	info->in_stack = 0;
-}
-
-static inline int irg_is_in_stack(const ir_graph *irg)
-{
-	scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	return info->in_stack;
-}
-
-static inline void set_irg_uplink(ir_graph *irg, size_t uplink)
-{
-	scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	info->uplink = uplink;
-}
-
-static inline size_t get_irg_uplink(const ir_graph *irg)
-{
-	const scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	return info->uplink;
-}
-
-static inline void set_irg_dfn(ir_graph *irg, size_t dfn)
-{
-	scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	info->dfn = dfn;
-}
-
-static inline size_t get_irg_dfn(const ir_graph *irg)
-{
-	const scc_info *info = (scc_info*) get_irg_link(irg);
-	assert(info != NULL);
-	return info->dfn;
-}
-
-static ir_graph **stack = NULL;
-static size_t tos = 0;                /**< top of stack */
-
-/**
- * Initialize the irg stack.
- */
-static inline void init_stack(void)
-{
-	if (stack) {
-		ARR_RESIZE(ir_graph *, stack, 1000);
-	} else {
-		stack = NEW_ARR_F(ir_graph *, 1000);
-	}
-	tos = 0;
-}
-
-/**
- * push a graph on the irg stack
- * @param n the graph to be pushed
- */
-static inline void push(ir_graph *irg)
+/** Adds a graph to a loop of the callgraph. */
+static void add_irg_to_loop(ir_loop *loop, void *node)
 {
-	if (tos == ARR_LEN(stack)) {
-		size_t nlen = ARR_LEN(stack) * 2;
-		ARR_RESIZE(ir_graph*, stack, nlen);
-	}
-	stack[tos++] = irg;
-	mark_irg_in_stack(irg);
+	ir_graph *irg = (ir_graph*)node;
+	add_loop_irg(loop, irg);
+	irg->l = loop;
 }
 
-/**
- * return the topmost graph on the stack and pop it
- */
-static inline ir_graph *pop(void)
+/** Marks a callee of a graph as backedge. */
+static void set_callee_backedge(void *node, int pos)
 {
-	assert(tos > 0);
-	ir_graph *irg = stack[--tos];
-	mark_irg_not_in_stack(irg);
-	return irg;
+	set_irg_callee_backedge((ir_graph*)node, (size_t)pos);
 }
 
-/**
- * The nodes up to irg belong to the current loop.
- * Removes them from the stack and adds them to the current loop.
- */
-static inline void pop_scc_to_loop(ir_graph *irg)
-{
-	ir_graph *m;
-	do {
-		m = pop();
-		++loop_node_cnt;
-		set_irg_dfn(m, loop_node_cnt);
-		add_loop_irg(current_loop, m);
-		m->l = current_loop;
-		//m->callgraph_loop_depth = current_loop->depth;
-	} while (m != irg);
-}
-
-/* GL ??? my last son is my grandson???  Removes cfloops with no
-   ir_nodes in them.  Such loops have only another loop as son. (Why
-   can't they have two loops as sons? Does it never get that far? ) */
-static void close_loop(ir_loop *l)
-{
-	size_t       last     = get_loop_n_elements(l) - 1;
-	loop_element lelement = get_loop_element(l, last);
-	ir_loop     *last_son = lelement.son;
-
-	if (get_kind(last_son) == k_ir_loop && get_loop_n_elements(last_son) == 1) {
-
-		lelement = get_loop_element(last_son, 0);
-		ir_loop *gson = lelement.son;
-		if (get_kind(gson) == k_ir_loop) {
-			loop_element new_last_son;
-
-			gson->outer_loop = l;
-			new_last_son.son = gson;
-			l->children[last] = new_last_son;
-		}
-	}
-	current_loop = l;
-}
+static const loop_scc_callbacks_t cgscc_callbacks = {
+	add_irg_to_loop,
+	set_callee_backedge,
+	NULL,
+};
 
 /**
- * Removes and unmarks all nodes up to n from the stack.
- * The nodes must be visited once more to assign them to a scc.
+ * Enters all graphs with their callees into the loop construction.
  */
-static inline void pop_scc_unmark_visit(ir_graph *n)
+static void init_scc(loop_scc_t *scc)
 {
-	ir_graph *m = NULL;
-	while (m != n) {
-		m = pop();
-		set_cg_irg_visited(m, 0);
-	}
-}
-
-/**
- * Allocates a new loop as son of current_loop.  Sets current_loop
- * to the new loop and returns the father.
- */
-static ir_loop *new_loop(void)
-{
-	ir_loop *father = current_loop;
-	ir_loop *son    = alloc_loop(father, get_irg_obstack(outermost_ir_graph));
-
-	current_loop = son;
-	return father;
-}
-
-
-static void init_scc(struct obstack *obst)
-{
-	current_dfn   = 1;
-	loop_node_cnt = 0;
-	init_stack();
-
 	for (size_t i = 0, n_irgs = get_irp_n_irgs(); i < n_irgs; ++i) {
 		ir_graph *irg = get_irp_irg(i);
-		set_irg_link(irg, new_scc_info(obst));
 		irg->callgraph_recursion_depth = 0;
 		irg->callgraph_loop_depth      = 0;
-	}
-}
-
-/** Returns non-zero if n is a loop header, i.e., it is a Block node
- *  and has predecessors within the cfloop and out of the cfloop.
- *
- *  @param root: only needed for assertion.
- */
-static int is_head(const ir_graph *n, const ir_graph *root)
-{
-	bool some_outof_loop = false;
-	bool some_in_loop    = false;
-
-	for (size_t i = 0, n_callees = get_irg_n_callees(n); i < n_callees; ++i) {
-		const ir_graph *pred = get_irg_callee(n, i);
-		if (is_irg_callee_backedge(n, i)) continue;
-		if (!irg_is_in_stack(pred)) {
-			some_outof_loop = true;
-		} else {
-			if (get_irg_uplink(pred) < get_irg_uplink(root))  {
-				assert(get_irg_uplink(pred) >= get_irg_uplink(root));
-			}
-			some_in_loop = true;
-		}
-	}
-
-	return some_outof_loop && some_in_loop;
-}
-
-/**
- * Returns non-zero if n is possible loop head of an endless loop.
- * I.e., it is a Block or Phi node and has only predecessors
- * within the loop.
- * @arg root: only needed for assertion.
- */
-static int is_endless_head(const ir_graph *n, const ir_graph *root)
-{
-	bool some_outof_loop = false;
-	bool some_in_loop    = false;
-
-	for (size_t i = 0, n_calless = get_irg_n_callees(n); i < n_calless; ++i) {
-		const ir_graph *pred = get_irg_callee(n, i);
-		assert(pred != NULL);
-		if (is_irg_callee_backedge(n, i))
-			continue;
-		if (!irg_is_in_stack(pred)) {
-			some_outof_loop = true;
-		} else {
-			if (get_irg_uplink(pred) < get_irg_uplink(root)) {
-				assert(get_irg_uplink(pred) >= get_irg_uplink(root));
-			}
-			some_in_loop = true;
-		}
-	}
-	return !some_outof_loop && some_in_loop;
-}
-
-/**
- * Finds index of the predecessor with the smallest dfn number
- * greater-equal than limit.
- */
-static bool smallest_dfn_pred(const ir_graph *n, size_t limit, size_t *result)
-{
-	size_t index = 0;
-	size_t min   = 0;
-	bool   found = false;
-	for (size_t i = 0, n_callees = get_irg_n_callees(n); i < n_callees; ++i) {
-		const ir_graph *pred = get_irg_callee(n, i);
-		if (is_irg_callee_backedge(n, i) || !irg_is_in_stack(pred))
-			continue;
-		if (get_irg_dfn(pred) >= limit && (!found || get_irg_dfn(pred) < min)) {
-			index = i;
-			min   = get_irg_dfn(pred);
-			found = true;
-		}
-	}
-
-	*result = index;
-	return found;
-}
 
-/** Finds index of the predecessor with the largest dfn number. */
-static bool largest_dfn_pred(const ir_graph *n, size_t *result)
-{
-	size_t index = 0;
-	size_t max   = 0;
-	bool   found = false;
-
-	for (size_t i = 0, n_callees = get_irg_n_callees(n); i < n_callees; ++i) {
-		const ir_graph *pred = get_irg_callee(n, i);
-		if (is_irg_callee_backedge (n, i) || !irg_is_in_stack(pred))
-			continue;
-		/* Note: dfn is always > 0 */
-		if (get_irg_dfn(pred) > max) {
-			index = i;
-			max   = get_irg_dfn(pred);
-			found = true;
-		}
-	}
-
-	*result = index;
-	return found;
-}
-
-static ir_graph *find_tail(const ir_graph *n)
-{
-	/*
-	if (!icfg && rm_cyclic_phis && remove_cyclic_phis (n)) return NULL;
-	*/
-	bool      found     = false;
-	size_t    res_index = 0;
-	ir_graph *m         = stack[tos - 1];  /* tos = top of stack */
-	if (is_head(m, n)) {
-		found = smallest_dfn_pred(m, 0, &res_index);
-		if (!found &&  /* no smallest dfn pred found. */
-			n == m)
-			return NULL;
-	} else {
-		if (m == n)
-			return NULL;    // Is this to catch Phi - self loops?
-		for (size_t i = tos - 1; i > 0;) {
-			m = stack[--i];
-
-			if (is_head(m, n)) {
-				found = smallest_dfn_pred(m, get_irg_dfn(m) + 1, &res_index);
-				if (! found)  /* no smallest dfn pred found. */
-					found = largest_dfn_pred(m, &res_index);
-
-				break;
-			}
-
-			/* We should not walk past our selves on the stack:  The upcoming nodes
-			   are not in this loop. We assume a loop not reachable from Start. */
-			if (m == n) {
-				found = false;
-				break;
-			}
-
-		}
-
-		if (! found) {
-			/* A dead loop not reachable from Start. */
-			for (size_t i = tos-1; i > 0;) {
-				m = stack[--i];
-				if (is_endless_head(m, n)) {
-					found = smallest_dfn_pred(m, get_irg_dfn(m) + 1, &res_index);
-					if (!found)  /* no smallest dfn pred found. */
-						found = largest_dfn_pred(m, &res_index);
-					break;
-				}
-				/* It's not an unreachable loop, either. */
-				if (m == n)
-					break;
-			}
-		}
-
-	}
-	assert(found);
-
-	set_irg_callee_backedge(m, res_index);
-	return get_irg_callee(m, res_index);
-}
-
-static void cgscc(ir_graph *n)
-{
-	if (cg_irg_visited(n))
-		return;
-	mark_cg_irg_visited(n);
-
-	/* Initialize the node */
-	set_irg_dfn(n, current_dfn);      /* Depth first number for this node */
-	set_irg_uplink(n, current_dfn);   /* ... is default uplink. */
-	++current_dfn;
-	push(n);
-
-	for (size_t i = 0, n_callees = get_irg_n_callees(n); i < n_callees; ++i) {
-		if (is_irg_callee_backedge(n, i))
-			continue;
-		ir_graph *m = get_irg_callee(n, i);
-
-		/** This marks the backedge, but does it guarantee a correct loop tree? */
-		//if (m == n) { set_irg_callee_backedge(n, i); continue; }
-
-		cgscc(m);
-		if (irg_is_in_stack(m)) {
-			/* Uplink of m is smaller if n->m is a backedge.
-			   Propagate the uplink to mark the cfloop. */
-			if (get_irg_uplink(m) < get_irg_uplink(n))
-				set_irg_uplink(n, get_irg_uplink(m));
-		}
-	}
-
-	if (get_irg_dfn(n) == get_irg_uplink(n)) {
-		/* This condition holds for
-		   1) the node with the incoming backedge.
-		   That is: We found a cfloop!
-		   2) Straight line code, because no uplink has been propagated, so the
-		   uplink still is the same as the dfn.
-
-		   But n might not be a proper cfloop head for the analysis. Proper cfloop
-		   heads are Block and Phi nodes. find_tail searches the stack for
-		   Block's and Phi's and takes those nodes as cfloop heads for the current
-		   cfloop instead and marks the incoming edge as backedge. */
-
-		ir_graph *tail = find_tail(n);
-		if (tail) {
-			/* We have a cfloop, that is no straight line code,
-			   because we found a cfloop head!
-			   Next actions: Open a new cfloop on the cfloop tree and
-			   try to find inner cfloops */
-			ir_loop *l = new_loop();
-
-			/* Remove the cfloop from the stack ... */
-			pop_scc_unmark_visit(n);
-
-			/* The current backedge has been marked, that is temporarily eliminated,
-			   by find tail. Start the scc algorithm
-			   anew on the subgraph thats left (the current cfloop without the backedge)
-			   in order to find more inner cfloops. */
-
-			cgscc(tail);
-
-			assert(cg_irg_visited(n));
-			close_loop(l);
-		} else {
-			pop_scc_to_loop(n);
+		loop_scc_add_node(scc, get_irg_idx(irg), irg, 0, true);
+		for (size_t j = 0, n_callees = get_irg_n_callees(irg); j < n_callees; ++j) {
+			loop_scc_add_edge(scc, get_irg_idx(get_irg_callee(irg, j)));
 		}
 	}
 }
 
-
 /**
  * reset the backedge information for all callers in all irgs
  */
@@ -801,31 +398,26 @@ void find_callgraph_recursions(void)
 	unvisited ones. The third step is needed for functions that are not
 	reachable from the outermost graph, but call themselves in a cycle. */
 	assert(get_irp_main_irg());
-	outermost_ir_graph = get_irp_main_irg();
-	struct obstack temp;
-	obstack_init(&temp);
-	init_scc(&temp);
-
-	current_loop = NULL;
-	new_loop();  /* sets current_loop */
+	ir_graph  *outermost_ir_graph = get_irp_main_irg();
+	loop_scc_t scc;
+	loop_scc_init(&scc, &cgscc_callbacks, get_irp_last_idx(),
+	              get_irg_obstack(outermost_ir_graph), false);
+	init_scc(&scc);
 
-	++master_cg_visited;
-	cgscc(outermost_ir_graph);
+	loop_scc_walk(&scc, get_irg_idx(outermost_ir_graph));
 	size_t n_irgs = get_irp_n_irgs();
 	for (size_t i = 0; i < n_irgs; ++i) {
 		ir_graph *irg = get_irp_irg(i);
-		if (!cg_irg_visited(irg) && get_irg_n_callers(irg) == 0)
-			cgscc(irg);
+		if (get_irg_n_callers(irg) == 0)
+			loop_scc_walk(&scc, get_irg_idx(irg));
 	}
 	for (size_t i = 0; i < n_irgs; ++i) {
-		ir_graph *irg = get_irp_irg(i);
-		if (!cg_irg_visited(irg))
-			cgscc(irg);
+		loop_scc_walk(&scc, get_irg_idx(get_irp_irg(i)));
 	}
-	obstack_free(&temp, NULL);
 
-	irp->outermost_cg_loop = current_loop;
-	mature_loops(current_loop, get_irg_obstack(outermost_ir_graph));
+	ir_loop *loop = loop_scc_finish(&scc);
+	irp->outermost_cg_loop = loop;
+	mature_loops(loop, get_irg_obstack(outermost_ir_graph));
 
 	/* -- Reverse the backedge information. -- */
 	for (size_t i = 0; i < n_irgs; ++i) {
@@ -17,6 +17,9 @@
  *  the program directly, or they are visible external.
  */
 #include "cgana.h"
+
+#include <stdbool.h>
+
 #include "xmalloc.h"
 #include "irnode_t.h"
 #include "irmode_t.h"
@@ -26,6 +29,7 @@
 #include "irgmod.h"
 #include "iropt.h"
 #include "irtools.h"
+#include "typerep.h"
 
 #include "irflag_t.h"
 #include "dbginfo_t.h"
@@ -42,6 +46,10 @@ static void *MARK = &MARK;
 
 static pset *entities = NULL;
 
+/** Set if the transitive closure of the inheritance relations was computed
+ *  for this analysis only. */
+static bool own_closure;
+
 /*--------------------------------------------------------------------------*/
 /* The analysis                                                             */
 /*--------------------------------------------------------------------------*/
@@ -52,33 +60,6 @@ static pset *entities = NULL;
 /* call target computations.                                                */
 /*--------------------------------------------------------------------------*/
 
-/** Collect the entity representing the implementation of this
- *  method (not the same if inherited) and all entities for overwriting
- *  implementations in parameter set.
- *  A recursive descend in the overwritten relation.
- *  Cycle-free, therefore must terminate.
- *
- * @param method   the overwritten method
- * @param set      A set of entities.
- *
- * @return Number of entities in set.
- */
-static size_t collect_impls(ir_entity *method, pset *set)
-{
-	size_t size = 0;
-	if (get_entity_irg(method) != NULL) {
-		/* has an implementation */
-		pset_insert_ptr(set, method);
-		++size;
-	}
-
-	/*- recursive descent -*/
-	for (size_t i = get_entity_n_overwrittenby(method); i-- > 0;) {
-		size += collect_impls(get_entity_overwrittenby(method, i), set);
-	}
-	return size;
-}
-
 /**
  * Determine all methods that overwrite the given method (and implement it).
  * The returned array must be freed by the caller (see DEL_ARR_F).
@@ -89,16 +70,18 @@ static size_t collect_impls(ir_entity *method, pset *set)
 static ir_entity **get_impl_methods(ir_entity *method)
 {
 	/* Collect all method entities that can be called here */
-	ir_entity  **arr = NULL;
-	pset       *set  = pset_new_ptr_default();
-	size_t      size = collect_impls(method, set);
-	if (size > 0) {
-		arr = NEW_ARR_F(ir_entity *, size);
-		foreach_pset(set, ir_entity, ent) {
-			arr[--size] = ent;
-		}
+	ir_entity **arr = NEW_ARR_F(ir_entity*, 0);
+	if (get_entity_irg(method) != NULL)
+		ARR_APP1(ir_entity*, arr, method);
+	for (ir_entity *ent = get_entity_trans_overwrittenby_first(method);
+	     ent != NULL; ent = get_entity_trans_overwrittenby_next(method)) {
+		if (get_entity_irg(ent) != NULL)
+			ARR_APP1(ir_entity*, arr, ent);
+	}
+	if (ARR_LEN(arr) == 0) {
+		DEL_ARR_F(arr);
+		return NULL;
 	}
-	del_pset(set);
 	return arr;
 }
 
@@ -150,6 +133,8 @@ static void sel_methods_walker(ir_node *node, void *env)
  *
  * Computes a set of entities that overwrite an entity and contain
  * an implementation. The set is stored in the entity's link field.
+ * The transitive closure of the inheritance relations is computed if it is
+ * not valid.
  *
  * Further replaces Sel nodes where this set contains exactly one
  * method by SymConst nodes.
@@ -160,6 +145,10 @@ static void sel_methods_init(void)
 {
 	assert(entities == NULL);
 	entities = pset_new_ptr_default();
+	own_closure = get_irp_inh_transitive_closure_state()
+	              != inh_transitive_closure_valid;
+	if (own_closure)
+		compute_inh_transitive_closure();
 	all_irg_walk(sel_methods_walker, NULL, NULL);
 }
 
@@ -371,6 +360,7 @@ static void add_method_address_inititializer(ir_initializer_t *initializer,
 	}
 	case IR_INITIALIZER_TARVAL:
 	case IR_INITIALIZER_NULL:
+	case IR_INITIALIZER_BYTES:
 		return;
 	case IR_INITIALIZER_COMPOUND:
 		for (size_t i = 0; i < initializer->compound.n_initializers; ++i) {
@@ -639,6 +629,8 @@ static void sel_methods_dispose(void)
 	}
 	del_pset(entities);
 	entities = NULL;
+	if (own_closure)
+		free_inh_transitive_closure();
 }
 
 static void destruct_walker(ir_node *node, void *env)
@@ -23,7 +23,7 @@
 #include "irgwalk.h"
 #include "irnode_t.h"
 #include "iroptimize.h"
-#include "tv.h"
+#include "tv_t.h"
 #include "irmemory.h"
 #include "constbits.h"
 
@@ -116,7 +116,21 @@ inline bitinfo* get_bitinfo(ir_node const* const irn)
 	return (bitinfo*)get_irn_link(irn);
 }
 
-int set_bitinfo(ir_node* const irn, ir_tarval* const z, ir_tarval* const o)
+/* Returns whether the information of mode m is kept as native integers. */
+static bool is_native_mode(ir_mode const* const m)
+{
+	return mode_is_int(m) && get_mode_size_bits(m) <= 64;
+}
+
+static uint64_t get_native_mask(ir_mode const* const m)
+{
+	unsigned const bits = get_mode_size_bits(m);
+	return bits == 64 ? UINT64_MAX : ((uint64_t)1 << bits) - 1;
+}
+
+static int update_bitinfo(ir_node* const irn, ir_tarval* const z,
+                          ir_tarval* const o, uint64_t const z64,
+                          uint64_t const o64)
 {
 	bitinfo* b = get_bitinfo(irn);
 	if (b == NULL) {
@@ -129,18 +143,185 @@ int set_bitinfo(ir_node* const irn, ir_tarval* const z, ir_tarval* const o)
 		assert(tarval_is_null(tarval_andnot(b->z, z)));
 		assert(tarval_is_null(tarval_andnot(o, b->o)));
 	}
-	b->z = z;
-	b->o = o;
+	b->z   = z;
+	b->o   = o;
+	b->z64 = z64;
+	b->o64 = o64;
 	DB((dbg, LEVEL_3, "%+F: 0:%T 1:%T\n", irn, z, o));
 	return 1;
 }
 
+int set_bitinfo(ir_node* const irn, ir_tarval* const z, ir_tarval* const o)
+{
+	ir_mode* const m = get_tarval_mode(z);
+	if (!is_native_mode(m))
+		return update_bitinfo(irn, z, o, 0, 0);
+
+	uint64_t const mask = get_native_mask(m);
+	return update_bitinfo(irn, z, o, get_tarval_uint64(z) & mask,
+	                      get_tarval_uint64(o) & mask);
+}
+
+/* Like set_bitinfo(), but the tarvals are only created if the information
+ * changed. */
+static int set_bitinfo_native(ir_node* const irn, ir_mode* const m,
+                              uint64_t const z, uint64_t const o)
+{
+	bitinfo const* const b = get_bitinfo(irn);
+	if (b != NULL && b->z64 == z && b->o64 == o)
+		return 0;
+	return update_bitinfo(irn, new_tarval_from_uint64(z, m),
+	                      new_tarval_from_uint64(o, m), z, o);
+}
+
+static bool is_undefined_native(bitinfo const* const b, uint64_t const mask)
+{
+	return b->z64 == 0 && b->o64 == mask;
+}
+
+/* Compares two native values like tarval_cmp() in mode m. */
+static bool is_less_native(uint64_t const a, uint64_t const b,
+                           ir_mode const* const m)
+{
+	if (!mode_is_signed(m))
+		return a < b;
+	unsigned const shift = 64 - get_mode_size_bits(m);
+	return (int64_t)(a << shift) < (int64_t)(b << shift);
+}
+
+/* Transfer function for integer modes of at most 64 bits, which computes with
+ * native integers instead of tarvals. The inputs must not be undefined.
+ * Returns -1 if the node is not handled. */
+static int transfer_native(ir_node* const irn, ir_mode* const m)
+{
+	uint64_t const mask = get_native_mask(m);
+	uint64_t       z;
+	uint64_t       o;
+
+	switch (get_irn_opcode(irn)) {
+		case iro_Const:
+			z = o = get_tarval_uint64(get_Const_tarval(irn)) & mask;
+			break;
+
+		case iro_Add: {
+			bitinfo const* const l = get_bitinfo(get_Add_left(irn));
+			bitinfo const* const r = get_bitinfo(get_Add_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			if (l->z64 == l->o64 && r->z64 == r->o64) {
+				z = o = (l->z64 + r->z64) & mask;
+			} else {
+				/* see the tarval version below */
+				uint64_t const no_c_in_no_c_out = l->z64 & r->z64;
+				uint64_t const low_zero_mask    = (no_c_in_no_c_out | -no_c_in_no_c_out) & mask;
+				z = l->z64 | r->z64 | low_zero_mask;
+				o = (l->o64 | r->o64) & ~low_zero_mask;
+			}
+			break;
+		}
+
+		case iro_Sub: {
+			bitinfo const* const l = get_bitinfo(get_Sub_left(irn));
+			bitinfo const* const r = get_bitinfo(get_Sub_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			if (l->z64 == l->o64 && r->z64 == r->o64) {
+				z = o = (l->z64 - r->z64) & mask;
+			} else if ((r->z64 & ~l->o64) == 0) {
+				z = l->z64 & ~r->o64;
+				o = l->o64 & ~r->z64;
+			} else {
+				z = mask;
+				o = 0;
+			}
+			break;
+		}
+
+		case iro_Mul: {
+			bitinfo const* const l = get_bitinfo(get_Mul_left(irn));
+			bitinfo const* const r = get_bitinfo(get_Mul_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			if (l->z64 == l->o64 && r->z64 == r->o64) {
+				z = o = (l->z64 * r->z64) & mask;
+			} else {
+				uint64_t const lzn = (l->z64 | -l->z64) & mask;
+				uint64_t const rzn = (r->z64 | -r->z64) & mask;
+				if (is_less_native(lzn, rzn, m)) {
+					z = ((lzn ^ (lzn << 1)) * rzn) & mask;
+				} else {
+					z = ((rzn ^ (rzn << 1)) * lzn) & mask;
+				}
+				o = 0;
+			}
+			break;
+		}
+
+		case iro_Minus: {
+			bitinfo const* const b = get_bitinfo(get_Minus_op(irn));
+			if (b == NULL)
+				return -1;
+			if (b->z64 == b->o64) {
+				z = o = -b->z64 & mask;
+			} else {
+				z = mask;
+				o = 0;
+			}
+			break;
+		}
+
+		case iro_And: {
+			bitinfo const* const l = get_bitinfo(get_And_left(irn));
+			bitinfo const* const r = get_bitinfo(get_And_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			z = l->z64 & r->z64;
+			o = l->o64 & r->o64;
+			break;
+		}
+
+		case iro_Or: {
+			bitinfo const* const l = get_bitinfo(get_Or_left(irn));
+			bitinfo const* const r = get_bitinfo(get_Or_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			z = l->z64 | r->z64;
+			o = l->o64 | r->o64;
+			break;
+		}
+
+		case iro_Eor: {
+			bitinfo const* const l = get_bitinfo(get_Eor_left(irn));
+			bitinfo const* const r = get_bitinfo(get_Eor_right(irn));
+			if (l == NULL || r == NULL)
+				return -1;
+			z = (l->z64 & ~r->o64) | (r->z64 & ~l->o64);
+			o = (r->o64 & ~l->z64) | (l->o64 & ~r->z64);
+			break;
+		}
+
+		case iro_Not: {
+			bitinfo const* const b = get_bitinfo(get_Not_op(irn));
+			if (b == NULL)
+				return -1;
+			z = ~b->o64 & mask;
+			o = ~b->z64 & mask;
+			break;
+		}
+
+		default:
+			return -1;
+	}
+
+	return set_bitinfo_native(irn, m, z, o);
+}
+
 static int mode_is_intb(ir_mode const* const m)
 {
 	return mode_is_int(m) || m == mode_b;
 }
 
-static int transfer(ir_node* const irn)
+int constbits_transfer(ir_node* const irn)
 {
 	ir_tarval* const f = get_tarval_b_false();
 	ir_tarval* const t = get_tarval_b_true();
@@ -240,6 +421,25 @@ result_unknown_X:
 undefined:
 			z = get_tarval_null(m);
 			o = get_tarval_all_one(m);
+		} else if (is_Phi(irn) && is_native_mode(m)) {
+			ir_node* const block = get_nodes_block(irn);
+			int      const arity = get_Phi_n_preds(irn);
+			uint64_t const mask  = get_native_mask(m);
+			uint64_t       z64   = 0;
+			uint64_t       o64   = mask;
+
+			for (int i = 0; i != arity; ++i) {
+				bitinfo* const b_cfg = get_bitinfo(get_Block_cfgpred(block, i));
+				if (b_cfg != NULL && b_cfg->z != f) {
+					bitinfo* const b = get_bitinfo(get_Phi_pred(irn, i));
+					/* Only use input if it's not undefined. */
+					if (!is_undefined_native(b, mask)) {
+						z64 |= b->z64;
+						o64 &= b->o64;
+					}
+				}
+			}
+			return set_bitinfo_native(irn, m, z64, o64);
 		} else if (is_Phi(irn)) {
 			ir_node* const block = get_nodes_block(irn);
 			int      const arity = get_Phi_n_preds(irn);
@@ -270,6 +470,12 @@ undefined:
 					goto undefined;
 			}
 
+			if (is_native_mode(m)) {
+				int const res = transfer_native(irn, m);
+				if (res >= 0)
+					return res;
+			}
+
 			switch (get_irn_opcode(irn)) {
 				case iro_Const: {
 					z = o = get_Const_tarval(irn);
@@ -575,7 +781,7 @@ static void first_round(ir_node* const irn, void* const env)
 {
 	pdeq* const q = (pdeq*)env;
 
-	transfer(irn);
+	constbits_transfer(irn);
 	if (is_Phi(irn) || is_Block(irn)) {
 		/* Only Phis (and their users) need another round, if we did not have
 		 * information about all their inputs in the first round, i.e. in loops. */
@@ -585,7 +791,7 @@ static void first_round(ir_node* const irn, void* const env)
 	}
 }
 
-static void queue_users(pdeq* const q, ir_node* const n)
+void constbits_queue_users(pdeq* const q, ir_node* const n)
 {
 	if (get_irn_mode(n) == mode_X) {
 		/* When the state of a control flow node changes, not only queue its
@@ -605,7 +811,7 @@ static void queue_users(pdeq* const q, ir_node* const n)
 		foreach_out_edge(n, e) {
 			ir_node* const src = get_edge_src_irn(e);
 			if (get_irn_mode(src) == mode_T) {
-				queue_users(q, src);
+				constbits_queue_users(q, src);
 			} else {
 				pdeq_putr(q, src);
 			}
@@ -628,30 +834,36 @@ static void build_phi_lists(ir_node *irn, void *env)
 		add_Block_phi(get_nodes_block(irn), irn);
 }
 
-void constbits_analyze(ir_graph* const irg, struct obstack *client_obst)
+void constbits_init(ir_graph* const irg, struct obstack *client_obst)
 {
 	obst = client_obst;
 
 	FIRM_DBG_REGISTER(dbg, "firm.ana.fp-vrp");
-	DB((dbg, LEVEL_1, "===> Performing constant propagation on %+F (analysis)\n", irg));
 
 	assert(((ir_resources_reserved(irg) & IR_RESOURCE_IRN_LINK) != 0) &&
 			"user of fp-vrp analysis must reserve links");
 	assert(((ir_resources_reserved(irg) & IR_RESOURCE_PHI_LIST) != 0) &&
 			"user of fp-vrp analysis must reserve phi list");
 
+	/* We need this extra step because the dom tree does not contain
+	 * unreachable blocks in Firm. Moreover build phi list. */
+	irg_walk_anchors(irg, clear_links, build_phi_lists, NULL);
+
 	{
-		pdeq* const q = new_pdeq();
+		ir_tarval* const f = get_tarval_b_false();
+		ir_tarval* const t = get_tarval_b_true();
+		set_bitinfo(get_irg_end_block(irg), t, f); /* Reachable. */
+	}
+}
 
-		/* We need this extra step because the dom tree does not contain
-		 * unreachable blocks in Firm. Moreover build phi list. */
-		irg_walk_anchors(irg, clear_links, build_phi_lists, NULL);
+void constbits_analyze(ir_graph* const irg, struct obstack *client_obst)
+{
+	constbits_init(irg, client_obst);
 
-		{
-			ir_tarval* const f = get_tarval_b_false();
-			ir_tarval* const t = get_tarval_b_true();
-			set_bitinfo(get_irg_end_block(irg), t, f); /* Reachable. */
-		}
+	DB((dbg, LEVEL_1, "===> Performing constant propagation on %+F (analysis)\n", irg));
+
+	{
+		pdeq* const q = new_pdeq();
 
 		/* TODO Improve iteration order. Best is reverse postorder in data flow
 		 * direction and respecting loop nesting for fastest convergence. */
@@ -659,8 +871,8 @@ void constbits_analyze(ir_graph* const irg, struct obstack *client_obst)
 
 		while (!pdeq_empty(q)) {
 			ir_node* const n = (ir_node*)pdeq_getl(q);
-			if (transfer(n))
-				queue_users(q, n);
+			if (constbits_transfer(n))
+				constbits_queue_users(q, n);
 		}
 
 		del_pdeq(q);
@@ -1,12 +1,20 @@
 #ifndef CONSTBITS_H
 #define CONSTBITS_H
 
+#include <stdint.h>
+
 #include "adt/obst.h"
+#include "adt/pdeq.h"
 
 typedef struct bitinfo
 {
 	ir_tarval* z; /* safe zeroes, 0 = bit is zero,       1 = bit maybe is 1 */
 	ir_tarval* o; /* safe ones,   0 = bit maybe is zero, 1 = bit is 1 */
+	/* z and o as native integers for integer modes of at most 64 bits, upper
+	 * bits are zero. The transfer functions compute with these and create the
+	 * tarvals only when the information changes. */
+	uint64_t   z64;
+	uint64_t   o64;
 } bitinfo;
 
 /* Get analysis information for node irn */
@@ -19,4 +27,14 @@ int set_bitinfo(ir_node* const irn, ir_tarval* const z, ir_tarval* const o);
  * The result is available via links to bitinfo*, allocated on client_obst. */
 void constbits_analyze(ir_graph* const irg, struct obstack *client_obst);
 
+/* Prepare the analysis of irg without running it, for clients which drive
+ * the fixpoint iteration themselves together with another analysis. */
+void constbits_init(ir_graph* const irg, struct obstack *client_obst);
+
+/* Update the analysis information of irn, returns non-zero if it changed. */
+int constbits_transfer(ir_node* const irn);
+
+/* Put the nodes whose information depends on n into q. */
+void constbits_queue_users(pdeq* const q, ir_node* const n);
+
 #endif
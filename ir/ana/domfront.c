@@ -11,9 +11,11 @@
  */
 #include "obst.h"
 #include "pmap.h"
-#include "irdom.h"
+#include "irdom_t.h"
 #include "array.h"
 #include "iredges_t.h"
+#include "raw_bitset.h"
+#include "xmalloc.h"
 
 /**
  * A wrapper for get_Block_idom.
@@ -106,3 +108,114 @@ ir_node **ir_get_dominance_frontier(const ir_node *block)
 	ir_dom_front_info_t *info = &irg->domfront;
 	return pmap_get(ir_node*, info->df_map, block);
 }
+
+/**
+ * Removes and returns the last block of the flexible array @p blocks.
+ */
+static ir_node *pop_block(ir_node **blocks)
+{
+	size_t   const n     = ARR_LEN(blocks);
+	ir_node *const block = blocks[n - 1];
+	ARR_SHRINKLEN(blocks, n - 1);
+	return block;
+}
+
+/**
+ * Inserts @p block into the piggy bank of the iterated dominance frontier
+ * computation, which holds the blocks still to be processed by depth.
+ */
+static void bank_insert(ir_node ***bank, unsigned *inserted, ir_node *block)
+{
+	unsigned const num = get_Block_dom_tree_pre_num(block);
+	if (rbitset_is_set(inserted, num))
+		return;
+	rbitset_set(inserted, num);
+	ir_node ***const level = &bank[get_Block_dom_depth(block)];
+	ARR_APP1(ir_node*, *level, block);
+}
+
+ir_node **ir_compute_iterated_dominance_frontier(ir_graph *irg,
+                                                 ir_node *const *blocks,
+                                                 size_t n_blocks)
+{
+	assert(irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
+	                             | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE));
+
+	ir_node **idf = NEW_ARR_F(ir_node*, 0);
+
+	int max_depth = 0;
+	for (size_t i = 0; i < n_blocks; ++i) {
+		int const depth = get_Block_dom_depth(blocks[i]);
+		if (depth > max_depth)
+			max_depth = depth;
+	}
+	if (max_depth == 0)
+		return idf;
+
+	unsigned const n       = get_Block_dom_max_subtree_pre_num(
+			get_irg_start_block(irg)) + 1;
+	unsigned      *inserted = rbitset_malloc(n);
+	unsigned      *in_idf   = rbitset_malloc(n);
+	unsigned      *visited  = rbitset_malloc(n);
+	ir_node     ***bank     = XMALLOCN(ir_node**, max_depth + 1);
+	for (int i = 0; i <= max_depth; ++i)
+		bank[i] = NEW_ARR_F(ir_node*, 0);
+	ir_node      **stack    = NEW_ARR_F(ir_node*, 0);
+
+	for (size_t i = 0; i < n_blocks; ++i) {
+		/* unreachable blocks have no dominance frontier */
+		if (get_Block_dom_depth(blocks[i]) > 0)
+			bank_insert(bank, inserted, blocks[i]);
+	}
+
+	/* Sreedhar-Gao: Take the deepest block x out of the bank and visit its
+	 * dominator subtree. Every join edge y -> z found in the subtree whose
+	 * target is not deeper than x adds z to the frontier. The subtrees of
+	 * blocks visited once need not be visited again, because their join
+	 * edges only lead to blocks already handled at a deeper level. */
+	for (int level = max_depth; level > 0; ) {
+		if (ARR_LEN(bank[level]) == 0) {
+			--level;
+			continue;
+		}
+		ir_node *const root = pop_block(bank[level]);
+		rbitset_set(visited, get_Block_dom_tree_pre_num(root));
+		ARR_APP1(ir_node*, stack, root);
+
+		while (ARR_LEN(stack) > 0) {
+			ir_node *const block = pop_block(stack);
+
+			foreach_block_succ(block, edge) {
+				ir_node *const succ = get_edge_src_irn(edge);
+				if (get_idom(succ) == block)
+					continue;
+				int const depth = get_Block_dom_depth(succ);
+				if (depth <= 0 || depth > level)
+					continue;
+				unsigned const num = get_Block_dom_tree_pre_num(succ);
+				if (rbitset_is_set(in_idf, num))
+					continue;
+				rbitset_set(in_idf, num);
+				ARR_APP1(ir_node*, idf, succ);
+				bank_insert(bank, inserted, succ);
+			}
+
+			dominates_for_each(block, child) {
+				unsigned const num = get_Block_dom_tree_pre_num(child);
+				if (rbitset_is_set(visited, num))
+					continue;
+				rbitset_set(visited, num);
+				ARR_APP1(ir_node*, stack, child);
+			}
+		}
+	}
+
+	DEL_ARR_F(stack);
+	for (int i = 0; i <= max_depth; ++i)
+		DEL_ARR_F(bank[i]);
+	free(bank);
+	free(visited);
+	free(in_idf);
+	free(inserted);
+	return idf;
+}
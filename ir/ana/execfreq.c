@@ -32,6 +32,8 @@
 
 #include "gaussseidel.h"
 
+#include "array_t.h"
+#include "obst.h"
 #include "set.h"
 #include "hashptr.h"
 #include "debug.h"
@@ -60,7 +62,14 @@
 
 #define MAX_INT_FREQ 1000000
 
-static hook_entry_t hook;
+/** strongly connected components up to this size are solved directly */
+#define SCC_DENSE_LIMIT     256
+/** maximum number of Gauss-Seidel steps for a single component */
+#define SCC_MAX_ITERATIONS  1000000
+
+static hook_entry_t          hook;
+static ir_execfreq_estimator estimator = ir_execfreq_system;
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
 double get_block_execfreq(const ir_node *block)
 {
@@ -73,6 +82,16 @@ void set_block_execfreq(ir_node *block, double newfreq)
 	block->attr.block.execfreq = newfreq;
 }
 
+void ir_set_execfreq_estimator(ir_execfreq_estimator new_estimator)
+{
+	estimator = new_estimator;
+}
+
+ir_execfreq_estimator ir_get_execfreq_estimator(void)
+{
+	return estimator;
+}
+
 static void exec_freq_node_info(void *ctx, FILE *f, const ir_node *irn)
 {
 	(void)ctx;
@@ -88,6 +107,7 @@ void init_execfreq(void)
 	memset(&hook, 0, sizeof(hook));
 	hook.hook._hook_node_info = exec_freq_node_info;
 	register_hook(hook_node_info, &hook);
+	FIRM_DBG_REGISTER(dbg, "firm.ana.execfreq");
 }
 
 void exit_execfreq(void)
@@ -103,7 +123,6 @@ static double *solve_lgs(gs_matrix_t *mat, double *x, int size)
 	for (int i = 0; i < size; ++i)
 		x[i] = init;
 
-	stat_ev_dbl("execfreq_matrix_size", size);
 	stat_ev_tim_push();
 	int    iter = 0;
 	double dev;
@@ -117,6 +136,506 @@ static double *solve_lgs(gs_matrix_t *mat, double *x, int size)
 	return x;
 }
 
+/**
+ * The system x = A*x of the execution frequencies in compressed sparse row
+ * form. Row r holds the predecessors of block r and the probabilities of
+ * the edges coming from them, the diagonal is not stored.
+ */
+typedef struct freq_system_t {
+	int     n;         /**< number of rows */
+	int    *row_begin; /**< first entry of each row, n + 1 elements */
+	int    *row_len;   /**< number of entries of each row */
+	int    *cols;      /**< column of each entry */
+	double *vals;      /**< value of each entry */
+} freq_system_t;
+
+/**
+ * Sets sys[row, col] to val. Like gs_matrix_set() a later value for the
+ * same column replaces the earlier one and the diagonal is ignored.
+ */
+static void freq_system_set(freq_system_t *sys, int row, int col, double val)
+{
+	if (row == col)
+		return;
+	int const begin = sys->row_begin[row];
+	int const end   = begin + sys->row_len[row];
+	for (int e = begin; e < end; ++e) {
+		if (sys->cols[e] == col) {
+			sys->vals[e] = val;
+			return;
+		}
+	}
+	assert(end < sys->row_begin[row + 1]);
+	sys->cols[end] = col;
+	sys->vals[end] = val;
+	++sys->row_len[row];
+}
+
+/** State of the strongly connected component search in solve_sccs(). */
+typedef struct scc_env_t {
+	const freq_system_t *sys;
+	int                  start_idx;
+	double              *x;
+	int                 *dfn;      /**< dfs number + 1, 0 if not reached */
+	int                 *low;      /**< lowest dfs number reachable */
+	bool                *on_stack;
+	int                 *stack;    /**< nodes of unfinished components */
+	int                  n_stack;
+	int                  n_dfn;
+	double              *dense;    /**< scratch matrix for solve_dense() */
+	int                 *pos;      /**< position of a row in its component */
+	int                  n_iter;   /**< Gauss-Seidel steps done */
+} scc_env_t;
+
+/**
+ * Solves (I - A_c) x_c = b for the rows of one component using gaussian
+ * elimination, b is the flow entering the component from solved rows.
+ */
+static bool solve_dense(scc_env_t *env, const int *members, int n)
+{
+	const freq_system_t *sys = env->sys;
+	double *const m      = env->dense;
+	int     const stride = n + 1;
+
+	for (int i = 0; i < n; ++i)
+		env->pos[members[i]] = i;
+	memset(m, 0, (size_t)n * stride * sizeof(*m));
+	for (int i = 0; i < n; ++i) {
+		int     const r   = members[i];
+		double *const row = &m[i * stride];
+		row[i] = 1.0;
+		for (int e = sys->row_begin[r], end = e + sys->row_len[r]; e < end; ++e) {
+			int const c = sys->cols[e];
+			if (env->pos[c] >= 0)
+				row[env->pos[c]] -= sys->vals[e];
+			else
+				row[n] += sys->vals[e] * env->x[c];
+		}
+	}
+
+	for (int k = 0; k < n; ++k) {
+		int pivot = k;
+		for (int i = k + 1; i < n; ++i) {
+			if (fabs(m[i * stride + k]) > fabs(m[pivot * stride + k]))
+				pivot = i;
+		}
+		if (UNDEF(m[pivot * stride + k]))
+			return false;
+		if (pivot != k) {
+			for (int j = k; j <= n; ++j) {
+				double const t = m[k * stride + j];
+				m[k * stride + j]     = m[pivot * stride + j];
+				m[pivot * stride + j] = t;
+			}
+		}
+		double const inv = 1.0 / m[k * stride + k];
+		for (int i = k + 1; i < n; ++i) {
+			double const f = m[i * stride + k] * inv;
+			if (f == 0.0)
+				continue;
+			for (int j = k; j <= n; ++j)
+				m[i * stride + j] -= f * m[k * stride + j];
+		}
+	}
+	for (int k = n - 1; k >= 0; --k) {
+		double sum = m[k * stride + n];
+		for (int j = k + 1; j < n; ++j)
+			sum -= m[k * stride + j] * env->x[members[j]];
+		env->x[members[k]] = sum / m[k * stride + k];
+	}
+
+	for (int i = 0; i < n; ++i)
+		env->pos[members[i]] = -1;
+	return true;
+}
+
+/**
+ * Runs Gauss-Seidel steps on the rows of one component only until it
+ * converges. The rows outside of the component are already solved.
+ */
+static bool solve_iterative(scc_env_t *env, const int *members, int n)
+{
+	const freq_system_t *sys = env->sys;
+	for (int iter = 0; iter < SCC_MAX_ITERATIONS; ++iter) {
+		++env->n_iter;
+		double dev = 0.0;
+		for (int i = 0; i < n; ++i) {
+			int const r   = members[i];
+			double    sum = 0.0;
+			for (int e = sys->row_begin[r], end = e + sys->row_len[r]; e < end; ++e)
+				sum += sys->vals[e] * env->x[sys->cols[e]];
+			dev      += fabs(env->x[r] - sum);
+			env->x[r] = sum;
+		}
+		if (!(dev > SEIDEL_TOLERANCE))
+			return !isnan(dev);
+	}
+	return false;
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+	int const ia = *(const int*)a;
+	int const ib = *(const int*)b;
+	return (ia > ib) - (ia < ib);
+}
+
+/** Solves the component consisting of the stack entries from @p first on. */
+static bool solve_scc(scc_env_t *env, int first)
+{
+	int *const members = &env->stack[first];
+	int  const n       = env->n_stack - first;
+	for (int i = 0; i < n; ++i)
+		env->on_stack[members[i]] = false;
+
+	if (n == 1) {
+		const freq_system_t *sys = env->sys;
+		int const r = members[0];
+		if (r == env->start_idx) {
+			env->x[r] = 1.0;
+			return true;
+		}
+		double sum = 0.0;
+		for (int e = sys->row_begin[r], end = e + sys->row_len[r]; e < end; ++e)
+			sum += sys->vals[e] * env->x[sys->cols[e]];
+		env->x[r] = sum;
+		return true;
+	}
+
+	/* the start block has a fixed frequency, it must not be part of a cycle */
+	for (int i = 0; i < n; ++i) {
+		if (members[i] == env->start_idx)
+			return false;
+	}
+	/* the rows are numbered in reverse postorder, so sorting them lets the
+	 * frequencies flow from the loop header to the back edges */
+	qsort(members, n, sizeof(*members), cmp_int);
+	if (n <= SCC_DENSE_LIMIT)
+		return solve_dense(env, members, n);
+	return solve_iterative(env, members, n);
+}
+
+/** A node on the explicit call stack of solve_sccs(). */
+typedef struct scc_frame_t {
+	int node;
+	int edge; /**< next entry of the row to look at */
+} scc_frame_t;
+
+/**
+ * Solves x = A*x with x[start_idx] = 1, ignoring the row of the start block.
+ * The strongly connected components of the dependency graph are found with
+ * Tarjan's algorithm, which finishes each component after all components it
+ * depends on, and are solved one after the other.
+ * Returns false if the system could not be solved this way.
+ */
+static bool solve_sccs(const freq_system_t *sys, int start_idx, double *x)
+{
+	int const n = sys->n;
+	scc_env_t env;
+	env.sys       = sys;
+	env.start_idx = start_idx;
+	env.x         = x;
+	env.dfn       = XMALLOCNZ(int, n);
+	env.low       = XMALLOCN(int, n);
+	env.on_stack  = XMALLOCNZ(bool, n);
+	env.stack     = XMALLOCN(int, n);
+	env.n_stack   = 0;
+	env.n_dfn     = 0;
+	env.pos       = XMALLOCN(int, n);
+	env.n_iter    = 0;
+	int const max_dense = MIN(n, SCC_DENSE_LIMIT);
+	env.dense     = XMALLOCN(double, (size_t)max_dense * (max_dense + 1));
+	for (int i = 0; i < n; ++i)
+		env.pos[i] = -1;
+
+	scc_frame_t *frames = NEW_ARR_F(scc_frame_t, 0);
+	bool         ok     = true;
+	int          n_sccs = 0;
+	for (int root = 0; root < n && ok; ++root) {
+		if (env.dfn[root] != 0)
+			continue;
+		scc_frame_t const root_frame = { root, -1 };
+		ARR_APP1(scc_frame_t, frames, root_frame);
+		while (ARR_LEN(frames) > 0 && ok) {
+			scc_frame_t *const f = &frames[ARR_LEN(frames) - 1];
+			int          const v = f->node;
+			if (f->edge < 0) {
+				env.dfn[v] = env.low[v] = ++env.n_dfn;
+				env.stack[env.n_stack++] = v;
+				env.on_stack[v] = true;
+				/* the start row is not part of the system */
+				f->edge = v == start_idx ? sys->row_begin[v] + sys->row_len[v]
+				                         : sys->row_begin[v];
+			}
+
+			int const end = sys->row_begin[v] + sys->row_len[v];
+			bool descend = false;
+			while (f->edge < end) {
+				int const w = sys->cols[f->edge++];
+				if (env.dfn[w] == 0) {
+					scc_frame_t const frame = { w, -1 };
+					ARR_APP1(scc_frame_t, frames, frame);
+					descend = true;
+					break;
+				} else if (env.on_stack[w]) {
+					env.low[v] = MIN(env.low[v], env.dfn[w]);
+				}
+			}
+			if (descend)
+				continue;
+
+			if (env.low[v] == env.dfn[v]) {
+				int first = env.n_stack;
+				do {
+					--first;
+				} while (env.stack[first] != v);
+				ok = solve_scc(&env, first);
+				env.n_stack = first;
+				++n_sccs;
+			}
+			ARR_SHRINKLEN(frames, ARR_LEN(frames) - 1);
+			if (ARR_LEN(frames) > 0) {
+				int const parent = frames[ARR_LEN(frames) - 1].node;
+				env.low[parent] = MIN(env.low[parent], env.low[v]);
+			}
+		}
+		ARR_SHRINKLEN(frames, 0);
+	}
+	stat_ev_int("execfreq_n_sccs", n_sccs);
+	stat_ev_int("execfreq_scc_iter", env.n_iter);
+
+	DEL_ARR_F(frames);
+	free(env.dense);
+	free(env.pos);
+	free(env.stack);
+	free(env.on_stack);
+	free(env.low);
+	free(env.dfn);
+	return ok;
+}
+
+/** Per loop state of solve_loop_tree(). */
+typedef struct loop_freq_t {
+	ir_loop *loop;
+	int      header;      /**< row of the loop header */
+	int     *members;     /**< rows of the loop in ascending order */
+	double   cyclic_prob; /**< probability to get from the header back to it */
+} loop_freq_t;
+
+static loop_freq_t *get_loop_freq(const ir_loop *loop)
+{
+	return get_loop_depth(loop) > 0 ? (loop_freq_t*)get_loop_link(loop) : NULL;
+}
+
+/** Checks whether the block in row @p row is part of loop @p loop. */
+static bool loop_contains_row(ir_loop *const *block_loops, const ir_loop *loop,
+                              int row)
+{
+	unsigned const depth = get_loop_depth(loop);
+	const ir_loop *l     = block_loops[row];
+	while (get_loop_depth(l) > depth)
+		l = get_loop_outer_loop(l);
+	return l == loop;
+}
+
+/**
+ * Checks that all loops are natural loops, entered only through their
+ * header and left by back edges only to their header.
+ */
+static bool is_reducible(const freq_system_t *sys, ir_loop *const *block_loops,
+                         int start_idx)
+{
+	if (sys->row_len[start_idx] != 0)
+		return false;
+	for (int r = 0; r < sys->n; ++r) {
+		const ir_loop     *loop = block_loops[r];
+		const loop_freq_t *lf   = get_loop_freq(loop);
+		/* every block may head at most one loop */
+		if (lf != NULL && lf->header == r) {
+			const loop_freq_t *outer = get_loop_freq(get_loop_outer_loop(loop));
+			if (outer != NULL && outer->header == r)
+				return false;
+		}
+		for (int e = sys->row_begin[r], end = e + sys->row_len[r]; e < end; ++e) {
+			int const p = sys->cols[e];
+			if (p > r) {
+				if (lf == NULL || lf->header != r
+				    || !loop_contains_row(block_loops, loop, p))
+					return false;
+				continue;
+			}
+			for (const ir_loop *l = loop; !loop_contains_row(block_loops, l, p);
+			     l = get_loop_outer_loop(l)) {
+				if (get_loop_freq(l)->header != r)
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static int cmp_loop_freq_depth(const void *a, const void *b)
+{
+	unsigned const da = get_loop_depth((*(loop_freq_t *const*)a)->loop);
+	unsigned const db = get_loop_depth((*(loop_freq_t *const*)b)->loop);
+	return (da < db) - (da > db);
+}
+
+/**
+ * Computes the frequencies of the members of a loop relative to its header,
+ * using the cyclic probabilities of the loops nested in it.
+ */
+static void propagate_loop_freq(const freq_system_t *sys,
+                                ir_loop *const *block_loops, int *stamp,
+                                int cur_stamp, const int *members, int n,
+                                int header, double *x)
+{
+	for (int i = 0; i < n; ++i)
+		stamp[members[i]] = cur_stamp;
+	for (int i = 0; i < n; ++i) {
+		int const r = members[i];
+		if (r == header) {
+			x[r] = 1.0;
+			continue;
+		}
+		/* the back edges of nested loops are accounted for in their cyclic
+		 * probability */
+		double inflow = 0.0;
+		for (int e = sys->row_begin[r], end = e + sys->row_len[r]; e < end; ++e) {
+			int const p = sys->cols[e];
+			if (p < r && stamp[p] == cur_stamp)
+				inflow += sys->vals[e] * x[p];
+		}
+		const loop_freq_t *lf = get_loop_freq(block_loops[r]);
+		if (lf != NULL && lf->header == r)
+			inflow /= 1.0 - lf->cyclic_prob;
+		x[r] = inflow;
+	}
+}
+
+/**
+ * Computes the frequencies from the loop tree in the spirit of Wu and Larus:
+ * Innermost loops first, the members of each loop are visited in reverse
+ * postorder to get their frequency relative to the loop header, which also
+ * yields the probability that the header is reached again over a back edge.
+ * A loop is then treated like a single block executed
+ * 1 / (1 - cyclic probability) times per entry. Each block is visited once
+ * per enclosing loop.
+ * Returns false for irreducible control flow.
+ */
+static bool solve_loop_tree(const freq_system_t *sys,
+                            ir_loop *const *block_loops, int start_idx,
+                            double *x)
+{
+	int const n = sys->n;
+	for (int r = 0; r < n; ++r) {
+		for (ir_loop *l = block_loops[r]; get_loop_depth(l) > 0;
+		     l = get_loop_outer_loop(l))
+			set_loop_link(l, NULL);
+	}
+
+	struct obstack obst;
+	obstack_init(&obst);
+	loop_freq_t **loops = NEW_ARR_F(loop_freq_t*, 0);
+	for (int r = 0; r < n; ++r) {
+		for (ir_loop *l = block_loops[r]; get_loop_depth(l) > 0;
+		     l = get_loop_outer_loop(l)) {
+			loop_freq_t *lf = get_loop_freq(l);
+			if (lf == NULL) {
+				lf = OALLOC(&obst, loop_freq_t);
+				lf->loop        = l;
+				lf->header      = r;
+				lf->members     = NEW_ARR_F(int, 0);
+				lf->cyclic_prob = 0.0;
+				set_loop_link(l, lf);
+				ARR_APP1(loop_freq_t*, loops, lf);
+			}
+			ARR_APP1(int, lf->members, r);
+		}
+	}
+
+	bool   ok       = is_reducible(sys, block_loops, start_idx);
+	size_t n_loops  = ARR_LEN(loops);
+	int   *stamp    = XMALLOCNZ(int, n);
+	int    last     = 0;
+	qsort(loops, n_loops, sizeof(*loops), cmp_loop_freq_depth);
+	for (size_t i = 0; ok && i < n_loops; ++i) {
+		loop_freq_t *const lf = loops[i];
+		int          const h  = lf->header;
+		propagate_loop_freq(sys, block_loops, stamp, ++last, lf->members,
+		                    (int)ARR_LEN(lf->members), h, x);
+		double cyclic_prob = 0.0;
+		for (int e = sys->row_begin[h], end = e + sys->row_len[h]; e < end; ++e) {
+			int const p = sys->cols[e];
+			if (p > h)
+				cyclic_prob += sys->vals[e] * x[p];
+		}
+		/* loops without an exit would get an infinite frequency */
+		if (!(cyclic_prob < 1.0 - EPSILON))
+			ok = false;
+		lf->cyclic_prob = cyclic_prob;
+	}
+	if (ok) {
+		int *all = XMALLOCN(int, n);
+		for (int r = 0; r < n; ++r)
+			all[r] = r;
+		propagate_loop_freq(sys, block_loops, stamp, ++last, all, n, start_idx,
+		                    x);
+		free(all);
+	}
+
+	free(stamp);
+	for (size_t i = 0; i < n_loops; ++i)
+		DEL_ARR_F(loops[i]->members);
+	DEL_ARR_F(loops);
+	obstack_free(&obst, NULL);
+	return ok;
+}
+
+/** Returns the largest difference of two solutions relative to their size. */
+static double get_max_rel_diff(const double *x, const double *y, int size,
+                               int start_idx)
+{
+	double const x_norm   = x[start_idx] != 0.0 ? 1.0 / x[start_idx] : 1.0;
+	double const y_norm   = y[start_idx] != 0.0 ? 1.0 / y[start_idx] : 1.0;
+	double       max_diff = 0.0;
+	for (int idx = 0; idx < size; ++idx) {
+		double const xf = fabs(x[idx]) * x_norm;
+		double const yf = fabs(y[idx]) * y_norm;
+		max_diff = MAX(max_diff, fabs(xf - yf) / MAX(1.0, xf));
+	}
+	return max_diff;
+}
+
+/**
+ * Solves the system component by component, falls back to Gauss-Seidel on
+ * the whole matrix if that fails.
+ */
+static void solve_system(ir_graph *irg, const freq_system_t *sys,
+                         gs_matrix_t *mat, int start_idx, double *x)
+{
+	int const size = sys->n;
+	stat_ev_tim_push();
+	bool const solved = solve_sccs(sys, start_idx, x);
+	stat_ev_tim_pop("execfreq_scc_time");
+	if (!solved) {
+		DB((dbg, LEVEL_1, "%+F: falling back to Gauss-Seidel\n", irg));
+		solve_lgs(mat, x, size);
+	}
+#ifdef DEBUG_libfirm
+	else if (firm_dbg_get_mask(dbg) & LEVEL_2) {
+		/* compare with the result of the Gauss-Seidel solver */
+		double *y = XMALLOCN(double, size);
+		solve_lgs(mat, y, size);
+		DB((dbg, LEVEL_2, "%+F: max relative difference to Gauss-Seidel %g\n",
+		    irg, get_max_rel_diff(x, y, size, start_idx)));
+		free(y);
+	}
+#else
+	(void)irg;
+#endif
+}
+
 static bool has_path_to_end(const ir_node *block)
 {
 	return Block_block_visited(block);
@@ -289,12 +808,28 @@ void ir_estimate_execfreq(ir_graph *irg)
 	int          size = dfs_get_n_nodes(dfs);
 	gs_matrix_t *mat  = gs_new_matrix(size, size);
 
+	freq_system_t sys;
+	sys.n         = size;
+	sys.row_begin = XMALLOCN(int, size + 1);
+	sys.row_len   = XMALLOCNZ(int, size);
+	ir_loop **block_loops = XMALLOCN(ir_loop*, size);
+	int       n_entries   = 0;
+	for (int idx = 0; idx < size; ++idx) {
+		const ir_node *bb = (ir_node*)dfs_get_post_num_node(dfs, size-idx-1);
+		block_loops[idx]   = get_irn_loop(bb);
+		sys.row_begin[idx] = n_entries;
+		n_entries += get_Block_n_cfgpreds(bb);
+	}
+	sys.row_begin[size] = n_entries;
+	sys.cols = XMALLOCN(int, n_entries);
+	sys.vals = XMALLOCN(double, n_entries);
+
 	ir_node *const start_block = get_irg_start_block(irg);
 	ir_node *const end_block   = get_irg_end_block(irg);
 	const int      start_idx   = size - dfs_get_post_num(dfs, start_block) - 1;
 
 	ir_reserve_resources(irg, IR_RESOURCE_BLOCK_VISITED
-	                     | IR_RESOURCE_IRN_VISITED);
+	                     | IR_RESOURCE_IRN_VISITED | IR_RESOURCE_LOOP_LINK);
 	inc_irg_block_visited(irg);
 	/* mark all blocks reachable from end_block as (block)visited
 	 * (so we can detect places like endless-loops/noreturn calls which
@@ -320,6 +855,7 @@ void ir_estimate_execfreq(ir_graph *irg)
 			int            pred_idx       = size - dfs_get_post_num(dfs, pred)-1;
 			double         cf_probability = get_cf_probability(bb, i, inv_loop_weight);
 			gs_matrix_set(mat, idx, pred_idx, cf_probability);
+			freq_system_set(&sys, idx, pred_idx, cf_probability);
 		}
 		/* ... equals my execution frequency */
 		gs_matrix_set(mat, idx, idx, -1.0);
@@ -348,12 +884,34 @@ void ir_estimate_execfreq(ir_graph *irg)
 		}
 	}
 
-	/* solve the system and delete the matrix */
 	double *x = XMALLOCN(double, size);
 	//ir_fprintf(stderr, "%+F:\n", irg);
 	//gs_matrix_dump(mat, 100, 100, stderr);
-	solve_lgs(mat, x, size);
+	stat_ev_dbl("execfreq_matrix_size", size);
+	bool solved = false;
+	if (estimator == ir_execfreq_loop_tree) {
+		stat_ev_tim_push();
+		solved = solve_loop_tree(&sys, block_loops, start_idx, x);
+		stat_ev_tim_pop("execfreq_loop_tree_time");
+		stat_ev_int("execfreq_loop_tree_fallback", !solved);
+		if (solved && stat_ev_enabled) {
+			/* compare with the solution of the linear system */
+			double *y = XMALLOCN(double, size);
+			solve_system(irg, &sys, mat, start_idx, y);
+			stat_ev_dbl("execfreq_loop_tree_max_diff",
+			            get_max_rel_diff(x, y, size, start_idx));
+			free(y);
+		}
+	}
+	if (!solved)
+		solve_system(irg, &sys, mat, start_idx, x);
+
 	gs_delete_matrix(mat);
+	free(sys.vals);
+	free(sys.cols);
+	free(sys.row_len);
+	free(sys.row_begin);
+	free(block_loops);
 
 	/* compute the normalization factor.
 	 * 1.0 / exec freq of start block.
@@ -408,7 +966,8 @@ void ir_estimate_execfreq(ir_graph *irg)
 		}
 	}
 
-	ir_free_resources(irg, IR_RESOURCE_BLOCK_VISITED | IR_RESOURCE_IRN_VISITED);
+	ir_free_resources(irg, IR_RESOURCE_BLOCK_VISITED | IR_RESOURCE_IRN_VISITED
+	                  | IR_RESOURCE_LOOP_LINK);
 
 	dfs_free(dfs);
 
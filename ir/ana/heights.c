@@ -20,8 +20,15 @@
 #include "irnodemap.h"
 #include "iredges_t.h"
 #include "list.h"
+#include "raw_bitset.h"
 #include "util.h"
 
+/**
+ * Blocks with more nodes than this answer reachability queries by searching
+ * instead of memoizing a bitset for every queried node.
+ */
+#define MAX_MEMO_NODES 1024
+
 struct ir_heights_t {
 	ir_nodemap      data;
 	unsigned        visited;
@@ -30,10 +37,18 @@ struct ir_heights_t {
 };
 
 typedef struct {
-	unsigned height;
-	unsigned visited;
+	unsigned  height;
+	unsigned  visited;
+	unsigned  idx;       /**< number of the node inside its block */
+	unsigned *reachable; /**< memoized in-block reachability, indexed by idx */
 } irn_height_t;
 
+typedef struct {
+	unsigned n_nodes;    /**< number of nodes in the block */
+	unsigned max_height;
+	bool     dirty;      /**< heights must be recomputed before the next use */
+} block_height_t;
+
 static irn_height_t *maybe_get_height_data(const ir_heights_t *heights,
                                            const ir_node *node)
 {
@@ -51,72 +66,26 @@ static irn_height_t *get_height_data(ir_heights_t *heights, const ir_node *node)
 	return height;
 }
 
-static void height_dump_cb(void *data, FILE *f, const ir_node *irn)
+static block_height_t *get_block_data(ir_heights_t *heights,
+                                      const ir_node *block)
 {
-	const ir_heights_t *heights = (const ir_heights_t*) data;
-	const irn_height_t *h       = maybe_get_height_data(heights, irn);
-	if (h != NULL)
-		fprintf(f, "height: %u\n", h->height);
-}
-
-/**
- * Check, if we can reach a target node from a given node inside one basic block.
- * @param h    The heights object.
- * @param curr The current node from which we tried to reach the other one.
- * @param tgt  The node we try to reach.
- * @return     1, one of tgt can be reached from curr, 0 else.
- */
-static bool search(ir_heights_t *h, const ir_node *curr, const ir_node *tgt)
-{
-	/* if the current node is the one we were looking for, we're done. */
-	if (curr == tgt)
-		return true;
-
-	/* If we are in another block or at a phi we won't find our target. */
-	if (get_nodes_block(curr) != get_nodes_block(tgt))
-		return false;
-	if (is_Phi(curr))
-		return false;
-
-	/* Check, if we have already been here. Coming more often won't help :-) */
-	irn_height_t *h_curr = maybe_get_height_data(h, curr);
-	if (h_curr->visited >= h->visited)
-		return false;
-
-	/* If we are too deep into the DAG we won't find the target either. */
-	irn_height_t *h_tgt = maybe_get_height_data(h, tgt);
-	if (h_curr->height > h_tgt->height)
-		return false;
-
-	/* Mark this place as visited. */
-	h_curr->visited = h->visited;
-
-	/* Start a search from this node. */
-	for (int i = 0, n = get_irn_ins_or_deps(curr); i < n; ++i) {
-		ir_node *op = get_irn_in_or_dep(curr, i);
-		if (search(h, op, tgt))
-			return true;
+	block_height_t *bh = ir_nodemap_get(block_height_t, &heights->data, block);
+	if (bh == NULL) {
+		bh = OALLOCZ(&heights->obst, block_height_t);
+		ir_nodemap_insert(&heights->data, block, bh);
 	}
-
-	return false;
+	return bh;
 }
 
-int heights_reachable_in_block(ir_heights_t *h, const ir_node *n,
-                               const ir_node *m)
+static void height_dump_cb(void *data, FILE *f, const ir_node *irn)
 {
-	int           res = 0;
-	irn_height_t *hn  = maybe_get_height_data(h, n);
-	irn_height_t *hm  = maybe_get_height_data(h, m);
-
-	assert(get_nodes_block(n) == get_nodes_block(m));
-	assert(hn != NULL && hm != NULL);
-
-	if (hn->height <= hm->height) {
-		h->visited++;
-		res = search(h, n, m);
-	}
+	if (is_Block(irn))
+		return;
 
-	return res;
+	const ir_heights_t *heights = (const ir_heights_t*) data;
+	const irn_height_t *h       = maybe_get_height_data(heights, irn);
+	if (h != NULL)
+		fprintf(f, "height: %u\n", h->height);
 }
 
 /**
@@ -124,8 +93,10 @@ int heights_reachable_in_block(ir_heights_t *h, const ir_node *n,
  * @param h   The heights object.
  * @param irn The node.
  * @param bl  The block.
+ * @param bh  The block data, used to number the nodes of the block.
  */
-static unsigned compute_height(ir_heights_t *h, ir_node *irn, const ir_node *bl)
+static unsigned compute_height(ir_heights_t *h, ir_node *irn, const ir_node *bl,
+                               block_height_t *bh)
 {
 	irn_height_t *ih = get_height_data(h, irn);
 
@@ -133,14 +104,16 @@ static unsigned compute_height(ir_heights_t *h, ir_node *irn, const ir_node *bl)
 	if (ih->visited >= h->visited)
 		return ih->height;
 
-	ih->visited = h->visited;
-	ih->height  = 0;
+	ih->visited   = h->visited;
+	ih->height    = 0;
+	ih->idx       = bh->n_nodes++;
+	ih->reachable = NULL;
 
 	foreach_out_edge(irn, edge) {
 		ir_node *dep = get_edge_src_irn(edge);
 
 		if (!is_Block(dep) && !is_Phi(dep) && get_nodes_block(dep) == bl) {
-			unsigned dep_height = compute_height(h, dep, bl);
+			unsigned dep_height = compute_height(h, dep, bl, bh);
 			ih->height          = MAX(ih->height, dep_height+1);
 		}
 	}
@@ -150,7 +123,7 @@ static unsigned compute_height(ir_heights_t *h, ir_node *irn, const ir_node *bl)
 
 		assert(!is_Phi(dep));
 		if (!is_Block(dep) && get_nodes_block(dep) == bl) {
-			unsigned dep_height = compute_height(h, dep, bl);
+			unsigned dep_height = compute_height(h, dep, bl, bh);
 			ih->height          = MAX(ih->height, dep_height+1);
 		}
 	}
@@ -158,25 +131,35 @@ static unsigned compute_height(ir_heights_t *h, ir_node *irn, const ir_node *bl)
 	return ih->height;
 }
 
+
 static unsigned compute_heights_in_block(ir_node *bl, ir_heights_t *h)
 {
+	block_height_t *bh = get_block_data(h, bl);
+	bh->n_nodes = 0;
+	bh->dirty   = false;
+
 	h->visited++;
 
 	int max_height = -1;
 	foreach_out_edge(bl, edge) {
 		ir_node *dep = get_edge_src_irn(edge);
-		int     curh = compute_height(h, dep, bl);
+		if (is_Block(dep) || get_nodes_block(dep) != bl)
+			continue;
+		int curh = compute_height(h, dep, bl, bh);
 
 		max_height = MAX(curh, max_height);
 	}
 
 	foreach_out_edge_kind(bl, edge, EDGE_KIND_DEP) {
 		ir_node *dep = get_edge_src_irn(edge);
-		int     curh = compute_height(h, dep, bl);
+		if (is_Block(dep) || get_nodes_block(dep) != bl)
+			continue;
+		int curh = compute_height(h, dep, bl, bh);
 
 		max_height = MAX(curh, max_height);
 	}
 
+	bh->max_height = max_height;
 	return max_height;
 }
 
@@ -186,13 +169,127 @@ static void compute_heights_in_block_walker(ir_node *block, void *data)
 	compute_heights_in_block(block, h);
 }
 
-unsigned get_irn_height(const ir_heights_t *heights, const ir_node *irn)
+/**
+ * Returns the height data of a node, recomputing its block first if the block
+ * was invalidated or the node was created after the last computation.
+ */
+static irn_height_t *get_valid_height_data(ir_heights_t *h, const ir_node *irn)
 {
-	const irn_height_t *height = maybe_get_height_data(heights, irn);
-	assert(height != NULL);
+	ir_node        *block = get_nodes_block(irn);
+	block_height_t *bh    = get_block_data(h, block);
+	irn_height_t   *ih    = maybe_get_height_data(h, irn);
+	if (bh->dirty || ih == NULL) {
+		heights_recompute_block(h, block);
+		ih = maybe_get_height_data(h, irn);
+	}
+	assert(ih != NULL);
+	return ih;
+}
+
+/**
+ * Check, if we can reach a target node from a given node inside one basic block.
+ * @param h    The heights object.
+ * @param curr The current node from which we tried to reach the other one.
+ * @param tgt  The node we try to reach.
+ * @return     1, one of tgt can be reached from curr, 0 else.
+ */
+static bool search(ir_heights_t *h, const ir_node *curr, const ir_node *tgt)
+{
+	/* if the current node is the one we were looking for, we're done. */
+	if (curr == tgt)
+		return true;
+
+	/* If we are in another block or at a phi we won't find our target. */
+	if (is_Block(curr) || get_nodes_block(curr) != get_nodes_block(tgt))
+		return false;
+	if (is_Phi(curr))
+		return false;
+
+	/* Check, if we have already been here. Coming more often won't help :-) */
+	irn_height_t *h_curr = maybe_get_height_data(h, curr);
+	if (h_curr->visited >= h->visited)
+		return false;
+
+	/* If we are too deep into the DAG we won't find the target either. */
+	irn_height_t *h_tgt = maybe_get_height_data(h, tgt);
+	if (h_curr->height > h_tgt->height)
+		return false;
+
+	/* Mark this place as visited. */
+	h_curr->visited = h->visited;
+
+	/* Start a search from this node. */
+	for (int i = 0, n = get_irn_ins_or_deps(curr); i < n; ++i) {
+		ir_node *op = get_irn_in_or_dep(curr, i);
+		if (search(h, op, tgt))
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Returns the set of nodes reachable from a node inside its block, computing
+ * it from the sets of its operands on first use.
+ */
+static const unsigned *get_reachable(ir_heights_t *h, const ir_node *irn,
+                                     const ir_node *bl, unsigned n_nodes)
+{
+	irn_height_t *ih = maybe_get_height_data(h, irn);
+	if (ih->reachable != NULL)
+		return ih->reachable;
+
+	unsigned *reachable = rbitset_obstack_alloc(&h->obst, n_nodes);
+	for (int i = 0, n = get_irn_ins_or_deps(irn); i < n; ++i) {
+		ir_node *op = get_irn_in_or_dep(irn, i);
+		if (is_Block(op) || get_nodes_block(op) != bl)
+			continue;
+
+		irn_height_t *iop = maybe_get_height_data(h, op);
+		rbitset_set(reachable, iop->idx);
+		/* the search does not continue through Phis */
+		if (!is_Phi(op))
+			rbitset_or(reachable, get_reachable(h, op, bl, n_nodes), n_nodes);
+	}
+	ih->reachable = reachable;
+	return reachable;
+}
+
+int heights_reachable_in_block(ir_heights_t *h, const ir_node *n,
+                               const ir_node *m)
+{
+	assert(get_nodes_block(n) == get_nodes_block(m));
+	irn_height_t *hn = get_valid_height_data(h, n);
+	irn_height_t *hm = get_valid_height_data(h, m);
+
+	if (n == m)
+		return 1;
+	/* operands are always higher than their users */
+	if (hn->height > hm->height || is_Phi(n))
+		return 0;
+
+	ir_node        *block = get_nodes_block(n);
+	block_height_t *bh    = get_block_data(h, block);
+	if (bh->n_nodes > MAX_MEMO_NODES) {
+		h->visited++;
+		return search(h, n, m);
+	}
+
+	const unsigned *reachable = get_reachable(h, n, block, bh->n_nodes);
+	return rbitset_is_set(reachable, hm->idx);
+}
+
+unsigned get_irn_height(ir_heights_t *heights, const ir_node *irn)
+{
+	const irn_height_t *height = get_valid_height_data(heights, irn);
 	return height->height;
 }
 
+void heights_invalidate_block(ir_heights_t *h, ir_node *block)
+{
+	get_block_data(h, block)->dirty = true;
+}
+
 unsigned heights_recompute_block(ir_heights_t *h, ir_node *block)
 {
 	ir_graph *irg = get_irn_irg(block);
@@ -205,7 +302,6 @@ unsigned heights_recompute_block(ir_heights_t *h, ir_node *block)
 		memset(ih, 0, sizeof(*ih));
 	}
 
-	h->visited = 0;
 	return compute_heights_in_block(block, h);
 }
 
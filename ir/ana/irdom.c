@@ -353,15 +353,9 @@ typedef struct tmp_dom_info {
 	struct tmp_dom_info *parent;
 	struct tmp_dom_info *label;   /**< used for LINK and EVAL */
 	struct tmp_dom_info *ancestor;/**< used for LINK and EVAL */
-	struct tmp_dom_info *dom;     /**< After step 3, if the semidominator of w
-	                                   is its immediate dominator, then w->dom
-	                                   is the immediate dominator of w.
-	                                   Otherwise w->dom is a vertex v whose
-	                                   number is smaller than w and whose
-	                                   immediate dominator is also w's
-	                                   immediate dominator. After step 4,
-	                                   w->dom is the immediate dominator of w.*/
-	struct tmp_dom_info *bucket;  /**< set of vertices with same semidominator */
+	struct tmp_dom_info *dom;     /**< immediate dominator, computed from the
+	                                   semidominators by searching the
+	                                   nearest common ancestor */
 } tmp_dom_info;
 
 /**
@@ -387,7 +381,6 @@ static void init_tmp_dom_info(ir_node *block, tmp_dom_info *parent,
 	tdi->label    = tdi;
 	tdi->ancestor = NULL;
 	tdi->dom      = NULL;
-	tdi->bucket   = NULL;
 
 	/* Iterate */
 	for (int i = get_Block_n_cfg_outs_ka(block) - 1; i >= 0; --i) {
@@ -422,7 +415,6 @@ static void init_tmp_pdom_info(ir_node *block, tmp_dom_info *parent,
 	tdi->label    = tdi;
 	tdi->ancestor = NULL;
 	tdi->dom      = NULL;
-	tdi->bucket   = NULL;
 
 	/* Iterate */
 	for (int i = get_Block_n_cfgpreds(block) - 1; i >= 0; --i) {
@@ -478,6 +470,27 @@ inline static void dom_link(tmp_dom_info *v, tmp_dom_info *w)
 	w->ancestor = v;
 }
 
+/**
+ * Computes the immediate dominators from the semidominators (Semi-NCA):
+ * The immediate dominator of w is the nearest common ancestor of its
+ * semidominator and its DFS parent in the dominator tree. As the vertices are
+ * processed in DFS preorder, the dominator tree of all vertices before w is
+ * complete, so the ancestor is found by walking up from the parent until a
+ * vertex not after the semidominator in preorder is reached.
+ * This replaces the buckets and the deferred fix-up step of Lengauer-Tarjan.
+ */
+static void compute_idoms(tmp_dom_info *tdi_list, int n_blocks)
+{
+	tdi_list[0].dom = NULL;
+	for (int i = 1; i < n_blocks; i++) {
+		tmp_dom_info *w   = &tdi_list[i];
+		tmp_dom_info *dom = w->parent;
+		while (dom > w->semi)
+			dom = dom->dom;
+		w->dom = dom;
+	}
+}
+
 /**
  * Walker: count the number of blocks and clears the dominance info
  */
@@ -522,7 +535,7 @@ void compute_doms(ir_graph *irg)
 		tmp_dom_info  *w     = &tdi_list[i];
 		const ir_node *block = w->block;
 
-		/* Step 2 */
+		/* semidominator */
 		for (int j = 0, arity = get_irn_arity(block); j < arity; j++) {
 			const ir_node *pred       = get_Block_cfgpred(block, j);
 			const ir_node *pred_block = get_nodes_block(pred);
@@ -549,38 +562,17 @@ void compute_doms(ir_graph *irg)
 			}
 		}
 
-		/* Add w to w->semi's bucket.  w is in exactly one bucket, so
-		   buckets can been implemented as linked lists. */
-		w->bucket = w->semi->bucket;
-		w->semi->bucket = w;
-
 		dom_link(w->parent, w);
-
-		/* Step 3 */
-		while (w->parent->bucket) {
-			tmp_dom_info *v = w->parent->bucket;
-			/* remove v from w->parent->bucket */
-			w->parent->bucket = v->bucket;
-			v->bucket = NULL;
-
-			tmp_dom_info *u = dom_eval(v);
-			if (u->semi < v->semi)
-				v->dom = u;
-			else
-				v->dom = w->parent;
-		}
 	}
-	/* Step 4 */
-	tdi_list[0].dom = NULL;
+	compute_idoms(tdi_list, n_blocks);
+
 	set_Block_idom(tdi_list[0].block, NULL);
 	set_Block_dom_depth(tdi_list[0].block, 1);
 	for (int i = 1; i < n_blocks; i++) {
 		tmp_dom_info *w = &tdi_list[i];
-		if (w->dom == NULL)
+		if (w->semi == w)
 			continue; /* control dead */
 
-		if (w->dom != w->semi)
-			w->dom = w->dom->dom;
 		set_Block_idom(w->block, w->dom->block);
 
 		/* blocks dominated by dead one's are still dead */
@@ -601,6 +593,40 @@ void compute_doms(ir_graph *irg)
 	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
 }
 
+static void assign_tree_dom_depth_pre_order(ir_node *block, void *data)
+{
+	ir_dom_info *bi   = get_dom_info(block);
+	ir_node     *idom = bi->idom;
+
+	bi->dom_depth = idom != NULL ? get_dom_info(idom)->dom_depth + 1 : 1;
+	assign_tree_dom_pre_order(block, data);
+}
+
+void rebuild_dom_tree(ir_graph *irg, ir_node *const *blocks, size_t n_blocks)
+{
+	ir_node *start = get_irg_start_block(irg);
+
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ir_dom_info *bi = get_dom_info(blocks[i]);
+		bi->first = NULL;
+		bi->next  = NULL;
+	}
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ir_node *block = blocks[i];
+		if (block == start)
+			continue;
+		/* immediate dominators merged into other blocks have been exchanged */
+		ir_node *idom = skip_Id(get_dom_info(block)->idom);
+		assert(is_Block(idom));
+		set_Block_idom(block, idom);
+	}
+	set_Block_idom(start, NULL);
+
+	unsigned tree_pre_order = 0;
+	dom_tree_walk(start, assign_tree_dom_depth_pre_order,
+	              assign_tree_dom_pre_order_max, &tree_pre_order);
+}
+
 void free_dom(ir_graph *irg)
 {
 	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
@@ -635,7 +661,7 @@ void compute_postdoms(ir_graph *irg)
 	for (int i = n_blocks; i-- > 1; ) {  /* Don't iterate the root, it's done. */
 		tmp_dom_info *w = &tdi_list[i];
 
-		/* Step 2 */
+		/* semidominator */
 		int irn_arity = get_Block_n_cfg_outs_ka(w->block);
 		for (int j = 0; j < irn_arity; j++) {
 			ir_node *succ = get_Block_cfg_out_ka(w->block, j);
@@ -646,36 +672,14 @@ void compute_postdoms(ir_graph *irg)
 			if (u->semi < w->semi)
 				w->semi = u->semi;
 		}
-		/* Add w to w->semi's bucket.  w is in exactly one bucket, so
-		   buckets can be implemented as linked lists. */
-		w->bucket = w->semi->bucket;
-		w->semi->bucket = w;
-
 		dom_link(w->parent, w);
-
-		/* Step 3 */
-		while (w->parent->bucket) {
-			tmp_dom_info *v = w->parent->bucket;
-			/* remove v from w->parent->bucket */
-			w->parent->bucket = v->bucket;
-			v->bucket = NULL;
-
-			tmp_dom_info *u = dom_eval(v);
-			if (u->semi < v->semi)
-				v->dom = u;
-			else
-				v->dom = w->parent;
-		}
 	}
-	/* Step 4 */
-	tdi_list[0].dom = NULL;
+	compute_idoms(tdi_list, n_blocks);
+
 	set_Block_ipostdom(tdi_list[0].block, NULL);
 	set_Block_postdom_depth(tdi_list[0].block, 1);
 	for (int i = 1; i < n_blocks; i++) {
 		tmp_dom_info *w = &tdi_list[i];
-
-		if (w->dom != w->semi)
-			w->dom = w->dom->dom;
 		set_Block_ipostdom(w->block, w->dom->block);
 		set_Block_postdom_depth(w->block, get_Block_postdom_depth(w->dom->block) + 1);
 	}
@@ -57,8 +57,35 @@ unsigned get_Block_pdom_tree_pre_num(const ir_node *bl);
 unsigned get_Block_dom_max_subtree_pre_num(const ir_node *bl);
 unsigned get_Block_pdom_max_subtree_pre_num(const ir_node *bl);
 
+/**
+ * Rebuilds the dominator tree after a transformation maintained the immediate
+ * dominators of the remaining blocks incrementally: recomputes the lists of
+ * dominated blocks, the dominator depths and the tree pre-order numbers.
+ * Immediate dominators which have been exchanged are replaced by the block
+ * they were merged into.
+ *
+ * @param blocks    all reachable blocks of irg, including the start block
+ * @param n_blocks  number of blocks in @p blocks
+ */
+void rebuild_dom_tree(ir_graph *irg, ir_node *const *blocks, size_t n_blocks);
+
 void ir_free_dominance_frontiers(ir_graph *irg);
 
+/**
+ * Computes the iterated dominance frontier of a set of blocks without
+ * computing the dominance frontiers of the whole graph.
+ * Requires consistent dominance information and out edges.
+ *
+ * @param irg       the graph
+ * @param blocks    the blocks, e.g. the blocks containing definitions
+ * @param n_blocks  the number of blocks
+ * @return a flexible array of the blocks in the iterated dominance frontier,
+ *         must be freed with DEL_ARR_F()
+ */
+ir_node **ir_compute_iterated_dominance_frontier(ir_graph *irg,
+                                                 ir_node *const *blocks,
+                                                 size_t n_blocks);
+
 /**
  * Iterate over all nodes which are immediately dominated by a given
  * node.
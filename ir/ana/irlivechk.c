@@ -245,6 +245,13 @@ void lv_chk_free(lv_chk_t *lv)
 	free(lv);
 }
 
+size_t lv_chk_memory_used(const lv_chk_t *lv)
+{
+	struct obstack *const obst = (struct obstack*)&lv->obst;
+	return sizeof(*lv) + (size_t)obstack_memory_used(obst)
+	     + ARR_LEN(lv->block_infos.data) * sizeof(lv->block_infos.data[0]);
+}
+
 unsigned lv_chk_bl_xxx(lv_chk_t *lv, const ir_node *bl, const ir_node *var)
 {
 	assert(is_Block(bl));
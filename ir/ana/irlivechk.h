@@ -62,6 +62,12 @@ extern lv_chk_t *lv_chk_new(ir_graph *irg);
  */
 extern void lv_chk_free(lv_chk_t *lv);
 
+/**
+ * Returns the number of bytes allocated for liveness check information.
+ * @param lv The liveness check information.
+ */
+extern size_t lv_chk_memory_used(const lv_chk_t *lv);
+
 
 /**
  * Return liveness information for a node concerning a block.
@@ -11,14 +11,17 @@
  */
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "adt/pmap.h"
+#include "pset.h"
 #include "irnode_t.h"
 #include "irgraph_t.h"
 #include "irprog_t.h"
 #include "irmemory_t.h"
 #include "irmemory.h"
 #include "irflag.h"
+#include "irhooks.h"
 #include "hashptr.h"
 #include "irflag.h"
 #include "irouts.h"
@@ -27,6 +30,10 @@
 #include "debug.h"
 #include "error.h"
 #include "typerep.h"
+#include "type_t.h"
+#include "bitfiddle.h"
+#include "xmalloc.h"
+#include "statev_t.h"
 
 /** The debug handle. */
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
@@ -35,6 +42,9 @@ DEBUG_ONLY(static firm_dbg_module_t *dbgcall = NULL;)
 /** The source language specific language disambiguator function. */
 static DISAMBIGUATOR_FUNC language_disambuigator = NULL;
 
+/** The disambiguator of the points-to analysis. */
+static DISAMBIGUATOR_FUNC points_to_disambiguator = NULL;
+
 /** The global memory disambiguator options. */
 static unsigned global_mem_disamgig_opt = aa_opt_no_opt;
 
@@ -58,14 +68,27 @@ unsigned get_irg_memory_disambiguator_options(const ir_graph *irg)
 	return opt;
 }
 
+/**
+ * Invalidates the alias query caches of all graphs.
+ */
+static void invalidate_alias_caches(void)
+{
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		clear_irg_properties(get_irp_irg(i),
+		                     IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
+	}
+}
+
 void set_irg_memory_disambiguator_options(ir_graph *irg, unsigned options)
 {
 	irg->mem_disambig_opt = options & ~aa_opt_inherited;
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
 }
 
 void set_irp_memory_disambiguator_options(unsigned options)
 {
 	global_mem_disamgig_opt = options;
+	invalidate_alias_caches();
 }
 
 ir_storage_class_class_t get_base_sc(ir_storage_class_class_t x)
@@ -695,21 +718,147 @@ leave_type_based_alias:;
 	}
 
 	/* access points-to information here */
+	if (points_to_disambiguator != NULL)
+		return points_to_disambiguator(orig_adr1, mode1, orig_adr2, mode2);
 	return ir_may_alias;
 }
 
+/** minimum number of entries of an alias query cache */
+#define ALIAS_CACHE_MIN_SIZE  64
+/** maximum number of entries of an alias query cache */
+#define ALIAS_CACHE_MAX_SIZE  16384
+/** number of slots probed before an entry is evicted */
+#define ALIAS_CACHE_PROBES    4
+
+/** An entry of the alias query cache. */
+typedef struct alias_cache_entry_t {
+	const ir_node     *adr1;   /**< The first address, NULL if unused. */
+	const ir_mode     *mode1;  /**< The first access mode. */
+	const ir_node     *adr2;   /**< The second address. */
+	const ir_mode     *mode2;  /**< The second access mode. */
+	ir_alias_relation  result; /**< The alias relation of the query. */
+} alias_cache_entry_t;
+
+/**
+ * The alias query cache of a graph: An open addressed hash table of fixed
+ * size. If all probed slots of a query are taken, the entry in the first one
+ * is replaced, so the table never grows.
+ */
+typedef struct ir_alias_cache_t {
+	size_t               mask;      /**< number of entries - 1 */
+	alias_cache_entry_t *entries;
+	unsigned long        n_queries; /**< queries since the last reset */
+	unsigned long        n_hits;    /**< cache hits since the last reset */
+} ir_alias_cache_t;
+
+static void report_alias_cache(const ir_alias_cache_t *cache)
+{
+	if (cache->n_queries == 0)
+		return;
+	stat_ev_ull("alias_cache_queries", cache->n_queries);
+	stat_ev_ull("alias_cache_hits", cache->n_hits);
+	DB((dbg, LEVEL_1, "alias cache: %lu of %lu queries hit\n", cache->n_hits,
+	    cache->n_queries));
+}
+
+void assure_irg_alias_cache(ir_graph *irg)
+{
+	if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE))
+		return;
+
+	/* a cache with about one entry per node, a pass asks for a few pairs per
+	 * memory operation */
+	size_t size = ceil_po2(get_irg_last_idx(irg));
+	if (size < ALIAS_CACHE_MIN_SIZE)
+		size = ALIAS_CACHE_MIN_SIZE;
+	if (size > ALIAS_CACHE_MAX_SIZE)
+		size = ALIAS_CACHE_MAX_SIZE;
+
+	ir_alias_cache_t *cache = irg->alias_cache;
+	if (cache == NULL) {
+		cache = XMALLOCZ(ir_alias_cache_t);
+		irg->alias_cache = cache;
+	} else {
+		report_alias_cache(cache);
+		if (cache->mask + 1 != size) {
+			free(cache->entries);
+			cache->entries = NULL;
+		}
+	}
+	if (cache->entries == NULL) {
+		cache->entries = XMALLOCN(alias_cache_entry_t, size);
+		cache->mask    = size - 1;
+	}
+	memset(cache->entries, 0, size * sizeof(cache->entries[0]));
+	cache->n_queries = 0;
+	cache->n_hits    = 0;
+	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
+}
+
+void free_irg_alias_cache(ir_graph *irg)
+{
+	ir_alias_cache_t *cache = irg->alias_cache;
+	if (cache == NULL)
+		return;
+	report_alias_cache(cache);
+	free(cache->entries);
+	free(cache);
+	irg->alias_cache = NULL;
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
+}
+
 ir_alias_relation get_alias_relation(
 	const ir_node *const adr1, const ir_mode *const mode1,
 	const ir_node *const adr2, const ir_mode *const mode2)
 {
+	ir_graph         *const irg   = get_irn_irg(adr1);
+	ir_alias_cache_t *const cache = irg->alias_cache;
+	if (cache == NULL || !get_opt_alias_analysis()
+	    || !irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE)) {
+		ir_alias_relation rel = _get_alias_relation(adr1, mode1, adr2, mode2);
+		DB((dbg, LEVEL_1, "alias(%+F, %+F) = %s\n", adr1, adr2, get_ir_alias_relation_name(rel)));
+		return rel;
+	}
+
+	++cache->n_queries;
+	unsigned const hash = hash_combine(hash_combine(hash_ptr(adr1), hash_ptr(adr2)),
+	                                   hash_combine(hash_ptr(mode1), hash_ptr(mode2)));
+	alias_cache_entry_t *slot = NULL;
+	for (unsigned i = 0; i < ALIAS_CACHE_PROBES; ++i) {
+		alias_cache_entry_t *entry = &cache->entries[(hash + i) & cache->mask];
+		if (entry->adr1 == NULL) {
+			slot = entry;
+			break;
+		}
+		if (entry->adr1 == adr1 && entry->adr2 == adr2
+		    && entry->mode1 == mode1 && entry->mode2 == mode2) {
+			++cache->n_hits;
+			return entry->result;
+		}
+	}
+	if (slot == NULL)
+		slot = &cache->entries[hash & cache->mask];
+
 	ir_alias_relation rel = _get_alias_relation(adr1, mode1, adr2, mode2);
 	DB((dbg, LEVEL_1, "alias(%+F, %+F) = %s\n", adr1, adr2, get_ir_alias_relation_name(rel)));
+	slot->adr1   = adr1;
+	slot->mode1  = mode1;
+	slot->adr2   = adr2;
+	slot->mode2  = mode2;
+	slot->result = rel;
 	return rel;
 }
 
 void set_language_memory_disambiguator(DISAMBIGUATOR_FUNC func)
 {
 	language_disambuigator = func;
+	invalidate_alias_caches();
+}
+
+void set_points_to_disambiguator(DISAMBIGUATOR_FUNC func)
+{
+	points_to_disambiguator = func;
+	invalidate_alias_caches();
 }
 
 /** The result cache for the memory disambiguator. */
@@ -1016,6 +1165,8 @@ static void analyse_irg_entity_usage(ir_graph *irg)
 		}
 	}
 
+	/* cached alias relations may depend on the old usage state */
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
 	/* now computed */
 	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE);
 }
@@ -1029,6 +1180,63 @@ void assure_irg_entity_usage_computed(ir_graph *irg)
 }
 
 
+/**
+ * Users of the address of a global entity.
+ *
+ * Once the global entity usage flags are computed they are kept up to date
+ * incrementally: hooks collect the graphs in which new users of global
+ * addresses appear and only the entities addressed in these graphs get
+ * their flags recomputed, walking just the graphs recorded for them.
+ */
+typedef struct entity_users_t {
+	ir_graph **irgs;           /**< graphs containing the address */
+	bool       in_initializer; /**< the address is used in an initializer */
+} entity_users_t;
+
+static pmap         *entity_users; /**< maps entities to entity_users_t */
+static pset         *dirty_irgs;   /**< graphs with new address users */
+static ir_graph     *copying_irg;  /**< graph copied by dead node elim */
+static hook_entry_t  hook_new_node_entry;
+static hook_entry_t  hook_set_irn_n_entry;
+static hook_entry_t  hook_replace_entry;
+static hook_entry_t  hook_dead_node_elim_entry;
+static hook_entry_t  hook_free_graph_entry;
+
+static bool is_global_entity(const ir_entity *entity)
+{
+	return (get_entity_owner(entity)->flags & tf_segment) != 0;
+}
+
+static entity_users_t *get_entity_users(ir_entity *entity)
+{
+	entity_users_t *users = pmap_get(entity_users_t, entity_users, entity);
+	if (users == NULL) {
+		users       = XMALLOCZ(entity_users_t);
+		users->irgs = NEW_ARR_F(ir_graph*, 0);
+		pmap_insert(entity_users, entity, users);
+	}
+	return users;
+}
+
+static void add_entity_user(ir_entity *entity, ir_graph *irg)
+{
+	entity_users_t *users = get_entity_users(entity);
+	for (size_t i = ARR_LEN(users->irgs); i-- > 0; ) {
+		if (users->irgs[i] == irg)
+			return;
+	}
+	ARR_APP1(ir_graph*, users->irgs, irg);
+}
+
+/**
+ * Marks the address of @p entity as used by an initializer.
+ */
+static void mark_initializer_address(ir_entity *entity)
+{
+	get_entity_users(entity)->in_initializer = true;
+	set_entity_usage(entity, ir_usage_unknown);
+}
+
 /**
  * Initialize the entity_usage flag for a global type like type.
  */
@@ -1059,12 +1267,13 @@ static void check_initializer_nodes(ir_initializer_t *initializer)
 		ir_node *n = initializer->consti.value;
 		if (is_SymConst_addr_ent(n)) {
 			ir_entity *ent = get_SymConst_entity(n);
-			set_entity_usage(ent, ir_usage_unknown);
+			mark_initializer_address(ent);
 		}
 		return;
 	}
 	case IR_INITIALIZER_TARVAL:
 	case IR_INITIALIZER_NULL:
+	case IR_INITIALIZER_BYTES:
 		return;
 	case IR_INITIALIZER_COMPOUND:
 		for (size_t i = 0; i < initializer->compound.n_initializers; ++i) {
@@ -1153,6 +1362,180 @@ static void check_global_address(ir_node *irn, void *data)
 	unsigned   flags  = get_entity_usage(entity);
 	flags |= determine_entity_usage(irn, entity);
 	set_entity_usage(entity, (ir_entity_usage) flags);
+
+	if (is_global_entity(entity))
+		add_entity_user(entity, get_irn_irg(irn));
+}
+
+/**
+ * Returns true if @p node computes an address of a global entity, possibly
+ * with the pointer arithmetic looked through by determine_entity_usage().
+ */
+static bool is_global_address(const ir_node *node)
+{
+	for (;;) {
+		switch (get_irn_opcode(node)) {
+		case iro_SymConst:
+			return is_SymConst_addr_ent(node)
+			    && is_global_entity(get_SymConst_entity(node));
+		case iro_Sel:
+			node = get_Sel_ptr(node);
+			continue;
+		case iro_Id:
+			node = get_Id_pred(node);
+			continue;
+		case iro_Proj: {
+			const ir_node *pred = get_Proj_pred(node);
+			if (!is_Tuple(pred))
+				return false;
+			node = get_Tuple_pred(pred, get_Proj_proj(node));
+			continue;
+		}
+		case iro_Add:
+		case iro_Sub: {
+			const ir_node *left  = get_binop_left(node);
+			const ir_node *right = get_binop_right(node);
+			if (mode_is_reference(get_irn_mode(right))
+			    && is_global_address(right))
+				return true;
+			if (!mode_is_reference(get_irn_mode(left)))
+				return false;
+			node = left;
+			continue;
+		}
+		default:
+			return false;
+		}
+	}
+}
+
+/**
+ * Records that @p node got a new user in @p irg.
+ */
+static void note_address_use(ir_graph *irg, const ir_node *node)
+{
+	if (irg == copying_irg)
+		return;
+	if (irg == get_const_code_irg()) {
+		if (is_SymConst_addr_ent(node))
+			mark_initializer_address(get_SymConst_entity(node));
+	} else if (is_global_address(node)) {
+		pset_insert_ptr(dirty_irgs, irg);
+	}
+}
+
+/**
+ * Hook: a new node may use global addresses.
+ */
+static void entity_users_new_node(void *ctx, ir_graph *irg, ir_node *node)
+{
+	(void)ctx;
+	if (irg == get_const_code_irg()) {
+		note_address_use(irg, node);
+		return;
+	}
+	/* inputs of immature blocks and Phis may not be set yet */
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		ir_node *pred = get_irn_n(node, i);
+		if (pred != NULL)
+			note_address_use(irg, pred);
+	}
+}
+
+/**
+ * Hook: an input of a node changed.
+ */
+static void entity_users_set_irn_n(void *ctx, ir_node *src, int pos,
+                                   ir_node *tgt, ir_node *old_tgt)
+{
+	(void)ctx;
+	(void)pos;
+	(void)old_tgt;
+	note_address_use(get_irn_irg(src), tgt);
+}
+
+/**
+ * Hook: the users of a node are moved to another node.
+ */
+static void entity_users_replace(void *ctx, ir_node *old_node,
+                                 ir_node *new_node)
+{
+	(void)ctx;
+	(void)old_node;
+	note_address_use(get_irn_irg(new_node), new_node);
+}
+
+/**
+ * Hook: dead node elimination only copies existing users.
+ */
+static void entity_users_dead_node_elim(void *ctx, ir_graph *irg, int start)
+{
+	(void)ctx;
+	copying_irg = start ? irg : NULL;
+}
+
+/**
+ * Hook: a graph is freed, so it does not use any addresses anymore.
+ */
+static void entity_users_free_graph(void *ctx, ir_graph *irg)
+{
+	(void)ctx;
+	if (pset_find_ptr(dirty_irgs, irg) != NULL)
+		pset_remove_ptr(dirty_irgs, irg);
+	pmap_entry *entry;
+	foreach_pmap(entity_users, entry) {
+		entity_users_t *users = (entity_users_t*)entry->value;
+		for (size_t i = ARR_LEN(users->irgs); i-- > 0; ) {
+			if (users->irgs[i] != irg)
+				continue;
+			size_t last = ARR_LEN(users->irgs) - 1;
+			users->irgs[i] = users->irgs[last];
+			ARR_SHRINKLEN(users->irgs, last);
+			break;
+		}
+	}
+}
+
+static void init_entity_users(void)
+{
+	entity_users = pmap_create();
+	dirty_irgs   = pset_new_ptr_default();
+	copying_irg  = NULL;
+
+	hook_new_node_entry.hook._hook_new_node = entity_users_new_node;
+	register_hook(hook_new_node, &hook_new_node_entry);
+	hook_set_irn_n_entry.hook._hook_set_irn_n = entity_users_set_irn_n;
+	register_hook(hook_set_irn_n, &hook_set_irn_n_entry);
+	hook_replace_entry.hook._hook_replace = entity_users_replace;
+	register_hook(hook_replace, &hook_replace_entry);
+	hook_dead_node_elim_entry.hook._hook_dead_node_elim
+		= entity_users_dead_node_elim;
+	register_hook(hook_dead_node_elim, &hook_dead_node_elim_entry);
+	hook_free_graph_entry.hook._hook_free_graph = entity_users_free_graph;
+	register_hook(hook_free_graph, &hook_free_graph_entry);
+}
+
+static void free_entity_users(void)
+{
+	if (entity_users == NULL)
+		return;
+
+	unregister_hook(hook_new_node, &hook_new_node_entry);
+	unregister_hook(hook_set_irn_n, &hook_set_irn_n_entry);
+	unregister_hook(hook_replace, &hook_replace_entry);
+	unregister_hook(hook_dead_node_elim, &hook_dead_node_elim_entry);
+	unregister_hook(hook_free_graph, &hook_free_graph_entry);
+
+	pmap_entry *entry;
+	foreach_pmap(entity_users, entry) {
+		entity_users_t *users = (entity_users_t*)entry->value;
+		DEL_ARR_F(users->irgs);
+		free(users);
+	}
+	pmap_destroy(entity_users);
+	del_pset(dirty_irgs);
+	entity_users = NULL;
+	dirty_irgs   = NULL;
 }
 
 /**
@@ -1160,6 +1543,9 @@ static void check_global_address(ir_node *irn, void *data)
  */
 static void analyse_irp_globals_entity_usage(void)
 {
+	free_entity_users();
+	init_entity_users();
+
 	for (ir_segment_t s = IR_SEGMENT_FIRST; s <= IR_SEGMENT_LAST; ++s) {
 		ir_type *type = get_segment_type(s);
 		init_entity_usage(type);
@@ -1185,10 +1571,81 @@ static void analyse_irp_globals_entity_usage(void)
 	}
 #endif /* DEBUG_libfirm */
 
+	invalidate_alias_caches();
 	/* now computed */
 	irp->globals_entity_usage_state = ir_entity_usage_computed;
 }
 
+/**
+ * Post-walker: collect the global entities addressed in a dirty graph.
+ */
+static void collect_dirty_entity(ir_node *irn, void *data)
+{
+	pset *entities = (pset*)data;
+	if (!is_SymConst_addr_ent(irn))
+		return;
+
+	ir_entity *entity = get_SymConst_entity(irn);
+	if (!is_global_entity(entity))
+		return;
+	add_entity_user(entity, get_irn_irg(irn));
+	pset_insert_ptr(entities, entity);
+}
+
+/**
+ * Post-walker: update the usage of the collected global entities.
+ */
+static void update_dirty_entity(ir_node *irn, void *data)
+{
+	pset *entities = (pset*)data;
+	if (!is_SymConst_addr_ent(irn))
+		return;
+
+	ir_entity *entity = get_SymConst_entity(irn);
+	if (pset_find_ptr(entities, entity) == NULL)
+		return;
+	unsigned flags = get_entity_usage(entity);
+	flags |= determine_entity_usage(irn, entity);
+	set_entity_usage(entity, (ir_entity_usage) flags);
+}
+
+/**
+ * Recompute the usage flags of the global entities addressed in the graphs
+ * that got new address users since the last update.
+ */
+static void update_irp_globals_entity_usage(void)
+{
+	pset *entities = pset_new_ptr_default();
+	foreach_pset(dirty_irgs, ir_graph, irg) {
+		irg_walk_graph(irg, NULL, collect_dirty_entity, entities);
+	}
+	del_pset(dirty_irgs);
+	dirty_irgs = pset_new_ptr_default();
+
+	pset *irgs = pset_new_ptr_default();
+	foreach_pset(entities, ir_entity, entity) {
+		entity_users_t *users = get_entity_users(entity);
+		ir_entity_usage flags = ir_usage_none;
+		if (entity_is_externally_visible(entity) || users->in_initializer)
+			flags = ir_usage_unknown;
+		set_entity_usage(entity, flags);
+
+		for (size_t i = 0, n = ARR_LEN(users->irgs); i < n; ++i)
+			pset_insert_ptr(irgs, users->irgs[i]);
+	}
+	DB((dbg, LEVEL_1, "updating usage of %zu entities in %zu graphs\n",
+	    pset_count(entities), pset_count(irgs)));
+
+	foreach_pset(irgs, ir_graph, irg) {
+		assure_irg_outs(irg);
+		irg_walk_graph(irg, NULL, update_dirty_entity, entities);
+	}
+	del_pset(irgs);
+	del_pset(entities);
+
+	invalidate_alias_caches();
+}
+
 ir_entity_usage_computed_state get_irp_globals_entity_usage_state(void)
 {
 	return irp->globals_entity_usage_state;
@@ -1197,14 +1654,17 @@ ir_entity_usage_computed_state get_irp_globals_entity_usage_state(void)
 void set_irp_globals_entity_usage_state(ir_entity_usage_computed_state state)
 {
 	irp->globals_entity_usage_state = state;
+	if (state == ir_entity_usage_not_computed)
+		free_entity_users();
 }
 
 void assure_irp_globals_entity_usage_computed(void)
 {
-	if (irp->globals_entity_usage_state != ir_entity_usage_not_computed)
-		return;
-
-	analyse_irp_globals_entity_usage();
+	if (irp->globals_entity_usage_state == ir_entity_usage_not_computed) {
+		analyse_irp_globals_entity_usage();
+	} else if (entity_users != NULL && pset_count(dirty_irgs) > 0) {
+		update_irp_globals_entity_usage();
+	}
 }
 
 void firm_init_memory_disambiguator(void)
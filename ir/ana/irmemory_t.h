@@ -12,9 +12,23 @@
 #ifndef FIRM_ANA_IRMEMORY_T_H
 #define FIRM_ANA_IRMEMORY_T_H
 
+#include "firm_types.h"
+#include "irmemory.h"
+
 /**
  * One-time inititialization of the memory< disambiguator.
  */
 void firm_init_memory_disambiguator(void);
 
+/**
+ * Frees the alias query cache of a graph.
+ */
+void free_irg_alias_cache(ir_graph *irg);
+
+/**
+ * Sets the disambiguator of the points-to analysis, which is asked after all
+ * other rules and the language specific disambiguator.
+ */
+void set_points_to_disambiguator(DISAMBIGUATOR_FUNC func);
+
 #endif
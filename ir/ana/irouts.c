@@ -10,7 +10,9 @@
  * @date     1.2002
  */
 #include "xmalloc.h"
-#include "irouts.h"
+#include "pagealloc.h"
+#include "irouts_t.h"
+#include "array.h"
 #include "irnode_t.h"
 #include "irgraph_t.h"
 #include "irprog_t.h"
@@ -18,22 +20,19 @@
 #include "error.h"
 #include "ircons.h"
 
-unsigned get_irn_n_outs(const ir_node *node)
+unsigned (get_irn_n_outs)(const ir_node *node)
 {
-	return node->o.out->n_edges;
+	return get_irn_n_outs_(node);
 }
 
-ir_node *get_irn_out(const ir_node *def, unsigned pos)
+ir_node *(get_irn_out)(const ir_node *def, unsigned pos)
 {
-	assert(pos < get_irn_n_outs(def));
-	return def->o.out->edges[pos].use;
+	return get_irn_out_(def, pos);
 }
 
-ir_node *get_irn_out_ex(const ir_node *def, unsigned pos, int *in_pos)
+ir_node *(get_irn_out_ex)(const ir_node *def, unsigned pos, int *in_pos)
 {
-	assert(pos < get_irn_n_outs(def));
-	*in_pos = def->o.out->edges[pos].pos;
-	return def->o.out->edges[pos].use;
+	return get_irn_out_ex_(def, pos, in_pos);
 }
 
 void set_irn_out(ir_node *def, unsigned pos, ir_node *use, int in_pos)
@@ -208,110 +207,94 @@ void irg_out_block_walk(ir_node *node, irg_walk_func *pre, irg_walk_func *post,
 	current_ir_graph = rem;
 }
 
-/*--------------------------------------------------------------------*/
-/** Building and Removing the out datastructure                      **/
-/**                                                                  **/
-/** The outs of a graph are allocated in a single, large array.      **/
-/** This allows to allocate and deallocate the memory for the outs   **/
-/** on demand.  The large array is separated into many small ones    **/
-/** for each node.  Only a single field to reference the out array   **/
-/** is stored in each node and a field referencing the large out     **/
-/** array in irgraph.  The 0 field of each out array contains the    **/
-/** size of this array.  This saves memory in the irnodes themselves.**/
-/** The construction does two passes over the graph.  The first pass **/
-/** counts the overall number of outs and the outs of each node.  It **/
-/** stores the outs of each node in the out reference of the node.   **/
-/** Then the large array is allocated.  The second iteration chops   **/
-/** the large array into smaller parts, sets the out edges and       **/
-/** recounts the out edges.                                          **/
-/*--------------------------------------------------------------------*/
-
-
-/** Returns the amount of out edges for not yet visited successors. */
-static void count_outs_node(ir_node *n)
+/*
+ * Building and removing the out datastructure:
+ *
+ * The outs of a graph are stored in compressed sparse row form: a single
+ * array holds the Def-Use edges of all nodes, each node references the
+ * start of its row, which begins with the number of edges in it.
+ * The construction first walks the graph to count the outs of each node and
+ * to collect the reachable nodes. Afterwards the rows are laid out and the
+ * edges are filled in by linear passes over the collected nodes.
+ */
+
+typedef struct outs_env_t {
+	ir_node **nodes;   /**< reachable nodes in walk order */
+	size_t    n_edges; /**< overall number of Def-Use edges */
+} outs_env_t;
+
+/** Counts the outs of @p n and all its not yet visited predecessors. */
+static void count_outs_node(ir_node *n, outs_env_t *env)
 {
 	if (irn_visited_else_mark(n))
 		return;
 
 	/* initialize our counter */
 	n->o.n_outs = 0;
+	ARR_APP1(ir_node*, env->nodes, n);
 
 	int start = is_Block(n) ? 0 : -1;
 	for (int i = start, irn_arity = get_irn_arity(n); i < irn_arity; ++i) {
 		ir_node *def = get_irn_n(n, i);
-		count_outs_node(def);
+		count_outs_node(def, env);
 		++def->o.n_outs;
 	}
+	env->n_edges += get_irn_arity(n) - start;
 }
 
-
-/** Returns the amount of out edges for not yet visited successors.
- *  This version handles some special nodes like irg_frame, irg_args etc. */
-static void count_outs(ir_graph *irg)
+void compute_irg_outs(ir_graph *irg)
 {
+	free_irg_outs(irg);
+
+	/* count the outs of all nodes reachable from End */
+	outs_env_t env;
+	env.nodes   = NEW_ARR_F(ir_node*, 0);
+	env.n_edges = 0;
 	inc_irg_visited(irg);
-	count_outs_node(get_irg_end(irg));
+	count_outs_node(get_irg_end(irg), &env);
+	size_t n_walked = ARR_LEN(env.nodes);
+
+	/* anchors not reachable from End have no outs */
 	for (int i = anchor_first; i <= anchor_last; ++i) {
 		ir_node *n = get_irg_anchor(irg, i);
 		if (irn_visited_else_mark(n))
 			continue;
 		n->o.n_outs = 0;
+		ARR_APP1(ir_node*, env.nodes, n);
 	}
-}
-
-static void set_out_edges_node(ir_node *node, struct obstack *obst)
-{
-	if (irn_visited_else_mark(node))
-		return;
-
-	/* Allocate my array */
-	unsigned n_outs = node->o.n_outs;
-	node->o.out          = OALLOCF(obst, ir_def_use_edges, edges, n_outs);
-	node->o.out->n_edges = 0;
-
-	/* add def->use edges from my predecessors to me */
-	int start = is_Block(node) ? 0 : -1;
-	for (int i = start, irn_arity = get_irn_arity(node); i < irn_arity; ++i) {
-		ir_node *def = get_irn_n(node, i);
-
-		/* recurse, ensures that out array of pred is already allocated */
-		set_out_edges_node(def, obst);
-
-		/* Remember this Def-Use edge */
-		unsigned pos = def->o.out->n_edges++;
-		def->o.out->edges[pos].use = node;
-		def->o.out->edges[pos].pos = i;
-	}
-}
 
-static void set_out_edges(ir_graph *irg)
-{
-	struct obstack *obst = &irg->out_obst;
-	obstack_init(obst);
-	irg->out_obst_allocated = true;
-
-	inc_irg_visited(irg);
-	set_out_edges_node(get_irg_end(irg), obst);
-	for (int i = anchor_first; i <= anchor_last; ++i) {
-		ir_node *n = get_irg_anchor(irg, i);
-		if (irn_visited_else_mark(n))
-			continue;
-		n->o.out          = OALLOCF(obst, ir_def_use_edges, edges, 0);
+	/* lay out the rows */
+	size_t n_nodes = ARR_LEN(env.nodes);
+	size_t size    = n_nodes * sizeof(ir_def_use_edges)
+	               + env.n_edges * sizeof(ir_def_use_edge);
+	bool   mapped  = irg->memory & IR_GRAPH_MEMORY_OUTS;
+	char  *row     = mapped
+		? (char*)page_alloc(size, irg->memory & IR_GRAPH_MEMORY_HUGE_PAGES)
+		: XMALLOCN(char, size);
+	irg->outs        = (ir_def_use_edges*)row;
+	irg->outs_size   = size;
+	irg->outs_mapped = mapped;
+	for (size_t i = 0; i < n_nodes; ++i) {
+		ir_node *n      = env.nodes[i];
+		unsigned n_outs = n->o.n_outs;
+		n->o.out          = (ir_def_use_edges*)row;
 		n->o.out->n_edges = 0;
+		row += sizeof(ir_def_use_edges) + n_outs * sizeof(ir_def_use_edge);
 	}
-}
-
-void compute_irg_outs(ir_graph *irg)
-{
-	free_irg_outs(irg);
-
-	/* This first iteration counts the overall number of out edges and the
-	   number of out edges for each node. */
-	count_outs(irg);
-
-	/* The second iteration splits the irg->outs array into smaller arrays
-	   for each node and writes the back edges into this array. */
-	set_out_edges(irg);
+	assert(row == (char*)irg->outs + size);
+
+	/* fill in the Def-Use edges */
+	for (size_t i = 0; i < n_walked; ++i) {
+		ir_node *n     = env.nodes[i];
+		int      start = is_Block(n) ? 0 : -1;
+		for (int p = start, irn_arity = get_irn_arity(n); p < irn_arity; ++p) {
+			ir_def_use_edges *out = get_irn_n(n, p)->o.out;
+			unsigned          pos = out->n_edges++;
+			out->edges[pos].use = n;
+			out->edges[pos].pos = p;
+		}
+	}
+	DEL_ARR_F(env.nodes);
 
 	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS);
 }
@@ -333,10 +316,13 @@ static void reset_outs(ir_node *node, void *unused)
 
 void free_irg_outs(ir_graph *irg)
 {
-	if (irg->out_obst_allocated) {
-		obstack_free(&irg->out_obst, NULL);
-		irg->out_obst_allocated = false;
-	}
+	if (irg->outs_mapped)
+		page_free(irg->outs, irg->outs_size);
+	else
+		free(irg->outs);
+	irg->outs        = NULL;
+	irg->outs_size   = 0;
+	irg->outs_mapped = false;
 
 #ifdef DEBUG_libfirm
 	/* when debugging, *always* reset all nodes' outs!  irg->outs might
@@ -0,0 +1,48 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief    Out edges (def-use edges) -- private datastructures.
+ */
+#ifndef FIRM_ANA_IROUTS_T_H
+#define FIRM_ANA_IROUTS_T_H
+
+#include "irouts.h"
+#include "irtypes.h"
+
+#define get_irn_n_outs(node)             get_irn_n_outs_(node)
+#define get_irn_out(def, pos)            get_irn_out_(def, pos)
+#define get_irn_out_ex(def, pos, in_pos) get_irn_out_ex_(def, pos, in_pos)
+
+static inline unsigned get_irn_n_outs_(const ir_node *node)
+{
+	return node->o.out->n_edges;
+}
+
+static inline ir_node *get_irn_out_(const ir_node *def, unsigned pos)
+{
+	assert(pos < get_irn_n_outs_(def));
+	return def->o.out->edges[pos].use;
+}
+
+static inline ir_node *get_irn_out_ex_(const ir_node *def, unsigned pos,
+                                       int *in_pos)
+{
+	assert(pos < get_irn_n_outs_(def));
+	*in_pos = def->o.out->edges[pos].pos;
+	return def->o.out->edges[pos].use;
+}
+
+/**
+ * Returns the packed Def-Use edges of @p def. The array must not be
+ * modified and is valid as long as the outs of the graph are.
+ */
+static inline const ir_def_use_edge *get_irn_outs(const ir_node *def)
+{
+	return def->o.out->edges;
+}
+
+#endif
@@ -0,0 +1,414 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief    Loop tree construction shared by the node, control flow and
+ *           callgraph loop analyses.
+ */
+#include "loopscc_t.h"
+
+#include "irloop_t.h"
+#include "array.h"
+#include "xmalloc.h"
+
+struct loop_scc_frame_t {
+	unsigned  node;    /**< the node visited */
+	unsigned  edge;    /**< the next input edge to visit */
+	unsigned  child;   /**< the input visited last, or LOOP_SCC_NO_NODE */
+	ir_loop  *close;   /**< the loop to close after the tail is visited */
+	bool      closing; /**< set if the node is done except for close */
+};
+
+void loop_scc_init(loop_scc_t *scc, const loop_scc_callbacks_t *cb,
+                   unsigned n_nodes, struct obstack *obst, bool reuse_loops)
+{
+	scc->cb           = cb;
+	scc->obst         = obst;
+	scc->nodes        = XMALLOCNZ(loop_scc_node_t, n_nodes);
+	scc->targets      = NEW_ARR_F(unsigned, 0);
+	scc->stack        = NEW_ARR_F(unsigned, 0);
+	scc->frames       = NEW_ARR_F(loop_scc_frame_t, 0);
+	scc->current_loop = alloc_loop(NULL, obst);
+	scc->current_dfn  = 1;
+	scc->last_node    = LOOP_SCC_NO_NODE;
+	scc->reuse_loops  = reuse_loops;
+}
+
+void loop_scc_add_node(loop_scc_t *scc, unsigned idx, void *node,
+                       int first_pos, bool may_head)
+{
+	loop_scc_node_t *n = &scc->nodes[idx];
+	n->node       = node;
+	n->first_edge = ARR_LEN(scc->targets);
+	n->n_edges    = 0;
+	n->first_pos  = first_pos;
+	n->may_head   = may_head;
+	scc->last_node = idx;
+}
+
+void loop_scc_add_edge(loop_scc_t *scc, unsigned target)
+{
+	ARR_APP1(unsigned, scc->targets, target);
+	++scc->nodes[scc->last_node].n_edges;
+}
+
+ir_loop *loop_scc_finish(loop_scc_t *scc)
+{
+	ir_loop *outermost = scc->current_loop;
+	assert(outermost == get_loop_outer_loop(outermost));
+	DEL_ARR_F(scc->frames);
+	DEL_ARR_F(scc->stack);
+	DEL_ARR_F(scc->targets);
+	free(scc->nodes);
+	return outermost;
+}
+
+/**
+ * Returns true if n is a loop head, i.e., it has inputs within the loop
+ * and out of the loop.
+ *
+ * @param root  only needed for assertion
+ */
+static bool is_head(const loop_scc_t *scc, unsigned n, unsigned root)
+{
+	const loop_scc_node_t *node            = &scc->nodes[n];
+	bool                   some_outof_loop = false;
+	bool                   some_in_loop    = false;
+	(void)root;
+
+	if (!node->may_head)
+		return false;
+	for (unsigned e = node->first_edge, end = e + node->n_edges; e < end; ++e) {
+		unsigned pred = scc->targets[e];
+		if (pred == LOOP_SCC_NO_NODE)
+			continue;
+		if (!scc->nodes[pred].in_stack) {
+			some_outof_loop = true;
+		} else {
+			assert(scc->nodes[pred].uplink >= scc->nodes[root].uplink);
+			some_in_loop = true;
+		}
+	}
+	return some_outof_loop && some_in_loop;
+}
+
+/**
+ * Returns true if n is a possible loop head of an endless loop, i.e., it
+ * has inputs within the loop only.
+ *
+ * @param root  only needed for assertion
+ */
+static bool is_endless_head(const loop_scc_t *scc, unsigned n, unsigned root)
+{
+	const loop_scc_node_t *node            = &scc->nodes[n];
+	bool                   none_outof_loop = true;
+	bool                   some_in_loop    = false;
+	(void)root;
+
+	if (!node->may_head)
+		return false;
+	for (unsigned e = node->first_edge, end = e + node->n_edges; e < end; ++e) {
+		unsigned pred = scc->targets[e];
+		if (pred == LOOP_SCC_NO_NODE)
+			continue;
+		if (!scc->nodes[pred].in_stack) {
+			none_outof_loop = false;
+		} else {
+			assert(scc->nodes[pred].uplink >= scc->nodes[root].uplink);
+			some_in_loop = true;
+		}
+	}
+	return none_outof_loop && some_in_loop;
+}
+
+/**
+ * Returns the input edge of n on the stack with the smallest dfn number
+ * greater-equal than limit, or LOOP_SCC_NO_NODE.
+ */
+static unsigned smallest_dfn_pred(const loop_scc_t *scc, unsigned n,
+                                  unsigned limit)
+{
+	const loop_scc_node_t *node  = &scc->nodes[n];
+	unsigned               index = LOOP_SCC_NO_NODE;
+	unsigned               min   = 0;
+
+	for (unsigned e = node->first_edge, end = e + node->n_edges; e < end; ++e) {
+		unsigned pred = scc->targets[e];
+		if (pred == LOOP_SCC_NO_NODE || !scc->nodes[pred].in_stack)
+			continue;
+		unsigned dfn = scc->nodes[pred].dfn;
+		if (dfn >= limit && (index == LOOP_SCC_NO_NODE || dfn < min)) {
+			index = e;
+			min   = dfn;
+		}
+	}
+	return index;
+}
+
+/**
+ * Returns the input edge of n on the stack with the largest dfn number, or
+ * LOOP_SCC_NO_NODE.
+ */
+static unsigned largest_dfn_pred(const loop_scc_t *scc, unsigned n)
+{
+	const loop_scc_node_t *node  = &scc->nodes[n];
+	unsigned               index = LOOP_SCC_NO_NODE;
+	unsigned               max   = 0;
+
+	for (unsigned e = node->first_edge, end = e + node->n_edges; e < end; ++e) {
+		unsigned pred = scc->targets[e];
+		if (pred == LOOP_SCC_NO_NODE || !scc->nodes[pred].in_stack)
+			continue;
+		/* dfn numbers are always > 0 */
+		unsigned dfn = scc->nodes[pred].dfn;
+		if (dfn > max) {
+			index = e;
+			max   = dfn;
+		}
+	}
+	return index;
+}
+
+/** Returns the backedge to use for the loop head m. */
+static unsigned head_pred(const loop_scc_t *scc, unsigned m)
+{
+	unsigned edge = smallest_dfn_pred(scc, m, scc->nodes[m].dfn + 1);
+	if (edge == LOOP_SCC_NO_NODE)
+		edge = largest_dfn_pred(scc, m);
+	return edge;
+}
+
+/**
+ * Searches the stack for possible loop heads. Tests these for backedges.
+ * If it finds a head with an unmarked backedge it marks this edge and
+ * returns the tail of the loop.
+ * If it finds no backedge returns LOOP_SCC_NO_NODE.
+ *
+ * @param n  A node where uplink == dfn.
+ */
+static unsigned find_tail(loop_scc_t *scc, unsigned n)
+{
+	const unsigned *stack = scc->stack;
+	size_t          tos   = ARR_LEN(stack);
+	unsigned        m     = stack[tos - 1];
+	unsigned        edge  = LOOP_SCC_NO_NODE;
+
+	if (is_head(scc, m, n)) {
+		edge = smallest_dfn_pred(scc, m, 0);
+		if (edge == LOOP_SCC_NO_NODE && m == n)
+			return LOOP_SCC_NO_NODE;
+	} else {
+		if (m == n)
+			return LOOP_SCC_NO_NODE;
+
+		bool endless = true;
+		for (size_t i = tos - 1; i-- > 0;) {
+			m = stack[i];
+			if (is_head(scc, m, n)) {
+				edge    = head_pred(scc, m);
+				endless = m == n && edge == LOOP_SCC_NO_NODE;
+				break;
+			}
+			/* We should not walk past our selves on the stack: The upcoming
+			 * nodes are not in this loop. We assume a loop not reachable
+			 * from Start. */
+			if (m == n)
+				break;
+		}
+
+		if (endless) {
+			/* A dead loop not reachable from Start. */
+			for (size_t i = tos - 1; i-- > 0;) {
+				m = stack[i];
+				if (is_endless_head(scc, m, n)) {
+					edge = head_pred(scc, m);
+					break;
+				}
+				/* It's not an unreachable loop, either. */
+				if (m == n)
+					break;
+			}
+		}
+	}
+
+	if (edge == LOOP_SCC_NO_NODE) {
+		assert(scc->cb->no_loop_head != NULL);
+		scc->cb->no_loop_head(scc->nodes[n].node);
+		return LOOP_SCC_NO_NODE;
+	}
+
+	const loop_scc_node_t *head = &scc->nodes[m];
+	unsigned               tail = scc->targets[edge];
+	scc->cb->set_backedge(head->node, head->first_pos + (int)(edge - head->first_edge));
+	scc->targets[edge] = LOOP_SCC_NO_NODE;
+	return tail;
+}
+
+/**
+ * Removes cfloops with no nodes in them. Such loops have only another loop
+ * as son.
+ */
+static void close_loop(loop_scc_t *scc, ir_loop *l)
+{
+	size_t       last     = get_loop_n_elements(l) - 1;
+	loop_element lelement = get_loop_element(l, last);
+	ir_loop     *last_son = lelement.son;
+
+	if (get_kind(last_son) == k_ir_loop && get_loop_n_elements(last_son) == 1) {
+		lelement = get_loop_element(last_son, 0);
+		ir_loop *gson = lelement.son;
+		if (get_kind(gson) == k_ir_loop) {
+			loop_element new_last_son;
+
+			gson->outer_loop = l;
+			new_last_son.son = gson;
+			l->children[last] = new_last_son;
+
+			/* the loop last_son is dead now, recover at least some memory */
+			DEL_ARR_F(last_son->children);
+		}
+	}
+
+	scc->current_loop = l;
+}
+
+/** Pushes n onto the stack and starts visiting it. */
+static void visit(loop_scc_t *scc, unsigned n)
+{
+	loop_scc_node_t *node = &scc->nodes[n];
+	node->dfn      = scc->current_dfn;
+	node->uplink   = scc->current_dfn;
+	node->in_stack = true;
+	++scc->current_dfn;
+	ARR_APP1(unsigned, scc->stack, n);
+
+	loop_scc_frame_t frame = { n, 0, LOOP_SCC_NO_NODE, NULL, false };
+	ARR_APP1(loop_scc_frame_t, scc->frames, frame);
+}
+
+/** Pops a node from the stack and returns it. */
+static unsigned pop(loop_scc_t *scc)
+{
+	size_t   tos = ARR_LEN(scc->stack) - 1;
+	unsigned n   = scc->stack[tos];
+	ARR_SHRINKLEN(scc->stack, tos);
+	scc->nodes[n].in_stack = false;
+	return n;
+}
+
+/**
+ * The nodes up to n belong to the current loop.
+ * Removes them from the stack and adds them to the current loop.
+ */
+static void pop_scc_to_loop(loop_scc_t *scc, unsigned n)
+{
+	unsigned m;
+	do {
+		m = pop(scc);
+		scc->cb->add_to_loop(scc->current_loop, scc->nodes[m].node);
+	} while (m != n);
+}
+
+/**
+ * Removes and unmarks all nodes up to n from the stack.
+ * The nodes must be visited once more to assign them to a scc.
+ */
+static void pop_scc_unmark_visit(loop_scc_t *scc, unsigned n)
+{
+	unsigned m;
+	do {
+		m = pop(scc);
+		scc->nodes[m].dfn = 0;
+	} while (m != n);
+}
+
+/** Propagates the uplink of the input m to n. */
+static void update_uplink(loop_scc_t *scc, loop_scc_node_t *node, unsigned m)
+{
+	const loop_scc_node_t *pred = &scc->nodes[m];
+	/* Uplink of m is smaller if n->m is a backedge. Propagate the uplink to
+	 * mark the loop. */
+	if (pred->in_stack && pred->uplink < node->uplink)
+		node->uplink = pred->uplink;
+}
+
+void loop_scc_walk(loop_scc_t *scc, unsigned root)
+{
+	if (scc->nodes[root].dfn != 0)
+		return;
+
+	visit(scc, root);
+	while (ARR_LEN(scc->frames) > 0) {
+		loop_scc_frame_t *frame = &scc->frames[ARR_LEN(scc->frames) - 1];
+		loop_scc_node_t  *node  = &scc->nodes[frame->node];
+
+		if (frame->closing) {
+			assert(node->dfn != 0);
+			if (frame->close != NULL)
+				close_loop(scc, frame->close);
+			ARR_SHRINKLEN(scc->frames, ARR_LEN(scc->frames) - 1);
+			continue;
+		}
+
+		if (frame->child != LOOP_SCC_NO_NODE) {
+			update_uplink(scc, node, frame->child);
+			frame->child = LOOP_SCC_NO_NODE;
+		}
+
+		/* visit the next unvisited input */
+		bool descended = false;
+		while (frame->edge < node->n_edges) {
+			unsigned m = scc->targets[node->first_edge + frame->edge++];
+			if (m == LOOP_SCC_NO_NODE)
+				continue;
+			if (scc->nodes[m].dfn == 0) {
+				frame->child = m;
+				visit(scc, m);
+				descended = true;
+				break;
+			}
+			update_uplink(scc, node, m);
+		}
+		if (descended)
+			continue;
+
+		unsigned n = frame->node;
+		if (node->dfn == node->uplink) {
+			/* This condition holds for
+			 * 1) the node with the incoming backedge.
+			 *    That is: We found a loop!
+			 * 2) Straight line code, because no uplink has been propagated,
+			 *    so the uplink still is the same as the dfn.
+			 *
+			 * But n might not be a proper loop head for the analysis.
+			 * find_tail() searches the stack for possible heads and takes
+			 * those nodes as loop heads for the current loop instead and
+			 * marks the incoming edge as backedge. */
+			unsigned tail = find_tail(scc, n);
+			if (tail != LOOP_SCC_NO_NODE) {
+				/* We have a loop: Open a new loop on the loop tree, unless the
+				 * current one is still empty, and search the loop once more
+				 * without the backedge to find inner loops. */
+				ir_loop *l = scc->current_loop;
+				if (!scc->reuse_loops || get_loop_n_elements(l) > 0
+				    || l == get_loop_outer_loop(l)) {
+					scc->current_loop = alloc_loop(l, scc->obst);
+					frame->close      = l;
+				}
+				frame->closing = true;
+
+				pop_scc_unmark_visit(scc, n);
+				if (scc->nodes[tail].dfn == 0)
+					visit(scc, tail);
+				continue;
+			}
+			/* No loop head was found, that is we have straight line code.
+			 * Pop all nodes from the stack to the current loop. */
+			pop_scc_to_loop(scc, n);
+		}
+		ARR_SHRINKLEN(scc->frames, ARR_LEN(scc->frames) - 1);
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief    Loop tree construction shared by the node, control flow and
+ *           callgraph loop analyses.
+ *
+ * The strongly connected regions are computed with the variation of the
+ * Tarjan algorithm described in [Trapp:99], Chapter 5.2.1.2: whenever a
+ * region is found, a loop head on the stack is chosen, one of its inputs is
+ * marked as backedge and the region is searched again for inner loops.
+ * The depth first search uses an explicit stack and all per node data is
+ * kept in arrays indexed by a dense node number, so neither the C stack nor
+ * link fields are used.
+ */
+#ifndef FIRM_ANA_LOOPSCC_T_H
+#define FIRM_ANA_LOOPSCC_T_H
+
+#include <stdbool.h>
+
+#include "firm_types.h"
+#include "obst.h"
+
+/** Marks an edge which is ignored, for example a Bad input. */
+#define LOOP_SCC_NO_NODE ((unsigned)-1)
+
+/** Callbacks of a loop tree construction. */
+typedef struct loop_scc_callbacks_t {
+	/** Adds a node to a loop. */
+	void (*add_to_loop)(ir_loop *loop, void *node);
+	/** Marks input @p pos of a node as backedge. */
+	void (*set_backedge)(void *node, int pos);
+	/**
+	 * Called for a region without a possible loop head, which happens in
+	 * dead code only. If NULL, such regions are not allowed.
+	 */
+	void (*no_loop_head)(void *node);
+} loop_scc_callbacks_t;
+
+/** Per node data of the construction. */
+typedef struct loop_scc_node_t {
+	void     *node;       /**< the client node */
+	unsigned  first_edge; /**< index of the first input edge */
+	unsigned  n_edges;    /**< number of input edges */
+	int       first_pos;  /**< input position of the first edge */
+	unsigned  dfn;        /**< depth first search number, 0 if not visited */
+	unsigned  uplink;     /**< smallest dfn reachable from this node */
+	bool      in_stack;   /**< set if the node is on the stack */
+	bool      may_head;   /**< set if the node may be a loop head */
+} loop_scc_node_t;
+
+/** A frame of the explicit depth first search stack. */
+typedef struct loop_scc_frame_t loop_scc_frame_t;
+
+/** The state of a loop tree construction. */
+typedef struct loop_scc_t {
+	const loop_scc_callbacks_t *cb;
+	struct obstack   *obst;         /**< obstack for the loops */
+	loop_scc_node_t  *nodes;        /**< node data, indexed by node number */
+	unsigned         *targets;      /**< edge targets, LOOP_SCC_NO_NODE for
+	                                     ignored edges and found backedges */
+	unsigned         *stack;        /**< the Tarjan node stack */
+	loop_scc_frame_t *frames;       /**< the depth first search stack */
+	ir_loop          *current_loop; /**< the loop the construction works on */
+	unsigned          current_dfn;  /**< next depth first search number */
+	unsigned          last_node;    /**< the node edges are added to */
+	bool              reuse_loops;  /**< reuse an empty current loop instead of
+	                                     opening a new one */
+} loop_scc_t;
+
+/**
+ * Initializes a loop tree construction and allocates the outermost loop.
+ *
+ * @param scc          the construction
+ * @param cb           the callbacks
+ * @param n_nodes      number of node numbers
+ * @param obst         obstack the loops are allocated on
+ * @param reuse_loops  if set, a loop is entered into the current loop
+ *                     instead of opening a new son, if the current loop is
+ *                     still empty and not the outermost one
+ */
+void loop_scc_init(loop_scc_t *scc, const loop_scc_callbacks_t *cb,
+                   unsigned n_nodes, struct obstack *obst, bool reuse_loops);
+
+/**
+ * Adds a node. Its input edges must be added directly afterwards.
+ *
+ * @param idx        the node number
+ * @param node       the client node
+ * @param first_pos  the input position of the first edge
+ * @param may_head   set if the node may become a loop head
+ */
+void loop_scc_add_node(loop_scc_t *scc, unsigned idx, void *node,
+                       int first_pos, bool may_head);
+
+/**
+ * Adds the next input edge of the last added node.
+ *
+ * @param target  the node number of the input, LOOP_SCC_NO_NODE to ignore
+ *                the input
+ */
+void loop_scc_add_edge(loop_scc_t *scc, unsigned target);
+
+/**
+ * Builds the loops of all nodes reachable from a root over input edges.
+ * Does nothing if the root has been visited already.
+ */
+void loop_scc_walk(loop_scc_t *scc, unsigned root);
+
+/**
+ * Frees the construction.
+ *
+ * @return the outermost loop, which is not matured yet
+ */
+ir_loop *loop_scc_finish(loop_scc_t *scc);
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 Karlsruhe Institute of Technology.
+ */
+
+/**
+ * @file
+ * @brief   Memory SSA: def-use chains per memory partition.
+ *
+ * The reaching access is found by walking the memory chain and skipping the
+ * operations which are transparent for the partition. The results are
+ * memoized for every memory value passed on the way, so later queries of the
+ * same partition stop at the first memory value already seen. This makes
+ * the walks of all queries of a partition linear in the length of the memory
+ * chain instead of quadratic.
+ */
+#include "memssa.h"
+
+#include <stdbool.h>
+
+#include "array.h"
+#include "hashptr.h"
+#include "irgraph_t.h"
+#include "irmemory.h"
+#include "irnode_t.h"
+#include "irnodemap.h"
+#include "pmap.h"
+#include "set.h"
+#include "typerep.h"
+#include "util.h"
+
+struct ir_memssa_t {
+	ir_graph   *irg;
+	ir_nodemap  partitions;  /**< partition + 1 of the memory operations */
+	pmap       *entity_part; /**< partitions of the entities */
+	bool       *is_local;    /**< partition is a frame entity */
+	set        *access;      /**< memoized reaching accesses */
+	bool        local_ents;  /**< frame entities get partitions */
+	bool        global_ents; /**< global entities get partitions */
+};
+
+/** A memoized reaching access. */
+typedef struct access_entry_t {
+	ir_node  *mem;    /**< the memory value */
+	unsigned  part;   /**< the partition */
+	ir_node  *access; /**< the reaching access of part at mem */
+} access_entry_t;
+
+static int cmp_access_entry(const void *a, const void *b, size_t size)
+{
+	const access_entry_t *ea = (const access_entry_t*)a;
+	const access_entry_t *eb = (const access_entry_t*)b;
+	(void)size;
+	return ea->mem != eb->mem || ea->part != eb->part;
+}
+
+static unsigned hash_access_entry(const ir_node *mem, unsigned part)
+{
+	return hash_combine(hash_irn(mem), part);
+}
+
+ir_memssa_t *memssa_new(ir_graph *irg)
+{
+	ir_memssa_t *ssa = XMALLOCZ(ir_memssa_t);
+	ssa->irg         = irg;
+	ssa->entity_part = pmap_create();
+	ssa->is_local    = NEW_ARR_F(bool, 1);
+	ssa->is_local[MEMSSA_REST] = false;
+	ssa->access      = new_set(cmp_access_entry, 64);
+	ssa->local_ents  = irg_has_properties(irg,
+			IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE);
+	ssa->global_ents = get_irp_globals_entity_usage_state()
+			== ir_entity_usage_computed;
+	ir_nodemap_init(&ssa->partitions, irg);
+	return ssa;
+}
+
+void memssa_free(ir_memssa_t *ssa)
+{
+	ir_nodemap_destroy(&ssa->partitions);
+	del_set(ssa->access);
+	DEL_ARR_F(ssa->is_local);
+	pmap_destroy(ssa->entity_part);
+	free(ssa);
+}
+
+void memssa_invalidate(ir_memssa_t *ssa)
+{
+	del_set(ssa->access);
+	ssa->access = new_set(cmp_access_entry, 64);
+}
+
+/**
+ * Returns the entity whose memory is accessed through @p ptr if it has a
+ * partition of its own, NULL else.
+ */
+static ir_entity *get_partition_entity(const ir_memssa_t *ssa, ir_node *ptr,
+                                       bool *is_local)
+{
+	for (;;) {
+		if (is_Sel(ptr)) {
+			ir_node *const base = get_Sel_ptr(ptr);
+			if (base == get_irg_frame(ssa->irg)) {
+				if (!ssa->local_ents)
+					return NULL;
+				*is_local = true;
+				return get_Sel_entity(ptr);
+			}
+			ptr = base;
+		} else if (is_Add(ptr)) {
+			ir_node *const left = get_Add_left(ptr);
+			ptr = mode_is_reference(get_irn_mode(left)) ? left
+			                                            : get_Add_right(ptr);
+		} else if (is_Sub(ptr)) {
+			ptr = get_Sub_left(ptr);
+		} else if (is_SymConst_addr_ent(ptr)) {
+			ir_entity *const entity = get_SymConst_entity(ptr);
+			if (!ssa->global_ents || is_method_entity(entity))
+				return NULL;
+			*is_local = false;
+			return entity;
+		} else {
+			return NULL;
+		}
+	}
+}
+
+static unsigned compute_partition(ir_memssa_t *ssa, ir_node *ptr)
+{
+	bool       is_local = false;
+	ir_entity *entity   = get_partition_entity(ssa, ptr, &is_local);
+	if (entity == NULL
+	    || (get_entity_usage(entity) & ir_usage_address_taken) != 0)
+		return MEMSSA_REST;
+
+	void *const part = pmap_get(void, ssa->entity_part, entity);
+	if (part != NULL)
+		return PTR_TO_INT(part);
+	unsigned const res = (unsigned)ARR_LEN(ssa->is_local);
+	ARR_APP1(bool, ssa->is_local, is_local);
+	pmap_insert(ssa->entity_part, entity, INT_TO_PTR(res));
+	return res;
+}
+
+unsigned memssa_get_partition(ir_memssa_t *ssa, const ir_node *node)
+{
+	ir_node *ptr;
+	switch (get_irn_opcode(node)) {
+	case iro_Load:  ptr = get_Load_ptr(node);  break;
+	case iro_Store: ptr = get_Store_ptr(node); break;
+	case iro_CopyB: ptr = get_CopyB_dst(node); break;
+	default:        return MEMSSA_REST;
+	}
+
+	void *const cached = ir_nodemap_get(void, &ssa->partitions, node);
+	if (cached != NULL)
+		return PTR_TO_INT(cached) - 1;
+	unsigned const part = compute_partition(ssa, ptr);
+	ir_nodemap_insert(&ssa->partitions, node, INT_TO_PTR(part + 1));
+	return part;
+}
+
+bool memssa_is_local(const ir_memssa_t *ssa, unsigned part)
+{
+	assert(part < ARR_LEN(ssa->is_local));
+	return ssa->is_local[part];
+}
+
+/**
+ * Returns non-zero if the call neither reads nor writes memory.
+ */
+static bool is_Call_pure(const ir_node *call)
+{
+	ir_type *call_tp = get_Call_type(call);
+	unsigned prop    = get_method_additional_properties(call_tp);
+
+	if ((prop & (mtp_property_const|mtp_property_pure)) == 0) {
+		ir_node *ptr = get_Call_ptr(call);
+		if (is_SymConst_addr_ent(ptr))
+			prop = get_entity_additional_properties(get_SymConst_entity(ptr));
+	}
+	return (prop & (mtp_property_const|mtp_property_pure)) != 0;
+}
+
+/**
+ * Returns the memory input of @p op if it neither reads nor writes partition
+ * @p part, NULL else.
+ */
+static ir_node *get_transparent_mem(ir_memssa_t *ssa, ir_node *op,
+                                    unsigned part)
+{
+	switch (get_irn_opcode(op)) {
+	case iro_Load:
+		if (get_Load_volatility(op) == volatility_is_volatile
+		    || memssa_get_partition(ssa, op) == part)
+			return NULL;
+		return get_Load_mem(op);
+
+	case iro_Store:
+		if (get_Store_volatility(op) == volatility_is_volatile
+		    || memssa_get_partition(ssa, op) == part)
+			return NULL;
+		return get_Store_mem(op);
+
+	case iro_CopyB:
+		if (memssa_get_partition(ssa, op) == part
+		    || compute_partition(ssa, get_CopyB_src(op)) == part)
+			return NULL;
+		return get_CopyB_mem(op);
+
+	case iro_Call:
+		/* a callee cannot access local entities whose address is not taken */
+		if (!ssa->is_local[part] && !is_Call_pure(op))
+			return NULL;
+		return get_Call_mem(op);
+
+	case iro_Div:
+		return get_Div_mem(op);
+
+	case iro_Mod:
+		return get_Mod_mem(op);
+
+	default:
+		return NULL;
+	}
+}
+
+ir_node *memssa_get_access(ir_memssa_t *ssa, ir_node *mem, unsigned part)
+{
+	assert(part < ARR_LEN(ssa->is_local));
+
+	ir_node **path = NEW_ARR_F(ir_node*, 0);
+	ir_node  *res;
+	for (;;) {
+		access_entry_t query;
+		query.mem  = mem;
+		query.part = part;
+		access_entry_t const *const entry = set_find(access_entry_t,
+				ssa->access, &query, sizeof(query),
+				hash_access_entry(mem, part));
+		if (entry != NULL) {
+			res = entry->access;
+			break;
+		}
+
+		ir_node *const op   = is_Proj(mem) ? get_Proj_pred(mem) : NULL;
+		ir_node *const next = op != NULL
+			? get_transparent_mem(ssa, op, part) : NULL;
+		ARR_APP1(ir_node*, path, mem);
+		if (next == NULL) {
+			res = mem;
+			break;
+		}
+		mem = next;
+	}
+
+	for (size_t i = 0, n = ARR_LEN(path); i < n; ++i) {
+		access_entry_t entry;
+		entry.mem    = path[i];
+		entry.part   = part;
+		entry.access = res;
+		(void)set_insert(access_entry_t, ssa->access, &entry, sizeof(entry),
+		                 hash_access_entry(entry.mem, part));
+	}
+	DEL_ARR_F(path);
+	return res;
+}
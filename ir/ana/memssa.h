@@ -0,0 +1,69 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 Karlsruhe Institute of Technology.
+ */
+
+/**
+ * @file
+ * @brief   Memory SSA: def-use chains per memory partition.
+ *
+ * The memory of a graph is partitioned into the entities whose address is
+ * never taken, each of which forms a partition of its own, and one partition
+ * for the rest of the memory. Each memory operation accesses exactly one
+ * partition. Instead of walking the single memory chain of the graph, the
+ * reaching access of a partition at a memory value skips all operations that
+ * neither read nor write the partition, so the memory chain of every
+ * partition is walked at most once.
+ */
+#ifndef FIRM_ANA_MEMSSA_H
+#define FIRM_ANA_MEMSSA_H
+
+#include <stdbool.h>
+
+#include "firm_types.h"
+
+/** The partition of all memory not in a partition of its own. */
+#define MEMSSA_REST 0
+
+typedef struct ir_memssa_t ir_memssa_t;
+
+/**
+ * Creates the memory partitions of a graph.
+ *
+ * Local entities get partitions of their own if the graph has
+ * IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE, global ones if the entity usage
+ * of the globals has been computed.
+ */
+ir_memssa_t *memssa_new(ir_graph *irg);
+
+/** Frees the memory SSA information. */
+void memssa_free(ir_memssa_t *ssa);
+
+/**
+ * Forgets the memoized reaching accesses. Must be called after the memory
+ * chains of the graph have been changed.
+ */
+void memssa_invalidate(ir_memssa_t *ssa);
+
+/**
+ * Returns the partition accessed by the memory operation @p node
+ * (a Load, Store or the destination of a CopyB), MEMSSA_REST for all other
+ * nodes.
+ */
+unsigned memssa_get_partition(ir_memssa_t *ssa, const ir_node *node);
+
+/**
+ * Returns whether partition @p part is a frame entity, which dies when the
+ * graph is left.
+ */
+bool memssa_is_local(const ir_memssa_t *ssa, unsigned part);
+
+/**
+ * Returns the reaching access of partition @p part at the memory value
+ * @p mem: The nearest memory value on the chain starting at @p mem which is
+ * produced by an operation that may read or write the partition, or a Phi,
+ * Sync or other memory value which is not the result of a memory operation.
+ */
+ir_node *memssa_get_access(ir_memssa_t *ssa, ir_node *mem, unsigned part);
+
+#endif
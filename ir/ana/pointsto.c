@@ -0,0 +1,958 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief    Interprocedural flow insensitive points-to analysis.
+ *
+ * The analysis computes for every pointer value of the program the set of
+ * abstract objects it may point to. Objects are entities (globals, frame
+ * variables, methods) and allocation sites (Alloc nodes and calls to
+ * functions with mtp_property_malloc). Every object has a content variable
+ * standing for the pointers stored in it; fields and array elements are not
+ * distinguished.
+ *
+ * The nodes of all graphs are translated into four kinds of constraints
+ *     p ⊇ {o}   (address)   p ⊇ q   (copy)
+ *     p ⊇ *q    (load)      *p ⊇ q  (store)
+ * which are solved either with Steensgaard's unification algorithm (fast,
+ * almost linear) or with Andersen's inclusion based algorithm (precise, using
+ * a worklist and raw bitsets as points-to sets).
+ *
+ * Code outside of the program is modelled by the object "unknown", whose
+ * content variable holds all escaped objects: Pointers passed to unknown
+ * code, stored into escaped objects or converted to integers escape, and
+ * pointers coming from unknown code point to "unknown", which may be any
+ * escaped object.
+ *
+ * Pointer arithmetic, Sel nodes and copies do not get variables of their own,
+ * they share the variable of the pointer they are based on.
+ */
+#include <assert.h>
+#include <stdbool.h>
+
+#include "adt/pmap.h"
+#include "adt/pset.h"
+#include "array.h"
+#include "debug.h"
+#include "error.h"
+#include "hashptr.h"
+#include "obst.h"
+#include "adt/pdeq.h"
+#include "raw_bitset.h"
+#include "set.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irhooks.h"
+#include "irmemory.h"
+#include "irmemory_t.h"
+#include "irnode_t.h"
+#include "irnodehashmap.h"
+#include "irprog_t.h"
+#include "tv.h"
+#include "typerep.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+/** no variable, no pointee */
+#define PT_NONE    ((unsigned)-1)
+/** the object standing for memory of unknown code */
+#define PT_UNKNOWN 0u
+
+typedef enum pt_constraint_kind_t {
+	PT_ADDR,  /**< dst ⊇ {src}, src is an object */
+	PT_COPY,  /**< dst ⊇ src */
+	PT_LOAD,  /**< dst ⊇ *src */
+	PT_STORE, /**< *dst ⊇ src */
+} pt_constraint_kind_t;
+
+typedef struct pt_constraint_t {
+	pt_constraint_kind_t kind;
+	unsigned             dst;
+	unsigned             src;
+} pt_constraint_t;
+
+/** Variables of the parameters and results of a method. */
+typedef struct pt_func_t {
+	unsigned first_param;
+	size_t   n_params;
+	unsigned first_result;
+	size_t   n_results;
+} pt_func_t;
+
+/** A variable of the Andersen solver. */
+typedef struct pt_var_t {
+	unsigned *pts;    /**< the points-to set */
+	unsigned *done;   /**< objects whose load and store edges exist */
+	unsigned *succs;  /**< copy edges, ARR_F */
+	unsigned *loads;  /**< destinations of loads through the var, ARR_F */
+	unsigned *stores; /**< sources of stores through the var, ARR_F */
+	bool      queued;
+} pt_var_t;
+
+typedef struct pt_edge_t {
+	unsigned from;
+	unsigned to;
+} pt_edge_t;
+
+static ir_points_to_precision precision;
+static bool                   computed = false;
+
+static struct obstack    obst;
+static ir_nodehashmap_t  node_vars;    /**< base pointer node -> var + 1 */
+static pmap             *entity_objs;  /**< entity -> object + 1 */
+static pmap             *site_objs;    /**< allocation site -> object + 1 */
+static pmap             *funcs;        /**< method entity -> pt_func_t */
+static pset             *taken_methods;/**< methods whose address is taken */
+static pset             *valid_irgs;   /**< graphs whose nodes are unchanged */
+static unsigned         *obj_contents; /**< content variable per object */
+static pt_constraint_t  *constraints;
+static unsigned          n_vars;
+static unsigned          unknown_content;
+
+/* results of Andersen's algorithm */
+static pt_var_t *vars;
+/* results of Steensgaard's algorithm */
+static unsigned *parent;
+static unsigned *pointee;
+static bool     *has_object;
+
+static hook_entry_t hook_dead_node_elim_entry;
+static hook_entry_t hook_free_graph_entry;
+
+static unsigned new_var(void)
+{
+	return n_vars++;
+}
+
+static unsigned new_object(void)
+{
+	unsigned const obj = ARR_LEN(obj_contents);
+	ARR_APP1(unsigned, obj_contents, new_var());
+	return obj;
+}
+
+static void add_constraint(pt_constraint_kind_t kind, unsigned dst,
+                           unsigned src)
+{
+	pt_constraint_t const c = { kind, dst, src };
+	ARR_APP1(pt_constraint_t, constraints, c);
+}
+
+/** The pointer escapes to unknown code. */
+static void add_escape(unsigned var)
+{
+	add_constraint(PT_COPY, unknown_content, var);
+}
+
+/** The pointer comes from unknown code. */
+static void add_unknown(unsigned var)
+{
+	add_constraint(PT_ADDR, var, PT_UNKNOWN);
+}
+
+static unsigned get_entity_object(ir_entity *entity)
+{
+	void *obj = pmap_get(void, entity_objs, entity);
+	if (obj != NULL)
+		return PTR_TO_INT(obj) - 1;
+	unsigned const res = new_object();
+	pmap_insert(entity_objs, entity, INT_TO_PTR(res + 1));
+	return res;
+}
+
+static unsigned get_site_object(const ir_node *site)
+{
+	void *obj = pmap_get(void, site_objs, site);
+	if (obj != NULL)
+		return PTR_TO_INT(obj) - 1;
+	unsigned const res = new_object();
+	pmap_insert(site_objs, site, INT_TO_PTR(res + 1));
+	return res;
+}
+
+static pt_func_t *get_func(ir_entity *entity)
+{
+	pt_func_t *func = pmap_get(pt_func_t, funcs, entity);
+	if (func != NULL)
+		return func;
+	ir_type *mtp = get_entity_type(entity);
+	func = OALLOC(&obst, pt_func_t);
+	func->n_params     = get_method_n_params(mtp);
+	func->first_param  = n_vars;
+	n_vars            += func->n_params;
+	func->n_results    = get_method_n_ress(mtp);
+	func->first_result = n_vars;
+	n_vars            += func->n_results;
+	pmap_insert(funcs, entity, func);
+	return func;
+}
+
+/**
+ * Skips the nodes computing a pointer from another one: Pointer arithmetic,
+ * Sel nodes (except for frame entities) and copies.
+ */
+static const ir_node *skip_pointer_copies(const ir_node *node)
+{
+	for (;;) {
+		const ir_node *next;
+		switch (get_irn_opcode(node)) {
+		case iro_Add:
+			next = get_Add_left(node);
+			if (!mode_is_reference(get_irn_mode(next)))
+				next = get_Add_right(node);
+			break;
+		case iro_Sub:
+			next = get_Sub_left(node);
+			break;
+		case iro_Sel:
+			next = get_Sel_ptr(node);
+			if (next == get_irg_frame(get_irn_irg(node)))
+				return node;
+			break;
+		case iro_Confirm:
+			next = get_Confirm_value(node);
+			break;
+		case iro_Pin:
+			next = get_Pin_op(node);
+			break;
+		case iro_Id:
+			next = get_Id_pred(node);
+			break;
+		case iro_Conv:
+			next = get_Conv_op(node);
+			break;
+		default:
+			return node;
+		}
+		if (!mode_is_reference(get_irn_mode(next)))
+			return node;
+		node = next;
+	}
+}
+
+static unsigned get_var(const ir_node *node)
+{
+	node = skip_pointer_copies(node);
+	void *var = ir_nodehashmap_get(void, &node_vars, node);
+	if (var != NULL)
+		return PTR_TO_INT(var) - 1;
+	unsigned const res = new_var();
+	ir_nodehashmap_insert(&node_vars, (ir_node*)node, INT_TO_PTR(res + 1));
+	return res;
+}
+
+static unsigned find_var(const ir_node *node)
+{
+	void *var = ir_nodehashmap_get(void, &node_vars, skip_pointer_copies(node));
+	return var != NULL ? (unsigned)PTR_TO_INT(var) - 1 : PT_NONE;
+}
+
+static bool is_pointer(const ir_node *node)
+{
+	return mode_is_reference(get_irn_mode(node));
+}
+
+/** Escapes all pointer operands of a node. */
+static void escape_operands(const ir_node *node)
+{
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		ir_node *pred = get_irn_n(node, i);
+		if (is_pointer(pred))
+			add_escape(get_var(pred));
+	}
+}
+
+/**
+ * Returns the number of possible callees of a call. If the callee is not known
+ * get_callee() returns NULL.
+ */
+static size_t get_n_callees(const ir_node *call)
+{
+	return Call_has_callees(call) ? get_Call_n_callees(call) : 1;
+}
+
+static ir_entity *get_callee(const ir_node *call, size_t pos)
+{
+	ir_entity *callee;
+	if (Call_has_callees(call)) {
+		callee = get_Call_callee(call, pos);
+	} else {
+		ir_node *ptr = get_Call_ptr(call);
+		if (!is_SymConst_addr_ent(ptr))
+			return NULL;
+		callee = get_SymConst_entity(ptr);
+	}
+	if (is_unknown_entity(callee) || get_entity_irg(callee) == NULL)
+		return NULL;
+	return callee;
+}
+
+static bool is_malloc_call(const ir_node *call)
+{
+	ir_node *ptr = get_Call_ptr(call);
+	return is_SymConst_addr_ent(ptr)
+	    && (get_entity_additional_properties(get_SymConst_entity(ptr))
+	        & mtp_property_malloc);
+}
+
+static void build_call(ir_node *call)
+{
+	int const n_args = get_Call_n_params(call);
+	for (size_t c = 0, n = get_n_callees(call); c < n; ++c) {
+		ir_entity *callee = get_callee(call, c);
+		pt_func_t *func   = callee != NULL ? get_func(callee) : NULL;
+		for (int i = 0; i < n_args; ++i) {
+			ir_node *arg = get_Call_param(call, i);
+			if (!is_pointer(arg))
+				continue;
+			if (func != NULL && (size_t)i < func->n_params) {
+				add_constraint(PT_COPY, func->first_param + i, get_var(arg));
+			} else {
+				add_escape(get_var(arg));
+			}
+		}
+	}
+}
+
+static void build_call_result(ir_node *proj, ir_node *call)
+{
+	unsigned const var = get_var(proj);
+	if (is_malloc_call(call)) {
+		add_constraint(PT_ADDR, var, get_site_object(call));
+		return;
+	}
+	unsigned const pos = get_Proj_proj(proj);
+	for (size_t c = 0, n = get_n_callees(call); c < n; ++c) {
+		ir_entity *callee = get_callee(call, c);
+		pt_func_t *func   = callee != NULL ? get_func(callee) : NULL;
+		if (func != NULL && pos < func->n_results) {
+			add_constraint(PT_COPY, var, func->first_result + pos);
+		} else {
+			add_unknown(var);
+		}
+	}
+}
+
+static void build_proj(ir_node *proj)
+{
+	ir_graph *irg  = get_irn_irg(proj);
+	ir_node  *pred = get_Proj_pred(proj);
+	unsigned  var  = get_var(proj);
+
+	if (proj == get_irg_frame(irg)) {
+		/* a pointer to any variable of the frame */
+		ir_type *frame = get_irg_frame_type(irg);
+		for (size_t i = 0, n = get_compound_n_members(frame); i < n; ++i) {
+			ir_entity *member = get_compound_member(frame, i);
+			add_constraint(PT_ADDR, var, get_entity_object(member));
+		}
+	} else if (pred == get_irg_args(irg)) {
+		pt_func_t *func = get_func(get_irg_entity(irg));
+		unsigned   pos  = get_Proj_proj(proj);
+		if (pos < func->n_params) {
+			add_constraint(PT_COPY, var, func->first_param + pos);
+		} else {
+			add_unknown(var);
+		}
+	} else if (is_Load(pred) && get_Proj_proj(proj) == pn_Load_res) {
+		add_constraint(PT_LOAD, var, get_var(get_Load_ptr(pred)));
+	} else if (is_Alloc(pred) && get_Proj_proj(proj) == pn_Alloc_res) {
+		add_constraint(PT_ADDR, var, get_site_object(pred));
+	} else if (is_Proj(pred) && get_Proj_proj(pred) == pn_Call_T_result
+	           && is_Call(get_Proj_pred(pred))) {
+		build_call_result(proj, get_Proj_pred(pred));
+	} else {
+		add_unknown(var);
+	}
+}
+
+/** Does a value of mode @p mode fit a pointer? */
+static bool may_hold_pointer(const ir_mode *mode)
+{
+	return get_mode_size_bits(mode) == get_mode_size_bits(mode_P);
+}
+
+/**
+ * Walker: translates a node into constraints.
+ */
+static void build_constraints(ir_node *node, void *env)
+{
+	(void)env;
+
+	/* methods whose address is taken can be called by anyone */
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		ir_node *pred = get_irn_n(node, i);
+		if (!is_SymConst_addr_ent(pred)
+		    || (is_Call(node) && i == n_Call_ptr))
+			continue;
+		ir_entity *entity = get_SymConst_entity(pred);
+		if (is_Method_type(get_entity_type(entity)))
+			pset_insert_ptr(taken_methods, entity);
+	}
+
+	switch (get_irn_opcode(node)) {
+	case iro_Load: {
+		/* pointers may be read as integers, too */
+		ir_mode *mode = get_Load_mode(node);
+		if (!mode_is_reference(mode) && may_hold_pointer(mode))
+			add_constraint(PT_LOAD, unknown_content,
+			               get_var(get_Load_ptr(node)));
+		return;
+	}
+	case iro_Store: {
+		ir_node *value = get_Store_value(node);
+		unsigned ptr   = get_var(get_Store_ptr(node));
+		if (is_pointer(value)) {
+			add_constraint(PT_STORE, ptr, get_var(value));
+		} else if (may_hold_pointer(get_irn_mode(value))) {
+			add_constraint(PT_STORE, ptr, unknown_content);
+		}
+		return;
+	}
+	case iro_CopyB: {
+		unsigned const tmp = new_var();
+		add_constraint(PT_LOAD, tmp, get_var(get_CopyB_src(node)));
+		add_constraint(PT_STORE, get_var(get_CopyB_dst(node)), tmp);
+		return;
+	}
+	case iro_Call:
+		build_call(node);
+		return;
+	case iro_Return: {
+		pt_func_t *func = get_func(get_irg_entity(get_irn_irg(node)));
+		for (size_t i = 0, n = get_Return_n_ress(node); i < n; ++i) {
+			ir_node *res = get_Return_res(node, i);
+			if (!is_pointer(res))
+				continue;
+			if (i < func->n_results) {
+				add_constraint(PT_COPY, func->first_result + i, get_var(res));
+			} else {
+				add_escape(get_var(res));
+			}
+		}
+		return;
+	}
+	case iro_Phi:
+		if (!is_pointer(node))
+			return;
+		for (int i = 0, n = get_Phi_n_preds(node); i < n; ++i) {
+			add_constraint(PT_COPY, get_var(node),
+			               get_var(get_Phi_pred(node, i)));
+		}
+		return;
+	case iro_Mux:
+		if (!is_pointer(node))
+			return;
+		add_constraint(PT_COPY, get_var(node), get_var(get_Mux_true(node)));
+		add_constraint(PT_COPY, get_var(node), get_var(get_Mux_false(node)));
+		return;
+	case iro_Conv: {
+		ir_node *op = get_Conv_op(node);
+		if (is_pointer(node) && !is_pointer(op)) {
+			add_unknown(get_var(node));
+		} else if (!is_pointer(node) && is_pointer(op)) {
+			add_escape(get_var(op));
+		}
+		return;
+	}
+	case iro_SymConst:
+		if (is_SymConst_addr_ent(node))
+			add_constraint(PT_ADDR, get_var(node),
+			               get_entity_object(get_SymConst_entity(node)));
+		return;
+	case iro_Sel:
+		if (get_Sel_ptr(node) == get_irg_frame(get_irn_irg(node)))
+			add_constraint(PT_ADDR, get_var(node),
+			               get_entity_object(get_Sel_entity(node)));
+		return;
+	case iro_Proj:
+		if (is_pointer(node))
+			build_proj(node);
+		return;
+	case iro_Const:
+		if (is_pointer(node) && !tarval_is_null(get_Const_tarval(node)))
+			add_unknown(get_var(node));
+		return;
+
+	/* nodes using pointers without letting them escape */
+	case iro_Add:
+	case iro_Sub:
+	case iro_Confirm:
+	case iro_Pin:
+	case iro_Id:
+	case iro_Cmp:
+	case iro_Free:
+	case iro_Block:
+	case iro_End:
+	case iro_Bad:
+	case iro_Sync:
+	case iro_Tuple:
+	case iro_Start:
+		return;
+
+	default:
+		escape_operands(node);
+		if (is_pointer(node))
+			add_unknown(get_var(node));
+		return;
+	}
+}
+
+/**
+ * Adds the addresses in an initializer to the content of an object.
+ */
+static void build_initializer(unsigned content, ir_initializer_t *initializer)
+{
+	switch (get_initializer_kind(initializer)) {
+	case IR_INITIALIZER_CONST: {
+		const ir_node *value = get_initializer_const_value(initializer);
+		if (!is_pointer(value))
+			return;
+		value = skip_pointer_copies(value);
+		if (is_SymConst_addr_ent(value)) {
+			ir_entity *entity = get_SymConst_entity(value);
+			if (is_Method_type(get_entity_type(entity)))
+				pset_insert_ptr(taken_methods, entity);
+			add_constraint(PT_ADDR, content, get_entity_object(entity));
+		} else if (!is_Const(value)) {
+			add_constraint(PT_ADDR, content, PT_UNKNOWN);
+		}
+		return;
+	}
+	case IR_INITIALIZER_TARVAL:
+	case IR_INITIALIZER_NULL:
+	case IR_INITIALIZER_BYTES:
+		return;
+	case IR_INITIALIZER_COMPOUND:
+		for (size_t i = 0, n = get_initializer_compound_n_entries(initializer);
+		     i < n; ++i) {
+			build_initializer(content,
+			                  get_initializer_compound_value(initializer, i));
+		}
+		return;
+	}
+	panic("invalid initializer found");
+}
+
+static void build_globals(void)
+{
+	for (ir_segment_t s = IR_SEGMENT_FIRST; s <= IR_SEGMENT_LAST; ++s) {
+		ir_type *segment = get_segment_type(s);
+		for (size_t i = 0, n = get_compound_n_members(segment); i < n; ++i) {
+			ir_entity *entity = get_compound_member(segment, i);
+			if (is_Method_type(get_entity_type(entity)))
+				continue;
+			unsigned const obj = get_entity_object(entity);
+			if (entity_is_externally_visible(entity))
+				add_constraint(PT_ADDR, unknown_content, obj);
+			if (has_entity_initializer(entity))
+				build_initializer(obj_contents[obj],
+				                  get_entity_initializer(entity));
+		}
+	}
+}
+
+/**
+ * Methods which can be called from unknown code get unknown arguments and
+ * let their results escape.
+ */
+static void build_entries(void)
+{
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_entity *entity = get_irg_entity(get_irp_irg(i));
+		if (!entity_is_externally_visible(entity)
+		    && !pset_find_ptr(taken_methods, entity))
+			continue;
+		pt_func_t *func = get_func(entity);
+		for (size_t p = 0; p < func->n_params; ++p)
+			add_constraint(PT_COPY, func->first_param + p, unknown_content);
+		for (size_t r = 0; r < func->n_results; ++r)
+			add_escape(func->first_result + r);
+	}
+}
+
+/*
+ * Andersen's algorithm
+ */
+
+static set  *edges;
+static pdeq *worklist;
+static size_t n_obj_elems;
+
+static int cmp_edge(const void *a, const void *b, size_t size)
+{
+	const pt_edge_t *ea = (const pt_edge_t*)a;
+	const pt_edge_t *eb = (const pt_edge_t*)b;
+	(void)size;
+	return ea->from != eb->from || ea->to != eb->to;
+}
+
+static void enqueue_var(unsigned var)
+{
+	if (vars[var].queued)
+		return;
+	vars[var].queued = true;
+	pdeq_putr(worklist, INT_TO_PTR(var));
+}
+
+/** pts(to) ⊇ pts(from) */
+static void propagate(unsigned from, unsigned to)
+{
+	unsigned *src     = vars[from].pts;
+	unsigned *dst     = vars[to].pts;
+	bool      changed = false;
+	for (size_t i = 0; i < n_obj_elems; ++i) {
+		unsigned const merged = dst[i] | src[i];
+		if (merged != dst[i]) {
+			dst[i]  = merged;
+			changed = true;
+		}
+	}
+	if (changed)
+		enqueue_var(to);
+}
+
+static void add_edge(unsigned from, unsigned to)
+{
+	if (from == to)
+		return;
+	pt_edge_t const edge = { from, to };
+	size_t    const size = set_count(edges);
+	(void)set_insert(pt_edge_t, edges, &edge, sizeof(edge),
+	                 hash_combine(from, to));
+	if (set_count(edges) == size)
+		return;
+	ARR_APP1(unsigned, vars[from].succs, to);
+	propagate(from, to);
+}
+
+static void solve_andersen(void)
+{
+	size_t const n_objects = ARR_LEN(obj_contents);
+	n_obj_elems = BITSET_SIZE_ELEMS(n_objects);
+
+	vars = OALLOCNZ(&obst, pt_var_t, n_vars);
+	for (unsigned v = 0; v < n_vars; ++v) {
+		vars[v].pts    = rbitset_obstack_alloc(&obst, n_objects);
+		vars[v].succs  = NEW_ARR_F(unsigned, 0);
+		vars[v].loads  = NEW_ARR_F(unsigned, 0);
+		vars[v].stores = NEW_ARR_F(unsigned, 0);
+	}
+	edges    = new_set(cmp_edge, 64);
+	worklist = new_pdeq();
+
+	for (size_t i = 0, n = ARR_LEN(constraints); i < n; ++i) {
+		pt_constraint_t const *c = &constraints[i];
+		switch (c->kind) {
+		case PT_ADDR:
+			rbitset_set(vars[c->dst].pts, c->src);
+			enqueue_var(c->dst);
+			break;
+		case PT_COPY:
+			add_edge(c->src, c->dst);
+			break;
+		case PT_LOAD:
+			ARR_APP1(unsigned, vars[c->src].loads, c->dst);
+			enqueue_var(c->src);
+			break;
+		case PT_STORE:
+			ARR_APP1(unsigned, vars[c->dst].stores, c->src);
+			enqueue_var(c->dst);
+			break;
+		}
+	}
+
+	unsigned long n_steps = 0;
+	while (!pdeq_empty(worklist)) {
+		unsigned const v   = PTR_TO_INT(pdeq_getl(worklist));
+		pt_var_t      *var = &vars[v];
+		var->queued = false;
+		++n_steps;
+
+		/* add the edges of loads and stores for new objects only */
+		if (ARR_LEN(var->loads) > 0 || ARR_LEN(var->stores) > 0) {
+			if (var->done == NULL)
+				var->done = rbitset_obstack_alloc(&obst, n_objects);
+			rbitset_foreach(var->pts, n_objects, obj) {
+				if (rbitset_is_set(var->done, obj))
+					continue;
+				rbitset_set(var->done, obj);
+				unsigned const content = obj_contents[obj];
+				for (size_t i = 0, n = ARR_LEN(var->loads); i < n; ++i)
+					add_edge(content, var->loads[i]);
+				for (size_t i = 0, n = ARR_LEN(var->stores); i < n; ++i)
+					add_edge(var->stores[i], content);
+			}
+		}
+		for (size_t i = 0, n = ARR_LEN(var->succs); i < n; ++i)
+			propagate(v, var->succs[i]);
+	}
+	DB((dbg, LEVEL_1, "andersen: %zu edges, %lu steps\n", set_count(edges),
+	    n_steps));
+
+	for (unsigned v = 0; v < n_vars; ++v) {
+		DEL_ARR_F(vars[v].succs);
+		DEL_ARR_F(vars[v].loads);
+		DEL_ARR_F(vars[v].stores);
+	}
+	del_pdeq(worklist);
+	del_set(edges);
+}
+
+static bool intersects(const unsigned *a, const unsigned *b)
+{
+	for (size_t i = 0; i < n_obj_elems; ++i) {
+		if (a[i] & b[i])
+			return true;
+	}
+	return false;
+}
+
+static ir_alias_relation andersen_alias_relation(unsigned var1, unsigned var2)
+{
+	const unsigned *pts1    = vars[var1].pts;
+	const unsigned *pts2    = vars[var2].pts;
+	const unsigned *escaped = vars[unknown_content].pts;
+	size_t const    n_objs  = ARR_LEN(obj_contents);
+	if (rbitset_is_empty(pts1, n_objs) || rbitset_is_empty(pts2, n_objs))
+		return ir_may_alias;
+	if (intersects(pts1, pts2))
+		return ir_may_alias;
+	/* a pointer from unknown code may point to any escaped object */
+	if (rbitset_is_set(pts1, PT_UNKNOWN) && intersects(pts2, escaped))
+		return ir_may_alias;
+	if (rbitset_is_set(pts2, PT_UNKNOWN) && intersects(pts1, escaped))
+		return ir_may_alias;
+	return ir_no_alias;
+}
+
+/*
+ * Steensgaard's algorithm
+ */
+
+static unsigned find_class(unsigned var)
+{
+	while (parent[var] != var) {
+		parent[var] = parent[parent[var]];
+		var         = parent[var];
+	}
+	return var;
+}
+
+static unsigned new_class(void)
+{
+	unsigned const c = ARR_LEN(parent);
+	ARR_APP1(unsigned, parent, c);
+	ARR_APP1(unsigned, pointee, PT_NONE);
+	ARR_APP1(bool, has_object, false);
+	return c;
+}
+
+/** Unifies two classes and, recursively, their pointees. */
+static void join(unsigned a, unsigned b)
+{
+	unsigned *pending = NEW_ARR_F(unsigned, 0);
+	for (;;) {
+		a = find_class(a);
+		b = find_class(b);
+		if (a != b) {
+			parent[b]      = a;
+			has_object[a] |= has_object[b];
+			unsigned const pa = pointee[a];
+			unsigned const pb = pointee[b];
+			if (pa == PT_NONE) {
+				pointee[a] = pb;
+			} else if (pb != PT_NONE) {
+				ARR_APP1(unsigned, pending, pa);
+				ARR_APP1(unsigned, pending, pb);
+			}
+		}
+		size_t const len = ARR_LEN(pending);
+		if (len == 0)
+			break;
+		a = pending[len - 2];
+		b = pending[len - 1];
+		ARR_SHRINKLEN(pending, len - 2);
+	}
+	DEL_ARR_F(pending);
+}
+
+static unsigned get_pointee(unsigned var)
+{
+	unsigned const c = find_class(var);
+	if (pointee[c] == PT_NONE) {
+		unsigned const p = new_class();
+		pointee[c] = p;
+		return p;
+	}
+	return find_class(pointee[c]);
+}
+
+static void solve_steensgaard(void)
+{
+	parent     = NEW_ARR_F(unsigned, 0);
+	pointee    = NEW_ARR_F(unsigned, 0);
+	has_object = NEW_ARR_F(bool, 0);
+	for (unsigned v = 0; v < n_vars; ++v)
+		new_class();
+	for (size_t o = 0, n = ARR_LEN(obj_contents); o < n; ++o)
+		has_object[obj_contents[o]] = true;
+
+	for (size_t i = 0, n = ARR_LEN(constraints); i < n; ++i) {
+		pt_constraint_t const *c = &constraints[i];
+		switch (c->kind) {
+		case PT_ADDR:
+			join(get_pointee(c->dst), obj_contents[c->src]);
+			break;
+		case PT_COPY:
+			join(get_pointee(c->dst), get_pointee(c->src));
+			break;
+		case PT_LOAD:
+			join(get_pointee(c->dst), get_pointee(get_pointee(c->src)));
+			break;
+		case PT_STORE:
+			join(get_pointee(get_pointee(c->dst)), get_pointee(c->src));
+			break;
+		}
+	}
+}
+
+static ir_alias_relation steensgaard_alias_relation(unsigned var1,
+                                                    unsigned var2)
+{
+	unsigned const p1 = pointee[find_class(var1)];
+	unsigned const p2 = pointee[find_class(var2)];
+	if (p1 == PT_NONE || p2 == PT_NONE)
+		return ir_may_alias;
+	unsigned const c1 = find_class(p1);
+	unsigned const c2 = find_class(p2);
+	if (c1 == c2 || !has_object[c1] || !has_object[c2])
+		return ir_may_alias;
+	return ir_no_alias;
+}
+
+/**
+ * The disambiguator registered with the memory disambiguator.
+ */
+static ir_alias_relation points_to_alias_relation(
+	const ir_node *adr1, const ir_mode *mode1,
+	const ir_node *adr2, const ir_mode *mode2)
+{
+	(void)mode1;
+	(void)mode2;
+	if (!pset_find_ptr(valid_irgs, get_irn_irg(adr1)))
+		return ir_may_alias;
+	/* nodes created after the analysis are unknown */
+	unsigned const var1 = find_var(adr1);
+	unsigned const var2 = find_var(adr2);
+	if (var1 == PT_NONE || var2 == PT_NONE)
+		return ir_may_alias;
+
+	return precision == ir_points_to_andersen
+	     ? andersen_alias_relation(var1, var2)
+	     : steensgaard_alias_relation(var1, var2);
+}
+
+/**
+ * Hook: the nodes of a graph are copied, so node pointers become invalid.
+ */
+static void forget_graph(void *ctx, ir_graph *irg)
+{
+	(void)ctx;
+	pset_remove_ptr(valid_irgs, irg);
+}
+
+static void forget_graph_dead_node_elim(void *ctx, ir_graph *irg, int start)
+{
+	if (start)
+		forget_graph(ctx, irg);
+}
+
+void free_points_to(void)
+{
+	if (!computed)
+		return;
+	computed = false;
+	set_points_to_disambiguator(NULL);
+	unregister_hook(hook_dead_node_elim, &hook_dead_node_elim_entry);
+	unregister_hook(hook_free_graph, &hook_free_graph_entry);
+
+	if (parent != NULL) {
+		DEL_ARR_F(parent);
+		DEL_ARR_F(pointee);
+		DEL_ARR_F(has_object);
+		parent     = NULL;
+		pointee    = NULL;
+		has_object = NULL;
+	}
+	vars = NULL;
+	DEL_ARR_F(obj_contents);
+	del_pset(valid_irgs);
+	ir_nodehashmap_destroy(&node_vars);
+	obstack_free(&obst, NULL);
+}
+
+void compute_points_to(ir_points_to_precision prec)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.ana.pointsto");
+
+	free_points_to();
+	precision = prec;
+
+	obstack_init(&obst);
+	ir_nodehashmap_init(&node_vars);
+	entity_objs   = pmap_create();
+	site_objs     = pmap_create();
+	funcs         = pmap_create();
+	taken_methods = pset_new_ptr_default();
+	valid_irgs    = pset_new_ptr_default();
+	obj_contents  = NEW_ARR_F(unsigned, 0);
+	constraints   = NEW_ARR_F(pt_constraint_t, 0);
+	n_vars        = 0;
+
+	unsigned const unknown = new_object();
+	assert(unknown == PT_UNKNOWN);
+	unknown_content = obj_contents[unknown];
+	/* unknown code may point to, load from and store to escaped objects */
+	add_constraint(PT_ADDR, unknown_content, PT_UNKNOWN);
+	add_constraint(PT_LOAD, unknown_content, unknown_content);
+	add_constraint(PT_STORE, unknown_content, unknown_content);
+
+	build_globals();
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		irg_walk_graph(irg, NULL, build_constraints, NULL);
+		pset_insert_ptr(valid_irgs, irg);
+	}
+	build_entries();
+
+	DB((dbg, LEVEL_1, "%u variables, %zu objects, %zu constraints\n", n_vars,
+	    ARR_LEN(obj_contents), ARR_LEN(constraints)));
+
+	if (precision == ir_points_to_andersen) {
+		solve_andersen();
+	} else {
+		solve_steensgaard();
+	}
+
+	DEL_ARR_F(constraints);
+	del_pset(taken_methods);
+	pmap_destroy(funcs);
+	pmap_destroy(site_objs);
+	pmap_destroy(entity_objs);
+
+	hook_dead_node_elim_entry.hook._hook_dead_node_elim
+		= forget_graph_dead_node_elim;
+	register_hook(hook_dead_node_elim, &hook_dead_node_elim_entry);
+	hook_free_graph_entry.hook._hook_free_graph = forget_graph;
+	register_hook(hook_free_graph, &hook_free_graph_entry);
+
+	computed = true;
+	set_points_to_disambiguator(points_to_alias_relation);
+}
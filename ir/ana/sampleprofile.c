@@ -0,0 +1,331 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Execution frequencies from sampled (AutoFDO) profiles.
+ *
+ * The profile is the text form of an AutoFDO sample profile as produced by
+ * create_llvm_prof from perf LBR samples of an optimized binary:
+ *
+ *     function:total_samples:head_samples
+ *      line_offset[.discriminator]: samples [callee:calls ...]
+ *      line_offset[.discriminator]: callee:total_samples
+ *       ...
+ *
+ * Line offsets are relative to the line of the function entity. The tool maps
+ * the sampled addresses to source lines with the debug information of the
+ * binary, we map them back to blocks with the dbg_info of the nodes: The
+ * count of a block is the maximum count of the lines of its nodes. Records of
+ * inlined callees are indented deeper and are skipped, as are discriminators
+ * which our debug info cannot distinguish.
+ */
+#include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "dbginfo.h"
+#include "hashptr.h"
+#include "set.h"
+#include "util.h"
+#include "xmalloc.h"
+
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "typerep.h"
+
+#include "execfreq_t.h"
+
+/** minimum frequency of blocks without samples */
+#define MIN_EXECFREQ 0.00001
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+/** Samples of a function. */
+typedef struct sample_func_t {
+	ident   *name;  /**< linker name of the function */
+	uint64_t total; /**< total samples in the function */
+	uint64_t head;  /**< samples at the function entry */
+} sample_func_t;
+
+/** Samples of a source line in a function. */
+typedef struct sample_line_t {
+	ident   *func;   /**< linker name of the function */
+	unsigned offset; /**< line offset to the function line */
+	uint64_t count;  /**< sample count */
+} sample_line_t;
+
+static set *sample_funcs = NULL;
+static set *sample_lines = NULL;
+
+static int cmp_sample_func(const void *a, const void *b, size_t size)
+{
+	const sample_func_t *fa = (const sample_func_t*)a;
+	const sample_func_t *fb = (const sample_func_t*)b;
+	(void)size;
+	return fa->name != fb->name;
+}
+
+static int cmp_sample_line(const void *a, const void *b, size_t size)
+{
+	const sample_line_t *la = (const sample_line_t*)a;
+	const sample_line_t *lb = (const sample_line_t*)b;
+	(void)size;
+	return la->func != lb->func || la->offset != lb->offset;
+}
+
+static unsigned hash_sample_line(const sample_line_t *line)
+{
+	return hash_combine(hash_ptr(line->func), line->offset);
+}
+
+static sample_func_t *find_sample_func(ident *name)
+{
+	sample_func_t query;
+	query.name = name;
+	return set_find(sample_func_t, sample_funcs, &query, sizeof(query),
+	                hash_ptr(name));
+}
+
+static uint64_t get_line_count(ident *func, unsigned offset)
+{
+	sample_line_t query;
+	query.func   = func;
+	query.offset = offset;
+	sample_line_t *line = set_find(sample_line_t, sample_lines, &query,
+	                               sizeof(query), hash_sample_line(&query));
+	return line != NULL ? line->count : 0;
+}
+
+static bool has_line(ident *func, unsigned offset)
+{
+	sample_line_t query;
+	query.func   = func;
+	query.offset = offset;
+	return set_find(sample_line_t, sample_lines, &query, sizeof(query),
+	                hash_sample_line(&query)) != NULL;
+}
+
+/**
+ * Parses a function header "name:total:head". The name may contain colons.
+ */
+static ident *parse_func_header(char *buf)
+{
+	char *head_sep = strrchr(buf, ':');
+	if (head_sep == NULL || head_sep == buf)
+		return NULL;
+	*head_sep = '\0';
+	char *total_sep = strrchr(buf, ':');
+	if (total_sep == NULL || total_sep == buf)
+		return NULL;
+	*total_sep = '\0';
+
+	sample_func_t func;
+	func.name  = new_id_from_str(buf);
+	func.total = 0;
+	func.head  = 0;
+	sample_func_t *entry = set_insert(sample_func_t, sample_funcs, &func,
+	                                  sizeof(func), hash_ptr(func.name));
+	/* the same function may be listed several times in merged profiles */
+	entry->total += strtoull(total_sep + 1, NULL, 10);
+	entry->head  += strtoull(head_sep + 1, NULL, 10);
+	return func.name;
+}
+
+/**
+ * Parses a body line "offset[.discriminator]: samples [callee:calls ...]".
+ * Inlined callsites "offset: callee:samples" are ignored.
+ */
+static void parse_body_line(ident *func, const char *buf)
+{
+	char    *end;
+	unsigned offset = (unsigned)strtoul(buf, &end, 10);
+	if (end == buf)
+		return;
+	if (*end == '.')
+		strtoul(end + 1, &end, 10);
+	if (*end != ':')
+		return;
+	const char *p = end + 1;
+	while (*p == ' ')
+		++p;
+	uint64_t const count = strtoull(p, &end, 10);
+	if (end == p || *end == ':')
+		return;
+
+	sample_line_t line;
+	line.func   = func;
+	line.offset = offset;
+	line.count  = 0;
+	sample_line_t *entry = set_insert(sample_line_t, sample_lines, &line,
+	                                  sizeof(line), hash_sample_line(&line));
+	entry->count = MAX(entry->count, count);
+}
+
+void ir_sample_profile_free(void)
+{
+	if (sample_lines != NULL) {
+		del_set(sample_lines);
+		sample_lines = NULL;
+	}
+	if (sample_funcs != NULL) {
+		del_set(sample_funcs);
+		sample_funcs = NULL;
+	}
+}
+
+int ir_sample_profile_read(const char *filename)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.ana.sampleprofile");
+
+	FILE *f = fopen(filename, "r");
+	if (f == NULL) {
+		DB((dbg, LEVEL_1, "Failed to open sample profile (%s)\n", filename));
+		return false;
+	}
+
+	ir_sample_profile_free();
+	sample_funcs = new_set(cmp_sample_func, 16);
+	sample_lines = new_set(cmp_sample_line, 64);
+
+	ident *func = NULL;
+	char   buf[1024];
+	while (fgets(buf, sizeof(buf), f) != NULL) {
+		size_t len = strlen(buf);
+		while (len > 0 && isspace((unsigned char)buf[len - 1]))
+			buf[--len] = '\0';
+		if (len == 0)
+			continue;
+
+		unsigned depth = 0;
+		while (buf[depth] == ' ')
+			++depth;
+		if (depth == 0) {
+			func = parse_func_header(buf);
+			if (func == NULL)
+				DB((dbg, LEVEL_1, "Malformed function record: %s\n", buf));
+		} else if (depth == 1 && func != NULL) {
+			parse_body_line(func, buf + depth);
+		}
+	}
+	fclose(f);
+
+	DB((dbg, LEVEL_1, "Read samples of %zu functions from %s\n",
+	    set_count(sample_funcs), filename));
+	return true;
+}
+
+typedef struct sample_walk_env_t {
+	ident    *func;       /**< linker name of the graph */
+	unsigned  first_line; /**< line of the function */
+	uint64_t *counts;     /**< sample count per block index */
+	bool     *has_line;   /**< at least one line of the block is listed */
+	ir_node **blocks;     /**< the blocks by index */
+	unsigned  n_blocks;
+} sample_walk_env_t;
+
+static void number_block(ir_node *block, void *data)
+{
+	sample_walk_env_t *env = (sample_walk_env_t*)data;
+	set_irn_link(block, INT_TO_PTR(env->n_blocks));
+	++env->n_blocks;
+}
+
+static void collect_block(ir_node *block, void *data)
+{
+	sample_walk_env_t *env = (sample_walk_env_t*)data;
+	env->blocks[PTR_TO_INT(get_irn_link(block))] = block;
+}
+
+static void collect_node_samples(ir_node *node, void *data)
+{
+	sample_walk_env_t *env = (sample_walk_env_t*)data;
+	if (is_Block(node))
+		return;
+	dbg_info *dbgi = get_irn_dbg_info(node);
+	if (dbgi == NULL)
+		return;
+	src_loc_t const loc = ir_retrieve_dbg_info(dbgi);
+	if (loc.line < env->first_line)
+		return;
+
+	unsigned const offset = loc.line - env->first_line;
+	if (!has_line(env->func, offset))
+		return;
+	unsigned const idx = PTR_TO_INT(get_irn_link(get_nodes_block(node)));
+	env->has_line[idx] = true;
+	env->counts[idx]   = MAX(env->counts[idx],
+	                         get_line_count(env->func, offset));
+}
+
+int ir_sample_profile_apply(ir_graph *irg)
+{
+	if (sample_funcs == NULL)
+		return false;
+
+	ir_entity     *entity = get_irg_entity(irg);
+	sample_func_t *func   = find_sample_func(get_entity_ld_ident(entity));
+	dbg_info      *dbgi   = get_entity_dbg_info(entity);
+	if (func == NULL || func->total == 0 || dbgi == NULL)
+		return false;
+	src_loc_t const loc = ir_retrieve_dbg_info(dbgi);
+	if (loc.line == 0)
+		return false;
+
+	/* blocks without line info keep the estimated frequencies */
+	ir_estimate_execfreq(irg);
+
+	sample_walk_env_t env;
+	env.func       = func->name;
+	env.first_line = loc.line;
+	env.n_blocks   = 0;
+
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
+	irg_block_walk_graph(irg, number_block, NULL, &env);
+	env.counts   = XMALLOCNZ(uint64_t, env.n_blocks);
+	env.has_line = XMALLOCNZ(bool, env.n_blocks);
+	env.blocks   = XMALLOCN(ir_node*, env.n_blocks);
+	irg_block_walk_graph(irg, collect_block, NULL, &env);
+	irg_walk_graph(irg, NULL, collect_node_samples, &env);
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
+
+	/* the head samples count the calls, the samples of the start block are
+	 * the next best thing when the profile has no entry counts */
+	ir_node *const start_block = get_irg_start_block(irg);
+	ir_node *const end_block   = get_irg_end_block(irg);
+	uint64_t entry = func->head;
+	if (entry == 0) {
+		for (unsigned i = 0; i < env.n_blocks; ++i) {
+			if (env.blocks[i] == start_block)
+				entry = env.counts[i];
+		}
+	}
+
+	bool const applied = entry != 0;
+	if (applied) {
+		double const factor = 1.0 / entry;
+		for (unsigned i = 0; i < env.n_blocks; ++i) {
+			ir_node *block = env.blocks[i];
+			if (!env.has_line[i] || block == start_block || block == end_block)
+				continue;
+			double freq = env.counts[i] * factor;
+			if (freq < MIN_EXECFREQ)
+				freq = MIN_EXECFREQ;
+			DB((dbg, LEVEL_2, "%+F: %" PRIu64 " samples, freq %g\n", block,
+			    env.counts[i], freq));
+			set_block_execfreq(block, freq);
+		}
+		set_block_execfreq(start_block, 1.0);
+	}
+
+	free(env.blocks);
+	free(env.has_line);
+	free(env.counts);
+	return applied;
+}
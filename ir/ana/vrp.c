@@ -21,14 +21,13 @@
 #include "pdeq.h"
 #include "irnodemap.h"
 #include "irhooks.h"
-#include "bitset.h"
+#include "constbits.h"
 #include "debug.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
 typedef struct vrp_env_t {
-	waitq       *workqueue;
-	bitset_t    *visited;
+	pdeq        *workqueue;
 	ir_vrp_info *info;
 } vrp_env_t;
 
@@ -462,22 +461,62 @@ static int vrp_update_node(ir_vrp_info *info, ir_node *node)
 	return something_changed;
 }
 
-static void vrp_first_pass(ir_node *n, void *e)
+/**
+ * Updates the known bits and the range of a node, returns true if either
+ * changed.
+ */
+static bool update_node(ir_vrp_info *info, ir_node *node)
+{
+	bool changed = constbits_transfer(node);
+	if (!is_Block(node))
+		changed |= vrp_update_node(info, node) != 0;
+	return changed;
+}
+
+static void vrp_first_round(ir_node *node, void *e)
+{
+	vrp_env_t *env = (vrp_env_t*)e;
+
+	update_node(env->info, node);
+	/* Phis and Blocks need another round if some of their inputs were not
+	 * known yet, i.e. in loops */
+	if (is_Phi(node) || is_Block(node))
+		pdeq_putr(env->workqueue, node);
+}
+
+/**
+ * Folds the known bits computed by constbits into the vrp information once
+ * both reached their fixpoint. Constbits starts optimistic, so its
+ * intermediate results must not flow into the pessimistic vrp lattice.
+ */
+static void merge_constbits(ir_node *node, void *e)
 {
-	if (is_Block(n))
+	vrp_env_t *env = (vrp_env_t*)e;
+	ir_mode   *mode = get_irn_mode(node);
+	if (is_Block(node) || !mode_is_int(mode))
 		return;
 
-	vrp_env_t *env = (vrp_env_t*) e;
-	bitset_set(env->visited, get_irn_idx(n));
+	/* nodes in unreachable blocks have meaningless bits */
+	bitinfo const *const block_bits = get_bitinfo(get_nodes_block(node));
+	if (block_bits == NULL || block_bits->z != get_tarval_b_true())
+		return;
 
-	vrp_update_node(env->info, n);
+	bitinfo const *const bits = get_bitinfo(node);
+	if (bits == NULL || get_tarval_mode(bits->z) != mode)
+		return;
 
-	for (int i = get_irn_n_outs(n); i-- > 0; ) {
-		ir_node *succ = get_irn_out(n, i);
-		if (bitset_is_set(env->visited, get_irn_idx(succ))) {
-			/* we found a loop*/
-			waitq_put(env->workqueue, succ);
-		}
+	vrp_attr *vrp = vrp_get_or_set_info(env->info, node);
+	if (get_tarval_mode(vrp->bits_set) != mode)
+		return;
+	vrp->bits_set     = tarval_or(vrp->bits_set, bits->o);
+	vrp->bits_not_set = tarval_and(vrp->bits_not_set, bits->z);
+	assert(tarval_is_null(tarval_andnot(vrp->bits_set, vrp->bits_not_set)));
+
+	/* a constant is the tightest range */
+	if (vrp->bits_set == vrp->bits_not_set) {
+		vrp->range_type   = VRP_RANGE;
+		vrp->range_bottom = vrp->bits_set;
+		vrp->range_top    = vrp->bits_set;
 	}
 }
 
@@ -509,7 +548,9 @@ void set_vrp_data(ir_graph *irg)
 
 	FIRM_DBG_REGISTER(dbg, "ir.ana.vrp");
 
-	assure_irg_outs(irg); /* ensure that out edges are consistent*/
+	assure_irg_properties(irg,
+		IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		| IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
 	ir_nodemap_init(&irg->vrp.infos, irg);
 	obstack_init(&irg->vrp.obst);
 	ir_vrp_info *info = &irg->vrp;
@@ -519,27 +560,32 @@ void set_vrp_data(ir_graph *irg)
 		register_hook(hook_node_info, &dump_hook);
 	}
 
-	vrp_env_t *env = OALLOCZ(&irg->vrp.obst, vrp_env_t);
-	env->workqueue = new_waitq();
-	env->info      = info;
+	/* The known bits of constbits and the ranges are computed in one
+	 * worklist iteration over the SSA edges: a node is revisited when the
+	 * known bits or the range of one of its operands changed. */
+	struct obstack bits_obst;
+	obstack_init(&bits_obst);
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	constbits_init(irg, &bits_obst);
 
-	env->visited = bitset_malloc(get_irg_last_idx(irg));
-	irg_walk_graph(irg, NULL, vrp_first_pass, env);
-	free(env->visited);
+	vrp_env_t env;
+	env.workqueue = new_pdeq();
+	env.info      = info;
+
+	irg_walk_blkwise_dom_top_down(irg, NULL, vrp_first_round, &env);
 
 	/* while there are entries in the worklist, continue*/
-	while (!waitq_empty(env->workqueue)) {
-		ir_node *node = (ir_node*) waitq_get(env->workqueue);
-
-		if (vrp_update_node(info, node)) {
-			/* if something changed, add successors to worklist*/
-			for (int i = get_irn_n_outs(node); i-- > 0; ) {
-				ir_node *succ =  get_irn_out(node, i);
-				waitq_put(env->workqueue, succ);
-			}
-		}
+	while (!pdeq_empty(env.workqueue)) {
+		ir_node *node = (ir_node*)pdeq_getl(env.workqueue);
+		if (update_node(info, node))
+			constbits_queue_users(env.workqueue, node);
 	}
-	del_waitq(env->workqueue);
+	del_pdeq(env.workqueue);
+
+	irg_walk_graph(irg, NULL, merge_constbits, &env);
+
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	obstack_free(&bits_obst, NULL);
 }
 
 void free_vrp_data(ir_graph *irg)
@@ -233,7 +233,7 @@ static void TEMPLATE_emit_block(ir_node *block)
 {
 	be_gas_begin_block(block, true);
 
-	sched_foreach(block, node) {
+	sched_foreach_frozen(block, node) {
 		be_emit_node(node);
 	}
 }
@@ -265,6 +265,7 @@ void TEMPLATE_emit_function(ir_graph *irg)
 
 	/* create the block schedule */
 	block_schedule = be_create_block_schedule(irg);
+	sched_freeze(irg);
 
 	/* emit assembler prolog */
 	be_gas_emit_function_prolog(entity, 4, NULL);
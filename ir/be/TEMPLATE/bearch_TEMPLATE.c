@@ -121,9 +121,13 @@ static TEMPLATE_isa_t TEMPLATE_isa_template = {
 		2,                           /* power of two stack alignment for calls, 2^2 == 4 */
 		7,                           /* costs for a spill instruction */
 		5,                           /* costs for a reload instruction */
+		NULL,                        /* machine model of the scheduler */
+		false,                       /* no JIT support */
 	},
 };
 
+static ir_type *between_type = NULL;
+
 static void TEMPLATE_init(void)
 {
 	TEMPLATE_register_init();
@@ -132,6 +136,7 @@ static void TEMPLATE_init(void)
 
 static void TEMPLATE_finish(void)
 {
+	between_type = NULL;
 	TEMPLATE_free_opcodes();
 }
 
@@ -158,11 +163,10 @@ static void TEMPLATE_end_codegeneration(void *self)
  */
 static ir_type *TEMPLATE_get_between_type(ir_graph *irg)
 {
-	static ir_type *between_type = NULL;
-	static ir_entity *old_bp_ent = NULL;
 	(void) irg;
 
 	if (!between_type) {
+		ir_entity *old_bp_ent;
 		ir_entity *ret_addr_ent;
 		ir_type *ret_addr_type = new_type_primitive(mode_P);
 		ir_type *old_bp_type   = new_type_primitive(mode_P);
@@ -227,7 +231,7 @@ static void TEMPLATE_lower_for_target(void)
 	lower_builtins(0, NULL);
 
 	/* lower compound param handling */
-	lower_calls_with_compounds(LF_RETURN_HIDDEN);
+	lower_calls_with_compounds(LF_RETURN_HIDDEN, NULL);
 }
 
 static int TEMPLATE_is_mux_allowed(ir_node *sel, ir_node *mux_false,
@@ -259,7 +263,9 @@ static const backend_params *TEMPLATE_get_backend_params(void)
 		0,     /* no trampoline support: size 0 */
 		0,     /* no trampoline support: align 0 */
 		NULL,  /* no trampoline support: no trampoline builder */
-		4      /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		4,     /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		0,     /* issue width: unknown */
+		0      /* branch mispredict penalty: unknown */
 	};
 	return &p;
 }
@@ -0,0 +1,224 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   calling convention helpers
+ */
+#include "amd64_cconv.h"
+#include "bearch_amd64_t.h"
+#include "beirg.h"
+#include "irmode.h"
+#include "typerep.h"
+#include "xmalloc.h"
+#include "error.h"
+#include "util.h"
+#include "bitfiddle.h"
+
+static const unsigned ignore_regs[] = {
+	REG_RSP,
+};
+
+static const arch_register_t* const param_regs[] = {
+	&amd64_registers[REG_RDI],
+	&amd64_registers[REG_RSI],
+	&amd64_registers[REG_RDX],
+	&amd64_registers[REG_RCX],
+	&amd64_registers[REG_R8],
+	&amd64_registers[REG_R9],
+};
+
+const arch_register_t *const amd64_callee_saves[N_AMD64_CALLEE_SAVES] = {
+	&amd64_registers[REG_RBX],
+	&amd64_registers[REG_RBP],
+	&amd64_registers[REG_R12],
+	&amd64_registers[REG_R13],
+	&amd64_registers[REG_R14],
+	&amd64_registers[REG_R15],
+};
+
+static const arch_register_t* const float_param_regs[] = {
+	&amd64_registers[REG_XMM0],
+	&amd64_registers[REG_XMM1],
+	&amd64_registers[REG_XMM2],
+	&amd64_registers[REG_XMM3],
+	&amd64_registers[REG_XMM4],
+	&amd64_registers[REG_XMM5],
+	&amd64_registers[REG_XMM6],
+	&amd64_registers[REG_XMM7],
+};
+
+static const arch_register_t* const result_regs[] = {
+	&amd64_registers[REG_RAX],
+	&amd64_registers[REG_RDX],
+};
+
+static const arch_register_t* const float_result_regs[] = {
+	&amd64_registers[REG_XMM0],
+	&amd64_registers[REG_XMM1],
+};
+
+calling_convention_t *amd64_decide_calling_convention(const ir_graph *irg,
+                                                      ir_type *function_type)
+{
+	unsigned stack_offset = 0;
+	unsigned regnum       = 0;
+	unsigned float_regnum = 0;
+
+	/* determine how parameters are passed: integer and float parameters use
+	 * their own registers, the ones which do not fit into them are passed on
+	 * the stack in 8 byte slots */
+	size_t              n_params = get_method_n_params(function_type);
+	reg_or_stackslot_t *params   = XMALLOCNZ(reg_or_stackslot_t, n_params);
+	for (size_t i = 0; i < n_params; ++i) {
+		ir_type            *param_type = get_method_param_type(function_type, i);
+		ir_mode            *mode       = get_type_mode(param_type);
+		reg_or_stackslot_t *param      = &params[i];
+		param->type = param_type;
+
+		if (mode == NULL)
+			panic("compound parameter not lowered in %+F", function_type);
+		if (mode_is_float(mode) && float_regnum < ARRAY_SIZE(float_param_regs)) {
+			param->reg = float_param_regs[float_regnum++];
+		} else if (!mode_is_float(mode) && regnum < ARRAY_SIZE(param_regs)) {
+			param->reg = param_regs[regnum++];
+		} else {
+			param->offset = stack_offset;
+			stack_offset += round_up2(get_type_size_bytes(param_type), 8);
+		}
+	}
+
+	/* results are in rax, rdx resp. xmm0, xmm1. There are two results for
+	 * compounds returned in registers */
+	size_t              n_results = get_method_n_ress(function_type);
+	reg_or_stackslot_t *results   = XMALLOCNZ(reg_or_stackslot_t, n_results);
+	unsigned            n_res_gp  = 0;
+	unsigned            n_res_xmm = 0;
+	for (size_t i = 0; i < n_results; ++i) {
+		ir_type            *result_type = get_method_res_type(function_type, i);
+		ir_mode            *result_mode = get_type_mode(result_type);
+		reg_or_stackslot_t *result      = &results[i];
+		result->type = result_type;
+
+		if (mode_is_float(result_mode)) {
+			if (n_res_xmm >= ARRAY_SIZE(float_result_regs))
+				panic("Too many float results");
+			result->reg = float_result_regs[n_res_xmm++];
+		} else {
+			if (n_res_gp >= ARRAY_SIZE(result_regs))
+				panic("Too many results");
+			result->reg = result_regs[n_res_gp++];
+		}
+	}
+
+	calling_convention_t *cconv = XMALLOCZ(calling_convention_t);
+	cconv->parameters       = params;
+	cconv->param_stack_size = stack_offset;
+	cconv->n_param_regs     = regnum + float_regnum;
+	cconv->n_xmm_regs       = float_regnum;
+	cconv->results          = results;
+
+	/* setup allocatable registers */
+	if (irg != NULL) {
+		be_irg_t       *birg = be_birg_from_irg(irg);
+		struct obstack *obst = &birg->obst;
+
+		assert(birg->allocatable_regs == NULL);
+		birg->allocatable_regs = rbitset_obstack_alloc(obst, N_AMD64_REGISTERS);
+		rbitset_set_all(birg->allocatable_regs, N_AMD64_REGISTERS);
+		for (size_t r = 0; r < ARRAY_SIZE(ignore_regs); ++r) {
+			rbitset_clear(birg->allocatable_regs, ignore_regs[r]);
+		}
+	}
+
+	return cconv;
+}
+
+/** Classes of an eightbyte of a compound in the System V ABI. */
+typedef enum amd64_class_t {
+	CLASS_NO_CLASS,
+	CLASS_INTEGER,
+	CLASS_SSE,
+} amd64_class_t;
+
+/**
+ * Classifies the eightbytes covered by type at offset.
+ *
+ * @return false if the type has to be passed in memory
+ */
+static bool classify_eightbytes(const ir_type *type, unsigned offset,
+                                amd64_class_t *classes)
+{
+	if (is_compound_type(type)) {
+		for (size_t i = 0, n = get_compound_n_members(type); i < n; ++i) {
+			ir_entity *member = get_compound_member(type, i);
+			ir_type   *mtype  = get_entity_type(member);
+			unsigned   moff   = offset + get_entity_offset(member);
+			if (get_entity_bitfield_size(member) > 0) {
+				classes[moff / 8] = CLASS_INTEGER;
+				continue;
+			}
+			if (!classify_eightbytes(mtype, moff, classes))
+				return false;
+		}
+		return true;
+	} else if (is_Array_type(type)) {
+		ir_type  *etype = get_array_element_type(type);
+		unsigned  esize = get_type_size_bytes(etype);
+		unsigned  size  = get_type_size_bytes(type);
+		for (unsigned eoff = 0; esize > 0 && eoff < size; eoff += esize) {
+			if (!classify_eightbytes(etype, offset + eoff, classes))
+				return false;
+		}
+		return true;
+	}
+
+	ir_mode *mode = get_type_mode(type);
+	if (mode == NULL)
+		return false;
+	unsigned size = get_mode_size_bytes(mode);
+	/* unaligned values and long double go to memory */
+	if (size > 8 || offset % size != 0)
+		return false;
+	if (mode_is_float(mode) && classes[offset / 8] != CLASS_INTEGER)
+		classes[offset / 8] = CLASS_SSE;
+	else
+		classes[offset / 8] = CLASS_INTEGER;
+	return true;
+}
+
+/**
+ * Classifies compounds of up to 16 bytes according to the System V ABI:
+ * Every eightbyte is passed in a general purpose register unless it consists
+ * of floating point values only, which use an xmm register.
+ */
+aggregate_spec_t amd64_lower_aggregate(ir_type *type, bool is_result)
+{
+	aggregate_spec_t spec;
+	amd64_class_t    classes[2] = { CLASS_NO_CLASS, CLASS_NO_CLASS };
+	unsigned         size       = get_type_size_bytes(type);
+	(void)is_result;
+
+	spec.length = 0;
+	if (size == 0 || size > 16 || !classify_eightbytes(type, 0, classes))
+		return spec;
+
+	for (unsigned i = 0; i * 8 < size; ++i) {
+		unsigned part = MIN(8, size - i * 8);
+		if (classes[i] == CLASS_SSE)
+			spec.modes[i] = part <= 4 ? mode_F : mode_D;
+		else
+			spec.modes[i] = part <= 4 ? mode_Iu : mode_Lu;
+		++spec.length;
+	}
+	return spec;
+}
+
+void amd64_free_calling_convention(calling_convention_t *cconv)
+{
+	free(cconv->parameters);
+	free(cconv->results);
+	free(cconv);
+}
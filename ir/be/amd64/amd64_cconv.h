@@ -0,0 +1,70 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   support functions for calling conventions
+ */
+#ifndef FIRM_BE_AMD64_AMD64_CCONV_H
+#define FIRM_BE_AMD64_AMD64_CCONV_H
+
+#include "firm_types.h"
+#include "be_types.h"
+#include "lower_calls.h"
+#include "gen_amd64_regalloc_if.h"
+
+/** number of callee save registers besides %rsp */
+#define N_AMD64_CALLEE_SAVES 6
+
+/** the callee save registers besides %rsp */
+extern const arch_register_t *const amd64_callee_saves[N_AMD64_CALLEE_SAVES];
+
+/** information about a single parameter or result */
+typedef struct reg_or_stackslot_t
+{
+	const arch_register_t *reg;    /**< if != NULL, the register used for
+	                                    this parameter. */
+	ir_type               *type;   /**< indicates that an entity of the specific
+	                                    type is needed */
+	unsigned               offset; /**< if transmitted via stack, the offset
+	                                    for this parameter. */
+	ir_entity             *entity; /**< entity in the argument type */
+} reg_or_stackslot_t;
+
+/** The calling convention info for one call site. */
+typedef struct calling_convention_t
+{
+	reg_or_stackslot_t *parameters;        /**< parameter info. */
+	unsigned            param_stack_size;  /**< needed stack size for
+	                                            parameters */
+	unsigned            n_param_regs;      /**< number of parameters passed
+	                                            in registers */
+	unsigned            n_xmm_regs;        /**< number of xmm registers used
+	                                            for parameters, variadic
+	                                            functions expect it in %al */
+	reg_or_stackslot_t *results;           /**< result info. */
+} calling_convention_t;
+
+/**
+ * Determines how function parameters and return values are passed according
+ * to the System V ABI. Decides what goes to register or to stack and what
+ * stack offsets/datatypes are used.
+ *
+ * @param irg  if not NULL, the allocatable registers of this graph are set up
+ */
+calling_convention_t *amd64_decide_calling_convention(const ir_graph *irg,
+                                                      ir_type *function_type);
+
+/**
+ * Classifies compound parameters and results for lower_calls_with_compounds().
+ */
+aggregate_spec_t amd64_lower_aggregate(ir_type *type, bool is_result);
+
+/**
+ * free memory used by a calling_convention_t
+ */
+void amd64_free_calling_convention(calling_convention_t *cconv);
+
+#endif
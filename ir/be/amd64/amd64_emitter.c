@@ -8,6 +8,7 @@
  * @brief   emit assembler for a backend graph
  */
 #include <limits.h>
+#include <string.h>
 
 #include "be_t.h"
 #include "error.h"
@@ -19,19 +20,27 @@
 #include "irop_t.h"
 #include "irargs_t.h"
 #include "irprog.h"
+#include "execfreq.h"
 
 #include "besched.h"
 #include "begnuas.h"
 #include "beblocksched.h"
+#include "beirg.h"
+#include "bedwarf.h"
+#include "bestack.h"
+#include "bitfiddle.h"
 
 #include "amd64_emitter.h"
 #include "gen_amd64_emitter.h"
 #include "gen_amd64_regalloc_if.h"
 #include "amd64_nodes_attr.h"
 #include "amd64_new_nodes.h"
+#include "amd64_cconv.h"
 
 #include "benode.h"
 
+#include "ia32_architecture.h"
+
 /*************************************************************
  *             _       _    __   _          _
  *            (_)     | |  / _| | |        | |
@@ -186,13 +195,6 @@ static void emit_register_insn_mode(const arch_register_t *reg,
 	be_emit_string(name);
 }
 
-typedef enum amd64_emit_mod_t {
-	EMIT_NONE        = 0,
-	EMIT_RESPECT_LS  = 1U << 0,
-	EMIT_IGNORE_MODE = 1U << 1,
-} amd64_emit_mod_t;
-ENUM_BITSET(amd64_emit_mod_t)
-
 static void amd64_emit_immediate(const amd64_imm_t *const imm)
 {
 	if (imm->symconst != NULL) {
@@ -209,6 +211,99 @@ static void amd64_emit_immediate(const amd64_imm_t *const imm)
 	}
 }
 
+static void amd64_emit_addr(const ir_node *const node,
+                            const amd64_addr_t *const addr)
+{
+	int64_t    const offset   = addr->immediate.offset;
+	ir_entity *const symconst = addr->immediate.symconst;
+	uint8_t    const base     = addr->base_input;
+	uint8_t    const index    = addr->index_input;
+
+	if (symconst != NULL) {
+		be_gas_emit_entity(symconst);
+		if (get_entity_owner(symconst) == get_tls_type())
+			be_emit_cstring("@tpoff");
+		if (offset != 0)
+			be_emit_irprintf("%+ld", offset);
+	} else if (offset != 0 || (base == NO_INPUT && index == NO_INPUT)) {
+		be_emit_irprintf("%ld", offset);
+	}
+
+	if (base == NO_INPUT && index == NO_INPUT) {
+		if (symconst != NULL)
+			be_emit_cstring("(%rip)");
+		return;
+	}
+
+	be_emit_char('(');
+	if (base != NO_INPUT)
+		emit_register(arch_get_irn_register_in(node, base));
+	if (index != NO_INPUT) {
+		be_emit_char(',');
+		emit_register(arch_get_irn_register_in(node, index));
+		be_emit_irprintf(",%u", 1U << addr->log_scale);
+	}
+	be_emit_char(')');
+}
+
+void amd64_emit_register(ir_node const *const node,
+                         arch_register_t const *const reg,
+                         amd64_emit_mod_t const mod)
+{
+	if (mod & EMIT_IGNORE_MODE) {
+		emit_register(reg);
+	} else {
+		amd64_attr_t const *const attr = get_amd64_attr_const(node);
+		if (mod & EMIT_RESPECT_LS) {
+			emit_register_mode(reg, attr->ls_mode);
+		} else {
+			emit_register_insn_mode(reg, attr->data.insn_mode);
+		}
+	}
+}
+
+void amd64_emit_immediate_operand(ir_node const *const node)
+{
+	amd64_attr_t const *const attr = get_amd64_attr_const(node);
+	amd64_emit_immediate(&attr->imm);
+}
+
+void amd64_emit_addr_operand(ir_node const *const node)
+{
+	amd64_addr_attr_t const *const attr = get_amd64_addr_attr_const(node);
+	amd64_emit_addr(node, &attr->addr);
+}
+
+void amd64_emit_suffix(ir_node const *const node, amd64_emit_mod_t const mod)
+{
+	amd64_attr_t const *const attr = get_amd64_attr_const(node);
+	if (mod & EMIT_RESPECT_LS) {
+		amd64_emit_mode_suffix(attr->ls_mode);
+	} else {
+		amd64_emit_insn_mode_suffix(attr->data.insn_mode);
+	}
+}
+
+void amd64_emit_sse_suffix(ir_node const *const node)
+{
+	/* scalar SSE suffix: single or double precision */
+	amd64_attr_t const *const attr = get_amd64_attr_const(node);
+	be_emit_char(attr->data.insn_mode == INSN_MODE_32 ? 's' : 'd');
+}
+
+void amd64_emit_conv_suffix(ir_node const *const node)
+{
+	amd64_attr_t const *const attr = get_amd64_attr_const(node);
+	ir_mode                  *mode = attr->ls_mode;
+	if (get_mode_size_bits(mode) == 64)
+		return;
+	if (get_mode_size_bits(mode) == 32 && !mode_is_signed(mode)
+	 && attr->data.insn_mode == INSN_MODE_32)
+		return;
+	be_emit_char(mode_is_signed(mode) ? 's' : 'z');
+	amd64_emit_mode_suffix(mode);
+}
+
 void amd64_emitf(ir_node const *const node, char const *fmt, ...)
 {
 	va_list ap;
@@ -255,11 +350,13 @@ end_of_mods:
 				be_emit_char('%');
 				break;
 
-			case 'C': {
-				amd64_attr_t const *const attr = get_amd64_attr_const(node);
-				amd64_emit_immediate(&attr->imm);
+			case 'A':
+				amd64_emit_addr_operand(node);
+				break;
+
+			case 'C':
+				amd64_emit_immediate_operand(node);
 				break;
-			}
 
 			case 'D':
 				if (*fmt < '0' || '9' <= *fmt)
@@ -279,26 +376,10 @@ end_of_mods:
 				break;
 			}
 
-			case 'O': {
-				amd64_SymConst_attr_t const *const attr = get_amd64_SymConst_attr_const(node);
-				if (attr->fp_offset)
-					be_emit_irprintf("%d", attr->fp_offset);
-				break;
-			}
-
 			case 'R':
 				reg = va_arg(ap, arch_register_t const*);
 emit_R:
-				if (mod & EMIT_IGNORE_MODE) {
-					emit_register(reg);
-				} else {
-					amd64_attr_t const *const attr = get_amd64_attr_const(node);
-					if (mod & EMIT_RESPECT_LS) {
-						emit_register_mode(reg, attr->ls_mode);
-					} else {
-						emit_register_insn_mode(reg, attr->data.insn_mode);
-					}
-				}
+				amd64_emit_register(node, reg, mod);
 				break;
 
 			case 'S': {
@@ -312,15 +393,13 @@ emit_R:
 				goto emit_R;
 			}
 
-			case 'M': {
-				amd64_attr_t const *const attr = get_amd64_attr_const(node);
-				if (mod & EMIT_RESPECT_LS) {
-					amd64_emit_mode_suffix(attr->ls_mode);
-				} else {
-					amd64_emit_insn_mode_suffix(attr->data.insn_mode);
-				}
+			case 'M':
+				amd64_emit_suffix(node, mod);
+				break;
+
+			case 'X':
+				amd64_emit_sse_suffix(node);
 				break;
-			}
 
 			case 'd': {
 				int const num = va_arg(ap, int);
@@ -340,18 +419,9 @@ emit_R:
 				break;
 			}
 
-			case 'c': {
-				amd64_attr_t const *const attr = get_amd64_attr_const(node);
-				ir_mode                  *mode = attr->ls_mode;
-				if (get_mode_size_bits(mode) == 64)
-					break;
-				if (get_mode_size_bits(mode) == 32 && !mode_is_signed(mode)
-				 && attr->data.insn_mode == INSN_MODE_32)
-					break;
-				be_emit_char(mode_is_signed(mode) ? 's' : 'z');
-				amd64_emit_mode_suffix(mode);
+			case 'c':
+				amd64_emit_conv_suffix(node);
 				break;
-			}
 
 			default:
 unknown:
@@ -408,6 +478,38 @@ static void emit_amd64_SwitchJmp(const ir_node *node)
 	be_emit_jump_table(node, attr->table, attr->table_entity, get_cfop_target_block);
 }
 
+/**
+ * Emits the jumps for a branch on the flags of an ucomis. The unordered
+ * result sets ZF, PF and CF, so "equal" and its negation need a parity
+ * check. The transformer permutes the operands of the other relations so
+ * that only carry and zero flag conditions remain.
+ */
+static void emit_float_jcc(const ir_node *proj_true, const ir_node *proj_false,
+                           ir_relation relation)
+{
+	const char *suffix;
+	switch (relation) {
+	case ir_relation_equal:
+		amd64_emitf(proj_false, "jp %L");
+		amd64_emitf(proj_true, "je %L");
+		return;
+	case ir_relation_unordered_less_greater:
+		amd64_emitf(proj_true, "jp %L");
+		amd64_emitf(proj_true, "jne %L");
+		return;
+	case ir_relation_unordered_equal:        suffix = "e";  break;
+	case ir_relation_less_greater:           suffix = "ne"; break;
+	case ir_relation_greater:                suffix = "a";  break;
+	case ir_relation_greater_equal:          suffix = "ae"; break;
+	case ir_relation_unordered_less:         suffix = "b";  break;
+	case ir_relation_unordered_less_equal:   suffix = "be"; break;
+	case ir_relation_unordered:              suffix = "p";  break;
+	case ir_relation_less_equal_greater:     suffix = "np"; break;
+	default: panic("ucomis has unsupported relation");
+	}
+	amd64_emitf(proj_true, "j%s %L", suffix);
+}
+
 /**
  * Emit a Compare with conditional branch.
  */
@@ -423,8 +525,11 @@ static void emit_amd64_Jcc(const ir_node *irn)
 	ir_node            *op1       = get_irn_n(irn, 0);
 	const amd64_attr_t *cmp_attr  = get_amd64_attr_const(op1);
 	bool                is_signed = !cmp_attr->data.cmp_unsigned;
+	bool                is_float  = is_amd64_xUcomis(op1);
 
-	assert(is_amd64_Cmp(op1));
+	/* besides Cmp and Test the flags may come from an arithmetic node whose
+	 * zero flag was reused by the peephole optimization */
+	assert(is_amd64_irn(op1));
 
 	foreach_out_edge(irn, edge) {
 		ir_node *proj = get_edge_src_irn(edge);
@@ -458,6 +563,11 @@ static void emit_amd64_Jcc(const ir_node *irn)
 		relation   = get_negated_relation(relation);
 	}
 
+	if (is_float) {
+		emit_float_jcc(proj_true, proj_false, relation);
+		goto emit_false;
+	}
+
 	switch (relation & ir_relation_less_equal_greater) {
 		case ir_relation_equal:              suffix = "e"; break;
 		case ir_relation_less:               suffix = is_signed ? "l"  : "b"; break;
@@ -472,6 +582,7 @@ static void emit_amd64_Jcc(const ir_node *irn)
 	/* emit the true proj */
 	amd64_emitf(proj_true, "j%s %L", suffix);
 
+emit_false:
 	if (get_cfop_target_block(proj_false) != next_block) {
 		amd64_emitf(proj_false, "jmp %L");
 	} else if (be_options.verbose_asm) {
@@ -483,10 +594,10 @@ static void emit_amd64_LoadZ(const ir_node *node)
 {
 	const amd64_attr_t *attr = get_amd64_attr_const(node);
 	switch (attr->data.insn_mode) {
-	case INSN_MODE_8:  amd64_emitf(node, "movzbq %O(%^S0), %^D0"); break;
-	case INSN_MODE_16: amd64_emitf(node, "movzwq %O(%^S0), %^D0"); break;
+	case INSN_MODE_8:  amd64_emitf(node, "movzbq %A, %^D0"); break;
+	case INSN_MODE_16: amd64_emitf(node, "movzwq %A, %^D0"); break;
 	case INSN_MODE_32:
-	case INSN_MODE_64: amd64_emitf(node, "mov%M %O(%^S0), %D0");   break;
+	case INSN_MODE_64: amd64_emitf(node, "mov%M %A, %D0");   break;
 	default:
 		panic("invalid insn mode");
 	}
@@ -499,24 +610,71 @@ static void emit_be_Call(const ir_node *node)
 {
 	ir_entity *entity = be_Call_get_entity(node);
 
-	/* %eax/%rax is used in AMD64 to pass the number of vector parameters for
+	/* %al is used in AMD64 to pass the number of vector registers used for
 	 * variable argument counts */
-	if (get_method_variadicity (be_Call_get_type((ir_node *) node))) {
-		/* But this still is a hack... */
-		amd64_emitf(node, "xor %%rax, %%rax");
+	ir_type *const call_type = be_Call_get_type((ir_node *) node);
+	if (get_method_variadicity(call_type)) {
+		calling_convention_t *cconv
+			= amd64_decide_calling_convention(NULL, call_type);
+		unsigned n_sse = cconv->n_xmm_regs;
+		amd64_free_calling_convention(cconv);
+		if (n_sse == 0) {
+			amd64_emitf(node, "xor %%rax, %%rax");
+		} else {
+			amd64_emitf(node, "movl $%u, %%eax", n_sse);
+		}
 	}
 
 	if (entity) {
 		amd64_emitf(node, "call %E", entity);
 	} else {
-		be_emit_pad_comment();
-		be_emit_cstring("/* FIXME: call NULL entity?! */\n");
+		arch_register_t const *const reg
+			= arch_get_irn_register_in(node, n_be_Call_ptr);
+		amd64_emitf(node, "call *%^R", reg);
 	}
 }
 
 /**
  * emit copy node
  */
+/**
+ * Emits an FMA3 instruction. The instruction overwrites one of its operands,
+ * so pick the form whose destination is the result register.
+ */
+static void emit_fma(const ir_node *node, const char *name)
+{
+	const arch_register_t *left   = arch_get_irn_register_in(node, n_amd64_xFmadd_left);
+	const arch_register_t *right  = arch_get_irn_register_in(node, n_amd64_xFmadd_right);
+	const arch_register_t *addend = arch_get_irn_register_in(node, n_amd64_xFmadd_addend);
+	const arch_register_t *out    = arch_get_irn_register_out(node, 0);
+
+	if (out == left) {
+		amd64_emitf(node, "%s213s%X %^R, %^R, %^R", name, addend, right, left);
+	} else if (out == right) {
+		amd64_emitf(node, "%s213s%X %^R, %^R, %^R", name, addend, left, right);
+	} else if (out == addend) {
+		amd64_emitf(node, "%s231s%X %^R, %^R, %^R", name, right, left, addend);
+	} else {
+		amd64_emitf(node, "movaps %^R, %^R", left, out);
+		amd64_emitf(node, "%s213s%X %^R, %^R, %^R", name, addend, right, out);
+	}
+}
+
+static void emit_amd64_xFmadd(const ir_node *node)
+{
+	emit_fma(node, "vfmadd");
+}
+
+static void emit_amd64_xFmsub(const ir_node *node)
+{
+	emit_fma(node, "vfmsub");
+}
+
+static void emit_amd64_xFnmadd(const ir_node *node)
+{
+	emit_fma(node, "vfnmadd");
+}
+
 static void emit_be_Copy(const ir_node *irn)
 {
 	ir_mode *mode = get_irn_mode(irn);
@@ -527,7 +685,7 @@ static void emit_be_Copy(const ir_node *irn)
 	}
 
 	if (mode_is_float(mode)) {
-		panic("move not supported for FP");
+		amd64_emitf(irn, "movaps %^S0, %^D0");
 	} else if (mode_is_data(mode)) {
 		amd64_emitf(irn, "mov %^S0, %^D0");
 	} else {
@@ -543,9 +701,14 @@ static void emit_be_Perm(const ir_node *node)
 	arch_register_class_t const* const cls0 = reg0->reg_class;
 	assert(cls0 == reg1->reg_class && "Register class mismatch at Perm");
 
-	amd64_emitf(node, "xchg %^R, %^R", reg0, reg1);
-
-	if (cls0 != &amd64_reg_classes[CLASS_amd64_gp]) {
+	if (cls0 == &amd64_reg_classes[CLASS_amd64_gp]) {
+		amd64_emitf(node, "xchg %^R, %^R", reg0, reg1);
+	} else if (cls0 == &amd64_reg_classes[CLASS_amd64_xmm]) {
+		/* there is no xchg for xmm registers */
+		amd64_emitf(node, "xorps %^R, %^R", reg0, reg1);
+		amd64_emitf(node, "xorps %^R, %^R", reg1, reg0);
+		amd64_emitf(node, "xorps %^R, %^R", reg0, reg1);
+	} else {
 		panic("unexpected register class in be_Perm (%+F)", node);
 	}
 }
@@ -555,10 +718,35 @@ static void emit_amd64_FrameAddr(const ir_node *irn)
 	const amd64_SymConst_attr_t *attr =
 		(const amd64_SymConst_attr_t*) get_amd64_attr_const(irn);
 
-	amd64_emitf(irn, "mov %S0, %D0");
-	amd64_emitf(irn, "add $%u, %D0", attr->fp_offset);
+	amd64_emitf(irn, "lea %d(%S0), %D0", attr->fp_offset);
 }
 
+/** Where the value a callee save register had on entry is kept. */
+typedef struct save_loc_t {
+	unsigned regs;    /**< general purpose registers holding the value */
+	int      slot;    /**< stack slot holding it, relative to the CFA */
+	bool     in_slot; /**< whether the stack slot holds the value */
+} save_loc_t;
+
+/** The call frame at a point of the program. */
+typedef struct callframe_t {
+	int        offset; /**< offset of the CFA from %rsp */
+	save_loc_t saves[N_AMD64_CALLEE_SAVES];
+} callframe_t;
+
+/** The location of a callee save value described by the emitted CFI. */
+typedef struct save_desc_t {
+	const arch_register_t *reg; /**< register holding it, NULL for the slot */
+	int                    slot;
+} save_desc_t;
+
+static callframe_t *callframe_exits;   /**< call frame at the end of blocks */
+static bool        *callframe_valid;   /**< whether the exit was computed */
+static int         *block_biases;      /**< stack bias at the block begin */
+static callframe_t  callframe;         /**< the current call frame */
+static int          described_offset;  /**< CFA offset described by the CFI */
+static save_desc_t  described_saves[N_AMD64_CALLEE_SAVES];
+
 /**
  * Emits code to increase stack pointer.
  */
@@ -582,7 +770,8 @@ static void emit_be_Start(const ir_node *node)
 	ir_type  *frame_type = get_irg_frame_type(irg);
 	unsigned  size       = get_type_size_bytes(frame_type);
 
-	if (size > 0) {
+	/* leaf functions may keep their frame in the red zone */
+	if (size > 0 && be_start_get_setup_stackframe(node)) {
 		amd64_emitf(node, "subq $%u, %%rsp", size);
 	}
 }
@@ -596,12 +785,22 @@ static void emit_be_Return(const ir_node *node)
 	ir_type  *frame_type = get_irg_frame_type(irg);
 	unsigned  size       = get_type_size_bytes(frame_type);
 
-	if (size > 0) {
+	if (size > 0 && be_return_get_destroy_stackframe(node)) {
 		amd64_emitf(node, "addq $%u, %%rsp", size);
+		/* the return or tail call runs without the frame */
+		if (be_dwarf_has_callframe_info()) {
+			described_offset = callframe.offset - (int)size;
+			be_dwarf_callframe_offset(described_offset);
+		}
 	}
 
-	be_emit_cstring("\tret");
-	be_emit_finish_line_gas(node);
+	ir_entity *const callee = be_Return_get_tail_call(node);
+	if (callee != NULL) {
+		amd64_emitf(node, "jmp %E", callee);
+	} else {
+		be_emit_cstring("\tret");
+		be_emit_finish_line_gas(node);
+	}
 }
 
 /**
@@ -621,6 +820,9 @@ static void amd64_register_emitters(void)
 	be_set_emitter(op_amd64_Jmp,        emit_amd64_Jmp);
 	be_set_emitter(op_amd64_LoadZ,      emit_amd64_LoadZ);
 	be_set_emitter(op_amd64_SwitchJmp,  emit_amd64_SwitchJmp);
+	be_set_emitter(op_amd64_xFmadd,     emit_amd64_xFmadd);
+	be_set_emitter(op_amd64_xFmsub,     emit_amd64_xFmsub);
+	be_set_emitter(op_amd64_xFnmadd,    emit_amd64_xFnmadd);
 	be_set_emitter(op_be_Call,          emit_be_Call);
 	be_set_emitter(op_be_Copy,          emit_be_Copy);
 	be_set_emitter(op_be_CopyKeep,      emit_be_Copy);
@@ -633,21 +835,356 @@ static void amd64_register_emitters(void)
 	be_set_emitter(op_be_Keep,  be_emit_nothing);
 }
 
+/**
+ * Test whether a block should be aligned: only if the alignment nops before
+ * the label aren't executed more often than we have jumps to the label.
+ */
+static bool should_align_block(const ir_node *block, const ir_node *prev)
+{
+	static const double DELTA = .0001;
+	double prev_freq = 0;  /**< execfreq of the fallthrough block */
+	double jmp_freq  = 0;  /**< execfreq of all non-fallthrough blocks */
+
+	if (ia32_cg_config.label_alignment_factor <= 0)
+		return false;
+
+	double const block_freq = get_block_execfreq(block);
+	if (block_freq < DELTA)
+		return false;
+
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		const ir_node *pred      = get_Block_cfgpred_block(block, i);
+		double         pred_freq = get_block_execfreq(pred);
+
+		if (pred == prev) {
+			prev_freq += pred_freq;
+		} else {
+			jmp_freq  += pred_freq;
+		}
+	}
+
+	if (prev_freq < DELTA && !(jmp_freq < DELTA))
+		return true;
+
+	return jmp_freq / prev_freq > ia32_cg_config.label_alignment_factor;
+}
+
+/**
+ * Aligns the label of frequent jump targets as requested by the cpu tuning.
+ */
+static void amd64_emit_block_alignment(const ir_node *block,
+                                       const ir_node *prev)
+{
+	ir_graph *const irg = get_Block_irg(block);
+	/* the function entry is aligned already and the cold fragment starts a
+	 * section of its own */
+	if (ia32_cg_config.label_alignment == 0 || prev == NULL
+	    || block == be_birg_from_irg(irg)->cold_block)
+		return;
+
+	/* without a fall-through the nops are never executed */
+	bool has_fallthrough = false;
+	if (sched_next_block(prev) == block) {
+		for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+			if (get_Block_cfgpred_block(block, i) == prev)
+				has_fallthrough = true;
+		}
+	}
+	if (has_fallthrough && !should_align_block(block, prev))
+		return;
+
+	amd64_emitf(NULL, ".p2align %u,,%u", ia32_cg_config.label_alignment,
+	            ia32_cg_config.label_alignment_max_skip);
+}
+
+static bool is_gp_reg(const arch_register_t *reg)
+{
+	return reg != NULL && reg->reg_class == &amd64_reg_classes[CLASS_amd64_gp];
+}
+
+static unsigned get_insn_mode_bytes(amd64_insn_mode_t insn_mode)
+{
+	switch (insn_mode) {
+	case INSN_MODE_8:  return 1;
+	case INSN_MODE_16: return 2;
+	case INSN_MODE_32: return 4;
+	case INSN_MODE_64: return 8;
+	default:           panic("invalid insn mode");
+	}
+}
+
+/**
+ * Returns whether @p node accesses a stack slot, which begins at @p slot
+ * relative to the CFA.
+ */
+static bool get_frame_slot(const ir_node *node, const callframe_t *frame,
+                           int *slot)
+{
+	const amd64_addr_attr_t *attr = get_amd64_addr_attr_const(node);
+	const amd64_addr_t      *addr = &attr->addr;
+	if (addr->base_input == NO_INPUT || addr->index_input != NO_INPUT
+	    || addr->immediate.symconst != NULL)
+		return false;
+	if (arch_get_irn_register_in(node, addr->base_input)
+	    != &amd64_registers[REG_RSP])
+		return false;
+	*slot = (int)addr->immediate.offset - frame->offset;
+	return true;
+}
+
+/** Records that @p dst receives the value of @p src. */
+static void copy_saves(const callframe_t *frame, unsigned *copied,
+                       const arch_register_t *src, const arch_register_t *dst)
+{
+	if (!is_gp_reg(src) || !is_gp_reg(dst))
+		return;
+	for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+		if (frame->saves[i].regs & (1u << src->index))
+			copied[i] |= 1u << dst->index;
+	}
+}
+
+/** Updates @p frame with the effect of @p node. */
+static void callframe_transfer(callframe_t *frame, ir_node *node)
+{
+	unsigned copied[N_AMD64_CALLEE_SAVES];
+	memset(copied, 0, sizeof(copied));
+
+	/* Phis got their values at the end of the predecessors, the values of
+	 * Start are the ones of the caller */
+	if (is_Phi(node))
+		return;
+	if (be_is_Start(node)) {
+		frame->offset += arch_get_sp_bias(node);
+		return;
+	}
+
+	if (be_is_Copy(node) || be_is_CopyKeep(node)) {
+		copy_saves(frame, copied, arch_get_irn_register_in(node, 0),
+		           arch_get_irn_register_out(node, 0));
+	} else if (be_is_Perm(node)) {
+		for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+			copy_saves(frame, copied, arch_get_irn_register_in(node, i),
+			           arch_get_irn_register_out(node, i));
+		}
+	} else if (is_amd64_Store(node) || is_amd64_xStores(node)) {
+		const amd64_attr_t *attr = get_amd64_attr_const(node);
+		unsigned size = get_insn_mode_bytes(attr->data.insn_mode);
+		int      slot;
+		if (get_frame_slot(node, frame, &slot)) {
+			const arch_register_t *val = arch_get_irn_register_in(node, 0);
+			for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+				save_loc_t *save = &frame->saves[i];
+				if (is_amd64_Store(node) && size == 8
+				    && (save->regs & (1u << val->index))) {
+					save->slot    = slot;
+					save->in_slot = true;
+				} else if (save->in_slot && save->slot < slot + (int)size
+				           && slot < save->slot + 8) {
+					save->in_slot = false;
+				}
+			}
+		}
+	} else if (is_amd64_LoadZ(node)) {
+		const amd64_attr_t *attr = get_amd64_attr_const(node);
+		int slot;
+		if (attr->data.insn_mode == INSN_MODE_64
+		    && get_frame_slot(node, frame, &slot)) {
+			const arch_register_t *res
+				= arch_get_irn_register_out(node, pn_amd64_LoadZ_res);
+			for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+				const save_loc_t *save = &frame->saves[i];
+				if (save->in_slot && save->slot == slot)
+					copied[i] |= 1u << res->index;
+			}
+		}
+	}
+
+	/* everything else overwrites its results */
+	unsigned written = 0;
+	be_foreach_out(node, o) {
+		const arch_register_t *reg = arch_get_irn_register_out(node, o);
+		if (is_gp_reg(reg))
+			written |= 1u << reg->index;
+	}
+	for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+		save_loc_t *save = &frame->saves[i];
+		save->regs = (save->regs & ~written) | copied[i];
+	}
+
+	int sp_change = arch_get_sp_bias(node);
+	assert(sp_change != SP_BIAS_RESET);
+	frame->offset += sp_change;
+}
+
+/**
+ * Computes the call frame at the beginning of @p block.
+ *
+ * @return false if no predecessor of the block has been computed yet
+ */
+static bool get_block_callframe(ir_node *block, callframe_t *frame)
+{
+	ir_graph          *irg    = get_irn_irg(block);
+	be_stack_layout_t *layout = be_get_irg_stack_layout(irg);
+	frame->offset = 8 + block_biases[get_irn_idx(block)] - layout->initial_bias;
+
+	if (block == get_irg_start_block(irg)) {
+		for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+			save_loc_t *save = &frame->saves[i];
+			save->regs    = 1u << amd64_callee_saves[i]->index;
+			save->in_slot = false;
+		}
+		return true;
+	}
+
+	/* a value is only known to be somewhere if it is there on all paths,
+	 * predecessors not computed yet do not restrict it */
+	bool first = true;
+	for (int p = 0, n = get_Block_n_cfgpreds(block); p < n; ++p) {
+		ir_node *pred = get_Block_cfgpred_block(block, p);
+		if (pred == NULL || !callframe_valid[get_irn_idx(pred)])
+			continue;
+		const callframe_t *exit = &callframe_exits[get_irn_idx(pred)];
+		for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+			save_loc_t       *save      = &frame->saves[i];
+			const save_loc_t *pred_save = &exit->saves[i];
+			if (first) {
+				*save = *pred_save;
+				continue;
+			}
+			save->regs &= pred_save->regs;
+			if (!pred_save->in_slot || pred_save->slot != save->slot)
+				save->in_slot = false;
+		}
+		first = false;
+	}
+	if (first) {
+		for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+			frame->saves[i].regs    = 0;
+			frame->saves[i].in_slot = false;
+		}
+	}
+	return !first;
+}
+
+static bool callframe_equal(const callframe_t *a, const callframe_t *b)
+{
+	for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+		const save_loc_t *sa = &a->saves[i];
+		const save_loc_t *sb = &b->saves[i];
+		if (sa->regs != sb->regs || sa->in_slot != sb->in_slot
+		    || (sa->in_slot && sa->slot != sb->slot))
+			return false;
+	}
+	return a->offset == b->offset;
+}
+
+/**
+ * Tracks where the values of the callee save registers live while they are
+ * spilled or moved around, so unwinders can find them. A value is only known
+ * to be in a location at a block begin if it is there at the end of all
+ * predecessors.
+ */
+static void compute_callframes(ir_graph *irg, ir_node **blk_sched)
+{
+	unsigned n_idx = get_irg_last_idx(irg);
+	block_biases    = be_get_block_stack_biases(irg);
+	callframe_exits = XMALLOCN(callframe_t, n_idx);
+	callframe_valid = XMALLOCNZ(bool, n_idx);
+
+	bool changed;
+	do {
+		changed = false;
+		for (size_t b = 0, n = ARR_LEN(blk_sched); b < n; ++b) {
+			ir_node    *block = blk_sched[b];
+			callframe_t frame;
+			if (block == get_irg_end_block(irg)
+			    || !get_block_callframe(block, &frame))
+				continue;
+			sched_foreach(block, node) {
+				callframe_transfer(&frame, node);
+			}
+
+			unsigned idx = get_irn_idx(block);
+			if (callframe_valid[idx]
+			    && callframe_equal(&callframe_exits[idx], &frame))
+				continue;
+			callframe_exits[idx] = frame;
+			callframe_valid[idx] = true;
+			changed              = true;
+		}
+	} while (changed);
+}
+
+static void free_callframes(void)
+{
+	free(block_biases);
+	free(callframe_exits);
+	free(callframe_valid);
+}
+
+/** Emits CFI for the differences of the current call frame to the CFI. */
+static void describe_callframe(void)
+{
+	if (callframe.offset != described_offset) {
+		described_offset = callframe.offset;
+		be_dwarf_callframe_offset(described_offset);
+	}
+
+	const arch_register_class_t *cls = &amd64_reg_classes[CLASS_amd64_gp];
+	for (size_t i = 0; i < N_AMD64_CALLEE_SAVES; ++i) {
+		const arch_register_t *reg  = amd64_callee_saves[i];
+		const save_loc_t      *save = &callframe.saves[i];
+		save_desc_t           *desc = &described_saves[i];
+
+		/* prefer the register itself, then the stack, then a copy */
+		if (save->regs & (1u << reg->index)) {
+			if (desc->reg != reg) {
+				desc->reg = reg;
+				be_dwarf_callframe_restore(reg);
+			}
+		} else if (save->in_slot) {
+			if (desc->reg != NULL || desc->slot != save->slot) {
+				desc->reg  = NULL;
+				desc->slot = save->slot;
+				be_dwarf_callframe_spilloffset(reg, save->slot);
+			}
+		} else if (save->regs != 0) {
+			if (desc->reg == NULL || !(save->regs & (1u << desc->reg->index))
+			    || desc->reg == reg) {
+				desc->reg = &cls->regs[ntz(save->regs)];
+				be_dwarf_callframe_copy(reg, desc->reg);
+			}
+		}
+	}
+}
+
 /**
  * Walks over the nodes in a block connected by scheduling edges
  * and emits code for each node.
  */
-static void amd64_gen_block(ir_node *block, void *data)
+static void amd64_gen_block(ir_node *block, ir_node *prev)
 {
-	(void) data;
-
 	if (! is_Block(block))
 		return;
 
+	amd64_emit_block_alignment(block, prev);
 	be_gas_begin_block(block, true);
 
-	sched_foreach(block, node) {
+	ir_graph  *irg     = get_irn_irg(block);
+	bool const has_cfi = be_dwarf_has_callframe_info()
+	                     && block != get_irg_end_block(irg);
+	if (has_cfi) {
+		get_block_callframe(block, &callframe);
+		describe_callframe();
+	}
+
+	sched_foreach_frozen(block, node) {
 		be_emit_node(node);
+		if (has_cfi) {
+			callframe_transfer(&callframe, node);
+			describe_callframe();
+		}
 	}
 }
 
@@ -678,24 +1215,45 @@ void amd64_emit_function(ir_graph *irg)
 	amd64_register_emitters();
 
 	blk_sched = be_create_block_schedule(irg);
+	be_split_cold_fragment(irg, blk_sched);
+	sched_freeze(irg);
 
-	be_gas_emit_function_prolog(entity, 4, NULL);
+	be_gas_emit_function_prolog(entity, ia32_cg_config.function_alignment,
+	                            NULL);
 
 	irg_block_walk_graph(irg, amd64_gen_labels, NULL, NULL);
 
+	bool const has_cfi = be_dwarf_has_callframe_info();
+	if (has_cfi) {
+		/* the CIE describes the state on entry */
+		be_dwarf_callframe_register(&amd64_registers[REG_RSP]);
+		described_offset = 8;
+		for (size_t r = 0; r < N_AMD64_CALLEE_SAVES; ++r) {
+			described_saves[r].reg = amd64_callee_saves[r];
+		}
+		compute_callframes(irg, blk_sched);
+	}
+
+	/* nothing falls through into the cold fragment */
+	ir_node *cold_block = be_birg_from_irg(irg)->cold_block;
 	n = ARR_LEN(blk_sched);
 	for (i = 0; i < n; i++) {
 		ir_node *block = blk_sched[i];
-		ir_node *next  = (i + 1) < n ? blk_sched[i+1] : NULL;
+		ir_node *next  = (i + 1) < n && blk_sched[i+1] != cold_block
+		                 ? blk_sched[i+1] : NULL;
 
 		set_irn_link(block, next);
 	}
 
 	for (i = 0; i < n; ++i) {
 		ir_node *block = blk_sched[i];
+		ir_node *prev  = i > 0 ? blk_sched[i-1] : NULL;
 
-		amd64_gen_block(block, 0);
+		amd64_gen_block(block, prev);
 	}
 
+	if (has_cfi)
+		free_callframes();
+
 	be_gas_emit_function_epilog(entity);
 }
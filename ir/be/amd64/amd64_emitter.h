@@ -38,6 +38,25 @@
  */
 void amd64_emitf(ir_node const *node, char const *fmt, ...);
 
+typedef enum amd64_emit_mod_t {
+	EMIT_NONE        = 0,
+	EMIT_RESPECT_LS  = 1U << 0,
+	EMIT_IGNORE_MODE = 1U << 1,
+} amd64_emit_mod_t;
+ENUM_BITSET(amd64_emit_mod_t)
+
+/*
+ * Emitters for single format conversions, used by amd64_emitf() and the
+ * emitters generated from the node specification.
+ */
+void amd64_emit_register(ir_node const *node, arch_register_t const *reg,
+                         amd64_emit_mod_t mod);
+void amd64_emit_immediate_operand(ir_node const *node);
+void amd64_emit_addr_operand(ir_node const *node);
+void amd64_emit_suffix(ir_node const *node, amd64_emit_mod_t mod);
+void amd64_emit_sse_suffix(ir_node const *node);
+void amd64_emit_conv_suffix(ir_node const *node);
+
 void amd64_emit_function(ir_graph *irg);
 
 #endif
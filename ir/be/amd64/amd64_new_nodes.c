@@ -98,6 +98,19 @@ amd64_SymConst_attr_t *get_amd64_SymConst_attr(ir_node *node)
 	return attr;
 }
 
+const amd64_addr_attr_t *get_amd64_addr_attr_const(const ir_node *node)
+{
+	const amd64_addr_attr_t *attr
+		= (const amd64_addr_attr_t*)get_irn_generic_attr_const(node);
+	return attr;
+}
+
+amd64_addr_attr_t *get_amd64_addr_attr(ir_node *node)
+{
+	amd64_addr_attr_t *attr = (amd64_addr_attr_t*)get_irn_generic_attr(node);
+	return attr;
+}
+
 const amd64_switch_jmp_attr_t *get_amd64_switch_jmp_attr_const(const ir_node *node)
 {
 	const amd64_switch_jmp_attr_t *attr
@@ -146,6 +159,16 @@ static void init_amd64_SymConst_attributes(ir_node *node, ir_entity *entity)
 	attr->fp_offset = 0;
 }
 
+/**
+ * Initialize address attributes.
+ */
+static void init_amd64_addr_attributes(ir_node *node, amd64_addr_t addr)
+{
+	amd64_addr_attr_t *attr = get_amd64_addr_attr(node);
+	attr->addr         = addr;
+	attr->frame_entity = NULL;
+}
+
 /**
  * Initialize SwitchJmp attributes.
  */
@@ -182,12 +205,32 @@ static int cmp_imm(const amd64_imm_t *const imm0, const amd64_imm_t *const imm1)
 	    || imm0->symconst != imm1->symconst;
 }
 
+/** Compare address attributes. */
+static int cmp_amd64_addr_attr(const ir_node *a, const ir_node *b)
+{
+	const amd64_addr_attr_t *attr_a = get_amd64_addr_attr_const(a);
+	const amd64_addr_attr_t *attr_b = get_amd64_addr_attr_const(b);
+	const amd64_addr_t      *addr_a = &attr_a->addr;
+	const amd64_addr_t      *addr_b = &attr_b->addr;
+	return cmp_imm(&addr_a->immediate, &addr_b->immediate)
+	    || addr_a->base_input != addr_b->base_input
+	    || addr_a->index_input != addr_b->index_input
+	    || addr_a->log_scale != addr_b->log_scale
+	    || attr_a->frame_entity != attr_b->frame_entity
+	    || attr_a->base.data.insn_mode != attr_b->base.data.insn_mode;
+}
+
 /** Compare common amd64 node attributes. */
 static int cmp_amd64_attr(const ir_node *a, const ir_node *b)
 {
 	const amd64_attr_t *attr_a = get_amd64_attr_const(a);
 	const amd64_attr_t *attr_b = get_amd64_attr_const(b);
-	return cmp_imm(&attr_a->imm, &attr_b->imm);
+	return cmp_imm(&attr_a->imm, &attr_b->imm)
+	    || attr_a->ls_mode != attr_b->ls_mode
+	    || attr_a->data.ins_permuted != attr_b->data.ins_permuted
+	    || attr_a->data.cmp_unsigned != attr_b->data.cmp_unsigned
+	    || attr_a->data.insn_mode != attr_b->data.insn_mode
+	    || attr_a->ext.relation != attr_b->ext.relation;
 }
 
 /** copies the AMD64 attributes of a node. */
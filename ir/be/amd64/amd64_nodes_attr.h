@@ -15,6 +15,7 @@
 
 typedef struct amd64_attr_t            amd64_attr_t;
 typedef struct amd64_SymConst_attr_t   amd64_SymConst_attr_t;
+typedef struct amd64_addr_attr_t       amd64_addr_attr_t;
 typedef struct amd64_switch_jmp_attr_t amd64_switch_jmp_attr_t;
 
 typedef enum {
@@ -30,6 +31,20 @@ typedef struct amd64_imm_t {
 	ir_entity *symconst;
 } amd64_imm_t;
 
+/** marks an unused base or index input of an address */
+#define NO_INPUT 0xFF
+
+/**
+ * An x86-64 address base + index * (1 << log_scale) + immediate. An address
+ * with a symconst but neither base nor index is relative to %rip.
+ */
+typedef struct amd64_addr_t {
+	amd64_imm_t immediate; /**< the displacement, sc_sign is unused */
+	uint8_t     base_input;
+	uint8_t     index_input;
+	unsigned    log_scale : 2;
+} amd64_addr_t;
+
 struct amd64_attr_t
 {
 	except_attr  exc;     /**< the exception attribute. MUST be the first one. */
@@ -50,7 +65,16 @@ struct amd64_SymConst_attr_t
 {
 	amd64_attr_t  base;
 	ir_entity    *entity;
-	unsigned      fp_offset;
+	int           fp_offset;
+};
+
+struct amd64_addr_attr_t
+{
+	amd64_attr_t  base;
+	amd64_addr_t  addr;
+	ir_entity    *frame_entity; /**< the frame entity addressed relative to
+	                                 the base, its offset is added to the
+	                                 displacement */
 };
 
 struct amd64_switch_jmp_attr_t
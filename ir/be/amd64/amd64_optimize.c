@@ -0,0 +1,354 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Peephole optimizations for AMD64.
+ */
+#include "irnode_t.h"
+#include "irgmod.h"
+#include "irgwalk.h"
+#include "iredges_t.h"
+#include "heights.h"
+#include "debug.h"
+
+#include "benode.h"
+#include "besched.h"
+#include "bepeephole.h"
+
+#include "amd64_optimize.h"
+#include "amd64_new_nodes.h"
+#include "amd64_nodes_attr.h"
+#include "gen_amd64_regalloc_if.h"
+#include "ia32_architecture.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
+
+/**
+ * Returns true if @p node is an immediate zero materialized in a register.
+ */
+static bool is_zero(const ir_node *node)
+{
+	if (is_amd64_Xor0(node))
+		return true;
+	if (!is_amd64_Const(node))
+		return false;
+	const amd64_attr_t *const attr = get_amd64_attr_const(node);
+	return attr->imm.offset == 0 && attr->imm.symconst == NULL;
+}
+
+/**
+ * Returns true if the upper 32 bits of the register produced by @p node are
+ * known to be zero. Every instruction writing a 32 bit register clears
+ * them.
+ */
+static bool upper_bits_clean(const ir_node *node)
+{
+	if (is_Proj(node)) {
+		const ir_node *const pred = get_Proj_pred(node);
+		if (!is_amd64_LoadZ(pred) || get_Proj_proj(node) != pn_amd64_LoadZ_res)
+			return false;
+		/* movzbq, movzwq and movl all zero extend */
+		return get_amd64_attr_const(pred)->data.insn_mode != INSN_MODE_64;
+	}
+	if (!is_amd64_irn(node))
+		return false;
+
+	switch ((amd64_opcodes)get_amd64_irn_opcode(node)) {
+	case iro_amd64_Xor0:
+		return true;
+	case iro_amd64_Add:
+	case iro_amd64_And:
+	case iro_amd64_Andn:
+	case iro_amd64_Blsi:
+	case iro_amd64_Blsr:
+	case iro_amd64_Const:
+	case iro_amd64_Conv:
+	case iro_amd64_IMul:
+	case iro_amd64_Lea:
+	case iro_amd64_Neg:
+	case iro_amd64_Not:
+	case iro_amd64_Or:
+	case iro_amd64_Sar:
+	case iro_amd64_Sarx:
+	case iro_amd64_Shl:
+	case iro_amd64_Shlx:
+	case iro_amd64_Shr:
+	case iro_amd64_Shrx:
+	case iro_amd64_Sub:
+	case iro_amd64_Xor:
+		return get_amd64_attr_const(node)->data.insn_mode == INSN_MODE_32;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Transforms a Cmp with zero into a Test of the value with itself, which
+ * produces the same flags but needs no register for the zero.
+ */
+static void peephole_amd64_Cmp(ir_node *const node)
+{
+	ir_node *const right = get_irn_n(node, n_amd64_Cmp_right);
+	if (!is_zero(right))
+		return;
+
+	dbg_info           *const dbgi  = get_irn_dbg_info(node);
+	ir_node            *const block = get_nodes_block(node);
+	ir_node            *const left  = get_irn_n(node, n_amd64_Cmp_left);
+	const amd64_attr_t *const attr  = get_amd64_attr_const(node);
+	ir_node            *const test  = new_bd_amd64_Test(dbgi, block, left, left,
+		attr->data.insn_mode, attr->data.ins_permuted, attr->data.cmp_unsigned);
+	arch_set_irn_register(test, arch_get_irn_register(node));
+
+	DBG((dbg, LEVEL_1, "replace %+F with %+F\n", node, test));
+	sched_add_before(node, test);
+	be_peephole_exchange(node, test);
+
+	if (get_irn_n_edges(right) == 0) {
+		sched_remove(right);
+		kill_node(right);
+	}
+}
+
+/**
+ * Transforms a mov $0, reg into the shorter xor reg, reg if the flags are
+ * not live.
+ */
+static void peephole_amd64_Const(ir_node *const node)
+{
+	if (!is_zero(node))
+		return;
+	/* xor destroys the flags, so no-one must be using them */
+	if (be_peephole_get_value(REG_EFLAGS) != NULL)
+		return;
+
+	dbg_info *const dbgi  = get_irn_dbg_info(node);
+	ir_node  *const block = get_nodes_block(node);
+	ir_node  *const xorn  = new_bd_amd64_Xor0(dbgi, block);
+	arch_set_irn_register(xorn, arch_get_irn_register(node));
+
+	sched_add_before(node, xorn);
+	be_peephole_exchange(node, xorn);
+}
+
+/**
+ * Transforms a Lea whose result register is also its base or index register
+ * into an Add, or removes it if it merely copies a register onto itself.
+ */
+static void peephole_amd64_Lea(ir_node *const node)
+{
+	const amd64_addr_attr_t *const attr = get_amd64_addr_attr_const(node);
+	const amd64_addr_t      *const addr = &attr->addr;
+
+	/* frame offsets have already been added to the displacement */
+	if (addr->immediate.offset != 0 || addr->immediate.symconst != NULL)
+		return;
+
+	ir_node *base  = addr->base_input == NO_INPUT
+		? NULL : get_irn_n(node, addr->base_input);
+	ir_node *index = addr->index_input == NO_INPUT
+		? NULL : get_irn_n(node, addr->index_input);
+	if (index != NULL && addr->log_scale != 0)
+		return;
+	if (base == NULL) {
+		base  = index;
+		index = NULL;
+	}
+	if (base == NULL)
+		return;
+
+	const arch_register_t *const out_reg = arch_get_irn_register(node);
+	if (index == NULL) {
+		if (arch_get_irn_register(base) != out_reg)
+			return;
+		/* lea (%reg), %reg is a nop */
+		DBG((dbg, LEVEL_1, "remove copy %+F\n", node));
+		be_peephole_exchange(node, base);
+		return;
+	}
+
+	/* add clobbers the flags */
+	if (be_peephole_get_value(REG_EFLAGS) != NULL)
+		return;
+
+	ir_node *op1;
+	ir_node *op2;
+	if (arch_get_irn_register(base) == out_reg) {
+		op1 = base;
+		op2 = index;
+	} else if (arch_get_irn_register(index) == out_reg) {
+		op1 = index;
+		op2 = base;
+	} else {
+		return;
+	}
+
+	dbg_info *const dbgi  = get_irn_dbg_info(node);
+	ir_node  *const block = get_nodes_block(node);
+	ir_node  *const add   = new_bd_amd64_Add(dbgi, block, op1, op2,
+	                                         attr->base.data.insn_mode);
+	arch_set_irn_register(add, out_reg);
+
+	DBG((dbg, LEVEL_1, "replace %+F with %+F\n", node, add));
+	sched_add_before(node, add);
+	be_peephole_exchange(node, add);
+}
+
+/**
+ * Removes a 32 bit zero extension (movl %eax, %eax) of a value whose upper
+ * bits are already clean.
+ */
+static void peephole_amd64_Conv(ir_node *const node)
+{
+	const amd64_attr_t *const attr = get_amd64_attr_const(node);
+	ir_mode            *const mode = attr->ls_mode;
+	if (get_mode_size_bits(mode) != 32 || mode_is_signed(mode)
+	    || attr->data.insn_mode != INSN_MODE_32)
+		return;
+
+	ir_node *const val = get_irn_n(node, n_amd64_Conv_val);
+	if (arch_get_irn_register(val) != arch_get_irn_register(node))
+		return;
+	if (!upper_bits_clean(val))
+		return;
+
+	DBG((dbg, LEVEL_1, "remove zero extension %+F\n", node));
+	be_peephole_exchange(node, val);
+}
+
+/**
+ * Returns true if @p node sets the zero flag according to its result.
+ */
+static bool produces_zero_flag(const ir_node *node)
+{
+	if (!is_amd64_irn(node))
+		return false;
+	switch ((amd64_opcodes)get_amd64_irn_opcode(node)) {
+	case iro_amd64_Add:
+	case iro_amd64_And:
+	case iro_amd64_Neg:
+	case iro_amd64_Or:
+	case iro_amd64_Sub:
+	case iro_amd64_Xor:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Removes a Test of a value with itself if the instruction computing the
+ * value already set the zero flag and nothing clobbered it since. Only
+ * users checking for (in)equality may reuse it, the other flags differ.
+ */
+static void optimize_Test(ir_node *const node)
+{
+	ir_node *const left = get_irn_n(node, n_amd64_Test_left);
+	if (get_irn_n(node, n_amd64_Test_right) != left)
+		return;
+	if (!produces_zero_flag(left))
+		return;
+
+	ir_node *const block = get_nodes_block(node);
+	if (get_nodes_block(left) != block)
+		return;
+	if (get_amd64_attr_const(left)->data.insn_mode
+	    != get_amd64_attr_const(node)->data.insn_mode)
+		return;
+
+	/* walk the schedule up and abort when something else modifies the flags */
+	for (ir_node *schedpoint = sched_prev(node); schedpoint != left;
+	     schedpoint = sched_prev(schedpoint)) {
+		if (sched_is_begin(schedpoint) || arch_irn_is(schedpoint, modify_flags))
+			return;
+	}
+
+	foreach_out_edge(node, edge) {
+		const ir_node *const user = get_edge_src_irn(edge);
+		if (!is_amd64_Jcc(user))
+			return;
+		ir_relation const relation = get_amd64_attr_const(user)->ext.relation
+		                           & ir_relation_less_equal_greater;
+		if (relation != ir_relation_equal
+		    && relation != ir_relation_less_greater)
+			return;
+	}
+
+	DBG((dbg, LEVEL_1, "reuse flags of %+F for %+F\n", left, node));
+	foreach_out_edge_safe(node, edge) {
+		ir_node *const user = get_edge_src_irn(edge);
+		set_irn_n(user, n_amd64_Jcc_eflags, left);
+	}
+	sched_remove(node);
+	kill_node(node);
+}
+
+static void optimize_block(ir_node *const block, void *const env)
+{
+	(void)env;
+	sched_foreach_safe(block, node) {
+		if (is_amd64_Test(node))
+			optimize_Test(node);
+	}
+}
+
+/**
+ * Moves the Cmp/Test producing the flags of a Jcc directly in front of it, so
+ * the processor can fuse both into a single uop.
+ */
+static void place_flags_before_jcc(ir_node *const block, void *const env)
+{
+	ir_heights_t *const heights = (ir_heights_t*)env;
+
+	ir_node *const jcc = sched_last(block);
+	if (!is_amd64_Jcc(jcc))
+		return;
+
+	ir_node *const flags = get_irn_n(jcc, n_amd64_Jcc_eflags);
+	if (!is_amd64_Cmp(flags) && !is_amd64_Test(flags))
+		return;
+	if (get_nodes_block(flags) != block || sched_next(flags) == jcc)
+		return;
+	if (!be_can_move_down(heights, flags, jcc))
+		return;
+
+	DBG((dbg, LEVEL_1, "move %+F before %+F for macro fusion\n", flags, jcc));
+	sched_remove(flags);
+	sched_add_before(jcc, flags);
+}
+
+/**
+ * Register a peephole optimization function.
+ */
+static void register_peephole_optimization(ir_op *op, peephole_opt_func func)
+{
+	assert(op->ops.generic == NULL);
+	op->ops.generic = (op_func)func;
+}
+
+void amd64_peephole_optimization(ir_graph *irg)
+{
+	ir_clear_opcodes_generic_func();
+	register_peephole_optimization(op_amd64_Cmp,   peephole_amd64_Cmp);
+	register_peephole_optimization(op_amd64_Const, peephole_amd64_Const);
+	register_peephole_optimization(op_amd64_Conv,  peephole_amd64_Conv);
+	register_peephole_optimization(op_amd64_Lea,   peephole_amd64_Lea);
+	be_peephole_opt(irg);
+
+	/* flags can only be reused once the Tests exist */
+	irg_block_walk_graph(irg, NULL, optimize_block, NULL);
+
+	if (ia32_cg_config.use_macro_fusion) {
+		ir_heights_t *const heights = heights_new(irg);
+		irg_block_walk_graph(irg, NULL, place_flags_before_jcc, heights);
+		heights_free(heights);
+	}
+}
+
+void amd64_init_optimize(void)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.be.amd64.optimize");
+}
@@ -0,0 +1,26 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Peephole optimizations for AMD64.
+ */
+#ifndef FIRM_BE_AMD64_AMD64_OPTIMIZE_H
+#define FIRM_BE_AMD64_AMD64_OPTIMIZE_H
+
+#include "firm_types.h"
+
+/**
+ * Performs peephole optimizations on a scheduled graph with registers
+ * assigned.
+ *
+ * @param irg   the graph
+ */
+void amd64_peephole_optimization(ir_graph *irg);
+
+/** Initialize the amd64 peephole optimizer. */
+void amd64_init_optimize(void);
+
+#endif
@@ -21,25 +21,25 @@ $arch = "amd64";
 #		{ name => "gp_NOREG", type => "ignore" }, # we need a dummy register for NoReg nodes
 		{ mode => "mode_Lu" }
 	],
-#	fp => [
-#		{ name => "xmm0",  dwarf => 17 },
-#		{ name => "xmm1",  dwarf => 18 },
-#		{ name => "xmm2",  dwarf => 19 },
-#		{ name => "xmm3",  dwarf => 20 },
-#		{ name => "xmm4",  dwarf => 21 },
-#		{ name => "xmm5",  dwarf => 22 },
-#		{ name => "xmm6",  dwarf => 23 },
-#		{ name => "xmm7",  dwarf => 24 },
-#		{ name => "xmm8",  dwarf => 25 },
-#		{ name => "xmm9",  dwarf => 26 },
-#		{ name => "xmm10", dwarf => 27 },
-#		{ name => "xmm11", dwarf => 28 },
-#		{ name => "xmm12", dwarf => 29 },
-#		{ name => "xmm13", dwarf => 30 },
-#		{ name => "xmm14", dwarf => 31 },
-#		{ name => "xmm15", dwarf => 32 },
-#		{ mode => "mode_D" }
-#	]
+	xmm => [
+		{ name => "xmm0",  dwarf => 17 },
+		{ name => "xmm1",  dwarf => 18 },
+		{ name => "xmm2",  dwarf => 19 },
+		{ name => "xmm3",  dwarf => 20 },
+		{ name => "xmm4",  dwarf => 21 },
+		{ name => "xmm5",  dwarf => 22 },
+		{ name => "xmm6",  dwarf => 23 },
+		{ name => "xmm7",  dwarf => 24 },
+		{ name => "xmm8",  dwarf => 25 },
+		{ name => "xmm9",  dwarf => 26 },
+		{ name => "xmm10", dwarf => 27 },
+		{ name => "xmm11", dwarf => 28 },
+		{ name => "xmm12", dwarf => 29 },
+		{ name => "xmm13", dwarf => 30 },
+		{ name => "xmm14", dwarf => 31 },
+		{ name => "xmm15", dwarf => 32 },
+		{ mode => "mode_D" }
+	],
 	flags => [
 		{ name => "eflags", dwarf => 49 },
 		{ mode => "mode_Iu", flags => "manual_ra" }
@@ -48,6 +48,7 @@ $arch = "amd64";
 
 $mode_gp        = "mode_Lu";
 $mode_flags     = "mode_Iu";
+$mode_xmm       = "mode_D";
 
 sub amd64_custom_init_attr {
 	my $constr = shift;
@@ -64,12 +65,30 @@ $custom_init_attr_func = \&amd64_custom_init_attr;
 
 $default_copy_attr = "amd64_copy_attr";
 
+# conversions of the emit templates, compiled by generate_emitter.pl
+%emit_modifiers = (
+	'#' => "EMIT_RESPECT_LS",
+	'^' => "EMIT_IGNORE_MODE",
+);
+@emit_conversions = (
+	'D(\d)' => 'amd64_emit_register(node, arch_get_irn_register_out(node, $1), MOD)',
+	'S(\d)' => 'amd64_emit_register(node, arch_get_irn_register_in(node, $1), MOD)',
+	'A'     => 'amd64_emit_addr_operand(node)',
+	'C'     => 'amd64_emit_immediate_operand(node)',
+	'M'     => 'amd64_emit_suffix(node, MOD)',
+	'X'     => 'amd64_emit_sse_suffix(node)',
+	'c'     => 'amd64_emit_conv_suffix(node)',
+);
+
 %init_attr = (
 	amd64_attr_t           =>
 		 "\tinit_amd64_attributes(res, irn_flags_, in_reqs, n_res);",
 	amd64_SymConst_attr_t =>
 		"\tinit_amd64_attributes(res, irn_flags_, in_reqs, n_res);"
 		. "\tinit_amd64_SymConst_attributes(res, entity);",
+	amd64_addr_attr_t =>
+		"\tinit_amd64_attributes(res, irn_flags_, in_reqs, n_res);"
+		. "\tinit_amd64_addr_attributes(res, addr);",
 	amd64_switch_jmp_attr_t =>
 		"\tinit_amd64_attributes(res, irn_flags_, in_reqs, n_res);"
 		. "\tinit_amd64_switch_attributes(res, table, table_entity);"
@@ -78,6 +97,7 @@ $default_copy_attr = "amd64_copy_attr";
 %compare_attr = (
 	amd64_attr_t             => "cmp_amd64_attr",
 	amd64_SymConst_attr_t    => "cmp_amd64_attr_SymConst",
+	amd64_addr_attr_t        => "cmp_amd64_addr_attr",
 	amd64_switch_jmp_attr_t  => "cmp_amd64_attr",
 );
 
@@ -205,6 +225,79 @@ Sar => {
 	modified_flags => $status_flags
 },
 
+# BMI2 shifts take the count in any register and leave the flags alone
+Shlx => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	outs      => [ "res" ],
+	emit      => "shlx%M %S1, %S0, %D0",
+	mode      => $mode_gp,
+},
+
+Shrx => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	outs      => [ "res" ],
+	emit      => "shrx%M %S1, %S0, %D0",
+	mode      => $mode_gp,
+},
+
+Sarx => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	outs      => [ "res" ],
+	emit      => "sarx%M %S1, %S0, %D0",
+	mode      => $mode_gp,
+},
+
+# res = ~left & right
+Andn => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "andn%M %S1, %S0, %D0",
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = val & (val - 1)
+Blsr => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp" ], out => [ "gp" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "blsr%M %S0, %D0",
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = val & -val
+Blsi => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp" ], out => [ "gp" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "blsi%M %S0, %D0",
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
 Sub => {
 	irn_flags  => [ "rematerializable" ],
 	attr       => "amd64_insn_mode_t insn_mode",
@@ -313,6 +406,22 @@ Cmp => {
 	modified_flags => 1,
 },
 
+Test => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in  => [ "gp", "gp" ],
+	               out => [ "flags" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "eflags" ],
+	emit      => "test%M %S1, %S0",
+	attr      => "amd64_insn_mode_t insn_mode, int ins_permuted, int cmp_unsigned",
+	init_attr => "attr->data.ins_permuted   = ins_permuted;\n".
+	             "\tattr->data.cmp_unsigned = cmp_unsigned;\n".
+	             "\tattr->data.insn_mode    = insn_mode;\n",
+	mode      => $mode_flags,
+	modified_flags => 1,
+},
+
 Jcc => {
 	state     => "pinned",
 	op_flags  => [ "cfopcode", "forking" ],
@@ -324,30 +433,51 @@ Jcc => {
 	mode      => "mode_T",
 },
 
+# The address nodes have the memory (and the stored value) as first inputs,
+# followed by the base and index registers used by the address.
 LoadZ => {
 	op_flags  => [ "uses_memory" ],
 	state     => "exc_pinned",
-	reg_req   => { in => [ "gp", "none" ],
+	arity     => "variable",
+	reg_req   => { in => [ "none", "gp", "gp" ],
 	               out => [ "gp", "none" ] },
-	ins       => [ "ptr", "mem" ],
 	outs      => [ "res",  "M" ],
-	attr      => "amd64_insn_mode_t insn_mode, ir_entity *entity",
-	attr_type => "amd64_SymConst_attr_t",
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
 	init_attr => "attr->base.data.insn_mode = insn_mode;",
-	emit      => "mov%M %O(%^S0), %D0"
 },
 
 LoadS => {
 	op_flags  => [ "uses_memory" ],
 	state     => "exc_pinned",
-	reg_req   => { in => [ "gp", "none" ],
+	arity     => "variable",
+	reg_req   => { in => [ "none", "gp", "gp" ],
 	               out => [ "gp", "none" ] },
-	ins       => [ "ptr", "mem" ],
 	outs      => [ "res",  "M" ],
-	attr      => "amd64_insn_mode_t insn_mode, ir_entity *entity",
-	attr_type => "amd64_SymConst_attr_t",
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
+	init_attr => "attr->base.data.insn_mode = insn_mode;",
+	emit      => "movs%Mq %A, %^D0"
+},
+
+Lea => {
+	irn_flags => [ "rematerializable" ],
+	arity     => "variable",
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	outs      => [ "res" ],
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
 	init_attr => "attr->base.data.insn_mode = insn_mode;",
-	emit      => "movs%Mq %O(%^S0), %^D0"
+	emit      => "lea%M %A, %D0",
+	mode      => $mode_gp,
+},
+
+LdTls => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { out => [ "gp" ] },
+	outs      => [ "res" ],
+	emit      => "movq %%fs:0, %^D0",
+	mode      => $mode_gp,
 },
 
 FrameAddr => {
@@ -363,14 +493,221 @@ FrameAddr => {
 Store => {
 	op_flags  => [ "uses_memory" ],
 	state     => "exc_pinned",
-	reg_req   => { in => [ "gp", "gp", "none" ], out => [ "none" ] },
-	ins       => [ "ptr", "val", "mem" ],
+	arity     => "variable",
+	reg_req   => { in => [ "gp", "none", "gp", "gp" ], out => [ "none" ] },
 	outs      => [ "M" ],
-	attr      => "amd64_insn_mode_t insn_mode, ir_entity *entity",
-	attr_type => "amd64_SymConst_attr_t",
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
 	init_attr => "attr->base.data.insn_mode = insn_mode;",
 	mode      => "mode_M",
-	emit      => "mov%M %S1, %O(%^S0)"
+	emit      => "mov%M %S0, %A"
+},
+
+# SSE scalar floating point nodes, the insn_mode selects single (INSN_MODE_32)
+# or double (INSN_MODE_64) precision.
+
+xAdds => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm" ], out => [ "in_r1 !in_r2" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "adds%X %^S1, %^D0",
+	mode      => $mode_xmm,
+},
+
+xSubs => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm" ], out => [ "in_r1 !in_r2" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "subs%X %^S1, %^D0",
+	mode      => $mode_xmm,
+},
+
+#
+# FMA3 instructions, the emitter picks the form matching the register
+# assignment
+#
+# res = left * right + addend
+xFmadd => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	outs      => [ "res" ],
+	mode      => $mode_xmm,
+},
+
+# res = left * right - addend
+xFmsub => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	outs      => [ "res" ],
+	mode      => $mode_xmm,
+},
+
+# res = -(left * right) + addend
+xFnmadd => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	outs      => [ "res" ],
+	mode      => $mode_xmm,
+},
+
+xMuls => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm" ], out => [ "in_r1 !in_r2" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "muls%X %^S1, %^D0",
+	mode      => $mode_xmm,
+},
+
+xDivs => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm", "xmm" ], out => [ "in_r1 !in_r2" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "divs%X %^S1, %^D0",
+	mode      => $mode_xmm,
+},
+
+# flips the bits of left set in the mask, used to negate with a sign mask
+xXorp => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm", "xmm" ], out => [ "in_r1 !in_r2" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "res" ],
+	emit      => "xorps %^S1, %^D0",
+	mode      => $mode_xmm,
+},
+
+xZero => {
+	op_flags  => [ "constlike" ],
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { out => [ "xmm" ] },
+	outs      => [ "res" ],
+	emit      => "xorps %^D0, %^D0",
+	mode      => $mode_xmm,
+},
+
+xUcomis => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in  => [ "xmm", "xmm" ], out => [ "flags" ] },
+	ins       => [ "left", "right" ],
+	outs      => [ "eflags" ],
+	emit      => "ucomis%X %^S1, %^S0",
+	attr      => "amd64_insn_mode_t insn_mode, int ins_permuted",
+	init_attr => "attr->data.ins_permuted = ins_permuted;\n".
+	             "\tattr->data.insn_mode    = insn_mode;\n",
+	mode      => $mode_flags,
+	modified_flags => 1,
+},
+
+xMovs => {
+	op_flags  => [ "uses_memory" ],
+	state     => "exc_pinned",
+	arity     => "variable",
+	reg_req   => { in => [ "none", "gp", "gp" ],
+	               out => [ "xmm", "none" ] },
+	outs      => [ "res",  "M" ],
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
+	init_attr => "attr->base.data.insn_mode = insn_mode;",
+	emit      => "movs%X %A, %^D0",
+},
+
+xStores => {
+	op_flags  => [ "uses_memory" ],
+	state     => "exc_pinned",
+	arity     => "variable",
+	reg_req   => { in => [ "xmm", "none", "gp", "gp" ], out => [ "none" ] },
+	outs      => [ "M" ],
+	attr      => "amd64_insn_mode_t insn_mode, amd64_addr_t addr",
+	attr_type => "amd64_addr_attr_t",
+	init_attr => "attr->base.data.insn_mode = insn_mode;",
+	mode      => "mode_M",
+	emit      => "movs%X %^S0, %A",
+},
+
+# the insn_mode of the conversions is the size of the integer
+
+CvtSI2SS => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp" ], out => [ "xmm" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvtsi2ss%M %S0, %^D0",
+	mode      => $mode_xmm,
+},
+
+CvtSI2SD => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "gp" ], out => [ "xmm" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvtsi2sd%M %S0, %^D0",
+	mode      => $mode_xmm,
+},
+
+CvtTSS2SI => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm" ], out => [ "gp" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvttss2si %^S0, %D0",
+	mode      => $mode_gp,
+},
+
+CvtTSD2SI => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "amd64_insn_mode_t insn_mode",
+	init_attr => "attr->data.insn_mode = insn_mode;",
+	reg_req   => { in => [ "xmm" ], out => [ "gp" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvttsd2si %^S0, %D0",
+	mode      => $mode_gp,
+},
+
+CvtSS2SD => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm" ], out => [ "xmm" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvtss2sd %^S0, %^D0",
+	mode      => $mode_xmm,
+},
+
+CvtSD2SS => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm" ], out => [ "xmm" ] },
+	ins       => [ "val" ],
+	outs      => [ "res" ],
+	emit      => "cvtsd2ss %^S0, %^D0",
+	mode      => $mode_xmm,
 },
 
 SwitchJmp => {
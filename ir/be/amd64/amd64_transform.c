@@ -11,26 +11,78 @@
 #include "irgraph_t.h"
 #include "irmode_t.h"
 #include "irgmod.h"
+#include "irgwalk.h"
 #include "ircons.h"
 #include "iropt_t.h"
 #include "error.h"
 #include "debug.h"
 #include "tv_t.h"
+#include "iredges_t.h"
+#include "util.h"
+#include "bitset.h"
+#include "constbits.h"
+#include "pmap.h"
+#include "opt_frame.h"
 
 #include "benode.h"
+#include "beabihelper.h"
 #include "betranshlp.h"
 #include "beutil.h"
+#include "beirg.h"
 #include "bearch_amd64_t.h"
 
 #include "amd64_nodes_attr.h"
 #include "amd64_transform.h"
 #include "amd64_new_nodes.h"
+#include "amd64_cconv.h"
 
 #include "gen_amd64_regalloc_if.h"
 
+#include "ia32_architecture.h"
+
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
-static ir_mode *mode_gp;
+static ir_mode         *mode_gp;
+static ir_mode         *mode_xmm;
+static const arch_register_t *sp_reg = &amd64_registers[REG_RSP];
+static beabi_helper_env_t    *abihelper;
+static be_stackorder_t       *stackorder;
+static calling_convention_t  *cconv = NULL;
+static bool                   frame_may_escape;
+static ir_type               *between_type;
+static pmap                  *node_to_stack;
+
+static const arch_register_t *const caller_saves[] = {
+	&amd64_registers[REG_RAX],
+	&amd64_registers[REG_RCX],
+	&amd64_registers[REG_RDX],
+	&amd64_registers[REG_RSI],
+	&amd64_registers[REG_RDI],
+	&amd64_registers[REG_R8],
+	&amd64_registers[REG_R9],
+	&amd64_registers[REG_R10],
+	&amd64_registers[REG_R11],
+	&amd64_registers[REG_XMM0],
+	&amd64_registers[REG_XMM1],
+	&amd64_registers[REG_XMM2],
+	&amd64_registers[REG_XMM3],
+	&amd64_registers[REG_XMM4],
+	&amd64_registers[REG_XMM5],
+	&amd64_registers[REG_XMM6],
+	&amd64_registers[REG_XMM7],
+	&amd64_registers[REG_XMM8],
+	&amd64_registers[REG_XMM9],
+	&amd64_registers[REG_XMM10],
+	&amd64_registers[REG_XMM11],
+	&amd64_registers[REG_XMM12],
+	&amd64_registers[REG_XMM13],
+	&amd64_registers[REG_XMM14],
+	&amd64_registers[REG_XMM15],
+};
+
+/** 64 bit values of the untransformed graph whose upper 32 bits are known to
+ * be zero, indexed by node index */
+static bitset_t *upper_bits_zero;
 
 /* Some support functions: */
 
@@ -39,15 +91,254 @@ static inline int mode_needs_gp_reg(ir_mode *mode)
 	return mode_is_int(mode) || mode_is_reference(mode);
 }
 
+/** Returns the insn_mode of a scalar SSE operation: single or double. */
+static amd64_insn_mode_t get_xmm_insn_mode(const ir_mode *mode)
+{
+	return get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+}
+
+static amd64_insn_mode_t get_insn_mode_from_mode(const ir_mode *mode)
+{
+	switch (get_mode_size_bits(mode)) {
+	case  8: return INSN_MODE_8;
+	case 16: return INSN_MODE_16;
+	case 32: return INSN_MODE_32;
+	case 64: return INSN_MODE_64;
+	}
+	panic("unexpected mode");
+}
+
+/* Address mode matching: */
+
+/** An address base + index * (1 << log_scale) + symconst + offset. */
+typedef struct amd64_address_t {
+	ir_node   *base;
+	ir_node   *index;
+	ir_entity *frame_entity; /**< frame entity addressed relative to base */
+	ir_entity *symconst;
+	int64_t    offset;
+	unsigned   log_scale;
+} amd64_address_t;
+
+/**
+ * Returns true if a node is only used to compute addresses. Folding such a
+ * node does not extend the live ranges of its operands.
+ */
+static bool is_address_only(const ir_node *node)
+{
+	foreach_out_edge(node, edge) {
+		ir_node *const user = get_edge_src_irn(edge);
+		int      const pos  = get_edge_src_pos(edge);
+		if ((is_Load(user) && pos == n_Load_ptr)
+		 || (is_Store(user) && pos == n_Store_ptr) || is_Add(user))
+			continue;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Folds a Const or an entity address into the displacement.
+ */
+static bool eat_immediate(amd64_address_t *addr, const ir_node *node)
+{
+	if (is_Const(node)) {
+		ir_tarval *const tv = get_Const_tarval(node);
+		if (!tarval_is_long(tv))
+			return false;
+		int64_t const offset = addr->offset + get_tarval_long(tv);
+		/* the displacement is a sign extended 32 bit value */
+		if (offset != (int32_t)offset)
+			return false;
+		addr->offset = offset;
+		return true;
+	} else if (is_SymConst_addr_ent(node) && addr->symconst == NULL) {
+		ir_entity *const entity = get_SymConst_entity(node);
+		/* thread local entities are relative to %fs, not %rip */
+		if (get_entity_owner(entity) == get_tls_type())
+			return false;
+		addr->symconst = entity;
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Folds the constant operands of Adds into the displacement.
+ *
+ * @return the remaining node
+ */
+static ir_node *eat_immediates(amd64_address_t *addr, ir_node *node)
+{
+	while (is_Add(node)) {
+		ir_node *const left  = get_Add_left(node);
+		ir_node *const right = get_Add_right(node);
+		if (eat_immediate(addr, right)) {
+			node = left;
+		} else if (eat_immediate(addr, left)) {
+			node = right;
+		} else {
+			break;
+		}
+	}
+	return node;
+}
+
+/**
+ * Makes a shift by 0 to 3 the scaled index of an address.
+ */
+static bool eat_shl(amd64_address_t *addr, ir_node *node)
+{
+	if (!is_Shl(node) || !is_address_only(node))
+		return false;
+	ir_node *const amount = get_Shl_right(node);
+	if (!is_Const(amount))
+		return false;
+	ir_tarval *const tv = get_Const_tarval(amount);
+	if (!tarval_is_long(tv))
+		return false;
+	long const log_scale = get_tarval_long(tv);
+	if (log_scale < 0 || log_scale > 3)
+		return false;
+	addr->index     = get_Shl_left(node);
+	addr->log_scale = log_scale;
+	return true;
+}
+
+/**
+ * Matches base + index * scale + displacement for the value of a node.
+ *
+ * @param force  fold the node even if it has users other than addresses
+ */
+static void match_address(amd64_address_t *addr, ir_node *node, bool force)
+{
+	memset(addr, 0, sizeof(*addr));
+
+	if (!force && (is_Add(node) || is_Shl(node)) && !is_address_only(node)) {
+		addr->base = node;
+		return;
+	}
+
+	node = eat_immediates(addr, node);
+	if (eat_immediate(addr, node))
+		return;
+
+	if (is_Sel(node)) {
+		/* only Sels of frame entities are left */
+		addr->base         = get_Sel_ptr(node);
+		addr->frame_entity = get_Sel_entity(node);
+		return;
+	}
+
+	if (eat_shl(addr, node))
+		return;
+
+	if (is_Add(node)) {
+		ir_node *const left  = get_Add_left(node);
+		ir_node *const right = get_Add_right(node);
+		unsigned const size  = get_mode_size_bits(get_irn_mode(node));
+		/* base and index registers are used with the full address size */
+		if (get_mode_size_bits(get_irn_mode(left)) == size
+		 && get_mode_size_bits(get_irn_mode(right)) == size) {
+			if (eat_shl(addr, right)) {
+				addr->base = left;
+			} else if (eat_shl(addr, left)) {
+				addr->base = right;
+			} else {
+				addr->base  = left;
+				addr->index = right;
+			}
+			return;
+		}
+	}
+
+	addr->base = node;
+}
+
+/**
+ * Appends the transformed base and index of an address to the inputs of a
+ * node and returns the address for them.
+ */
+static amd64_addr_t create_addr(const amd64_address_t *address, ir_node **in,
+                                int *arity)
+{
+	amd64_addr_t addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.immediate.offset   = address->offset;
+	addr.immediate.symconst = address->symconst;
+	addr.log_scale          = address->log_scale;
+	addr.base_input         = NO_INPUT;
+	addr.index_input        = NO_INPUT;
+	if (address->base != NULL) {
+		addr.base_input = *arity;
+		in[(*arity)++]  = be_transform_node(address->base);
+	}
+	if (address->index != NULL) {
+		addr.index_input = *arity;
+		in[(*arity)++]   = be_transform_node(address->index);
+	}
+	return addr;
+}
+
 /* Op transformers: */
 
+/**
+ * Returns a constant entity in .rodata holding a tarval.
+ */
+static ir_entity *create_float_const_entity(ir_graph *const irg,
+                                            ir_tarval *const tv)
+{
+	amd64_isa_t *isa    = (amd64_isa_t*)be_get_irg_arch_env(irg);
+	ir_entity   *entity = pmap_get(ir_entity, isa->constants, tv);
+	if (entity != NULL)
+		return entity;
+
+	ir_mode *mode = get_tarval_mode(tv);
+	ir_type *type = get_type_for_mode(mode);
+	entity = new_entity(get_glob_type(), id_unique("C%u"), type);
+	set_entity_visibility(entity, ir_visibility_private);
+	add_entity_linkage(entity, IR_LINKAGE_CONSTANT);
+	set_entity_initializer(entity, create_initializer_tarval(tv));
+
+	pmap_insert(isa->constants, tv, entity);
+	return entity;
+}
+
+/**
+ * Loads a tarval from .rodata into an xmm register.
+ */
+static ir_node *create_float_const(dbg_info *dbgi, ir_node *block,
+                                   ir_tarval *tv)
+{
+	ir_graph  *irg    = get_Block_irg(block);
+	ir_entity *entity = create_float_const_entity(irg, tv);
+
+	amd64_addr_t addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.immediate.symconst = entity;
+	addr.base_input         = NO_INPUT;
+	addr.index_input        = NO_INPUT;
+
+	ir_node *in[]  = { get_irg_no_mem(irg) };
+	ir_node *load  = new_bd_amd64_xMovs(dbgi, block, ARRAY_SIZE(in), in,
+	                                    get_xmm_insn_mode(get_tarval_mode(tv)),
+	                                    addr);
+	set_irn_pinned(load, op_pin_state_floats);
+	return new_r_Proj(load, mode_xmm, pn_amd64_xMovs_res);
+}
+
 static ir_node *gen_Const(ir_node *node)
 {
 	ir_node  *block = be_transform_node(get_nodes_block(node));
 	dbg_info *dbgi  = get_irn_dbg_info(node);
 	ir_mode  *mode  = get_irn_mode(node);
-	if (!mode_needs_gp_reg(mode))
-		panic("amd64: float constant not supported yet");
+	if (mode_is_float(mode)) {
+		ir_tarval *tv = get_Const_tarval(node);
+		/* only +0.0 is all zero bits */
+		if (tarval_is_null(tv) && !tarval_is_negative(tv))
+			return new_bd_amd64_xZero(dbgi, block);
+		return create_float_const(dbgi, block, tv);
+	}
 	ir_tarval *tv = get_Const_tarval(node);
 	uint64_t val = get_tarval_uint64(tv);
 	amd64_insn_mode_t imode = val > UINT32_MAX ? INSN_MODE_64 : INSN_MODE_32;
@@ -60,7 +351,25 @@ static ir_node *gen_SymConst(ir_node *node)
 	dbg_info  *dbgi   = get_irn_dbg_info(node);
 	ir_entity *entity = get_SymConst_entity(node);
 
-	return new_bd_amd64_Const(dbgi, block, INSN_MODE_32, 0, false, entity);
+	amd64_addr_t addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.immediate.symconst = entity;
+	addr.index_input        = NO_INPUT;
+	if (get_entity_owner(entity) == get_tls_type()) {
+		/* local exec model: the entity's offset from the thread pointer */
+		if (get_entity_visibility(entity) == ir_visibility_external)
+			panic("access to external thread local %+F not supported",
+			      entity);
+		ir_node *in[1];
+		in[0]           = new_bd_amd64_LdTls(dbgi, block);
+		addr.base_input = 0;
+		return new_bd_amd64_Lea(dbgi, block, ARRAY_SIZE(in), in,
+		                        INSN_MODE_64, addr);
+	}
+
+	/* a %rip relative lea */
+	addr.base_input = NO_INPUT;
+	return new_bd_amd64_Lea(dbgi, block, 0, NULL, INSN_MODE_64, addr);
 }
 
 typedef ir_node* (*binop_constructor)(dbg_info *dbgi, ir_node *block,
@@ -80,15 +389,200 @@ static ir_node *gen_binop(ir_node *const node, binop_constructor const new_node)
 	return new_node(dbgi, block, new_op1, new_op2, imode);
 }
 
-static ir_node *gen_Add (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Add);  }
-static ir_node *gen_And (ir_node *const node) { return gen_binop(node, &new_bd_amd64_And);  }
+typedef ir_node* (*xmm_binop_constructor)(dbg_info *dbgi, ir_node *block,
+		ir_node *left, ir_node *right, amd64_insn_mode_t insn_mode);
+
+static ir_node *gen_xmm_binop(ir_node *const node, ir_node *const op1,
+                              ir_node *const op2, ir_mode *const mode,
+                              xmm_binop_constructor const new_node)
+{
+	dbg_info *const dbgi    = get_irn_dbg_info(node);
+	ir_node  *const block   = be_transform_node(get_nodes_block(node));
+	ir_node  *const new_op1 = be_transform_node(op1);
+	ir_node  *const new_op2 = be_transform_node(op2);
+	return new_node(dbgi, block, new_op1, new_op2, get_xmm_insn_mode(mode));
+}
+
+typedef ir_node* (*fma_constructor)(dbg_info *dbgi, ir_node *block,
+		ir_node *left, ir_node *right, ir_node *addend,
+		amd64_insn_mode_t insn_mode);
+
+/**
+ * Returns true if the Mul @p node may be fused into its only user @p user.
+ */
+static bool is_contractible_Mul(const ir_node *node, const ir_node *user)
+{
+	return is_Mul(node) && get_irn_n_edges(node) == 1
+	    && get_nodes_block(node) == get_nodes_block(user)
+	    && get_irn_mode(node) == get_irn_mode(user);
+}
+
+static ir_node *gen_fma(ir_node *const node, ir_node *const mul,
+                        ir_node *const addend, fma_constructor const new_node)
+{
+	dbg_info *const dbgi       = get_irn_dbg_info(node);
+	ir_node  *const block      = be_transform_node(get_nodes_block(node));
+	ir_node  *const new_left   = be_transform_node(get_Mul_left(mul));
+	ir_node  *const new_right  = be_transform_node(get_Mul_right(mul));
+	ir_node  *const new_addend = be_transform_node(addend);
+	return new_node(dbgi, block, new_left, new_right, new_addend,
+	                get_xmm_insn_mode(get_irn_mode(node)));
+}
+
+static ir_node *gen_Add(ir_node *const node)
+{
+	dbg_info *const dbgi  = get_irn_dbg_info(node);
+	ir_node  *const block = be_transform_node(get_nodes_block(node));
+	ir_mode  *const mode  = get_irn_mode(node);
+	if (mode_is_float(mode)) {
+		ir_node *const left  = get_Add_left(node);
+		ir_node *const right = get_Add_right(node);
+		if (ia32_cg_config.use_fma) {
+			if (is_contractible_Mul(left, node))
+				return gen_fma(node, left, right, &new_bd_amd64_xFmadd);
+			if (is_contractible_Mul(right, node))
+				return gen_fma(node, right, left, &new_bd_amd64_xFmadd);
+		}
+		return gen_xmm_binop(node, left, right, mode, &new_bd_amd64_xAdds);
+	}
+
+	amd64_insn_mode_t imode
+		= get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+
+	/* an Add is an address computation, which needs no two-address copy and
+	 * folds constants and a scaled operand */
+	amd64_address_t address;
+	match_address(&address, node, true);
+	if (address.base == node)
+		return gen_binop(node, &new_bd_amd64_Add);
+
+	ir_node *in[2];
+	int      arity = 0;
+	amd64_addr_t const addr = create_addr(&address, in, &arity);
+	ir_node *const res = new_bd_amd64_Lea(dbgi, block, arity, in, imode, addr);
+	get_amd64_addr_attr(res)->frame_entity = address.frame_entity;
+	return res;
+}
+
+typedef ir_node* (*unop_constructor)(dbg_info *dbgi, ir_node *block,
+		ir_node *op, amd64_insn_mode_t insn_mode);
+
+/**
+ * Returns true if the BMI instructions may be used for @p node.
+ */
+static bool use_bmi(const ir_node *node)
+{
+	return ia32_cg_config.use_bmi
+	    && get_mode_size_bits(get_irn_mode(node)) >= 32;
+}
+
+static ir_node *gen_bmi_unop(ir_node *const node, ir_node *const op,
+                             unop_constructor const new_node)
+{
+	dbg_info *const dbgi   = get_irn_dbg_info(node);
+	ir_node  *const block  = be_transform_node(get_nodes_block(node));
+	ir_node  *const new_op = be_transform_node(op);
+	ir_mode  *const mode   = get_irn_mode(node);
+	amd64_insn_mode_t imode
+		= get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+	return new_node(dbgi, block, new_op, imode);
+}
+
+/**
+ * Matches the BMI forms of val & mask.
+ */
+static ir_node *match_bmi_and(ir_node *const node, ir_node *const val,
+                              ir_node *const mask)
+{
+	/* x & (x - 1) */
+	if (is_Add(mask) && get_Add_left(mask) == val
+	    && is_Const(get_Add_right(mask))
+	    && is_Const_all_one(get_Add_right(mask)))
+		return gen_bmi_unop(node, val, &new_bd_amd64_Blsr);
+	if (is_Sub(mask) && get_Sub_left(mask) == val
+	    && is_Const(get_Sub_right(mask)) && is_Const_one(get_Sub_right(mask)))
+		return gen_bmi_unop(node, val, &new_bd_amd64_Blsr);
+
+	/* x & -x */
+	if (is_Minus(mask) && get_Minus_op(mask) == val)
+		return gen_bmi_unop(node, val, &new_bd_amd64_Blsi);
+
+	/* x & ~y */
+	if (is_Not(mask)) {
+		dbg_info *const dbgi      = get_irn_dbg_info(node);
+		ir_node  *const block     = be_transform_node(get_nodes_block(node));
+		ir_node  *const new_left  = be_transform_node(get_Not_op(mask));
+		ir_node  *const new_right = be_transform_node(val);
+		ir_mode  *const mode      = get_irn_mode(node);
+		amd64_insn_mode_t imode
+			= get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+		return new_bd_amd64_Andn(dbgi, block, new_left, new_right, imode);
+	}
+	return NULL;
+}
+
+static ir_node *gen_And(ir_node *const node)
+{
+	if (use_bmi(node)) {
+		ir_node *const left  = get_And_left(node);
+		ir_node *const right = get_And_right(node);
+		ir_node       *res   = match_bmi_and(node, left, right);
+		if (res == NULL)
+			res = match_bmi_and(node, right, left);
+		if (res != NULL)
+			return res;
+	}
+	return gen_binop(node, &new_bd_amd64_And);
+}
+
 static ir_node *gen_Eor (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Xor);  }
 static ir_node *gen_Or  (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Or);   }
-static ir_node *gen_Mul (ir_node *const node) { return gen_binop(node, &new_bd_amd64_IMul); }
-static ir_node *gen_Shl (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Shl);  }
-static ir_node *gen_Shr (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Shr);  }
-static ir_node *gen_Shrs(ir_node *const node) { return gen_binop(node, &new_bd_amd64_Sar);  }
-static ir_node *gen_Sub (ir_node *const node) { return gen_binop(node, &new_bd_amd64_Sub);  }
+
+/* with BMI2 the shift count needs not be in %cl */
+static ir_node *gen_Shl(ir_node *const node)
+{
+	return gen_binop(node, use_bmi(node) ? &new_bd_amd64_Shlx
+	                                     : &new_bd_amd64_Shl);
+}
+
+static ir_node *gen_Shr(ir_node *const node)
+{
+	return gen_binop(node, use_bmi(node) ? &new_bd_amd64_Shrx
+	                                     : &new_bd_amd64_Shr);
+}
+
+static ir_node *gen_Shrs(ir_node *const node)
+{
+	return gen_binop(node, use_bmi(node) ? &new_bd_amd64_Sarx
+	                                     : &new_bd_amd64_Sar);
+}
+
+static ir_node *gen_Mul(ir_node *const node)
+{
+	ir_mode *const mode = get_irn_mode(node);
+	if (mode_is_float(mode)) {
+		return gen_xmm_binop(node, get_Mul_left(node), get_Mul_right(node),
+		                     mode, &new_bd_amd64_xMuls);
+	}
+	return gen_binop(node, &new_bd_amd64_IMul);
+}
+
+static ir_node *gen_Sub(ir_node *const node)
+{
+	ir_mode *const mode = get_irn_mode(node);
+	if (mode_is_float(mode)) {
+		ir_node *const left  = get_Sub_left(node);
+		ir_node *const right = get_Sub_right(node);
+		if (ia32_cg_config.use_fma) {
+			if (is_contractible_Mul(left, node))
+				return gen_fma(node, left, right, &new_bd_amd64_xFmsub);
+			if (is_contractible_Mul(right, node))
+				return gen_fma(node, right, left, &new_bd_amd64_xFnmadd);
+		}
+		return gen_xmm_binop(node, left, right, mode, &new_bd_amd64_xSubs);
+	}
+	return gen_binop(node, &new_bd_amd64_Sub);
+}
 
 static ir_node *create_div(ir_node *const node, ir_mode *const mode,
                            ir_node *const op1, ir_node *const op2,
@@ -122,10 +616,10 @@ static ir_node *create_div(ir_node *const node, ir_mode *const mode,
 static ir_node *gen_Div(ir_node *const node)
 {
 	ir_mode *const mode = get_Div_resmode(node);
-	if (!mode_needs_gp_reg(mode))
-		panic("amd64: float div NIY");
-	ir_node *const op1 = get_Div_left(node);
-	ir_node *const op2 = get_Div_right(node);
+	ir_node *const op1  = get_Div_left(node);
+	ir_node *const op2  = get_Div_right(node);
+	if (mode_is_float(mode))
+		return gen_xmm_binop(node, op1, op2, mode, &new_bd_amd64_xDivs);
 	ir_node *const mem = get_Div_mem(node);
 	return create_div(node, mode, op1, op2, mem);
 }
@@ -136,6 +630,20 @@ static ir_node *gen_Proj_Div(ir_node *const node)
 	ir_node *new_pred = be_transform_node(pred);
 	long     pn       = get_Proj_proj(node);
 
+	if (is_amd64_xDivs(new_pred)) {
+		/* divss/divsd neither use memory nor trap */
+		switch ((pn_Div)pn) {
+		case pn_Div_M:
+			return be_transform_node(get_Div_mem(pred));
+		case pn_Div_res:
+			return new_pred;
+		case pn_Div_X_except:
+		case pn_Div_X_regular:
+			panic("amd64 exception NIY");
+		}
+		panic("invalid Div Proj");
+	}
+
 	assert((long)pn_amd64_Div_M == (long)pn_amd64_IDiv_M);
 	assert((long)pn_amd64_Div_res_div == (long)pn_amd64_IDiv_res_div);
 	switch((pn_Div)pn) {
@@ -197,6 +705,19 @@ static ir_node *gen_unop(ir_node *const node, int op_pos, unop_constructor gen)
 
 static ir_node *gen_Minus(ir_node *const node)
 {
+	ir_mode *const mode = get_irn_mode(node);
+	if (mode_is_float(mode)) {
+		/* flip the sign bit */
+		dbg_info  *const dbgi     = get_irn_dbg_info(node);
+		ir_node   *const block    = be_transform_node(get_nodes_block(node));
+		ir_node   *const new_op   = be_transform_node(get_Minus_op(node));
+		ir_mode   *const int_mode = get_mode_size_bits(mode) > 32
+		                            ? mode_Lu : mode_Iu;
+		ir_tarval *const sign     = tarval_shl_unsigned(
+			get_mode_one(int_mode), get_mode_size_bits(int_mode) - 1);
+		ir_node   *const mask     = create_float_const(dbgi, block, sign);
+		return new_bd_amd64_xXorp(dbgi, block, new_op, mask);
+	}
 	return gen_unop(node, n_Minus_op, &new_bd_amd64_Neg);
 }
 static ir_node *gen_Not(ir_node *const node)
@@ -234,14 +755,6 @@ static ir_node *gen_Switch(ir_node *node)
 	return out;
 }
 
-static ir_node *gen_be_Call(ir_node *node)
-{
-	ir_node *res = be_duplicate_node(node);
-	arch_add_irn_flags(res, arch_irn_flags_modify_flags);
-
-	return res;
-}
-
 static bool needs_extension(ir_node *op)
 {
 	ir_mode *mode = get_irn_mode(op);
@@ -262,7 +775,25 @@ static ir_node *gen_Cmp(ir_node *node)
 	bool      is_unsigned;
 
 	if (mode_is_float(cmp_mode)) {
-		panic("Floating point not implemented yet!");
+		/* ucomis leaves less and unordered indistinguishable in the carry
+		 * flag, so compare the other way round for these relations */
+		ir_relation const relation = get_Cmp_relation(node);
+		bool permute;
+		switch (relation) {
+		case ir_relation_less:
+		case ir_relation_less_equal:
+		case ir_relation_unordered_greater:
+		case ir_relation_unordered_greater_equal:
+			permute = true;
+			break;
+		default:
+			permute = false;
+			break;
+		}
+		new_op1 = be_transform_node(permute ? op2 : op1);
+		new_op2 = be_transform_node(permute ? op1 : op2);
+		return new_bd_amd64_xUcomis(dbgi, block, new_op1, new_op2,
+		                            get_xmm_insn_mode(cmp_mode), permute);
 	}
 
 	amd64_insn_mode_t insn_mode
@@ -298,6 +829,8 @@ static ir_node *gen_Phi(ir_node *node)
 	if (mode_needs_gp_reg(mode)) {
 		/* all integer operations are on 64bit registers now */
 		req  = amd64_reg_classes[CLASS_amd64_gp].class_req;
+	} else if (mode_is_float(mode)) {
+		req  = amd64_reg_classes[CLASS_amd64_xmm].class_req;
 	} else {
 		req = arch_no_register_req;
 	}
@@ -305,6 +838,187 @@ static ir_node *gen_Phi(ir_node *node)
 	return be_transform_phi(node, req);
 }
 
+/**
+ * Converts between integer and float modes or between float modes.
+ */
+static ir_node *gen_float_conv(ir_node *node, ir_node *new_op,
+                               ir_mode *src_mode, ir_mode *dst_mode)
+{
+	ir_node  *block    = be_transform_node(get_nodes_block(node));
+	dbg_info *dbgi     = get_irn_dbg_info(node);
+	unsigned  src_bits = get_mode_size_bits(src_mode);
+	unsigned  dst_bits = get_mode_size_bits(dst_mode);
+
+	if (mode_is_float(src_mode) && mode_is_float(dst_mode)) {
+		if (src_bits == dst_bits)
+			return new_op;
+		return src_bits < dst_bits ? new_bd_amd64_CvtSS2SD(dbgi, block, new_op)
+		                           : new_bd_amd64_CvtSD2SS(dbgi, block, new_op);
+	}
+
+	if (mode_is_float(src_mode)) {
+		/* cvtts?2si converts to signed integers, an unsigned 32 bit result is
+		 * the low half of a 64 bit conversion */
+		if (dst_bits > 32 && !mode_is_signed(dst_mode))
+			panic("amd64: float to unsigned 64bit conversion not supported yet");
+		amd64_insn_mode_t insn_mode
+			= dst_bits < 32 || (dst_bits == 32 && mode_is_signed(dst_mode))
+			? INSN_MODE_32 : INSN_MODE_64;
+		return src_bits > 32
+		       ? new_bd_amd64_CvtTSD2SI(dbgi, block, new_op, insn_mode)
+		       : new_bd_amd64_CvtTSS2SI(dbgi, block, new_op, insn_mode);
+	}
+
+	/* cvtsi2s? converts from signed integers, so smaller integers are
+	 * extended to 64 bit first */
+	amd64_insn_mode_t insn_mode = INSN_MODE_64;
+	if (src_bits == 32 && mode_is_signed(src_mode)) {
+		insn_mode = INSN_MODE_32;
+	} else if (src_bits < 64) {
+		new_op = new_bd_amd64_Conv(dbgi, block, new_op, src_mode);
+		if (src_bits == 32) {
+			amd64_attr_t *const attr = get_amd64_attr(new_op);
+			attr->data.insn_mode = INSN_MODE_32;
+		}
+	} else if (!mode_is_signed(src_mode)) {
+		panic("amd64: unsigned 64bit to float conversion not supported yet");
+	}
+	return dst_bits > 32 ? new_bd_amd64_CvtSI2SD(dbgi, block, new_op, insn_mode)
+	                     : new_bd_amd64_CvtSI2SS(dbgi, block, new_op, insn_mode);
+}
+
+/**
+ * Returns true if the register holding @p node, a value of a mode with at
+ * most 32 bits, has its upper 32 bits cleared. Every instruction writing a
+ * 32 bit register clears them, the exceptions are sign extensions and values
+ * from outside like parameters.
+ */
+static bool upper_bits_clean(const ir_node *node, unsigned depth)
+{
+	switch (get_irn_opcode(node)) {
+	case iro_Add:
+	case iro_And:
+	case iro_Eor:
+	case iro_Minus:
+	case iro_Mul:
+	case iro_Not:
+	case iro_Or:
+	case iro_Shl:
+	case iro_Shr:
+	case iro_Shrs:
+	case iro_Sub:
+		return true;
+
+	case iro_Const:
+		return get_tarval_uint64(get_Const_tarval(node)) <= UINT32_MAX;
+
+	case iro_Conv: {
+		const ir_node *const op       = get_Conv_op(node);
+		ir_mode       *const src_mode = get_irn_mode(op);
+		if (!mode_needs_gp_reg(src_mode))
+			return false;
+		unsigned const src_bits = get_mode_size_bits(src_mode);
+		unsigned const dst_bits = get_mode_size_bits(get_irn_mode(node));
+		if (src_bits == dst_bits)
+			return depth > 0 && upper_bits_clean(op, depth - 1);
+		/* truncations are left out if nobody needs a clean register, but then
+		 * nobody asks either */
+		ir_mode *const min_mode = src_bits < dst_bits ? src_mode
+		                                              : get_irn_mode(node);
+		return !mode_is_signed(min_mode);
+	}
+
+	case iro_Proj: {
+		const ir_node *const pred = get_Proj_pred(node);
+		if (is_Load(pred))
+			return !mode_is_signed(get_Load_mode(pred));
+		return is_Div(pred) || is_Mod(pred);
+	}
+
+	case iro_Phi:
+		if (depth == 0)
+			return false;
+		for (int i = 0, arity = get_Phi_n_preds(node); i < arity; ++i) {
+			if (!upper_bits_clean(get_Phi_pred(node, i), depth - 1))
+				return false;
+		}
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Returns true if all users of @p node, a value of a mode with at most 32
+ * bits, compute with 32 bit instructions which ignore the upper half of its
+ * register.
+ */
+static bool upper_bits_ignored(const ir_node *node)
+{
+	foreach_out_edge(node, edge) {
+		const ir_node *const user = get_edge_src_irn(edge);
+		switch (get_irn_opcode(user)) {
+		case iro_Add:
+		case iro_And:
+		case iro_Cmp:
+		case iro_Div:
+		case iro_Eor:
+		case iro_Minus:
+		case iro_Mod:
+		case iro_Mul:
+		case iro_Not:
+		case iro_Or:
+		case iro_Shl:
+		case iro_Shr:
+		case iro_Shrs:
+		case iro_Sub:
+			continue;
+		case iro_Store:
+			if (get_edge_src_pos(edge) == n_Store_value)
+				continue;
+			return false;
+		default:
+			return false;
+		}
+	}
+	return true;
+}
+
+static void collect_upper_bits_zero(ir_node *node, void *env)
+{
+	(void)env;
+	ir_mode *const mode = get_irn_mode(node);
+	if (!mode_is_int(mode) || get_mode_size_bits(mode) != 64)
+		return;
+	bitinfo const *const b = get_bitinfo(node);
+	if (b == NULL)
+		return;
+	/* the bits may not be one and are not one, the latter rules out
+	 * unreachable values */
+	if (tarval_is_null(tarval_shr_unsigned(b->z, 32))
+	    && tarval_is_null(tarval_shr_unsigned(b->o, 32)))
+		bitset_set(upper_bits_zero, get_irn_idx(node));
+}
+
+/**
+ * Records the 64 bit values whose upper half constbits proves to be zero,
+ * truncating them to 32 bits needs no instruction.
+ */
+static void analyze_upper_bits_zero(ir_graph *irg)
+{
+	struct obstack obst;
+	obstack_init(&obst);
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	constbits_analyze(irg, &obst);
+
+	upper_bits_zero = bitset_malloc(get_irg_last_idx(irg));
+	irg_walk_graph(irg, NULL, collect_upper_bits_zero, NULL);
+
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	obstack_free(&obst, NULL);
+}
+
 static ir_node *gen_Conv(ir_node *node)
 {
 	ir_node  *block    = be_transform_node(get_nodes_block(node));
@@ -318,7 +1032,7 @@ static ir_node *gen_Conv(ir_node *node)
 		return new_op;
 
 	if (mode_is_float(src_mode) || mode_is_float(dst_mode)) {
-		panic("float not supported yet");
+		return gen_float_conv(node, new_op, src_mode, dst_mode);
 	} else { /* complete in gp registers */
 		int src_bits = get_mode_size_bits(src_mode);
 		int dst_bits = get_mode_size_bits(dst_mode);
@@ -335,6 +1049,17 @@ static ir_node *gen_Conv(ir_node *node)
 			min_mode = dst_mode;
 		}
 
+		/* a 32 bit zero extension is implicit if the upper half of the
+		 * register is zero already, a truncation is not needed either if
+		 * no user looks at the upper half */
+		if (get_mode_size_bits(min_mode) == 32 && !mode_is_signed(min_mode)) {
+			if (src_bits < dst_bits
+			    ? upper_bits_clean(op, 3)
+			    : bitset_is_set(upper_bits_zero, get_irn_idx(op))
+			      || upper_bits_ignored(node))
+				return new_op;
+		}
+
 		ir_node *res = new_bd_amd64_Conv(dbgi, block, new_op, min_mode);
 		if (!mode_is_signed(min_mode) && get_mode_size_bits(min_mode) == 32) {
 			amd64_attr_t *const attr = get_amd64_attr(res);
@@ -345,22 +1070,10 @@ static ir_node *gen_Conv(ir_node *node)
 	}
 }
 
-static amd64_insn_mode_t get_insn_mode_from_mode(const ir_mode *mode)
-{
-	switch (get_mode_size_bits(mode)) {
-	case  8: return INSN_MODE_8;
-	case 16: return INSN_MODE_16;
-	case 32: return INSN_MODE_32;
-	case 64: return INSN_MODE_64;
-	}
-	panic("unexpected mode");
-}
-
 static ir_node *gen_Store(ir_node *node)
 {
 	ir_node  *block    = be_transform_node(get_nodes_block(node));
 	ir_node  *ptr      = get_Store_ptr(node);
-	ir_node  *new_ptr  = be_transform_node(ptr);
 	ir_node  *mem      = get_Store_mem(node);
 	ir_node  *new_mem  = be_transform_node(mem);
 	ir_node  *val      = get_Store_value(node);
@@ -369,13 +1082,20 @@ static ir_node *gen_Store(ir_node *node)
 	dbg_info *dbgi     = get_irn_dbg_info(node);
 	ir_node *new_store;
 
+	amd64_address_t address;
+	match_address(&address, ptr, false);
+	ir_node *in[4] = { new_val, new_mem };
+	int      arity = 2;
+	amd64_addr_t addr = create_addr(&address, in, &arity);
 	if (mode_is_float(mode)) {
-		panic("Float not supported yet");
+		new_store = new_bd_amd64_xStores(dbgi, block, arity, in,
+		                                 get_xmm_insn_mode(mode), addr);
 	} else {
 		assert(mode_needs_gp_reg(mode) && "unsupported mode for Store");
 		amd64_insn_mode_t insn_mode = get_insn_mode_from_mode(mode);
-		new_store = new_bd_amd64_Store(dbgi, block, new_ptr, new_val, new_mem, insn_mode, NULL);
+		new_store = new_bd_amd64_Store(dbgi, block, arity, in, insn_mode, addr);
 	}
+	get_amd64_addr_attr(new_store)->frame_entity = address.frame_entity;
 	set_irn_pinned(new_store, get_irn_pinned(node));
 	return new_store;
 }
@@ -384,24 +1104,30 @@ static ir_node *gen_Load(ir_node *node)
 {
 	ir_node  *block    = be_transform_node(get_nodes_block(node));
 	ir_node  *ptr      = get_Load_ptr(node);
-	ir_node  *new_ptr  = be_transform_node(ptr);
 	ir_node  *mem      = get_Load_mem(node);
 	ir_node  *new_mem  = be_transform_node(mem);
 	ir_mode  *mode     = get_Load_mode(node);
 	dbg_info *dbgi     = get_irn_dbg_info(node);
 	ir_node  *new_load;
 
+	amd64_address_t address;
+	match_address(&address, ptr, false);
+	ir_node *in[3] = { new_mem };
+	int      arity = 1;
+	amd64_addr_t addr = create_addr(&address, in, &arity);
 	if (mode_is_float(mode)) {
-		panic("Float not supported yet");
+		new_load = new_bd_amd64_xMovs(dbgi, block, arity, in,
+		                              get_xmm_insn_mode(mode), addr);
 	} else {
 		assert(mode_needs_gp_reg(mode) && "unsupported mode for Load");
 		amd64_insn_mode_t insn_mode = get_insn_mode_from_mode(mode);
 		if (get_mode_size_bits(mode) < 64 && mode_is_signed(mode)) {
-			new_load = new_bd_amd64_LoadS(dbgi, block, new_ptr, new_mem, insn_mode, NULL);
+			new_load = new_bd_amd64_LoadS(dbgi, block, arity, in, insn_mode, addr);
 		} else {
-			new_load = new_bd_amd64_LoadZ(dbgi, block, new_ptr, new_mem, insn_mode, NULL);
+			new_load = new_bd_amd64_LoadZ(dbgi, block, arity, in, insn_mode, addr);
 		}
 	}
+	get_amd64_addr_attr(new_load)->frame_entity = address.frame_entity;
 	set_irn_pinned(new_load, get_irn_pinned(node));
 
 	return new_load;
@@ -432,6 +1158,13 @@ static ir_node *gen_Proj_Load(ir_node *node)
 				return new_rd_Proj(dbgi, new_load, mode_M, pn_amd64_LoadZ_M);
 			}
 		break;
+		case iro_amd64_xMovs:
+			if (proj == pn_Load_res) {
+				return new_rd_Proj(dbgi, new_load, mode_xmm, pn_amd64_xMovs_res);
+			} else if (proj == pn_Load_M) {
+				return new_rd_Proj(dbgi, new_load, mode_M, pn_amd64_xMovs_M);
+			}
+		break;
 		default:
 			panic("Unsupported Proj from Load");
 	}
@@ -450,45 +1183,535 @@ static ir_node *gen_Proj_Store(ir_node *node)
 	}
 }
 
-static ir_node *gen_Proj_be_Call(ir_node *node)
+static ir_node *gen_Sel(ir_node *node)
 {
-	ir_mode *mode = get_irn_mode(node);
-	if (mode_needs_gp_reg(mode)) {
-		ir_node *pred     = get_Proj_pred(node);
-		ir_node *new_pred = be_transform_node(pred);
-		long     pn       = get_Proj_proj(node);
-		ir_node *new_proj = new_r_Proj(new_pred, mode_Lu, pn);
-		return new_proj;
+	dbg_info  *dbgi      = get_irn_dbg_info(node);
+	ir_node   *block     = be_transform_node(get_nodes_block(node));
+	ir_node   *ptr       = get_Sel_ptr(node);
+	ir_node   *new_ptr   = be_transform_node(ptr);
+	ir_entity *entity    = get_Sel_entity(node);
+
+	/* must be the frame pointer all other sels must have been lowered
+	 * already */
+	assert(is_Proj(ptr) && is_Start(get_Proj_pred(ptr)));
+
+	return new_bd_amd64_FrameAddr(dbgi, block, new_ptr, entity);
+}
+
+/**
+ * Loads a value of @p mode from the frame entity @p entity.
+ */
+static ir_node *create_frame_load(dbg_info *dbgi, ir_node *block,
+                                  ir_node *base, ir_node *mem, ir_mode *mode,
+                                  ir_entity *entity)
+{
+	amd64_addr_t addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.base_input  = 1;
+	addr.index_input = NO_INPUT;
+
+	ir_node *in[] = { mem, base };
+	ir_node *load;
+	ir_node *value;
+	if (mode_is_float(mode)) {
+		load  = new_bd_amd64_xMovs(dbgi, block, ARRAY_SIZE(in), in,
+		                           get_xmm_insn_mode(mode), addr);
+		value = new_r_Proj(load, mode_xmm, pn_amd64_xMovs_res);
 	} else {
-		return be_duplicate_node(node);
+		amd64_insn_mode_t insn_mode = get_insn_mode_from_mode(mode);
+		if (get_mode_size_bits(mode) < 64 && mode_is_signed(mode)) {
+			load  = new_bd_amd64_LoadS(dbgi, block, ARRAY_SIZE(in), in,
+			                           insn_mode, addr);
+			value = new_r_Proj(load, mode_gp, pn_amd64_LoadS_res);
+		} else {
+			load  = new_bd_amd64_LoadZ(dbgi, block, ARRAY_SIZE(in), in,
+			                           insn_mode, addr);
+			value = new_r_Proj(load, mode_gp, pn_amd64_LoadZ_res);
+		}
 	}
+	get_amd64_addr_attr(load)->frame_entity = entity;
+	set_irn_pinned(load, op_pin_state_floats);
+	return value;
 }
 
-static ir_node *gen_be_FrameAddr(ir_node *node)
+/**
+ * Returns the number of the output of a Call which delivers the value of
+ * the caller save register @p reg.
+ */
+static long get_call_out_for_reg(const arch_register_t *reg)
 {
-	ir_node   *block  = be_transform_node(get_nodes_block(node));
-	ir_entity *ent    = be_get_frame_entity(node);
-	ir_node   *fp     = be_get_FrameAddr_frame(node);
-	ir_node   *new_fp = be_transform_node(fp);
-	dbg_info  *dbgi   = get_irn_dbg_info(node);
-	ir_node   *new_node;
+	for (size_t i = 0; i < ARRAY_SIZE(caller_saves); ++i) {
+		if (caller_saves[i] == reg)
+			return pn_be_Call_first_res + i;
+	}
+	panic("%s is not a caller save register", reg->name);
+}
+
+static ir_node *gen_Proj_Start(ir_node *node)
+{
+	ir_node *block     = get_nodes_block(node);
+	ir_node *new_block = be_transform_node(block);
+	long     pn        = get_Proj_proj(node);
+
+	/* make sure the prolog is constructed */
+	be_transform_node(get_Proj_pred(node));
+
+	switch ((pn_Start) pn) {
+	case pn_Start_X_initial_exec:
+		/* we exchange the ProjX with a jump */
+		return new_bd_amd64_Jmp(NULL, new_block);
+
+	case pn_Start_M:
+		return be_prolog_get_memory(abihelper);
+
+	case pn_Start_T_args:
+		return new_r_Bad(get_irn_irg(block), mode_T);
 
-	new_node = new_bd_amd64_FrameAddr(dbgi, block, new_fp, ent);
-	return new_node;
+	case pn_Start_P_frame_base:
+		return be_prolog_get_reg_value(abihelper, sp_reg);
+	}
+	panic("unexpected start proj: %ld\n", pn);
+}
+
+static ir_node *gen_Proj_Proj_Start(ir_node *node)
+{
+	long     pn        = get_Proj_proj(node);
+	ir_node *block     = get_nodes_block(node);
+	ir_node *new_block = be_transform_node(block);
+
+	/* Proj->Proj->Start must be a method argument */
+	assert(get_Proj_proj(get_Proj_pred(node)) == pn_Start_T_args);
+
+	const reg_or_stackslot_t *param = &cconv->parameters[pn];
+	if (param->reg != NULL) {
+		/* argument transmitted in register */
+		return be_prolog_get_reg_value(abihelper, param->reg);
+	}
+
+	/* argument transmitted on stack */
+	ir_node *sp  = be_prolog_get_reg_value(abihelper, sp_reg);
+	ir_node *mem = be_prolog_get_memory(abihelper);
+	return create_frame_load(NULL, new_block, sp, mem,
+	                         get_type_mode(param->type), param->entity);
 }
 
-static ir_node *gen_be_Start(ir_node *node)
+static ir_node *gen_Proj_Proj_Call(ir_node *node)
 {
-	ir_node *new_node = be_duplicate_node(node);
-	be_start_set_setup_stackframe(new_node, true);
-	return new_node;
+	long                  pn            = get_Proj_proj(node);
+	ir_node              *call          = get_Proj_pred(get_Proj_pred(node));
+	ir_node              *new_call      = be_transform_node(call);
+	ir_type              *function_type = get_Call_type(call);
+	calling_convention_t *cconv
+		= amd64_decide_calling_convention(NULL, function_type);
+	const reg_or_stackslot_t *res  = &cconv->results[pn];
+	ir_mode                  *mode = get_irn_mode(node);
+
+	assert(res->reg != NULL);
+	long     out    = get_call_out_for_reg(res->reg);
+	ir_node *result = new_r_Proj(new_call,
+	                             mode_is_float(mode) ? mode : mode_gp, out);
+
+	amd64_free_calling_convention(cconv);
+	return result;
 }
 
-static ir_node *gen_be_Return(ir_node *node)
+static ir_node *gen_Proj_Proj(ir_node *node)
 {
-	ir_node *new_node = be_duplicate_node(node);
-	be_return_set_destroy_stackframe(new_node, true);
-	return new_node;
+	ir_node *pred      = get_Proj_pred(node);
+	ir_node *pred_pred = get_Proj_pred(pred);
+	if (is_Call(pred_pred)) {
+		return gen_Proj_Proj_Call(node);
+	} else if (is_Start(pred_pred)) {
+		return gen_Proj_Proj_Start(node);
+	}
+	panic("code selection didn't expect Proj(Proj) after %+F\n", pred_pred);
+}
+
+static ir_node *gen_Proj_Call(ir_node *node)
+{
+	long     pn       = get_Proj_proj(node);
+	ir_node *call     = get_Proj_pred(node);
+	ir_node *new_call = be_transform_node(call);
+
+	switch ((pn_Call) pn) {
+	case pn_Call_M:
+		return new_r_Proj(new_call, mode_M, pn_be_Call_M);
+	case pn_Call_X_regular:
+		return new_r_Proj(new_call, mode_X, pn_be_Call_X_regular);
+	case pn_Call_X_except:
+		return new_r_Proj(new_call, mode_X, pn_be_Call_X_except);
+	case pn_Call_T_result:
+		break;
+	}
+	panic("Unexpected Call proj %ld\n", pn);
+}
+
+/**
+ * Returns the between type, only the return address lies between the frame
+ * and the stack arguments as no frame pointer is set up.
+ */
+static ir_type *amd64_get_between_type(void)
+{
+	if (between_type == NULL) {
+		ir_type *ret_addr_type = new_type_primitive(mode_Lu);
+
+		between_type = new_type_class(new_id_from_str("amd64_between_type"));
+		ir_entity *ret_addr_ent = new_entity(between_type,
+		                                     new_id_from_str("ret_addr"),
+		                                     ret_addr_type);
+		set_entity_offset(ret_addr_ent, 0);
+		set_type_size_bytes(between_type, get_type_size_bytes(ret_addr_type));
+		set_type_state(between_type, layout_fixed);
+	}
+
+	return between_type;
+}
+
+static void create_stacklayout(ir_graph *irg)
+{
+	ir_entity         *entity        = get_irg_entity(irg);
+	ir_type           *function_type = get_entity_type(entity);
+	ir_type           *frame_type    = get_irg_frame_type(irg);
+	be_stack_layout_t *layout        = be_get_irg_stack_layout(irg);
+	size_t             n_params      = get_method_n_params(function_type);
+
+	/* calling conventions must be decided by now */
+	assert(cconv != NULL);
+
+	/* construct argument type, the parameter entities of stack arguments
+	 * move there, the ones of register arguments stay in the frame and get
+	 * the argument stored */
+	ir_type *arg_type = new_type_struct(id_mangle_u(get_entity_ident(entity), new_id_from_chars("arg_type", 8)));
+	for (size_t f = get_compound_n_members(frame_type); f-- > 0; ) {
+		ir_entity *member = get_compound_member(frame_type, f);
+		if (!is_parameter_entity(member))
+			continue;
+
+		size_t num = get_entity_parameter_number(member);
+		if (num == IR_VA_START_PARAMETER_NUMBER)
+			continue;
+		assert(num < n_params);
+		reg_or_stackslot_t *param = &cconv->parameters[num];
+		if (param->reg != NULL)
+			continue;
+		if (param->entity != NULL)
+			panic("multiple entities for parameter %u in %+F found", num, irg);
+		param->entity = member;
+		set_entity_owner(member, arg_type);
+	}
+	for (size_t p = 0; p < n_params; ++p) {
+		reg_or_stackslot_t *param = &cconv->parameters[p];
+		if (param->reg != NULL)
+			continue;
+		if (param->entity == NULL)
+			param->entity = new_parameter_entity(arg_type, p, param->type);
+		set_entity_offset(param->entity, param->offset);
+	}
+	set_type_size_bytes(arg_type, cconv->param_stack_size);
+	set_type_state(arg_type, layout_fixed);
+
+	memset(layout, 0, sizeof(*layout));
+
+	layout->frame_type     = frame_type;
+	layout->between_type   = amd64_get_between_type();
+	layout->arg_type       = arg_type;
+	layout->initial_offset = 0;
+	layout->initial_bias   = 0;
+	layout->sp_relative    = true;
+
+	assert(N_FRAME_TYPES == 3);
+	layout->order[0] = layout->frame_type;
+	layout->order[1] = layout->between_type;
+	layout->order[2] = layout->arg_type;
+}
+
+/**
+ * transform the start node to the prolog code
+ */
+static ir_node *gen_Start(ir_node *node)
+{
+	ir_graph  *irg           = get_irn_irg(node);
+	ir_entity *entity        = get_irg_entity(irg);
+	ir_type   *function_type = get_entity_type(entity);
+	ir_node   *block         = get_nodes_block(node);
+	ir_node   *new_block     = be_transform_node(block);
+	dbg_info  *dbgi          = get_irn_dbg_info(node);
+
+	/* stackpointer is important at function prolog */
+	be_prolog_add_reg(abihelper, sp_reg,
+			arch_register_req_type_produces_sp | arch_register_req_type_ignore);
+	/* function parameters in registers */
+	for (size_t i = 0, n = get_method_n_params(function_type); i < n; ++i) {
+		const reg_or_stackslot_t *param = &cconv->parameters[i];
+		if (param->reg != NULL)
+			be_prolog_add_reg(abihelper, param->reg, arch_register_req_type_none);
+	}
+	/* announce that we need the values of the callee save regs */
+	for (size_t i = 0; i < ARRAY_SIZE(amd64_callee_saves); ++i) {
+		be_prolog_add_reg(abihelper, amd64_callee_saves[i],
+		                  arch_register_req_type_none);
+	}
+
+	ir_node *start = be_prolog_create_start(abihelper, dbgi, new_block);
+	be_start_set_setup_stackframe(start, true);
+	return start;
+}
+
+static ir_node *get_stack_pointer_for(ir_node *node)
+{
+	/* get predecessor in stack_order list */
+	ir_node *stack_pred = be_get_stack_pred(stackorder, node);
+	if (stack_pred == NULL) {
+		/* first stack user in the current block. We can simply use the
+		 * initial sp_proj for it */
+		return be_prolog_get_reg_value(abihelper, sp_reg);
+	}
+
+	be_transform_node(stack_pred);
+	ir_node *stack = pmap_get(ir_node, node_to_stack, stack_pred);
+	if (stack == NULL) {
+		return get_stack_pointer_for(stack_pred);
+	}
+
+	return stack;
+}
+
+/**
+ * Checks whether the Call returned by the Return @p node can be emitted as a
+ * jump after the epilog: all arguments must be passed in registers and the
+ * callee must return its results where we return ours.
+ *
+ * @return the calling convention of the callee, or NULL
+ */
+static calling_convention_t *get_sibling_call(ir_node *node, ir_node **call)
+{
+	if (frame_may_escape)
+		return NULL;
+	*call = be_get_sibling_call(node);
+	if (*call == NULL || be_get_stack_pred(stackorder, node) != *call)
+		return NULL;
+
+	ir_type              *type   = get_Call_type(*call);
+	calling_convention_t *callee = amd64_decide_calling_convention(NULL, type);
+	bool                  ok     = callee->param_stack_size == 0;
+	for (size_t i = 0, n = get_method_n_ress(type); ok && i < n; ++i) {
+		ok = callee->results[i].reg == cconv->results[i].reg;
+	}
+	if (!ok) {
+		amd64_free_calling_convention(callee);
+		return NULL;
+	}
+	return callee;
+}
+
+/**
+ * Returns the transformed value of a call argument or result of mode @p mode.
+ * The System V ABI passes values of less than 32 bits extended to 32 bits.
+ */
+static ir_node *transform_abi_value(dbg_info *dbgi, ir_node *block,
+                                    ir_node *value, ir_mode *mode)
+{
+	ir_node *new_value = be_transform_node(value);
+	if (mode_needs_gp_reg(mode) && needs_extension(value))
+		return new_bd_amd64_Conv(dbgi, block, new_value, mode);
+	return new_value;
+}
+
+/**
+ * transform a Return node into epilogue code + return statement
+ */
+static ir_node *gen_Return(ir_node *node)
+{
+	ir_node  *block     = get_nodes_block(node);
+	ir_node  *new_block = be_transform_node(block);
+	dbg_info *dbgi      = get_irn_dbg_info(node);
+	ir_node  *mem       = get_Return_mem(node);
+	size_t    n_res     = get_Return_n_ress(node);
+	ir_node  *sibling   = NULL;
+	ir_node  *sp;
+
+	/* a sibling call passes its arguments instead of our results and jumps
+	 * to the callee, which returns to our caller */
+	calling_convention_t *callee = get_sibling_call(node, &sibling);
+	if (callee != NULL) {
+		mem   = get_Call_mem(sibling);
+		sp    = get_stack_pointer_for(sibling);
+		n_res = 0;
+	} else {
+		sp = get_stack_pointer_for(node);
+	}
+	ir_node *new_mem = be_transform_node(mem);
+
+	be_epilog_begin(abihelper);
+	be_epilog_set_memory(abihelper, new_mem);
+	/* connect stack pointer with initial stack pointer. fix_stack phase
+	   will later serialize all stack pointer adjusting nodes */
+	be_epilog_add_reg(abihelper, sp_reg,
+			arch_register_req_type_produces_sp | arch_register_req_type_ignore,
+			sp);
+
+	/* result values */
+	for (size_t i = 0; i < n_res; ++i) {
+		ir_node *res_value = get_Return_res(node, i);
+		ir_node *new_value = transform_abi_value(dbgi, new_block, res_value,
+		                                         get_irn_mode(res_value));
+		be_epilog_add_reg(abihelper, cconv->results[i].reg,
+		                  arch_register_req_type_none, new_value);
+	}
+
+	/* sibling call arguments */
+	size_t const n_args = callee != NULL ? get_Call_n_params(sibling) : 0;
+	for (size_t i = 0; i < n_args; ++i) {
+		ir_node *value     = get_Call_param(sibling, i);
+		ir_node *new_value = transform_abi_value(dbgi, new_block, value,
+		                                         get_irn_mode(value));
+		be_epilog_add_reg(abihelper, callee->parameters[i].reg,
+		                  arch_register_req_type_none, new_value);
+	}
+
+	/* connect callee saves with their values at the function begin */
+	for (size_t i = 0; i < ARRAY_SIZE(amd64_callee_saves); ++i) {
+		const arch_register_t *reg   = amd64_callee_saves[i];
+		ir_node               *value = be_prolog_get_reg_value(abihelper, reg);
+		be_epilog_add_reg(abihelper, reg, arch_register_req_type_none, value);
+	}
+
+	ir_node *ret = be_epilog_create_return(abihelper, dbgi, new_block);
+	be_return_set_destroy_stackframe(ret, true);
+
+	if (callee != NULL) {
+		ir_entity *entity = get_SymConst_entity(get_Call_ptr(sibling));
+		be_Return_set_tail_call(ret, entity);
+		amd64_free_calling_convention(callee);
+	}
+	return ret;
+}
+
+static ir_node *gen_Call(ir_node *node)
+{
+	ir_node              *callee       = get_Call_ptr(node);
+	ir_node              *block        = get_nodes_block(node);
+	ir_node              *new_block    = be_transform_node(block);
+	ir_node              *mem          = get_Call_mem(node);
+	ir_node              *new_mem      = be_transform_node(mem);
+	dbg_info             *dbgi         = get_irn_dbg_info(node);
+	ir_type              *type         = get_Call_type(node);
+	calling_convention_t *cconv        = amd64_decide_calling_convention(NULL, type);
+	size_t                n_params     = get_Call_n_params(node);
+	size_t const          n_param_regs = cconv->n_param_regs;
+	ir_node             **in           = ALLOCAN(ir_node*, n_param_regs);
+	ir_node             **sync_ins     = ALLOCAN(ir_node*, n_params);
+	size_t                in_arity     = 0;
+	size_t                sync_arity   = 0;
+
+	assert(n_params == get_method_n_params(type));
+
+	/* allocate the stack arguments, this IncSP also aligns the stack pointer
+	 * at the call */
+	ir_node *incsp = be_new_IncSP(sp_reg, new_block, get_stack_pointer_for(node),
+	                              cconv->param_stack_size, 1);
+
+	/* parameters */
+	for (size_t p = 0; p < n_params; ++p) {
+		ir_node                  *value     = get_Call_param(node, p);
+		ir_mode                  *mode      = get_type_mode(get_method_param_type(type, p));
+		ir_node                  *new_value = transform_abi_value(dbgi, new_block, value, mode);
+		const reg_or_stackslot_t *param     = &cconv->parameters[p];
+
+		/* put value into registers */
+		if (param->reg != NULL) {
+			in[in_arity++] = new_value;
+			continue;
+		}
+
+		/* we need a store if we're here */
+		amd64_addr_t addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.immediate.offset = param->offset;
+		addr.base_input       = 2;
+		addr.index_input      = NO_INPUT;
+
+		ir_node *str_in[] = { new_value, new_mem, incsp };
+		ir_node *store;
+		if (mode_is_float(mode)) {
+			store = new_bd_amd64_xStores(dbgi, new_block, ARRAY_SIZE(str_in),
+			                             str_in, get_xmm_insn_mode(mode), addr);
+		} else {
+			store = new_bd_amd64_Store(dbgi, new_block, ARRAY_SIZE(str_in),
+			                           str_in, get_insn_mode_from_mode(mode),
+			                           addr);
+		}
+		sync_ins[sync_arity++] = store;
+	}
+	assert(in_arity == n_param_regs);
+
+	/* construct memory input */
+	ir_node *call_mem;
+	if (sync_arity == 0) {
+		call_mem = new_mem;
+	} else if (sync_arity == 1) {
+		call_mem = sync_ins[0];
+	} else {
+		call_mem = new_rd_Sync(NULL, new_block, sync_arity, sync_ins);
+	}
+
+	/* direct calls take the entity as immediate, the emitter overwrites %rax
+	 * with the number of xmm arguments for variadic callees, so an address
+	 * register must be a different one */
+	ir_entity                 *entity  = NULL;
+	ir_node                   *ptr     = incsp;
+	const arch_register_req_t *ptr_req = sp_reg->single_req;
+	if (is_SymConst_addr_ent(callee)) {
+		entity = get_SymConst_entity(callee);
+	} else {
+		ptr     = be_transform_node(callee);
+		ptr_req = get_method_variadicity(type) == variadicity_variadic
+			? amd64_registers[REG_R11].single_req
+			: amd64_reg_classes[CLASS_amd64_gp].class_req;
+	}
+
+	/* outputs: memory, control flow, stack pointer and the caller saves
+	 * which include the result registers */
+	size_t const n_caller_saves = ARRAY_SIZE(caller_saves);
+	ir_node *res = be_new_Call(dbgi, new_block, call_mem, sp_reg->single_req,
+	                           incsp, ptr_req, ptr,
+	                           pn_be_Call_first_res + n_caller_saves,
+	                           in_arity, in, type);
+	if (entity != NULL)
+		be_Call_set_entity(res, entity);
+	arch_add_irn_flags(res, arch_irn_flags_modify_flags);
+	ir_set_throws_exception(res, ir_throws_exception(node));
+
+	size_t in_pos = n_be_Call_first_arg;
+	for (size_t p = 0; p < n_params; ++p) {
+		const arch_register_t *reg = cconv->parameters[p].reg;
+		if (reg != NULL) {
+			be_set_constr_single_reg_in(res, in_pos++, reg,
+			                            arch_register_req_type_none);
+		}
+	}
+	be_set_constr_single_reg_out(res, pn_be_Call_sp, sp_reg,
+			arch_register_req_type_ignore | arch_register_req_type_produces_sp);
+	for (size_t o = 0; o < n_caller_saves; ++o) {
+		be_set_constr_single_reg_out(res, pn_be_Call_first_res + o,
+		                             caller_saves[o],
+		                             arch_register_req_type_none);
+	}
+
+	/* IncSP to destroy the call stackframe and revert the alignment */
+	ir_node *sp = new_r_Proj(res, mode_gp, pn_be_Call_sp);
+	arch_set_irn_register(sp, sp_reg);
+	incsp = be_new_IncSP(sp_reg, new_block, sp, -(int)cconv->param_stack_size,
+	                     0);
+	/* if we are the last IncSP producer in a block then we have to keep
+	 * the stack value.
+	 * Note: This here keeps all producers which is more than necessary */
+	keep_alive(incsp);
+
+	pmap_insert(node_to_stack, node, incsp);
+
+	amd64_free_calling_convention(cconv);
+	return res;
 }
 
 /* Boilerplate code for transformation: */
@@ -499,10 +1722,7 @@ static void amd64_register_transformers(void)
 
 	be_set_transform_function(op_Add,          gen_Add);
 	be_set_transform_function(op_And,          gen_And);
-	be_set_transform_function(op_be_Call,      gen_be_Call);
-	be_set_transform_function(op_be_FrameAddr, gen_be_FrameAddr);
-	be_set_transform_function(op_be_Return,    gen_be_Return);
-	be_set_transform_function(op_be_Start,     gen_be_Start);
+	be_set_transform_function(op_Call,         gen_Call);
 	be_set_transform_function(op_Cmp,          gen_Cmp);
 	be_set_transform_function(op_Cond,         gen_Cond);
 	be_set_transform_function(op_Const,        gen_Const);
@@ -517,32 +1737,115 @@ static void amd64_register_transformers(void)
 	be_set_transform_function(op_Not,          gen_Not);
 	be_set_transform_function(op_Or,           gen_Or);
 	be_set_transform_function(op_Phi,          gen_Phi);
+	be_set_transform_function(op_Return,       gen_Return);
+	be_set_transform_function(op_Sel,          gen_Sel);
 	be_set_transform_function(op_Shl,          gen_Shl);
 	be_set_transform_function(op_Shr,          gen_Shr);
 	be_set_transform_function(op_Shrs,         gen_Shrs);
+	be_set_transform_function(op_Start,        gen_Start);
 	be_set_transform_function(op_Store,        gen_Store);
 	be_set_transform_function(op_Sub,          gen_Sub);
 	be_set_transform_function(op_Switch,       gen_Switch);
 	be_set_transform_function(op_SymConst,     gen_SymConst);
 
-	be_set_transform_proj_function(op_be_Call,  gen_Proj_be_Call);
-	be_set_transform_proj_function(op_be_Start, be_duplicate_node);
-	be_set_transform_proj_function(op_Cond,     be_duplicate_node);
-	be_set_transform_proj_function(op_Div,      gen_Proj_Div);
-	be_set_transform_proj_function(op_Load,     gen_Proj_Load);
-	be_set_transform_proj_function(op_Mod,      gen_Proj_Mod);
-	be_set_transform_proj_function(op_Store,    gen_Proj_Store);
-	be_set_transform_proj_function(op_Switch,   be_duplicate_node);
+	be_set_transform_proj_function(op_Call,   gen_Proj_Call);
+	be_set_transform_proj_function(op_Cond,   be_duplicate_node);
+	be_set_transform_proj_function(op_Div,    gen_Proj_Div);
+	be_set_transform_proj_function(op_Load,   gen_Proj_Load);
+	be_set_transform_proj_function(op_Mod,    gen_Proj_Mod);
+	be_set_transform_proj_function(op_Proj,   gen_Proj_Proj);
+	be_set_transform_proj_function(op_Start,  gen_Proj_Start);
+	be_set_transform_proj_function(op_Store,  gen_Proj_Store);
+	be_set_transform_proj_function(op_Switch, be_duplicate_node);
+}
+
+/**
+ * Merges the start block with its successor if it is the only predecessor.
+ * The prolog code then shares a block with the function body, so values
+ * placed in the start block like constants need not live across calls.
+ */
+static void merge_start_block(ir_graph *irg)
+{
+	ir_node *initial_X   = get_irg_initial_exec(irg);
+	ir_node *start_block = get_irg_start_block(irg);
+	ir_node *jmp         = new_r_Jmp(start_block);
+
+	assert(is_Proj(initial_X));
+	exchange(initial_X, jmp);
+	set_irg_initial_exec(irg, new_r_Bad(irg, mode_X));
+
+	foreach_out_edge(jmp, edge) {
+		ir_node *succ = get_edge_src_irn(edge);
+		if (!is_Block(succ))
+			continue;
+
+		if (get_irn_arity(succ) == 1) {
+			exchange(succ, start_block);
+			clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+		}
+		break;
+	}
 }
 
 void amd64_transform_graph(ir_graph *irg)
 {
 	assure_irg_properties(irg, IR_GRAPH_PROPERTY_NO_TUPLES
-	                         | IR_GRAPH_PROPERTY_NO_BADS);
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+	merge_start_block(irg);
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_NO_TUPLES
+	                         | IR_GRAPH_PROPERTY_NO_BADS
+	                         | IR_GRAPH_PROPERTY_NO_UNREACHABLE_CODE
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
 
 	amd64_register_transformers();
-	mode_gp = mode_Lu;
+	mode_gp  = mode_Lu;
+	mode_xmm = mode_D;
+
+	node_to_stack = pmap_create();
+
+	assert(abihelper == NULL);
+	abihelper = be_abihelper_prepare(irg);
+	stackorder = be_collect_stacknodes(irg);
+	frame_may_escape = be_frame_may_escape(irg);
+	assert(cconv == NULL);
+	cconv = amd64_decide_calling_convention(irg, get_entity_type(get_irg_entity(irg)));
+	create_stacklayout(irg);
+	be_add_parameter_entity_stores(irg);
+
+	/* the bitset is indexed by node index, so the parameter stores must
+	 * exist already */
+	analyze_upper_bits_zero(irg);
+
+	/* layout the frame while its entities are still accessed by Sels */
+	ir_type *frame_type = get_irg_frame_type(irg);
+	if (get_type_state(frame_type) == layout_undefined)
+		opt_frame_share_slots(irg);
+
 	be_transform_graph(irg, NULL);
+
+	be_abihelper_finish(abihelper);
+	abihelper = NULL;
+	be_free_stackorder(stackorder);
+	stackorder = NULL;
+
+	amd64_free_calling_convention(cconv);
+	cconv = NULL;
+
+	if (get_type_state(frame_type) == layout_undefined) {
+		default_layout_compound_type(frame_type);
+	}
+	pmap_destroy(node_to_stack);
+	node_to_stack = NULL;
+
+	free(upper_bits_zero);
+	upper_bits_zero = NULL;
+}
+
+void amd64_finish_transform(void)
+{
+	between_type = NULL;
 }
 
 void amd64_init_transform(void)
@@ -12,6 +12,8 @@
 
 void amd64_init_transform(void);
 
+void amd64_finish_transform(void);
+
 void amd64_transform_graph(ir_graph *irg);
 
 #endif
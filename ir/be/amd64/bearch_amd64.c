@@ -8,10 +8,15 @@
  * @brief    The main amd64 backend driver file.
  */
 #include "irgwalk.h"
+#include "util.h"
 #include "irprog.h"
 #include "ircons.h"
 #include "irgmod.h"
 #include "irdump.h"
+#include "irdom.h"
+#include "iredges_t.h"
+#include "execfreq.h"
+#include "array.h"
 #include "lower_calls.h"
 #include "debug.h"
 #include "error.h"
@@ -34,10 +39,14 @@
 #include "bearch_amd64_t.h"
 
 #include "amd64_finish.h"
+#include "amd64_optimize.h"
 #include "amd64_new_nodes.h"
 #include "gen_amd64_regalloc_if.h"
 #include "amd64_transform.h"
 #include "amd64_emitter.h"
+#include "amd64_cconv.h"
+
+#include "ia32_architecture.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
@@ -47,13 +56,11 @@ static ir_entity *amd64_get_frame_entity(const ir_node *node)
 		const amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr_const(node);
 		return attr->entity;
 
-	} else if (is_amd64_Store(node)) {
-		const amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr_const(node);
-		return attr->entity;
-
-	} else if (is_amd64_LoadS(node) || is_amd64_LoadZ(node)) {
-		const amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr_const(node);
-		return attr->entity;
+	} else if (is_amd64_Store(node) || is_amd64_LoadS(node)
+	           || is_amd64_LoadZ(node) || is_amd64_Lea(node)
+	           || is_amd64_xMovs(node) || is_amd64_xStores(node)) {
+		const amd64_addr_attr_t *attr = get_amd64_addr_attr_const(node);
+		return attr->frame_entity;
 	}
 
 	(void) node;
@@ -71,14 +78,11 @@ static void amd64_set_frame_offset(ir_node *irn, int offset)
 		amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr(irn);
 		attr->fp_offset += offset;
 
-	} else if (is_amd64_Store(irn)) {
-		amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr(irn);
-		attr->fp_offset += offset;
-
-	} else if (is_amd64_LoadS(irn) || is_amd64_LoadZ(irn)) {
-		amd64_SymConst_attr_t *attr = get_amd64_SymConst_attr(irn);
-		attr->fp_offset += offset;
-
+	} else if (is_amd64_Store(irn) || is_amd64_LoadS(irn)
+	           || is_amd64_LoadZ(irn) || is_amd64_Lea(irn)
+	           || is_amd64_xMovs(irn) || is_amd64_xStores(irn)) {
+		amd64_addr_attr_t *attr = get_amd64_addr_attr(irn);
+		attr->addr.immediate.offset += offset;
 	}
 }
 
@@ -101,11 +105,25 @@ static const arch_irn_ops_t amd64_irn_ops = {
 
 static void amd64_before_ra(ir_graph *irg)
 {
-	be_sched_fix_flags(irg, &amd64_reg_classes[CLASS_amd64_flags], NULL, NULL);
+	be_sched_fix_flags(irg, &amd64_reg_classes[CLASS_amd64_flags], NULL, NULL,
+	                   NULL);
 
 	be_add_missing_keeps(irg);
 }
 
+/**
+ * Returns the address of a frame entity, the offset is set after the stack
+ * layout is fixed.
+ */
+static amd64_addr_t get_frame_addr(uint8_t base_input)
+{
+	amd64_addr_t addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.base_input  = base_input;
+	addr.index_input = NO_INPUT;
+	return addr;
+}
+
 static void transform_Reload(ir_node *node)
 {
 	ir_graph  *irg    = get_irn_irg(node);
@@ -116,10 +134,23 @@ static void transform_Reload(ir_node *node)
 	ir_mode   *mode   = get_irn_mode(node);
 	ir_entity *entity = be_get_frame_entity(node);
 
-	ir_node *load = new_bd_amd64_LoadZ(dbgi, block, ptr, mem, INSN_MODE_64, entity);
+	ir_node *in[] = { mem, ptr };
+	ir_node *load;
+	ir_node *proj;
+	if (mode_is_float(mode)) {
+		amd64_insn_mode_t insn_mode
+			= get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+		load = new_bd_amd64_xMovs(dbgi, block, ARRAY_SIZE(in), in, insn_mode,
+		                          get_frame_addr(1));
+		proj = new_rd_Proj(dbgi, load, mode, pn_amd64_xMovs_res);
+	} else {
+		load = new_bd_amd64_LoadZ(dbgi, block, ARRAY_SIZE(in), in,
+		                          INSN_MODE_64, get_frame_addr(1));
+		proj = new_rd_Proj(dbgi, load, mode, pn_amd64_LoadZ_res);
+	}
+	get_amd64_addr_attr(load)->frame_entity = entity;
 	sched_replace(node, load);
 
-	ir_node *proj = new_rd_Proj(dbgi, load, mode, pn_amd64_LoadZ_res);
 
 	const arch_register_t *reg = arch_get_irn_register(node);
 	arch_set_irn_register(proj, reg);
@@ -137,7 +168,20 @@ static void transform_Spill(ir_node *node)
 	ir_node   *val    = get_irn_n(node, n_be_Spill_val);
 	ir_entity *entity = be_get_frame_entity(node);
 
-	ir_node *store = new_bd_amd64_Store(dbgi, block, ptr, val, mem, INSN_MODE_64, entity);
+	ir_mode   *mode   = get_irn_mode(val);
+
+	ir_node *in[] = { val, mem, ptr };
+	ir_node *store;
+	if (mode_is_float(mode)) {
+		amd64_insn_mode_t insn_mode
+			= get_mode_size_bits(mode) > 32 ? INSN_MODE_64 : INSN_MODE_32;
+		store = new_bd_amd64_xStores(dbgi, block, ARRAY_SIZE(in), in,
+		                             insn_mode, get_frame_addr(2));
+	} else {
+		store = new_bd_amd64_Store(dbgi, block, ARRAY_SIZE(in), in,
+		                           INSN_MODE_64, get_frame_addr(2));
+	}
+	get_amd64_addr_attr(store)->frame_entity = entity;
 	sched_replace(node, store);
 
 	exchange(node, store);
@@ -175,6 +219,201 @@ static void amd64_collect_frame_entity_nodes(ir_node *node, void *data)
 	}
 }
 
+static void find_call_walker(ir_node *node, void *data)
+{
+	bool *found = (bool*)data;
+	if (be_is_Call(node))
+		*found = true;
+}
+
+/**
+ * Returns true if the graph calls other functions.
+ */
+static bool has_calls(ir_graph *irg)
+{
+	bool found = false;
+	irg_walk_graph(irg, NULL, find_call_walker, &found);
+	return found;
+}
+
+/**
+ * Leaf functions may use the 128 bytes below the stack pointer (the red zone
+ * of the System V ABI) without allocating them. If the whole frame fits in
+ * there, the Start and Return nodes do not adjust the stack pointer and the
+ * frame entities get negative offsets.
+ */
+static void use_red_zone(ir_graph *irg)
+{
+	be_stack_layout_t *layout     = be_get_irg_stack_layout(irg);
+	ir_type           *frame_type = get_irg_frame_type(irg);
+
+	if (!layout->sp_relative
+	    || get_type_size_bytes(frame_type) > AMD64_RED_ZONE_SIZE
+	    || has_calls(irg))
+		return;
+
+	be_start_set_setup_stackframe(get_irg_start(irg), false);
+	ir_node *end_block = get_irg_end_block(irg);
+	for (int i = 0, n = get_Block_n_cfgpreds(end_block); i < n; ++i) {
+		ir_node *ret = get_Block_cfgpred(end_block, i);
+		if (be_is_Return(ret))
+			be_return_set_destroy_stackframe(ret, false);
+	}
+}
+
+/**
+ * Returns true if @p node needs the stack frame: it accesses a frame entity
+ * or uses the stack pointer, for example to prepare a call. Stack arguments
+ * are addressed relative to the stack pointer without a frame as well.
+ */
+static bool needs_frame(const ir_node *node, const be_stack_layout_t *layout)
+{
+	if (be_is_Start(node) || be_is_Return(node))
+		return false;
+
+	ir_entity *entity = arch_get_frame_entity(node);
+	if (entity != NULL)
+		return get_entity_owner(entity) != layout->arg_type;
+
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		ir_node *op = get_irn_n(node, i);
+		if (mode_is_data(get_irn_mode(op))
+		    && arch_get_irn_register(op) == &amd64_registers[REG_RSP])
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Returns true if every block reachable from @p block is dominated by it, so
+ * each path from the block to a return passes it exactly once.
+ */
+static bool dominates_reachable(ir_node *block)
+{
+	ir_graph *irg       = get_Block_irg(block);
+	ir_node  *end_block = get_irg_end_block(irg);
+	ir_node **worklist  = NEW_ARR_F(ir_node*, 1);
+	bool      result    = true;
+
+	inc_irg_block_visited(irg);
+	worklist[0] = block;
+	while (result && ARR_LEN(worklist) > 0) {
+		size_t   n_work = ARR_LEN(worklist);
+		ir_node *bl     = worklist[n_work - 1];
+		ARR_SHRINKLEN(worklist, n_work - 1);
+
+		foreach_block_succ(bl, edge) {
+			ir_node *succ = get_edge_src_irn(edge);
+			if (succ == end_block || Block_block_visited(succ))
+				continue;
+			if (succ == block || !block_dominates(block, succ)) {
+				result = false;
+				break;
+			}
+			mark_Block_block_visited(succ);
+			ARR_APP1(ir_node*, worklist, succ);
+		}
+	}
+	DEL_ARR_F(worklist);
+	return result;
+}
+
+typedef struct frame_users_env_t {
+	const be_stack_layout_t *layout;
+	ir_node                 *dominator; /**< dominates all frame users */
+} frame_users_env_t;
+
+static void find_frame_users(ir_node *block, void *data)
+{
+	frame_users_env_t *env = (frame_users_env_t*)data;
+	sched_foreach(block, node) {
+		if (needs_frame(node, env->layout)) {
+			env->dominator = env->dominator == NULL ? block
+				: node_smallest_common_dominator(env->dominator, block);
+			return;
+		}
+	}
+}
+
+/**
+ * Shrink-wraps the stack frame: Paths that do not need the frame, like the
+ * early exits of a function, should not pay for setting it up. The frame is
+ * set up at the beginning of the deepest block dominating all blocks which
+ * need it, if that block executes less often than the start block, and torn
+ * down by the returns it reaches. Spills of callee saved registers do not
+ * need special handling, they are already placed where the registers get
+ * evicted.
+ */
+static void shrink_wrap_frame(ir_graph *irg)
+{
+	ir_node           *start      = get_irg_start(irg);
+	be_stack_layout_t *layout     = be_get_irg_stack_layout(irg);
+	ir_type           *frame_type = get_irg_frame_type(irg);
+	unsigned           frame_size = get_type_size_bytes(frame_type);
+	if (frame_size == 0 || !be_start_get_setup_stackframe(start))
+		return;
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+
+	frame_users_env_t env = { layout, NULL };
+	irg_block_walk_graph(irg, find_frame_users, NULL, &env);
+
+	/* a frame nobody uses is not set up at all */
+	ir_node *start_block = get_irg_start_block(irg);
+	ir_node *save_block  = env.dominator;
+	while (save_block != NULL && save_block != start_block
+	       && !dominates_reachable(save_block)) {
+		save_block = get_Block_idom(save_block);
+	}
+	if (save_block == start_block
+	    || (save_block != NULL && get_block_execfreq(save_block)
+	                              >= get_block_execfreq(start_block)))
+		return;
+
+	be_start_set_setup_stackframe(start, false);
+	ir_node *end_block = get_irg_end_block(irg);
+	for (int i = 0, n = get_Block_n_cfgpreds(end_block); i < n; ++i) {
+		ir_node *ret = get_Block_cfgpred(end_block, i);
+		if (!be_is_Return(ret))
+			continue;
+		bool destroy = save_block != NULL
+		               && block_dominates(save_block, get_nodes_block(ret));
+		be_return_set_destroy_stackframe(ret, destroy);
+	}
+	if (save_block == NULL)
+		return;
+
+	/* be_abi_fix_stack_nodes() connects the users of the stack pointer */
+	const arch_register_t *sp_reg = &amd64_registers[REG_RSP];
+	ir_node *sp    = be_get_initial_reg_value(irg, sp_reg);
+	ir_node *incsp = be_new_IncSP(sp_reg, save_block, sp, frame_size, 0);
+	ir_node *first = sched_first(save_block);
+	while (is_Phi(first))
+		first = sched_next(first);
+	sched_add_before(first, incsp);
+	keep_alive(incsp);
+}
+
+/**
+ * Sizes a frame set up by the prolog so that together with the return address
+ * it keeps the stack pointer aligned, calls then need no further adjustment.
+ */
+static void align_frame(ir_graph *irg)
+{
+	ir_type *frame_type = get_irg_frame_type(irg);
+	unsigned frame_size = get_type_size_bytes(frame_type);
+	if (frame_size == 0 || !be_start_get_setup_stackframe(get_irg_start(irg)))
+		return;
+
+	const arch_env_t  *arch_env     = be_get_irg_arch_env(irg);
+	be_stack_layout_t *layout       = be_get_irg_stack_layout(irg);
+	unsigned           between_size = get_type_size_bytes(layout->between_type);
+	unsigned           alignment    = 1u << arch_env->stack_alignment;
+	set_type_size_bytes(frame_type,
+	                    round_up2(frame_size + between_size, alignment)
+	                    - between_size);
+}
+
 /**
  * Called immediatly before emit phase.
  */
@@ -191,6 +430,10 @@ static void amd64_finish_graph(ir_graph *irg)
 
 	irg_block_walk_graph(irg, NULL, amd64_after_ra_walker, NULL);
 
+	use_red_zone(irg);
+	align_frame(irg);
+	shrink_wrap_frame(irg);
+
 	/* fix stack entity offsets */
 	be_abi_fix_stack_nodes(irg);
 	be_abi_fix_stack_bias(irg);
@@ -198,6 +441,10 @@ static void amd64_finish_graph(ir_graph *irg)
 	/* Fix 2-address code constraints. */
 	amd64_finish_irg(irg);
 
+	/* do peephole optimizations */
+	if (!be_options.fast)
+		amd64_peephole_optimization(irg);
+
 	/* emit code */
 	amd64_emit_function(irg);
 }
@@ -212,20 +459,26 @@ static amd64_isa_t amd64_isa_template = {
 		amd64_reg_classes,
 		&amd64_registers[REG_RSP], /* stack pointer register */
 		&amd64_registers[REG_RBP], /* base pointer register */
-		3,                         /* power of two stack alignment for calls, 2^2 == 4 */
+		4,                         /* power of two stack alignment for calls, 2^4 == 16 */
 		7,                         /* costs for a spill instruction */
 		5,                         /* costs for a reload instruction */
+		NULL,                      /* machine model of the scheduler */
+		false,                     /* no JIT support */
 	},
+	NULL,                          /* constants */
 };
 
 static void amd64_init(void)
 {
+	/* the cpu tuning tables are shared with the ia32 backend */
+	ia32_setup_cg_config();
 	amd64_register_init();
 	amd64_create_opcodes(&amd64_irn_ops);
 }
 
 static void amd64_finish(void)
 {
+	amd64_finish_transform();
 	amd64_free_opcodes();
 }
 
@@ -233,6 +486,7 @@ static arch_env_t *amd64_begin_codegeneration(void)
 {
 	amd64_isa_t *isa = XMALLOC(amd64_isa_t);
 	*isa = amd64_isa_template;
+	isa->constants = pmap_create();
 
 	return &isa->base;
 }
@@ -242,7 +496,9 @@ static arch_env_t *amd64_begin_codegeneration(void)
  */
 static void amd64_end_codegeneration(void *self)
 {
-	free(self);
+	amd64_isa_t *isa = (amd64_isa_t*)self;
+	pmap_destroy(isa->constants);
+	free(isa);
 }
 
 /**
@@ -250,9 +506,6 @@ static void amd64_end_codegeneration(void *self)
  */
 static void amd64_prepare_graph(ir_graph *irg)
 {
-	be_abi_introduce(irg);
-	be_dump(DUMP_BE, irg, "abi");
-
 	be_timer_push(T_CODEGEN);
 	amd64_transform_graph(irg);
 	be_timer_pop(T_CODEGEN);
@@ -260,105 +513,10 @@ static void amd64_prepare_graph(ir_graph *irg)
 	be_dump(DUMP_BE, irg, "code-selection");
 }
 
-/**
- * Get the between type for that call.
- * @param self The callback object.
- * @return The between type of for that call.
- */
-static ir_type *amd64_get_between_type(ir_graph *irg)
-{
-	static ir_type *between_type = NULL;
-	static ir_entity *old_bp_ent = NULL;
-	(void) irg;
-
-	if(!between_type) {
-		ir_entity *ret_addr_ent;
-		ir_type *ret_addr_type = new_type_primitive(mode_P);
-		ir_type *old_bp_type   = new_type_primitive(mode_P);
-
-		between_type           = new_type_class(new_id_from_str("amd64_between_type"));
-		old_bp_ent             = new_entity(between_type, new_id_from_str("old_bp"), old_bp_type);
-		ret_addr_ent           = new_entity(between_type, new_id_from_str("old_bp"), ret_addr_type);
-
-		set_entity_offset(old_bp_ent, 0);
-		set_entity_offset(ret_addr_ent, get_type_size_bytes(old_bp_type));
-		set_type_size_bytes(between_type, get_type_size_bytes(old_bp_type) + get_type_size_bytes(ret_addr_type));
-	}
-
-	return between_type;
-}
-
-static const be_abi_callbacks_t amd64_abi_callbacks = {
-	amd64_get_between_type,
-};
-
-static const arch_register_t *gpreg_param_reg_std[] = {
-	&amd64_registers[REG_RDI],
-	&amd64_registers[REG_RSI],
-	&amd64_registers[REG_RDX],
-	&amd64_registers[REG_RCX],
-	&amd64_registers[REG_R8],
-	&amd64_registers[REG_R9],
-};
-
-static const arch_register_t *amd64_get_RegParam_reg(int n)
-{
-	assert(n < 6 && n >=0 && "register param > 6 requested");
-	return gpreg_param_reg_std[n];
-}
-
-/**
- * Get the ABI restrictions for procedure calls.
- * @param self        The this pointer.
- * @param method_type The type of the method (procedure) in question.
- * @param abi         The abi object to be modified
- */
-static void amd64_get_call_abi(ir_type *method_type, be_abi_call_t *abi)
-{
-	ir_type  *tp;
-	ir_mode  *mode;
-	int       i, n = get_method_n_params(method_type);
-	int no_reg = 0;
-
-	/* set abi flags for calls */
-	be_abi_call_flags_t call_flags = be_abi_call_get_flags(abi);
-	call_flags.call_has_imm = true;
-	be_abi_call_set_flags(abi, call_flags, &amd64_abi_callbacks);
-
-	for (i = 0; i < n; i++) {
-		tp   = get_method_param_type(method_type, i);
-		mode = get_type_mode(tp);
-		//d// printf ("MODE %p %p XX %d\n", mode, mode_Iu, i);
-
-		if (!no_reg && i < 6 && mode_is_data (mode)) {
-			//d// printf("TEST%d\n", i);
-			be_abi_call_param_reg(abi, i, amd64_get_RegParam_reg (i),
-			                      ABI_CONTEXT_BOTH);
-		/* default: all parameters on stack */
-		} else {
-			no_reg = 1;
-			be_abi_call_param_stack(abi, i, mode, 8, 0, 0, ABI_CONTEXT_BOTH);
-		}
-	}
-
-	/* TODO: set correct return register */
-	/* default: return value is in R0 resp. F0 */
-	if (get_method_n_ress(method_type) > 0) {
-		tp   = get_method_res_type(method_type, 0);
-		mode = get_type_mode(tp);
-
-		if (mode_is_float(mode))
-			panic("float not supported yet");
-
-		be_abi_call_res_reg(abi, 0,
-			&amd64_registers[REG_RAX], ABI_CONTEXT_BOTH);
-	}
-}
-
 static void amd64_lower_for_target(void)
 {
 	/* lower compound param handling */
-	lower_calls_with_compounds(LF_RETURN_HIDDEN);
+	lower_calls_with_compounds(LF_RETURN_HIDDEN, amd64_lower_aggregate);
 
 	size_t n_irgs = get_irp_n_irgs();
 	for (size_t i = 0; i < n_irgs; ++i) {
@@ -389,12 +547,22 @@ static int amd64_is_mux_allowed(ir_node *sel, ir_node *mux_false,
  * Returns the libFirm configuration parameter for this backend.
  */
 static const backend_params *amd64_get_backend_params(void) {
+	static const ir_settings_arch_dep_t arch_dep = {
+		1,                    /* also use subs */
+		4,                    /* maximum shifts */
+		63,                   /* maximum shift amount */
+		amd64_evaluate_insn,  /* evaluate the instruction sequence */
+
+		0,  /* no Mulhs */
+		0,  /* no Mulhu */
+		0,  /* no Mulh */
+	};
 	static backend_params p = {
 		0,     /* little endian */
 		1,     /* modulo shift is efficient */
 		0,     /* non-modulo shift is not efficient */
 		0,     /* PIC code not supported */
-		NULL,  /* will be set later */
+		&arch_dep,  /* architecture dependent settings */
 		amd64_is_mux_allowed,  /* parameter for if conversion */
 		64,    /* machine size */
 		NULL,  /* float arithmetic mode */
@@ -404,7 +572,9 @@ static const backend_params *amd64_get_backend_params(void) {
 		0,     /* no trampoline support: size 0 */
 		0,     /* no trampoline support: align 0 */
 		NULL,  /* no trampoline support: no trampoline builder */
-		8      /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		8,     /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		4,     /* issue width */
+		16     /* branch mispredict penalty */
 	};
 	return &p;
 }
@@ -415,33 +585,6 @@ static int amd64_is_valid_clobber(const char *clobber)
 	return 0;
 }
 
-static int amd64_register_saved_by(const arch_register_t *reg, int callee)
-{
-	switch (reg->global_index) {
-	case REG_RBX:
-	case REG_RBP:
-	case REG_R12:
-	case REG_R13:
-	case REG_R14:
-	case REG_R15:
-		return callee;
-
-	case REG_RAX:
-	case REG_RCX:
-	case REG_RDX:
-	case REG_RSI:
-	case REG_RDI:
-	case REG_R8:
-	case REG_R9:
-	case REG_R10:
-	case REG_R11:
-		return !callee;
-
-	default:
-		return 0;
-	}
-}
-
 const arch_isa_if_t amd64_isa_if = {
 	amd64_init,
 	amd64_finish,
@@ -451,11 +594,11 @@ const arch_isa_if_t amd64_isa_if = {
 
 	amd64_begin_codegeneration,
 	amd64_end_codegeneration,
-	amd64_get_call_abi,
+	NULL,              /* get call abi */
 	NULL,              /* mark remat */
 	be_new_spill,
 	be_new_reload,
-	amd64_register_saved_by,
+	NULL,              /* register_saved_by */
 
 	NULL,              /* handle intrinsics */
 	amd64_prepare_graph,
@@ -470,5 +613,6 @@ void be_init_arch_amd64(void)
 	FIRM_DBG_REGISTER(dbg, "firm.be.amd64.cg");
 
 	amd64_init_finish();
+	amd64_init_optimize();
 	amd64_init_transform();
 }
@@ -11,11 +11,16 @@
 #define FIRM_BE_AMD64_BEARCH_AMD64_T_H
 
 #include "bearch.h"
+#include "pmap.h"
+
+/** size of the area below the stack pointer leaf functions may use */
+#define AMD64_RED_ZONE_SIZE 128
 
 typedef struct amd64_isa_t            amd64_isa_t;
 
 struct amd64_isa_t {
 	arch_env_t  base;      /**< must be derived from arch_isa */
+	pmap       *constants; /**< floating point constants in .rodata */
 };
 
 #endif
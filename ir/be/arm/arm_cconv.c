@@ -9,6 +9,7 @@
  * @author  Matthias Braun
  */
 #include "arm_cconv.h"
+#include "bearch_arm_t.h"
 #include "beirg.h"
 #include "irmode.h"
 #include "typerep.h"
@@ -42,6 +43,26 @@ static const arch_register_t* const float_result_regs[] = {
 	&arm_registers[REG_F1]
 };
 
+static const arch_register_t* const vfp_param_regs[] = {
+	&arm_registers[REG_S0],
+	&arm_registers[REG_S1],
+	&arm_registers[REG_S2],
+	&arm_registers[REG_S3],
+	&arm_registers[REG_S4],
+	&arm_registers[REG_S5],
+	&arm_registers[REG_S6],
+	&arm_registers[REG_S7],
+	&arm_registers[REG_S8],
+	&arm_registers[REG_S9],
+	&arm_registers[REG_S10],
+	&arm_registers[REG_S11],
+	&arm_registers[REG_S12],
+	&arm_registers[REG_S13],
+	&arm_registers[REG_S14],
+	&arm_registers[REG_S15]
+};
+static arch_register_req_t vfp_double_reqs[ARRAY_SIZE(vfp_param_regs)];
+
 calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
                                                     ir_type *function_type)
 {
@@ -52,6 +73,9 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 	size_t const          n_param_regs        = ARRAY_SIZE(param_regs);
 	size_t const          n_result_regs       = ARRAY_SIZE(result_regs);
 	size_t const          n_float_result_regs = ARRAY_SIZE(float_result_regs);
+	size_t const          n_vfp_param_regs    = ARRAY_SIZE(vfp_param_regs);
+	unsigned              vfp_used            = 0;
+	unsigned              n_vfp_params        = 0;
 	size_t                n_params;
 	size_t                n_results;
 	size_t                i;
@@ -59,6 +83,11 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 	size_t                float_regnum;
 	calling_convention_t *cconv;
 
+	/* the VFP variant of the procedure call standard does not apply to
+	 * variadic functions */
+	bool const hard_float = USE_VFP() && arm_cg_config.hard_float
+		&& get_method_variadicity(function_type) == variadicity_non_variadic;
+
 	/* determine how parameters are passed */
 	n_params = get_method_n_params(function_type);
 	regnum   = 0;
@@ -71,9 +100,34 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 		reg_or_stackslot_t *param      = &params[i];
 		param->type = param_type;
 
+		if (hard_float && mode_is_float(mode)) {
+			/* singles may fill holes left by aligned doubles */
+			unsigned const n_regs = bits > 32 ? 2 : 1;
+			unsigned const mask   = (1u << n_regs) - 1;
+			unsigned       r      = 0;
+			while (r < n_vfp_param_regs && (vfp_used & (mask << r)) != 0)
+				r += n_regs;
+
+			if (r < n_vfp_param_regs) {
+				const arch_register_t *reg = vfp_param_regs[r];
+				vfp_used   |= mask << r;
+				param->reg0 = reg;
+				param->req0 = n_regs == 2 ? &vfp_double_reqs[r] : reg->single_req;
+				++n_vfp_params;
+			} else {
+				/* once a float went to the stack no more registers are
+				 * back-filled */
+				vfp_used      = ~0u;
+				param->offset = stack_offset;
+				stack_offset += bits / 8;
+			}
+			continue;
+		}
+
 		if (regnum < n_param_regs) {
 			const arch_register_t *reg = param_regs[regnum++];
 			param->reg0 = reg;
+			param->req0 = reg->single_req;
 		} else {
 			param->offset = stack_offset;
 			/* increase offset 4 bytes so everything is aligned */
@@ -99,7 +153,7 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 			}
 		}
 	}
-	n_param_regs_used = regnum;
+	n_param_regs_used = regnum + n_vfp_params;
 
 	n_results    = get_method_n_ress(function_type);
 	regnum       = 0;
@@ -110,15 +164,25 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 		ir_mode            *result_mode = get_type_mode(result_type);
 		reg_or_stackslot_t *result      = &results[i];
 
-		if (mode_is_float(result_mode)) {
+		if (mode_is_float(result_mode) && hard_float) {
+			const arch_register_t *reg = vfp_param_regs[0];
+			if (float_regnum++ > 0)
+				panic("Too many float results");
+			result->reg0 = reg;
+			result->req0 = get_mode_size_bits(result_mode) > 32
+				? &vfp_double_reqs[0] : reg->single_req;
+		} else if (mode_is_float(result_mode) && !USE_VFP()) {
 			if (float_regnum >= n_float_result_regs) {
 				panic("Too many float results");
 			} else {
 				const arch_register_t *reg = float_result_regs[float_regnum++];
 				result->reg0 = reg;
+				result->req0 = reg->single_req;
 			}
 		} else {
-			if (get_mode_size_bits(result_mode) > 32) {
+			/* floats without hard-float ABI are returned like integers */
+			unsigned bits = get_mode_size_bits(result_mode);
+			if (bits > 32 && !mode_is_float(result_mode)) {
 				panic("Results with more than 32bits not supported yet");
 			}
 
@@ -127,6 +191,12 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 			} else {
 				const arch_register_t *reg = result_regs[regnum++];
 				result->reg0 = reg;
+				result->req0 = reg->single_req;
+			}
+			if (bits > 32) {
+				if (regnum >= n_result_regs)
+					panic("Too many results");
+				result->reg1 = result_regs[regnum++];
 			}
 		}
 	}
@@ -155,9 +225,60 @@ calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
 	return cconv;
 }
 
+/**
+ * Tests whether a type contains floating point values, which the VFP variant
+ * of the procedure call standard passes in different registers.
+ */
+static bool contains_float(const ir_type *type)
+{
+	if (is_compound_type(type)) {
+		for (size_t i = 0, n = get_compound_n_members(type); i < n; ++i) {
+			ir_entity *member = get_compound_member(type, i);
+			if (contains_float(get_entity_type(member)))
+				return true;
+		}
+		return false;
+	} else if (is_Array_type(type)) {
+		return contains_float(get_array_element_type(type));
+	}
+	ir_mode *mode = get_type_mode(type);
+	return mode == NULL || mode_is_float(mode);
+}
+
+aggregate_spec_t arm_lower_aggregate(ir_type *type, bool is_result)
+{
+	aggregate_spec_t spec;
+	unsigned         size = get_type_size_bytes(type);
+
+	spec.length = 0;
+	/* doubleword aligned compounds start at an even register, which the
+	 * word-wise split below does not model */
+	if (size == 0 || get_type_alignment_bytes(type) > 4 || contains_float(type))
+		return spec;
+
+	/* composites of up to one word are returned in r0, parameters are split
+	 * into words passed like integers */
+	unsigned max_size = is_result ? 4 : 4 * MAX_REGISTER_AGGREGATE_VALUES;
+	if (size > max_size)
+		return spec;
+	for (unsigned offset = 0; offset < size; offset += 4)
+		spec.modes[spec.length++] = mode_Iu;
+	return spec;
+}
+
 void arm_free_calling_convention(calling_convention_t *cconv)
 {
 	free(cconv->parameters);
 	free(cconv->results);
 	free(cconv);
 }
+
+void arm_cconv_init(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(vfp_double_reqs); i += 2) {
+		arch_register_req_t *req = &vfp_double_reqs[i];
+		*req = *vfp_param_regs[i]->single_req;
+		req->type |= arch_register_req_type_aligned;
+		req->width = 2;
+	}
+}
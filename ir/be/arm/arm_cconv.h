@@ -13,11 +13,14 @@
 
 #include "firm_types.h"
 #include "be_types.h"
+#include "lower_calls.h"
 #include "gen_arm_regalloc_if.h"
 
 /** information about a single parameter or result */
 typedef struct reg_or_stackslot_t
 {
+	const arch_register_req_t *req0; /**< if != NULL, register requirements
+	                                      for the value in reg0. */
 	const arch_register_t *reg0;   /**< if != NULL, the first register used for this parameter. */
 	const arch_register_t *reg1;   /**< if != NULL, the second register used. */
 	ir_type               *type;   /**< indicates that an entity of the specific
@@ -43,9 +46,19 @@ typedef struct calling_convention_t
 calling_convention_t *arm_decide_calling_convention(const ir_graph *irg,
                                                     ir_type *function_type);
 
+/**
+ * Classifies compound parameters and results for lower_calls_with_compounds().
+ */
+aggregate_spec_t arm_lower_aggregate(ir_type *type, bool is_result);
+
 /**
  * free memory used by a calling_convention_t
  */
 void arm_free_calling_convention(calling_convention_t *cconv);
 
+/**
+ * Initialize the requirements for values in VFP register pairs.
+ */
+void arm_cconv_init(void);
+
 #endif
@@ -9,10 +9,14 @@
  * @author  Oliver Richter, Tobias Gneist, Michael Beck
  */
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "bearch_arm_t.h"
 #include "xmalloc.h"
+#include "util.h"
 #include "tv.h"
 #include "iredges.h"
 #include "debug.h"
@@ -42,31 +46,51 @@
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
 static set       *sym_or_tv;
-static arm_isa_t *isa;
+static size_t     first_line;    /**< the first line of the current function */
+static unsigned   pool_size;     /**< size of the pending pool entries */
+static unsigned   pool_deadline; /**< the pending pool entries have to be
+                                      emitted before this code offset */
 
 static void arm_emit_register(const arch_register_t *reg)
 {
 	be_emit_string(reg->name);
 }
 
-static void arm_emit_source_register(const ir_node *node, int pos)
+/**
+ * Emits @p reg, a VFP register pair is named by its double register.
+ */
+static void arm_emit_register_req(const arch_register_t *reg,
+                                  const arch_register_req_t *req)
+{
+	if (req->width > 1) {
+		be_emit_irprintf("d%u", reg->index / 2);
+	} else {
+		arm_emit_register(reg);
+	}
+}
+
+void arm_emit_source_register(const ir_node *node, int pos)
 {
 	const arch_register_t *reg = arch_get_irn_register_in(node, pos);
-	arm_emit_register(reg);
+	arm_emit_register_req(reg, arch_get_irn_register_req_in(node, pos));
 }
 
-static void arm_emit_dest_register(const ir_node *node, int pos)
+void arm_emit_dest_register(const ir_node *node, int pos)
 {
 	const arch_register_t *reg = arch_get_irn_register_out(node, pos);
-	arm_emit_register(reg);
+	arm_emit_register_req(reg, arch_get_irn_register_req_out(node, pos));
 }
 
-static void arm_emit_offset(const ir_node *node)
+void arm_emit_offset(const ir_node *node)
 {
 	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
 	assert(attr->base.is_load_store);
 
-	be_emit_irprintf("0x%X", attr->offset);
+	if (attr->offset < 0) {
+		be_emit_irprintf("-0x%X", -attr->offset);
+	} else {
+		be_emit_irprintf("0x%X", attr->offset);
+	}
 }
 
 /**
@@ -84,19 +108,64 @@ static void arm_emit_fpa_postfix(const ir_mode *mode)
 	be_emit_char(c);
 }
 
-static void arm_emit_float_load_store_mode(const ir_node *node)
+void arm_emit_float_load_store_mode(const ir_node *node)
 {
 	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
 	arm_emit_fpa_postfix(attr->load_store_mode);
 }
 
-static void arm_emit_float_arithmetic_mode(const ir_node *node)
+void arm_emit_float_arithmetic_mode(const ir_node *node)
 {
 	const arm_farith_attr_t *attr = get_arm_farith_attr_const(node);
 	arm_emit_fpa_postfix(attr->mode);
 }
 
-static void arm_emit_symconst(const ir_node *node)
+/**
+ * Emit the vfp instruction suffix depending on the mode.
+ */
+void arm_emit_vfp_arithmetic_mode(const ir_node *node)
+{
+	const arm_farith_attr_t *attr = get_arm_farith_attr_const(node);
+	be_emit_irprintf(".f%u", get_mode_size_bits(attr->mode));
+}
+
+/**
+ * Returns the condition code testing @p relation on the flags produced by
+ * the integer compare @p flags.
+ */
+static const char *get_int_condition(const ir_node *flags,
+                                     ir_relation relation)
+{
+	const arm_cmp_attr_t *cmp_attr  = get_arm_cmp_attr_const(flags);
+	bool                  is_signed = !cmp_attr->is_unsigned;
+
+	assert(is_arm_Cmp(flags) || is_arm_Tst(flags));
+	if (cmp_attr->ins_permuted)
+		relation = get_inversed_relation(relation);
+
+	switch (relation & (ir_relation_less_equal_greater)) {
+		case ir_relation_equal:         return "eq";
+		case ir_relation_less:          return is_signed ? "lt" : "lo";
+		case ir_relation_less_equal:    return is_signed ? "le" : "ls";
+		case ir_relation_greater:       return is_signed ? "gt" : "hi";
+		case ir_relation_greater_equal: return is_signed ? "ge" : "hs";
+		case ir_relation_less_greater:  return "ne";
+		case ir_relation_less_equal_greater: return "al";
+		default: panic("Cmp has unsupported relation");
+	}
+}
+
+/**
+ * Emit the condition suffix of a conditionally executed instruction.
+ */
+void arm_emit_cond_suffix(const ir_node *node)
+{
+	const arm_cond_attr_t *attr  = get_arm_cond_attr_const(node);
+	const ir_node         *flags = get_irn_n(node, 0);
+	be_emit_string(get_int_condition(flags, attr->relation));
+}
+
+void arm_emit_symconst(const ir_node *node)
 {
 	const arm_SymConst_attr_t *symconst = get_arm_SymConst_attr_const(node);
 	ir_entity                 *entity   = symconst->entity;
@@ -106,7 +175,7 @@ static void arm_emit_symconst(const ir_node *node)
 	/* TODO do something with offset */
 }
 
-static void arm_emit_load_mode(const ir_node *node)
+void arm_emit_load_mode(const ir_node *node)
 {
 	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
 	ir_mode *mode      = attr->load_store_mode;
@@ -121,7 +190,7 @@ static void arm_emit_load_mode(const ir_node *node)
 	}
 }
 
-static void arm_emit_store_mode(const ir_node *node)
+void arm_emit_store_mode(const ir_node *node)
 {
 	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
 	ir_mode *mode      = attr->load_store_mode;
@@ -160,7 +229,7 @@ static void emit_shf_mod_name(arm_shift_modifier_t mod)
 	panic("can't emit this shf_mod_name %d", (int) mod);
 }
 
-static void arm_emit_shifter_operand(const ir_node *node)
+void arm_emit_shifter_operand(const ir_node *node)
 {
 	const arm_shifter_operand_t *attr = get_arm_shifter_operand_attr_const(node);
 
@@ -216,6 +285,8 @@ typedef struct sym_or_tv_t {
 	} u;
 	unsigned label;      /**< the associated label. */
 	bool     is_entity;  /**< true if an entity is stored. */
+	bool     pending;    /**< true if it waits for the next literal pool. */
+	unsigned offset;     /**< the code offset once emitted. */
 } sym_or_tv_t;
 
 /**
@@ -232,6 +303,122 @@ static void emit_constant_name(const sym_or_tv_t *entry)
 	be_emit_irprintf("%sC%u", be_gas_get_private_prefix(), entry->label);
 }
 
+/** Reach of ldr into the literal pool, a 12 bit byte offset. */
+#define POOL_RANGE_LDR 4095
+/** Reach of ldf and vldr into the literal pool, an 8 bit word offset. */
+#define POOL_RANGE_FP  1020
+/** A pool this close to its deadline is emitted at the next block boundary
+ * without fallthrough. */
+#define POOL_SLACK     256
+/** Upper bound for the code size of a node without a special estimate. */
+#define MAX_NODE_SIZE  64
+
+/**
+ * Returns an upper bound for the size of the code emitted for the current
+ * function so far: every line holds at most one instruction or word.
+ */
+static unsigned get_code_size(void)
+{
+	return 4 * (unsigned)(be_emit_get_n_lines() - first_line);
+}
+
+static unsigned get_pool_entry_size(const sym_or_tv_t *entry)
+{
+	if (entry->is_entity)
+		return 4;
+	return round_up2(get_mode_size_bytes(get_tarval_mode(entry->u.tv)), 4);
+}
+
+/**
+ * Returns the literal pool entry for an entity or tarval, which has to be
+ * within @p range bytes of the instruction emitted next. Entries of earlier
+ * pools are shared while they are in reach.
+ */
+static sym_or_tv_t *get_pool_entry(const void *generic, bool is_entity,
+                                   unsigned range)
+{
+	sym_or_tv_t key;
+	key.u.generic = generic;
+	key.is_entity = is_entity;
+	key.label     = 0;
+	key.pending   = false;
+	key.offset    = 0;
+	sym_or_tv_t *entry = set_insert(sym_or_tv_t, sym_or_tv, &key, sizeof(key),
+	                                hash_ptr(generic));
+
+	/* pc reads 8 bytes ahead of the current instruction */
+	if (entry->label == 0
+	    || (!entry->pending && get_code_size() + 8 - entry->offset > range)) {
+		entry->label   = get_unique_label();
+		entry->pending = true;
+		pool_size     += get_pool_entry_size(entry);
+	}
+	if (entry->pending)
+		pool_deadline = MIN(pool_deadline, get_code_size() + range);
+	return entry;
+}
+
+/**
+ * Emits the pending literal pool entries, a branch skips them if
+ * @p branch_over is set.
+ */
+static void emit_literal_pool(bool branch_over)
+{
+	const char *prefix = be_gas_get_private_prefix();
+	unsigned    label  = 0;
+	if (branch_over) {
+		label = get_unique_label();
+		be_emit_irprintf("\tb %sP%u\n", prefix, label);
+		be_emit_write_line();
+	}
+
+	be_emit_cstring("\t.align 2\n");
+	be_emit_write_line();
+	foreach_set(sym_or_tv, sym_or_tv_t, entry) {
+		if (!entry->pending)
+			continue;
+		entry->pending = false;
+		entry->offset  = get_code_size();
+
+		emit_constant_name(entry);
+		be_emit_cstring(":\n");
+		be_emit_write_line();
+
+		if (entry->is_entity) {
+			be_emit_cstring("\t.word\t");
+			be_gas_emit_entity(entry->u.entity);
+			be_emit_char('\n');
+			be_emit_write_line();
+		} else {
+			ir_tarval *tv = entry->u.tv;
+			int vi;
+			int size = get_mode_size_bytes(get_tarval_mode(tv));
+
+			/* beware: ARM fpa uses big endian format, vfp the natural
+			 * little endian one */
+			int first = be_is_big_endian() ? ((size + 3) & ~3) - 4 : 0;
+			int step  = be_is_big_endian() ? -4 : 4;
+			for (vi = first; vi >= 0 && vi < size; vi += step) {
+				/* get 32 bits */
+				unsigned v;
+				v =            get_tarval_sub_bits(tv, vi+3);
+				v = (v << 8) | get_tarval_sub_bits(tv, vi+2);
+				v = (v << 8) | get_tarval_sub_bits(tv, vi+1);
+				v = (v << 8) | get_tarval_sub_bits(tv, vi+0);
+				be_emit_irprintf("\t.word\t%u\n", v);
+				be_emit_write_line();
+			}
+		}
+	}
+
+	if (branch_over) {
+		be_emit_irprintf("%sP%u:\n", prefix, label);
+		be_emit_write_line();
+	}
+	pool_size     = 0;
+	pool_deadline = UINT_MAX;
+}
+
 /**
  * Returns the target block for a control flow node.
  */
@@ -307,6 +494,10 @@ void arm_emitf(const ir_node *node, const char *format, ...)
 			arm_emit_shifter_operand(node);
 			break;
 
+		case 'P':
+			arm_emit_cond_suffix(node);
+			break;
+
 		case 'C': {
 			const sym_or_tv_t *name = va_arg(ap, const sym_or_tv_t*);
 			emit_constant_name(name);
@@ -325,6 +516,7 @@ void arm_emitf(const ir_node *node, const char *format, ...)
 			case 'S': arm_emit_store_mode(node);            break;
 			case 'A': arm_emit_float_arithmetic_mode(node); break;
 			case 'F': arm_emit_float_load_store_mode(node); break;
+			case 'V': arm_emit_vfp_arithmetic_mode(node);   break;
 			default:
 				--format;
 				goto unknown;
@@ -380,20 +572,43 @@ unknown:
  * Emit a SymConst.
  */
 static void emit_arm_SymConst(const ir_node *irn)
+{
+	const arm_SymConst_attr_t *attr  = get_arm_SymConst_attr_const(irn);
+	sym_or_tv_t               *entry
+		= get_pool_entry(attr->entity, true, POOL_RANGE_LDR);
+
+	/* load the symbol indirect */
+	arm_emitf(irn, "ldr %D0, %C", entry);
+}
+
+static void emit_arm_Movw(const ir_node *irn)
 {
 	const arm_SymConst_attr_t *attr = get_arm_SymConst_attr_const(irn);
-	sym_or_tv_t key, *entry;
+	if (attr->entity != NULL) {
+		arm_emitf(irn, "movw %D0, #:lower16:%I");
+	} else {
+		arm_emitf(irn, "movw %D0, #0x%X", attr->fp_offset & 0xFFFF);
+	}
+}
 
-	key.u.entity  = attr->entity;
-	key.is_entity = true;
-	key.label     = 0;
-	entry = set_insert(sym_or_tv_t, sym_or_tv, &key, sizeof(key), hash_ptr(key.u.generic));
-	if (entry->label == 0) {
-		/* allocate a label */
-		entry->label = get_unique_label();
+static void emit_arm_Movt(const ir_node *irn)
+{
+	const arm_SymConst_attr_t *attr = get_arm_SymConst_attr_const(irn);
+	if (attr->entity != NULL) {
+		arm_emitf(irn, "movt %D0, #:upper16:%I");
+	} else {
+		arm_emitf(irn, "movt %D0, #0x%X",
+		          (int)((unsigned)attr->fp_offset >> 16));
 	}
+}
 
-	/* load the symbol indirect */
+/**
+ * Emit an integer constant loaded from the literal pool.
+ */
+static void emit_arm_LdrLit(const ir_node *irn)
+{
+	sym_or_tv_t *entry
+		= get_pool_entry(get_fConst_value(irn), false, POOL_RANGE_LDR);
 	arm_emitf(irn, "ldr %D0, %C", entry);
 }
 
@@ -408,20 +623,62 @@ static void emit_arm_FrameAddr(const ir_node *irn)
  */
 static void emit_arm_fConst(const ir_node *irn)
 {
-	sym_or_tv_t key;
+	/* load the tarval indirect */
+	sym_or_tv_t *entry
+		= get_pool_entry(get_fConst_value(irn), false, POOL_RANGE_FP);
+	ir_mode     *mode  = get_irn_mode(irn);
+	arm_emitf(irn, "ldf%m %D0, %C", mode, entry);
+}
 
-	key.u.tv      = get_fConst_value(irn);
-	key.is_entity = false;
-	key.label     = 0;
-	sym_or_tv_t *entry = set_insert(sym_or_tv_t, sym_or_tv, &key, sizeof(key), hash_ptr(key.u.generic));
-	if (entry->label == 0) {
-		/* allocate a label */
-		entry->label = get_unique_label();
+/**
+ * Checks whether @p val can be encoded as VFPv3 immediate, which has the
+ * form +/-n * 2^-r with 16 <= n <= 31 and 0 <= r <= 7.
+ */
+static bool is_vfp_immediate(double val)
+{
+	double abs_val = fabs(val);
+	for (int r = 0; r <= 7; ++r) {
+		for (int n = 16; n <= 31; ++n) {
+			if (ldexp(n, -r) == abs_val)
+				return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Emit a floating point vfp constant.
+ */
+static void emit_arm_Vconst(const ir_node *irn)
+{
+	ir_tarval *tv   = get_fConst_value(irn);
+	unsigned   bits = get_mode_size_bits(get_tarval_mode(tv));
+
+	if (USE_VFP_V3() && is_vfp_immediate(get_tarval_double(tv))) {
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%.8g", get_tarval_double(tv));
+		if (strchr(buf, '.') == NULL)
+			strcat(buf, ".0");
+		arm_emitf(irn, "vmov.f%u %D0, #%s", bits, buf);
+		return;
 	}
 
 	/* load the tarval indirect */
-	ir_mode *mode = get_irn_mode(irn);
-	arm_emitf(irn, "ldf%m %D0, %C", mode, entry);
+	sym_or_tv_t *entry = get_pool_entry(tv, false, POOL_RANGE_FP);
+	arm_emitf(irn, "vldr %D0, %C", entry);
+}
+
+/**
+ * Emit a vfp conversion between single and double precision.
+ */
+static void emit_arm_Vcvt(const ir_node *irn)
+{
+	const arm_farith_attr_t *attr = get_arm_farith_attr_const(irn);
+	if (get_mode_size_bits(attr->mode) == 64) {
+		arm_emitf(irn, "vcvt.f64.f32 %D0, %S0");
+	} else {
+		arm_emitf(irn, "vcvt.f32.f64 %D0, %S0");
+	}
 }
 
 /**
@@ -443,11 +700,9 @@ static void emit_arm_B(const ir_node *irn)
 	const ir_node *next_block;
 	ir_node *op1 = get_irn_n(irn, 0);
 	const char *suffix;
+	const char *suffix2 = NULL;
 	ir_relation relation = get_arm_CondJmp_relation(irn);
-	const arm_cmp_attr_t *cmp_attr = get_arm_cmp_attr_const(op1);
-	bool is_signed = !cmp_attr->is_unsigned;
-
-	assert(is_arm_Cmp(op1) || is_arm_Tst(op1));
+	bool is_float = is_arm_Vcmp(op1);
 
 	foreach_out_edge(irn, edge) {
 		ir_node *proj = get_edge_src_irn(edge);
@@ -459,10 +714,6 @@ static void emit_arm_B(const ir_node *irn)
 		}
 	}
 
-	if (cmp_attr->ins_permuted) {
-		relation = get_inversed_relation(relation);
-	}
-
 	/* for now, the code works for scheduled and non-schedules blocks */
 	block = get_nodes_block(irn);
 
@@ -481,19 +732,39 @@ static void emit_arm_B(const ir_node *irn)
 		relation   = get_negated_relation(relation);
 	}
 
-	switch (relation & (ir_relation_less_equal_greater)) {
-		case ir_relation_equal:         suffix = "eq"; break;
-		case ir_relation_less:          suffix = is_signed ? "lt" : "lo"; break;
-		case ir_relation_less_equal:    suffix = is_signed ? "le" : "ls"; break;
-		case ir_relation_greater:       suffix = is_signed ? "gt" : "hi"; break;
-		case ir_relation_greater_equal: suffix = is_signed ? "ge" : "hs"; break;
-		case ir_relation_less_greater:  suffix = "ne"; break;
-		case ir_relation_less_equal_greater: suffix = "al"; break;
+	if (is_float) {
+		/* vmrs sets C and V for unordered operands */
+		switch (relation) {
+		case ir_relation_equal:                   suffix = "eq"; break;
+		case ir_relation_less:                    suffix = "mi"; break;
+		case ir_relation_less_equal:              suffix = "ls"; break;
+		case ir_relation_greater:                 suffix = "gt"; break;
+		case ir_relation_greater_equal:           suffix = "ge"; break;
+		case ir_relation_unordered:               suffix = "vs"; break;
+		case ir_relation_unordered_less:          suffix = "lt"; break;
+		case ir_relation_unordered_less_equal:    suffix = "le"; break;
+		case ir_relation_unordered_greater:       suffix = "hi"; break;
+		case ir_relation_unordered_greater_equal: suffix = "pl"; break;
+		case ir_relation_unordered_less_greater:  suffix = "ne"; break;
+		case ir_relation_less_equal_greater:      suffix = "vc"; break;
+		case ir_relation_less_greater:
+			suffix  = "mi";
+			suffix2 = "gt";
+			break;
+		case ir_relation_unordered_equal:
+			suffix  = "eq";
+			suffix2 = "vs";
+			break;
 		default: panic("Cmp has unsupported relation");
+		}
+	} else {
+		suffix = get_int_condition(op1, relation);
 	}
 
 	/* emit the true proj */
 	arm_emitf(irn, "b%s %t", suffix, proj_true);
+	if (suffix2 != NULL)
+		arm_emitf(irn, "b%s %t", suffix2, proj_true);
 
 	if (get_cfop_target_block(proj_false) == next_block) {
 		if (be_options.verbose_asm) {
@@ -513,6 +784,62 @@ static int reg_cmp(const void *a, const void *b)
 	return *ra < *rb ? -1 : (*ra != *rb);
 }
 
+/**
+ * Emits a load/store multiple of @p n words, the addressing mode follows
+ * from the offset of the lowest word relative to the base register.
+ */
+static void emit_load_store_m(const ir_node *node, const char *op,
+                              const arch_register_t *const *regs, unsigned n)
+{
+	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
+	long const  size = 4 * (long)n;
+	const char *mode;
+	if (attr->offset == 0) {
+		mode = "ia";
+	} else if (attr->offset == 4) {
+		mode = "ib";
+	} else if (attr->offset == -size) {
+		mode = "db";
+	} else if (attr->offset == 4 - size) {
+		mode = "da";
+	} else {
+		panic("invalid offset %ld in %+F", attr->offset, node);
+	}
+
+	be_emit_irprintf("\t%s%s ", op, mode);
+	arm_emit_source_register(node, 0);
+	be_emit_cstring(", {");
+	for (unsigned i = 0; i < n; ++i) {
+		if (i > 0)
+			be_emit_cstring(", ");
+		arm_emit_register(regs[i]);
+	}
+	be_emit_char('}');
+	be_emit_finish_line_gas(node);
+}
+
+static void emit_arm_LoadM(const ir_node *node)
+{
+	const arch_register_t *regs[16];
+	unsigned               n = arch_get_irn_n_outs(node) - 1;
+	assert(n <= ARRAY_SIZE(regs));
+	for (unsigned i = 0; i < n; ++i) {
+		regs[i] = arch_get_irn_register_out(node, i);
+	}
+	emit_load_store_m(node, "ldm", regs, n);
+}
+
+static void emit_arm_StoreM(const ir_node *node)
+{
+	const arch_register_t *regs[16];
+	unsigned               n = get_irn_arity(node) - 2;
+	assert(n <= ARRAY_SIZE(regs));
+	for (unsigned i = 0; i < n; ++i) {
+		regs[i] = arch_get_irn_register_in(node, i + 1);
+	}
+	emit_load_store_m(node, "stm", regs, n);
+}
+
 /**
  * Create the CopyB instruction sequence.
  */
@@ -568,6 +895,24 @@ static void emit_arm_CopyB(const ir_node *irn)
 	}
 }
 
+/**
+ * Returns the number of words of the jump table emitted for @p table.
+ */
+static unsigned get_jump_table_length(const ir_switch_table *table)
+{
+	unsigned long length = 0;
+	for (size_t e = 0, n = ir_switch_table_get_n_entries(table); e < n; ++e) {
+		const ir_switch_table_entry *entry
+			= ir_switch_table_get_entry_const(table, e);
+		if (entry->pn == 0 || !tarval_is_long(entry->max))
+			continue;
+		unsigned long val = (unsigned long)get_tarval_long(entry->max);
+		if (val > length)
+			length = val;
+	}
+	return length + 1;
+}
+
 static void emit_arm_SwitchJmp(const ir_node *irn)
 {
 	const arm_SwitchJmp_attr_t *attr = get_arm_SwitchJmp_attr_const(irn);
@@ -602,8 +947,15 @@ static void emit_be_Copy(const ir_node *irn)
 	}
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			arm_emitf(irn, "mvf %D0, %S0");
+		} else if (USE_VFP()) {
+			if (get_mode_size_bits(mode) == 64) {
+				const arch_register_t *in = arch_get_irn_register_in(irn, 0);
+				arm_emitf(irn, "vmov.f64 %D0, d%u", in->index / 2);
+			} else {
+				arm_emitf(irn, "vmov.f32 %D0, %S0");
+			}
 		} else {
 			panic("move not supported for this mode");
 		}
@@ -616,6 +968,23 @@ static void emit_be_Copy(const ir_node *irn)
 
 static void emit_be_Perm(const ir_node *irn)
 {
+	const arch_register_t *reg0 = arch_get_irn_register_out(irn, 0);
+	if (reg0->reg_class == &arm_reg_classes[CLASS_arm_vfp]) {
+		/* swap each single precision register through the scratch
+		 * register r12 */
+		const arch_register_t *reg1  = arch_get_irn_register_out(irn, 1);
+		unsigned               width = arch_get_irn_register_req_out(irn, 0)->width;
+		for (unsigned i = 0; i < width; ++i) {
+			const arch_register_t *r0 = &arm_registers[reg0->global_index + i];
+			const arch_register_t *r1 = &arm_registers[reg1->global_index + i];
+			arm_emitf(irn,
+				"vmov r12, %r\n"
+				"vmov.f32 %r, %r\n"
+				"vmov %r, r12", r0, r0, r1, r1);
+		}
+		return;
+	}
+
 	arm_emitf(irn,
 		"eor %D0, %D0, %D1\n"
 		"eor %D1, %D0, %D1\n"
@@ -664,7 +1033,7 @@ static void emit_be_Start(const ir_node *node)
 	unsigned  size       = get_type_size_bytes(frame_type);
 
 	/* allocate stackframe */
-	if (size > 0) {
+	if (size > 0 && be_start_get_setup_stackframe(node)) {
 		arm_emitf(node, "sub sp, sp, #0x%X", size);
 	}
 }
@@ -676,10 +1045,18 @@ static void emit_be_Return(const ir_node *node)
 	unsigned  size       = get_type_size_bytes(frame_type);
 
 	/* deallocate stackframe */
-	if (size > 0) {
+	if (size > 0 && be_return_get_destroy_stackframe(node)) {
 		arm_emitf(node, "add sp, sp, #0x%X", size);
 	}
-	arm_emitf(node, "mov pc, lr");
+
+	ir_entity *const callee = be_Return_get_tail_call(node);
+	if (callee != NULL) {
+		be_emit_cstring("\tb ");
+		be_gas_emit_entity(callee);
+		be_emit_finish_line_gas(node);
+	} else {
+		arm_emitf(node, "mov pc, lr");
+	}
 }
 
 
@@ -717,9 +1094,16 @@ static void arm_register_emitters(void)
 	be_set_emitter(op_arm_B,         emit_arm_B);
 	be_set_emitter(op_arm_CopyB,     emit_arm_CopyB);
 	be_set_emitter(op_arm_FrameAddr, emit_arm_FrameAddr);
+	be_set_emitter(op_arm_LdrLit,    emit_arm_LdrLit);
+	be_set_emitter(op_arm_LoadM,     emit_arm_LoadM);
+	be_set_emitter(op_arm_StoreM,    emit_arm_StoreM);
 	be_set_emitter(op_arm_Jmp,       emit_arm_Jmp);
+	be_set_emitter(op_arm_Movt,      emit_arm_Movt);
+	be_set_emitter(op_arm_Movw,      emit_arm_Movw);
 	be_set_emitter(op_arm_SwitchJmp, emit_arm_SwitchJmp);
 	be_set_emitter(op_arm_SymConst,  emit_arm_SymConst);
+	be_set_emitter(op_arm_Vconst,    emit_arm_Vconst);
+	be_set_emitter(op_arm_Vcvt,      emit_arm_Vcvt);
 	be_set_emitter(op_arm_fConst,    emit_arm_fConst);
 	be_set_emitter(op_be_Copy,       emit_be_Copy);
 	be_set_emitter(op_be_CopyKeep,   emit_be_Copy);
@@ -759,6 +1143,39 @@ static void arm_emit_block_header(ir_node *block, ir_node *prev)
 	be_gas_begin_block(block, need_label);
 }
 
+/**
+ * Returns an upper bound for the code size of @p node.
+ */
+static unsigned get_max_node_size(const ir_node *node)
+{
+	if (is_arm_SwitchJmp(node)) {
+		const arm_SwitchJmp_attr_t *attr = get_arm_SwitchJmp_attr_const(node);
+		return 4 + 4 * get_jump_table_length(attr->table);
+	} else if (is_arm_CopyB(node)) {
+		const arm_CopyB_attr_t *attr = get_arm_CopyB_attr_const(node);
+		return MAX_NODE_SIZE + 8 * (attr->size / 16);
+	} else if (be_is_MemPerm(node)) {
+		return 16 * be_get_MemPerm_entity_arity(node);
+	}
+	return MAX_NODE_SIZE;
+}
+
+/**
+ * Returns true if control flow falls through from @p prev into @p block.
+ */
+static bool is_fallthrough(const ir_node *block, const ir_node *prev)
+{
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		ir_node *pred = get_Block_cfgpred(block, i);
+		if (get_nodes_block(pred) != prev)
+			continue;
+		if (is_Proj(pred) && is_arm_SwitchJmp(get_Proj_pred(pred)))
+			continue;
+		return true;
+	}
+	return false;
+}
+
 /**
  * Walks over the nodes in a block connected by scheduling edges
  * and emits code for each node.
@@ -767,7 +1184,12 @@ static void arm_gen_block(ir_node *block, ir_node *prev_block)
 {
 	arm_emit_block_header(block, prev_block);
 	be_dwarf_location(get_irn_dbg_info(block));
-	sched_foreach(block, irn) {
+	sched_foreach_frozen(block, irn) {
+		/* the pending literal pool entries have to stay in reach */
+		if (pool_size > 0
+		    && get_code_size() + get_max_node_size(irn) + 8 + pool_size
+		       > pool_deadline)
+			emit_literal_pool(true);
 		be_emit_node(irn);
 	}
 }
@@ -806,12 +1228,13 @@ void arm_emit_function(ir_graph *irg)
 {
 	ir_node          *last_block = NULL;
 	ir_entity        *entity     = get_irg_entity(irg);
-	const arch_env_t *arch_env   = be_get_irg_arch_env(irg);
 	ir_node          **blk_sched;
 	size_t           i, n;
 
-	isa = (arm_isa_t*) arch_env;
-	sym_or_tv = new_set(cmp_sym_or_tv, 8);
+	sym_or_tv     = new_set(cmp_sym_or_tv, 8);
+	first_line    = be_emit_get_n_lines();
+	pool_size     = 0;
+	pool_deadline = UINT_MAX;
 
 	be_gas_elf_type_char = '%';
 
@@ -819,6 +1242,7 @@ void arm_emit_function(ir_graph *irg)
 
 	/* create the block schedule */
 	blk_sched = be_create_block_schedule(irg);
+	sched_freeze(irg);
 
 	be_gas_emit_function_prolog(entity, 4, NULL);
 
@@ -834,42 +1258,19 @@ void arm_emit_function(ir_graph *irg)
 
 		/* set here the link. the emitter expects to find the next block here */
 		set_irn_link(block, next_bl);
+		/* place a literal pool close to its deadline where no control flow
+		 * falls through */
+		if (pool_size > 0 && last_block != NULL
+		    && get_code_size() + pool_size + POOL_SLACK > pool_deadline
+		    && !is_fallthrough(block, last_block))
+			emit_literal_pool(false);
 		arm_gen_block(block, last_block);
 		last_block = block;
 	}
 
-	/* emit SymConst values */
-	if (set_count(sym_or_tv) > 0) {
-		be_emit_cstring("\t.align 2\n");
-
-		foreach_set(sym_or_tv, sym_or_tv_t, entry) {
-			emit_constant_name(entry);
-			be_emit_cstring(":\n");
-			be_emit_write_line();
-
-			if (entry->is_entity) {
-				be_emit_cstring("\t.word\t");
-				be_gas_emit_entity(entry->u.entity);
-				be_emit_char('\n');
-				be_emit_write_line();
-			} else {
-				ir_tarval *tv = entry->u.tv;
-				int vi;
-				int size = get_mode_size_bytes(get_tarval_mode(tv));
-
-				/* beware: ARM fpa uses big endian format */
-				for (vi = ((size + 3) & ~3) - 4; vi >= 0; vi -= 4) {
-					/* get 32 bits */
-					unsigned v;
-					v =            get_tarval_sub_bits(tv, vi+3);
-					v = (v << 8) | get_tarval_sub_bits(tv, vi+2);
-					v = (v << 8) | get_tarval_sub_bits(tv, vi+1);
-					v = (v << 8) | get_tarval_sub_bits(tv, vi+0);
-					be_emit_irprintf("\t.word\t%u\n", v);
-					be_emit_write_line();
-				}
-			}
-		}
+	/* emit the remaining literal pool entries */
+	if (pool_size > 0) {
+		emit_literal_pool(false);
 		be_emit_char('\n');
 		be_emit_write_line();
 	}
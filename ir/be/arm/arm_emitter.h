@@ -42,6 +42,22 @@
  */
 void arm_emitf(const ir_node *node, const char *format, ...);
 
+/*
+ * Emitters for single format conversions, used by arm_emitf() and the
+ * emitters generated from the node specification.
+ */
+void arm_emit_source_register(const ir_node *node, int pos);
+void arm_emit_dest_register(const ir_node *node, int pos);
+void arm_emit_offset(const ir_node *node);
+void arm_emit_shifter_operand(const ir_node *node);
+void arm_emit_symconst(const ir_node *node);
+void arm_emit_cond_suffix(const ir_node *node);
+void arm_emit_load_mode(const ir_node *node);
+void arm_emit_store_mode(const ir_node *node);
+void arm_emit_float_arithmetic_mode(const ir_node *node);
+void arm_emit_float_load_store_mode(const ir_node *node);
+void arm_emit_vfp_arithmetic_mode(const ir_node *node);
+
 void arm_emit_function(ir_graph *irg);
 
 void arm_init_emitter(void);
@@ -33,13 +33,20 @@
 
 static bool arm_has_symconst_attr(const ir_node *node)
 {
-	return is_arm_SymConst(node) || is_arm_FrameAddr(node) || is_arm_Bl(node);
+	return is_arm_SymConst(node) || is_arm_FrameAddr(node) || is_arm_Bl(node)
+	    || is_arm_Movw(node) || is_arm_Movt(node);
 }
 
 static bool has_load_store_attr(const ir_node *node)
 {
 	return is_arm_Ldr(node) || is_arm_Str(node) || is_arm_LinkLdrPC(node)
-		|| is_arm_Ldf(node) || is_arm_Stf(node);
+		|| is_arm_Ldf(node) || is_arm_Stf(node)
+		|| is_arm_Vldr(node) || is_arm_Vstr(node);
+}
+
+static bool has_cond_attr(const ir_node *node)
+{
+	return is_arm_MovCC(node) || is_arm_AddCC(node) || is_arm_SubCC(node);
 }
 
 static bool has_shifter_operand(const ir_node *node)
@@ -47,7 +54,8 @@ static bool has_shifter_operand(const ir_node *node)
 	return is_arm_Add(node) || is_arm_And(node) || is_arm_Or(node)
 		|| is_arm_Eor(node) || is_arm_Bic(node) || is_arm_Sub(node)
 		|| is_arm_Rsb(node) || is_arm_Mov(node) || is_arm_Mvn(node)
-		|| is_arm_Cmp(node) || is_arm_Tst(node) || is_arm_LinkMovPC(node);
+		|| is_arm_Cmp(node) || is_arm_Tst(node) || is_arm_LinkMovPC(node)
+		|| has_cond_attr(node);
 }
 
 static bool has_cmp_attr(const ir_node *node)
@@ -58,9 +66,20 @@ static bool has_cmp_attr(const ir_node *node)
 static bool has_farith_attr(const ir_node *node)
 {
 	return is_arm_Adf(node) || is_arm_Muf(node) || is_arm_Suf(node)
-	    || is_arm_Dvf(node) || is_arm_Mvf(node) || is_arm_FltX(node);
+	    || is_arm_Dvf(node) || is_arm_Mvf(node) || is_arm_FltX(node)
+	    || is_arm_Vadd(node) || is_arm_Vsub(node) || is_arm_Vmul(node)
+	    || is_arm_Vdiv(node) || is_arm_Vneg(node) || is_arm_Vcmp(node)
+	    || is_arm_Vcvt(node) || is_arm_Vsitof(node) || is_arm_Vuitof(node)
+	    || is_arm_Vftosi(node) || is_arm_Vftoui(node);
 }
 
+#ifndef NDEBUG
+static bool has_fConst_attr(const ir_node *node)
+{
+	return is_arm_fConst(node) || is_arm_Vconst(node) || is_arm_LdrLit(node);
+}
+#endif
+
 /**
  * Dumper interface for dumping arm nodes in vcg.
  * @param F        the output file
@@ -158,6 +177,10 @@ static void arm_dump_node(FILE *F, const ir_node *n, dump_reason_t reason)
 			}
 			fputc('\n', F);
 		}
+		if (has_cond_attr(n)) {
+			const arm_cond_attr_t *attr = get_arm_cond_attr_const(n);
+			fprintf(F, "relation = %s\n", get_relation_string(attr->relation));
+		}
 		if (arm_has_symconst_attr(n)) {
 			const arm_SymConst_attr_t *attr = get_arm_SymConst_attr_const(n);
 
@@ -193,7 +216,8 @@ const arm_attr_t *get_arm_attr_const(const ir_node *node)
 #ifndef NDEBUG
 static bool has_symconst_attr(const ir_node *node)
 {
-	return is_arm_SymConst(node) || is_arm_FrameAddr(node) || is_arm_Bl(node);
+	return is_arm_SymConst(node) || is_arm_FrameAddr(node) || is_arm_Bl(node)
+	    || is_arm_Movw(node) || is_arm_Movt(node);
 }
 #endif
 
@@ -211,13 +235,13 @@ const arm_SymConst_attr_t *get_arm_SymConst_attr_const(const ir_node *node)
 
 static const arm_fConst_attr_t *get_arm_fConst_attr_const(const ir_node *node)
 {
-	assert(is_arm_fConst(node));
+	assert(has_fConst_attr(node));
 	return (const arm_fConst_attr_t*)get_irn_generic_attr_const(node);
 }
 
 static arm_fConst_attr_t *get_arm_fConst_attr(ir_node *node)
 {
-	assert(is_arm_fConst(node));
+	assert(has_fConst_attr(node));
 	return (arm_fConst_attr_t*)get_irn_generic_attr(node);
 }
 
@@ -342,6 +366,12 @@ static void init_arm_cmp_attr(ir_node *res, bool ins_permuted, bool is_unsigned)
 	attr->is_unsigned  = is_unsigned;
 }
 
+static void init_arm_cond_attr(ir_node *res, ir_relation relation)
+{
+	arm_cond_attr_t *attr = get_arm_cond_attr(res);
+	attr->relation = relation;
+}
+
 static void init_arm_SymConst_attributes(ir_node *res, ir_entity *entity,
                                          int symconst_offset)
 {
@@ -469,6 +499,16 @@ const arm_cmp_attr_t *get_arm_cmp_attr_const(const ir_node *node)
 	return (const arm_cmp_attr_t*) get_irn_generic_attr_const(node);
 }
 
+arm_cond_attr_t *get_arm_cond_attr(ir_node *node)
+{
+	return (arm_cond_attr_t*) get_irn_generic_attr(node);
+}
+
+const arm_cond_attr_t *get_arm_cond_attr_const(const ir_node *node)
+{
+	return (const arm_cond_attr_t*) get_irn_generic_attr_const(node);
+}
+
 static int cmp_attr_arm_load_store(const ir_node *a, const ir_node *b)
 {
 	const arm_load_store_attr_t *attr_a;
@@ -521,6 +561,19 @@ static int cmp_attr_arm_cmp(const ir_node *a, const ir_node *b)
 	return 0;
 }
 
+static int cmp_attr_arm_cond(const ir_node *a, const ir_node *b)
+{
+	const arm_cond_attr_t *attr_a;
+	const arm_cond_attr_t *attr_b;
+
+	if (cmp_attr_arm_shifter_operand(a, b))
+		return 1;
+
+	attr_a = get_arm_cond_attr_const(a);
+	attr_b = get_arm_cond_attr_const(b);
+	return attr_a->relation != attr_b->relation;
+}
+
 static int cmp_attr_arm_farith(const ir_node *a, const ir_node *b)
 {
 	const arm_farith_attr_t *attr_a;
@@ -46,6 +46,9 @@ const arm_shifter_operand_t *get_arm_shifter_operand_attr_const(const ir_node *n
 arm_cmp_attr_t *get_arm_cmp_attr(ir_node *node);
 const arm_cmp_attr_t *get_arm_cmp_attr_const(const ir_node *node);
 
+arm_cond_attr_t *get_arm_cond_attr(ir_node *node);
+const arm_cond_attr_t *get_arm_cond_attr_const(const ir_node *node);
+
 arm_farith_attr_t *get_arm_farith_attr(ir_node *node);
 const arm_farith_attr_t *get_arm_farith_attr_const(const ir_node *node);
 
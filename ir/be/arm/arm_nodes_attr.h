@@ -69,6 +69,12 @@ typedef struct arm_cmp_attr_t {
 	bool                   is_unsigned  : 1;
 } arm_cmp_attr_t;
 
+/** Attributes for conditionally executed data processing instructions */
+typedef struct arm_cond_attr_t {
+	arm_shifter_operand_t  base;
+	ir_relation            relation; /**< execute if the flags satisfy this */
+} arm_cond_attr_t;
+
 /**
  * this struct holds information needed to produce the arm addressing modes
  * for "Load and Store Word or Unsigned Byte", "Miscellaneous Loads and Stores"
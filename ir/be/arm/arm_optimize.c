@@ -11,8 +11,11 @@
 #include "irgmod.h"
 #include "ircons.h"
 #include "iredges.h"
+#include "irgwalk.h"
+#include "irop_t.h"
 #include "error.h"
 
+#include "beirg.h"
 #include "benode.h"
 #include "bepeephole.h"
 #include "besched.h"
@@ -188,6 +191,18 @@ static void peephole_arm_FrameAddr(ir_node *node)
 	set_irn_n(node, n_arm_FrameAddr_base, ptr);
 }
 
+/**
+ * Returns whether @p offset fits into the immediate of an integer load or
+ * store of @p mode, halfword and signed byte accesses have a smaller range.
+ */
+static bool is_load_store_offset(const ir_mode *mode, int offset)
+{
+	unsigned bits  = get_mode_size_bits(mode);
+	int      limit = bits == 16 || (bits == 8 && mode_is_signed(mode))
+	                 ? 255 : 4095;
+	return -limit <= offset && offset <= limit;
+}
+
 /**
  * Fix stackpointer relative stores if the offset gets too big
  */
@@ -199,8 +214,9 @@ static void peephole_arm_Str_Ldr(ir_node *node)
 	ir_node               *ptr;
 	arm_vals              v;
 
-	if (allowed_arm_immediate(offset, &v))
+	if (is_load_store_offset(attr->load_store_mode, offset))
 		return;
+	arm_gen_vals_from_word(offset < 0 ? -offset : offset, &v);
 
 	/* we should only have too big offsets for frame entities */
 	if (!attr->is_frame_entity) {
@@ -235,6 +251,438 @@ static void peephole_arm_Str_Ldr(ir_node *node)
 	attr->offset = 0;
 }
 
+/** maximum number of nodes searched for accesses to combine */
+#define LOAD_STORE_M_WINDOW 16
+/** maximum number of words combined into one LoadM/StoreM */
+#define LOAD_STORE_M_MAX    8
+
+/** Returns a mask bit for the general purpose register @p reg. */
+static unsigned gp_mask(const arch_register_t *reg)
+{
+	if (reg == NULL || reg->reg_class != &arm_reg_classes[CLASS_arm_gp])
+		return 0;
+	return 1u << reg->index;
+}
+
+/** Returns the general purpose registers written by @p node. */
+static unsigned get_written_regs(const ir_node *node)
+{
+	unsigned mask = 0;
+	be_foreach_out(node, o) {
+		mask |= gp_mask(arch_get_irn_register_out(node, o));
+	}
+	return mask;
+}
+
+/** Returns the general purpose registers read by @p node. */
+static unsigned get_read_regs(const ir_node *node)
+{
+	unsigned mask = 0;
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		mask |= gp_mask(arch_get_irn_register_in(node, i));
+	}
+	return mask;
+}
+
+/**
+ * Returns the register loaded or stored by @p node if it is a word sized
+ * Ldr or Str of the given kind, NULL otherwise.
+ */
+static const arch_register_t *get_word_access_reg(const ir_node *node,
+                                                  bool is_load)
+{
+	if (is_load ? !is_arm_Ldr(node) : !is_arm_Str(node))
+		return NULL;
+	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(node);
+	if (get_mode_size_bits(attr->load_store_mode) != 32
+	    || (attr->entity != NULL && !attr->is_frame_entity))
+		return NULL;
+	const arch_register_t *reg = is_load
+		? arch_get_irn_register_out(node, pn_arm_Ldr_res)
+		: arch_get_irn_register_in(node, n_arm_Str_val);
+	/* sp and pc in the register list have special meanings */
+	if (reg == &arm_registers[REG_SP] || reg == &arm_registers[REG_PC])
+		return NULL;
+	return reg;
+}
+
+/**
+ * Returns whether @p node may access memory. Calls are not marked as memory
+ * operations, but take a memory input.
+ */
+static bool may_access_memory(const ir_node *node)
+{
+	if (is_op_uses_memory(get_irn_op(node)))
+		return true;
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		if (get_irn_mode(get_irn_n(node, i)) == mode_M)
+			return true;
+	}
+	return false;
+}
+
+static long get_access_offset(const ir_node *node)
+{
+	return get_arm_load_store_attr_const(node)->offset;
+}
+
+/**
+ * Checks whether the first @p n accesses cover consecutive words and their
+ * registers ascend with the addresses, which ldm/stm demand.
+ *
+ * @return the lowest offset
+ */
+static bool is_consecutive(ir_node *const *accesses,
+                           const arch_register_t *const *regs, unsigned n,
+                           long *lowest)
+{
+	unsigned low = 0;
+	for (unsigned i = 1; i < n; ++i) {
+		if (get_access_offset(accesses[i]) < get_access_offset(accesses[low]))
+			low = i;
+	}
+	long     base_offset = get_access_offset(accesses[low]);
+	unsigned used        = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		long delta = get_access_offset(accesses[i]) - base_offset;
+		if (delta % 4 != 0 || delta / 4 >= (long)n || (used & (1u << delta / 4)))
+			return false;
+		used |= 1u << delta / 4;
+		for (unsigned j = 0; j < n; ++j) {
+			long delta_j = get_access_offset(accesses[j]) - base_offset;
+			if (delta_j > delta && regs[j]->index <= regs[i]->index)
+				return false;
+		}
+	}
+	*lowest = base_offset;
+	return true;
+}
+
+/**
+ * Returns whether ldm/stm can address @p n words beginning at @p offset from
+ * the base register without an address computation.
+ */
+static bool is_load_store_m_offset(long offset, unsigned n)
+{
+	long const size = 4 * (long)n;
+	return offset == 0 || offset == 4 || offset == -size
+	    || offset == 4 - size;
+}
+
+/** Sorts the accesses by offset. */
+static void sort_accesses(ir_node **accesses, const arch_register_t **regs,
+                          unsigned n)
+{
+	for (unsigned i = 1; i < n; ++i) {
+		for (unsigned j = i; j > 0
+		     && get_access_offset(accesses[j]) < get_access_offset(accesses[j - 1]);
+		     --j) {
+			ir_node               *tmp     = accesses[j];
+			const arch_register_t *tmp_reg = regs[j];
+			accesses[j]      = accesses[j - 1];
+			regs[j]          = regs[j - 1];
+			accesses[j - 1]  = tmp;
+			regs[j - 1]      = tmp_reg;
+		}
+	}
+}
+
+/** Returns whether @p mem is the memory result of one of the accesses. */
+static bool is_access_memory(const ir_node *mem, ir_node *const *accesses,
+                             unsigned n)
+{
+	const ir_node *pred = is_Proj(mem) ? get_Proj_pred(mem) : mem;
+	for (unsigned i = 0; i < n; ++i) {
+		if (accesses[i] == pred)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Returns whether the memory @p mem is produced after @p first by another
+ * node than the accesses, so a load using it cannot move up to @p first.
+ */
+static bool is_memory_after(const ir_node *mem, const ir_node *first,
+                            ir_node *const *accesses, unsigned n)
+{
+	const ir_node *pred = is_Proj(mem) ? get_Proj_pred(mem) : mem;
+	if (is_Sync(pred))
+		return true;
+	return get_nodes_block(pred) == get_nodes_block(first)
+	    && sched_is_scheduled(pred) && sched_comes_after(first, pred)
+	    && !is_access_memory(mem, accesses, n);
+}
+
+/**
+ * Combines the memory inputs of the accesses, ignoring the ones which are
+ * produced by the accesses themselves.
+ */
+static ir_node *combine_memory(ir_node *block, ir_node *const *accesses,
+                               unsigned n, int mem_pos)
+{
+	ir_node *in[LOAD_STORE_M_MAX];
+	int      n_in = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		ir_node *mem = get_irn_n(accesses[i], mem_pos);
+		if (is_access_memory(mem, accesses, n))
+			continue;
+		bool found = false;
+		for (int j = 0; j < n_in; ++j)
+			found |= in[j] == mem;
+		if (!found)
+			in[n_in++] = mem;
+	}
+	assert(n_in > 0);
+	return n_in == 1 ? in[0] : new_r_Sync(block, n_in, in);
+}
+
+/**
+ * Creates the base address for accessing the words at @p offset from @p ptr
+ * with a LoadM/StoreM scheduled before @p before. Uses r12 if an address
+ * computation is necessary.
+ *
+ * @return NULL if the address cannot be formed cheaply
+ */
+static ir_node *get_load_store_m_base(ir_node *before, ir_node *ptr,
+                                      long *offset, unsigned n)
+{
+	if (is_load_store_m_offset(*offset, n))
+		return ptr;
+
+	/* an address computation only pays off for more than two words */
+	arm_vals v;
+	if (n < 3 || arch_get_irn_register(ptr) == &arm_registers[REG_R12]
+	    || !allowed_arm_immediate(*offset < 0 ? -*offset : *offset, &v))
+		return NULL;
+
+	dbg_info *dbgi  = get_irn_dbg_info(before);
+	ir_node  *block = get_nodes_block(before);
+	ir_node  *addr  = *offset < 0
+		? new_bd_arm_Sub_imm(dbgi, block, ptr, v.values[0], v.rors[0])
+		: new_bd_arm_Add_imm(dbgi, block, ptr, v.values[0], v.rors[0]);
+	arch_set_irn_register(addr, &arm_registers[REG_R12]);
+	sched_add_before(before, addr);
+	*offset = 0;
+	return addr;
+}
+
+/**
+ * Sets the register requirements of a LoadM/StoreM: all inputs but the
+ * memory are general purpose registers.
+ */
+static void set_load_store_m_reqs(ir_node *node)
+{
+	ir_graph                   *irg   = get_irn_irg(node);
+	struct obstack             *obst  = be_get_be_obst(irg);
+	int                         arity = get_irn_arity(node);
+	const arch_register_req_t **reqs
+		= OALLOCN(obst, const arch_register_req_t*, arity);
+	for (int i = 0; i < arity - 1; ++i) {
+		reqs[i] = arm_reg_classes[CLASS_arm_gp].class_req;
+	}
+	reqs[arity - 1] = arch_no_register_req;
+	arch_set_irn_register_reqs_in(node, reqs);
+}
+
+/**
+ * Combines loads of consecutive words at @p first and the following Ldr
+ * nodes into a single ldm. The loads are moved up to @p first, so nodes in
+ * between must not write memory, the base register or use the loaded
+ * registers.
+ */
+static ir_node *combine_loads(ir_node *first)
+{
+	ir_node               *loads[LOAD_STORE_M_MAX];
+	const arch_register_t *regs[LOAD_STORE_M_MAX];
+	const arch_register_t *base = arch_get_irn_register_in(first, n_arm_Ldr_ptr);
+	unsigned               n    = 0;
+	unsigned               used = 0; /**< registers used by other nodes */
+
+	regs[0] = get_word_access_reg(first, true);
+	if (regs[0] == NULL || regs[0] == base)
+		return first;
+	loads[n++] = first;
+
+	unsigned window = 0;
+	for (ir_node *node = sched_next(first);
+	     !sched_is_end(node) && n < LOAD_STORE_M_MAX
+	     && window < LOAD_STORE_M_WINDOW;
+	     node = sched_next(node), ++window) {
+		const arch_register_t *reg = get_word_access_reg(node, true);
+		if (reg != NULL && reg != base && !(used & gp_mask(reg))
+		    && arch_get_irn_register_in(node, n_arm_Ldr_ptr) == base
+		    && !is_memory_after(get_irn_n(node, n_arm_Ldr_mem), first,
+		                        loads, n)) {
+			bool duplicate = false;
+			for (unsigned i = 0; i < n; ++i)
+				duplicate |= regs[i] == reg;
+			if (!duplicate) {
+				regs[n]    = reg;
+				loads[n++] = node;
+				continue;
+			}
+		}
+
+		if (is_cfop(node) || (may_access_memory(node) && !is_arm_Ldr(node)))
+			break;
+		unsigned written = get_written_regs(node);
+		if (written & gp_mask(base))
+			break;
+		used |= written | get_read_regs(node);
+	}
+
+	/* find the longest prefix which ldm can load */
+	long offset = 0;
+	while (n >= 2 && !(is_consecutive(loads, regs, n, &offset)
+	                   && (is_load_store_m_offset(offset, n) || n >= 3)))
+		--n;
+	if (n < 2)
+		return first;
+	ir_node *ptr = get_load_store_m_base(first,
+	                                     get_irn_n(first, n_arm_Ldr_ptr),
+	                                     &offset, n);
+	if (ptr == NULL)
+		return first;
+
+	sort_accesses(loads, regs, n);
+	ir_node  *block = get_nodes_block(first);
+	ir_node  *in[2];
+	in[0] = ptr;
+	in[1] = combine_memory(block, loads, n, n_arm_Ldr_mem);
+	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(first);
+	ir_node *ldm = new_bd_arm_LoadM(get_irn_dbg_info(first), block, 2, in,
+	                                n + 1, attr->load_store_mode, NULL, 0,
+	                                offset, false);
+	set_load_store_m_reqs(ldm);
+	for (unsigned i = 0; i < n; ++i) {
+		arch_set_irn_register_req_out(ldm, i,
+		                              arm_reg_classes[CLASS_arm_gp].class_req);
+		arch_set_irn_register_out(ldm, i, regs[i]);
+	}
+	arch_set_irn_register_req_out(ldm, n, arch_no_register_req);
+	sched_add_before(first, ldm);
+
+	ir_node *mem = NULL;
+	for (unsigned i = 0; i < n; ++i) {
+		ir_node *load = loads[i];
+		foreach_out_edge_safe(load, edge) {
+			ir_node *proj = get_edge_src_irn(edge);
+			if (get_Proj_proj(proj) == pn_arm_Ldr_res) {
+				exchange(proj, new_r_Proj(ldm, get_irn_mode(proj), i));
+			} else {
+				if (mem == NULL)
+					mem = new_r_Proj(ldm, mode_M, n);
+				exchange(proj, mem);
+			}
+		}
+		sched_remove(load);
+		kill_node(load);
+	}
+	return ldm;
+}
+
+/**
+ * Combines stores of consecutive words at @p first and the following Str
+ * nodes into a single stm. The stores are moved down to the last one, so
+ * nodes in between must not access memory or overwrite the base and the
+ * stored registers.
+ */
+static ir_node *combine_stores(ir_node *first)
+{
+	ir_node               *stores[LOAD_STORE_M_MAX];
+	const arch_register_t *regs[LOAD_STORE_M_MAX];
+	const arch_register_t *base = arch_get_irn_register_in(first, n_arm_Str_ptr);
+	unsigned               n    = 0;
+	unsigned               live = 0; /**< registers which must not change */
+
+	regs[0] = get_word_access_reg(first, false);
+	if (regs[0] == NULL)
+		return first;
+	stores[n++] = first;
+	live        = gp_mask(base) | gp_mask(regs[0]);
+
+	unsigned window = 0;
+	for (ir_node *node = sched_next(first);
+	     !sched_is_end(node) && n < LOAD_STORE_M_MAX
+	     && window < LOAD_STORE_M_WINDOW;
+	     node = sched_next(node), ++window) {
+		const arch_register_t *reg = get_word_access_reg(node, false);
+		if (reg != NULL && arch_get_irn_register_in(node, n_arm_Str_ptr) == base) {
+			bool duplicate = false;
+			for (unsigned i = 0; i < n; ++i) {
+				duplicate |= regs[i] == reg
+				          || get_access_offset(stores[i])
+				             == get_access_offset(node);
+			}
+			if (duplicate)
+				break;
+			regs[n]     = reg;
+			stores[n++] = node;
+			live       |= gp_mask(reg);
+			continue;
+		}
+
+		if (is_cfop(node) || may_access_memory(node)
+		    || (get_written_regs(node) & live))
+			break;
+	}
+
+	/* find the longest prefix which stm can store */
+	long offset = 0;
+	while (n >= 2 && !(is_consecutive(stores, regs, n, &offset)
+	                   && (is_load_store_m_offset(offset, n) || n >= 3)))
+		--n;
+	if (n < 2)
+		return first;
+	ir_node *last = stores[n - 1];
+	ir_node *ptr  = get_load_store_m_base(last, get_irn_n(last, n_arm_Str_ptr),
+	                                      &offset, n);
+	if (ptr == NULL)
+		return first;
+
+	ir_node *block = get_nodes_block(first);
+	ir_node *in[LOAD_STORE_M_MAX + 2];
+	ir_node *mem   = combine_memory(block, stores, n, n_arm_Str_mem);
+	sort_accesses(stores, regs, n);
+	in[0] = ptr;
+	for (unsigned i = 0; i < n; ++i) {
+		in[i + 1] = get_irn_n(stores[i], n_arm_Str_val);
+	}
+	in[n + 1] = mem;
+	const arm_load_store_attr_t *attr = get_arm_load_store_attr_const(first);
+	ir_node *stm = new_bd_arm_StoreM(get_irn_dbg_info(last), block, n + 2, in,
+	                                 1, attr->load_store_mode, NULL, 0, offset,
+	                                 false);
+	set_load_store_m_reqs(stm);
+	arch_set_irn_register_req_out(stm, 0, arch_no_register_req);
+	sched_add_before(last, stm);
+
+	ir_node *res = new_r_Proj(stm, mode_M, 0);
+	for (unsigned i = 0; i < n; ++i) {
+		sched_remove(stores[i]);
+		exchange(stores[i], res);
+	}
+	return stm;
+}
+
+/**
+ * Combines loads and stores of consecutive words relative to the same base
+ * register into ldm/stm.
+ */
+static void combine_load_store_m(ir_node *block, void *data)
+{
+	(void)data;
+	for (ir_node *node = sched_first(block); !sched_is_end(node);
+	     node = sched_next(node)) {
+		if (is_arm_Ldr(node)) {
+			node = combine_loads(node);
+		} else if (is_arm_Str(node)) {
+			node = combine_stores(node);
+		}
+	}
+}
+
 /**
  * Register a peephole optimization function.
  */
@@ -255,4 +703,7 @@ void arm_peephole_optimization(ir_graph *irg)
 	register_peephole_optimization(op_arm_FrameAddr, peephole_arm_FrameAddr);
 
 	be_peephole_opt(irg);
+
+	/* the offsets are final now */
+	irg_block_walk_graph(irg, NULL, combine_load_store_m, NULL);
 }
@@ -9,6 +9,7 @@ $arch = "arm";
 $mode_gp    = "mode_Iu";
 $mode_flags = "mode_Bu";
 $mode_fp    = "mode_F";
+$mode_fp2   = "mode_D";
 
 # NOTE: Last entry of each class is the largest Firm-Mode a register can hold
 %reg_classes = (
@@ -42,6 +43,41 @@ $mode_fp    = "mode_F";
 		{ name => "f7", dwarf => 103 },
 		{ mode => $mode_fp }
 	],
+	vfp => [
+		{ name => "s0",  dwarf => 64 },
+		{ name => "s1",  dwarf => 65 },
+		{ name => "s2",  dwarf => 66 },
+		{ name => "s3",  dwarf => 67 },
+		{ name => "s4",  dwarf => 68 },
+		{ name => "s5",  dwarf => 69 },
+		{ name => "s6",  dwarf => 70 },
+		{ name => "s7",  dwarf => 71 },
+		{ name => "s8",  dwarf => 72 },
+		{ name => "s9",  dwarf => 73 },
+		{ name => "s10", dwarf => 74 },
+		{ name => "s11", dwarf => 75 },
+		{ name => "s12", dwarf => 76 },
+		{ name => "s13", dwarf => 77 },
+		{ name => "s14", dwarf => 78 },
+		{ name => "s15", dwarf => 79 },
+		{ name => "s16", dwarf => 80 },
+		{ name => "s17", dwarf => 81 },
+		{ name => "s18", dwarf => 82 },
+		{ name => "s19", dwarf => 83 },
+		{ name => "s20", dwarf => 84 },
+		{ name => "s21", dwarf => 85 },
+		{ name => "s22", dwarf => 86 },
+		{ name => "s23", dwarf => 87 },
+		{ name => "s24", dwarf => 88 },
+		{ name => "s25", dwarf => 89 },
+		{ name => "s26", dwarf => 90 },
+		{ name => "s27", dwarf => 91 },
+		{ name => "s28", dwarf => 92 },
+		{ name => "s29", dwarf => 93 },
+		{ name => "s30", dwarf => 94 },
+		{ name => "s31", dwarf => 95 },
+		{ mode => $mode_fp }
+	],
 	flags => [
 		{ name => "fl" },
 		{ mode => $mode_flags, flags => "manual_ra" }
@@ -51,6 +87,21 @@ $mode_fp    = "mode_F";
 $default_attr_type = "arm_attr_t";
 $default_copy_attr = "arm_copy_attr";
 
+# conversions of the emit templates, compiled by generate_emitter.pl
+@emit_conversions = (
+	'D(\d)' => 'arm_emit_dest_register(node, $1)',
+	'S(\d)' => 'arm_emit_source_register(node, $1)',
+	'O'     => 'arm_emit_shifter_operand(node)',
+	'o'     => 'arm_emit_offset(node)',
+	'I'     => 'arm_emit_symconst(node)',
+	'P'     => 'arm_emit_cond_suffix(node)',
+	'ML'    => 'arm_emit_load_mode(node)',
+	'MS'    => 'arm_emit_store_mode(node)',
+	'MA'    => 'arm_emit_float_arithmetic_mode(node)',
+	'MF'    => 'arm_emit_float_load_store_mode(node)',
+	'MV'    => 'arm_emit_vfp_arithmetic_mode(node)',
+);
+
 %init_attr = (
 	arm_attr_t           => "\tinit_arm_attributes(res, irn_flags_, in_reqs, n_res);",
 	arm_SymConst_attr_t  =>
@@ -66,6 +117,8 @@ $default_copy_attr = "arm_copy_attr";
 		"\tinit_arm_attributes(res, irn_flags_, in_reqs, n_res);\n",
 	arm_cmp_attr_t =>
 		"\tinit_arm_attributes(res, irn_flags_, in_reqs, n_res);\n",
+	arm_cond_attr_t =>
+		"\tinit_arm_attributes(res, irn_flags_, in_reqs, n_res);\n",
 	arm_farith_attr_t =>
 		"\tinit_arm_attributes(res, irn_flags_, in_reqs, n_res);\n".
 		"\tinit_arm_farith_attributes(res, op_mode);",
@@ -84,9 +137,50 @@ $default_copy_attr = "arm_copy_attr";
 	arm_shifter_operand_t => "cmp_attr_arm_shifter_operand",
 	arm_CopyB_attr_t      => "cmp_attr_arm_CopyB",
 	arm_cmp_attr_t        => "cmp_attr_arm_cmp",
+	arm_cond_attr_t       => "cmp_attr_arm_cond",
 	arm_farith_attr_t     => "cmp_attr_arm_farith",
 );
 
+my %vfp_binop_constructors = (
+	s => {
+		reg_req => { in => [ "vfp", "vfp" ], out => [ "vfp" ] },
+		mode    => $mode_fp,
+	},
+	d => {
+		reg_req => { in => [ "vfp:a|2", "vfp:a|2" ], out => [ "vfp:a|2" ] },
+		mode    => $mode_fp2,
+	},
+);
+
+my %vfp_unop_constructors = (
+	s => {
+		reg_req => { in => [ "vfp" ], out => [ "vfp" ] },
+		mode    => $mode_fp,
+	},
+	d => {
+		reg_req => { in => [ "vfp:a|2" ], out => [ "vfp:a|2" ] },
+		mode    => $mode_fp2,
+	},
+);
+
+my %vfp_load_constructors = (
+	s => {
+		reg_req => { in => [ "gp", "none" ], out => [ "vfp", "none" ] },
+	},
+	d => {
+		reg_req => { in => [ "gp", "none" ], out => [ "vfp:a|2", "none" ] },
+	},
+);
+
+my %vfp_store_constructors = (
+	s => {
+		reg_req => { in => [ "gp", "vfp", "none" ], out => [ "none" ] },
+	},
+	d => {
+		reg_req => { in => [ "gp", "vfp:a|2", "none" ], out => [ "none" ] },
+	},
+);
+
 my %unop_shifter_operand_constructors = (
 	imm => {
 		attr       => "unsigned char immediate_value, unsigned char immediate_rot",
@@ -135,6 +229,46 @@ my %binop_shifter_operand_constructors = (
 	},
 );
 
+# conditionally executed instructions: the result register is the same as
+# the "false" input, which is left untouched if the condition does not hold
+my %cond_unop_shifter_operand_constructors = (
+	imm => {
+		attr       => "ir_relation relation, unsigned char immediate_value, unsigned char immediate_rot",
+		custominit =>
+			"init_arm_shifter_operand(res, immediate_value, ARM_SHF_IMM, immediate_rot);\n".
+			"\tinit_arm_cond_attr(res, relation);",
+		reg_req    => { in => [ "flags", "gp" ], out => [ "in_r2" ] },
+		ins        => [ "flags", "val_false" ],
+	},
+	reg => {
+		attr       => "ir_relation relation",
+		custominit =>
+			"init_arm_shifter_operand(res, 0, ARM_SHF_REG, 0);\n".
+			"\tinit_arm_cond_attr(res, relation);",
+		reg_req    => { in => [ "flags", "gp", "gp" ], out => [ "in_r2" ] },
+		ins        => [ "flags", "val_false", "val_true" ],
+	},
+);
+
+my %cond_binop_shifter_operand_constructors = (
+	imm => {
+		attr       => "ir_relation relation, unsigned char immediate_value, unsigned char immediate_rot",
+		custominit =>
+			"init_arm_shifter_operand(res, immediate_value, ARM_SHF_IMM, immediate_rot);\n".
+			"\tinit_arm_cond_attr(res, relation);",
+		reg_req    => { in => [ "flags", "gp", "gp" ], out => [ "in_r2" ] },
+		ins        => [ "flags", "val_false", "left" ],
+	},
+	reg => {
+		attr       => "ir_relation relation",
+		custominit =>
+			"init_arm_shifter_operand(res, 0, ARM_SHF_REG, 0);\n".
+			"\tinit_arm_cond_attr(res, relation);",
+		reg_req    => { in => [ "flags", "gp", "gp", "gp" ], out => [ "in_r2" ] },
+		ins        => [ "flags", "val_false", "left", "right" ],
+	},
+);
+
 my %cmp_shifter_operand_constructors = (
 	imm => {
 		attr       => "unsigned char immediate_value, unsigned char immediate_rot, bool ins_permuted, bool is_unsigned",
@@ -274,6 +408,27 @@ Mvn => {
 	constructors => \%unop_shifter_operand_constructors,
 },
 
+MovCC => {
+	attr_type => "arm_cond_attr_t",
+	emit      => 'mov%P %D0, %O',
+	mode      => $mode_gp,
+	constructors => \%cond_unop_shifter_operand_constructors,
+},
+
+AddCC => {
+	attr_type => "arm_cond_attr_t",
+	emit      => 'add%P %D0, %S2, %O',
+	mode      => $mode_gp,
+	constructors => \%cond_binop_shifter_operand_constructors,
+},
+
+SubCC => {
+	attr_type => "arm_cond_attr_t",
+	emit      => 'sub%P %D0, %S2, %O',
+	mode      => $mode_gp,
+	constructors => \%cond_binop_shifter_operand_constructors,
+},
+
 Clz => {
 	irn_flags => [ "rematerializable" ],
 	reg_req   => { in => [ "gp" ], out => [ "gp" ] },
@@ -356,6 +511,37 @@ SymConst => {
 	mode      => $mode_gp,
 },
 
+# movw/movt pair: without an entity the offset is the value to construct,
+# movw sets its low 16 bits, movt the high ones
+Movw => {
+	op_flags  => [ "constlike" ],
+	irn_flags => [ "rematerializable" ],
+	attr      => "ir_entity *entity, int symconst_offset",
+	reg_req   => { out => [ "gp" ] },
+	attr_type => "arm_SymConst_attr_t",
+	mode      => $mode_gp,
+},
+
+Movt => {
+	irn_flags => [ "rematerializable" ],
+	attr      => "ir_entity *entity, int symconst_offset",
+	reg_req   => { in => [ "gp" ], out => [ "in_r1" ] },
+	ins       => [ "low" ],
+	attr_type => "arm_SymConst_attr_t",
+	mode      => $mode_gp,
+},
+
+# integer constant loaded from the literal pool
+LdrLit => {
+	op_flags  => [ "constlike" ],
+	irn_flags => [ "rematerializable" ],
+	attr      => "ir_tarval *tv",
+	init_attr => "attr->tv = tv;",
+	reg_req   => { out => [ "gp" ] },
+	attr_type => "arm_fConst_attr_t",
+	mode      => $mode_gp,
+},
+
 Cmp => {
 	irn_flags    => [ "rematerializable", "modify_flags" ],
 	emit         => 'cmp %S0, %O',
@@ -424,6 +610,29 @@ Str => {
 	attr      => "ir_mode *ls_mode, ir_entity *entity, int entity_sign, long offset, bool is_frame_entity",
 },
 
+# Load/store multiple of consecutive words, created by the peephole
+# optimization after register allocation. Input 0 is the base address and the
+# last input the memory, LoadM has the loaded words as its first outputs and
+# StoreM takes the stored words between base and memory. The offset is the one
+# of the lowest word.
+LoadM => {
+	op_flags  => [ "uses_memory" ],
+	state     => "exc_pinned",
+	arity     => "variable",
+	out_arity => "variable",
+	attr_type => "arm_load_store_attr_t",
+	attr      => "ir_mode *ls_mode, ir_entity *entity, int entity_sign, long offset, bool is_frame_entity",
+},
+
+StoreM => {
+	op_flags  => [ "uses_memory" ],
+	state     => "exc_pinned",
+	arity     => "variable",
+	out_arity => "variable",
+	attr_type => "arm_load_store_attr_t",
+	attr      => "ir_mode *ls_mode, ir_entity *entity, int entity_sign, long offset, bool is_frame_entity",
+},
+
 StoreStackM4Inc => {
 	op_flags  => [ "uses_memory" ],
 	irn_flags => [ "rematerializable" ],
@@ -542,6 +751,239 @@ fConst => {
 	mode      => "get_tarval_mode(tv)",
 	reg_req   => { out => [ "fpa" ] },
 	attr_type => "arm_fConst_attr_t",
+},
+
+#
+# VFP instructions, double values occupy an aligned pair of single registers
+#
+Vadd => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vadd%MV %D0, %S0, %S1',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "left", "right" ],
+	constructors => \%vfp_binop_constructors,
+},
+
+Vsub => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vsub%MV %D0, %S0, %S1',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "left", "right" ],
+	constructors => \%vfp_binop_constructors,
+},
+
+Vmul => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vmul%MV %D0, %S0, %S1',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "left", "right" ],
+	constructors => \%vfp_binop_constructors,
+},
+
+Vdiv => {
+	emit         => 'vdiv%MV %D0, %S0, %S1',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "left", "right" ],
+	outs         => [ "res", "M" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp", "vfp" ], out => [ "vfp", "none" ] },
+		},
+		d => {
+			reg_req => { in => [ "vfp:a|2", "vfp:a|2" ], out => [ "vfp:a|2", "none" ] },
+		},
+	},
+},
+
+Vneg => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vneg%MV %D0, %S0',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => \%vfp_unop_constructors,
+},
+
+Vcmp => {
+	irn_flags    => [ "rematerializable", "modify_flags" ],
+	emit         => "vcmp%MV %S0, %S1\n".
+	                "vmrs APSR_nzcv, fpscr",
+	mode         => $mode_flags,
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "left", "right" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp", "vfp" ], out => [ "flags" ] },
+		},
+		d => {
+			reg_req => { in => [ "vfp:a|2", "vfp:a|2" ], out => [ "flags" ] },
+		},
+	},
+},
+
+# conversion between single and double precision, op_mode is the target mode
+Vcvt => {
+	irn_flags    => [ "rematerializable" ],
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => {
+		s_d => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp:a|2" ] },
+			mode    => $mode_fp2,
+		},
+		d_s => {
+			reg_req => { in => [ "vfp:a|2" ], out => [ "vfp" ] },
+			mode    => $mode_fp,
+		},
+	},
+},
+
+# integer to float conversions, the integer lives in a single register
+Vsitof => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vcvt%MV.s32 %D0, %S0',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp" ] },
+			mode    => $mode_fp,
+		},
+		d => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp:a|2" ] },
+			mode    => $mode_fp2,
+		},
+	},
+},
+
+Vuitof => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vcvt%MV.u32 %D0, %S0',
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp" ] },
+			mode    => $mode_fp,
+		},
+		d => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp:a|2" ] },
+			mode    => $mode_fp2,
+		},
+	},
+},
+
+# float to integer conversions rounding towards zero
+Vftosi => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vcvt.s32%MV %D0, %S0',
+	mode         => $mode_fp,
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp" ] },
+		},
+		d => {
+			reg_req => { in => [ "vfp:a|2" ], out => [ "vfp" ] },
+		},
+	},
+},
+
+Vftoui => {
+	irn_flags    => [ "rematerializable" ],
+	emit         => 'vcvt.u32%MV %D0, %S0',
+	mode         => $mode_fp,
+	attr_type    => "arm_farith_attr_t",
+	attr         => "ir_mode *op_mode",
+	ins          => [ "val" ],
+	constructors => {
+		s => {
+			reg_req => { in => [ "vfp" ], out => [ "vfp" ] },
+		},
+		d => {
+			reg_req => { in => [ "vfp:a|2" ], out => [ "vfp" ] },
+		},
+	},
+},
+
+# transfers between the general purpose and the VFP register file
+VmovSR => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp" ], out => [ "vfp" ] },
+	emit      => 'vmov %D0, %S0',
+	mode      => $mode_fp,
+},
+
+VmovRS => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "vfp" ], out => [ "gp" ] },
+	emit      => 'vmov %D0, %S0',
+	mode      => $mode_gp,
+},
+
+VmovDRR => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp", "gp" ], out => [ "vfp:a|2" ] },
+	ins       => [ "low", "high" ],
+	emit      => 'vmov %D0, %S0, %S1',
+	mode      => $mode_fp2,
+},
+
+VmovRRD => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "vfp:a|2" ], out => [ "gp", "gp" ] },
+	outs      => [ "low", "high" ],
+	emit      => 'vmov %D0, %D1, %S0',
+},
+
+Vldr => {
+	op_flags     => [ "uses_memory" ],
+	state        => "exc_pinned",
+	ins          => [ "ptr", "mem" ],
+	outs         => [ "res", "M" ],
+	emit         => 'vldr %D0, [%S0, #%o]',
+	attr_type    => "arm_load_store_attr_t",
+	attr         => "ir_mode *ls_mode, ir_entity *entity, int entity_sign, long offset, bool is_frame_entity",
+	constructors => \%vfp_load_constructors,
+},
+
+Vstr => {
+	op_flags     => [ "uses_memory" ],
+	state        => "exc_pinned",
+	ins          => [ "ptr", "val", "mem" ],
+	outs         => [ "M" ],
+	mode         => "mode_M",
+	emit         => 'vstr %S1, [%S0, #%o]',
+	attr_type    => "arm_load_store_attr_t",
+	attr         => "ir_mode *ls_mode, ir_entity *entity, int entity_sign, long offset, bool is_frame_entity",
+	constructors => \%vfp_store_constructors,
+},
+
+Vconst => {
+	op_flags     => [ "constlike" ],
+	irn_flags    => [ "rematerializable" ],
+	attr         => "ir_tarval *tv",
+	init_attr    => "attr->tv = tv;",
+	mode         => "get_tarval_mode(tv)",
+	attr_type    => "arm_fConst_attr_t",
+	constructors => {
+		s => {
+			reg_req => { out => [ "vfp" ] },
+		},
+		d => {
+			reg_req => { out => [ "vfp:a|2" ] },
+		},
+	},
 }
 
 ); # end of %nodes
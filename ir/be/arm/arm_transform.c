@@ -20,6 +20,7 @@
 #include "debug.h"
 #include "error.h"
 #include "util.h"
+#include "opt_frame.h"
 
 #include "benode.h"
 #include "beirg.h"
@@ -47,7 +48,7 @@ static ir_mode               *mode_fp;
 static beabi_helper_env_t    *abihelper;
 static be_stackorder_t       *stackorder;
 static calling_convention_t  *cconv = NULL;
-static arm_isa_t             *isa;
+static bool                   frame_may_escape;
 
 static pmap                  *node_to_stack;
 
@@ -80,11 +81,71 @@ static const arch_register_t *const caller_saves[] = {
 	&arm_registers[REG_F7],
 };
 
+static const arch_register_t *const vfp_callee_saves[] = {
+	&arm_registers[REG_S16],
+	&arm_registers[REG_S17],
+	&arm_registers[REG_S18],
+	&arm_registers[REG_S19],
+	&arm_registers[REG_S20],
+	&arm_registers[REG_S21],
+	&arm_registers[REG_S22],
+	&arm_registers[REG_S23],
+	&arm_registers[REG_S24],
+	&arm_registers[REG_S25],
+	&arm_registers[REG_S26],
+	&arm_registers[REG_S27],
+	&arm_registers[REG_S28],
+	&arm_registers[REG_S29],
+	&arm_registers[REG_S30],
+	&arm_registers[REG_S31],
+};
+
+static const arch_register_t *const vfp_caller_saves[] = {
+	&arm_registers[REG_S0],
+	&arm_registers[REG_S1],
+	&arm_registers[REG_S2],
+	&arm_registers[REG_S3],
+	&arm_registers[REG_S4],
+	&arm_registers[REG_S5],
+	&arm_registers[REG_S6],
+	&arm_registers[REG_S7],
+	&arm_registers[REG_S8],
+	&arm_registers[REG_S9],
+	&arm_registers[REG_S10],
+	&arm_registers[REG_S11],
+	&arm_registers[REG_S12],
+	&arm_registers[REG_S13],
+	&arm_registers[REG_S14],
+	&arm_registers[REG_S15],
+};
+
+static const arch_register_req_t vfp_double_req = {
+	arch_register_req_type_normal | arch_register_req_type_aligned,
+	&arm_reg_classes[CLASS_arm_vfp],
+	NULL,
+	0,
+	0,
+	2
+};
+
 static bool mode_needs_gp_reg(ir_mode *mode)
 {
 	return mode_is_int(mode) || mode_is_reference(mode);
 }
 
+/**
+ * Returns true if values of @p mode occupy a VFP register pair.
+ */
+static bool vfp_is_double(const ir_mode *mode)
+{
+	unsigned bits = get_mode_size_bits(mode);
+	if (bits == 32)
+		return false;
+	if (bits != 64 || !USE_VFP_DOUBLE())
+		panic("mode %+F not supported by the VFP unit", mode);
+	return true;
+}
+
 /**
  * create firm graph for a constant
  */
@@ -104,6 +165,18 @@ static ir_node *create_const_graph_value(dbg_info *dbgi, ir_node *block,
 	arm_gen_vals_from_word(value, &v);
 	arm_gen_vals_from_word(~value, &vn);
 
+	/* longer sequences are replaced by movw/movt or a literal load */
+	int ops = MIN(v.ops, vn.ops);
+	if (ops > 1 && USE_MOVW()) {
+		result = new_bd_arm_Movw(dbgi, block, NULL, value);
+		if (value > 0xFFFF)
+			result = new_bd_arm_Movt(dbgi, block, result, NULL, value);
+		return result;
+	} else if (ops > 2) {
+		ir_tarval *tv = new_tarval_from_long(value, mode_Iu);
+		return new_bd_arm_LdrLit(dbgi, block, tv);
+	}
+
 	if (vn.ops < v.ops) {
 		/* remove bits */
 		result = new_bd_arm_Mvn_imm(dbgi, block, vn.values[0], vn.rors[0]);
@@ -224,7 +297,7 @@ static ir_node *gen_Conv(ir_node *node)
 		return new_op;
 
 	if (mode_is_float(src_mode) || mode_is_float(dst_mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			if (mode_is_float(src_mode)) {
 				if (mode_is_float(dst_mode)) {
 					/* from float to float */
@@ -241,8 +314,47 @@ static ir_node *gen_Conv(ir_node *node)
 					return new_bd_arm_FltX(dbg, block, new_op, dst_mode);
 				}
 			}
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (mode_is_float(src_mode)) {
+				if (mode_is_float(dst_mode)) {
+					/* from float to float */
+					if (vfp_is_double(dst_mode))
+						return new_bd_arm_Vcvt_s_d(dbg, block, new_op, dst_mode);
+					else if (vfp_is_double(src_mode))
+						return new_bd_arm_Vcvt_d_s(dbg, block, new_op, dst_mode);
+					return new_op;
+				} else {
+					/* from float to int, the result is produced in a VFP
+					 * register */
+					bool     is_double = vfp_is_double(src_mode);
+					ir_node *conv;
+					if (mode_is_signed(dst_mode)) {
+						conv = is_double
+							? new_bd_arm_Vftosi_d(dbg, block, new_op, src_mode)
+							: new_bd_arm_Vftosi_s(dbg, block, new_op, src_mode);
+					} else {
+						conv = is_double
+							? new_bd_arm_Vftoui_d(dbg, block, new_op, src_mode)
+							: new_bd_arm_Vftoui_s(dbg, block, new_op, src_mode);
+					}
+					return new_bd_arm_VmovRS(dbg, block, conv);
+				}
+			} else {
+				/* from int to float, the source has to be moved into a VFP
+				 * register first */
+				bool     is_double = vfp_is_double(dst_mode);
+				ir_node *ext       = gen_extension(dbg, block, new_op, src_mode);
+				ir_node *val       = new_bd_arm_VmovSR(dbg, block, ext);
+				if (mode_is_signed(src_mode)) {
+					return is_double
+						? new_bd_arm_Vsitof_d(dbg, block, val, dst_mode)
+						: new_bd_arm_Vsitof_s(dbg, block, val, dst_mode);
+				} else {
+					return is_double
+						? new_bd_arm_Vuitof_d(dbg, block, val, dst_mode)
+						: new_bd_arm_Vuitof_s(dbg, block, val, dst_mode);
+				}
+			}
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -552,10 +664,12 @@ static ir_node *gen_Add(ir_node *node)
 		dbg_info *dbgi    = get_irn_dbg_info(node);
 		ir_node  *new_op1 = be_transform_node(op1);
 		ir_node  *new_op2 = be_transform_node(op2);
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			return new_bd_arm_Adf(dbgi, block, new_op1, new_op2, mode);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode))
+				return new_bd_arm_Vadd_d(dbgi, block, new_op1, new_op2, mode);
+			return new_bd_arm_Vadd_s(dbgi, block, new_op1, new_op2, mode);
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -581,10 +695,12 @@ static ir_node *gen_Mul(ir_node *node)
 	dbg_info *dbg     = get_irn_dbg_info(node);
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			return new_bd_arm_Muf(dbg, block, new_op1, new_op2, mode);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode))
+				return new_bd_arm_Vmul_d(dbg, block, new_op1, new_op2, mode);
+			return new_bd_arm_Vmul_s(dbg, block, new_op1, new_op2, mode);
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -606,10 +722,12 @@ static ir_node *gen_Div(ir_node *node)
 	/* integer division should be replaced by builtin call */
 	assert(mode_is_float(mode));
 
-	if (USE_FPA(isa)) {
+	if (USE_FPA()) {
 		return new_bd_arm_Dvf(dbg, block, new_op1, new_op2, mode);
-	} else if (USE_VFP(isa)) {
-		panic("VFP not supported yet");
+	} else if (USE_VFP()) {
+		if (vfp_is_double(mode))
+			return new_bd_arm_Vdiv_d(dbg, block, new_op1, new_op2, mode);
+		return new_bd_arm_Vdiv_s(dbg, block, new_op1, new_op2, mode);
 	} else {
 		panic("Softfloat not supported yet");
 	}
@@ -699,10 +817,12 @@ static ir_node *gen_Sub(ir_node *node)
 	dbg_info *dbgi    = get_irn_dbg_info(node);
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			return new_bd_arm_Suf(dbgi, block, new_op1, new_op2, mode);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode))
+				return new_bd_arm_Vsub_d(dbgi, block, new_op1, new_op2, mode);
+			return new_bd_arm_Vsub_s(dbgi, block, new_op1, new_op2, mode);
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -841,10 +961,12 @@ static ir_node *gen_Minus(ir_node *node)
 	ir_mode  *mode    = get_irn_mode(node);
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
-			return new_bd_arm_Mvf(dbgi, block, op, mode);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		if (USE_FPA()) {
+			return new_bd_arm_Mvf(dbgi, block, new_op, mode);
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode))
+				return new_bd_arm_Vneg_d(dbgi, block, new_op, mode);
+			return new_bd_arm_Vneg_s(dbgi, block, new_op, mode);
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -853,6 +975,33 @@ static ir_node *gen_Minus(ir_node *node)
 	return new_bd_arm_Rsb_imm(dbgi, block, new_op, 0, 0);
 }
 
+/**
+ * Folds a constant offset of the address @p ptr into the immediate of an
+ * integer load or store of @p mode. Halfword and signed byte accesses have a
+ * smaller immediate range.
+ *
+ * @return the remaining base address
+ */
+static ir_node *match_address(ir_node *ptr, ir_mode *mode, long *offset)
+{
+	*offset = 0;
+	if (!is_Add(ptr) || !is_Const(get_Add_right(ptr)))
+		return ptr;
+	ir_tarval *tv = get_Const_tarval(get_Add_right(ptr));
+	if (!tarval_is_long(tv))
+		return ptr;
+
+	/* addresses wrap around, so the offset may be read as signed */
+	long     val   = (int32_t)get_tarval_long(tv);
+	unsigned bits  = get_mode_size_bits(mode);
+	long     limit = bits == 16 || (bits == 8 && mode_is_signed(mode))
+	                 ? 255 : 4095;
+	if (val < -limit || val > limit)
+		return ptr;
+	*offset = val;
+	return get_Add_left(ptr);
+}
+
 static ir_node *gen_Load(ir_node *node)
 {
 	ir_node  *block    = be_transform_node(get_nodes_block(node));
@@ -868,18 +1017,27 @@ static ir_node *gen_Load(ir_node *node)
 		panic("unaligned Loads not supported yet");
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			new_load = new_bd_arm_Ldf(dbgi, block, new_ptr, new_mem, mode,
 			                          NULL, 0, 0, false);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode)) {
+				new_load = new_bd_arm_Vldr_d(dbgi, block, new_ptr, new_mem,
+				                             mode, NULL, 0, 0, false);
+			} else {
+				new_load = new_bd_arm_Vldr_s(dbgi, block, new_ptr, new_mem,
+				                             mode, NULL, 0, 0, false);
+			}
 		} else {
 			panic("Softfloat not supported yet");
 		}
 	} else {
 		assert(mode_is_data(mode) && "unsupported mode for Load");
 
-		new_load = new_bd_arm_Ldr(dbgi, block, new_ptr, new_mem, mode, NULL, 0, 0, false);
+		long     offset;
+		ir_node *base = match_address(ptr, mode, &offset);
+		new_load = new_bd_arm_Ldr(dbgi, block, be_transform_node(base), new_mem,
+		                          mode, NULL, 0, offset, false);
 	}
 	set_irn_pinned(new_load, get_irn_pinned(node));
 
@@ -910,18 +1068,27 @@ static ir_node *gen_Store(ir_node *node)
 		panic("unaligned Stores not supported yet");
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			new_store = new_bd_arm_Stf(dbgi, block, new_ptr, new_val,
 			                           new_mem, mode, NULL, 0, 0, false);
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			if (vfp_is_double(mode)) {
+				new_store = new_bd_arm_Vstr_d(dbgi, block, new_ptr, new_val,
+				                              new_mem, mode, NULL, 0, 0, false);
+			} else {
+				new_store = new_bd_arm_Vstr_s(dbgi, block, new_ptr, new_val,
+				                              new_mem, mode, NULL, 0, 0, false);
+			}
 		} else {
 			panic("Softfloat not supported yet");
 		}
 	} else {
 		assert(mode_is_data(mode) && "unsupported mode for Store");
-		new_store = new_bd_arm_Str(dbgi, block, new_ptr, new_val, new_mem, mode,
-		                           NULL, 0, 0, false);
+		long     offset;
+		ir_node *base = match_address(ptr, mode, &offset);
+		new_store = new_bd_arm_Str(dbgi, block, be_transform_node(base),
+		                           new_val, new_mem, mode, NULL, 0, offset,
+		                           false);
 	}
 	set_irn_pinned(new_store, get_irn_pinned(node));
 	return new_store;
@@ -969,10 +1136,15 @@ static ir_node *gen_Cmp(ir_node *node)
 	bool      is_unsigned;
 
 	if (mode_is_float(cmp_mode)) {
-		/* TODO: this is broken... */
 		new_op1 = be_transform_node(op1);
 		new_op2 = be_transform_node(op2);
 
+		if (USE_VFP()) {
+			if (vfp_is_double(cmp_mode))
+				return new_bd_arm_Vcmp_d(dbgi, block, new_op1, new_op2, cmp_mode);
+			return new_bd_arm_Vcmp_s(dbgi, block, new_op1, new_op2, cmp_mode);
+		}
+		/* TODO: this is broken... */
 		return new_bd_arm_Cmfe(dbgi, block, new_op1, new_op2, false);
 	}
 
@@ -998,6 +1170,83 @@ static ir_node *gen_Cond(ir_node *node)
 	return new_bd_arm_B(dbgi, block, flag_node, relation);
 }
 
+/**
+ * Returns how much we gain by executing @p value conditionally: an Add or
+ * Sub only used by the Mux folds into a predicated add/sub, an immediate
+ * into a predicated mov.
+ */
+static int get_mux_operand_score(const ir_node *value)
+{
+	arm_immediate_t imm;
+
+	if ((is_Add(value) || is_Sub(value)) && get_irn_n_edges(value) == 1)
+		return 2;
+	if (try_encode_as_immediate(value, &imm))
+		return 1;
+	return 0;
+}
+
+/**
+ * Transforms a Mux into a predicated mov, add or sub which overwrites the
+ * false value if the condition holds.
+ */
+static ir_node *gen_Mux(ir_node *node)
+{
+	ir_node    *block     = be_transform_node(get_nodes_block(node));
+	dbg_info   *dbgi      = get_irn_dbg_info(node);
+	ir_node    *sel       = get_Mux_sel(node);
+	ir_node    *mux_true  = get_Mux_true(node);
+	ir_node    *mux_false = get_Mux_false(node);
+	ir_relation relation  = get_Cmp_relation(sel);
+	ir_node    *flags     = be_transform_node(sel);
+	ir_node    *new_false;
+	arm_immediate_t imm;
+
+	assert(mode_needs_gp_reg(get_irn_mode(node)));
+	if (get_mux_operand_score(mux_false) > get_mux_operand_score(mux_true)) {
+		ir_node *tmp = mux_true;
+		mux_true  = mux_false;
+		mux_false = tmp;
+		relation  = get_negated_relation(relation);
+	}
+	new_false = be_transform_node(mux_false);
+
+	if (get_mux_operand_score(mux_true) == 2) {
+		ir_node *left  = get_binop_left(mux_true);
+		ir_node *right = get_binop_right(mux_true);
+		ir_node *new_left;
+
+		if (is_Add(mux_true) && !try_encode_as_immediate(right, &imm)
+		    && try_encode_as_immediate(left, &imm)) {
+			ir_node *tmp = left;
+			left  = right;
+			right = tmp;
+		}
+		new_left = be_transform_node(left);
+		if (try_encode_as_immediate(right, &imm)) {
+			if (is_Add(mux_true))
+				return new_bd_arm_AddCC_imm(dbgi, block, flags, new_false,
+				                            new_left, relation, imm.imm_8,
+				                            imm.rot);
+			return new_bd_arm_SubCC_imm(dbgi, block, flags, new_false,
+			                            new_left, relation, imm.imm_8, imm.rot);
+		}
+		ir_node *new_right = be_transform_node(right);
+		if (is_Add(mux_true))
+			return new_bd_arm_AddCC_reg(dbgi, block, flags, new_false,
+			                            new_left, new_right, relation);
+		return new_bd_arm_SubCC_reg(dbgi, block, flags, new_false, new_left,
+		                            new_right, relation);
+	}
+
+	if (try_encode_as_immediate(mux_true, &imm))
+		return new_bd_arm_MovCC_imm(dbgi, block, flags, new_false, relation,
+		                            imm.imm_8, imm.rot);
+	ir_node *new_true = be_transform_node(mux_true);
+	return new_bd_arm_MovCC_reg(dbgi, block, flags, new_false, new_true,
+	                            relation);
+}
+
 enum fpa_imm_mode {
 	FPA_IMM_FLOAT    = 0,
 	FPA_IMM_DOUBLE   = 1,
@@ -1013,12 +1262,15 @@ static ir_node *gen_Const(ir_node *node)
 	dbg_info *dbg = get_irn_dbg_info(node);
 
 	if (mode_is_float(mode)) {
-		if (USE_FPA(isa)) {
+		if (USE_FPA()) {
 			ir_tarval *tv = get_Const_tarval(node);
 			node          = new_bd_arm_fConst(dbg, block, tv);
 			return node;
-		} else if (USE_VFP(isa)) {
-			panic("VFP not supported yet");
+		} else if (USE_VFP()) {
+			ir_tarval *tv = get_Const_tarval(node);
+			if (vfp_is_double(mode))
+				return new_bd_arm_Vconst_d(dbg, block, tv);
+			return new_bd_arm_Vconst_s(dbg, block, tv);
 		} else {
 			panic("Softfloat not supported yet");
 		}
@@ -1033,6 +1285,13 @@ static ir_node *gen_SymConst(ir_node *node)
 	dbg_info  *dbgi   = get_irn_dbg_info(node);
 	ir_node   *new_node;
 
+	if (get_entity_owner(entity) == get_tls_type())
+		panic("thread local storage not implemented for %+F", entity);
+
+	if (USE_MOVW()) {
+		new_node = new_bd_arm_Movw(dbgi, block, entity, 0);
+		return new_bd_arm_Movt(dbgi, block, new_node, entity, 0);
+	}
 	new_node = new_bd_arm_SymConst(dbgi, block, entity, 0);
 	return new_node;
 }
@@ -1040,6 +1299,9 @@ static ir_node *gen_SymConst(ir_node *node)
 static ir_node *ints_to_double(dbg_info *dbgi, ir_node *block, ir_node *node0,
                                ir_node *node1)
 {
+	if (USE_VFP())
+		return new_bd_arm_VmovDRR(dbgi, block, node0, node1);
+
 	/* the good way to do this would be to use the stm (store multiple)
 	 * instructions, since our input is nearly always 2 consecutive 32bit
 	 * registers... */
@@ -1064,6 +1326,9 @@ static ir_node *ints_to_double(dbg_info *dbgi, ir_node *block, ir_node *node0,
 
 static ir_node *int_to_float(dbg_info *dbgi, ir_node *block, ir_node *node)
 {
+	if (USE_VFP())
+		return new_bd_arm_VmovSR(dbgi, block, node);
+
 	ir_graph *irg   = get_Block_irg(block);
 	ir_node  *stack = get_irg_frame(irg);
 	ir_node  *nomem = get_irg_no_mem(irg);
@@ -1080,6 +1345,9 @@ static ir_node *int_to_float(dbg_info *dbgi, ir_node *block, ir_node *node)
 
 static ir_node *float_to_int(dbg_info *dbgi, ir_node *block, ir_node *node)
 {
+	if (USE_VFP())
+		return new_bd_arm_VmovRS(dbgi, block, node);
+
 	ir_graph *irg   = get_Block_irg(block);
 	ir_node  *stack = get_irg_frame(irg);
 	ir_node  *nomem = get_irg_no_mem(irg);
@@ -1097,6 +1365,13 @@ static ir_node *float_to_int(dbg_info *dbgi, ir_node *block, ir_node *node)
 static void double_to_ints(dbg_info *dbgi, ir_node *block, ir_node *node,
                            ir_node **out_value0, ir_node **out_value1)
 {
+	if (USE_VFP()) {
+		ir_node *vmov = new_bd_arm_VmovRRD(dbgi, block, node);
+		*out_value0 = new_r_Proj(vmov, mode_gp, pn_arm_VmovRRD_low);
+		*out_value1 = new_r_Proj(vmov, mode_gp, pn_arm_VmovRRD_high);
+		return;
+	}
+
 	ir_graph *irg   = get_Block_irg(block);
 	ir_node  *stack = get_irg_frame(irg);
 	ir_node  *nomem = get_irg_no_mem(irg);
@@ -1240,6 +1515,14 @@ static ir_node *gen_Proj_Load(ir_node *node)
 			return new_rd_Proj(dbgi, new_load, mode_M, pn_arm_Ldf_M);
 		}
 		break;
+	case iro_arm_Vldr:
+		if (proj == pn_Load_res) {
+			ir_mode *mode = get_Load_mode(load);
+			return new_rd_Proj(dbgi, new_load, mode, pn_arm_Vldr_res);
+		} else if (proj == pn_Load_M) {
+			return new_rd_Proj(dbgi, new_load, mode_M, pn_arm_Vldr_M);
+		}
+		break;
 	default:
 		break;
 	}
@@ -1254,6 +1537,18 @@ static ir_node *gen_Proj_Div(ir_node *node)
 	ir_mode  *mode     = get_irn_mode(node);
 	long     proj      = get_Proj_proj(node);
 
+	if (is_arm_Vdiv(new_pred)) {
+		switch (proj) {
+		case pn_Div_M:
+			return new_rd_Proj(dbgi, new_pred, mode_M, pn_arm_Vdiv_M);
+		case pn_Div_res:
+			return new_rd_Proj(dbgi, new_pred, mode, pn_arm_Vdiv_res);
+		default:
+			break;
+		}
+		panic("Unsupported Proj from Div");
+	}
+
 	switch (proj) {
 	case pn_Div_M:
 		return new_rd_Proj(dbgi, new_pred, mode_M, pn_arm_Dvf_M);
@@ -1309,12 +1604,14 @@ static ir_node *gen_Proj_Proj_Start(ir_node *node)
 		ir_mode *mode  = get_type_mode(param_type);
 		ir_node *value = be_prolog_get_reg_value(abihelper, param->reg0);
 
-		if (mode_is_float(mode)) {
+		if (mode_is_float(mode)
+		    && param->reg0->reg_class == &arm_reg_classes[CLASS_arm_gp]) {
 			ir_node *value1 = NULL;
 
 			if (param->reg1 != NULL) {
 				value1 = be_prolog_get_reg_value(abihelper, param->reg1);
-			} else if (param->entity != NULL) {
+			} else if (get_mode_size_bits(mode) > 32) {
+				/* the upper half was passed on the stack */
 				ir_node *const fp  = get_irg_frame(irg);
 				ir_node *const mem = be_prolog_get_memory(abihelper);
 				ir_node *const ldr = new_bd_arm_Ldr(NULL, new_block, fp, mem, mode_gp, param->entity, 0, 0, true);
@@ -1337,7 +1634,16 @@ static ir_node *gen_Proj_Proj_Start(ir_node *node)
 		ir_node       *load;
 		ir_node       *value;
 
-		if (mode_is_float(mode)) {
+		if (mode_is_float(mode) && USE_VFP()) {
+			if (vfp_is_double(mode)) {
+				load = new_bd_arm_Vldr_d(NULL, new_block, fp, mem, mode,
+				                         param->entity, 0, 0, true);
+			} else {
+				load = new_bd_arm_Vldr_s(NULL, new_block, fp, mem, mode,
+				                         param->entity, 0, 0, true);
+			}
+			value = new_r_Proj(load, mode, pn_arm_Vldr_res);
+		} else if (mode_is_float(mode)) {
 			load  = new_bd_arm_Ldf(NULL, new_block, fp, mem, mode,
 			                       param->entity, 0, 0, true);
 			value = new_r_Proj(load, mode_fp, pn_arm_Ldf_res);
@@ -1353,19 +1659,31 @@ static ir_node *gen_Proj_Proj_Start(ir_node *node)
 }
 
 /**
- * Finds number of output value of a mode_T node which is constrained to
- * a single specific register.
+ * Finds number of output value of a mode_T node which has the register
+ * requirement @p req.
  */
-static int find_out_for_reg(ir_node *node, const arch_register_t *reg)
+static int find_out_for_req(ir_node *node, const arch_register_req_t *req)
 {
 	be_foreach_out(node, o) {
-		const arch_register_req_t *req = arch_get_irn_register_req_out(node, o);
-		if (req == reg->single_req)
+		if (arch_get_irn_register_req_out(node, o) == req)
 			return o;
 	}
 	return -1;
 }
 
+/**
+ * Finds number of the input of @p node which has the register requirement
+ * @p req.
+ */
+static int find_in_for_req(ir_node *node, const arch_register_req_t *req)
+{
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		if (arch_get_irn_register_req_in(node, i) == req)
+			return i;
+	}
+	return -1;
+}
+
 static ir_node *gen_Proj_Proj_Call(ir_node *node)
 {
 	long                  pn            = get_Proj_proj(node);
@@ -1375,20 +1693,39 @@ static ir_node *gen_Proj_Proj_Call(ir_node *node)
 	calling_convention_t *cconv
 		= arm_decide_calling_convention(NULL, function_type);
 	const reg_or_stackslot_t *res = &cconv->results[pn];
-	ir_mode              *mode;
+	ir_mode              *res_mode
+		= get_type_mode(get_method_res_type(function_type, pn));
+	ir_node              *result;
 	int                   regn;
 
-	/* TODO 64bit modes */
-	assert(res->reg0 != NULL && res->reg1 == NULL);
-	regn = find_out_for_reg(new_call, res->reg0);
+	assert(res->reg0 != NULL);
+	regn = find_out_for_req(new_call, res->req0);
 	if (regn < 0) {
 		panic("Internal error in calling convention for return %+F", node);
 	}
-	mode = res->reg0->reg_class->mode;
+
+	if (mode_is_float(res_mode)
+	    && res->reg0->reg_class == &arm_reg_classes[CLASS_arm_gp]) {
+		/* float result returned in integer registers */
+		ir_node *block = get_nodes_block(new_call);
+		ir_node *value = new_r_Proj(new_call, mode_gp, regn);
+		if (res->reg1 != NULL) {
+			int      regn1  = find_out_for_req(new_call, res->reg1->single_req);
+			ir_node *value1 = new_r_Proj(new_call, mode_gp, regn1);
+			result = ints_to_double(NULL, block, value, value1);
+		} else {
+			result = int_to_float(NULL, block, value);
+		}
+	} else {
+		ir_mode *mode = res->reg0->reg_class == &arm_reg_classes[CLASS_arm_vfp]
+			? res_mode : res->reg0->reg_class->mode;
+		assert(res->reg1 == NULL);
+		result = new_r_Proj(new_call, mode, regn);
+	}
 
 	arm_free_calling_convention(cconv);
 
-	return new_r_Proj(new_call, mode, regn);
+	return result;
 }
 
 static ir_node *gen_Proj_Call(ir_node *node)
@@ -1439,7 +1776,12 @@ static ir_node *gen_Unknown(ir_node *node)
 
 	/* just produce a 0 */
 	ir_mode *mode = get_irn_mode(node);
-	if (mode_is_float(mode)) {
+	if (mode_is_float(mode) && USE_VFP()) {
+		ir_tarval *tv = get_mode_null(mode);
+		if (vfp_is_double(mode))
+			return new_bd_arm_Vconst_d(dbgi, new_block, tv);
+		return new_bd_arm_Vconst_s(dbgi, new_block, tv);
+	} else if (mode_is_float(mode)) {
 		ir_tarval *tv     = get_mode_null(mode);
 		ir_node   *fconst = new_bd_arm_fConst(dbgi, new_block, tv);
 		return fconst;
@@ -1450,6 +1792,8 @@ static ir_node *gen_Unknown(ir_node *node)
 	panic("Unexpected Unknown mode");
 }
 
+static ir_type *between_type = NULL;
+
 /**
  * Produces the type which sits between the stack args and the locals on the
  * stack. It will contain the return address and space to store the old base
@@ -1458,8 +1802,6 @@ static ir_node *gen_Unknown(ir_node *node)
  */
 static ir_type *arm_get_between_type(void)
 {
-	static ir_type *between_type = NULL;
-
 	if (between_type == NULL) {
 		between_type = new_type_class(new_id_from_str("arm_between_type"));
 		set_type_size_bytes(between_type, 0);
@@ -1543,8 +1885,26 @@ static ir_node *gen_Start(ir_node *node)
 	for (i = 0; i != ARRAY_SIZE(callee_saves); ++i) {
 		be_prolog_add_reg(abihelper, callee_saves[i], arch_register_req_type_none);
 	}
+	if (USE_VFP()) {
+		for (i = 0; i != ARRAY_SIZE(vfp_callee_saves); ++i) {
+			be_prolog_add_reg(abihelper, vfp_callee_saves[i],
+			                  arch_register_req_type_none);
+		}
+	}
 
 	start = be_prolog_create_start(abihelper, dbgi, new_block);
+	/* the emitter allocates the frame, frame offsets must know about it */
+	be_start_set_setup_stackframe(start, true);
+
+	/* double parameters occupy a VFP register pair */
+	for (i = 0; i < get_method_n_params(function_type); ++i) {
+		const reg_or_stackslot_t *param = &cconv->parameters[i];
+		if (param->req0 == NULL || param->req0->width == 1)
+			continue;
+		int o = find_out_for_req(start, param->reg0->single_req);
+		be_set_constr_out(start, o, param->req0);
+		set_irn_mode(be_prolog_get_reg_value(abihelper, param->reg0), mode_D);
+	}
 	return start;
 }
 
@@ -1570,6 +1930,44 @@ static ir_node *get_stack_pointer_for(ir_node *node)
 	return stack;
 }
 
+/**
+ * Checks whether the Call returned by the Return @p node can be emitted as a
+ * jump after the epilog: all arguments must be passed in registers and the
+ * callee must return its results where we return ours.
+ *
+ * @return the calling convention of the callee, or NULL
+ */
+static calling_convention_t *get_sibling_call(ir_node *node, ir_node **call)
+{
+	if (frame_may_escape)
+		return NULL;
+	*call = be_get_sibling_call(node);
+	if (*call == NULL || be_get_stack_pred(stackorder, node) != *call)
+		return NULL;
+
+	ir_type              *type   = get_Call_type(*call);
+	calling_convention_t *callee = arm_decide_calling_convention(NULL, type);
+	bool                  ok     = callee->param_stack_size == 0;
+	for (size_t p = 0, n = get_method_n_params(type); ok && p < n; ++p) {
+		const reg_or_stackslot_t *param = &callee->parameters[p];
+		ir_mode                  *mode  = get_type_mode(get_method_param_type(type, p));
+
+		/* floats split into integer registers are not handled */
+		ok = param->reg0 != NULL && param->reg1 == NULL
+		  && (!mode_is_float(mode)
+		      || param->reg0->reg_class != &arm_reg_classes[CLASS_arm_gp]);
+	}
+	for (size_t i = 0, n = get_method_n_ress(type); ok && i < n; ++i) {
+		ok = callee->results[i].reg0 == cconv->results[i].reg0
+		  && callee->results[i].reg1 == cconv->results[i].reg1;
+	}
+	if (!ok) {
+		arm_free_calling_convention(callee);
+		return NULL;
+	}
+	return callee;
+}
+
 /**
  * transform a Return node into epilogue code + return statement
  */
@@ -1579,13 +1977,26 @@ static ir_node *gen_Return(ir_node *node)
 	ir_node   *new_block      = be_transform_node(block);
 	dbg_info  *dbgi           = get_irn_dbg_info(node);
 	ir_node   *mem            = get_Return_mem(node);
-	ir_node   *new_mem        = be_transform_node(mem);
 	size_t     n_callee_saves = ARRAY_SIZE(callee_saves);
-	ir_node   *sp_proj        = get_stack_pointer_for(node);
+	ir_node   *sp_proj;
 	size_t     n_res          = get_Return_n_ress(node);
+	ir_node   *sibling        = NULL;
+	ir_node   *new_mem;
 	ir_node   *bereturn;
 	size_t     i;
 
+	/* a sibling call passes its arguments instead of our results and jumps
+	 * to the callee, which returns to our caller */
+	calling_convention_t *callee = get_sibling_call(node, &sibling);
+	if (callee != NULL) {
+		mem     = get_Call_mem(sibling);
+		sp_proj = get_stack_pointer_for(sibling);
+		n_res   = 0;
+	} else {
+		sp_proj = get_stack_pointer_for(node);
+	}
+	new_mem = be_transform_node(mem);
+
 	be_epilog_begin(abihelper);
 	be_epilog_set_memory(abihelper, new_mem);
 	/* connect stack pointer with initial stack pointer. fix_stack phase
@@ -1600,19 +2011,80 @@ static ir_node *gen_Return(ir_node *node)
 		ir_node                  *new_res_value = be_transform_node(res_value);
 		const reg_or_stackslot_t *slot          = &cconv->results[i];
 		const arch_register_t    *reg           = slot->reg0;
+		ir_mode                  *mode          = get_irn_mode(res_value);
+
+		if (mode_is_float(mode)
+		    && reg->reg_class == &arm_reg_classes[CLASS_arm_gp]) {
+			/* float result returned in integer registers */
+			if (slot->reg1 != NULL) {
+				ir_node *value0;
+				ir_node *value1;
+				double_to_ints(dbgi, new_block, new_res_value, &value0,
+				               &value1);
+				be_epilog_add_reg(abihelper, reg, arch_register_req_type_none,
+				                  value0);
+				be_epilog_add_reg(abihelper, slot->reg1,
+				                  arch_register_req_type_none, value1);
+			} else {
+				ir_node *value = float_to_int(dbgi, new_block, new_res_value);
+				be_epilog_add_reg(abihelper, reg, arch_register_req_type_none,
+				                  value);
+			}
+			continue;
+		}
+
 		assert(slot->reg1 == NULL);
 		be_epilog_add_reg(abihelper, reg, arch_register_req_type_none, new_res_value);
 	}
 
+	/* sibling call arguments */
+	size_t const n_args = callee != NULL ? get_Call_n_params(sibling) : 0;
+	for (i = 0; i < n_args; ++i) {
+		ir_node *value     = get_Call_param(sibling, i);
+		ir_node *new_value = be_transform_node(value);
+		be_epilog_add_reg(abihelper, callee->parameters[i].reg0,
+		                  arch_register_req_type_none, new_value);
+	}
+
 	/* connect callee saves with their values at the function begin */
 	for (i = 0; i < n_callee_saves; ++i) {
 		const arch_register_t *reg   = callee_saves[i];
 		ir_node               *value = be_prolog_get_reg_value(abihelper, reg);
 		be_epilog_add_reg(abihelper, reg, arch_register_req_type_none, value);
 	}
+	if (USE_VFP()) {
+		for (i = 0; i < ARRAY_SIZE(vfp_callee_saves); ++i) {
+			const arch_register_t *reg   = vfp_callee_saves[i];
+			ir_node               *value = be_prolog_get_reg_value(abihelper, reg);
+			be_epilog_add_reg(abihelper, reg, arch_register_req_type_none, value);
+		}
+	}
 
 	/* epilog code: an incsp */
 	bereturn = be_epilog_create_return(abihelper, dbgi, new_block);
+	be_return_set_destroy_stackframe(bereturn, true);
+
+	/* double results occupy a VFP register pair */
+	for (i = 0; i < n_res; ++i) {
+		const reg_or_stackslot_t *slot = &cconv->results[i];
+		if (slot->req0->width == 1)
+			continue;
+		int in = find_in_for_req(bereturn, slot->reg0->single_req);
+		be_set_constr_in(bereturn, in, slot->req0);
+	}
+
+	if (callee != NULL) {
+		for (i = 0; i < n_args; ++i) {
+			const reg_or_stackslot_t *param = &callee->parameters[i];
+			if (param->req0->width == 1)
+				continue;
+			int in = find_in_for_req(bereturn, param->reg0->single_req);
+			be_set_constr_in(bereturn, in, param->req0);
+		}
+		ir_entity *entity = get_SymConst_entity(get_Call_ptr(sibling));
+		be_Return_set_tail_call(bereturn, entity);
+		arm_free_calling_convention(callee);
+	}
 	return bereturn;
 }
 
@@ -1666,7 +2138,8 @@ static ir_node *gen_Call(ir_node *node)
 		ir_mode                  *mode       = get_type_mode(param_type);
 		ir_node                  *str;
 
-		if (mode_is_float(mode) && param->reg0 != NULL) {
+		if (mode_is_float(mode) && param->reg0 != NULL
+		    && param->reg0->reg_class == &arm_reg_classes[CLASS_arm_gp]) {
 			unsigned size_bits = get_mode_size_bits(mode);
 			if (size_bits == 64) {
 				double_to_ints(dbgi, new_block, new_value, &new_value,
@@ -1680,7 +2153,7 @@ static ir_node *gen_Call(ir_node *node)
 		/* put value into registers */
 		if (param->reg0 != NULL) {
 			in[in_arity]     = new_value;
-			in_req[in_arity] = param->reg0->single_req;
+			in_req[in_arity] = param->req0;
 			++in_arity;
 			if (new_value1 == NULL)
 				continue;
@@ -1705,7 +2178,17 @@ static ir_node *gen_Call(ir_node *node)
 			incsp = be_new_IncSP(sp_reg, new_block, new_frame,
 								 cconv->param_stack_size, 1);
 		}
-		if (mode_is_float(mode)) {
+		if (mode_is_float(mode) && USE_VFP()) {
+			if (vfp_is_double(mode)) {
+				str = new_bd_arm_Vstr_d(dbgi, new_block, incsp, new_value,
+				                        new_mem, mode, NULL, 0, param->offset,
+				                        true);
+			} else {
+				str = new_bd_arm_Vstr_s(dbgi, new_block, incsp, new_value,
+				                        new_mem, mode, NULL, 0, param->offset,
+				                        true);
+			}
+		} else if (mode_is_float(mode)) {
 			str = new_bd_arm_Stf(dbgi, new_block, incsp, new_value, new_mem,
 			                     mode, NULL, 0, param->offset, true);
 		} else {
@@ -1738,8 +2221,27 @@ static ir_node *gen_Call(ir_node *node)
 	/* outputs:
 	 *  - memory
 	 *  - caller saves
+	 *  - VFP caller saves, a double result occupies a register pair
 	 */
-	out_arity = 1 + n_caller_saves;
+	const arch_register_req_t *vfp_out_reqs[ARRAY_SIZE(vfp_caller_saves)];
+	size_t n_vfp_outs = 0;
+	if (USE_VFP()) {
+		size_t n_ress = get_method_n_ress(type);
+		for (o = 0; o < ARRAY_SIZE(vfp_caller_saves); ++o)
+			vfp_out_reqs[o] = vfp_caller_saves[o]->single_req;
+		for (o = 0; o < n_ress; ++o) {
+			const reg_or_stackslot_t *result = &cconv->results[o];
+			if (result->req0->width == 1)
+				continue;
+			vfp_out_reqs[result->reg0->index]     = result->req0;
+			vfp_out_reqs[result->reg0->index + 1] = NULL;
+		}
+		for (o = 0; o < ARRAY_SIZE(vfp_caller_saves); ++o) {
+			if (vfp_out_reqs[o] != NULL)
+				++n_vfp_outs;
+		}
+	}
+	out_arity = 1 + n_caller_saves + n_vfp_outs;
 
 	if (entity != NULL) {
 		/* TODO: use a generic symconst matcher here
@@ -1775,6 +2277,13 @@ static ir_node *gen_Call(ir_node *node)
 		const arch_register_t *reg = caller_saves[o];
 		arch_set_irn_register_req_out(res, o+1, reg->single_req);
 	}
+	if (n_vfp_outs > 0) {
+		size_t out = 1 + n_caller_saves;
+		for (o = 0; o < ARRAY_SIZE(vfp_caller_saves); ++o) {
+			if (vfp_out_reqs[o] != NULL)
+				arch_set_irn_register_req_out(res, out++, vfp_out_reqs[o]);
+		}
+	}
 
 	/* copy pinned attribute */
 	set_irn_pinned(res, get_irn_pinned(node));
@@ -1808,6 +2317,9 @@ static ir_node *gen_Phi(ir_node *node)
 		assert(get_mode_size_bits(mode) <= 32);
 		/* all integer operations are on 32bit registers now */
 		req  = arm_reg_classes[CLASS_arm_gp].class_req;
+	} else if (mode_is_float(mode) && USE_VFP()) {
+		req = vfp_is_double(mode) ? &vfp_double_req
+		                          : arm_reg_classes[CLASS_arm_vfp].class_req;
 	} else {
 		req = arch_no_register_req;
 	}
@@ -1836,6 +2348,7 @@ static void arm_register_transformers(void)
 	be_set_transform_function(op_Load,     gen_Load);
 	be_set_transform_function(op_Minus,    gen_Minus);
 	be_set_transform_function(op_Mul,      gen_Mul);
+	be_set_transform_function(op_Mux,      gen_Mux);
 	be_set_transform_function(op_Not,      gen_Not);
 	be_set_transform_function(op_Or,       gen_Or);
 	be_set_transform_function(op_Phi,      gen_Phi);
@@ -1898,7 +2411,6 @@ void arm_transform_graph(ir_graph *irg)
 
 	static int imm_initialized = 0;
 	ir_entity *entity          = get_irg_entity(irg);
-	const arch_env_t *arch_env = be_get_irg_arch_env(irg);
 	ir_type   *frame_type;
 
 	mode_gp = mode_Iu;
@@ -1910,17 +2422,21 @@ void arm_transform_graph(ir_graph *irg)
 	}
 	arm_register_transformers();
 
-	isa = (arm_isa_t*) arch_env;
-
 	node_to_stack = pmap_create();
 
 	assert(abihelper == NULL);
 	abihelper = be_abihelper_prepare(irg);
 	stackorder = be_collect_stacknodes(irg);
+	frame_may_escape = be_frame_may_escape(irg);
 	assert(cconv == NULL);
 	cconv = arm_decide_calling_convention(irg, get_entity_type(entity));
 	create_stacklayout(irg);
 
+	/* layout the frame while its entities are still accessed by Sels */
+	frame_type = get_irg_frame_type(irg);
+	if (get_type_state(frame_type) == layout_undefined)
+		opt_frame_share_slots(irg);
+
 	be_transform_graph(irg, NULL);
 
 	be_abihelper_finish(abihelper);
@@ -1946,3 +2462,8 @@ void arm_init_transform(void)
 {
 	FIRM_DBG_REGISTER(dbg, "firm.be.arm.transform");
 }
+
+void arm_finish_transform(void)
+{
+	between_type = NULL;
+}
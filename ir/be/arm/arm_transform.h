@@ -18,4 +18,9 @@ void arm_transform_graph(ir_graph *irg);
 
 void arm_init_transform(void);
 
+/**
+ * Forget the between type, it vanishes with the current program.
+ */
+void arm_finish_transform(void);
+
 #endif
@@ -47,6 +47,15 @@
 #include "arm_optimize.h"
 #include "arm_emitter.h"
 #include "arm_map_regs.h"
+#include "arm_cconv.h"
+
+arm_codegen_config_t arm_cg_config = {
+	ARM_ARCH_V5TE,    /* architecture */
+	ARM_FPU_ARCH_FPE, /* FPU architecture */
+	false,            /* pass floating point values in integer registers */
+};
+
+static int use_hard_float = false;
 
 static ir_entity *arm_get_frame_entity(const ir_node *irn)
 {
@@ -134,7 +143,7 @@ static void arm_collect_frame_entity_nodes(ir_node *node, void *data)
 		return;
 	}
 
-	if (!is_arm_Ldf(node) && !is_arm_Ldr(node))
+	if (!is_arm_Ldf(node) && !is_arm_Ldr(node) && !is_arm_Vldr(node))
 		return;
 
 	attr   = get_arm_load_store_attr_const(node);
@@ -166,16 +175,26 @@ static void transform_Reload(ir_node *node)
 	ir_node   *mem    = get_irn_n(node, n_be_Reload_mem);
 	ir_mode   *mode   = get_irn_mode(node);
 	ir_entity *entity = be_get_frame_entity(node);
-	const arch_register_t *reg;
+	const arch_register_t *reg = arch_get_irn_register(node);
 	ir_node   *proj;
 	ir_node   *load;
 
-	load = new_bd_arm_Ldr(dbgi, block, ptr, mem, mode, entity, false, 0, true);
+	if (reg->reg_class == &arm_reg_classes[CLASS_arm_vfp]) {
+		if (get_mode_size_bits(mode) == 64) {
+			load = new_bd_arm_Vldr_d(dbgi, block, ptr, mem, mode, entity,
+			                         false, 0, true);
+		} else {
+			load = new_bd_arm_Vldr_s(dbgi, block, ptr, mem, mode, entity,
+			                         false, 0, true);
+		}
+		proj = new_rd_Proj(dbgi, load, mode, pn_arm_Vldr_res);
+	} else {
+		load = new_bd_arm_Ldr(dbgi, block, ptr, mem, mode, entity, false, 0,
+		                      true);
+		proj = new_rd_Proj(dbgi, load, mode, pn_arm_Ldr_res);
+	}
 	sched_replace(node, load);
 
-	proj = new_rd_Proj(dbgi, load, mode, pn_arm_Ldr_res);
-
-	reg = arch_get_irn_register(node);
 	arch_set_irn_register(proj, reg);
 
 	exchange(node, proj);
@@ -191,10 +210,21 @@ static void transform_Spill(ir_node *node)
 	ir_node   *val    = get_irn_n(node, n_be_Spill_val);
 	ir_mode   *mode   = get_irn_mode(val);
 	ir_entity *entity = be_get_frame_entity(node);
+	const arch_register_t *reg = arch_get_irn_register(val);
 	ir_node   *store;
 
-	store = new_bd_arm_Str(dbgi, block, ptr, val, mem, mode, entity, false, 0,
-	                       true);
+	if (reg->reg_class == &arm_reg_classes[CLASS_arm_vfp]) {
+		if (get_mode_size_bits(mode) == 64) {
+			store = new_bd_arm_Vstr_d(dbgi, block, ptr, val, mem, mode, entity,
+			                          false, 0, true);
+		} else {
+			store = new_bd_arm_Vstr_s(dbgi, block, ptr, val, mem, mode, entity,
+			                          false, 0, true);
+		}
+	} else {
+		store = new_bd_arm_Str(dbgi, block, ptr, val, mem, mode, entity, false,
+		                       0, true);
+	}
 	sched_replace(node, store);
 
 	exchange(node, store);
@@ -238,7 +268,8 @@ static void arm_emit(ir_graph *irg)
 
 static void arm_before_ra(ir_graph *irg)
 {
-	be_sched_fix_flags(irg, &arm_reg_classes[CLASS_arm_flags], NULL, NULL);
+	be_sched_fix_flags(irg, &arm_reg_classes[CLASS_arm_flags], NULL, NULL,
+	                   NULL);
 }
 
 static ir_entity *divsi3;
@@ -325,19 +356,26 @@ static arm_isa_t arm_isa_template = {
 		2,                       /* power of two stack alignment for calls, 2^2 == 4 */
 		7,                       /* spill costs */
 		5,                       /* reload costs */
+		NULL,                    /* machine model of the scheduler */
+		false,                   /* no JIT support */
 	},
-	ARM_FPU_ARCH_FPE,          /* FPU architecture */
 };
 
 static void arm_init(void)
 {
 	arm_register_init();
+	arm_cconv_init();
 
 	arm_create_opcodes(&arm_irn_ops);
 }
 
 static void arm_finish(void)
 {
+	divsi3  = NULL;
+	udivsi3 = NULL;
+	modsi3  = NULL;
+	umodsi3 = NULL;
+	arm_finish_transform();
 	arm_free_opcodes();
 }
 
@@ -346,6 +384,8 @@ static arch_env_t *arm_begin_codegeneration(void)
 	arm_isa_t *isa = XMALLOC(arm_isa_t);
 	*isa = arm_isa_template;
 
+	arm_cg_config.hard_float = use_hard_float;
+
 	be_gas_emit_types = false;
 
 	return &isa->base;
@@ -360,16 +400,29 @@ static void arm_end_codegeneration(void *self)
 }
 
 /**
- * Allows or disallows the creation of Psi nodes for the given Phi nodes.
+ * Allows or disallows the creation of Mux nodes for the given Phi nodes.
+ * We can execute a mov, add or sub conditionally on the flags of an integer
+ * compare, which is always cheaper than a branch around it.
  * @return 1 if allowed, 0 otherwise
  */
 static int arm_is_mux_allowed(ir_node *sel, ir_node *mux_false,
                               ir_node *mux_true)
 {
-	(void) sel;
+	ir_mode *mode = get_irn_mode(mux_true);
+	ir_mode *cmp_mode;
 	(void) mux_false;
-	(void) mux_true;
-	return false;
+
+	if (!mode_is_int(mode) && !mode_is_reference(mode))
+		return false;
+	if (get_mode_size_bits(mode) > 32)
+		return false;
+	if (!is_Cmp(sel))
+		return false;
+	/* the flags of a float compare need an extra vmrs, keep the branch */
+	cmp_mode = get_irn_mode(get_Cmp_left(sel));
+	if (!mode_is_int(cmp_mode) && !mode_is_reference(cmp_mode))
+		return false;
+	return get_mode_size_bits(cmp_mode) <= 32;
 }
 
 static int arm_is_valid_clobber(const char *clobber)
@@ -384,7 +437,7 @@ static void arm_lower_for_target(void)
 	size_t i, n_irgs = get_irp_n_irgs();
 
 	/* lower compound param handling */
-	lower_calls_with_compounds(LF_RETURN_HIDDEN);
+	lower_calls_with_compounds(LF_RETURN_HIDDEN, arm_lower_aggregate);
 
 	for (i = 0; i < n_irgs; ++i) {
 		ir_graph *irg = get_irp_irg(i);
@@ -415,7 +468,7 @@ static const backend_params *arm_get_libfirm_params(void)
 		32,   /* SMUL & UMUL available for 32 bit */
 	};
 	static backend_params p = {
-		1,     /* big endian */
+		1,     /* big endian (set below) */
 		1,     /* modulo shift efficient */
 		0,     /* non-modulo shift not efficient */
 		0,     /* PIC code not supported */
@@ -429,12 +482,33 @@ static const backend_params *arm_get_libfirm_params(void)
 		0,     /* no trampoline support: size 0 */
 		0,     /* no trampoline support: align 0 */
 		NULL,  /* no trampoline support: no trampoline builder */
-		4      /* alignment of stack parameter */
+		4,     /* alignment of stack parameter */
+		0,     /* issue width: unknown */
+		0      /* branch mispredict penalty: unknown */
 	};
 
+	/* FPA stores the most significant word of a double first, VFP uses the
+	 * natural little endian layout */
+	p.byte_order_big_endian = !USE_VFP();
 	return &p;
 }
 
+/* supported architectures. */
+static const lc_opt_enum_int_items_t arm_arch_items[] = {
+	{ "armv4",   ARM_ARCH_V4 },
+	{ "armv4t",  ARM_ARCH_V4T },
+	{ "armv5t",  ARM_ARCH_V5T },
+	{ "armv5te", ARM_ARCH_V5TE },
+	{ "armv6",   ARM_ARCH_V6 },
+	{ "armv6t2", ARM_ARCH_V6T2 },
+	{ "armv7",   ARM_ARCH_V7 },
+	{ NULL,      0 }
+};
+
+static lc_opt_enum_int_var_t arch_var = {
+	&arm_cg_config.arch, arm_arch_items
+};
+
 /* fpu set architectures. */
 static const lc_opt_enum_int_items_t arm_fpu_items[] = {
 	{ "softfloat", ARM_FPU_ARCH_SOFTFLOAT },
@@ -443,15 +517,18 @@ static const lc_opt_enum_int_items_t arm_fpu_items[] = {
 	{ "vfp1xd",    ARM_FPU_ARCH_VFP_V1xD },
 	{ "vfp1",      ARM_FPU_ARCH_VFP_V1 },
 	{ "vfp2",      ARM_FPU_ARCH_VFP_V2 },
+	{ "vfp3",      ARM_FPU_ARCH_VFP_V3 },
 	{ NULL,        0 }
 };
 
 static lc_opt_enum_int_var_t arch_fpu_var = {
-	&arm_isa_template.fpu_arch, arm_fpu_items
+	&arm_cg_config.fpu_arch, arm_fpu_items
 };
 
 static const lc_opt_table_entry_t arm_options[] = {
+	LC_OPT_ENT_ENUM_INT("arch",      "select the architecture", &arch_var),
 	LC_OPT_ENT_ENUM_INT("fpunit",    "select the floating point unit", &arch_fpu_var),
+	LC_OPT_ENT_BOOL    ("hard-float", "pass floating point values in VFP registers", &use_hard_float),
 	LC_OPT_LAST
 };
 
@@ -31,6 +31,9 @@ enum arm_cpu_extensions {
 	ARM_EXT_V5ExP = 0x00000200,  /**< DSP core set. */
 	ARM_EXT_V5E   = 0x00000400,  /**< DSP Double transfers. */
 	ARM_EXT_V5J   = 0x00000800,  /**< Jazelle extension.   */
+	ARM_EXT_V6    = 0x00001000,  /**< ARMv6 core set. */
+	ARM_EXT_V6T2  = 0x00002000,  /**< Thumb-2, movw and movt. */
+	ARM_EXT_V7    = 0x00004000,  /**< ARMv7 core set. */
 
 	/* Co-processor space extensions.  */
 	ARM_CEXT_XSCALE   = 0x00800000, /**< Allow MIA etc. */
@@ -62,6 +65,9 @@ enum arm_architectures {
 	ARM_ARCH_V5TExP = ARM_ARCH_V5T | ARM_EXT_V5ExP,
 	ARM_ARCH_V5TE   = ARM_ARCH_V5TExP | ARM_EXT_V5E,
 	ARM_ARCH_V5TEJ  = ARM_ARCH_V5TE | ARM_EXT_V5J,
+	ARM_ARCH_V6     = ARM_ARCH_V5TEJ | ARM_EXT_V6,
+	ARM_ARCH_V6T2   = ARM_ARCH_V6 | ARM_EXT_V6T2,
+	ARM_ARCH_V7     = ARM_ARCH_V6T2 | ARM_EXT_V7,
 
 	/* Processors with specific extensions in the co-processor space.  */
 	ARM_ARCH_XSCALE = ARM_ARCH_V5TE | ARM_CEXT_XSCALE,
@@ -78,6 +84,7 @@ enum arm_fp_architectures {
 	ARM_FPU_VFP_EXT_V1xD   = 0x08000000, /**< Base VFP instruction set. */
 	ARM_FPU_VFP_EXT_V1     = 0x04000000, /**< Double-precision insns. */
 	ARM_FPU_VFP_EXT_V2     = 0x02000000, /**< ARM10E VFPr1. */
+	ARM_FPU_VFP_EXT_V3     = 0x00800000, /**< VFPv3 constant loads. */
 
 	ARM_FPU_SOFTFLOAT      = 0x01000000, /**< soft float library */
 	ARM_FPU_NONE           = 0,
@@ -89,17 +96,27 @@ enum arm_fp_architectures {
 	ARM_FPU_ARCH_VFP_V1xD  = ARM_FPU_VFP_EXT_V1xD | ARM_FPU_VFP_EXT_NONE,
 	ARM_FPU_ARCH_VFP_V1    = ARM_FPU_ARCH_VFP_V1xD | ARM_FPU_VFP_EXT_V1,
 	ARM_FPU_ARCH_VFP_V2    = ARM_FPU_ARCH_VFP_V1 | ARM_FPU_VFP_EXT_V2,
+	ARM_FPU_ARCH_VFP_V3    = ARM_FPU_ARCH_VFP_V2 | ARM_FPU_VFP_EXT_V3,
 
 	ARM_FPU_ARCH_SOFTFLOAT = ARM_FPU_SOFTFLOAT,
 
-	ARM_FPU_MASK           = 0x7f000000,
+	ARM_FPU_MASK           = 0x7f800000,
 };
 
 /** Returns non-zero if FPA instructions should be issued. */
-#define USE_FPA(isa)     ((isa)->fpu_arch & ARM_FPU_FPA_EXT_V1)
+#define USE_FPA()        (arm_cg_config.fpu_arch & ARM_FPU_FPA_EXT_V1)
 
 /** Returns non-zero if VFP instructions should be issued. */
-#define USE_VFP(isa)     ((isa)->fpu_arch & ARM_FPU_VFP_EXT_V1xD)
+#define USE_VFP()        (arm_cg_config.fpu_arch & ARM_FPU_VFP_EXT_V1xD)
+
+/** Returns non-zero if the VFP unit supports double precision. */
+#define USE_VFP_DOUBLE() (arm_cg_config.fpu_arch & ARM_FPU_VFP_EXT_V1)
+
+/** Returns non-zero if VFPv3 instructions should be issued. */
+#define USE_VFP_V3()     (arm_cg_config.fpu_arch & ARM_FPU_VFP_EXT_V3)
+
+/** Returns non-zero if 16 bit immediates can be moved with movw and movt. */
+#define USE_MOVW()       (arm_cg_config.arch & ARM_EXT_V6T2)
 
 /** Types of processor to generate code for. */
 enum arm_processor_types {
@@ -116,9 +133,15 @@ enum arm_processor_types {
 	ARM_STRONG = ARM_ARCH_V4,
 };
 
+typedef struct arm_codegen_config_t {
+	int  arch;       /**< architecture */
+	int  fpu_arch;   /**< FPU architecture */
+	bool hard_float; /**< pass floating point values in VFP registers */
+} arm_codegen_config_t;
+extern arm_codegen_config_t arm_cg_config;
+
 struct arm_isa_t {
 	arch_env_t     base;      /**< must be derived from arch_env_t */
-	int            fpu_arch;      /**< FPU architecture */
 };
 
 #endif
@@ -42,12 +42,19 @@ struct be_options_t {
 	int  timing;               /**< time the backend phases */
 	int  opt_profile_generate; /**< instrument code for profiling */
 	int  opt_profile_use;      /**< use existing profile data */
+	int  opt_profile_threads;  /**< use thread local profile counters */
 	int  omit_fp;              /**< try to omit the frame pointer */
 	int  pic;                  /**< create position independent code */
 	int  do_verify;            /**< backend verify option */
+	int  verify_sample;        /**< verify only about every n-th graph */
 	char ilp_server[128];      /**< the ilp server name */
 	char ilp_solver[128];      /**< the ilp solver name */
 	int  verbose_asm;          /**< dump verbose assembler */
+	int  drop_irgs;            /**< free graph bodies after emitting them */
+	char sample_profile[256];  /**< AutoFDO sample profile to use */
+	int  fp_contract;          /**< fuse floating point multiply and add */
+	int  fast;                 /**< use the low latency backend pipeline */
+	int  time_counters;        /**< count hardware events in the timers */
 };
 extern be_options_t be_options;
 
@@ -73,6 +80,12 @@ unsigned be_get_n_allocatable_regs(const ir_graph *irg,
 void firm_be_init(void);
 void firm_be_finish(void);
 
+/**
+ * Finishes the target isa, dropping the state it keeps for the current
+ * program. The isa is initialized again when it is used next.
+ */
+void firm_be_reset(void);
+
 extern int be_timing;
 
 typedef enum {
@@ -104,9 +117,13 @@ typedef enum {
 ENUM_COUNTABLE(be_timer_id_t)
 extern ir_timer_t *be_timers[T_LAST+1];
 
+/** Returns the name of the backend timer @p id. */
+const char *be_get_timer_name(be_timer_id_t id);
+
 static inline void be_timer_push(be_timer_id_t id)
 {
 	assert(id <= T_LAST);
+	ir_pass_stat_begin(NULL, be_get_timer_name(id));
 	if (!be_timing)
 		return;
 	ir_timer_push(be_timers[id]);
@@ -115,6 +132,7 @@ static inline void be_timer_push(be_timer_id_t id)
 static inline void be_timer_pop(be_timer_id_t id)
 {
 	assert(id <= T_LAST);
+	ir_pass_stat_end();
 	if (!be_timing)
 		return;
 	ir_timer_pop(be_timers[id]);
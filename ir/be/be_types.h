@@ -43,6 +43,7 @@ typedef enum arch_irn_flags_t {
 ENUM_BITSET(arch_irn_flags_t)
 
 typedef struct be_lv_t                  be_lv_t;
+typedef struct be_lv_cls_t              be_lv_cls_t;
 typedef union  be_lv_info_t             be_lv_info_t;
 
 typedef struct be_abi_call_flags_bits_t be_abi_call_flags_bits_t;
@@ -57,6 +58,7 @@ typedef struct sched_info_t             sched_info_t;
 typedef struct reg_out_info_t           reg_out_info_t;
 typedef struct be_ifg_t                 be_ifg_t;
 typedef struct copy_opt_t               copy_opt_t;
+typedef struct be_machine_t             be_machine_t;
 
 typedef struct be_main_env_t be_main_env_t;
 typedef struct be_options_t  be_options_t;
@@ -26,6 +26,7 @@
 #include "raw_bitset.h"
 #include "error.h"
 #include "pset_new.h"
+#include "opt_frame.h"
 
 #include "be.h"
 #include "beabi.h"
@@ -78,6 +79,8 @@ struct be_abi_irg_t {
 	                              their Projs to the RegParams node. */
 	pmap          *keep_map; /**< mapping blocks to keep nodes. */
 	ir_node      **calls;    /**< flexible array containing all be_Call nodes */
+	pmap          *sibling_calls; /**< maps Calls which are turned into jumps
+	                                   to the ABI of their callee. */
 };
 
 static ir_heights_t *ir_heights;
@@ -865,6 +868,10 @@ static void link_ops_in_block_walker(ir_node *irn, void *data)
 	be_abi_irg_t *env  = (be_abi_irg_t*)data;
 	unsigned      code = get_irn_opcode(irn);
 
+	/* sibling calls are emitted by their Return */
+	if (code == iro_Call && pmap_contains(env->sibling_calls, irn))
+		return;
+
 	if (code == iro_Call || code == iro_Alloc || code == iro_Free) {
 		ir_node *bl       = get_nodes_block(irn);
 		void *save        = get_irn_link(bl);
@@ -1060,6 +1067,86 @@ static void reg_map_to_arr(arch_register_t const **const res,
 	qsort(res, n, sizeof(res[0]), cmp_regs);
 }
 
+/**
+ * Checks whether the call returned by the Return @p ret can be turned into a
+ * jump: The callee must take all its arguments in registers and return its
+ * results where we return ours, so the jump can happen after our stack frame
+ * was destroyed.
+ *
+ * @return the ABI description of the callee, or NULL
+ */
+static be_abi_call_t *get_sibling_call_abi(be_abi_irg_t *const env,
+                                           ir_node *const ret)
+{
+	ir_node *const call = be_get_sibling_call(ret);
+	if (call == NULL)
+		return NULL;
+
+	const arch_env_t *const arch_env = be_get_irg_arch_env(get_irn_irg(ret));
+	ir_type          *const call_tp  = get_Call_type(call);
+	be_abi_call_t    *const abi      = be_abi_call_new();
+	arch_env_get_call_abi(arch_env, call_tp, abi);
+
+	/* the stack argument area of the callee would overlap our return address
+	 * and the callee would have to pop something we pushed */
+	bool ok = abi->pop == 0 && env->call->pop == 0;
+	for (size_t p = 0, n = get_method_n_params(call_tp); ok && p < n; ++p) {
+		be_abi_call_arg_t const *const arg = get_call_arg(abi, 0, p, 0);
+		/* callee save registers are restored before the jump */
+		ok = arg->in_reg && !arch_register_is_callee_save(arch_env, arg->reg);
+	}
+	for (size_t i = 0, n = get_method_n_ress(call_tp); ok && i < n; ++i) {
+		be_abi_call_arg_t const *const res  = get_call_arg(abi,       1, i, 0);
+		be_abi_call_arg_t const *const ours = get_call_arg(env->call, 1, i, 1);
+		ok = res->in_reg && ours->in_reg && res->reg == ours->reg;
+	}
+	if (!ok) {
+		be_abi_call_free(abi);
+		return NULL;
+	}
+	return abi;
+}
+
+/**
+ * Collects all Calls in the graph which can be turned into jumps by their
+ * Return.
+ */
+static void find_sibling_calls(ir_graph *const irg, be_abi_irg_t *const env)
+{
+	if (!env->call->flags.try_tail_calls || be_frame_may_escape(irg))
+		return;
+
+	ir_node *const end = get_irg_end_block(irg);
+	for (int i = 0, n = get_Block_n_cfgpreds(end); i < n; ++i) {
+		ir_node *const ret = get_Block_cfgpred(end, i);
+		if (!is_Return(ret))
+			continue;
+
+		be_abi_call_t *const abi = get_sibling_call_abi(env, ret);
+		if (abi == NULL)
+			continue;
+
+		ir_node *const call = get_Proj_pred(get_Return_mem(ret));
+		DBG((dbg, LEVEL_2, "\tturning %+F into a sibling call\n", call));
+		pmap_insert(env->sibling_calls, call, abi);
+	}
+}
+
+/**
+ * Removes a sibling call after its Return has been replaced.
+ */
+static void kill_sibling_call(ir_node *const call)
+{
+	foreach_out_edge_safe(call, edge) {
+		ir_node *const proj = get_edge_src_irn(edge);
+		foreach_out_edge_safe(proj, res_edge) {
+			kill_node(get_edge_src_irn(res_edge));
+		}
+		kill_node(proj);
+	}
+	kill_node(call);
+}
+
 /**
  * Creates a be_Return for a Return node.
  *
@@ -1086,9 +1173,22 @@ static ir_node *create_be_return(be_abi_irg_t *const env, ir_node *const irn)
 		remove_End_keepalive(get_irg_end(irg), keep);
 	}
 
+	/* A sibling call passes its arguments instead of our results. */
+	ir_node       *const mem      = get_Return_mem(irn);
+	ir_node       *const sibling  = is_Proj(mem) ? get_Proj_pred(mem) : NULL;
+	be_abi_call_t *const sib_abi
+		= pmap_get(be_abi_call_t, env->sibling_calls, sibling);
+	pmap                *reg_map  = pmap_create();
+	int                  n_res    = get_Return_n_ress(irn);
+	if (sib_abi != NULL) {
+		for (int p = 0, n = get_Call_n_params(sibling); p < n; ++p) {
+			be_abi_call_arg_t *arg = get_call_arg(sib_abi, 0, p, 0);
+			pmap_insert(reg_map, (void *) arg->reg, get_Call_param(sibling, p));
+		}
+		n_res = 0;
+	}
+
 	/* Insert results for Return into the register map. */
-	int const n_res   = get_Return_n_ress(irn);
-	pmap     *reg_map = pmap_create();
 	for (int i = 0; i < n_res; ++i) {
 		ir_node *res           = get_Return_res(irn, i);
 		be_abi_call_arg_t *arg = get_call_arg(call, 1, i, 1);
@@ -1115,7 +1215,7 @@ static ir_node *create_be_return(be_abi_irg_t *const env, ir_node *const irn)
 	ir_node **in = ALLOCAN(ir_node*,               in_max);
 	const arch_register_t **regs = ALLOCAN(arch_register_t const*, in_max);
 
-	in[0]   = get_Return_mem(irn);
+	in[0]   = sib_abi != NULL ? get_Call_mem(sibling) : mem;
 	in[1]   = be_abi_reg_map_get(reg_map, arch_env->sp);
 	regs[0] = NULL;
 	regs[1] = arch_env->sp;
@@ -1144,6 +1244,10 @@ static ir_node *create_be_return(be_abi_irg_t *const env, ir_node *const irn)
 	/* The in array for the new back end return is now ready. */
 	dbg_info *const dbgi = get_irn_dbg_info(irn);
 	ir_node  *const ret  = be_new_Return(dbgi, bl, n_res, call->pop, n, in);
+	if (sib_abi != NULL) {
+		ir_node *const ptr = get_Call_ptr(sibling);
+		be_Return_set_tail_call(ret, get_SymConst_entity(ptr));
+	}
 
 	/* Set the register classes of the return's parameter accordingly. */
 	for (int i = 0; i < n; ++i) {
@@ -1244,7 +1348,7 @@ static void modify_irg(ir_graph *const irg, be_abi_irg_t *const env)
 	ir_type *const frame_tp = get_irg_frame_type(irg);
 	/* layout the stackframe now */
 	if (get_type_state(frame_tp) == layout_undefined) {
-		default_layout_compound_type(frame_tp);
+		opt_frame_share_slots(irg);
 	}
 
 	/* align stackframe */
@@ -1430,8 +1534,12 @@ static void modify_irg(ir_graph *const irg, be_abi_irg_t *const env)
 		ir_node *irn = get_Block_cfgpred(end, i);
 
 		if (is_Return(irn)) {
+			ir_node *const mem = get_Return_mem(irn);
 			ir_node *const ret = create_be_return(env, irn);
 			exchange(irn, ret);
+			if (is_Proj(mem)
+			    && pmap_contains(env->sibling_calls, get_Proj_pred(mem)))
+				kill_sibling_call(get_Proj_pred(mem));
 		}
 	}
 
@@ -1507,6 +1615,10 @@ void be_abi_introduce(ir_graph *irg)
 	ir_node *const dummy = new_r_Dummy(irg, arch_env->sp->reg_class->mode);
 	env.init_sp = dummy;
 	env.calls   = NEW_ARR_F(ir_node*, 0);
+	env.sibling_calls = pmap_create();
+
+	/* Turn calls in return position into jumps if possible. */
+	find_sibling_calls(irg, &env);
 
 	/* Lower all call nodes in the IRG. */
 	process_calls(irg, &env);
@@ -1525,6 +1637,12 @@ void be_abi_introduce(ir_graph *irg)
 	/* calls array is not needed anymore */
 	DEL_ARR_F(env.calls);
 
+	pmap_entry *ent;
+	foreach_pmap(env.sibling_calls, ent) {
+		be_abi_call_free((be_abi_call_t*)ent->value);
+	}
+	pmap_destroy(env.sibling_calls);
+
 	/* reroute the stack origin of the calls to the true stack origin. */
 	exchange(dummy, env.init_sp);
 	exchange(old_frame, get_irg_frame(irg));
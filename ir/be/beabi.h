@@ -20,6 +20,8 @@ struct be_abi_call_flags_t {
 	bool try_omit_fp   : 1; /**< Try to omit the frame pointer. */
 	bool call_has_imm  : 1; /**< A call can take the callee's address as an
 	                             immediate. */
+	bool try_tail_calls : 1; /**< The backend can emit a be_Return with a
+	                              tail call entity as a jump. */
 };
 
 struct be_abi_callbacks_t {
@@ -718,3 +718,64 @@ void be_add_parameter_entity_stores(ir_graph *irg)
 		create_stores_for_type(irg, between_type);
 	}
 }
+
+ir_node *be_get_sibling_call(const ir_node *ret)
+{
+	ir_node *const mem = get_Return_mem(ret);
+	if (!is_Proj(mem) || get_Proj_proj(mem) != pn_Call_M
+	    || get_irn_n_edges(mem) != 1)
+		return NULL;
+
+	ir_node *const call = get_Proj_pred(mem);
+	if (!is_Call(call) || get_nodes_block(call) != get_nodes_block(ret)
+	    || ir_throws_exception(call) || !is_SymConst_addr_ent(get_Call_ptr(call)))
+		return NULL;
+
+	ir_type *const call_tp = get_Call_type(call);
+	size_t   const n_res   = get_Return_n_ress(ret);
+	if (get_method_variadicity(call_tp) == variadicity_variadic
+	    || get_method_n_ress(call_tp) != n_res)
+		return NULL;
+
+	/* we must return exactly the results of the call */
+	for (size_t i = 0; i < n_res; ++i) {
+		ir_node *const res = get_Return_res(ret, i);
+		if (!is_Proj(res) || get_Proj_proj(res) != (long)i
+		    || get_irn_n_edges(res) != 1)
+			return NULL;
+		ir_node *const res_tuple = get_Proj_pred(res);
+		if (!is_Proj(res_tuple) || get_Proj_pred(res_tuple) != call)
+			return NULL;
+	}
+	return call;
+}
+
+static void find_frame_users_walker(ir_node *node, void *data)
+{
+	bool *const escapes = (bool*)data;
+
+	switch (get_irn_opcode(node)) {
+	case iro_Alloc:
+	case iro_Free:
+		*escapes = true;
+		break;
+	case iro_Sel:
+		if (get_Sel_ptr(node) == get_irg_frame(get_irn_irg(node)))
+			*escapes = true;
+		break;
+	case iro_Builtin:
+		if (get_Builtin_kind(node) == ir_bk_frame_address
+		    || get_Builtin_kind(node) == ir_bk_return_address)
+			*escapes = true;
+		break;
+	default:
+		break;
+	}
+}
+
+bool be_frame_may_escape(ir_graph *irg)
+{
+	bool escapes = false;
+	irg_walk_graph(irg, NULL, find_frame_users_walker, &escapes);
+	return escapes;
+}
@@ -134,4 +134,21 @@ void be_free_stackorder(be_stackorder_t *env);
  */
 void be_add_parameter_entity_stores(ir_graph *irg);
 
+/**
+ * Returns the Call whose results the Return @p ret passes on unchanged if the
+ * call may be turned into a jump to the callee (sibling call) as far as the
+ * IR is concerned: a direct, non-variadic call in the same block which cannot
+ * throw and whose memory and results are only used by the Return.
+ * The backend still has to check that the calling conventions fit.
+ */
+ir_node *be_get_sibling_call(const ir_node *ret);
+
+/**
+ * Returns true if the stack frame of @p irg might still be referenced after
+ * a sibling call destroyed it. This is the case if the address of a frame
+ * entity is taken or the stack is allocated dynamically.
+ * Must be called while frame entities are still accessed by Sels.
+ */
+bool be_frame_may_escape(ir_graph *irg);
+
 #endif
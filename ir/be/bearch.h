@@ -499,6 +499,10 @@ struct arch_env_t {
 	int                    stack_alignment;  /**< power of 2 stack alignment */
 	int                    spill_cost;       /**< cost for a be_Spill node */
 	int                    reload_cost;      /**< cost for a be_Reload node */
+	const be_machine_t    *machine;          /**< machine model for the
+	                                              scheduler, may be NULL */
+	bool                   supports_jit;     /**< can emit into a JIT
+	                                              buffer */
 };
 
 static inline bool arch_irn_is_ignore(const ir_node *irn)
@@ -22,6 +22,7 @@
 #include "beblocksched.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "array.h"
 #include "pdeq.h"
@@ -32,10 +33,14 @@
 #include "irgraph_t.h"
 #include "irloop.h"
 #include "execfreq.h"
+#include "irprofile.h"
 #include "irdump_t.h"
 #include "irtools.h"
+#include "util.h"
 #include "debug.h"
 #include "beirgmod.h"
+#include "besched.h"
+#include "benode.h"
 #include "bemodule.h"
 #include "be.h"
 #include "error.h"
@@ -44,20 +49,21 @@
 #include "lc_opts_enum.h"
 
 #include "lpp.h"
-#include "lpp_net.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
 typedef enum blocksched_algos_t {
-	BLOCKSCHED_NAIV, BLOCKSCHED_GREEDY, BLOCKSCHED_ILP
+	BLOCKSCHED_NAIV, BLOCKSCHED_GREEDY, BLOCKSCHED_ILP, BLOCKSCHED_EXTTSP
 } blocksched_algos_t;
 
-static int algo = BLOCKSCHED_GREEDY;
+static int  algo       = BLOCKSCHED_GREEDY;
+static int  split_cold = false;
 
 static const lc_opt_enum_int_items_t blockschedalgo_items[] = {
 	{ "naiv",   BLOCKSCHED_NAIV },
 	{ "greedy", BLOCKSCHED_GREEDY },
 	{ "ilp",    BLOCKSCHED_ILP },
+	{ "exttsp", BLOCKSCHED_EXTTSP },
 	{ NULL,     0 }
 };
 
@@ -67,6 +73,7 @@ static lc_opt_enum_int_var_t algo_var = {
 
 static const lc_opt_table_entry_t be_blocksched_options[] = {
 	LC_OPT_ENT_ENUM_INT ("blockscheduler", "the block scheduling algorithm", &algo_var),
+	LC_OPT_ENT_BOOL     ("splitcold",      "move blocks the profile never saw executing into a cold section", &split_cold),
 	LC_OPT_LAST
 };
 
@@ -113,6 +120,23 @@ static blocksched_entry_t* get_blocksched_entry(const ir_node *block)
 	return (blocksched_entry_t*)get_irn_link(block);
 }
 
+/**
+ * Returns the frequency of the control flow edge from predecessor @p pos into
+ * @p block. Profiles give the share of the edge in the block count, else the
+ * frequency of the predecessor block is an approximation.
+ */
+static double get_edge_execfreq(const ir_node *block, int pos)
+{
+	if (ir_profile_has_edge_execcount(block, pos)) {
+		double   freq  = get_block_execfreq(block);
+		uint32_t count = ir_profile_get_block_execcount(block);
+		if (count == 0)
+			return freq;
+		return freq * ir_profile_get_edge_execcount(block, pos) / count;
+	}
+	return get_block_execfreq(get_Block_cfgpred_block(block, pos));
+}
+
 /**
  * Collect cfg frequencies of all edges between blocks.
  * Also determines edge with highest frequency.
@@ -165,10 +189,7 @@ static void collect_egde_frequency(ir_node *block, void *data)
 
 		edge.block = block;
 		for (i = 0; i < arity; ++i) {
-			double  execfreq;
-			ir_node *pred_block = get_Block_cfgpred_block(block, i);
-
-			execfreq = get_block_execfreq(pred_block);
+			double execfreq = get_edge_execfreq(block, i);
 
 			edge.pos              = i;
 			edge.execfreq         = execfreq;
@@ -615,9 +636,8 @@ static void collect_egde_frequency_ilp(ir_node *block, void *data)
 			double     execfreq;
 			int        edgenum;
 			ilp_edge_t *edge;
-			ir_node    *pred_block = get_Block_cfgpred_block(block, i);
 
-			execfreq = get_block_execfreq(pred_block);
+			execfreq = get_edge_execfreq(block, i);
 			edgenum  = add_ilp_edge(block, i, execfreq, env);
 			edge     = &env->ilpedges[edgenum];
 			lpp_set_factor_fast(env->lpp, cst_idx, edge->ilpvar, 1.0);
@@ -654,7 +674,7 @@ static void coalesce_blocks_ilp(blocksched_ilp_env_t *env)
 		lpp_set_factor_fast(env->lpp, entry->out_cst, edge->ilpvar, 1.0);
 	}
 
-	lpp_solve_net(env->lpp, be_options.ilp_server, be_options.ilp_solver);
+	lpp_solve(env->lpp, be_options.ilp_server, be_options.ilp_solver);
 	assert(lpp_is_sol_valid(env->lpp));
 
 	/* Apply results to edges */
@@ -717,6 +737,454 @@ static ir_node **create_block_schedule_ilp(ir_graph *irg)
 	return block_list;
 }
 
+/*
+ *  _____      _       _____ ____  ____
+ * | ____|_  _| |_    |_   _/ ___||  _ \
+ * |  _| \ \/ / __|_____| | \___ \| |_) |
+ * | |___ >  <| ||_____|| |  ___) |  __/
+ * |_____/_/\_\\__|     |_| |____/|_|
+ *
+ * The extended TSP formulation of Newell and Pupyrev: a layout gets a score
+ * for every edge, the full weight of the edge for a fallthrough and a fraction
+ * decreasing with the distance for short forward and backward jumps, which
+ * models instruction cache and fetch locality. Starting with one chain per
+ * block, chains are merged greedily by the highest score gain, trying both
+ * concatenations and inserting one chain into a split of the other.
+ */
+
+/** Estimated code size of an instruction in bytes. */
+#define EXTTSP_INSN_SIZE          4
+#define EXTTSP_FALLTHROUGH_WEIGHT 1.0
+#define EXTTSP_FORWARD_WEIGHT     0.1
+#define EXTTSP_FORWARD_DISTANCE   1024
+#define EXTTSP_BACKWARD_WEIGHT    0.1
+#define EXTTSP_BACKWARD_DISTANCE  640
+/** Chains larger than this are not split when merging. */
+#define EXTTSP_MAX_SPLIT_SIZE     128
+
+typedef struct exttsp_block_t {
+	ir_node  *block;
+	double    freq;
+	unsigned  size;   /**< estimated code size in bytes */
+	unsigned  chain;  /**< the chain containing the block */
+	unsigned  addr;   /**< address in the layout being evaluated */
+	unsigned  stamp;  /**< marks blocks of the layout being evaluated */
+	unsigned *succs;  /**< outgoing edges */
+	unsigned *preds;  /**< incoming edges */
+} exttsp_block_t;
+
+typedef struct exttsp_edge_t {
+	unsigned src;
+	unsigned dst;
+	double   weight;  /**< execution frequency of the edge */
+} exttsp_edge_t;
+
+typedef enum exttsp_merge_kind_t {
+	EXTTSP_MERGE_XY,    /**< chain followed by the other chain */
+	EXTTSP_MERGE_YX,    /**< other chain followed by the chain */
+	EXTTSP_MERGE_X1YX2, /**< other chain inserted into the chain */
+	EXTTSP_MERGE_Y1XY2, /**< chain inserted into the other chain */
+} exttsp_merge_kind_t;
+
+typedef struct exttsp_merge_t {
+	double              gain;  /**< score gain of the merge */
+	unsigned            other; /**< the chain to merge with */
+	unsigned            split; /**< split position for the insertions */
+	exttsp_merge_kind_t kind;
+	bool                valid; /**< false if the merge has to be recomputed */
+} exttsp_merge_t;
+
+typedef struct exttsp_chain_t {
+	unsigned       *blocks; /**< the blocks in layout order */
+	unsigned        size;   /**< code size */
+	double          freq;   /**< sum of the block frequencies */
+	double          score;  /**< score of the chain on its own */
+	unsigned        stamp;  /**< marks neighbours of a chain */
+	bool            dead;   /**< merged into another chain */
+	exttsp_merge_t  best;   /**< best merge with a neighbour */
+} exttsp_chain_t;
+
+typedef struct exttsp_env_t {
+	exttsp_block_t *blocks;
+	exttsp_edge_t  *edges;
+	exttsp_chain_t *chains;
+	unsigned        start;  /**< the chain of the start block */
+	unsigned        stamp;
+} exttsp_env_t;
+
+/** A part of a chain. */
+typedef struct exttsp_piece_t {
+	unsigned const *blocks;
+	unsigned        n;
+} exttsp_piece_t;
+
+static void collect_exttsp_block(ir_node *block, void *data)
+{
+	exttsp_env_t  *env = (exttsp_env_t*)data;
+	exttsp_block_t b;
+	memset(&b, 0, sizeof(b));
+	b.block = block;
+	b.freq  = get_block_execfreq(block);
+	sched_foreach(block, node) {
+		if (!is_Phi(node) && !be_is_Keep(node))
+			b.size += EXTTSP_INSN_SIZE;
+	}
+	b.succs = NEW_ARR_F(unsigned, 0);
+	b.preds = NEW_ARR_F(unsigned, 0);
+	set_irn_link(block, INT_TO_PTR(ARR_LEN(env->blocks)));
+	ARR_APP1(exttsp_block_t, env->blocks, b);
+}
+
+static double exttsp_edge_score(unsigned src_end, unsigned dst, double weight)
+{
+	if (dst == src_end)
+		return weight * EXTTSP_FALLTHROUGH_WEIGHT;
+	if (dst > src_end) {
+		unsigned const dist = dst - src_end;
+		if (dist < EXTTSP_FORWARD_DISTANCE)
+			return weight * EXTTSP_FORWARD_WEIGHT
+			     * (1.0 - (double)dist / EXTTSP_FORWARD_DISTANCE);
+	} else {
+		unsigned const dist = src_end - dst;
+		if (dist < EXTTSP_BACKWARD_DISTANCE)
+			return weight * EXTTSP_BACKWARD_WEIGHT
+			     * (1.0 - (double)dist / EXTTSP_BACKWARD_DISTANCE);
+	}
+	return 0.0;
+}
+
+/**
+ * Computes the score of the edges between the blocks of a layout made of the
+ * given pieces.
+ */
+static double exttsp_score(exttsp_env_t *env, exttsp_piece_t const *pieces,
+                           unsigned n_pieces)
+{
+	unsigned const stamp = ++env->stamp;
+	unsigned       addr  = 0;
+	for (unsigned p = 0; p < n_pieces; ++p) {
+		for (unsigned i = 0; i < pieces[p].n; ++i) {
+			exttsp_block_t *const b = &env->blocks[pieces[p].blocks[i]];
+			b->addr  = addr;
+			b->stamp = stamp;
+			addr    += b->size;
+		}
+	}
+
+	double score = 0.0;
+	for (unsigned p = 0; p < n_pieces; ++p) {
+		for (unsigned i = 0; i < pieces[p].n; ++i) {
+			exttsp_block_t const *const b = &env->blocks[pieces[p].blocks[i]];
+			for (size_t e = 0, n = ARR_LEN(b->succs); e < n; ++e) {
+				exttsp_edge_t  const *const edge = &env->edges[b->succs[e]];
+				exttsp_block_t const *const dst  = &env->blocks[edge->dst];
+				if (dst->stamp != stamp)
+					continue;
+				score += exttsp_edge_score(b->addr + b->size, dst->addr,
+				                           edge->weight);
+			}
+		}
+	}
+	return score;
+}
+
+/**
+ * Fills pieces with the layout of a merge of chains x and y, returns the
+ * number of pieces.
+ */
+static unsigned exttsp_merge_layout(exttsp_env_t *env, unsigned x, unsigned y,
+                                    exttsp_merge_kind_t kind, unsigned split,
+                                    exttsp_piece_t *pieces)
+{
+	unsigned const *const xb = env->chains[x].blocks;
+	unsigned const *const yb = env->chains[y].blocks;
+	unsigned        const xn = ARR_LEN(xb);
+	unsigned        const yn = ARR_LEN(yb);
+	switch (kind) {
+	case EXTTSP_MERGE_XY:
+		pieces[0] = (exttsp_piece_t){ xb, xn };
+		pieces[1] = (exttsp_piece_t){ yb, yn };
+		return 2;
+	case EXTTSP_MERGE_YX:
+		pieces[0] = (exttsp_piece_t){ yb, yn };
+		pieces[1] = (exttsp_piece_t){ xb, xn };
+		return 2;
+	case EXTTSP_MERGE_X1YX2:
+		pieces[0] = (exttsp_piece_t){ xb, split };
+		pieces[1] = (exttsp_piece_t){ yb, yn };
+		pieces[2] = (exttsp_piece_t){ xb + split, xn - split };
+		return 3;
+	case EXTTSP_MERGE_Y1XY2:
+		pieces[0] = (exttsp_piece_t){ yb, split };
+		pieces[1] = (exttsp_piece_t){ xb, xn };
+		pieces[2] = (exttsp_piece_t){ yb + split, yn - split };
+		return 3;
+	}
+	panic("invalid merge kind");
+}
+
+static void exttsp_try_merge(exttsp_env_t *env, unsigned x, unsigned y,
+                             exttsp_merge_kind_t kind, unsigned split,
+                             exttsp_merge_t *best)
+{
+	exttsp_piece_t pieces[3];
+	unsigned const n_pieces = exttsp_merge_layout(env, x, y, kind, split, pieces);
+	double   const gain     = exttsp_score(env, pieces, n_pieces)
+	                        - env->chains[x].score - env->chains[y].score;
+	if (gain > best->gain) {
+		best->gain  = gain;
+		best->other = y;
+		best->split = split;
+		best->kind  = kind;
+	}
+}
+
+/**
+ * Finds the best way to merge chains x and y, keeping the start block first.
+ */
+static void exttsp_compute_merge(exttsp_env_t *env, unsigned x, unsigned y,
+                                 exttsp_merge_t *best)
+{
+	unsigned const xn = ARR_LEN(env->chains[x].blocks);
+	unsigned const yn = ARR_LEN(env->chains[y].blocks);
+	if (y != env->start)
+		exttsp_try_merge(env, x, y, EXTTSP_MERGE_XY, 0, best);
+	if (x != env->start)
+		exttsp_try_merge(env, x, y, EXTTSP_MERGE_YX, 0, best);
+	if (xn <= EXTTSP_MAX_SPLIT_SIZE && y != env->start) {
+		for (unsigned split = 1; split < xn; ++split)
+			exttsp_try_merge(env, x, y, EXTTSP_MERGE_X1YX2, split, best);
+	}
+	if (yn <= EXTTSP_MAX_SPLIT_SIZE && x != env->start) {
+		for (unsigned split = 1; split < yn; ++split)
+			exttsp_try_merge(env, x, y, EXTTSP_MERGE_Y1XY2, split, best);
+	}
+}
+
+static void exttsp_check_neighbour(exttsp_env_t *env, unsigned c,
+                                   unsigned block, unsigned mark,
+                                   exttsp_merge_t *best)
+{
+	unsigned        const other = env->blocks[block].chain;
+	exttsp_chain_t *const chain = &env->chains[other];
+	if (other == c || chain->stamp == mark)
+		return;
+	chain->stamp = mark;
+	exttsp_compute_merge(env, c, other, best);
+}
+
+/**
+ * Recomputes the best merge of chain c with one of its neighbours.
+ */
+static void exttsp_update_best(exttsp_env_t *env, unsigned c)
+{
+	exttsp_merge_t best;
+	memset(&best, 0, sizeof(best));
+	best.valid = true;
+
+	unsigned        const mark   = ++env->stamp;
+	unsigned const *const blocks = env->chains[c].blocks;
+	for (size_t i = 0, n = ARR_LEN(blocks); i < n; ++i) {
+		exttsp_block_t const *const b = &env->blocks[blocks[i]];
+		for (size_t e = 0, n_e = ARR_LEN(b->succs); e < n_e; ++e)
+			exttsp_check_neighbour(env, c, env->edges[b->succs[e]].dst, mark, &best);
+		for (size_t e = 0, n_e = ARR_LEN(b->preds); e < n_e; ++e)
+			exttsp_check_neighbour(env, c, env->edges[b->preds[e]].src, mark, &best);
+	}
+
+	env->chains[c].best = best;
+}
+
+static void exttsp_merge(exttsp_env_t *env, unsigned x, exttsp_merge_t const *merge)
+{
+	unsigned const y = merge->other;
+	exttsp_piece_t pieces[3];
+	unsigned const n_pieces
+		= exttsp_merge_layout(env, x, y, merge->kind, merge->split, pieces);
+
+	unsigned *blocks = NEW_ARR_F(unsigned, 0);
+	for (unsigned p = 0; p < n_pieces; ++p) {
+		for (unsigned i = 0; i < pieces[p].n; ++i)
+			ARR_APP1(unsigned, blocks, pieces[p].blocks[i]);
+	}
+
+	exttsp_chain_t *const cx = &env->chains[x];
+	exttsp_chain_t *const cy = &env->chains[y];
+	DB((dbg, LEVEL_1, "Merge chains %u and %u (gain %.3g)\n", x, y,
+	    merge->gain));
+	DEL_ARR_F(cx->blocks);
+	DEL_ARR_F(cy->blocks);
+	cx->blocks = blocks;
+	cx->size  += cy->size;
+	cx->freq  += cy->freq;
+	cx->score += cy->score + merge->gain;
+	cy->blocks = NULL;
+	cy->dead   = true;
+	if (y == env->start)
+		env->start = x;
+	for (size_t i = 0, n = ARR_LEN(blocks); i < n; ++i)
+		env->blocks[blocks[i]].chain = x;
+
+	/* merges involving one of the two chains have to be recomputed */
+	for (size_t c = 0, n = ARR_LEN(env->chains); c < n; ++c) {
+		exttsp_chain_t *const chain = &env->chains[c];
+		if (chain->dead)
+			continue;
+		if (c == x || chain->best.other == x || chain->best.other == y)
+			chain->best.valid = false;
+	}
+	for (size_t i = 0, n = ARR_LEN(blocks); i < n; ++i) {
+		exttsp_block_t const *const b = &env->blocks[blocks[i]];
+		for (size_t e = 0, n_e = ARR_LEN(b->succs); e < n_e; ++e)
+			env->chains[env->blocks[env->edges[b->succs[e]].dst].chain].best.valid = false;
+		for (size_t e = 0, n_e = ARR_LEN(b->preds); e < n_e; ++e)
+			env->chains[env->blocks[env->edges[b->preds[e]].src].chain].best.valid = false;
+	}
+}
+
+static double get_chain_density(exttsp_chain_t const *chain)
+{
+	return chain->freq / MAX(chain->size, 1u);
+}
+
+/**
+ * Sort chains by decreasing density, i.e. execution frequency per byte.
+ */
+static int cmp_exttsp_chains(const void *d1, const void *d2)
+{
+	exttsp_chain_t const *const c1 = *(exttsp_chain_t const *const*)d1;
+	exttsp_chain_t const *const c2 = *(exttsp_chain_t const *const*)d2;
+	double                const f1 = get_chain_density(c1);
+	double                const f2 = get_chain_density(c2);
+	if (f1 != f2)
+		return f1 < f2 ? 1 : -1;
+	return QSORT_CMP(c1, c2);
+}
+
+static ir_node **create_block_schedule_exttsp(ir_graph *irg)
+{
+	blocksched_env_t env;
+	env.irg        = irg;
+	env.edges      = NEW_ARR_F(edge_t, 0);
+	env.worklist   = NULL;
+	env.blockcount = 0;
+	obstack_init(&env.obst);
+
+	assure_loopinfo(irg);
+
+	/* collect edge execution frequencies before the empty blocks on split
+	 * critical edges disappear, their frequency is the edge frequency */
+	irg_block_walk_graph(irg, collect_egde_frequency, NULL, &env);
+	(void)be_remove_empty_blocks(irg);
+
+	exttsp_env_t tsp;
+	tsp.blocks = NEW_ARR_F(exttsp_block_t, 0);
+	tsp.edges  = NEW_ARR_F(exttsp_edge_t, 0);
+	tsp.chains = NEW_ARR_F(exttsp_chain_t, 0);
+	tsp.stamp  = 0;
+	irg_block_walk_graph(irg, collect_exttsp_block, NULL, &tsp);
+
+	for (size_t i = 0, n = ARR_LEN(env.edges); i < n; ++i) {
+		edge_t const *const edge  = &env.edges[i];
+		ir_node      *const block = edge->block;
+		/* the block might have been removed already... */
+		if (is_Bad(get_Block_cfgpred(block, 0))
+		    || is_Bad(get_Block_cfgpred(block, edge->pos)))
+			continue;
+
+		ir_node      *const pred = get_Block_cfgpred_block(block, edge->pos);
+		exttsp_edge_t const e    = {
+			PTR_TO_INT(get_irn_link(pred)),
+			PTR_TO_INT(get_irn_link(block)),
+			edge->execfreq,
+		};
+		unsigned const idx = ARR_LEN(tsp.edges);
+		ARR_APP1(exttsp_edge_t, tsp.edges, e);
+		ARR_APP1(unsigned, tsp.blocks[e.src].succs, idx);
+		ARR_APP1(unsigned, tsp.blocks[e.dst].preds, idx);
+	}
+
+	/* one chain per block to start with */
+	size_t const n_blocks = ARR_LEN(tsp.blocks);
+	for (size_t i = 0; i < n_blocks; ++i) {
+		exttsp_block_t *const b = &tsp.blocks[i];
+		exttsp_chain_t        chain;
+		memset(&chain, 0, sizeof(chain));
+		chain.blocks = NEW_ARR_F(unsigned, 1);
+		chain.blocks[0] = i;
+		chain.size      = b->size;
+		chain.freq      = b->freq;
+		b->chain        = i;
+		ARR_APP1(exttsp_chain_t, tsp.chains, chain);
+	}
+	for (size_t i = 0; i < n_blocks; ++i) {
+		exttsp_piece_t const piece = { tsp.chains[i].blocks, 1 };
+		tsp.chains[i].score = exttsp_score(&tsp, &piece, 1);
+	}
+	tsp.start = PTR_TO_INT(get_irn_link(get_irg_start_block(irg)));
+
+	/* greedily apply the merge with the highest gain */
+	for (;;) {
+		unsigned best_chain = 0;
+		double   best_gain  = 0.0;
+		bool     found      = false;
+		for (size_t c = 0; c < n_blocks; ++c) {
+			exttsp_chain_t *const chain = &tsp.chains[c];
+			if (chain->dead)
+				continue;
+			if (!chain->best.valid)
+				exttsp_update_best(&tsp, c);
+			if (chain->best.gain > best_gain) {
+				best_chain = c;
+				best_gain  = chain->best.gain;
+				found      = true;
+			}
+		}
+		if (!found)
+			break;
+		exttsp_merge_t const merge = tsp.chains[best_chain].best;
+		exttsp_merge(&tsp, best_chain, &merge);
+	}
+
+	/* the start chain comes first, the others by density */
+	exttsp_chain_t **chains = NEW_ARR_F(exttsp_chain_t*, 0);
+	for (size_t c = 0; c < n_blocks; ++c) {
+		if (!tsp.chains[c].dead && c != tsp.start)
+			ARR_APP1(exttsp_chain_t*, chains, &tsp.chains[c]);
+	}
+	qsort(chains, ARR_LEN(chains), sizeof(*chains), cmp_exttsp_chains);
+
+	ir_node **block_list = NEW_ARR_D(ir_node*, be_get_be_obst(irg), n_blocks);
+	size_t    pos        = 0;
+	DB((dbg, LEVEL_1, "Blockschedule:\n"));
+	for (size_t c = 0, n = ARR_LEN(chains); c <= n; ++c) {
+		exttsp_chain_t const *const chain = c == 0 ? &tsp.chains[tsp.start] : chains[c - 1];
+		for (size_t i = 0, n_chain = ARR_LEN(chain->blocks); i < n_chain; ++i) {
+			ir_node *const block = tsp.blocks[chain->blocks[i]].block;
+			DB((dbg, LEVEL_1, "\t%+F\n", block));
+			block_list[pos++] = block;
+		}
+	}
+	assert(pos == n_blocks);
+
+	DEL_ARR_F(chains);
+	for (size_t c = 0; c < n_blocks; ++c) {
+		if (!tsp.chains[c].dead)
+			DEL_ARR_F(tsp.chains[c].blocks);
+	}
+	for (size_t i = 0; i < n_blocks; ++i) {
+		DEL_ARR_F(tsp.blocks[i].succs);
+		DEL_ARR_F(tsp.blocks[i].preds);
+	}
+	DEL_ARR_F(tsp.chains);
+	DEL_ARR_F(tsp.edges);
+	DEL_ARR_F(tsp.blocks);
+	DEL_ARR_F(env.edges);
+	obstack_free(&env.obst, NULL);
+
+	return block_list;
+}
+
 /*
  *  __  __       _
  * |  \/  | __ _(_)_ __
@@ -743,7 +1211,55 @@ ir_node **be_create_block_schedule(ir_graph *irg)
 		return create_block_schedule_greedy(irg);
 	case BLOCKSCHED_ILP:
 		return create_block_schedule_ilp(irg);
+	case BLOCKSCHED_EXTTSP:
+		return create_block_schedule_exttsp(irg);
 	}
 
 	panic("unknown blocksched algo");
 }
+
+/**
+ * A block is cold if the profile has a zero count for it. Blocks lacking
+ * profile data are created after the profile was read and stay hot.
+ */
+static bool is_cold_block(const ir_node *block)
+{
+	ir_graph *irg = get_Block_irg(block);
+	if (block == get_irg_start_block(irg) || block == get_irg_end_block(irg))
+		return false;
+	return ir_profile_has_block_execcount(block)
+	    && ir_profile_get_block_execcount(block) == 0;
+}
+
+void be_split_cold_fragment(ir_graph *irg, ir_node **block_schedule)
+{
+	be_irg_t *birg = be_birg_from_irg(irg);
+	birg->cold_block = NULL;
+	/* a cold graph lives in the cold section as a whole, merged functions
+	 * have to stay in a single section group */
+	if (!split_cold || birg->cold
+	    || get_entity_linkage(get_irg_entity(irg)) & IR_LINKAGE_MERGE)
+		return;
+
+	size_t    n_blocks = ARR_LEN(block_schedule);
+	ir_node **cold     = NEW_ARR_F(ir_node*, 0);
+	size_t    n_hot    = 0;
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ir_node *block = block_schedule[i];
+		if (is_cold_block(block)) {
+			ARR_APP1(ir_node*, cold, block);
+		} else {
+			block_schedule[n_hot++] = block;
+		}
+	}
+
+	/* the cold blocks keep their relative order behind the hot ones */
+	size_t n_cold = ARR_LEN(cold);
+	if (n_cold > 0) {
+		memcpy(&block_schedule[n_hot], cold, n_cold * sizeof(cold[0]));
+		birg->cold_block = cold[0];
+		DB((dbg, LEVEL_1, "%+F: %zu of %zu blocks are cold\n", irg, n_cold,
+		    n_blocks));
+	}
+	DEL_ARR_F(cold);
+}
@@ -16,4 +16,13 @@
 
 ir_node **be_create_block_schedule(ir_graph *irg);
 
+/**
+ * Moves the blocks the profile never saw executing to the end of
+ * @p block_schedule and records the first of them as the start of the cold
+ * fragment of the graph, which is emitted into the cold text section.
+ * Backends calling this must not let the last hot block fall through into
+ * the cold fragment. Does nothing unless the splitcold option is set.
+ */
+void be_split_cold_fragment(ir_graph *irg, ir_node **block_schedule);
+
 #endif
@@ -278,6 +278,11 @@ static void constraints(ir_node *const bl, void *const data)
 	}
 }
 
+void be_chordal_handle_constraints(be_chordal_env_t *const env)
+{
+	dom_tree_walk_irg(env->irg, constraints, NULL, env);
+}
+
 static void assign(ir_node *const block, void *const env_ptr)
 {
 	be_chordal_env_t *const env  = (be_chordal_env_t*)env_ptr;
@@ -340,7 +345,7 @@ static void be_ra_chordal_color(be_chordal_env_t *const chordal_env)
 	be_timer_push(T_CONSTR);
 
 	/* Handle register targeting constraints */
-	dom_tree_walk_irg(irg, constraints, NULL, chordal_env);
+	be_chordal_handle_constraints(chordal_env);
 
 	if (chordal_env->opts->dump_flags & BE_CH_DUMP_CONSTR) {
 		snprintf(buf, sizeof(buf), "%s-constr", chordal_env->cls->name);
@@ -349,6 +354,11 @@ static void be_ra_chordal_color(be_chordal_env_t *const chordal_env)
 
 	be_timer_pop(T_CONSTR);
 
+	/* The constraint handling is done, so the liveness does not change until
+	 * the interference graph is not needed anymore. */
+	if (chordal_env->opts->lv_bitsets)
+		chordal_env->lv_cls = be_lv_cls_new(be_get_irg_liveness(irg), chordal_env->cls);
+
 	/* First, determine the pressure */
 	dom_tree_walk_irg(irg, create_borders, NULL, chordal_env);
 
@@ -71,10 +71,18 @@ void create_borders(ir_node *block, void *env_ptr)
 	 * Make final uses of all values live out of the block.
 	 * They are necessary to build up real intervals.
 	 */
-	be_lv_foreach_cls(lv, block, be_lv_state_end, env->cls, irn) {
-		DB((dbg, LEVEL_3, "\tMaking live: %+F\n", irn));
-		ir_nodeset_insert(&live, irn);
-		border_use(irn, step, 0);
+	if (env->lv_cls != NULL) {
+		be_lv_cls_foreach(env->lv_cls, block, be_lv_state_end, irn) {
+			DB((dbg, LEVEL_3, "\tMaking live: %+F\n", irn));
+			ir_nodeset_insert(&live, irn);
+			border_use(irn, step, 0);
+		}
+	} else {
+		be_lv_foreach_cls(lv, block, be_lv_state_end, env->cls, irn) {
+			DB((dbg, LEVEL_3, "\tMaking live: %+F\n", irn));
+			ir_nodeset_insert(&live, irn);
+			border_use(irn, step, 0);
+		}
 	}
 	++step;
 
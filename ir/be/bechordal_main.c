@@ -67,6 +67,8 @@
 static be_ra_chordal_opts_t options = {
 	BE_CH_DUMP_NONE,
 	BE_CH_LOWER_PERM_SWAP,
+	0,
+	1,
 };
 
 static const lc_opt_enum_int_items_t lower_perm_items[] = {
@@ -103,6 +105,8 @@ static lc_opt_enum_mask_var_t dump_var = {
 static const lc_opt_table_entry_t be_chordal_options[] = {
 	LC_OPT_ENT_ENUM_INT ("perm",          "perm lowering options", &lower_perm_var),
 	LC_OPT_ENT_ENUM_MASK("dump",          "select dump phases", &dump_var),
+	LC_OPT_ENT_BOOL     ("lvbitsets",     "use per class liveness bitsets for interference checks", &options.lv_bitsets),
+	LC_OPT_ENT_BOOL     ("skipempty",     "skip register classes without values", &options.skip_empty_classes),
 	LC_OPT_LAST
 };
 
@@ -228,7 +232,7 @@ static void post_spill(be_chordal_env_t *const chordal_env, ir_graph *const irg)
 	be_timer_pop(T_RA_SPILL_APPLY);
 
 	/* verify schedule and register pressure */
-	if (be_options.do_verify) {
+	if (be_should_verify(irg)) {
 		be_timer_push(T_VERIFY);
 		be_verify_schedule(irg);
 		be_verify_register_pressure(irg, chordal_env->cls);
@@ -269,14 +273,21 @@ static void post_spill(be_chordal_env_t *const chordal_env, ir_graph *const irg)
 
 	dump(BE_CH_DUMP_COPYMIN, irg, chordal_env->cls, "copymin");
 
+	/* ssa destruction changes the liveness */
+	if (chordal_env->lv_cls != NULL) {
+		be_lv_cls_free(chordal_env->lv_cls);
+		chordal_env->lv_cls = NULL;
+	}
+
 	/* ssa destruction */
 	be_timer_push(T_RA_SSA);
-	be_ssa_destruction(chordal_env->irg, chordal_env->cls);
+	be_ssa_destruction(chordal_env->irg, chordal_env->cls,
+	                   options.lower_perm_opt == BE_CH_LOWER_PERM_COPY);
 	be_timer_pop(T_RA_SSA);
 
 	dump(BE_CH_DUMP_SSADESTR, irg, chordal_env->cls, "ssadestr");
 
-	if (be_options.do_verify) {
+	if (be_should_verify(irg)) {
 		be_timer_push(T_VERIFY);
 		be_ssa_destruction_check(chordal_env->irg, chordal_env->cls);
 		be_timer_pop(T_VERIFY);
@@ -290,6 +301,26 @@ static void post_spill(be_chordal_env_t *const chordal_env, ir_graph *const irg)
 	free(chordal_env->allocatable_regs);
 }
 
+static void mark_used_classes(ir_node *node, void *env)
+{
+	bool *const used = (bool*)env;
+	if (get_irn_mode(node) == mode_T)
+		return;
+	arch_register_req_t const *const req = arch_get_irn_register_req(node);
+	if (req->cls != NULL && !arch_register_req_is(req, ignore))
+		used[req->cls->index] = true;
+}
+
+/**
+ * Determines which register classes contain values that need a register.
+ * Allocating one class only creates values of that class, so the result stays
+ * valid while the classes are processed.
+ */
+static void find_used_classes(ir_graph *irg, bool *used)
+{
+	irg_walk_graph(irg, NULL, mark_used_classes, used);
+}
+
 /**
  * Performs chordal register allocation for each register class on given irg.
  *
@@ -311,6 +342,7 @@ static void be_ra_chordal_main(ir_graph *irg)
 	chordal_env.irg              = irg;
 	chordal_env.border_heads     = NULL;
 	chordal_env.ifg              = NULL;
+	chordal_env.lv_cls           = NULL;
 	chordal_env.allocatable_regs = NULL;
 
 	if (stat_ev_enabled) {
@@ -319,13 +351,28 @@ static void be_ra_chordal_main(ir_graph *irg)
 
 	/* use one of the generic spiller */
 
+	/* classes without any values need neither spilling nor coloring */
+	m = arch_env->n_register_classes;
+	bool *used_classes = ALLOCANZ(bool, m);
+	if (options.skip_empty_classes) {
+		find_used_classes(irg, used_classes);
+	} else {
+		for (j = 0; j < m; ++j)
+			used_classes[j] = true;
+	}
+
 	/* Perform the following for each register class. */
-	for (j = 0, m = arch_env->n_register_classes; j < m; ++j) {
+	for (j = 0; j < m; ++j) {
 		const arch_register_class_t *cls = &arch_env->register_classes[j];
 
 		if (arch_register_class_flags(cls) & arch_register_class_flag_manual_ra)
 			continue;
-
+		if (!used_classes[cls->index]) {
+			stat_ev_ctx_push_str("bechordal_cls", cls->name);
+			stat_ev_int("bechordal_skipped", 1);
+			stat_ev_ctx_pop("bechordal_cls");
+			continue;
+		}
 
 		stat_ev_ctx_push_str("bechordal_cls", cls->name);
 
@@ -47,6 +47,7 @@ struct be_chordal_env_t {
 	pmap                 *border_heads; /**< Maps blocks to border heads. */
 	be_ifg_t             *ifg;          /**< The interference graph. */
 	bitset_t             *allocatable_regs; /**< set of allocatable registers */
+	be_lv_cls_t          *lv_cls;       /**< Bitset liveness of the class, NULL if not used. */
 };
 
 static inline struct list_head *get_block_border_head(be_chordal_env_t const *const inf, ir_node *const bl)
@@ -80,8 +81,17 @@ enum {
 struct be_ra_chordal_opts_t {
 	unsigned dump_flags;
 	int      lower_perm_opt;
+	int      lv_bitsets;
+	int      skip_empty_classes;
 };
 
 void check_for_memory_operands(ir_graph *irg);
 
+/**
+ * Inserts Perms in front of nodes with register constraints and assigns
+ * registers to the constrained values and the results of these Perms.
+ * Needs valid live sets and dominance information.
+ */
+void be_chordal_handle_constraints(be_chordal_env_t *env);
+
 #endif /* FIRM_BE_BECHORDAL_T_H */
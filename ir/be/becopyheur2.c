@@ -1005,6 +1005,7 @@ static int co_solve_heuristic_new(copy_opt_t *co)
 	FIRM_DBG_REGISTER(env.dbg, "firm.be.co2");
 	INIT_LIST_HEAD(&env.cloud_head);
 
+	be_ifg_materialize(co->cenv->ifg);
 	process(&env);
 
 	writeback_colors(&env);
@@ -17,6 +17,7 @@
 #define DISABLE_STATEV
 
 #include <float.h>
+#include <string.h>
 
 #include "array.h"
 #include "irnode_t.h"
@@ -110,6 +111,7 @@ typedef struct co_mst_irn_t {
 	aff_chunk_t      *chunk;            /**< the chunk this irn belongs to */
 	bitset_t         *adm_colors;       /**< set of admissible colors for this irn */
 	ir_node          **int_neighs;      /**< array of all interfering neighbours (cached for speed reasons) */
+	const ir_node    **sorted_neighs;   /**< the interfering neighbours sorted by address */
 	int              n_neighs;          /**< length of the interfering neighbours array. */
 	int              int_aff_neigh;     /**< number of interfering affinity neighbours */
 	int              col;               /**< color currently assigned */
@@ -120,6 +122,13 @@ typedef struct co_mst_irn_t {
 	real_t           constr_factor;
 } co_mst_irn_t;
 
+static int cmp_node_addr(const void *a, const void *b)
+{
+	const ir_node *const n1 = *(const ir_node *const*)a;
+	const ir_node *const n2 = *(const ir_node *const*)b;
+	return QSORT_CMP(n1, n2);
+}
+
 /**
  * In case there is no phase information for irn, initialize it.
  */
@@ -164,6 +173,13 @@ static co_mst_irn_t *co_mst_irn_init(co_mst_env_t *env, const ir_node *irn)
 	}
 	res->int_neighs = (ir_node**)obstack_finish(&env->obst);
 	res->n_neighs   = len;
+
+	/* the sorted copy allows merging the neighbours into the interference
+	 * arrays of chunks and binary searching them */
+	const ir_node **const sorted = OALLOCN(&env->obst, const ir_node*, len);
+	memcpy(sorted, res->int_neighs, len * sizeof(*sorted));
+	qsort(sorted, len, sizeof(*sorted), cmp_node_addr);
+	res->sorted_neighs = sorted;
 	return res;
 }
 
@@ -334,12 +350,13 @@ static inline void delete_aff_chunk(aff_chunk_t *c)
 /**
  * binary search of sorted nodes.
  *
- * @return the position where n is found in the array arr or ~pos
- * if the nodes is not here.
+ * @return the position where n is found in the first len entries of arr or
+ * ~pos if the nodes is not here.
  */
-static inline int nodes_bsearch(const ir_node **arr, const ir_node *n)
+static inline int nodes_bsearch_len(const ir_node *const *arr, int len,
+                                    const ir_node *n)
 {
-	int hi = ARR_LEN(arr);
+	int hi = len;
 	int lo = 0;
 
 	while (lo < hi) {
@@ -356,6 +373,14 @@ static inline int nodes_bsearch(const ir_node **arr, const ir_node *n)
 	return ~lo;
 }
 
+/**
+ * binary search of sorted nodes in an ARR_F.
+ */
+static inline int nodes_bsearch(const ir_node **arr, const ir_node *n)
+{
+	return nodes_bsearch_len(arr, ARR_LEN(arr), n);
+}
+
 /** Check if a node n can be found inside arr. */
 static int node_contains(const ir_node **arr, const ir_node *n)
 {
@@ -389,23 +414,71 @@ static int nodes_insert(const ir_node ***arr, const ir_node *irn)
 	return 0;
 }
 
+/**
+ * Merge the n_add sorted nodes in add into the sorted nodes list.
+ * Unlike inserting the nodes one by one, this takes time linear in the length
+ * of both lists.
+ */
+static void nodes_merge(const ir_node ***arr, const ir_node *const *add,
+                        size_t n_add)
+{
+	const ir_node **l   = *arr;
+	size_t          len = ARR_LEN(l);
+
+	/* count the nodes not in the list yet */
+	size_t n_new = 0;
+	for (size_t i = 0, j = 0; j < n_add;) {
+		if (i == len || add[j] < l[i]) {
+			++n_new;
+			++j;
+		} else if (add[j] == l[i]) {
+			++i;
+			++j;
+		} else {
+			++i;
+		}
+	}
+	if (n_new == 0)
+		return;
+
+	/* merge from the back, so no temporary list is needed */
+	ARR_RESIZE(const ir_node *, l, len + n_new);
+	size_t i = len;
+	size_t j = n_add;
+	size_t k = len + n_new;
+	while (j > 0) {
+		const ir_node *const a = add[j - 1];
+		if (i > 0 && l[i - 1] >= a) {
+			if (l[i - 1] == a)
+				--j;
+			l[--k] = l[--i];
+		} else {
+			l[--k] = a;
+			--j;
+		}
+	}
+	assert(k == i);
+	*arr = l;
+}
+
+/** Check if irn is an interfering neighbour of node. */
+static inline int node_interferes(const co_mst_irn_t *node, const ir_node *irn)
+{
+	return nodes_bsearch_len(node->sorted_neighs, node->n_neighs, irn) >= 0;
+}
+
 /**
  * Adds a node to an affinity chunk
  */
 static inline void aff_chunk_add_node(aff_chunk_t *c, co_mst_irn_t *node)
 {
-	int i;
-
 	if (! nodes_insert(&c->n, node->irn))
 		return;
 
 	c->weight_consistent = 0;
 	node->chunk          = c;
 
-	for (i = node->n_neighs - 1; i >= 0; --i) {
-		ir_node *neigh = node->int_neighs[i];
-		nodes_insert(&c->interfere, neigh);
-	}
+	nodes_merge(&c->interfere, node->sorted_neighs, node->n_neighs);
 }
 
 /**
@@ -424,17 +497,22 @@ static inline int aff_chunk_interferes(const aff_chunk_t *chunk, const ir_node *
  */
 static inline int aff_chunks_interfere(const aff_chunk_t *c1, const aff_chunk_t *c2)
 {
-	int i;
-
 	if (c1 == c2)
 		return 0;
 
-	/* check if there is a node in c2 having an interfering neighbor in c1 */
-	for (i = ARR_LEN(c2->n) - 1; i >= 0; --i) {
-		const ir_node *irn = c2->n[i];
-
-		if (node_contains(c1->interfere, irn))
+	/* check if there is a node in c2 having an interfering neighbor in c1,
+	 * both lists are sorted so walk them in parallel */
+	const ir_node **const n   = c2->n;
+	const ir_node **const itf = c1->interfere;
+	size_t          const n_n = ARR_LEN(n);
+	size_t          const n_i = ARR_LEN(itf);
+	for (size_t i = 0, j = 0; i < n_n && j < n_i;) {
+		if (n[i] == itf[j])
 			return 1;
+		if (n[i] < itf[j])
+			++i;
+		else
+			++j;
 	}
 	return 0;
 }
@@ -479,13 +557,8 @@ static int aff_chunk_absorb(co_mst_env_t *env, const ir_node *src, const ir_node
 		if (c2 == NULL) {
 			/* no chunk exists */
 			co_mst_irn_t *mirn = get_co_mst_irn(env, src);
-			int i;
 
-			for (i = mirn->n_neighs - 1; i >= 0; --i) {
-				if (mirn->int_neighs[i] == tgt)
-					break;
-			}
-			if (i < 0) {
+			if (!node_interferes(mirn, tgt)) {
 				/* create one containing both nodes */
 				c1 = new_aff_chunk(env);
 				aff_chunk_add_node(c1, get_co_mst_irn(env, src));
@@ -506,15 +579,13 @@ static int aff_chunk_absorb(co_mst_env_t *env, const ir_node *src, const ir_node
 			goto absorbed;
 		}
 	} else if (c1 != c2 && ! aff_chunks_interfere(c1, c2)) {
-		int idx, len;
+		/* the interference list of c2 already contains the interfering
+		 * neighbours of all its nodes, so merge the lists as a whole */
+		for (size_t idx = 0, len = ARR_LEN(c2->n); idx < len; ++idx)
+			get_co_mst_irn(env, c2->n[idx])->chunk = c1;
 
-		for (idx = 0, len = ARR_LEN(c2->n); idx < len; ++idx)
-			aff_chunk_add_node(c1, get_co_mst_irn(env, c2->n[idx]));
-
-		for (idx = 0, len = ARR_LEN(c2->interfere); idx < len; ++idx) {
-			const ir_node *irn = c2->interfere[idx];
-			nodes_insert(&c1->interfere, irn);
-		}
+		nodes_merge(&c1->n, c2->n, ARR_LEN(c2->n));
+		nodes_merge(&c1->interfere, c2->interfere, ARR_LEN(c2->interfere));
 
 		c1->weight_consistent = 0;
 
@@ -586,18 +657,13 @@ static int count_interfering_aff_neighs(co_mst_env_t *env, const affinity_node_t
 
 	co_gs_foreach_neighb(an, neigh) {
 		const ir_node *n = neigh->irn;
-		int           i;
 
 		if (arch_irn_is_ignore(n))
 			continue;
 
 		/* check if the affinity neighbour interfere */
-		for (i = 0; i < node->n_neighs; ++i) {
-			if (node->int_neighs[i] == n) {
-				++res;
-				break;
-			}
-		}
+		if (node_interferes(node, n))
+			++res;
 	}
 	return res;
 }
@@ -1399,6 +1465,9 @@ static int co_solve_heuristic_mst(copy_opt_t *co)
 
 	stat_ev_tim_push();
 
+	/* the neighbours of every node are queried */
+	be_ifg_materialize(co->cenv->ifg);
+
 	/* init phase */
 	co_mst_env_t mst_env;
 	ir_nodemap_init(&mst_env.map, co->irg);
@@ -79,19 +79,20 @@ void be_init_copyilp(void)
  */
 static inline bool sr_is_simplicial(ilp_env_t *const ienv, ir_node const *const ifn)
 {
-	bool              res = true;
-	ir_node         **all = NEW_ARR_F(ir_node*, 0);
-	be_lv_t    *const lv  = be_get_irg_liveness(ienv->co->irg);
-	neighbours_iter_t iter;
-	be_ifg_foreach_neighbour(ienv->co->cenv->ifg, &iter, ifn, curr) {
+	bool                  res = true;
+	ir_node             **all = NEW_ARR_F(ir_node*, 0);
+	be_ifg_t const *const ifg = ienv->co->cenv->ifg;
+	neighbours_iter_t     iter;
+	be_ifg_foreach_neighbour(ifg, &iter, ifn, curr) {
 		/* Only consider non-removed neighbours. */
 		if (sr_is_removed(ienv, curr))
 			continue;
 
 		/* Check whether the current node forms a clique with all previous nodes. */
 		for (size_t i = ARR_LEN(all); i-- != 0;) {
-			if (!be_values_interfere(lv, curr, all[i])) {
+			if (!be_ifg_connected(ifg, curr, all[i])) {
 				res = false;
+				be_ifg_neighbours_break(&iter);
 				goto end;
 			}
 		}
@@ -206,6 +207,9 @@ ilp_env_t *new_ilp_env(copy_opt_t *co, ilp_callback build, ilp_callback apply, v
 	res->col_suff   = NEW_ARR_F(ir_node*, 0);
 	ir_nodeset_init(&res->all_removed);
 
+	/* size reduction and the constraints query the neighbours a lot */
+	be_ifg_materialize(co->cenv->ifg);
+
 	return res;
 }
 
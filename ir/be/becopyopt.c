@@ -119,17 +119,21 @@ static const lc_opt_table_entry_t options[] = {
 	LC_OPT_ENT_ENUM_MASK     ("dump",    "dump ifg before or after copy optimization",              &dump_var),
 	LC_OPT_ENT_ENUM_MASK     ("style",   "dump style for ifg dumping",                              &style_var),
 	LC_OPT_ENT_BOOL          ("stats",   "dump statistics after each optimization",                 &do_stats),
-	LC_OPT_ENT_BOOL          ("improve", "run heur1 before if algo can exploit start solutions",    &improve),
+	LC_OPT_ENT_BOOL          ("improve", "run start algo before if algo can exploit start solutions", &improve),
 	LC_OPT_LAST
 };
 
 static be_module_list_entry_t *copyopts = NULL;
 static const co_algo_info *selected_copyopt = NULL;
+/** the algorithm providing the start solution for improving algorithms */
+static const co_algo_info *start_copyopt = NULL;
 
 void be_register_copyopt(const char *name, co_algo_info *copyopt)
 {
 	if (selected_copyopt == NULL)
 		selected_copyopt = copyopt;
+	if (start_copyopt == NULL || strcmp(name, "heur4") == 0)
+		start_copyopt = copyopt;
 	be_add_module_to_list(&copyopts, name, copyopt);
 }
 
@@ -144,6 +148,8 @@ void be_init_copyopt(void)
 	lc_opt_add_table(co_grp, options);
 	be_add_module_list_opt(co_grp, "algo", "select copy optimization algo",
 		                       &copyopts, (void**) &selected_copyopt);
+	be_add_module_list_opt(co_grp, "start", "select algo computing the start solution for improving algos",
+		                       &copyopts, (void**) &start_copyopt);
 }
 
 static int void_algo(copy_opt_t *co)
@@ -710,24 +716,19 @@ void co_complete_stats(const copy_opt_t *co, co_complete_stats_t *stat)
                   |_|                                      |___/
  ******************************************************************************/
 
-static int compare_affinity_node_t(const void *k1, const void *k2, size_t size)
-{
-	const affinity_node_t *n1 = (const affinity_node_t*)k1;
-	const affinity_node_t *n2 = (const affinity_node_t*)k2;
-	(void) size;
-
-	return (n1->irn != n2->irn);
-}
-
 static void add_edge(copy_opt_t *co, ir_node *n1, ir_node *n2, int costs)
 {
-	affinity_node_t new_node, *node;
+	affinity_node_t *node = ir_nodemap_get(affinity_node_t, &co->aff_map, n1);
 	neighb_t        *nbr;
 	int             allocnew = 1;
 
-	new_node.irn        = n1;
-	new_node.neighbours = NULL;
-	node = set_insert(affinity_node_t, co->nodes, &new_node, sizeof(new_node), hash_irn(new_node.irn));
+	if (node == NULL) {
+		node             = OALLOC(&co->obst, affinity_node_t);
+		node->irn        = n1;
+		node->neighbours = NULL;
+		ir_nodemap_insert(&co->aff_map, n1, node);
+		ARR_APP1(affinity_node_t*, co->nodes, node);
+	}
 
 	for (nbr = node->neighbours; nbr; nbr = nbr->next)
 		if (nbr->irn == n2) {
@@ -795,7 +796,8 @@ static void build_graph_walker(ir_node *irn, void *env)
 void co_build_graph_structure(copy_opt_t *co)
 {
 	obstack_init(&co->obst);
-	co->nodes = new_set(compare_affinity_node_t, 32);
+	co->nodes = NEW_ARR_F(affinity_node_t*, 0);
+	ir_nodemap_init(&co->aff_map, co->irg);
 
 	irg_walk_graph(co->irg, build_graph_walker, NULL, co);
 }
@@ -804,19 +806,15 @@ void co_free_graph_structure(copy_opt_t *co)
 {
 	ASSERT_GS_AVAIL(co);
 
-	del_set(co->nodes);
+	DEL_ARR_F(co->nodes);
+	ir_nodemap_destroy(&co->aff_map);
 	obstack_free(&co->obst, NULL);
 	co->nodes = NULL;
 }
 
 int co_gs_is_optimizable(copy_opt_t const *const co, ir_node *const irn)
 {
-	affinity_node_t new_node, *n;
-
-	ASSERT_GS_AVAIL(co);
-
-	new_node.irn = irn;
-	n = set_find(affinity_node_t, co->nodes, &new_node, sizeof(new_node), hash_irn(new_node.irn));
+	affinity_node_t const *const n = get_affinity_info(co, irn);
 	return n && n->neighbours;
 }
 
@@ -982,12 +980,18 @@ void co_driver(be_chordal_env_t *cenv)
 		fclose(f);
 	}
 
-	/* if the algo can improve results, provide an initial solution with heur1 */
-	if (improve && selected_copyopt->can_improve_existing) {
+	/* the improving algorithms build an ILP, graphs beyond the memory budget
+	 * only get the start solution */
+	co_algo_info const *algo = selected_copyopt;
+	if (algo->can_improve_existing && irg_memory_budget_exceeded(cenv->irg))
+		algo = start_copyopt;
+
+	/* if the algo can improve results, provide an initial solution */
+	if (improve && algo->can_improve_existing && start_copyopt != algo) {
 		co_complete_stats_t stats;
 
 		/* produce a heuristic solution */
-		co_solve_heuristic(co);
+		start_copyopt->copyopt(co);
 
 		/* do the stats and provide the current costs */
 		co_complete_stats(co, &stats);
@@ -996,7 +1000,7 @@ void co_driver(be_chordal_env_t *cenv)
 
 	/* perform actual copy minimization */
 	ir_timer_reset_and_start(timer);
-	was_optimal = selected_copyopt->copyopt(co);
+	was_optimal = algo->copyopt(co);
 	ir_timer_stop(timer);
 
 	stat_ev_dbl("co_time", ir_timer_elapsed_msec(timer));
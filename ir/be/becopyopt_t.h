@@ -14,8 +14,9 @@
 
 #include "obst.h"
 #include "list.h"
-#include "set.h"
+#include "array.h"
 #include "irnode_t.h"
+#include "irnodemap.h"
 
 #include "bearch.h"
 #include "bechordal_t.h"
@@ -34,8 +35,9 @@ struct copy_opt_t {
 	struct list_head units;  /**< all units to optimize in specific order */
 
 	/** Representation in graph structure. Only build on demand */
-	struct obstack obst;
-	set    *nodes;
+	struct obstack           obst;
+	struct affinity_node_t **nodes;   /**< all nodes with affinity edges */
+	ir_nodemap               aff_map; /**< maps nodes to their affinity info */
 };
 
 /* Helpers */
@@ -116,15 +118,13 @@ struct affinity_node_t {
 
 static inline affinity_node_t *get_affinity_info(const copy_opt_t *co, const ir_node *irn)
 {
-	affinity_node_t find;
-
 	ASSERT_GS_AVAIL(co);
-
-	find.irn = irn;
-	return set_find(affinity_node_t, co->nodes, &find, sizeof(find), hash_irn(irn));
+	return ir_nodemap_get(affinity_node_t, &co->aff_map, irn);
 }
 
-#define co_gs_foreach_aff_node(co, aff_node)     foreach_set((co)->nodes, affinity_node_t, (aff_node))
+#define co_gs_foreach_aff_node(co, aff_node) \
+	for (size_t aff_node##__i = 0, aff_node##__n = ARR_LEN((co)->nodes); aff_node##__i < aff_node##__n; ++aff_node##__i) \
+		for (affinity_node_t *aff_node = (co)->nodes[aff_node##__i]; aff_node != NULL; aff_node = NULL)
 #define co_gs_foreach_neighb(aff_node, neighb)   for (neighb_t *neighb = aff_node->neighbours; neighb; neighb = neighb->next)
 
 #endif /* FIRM_BE_BECOPYOPT_T_H */
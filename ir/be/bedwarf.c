@@ -10,6 +10,7 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "bearch.h"
@@ -30,7 +31,7 @@
 #include "beabi.h"
 #include "bemodule.h"
 #include "beemitter.h"
-#include "dbginfo.h"
+#include "dbginfo_t.h"
 #include "begnuas.h"
 #include "typerep.h"
 
@@ -69,8 +70,27 @@ typedef enum custom_abbrevs {
 	abbrev_bitfield_member,
 	abbrev_subroutine_type,
 	abbrev_void_subroutine_type,
+	abbrev_split_subprogram,
+	abbrev_void_split_subprogram,
 } custom_abbrevs;
 
+/** Where a register of the caller is saved in the current method. */
+typedef struct callframe_spill_t {
+	const arch_register_t *reg;
+	const arch_register_t *in_reg; /**< register holding the value, NULL if
+	                                    it is saved on the stack */
+	int                    offset; /**< offset relative to the CFA */
+} callframe_spill_t;
+
+/** The callframe description in effect at some point of the method. */
+typedef struct callframe_state_t {
+	const arch_register_t *cfa_register;
+	int                    cfa_offset;
+	bool                   has_cfa_offset;
+	size_t                 n_spills;
+	callframe_spill_t      spills[];
+} callframe_state_t;
+
 /**
  * The dwarf handle.
  */
@@ -85,7 +105,21 @@ typedef struct dwarf_t {
 	const char       *main_file;    /**< name of the main source file */
 	const char       *curr_file;    /**< name of the current source file */
 	unsigned          label_num;
-	unsigned          last_line;
+	unsigned         *file_nums;    /**< file id of a packed source location
+	                                     - 1 -> number in file list or 0 */
+	packed_src_loc_t  last_loc;     /**< the location of the last .loc */
+	const ir_entity **split_list;   /**< methods with a cold fragment */
+	bool              cur_split;    /**< current method has a cold fragment */
+	/* the callframe description in effect */
+	const arch_register_t *cfa_register;
+	int                    cfa_offset;
+	bool                   has_cfa_offset;
+	callframe_spill_t     *cfa_spills;
+	/* the descriptions at the end of the blocks of a split method, the one
+	 * the cold fragment is entered with is restated there */
+	const ir_node         *cur_block;
+	pmap                  *block_exits;
+	struct obstack         callframe_obst;
 } dwarf_t;
 
 static dwarf_t               env;
@@ -302,46 +336,154 @@ static void emit_pubnames(void)
 	emit_label("pubnames_end");
 }
 
+static unsigned insert_file_id(unsigned file_id)
+{
+	size_t const idx = file_id - 1;
+	size_t const len = ARR_LEN(env.file_nums);
+	if (idx >= len) {
+		ARR_RESIZE(unsigned, env.file_nums, idx + 1);
+		memset(&env.file_nums[len], 0, (idx + 1 - len) * sizeof(unsigned));
+	}
+	if (env.file_nums[idx] == 0)
+		env.file_nums[idx] = insert_file(ir_get_src_file(file_id));
+	return env.file_nums[idx];
+}
+
 void be_dwarf_location(dbg_info *dbgi)
 {
 	if (debug_level < LEVEL_LOCATIONS)
 		return;
-	src_loc_t loc = ir_retrieve_dbg_info(dbgi);
-	if (!loc.file)
+	packed_src_loc_t const loc = ir_retrieve_packed_dbg_info(dbgi);
+	/* a .loc stays in effect for the following instructions */
+	if (loc == 0 || loc == env.last_loc)
 		return;
+	env.last_loc = loc;
 
-	unsigned filenum = insert_file(loc.file);
-	be_emit_irprintf("\t.loc %u %u %u\n", filenum, loc.line, loc.column);
+	unsigned const filenum = insert_file_id(packed_src_loc_file_id(loc));
+	be_emit_irprintf("\t.loc %u %u %u\n", filenum, packed_src_loc_line(loc),
+	                 packed_src_loc_column(loc));
 	be_emit_write_line();
 }
 
-void be_dwarf_callframe_register(const arch_register_t *reg)
+static void emit_callframe_register(const arch_register_t *reg)
 {
-	if (debug_level < LEVEL_FRAMEINFO)
-		return;
 	be_emit_cstring("\t.cfi_def_cfa_register ");
 	be_emit_irprintf("%d\n", reg->dwarf_number);
 	be_emit_write_line();
 }
 
-void be_dwarf_callframe_offset(int offset)
+static void emit_callframe_offset(int offset)
 {
-	if (debug_level < LEVEL_FRAMEINFO)
-		return;
 	be_emit_cstring("\t.cfi_def_cfa_offset ");
 	be_emit_irprintf("%d\n", offset);
 	be_emit_write_line();
 }
 
+static void emit_callframe_spilloffset(const arch_register_t *reg, int offset)
+{
+	be_emit_cstring("\t.cfi_offset ");
+	be_emit_irprintf("%d, %d\n", reg->dwarf_number, offset);
+	be_emit_write_line();
+}
+
+static void emit_callframe_copy(const arch_register_t *reg,
+                                const arch_register_t *in_reg)
+{
+	be_emit_cstring("\t.cfi_register ");
+	be_emit_irprintf("%d, %d\n", reg->dwarf_number, in_reg->dwarf_number);
+	be_emit_write_line();
+}
+
+static void emit_callframe_save(const callframe_spill_t *spill)
+{
+	if (spill->in_reg != NULL)
+		emit_callframe_copy(spill->reg, spill->in_reg);
+	else
+		emit_callframe_spilloffset(spill->reg, spill->offset);
+}
+
+void be_dwarf_callframe_register(const arch_register_t *reg)
+{
+	/* only changes are emitted, the description restated in a cold fragment
+	 * often is in effect already */
+	if (debug_level < LEVEL_FRAMEINFO || env.cfa_register == reg)
+		return;
+	env.cfa_register = reg;
+	emit_callframe_register(reg);
+}
+
+void be_dwarf_callframe_offset(int offset)
+{
+	if (debug_level < LEVEL_FRAMEINFO
+	    || (env.has_cfa_offset && env.cfa_offset == offset))
+		return;
+	env.cfa_offset     = offset;
+	env.has_cfa_offset = true;
+	emit_callframe_offset(offset);
+}
+
+static size_t find_callframe_save(const arch_register_t *reg)
+{
+	size_t i;
+	size_t n = ARR_LEN(env.cfa_spills);
+	for (i = 0; i < n; ++i) {
+		if (env.cfa_spills[i].reg == reg)
+			break;
+	}
+	return i;
+}
+
+static void set_callframe_save(const arch_register_t *reg,
+                               const arch_register_t *in_reg, int offset)
+{
+	callframe_spill_t spill = { reg, in_reg, offset };
+	size_t i = find_callframe_save(reg);
+	if (i < ARR_LEN(env.cfa_spills)) {
+		callframe_spill_t const *const old = &env.cfa_spills[i];
+		if (old->in_reg == in_reg && (in_reg != NULL || old->offset == offset))
+			return;
+		env.cfa_spills[i] = spill;
+	} else {
+		ARR_APP1(callframe_spill_t, env.cfa_spills, spill);
+	}
+	emit_callframe_save(&spill);
+}
+
 void be_dwarf_callframe_spilloffset(const arch_register_t *reg, int offset)
 {
 	if (debug_level < LEVEL_FRAMEINFO)
 		return;
-	be_emit_cstring("\t.cfi_offset ");
-	be_emit_irprintf("%d, %d\n", reg->dwarf_number, offset);
+	set_callframe_save(reg, NULL, offset);
+}
+
+void be_dwarf_callframe_copy(const arch_register_t *reg,
+                             const arch_register_t *in_reg)
+{
+	if (debug_level < LEVEL_FRAMEINFO)
+		return;
+	set_callframe_save(reg, in_reg, 0);
+}
+
+void be_dwarf_callframe_restore(const arch_register_t *reg)
+{
+	if (debug_level < LEVEL_FRAMEINFO)
+		return;
+	size_t i = find_callframe_save(reg);
+	size_t n = ARR_LEN(env.cfa_spills);
+	if (i == n)
+		return;
+	env.cfa_spills[i] = env.cfa_spills[n - 1];
+	ARR_SHRINKLEN(env.cfa_spills, n - 1);
+	be_emit_cstring("\t.cfi_restore ");
+	be_emit_irprintf("%d\n", reg->dwarf_number);
 	be_emit_write_line();
 }
 
+bool be_dwarf_has_callframe_info(void)
+{
+	return debug_level >= LEVEL_FRAMEINFO;
+}
+
 static bool is_extern_entity(const ir_entity *entity)
 {
 	ir_visited_t visibility = get_entity_visibility(entity);
@@ -404,6 +546,27 @@ static void emit_subprogram_abbrev(void)
 		register_attribute(DW_AT_frame_base, DW_FORM_block1);
 	end_abbrev();
 
+	/* methods with a cold fragment occupy two address ranges */
+	begin_abbrev(abbrev_split_subprogram, DW_TAG_subprogram, DW_CHILDREN_yes);
+	register_attribute(DW_AT_name,      DW_FORM_string);
+	register_dbginfo_attributes();
+	register_attribute(DW_AT_type,       DW_FORM_ref4);
+	register_attribute(DW_AT_external,   DW_FORM_flag);
+	register_attribute(DW_AT_ranges,     DW_FORM_data4);
+	if (debug_level >= LEVEL_FRAMEINFO)
+		register_attribute(DW_AT_frame_base, DW_FORM_block1);
+	end_abbrev();
+
+	begin_abbrev(abbrev_void_split_subprogram, DW_TAG_subprogram,
+	             DW_CHILDREN_yes);
+	register_attribute(DW_AT_name,       DW_FORM_string);
+	register_dbginfo_attributes();
+	register_attribute(DW_AT_external,   DW_FORM_flag);
+	register_attribute(DW_AT_ranges,     DW_FORM_data4);
+	if (debug_level >= LEVEL_FRAMEINFO)
+		register_attribute(DW_AT_frame_base, DW_FORM_block1);
+	end_abbrev();
+
 	begin_abbrev(abbrev_formal_parameter, DW_TAG_formal_parameter,
 	             DW_CHILDREN_no);
 	register_attribute(DW_AT_name,      DW_FORM_string);
@@ -456,7 +619,8 @@ static void emit_function_parameters(const ir_entity *entity,
 }
 
 void be_dwarf_method_before(const ir_entity *entity,
-                            const parameter_dbg_info_t *parameter_infos)
+                            const parameter_dbg_info_t *parameter_infos,
+                            bool has_cold_fragment)
 {
 	if (debug_level < LEVEL_BASIC)
 		return;
@@ -476,7 +640,12 @@ void be_dwarf_method_before(const ir_entity *entity,
 	}
 
 	emit_entity_label(entity);
-	emit_uleb128(n_ress == 0 ? abbrev_void_subprogram : abbrev_subprogram);
+	if (has_cold_fragment) {
+		emit_uleb128(n_ress == 0 ? abbrev_void_split_subprogram
+		                         : abbrev_split_subprogram);
+	} else {
+		emit_uleb128(n_ress == 0 ? abbrev_void_subprogram : abbrev_subprogram);
+	}
 	be_gas_emit_cstring(get_entity_ld_name(entity));
 	emit_dbginfo(get_entity_dbg_info(entity));
 	if (n_ress > 0) {
@@ -484,9 +653,17 @@ void be_dwarf_method_before(const ir_entity *entity,
 		emit_type_address(res);
 	}
 	emit_int8(is_extern_entity(entity));
-	emit_ref(entity);
-	be_emit_irprintf("\t.long %smethod_end_%s\n", be_gas_get_private_prefix(),
-	                 get_entity_ld_name(entity));
+	if (has_cold_fragment) {
+		/* the range list is emitted at the end of the compilation unit */
+		be_emit_irprintf("\t.long %sranges_%s\n", be_gas_get_private_prefix(),
+		                 get_entity_ld_name(entity));
+		ARR_APP1(const ir_entity*, env.split_list, entity);
+	} else {
+		emit_ref(entity);
+		be_emit_irprintf("\t.long %smethod_end_%s\n",
+		                 be_gas_get_private_prefix(),
+		                 get_entity_ld_name(entity));
+	}
 	/* frame_base prog */
 	emit_int8(1);
 	emit_int8(DW_OP_call_frame_cfa);
@@ -496,18 +673,28 @@ void be_dwarf_method_before(const ir_entity *entity,
 
 	ARR_APP1(const ir_entity*, env.pubnames_list, entity);
 
-	env.cur_ent = entity;
+	env.cur_ent   = entity;
+	env.cur_split = has_cold_fragment;
 }
 
 void be_dwarf_method_begin(void)
 {
+	env.last_loc = 0;
 	if (debug_level < LEVEL_FRAMEINFO)
 		return;
+	env.cfa_register   = NULL;
+	env.has_cfa_offset = false;
+	ARR_SHRINKLEN(env.cfa_spills, 0);
+	env.cur_block = NULL;
+	if (env.cur_split) {
+		env.block_exits = pmap_create();
+		obstack_init(&env.callframe_obst);
+	}
 	be_emit_cstring("\t.cfi_startproc\n");
 	be_emit_write_line();
 }
 
-void be_dwarf_method_end(void)
+void be_dwarf_method_hot_end(void)
 {
 	if (debug_level < LEVEL_BASIC)
 		return;
@@ -521,6 +708,123 @@ void be_dwarf_method_end(void)
 	}
 }
 
+static callframe_state_t *save_callframe_state(void)
+{
+	size_t const       n_spills = ARR_LEN(env.cfa_spills);
+	callframe_state_t *state    = (callframe_state_t*)obstack_alloc(
+		&env.callframe_obst,
+		sizeof(*state) + n_spills * sizeof(state->spills[0]));
+	state->cfa_register   = env.cfa_register;
+	state->cfa_offset     = env.cfa_offset;
+	state->has_cfa_offset = env.has_cfa_offset;
+	state->n_spills       = n_spills;
+	memcpy(state->spills, env.cfa_spills, n_spills * sizeof(state->spills[0]));
+	return state;
+}
+
+static void restore_callframe_state(const callframe_state_t *state)
+{
+	env.cfa_register   = state->cfa_register;
+	env.cfa_offset     = state->cfa_offset;
+	env.has_cfa_offset = state->has_cfa_offset;
+	ARR_RESIZE(callframe_spill_t, env.cfa_spills, state->n_spills);
+	memcpy(env.cfa_spills, state->spills,
+	       state->n_spills * sizeof(env.cfa_spills[0]));
+}
+
+void be_dwarf_block_begin(const ir_node *block)
+{
+	if (debug_level < LEVEL_FRAMEINFO || !env.cur_split)
+		return;
+	if (env.cur_block != NULL)
+		pmap_insert(env.block_exits, env.cur_block, save_callframe_state());
+	env.cur_block = block;
+}
+
+void be_dwarf_method_cold_begin(void)
+{
+	/* the cold fragment lives in another section */
+	env.last_loc = 0;
+	if (debug_level < LEVEL_FRAMEINFO)
+		return;
+	be_emit_cstring("\t.cfi_startproc\n");
+	be_emit_write_line();
+
+	/* the cold block is entered with the description at the end of its hot
+	 * predecessors, not the one after the last hot block */
+	const ir_node *block = env.cur_block;
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		const ir_node     *pred  = get_Block_cfgpred_block(block, i);
+		callframe_state_t *state
+			= pmap_get(callframe_state_t, env.block_exits, pred);
+		if (state != NULL) {
+			restore_callframe_state(state);
+			break;
+		}
+	}
+
+	/* the new FDE starts with the state of the CIE, the cold blocks run
+	 * with the frame set up by the hot part */
+	if (env.cfa_register != NULL)
+		emit_callframe_register(env.cfa_register);
+	if (env.has_cfa_offset)
+		emit_callframe_offset(env.cfa_offset);
+	for (size_t i = 0, n = ARR_LEN(env.cfa_spills); i < n; ++i) {
+		emit_callframe_save(&env.cfa_spills[i]);
+	}
+}
+
+void be_dwarf_method_end(void)
+{
+	if (debug_level < LEVEL_BASIC)
+		return;
+	const ir_entity *entity = env.cur_ent;
+	be_emit_irprintf("%smethod_%s_%s:\n", be_gas_get_private_prefix(),
+	                 env.cur_split ? "cold_end" : "end",
+	                 get_entity_ld_name(entity));
+
+	if (debug_level >= LEVEL_FRAMEINFO) {
+		be_emit_cstring("\t.cfi_endproc\n");
+		be_emit_write_line();
+		if (env.cur_split) {
+			pmap_destroy(env.block_exits);
+			obstack_free(&env.callframe_obst, NULL);
+		}
+	}
+}
+
+/**
+ * Emits the address ranges of the methods with a cold fragment: the hot part
+ * starting at the method entity and the cold fragment.
+ */
+static void emit_ranges(void)
+{
+	size_t n_split = ARR_LEN(env.split_list);
+	if (n_split == 0)
+		return;
+
+	be_gas_emit_switch_section(GAS_SECTION_DEBUG_RANGES);
+	const char *prefix = be_gas_get_private_prefix();
+	for (size_t i = 0; i < n_split; ++i) {
+		const ir_entity *entity  = env.split_list[i];
+		const char      *ld_name = get_entity_ld_name(entity);
+		be_emit_irprintf("%sranges_%s:\n", prefix, ld_name);
+		be_emit_write_line();
+		emit_ref(entity);
+		be_emit_irprintf("\t.long %smethod_end_%s\n", prefix, ld_name);
+		be_emit_write_line();
+		be_emit_cstring("\t.long ");
+		be_gas_emit_cold_fragment(entity);
+		be_emit_char('\n');
+		be_emit_write_line();
+		be_emit_irprintf("\t.long %smethod_cold_end_%s\n", prefix, ld_name);
+		be_emit_write_line();
+		/* end of list */
+		emit_int32(0);
+		emit_int32(0);
+	}
+}
+
 static void emit_base_type_abbrev(void)
 {
 	begin_abbrev(abbrev_base_type, DW_TAG_base_type, DW_CHILDREN_no);
@@ -916,6 +1220,7 @@ void be_dwarf_unit_end(void)
 
 	emit_line_info();
 	emit_pubnames();
+	emit_ranges();
 }
 
 void be_dwarf_close(void)
@@ -924,7 +1229,10 @@ void be_dwarf_close(void)
 		return;
 	pmap_destroy(env.file_map);
 	DEL_ARR_F(env.file_list);
+	DEL_ARR_F(env.file_nums);
 	DEL_ARR_F(env.pubnames_list);
+	DEL_ARR_F(env.split_list);
+	DEL_ARR_F(env.cfa_spills);
 	pset_new_destroy(&env.emitted_types);
 }
 
@@ -935,7 +1243,11 @@ void be_dwarf_open(void)
 		return;
 	env.file_map      = pmap_create();
 	env.file_list     = NEW_ARR_F(const char*, 0);
+	env.file_nums     = NEW_ARR_F(unsigned, 0);
+	env.last_loc      = 0;
 	env.pubnames_list = NEW_ARR_F(const ir_entity*, 0);
+	env.split_list    = NEW_ARR_F(const ir_entity*, 0);
+	env.cfa_spills    = NEW_ARR_F(callframe_spill_t, 0);
 	pset_new_init(&env.emitted_types);
 }
 
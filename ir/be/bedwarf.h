@@ -11,6 +11,8 @@
 #ifndef FIRM_BE_BEDWARF_H
 #define FIRM_BE_BEDWARF_H
 
+#include <stdbool.h>
+
 #include "beabi.h"
 
 typedef struct parameter_dbg_info_t {
@@ -30,13 +32,26 @@ void be_dwarf_unit_begin(const char *filename);
 /** end compilation unit */
 void be_dwarf_unit_end(void);
 
-/** output debug info necessary right before defining a method */
+/** output debug info necessary right before defining a method, a method
+ * with a cold fragment gets an address range list instead of a pc range */
 void be_dwarf_method_before(const ir_entity *ent,
-                            const parameter_dbg_info_t *infos);
+                            const parameter_dbg_info_t *infos,
+                            bool has_cold_fragment);
 
 /** output debug info right before beginning to output assembly instructions */
 void be_dwarf_method_begin(void);
 
+/** debug info at the end of the hot part of a method with a cold fragment,
+ * emitted before switching to the cold section */
+void be_dwarf_method_hot_end(void);
+
+/** called at the beginning of each block of a method, before its label */
+void be_dwarf_block_begin(const ir_node *block);
+
+/** output debug info right after the label of the cold fragment, the
+ * fragment gets a callframe description of its own */
+void be_dwarf_method_cold_begin(void);
+
 /** debug for a method end */
 void be_dwarf_method_end(void);
 
@@ -62,4 +77,19 @@ void be_dwarf_callframe_offset(int offset);
  */
 void be_dwarf_callframe_spilloffset(const arch_register_t *reg, int offset);
 
+/**
+ * Indicate that the value of the caller saved register @p reg is kept in the
+ * register @p in_reg.
+ */
+void be_dwarf_callframe_copy(const arch_register_t *reg,
+                             const arch_register_t *in_reg);
+
+/**
+ * Indicate that the register @p reg holds the value of the caller again.
+ */
+void be_dwarf_callframe_restore(const arch_register_t *reg);
+
+/** Returns whether callframe information is emitted. */
+bool be_dwarf_has_callframe_info(void);
+
 #endif
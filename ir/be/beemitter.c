@@ -9,6 +9,8 @@
  * @author      Matthias Braun
  * @date        12.03.2007
  */
+#include <string.h>
+
 #include "bedwarf.h"
 #include "beemitter.h"
 #include "be_t.h"
@@ -17,19 +19,36 @@
 #include "irprintf.h"
 #include "ident.h"
 #include "tv.h"
-#include "dbginfo.h"
+#include "dbginfo_t.h"
+
+/** size of the buffer collecting finished lines before they are written */
+#define EMIT_BUFFER_SIZE (64 * 1024)
 
 FILE           *emit_file;
 struct obstack  emit_obst;
 
+static char   emit_buffer[EMIT_BUFFER_SIZE];
+static size_t emit_buffer_len;
+static size_t emit_n_lines;
+
+static void flush_emit_buffer(void)
+{
+	/* without a file (JIT compilation) the assembler output is discarded */
+	if (emit_file != NULL)
+		fwrite(emit_buffer, 1, emit_buffer_len, emit_file);
+	emit_buffer_len = 0;
+}
+
 void be_emit_init(FILE *file)
 {
 	emit_file       = file;
+	emit_buffer_len = 0;
 	obstack_init(&emit_obst);
 }
 
 void be_emit_exit(void)
 {
+	flush_emit_buffer();
 	obstack_free(&emit_obst, NULL);
 }
 
@@ -47,13 +66,63 @@ void be_emit_irprintf(const char *fmt, ...)
 	va_end(ap);
 }
 
+void be_emit_uint(unsigned long value)
+{
+	char  buf[sizeof(value) * 3];
+	char *end = buf + sizeof(buf);
+	char *p   = end;
+	do {
+		*--p   = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	be_emit_string_len(p, end - p);
+}
+
+void be_emit_int(long value)
+{
+	if (value < 0) {
+		be_emit_char('-');
+		/* negate as unsigned to handle LONG_MIN */
+		be_emit_uint(-(unsigned long)value);
+	} else {
+		be_emit_uint(value);
+	}
+}
+
+void be_emit_hex(unsigned long value)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	char  buf[sizeof(value) * 2];
+	char *end = buf + sizeof(buf);
+	char *p   = end;
+	do {
+		*--p    = digits[value & 0xF];
+		value >>= 4;
+	} while (value != 0);
+	be_emit_string_len(p, end - p);
+}
+
 void be_emit_write_line(void)
 {
 	size_t  len  = obstack_object_size(&emit_obst);
 	char   *line = (char*)obstack_finish(&emit_obst);
 
-	fwrite(line, 1, len, emit_file);
+	if (len > EMIT_BUFFER_SIZE - emit_buffer_len)
+		flush_emit_buffer();
+	if (len >= EMIT_BUFFER_SIZE) {
+		if (emit_file != NULL)
+			fwrite(line, 1, len, emit_file);
+	} else {
+		memcpy(emit_buffer + emit_buffer_len, line, len);
+		emit_buffer_len += len;
+	}
 	obstack_free(&emit_obst, line);
+	++emit_n_lines;
+}
+
+size_t be_emit_get_n_lines(void)
+{
+	return emit_n_lines;
 }
 
 void be_emit_pad_comment(void)
@@ -67,9 +136,6 @@ void be_emit_pad_comment(void)
 
 void be_emit_finish_line_gas(const ir_node *node)
 {
-	dbg_info  *dbg;
-	src_loc_t  loc;
-
 	if (node == NULL || !be_options.verbose_asm) {
 		be_emit_char('\n');
 		be_emit_write_line();
@@ -80,14 +146,18 @@ void be_emit_finish_line_gas(const ir_node *node)
 	be_emit_cstring("/* ");
 	be_emit_irprintf("%+F ", node);
 
-	dbg = get_irn_dbg_info(node);
-	loc = ir_retrieve_dbg_info(dbg);
-	if (loc.file) {
-		be_emit_string(loc.file);
-		if (loc.line != 0) {
-			be_emit_irprintf(":%u", loc.line);
-			if (loc.column != 0) {
-				be_emit_irprintf(":%u", loc.column);
+	packed_src_loc_t const loc
+		= ir_retrieve_packed_dbg_info(get_irn_dbg_info(node));
+	if (loc != 0) {
+		unsigned const line   = packed_src_loc_line(loc);
+		unsigned const column = packed_src_loc_column(loc);
+		be_emit_string(ir_get_src_file(packed_src_loc_file_id(loc)));
+		if (line != 0) {
+			be_emit_char(':');
+			be_emit_uint(line);
+			if (column != 0) {
+				be_emit_char(':');
+				be_emit_uint(column);
 			}
 		}
 	}
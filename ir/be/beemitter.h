@@ -63,10 +63,28 @@ static inline void be_emit_string(const char *str)
 #define be_emit_cstring(str) \
 	be_emit_string_len(str, sizeof(str) - 1)
 
+/**
+ * Emit an unsigned integer in decimal notation. Unlike be_emit_irprintf()
+ * this does not parse a format string.
+ */
+void be_emit_uint(unsigned long value);
+
+/**
+ * Emit a signed integer in decimal notation.
+ */
+void be_emit_int(long value);
+
+/**
+ * Emit an unsigned integer in hexadecimal notation with uppercase digits and
+ * without a 0x prefix.
+ */
+void be_emit_hex(unsigned long value);
+
 /**
  * Initializes an emitter environment.
  *
- * @param F    a file handle where the emitted file is written to.
+ * @param F    a file handle where the emitted file is written to or NULL to
+ *             discard the output.
  */
 void be_emit_init(FILE *F);
 
@@ -91,9 +109,18 @@ void be_emit_irvprintf(const char *fmt, va_list args);
 
 /**
  * Flush the line in the current line buffer to the emitter file.
+ * Finished lines are collected in a large buffer which is written out when it
+ * is full and in be_emit_exit(), so the file must not be written to directly
+ * while the emitter is active.
  */
 void be_emit_write_line(void);
 
+/**
+ * Returns the number of lines written so far. As every instruction is on a
+ * line of its own, backends use it to bound the size of the emitted code.
+ */
+size_t be_emit_get_n_lines(void);
+
 /**
  * Flush the line in the current line buffer to the emitter file and
  * appends a gas-style comment with the node number and writes the line
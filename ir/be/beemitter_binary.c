@@ -13,9 +13,14 @@
 #include <limits.h>
 
 #include "beemitter_binary.h"
+#include "beemitter.h"
+#include "bejit.h"
 #include "obst.h"
 #include "error.h"
 
+/** maximum number of machine code bytes written with a single directive */
+#define CODE_BYTES_PER_LINE 32
+
 static code_fragment_t *first_fragment;
 static code_fragment_t *last_fragment;
 #ifndef NDEBUG
@@ -24,6 +29,9 @@ static const unsigned CODE_FRAGMENT_MAGIC = 0x4643414d;  /* "CFMA" */
 
 struct obstack code_fragment_obst;
 
+static unsigned char code_bytes[CODE_BYTES_PER_LINE];
+static unsigned      n_code_bytes;
+
 /** returns current fragment (the address stays only valid until the next
     be_emit(8/16/32/entity) call!) */
 code_fragment_t *be_get_current_fragment(void)
@@ -86,18 +94,55 @@ void be_start_new_fragment(void)
 
 static void emit(FILE *file, const unsigned char *buffer, size_t len)
 {
-	size_t i;
-	for (i = 0; i < len; ++i) {
+	size_t i = 0;
+	while (i < len) {
 		size_t i2;
 		fputs("\t.byte ", file);
 		for (i2 = i; i2 < i + 30 && i2 < len; ++i2) {
-			fprintf(file, "0x%02X", (unsigned)buffer[i2]);
+			fprintf(file, i2 == i ? "0x%02X" : ",0x%02X", (unsigned)buffer[i2]);
 		}
 		i = i2;
 		fputs("\n", file);
 	}
 }
 
+void be_emit_code_byte(unsigned char byte)
+{
+	if (be_jit_active()) {
+		be_jit_emit_byte(byte);
+		return;
+	}
+	if (n_code_bytes == CODE_BYTES_PER_LINE)
+		be_flush_code_bytes();
+	code_bytes[n_code_bytes++] = byte;
+}
+
+void be_flush_code_bytes(void)
+{
+	static const char hex[] = "0123456789abcdef";
+	char     buf[CODE_BYTES_PER_LINE * 5];
+	char    *p = buf;
+	unsigned i;
+
+	if (n_code_bytes == 0)
+		return;
+
+	for (i = 0; i < n_code_bytes; ++i) {
+		unsigned char const byte = code_bytes[i];
+		if (i > 0)
+			*p++ = ',';
+		*p++ = '0';
+		*p++ = 'x';
+		*p++ = hex[byte >> 4];
+		*p++ = hex[byte & 0xf];
+	}
+	be_emit_cstring("\t.byte ");
+	be_emit_string_len(buf, p - buf);
+	be_emit_char('\n');
+	be_emit_write_line();
+	n_code_bytes = 0;
+}
+
 static unsigned align(unsigned offset, unsigned alignment)
 {
 	if (offset % alignment != 0) {
@@ -164,11 +209,9 @@ static void determine_offsets(const binary_emiter_interface_t *interface)
 void be_emit_entity(ir_entity *entity, bool entity_sign, int offset,
                     bool is_relative)
 {
-	(void) entity;
-	(void) entity_sign;
-	(void) offset;
-	(void) is_relative;
-	panic("not implemented yet");
+	if (!be_jit_active())
+		panic("entity references are only supported in JIT mode");
+	be_jit_emit_entity(entity, entity_sign, offset, is_relative);
 }
 
 void be_emit_code(FILE *output, const binary_emiter_interface_t *interface)
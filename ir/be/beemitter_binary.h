@@ -105,7 +105,34 @@ static inline void be_emit32(const uint32_t u32)
 	obstack_grow(&code_fragment_obst, &u32, 4);
 }
 
-/** leave space where an entity reference is put at the finish stage */
+/**
+ * Appends a byte of machine code to the assembler output. Consecutive bytes
+ * are collected and written as a single .byte directive, so
+ * be_flush_code_bytes() must be called before anything else is emitted.
+ */
+void be_emit_code_byte(unsigned char byte);
+
+/** appends a word (16bits) of machine code in little endian byte order */
+static inline void be_emit_code16(uint16_t u16)
+{
+	be_emit_code_byte((unsigned char)u16);
+	be_emit_code_byte((unsigned char)(u16 >> 8));
+}
+
+/** appends a dword (32bits) of machine code in little endian byte order */
+static inline void be_emit_code32(uint32_t u32)
+{
+	be_emit_code16((uint16_t)u32);
+	be_emit_code16((uint16_t)(u32 >> 16));
+}
+
+/** writes all collected machine code bytes to the assembler output */
+void be_flush_code_bytes(void);
+
+/**
+ * Leave space where an entity reference is put at the finish stage. Only
+ * available while emitting into a JIT buffer.
+ */
 void be_emit_entity(ir_entity *entity, bool entity_sign, int offset,
                     bool is_relative);
 
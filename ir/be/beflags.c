@@ -26,6 +26,7 @@
 #include "irnode_t.h"
 #include "irtools.h"
 #include "ircons.h"
+#include "irgmod.h"
 #include "iredges_t.h"
 #include "error.h"
 
@@ -42,6 +43,7 @@ static const arch_register_class_t *flag_class;
 static const arch_register_t       *flags_reg;
 static func_rematerialize           remat;
 static check_modifies_flags         check_modify;
+static func_preserve_flags          preserve;
 static int                          changed;
 
 static ir_node *default_remat(ir_node *node, ir_node *after)
@@ -118,6 +120,78 @@ static bool can_move(ir_node *node, ir_node *after)
 	return true;
 }
 
+/**
+ * tests whether node node can be moved in front of node before, that is
+ * whether all its operands are available there
+ * (only works for nodes in same block)
+ */
+static bool can_move_before(ir_node *node, ir_node *before)
+{
+	ir_node *block = get_nodes_block(before);
+	if (get_nodes_block(node) != block || get_irn_mode(node) == mode_T
+	    || be_is_Keep(node) || get_irn_deps(node) > 0
+	    || get_irn_n_edges_kind(node, EDGE_KIND_DEP) > 0)
+		return false;
+
+	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+		ir_node *op = skip_Proj(get_irn_n(node, i));
+		if (get_nodes_block(op) != block || !sched_is_scheduled(op))
+			continue;
+		if (!sched_comes_after(op, before))
+			return false;
+	}
+	return true;
+}
+
+static bool needs_flags(const ir_node *node)
+{
+	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+		const arch_register_req_t *req = arch_get_irn_register_req_in(node, i);
+		if (req->cls == flag_class)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Tries to remove the flag destroying node clobber from between the producer
+ * flags_needed and its consumers without duplicating the producer. This is
+ * done by replacing clobber with a variant leaving the flags alone or by
+ * scheduling it in front of the producer.
+ *
+ * @return true if the flags survive clobber now
+ */
+static bool avoid_clobber(ir_node *flags_needed, ir_node *clobber)
+{
+	/* moving the producer down is handled by rematerialize_or_move() */
+	if (needs_flags(clobber)
+	    || (get_nodes_block(flags_needed) == get_nodes_block(clobber)
+	        && can_move(flags_needed, clobber)))
+		return false;
+
+	ir_node *replacement = preserve != NULL ? preserve(clobber) : NULL;
+	if (replacement != NULL) {
+		ir_graph *irg = get_irn_irg(clobber);
+		be_lv_t  *lv  = be_get_irg_liveness(irg);
+		if (lv != NULL)
+			be_liveness_remove(lv, clobber);
+		sched_replace(clobber, replacement);
+		exchange(clobber, replacement);
+		if (lv != NULL)
+			be_liveness_introduce(lv, replacement);
+		changed = 1;
+		return true;
+	}
+
+	if (get_nodes_block(flags_needed) == get_nodes_block(clobber)
+	    && can_move_before(clobber, flags_needed)) {
+		sched_remove(clobber);
+		sched_add_before(flags_needed, clobber);
+		return true;
+	}
+	return false;
+}
+
 static void rematerialize_or_move(ir_node *flags_needed, ir_node *node,
                                   ir_node *flag_consumers, int pn)
 {
@@ -192,11 +266,14 @@ static void fix_flags_walker(ir_node *block, void *env)
 	(void) env;
 
 	ir_node *place = block;
-	sched_foreach_reverse(block, node) {
+	for (ir_node *node = sched_last(block), *prev; !sched_is_begin(node);
+	     node = prev) {
 		int i, arity;
 		ir_node *new_flags_needed = NULL;
 		ir_node *test;
 
+		prev = sched_prev(node);
+
 		if (is_Phi(node)) {
 			place = node;
 			break;
@@ -214,10 +291,19 @@ static void fix_flags_walker(ir_node *block, void *env)
 			test = sched_prev(test);
 
 		if (flags_needed != NULL && check_modify(test)) {
-			/* rematerialize */
-			rematerialize_or_move(flags_needed, node, flag_consumers, pn);
-			flags_needed   = NULL;
-			flag_consumers = NULL;
+			ir_node *test_prev = sched_prev(test);
+			if (avoid_clobber(flags_needed, test)) {
+				/* continue above the old place of test, a moved test is
+				 * visited again in front of the producer */
+				prev = test_prev;
+				if (test == node)
+					continue;
+			} else {
+				/* rematerialize */
+				rematerialize_or_move(flags_needed, node, flag_consumers, pn);
+				flags_needed   = NULL;
+				flag_consumers = NULL;
+			}
 		}
 
 		/* test whether the current node needs flags */
@@ -274,12 +360,14 @@ static void fix_flags_walker(ir_node *block, void *env)
 
 void be_sched_fix_flags(ir_graph *irg, const arch_register_class_t *flag_cls,
                         func_rematerialize remat_func,
-                        check_modifies_flags check_modifies_flags_func)
+                        check_modifies_flags check_modifies_flags_func,
+                        func_preserve_flags preserve_flags_func)
 {
 	flag_class   = flag_cls;
 	flags_reg    = & flag_class->regs[0];
 	remat        = remat_func;
 	check_modify = check_modifies_flags_func;
+	preserve     = preserve_flags_func;
 	changed      = 0;
 	if (remat == NULL)
 		remat = &default_remat;
@@ -23,15 +23,25 @@ typedef ir_node * (*func_rematerialize) (ir_node *node, ir_node *after);
  */
 typedef bool (*check_modifies_flags) (const ir_node *node);
 
+/**
+ * Callback which creates a node computing the same value as a flags modifying
+ * node but leaving the flags alone, like lea instead of add on x86. Returns
+ * NULL if there is no such node. The new node is not scheduled yet.
+ */
+typedef ir_node * (*func_preserve_flags) (ir_node *node);
+
 /**
  * Walks the schedule and ensures that flags aren't destroyed between producer
  * and consumer of flags. It does so by moving down/rematerialising of the
  * nodes. This does not work across blocks.
+ * Before rematerialising, a flags destroying node in between is replaced using
+ * @p preserve_flags_func or scheduled in front of the producer if possible.
  * The callback functions may be NULL if you want to use default
- * implementations.
+ * implementations, there is no default for @p preserve_flags_func.
  */
 void be_sched_fix_flags(ir_graph *irg, const arch_register_class_t *flag_cls,
                         func_rematerialize remat_func,
-                        check_modifies_flags check_modifies_flags_func);
+                        check_modifies_flags check_modifies_flags_func,
+                        func_preserve_flags preserve_flags_func);
 
 #endif
@@ -29,6 +29,8 @@
 #include "bearch.h"
 #include "beemitter.h"
 #include "bedwarf.h"
+#include "beirg.h"
+#include "bejit.h"
 
 /** by default, we generate assembler code for the Linux gas */
 object_file_format_t  be_gas_object_file_format = OBJECT_FILE_FORMAT_ELF;
@@ -78,6 +80,8 @@ static void emit_section_macho(be_gas_section_t section)
 		case GAS_SECTION_DEBUG_LINE:      name = "section __DWARF,__debug_line,regular,debug"; break;
 		case GAS_SECTION_DEBUG_PUBNAMES:  name = "section __DWARF,__debug_pubnames,regular,debug"; break;
 		case GAS_SECTION_DEBUG_FRAME:     name = "section __DWARF,__debug_frame,regular,debug"; break;
+		case GAS_SECTION_TEXT_UNLIKELY:   name = "section __TEXT,__text_cold,regular,pure_instructions"; break;
+		case GAS_SECTION_DEBUG_RANGES:    name = "section __DWARF,__debug_ranges,regular,debug"; break;
 		default: panic("unsupported scetion type 0x%X", section);
 		}
 	} else if (flags & GAS_SECTION_FLAG_COMDAT) {
@@ -116,8 +120,10 @@ static void emit_section_sparc(be_gas_section_t section,
 		"debug_info",
 		"debug_abbrev",
 		"debug_line",
-		"debug_pubnames"
+		"debug_pubnames",
 		"debug_frame",
+		"text.unlikely",
+		"debug_ranges",
 	};
 
 	if (current_section == section && !(section & GAS_SECTION_FLAG_COMDAT))
@@ -185,6 +191,8 @@ static void emit_section(be_gas_section_t section, const ir_entity *entity)
 		{ "debug_line",     "progbits", ""   },
 		{ "debug_pubnames", "progbits", ""   },
 		{ "debug_frame",    "progbits", ""   },
+		{ "text.unlikely",  "progbits", "ax" },
+		{ "debug_ranges",   "progbits", ""   },
 	};
 
 	if (be_gas_object_file_format == OBJECT_FILE_FORMAT_MACH_O) {
@@ -344,6 +352,8 @@ static bool initializer_is_null(const ir_initializer_t *initializer)
 		}
 		return true;
 	}
+	case IR_INITIALIZER_BYTES:
+		return false;
 	}
 	panic("invalid initializer in initializer_is_null");
 }
@@ -485,9 +495,15 @@ static void emit_visibility(const ir_entity *entity)
 void be_gas_emit_function_prolog(const ir_entity *entity, unsigned po2alignment,
                                  const parameter_dbg_info_t *parameter_infos)
 {
-	be_dwarf_method_before(entity, parameter_infos);
+	ir_graph const *const irg  = get_entity_irg(entity);
+	be_irg_t const *const birg = irg != NULL ? be_birg_from_irg(irg) : NULL;
+	be_dwarf_method_before(entity, parameter_infos,
+	                       birg != NULL && birg->cold_block != NULL);
 
 	be_gas_section_t section = determine_section(NULL, entity);
+	/* functions the profile never saw executing go to the cold section */
+	if (section == GAS_SECTION_TEXT && birg != NULL && birg->cold)
+		section = GAS_SECTION_TEXT_UNLIKELY;
 	emit_section(section, entity);
 
 	/* write the begin line (makes the life easier for scripts parsing the
@@ -548,10 +564,19 @@ void be_gas_emit_function_epilog(const ir_entity *entity)
 	be_dwarf_method_end();
 
 	if (be_gas_object_file_format == OBJECT_FILE_FORMAT_ELF) {
-		be_emit_cstring("\t.size\t");
-		be_gas_emit_entity(entity);
-		be_emit_cstring(", .-");
-		be_gas_emit_entity(entity);
+		/* the size of the hot part was emitted before the cold fragment */
+		ir_graph const *const irg = get_entity_irg(entity);
+		if (irg != NULL && be_birg_from_irg(irg)->cold_block != NULL) {
+			be_emit_cstring("\t.size\t");
+			be_gas_emit_cold_fragment(entity);
+			be_emit_cstring(", .-");
+			be_gas_emit_cold_fragment(entity);
+		} else {
+			be_emit_cstring("\t.size\t");
+			be_gas_emit_entity(entity);
+			be_emit_cstring(", .-");
+			be_gas_emit_entity(entity);
+		}
 		be_emit_char('\n');
 		be_emit_write_line();
 	}
@@ -729,65 +754,128 @@ static void emit_size_type(size_t size)
 	}
 }
 
-static void emit_string_char(int c)
+/** Maximum number of characters put into a single string directive. */
+#define STRING_CHUNK_SIZE 256
+
+static bool char_needs_escape(unsigned char c)
 {
-	switch (c) {
-	case '"' : be_emit_cstring("\\\""); break;
-	case '\n': be_emit_cstring("\\n"); break;
-	case '\r': be_emit_cstring("\\r"); break;
-	case '\t': be_emit_cstring("\\t"); break;
-	case '\\': be_emit_cstring("\\\\"); break;
-	default  :
-		if (isprint(c))
-			be_emit_char(c);
-		else
-			be_emit_irprintf("\\%03o", c);
-		break;
+	return !isprint(c) || c == '"' || c == '\\';
+}
+
+/**
+ * Emits the characters of a string literal. Runs of characters without
+ * escape sequences are copied to the output at once.
+ */
+static void emit_string_chars(const unsigned char *str, size_t len)
+{
+	const unsigned char *run = str;
+	const unsigned char *end = str + len;
+	for (const unsigned char *c = str; c != end; ++c) {
+		if (!char_needs_escape(*c))
+			continue;
+		be_emit_string_len((const char*)run, c - run);
+		run = c + 1;
+
+		switch (*c) {
+		case '"' : be_emit_cstring("\\\""); break;
+		case '\n': be_emit_cstring("\\n"); break;
+		case '\r': be_emit_cstring("\\r"); break;
+		case '\t': be_emit_cstring("\\t"); break;
+		case '\\': be_emit_cstring("\\\\"); break;
+		default: {
+			/* always use 3 digits, so a following digit cannot be mistaken as
+			 * part of the escape sequence */
+			char const octal[] = {
+				'\\', '0' + (*c >> 6), '0' + (*c >> 3 & 7), '0' + (*c & 7)
+			};
+			be_emit_string_len(octal, sizeof(octal));
+			break;
+		}
+		}
 	}
+	be_emit_string_len((const char*)run, end - run);
 }
 
-static size_t emit_string_initializer(const ir_initializer_t *initializer)
+/**
+ * Emits @p len characters as .ascii directives of at most STRING_CHUNK_SIZE
+ * characters. If @p zero_terminated is set the last directive is an .asciz
+ * adding the terminating zero.
+ */
+static void emit_string_data(const unsigned char *str, size_t len,
+                             bool zero_terminated)
 {
-	be_emit_cstring("\t.asciz \"");
+	if (len == 0 && !zero_terminated)
+		return;
+	do {
+		size_t chunk = MIN(len, (size_t)STRING_CHUNK_SIZE);
+		if (chunk == len && zero_terminated) {
+			be_emit_cstring("\t.asciz \"");
+		} else {
+			be_emit_cstring("\t.ascii \"");
+		}
+		emit_string_chars(str, chunk);
+		be_emit_cstring("\"\n");
+		be_emit_write_line();
+		str += chunk;
+		len -= chunk;
+	} while (len > 0);
+}
 
-	size_t len = initializer->compound.n_initializers;
+/**
+ * Emits binary data as .byte directives, which is shorter than string
+ * directives consisting mostly of escape sequences.
+ */
+static void emit_byte_data(const unsigned char *data, size_t len)
+{
+	static const size_t BYTES_PER_LINE = 32;
+
+	for (size_t i = 0; i < len; i += BYTES_PER_LINE) {
+		size_t end = MIN(i + BYTES_PER_LINE, len);
+		be_emit_cstring("\t.byte\t");
+		for (size_t b = i; b < end; ++b) {
+			if (b > i)
+				be_emit_char(',');
+			be_emit_uint(data[b]);
+		}
+		be_emit_char('\n');
+		be_emit_write_line();
+	}
+}
+
+static size_t emit_string_initializer(const ir_initializer_t *initializer)
+{
+	size_t         len = initializer->compound.n_initializers;
+	unsigned char *str = XMALLOCN(unsigned char, len);
 	for (size_t i = 0; i < len-1; ++i) {
 		const ir_initializer_t *sub_initializer
 			= get_initializer_compound_value(initializer, i);
 
 		ir_tarval *tv = get_initializer_tarval(sub_initializer);
-		int        c  = get_tarval_long(tv);
-		emit_string_char(c);
+		str[i] = (unsigned char)get_tarval_long(tv);
 	}
-	be_emit_cstring("\"\n");
-	be_emit_write_line();
+	emit_string_data(str, len-1, true);
+	free(str);
 
-	return initializer->compound.n_initializers;
+	return len;
 }
 
 void be_gas_emit_string_literal(const char *string)
 {
 	be_emit_char('"');
-	for (const char *c = string; *c != '\0'; ++c) {
-		emit_string_char(*c);
-	}
+	emit_string_chars((const unsigned char*)string, strlen(string));
 	be_emit_char('"');
 }
 
 void be_gas_emit_cstring(const char *string)
 {
-	be_emit_cstring("\t.asciz \"");
-	for (const char *c = string; *c != '\0'; ++c) {
-		emit_string_char(*c);
-	}
-	be_emit_cstring("\"\n");
-	be_emit_write_line();
+	emit_string_data((const unsigned char*)string, strlen(string), true);
 }
 
 typedef enum normal_or_bitfield_kind {
 	NORMAL = 0,
 	TARVAL,
 	STRING,
+	BYTES,
 	BITFIELD
 } normal_or_bitfield_kind;
 
@@ -799,6 +887,7 @@ typedef struct {
 		ir_tarval              *tarval;
 		unsigned char           bf_val;
 		const ir_initializer_t *string;
+		const ir_initializer_t *bytes;
 	} v;
 } normal_or_bitfield;
 
@@ -812,6 +901,10 @@ static size_t get_initializer_size(const ir_initializer_t *initializer,
 	case IR_INITIALIZER_CONST:
 	case IR_INITIALIZER_NULL:
 		return get_type_size_bytes(type);
+	case IR_INITIALIZER_BYTES:
+		if (is_Array_type(type) && is_array_variable_size(type))
+			return get_initializer_bytes_size(initializer);
+		return get_type_size_bytes(type);
 	case IR_INITIALIZER_COMPOUND:
 		if (is_Array_type(type)) {
 			if (is_array_variable_size(type)) {
@@ -874,6 +967,7 @@ static void emit_bitfield(normal_or_bitfield *vals, unsigned offset_bits,
 		break;
 	}
 	case IR_INITIALIZER_COMPOUND:
+	case IR_INITIALIZER_BYTES:
 		panic("bitfield initializer is compound");
 	}
 	if (tv == NULL || tv == tarval_bad) {
@@ -959,6 +1053,13 @@ static void emit_ir_initializer(normal_or_bitfield *vals,
 		}
 		return;
 
+	case IR_INITIALIZER_BYTES:
+		assert(vals->kind != BITFIELD);
+		vals->kind    = BYTES;
+		vals->type    = type;
+		vals->v.bytes = initializer;
+		return;
+
 	case IR_INITIALIZER_COMPOUND:
 		if (is_Array_type(type)) {
 			ir_type *element_type = get_array_element_type(type);
@@ -1008,6 +1109,48 @@ static void emit_ir_initializer(normal_or_bitfield *vals,
 	panic("invalid ir_initializer kind found");
 }
 
+/**
+ * Emits the data of a bytes initializer followed by zeros up to @p size
+ * bytes. File backed data is included with .incbin, so the data does not
+ * have to pass through the assembler output.
+ */
+static void emit_bytes_initializer(const ir_initializer_t *initializer,
+                                   size_t size)
+{
+	size_t      n_bytes  = get_initializer_bytes_size(initializer);
+	const char *filename = get_initializer_bytes_file(initializer);
+	if (n_bytes > size)
+		n_bytes = size;
+
+	if (filename != NULL && n_bytes == get_initializer_bytes_size(initializer)) {
+		be_emit_cstring("\t.incbin ");
+		be_gas_emit_string_literal(filename);
+		be_emit_char('\n');
+		be_emit_write_line();
+	} else {
+		/* decide per chunk whether the data looks like text */
+		const unsigned char *data
+			= (const unsigned char*)get_initializer_bytes_data(initializer);
+		for (size_t i = 0; i < n_bytes; i += STRING_CHUNK_SIZE) {
+			size_t len       = MIN(n_bytes - i, (size_t)STRING_CHUNK_SIZE);
+			size_t n_escaped = 0;
+			for (size_t b = i; b < i + len; ++b) {
+				n_escaped += char_needs_escape(data[b]);
+			}
+			if (n_escaped > len / 4) {
+				emit_byte_data(data + i, len);
+			} else {
+				emit_string_data(data + i, len, false);
+			}
+		}
+	}
+
+	if (size > n_bytes) {
+		be_emit_irprintf("\t.space\t%zu, 0\n", size - n_bytes);
+		be_emit_write_line();
+	}
+}
+
 static void emit_tarval_data(ir_type *type, ir_tarval *tv)
 {
 	size_t size = get_type_size_bytes(type);
@@ -1111,6 +1254,12 @@ static void emit_initializer(be_gas_decl_env_t *env, const ir_entity *entity)
 	if (size == 0)
 		return;
 
+	/* stream raw data directly instead of collecting the values per byte */
+	if (get_initializer_kind(initializer) == IR_INITIALIZER_BYTES) {
+		emit_bytes_initializer(initializer, size);
+		return;
+	}
+
 	/*
 	 * In the worst case, every initializer allocates one byte.
 	 * Moreover, initializer might be big, do not allocate on stack.
@@ -1145,6 +1294,10 @@ static void emit_initializer(be_gas_decl_env_t *env, const ir_entity *entity)
 		case STRING:
 			elem_size = emit_string_initializer(vals[k].v.string);
 			break;
+		case BYTES:
+			elem_size = get_initializer_size(vals[k].v.bytes, vals[k].type);
+			emit_bytes_initializer(vals[k].v.bytes, elem_size);
+			break;
 		case BITFIELD:
 			be_emit_irprintf("\t.byte\t%d\n", vals[k].v.bf_val);
 			be_emit_write_line();
@@ -1311,8 +1464,54 @@ void be_gas_emit_block_name(const ir_node *block)
 	}
 }
 
+void be_gas_emit_cold_fragment(const ir_entity *entity)
+{
+	be_gas_emit_entity(entity);
+	be_emit_cstring(".cold");
+}
+
+/**
+ * Ends the hot part of the current function and starts its cold fragment: a
+ * local function symbol in the cold text section.
+ */
+static void emit_cold_fragment_begin(const ir_entity *entity)
+{
+	be_dwarf_method_hot_end();
+	if (be_gas_object_file_format == OBJECT_FILE_FORMAT_ELF) {
+		be_emit_cstring("\t.size\t");
+		be_gas_emit_entity(entity);
+		be_emit_cstring(", .-");
+		be_gas_emit_entity(entity);
+		be_emit_char('\n');
+		be_emit_write_line();
+	}
+
+	be_gas_emit_switch_section(GAS_SECTION_TEXT_UNLIKELY);
+	if (be_gas_object_file_format == OBJECT_FILE_FORMAT_ELF) {
+		be_emit_cstring("\t.type\t");
+		be_gas_emit_cold_fragment(entity);
+		be_emit_cstring(", ");
+		be_emit_char(be_gas_elf_type_char);
+		be_emit_cstring("function\n");
+		be_emit_write_line();
+	}
+	be_gas_emit_cold_fragment(entity);
+	be_emit_cstring(":\n");
+	be_emit_write_line();
+	be_dwarf_method_cold_begin();
+}
+
 void be_gas_begin_block(const ir_node *block, bool needs_label)
 {
+	be_dwarf_block_begin(block);
+
+	ir_graph *const irg = get_Block_irg(block);
+	if (block == be_birg_from_irg(irg)->cold_block) {
+		emit_cold_fragment_begin(get_irg_entity(irg));
+		/* jumps from the hot part always need the label */
+		needs_label = true;
+	}
+
 	if (needs_label) {
 		be_gas_emit_block_name(block);
 		be_emit_char(':');
@@ -1547,6 +1746,17 @@ void be_emit_jump_table(const ir_node *node, const ir_switch_table *table,
 		}
 	}
 
+	if (be_jit_active()) {
+		for (unsigned long i = 0; i < length; ++i) {
+			if (labels[i] == NULL)
+				labels[i] = targets[0];
+		}
+		be_jit_emit_jump_table(entity, labels, length);
+		free(labels);
+		free(targets);
+		return;
+	}
+
 	/* emit table */
 	unsigned pointer_size = get_mode_size_bytes(mode_P);
 	if (entity != NULL) {
@@ -1593,8 +1803,10 @@ void be_gas_begin_compilation_unit(const be_main_env_t *env)
 	be_dwarf_open();
 	be_dwarf_unit_begin(env->cup_name);
 
-	block_numbers = pmap_create();
-	next_block_nr = 0;
+	block_numbers   = pmap_create();
+	next_block_nr   = 0;
+	/* a former unit may have been emitted into the same process */
+	current_section = (be_gas_section_t) -1;
 
 	emit_global_asms();
 }
@@ -32,7 +32,9 @@ typedef enum {
 	GAS_SECTION_DEBUG_LINE,      /**< dwarf debug line */
 	GAS_SECTION_DEBUG_PUBNAMES,  /**< dwarf pub names */
 	GAS_SECTION_DEBUG_FRAME,     /**< dwarf callframe infos */
-	GAS_SECTION_LAST = GAS_SECTION_DEBUG_FRAME,
+	GAS_SECTION_TEXT_UNLIKELY,   /**< text section for rarely executed code */
+	GAS_SECTION_DEBUG_RANGES,    /**< dwarf address ranges */
+	GAS_SECTION_LAST = GAS_SECTION_DEBUG_RANGES,
 	GAS_SECTION_TYPE_MASK    = 0xFF,
 
 	GAS_SECTION_FLAG_TLS     = 1 << 8,  /**< thread local flag */
@@ -88,6 +90,11 @@ char const *be_gas_get_private_prefix(void);
  */
 void be_gas_emit_entity(const ir_entity *entity);
 
+/**
+ * Emits the symbol name of the cold fragment of a function entity.
+ */
+void be_gas_emit_cold_fragment(const ir_entity *entity);
+
 /**
  * Emit (a private) symbol name for a firm block
  */
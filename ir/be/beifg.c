@@ -10,6 +10,7 @@
  * @date        18.11.2005
  */
 #include <stdlib.h>
+#include <string.h>
 
 #include "lc_opts.h"
 #include "lc_opts_enum.h"
@@ -21,6 +22,8 @@
 #include "beifg.h"
 #include "error.h"
 #include "xmalloc.h"
+#include "util.h"
+#include "array.h"
 
 #include "becopystat.h"
 #include "becopyopt.h"
@@ -28,8 +31,17 @@
 #include "bemodule.h"
 #include "beintlive_t.h"
 
+/** Classes with more values do not get an adjacency bit matrix. */
+#define IFG_MATRIX_MAX_NODES 4096
+
 void be_ifg_free(be_ifg_t *self)
 {
+	if (self->adj != NULL) {
+		obstack_free(&self->obst, NULL);
+		free(self->adj);
+		free(self->dense);
+		free(self->matrix);
+	}
 	free(self);
 }
 
@@ -74,11 +86,14 @@ static void find_neighbour_walker(ir_node *block, void *data)
 {
 	neighbours_iter_t *it    = (neighbours_iter_t*)data;
 	struct list_head  *head  = get_block_border_head(it->env, block);
+	be_lv_cls_t       *lvc   = it->env->lv_cls;
 	be_lv_t           *lv    = be_get_irg_liveness(it->env->irg);
 
 	int has_started = 0;
 
-	if (!be_is_live_in(lv, block, it->irn) && block != get_nodes_block(it->irn))
+	bool const live_in = lvc != NULL ? be_lv_cls_is_live_in(lvc, block, it->irn)
+	                                 : be_is_live_in(lv, block, it->irn);
+	if (!live_in && block != get_nodes_block(it->irn))
 		return;
 
 	foreach_border_head(head, b) {
@@ -102,11 +117,24 @@ static void find_neighbour_walker(ir_node *block, void *data)
 	}
 }
 
+static be_ifg_adj_t const *get_adj(const be_ifg_t *ifg, const ir_node *irn)
+{
+	unsigned const idx = get_irn_idx(irn);
+	assert(idx < ifg->n_idx && "node created after materializing the ifg");
+	return &ifg->adj[idx];
+}
+
 static void find_neighbours(const be_ifg_t *ifg, neighbours_iter_t *it, const ir_node *irn)
 {
 	it->env         = ifg->env;
 	it->irn         = irn;
 	it->valid       = 1;
+	it->from_adj    = ifg->adj != NULL;
+	if (it->from_adj) {
+		it->adj = get_adj(ifg, irn);
+		it->pos = 0;
+		return;
+	}
 	ir_nodeset_init(&it->neighbours);
 
 	dom_tree_walk(get_nodes_block(irn), find_neighbour_walker, NULL, it);
@@ -118,12 +146,16 @@ static inline void neighbours_break(neighbours_iter_t *it, int force)
 {
 	(void) force;
 	assert(it->valid == 1);
-	ir_nodeset_destroy(&it->neighbours);
+	if (!it->from_adj)
+		ir_nodeset_destroy(&it->neighbours);
 	it->valid = 0;
 }
 
 static ir_node *get_next_neighbour(neighbours_iter_t *it)
 {
+	if (it->from_adj)
+		return it->pos < it->adj->n ? it->adj->nodes[it->pos++] : NULL;
+
 	ir_node *res = ir_nodeset_iterator_next(&it->iter);
 
 	if (res == NULL) {
@@ -248,6 +280,9 @@ void be_ifg_cliques_break(cliques_iter_t *iter)
 
 int be_ifg_degree(const be_ifg_t *ifg, const ir_node *irn)
 {
+	if (ifg->adj != NULL)
+		return get_adj(ifg, irn)->n;
+
 	neighbours_iter_t it;
 	int degree;
 	find_neighbours(ifg, &it, irn);
@@ -256,10 +291,187 @@ int be_ifg_degree(const be_ifg_t *ifg, const ir_node *irn)
 	return degree;
 }
 
+static size_t matrix_pos(unsigned a, unsigned b)
+{
+	if (a < b) {
+		unsigned const t = a;
+		a = b;
+		b = t;
+	}
+	return (size_t)a * (a - 1) / 2 + b;
+}
+
+bool be_ifg_connected(const be_ifg_t *ifg, const ir_node *a, const ir_node *b)
+{
+	if (a == b)
+		return false;
+
+	if (ifg->adj == NULL) {
+		neighbours_iter_t it;
+		be_ifg_foreach_neighbour(ifg, &it, a, n) {
+			if (n == b) {
+				be_ifg_neighbours_break(&it);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	be_ifg_adj_t const *const adj_a = get_adj(ifg, a);
+	be_ifg_adj_t const *const adj_b = get_adj(ifg, b);
+	if (adj_a->n == 0 || adj_b->n == 0)
+		return false;
+
+	if (ifg->matrix != NULL) {
+		unsigned const da = ifg->dense[get_irn_idx(a)];
+		unsigned const db = ifg->dense[get_irn_idx(b)];
+		return bitset_is_set(ifg->matrix, matrix_pos(da, db));
+	}
+
+	/* binary search in the smaller neighbour array */
+	be_ifg_adj_t const *adj = adj_a;
+	const ir_node      *irn = b;
+	if (adj_b->n < adj_a->n) {
+		adj = adj_b;
+		irn = a;
+	}
+	unsigned const idx = get_irn_idx(irn);
+	unsigned       lo  = 0;
+	unsigned       hi  = adj->n;
+	while (lo < hi) {
+		unsigned const md      = lo + (hi - lo) / 2;
+		unsigned const md_idx  = get_irn_idx(adj->nodes[md]);
+		if (md_idx == idx)
+			return true;
+		if (md_idx < idx)
+			lo = md + 1;
+		else
+			hi = md;
+	}
+	return false;
+}
+
+/** State of the pass collecting the interference edges. */
+typedef struct materialize_env_t {
+	be_ifg_t  *ifg;
+	ir_node ***edges;    /**< neighbours per node index, may contain duplicates */
+	ir_node  **living;   /**< values living at the current border */
+	unsigned  *live_pos; /**< position of a value in living */
+} materialize_env_t;
+
+static void add_edge(materialize_env_t *env, ir_node *a, ir_node *b)
+{
+	unsigned const idx = get_irn_idx(a);
+	if (env->edges[idx] == NULL)
+		env->edges[idx] = NEW_ARR_F(ir_node*, 0);
+	ARR_APP1(ir_node*, env->edges[idx], b);
+}
+
+static void materialize_walker(ir_node *block, void *data)
+{
+	materialize_env_t *env  = (materialize_env_t*)data;
+	struct list_head  *head = get_block_border_head(env->ifg->env, block);
+
+	/* the borders start with the live-in values and end with the live-out
+	 * values, so the set of living values is empty at both ends */
+	assert(ARR_LEN(env->living) == 0);
+	foreach_border_head(head, b) {
+		ir_node *const irn = b->irn;
+		if (b->is_def) {
+			/* a value starting to live interferes with all living ones */
+			for (size_t i = 0, n = ARR_LEN(env->living); i < n; ++i) {
+				ir_node *const other = env->living[i];
+				add_edge(env, irn, other);
+				add_edge(env, other, irn);
+			}
+			env->live_pos[get_irn_idx(irn)] = ARR_LEN(env->living);
+			ARR_APP1(ir_node*, env->living, irn);
+		} else {
+			size_t   const n    = ARR_LEN(env->living);
+			unsigned const pos  = env->live_pos[get_irn_idx(irn)];
+			ir_node *const last = env->living[n - 1];
+			assert(env->living[pos] == irn);
+			env->living[pos] = last;
+			env->live_pos[get_irn_idx(last)] = pos;
+			ARR_SHRINKLEN(env->living, n - 1);
+		}
+	}
+}
+
+static int cmp_node_idx(const void *a, const void *b)
+{
+	ir_node const *const n1 = *(ir_node const *const*)a;
+	ir_node const *const n2 = *(ir_node const *const*)b;
+	return QSORT_CMP(get_irn_idx(n1), get_irn_idx(n2));
+}
+
+void be_ifg_materialize(be_ifg_t *ifg)
+{
+	if (ifg->adj != NULL)
+		return;
+
+	ir_graph *const irg   = ifg->env->irg;
+	unsigned  const n_idx = get_irg_last_idx(irg);
+
+	materialize_env_t env;
+	env.ifg      = ifg;
+	env.edges    = XMALLOCNZ(ir_node**, n_idx);
+	env.living   = NEW_ARR_F(ir_node*, 0);
+	env.live_pos = XMALLOCN(unsigned, n_idx);
+	irg_block_walk_graph(irg, materialize_walker, NULL, &env);
+	DEL_ARR_F(env.living);
+	free(env.live_pos);
+
+	/* sort the neighbours, drop the edges found in several blocks and number
+	 * the nodes having neighbours */
+	obstack_init(&ifg->obst);
+	ifg->adj    = XMALLOCNZ(be_ifg_adj_t, n_idx);
+	ifg->n_idx  = n_idx;
+	ifg->dense  = XMALLOCN(unsigned, n_idx);
+	ifg->matrix = NULL;
+	unsigned n_dense = 0;
+	for (unsigned idx = 0; idx < n_idx; ++idx) {
+		ir_node **const edges = env.edges[idx];
+		if (edges == NULL)
+			continue;
+
+		size_t const n = ARR_LEN(edges);
+		qsort(edges, n, sizeof(*edges), cmp_node_idx);
+		size_t n_unique = 0;
+		for (size_t i = 0; i < n; ++i) {
+			if (n_unique == 0 || edges[n_unique - 1] != edges[i])
+				edges[n_unique++] = edges[i];
+		}
+
+		be_ifg_adj_t *const adj = &ifg->adj[idx];
+		adj->n     = n_unique;
+		adj->nodes = OALLOCN(&ifg->obst, ir_node*, n_unique);
+		memcpy(adj->nodes, edges, n_unique * sizeof(*edges));
+		DEL_ARR_F(edges);
+		ifg->dense[idx] = n_dense++;
+	}
+	free(env.edges);
+
+	if (n_dense > 1 && n_dense <= IFG_MATRIX_MAX_NODES) {
+		ifg->matrix = bitset_malloc(matrix_pos(n_dense, 0));
+		for (unsigned idx = 0; idx < n_idx; ++idx) {
+			be_ifg_adj_t const *const adj = &ifg->adj[idx];
+			for (unsigned i = 0; i < adj->n; ++i) {
+				unsigned const other = get_irn_idx(adj->nodes[i]);
+				bitset_set(ifg->matrix, matrix_pos(ifg->dense[idx], ifg->dense[other]));
+			}
+		}
+	}
+}
+
 be_ifg_t *be_create_ifg(const be_chordal_env_t *env)
 {
 	be_ifg_t *ifg = XMALLOC(be_ifg_t);
-	ifg->env = env;
+	ifg->env    = env;
+	ifg->adj    = NULL;
+	ifg->n_idx  = 0;
+	ifg->dense  = NULL;
+	ifg->matrix = NULL;
 
 	return ifg;
 }
@@ -16,9 +16,24 @@
 #include "bechordal.h"
 #include "irnodeset.h"
 #include "pset.h"
+#include "bitset.h"
+#include "obst.h"
+
+/** The neighbours of a node in a materialized interference graph. */
+typedef struct be_ifg_adj_t {
+	ir_node  **nodes; /**< the neighbours sorted by node index */
+	unsigned   n;     /**< the number of neighbours */
+} be_ifg_adj_t;
 
 struct be_ifg_t {
 	const be_chordal_env_t *env;
+	struct obstack          obst;    /**< holds the materialized graph */
+	be_ifg_adj_t           *adj;     /**< neighbours indexed by node index,
+	                                      NULL if the graph is not materialized */
+	unsigned                n_idx;   /**< length of adj */
+	unsigned               *dense;   /**< dense numbers of the nodes in matrix */
+	bitset_t               *matrix;  /**< triangular adjacency matrix, NULL if
+	                                      the class is too large */
 };
 
 typedef struct nodes_iter_t {
@@ -33,6 +48,9 @@ typedef struct neighbours_iter_t {
 	const be_chordal_env_t *env;
 	const ir_node        *irn;
 	int                   valid;
+	bool                  from_adj;  /**< iterating a materialized graph */
+	be_ifg_adj_t const   *adj;
+	unsigned              pos;
 	ir_nodeset_t          neighbours;
 	ir_nodeset_iterator_t iter;
 } neighbours_iter_t;
@@ -60,6 +78,25 @@ int      be_ifg_cliques_next(cliques_iter_t *iter);
 void     be_ifg_cliques_break(cliques_iter_t *iter);
 int      be_ifg_degree(const be_ifg_t *ifg, const ir_node *irn);
 
+/**
+ * Check whether two nodes interfere, i.e. are neighbours in the graph.
+ */
+bool     be_ifg_connected(const be_ifg_t *ifg, const ir_node *a,
+                          const ir_node *b);
+
+/**
+ * Materialize the interference graph.
+ *
+ * By default the neighbours of a node are recomputed from the border lists
+ * on every query, which costs a dominance tree walk each time but no memory.
+ * Copy minimization algorithms query the graph so often that they should
+ * call this first: It collects all edges in one pass into sorted adjacency
+ * arrays and, for classes with not too many values, a bit matrix answering
+ * be_ifg_connected() in constant time. Calling it again does nothing.
+ * The graph must not be queried for nodes created afterwards.
+ */
+void     be_ifg_materialize(be_ifg_t *ifg);
+
 #define be_ifg_foreach_neighbour(ifg, iter, irn, pos) \
 	for (ir_node *pos = be_ifg_neighbours_begin(ifg, iter, irn); pos; pos = be_ifg_neighbours_next(iter))
 
@@ -34,7 +34,7 @@ void be_info_new_node(ir_graph *irg, ir_node *node)
 		return;
 
 	obst = be_get_be_obst(irg);
-	info = OALLOCZ(obst, backend_info_t);
+	info = OALLOCZ(&be_birg_from_irg(irg)->info_obst, backend_info_t);
 
 	assert(node->backend_info == NULL);
 	node->backend_info = info;
@@ -173,6 +173,32 @@ static void sched_edge_hook(FILE *F, const ir_node *irn)
 	}
 }
 
+static void move_info(ir_node *node, struct obstack *obst)
+{
+	backend_info_t *info = OALLOC(obst, backend_info_t);
+	*info = *be_get_info(node);
+	node->backend_info = info;
+}
+
+static void compact_block_infos(ir_node *block, void *data)
+{
+	struct obstack *obst = (struct obstack*)data;
+
+	move_info(block, obst);
+	sched_foreach(block, node) {
+		move_info(node, obst);
+	}
+}
+
+void be_info_compact(ir_graph *irg)
+{
+	/* Nothing but backend infos lives on the info obstack, so the copies are
+	 * placed one after another. The old records stay until the birg is freed,
+	 * nodes outside of the schedule keep using them. */
+	struct obstack *obst = &be_birg_from_irg(irg)->info_obst;
+	irg_block_walk_graph(irg, compact_block_infos, NULL, obst);
+}
+
 void be_info_init_irg(ir_graph *irg)
 {
 	add_irg_constraints(irg, IR_GRAPH_CONSTRAINT_BACKEND);
@@ -49,6 +49,12 @@ void be_info_free(void);
 void be_info_init_irg(ir_graph *irg);
 void be_info_new_node(ir_graph *irg, ir_node *node);
 
+/**
+ * Copies the backend infos of all scheduled nodes in schedule order to fresh
+ * memory, so walking a schedule touches consecutive records.
+ */
+void be_info_compact(ir_graph *irg);
+
 int be_nodes_equal(const ir_node *node1, const ir_node *node2);
 
 #endif
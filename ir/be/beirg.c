@@ -12,7 +12,9 @@
 #include "execfreq.h"
 #include "beirg.h"
 #include "absgraph.h"
-#include "belive.h"
+#include "belive_t.h"
+#include "besched.h"
+#include "statev_t.h"
 
 void be_invalidate_live_sets(ir_graph *irg)
 {
@@ -43,10 +45,33 @@ void be_free_birg(ir_graph *irg)
 	be_irg_t *birg = be_birg_from_irg(irg);
 
 	if (birg->lv != NULL) {
+		stat_ev_int("be_lv_chk_builds", birg->lv->n_chk_builds);
+		stat_ev_int("be_lv_chk_reuses", birg->lv->n_chk_reuses);
 		be_liveness_free(birg->lv);
 		birg->lv = NULL;
 	}
 
+	if (birg->sched_frozen)
+		sched_thaw(irg);
+
+	obstack_free(&birg->info_obst, NULL);
 	obstack_free(&birg->obst, NULL);
 	irg->be_data = NULL;
 }
+
+size_t be_get_birg_memory_used(const ir_graph *irg)
+{
+	be_irg_t *birg = be_birg_from_irg(irg);
+	if (birg == NULL)
+		return 0;
+	return (size_t)obstack_memory_used(&birg->obst)
+	     + (size_t)obstack_memory_used(&birg->info_obst);
+}
+
+size_t be_get_irg_liveness_memory_used(const ir_graph *irg)
+{
+	be_irg_t *birg = be_birg_from_irg(irg);
+	if (birg == NULL || birg->lv == NULL)
+		return 0;
+	return be_liveness_memory_used(birg->lv);
+}
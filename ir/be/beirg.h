@@ -16,6 +16,7 @@
 #include "be_types.h"
 #include "be_t.h"
 #include "irtypes.h"
+#include "irnodemap.h"
 
 void be_assure_live_sets(ir_graph *irg);
 void be_assure_live_chk(ir_graph *irg);
@@ -36,6 +37,18 @@ void be_invalidate_live_chk(ir_graph *irg);
  */
 void be_free_birg(ir_graph *irg);
 
+/**
+ * Returns the number of bytes allocated on the birg obstack, which holds the
+ * backend info of the nodes. Returns 0 if the backend has no data for @p irg.
+ */
+size_t be_get_birg_memory_used(const ir_graph *irg);
+
+/**
+ * Returns the number of bytes allocated for the liveness information of
+ * @p irg.
+ */
+size_t be_get_irg_liveness_memory_used(const ir_graph *irg);
+
 /** The number of parts of the stack layout. */
 #define N_FRAME_TYPES 3
 
@@ -77,7 +90,22 @@ typedef struct be_irg_t {
 	                                                  register constraints which we can't keep
 	                                                  in the irg obst, because it gets replaced
 	                                                  during code selection) */
+	struct obstack             info_obst;        /**< backend_info_t records of
+	                                                  the nodes, kept apart from
+	                                                  other allocations */
 	void                      *isa_link;         /**< architecture specific per-graph data*/
+	bool                       cold;             /**< the profile shows the graph is
+	                                                  never executed */
+	ir_node                   *cold_block;       /**< first block of the cold
+	                                                  fragment in the block
+	                                                  schedule, NULL if the graph
+	                                                  is not split */
+	bool                       verify;           /**< run the verifiers on the
+	                                                  graph */
+	bool                       sched_frozen;     /**< the schedule may not be
+	                                                  changed anymore */
+	ir_nodemap                 sched_arrays;     /**< maps blocks to their
+	                                                  frozen schedule */
 } be_irg_t;
 
 static inline be_irg_t *be_birg_from_irg(const ir_graph *irg)
@@ -85,6 +113,12 @@ static inline be_irg_t *be_birg_from_irg(const ir_graph *irg)
 	return (be_irg_t*) irg->be_data;
 }
 
+/** Returns true if the backend verifiers should check @p irg. */
+static inline bool be_should_verify(const ir_graph *irg)
+{
+	return be_birg_from_irg(irg)->verify;
+}
+
 static inline be_main_env_t *be_get_irg_main_env(const ir_graph *irg)
 {
 	return be_birg_from_irg(irg)->main_env;
@@ -249,7 +249,8 @@ int be_remove_empty_blocks(ir_graph *irg)
 
 	if (blocks_removed) {
 		/* invalidate analysis info */
-		clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+		clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		                        | IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK);
 	}
 	return blocks_removed;
 }
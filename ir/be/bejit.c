@@ -0,0 +1,456 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Collects machine code and relocations for JIT compilation and
+ *              places the result in executable memory.
+ *
+ * All functions are emitted into one growing buffer. Block references are
+ * resolved at the end of each function, references to entities once all
+ * functions are known. The finished code is copied to freshly mapped pages
+ * which are made executable only after all relocations have been applied.
+ */
+/* MAP_ANONYMOUS is not part of C99/POSIX */
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#include "array.h"
+#include "bejit.h"
+#include "error.h"
+#include "irnode_t.h"
+#include "obst.h"
+#include "pmap.h"
+#include "tv.h"
+#include "typerep.h"
+#include "util.h"
+#include "xmalloc.h"
+
+/** The kinds of 32bit references in the machine code. */
+typedef enum jit_reloc_kind_t {
+	JIT_RELOC_ENTITY, /**< address of an entity */
+	JIT_RELOC_BLOCK,  /**< address of a block of the current function */
+	JIT_RELOC_CODE,   /**< address of an offset in the code buffer */
+} jit_reloc_kind_t;
+
+typedef struct jit_reloc_t {
+	jit_reloc_kind_t kind;
+	bool             is_relative; /**< relative to the end of the field */
+	bool             negate;      /**< use the negated address */
+	unsigned         pos;         /**< position of the field in the buffer */
+	int              offset;      /**< constant added to the address */
+	union {
+		ir_entity     *entity;
+		const ir_node *block;
+		unsigned       code_offset;
+	} u;
+} jit_reloc_t;
+
+struct ir_jit_code_t {
+	unsigned char *mem;       /**< the executable memory */
+	size_t         size;      /**< size of the executable memory */
+	pmap          *functions; /**< maps function entities to addresses */
+};
+
+static bool            active;
+static struct obstack  code_obst;      /**< the machine code, one object */
+static jit_reloc_t    *relocs;         /**< references to resolve at the end */
+static jit_reloc_t    *block_relocs;   /**< block references of the function */
+static pmap           *block_offsets;  /**< block offsets of the function */
+static pmap           *entity_offsets; /**< entities defined in the buffer */
+static ir_entity     **functions;      /**< all emitted functions */
+
+static unsigned get_code_pos(void)
+{
+	return (unsigned)obstack_object_size(&code_obst);
+}
+
+static void align_code(unsigned alignment)
+{
+	while (get_code_pos() % alignment != 0)
+		obstack_1grow(&code_obst, 0);
+}
+
+/** writes a 32bit value in little endian byte order */
+static void write32(unsigned char *dst, uint32_t value)
+{
+	dst[0] = (unsigned char)value;
+	dst[1] = (unsigned char)(value >> 8);
+	dst[2] = (unsigned char)(value >> 16);
+	dst[3] = (unsigned char)(value >> 24);
+}
+
+/** appends a 32bit field to the buffer and returns a relocation for it */
+static jit_reloc_t *new_reloc(jit_reloc_t **arr, jit_reloc_kind_t kind,
+                              bool is_relative)
+{
+	jit_reloc_t reloc;
+	memset(&reloc, 0, sizeof(reloc));
+	reloc.kind        = kind;
+	reloc.is_relative = is_relative;
+	reloc.pos         = get_code_pos();
+	for (unsigned i = 0; i < 4; ++i) {
+		obstack_1grow(&code_obst, 0);
+	}
+
+	ARR_APP1(jit_reloc_t, *arr, reloc);
+	return &(*arr)[ARR_LEN(*arr) - 1];
+}
+
+void be_jit_begin(void)
+{
+	assert(!active);
+	active = true;
+	obstack_init(&code_obst);
+	relocs         = NEW_ARR_F(jit_reloc_t, 0);
+	functions      = NEW_ARR_F(ir_entity*, 0);
+	entity_offsets = pmap_create();
+}
+
+bool be_jit_active(void)
+{
+	return active;
+}
+
+void be_jit_begin_function(ir_entity *entity, unsigned alignment)
+{
+	assert(active && block_offsets == NULL);
+	align_code(alignment);
+	pmap_insert(entity_offsets, entity, INT_TO_PTR(get_code_pos()));
+	ARR_APP1(ir_entity*, functions, entity);
+
+	block_offsets = pmap_create();
+	block_relocs  = NEW_ARR_F(jit_reloc_t, 0);
+}
+
+void be_jit_end_function(void)
+{
+	unsigned char *const code = (unsigned char*)obstack_base(&code_obst);
+	for (size_t i = 0, n = ARR_LEN(block_relocs); i < n; ++i) {
+		jit_reloc_t *const reloc = &block_relocs[i];
+		pmap_entry  *const entry = pmap_find(block_offsets, reloc->u.block);
+		if (entry == NULL)
+			panic("jump to unemitted block %+F", reloc->u.block);
+		unsigned const target = (unsigned)PTR_TO_INT(entry->value);
+
+		if (reloc->is_relative) {
+			/* relative jumps don't depend on the final code address */
+			int32_t const value = (int32_t)(target - (reloc->pos + 4))
+			                    + reloc->offset;
+			write32(&code[reloc->pos], (uint32_t)value);
+		} else {
+			jit_reloc_t code_reloc   = *reloc;
+			code_reloc.kind          = JIT_RELOC_CODE;
+			code_reloc.u.code_offset = target;
+			ARR_APP1(jit_reloc_t, relocs, code_reloc);
+		}
+	}
+	DEL_ARR_F(block_relocs);
+	pmap_destroy(block_offsets);
+	block_relocs  = NULL;
+	block_offsets = NULL;
+}
+
+void be_jit_begin_block(const ir_node *block)
+{
+	pmap_insert(block_offsets, block, INT_TO_PTR(get_code_pos()));
+}
+
+void be_jit_emit_byte(unsigned char byte)
+{
+	obstack_1grow(&code_obst, byte);
+}
+
+void be_jit_emit_entity(ir_entity *entity, bool entity_sign, int offset,
+                        bool is_relative)
+{
+	jit_reloc_t *const reloc = new_reloc(&relocs, JIT_RELOC_ENTITY,
+	                                     is_relative);
+	reloc->negate   = entity_sign;
+	reloc->offset   = offset;
+	reloc->u.entity = entity;
+}
+
+void be_jit_emit_block(const ir_node *block, bool is_relative)
+{
+	jit_reloc_t *const reloc = new_reloc(&block_relocs, JIT_RELOC_BLOCK,
+	                                     is_relative);
+	reloc->u.block = block;
+}
+
+void be_jit_emit_jump_table(ir_entity *entity, const ir_node *const *labels,
+                            unsigned long length)
+{
+	align_code(4);
+	pmap_insert(entity_offsets, entity, INT_TO_PTR(get_code_pos()));
+	for (unsigned long i = 0; i < length; ++i) {
+		be_jit_emit_block(labels[i], false);
+	}
+}
+
+static void write_tarval(unsigned char *dst, ir_tarval *tv)
+{
+	unsigned const size = get_mode_size_bytes(get_tarval_mode(tv));
+	for (unsigned i = 0; i < size; ++i) {
+		dst[i] = get_tarval_sub_bits(tv, i);
+	}
+}
+
+/**
+ * Writes the value of an initializer. Returns false if it is not a constant
+ * known at compile time.
+ */
+static bool write_initializer(unsigned char *dst,
+                              const ir_initializer_t *initializer,
+                              ir_type *type)
+{
+	switch (get_initializer_kind(initializer)) {
+	case IR_INITIALIZER_NULL:
+		return true;
+	case IR_INITIALIZER_TARVAL:
+		write_tarval(dst, get_initializer_tarval_value(initializer));
+		return true;
+	case IR_INITIALIZER_CONST: {
+		ir_node *const value = get_initializer_const_value(initializer);
+		if (!is_Const(value))
+			return false;
+		write_tarval(dst, get_Const_tarval(value));
+		return true;
+	}
+	case IR_INITIALIZER_COMPOUND: {
+		if (!is_Array_type(type))
+			return false;
+		ir_type *const element_type = get_array_element_type(type);
+		unsigned const element_size = get_type_size_bytes(element_type);
+		for (size_t i = 0, n = get_initializer_compound_n_entries(initializer);
+		     i < n; ++i) {
+			const ir_initializer_t *const sub
+				= get_initializer_compound_value(initializer, i);
+			if (!write_initializer(dst + i * element_size, sub, element_type))
+				return false;
+		}
+		return true;
+	}
+	case IR_INITIALIZER_BYTES: {
+		size_t size = get_initializer_bytes_size(initializer);
+		size_t max  = get_type_size_bytes(type);
+		memcpy(dst, get_initializer_bytes_data(initializer), MIN(size, max));
+		return true;
+	}
+	}
+	panic("invalid initializer kind");
+}
+
+/**
+ * Places a constant entity without an address from the resolver behind the
+ * code. Returns false if the entity has no constant initializer.
+ */
+static bool place_constant_entity(ir_entity *entity)
+{
+	if (!(get_entity_linkage(entity) & IR_LINKAGE_CONSTANT)
+	    || !entity_has_definition(entity)
+	    || is_Method_type(get_entity_type(entity)))
+		return false;
+	const ir_initializer_t *const initializer
+		= get_entity_initializer(entity);
+	if (initializer == NULL)
+		return false;
+
+	ir_type *const type = get_entity_type(entity);
+	unsigned const size = get_type_size_bytes(type);
+	align_code(MAX(get_type_alignment_bytes(type), 1u));
+	unsigned const pos = get_code_pos();
+	for (unsigned i = 0; i < size; ++i) {
+		obstack_1grow(&code_obst, 0);
+	}
+
+	unsigned char *const dst = (unsigned char*)obstack_base(&code_obst) + pos;
+	if (!write_initializer(dst, initializer, type))
+		return false;
+	pmap_insert(entity_offsets, entity, INT_TO_PTR(pos));
+	return true;
+}
+
+static void *alloc_code_memory(size_t size)
+{
+#ifdef _WIN32
+	return VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+	/* code for 32bit targets must be addressable with 32bit */
+	if (be_get_machine_size() <= 32)
+		flags |= MAP_32BIT;
+#endif
+	void *const mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	return mem != MAP_FAILED ? mem : NULL;
+#endif
+}
+
+static bool make_code_executable(void *mem, size_t size)
+{
+#ifdef _WIN32
+	DWORD old;
+	if (!VirtualProtect(mem, size, PAGE_EXECUTE_READ, &old))
+		return false;
+	FlushInstructionCache(GetCurrentProcess(), mem, size);
+	return true;
+#else
+	return mprotect(mem, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+}
+
+static void free_code_memory(void *mem, size_t size)
+{
+#ifdef _WIN32
+	(void)size;
+	VirtualFree(mem, 0, MEM_RELEASE);
+#else
+	munmap(mem, size);
+#endif
+}
+
+/**
+ * Determines the address an entity reference in the code refers to.
+ */
+static bool get_reloc_address(const jit_reloc_t *reloc,
+                              const unsigned char *mem, pmap *external,
+                              uintptr_t *address)
+{
+	if (reloc->kind == JIT_RELOC_CODE) {
+		*address = (uintptr_t)(mem + reloc->u.code_offset);
+		return true;
+	}
+
+	ir_entity  *const entity = reloc->u.entity;
+	pmap_entry *const entry  = pmap_find(entity_offsets, entity);
+	if (entry != NULL) {
+		*address = (uintptr_t)(mem + PTR_TO_INT(entry->value));
+		return true;
+	}
+	pmap_entry *const ext = pmap_find(external, entity);
+	if (ext == NULL)
+		return false;
+	*address = (uintptr_t)ext->value;
+	return true;
+}
+
+/** Applies all entity and code relocations, returns false on overflow. */
+static bool apply_relocs(unsigned char *mem, pmap *external)
+{
+	for (size_t i = 0, n = ARR_LEN(relocs); i < n; ++i) {
+		const jit_reloc_t *const reloc = &relocs[i];
+		uintptr_t address;
+		if (!get_reloc_address(reloc, mem, external, &address))
+			return false;
+
+		int64_t value = reloc->negate ? -(int64_t)address : (int64_t)address;
+		value += reloc->offset;
+		if (reloc->is_relative) {
+			value -= (int64_t)(uintptr_t)(mem + reloc->pos + 4);
+			if (value < INT32_MIN || value > INT32_MAX)
+				return false;
+		} else if (value < INT32_MIN || value > (int64_t)UINT32_MAX) {
+			return false;
+		}
+		write32(&mem[reloc->pos], (uint32_t)value);
+	}
+	return true;
+}
+
+static void be_jit_cleanup(void)
+{
+	obstack_free(&code_obst, NULL);
+	DEL_ARR_F(relocs);
+	DEL_ARR_F(functions);
+	pmap_destroy(entity_offsets);
+	active = false;
+}
+
+ir_jit_code_t *be_jit_finish(be_jit_resolver_t resolver, void *data)
+{
+	assert(active && block_offsets == NULL);
+
+	/* resolve external entities, the backend's own constants are placed
+	 * behind the code */
+	ir_jit_code_t *res      = NULL;
+	pmap          *external = pmap_create();
+	for (size_t i = 0, n = ARR_LEN(relocs); i < n; ++i) {
+		const jit_reloc_t *const reloc = &relocs[i];
+		if (reloc->kind != JIT_RELOC_ENTITY)
+			continue;
+		ir_entity *const entity = reloc->u.entity;
+		if (pmap_contains(entity_offsets, entity)
+		    || pmap_contains(external, entity))
+			continue;
+
+		void *const address = resolver != NULL ? resolver(entity, data) : NULL;
+		if (address != NULL) {
+			pmap_insert(external, entity, address);
+		} else if (!place_constant_entity(entity)) {
+			goto out;
+		}
+	}
+
+	size_t         const code_size = get_code_pos();
+	unsigned char *const code      = (unsigned char*)obstack_finish(&code_obst);
+	/* an empty mapping is invalid */
+	size_t         const size      = MAX(code_size, (size_t)1);
+	unsigned char *const mem       = (unsigned char*)alloc_code_memory(size);
+	if (mem == NULL)
+		goto out;
+	memcpy(mem, code, code_size);
+	if (!apply_relocs(mem, external) || !make_code_executable(mem, size)) {
+		free_code_memory(mem, size);
+		goto out;
+	}
+
+	res            = XMALLOC(ir_jit_code_t);
+	res->mem       = mem;
+	res->size      = size;
+	res->functions = pmap_create();
+	for (size_t i = 0, n = ARR_LEN(functions); i < n; ++i) {
+		ir_entity *const entity = functions[i];
+		unsigned   const offset
+			= (unsigned)PTR_TO_INT(pmap_get(void, entity_offsets, entity));
+		pmap_insert(res->functions, entity, mem + offset);
+	}
+
+out:
+	pmap_destroy(external);
+	be_jit_cleanup();
+	return res;
+}
+
+void *be_jit_get_entity_address(const ir_jit_code_t *code,
+                                const ir_entity *entity)
+{
+	return pmap_get(void, code->functions, entity);
+}
+
+size_t be_jit_get_code_size(const ir_jit_code_t *code)
+{
+	return code->size;
+}
+
+void be_jit_free(ir_jit_code_t *code)
+{
+	free_code_memory(code->mem, code->size);
+	pmap_destroy(code->functions);
+	free(code);
+}
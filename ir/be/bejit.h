@@ -0,0 +1,69 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Collects machine code and relocations for JIT compilation.
+ *
+ * While a JIT compilation is active the binary emitter writes its machine
+ * code into an in-memory buffer instead of the assembler output. References
+ * to blocks and entities are recorded as 32bit relocations and resolved once
+ * all graphs have been emitted.
+ */
+#ifndef FIRM_BE_BEJIT_H
+#define FIRM_BE_BEJIT_H
+
+#include <stdbool.h>
+
+#include "firm_types.h"
+#include "be.h"
+
+/** Starts collecting machine code for a JIT compilation. */
+void be_jit_begin(void);
+
+/**
+ * Places all collected machine code into executable memory and resolves the
+ * relocations.
+ *
+ * @returns the executable code or NULL if an entity could not be resolved
+ */
+ir_jit_code_t *be_jit_finish(be_jit_resolver_t resolver, void *data);
+
+/** Returns true while machine code is collected for a JIT compilation. */
+bool be_jit_active(void);
+
+/** Starts the machine code of the function @p entity. */
+void be_jit_begin_function(ir_entity *entity, unsigned alignment);
+
+/** Finishes the current function and resolves its block references. */
+void be_jit_end_function(void);
+
+/** Marks the current position as start of @p block. */
+void be_jit_begin_block(const ir_node *block);
+
+/** Appends a byte of machine code. */
+void be_jit_emit_byte(unsigned char byte);
+
+/**
+ * Appends a 32bit reference to an entity. If @p is_relative is true the
+ * offset from behind the reference to the entity is used.
+ */
+void be_jit_emit_entity(ir_entity *entity, bool entity_sign, int offset,
+                        bool is_relative);
+
+/**
+ * Appends a 32bit reference to a block of the current function. If
+ * @p is_relative is true the offset from behind the reference is used.
+ */
+void be_jit_emit_block(const ir_node *block, bool is_relative);
+
+/**
+ * Appends a jump table with the absolute addresses of @p labels and makes
+ * it the definition of @p entity.
+ */
+void be_jit_emit_jump_table(ir_entity *entity, const ir_node *const *labels,
+                            unsigned long length);
+
+#endif
@@ -0,0 +1,517 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       Linear scan register allocator.
+ *
+ * A fast register allocator for situations where compile time matters more
+ * than code quality. It works on SSA form like the chordal allocator:
+ * 1. The spiller lowers the register pressure to the number of registers.
+ * 2. Register constraints are resolved by the chordal constraint handling.
+ * 3. A single linear scan over the lifetime intervals assigns registers.
+ * 4. SSA destruction implements the Phis with copies and swaps.
+ *
+ * The blocks are linearized in reverse postorder, so every definition comes
+ * after the definitions dominating it. In SSA form two interfering values are
+ * always both live at the definition of the later one. Hence an interval
+ * which is in a lifetime hole at the start of the current interval never
+ * interferes with it, and the register of a value is free for its whole
+ * lifetime if it is free at its definition. This makes interval splitting
+ * unnecessary and there is no copy coalescing apart from register hints.
+ */
+#include <stdlib.h>
+
+#include "array.h"
+#include "bitfiddle.h"
+#include "debug.h"
+#include "irdump.h"
+#include "iredges_t.h"
+#include "irgraph_t.h"
+#include "irnode_t.h"
+#include "obst.h"
+#include "pqueue.h"
+#include "raw_bitset.h"
+#include "statev_t.h"
+#include "util.h"
+
+#include "be_t.h"
+#include "bearch.h"
+#include "bechordal_t.h"
+#include "beirg.h"
+#include "belive_t.h"
+#include "belower.h"
+#include "bemodule.h"
+#include "benode.h"
+#include "bera.h"
+#include "besched.h"
+#include "bespill.h"
+#include "bessadestr.h"
+#include "bestack.h"
+#include "beutil.h"
+#include "beverify.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
+
+/** A half-open range [from, to) of schedule positions. */
+typedef struct live_range_t {
+	unsigned from;
+	unsigned to;
+} live_range_t;
+
+/** The lifetime interval of a value, a sorted list of disjoint ranges. */
+typedef struct interval_t {
+	ir_node      *value;
+	live_range_t *ranges; /**< ARR_F, built in descending order */
+	size_t        cursor; /**< first range not ending before the scan position */
+	unsigned      reg;    /**< index of the assigned register */
+} interval_t;
+
+/** The positions covered by a block. */
+typedef struct block_range_t {
+	unsigned from;
+	unsigned to;
+} block_range_t;
+
+typedef struct lsra_env_t {
+	struct obstack               obst;
+	ir_graph                    *irg;
+	const arch_register_class_t *cls;
+	const unsigned              *allocatable; /**< allocatable registers */
+	interval_t                 **intervals;   /**< ARR_F of all intervals */
+	interval_t                 **node_map;    /**< maps node indices to intervals */
+} lsra_env_t;
+
+static interval_t *get_interval(lsra_env_t *env, ir_node *value)
+{
+	interval_t **slot     = &env->node_map[get_irn_idx(value)];
+	interval_t  *interval = *slot;
+	if (interval == NULL) {
+		interval         = OALLOCZ(&env->obst, interval_t);
+		interval->value  = value;
+		interval->ranges = NEW_ARR_F(live_range_t, 0);
+		*slot            = interval;
+		ARR_APP1(interval_t*, env->intervals, interval);
+	}
+	return interval;
+}
+
+/**
+ * Adds the range [from, to) to the interval of @p value. Ranges are added in
+ * descending order, so only the last range may need to be merged.
+ */
+static void add_range(lsra_env_t *env, ir_node *value, unsigned from,
+                      unsigned to)
+{
+	interval_t   *interval = get_interval(env, value);
+	size_t const  n        = ARR_LEN(interval->ranges);
+	if (n > 0) {
+		live_range_t *last = &interval->ranges[n - 1];
+		if (last->from <= to) {
+			last->from = MIN(last->from, from);
+			last->to   = MAX(last->to, to);
+			return;
+		}
+	}
+	live_range_t const range = { from, to };
+	ARR_APP1(live_range_t, interval->ranges, range);
+}
+
+/**
+ * Shortens the interval of @p value to start at its definition.
+ */
+static void set_def(lsra_env_t *env, ir_node *value, unsigned pos)
+{
+	interval_t   *interval = get_interval(env, value);
+	size_t const  n        = ARR_LEN(interval->ranges);
+	if (n > 0 && interval->ranges[n - 1].from <= pos) {
+		interval->ranges[n - 1].from = pos;
+	} else {
+		/* the value is never used, but still occupies a register */
+		live_range_t const range = { pos, pos + 1 };
+		ARR_APP1(live_range_t, interval->ranges, range);
+	}
+}
+
+/**
+ * Computes the lifetime intervals of all values of the current register
+ * class. Every scheduled node gets two positions: its operands are read at
+ * the first one, its results are written at the second one.
+ */
+static void build_intervals(lsra_env_t *env, ir_node **blocks, size_t n_blocks)
+{
+	be_lv_t       *lv     = be_get_irg_liveness(env->irg);
+	block_range_t *ranges = OALLOCN(&env->obst, block_range_t, n_blocks);
+
+	unsigned pos = 0;
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ranges[i].from = pos;
+		sched_foreach(blocks[i], node) {
+			pos += 2;
+		}
+		ranges[i].to = pos;
+	}
+
+	for (size_t i = n_blocks; i-- > 0;) {
+		ir_node      *block = blocks[i];
+		unsigned const from = ranges[i].from;
+
+		be_lv_foreach_cls(lv, block, be_lv_state_end, env->cls, value) {
+			add_range(env, value, from, ranges[i].to);
+		}
+
+		pos = ranges[i].to;
+		sched_foreach_reverse(block, node) {
+			pos -= 2;
+			if (is_Phi(node)) {
+				/* Phis are defined at the block entry, their operands are used
+				 * at the end of the predecessors */
+				be_foreach_definition(node, env->cls, value, req,
+					set_def(env, value, from);
+				);
+				continue;
+			}
+
+			be_foreach_definition(node, env->cls, value, req,
+				set_def(env, value, pos + 1);
+			);
+			be_foreach_use(node, env->cls, in_req, value, value_req,
+				add_range(env, value, from, pos + 1);
+			);
+		}
+	}
+
+	for (size_t i = 0, n = ARR_LEN(env->intervals); i < n; ++i) {
+		live_range_t *r   = env->intervals[i]->ranges;
+		size_t const  len = ARR_LEN(r);
+		for (size_t l = 0, h = len - 1; l < h; ++l, --h) {
+			live_range_t const tmp = r[l];
+			r[l] = r[h];
+			r[h] = tmp;
+		}
+	}
+}
+
+static unsigned interval_start(const interval_t *interval)
+{
+	return interval->ranges[0].from;
+}
+
+static unsigned interval_end(const interval_t *interval)
+{
+	return interval->ranges[ARR_LEN(interval->ranges) - 1].to;
+}
+
+/**
+ * Returns true if @p interval covers position @p pos. The positions asked
+ * for must not decrease.
+ */
+static bool covers(interval_t *interval, unsigned pos)
+{
+	size_t const n = ARR_LEN(interval->ranges);
+	while (interval->cursor < n && interval->ranges[interval->cursor].to <= pos)
+		++interval->cursor;
+	return interval->cursor < n && interval->ranges[interval->cursor].from <= pos;
+}
+
+static int cmp_interval(const void *a, const void *b)
+{
+	const interval_t *ia = *(const interval_t**)a;
+	const interval_t *ib = *(const interval_t**)b;
+	unsigned const    sa = interval_start(ia);
+	unsigned const    sb = interval_start(ib);
+	if (sa != sb)
+		return sa < sb ? -1 : 1;
+	/* precolored values first, so nobody else takes their register */
+	bool const pa = arch_get_irn_register(ia->value) != NULL;
+	bool const pb = arch_get_irn_register(ib->value) != NULL;
+	if (pa != pb)
+		return pa ? -1 : 1;
+	return QSORT_CMP(get_irn_idx(ia->value), get_irn_idx(ib->value));
+}
+
+/**
+ * Returns the index of @p node's register if it can be used as a hint for the
+ * current interval, n_regs otherwise.
+ */
+static unsigned hint_reg(const lsra_env_t *env, const ir_node *node,
+                         const unsigned *occupied)
+{
+	const arch_register_t *reg = arch_get_irn_register(node);
+	if (reg == NULL || reg->reg_class != env->cls
+	    || !rbitset_is_set(env->allocatable, reg->index)
+	    || rbitset_is_set(occupied, reg->index))
+		return env->cls->n_regs;
+	return reg->index;
+}
+
+/**
+ * Looks for a register avoiding a copy: the register of a should_be_same
+ * operand, of the copied value, of a Phi operand or of a Phi using the value.
+ */
+static unsigned find_hint(const lsra_env_t *env, ir_node *value,
+                          const unsigned *occupied)
+{
+	unsigned const             n_regs = env->cls->n_regs;
+	const arch_register_req_t *req    = arch_get_irn_register_req(value);
+	ir_node                   *node   = skip_Proj(value);
+
+	for (unsigned same = req->other_same; same != 0; same &= same - 1) {
+		unsigned const reg = hint_reg(env, get_irn_n(node, ntz(same)), occupied);
+		if (reg != n_regs)
+			return reg;
+	}
+
+	if (be_is_Copy(value)) {
+		unsigned const reg = hint_reg(env, be_get_Copy_op(value), occupied);
+		if (reg != n_regs)
+			return reg;
+	}
+
+	if (is_Phi(value)) {
+		for (int i = 0, arity = get_irn_arity(value); i < arity; ++i) {
+			unsigned const reg = hint_reg(env, get_irn_n(value, i), occupied);
+			if (reg != n_regs)
+				return reg;
+		}
+	}
+
+	foreach_out_edge(value, edge) {
+		ir_node *const user = get_edge_src_irn(edge);
+		if (!is_Phi(user))
+			continue;
+		unsigned const reg = hint_reg(env, user, occupied);
+		if (reg != n_regs)
+			return reg;
+	}
+
+	return n_regs;
+}
+
+static int inactive_priority(const interval_t *interval)
+{
+	return -(int)interval->ranges[interval->cursor].from;
+}
+
+/**
+ * Assigns registers to the intervals in the order of their start positions.
+ */
+static void assign_registers(lsra_env_t *env)
+{
+	const arch_register_class_t *cls       = env->cls;
+	unsigned const               n_regs    = cls->n_regs;
+	interval_t                 **intervals = env->intervals;
+	size_t const                 n         = ARR_LEN(intervals);
+	interval_t                 **active    = NEW_ARR_F(interval_t*, 0);
+	pqueue_t                    *inactive  = new_pqueue();
+	unsigned                    *occupied  = rbitset_alloca(n_regs);
+
+	qsort(intervals, n, sizeof(*intervals), cmp_interval);
+
+	for (size_t i = 0; i < n; ++i) {
+		interval_t    *cur = intervals[i];
+		unsigned const pos = interval_start(cur);
+
+		/* expire intervals and move those in a lifetime hole to inactive */
+		for (size_t a = 0; a < ARR_LEN(active);) {
+			interval_t *const it = active[a];
+			if (interval_end(it) <= pos || !covers(it, pos)) {
+				if (interval_end(it) > pos)
+					pqueue_put(inactive, it, inactive_priority(it));
+				active[a] = active[ARR_LEN(active) - 1];
+				ARR_SHRINKLEN(active, ARR_LEN(active) - 1);
+				continue;
+			}
+			++a;
+		}
+
+		/* reactivate inactive intervals whose next range has started */
+		while (!pqueue_empty(inactive)) {
+			interval_t *const it = (interval_t*)pqueue_front(inactive);
+			if (it->ranges[it->cursor].from > pos)
+				break;
+			if (covers(it, pos)) {
+				pqueue_pop_front(inactive);
+				ARR_APP1(interval_t*, active, it);
+			} else if (interval_end(it) > pos) {
+				/* the next range starts later, requeue it in place */
+				pqueue_replace_front(inactive, it, inactive_priority(it));
+			} else {
+				pqueue_pop_front(inactive);
+			}
+		}
+
+		rbitset_clear_all(occupied, n_regs);
+		for (size_t a = 0, n_active = ARR_LEN(active); a < n_active; ++a) {
+			rbitset_set(occupied, active[a]->reg);
+		}
+
+		ir_node               *value = cur->value;
+		const arch_register_t *reg   = arch_get_irn_register(value);
+		if (reg != NULL) {
+			assert(!rbitset_is_set(occupied, reg->index)
+			       && "pre-colored register must be free");
+			cur->reg = reg->index;
+		} else {
+			unsigned idx = find_hint(env, value, occupied);
+			if (idx == n_regs) {
+				for (idx = 0; idx < n_regs; ++idx) {
+					if (rbitset_is_set(env->allocatable, idx)
+					    && !rbitset_is_set(occupied, idx))
+						break;
+				}
+			}
+			assert(idx < n_regs && "register pressure too high");
+			cur->reg = idx;
+			arch_set_irn_register(value, arch_register_for_index(cls, idx));
+		}
+		DBG((dbg, LEVEL_2, "%+F [%u, %u) gets %s\n", value, pos,
+		     interval_end(cur), arch_register_for_index(cls, cur->reg)->name));
+
+		ARR_APP1(interval_t*, active, cur);
+	}
+
+	del_pqueue(inactive);
+	DEL_ARR_F(active);
+}
+
+/**
+ * Assigns registers to all values of the current register class.
+ */
+static void linear_scan(lsra_env_t *env)
+{
+	ir_graph *irg    = env->irg;
+	ir_node **blocks = be_get_cfgpostorder(irg);
+	size_t    n      = ARR_LEN(blocks);
+
+	/* turn the postorder into a reverse postorder */
+	for (size_t l = 0, h = n - 1; l < h; ++l, --h) {
+		ir_node *tmp = blocks[l];
+		blocks[l] = blocks[h];
+		blocks[h] = tmp;
+	}
+
+	env->node_map  = XMALLOCNZ(interval_t*, get_irg_last_idx(irg));
+	env->intervals = NEW_ARR_F(interval_t*, 0);
+	build_intervals(env, blocks, n);
+	stat_ev_int("linearscan_intervals", ARR_LEN(env->intervals));
+	assign_registers(env);
+
+	for (size_t i = 0, n_intervals = ARR_LEN(env->intervals); i < n_intervals;
+	     ++i) {
+		DEL_ARR_F(env->intervals[i]->ranges);
+	}
+	DEL_ARR_F(env->intervals);
+	DEL_ARR_F(blocks);
+	free(env->node_map);
+}
+
+static void dump(ir_graph *irg, const char *suffix)
+{
+	if (be_options.dump_flags & DUMP_RA)
+		dump_ir_graph(irg, suffix);
+}
+
+static void linearscan_alloc_cls(ir_graph *irg, const arch_register_class_t *cls)
+{
+	be_chordal_env_t chordal_env;
+	obstack_init(&chordal_env.obst);
+	chordal_env.opts             = NULL;
+	chordal_env.irg              = irg;
+	chordal_env.cls              = cls;
+	chordal_env.border_heads     = NULL;
+	chordal_env.ifg              = NULL;
+	chordal_env.lv_cls           = NULL;
+	chordal_env.allocatable_regs = bitset_malloc(cls->n_regs);
+	be_get_allocatable_regs(irg, cls, chordal_env.allocatable_regs->data);
+
+	/* make sure all nodes show their real register pressure */
+	be_assure_live_chk(irg);
+	be_timer_push(T_RA_CONSTR);
+	be_pre_spill_prepare_constr(irg, cls);
+	be_timer_pop(T_RA_CONSTR);
+
+	be_timer_push(T_RA_SPILL);
+	be_do_spill(irg, cls);
+	be_timer_pop(T_RA_SPILL);
+
+	be_timer_push(T_RA_SPILL_APPLY);
+	check_for_memory_operands(irg);
+	be_abi_fix_stack_nodes(irg);
+	be_timer_pop(T_RA_SPILL_APPLY);
+
+	dump(irg, "spill");
+
+	if (be_should_verify(irg)) {
+		be_timer_push(T_VERIFY);
+		be_verify_schedule(irg);
+		be_verify_register_pressure(irg, cls);
+		be_timer_pop(T_VERIFY);
+	}
+
+	be_timer_push(T_RA_COLOR);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+	be_assure_live_sets(irg);
+	be_chordal_handle_constraints(&chordal_env);
+
+	lsra_env_t env;
+	obstack_init(&env.obst);
+	env.irg         = irg;
+	env.cls         = cls;
+	env.allocatable = chordal_env.allocatable_regs->data;
+	linear_scan(&env);
+	obstack_free(&env.obst, NULL);
+	be_timer_pop(T_RA_COLOR);
+
+	dump(irg, "linearscan");
+
+	be_timer_push(T_RA_SSA);
+	be_ssa_destruction(irg, cls, false);
+	be_timer_pop(T_RA_SSA);
+
+	if (be_should_verify(irg)) {
+		be_timer_push(T_VERIFY);
+		be_ssa_destruction_check(irg, cls);
+		be_timer_pop(T_VERIFY);
+	}
+
+	free(chordal_env.allocatable_regs);
+	obstack_free(&chordal_env.obst, NULL);
+}
+
+/**
+ * The linear scan register allocator for a whole procedure.
+ */
+static void be_linearscan_alloc(ir_graph *irg)
+{
+	const arch_env_t *arch_env = be_get_irg_arch_env(irg);
+
+	be_timer_push(T_RA_OTHER);
+
+	for (int c = 0, n_cls = arch_env->n_register_classes; c < n_cls; ++c) {
+		const arch_register_class_t *cls = &arch_env->register_classes[c];
+		if (arch_register_class_flags(cls) & arch_register_class_flag_manual_ra)
+			continue;
+
+		stat_ev_ctx_push_str("regcls", cls->name);
+		linearscan_alloc_cls(irg, cls);
+		stat_ev_ctx_pop("regcls");
+	}
+
+	be_timer_push(T_RA_EPILOG);
+	lower_nodes_after_ra(irg, false);
+	be_invalidate_live_sets(irg);
+	be_timer_pop(T_RA_EPILOG);
+
+	be_timer_pop(T_RA_OTHER);
+}
+
+BE_REGISTER_MODULE_CONSTRUCTOR(be_init_linearscan)
+void be_init_linearscan(void)
+{
+	static be_ra_t be_ra_linearscan = { be_linearscan_alloc };
+	be_register_allocator("linearscan", &be_ra_linearscan);
+	FIRM_DBG_REGISTER(dbg, "firm.be.linearscan");
+}
@@ -335,9 +335,20 @@ void be_liveness_compute_sets(be_lv_t *lv)
 
 void be_liveness_compute_chk(be_lv_t *lv)
 {
-	if (lv->lvc != NULL)
-		return;
-	lv->lvc = lv_chk_new(lv->irg);
+	/* the check only depends on the control flow and the dominance tree, so it
+	 * stays valid as long as no pass has changed them */
+	ir_graph *const irg = lv->irg;
+	if (lv->lvc != NULL) {
+		if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK
+		                          | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE)) {
+			++lv->n_chk_reuses;
+			return;
+		}
+		be_liveness_invalidate_chk(lv);
+	}
+	lv->lvc = lv_chk_new(irg);
+	++lv->n_chk_builds;
+	add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK);
 }
 
 void be_liveness_invalidate_sets(be_lv_t *lv)
@@ -353,6 +364,7 @@ void be_liveness_invalidate_chk(be_lv_t *lv)
 {
 	be_liveness_invalidate_sets(lv);
 
+	clear_irg_properties(lv->irg, IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK);
 	if (lv->lvc == NULL)
 		return;
 	lv_chk_free(lv->lvc);
@@ -368,6 +380,19 @@ be_lv_t *be_liveness_new(ir_graph *irg)
 	return lv;
 }
 
+size_t be_liveness_memory_used(const be_lv_t *lv)
+{
+	size_t res = sizeof(*lv);
+	if (lv->sets_valid) {
+		struct obstack *const obst = (struct obstack*)&lv->obst;
+		res += (size_t)obstack_memory_used(obst)
+		     + lv->map.num_buckets * sizeof(lv->map.entries[0]);
+	}
+	if (lv->lvc != NULL)
+		res += lv_chk_memory_used(lv->lvc);
+	return res;
+}
+
 void be_liveness_free(be_lv_t *lv)
 {
 	be_liveness_invalidate_sets(lv);
@@ -407,6 +432,163 @@ void be_liveness_update(be_lv_t *lv, ir_node *irn)
 	be_liveness_introduce(lv, irn);
 }
 
+typedef struct lv_remove_set_walker_t {
+	be_lv_t            *lv;
+	const ir_nodeset_t *nodes;
+	unsigned            n_blocks;
+} lv_remove_set_walker_t;
+
+/**
+ * Removes all nodes of a set from the list of live variables of a block.
+ */
+static void lv_remove_set_walker(ir_node *const bl, void *const data)
+{
+	lv_remove_set_walker_t *const w        = (lv_remove_set_walker_t*)data;
+	be_lv_info_t           *const irn_live = ir_nodehashmap_get(be_lv_info_t, &w->lv->map, bl);
+	++w->n_blocks;
+	if (irn_live == NULL)
+		return;
+
+	be_lv_info_t *const payload = irn_live + 1;
+	unsigned      const n       = irn_live[0].head.n_members;
+	unsigned            n_kept  = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		if (ir_nodeset_contains(w->nodes, payload[i].node.node))
+			continue;
+		payload[n_kept++] = payload[i];
+	}
+	for (unsigned i = n_kept; i < n; ++i) {
+		payload[i].node.node  = NULL;
+		payload[i].node.flags = 0;
+	}
+	irn_live[0].head.n_members = n_kept;
+}
+
+static int cmp_dom_pre_num(const void *a, const void *b)
+{
+	const ir_node *block_a = *(const ir_node *const*)a;
+	const ir_node *block_b = *(const ir_node *const*)b;
+	unsigned       num_a   = get_Block_dom_tree_pre_num(block_a);
+	unsigned       num_b   = get_Block_dom_tree_pre_num(block_b);
+	return num_a < num_b ? -1 : num_a > num_b;
+}
+
+unsigned be_liveness_update_nodes(be_lv_t *lv, const ir_nodeset_t *nodes)
+{
+	if (!lv->sets_valid)
+		return 0;
+
+	/* a value is only live in the dominance subtree of its definition, so
+	 * collect the subtrees of all changed values */
+	ir_node **roots = NEW_ARR_F(ir_node*, 0);
+	foreach_ir_nodeset(nodes, node, iter) {
+		if (is_Deleted(node))
+			continue;
+		ARR_APP1(ir_node*, roots, get_nodes_block(node));
+	}
+	size_t n_roots = ARR_LEN(roots);
+	qsort(roots, n_roots, sizeof(*roots), cmp_dom_pre_num);
+
+	/* remove the values from every block of the subtrees, subtrees nested in
+	 * an already visited one are skipped */
+	lv_remove_set_walker_t w;
+	w.lv       = lv;
+	w.nodes    = nodes;
+	w.n_blocks = 0;
+	unsigned next_unvisited = 0;
+	for (size_t i = 0; i < n_roots; ++i) {
+		ir_node *root = roots[i];
+		if (get_Block_dom_tree_pre_num(root) < next_unvisited)
+			continue;
+		dom_tree_walk(root, lv_remove_set_walker, NULL, &w);
+		next_unvisited = get_Block_dom_max_subtree_pre_num(root) + 1;
+	}
+	DEL_ARR_F(roots);
+
+	/* and compute the liveness of the values again */
+	re.lv = lv;
+	foreach_ir_nodeset(nodes, node, iter) {
+		if (!is_Deleted(node) && is_liveness_node(node))
+			liveness_for_node(node);
+	}
+
+	DBG((dbg, LEVEL_1, "updated liveness of %zu values in %u blocks\n",
+	     ir_nodeset_size(nodes), w.n_blocks));
+	return w.n_blocks;
+}
+
+static void lv_cls_number_walker(ir_node *const block, void *const data)
+{
+	be_lv_cls_t *const lvc = (be_lv_cls_t*)data;
+
+	be_lv_foreach_cls(lvc->lv, block, be_lv_state_in | be_lv_state_end | be_lv_state_out, lvc->cls, node) {
+		unsigned const idx = get_irn_idx(node);
+		if (lvc->numbers[idx] != 0)
+			continue;
+		ARR_APP1(ir_node*, lvc->values, node);
+		lvc->numbers[idx] = ++lvc->n_values;
+	}
+}
+
+static void lv_cls_fill_walker(ir_node *const block, void *const data)
+{
+	be_lv_cls_t  *const lvc = (be_lv_cls_t*)data;
+	be_lv_info_t *const arr = ir_nodehashmap_get(be_lv_info_t, &lvc->lv->map, block);
+	if (arr == NULL)
+		return;
+
+	be_lv_cls_block_t *info = NULL;
+	for (unsigned i = 1, n = arr[0].head.n_members; i <= n; ++i) {
+		be_lv_info_node_t const *const entry = &arr[i].node;
+		unsigned const idx = get_irn_idx(entry->node);
+		if (idx >= lvc->n_idx || lvc->numbers[idx] == 0)
+			continue;
+
+		if (info == NULL) {
+			info      = OALLOC(&lvc->obst, be_lv_cls_block_t);
+			info->in  = rbitset_obstack_alloc(&lvc->obst, lvc->n_values);
+			info->end = rbitset_obstack_alloc(&lvc->obst, lvc->n_values);
+			info->out = rbitset_obstack_alloc(&lvc->obst, lvc->n_values);
+			ir_nodehashmap_insert(&lvc->blocks, block, info);
+		}
+
+		unsigned const nr = lvc->numbers[idx] - 1;
+		if (entry->flags & be_lv_state_in)
+			rbitset_set(info->in, nr);
+		if (entry->flags & be_lv_state_end)
+			rbitset_set(info->end, nr);
+		if (entry->flags & be_lv_state_out)
+			rbitset_set(info->out, nr);
+	}
+}
+
+be_lv_cls_t *be_lv_cls_new(const be_lv_t *lv, const arch_register_class_t *cls)
+{
+	assert(lv->sets_valid);
+
+	be_lv_cls_t *const lvc = XMALLOCZ(be_lv_cls_t);
+	obstack_init(&lvc->obst);
+	ir_nodehashmap_init(&lvc->blocks);
+	lvc->lv      = lv;
+	lvc->cls     = cls;
+	lvc->n_idx   = get_irg_last_idx(lv->irg);
+	lvc->numbers = OALLOCNZ(&lvc->obst, unsigned, lvc->n_idx);
+	lvc->values  = NEW_ARR_F(ir_node*, 0);
+
+	/* number the values first, so the bitsets can get their final size */
+	irg_block_walk_graph(lv->irg, lv_cls_number_walker, NULL, lvc);
+	irg_block_walk_graph(lv->irg, lv_cls_fill_walker, NULL, lvc);
+	return lvc;
+}
+
+void be_lv_cls_free(be_lv_cls_t *lvc)
+{
+	DEL_ARR_F(lvc->values);
+	ir_nodehashmap_destroy(&lvc->blocks);
+	obstack_free(&lvc->obst, NULL);
+	free(lvc);
+}
+
 void be_liveness_transfer(const arch_register_class_t *cls,
                           ir_node *node, ir_nodeset_t *nodeset)
 {
@@ -510,3 +692,4 @@ void be_init_live(void)
 	(void)be_live_chk_compare;
 	FIRM_DBG_REGISTER(dbg, "firm.be.liveness");
 }
+
@@ -38,6 +38,12 @@ void be_liveness_free(be_lv_t *lv);
  * (Re)compute the liveness information if necessary.
  */
 void be_liveness_compute_sets(be_lv_t *lv);
+
+/**
+ * Compute the liveness check information. An existing check is reused as long
+ * as the graph has IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK and consistent
+ * dominance, so passes that do not change the control flow share it.
+ */
 void be_liveness_compute_chk(be_lv_t *lv);
 
 /**
@@ -46,11 +52,18 @@ void be_liveness_compute_chk(be_lv_t *lv);
  * update the liveness with the be_liveness_{update,remove,introduce}
  * functions.
  * @note If changed the control flow then you must also call
- *       be_liveness_invalidate_chk()
+ *       be_liveness_invalidate_chk() or clear
+ *       IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK
  */
 void be_liveness_invalidate_sets(be_lv_t *lv);
 void be_liveness_invalidate_chk(be_lv_t *lv);
 
+/**
+ * Returns the number of bytes allocated for the liveness sets and the
+ * liveness check.
+ */
+size_t be_liveness_memory_used(const be_lv_t *lv);
+
 /**
  * Update the liveness information for a single node.
  * It is irrelevant if there is liveness information present for the node.
@@ -60,6 +73,20 @@ void be_liveness_invalidate_chk(be_lv_t *lv);
  */
 void be_liveness_update(be_lv_t *lv, ir_node *irn);
 
+/**
+ * Update the liveness information for a set of changed values at once.
+ * This is what passes that insert many nodes like spilling should use
+ * instead of invalidating and recomputing the whole liveness information. A
+ * value has to be in the set if it is new, if it got new users or if it lost
+ * users. Deleted nodes in the set are ignored.
+ * Only the blocks dominated by the definitions of the values are visited.
+ *
+ * @param lv     The liveness info.
+ * @param nodes  The set of changed values.
+ * @return the number of blocks which had to be visited.
+ */
+unsigned be_liveness_update_nodes(be_lv_t *lv, const ir_nodeset_t *nodes);
+
 /**
  * Remove a node from the liveness information.
  */
@@ -14,6 +14,8 @@
 
 #include <stdbool.h>
 #include "irnodehashmap.h"
+#include "obst.h"
+#include "raw_bitset.h"
 #include "irhooks.h"
 #include "irlivechk.h"
 #include "belive.h"
@@ -29,6 +31,8 @@ struct be_lv_t {
 	bool             sets_valid;
 	ir_graph        *irg;
 	lv_chk_t        *lvc;
+	unsigned         n_chk_builds;  /**< number of times lvc was computed */
+	unsigned         n_chk_reuses;  /**< number of times lvc was reused */
 };
 
 typedef struct be_lv_info_node_t be_lv_info_node_t;
@@ -118,4 +122,86 @@ static inline ir_node *be_lv_iteration_cls_next(lv_iterator_t *iterator, be_lv_s
 		for (lv_iterator_t iter = be_lv_iteration_begin((lv), (block)); once; once = false) \
 			for (ir_node *node; (node = be_lv_iteration_cls_next(&iter, (flags), (cls))) != NULL;)
 
+/**
+ * Liveness of the values of one register class kept as raw bitsets.
+ * The values of the class are numbered densely, so each block only needs one
+ * bit per value and state and queries become a single bit test. This is a
+ * snapshot of the liveness sets at the time of its creation: It must be built
+ * anew, whenever the liveness of the graph changes.
+ */
+struct be_lv_cls_t {
+	struct obstack               obst;
+	const be_lv_t               *lv;       /**< The liveness sets the bitsets were built from. */
+	const arch_register_class_t *cls;      /**< The register class. */
+	ir_nodehashmap_t             blocks;   /**< Maps blocks to be_lv_cls_block_t. */
+	unsigned                    *numbers;  /**< Value number + 1 per node index, 0 for other nodes. */
+	unsigned                     n_idx;    /**< Size of the numbers array. */
+	ir_node                    **values;   /**< Maps value numbers back to the values. */
+	unsigned                     n_values; /**< Number of values of the class. */
+};
+
+typedef struct be_lv_cls_block_t {
+	unsigned *in;  /**< Values live at the beginning of the block. */
+	unsigned *end; /**< Values live at the end of the block. */
+	unsigned *out; /**< Values live out of the block. */
+} be_lv_cls_block_t;
+
+/**
+ * Creates the bitset liveness of a register class from valid liveness sets.
+ *
+ * @param lv   The liveness info, its sets must be valid.
+ * @param cls  The register class.
+ */
+be_lv_cls_t *be_lv_cls_new(const be_lv_t *lv, const arch_register_class_t *cls);
+
+/**
+ * Frees the bitset liveness of a register class.
+ */
+void be_lv_cls_free(be_lv_cls_t *lvc);
+
+/**
+ * Returns the bitset of the values in the given liveness state at a block or
+ * NULL if no value of the class is live there.
+ *
+ * @param state  Exactly one of be_lv_state_in, be_lv_state_end and
+ *               be_lv_state_out.
+ */
+static inline const unsigned *be_lv_cls_get_set(const be_lv_cls_t *lvc,
+		const ir_node *block, be_lv_state_t state)
+{
+	const be_lv_cls_block_t *info
+		= ir_nodehashmap_get(const be_lv_cls_block_t, &lvc->blocks, block);
+	if (info == NULL)
+		return NULL;
+	if (state == be_lv_state_in)
+		return info->in;
+	if (state == be_lv_state_end)
+		return info->end;
+	assert(state == be_lv_state_out);
+	return info->out;
+}
+
+static inline bool be_lv_cls_is_live_xxx(const be_lv_cls_t *lvc,
+		const ir_node *block, const ir_node *irn, be_lv_state_t state)
+{
+	unsigned const idx = get_irn_idx(irn);
+	if (idx >= lvc->n_idx || lvc->numbers[idx] == 0)
+		return false;
+
+	const unsigned *const set = be_lv_cls_get_set(lvc, block, state);
+	return set != NULL && rbitset_is_set(set, lvc->numbers[idx] - 1);
+}
+
+#define be_lv_cls_is_live_in(lvc, bl, irn)  be_lv_cls_is_live_xxx(lvc, bl, irn, be_lv_state_in)
+#define be_lv_cls_is_live_end(lvc, bl, irn) be_lv_cls_is_live_xxx(lvc, bl, irn, be_lv_state_end)
+#define be_lv_cls_is_live_out(lvc, bl, irn) be_lv_cls_is_live_xxx(lvc, bl, irn, be_lv_state_out)
+
+/**
+ * Iterates over the values of the class in one liveness state at a block.
+ */
+#define be_lv_cls_foreach(lvc, block, state, node) \
+	for (unsigned const *set_ = be_lv_cls_get_set((lvc), (block), (state)); set_ != NULL; set_ = NULL) \
+		for (size_t nr_ = 0; (nr_ = rbitset_next_max(set_, nr_, (lvc)->n_values, true)) != (size_t)-1; ++nr_) \
+			for (ir_node *node = (lvc)->values[nr_]; node != NULL; node = NULL)
+
 #endif
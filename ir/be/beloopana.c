@@ -9,12 +9,11 @@
  * @author      Christian Wuerdig
  * @date        19.02.2007
  */
-#include "set.h"
 #include "irnode.h"
 #include "util.h"
 #include "irloop_t.h"
-#include "error.h"
 #include "debug.h"
+#include "pmap.h"
 
 #include "bearch.h"
 #include "beirg.h"
@@ -25,35 +24,22 @@
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
-#define HASH_LOOP_INFO(info) (hash_ptr((info)->loop) ^ hash_ptr((info)->cls))
-
-typedef struct be_loop_info_t {
-	ir_loop                     *loop;
-	const arch_register_class_t *cls;
-	unsigned                    max_pressure;
-} be_loop_info_t;
-
 struct be_loopana_t {
-	set *data;
+	arch_register_class_t const *cls;   /**< the class of the pressure */
+	be_lv_t                     *lv;    /**< liveness of the graph */
+	pmap                        *loops; /**< the pressure of each computed
+	                                         loop plus one */
 };
 
-static int cmp_loop_info(const void *a, const void *b, size_t size)
-{
-	const be_loop_info_t *i1 = (const be_loop_info_t*)a;
-	const be_loop_info_t *i2 = (const be_loop_info_t*)b;
-	(void) size;
-
-	return ! (i1->loop == i2->loop && i1->cls == i2->cls);
-}
-
 /**
  * Compute the highest register pressure in a block.
+ * @param loop_ana  The loop ana object.
  * @param block     The block to compute pressure for.
- * @param cls       The register class to compute pressure for.
  * @return The highest register pressure in the given block.
  */
-static unsigned be_compute_block_pressure(ir_node *const block, arch_register_class_t const *const cls)
+static unsigned be_compute_block_pressure(be_loopana_t *const loop_ana, ir_node *const block)
 {
+	arch_register_class_t const *const cls = loop_ana->cls;
 	ir_nodeset_t live_nodes;
 	size_t       max_live;
 
@@ -61,8 +47,7 @@ static unsigned be_compute_block_pressure(ir_node *const block, arch_register_cl
 
 	/* determine largest pressure with this block */
 	ir_nodeset_init(&live_nodes);
-	be_lv_t *const lv = be_get_irg_liveness(get_Block_irg(block));
-	be_liveness_end_of_block(lv, cls, block, &live_nodes);
+	be_liveness_end_of_block(loop_ana->lv, cls, block, &live_nodes);
 	max_live   = ir_nodeset_size(&live_nodes);
 
 	sched_foreach_reverse(block, irn) {
@@ -83,46 +68,40 @@ static unsigned be_compute_block_pressure(ir_node *const block, arch_register_cl
 }
 
 /**
- * Compute the highest register pressure in a loop and its sub-loops.
+ * Returns the highest register pressure in a loop and its sub-loops. The
+ * pressure is computed on the first request and kept for the later ones, so
+ * each block is walked at most once.
  * @param loop_ana  The loop ana object.
  * @param loop      The loop to compute pressure for.
- * @param cls       The register class to compute pressure for.
  * @return The highest register pressure in the given loop.
  */
-static unsigned be_compute_loop_pressure(be_loopana_t *loop_ana, ir_loop *loop,
-                                         const arch_register_class_t *cls)
+static unsigned be_compute_loop_pressure(be_loopana_t *loop_ana, ir_loop *loop)
 {
-	size_t         i, max;
-	unsigned       pressure;
-	be_loop_info_t *entry, key;
+	void *entry = pmap_get(void, loop_ana->loops, loop);
+	if (entry != NULL)
+		return PTR_TO_INT(entry) - 1;
 
 	DBG((dbg, LEVEL_1, "\nProcessing Loop %ld\n", loop->loop_nr));
 	assert(get_loop_n_elements(loop) > 0);
-	pressure = 0;
+	unsigned pressure = 0;
 
 	/* determine maximal pressure in all loop elements */
-	for (i = 0, max = get_loop_n_elements(loop); i < max; ++i) {
+	for (size_t i = 0, max = get_loop_n_elements(loop); i < max; ++i) {
 		unsigned     son_pressure;
 		loop_element elem = get_loop_element(loop, i);
 
 		if (*elem.kind == k_ir_node)
-			son_pressure = be_compute_block_pressure(elem.node, cls);
+			son_pressure = be_compute_block_pressure(loop_ana, elem.node);
 		else {
 			assert(*elem.kind == k_ir_loop);
-			son_pressure = be_compute_loop_pressure(loop_ana, elem.son, cls);
+			son_pressure = be_compute_loop_pressure(loop_ana, elem.son);
 		}
 
 		pressure = MAX(pressure, son_pressure);
 	}
-	DBG((dbg, LEVEL_1, "Done with loop %ld, pressure %u for class %s\n", loop->loop_nr, pressure, cls->name));
-
-	/* update info in set */
-	key.loop            = loop;
-	key.cls             = cls;
-	key.max_pressure    = 0;
-	entry               = set_insert(be_loop_info_t, loop_ana->data, &key, sizeof(key), HASH_LOOP_INFO(&key));
-	entry->max_pressure = MAX(entry->max_pressure, pressure);
+	DBG((dbg, LEVEL_1, "Done with loop %ld, pressure %u for class %s\n", loop->loop_nr, pressure, loop_ana->cls->name));
 
+	pmap_insert(loop_ana->loops, loop, INT_TO_PTR(pressure + 1));
 	return pressure;
 }
 
@@ -130,41 +109,30 @@ be_loopana_t *be_new_loop_pressure(ir_graph *const irg, arch_register_class_t co
 {
 	be_loopana_t *loop_ana = XMALLOC(be_loopana_t);
 
-	loop_ana->data = new_set(cmp_loop_info, 16);
+	loop_ana->cls   = cls;
+	loop_ana->lv    = be_get_irg_liveness(irg);
+	loop_ana->loops = pmap_create();
 
 	DBG((dbg, LEVEL_1, "\n=====================================================\n", cls->name));
-	DBG((dbg, LEVEL_1, " Computing register pressure for class %s:\n", cls->name));
+	DBG((dbg, LEVEL_1, " Register pressure for class %s:\n", cls->name));
 	DBG((dbg, LEVEL_1, "=====================================================\n", cls->name));
 
 	assure_loopinfo(irg);
 
-	be_compute_loop_pressure(loop_ana, get_irg_loop(irg), cls);
-
 	return loop_ana;
 }
 
 unsigned be_get_loop_pressure(be_loopana_t *loop_ana, const arch_register_class_t *cls, ir_loop *loop)
 {
-	unsigned pressure = INT_MAX;
-	be_loop_info_t *entry, key;
-
-	assert(cls && loop);
+	assert(cls == loop_ana->cls && loop);
+	(void)cls;
 
-	key.loop = loop;
-	key.cls  = cls;
-	entry    = set_find(be_loop_info_t, loop_ana->data, &key, sizeof(key), HASH_LOOP_INFO(&key));
-
-	if (entry)
-		pressure = entry->max_pressure;
-	else
-		panic("Pressure not computed for given class and loop object.");
-
-	return pressure;
+	return be_compute_loop_pressure(loop_ana, loop);
 }
 
 void be_free_loop_pressure(be_loopana_t *loop_ana)
 {
-	del_set(loop_ana->data);
+	pmap_destroy(loop_ana->loops);
 	free(loop_ana);
 }
 
@@ -19,7 +19,8 @@
 typedef struct be_loopana_t be_loopana_t;
 
 /**
- * Compute the register pressure for a class of all loops in the irg.
+ * Prepare the register pressure analysis for a class of all loops in the
+ * irg. The pressure of a loop is computed when it is requested first.
  * @param irg   The graph
  * @param cls   The register class to compute the pressure for
  * @return The loop analysis object.
@@ -27,8 +28,11 @@ typedef struct be_loopana_t be_loopana_t;
 be_loopana_t *be_new_loop_pressure(ir_graph *irg, arch_register_class_t const *cls);
 
 /**
- * Returns the computed register pressure for the given class and loop.
- * @return The pressure or INT_MAX if not found
+ * Returns the register pressure for the given class and loop.
+ * @param loop_ana  The loop analysis object
+ * @param cls       The register class of the loop analysis object
+ * @param loop      The loop
+ * @return The highest pressure in the loop and its sub-loops
  */
 unsigned be_get_loop_pressure(be_loopana_t *loop_ana,
                               const arch_register_class_t *cls, ir_loop *loop);
@@ -0,0 +1,43 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief       A simple machine model for instruction scheduling.
+ *
+ * The model describes an out-of-order core by the number of instructions it
+ * starts per cycle and a set of execution ports. Every instruction has a
+ * latency until its results are available, a set of ports it may execute on
+ * and the number of cycles it occupies the port before the next instruction
+ * can start there, i.e. its reciprocal throughput.
+ */
+#ifndef FIRM_BE_BEMACHINE_H
+#define FIRM_BE_BEMACHINE_H
+
+#include "firm_types.h"
+#include "be_types.h"
+
+/** The maximum number of execution ports of a machine model. */
+#define BE_MACHINE_MAX_PORTS 32
+
+/** Timing of an instruction. */
+typedef struct be_insn_timing_t {
+	unsigned latency;   /**< cycles until the results are available */
+	unsigned occupancy; /**< cycles the instruction blocks its port */
+	unsigned ports;     /**< bitmask of the ports the instruction may use,
+	                         0 if it needs none */
+} be_insn_timing_t;
+
+struct be_machine_t {
+	unsigned issue_width; /**< number of instructions started per cycle */
+	unsigned n_ports;     /**< number of execution ports */
+
+	/**
+	 * Get the timing of an instruction.
+	 */
+	void (*get_timing)(ir_node const *node, be_insn_timing_t *timing);
+};
+
+#endif
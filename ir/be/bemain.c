@@ -17,6 +17,7 @@
 
 #include "obst.h"
 #include "statev.h"
+#include "hashptr.h"
 #include "irprog.h"
 #include "irgopt.h"
 #include "irdump.h"
@@ -30,7 +31,9 @@
 #include "execfreq_t.h"
 #include "irprofile.h"
 #include "ircons.h"
+#include "irio.h"
 #include "util.h"
+#include "error.h"
 
 #include "bearch.h"
 #include "be_t.h"
@@ -55,6 +58,7 @@
 #include "beirg.h"
 #include "bestack.h"
 #include "beemitter.h"
+#include "bejit.h"
 
 #define NEW_ID(s) new_id_from_chars(s, sizeof(s) - 1)
 
@@ -64,12 +68,19 @@ be_options_t be_options = {
 	BE_TIME_OFF,                       /* no timing */
 	false,                             /* profile_generate */
 	false,                             /* profile_use */
+	false,                             /* profile_threads */
 	0,                                 /* try to omit frame pointer */
 	0,                                 /* create PIC code */
 	true,                              /* do verification */
+	0,                                 /* verify all graphs */
 	"",                                /* ilp server */
 	"",                                /* ilp solver */
 	1,                                 /* verbose assembler output */
+	false,                             /* drop graph bodies */
+	"",                                /* sample profile */
+	false,                             /* no floating point contraction */
+	false,                             /* full backend pipeline */
+	false,                             /* no hardware counters */
 };
 
 /* back end instruction set architecture to use */
@@ -97,13 +108,20 @@ static const lc_opt_table_entry_t be_main_options[] = {
 	LC_OPT_ENT_BOOL     ("omitfp",     "omit frame pointer",                                  &be_options.omit_fp),
 	LC_OPT_ENT_BOOL     ("pic",        "create PIC code",                                     &be_options.pic),
 	LC_OPT_ENT_BOOL     ("verify",     "verify the backend irg",                              &be_options.do_verify),
+	LC_OPT_ENT_INT      ("verifysample", "verify only about every n-th graph",                &be_options.verify_sample),
 	LC_OPT_ENT_BOOL     ("time",       "get backend timing statistics",                       &be_options.timing),
+	LC_OPT_ENT_BOOL     ("timecounters", "count hardware events in the timing statistics",   &be_options.time_counters),
 	LC_OPT_ENT_BOOL     ("profilegenerate", "instrument the code for execution count profiling",   &be_options.opt_profile_generate),
 	LC_OPT_ENT_BOOL     ("profileuse",      "use existing profile data",                           &be_options.opt_profile_use),
+	LC_OPT_ENT_BOOL     ("profilethreads",  "count per thread when instrumenting for profiling",   &be_options.opt_profile_threads),
 	LC_OPT_ENT_BOOL     ("verboseasm", "enable verbose assembler output",                     &be_options.verbose_asm),
+	LC_OPT_ENT_BOOL     ("dropirgs",   "free graph bodies after emitting them",               &be_options.drop_irgs),
+	LC_OPT_ENT_BOOL     ("fpcontract", "fuse floating point multiply and add",               &be_options.fp_contract),
+	LC_OPT_ENT_BOOL     ("fast",       "use a fast pipeline for low compile latency",         &be_options.fast),
 
 	LC_OPT_ENT_STR("ilp.server", "the ilp server name", &be_options.ilp_server),
 	LC_OPT_ENT_STR("ilp.solver", "the ilp solver name", &be_options.ilp_solver),
+	LC_OPT_ENT_STR("sampleprofile", "use the AutoFDO sample profile in the given file", &be_options.sample_profile),
 	LC_OPT_LAST
 };
 
@@ -264,7 +282,7 @@ int be_parse_arg(const char *arg)
 /* Perform schedule verification if requested. */
 static void be_sched_verify(ir_graph *irg)
 {
-	if (be_options.do_verify) {
+	if (be_should_verify(irg)) {
 		be_timer_push(T_VERIFY);
 		be_verify_schedule(irg);
 		be_timer_pop(T_VERIFY);
@@ -285,6 +303,11 @@ void firm_be_finish(void)
 	be_quit_modules();
 }
 
+void firm_be_reset(void)
+{
+	finish_isa();
+}
+
 /* Returns the backend parameter */
 const backend_params *be_get_backend_param(void)
 {
@@ -360,6 +383,24 @@ static void be_done_env(be_main_env_t *env)
 /**
  * Prepare a backend graph for code generation and initialize its irg
  */
+/**
+ * Decides whether the verifiers run on @p irg. With a verify sample of n only
+ * about every n-th graph is verified. The graphs are picked by their name, so
+ * the selection does not depend on the order of the graphs.
+ */
+static bool select_for_verify(const ir_graph *irg)
+{
+	if (!be_options.do_verify)
+		return false;
+
+	int const sample = be_options.verify_sample;
+	if (sample <= 1)
+		return true;
+
+	ir_entity const *const entity = get_irg_entity(irg);
+	return hash_str(get_entity_ld_name(entity)) % (unsigned)sample == 0;
+}
+
 static void initialize_birg(be_irg_t *birg, ir_graph *irg, be_main_env_t *env)
 {
 	/* don't duplicate locals in backend when dumping... */
@@ -375,7 +416,9 @@ static void initialize_birg(be_irg_t *birg, ir_graph *irg, be_main_env_t *env)
 
 	memset(birg, 0, sizeof(*birg));
 	birg->main_env = env;
+	birg->verify   = select_for_verify(irg);
 	obstack_init(&birg->obst);
+	obstack_init(&birg->info_obst);
 	irg->be_data = birg;
 
 	be_info_init_irg(irg);
@@ -386,7 +429,7 @@ static void initialize_birg(be_irg_t *birg, ir_graph *irg, be_main_env_t *env)
 
 int be_timing;
 
-static const char *get_timer_name(be_timer_id_t id)
+const char *be_get_timer_name(be_timer_id_t id)
 {
 	switch (id) {
 	case T_ABI:            return "abi";
@@ -420,7 +463,9 @@ void be_lower_for_target(void)
 {
 	initialize_isa();
 
+	ir_pass_stat_begin(NULL, "lower_for_target");
 	isa_if->lower_for_target();
+	ir_pass_stat_end();
 	/* set the phase to low */
 	for (size_t i = get_irp_n_irgs(); i-- > 0;) {
 		ir_graph *irg = get_irp_irg(i);
@@ -429,6 +474,181 @@ void be_lower_for_target(void)
 	}
 }
 
+/**
+ * Runs the per-graph part of the backend which does not produce any output:
+ * code selection, scheduling, constraint handling and register allocation.
+ * Everything done here only touches the graph and its birg, the emitter is
+ * not used yet.
+ * Optimizations are switched off before the constraint handling; their
+ * previous state is saved in @p state and has to be restored by the caller
+ * after emission.
+ */
+static void be_codegen_graph(ir_graph *irg, optimization_state_t *state)
+{
+	arch_env_t const *const arch_env = be_get_irg_arch_env(irg);
+
+	/* Verify the initial graph */
+	if (be_should_verify(irg)) {
+		be_timer_push(T_VERIFY);
+		irg_assert_verify(irg);
+		be_timer_pop(T_VERIFY);
+	}
+
+	/* prepare and perform codeselection */
+	if (arch_env->impl->prepare_graph != NULL)
+		arch_env->impl->prepare_graph(irg);
+
+	/* schedule the irg */
+	be_timer_push(T_SCHED);
+	be_schedule_graph(irg);
+	be_info_compact(irg);
+	be_timer_pop(T_SCHED);
+
+	be_dump(DUMP_SCHED, irg, "sched");
+
+	/* check schedule */
+	be_sched_verify(irg);
+
+	/* introduce patterns to assure constraints */
+	be_timer_push(T_CONSTR);
+	/* we switch off optimizations here, because they might cause trouble */
+	save_optimization_state(state);
+	set_optimize(0);
+	set_opt_cse(0);
+
+	/* add Keeps for should_be_different constrained nodes  */
+	/* beware: needs schedule due to usage of be_ssa_constr */
+	assure_constraints(irg);
+	be_timer_pop(T_CONSTR);
+
+	be_dump(DUMP_SCHED, irg, "assured");
+
+	/* stuff needs to be done after scheduling but before register allocation */
+	be_timer_push(T_RA_PREPARATION);
+	if (arch_env->impl->before_ra != NULL)
+		arch_env->impl->before_ra(irg);
+	be_timer_pop(T_RA_PREPARATION);
+
+	/* connect all stack modifying nodes together (see beabi.c) */
+	be_timer_push(T_ABI);
+	be_abi_fix_stack_nodes(irg);
+	be_timer_pop(T_ABI);
+
+	be_dump(DUMP_SCHED, irg, "fix_stack");
+
+	/* check schedule */
+	be_sched_verify(irg);
+
+	if (stat_ev_enabled) {
+		stat_ev_dbl("bemain_costs_before_ra", be_estimate_irg_costs(irg));
+		stat_ev_ull("bemain_insns_before_ra", be_count_insns(irg));
+		stat_ev_ull("bemain_blocks_before_ra", be_count_blocks(irg));
+	}
+
+	/* Do register allocation */
+	be_allocate_registers(irg);
+	be_info_compact(irg);
+
+	if (be_should_verify(irg)) {
+		be_timer_push(T_VERIFY);
+		be_verify_register_allocation(irg);
+		be_timer_pop(T_VERIFY);
+	}
+
+	if (stat_ev_enabled) {
+		stat_ev_dbl("bemain_costs_after_ra", be_estimate_irg_costs(irg));
+		stat_ev_ull("bemain_insns_after_ra", be_count_insns(irg));
+		stat_ev_ull("bemain_blocks_after_ra", be_count_blocks(irg));
+	}
+
+	be_dump(DUMP_RA, irg, "ra");
+}
+
+/**
+ * Emits the assembler code for a graph which went through be_codegen_graph().
+ * Graphs must be emitted in the order of the irp.
+ */
+static void be_emit_graph(ir_graph *irg)
+{
+	arch_env_t const *const arch_env = be_get_irg_arch_env(irg);
+
+	be_timer_push(T_EMIT);
+	if (arch_env->impl->emit != NULL)
+		arch_env->impl->emit(irg);
+	be_timer_pop(T_EMIT);
+
+	if (stat_ev_enabled) {
+		stat_ev_ull("bemain_insns_finish", be_count_insns(irg));
+		stat_ev_ull("bemain_blocks_finish", be_count_blocks(irg));
+	}
+
+	be_dump(DUMP_FINAL, irg, "final");
+}
+
+/**
+ * Runs the whole backend pipeline on a graph, from code selection to
+ * emission.
+ */
+static void be_compile_graph(ir_graph *irg)
+{
+	/* stop and reset timers */
+	ir_pass_stat_begin(irg, "backend");
+	be_timer_push(T_OTHER);
+
+	optimization_state_t state;
+	be_codegen_graph(irg, &state);
+	be_emit_graph(irg);
+
+	restore_optimization_state(&state);
+
+	be_timer_pop(T_OTHER);
+	ir_pass_stat_end();
+}
+
+/**
+ * Reports and resets the per-graph backend timers.
+ */
+static void be_report_timers(ir_graph *irg)
+{
+	bool const counters = ir_timer_counters_enabled();
+	if (stat_ev_enabled) {
+		for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
+			char buf[128];
+			snprintf(buf, sizeof(buf), "bemain_time_%s",
+			         be_get_timer_name(t));
+			stat_ev_dbl(buf, ir_timer_elapsed_usec(be_timers[t]));
+			if (!counters)
+				continue;
+			for (ir_timer_counter_t c = ir_timer_counter_cycles;
+			     c <= ir_timer_counter_last; ++c) {
+				snprintf(buf, sizeof(buf), "bemain_%s_%s",
+				         ir_timer_counter_name(c), be_get_timer_name(t));
+				stat_ev_ull(buf, ir_timer_elapsed_counter(be_timers[t], c));
+			}
+		}
+	} else {
+		printf("==>> IRG %s <<==\n",
+		       get_entity_name(get_irg_entity(irg)));
+		for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
+			double val = ir_timer_elapsed_usec(be_timers[t]) / 1000.0;
+			printf("%-20s: %10.3f msec", be_get_timer_name(t), val);
+			if (counters) {
+				ir_timer_t *const timer   = be_timers[t];
+				double      const cycles  = ir_timer_elapsed_counter(timer, ir_timer_counter_cycles);
+				double      const instrs  = ir_timer_elapsed_counter(timer, ir_timer_counter_instructions);
+				printf(" %14.0f cycles %6.2f IPC %10llu cache misses %10llu branch misses",
+				       cycles, cycles > 0 ? instrs / cycles : 0.0,
+				       ir_timer_elapsed_counter(timer, ir_timer_counter_cache_misses),
+				       ir_timer_elapsed_counter(timer, ir_timer_counter_branch_misses));
+			}
+			putchar('\n');
+		}
+	}
+	for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
+		ir_timer_reset(be_timers[t]);
+	}
+}
+
 /**
  * The Firm backend main loop.
  * Do architecture specific lowering for all graphs
@@ -437,15 +657,41 @@ void be_lower_for_target(void)
  * @param file_handle   the file handle the output will be written to
  * @param cup_name      name of the compilation unit
  */
-static void be_main_loop(FILE *file_handle, const char *cup_name)
+/**
+ * Selects the cheapest implementation of each configurable backend phase.
+ * Used by the "fast" option: trivial scheduling, linear scan register
+ * allocation (no copy minimization) and a naive block order.  The
+ * architecture specific peephole optimizations check be_options.fast
+ * themselves.
+ */
+static void be_select_fast_pipeline(void)
+{
+	static const char *const fast_args[] = {
+		"scheduler=trivial",
+		"regalloc=linearscan",
+		"blockscheduler=naiv",
+	};
+	for (size_t i = 0; i < ARRAY_SIZE(fast_args); ++i) {
+		int const res = be_parse_arg(fast_args[i]);
+		assert(res);
+		(void)res;
+	}
+}
+
+static size_t be_main_loop(FILE *file_handle, const char *cup_name)
 {
 	be_timing = (be_options.timing == BE_TIME_ON);
 
+	if (be_options.fast)
+		be_select_fast_pipeline();
+
 	/* perform target lowering if it didn't happen yet */
 	if (get_irp_n_irgs() > 0 && !irg_is_constrained(get_irp_irg(0), IR_GRAPH_CONSTRAINT_TARGET_LOWERED))
 		be_lower_for_target();
 
 	if (be_timing) {
+		if (be_options.time_counters && !ir_timer_enable_counters())
+			fprintf(stderr, "warning: hardware counters not available\n");
 		for (size_t i = 0; i < T_LAST+1; ++i) {
 			be_timers[i] = ir_timer_new();
 		}
@@ -490,14 +736,25 @@ static void be_main_loop(FILE *file_handle, const char *cup_name)
 			fprintf(stderr, "Warning: Couldn't read profile data '%s'\n",
 			        prof_filename);
 		} else {
+			for (size_t i = 0; i < num_irgs; ++i) {
+				ir_graph *irg   = get_irp_irg(i);
+				be_irg_t *birg  = be_birg_from_irg(irg);
+				ir_node  *start = get_irg_start_block(irg);
+				/* graphs the profile does not know about keep their
+				 * placement */
+				if (birg != NULL && ir_profile_has_block_execcount(start))
+					birg->cold = ir_profile_get_block_execcount(start) == 0;
+			}
 			ir_create_execfreqs_from_profile();
-			ir_profile_free();
+			/* the counts stay available for the block scheduler, they are
+			 * freed once all graphs are emitted */
 			have_profile = true;
 		}
 	}
 
 	if (num_birgs > 0 && be_options.opt_profile_generate) {
-		ir_graph *const prof_init_irg = ir_profile_instrument(prof_filename);
+		ir_graph *const prof_init_irg = ir_profile_instrument(prof_filename,
+			be_options.opt_profile_threads);
 		assert(prof_init_irg->be_data == NULL);
 		initialize_birg(&birgs[num_birgs], prof_init_irg, &env);
 		num_birgs++;
@@ -509,155 +766,107 @@ static void be_main_loop(FILE *file_handle, const char *cup_name)
 		ir_timer_init_parent(be_timers[t]);
 	}
 	if (!have_profile) {
+		bool have_samples = false;
+		if (be_options.sample_profile[0] != '\0') {
+			have_samples = ir_sample_profile_read(be_options.sample_profile);
+			if (!have_samples)
+				fprintf(stderr, "Warning: Couldn't read sample profile '%s'\n",
+				        be_options.sample_profile);
+		}
+
 		be_timer_push(T_EXECFREQ);
 		for (size_t i = 0; i < num_irgs; ++i) {
 			ir_graph *irg = get_irp_irg(i);
-			ir_estimate_execfreq(irg);
+			if (!have_samples || !ir_sample_profile_apply(irg))
+				ir_estimate_execfreq(irg);
 		}
 		be_timer_pop(T_EXECFREQ);
+		if (have_samples)
+			ir_sample_profile_free();
 	}
 
 	/* For all graphs */
+	size_t n_compiled = 0;
 	for (size_t i = 0; i < num_irgs; ++i) {
 		ir_graph  *const irg    = get_irp_irg(i);
 		ir_entity *const entity = get_irg_entity(irg);
 		if (get_entity_linkage(entity) & IR_LINKAGE_NO_CODEGEN)
 			continue;
+		++n_compiled;
 
 		if (stat_ev_enabled) {
 			stat_ev_ctx_push_fmt("bemain_irg", "%+F", irg);
 			stat_ev_ull("bemain_insns_start", be_count_insns(irg));
 			stat_ev_ull("bemain_blocks_start", be_count_blocks(irg));
+			stat_ev_ull("bemain_irg_hash", ir_hash_irg(irg));
 		}
 
-		/* stop and reset timers */
-		be_timer_push(T_OTHER);
-
-		/* Verify the initial graph */
-		if (be_options.do_verify) {
-			be_timer_push(T_VERIFY);
-			irg_assert_verify(irg);
-			be_timer_pop(T_VERIFY);
-		}
-
-		/* prepare and perform codeselection */
-		if (arch_env->impl->prepare_graph != NULL)
-			arch_env->impl->prepare_graph(irg);
-
-		/* schedule the irg */
-		be_timer_push(T_SCHED);
-		be_schedule_graph(irg);
-		be_timer_pop(T_SCHED);
-
-		be_dump(DUMP_SCHED, irg, "sched");
-
-		/* check schedule */
-		be_sched_verify(irg);
-
-		/* introduce patterns to assure constraints */
-		be_timer_push(T_CONSTR);
-		/* we switch off optimizations here, because they might cause trouble */
-		optimization_state_t state;
-		save_optimization_state(&state);
-		set_optimize(0);
-		set_opt_cse(0);
-
-		/* add Keeps for should_be_different constrained nodes  */
-		/* beware: needs schedule due to usage of be_ssa_constr */
-		assure_constraints(irg);
-		be_timer_pop(T_CONSTR);
-
-		be_dump(DUMP_SCHED, irg, "assured");
-
-		/* stuff needs to be done after scheduling but before register allocation */
-		be_timer_push(T_RA_PREPARATION);
-		if (arch_env->impl->before_ra != NULL)
-			arch_env->impl->before_ra(irg);
-		be_timer_pop(T_RA_PREPARATION);
-
-		/* connect all stack modifying nodes together (see beabi.c) */
-		be_timer_push(T_ABI);
-		be_abi_fix_stack_nodes(irg);
-		be_timer_pop(T_ABI);
-
-		be_dump(DUMP_SCHED, irg, "fix_stack");
-
-		/* check schedule */
-		be_sched_verify(irg);
-
-		if (stat_ev_enabled) {
-			stat_ev_dbl("bemain_costs_before_ra", be_estimate_irg_costs(irg));
-			stat_ev_ull("bemain_insns_before_ra", be_count_insns(irg));
-			stat_ev_ull("bemain_blocks_before_ra", be_count_blocks(irg));
-		}
+		be_compile_graph(irg);
 
-		/* Do register allocation */
-		be_allocate_registers(irg);
+		if (be_timing)
+			be_report_timers(irg);
 
-		if (be_options.do_verify) {
-			be_timer_push(T_VERIFY);
-			be_verify_register_allocation(irg);
-			be_timer_pop(T_VERIFY);
-		}
+		be_free_birg(irg);
+		if (be_options.drop_irgs)
+			free_irg_body(irg);
+		stat_ev_ctx_pop("bemain_irg");
+	}
 
-		if (stat_ev_enabled) {
-			stat_ev_dbl("bemain_costs_after_ra", be_estimate_irg_costs(irg));
-			stat_ev_ull("bemain_insns_after_ra", be_count_insns(irg));
-			stat_ev_ull("bemain_blocks_after_ra", be_count_blocks(irg));
-		}
+	if (have_profile)
+		ir_profile_free();
 
-		be_dump(DUMP_RA, irg, "ra");
+	be_gas_end_compilation_unit(&env);
+	be_emit_exit();
 
-		/* emit assembler code */
-		be_timer_push(T_EMIT);
-		if (arch_env->impl->emit != NULL)
-			arch_env->impl->emit(irg);
-		be_timer_pop(T_EMIT);
+	arch_env_end_codegeneration(arch_env);
 
-		if (stat_ev_enabled) {
-			stat_ev_ull("bemain_insns_finish", be_count_insns(irg));
-			stat_ev_ull("bemain_blocks_finish", be_count_blocks(irg));
-		}
+	be_done_env(&env);
 
-		be_dump(DUMP_FINAL, irg, "final");
+	be_info_free();
+	return n_compiled;
+}
 
-		restore_optimization_state(&state);
+ir_jit_code_t *be_jit_compile(size_t n_irgs, ir_graph *const *irgs,
+                              be_jit_resolver_t resolver, void *data)
+{
+	be_timing = false;
 
-		be_timer_pop(T_OTHER);
+	/* perform target lowering if it didn't happen yet */
+	if (n_irgs > 0 && !irg_is_constrained(irgs[0], IR_GRAPH_CONSTRAINT_TARGET_LOWERED))
+		be_lower_for_target();
 
-		if (be_timing) {
-			if (stat_ev_enabled) {
-				for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
-					char buf[128];
-					snprintf(buf, sizeof(buf), "bemain_time_%s",
-					         get_timer_name(t));
-					stat_ev_dbl(buf, ir_timer_elapsed_usec(be_timers[t]));
-				}
-			} else {
-				printf("==>> IRG %s <<==\n",
-				       get_entity_name(get_irg_entity(irg)));
-				for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
-					double val = ir_timer_elapsed_usec(be_timers[t]) / 1000.0;
-					printf("%-20s: %10.3f msec\n", get_timer_name(t), val);
-				}
-			}
-			for (be_timer_id_t t = T_FIRST; t < T_LAST+1; ++t) {
-				ir_timer_reset(be_timers[t]);
-			}
-		}
+	be_main_env_t env;
+	be_init_env(&env, "<jit>");
+	be_info_init();
+	arch_env_t *arch_env = env.arch_env;
+	if (!arch_env->supports_jit)
+		panic("backend does not support JIT compilation");
+
+	/* the binary emitter writes into the JIT buffer, there is no assembler
+	 * output */
+	be_emit_init(NULL);
+	be_jit_begin();
+
+	be_irg_t *birgs = XMALLOCN(be_irg_t, n_irgs);
+	for (size_t i = 0; i < n_irgs; ++i) {
+		ir_graph *irg = irgs[i];
+		initialize_birg(&birgs[i], irg, &env);
+		ir_estimate_execfreq(irg);
+	}
 
+	for (size_t i = 0; i < n_irgs; ++i) {
+		ir_graph *const irg = irgs[i];
+		be_compile_graph(irg);
 		be_free_birg(irg);
-		stat_ev_ctx_pop("bemain_irg");
 	}
+	free(birgs);
 
-	be_gas_end_compilation_unit(&env);
 	be_emit_exit();
-
 	arch_env_end_codegeneration(arch_env);
-
 	be_done_env(&env);
-
 	be_info_free();
+
+	return be_jit_finish(resolver, data);
 }
 
 /* Main interface to the frontend. */
@@ -685,7 +894,7 @@ void be_main(FILE *file_handle, const char *cup_name)
 		stat_ev_ctx_push_str("bemain_compilation_unit", cup_name);
 	}
 
-	be_main_loop(file_handle, cup_name);
+	size_t const n_compiled = be_main_loop(file_handle, cup_name);
 
 	if (be_options.timing == BE_TIME_ON) {
 		ir_timer_stop(t);
@@ -695,6 +904,11 @@ void be_main(FILE *file_handle, const char *cup_name)
 		} else {
 			double val = ir_timer_elapsed_usec(t) / 1000.0;
 			printf("%-20s: %10.3f msec\n", "BEMAINLOOP", val);
+			/* latency from lowered graph to emitted assembler per function */
+			if (n_compiled > 0) {
+				double per_irg = ir_timer_elapsed_usec(t) / (double)n_compiled;
+				printf("%-20s: %10.3f usec\n", "BEMAINLOOP/irg", per_irg);
+			}
 		}
 	}
 
@@ -50,6 +50,7 @@ void be_init_ra(void);
 void be_init_spillbelady(void);
 void be_init_ssaconstr(void);
 void be_init_pref_alloc(void);
+void be_init_linearscan(void);
 void be_init_irgmod(void);
 void be_init_loopana(void);
 void be_init_spillslots(void);
@@ -107,6 +108,7 @@ void be_init_modules(void)
 	be_init_dwarf();
 	be_init_ssaconstr();
 	be_init_pref_alloc();
+	be_init_linearscan();
 	be_init_state();
 
 	be_init_arch_ia32();
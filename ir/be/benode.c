@@ -61,6 +61,8 @@ typedef struct {
 	unsigned       pop;          /**< number of bytes that should be popped */
 	int            emit_pop;     /**< if set, emit pop bytes, even if pop = 0 */
 	bool           destroy_stackframe; /**< if set destroys the stackframe */
+	ir_entity     *tail_call;    /**< if set, jump to this entity instead of
+	                                  returning */
 } be_return_attr_t;
 
 /** The be_IncSP attribute type. */
@@ -144,6 +146,8 @@ static int Return_cmp_attr(const ir_node *a, const ir_node *b)
 		return 1;
 	if (a_attr->emit_pop != b_attr->emit_pop)
 		return 1;
+	if (a_attr->tail_call != b_attr->tail_call)
+		return 1;
 
 	return be_nodes_equal(a, b);
 }
@@ -541,6 +545,7 @@ ir_node *be_new_Return(dbg_info *const dbg, ir_node *const block, int const n_re
 	a->num_ret_vals       = n_res;
 	a->pop                = pop;
 	a->emit_pop           = 0;
+	a->tail_call          = NULL;
 	a->base.exc.pin_state = op_pin_state_pinned;
 
 	return res;
@@ -553,6 +558,13 @@ void be_return_set_destroy_stackframe(ir_node *node, bool value)
 	attr->destroy_stackframe = value;
 }
 
+bool be_return_get_destroy_stackframe(const ir_node *node)
+{
+	const be_return_attr_t *attr = (const be_return_attr_t*) get_irn_generic_attr_const(node);
+	assert(be_is_Return(node));
+	return attr->destroy_stackframe;
+}
+
 int be_Return_get_n_rets(const ir_node *ret)
 {
 	const be_return_attr_t *a = (const be_return_attr_t*)get_irn_generic_attr_const(ret);
@@ -577,6 +589,18 @@ void be_Return_set_emit_pop(ir_node *ret, int emit_pop)
 	a->emit_pop = emit_pop;
 }
 
+ir_entity *be_Return_get_tail_call(const ir_node *ret)
+{
+	const be_return_attr_t *a = (const be_return_attr_t*)get_irn_generic_attr_const(ret);
+	return a->tail_call;
+}
+
+void be_Return_set_tail_call(ir_node *ret, ir_entity *callee)
+{
+	be_return_attr_t *a = (be_return_attr_t*)get_irn_generic_attr(ret);
+	a->tail_call = callee;
+}
+
 ir_node *be_new_IncSP(const arch_register_t *sp, ir_node *bl,
                       ir_node *old_sp, int offset, int align)
 {
@@ -674,6 +698,13 @@ void be_start_set_setup_stackframe(ir_node *node, bool value)
 	attr->setup_stackframe = value;
 }
 
+bool be_start_get_setup_stackframe(const ir_node *node)
+{
+	const be_start_attr_t *attr = (const be_start_attr_t*) get_irn_generic_attr_const(node);
+	assert(be_is_Start(node));
+	return attr->setup_stackframe;
+}
+
 ir_node *be_new_FrameAddr(const arch_register_class_t *cls_frame, ir_node *bl, ir_node *frame, ir_entity *ent)
 {
 	be_frame_attr_t *a;
@@ -1170,6 +1201,11 @@ static void dump_node(FILE *f, const ir_node *irn, dump_reason_t reason)
 				const be_incsp_attr_t *attr = (const be_incsp_attr_t*)get_irn_generic_attr_const(irn);
 				fprintf(f, " [%d] ", attr->offset);
 			}
+			if (be_is_Return(irn)) {
+				ir_entity *const callee = be_Return_get_tail_call(irn);
+				if (callee != NULL)
+					fprintf(f, " [tail %s] ", get_entity_name(callee));
+			}
 			break;
 		case dump_node_info_txt:
 			arch_dump_reqs_and_registers(f, irn);
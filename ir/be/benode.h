@@ -362,10 +362,30 @@ void be_Return_set_emit_pop(ir_node *ret, int emit_pop);
 
 void be_return_set_destroy_stackframe(ir_node *node, bool value);
 
+bool be_return_get_destroy_stackframe(const ir_node *node);
+
+/**
+ * Return the entity a sibling call Return jumps to, or NULL if this is an
+ * ordinary return.
+ *
+ * @param ret  the be_Return node
+ */
+ir_entity *be_Return_get_tail_call(const ir_node *ret);
+
+/**
+ * Turn the Return into a jump to @p callee (sibling call).
+ *
+ * @param ret     the be_Return node
+ * @param callee  the called function entity
+ */
+void be_Return_set_tail_call(ir_node *ret, ir_entity *callee);
+
 ir_node *be_new_Start(dbg_info *dbgi, ir_node *block, int n_out);
 
 void be_start_set_setup_stackframe(ir_node *node, bool value);
 
+bool be_start_get_setup_stackframe(const ir_node *node);
+
 enum {
 	n_be_CopyKeep_op = 0
 };
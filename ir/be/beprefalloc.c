@@ -1110,6 +1110,35 @@ static bool is_aligned(unsigned num, unsigned alignment)
 	return (num&mask) == 0;
 }
 
+/**
+ * Assigns a register to each of the @p n_rows rows of the utility matrix
+ * @p util, which has a column for each register, maximizing the utility.
+ */
+static void solve_matching(unsigned n_rows, const unsigned *util,
+                           unsigned *assignment)
+{
+	if (n_regs <= HUNGARIAN_SMALL_MAX) {
+		hungarian_solve_small(n_rows, n_regs, util, assignment);
+		return;
+	}
+
+	hungarian_problem_t *bp
+		= hungarian_new(n_rows, n_regs, HUNGARIAN_MATCH_PERFECT);
+	for (unsigned r = 0; r < n_rows; ++r) {
+		for (unsigned c = 0; c < n_regs; ++c) {
+			if (util[r*n_regs + c] != 0)
+				hungarian_add(bp, r, c, util[r*n_regs + c]);
+		}
+	}
+	hungarian_prepare_cost_matrix(bp, HUNGARIAN_MODE_MAXIMIZE_UTIL);
+
+	int res = hungarian_solve(bp, assignment, NULL, 0);
+	(void)res;
+	assert(res == 0);
+
+	hungarian_free(bp);
+}
+
 /**
  * Enforce constraints at a node by live range splits.
  *
@@ -1183,13 +1212,12 @@ static void enforce_constraints(ir_nodeset_t *live_nodes, ir_node *node,
 	 *       right, destinations left because this will produce the solution
 	 *       in the format required for permute_values.
 	 */
-	hungarian_problem_t *bp
-		= hungarian_new(n_regs, n_regs, HUNGARIAN_MATCH_PERFECT);
+	unsigned *util = ALLOCANZ(unsigned, n_regs * n_regs);
 
 	/* add all combinations, then remove not allowed ones */
 	for (unsigned l = 0; l < n_regs; ++l) {
 		if (!rbitset_is_set(normal_regs, l)) {
-			hungarian_add(bp, l, l, 1);
+			util[l*n_regs + l] = 1;
 			continue;
 		}
 
@@ -1201,7 +1229,7 @@ static void enforce_constraints(ir_nodeset_t *live_nodes, ir_node *node,
 					&& rbitset_is_set(forbidden_regs, r))
 				continue;
 
-			hungarian_add(bp, r, l, l == r ? 9 : 8);
+			util[r*n_regs + l] = l == r ? 9 : 8;
 		}
 	}
 
@@ -1215,19 +1243,12 @@ static void enforce_constraints(ir_nodeset_t *live_nodes, ir_node *node,
 		for (unsigned r = 0; r < n_regs; ++r) {
 			if (rbitset_is_set(limited, r))
 				continue;
-			hungarian_remove(bp, r, current_reg);
+			util[r*n_regs + current_reg] = 0;
 		}
 	);
 
-	//hungarian_print_cost_matrix(bp, 1);
-	hungarian_prepare_cost_matrix(bp, HUNGARIAN_MODE_MAXIMIZE_UTIL);
-
 	unsigned *assignment = ALLOCAN(unsigned, n_regs);
-	int       res        = hungarian_solve(bp, assignment, NULL, 0);
-	(void)res;
-	assert(res == 0);
-
-	hungarian_free(bp);
+	solve_matching(n_regs, util, assignment);
 
 	permute_values(live_nodes, node, assignment);
 }
@@ -1410,9 +1431,8 @@ static void assign_phi_registers(ir_node *block)
 		return;
 
 	/* build a bipartite matching problem for all phi nodes */
-	hungarian_problem_t *bp
-		= hungarian_new(n_phis, n_regs, HUNGARIAN_MATCH_PERFECT);
-	int n = 0;
+	unsigned *util = ALLOCANZ(unsigned, n_phis * n_regs);
+	int       n    = 0;
 	sched_foreach(block, node) {
 		if (!is_Phi(node))
 			break;
@@ -1432,7 +1452,7 @@ static void assign_phi_registers(ir_node *block)
 			costs = costs < 0 ? -logf(-costs+1) : logf(costs+1);
 			costs *= 100;
 			costs += 10000;
-			hungarian_add(bp, n, r, (int)costs);
+			util[n*n_regs + r] = (int)costs;
 			DB((dbg, LEVEL_3, " %s(%f)", arch_register_for_index(cls, r)->name,
 						info->prefs[r]));
 		}
@@ -1440,13 +1460,8 @@ static void assign_phi_registers(ir_node *block)
 		++n;
 	}
 
-	//hungarian_print_cost_matrix(bp, 7);
-	hungarian_prepare_cost_matrix(bp, HUNGARIAN_MODE_MAXIMIZE_UTIL);
-
 	unsigned *assignment = ALLOCAN(unsigned, n_regs);
-	int       res        = hungarian_solve(bp, assignment, NULL, 0);
-	(void)res;
-	assert(res == 0);
+	solve_matching(n_phis, util, assignment);
 
 	/* apply results */
 	n = 0;
@@ -1858,7 +1873,7 @@ static void be_pref_alloc(ir_graph *new_irg)
 		spill();
 
 		/* verify schedule and register pressure */
-		if (be_options.do_verify) {
+		if (be_should_verify(irg)) {
 			be_timer_push(T_VERIFY);
 			be_verify_schedule(irg);
 			be_verify_register_pressure(irg, cls);
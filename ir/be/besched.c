@@ -26,6 +26,7 @@
 #include "lc_opts.h"
 #include "lc_opts_enum.h"
 #include "irtools.h"
+#include "irgwalk.h"
 
 #define SCHED_INITIAL_GRANULARITY (1 << 14)
 
@@ -83,6 +84,7 @@ void sched_add_before(ir_node *before, ir_node *irn)
 	sched_info_t *prev_info = get_irn_sched_info(prev);
 	assert(sched_is_scheduled(before));
 	assert(!sched_is_scheduled(irn));
+	assert(!sched_is_frozen(get_irn_irg(irn)));
 	assert(!is_Proj(before));
 	assert(!is_Proj(irn));
 
@@ -102,6 +104,7 @@ void sched_add_after(ir_node *after, ir_node *irn)
 	sched_info_t *next_info = get_irn_sched_info(next);
 	assert(sched_is_scheduled(after));
 	assert(!sched_is_scheduled(irn));
+	assert(!sched_is_frozen(get_irn_irg(irn)));
 	assert(!is_Proj(after));
 	assert(!is_Proj(irn));
 
@@ -120,6 +123,7 @@ void sched_remove(ir_node *irn)
 	sched_info_t *prev_info = get_irn_sched_info(prev);
 	sched_info_t *next_info = get_irn_sched_info(next);
 	assert(sched_is_scheduled(irn));
+	assert(!sched_is_frozen(get_irn_irg(irn)));
 
 	prev_info->next = next;
 	next_info->prev = prev;
@@ -131,6 +135,7 @@ void sched_replace(ir_node *const old, ir_node *const irn)
 {
 	assert(sched_is_scheduled(old));
 	assert(!sched_is_scheduled(irn));
+	assert(!sched_is_frozen(get_irn_irg(irn)));
 
 	sched_info_t *const old_info = get_irn_sched_info(old);
 	sched_info_t *const irn_info = get_irn_sched_info(irn);
@@ -145,6 +150,43 @@ void sched_replace(ir_node *const old, ir_node *const irn)
 	get_irn_sched_info(next)->prev = irn;
 }
 
+static void freeze_block(ir_node *block, void *data)
+{
+	be_irg_t *birg    = (be_irg_t*)data;
+	unsigned  n_nodes = 0;
+	sched_foreach(block, irn) {
+		++n_nodes;
+	}
+
+	sched_array_t *arr = OALLOCF(&birg->obst, sched_array_t, nodes, n_nodes);
+	arr->n_nodes = n_nodes;
+	unsigned pos = 0;
+	sched_foreach(block, irn) {
+		/* time step 0 belongs to the block */
+		get_irn_sched_info(irn)->time_step = pos + 1;
+		arr->nodes[pos++] = irn;
+	}
+	ir_nodemap_insert(&birg->sched_arrays, block, arr);
+}
+
+void sched_freeze(ir_graph *irg)
+{
+	be_irg_t *birg = be_birg_from_irg(irg);
+	assert(!birg->sched_frozen);
+	ir_nodemap_init(&birg->sched_arrays, irg);
+	irg_block_walk_graph(irg, freeze_block, NULL, birg);
+	birg->sched_frozen = true;
+}
+
+void sched_thaw(ir_graph *irg)
+{
+	be_irg_t *birg = be_birg_from_irg(irg);
+	assert(birg->sched_frozen);
+	/* the arrays themselves live on the birg obstack */
+	ir_nodemap_destroy(&birg->sched_arrays);
+	birg->sched_frozen = false;
+}
+
 static be_module_list_entry_t *schedulers;
 static schedule_func           scheduler;
 
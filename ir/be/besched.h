@@ -14,6 +14,7 @@
 #include <stdbool.h>
 
 #include "beinfo.h"
+#include "beirg.h"
 
 static sched_info_t *get_irn_sched_info(const ir_node *node)
 {
@@ -198,6 +199,66 @@ static inline bool sched_comes_after(const ir_node *n1, const ir_node *n2)
 #define sched_foreach_reverse_safe(block, irn) \
 	for (ir_node *irn, *irn##__prev = sched_last(block); !sched_is_begin(irn = irn##__prev) ? irn##__prev = sched_prev(irn), 1 : 0;)
 
+/**
+ * The schedule of a block stored as array. Frozen schedules allow cache
+ * friendly iteration and constant time position lookups.
+ */
+typedef struct sched_array_t {
+	unsigned  n_nodes;
+	ir_node  *nodes[];
+} sched_array_t;
+
+/**
+ * Freezes the schedule of all blocks of @p irg: Every block schedule is
+ * copied into an array and the time steps of the nodes are replaced by their
+ * positions. The schedule must not be changed until sched_thaw() is called.
+ * This is intended for the passes after the last schedule modification, like
+ * the emitters.
+ */
+void sched_freeze(ir_graph *irg);
+
+/**
+ * Releases the frozen schedule of @p irg, the schedule may be changed again.
+ */
+void sched_thaw(ir_graph *irg);
+
+/**
+ * Checks whether the schedule of @p irg is frozen.
+ */
+static inline bool sched_is_frozen(const ir_graph *irg)
+{
+	return be_birg_from_irg(irg)->sched_frozen;
+}
+
+/**
+ * Returns the frozen schedule of @p block.
+ */
+static inline const sched_array_t *sched_get_array(const ir_node *block)
+{
+	const be_irg_t *birg = be_birg_from_irg(get_irn_irg(block));
+	assert(birg->sched_frozen);
+	return ir_nodemap_get(const sched_array_t, &birg->sched_arrays, block);
+}
+
+/**
+ * Returns the position of @p irn in the frozen schedule of its block.
+ */
+static inline unsigned sched_get_position(const ir_node *irn)
+{
+	assert(sched_is_frozen(get_irn_irg(irn)));
+	return sched_get_time_step(irn) - 1;
+}
+
+/**
+ * Iterates over a frozen block schedule.
+ * @param block The block.
+ * @param irn A ir node pointer used as an iterator.
+ */
+#define sched_foreach_frozen(block, irn) \
+	for (sched_array_t const *irn##__arr = sched_get_array(block); irn##__arr != NULL; irn##__arr = NULL) \
+		for (unsigned irn##__i = 0; irn##__i < irn##__arr->n_nodes; ++irn##__i) \
+			for (ir_node *irn = irn##__arr->nodes[irn##__i]; irn != NULL; irn = NULL)
+
 /**
  * Type for a function scheduling a graph
  */
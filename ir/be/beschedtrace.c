@@ -9,15 +9,23 @@
  * @author      Michael Beck
  * @date        28.08.2006
  */
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "iredges_t.h"
+#include "irdom.h"
+#include "irgwalk.h"
+#include "execfreq_t.h"
 #include "beirg.h"
 #include "besched.h"
 #include "belistsched.h"
 #include "benode.h"
 #include "belive.h"
 #include "bemodule.h"
+#include "bearch.h"
+#include "bemachine.h"
+#include "util.h"
 
 /* we need a special mark */
 static char _mark;
@@ -30,6 +38,8 @@ typedef struct trace_irn {
 	int      reg_diff;           /**< The difference of num(out registers) - num(in registers) */
 	int      preorder;           /**< The pre-order position */
 	unsigned critical_path_len;  /**< The weighted length of the longest critical path */
+	sched_timestep_t modulo_time; /**< The start time in the modulo schedule of a loop */
+	unsigned modulo_pos;         /**< The position in the modulo scheduled loop body */
 	unsigned is_root       : 1;  /**< is a root node of a block */
 } trace_irn_t;
 
@@ -37,6 +47,12 @@ typedef struct trace_env {
 	trace_irn_t      *sched_info;               /**< trace scheduling information about the nodes */
 	sched_timestep_t curr_time;                 /**< current time of the scheduler */
 	be_lv_t          *liveness;                 /**< The liveness for the irg */
+	const be_machine_t *machine;                /**< The machine model, NULL for unit latencies */
+	sched_timestep_t *port_free;                /**< The time each port of the machine is free again */
+	unsigned         n_issued;                  /**< Number of instructions started at curr_time */
+	ir_node          *preorder;                 /**< The pre-order list of the current block */
+	bool             use_modulo;                /**< Modulo schedule single block loops */
+	bool             in_modulo;                 /**< The current block has a modulo schedule */
 	DEBUG_ONLY(firm_dbg_module_t *dbg;)
 } trace_env_t;
 
@@ -202,14 +218,34 @@ static inline void set_irn_critical_path_len(trace_env_t *env, ir_node *n, unsig
 	env->sched_info[idx].critical_path_len = len;
 }
 
+/**
+ * Get the timing of node n from the machine model. Nodes which do not end up
+ * as instructions take no time and need no port.
+ */
+static void get_timing(trace_env_t *env, ir_node *n, be_insn_timing_t *timing)
+{
+	if (is_Proj(n) || is_Phi(n) || be_is_Keep(n) || be_is_CopyKeep(n)
+	    || be_is_Start(n) || (arch_get_irn_flags(n) & arch_irn_flags_not_scheduled)) {
+		timing->latency   = 0;
+		timing->occupancy = 0;
+		timing->ports     = 0;
+		return;
+	}
+	env->machine->get_timing(n, timing);
+}
+
 /**
  * returns the exec-time for node n.
  */
 static sched_timestep_t exectime(trace_env_t *env, ir_node *n)
 {
-	(void) env;
 	if (be_is_Keep(n) || is_Proj(n))
 		return 0;
+	if (env->machine != NULL) {
+		be_insn_timing_t timing;
+		get_timing(env, n, &timing);
+		return timing.latency;
+	}
 	return 1;
 }
 
@@ -220,6 +256,11 @@ static sched_timestep_t latency(trace_env_t *env, ir_node *pred, int pred_cycle,
 {
 	(void) pred_cycle;
 	(void) curr_cycle;
+	/* with a machine model the result of pred is available after its
+	 * latency, whatever the user is */
+	if (env->machine != NULL)
+		return exectime(env, pred);
+
 	/* a Keep hides a root */
 	if (be_is_Keep(curr))
 		return exectime(env, pred);
@@ -404,6 +445,7 @@ static void trace_preprocess_block(trace_env_t *env, ir_node *block)
 		descent(curr, block, &preord, env, 0);
 	}
 	root = preord;
+	env->preorder = root;
 
 	/* Third step: calculate the Delay. Note that our
 	* list is now in pre-order, starting at root
@@ -503,6 +545,7 @@ static void trace_free(void *data)
 {
 	trace_env_t *env = (trace_env_t*)data;
 	DEL_ARR_F(env->sched_info);
+	free(env->port_free);
 	free(env);
 }
 
@@ -697,9 +740,753 @@ static void sched_heuristic(ir_graph *irg)
 	be_list_sched_graph(irg, &heuristic_selector);
 }
 
+/**
+ * Timing used if the backend provides no machine model: every instruction
+ * takes a cycle and one instruction is started per cycle.
+ */
+static void unit_get_timing(ir_node const *node, be_insn_timing_t *timing)
+{
+	(void)node;
+	timing->latency   = 1;
+	timing->occupancy = 1;
+	timing->ports     = 0;
+}
+
+static const be_machine_t unit_machine = {
+	1,               /* issue_width */
+	0,               /* n_ports */
+	unit_get_timing, /* get_timing */
+};
+
+/**
+ * Returns the earliest time irn can be started at and the port it will use
+ * then, ~0u if it needs none.
+ */
+static sched_timestep_t machine_start_time(trace_env_t *env, ir_node *irn,
+                                           be_insn_timing_t const *timing,
+                                           unsigned *port)
+{
+	be_machine_t const *machine = env->machine;
+	sched_timestep_t    start   = env->curr_time;
+	if (env->n_issued >= machine->issue_width)
+		++start;
+
+	sched_timestep_t const etime = get_irn_etime(env, irn);
+	if (etime > start)
+		start = etime;
+
+	*port = ~0u;
+	if (timing->ports != 0) {
+		sched_timestep_t best = 0;
+		for (unsigned p = 0; p < machine->n_ports; ++p) {
+			if (!(timing->ports & (1u << p)))
+				continue;
+			sched_timestep_t const t = MAX(start, env->port_free[p]);
+			if (*port == ~0u || t < best) {
+				best  = t;
+				*port = p;
+			}
+		}
+		if (*port != ~0u)
+			start = best;
+	}
+	return start;
+}
+
+/**
+ * The operands of irn are all scheduled: it can start once the last of their
+ * results from this block is available.
+ */
+static void machine_node_ready(void *data, ir_node *irn, ir_node *pred)
+{
+	trace_env_t *env   = (trace_env_t*)data;
+	ir_node     *block = get_nodes_block(irn);
+	(void)pred;
+
+	sched_timestep_t etime = 0;
+	for (int i = 0, n = get_irn_ins_or_deps(irn); i < n; ++i) {
+		ir_node *op = get_irn_in_or_dep(irn, i);
+		if (get_nodes_block(op) != block)
+			continue;
+		sched_timestep_t const t = get_irn_etime(env, op);
+		if (t > etime)
+			etime = t;
+	}
+	set_irn_etime(env, irn, etime);
+	DB((env->dbg, LEVEL_2, "\tset etime of %+F to %u\n", irn, etime));
+}
+
+/**
+ * Issue irn: occupy its port and record when its results are available.
+ */
+static void machine_node_selected(void *data, ir_node *irn)
+{
+	trace_env_t *env = (trace_env_t*)data;
+
+	if (is_Proj(irn)) {
+		ir_node *pred = get_Proj_pred(irn);
+		set_irn_etime(env, irn, get_irn_etime(env, pred));
+		return;
+	}
+
+	be_insn_timing_t timing;
+	get_timing(env, irn, &timing);
+	if (timing.latency == 0 && timing.ports == 0) {
+		set_irn_etime(env, irn, env->curr_time);
+		return;
+	}
+
+	unsigned               port;
+	sched_timestep_t const start = machine_start_time(env, irn, &timing, &port);
+	if (start > env->curr_time) {
+		env->curr_time = start;
+		env->n_issued  = 0;
+	}
+	++env->n_issued;
+	if (port != ~0u)
+		env->port_free[port] = start + timing.occupancy;
+	set_irn_etime(env, irn, start + timing.latency);
+	DB((env->dbg, LEVEL_2, "\t%+F starts at %u, port %d\n", irn, start, (int)port));
+}
+
+/**
+ * The machine selector: list scheduling driven by the latencies and ports of
+ * the machine model. The node which can start first wins, ties are broken by
+ * the longest path to the end of the block.
+ */
+static ir_node *machine_select(void *block_env, ir_nodeset_t *ready_set)
+{
+	trace_env_t      *env        = (trace_env_t*)block_env;
+	ir_node          *cand       = NULL;
+	sched_timestep_t  cand_start = 0;
+	sched_timestep_t  cand_delay = 0;
+	int               cand_pre   = 0;
+
+	foreach_ir_nodeset(ready_set, irn, iter) {
+		/* make sure that branches are scheduled last */
+		if (is_cfop(irn))
+			continue;
+
+		be_insn_timing_t timing;
+		unsigned         port;
+		get_timing(env, irn, &timing);
+		/* in a loop the modulo schedule decides */
+		sched_timestep_t const start = env->in_modulo
+			? env->sched_info[get_irn_idx(irn)].modulo_time
+			: machine_start_time(env, irn, &timing, &port);
+		sched_timestep_t const delay = get_irn_delay(env, irn);
+		int              const pre   = get_irn_preorder(env, irn);
+		if (cand == NULL || start < cand_start
+		    || (start == cand_start && (delay > cand_delay
+		        || (delay == cand_delay && pre > cand_pre)))) {
+			cand       = irn;
+			cand_start = start;
+			cand_delay = delay;
+			cand_pre   = pre;
+		}
+	}
+
+	if (cand == NULL)
+		cand = basic_selection(ready_set);
+	return cand;
+}
+
+static void *machine_init_graph(ir_graph *irg)
+{
+	trace_env_t        *env     = trace_init(irg);
+	const be_machine_t *machine = be_get_irg_arch_env(irg)->machine;
+
+	env->machine   = machine != NULL ? machine : &unit_machine;
+	env->port_free = XMALLOCNZ(sched_timestep_t, env->machine->n_ports);
+	return env;
+}
+
+static void modulo_schedule_block(trace_env_t *env, ir_node *block);
+
+static void *machine_init_block(void *graph_env, ir_node *bl)
+{
+	trace_env_t *env = (trace_env_t*)graph_env;
+	trace_preprocess_block(env, bl);
+	env->curr_time = 0;
+	env->n_issued  = 0;
+	env->in_modulo = false;
+	if (env->use_modulo)
+		modulo_schedule_block(env, bl);
+	memset(env->port_free, 0, env->machine->n_ports * sizeof(*env->port_free));
+	return graph_env;
+}
+
+static void sched_machine(ir_graph *irg)
+{
+	static const list_sched_selector_t machine_selector = {
+		machine_init_graph,
+		machine_init_block,
+		machine_select,
+		machine_node_ready,    /* node_ready */
+		machine_node_selected, /* node_selected */
+		NULL,                  /* finish_block */
+		trace_free             /* finish_graph */
+	};
+	be_list_sched_graph(irg, &machine_selector);
+}
+
+/** Minimum latency of instructions hoisted into a dominating block. */
+#define HOIST_MIN_LATENCY 3
+
+typedef struct superblock_env_t {
+	ir_node            **blocks;  /**< all blocks of the graph */
+	ir_node            **nodes;   /**< all other nodes in topological order */
+	unsigned            *trace;   /**< trace number of a block, by index */
+	ir_node            **target;  /**< hoisting target of a block, by index */
+	const be_machine_t  *machine; /**< the machine model */
+	DEBUG_ONLY(firm_dbg_module_t *dbg;)
+} superblock_env_t;
+
+static void collect_nodes(ir_node *node, void *data)
+{
+	superblock_env_t *env = (superblock_env_t*)data;
+	if (is_Block(node))
+		ARR_APP1(ir_node*, env->blocks, node);
+	else
+		ARR_APP1(ir_node*, env->nodes, node);
+}
+
+/**
+ * Sort blocks by decreasing execution frequency.
+ */
+static int cmp_block_execfreq(const void *a, const void *b)
+{
+	ir_node *const b0 = *(ir_node *const*)a;
+	ir_node *const b1 = *(ir_node *const*)b;
+	double   const f0 = get_block_execfreq(b0);
+	double   const f1 = get_block_execfreq(b1);
+	if (f0 != f1)
+		return f0 < f1 ? 1 : -1;
+	return QSORT_CMP(get_irn_idx(b0), get_irn_idx(b1));
+}
+
+/**
+ * Partition the blocks into traces: starting with the hottest block not yet
+ * in a trace, follow the hottest successor which is not in a trace either.
+ */
+static void form_traces(superblock_env_t *env)
+{
+	size_t const n_blocks = ARR_LEN(env->blocks);
+	qsort(env->blocks, n_blocks, sizeof(*env->blocks), cmp_block_execfreq);
+
+	unsigned n_traces = 0;
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ir_node *block = env->blocks[i];
+		if (env->trace[get_irn_idx(block)] != 0)
+			continue;
+
+		++n_traces;
+		while (block != NULL) {
+			env->trace[get_irn_idx(block)] = n_traces;
+			DB((env->dbg, LEVEL_2, "trace %u: %+F (freq %f)\n", n_traces,
+			    block, get_block_execfreq(block)));
+
+			ir_node *next      = NULL;
+			double   next_freq = 0.0;
+			foreach_block_succ(block, edge) {
+				ir_node *const succ = get_edge_src_irn(edge);
+				double   const freq = get_block_execfreq(succ);
+				if (env->trace[get_irn_idx(succ)] != 0)
+					continue;
+				if (next == NULL || freq > next_freq) {
+					next      = succ;
+					next_freq = freq;
+				}
+			}
+			block = next;
+		}
+	}
+}
+
+/**
+ * Determine the block instructions of block may be hoisted into: its
+ * immediate dominator if both are in the same trace and control equivalent,
+ * i.e. block post-dominates it and is executed as often. The frequency check
+ * rules out dominators which are executed more often in a loop and paths
+ * which leave the function without reaching block.
+ */
+static ir_node *get_hoist_target(superblock_env_t *env, ir_node *block)
+{
+	ir_node *const idom = get_Block_idom(block);
+	if (idom == NULL)
+		return NULL;
+	if (env->trace[get_irn_idx(idom)] != env->trace[get_irn_idx(block)])
+		return NULL;
+	if (!block_postdominates(block, idom))
+		return NULL;
+
+	double const freq      = get_block_execfreq(block);
+	double const idom_freq = get_block_execfreq(idom);
+	if (fabs(freq - idom_freq) > 1e-3 * MAX(freq, idom_freq))
+		return NULL;
+	return idom;
+}
+
+/** Maximum depth of operands hoisted together with an instruction. */
+#define HOIST_MAX_DEPTH 4
+
+/**
+ * Returns true if node may be moved out of its block at all. Memory
+ * operations are fine, aliasing accesses are ordered by their memory edges
+ * just as inside a block.
+ */
+static bool is_movable(ir_node *node)
+{
+	if (is_Proj(node) || is_Phi(node) || is_cfop(node) || be_is_Keep(node)
+	    || be_is_CopyKeep(node) || be_is_Start(node)
+	    || (arch_get_irn_flags(node) & arch_irn_flags_not_scheduled))
+		return false;
+
+	/* values in ignore registers like the stack pointer stay where they are */
+	be_foreach_out(node, o) {
+		arch_register_req_t const *const req = arch_get_irn_register_req_out(node, o);
+		if (arch_register_req_is(req, ignore))
+			return false;
+	}
+	if (get_irn_mode(node) == mode_T) {
+		foreach_out_edge(node, edge) {
+			ir_node *const proj = get_edge_src_irn(edge);
+			if (is_Proj(proj) && get_irn_mode(proj) == mode_X)
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Returns true if all operands of node are available in target or can be
+ * moved there from block together with node.
+ */
+static bool can_hoist_operands(ir_node *node, ir_node *block, ir_node *target,
+                               unsigned depth)
+{
+	for (int i = 0, n = get_irn_ins_or_deps(node); i < n; ++i) {
+		ir_node *op = get_irn_in_or_dep(node, i);
+		if (block_dominates(get_nodes_block(op), target))
+			continue;
+		if (is_Proj(op))
+			op = get_Proj_pred(op);
+		if (get_nodes_block(op) != block || depth == 0 || !is_movable(op)
+		    || !can_hoist_operands(op, block, target, depth - 1))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Move node together with its Projs into block.
+ */
+static void move_node(ir_node *node, ir_node *block)
+{
+	set_nodes_block(node, block);
+	if (get_irn_mode(node) != mode_T)
+		return;
+	foreach_out_edge(node, edge) {
+		ir_node *const proj = get_edge_src_irn(edge);
+		if (is_Proj(proj))
+			move_node(proj, block);
+	}
+}
+
+/**
+ * Move node and the operands it needs from its block into target.
+ */
+static void hoist_node(superblock_env_t *env, ir_node *node, ir_node *target)
+{
+	ir_node *const block = get_nodes_block(node);
+	for (int i = 0, n = get_irn_ins_or_deps(node); i < n; ++i) {
+		ir_node *op = get_irn_in_or_dep(node, i);
+		if (is_Proj(op))
+			op = get_Proj_pred(op);
+		if (get_nodes_block(op) == block)
+			hoist_node(env, op, target);
+	}
+	DB((env->dbg, LEVEL_1, "hoist %+F from %+F into %+F\n", node, block,
+	    target));
+	move_node(node, target);
+}
+
+/**
+ * Hoist long latency instructions along the traces of the graph into control
+ * equivalent dominators, i.e. above the branches in between, so the list
+ * scheduler can overlap them with the work there.
+ */
+static void superblock_hoist(ir_graph *irg)
+{
+	superblock_env_t env;
+	env.machine = be_get_irg_arch_env(irg)->machine;
+	FIRM_DBG_REGISTER(env.dbg, "firm.be.sched.superblock");
+	/* without a machine model there are no long latency instructions */
+	if (env.machine == NULL)
+		return;
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
+		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		| IR_GRAPH_PROPERTY_CONSISTENT_POSTDOMINANCE);
+
+	unsigned const n_idx = get_irg_last_idx(irg);
+	env.blocks = NEW_ARR_F(ir_node*, 0);
+	env.nodes  = NEW_ARR_F(ir_node*, 0);
+	env.trace  = NEW_ARR_FZ(unsigned, n_idx);
+	env.target = NEW_ARR_FZ(ir_node*, n_idx);
+	irg_walk_graph(irg, NULL, collect_nodes, &env);
+
+	form_traces(&env);
+	for (size_t i = 0, n = ARR_LEN(env.blocks); i < n; ++i) {
+		ir_node *const block = env.blocks[i];
+		env.target[get_irn_idx(block)] = get_hoist_target(&env, block);
+	}
+
+	/* operands come first, so chains of instructions move together */
+	unsigned n_moved = 0;
+	for (size_t i = 0, n = ARR_LEN(env.nodes); i < n; ++i) {
+		ir_node *const node   = env.nodes[i];
+		ir_node *const block  = get_nodes_block(node);
+		ir_node *const target = env.target[get_irn_idx(block)];
+		if (target == NULL || !is_movable(node))
+			continue;
+
+		be_insn_timing_t timing;
+		env.machine->get_timing(node, &timing);
+		if (timing.latency < HOIST_MIN_LATENCY
+		    || !can_hoist_operands(node, block, target, HOIST_MAX_DEPTH))
+			continue;
+		hoist_node(&env, node, target);
+		++n_moved;
+	}
+
+	if (n_moved > 0)
+		be_invalidate_live_chk(irg);
+
+	DEL_ARR_F(env.target);
+	DEL_ARR_F(env.trace);
+	DEL_ARR_F(env.nodes);
+	DEL_ARR_F(env.blocks);
+}
+
+static void sched_superblock(ir_graph *irg)
+{
+	superblock_hoist(irg);
+	sched_machine(irg);
+}
+
+/** Maximum number of instructions of a modulo scheduled loop. */
+#define MODULO_MAX_NODES 256
+
+/** A dependency between two instructions of a loop body. */
+typedef struct modulo_dep_t {
+	unsigned src;      /**< position of the producer */
+	unsigned dst;      /**< position of the consumer */
+	unsigned latency;  /**< latency of the producer */
+	unsigned distance; /**< number of iterations between them */
+} modulo_dep_t;
+
+typedef struct modulo_env_t {
+	trace_env_t      *env;
+	ir_node         **ops;    /**< the instructions in topological order */
+	be_insn_timing_t *timing; /**< the timing of the instructions */
+	modulo_dep_t     *deps;   /**< the dependencies between the instructions */
+	sched_timestep_t *time;   /**< the start times of the instructions */
+} modulo_env_t;
+
+/**
+ * Returns true if control flow predecessor pos of block is a backedge from
+ * block to itself. Splitting critical edges leaves a block with just a Jmp on
+ * such edges.
+ */
+static bool is_self_backedge(ir_node *block, int pos)
+{
+	ir_node *const pred = get_Block_cfgpred_block(block, pos);
+	if (pred == block)
+		return true;
+	if (get_Block_n_cfgpreds(pred) != 1
+	    || get_Block_cfgpred_block(pred, 0) != block)
+		return false;
+	foreach_out_edge(pred, edge) {
+		ir_node *const node = get_edge_src_irn(edge);
+		if (!is_Anchor(node) && !is_cfop(node))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Returns true if block is a loop consisting of this block only.
+ */
+static bool is_single_block_loop(ir_node *block)
+{
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		if (is_self_backedge(block, i))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Returns the instruction of the loop body producing value, or NULL if it is
+ * not computed in block.
+ */
+static ir_node *get_body_op(ir_node *value, ir_node *block)
+{
+	if (is_Proj(value))
+		value = get_Proj_pred(value);
+	if (get_nodes_block(value) != block || is_Phi(value) || is_Proj(value))
+		return NULL;
+	return value;
+}
+
+static void add_modulo_dep(modulo_env_t *menv, ir_node *src, ir_node *dst,
+                           unsigned distance)
+{
+	trace_env_t *const env     = menv->env;
+	unsigned     const src_pos = env->sched_info[get_irn_idx(src)].modulo_pos;
+	modulo_dep_t const dep     = {
+		src_pos,
+		env->sched_info[get_irn_idx(dst)].modulo_pos,
+		menv->timing[src_pos].latency,
+		distance,
+	};
+	ARR_APP1(modulo_dep_t, menv->deps, dep);
+}
+
+/**
+ * Collect the instructions of the loop body and their dependencies. Values
+ * flowing through a Phi of the loop header into the next iteration give
+ * dependencies with distance 1.
+ */
+static void collect_loop_body(modulo_env_t *menv, ir_node *block)
+{
+	trace_env_t *const env = menv->env;
+	/* users come before their operands in the pre-order list */
+	for (ir_node *node = env->preorder; node != NULL;
+	     node = (ir_node*)get_irn_link(node)) {
+		if (is_Proj(node) || is_Phi(node) || is_cfop(node)
+		    || (arch_get_irn_flags(node) & arch_irn_flags_not_scheduled))
+			continue;
+		ARR_APP1(ir_node*, menv->ops, node);
+	}
+
+	size_t const n_ops = ARR_LEN(menv->ops);
+	for (size_t i = 0, j = n_ops; i + 1 < j; ++i) {
+		--j;
+		ir_node *const tmp = menv->ops[i];
+		menv->ops[i] = menv->ops[j];
+		menv->ops[j] = tmp;
+	}
+	menv->timing = NEW_ARR_F(be_insn_timing_t, n_ops);
+	for (size_t i = 0; i < n_ops; ++i) {
+		ir_node *const node = menv->ops[i];
+		env->sched_info[get_irn_idx(node)].modulo_pos = i;
+		get_timing(env, node, &menv->timing[i]);
+	}
+
+	for (size_t i = 0; i < n_ops; ++i) {
+		ir_node *const node = menv->ops[i];
+		for (int p = 0, n = get_irn_ins_or_deps(node); p < n; ++p) {
+			ir_node *const in = get_irn_in_or_dep(node, p);
+			ir_node *const op = get_body_op(in, block);
+			if (op != NULL) {
+				add_modulo_dep(menv, op, node, 0);
+			} else if (is_Phi(in) && get_nodes_block(in) == block) {
+				for (int b = 0, n_preds = get_Phi_n_preds(in); b < n_preds; ++b) {
+					if (!is_self_backedge(block, b))
+						continue;
+					ir_node *const back = get_body_op(get_Phi_pred(in, b), block);
+					if (back != NULL)
+						add_modulo_dep(menv, back, node, 1);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Lower bound of the initiation interval given by the issue width and the
+ * execution ports.
+ */
+static unsigned get_res_mii(modulo_env_t *menv)
+{
+	be_machine_t const *const machine = menv->env->machine;
+	unsigned n_insns   = 0;
+	unsigned total_occ = 0;
+	unsigned port_occ[BE_MACHINE_MAX_PORTS];
+	memset(port_occ, 0, sizeof(port_occ));
+
+	for (size_t i = 0, n = ARR_LEN(menv->ops); i < n; ++i) {
+		be_insn_timing_t const *const timing = &menv->timing[i];
+		if (timing->latency == 0 && timing->ports == 0)
+			continue;
+		++n_insns;
+		if (timing->ports == 0)
+			continue;
+		total_occ += timing->occupancy;
+		/* instructions bound to a single port */
+		if ((timing->ports & (timing->ports - 1)) == 0) {
+			for (unsigned p = 0; p < machine->n_ports; ++p) {
+				if (timing->ports & (1u << p))
+					port_occ[p] += timing->occupancy;
+			}
+		}
+	}
+
+	unsigned mii = (n_insns + machine->issue_width - 1) / machine->issue_width;
+	if (machine->n_ports > 0)
+		mii = MAX(mii, (total_occ + machine->n_ports - 1) / machine->n_ports);
+	for (unsigned p = 0; p < machine->n_ports; ++p)
+		mii = MAX(mii, port_occ[p]);
+	return MAX(mii, 1u);
+}
+
+/**
+ * Try to find a modulo schedule with initiation interval ii. Instructions are
+ * placed in topological order at the first time their operands are ready and
+ * the modulo reservation table has room for them. Gives up if no slot is free
+ * within ii cycles or a recurrence is violated.
+ */
+static bool try_modulo_schedule(modulo_env_t *menv, unsigned ii)
+{
+	be_machine_t const *const machine = menv->env->machine;
+	size_t       const n_ops  = ARR_LEN(menv->ops);
+	size_t       const n_deps = ARR_LEN(menv->deps);
+	unsigned    *const issued = XMALLOCNZ(unsigned, ii);
+	bool        *const busy   = XMALLOCNZ(bool, ii * machine->n_ports);
+	bool               ok     = true;
+
+	for (size_t i = 0; i < n_ops && ok; ++i) {
+		be_insn_timing_t const *const timing = &menv->timing[i];
+		sched_timestep_t              est    = 0;
+		for (size_t d = 0; d < n_deps; ++d) {
+			modulo_dep_t const *const dep = &menv->deps[d];
+			if (dep->dst != i || dep->src >= i)
+				continue;
+			sched_timestep_t const ready = menv->time[dep->src] + dep->latency;
+			if (ready > est + dep->distance * ii)
+				est = ready - dep->distance * ii;
+		}
+
+		if (timing->latency == 0 && timing->ports == 0) {
+			menv->time[i] = est;
+			continue;
+		}
+
+		ok = false;
+		for (sched_timestep_t t = est; t < est + ii && !ok; ++t) {
+			if (issued[t % ii] >= machine->issue_width)
+				continue;
+			unsigned port = ~0u;
+			for (unsigned p = 0; p < machine->n_ports && port == ~0u; ++p) {
+				if (!(timing->ports & (1u << p)))
+					continue;
+				bool free = timing->occupancy <= ii;
+				for (unsigned c = 0; c < timing->occupancy && free; ++c)
+					free = !busy[((t + c) % ii) * machine->n_ports + p];
+				if (free)
+					port = p;
+			}
+			if (timing->ports != 0 && port == ~0u)
+				continue;
+
+			++issued[t % ii];
+			if (port != ~0u) {
+				for (unsigned c = 0; c < timing->occupancy; ++c)
+					busy[((t + c) % ii) * machine->n_ports + port] = true;
+			}
+			menv->time[i] = t;
+			ok            = true;
+		}
+	}
+
+	/* the recurrences through the loop header */
+	for (size_t d = 0; d < n_deps && ok; ++d) {
+		modulo_dep_t const *const dep = &menv->deps[d];
+		if (menv->time[dep->dst] + dep->distance * ii
+		    < menv->time[dep->src] + dep->latency)
+			ok = false;
+	}
+
+	free(busy);
+	free(issued);
+	return ok;
+}
+
+/**
+ * Iterative modulo scheduling of a single block loop: find the smallest
+ * initiation interval with a valid modulo schedule and record its start
+ * times. The machine selector then orders the loop body by these times, so
+ * instructions on recurrences start as early as possible and an out-of-order
+ * core can overlap successive iterations.
+ */
+static void modulo_schedule_block(trace_env_t *env, ir_node *block)
+{
+	if (!is_single_block_loop(block))
+		return;
+
+	modulo_env_t menv;
+	menv.env  = env;
+	menv.ops  = NEW_ARR_F(ir_node*, 0);
+	menv.deps = NEW_ARR_F(modulo_dep_t, 0);
+	collect_loop_body(&menv, block);
+
+	size_t const n_ops = ARR_LEN(menv.ops);
+	if (n_ops > 0 && n_ops <= MODULO_MAX_NODES) {
+		/* a flat schedule is a valid modulo schedule once the interval
+		 * exceeds its length */
+		unsigned max_ii = 1;
+		for (size_t i = 0; i < n_ops; ++i)
+			max_ii += MAX(menv.timing[i].latency, menv.timing[i].occupancy);
+
+		menv.time = NEW_ARR_F(sched_timestep_t, n_ops);
+		unsigned const mii = get_res_mii(&menv);
+		for (unsigned ii = mii; ii <= max_ii; ++ii) {
+			if (!try_modulo_schedule(&menv, ii))
+				continue;
+			DB((env->dbg, LEVEL_1, "%+F: modulo schedule with II %u (ResMII %u)\n",
+			    block, ii, mii));
+			for (size_t i = 0; i < n_ops; ++i)
+				env->sched_info[get_irn_idx(menv.ops[i])].modulo_time = menv.time[i];
+			env->in_modulo = true;
+			break;
+		}
+		DEL_ARR_F(menv.time);
+	}
+
+	DEL_ARR_F(menv.timing);
+	DEL_ARR_F(menv.deps);
+	DEL_ARR_F(menv.ops);
+}
+
+static void *modulo_init_graph(ir_graph *irg)
+{
+	trace_env_t *env = (trace_env_t*)machine_init_graph(irg);
+	env->use_modulo = true;
+	return env;
+}
+
+static void sched_modulo(ir_graph *irg)
+{
+	static const list_sched_selector_t modulo_selector = {
+		modulo_init_graph,
+		machine_init_block,
+		machine_select,
+		machine_node_ready,    /* node_ready */
+		machine_node_selected, /* node_selected */
+		NULL,                  /* finish_block */
+		trace_free             /* finish_graph */
+	};
+	be_list_sched_graph(irg, &modulo_selector);
+}
+
 BE_REGISTER_MODULE_CONSTRUCTOR(be_init_sched_trace)
 void be_init_sched_trace(void)
 {
 	be_register_scheduler("heur", sched_heuristic);
 	be_register_scheduler("muchnik", sched_muchnik);
+	be_register_scheduler("machine", sched_machine);
+	be_register_scheduler("superblock", sched_superblock);
+	be_register_scheduler("modulo", sched_modulo);
 }
@@ -21,6 +21,7 @@
 #include "irtools.h"
 #include "statev_t.h"
 #include "util.h"
+#include "bitset.h"
 
 #include "beutil.h"
 #include "bearch.h"
@@ -58,8 +59,10 @@ typedef struct loc_t {
 } loc_t;
 
 typedef struct workset_t {
-	unsigned len;     /**< current length */
-	loc_t    vals[];  /**< array of the values/distances in this working set */
+	bitset_t *members; /**< the contained values by index, only for the main
+	                        workset, NULL otherwise */
+	unsigned  len;     /**< current length */
+	loc_t     vals[];  /**< array of the values/distances in this working set */
 } workset_t;
 
 static struct obstack               obst;
@@ -88,6 +91,14 @@ static const lc_opt_table_entry_t options[] = {
 	LC_OPT_LAST
 };
 
+/**
+ * Returns the number of registers occupied by @p node.
+ */
+static unsigned get_value_width(const ir_node *node)
+{
+	return arch_get_irn_register_req(node)->width;
+}
+
 /**
  * Alloc a new workset on obstack @p ob with maximum size @p max
  */
@@ -96,6 +107,17 @@ static workset_t *new_workset(void)
 	return OALLOCFZ(&obst, workset_t, vals, n_regs);
 }
 
+/**
+ * Alloc a new workset which tracks its members in a bitset, so membership
+ * tests do not need to scan the array.
+ */
+static workset_t *new_indexed_workset(ir_graph *irg)
+{
+	workset_t *res = new_workset();
+	res->members = bitset_obstack_alloc(&obst, get_irg_last_idx(irg));
+	return res;
+}
+
 /**
  * Alloc a new instance on obstack and make it equal to @param workset
  */
@@ -103,16 +125,35 @@ static workset_t *workset_clone(workset_t *workset)
 {
 	workset_t *res = OALLOCF(&obst, workset_t, vals, n_regs);
 	memcpy(res, workset, sizeof(*res) + n_regs * sizeof(res->vals[0]));
+	res->members = NULL;
 	return res;
 }
 
+static void workset_set_members(workset_t *workset, unsigned from, bool member)
+{
+	bitset_t *members = workset->members;
+	if (members == NULL)
+		return;
+	for (unsigned i = from; i < workset->len; ++i) {
+		unsigned idx = get_irn_idx(workset->vals[i].node);
+		if (member)
+			bitset_set(members, idx);
+		else
+			bitset_clear(members, idx);
+	}
+}
+
 /**
  * Copy workset @param src to @param tgt
  */
 static void workset_copy(workset_t *dest, const workset_t *src)
 {
-	size_t size = sizeof(*src) + n_regs * sizeof(src->vals[0]);
+	bitset_t *members = dest->members;
+	size_t    size    = sizeof(*src) + n_regs * sizeof(src->vals[0]);
+	workset_set_members(dest, 0, false);
 	memcpy(dest, src, size);
+	dest->members = members;
+	workset_set_members(dest, 0, true);
 }
 
 /**
@@ -122,8 +163,21 @@ static void workset_copy(workset_t *dest, const workset_t *src)
  */
 static void workset_bulk_fill(workset_t *workset, int count, const loc_t *locs)
 {
+	workset_set_members(workset, 0, false);
 	workset->len = count;
 	memcpy(&(workset->vals[0]), locs, count * sizeof(locs[0]));
+	workset_set_members(workset, 0, true);
+}
+
+/**
+ * Returns the number of registers occupied by the values in @p workset.
+ */
+static unsigned workset_get_n_regs(const workset_t *workset)
+{
+	unsigned n = 0;
+	for (unsigned i = 0; i < workset->len; ++i)
+		n += get_value_width(workset->vals[i].node);
+	return n;
 }
 
 /**
@@ -138,6 +192,9 @@ static void workset_insert(workset_t *workset, ir_node *val, bool spilled)
 	assert(arch_irn_consider_in_reg_alloc(cls, val));
 
 	/* check if val is already contained */
+	bitset_t *const members = workset->members;
+	if (members != NULL && !bitset_is_set(members, get_irn_idx(val)))
+		goto insert;
 	for (i = 0; i < workset->len; ++i) {
 		loc = &workset->vals[i];
 		if (loc->node == val) {
@@ -148,8 +205,12 @@ static void workset_insert(workset_t *workset, ir_node *val, bool spilled)
 		}
 	}
 
+insert:
 	/* insert val */
-	assert(workset->len < n_regs && "Workset already full!");
+	assert(workset_get_n_regs(workset) + get_value_width(val) <= n_regs
+	       && "Workset already full!");
+	if (members != NULL)
+		bitset_set(members, get_irn_idx(val));
 	loc           = &workset->vals[workset->len];
 	loc->node     = val;
 	loc->spilled  = spilled;
@@ -162,6 +223,7 @@ static void workset_insert(workset_t *workset, ir_node *val, bool spilled)
  */
 static void workset_clear(workset_t *workset)
 {
+	workset_set_members(workset, 0, false);
 	workset->len = 0;
 }
 
@@ -171,6 +233,13 @@ static void workset_clear(workset_t *workset)
 static void workset_remove(workset_t *workset, ir_node *val)
 {
 	unsigned i;
+	bitset_t *const members = workset->members;
+	if (members != NULL) {
+		unsigned const idx = get_irn_idx(val);
+		if (!bitset_is_set(members, idx))
+			return;
+		bitset_clear(members, idx);
+	}
 	for (i = 0; i < workset->len; ++i) {
 		if (workset->vals[i].node == val) {
 			workset->vals[i] = workset->vals[--workset->len];
@@ -182,6 +251,8 @@ static void workset_remove(workset_t *workset, ir_node *val)
 static const loc_t *workset_contains(const workset_t *ws, const ir_node *val)
 {
 	unsigned i;
+	if (ws->members != NULL && !bitset_is_set(ws->members, get_irn_idx(val)))
+		return NULL;
 	for (i = 0; i < ws->len; ++i) {
 		if (ws->vals[i].node == val)
 			return &ws->vals[i];
@@ -228,6 +299,8 @@ static inline unsigned workset_get_length(const workset_t *workset)
 
 static inline void workset_set_length(workset_t *workset, unsigned len)
 {
+	assert(len <= workset->len);
+	workset_set_members(workset, len, false);
 	workset->len = len;
 }
 
@@ -313,10 +386,12 @@ static void displace(workset_t *const new_vals, int const is_usage, ir_node *con
 	int       len;
 	int       spills_needed;
 	int       demand;
+	int       n_insert;
 	unsigned  iter;
 
-	/* 1. Identify the number of needed slots and the values to reload */
-	demand = 0;
+	/* 1. Identify the number of needed registers and the values to reload */
+	demand   = 0;
+	n_insert = 0;
 	workset_foreach(new_vals, val, iter) {
 		bool reloaded = false;
 
@@ -334,19 +409,19 @@ static void displace(workset_t *const new_vals, int const is_usage, ir_node *con
 			 * spilled */
 			workset_remove(ws, val);
 		}
-		spilled[demand]   = reloaded;
-		to_insert[demand] = val;
-		++demand;
+		spilled[n_insert]   = reloaded;
+		to_insert[n_insert] = val;
+		++n_insert;
+		demand += get_value_width(val);
 	}
 
-	/* 2. Make room for at least 'demand' slots */
+	/* 2. Make room for at least 'demand' registers */
 	len           = workset_get_length(ws);
-	spills_needed = len + demand - n_regs;
-	assert(spills_needed <= len);
+	spills_needed = workset_get_n_regs(ws) + demand - n_regs;
 
 	/* Only make more free room if we do not have enough */
 	if (spills_needed > 0) {
-		DB((dbg, DBG_DECIDE, "    disposing %d values\n", spills_needed));
+		int keep;
 
 		/* calculate current next-use distance for live values */
 		for (i = 0; i < len; ++i) {
@@ -358,7 +433,15 @@ static void displace(workset_t *const new_vals, int const is_usage, ir_node *con
 		/* sort entries by increasing nextuse-distance*/
 		workset_sort(ws);
 
-		for (i = len - spills_needed; i < len; ++i) {
+		/* dispose the values with the farthest next use until enough
+		 * registers are free */
+		for (keep = len; spills_needed > 0; --keep) {
+			assert(keep > 0);
+			spills_needed -= get_value_width(ws->vals[keep - 1].node);
+		}
+		DB((dbg, DBG_DECIDE, "    disposing %d values\n", len - keep));
+
+		for (i = keep; i < len; ++i) {
 			ir_node *val = ws->vals[i].node;
 
 			DB((dbg, DBG_DECIDE, "    disposing node %+F (%u)\n", val,
@@ -375,12 +458,12 @@ static void displace(workset_t *const new_vals, int const is_usage, ir_node *con
 			}
 		}
 
-		/* kill the last 'demand' entries in the array */
-		workset_set_length(ws, len - spills_needed);
+		/* kill the disposed entries at the end of the array */
+		workset_set_length(ws, keep);
 	}
 
 	/* 3. Insert the new values into the workset */
-	for (i = 0; i < demand; ++i) {
+	for (i = 0; i < n_insert; ++i) {
 		ir_node *val = to_insert[i];
 
 		workset_insert(ws, val, spilled[i]);
@@ -598,7 +681,9 @@ static void decide_start_workset(ir_node *const block)
 
 	pressure            = be_get_loop_pressure(loop_ana, cls, loop);
 	assert(ARR_LEN(delayed) <= pressure);
-	free_slots          = n_regs - ARR_LEN(starters);
+	free_slots          = n_regs;
+	for (i = 0; i < ARR_LEN(starters); ++i)
+		free_slots -= get_value_width(starters[i].node);
 	free_pressure_slots = n_regs - (pressure - ARR_LEN(delayed));
 	free_slots          = MIN(free_slots, free_pressure_slots);
 
@@ -613,8 +698,12 @@ static void decide_start_workset(ir_node *const block)
 		qsort(delayed, ARR_LEN(delayed), sizeof(delayed[0]), loc_compare);
 
 		for (i = 0; i < ARR_LEN(delayed) && free_slots > 0; ++i) {
-			int    p, arity;
-			loc_t *loc = & delayed[i];
+			int      p, arity;
+			loc_t   *loc   = & delayed[i];
+			unsigned width = get_value_width(loc->node);
+
+			if ((int)width > free_slots)
+				continue;
 
 			if (!is_Phi(loc->node)) {
 				/* don't use values which are dead in a known predecessors
@@ -639,7 +728,7 @@ static void decide_start_workset(ir_node *const block)
 			DB((dbg, DBG_START, "    delayed %+F taken\n", loc->node));
 			ARR_APP1(loc_t, starters, *loc);
 			loc->node = NULL;
-			--free_slots;
+			free_slots -= width;
 		skip_delayed:
 			;
 		}
@@ -662,7 +751,12 @@ static void decide_start_workset(ir_node *const block)
 	qsort(starters, ARR_LEN(starters), sizeof(starters[0]), loc_compare);
 
 	/* Copy the best ones from starters to start workset */
-	ws_count = MIN((unsigned) ARR_LEN(starters), n_regs);
+	ws_count = 0;
+	for (unsigned n_used = 0; ws_count < ARR_LEN(starters); ++ws_count) {
+		n_used += get_value_width(starters[ws_count].node);
+		if (n_used > n_regs)
+			break;
+	}
 	workset_clear(ws);
 	workset_bulk_fill(ws, ws_count, starters);
 
@@ -779,7 +873,7 @@ static void process_block(ir_node *block)
 	new_vals = new_workset();
 
 	sched_foreach(block, irn) {
-		assert(workset_get_length(ws) <= n_regs);
+		assert(workset_get_n_regs(ws) <= n_regs);
 
 		/* Phis are no real instr (see insert_starters()) */
 		if (is_Phi(irn)) {
@@ -798,7 +892,6 @@ static void process_block(ir_node *block)
 		/* allocate all values _defined_ by this instruction */
 		workset_clear(new_vals);
 		be_foreach_definition(irn, cls, value, req,
-			assert(req->width == 1);
 			workset_insert(new_vals, value, false);
 		);
 		displace(new_vals, 0, irn);
@@ -941,8 +1034,8 @@ static void be_spill_belady(ir_graph *irg, const arch_register_class_t *rcls)
 	cls       = rcls;
 	lv        = be_get_irg_liveness(irg);
 	n_regs    = be_get_n_allocatable_regs(irg, cls);
-	ws        = new_workset();
-	uses      = be_begin_uses(irg, lv);
+	ws        = new_indexed_workset(irg);
+	uses      = be_begin_uses(irg, lv, cls);
 	loop_ana  = be_new_loop_pressure(irg, cls);
 	senv      = be_new_spill_env(irg);
 	blocklist = be_get_cfgpostorder(irg);
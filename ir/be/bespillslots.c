@@ -26,7 +26,8 @@
 #include "bechordal_t.h"
 #include "statev_t.h"
 #include "bemodule.h"
-#include "beintlive_t.h"
+#include "raw_bitset.h"
+#include "iredges_t.h"
 #include "beirg.h"
 #include "bearch.h"
 #include "bespillutil.h"
@@ -170,166 +171,319 @@ void be_node_needs_frame_entity(be_fec_env_t *env, ir_node *node,
 	ARR_APP1(ir_node *, env->reloads, node);
 }
 
-static int merge_interferences(be_fec_env_t *env, bitset_t** interferences,
-                               int* spillslot_unionfind, int s1, int s2)
+/**
+ * A part (from, to] of the lifetime of a spillslot in the linearization of
+ * the schedule.
+ */
+typedef struct lifetime_interval_t {
+	unsigned from;
+	unsigned to;
+} lifetime_interval_t;
+
+typedef struct lifetime_env_t {
+	unsigned  *positions;   /**< linear position of nodes, start of blocks */
+	unsigned  *block_ends;  /**< linear position of the end of blocks */
+	unsigned  *visited;     /**< last value whose lifetime reached a block */
+	unsigned   value_nr;
+	ir_node   *def_block;
+	unsigned   def_pos;
+	ir_node  **worklist;
+	lifetime_interval_t *intervals;
+} lifetime_env_t;
+
+/**
+ * Linearizes the schedule: the nodes of each block are numbered between the
+ * start and end positions of the block.
+ */
+static void number_block(ir_node *block, void *data)
 {
-	int res;
-	size_t spillcount;
-	size_t i;
+	lifetime_env_t *lenv     = (lifetime_env_t*)data;
+	unsigned        position = lenv->value_nr;
 
-	/* merge spillslots and interferences */
-	res = uf_union(spillslot_unionfind, s1, s2);
-	/* we assume that we always merge s2 to s1 so swap s1, s2 if necessary */
-	if (res != s1) {
-		int t = s1;
-		s1 = s2;
-		s2 = t;
+	lenv->positions[get_irn_idx(block)] = position++;
+	sched_foreach(block, node) {
+		lenv->positions[get_irn_idx(node)] = position++;
 	}
+	lenv->block_ends[get_irn_idx(block)] = position++;
+	lenv->value_nr = position;
+}
 
-	bitset_or(interferences[s1], interferences[s2]);
+static void add_interval(lifetime_env_t *lenv, unsigned from, unsigned to)
+{
+	lifetime_interval_t interval = { from, to };
+	ARR_APP1(lifetime_interval_t, lenv->intervals, interval);
+}
 
-	/* update other interferences */
-	spillcount = ARR_LEN(env->spills);
-	for (i = 0; i < spillcount; ++i) {
-		bitset_t *intfs = interferences[i];
-		if (bitset_is_set(intfs, s2))
-			bitset_set(intfs, s1);
+/**
+ * Marks the current value as live at the end of @p block.
+ */
+static void add_live_out(lifetime_env_t *lenv, ir_node *block)
+{
+	unsigned idx = get_irn_idx(block);
+	if (lenv->visited[idx] == lenv->value_nr)
+		return;
+	lenv->visited[idx] = lenv->value_nr;
+	ARR_APP1(ir_node*, lenv->worklist, block);
+}
+
+/**
+ * Marks the current value as live in @p block up to position @p use_pos and
+ * propagates the lifetime up to the definition.
+ */
+static void add_use(lifetime_env_t *lenv, ir_node *block, unsigned use_pos)
+{
+	unsigned start = lenv->positions[get_irn_idx(block)];
+	if (block == lenv->def_block && lenv->def_pos < use_pos) {
+		add_interval(lenv, lenv->def_pos, use_pos);
+		return;
+	}
+	add_interval(lenv, start, use_pos);
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i)
+		add_live_out(lenv, get_Block_cfgpred_block(block, i));
+
+	for (size_t n_work; (n_work = ARR_LEN(lenv->worklist)) > 0; ) {
+		ir_node *pred = lenv->worklist[n_work - 1];
+		unsigned end  = lenv->block_ends[get_irn_idx(pred)];
+		ARR_SHRINKLEN(lenv->worklist, n_work - 1);
+		if (pred == lenv->def_block) {
+			add_interval(lenv, lenv->def_pos, end);
+			continue;
+		}
+		add_interval(lenv, lenv->positions[get_irn_idx(pred)], end);
+		for (int i = 0, n = get_Block_n_cfgpreds(pred); i < n; ++i)
+			add_live_out(lenv, get_Block_cfgpred_block(pred, i));
 	}
+}
 
-	return res;
+static void add_user(lifetime_env_t *lenv, ir_node *user, int pos)
+{
+	if (is_Phi(user)) {
+		/* Phi arguments are used at the end of the predecessor block */
+		ir_node *block = get_Block_cfgpred_block(get_nodes_block(user), pos);
+		add_use(lenv, block, lenv->block_ends[get_irn_idx(block)]);
+	} else if (sched_is_scheduled(user)) {
+		add_use(lenv, get_nodes_block(user),
+		        lenv->positions[get_irn_idx(user)]);
+	}
 }
 
-static bool my_values_interfere2(ir_graph *const irg, ir_node const *a, ir_node const *b)
+/**
+ * Collects the lifetime intervals of the memory value @p value by walking
+ * from its uses up to its definition.
+ */
+static void collect_lifetime(lifetime_env_t *lenv, ir_node *value)
 {
-	if (value_dominates(b, a)) {
-		/* Adjust a and b so, that a dominates b if
-		 * a dominates b or vice versa. */
-		ir_node const *const t = a;
-		a = b;
-		b = t;
-	} else if (!value_dominates(a, b)) {
-		/* If there is no dominance relation, they do not interfere. */
-		return 0;
+	if (is_NoMem(value))
+		return;
+	if (is_Sync(value)) {
+		for (int i = 0, n = get_irn_arity(value); i < n; ++i)
+			collect_lifetime(lenv, get_irn_n(value, i));
+		return;
 	}
 
-	ir_node *const bb = get_nodes_block(b);
-
-	/* If a is live end in b's block it is
-	 * live at b's definition (a dominates b) */
-	be_lv_t *const lv = be_get_irg_liveness(irg);
-	if (be_is_live_end(lv, bb, a))
-		return true;
-
-	/* Look at all usages of a.
-	 * If there's one usage of a in the block of b, then
-	 * we check, if this use is dominated by b, if that's true
-	 * a and b interfere. Note that b must strictly dominate the user,
-	 * since if b is the last user of in the block, b and a do not
-	 * interfere.
-	 * Uses of a not in b's block can be disobeyed, because the
-	 * check for a being live at the end of b's block is already
-	 * performed. */
-	foreach_out_edge(a, edge) {
-		ir_node const *const user = get_edge_src_irn(edge);
+	ir_node *def   = skip_Proj(value);
+	ir_node *block = get_nodes_block(def);
+	++lenv->value_nr;
+	lenv->def_block = block;
+	lenv->def_pos   = !is_Phi(def) && sched_is_scheduled(def)
+		? lenv->positions[get_irn_idx(def)]
+		: lenv->positions[get_irn_idx(block)];
+
+	foreach_out_edge(value, edge) {
+		ir_node *user = get_edge_src_irn(edge);
 		if (is_Sync(user)) {
+			/* Syncs are not scheduled, their users use the value */
 			foreach_out_edge(user, edge2) {
-				ir_node const *const user2 = get_edge_src_irn(edge2);
+				ir_node *user2 = get_edge_src_irn(edge2);
 				assert(!is_Sync(user2));
-				if (get_nodes_block(user2) == bb && !is_Phi(user2) &&
-				    _value_strictly_dominates_intrablock(b, user2))
-					return true;
+				add_user(lenv, user2, get_edge_src_pos(edge2));
 			}
 		} else {
-			if (get_nodes_block(user) == bb && !is_Phi(user) &&
-			    _value_strictly_dominates_intrablock(b, user))
-				return true;
+			add_user(lenv, user, get_edge_src_pos(edge));
+		}
+	}
+}
+
+static int cmp_lifetime_interval(const void *d1, const void *d2)
+{
+	const lifetime_interval_t *i1 = (const lifetime_interval_t*)d1;
+	const lifetime_interval_t *i2 = (const lifetime_interval_t*)d2;
+	return (i1->from > i2->from) - (i1->from < i2->from);
+}
+
+/**
+ * Sorts the collected intervals and merges overlapping ones.
+ * @return a new flexible array with the lifetime
+ */
+static lifetime_interval_t *finish_lifetime(lifetime_env_t *lenv)
+{
+	lifetime_interval_t *intervals = lenv->intervals;
+	size_t               n         = ARR_LEN(intervals);
+	lifetime_interval_t *res       = NEW_ARR_F(lifetime_interval_t, 0);
+
+	qsort(intervals, n, sizeof(intervals[0]), cmp_lifetime_interval);
+	for (size_t i = 0; i < n; ++i) {
+		size_t n_res = ARR_LEN(res);
+		if (n_res > 0 && res[n_res - 1].to >= intervals[i].from) {
+			if (intervals[i].to > res[n_res - 1].to)
+				res[n_res - 1].to = intervals[i].to;
+		} else {
+			ARR_APP1(lifetime_interval_t, res, intervals[i]);
 		}
 	}
+	ARR_SHRINKLEN(lenv->intervals, 0);
+	return res;
+}
+
+/**
+ * Computes the lifetimes of all spills as intervals over a linearization of
+ * the schedule, which replaces pairwise liveness queries.
+ */
+static lifetime_interval_t **compute_lifetimes(be_fec_env_t *env)
+{
+	ir_graph             *irg        = env->irg;
+	size_t                spillcount = ARR_LEN(env->spills);
+	unsigned              n_idx      = get_irg_last_idx(irg);
+	lifetime_interval_t **lifetimes  = XMALLOCN(lifetime_interval_t*,
+	                                            spillcount);
+	lifetime_env_t        lenv;
+
+	lenv.positions  = XMALLOCNZ(unsigned, n_idx);
+	lenv.block_ends = XMALLOCNZ(unsigned, n_idx);
+	lenv.visited    = XMALLOCNZ(unsigned, n_idx);
+	lenv.value_nr   = 0;
+	lenv.worklist   = NEW_ARR_F(ir_node*, 0);
+	lenv.intervals  = NEW_ARR_F(lifetime_interval_t, 0);
+
+	irg_block_walk_graph(irg, NULL, number_block, &lenv);
+	lenv.value_nr = 0;
+
+	for (size_t s = 0; s < spillcount; ++s) {
+		collect_lifetime(&lenv, env->spills[s]->spill);
+		lifetimes[s] = finish_lifetime(&lenv);
+	}
 
+	DEL_ARR_F(lenv.intervals);
+	DEL_ARR_F(lenv.worklist);
+	free(lenv.visited);
+	free(lenv.block_ends);
+	free(lenv.positions);
+	return lifetimes;
+}
+
+/**
+ * Returns true if two sorted, disjoint interval lists overlap.
+ */
+static bool lifetimes_interfere(const lifetime_interval_t *l1,
+                                const lifetime_interval_t *l2)
+{
+	size_t i1 = 0;
+	size_t i2 = 0;
+	size_t n1 = ARR_LEN(l1);
+	size_t n2 = ARR_LEN(l2);
+	while (i1 < n1 && i2 < n2) {
+		if (l1[i1].to <= l2[i2].from) {
+			++i1;
+		} else if (l2[i2].to <= l1[i1].from) {
+			++i2;
+		} else {
+			return true;
+		}
+	}
 	return false;
 }
 
 /**
- * same as values_interfere but with special handling for Syncs
+ * Merges the lifetime @p l2 into @p l1, dropping intervals ending before
+ * @p min_pos.
+ * @return the merged lifetime, @p l1 and @p l2 are freed
  */
-static int my_values_interfere(ir_graph *irg, ir_node *a, ir_node *b)
+static lifetime_interval_t *merge_lifetimes(lifetime_interval_t *l1,
+                                            lifetime_interval_t *l2,
+                                            unsigned min_pos)
 {
-	if (is_Sync(a)) {
-		int i, arity = get_irn_arity(a);
-		for (i = 0; i < arity; ++i) {
-			ir_node *in = get_irn_n(a, i);
-			if (my_values_interfere(irg, in, b))
-				return 1;
+	size_t               i1  = 0;
+	size_t               i2  = 0;
+	size_t               n1  = ARR_LEN(l1);
+	size_t               n2  = ARR_LEN(l2);
+	lifetime_interval_t *res = NEW_ARR_F(lifetime_interval_t, 0);
+	while (i1 < n1 || i2 < n2) {
+		lifetime_interval_t interval;
+		if (i2 == n2 || (i1 < n1 && l1[i1].from < l2[i2].from)) {
+			interval = l1[i1++];
+		} else {
+			interval = l2[i2++];
 		}
-		return 0;
-	} else if (is_Sync(b)) {
-		int i, arity = get_irn_arity(b);
-		for (i = 0; i < arity; ++i) {
-			ir_node *in = get_irn_n(b, i);
-			/* a is not a sync, so no need for my_values_interfere */
-			if (my_values_interfere2(irg, a, in))
-				return 1;
+		if (interval.to <= min_pos)
+			continue;
+		/* the lifetimes did not interfere, so only touching intervals can be
+		 * joined */
+		size_t n_res = ARR_LEN(res);
+		if (n_res > 0 && res[n_res - 1].to == interval.from) {
+			res[n_res - 1].to = interval.to;
+		} else {
+			ARR_APP1(lifetime_interval_t, res, interval);
 		}
-		return 0;
 	}
+	DEL_ARR_F(l1);
+	DEL_ARR_F(l2);
+	return res;
+}
+
+static unsigned get_lifetime_start(const lifetime_interval_t *lifetime)
+{
+	return ARR_LEN(lifetime) > 0 ? lifetime[0].from : 0;
+}
+
+static unsigned get_lifetime_end(const lifetime_interval_t *lifetime)
+{
+	size_t n = ARR_LEN(lifetime);
+	return n > 0 ? lifetime[n - 1].to : 0;
+}
 
-	return my_values_interfere2(irg, a, b);
+typedef struct slot_order_t {
+	int      slot;
+	unsigned start;
+} slot_order_t;
+
+static int cmp_slot_order(const void *d1, const void *d2)
+{
+	const slot_order_t *o1 = (const slot_order_t*)d1;
+	const slot_order_t *o2 = (const slot_order_t*)d2;
+	if (o1->start != o2->start)
+		return o1->start < o2->start ? -1 : 1;
+	return (o1->slot > o2->slot) - (o1->slot < o2->slot);
 }
 
 /**
  * A greedy coalescing algorithm for spillslots:
- *  1. Sort the list of affinity edges
- *  2. Try to merge slots with affinity edges (most expensive slots first)
- *  3. Try to merge everything else that is possible
+ *  1. Compute the lifetime of each spillslot as intervals over a
+ *     linearization of the schedule
+ *  2. Sort the list of affinity edges
+ *  3. Try to merge slots with affinity edges (most expensive slots first)
+ *  4. Merge everything else that is possible in a linear scan over the
+ *     slots ordered by their start: slots whose lifetime ended are reused
+ *     without further tests, otherwise the lifetime holes of the active
+ *     slots are checked
  */
 static void do_greedy_coalescing(be_fec_env_t *env)
 {
-	spill_t **spills     = env->spills;
-	size_t    spillcount = ARR_LEN(spills);
-	size_t    i;
-	size_t    affinity_edge_count;
-	bitset_t **interferences;
-	int* spillslot_unionfind;
-	struct obstack data;
+	spill_t             **spills     = env->spills;
+	size_t                spillcount = ARR_LEN(spills);
+	size_t                i;
+	size_t                affinity_edge_count;
+	lifetime_interval_t **lifetimes;
+	int                  *spillslot_unionfind;
 
 	if (spillcount == 0)
 		return;
 
-	obstack_init(&data);
-
 	DB((dbg, DBG_COALESCING, "Coalescing %d spillslots\n", spillcount));
 
-	interferences       = OALLOCN(&data, bitset_t*, spillcount);
-	spillslot_unionfind = OALLOCN(&data, int,       spillcount);
-
+	lifetimes           = compute_lifetimes(env);
+	spillslot_unionfind = XMALLOCN(int, spillcount);
 	uf_init(spillslot_unionfind, spillcount);
 
-	for (i = 0; i < spillcount; ++i) {
-		interferences[i] = bitset_obstack_alloc(&data, spillcount);
-	}
-
-	/* construct interferences */
-	for (i = 0; i < spillcount; ++i) {
-		size_t   i2;
-		ir_node *spill1 = spills[i]->spill;
-		if (is_NoMem(spill1))
-			continue;
-
-		for (i2 = i+1; i2 < spillcount; ++i2) {
-			ir_node *spill2 = spills[i2]->spill;
-			if (is_NoMem(spill2))
-				continue;
-
-			if (my_values_interfere(env->irg, spill1, spill2)) {
-				DB((dbg, DBG_INTERFERENCES,
-				     "Slot %d and %d interfere\n", i, i2));
-
-				bitset_set(interferences[i], i2);
-				bitset_set(interferences[i2], i);
-			}
-		}
-	}
-
 	/* sort affinity edges */
 	affinity_edge_count = ARR_LEN(env->affinity_edges);
 	qsort(env->affinity_edges, affinity_edge_count,
@@ -340,57 +494,95 @@ static void do_greedy_coalescing(be_fec_env_t *env)
 		const affinity_edge_t *edge = env->affinity_edges[i];
 		int s1 = uf_find(spillslot_unionfind, edge->slot1);
 		int s2 = uf_find(spillslot_unionfind, edge->slot2);
+		if (s1 == s2)
+			continue;
 
 		/* test if values interfere */
-		if (bitset_is_set(interferences[s1], s2)) {
-			assert(bitset_is_set(interferences[s2], s1));
+		if (lifetimes_interfere(lifetimes[s1], lifetimes[s2])) {
+			DB((dbg, DBG_INTERFERENCES,
+			    "Slot %d and %d interfere\n", s1, s2));
 			continue;
 		}
 
 		DB((dbg, DBG_COALESCING,
 		    "Merging %d and %d because of affinity edge\n", s1, s2));
 
-		merge_interferences(env, interferences, spillslot_unionfind, s1, s2);
+		int res = uf_union(spillslot_unionfind, s1, s2);
+		lifetimes[res] = merge_lifetimes(lifetimes[s1], lifetimes[s2], 0);
+		lifetimes[res == s1 ? s2 : s1] = NULL;
 	}
 
-	/* try to merge as much remaining spillslots as possible */
+	/* linear scan over the remaining slots */
+	slot_order_t *order   = XMALLOCN(slot_order_t, spillcount);
+	size_t        n_slots = 0;
 	for (i = 0; i < spillcount; ++i) {
-		size_t i2;
-		int    s1 = uf_find(spillslot_unionfind, i);
-		if (s1 != (int)i)
+		if (uf_find(spillslot_unionfind, i) != (int)i)
 			continue;
-
-		for (i2 = i+1; i2 < spillcount; ++i2) {
-			int s2 = uf_find(spillslot_unionfind, i2);
-			if (s2 != (int)i2)
-				continue;
-
-			/* test if values interfere
-			 * we have to test n1-n2 and n2-n1, because only 1 side gets updated
-			 * when node merging occurs
-			 */
-			if (bitset_is_set(interferences[s1], s2)) {
-				assert(bitset_is_set(interferences[s2], s1));
-				continue;
+		order[n_slots].slot  = i;
+		order[n_slots].start = get_lifetime_start(lifetimes[i]);
+		++n_slots;
+	}
+	qsort(order, n_slots, sizeof(order[0]), cmp_slot_order);
+
+	int    *active   = XMALLOCN(int, n_slots);
+	size_t  n_active = 0;
+	int    *expired  = XMALLOCN(int, n_slots);
+	size_t  n_expired = 0;
+	for (i = 0; i < n_slots; ++i) {
+		int      s     = order[i].slot;
+		unsigned start = order[i].start;
+
+		/* slots whose lifetime ended can hold s without interference */
+		for (size_t a = 0; a < n_active; ) {
+			if (get_lifetime_end(lifetimes[active[a]]) <= start) {
+				expired[n_expired++] = active[a];
+				active[a] = active[--n_active];
+			} else {
+				++a;
 			}
+		}
 
-			DB((dbg, DBG_COALESCING,
-			     "Merging %d and %d because it is possible\n", s1, s2));
-
-			if (merge_interferences(env, interferences, spillslot_unionfind, s1, s2) != 0) {
-				/* we can break the loop here, because s2 is the new supernode
-				 * now and we'll test s2 again later anyway */
-				break;
+		int target = -1;
+		if (n_expired > 0) {
+			target = expired[--n_expired];
+		} else {
+			for (size_t a = 0; a < n_active; ++a) {
+				if (!lifetimes_interfere(lifetimes[active[a]], lifetimes[s])) {
+					target = active[a];
+					active[a] = active[--n_active];
+					break;
+				}
 			}
 		}
+
+		if (target < 0) {
+			active[n_active++] = s;
+			continue;
+		}
+
+		DB((dbg, DBG_COALESCING,
+		    "Merging %d and %d because it is possible\n", target, s));
+
+		int res = uf_union(spillslot_unionfind, target, s);
+		/* no slot after s starts before s, so earlier intervals are dead */
+		lifetimes[res] = merge_lifetimes(lifetimes[target], lifetimes[s],
+		                                 start);
+		lifetimes[res == s ? target : s] = NULL;
+		active[n_active++] = res;
 	}
+	free(expired);
+	free(active);
+	free(order);
 
 	/* assign spillslots to spills */
 	for (i = 0; i < spillcount; ++i) {
 		spills[i]->spillslot = uf_find(spillslot_unionfind, i);
+		if (lifetimes[i] != NULL)
+			DEL_ARR_F(lifetimes[i]);
 	}
 
-	obstack_free(&data, 0);
+	free(spillslot_unionfind);
+	free(lifetimes);
 }
 
 typedef struct spill_slot_t {
@@ -452,6 +644,38 @@ static ir_entity* create_stack_entity(be_fec_env_t *env, spill_slot_t *slot)
 	return res;
 }
 
+static int cmp_spill_slot(const void *d1, const void *d2)
+{
+	const spill_slot_t *s1 = *(const spill_slot_t**)d1;
+	const spill_slot_t *s2 = *(const spill_slot_t**)d2;
+	/* largest alignment first, then largest size */
+	if (s1->align != s2->align)
+		return s1->align < s2->align ? 1 : -1;
+	if (s1->size != s2->size)
+		return s1->size < s2->size ? 1 : -1;
+	return s1 < s2 ? -1 : s1 > s2;
+}
+
+/**
+ * Creates the stack entities of all used spillslots. Allocating them by
+ * decreasing alignment and size avoids padding between them and keeps the
+ * frame small.
+ */
+static void create_stack_entities(be_fec_env_t *env, spill_slot_t *spillslots,
+                                   size_t n_slots)
+{
+	spill_slot_t **sorted  = XMALLOCN(spill_slot_t*, n_slots);
+	size_t         n_used  = 0;
+	for (size_t s = 0; s < n_slots; ++s) {
+		if (spillslots[s].size > 0)
+			sorted[n_used++] = &spillslots[s];
+	}
+	qsort(sorted, n_used, sizeof(sorted[0]), cmp_spill_slot);
+	for (size_t s = 0; s < n_used; ++s)
+		create_stack_entity(env, sorted[s]);
+	free(sorted);
+}
+
 /**
  * Enlarges a spillslot (if necessary) so that it can carry a value of size
  * @p othersize and alignment @p otheralign.
@@ -524,15 +748,15 @@ static void assign_spillslots(be_fec_env_t *env)
 		}
 	}
 
+	create_stack_entities(env, spillslots, spillcount);
+
 	for (s = 0; s < spillcount; ++s) {
 		const spill_t *spill  = spills[s];
 		ir_node       *node   = spill->spill;
 		int            slotid = spill->spillslot;
 		spill_slot_t  *slot   = &spillslots[slotid];
 
-		if (slot->entity == NULL) {
-			create_stack_entity(env, slot);
-		}
+		assert(slot->entity != NULL);
 
 		if (is_Phi(node)) {
 			int arity = get_irn_arity(node);
@@ -552,9 +776,6 @@ static void assign_spillslots(be_fec_env_t *env)
 					memperm_t       *memperm;
 					memperm_entry_t *entry;
 					spill_slot_t    *argslot = &spillslots[argslotid];
-					if (argslot->entity == NULL) {
-						create_stack_entity(env, argslot);
-					}
 
 					memperm = get_memperm(env, predblock);
 
@@ -645,8 +866,6 @@ be_fec_env_t *be_new_frame_entity_coalescer(ir_graph *irg)
 {
 	be_fec_env_t *env = XMALLOCZ(be_fec_env_t);
 
-	be_assure_live_chk(irg);
-
 	obstack_init(&env->obst);
 	env->irg            = irg;
 	env->spills         = NEW_ARR_F(spill_t*, 0);
@@ -9,6 +9,7 @@
  * @author      Daniel Grund, Sebastian Hack, Matthias Braun
  * @date        29.09.2005
  */
+#include <math.h>
 #include <stdlib.h>
 #include <stdbool.h>
 
@@ -24,6 +25,7 @@
 #include "array.h"
 #include "execfreq.h"
 #include "error.h"
+#include "util.h"
 #include "bearch.h"
 #include "belive_t.h"
 #include "besched.h"
@@ -85,6 +87,8 @@ struct spill_env_t {
 	                                       placed */
 	spill_info_t    **mem_phis;       /**< set of all spilled phis. */
 
+	ir_nodeset_t      lv_changed;     /**< values whose liveness changed while
+	                                       inserting spills and reloads */
 	unsigned          spill_count;
 	unsigned          reload_count;
 	unsigned          remat_count;
@@ -126,6 +130,29 @@ static spill_info_t *get_spillinfo(const spill_env_t *env, ir_node *value)
 	return res;
 }
 
+/**
+ * Returns the spill info of @p value or NULL if the value is not spilled.
+ */
+static spill_info_t *find_spillinfo(const spill_env_t *env,
+                                    const ir_node *value)
+{
+	spill_info_t info;
+	info.to_spill = (ir_node*)value;
+	return set_find(spill_info_t, env->spills, &info, sizeof(info),
+	                hash_irn(value));
+}
+
+/**
+ * Remembers that the liveness of a node and of its operands changed.
+ */
+static void note_changed_liveness(spill_env_t *env, ir_node *node)
+{
+	ir_nodeset_insert(&env->lv_changed, node);
+	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+		ir_nodeset_insert(&env->lv_changed, get_irn_n(node, i));
+	}
+}
+
 spill_env_t *be_new_spill_env(ir_graph *irg)
 {
 	const arch_env_t *arch_env = be_get_irg_arch_env(irg);
@@ -382,6 +409,7 @@ static void spill_irn(spill_env_t *env, spill_info_t *spillinfo)
 		after = determine_spill_point(after);
 
 		spill->spill = arch_env_new_spill(env->arch_env, to_spill, after);
+		note_changed_liveness(env, spill->spill);
 		DB((dbg, LEVEL_1, "\t%+F after %+F\n", spill->spill, after));
 		env->spill_count++;
 	}
@@ -438,6 +466,7 @@ static void spill_phi(spill_env_t *env, spill_info_t *spillinfo)
 
 		set_irn_n(spill->spill, i, arg_info->spills->spill);
 	}
+	note_changed_liveness(env, spill->spill);
 	DBG((dbg, LEVEL_1, "... done spilling Phi %+F, created PhiM %+F\n", phi,
 	     spill->spill));
 }
@@ -471,6 +500,108 @@ static void spill_node(spill_env_t *env, spill_info_t *spillinfo)
  *
  */
 
+/**
+ * Tests whether @p value is used at or after @p before, which is scheduled in
+ * @p block.
+ */
+static bool is_used_from(const be_lv_t *lv, const ir_node *value,
+                         const ir_node *block, const ir_node *before)
+{
+	if (be_is_live_end(lv, block, value))
+		return true;
+	foreach_out_edge(value, edge) {
+		const ir_node *user = get_edge_src_irn(edge);
+		if (is_Phi(user) || get_nodes_block(user) != block
+		    || !sched_is_scheduled(user))
+			continue;
+		if (user == before || sched_comes_after(before, user))
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Tests whether @p value is held in a register right before @p before: it is
+ * never spilled and live at this point, so a rematerialisation may use it
+ * without extending its lifetime.
+ */
+static bool is_live_in_reg_before(const spill_env_t *env, const ir_node *value,
+                                  const ir_node *before)
+{
+	be_lv_t *lv = be_get_irg_liveness(env->irg);
+	if (!lv->sets_valid || is_Block(before) || !sched_is_scheduled(before))
+		return false;
+	if (get_irn_mode(value) == mode_T
+	    || arch_get_irn_register_req(value)->cls == NULL)
+		return false;
+	if (find_spillinfo(env, value) != NULL)
+		return false;
+
+	const ir_node *block = get_nodes_block(before);
+	const ir_node *def   = skip_Proj_const(value);
+	if (get_nodes_block(def) == block) {
+		if (!sched_is_scheduled(def) || !sched_comes_after(def, before))
+			return false;
+	} else if (!be_is_live_in(lv, block, value)) {
+		return false;
+	}
+	return is_used_from(lv, value, block, before);
+}
+
+/**
+ * Tests whether @p value lives in a flags register, i.e. in a manually
+ * allocated register class which is not a state.
+ */
+static bool is_flags_value(const ir_node *value)
+{
+	const arch_register_class_t *cls = arch_get_irn_register_req(value)->cls;
+	if (cls == NULL)
+		return false;
+	arch_register_class_flags_t flags = arch_register_class_flags(cls);
+	return (flags & arch_register_class_flag_manual_ra)
+	    && !(flags & arch_register_class_flag_state);
+}
+
+/**
+ * Tests whether a flags value is live right before @p before, so no node
+ * modifying the flags may be placed there.
+ */
+static bool are_flags_live_before(const spill_env_t *env, const ir_node *before)
+{
+	be_lv_t *lv = be_get_irg_liveness(env->irg);
+	if (!lv->sets_valid || is_Block(before) || !sched_is_scheduled(before))
+		return true;
+
+	/* flags values never live across a node modifying the flags, so only the
+	 * results of the last such node before us are interesting */
+	const ir_node *block = get_nodes_block(before);
+	sched_foreach_reverse_before((ir_node*)before, node) {
+		bool defines_flags = false;
+		if (get_irn_mode(node) == mode_T) {
+			foreach_out_edge(node, edge) {
+				const ir_node *proj = get_edge_src_irn(edge);
+				if (!is_flags_value(proj))
+					continue;
+				defines_flags = true;
+				if (is_used_from(lv, proj, block, before))
+					return true;
+			}
+		} else if (is_flags_value(node)) {
+			defines_flags = true;
+			if (is_used_from(lv, node, block, before))
+				return true;
+		}
+		if (defines_flags || arch_irn_is(node, modify_flags))
+			return false;
+	}
+
+	be_lv_foreach(lv, block, be_lv_state_in, value) {
+		if (is_flags_value(value))
+			return true;
+	}
+	return false;
+}
+
 /**
  * Tests whether value @p arg is available before node @p reloader
  * @returns 1 if value is available, 0 otherwise
@@ -501,6 +632,27 @@ static int is_value_available(spill_env_t *env, const ir_node *arg,
 	return 0;
 }
 
+/**
+ * Tests whether a rematerialisation of @p insn before @p reloader may use its
+ * argument @p arg as it is.
+ */
+static bool is_remat_arg_available(spill_env_t *env, const ir_node *insn,
+                                   const ir_node *arg, const ir_node *reloader)
+{
+	if (is_value_available(env, arg, reloader))
+		return true;
+
+	/* values held in a register anyway may be used, unless insn overwrites
+	 * one of its inputs: the input would need a copy then */
+	insn = skip_Proj_const(insn);
+	be_foreach_out(insn, o) {
+		const arch_register_req_t *req = arch_get_irn_register_req_out(insn, o);
+		if (arch_register_req_is(req, should_be_same))
+			return false;
+	}
+	return is_live_in_reg_before(env, arg, reloader);
+}
+
 /**
  * Check if a node is rematerializable. This tests for the following conditions:
  *
@@ -531,11 +683,10 @@ static int check_remat_conditions_costs(spill_env_t *env,
 	if (parentcosts + costs >= env->reload_cost + env->spill_cost) {
 		return REMAT_COST_INFINITE;
 	}
-	/* never rematerialize a node which modifies the flags.
-	 * (would be better to test whether the flags are actually live at point
-	 * reloader...)
-	 */
-	if (arch_irn_is(insn, modify_flags)) {
+	/* never rematerialize a node which modifies the flags while they are
+	 * live at point reloader */
+	if (arch_irn_is(insn, modify_flags)
+	    && are_flags_live_before(env, reloader)) {
 		return REMAT_COST_INFINITE;
 	}
 
@@ -543,7 +694,7 @@ static int check_remat_conditions_costs(spill_env_t *env,
 	for (i = 0, arity = get_irn_arity(insn); i < arity; ++i) {
 		ir_node *arg = get_irn_n(insn, i);
 
-		if (is_value_available(env, arg, reloader))
+		if (is_remat_arg_available(env, insn, arg, reloader))
 			continue;
 
 		/* we have to rematerialize the argument as well */
@@ -580,7 +731,7 @@ static ir_node *do_remat(spill_env_t *env, ir_node *spilled, ir_node *reloader)
 	for (i = 0, arity = get_irn_arity(spilled); i < arity; ++i) {
 		ir_node *arg = get_irn_n(spilled, i);
 
-		if (is_value_available(env, arg, reloader)) {
+		if (is_remat_arg_available(env, spilled, arg, reloader)) {
 			ins[i] = arg;
 		} else {
 			ins[i] = do_remat(env, arg, reloader);
@@ -596,6 +747,9 @@ static ir_node *do_remat(spill_env_t *env, ir_node *spilled, ir_node *reloader)
 	                  get_irn_arity(spilled), ins);
 	copy_node_attr(env->irg, spilled, res);
 	arch_env_mark_remat(env->arch_env, res);
+	/* the original might become dead, so its operands lose users */
+	note_changed_liveness(env, spilled);
+	note_changed_liveness(env, res);
 
 	DBG((dbg, LEVEL_1, "Insert remat %+F of %+F before reloader %+F\n", res, spilled, reloader));
 
@@ -701,6 +855,255 @@ ir_node *be_new_reload(ir_node *value, ir_node *spill, ir_node *before)
  *
  */
 
+/**
+ * An edge of the flow network used to place spills. Edges are created in
+ * pairs, so the reverse edge of edge e is e ^ 1.
+ */
+typedef struct cut_edge_t {
+	unsigned dst;  /**< the target vertex */
+	unsigned next; /**< the next edge leaving the same vertex */
+	double   cap;  /**< the remaining capacity */
+} cut_edge_t;
+
+/**
+ * The flow network for placing the spills of a single value. Every block is
+ * split into an in and an out vertex, so the block gets a capacity.
+ */
+typedef struct cut_graph_t {
+	ir_node    **blocks; /**< the blocks between definition and late spills */
+	bool        *sink;   /**< whether a block contains a late spill */
+	unsigned    *head;   /**< the first edge leaving each vertex */
+	cut_edge_t  *edges;  /**< all edges */
+} cut_graph_t;
+
+#define CUT_NO_EDGE    ((unsigned)-1)
+#define CUT_SOURCE     0
+#define CUT_SINK       1
+#define CUT_IN(i)      (2 + 2 * (i))
+#define CUT_OUT(i)     (3 + 2 * (i))
+/** maximal number of blocks considered for placing the spills of a value */
+#define MAX_CUT_BLOCKS 64
+
+static unsigned cut_get_block_index(cut_graph_t *graph, ir_node *block)
+{
+	for (size_t i = 0, n = ARR_LEN(graph->blocks); i < n; ++i) {
+		if (graph->blocks[i] == block)
+			return i;
+	}
+	ARR_APP1(ir_node*, graph->blocks, block);
+	ARR_APP1(bool, graph->sink, false);
+	ARR_APP1(unsigned, graph->head, CUT_NO_EDGE);
+	ARR_APP1(unsigned, graph->head, CUT_NO_EDGE);
+	return ARR_LEN(graph->blocks) - 1;
+}
+
+static void cut_add_edge(cut_graph_t *graph, unsigned src, unsigned dst,
+                         double cap)
+{
+	cut_edge_t forward  = { dst, graph->head[src], cap };
+	cut_edge_t backward = { src, graph->head[dst], 0 };
+	graph->head[src] = ARR_LEN(graph->edges);
+	ARR_APP1(cut_edge_t, graph->edges, forward);
+	graph->head[dst] = ARR_LEN(graph->edges);
+	ARR_APP1(cut_edge_t, graph->edges, backward);
+}
+
+/**
+ * Searches the residual network breadth first starting at the source and
+ * records the edge used to reach each vertex in @p pred.
+ *
+ * @returns true if the sink is reachable
+ */
+static bool cut_find_path(const cut_graph_t *graph, unsigned *pred)
+{
+	size_t    n_vertices = ARR_LEN(graph->head);
+	unsigned *queue      = ALLOCAN(unsigned, n_vertices);
+	size_t    q_begin    = 0;
+	size_t    q_end      = 0;
+
+	for (size_t v = 0; v < n_vertices; ++v)
+		pred[v] = CUT_NO_EDGE;
+	queue[q_end++] = CUT_SOURCE;
+	while (q_begin < q_end) {
+		unsigned v = queue[q_begin++];
+		for (unsigned e = graph->head[v]; e != CUT_NO_EDGE;
+		     e = graph->edges[e].next) {
+			const cut_edge_t *edge = &graph->edges[e];
+			if (edge->cap <= 0 || edge->dst == CUT_SOURCE
+			    || pred[edge->dst] != CUT_NO_EDGE)
+				continue;
+			pred[edge->dst] = e;
+			if (edge->dst == CUT_SINK)
+				return true;
+			queue[q_end++] = edge->dst;
+		}
+	}
+	return false;
+}
+
+/**
+ * Builds the flow network from the definition of the value to its late spill
+ * points. The region ends at blocks containing a late spill, as the value is
+ * not held in a register behind them.
+ *
+ * @returns false if the region is too big or does not reach all late spills
+ */
+static bool cut_build_graph(spill_env_t *env, spill_info_t *spillinfo,
+                            cut_graph_t *graph)
+{
+	ir_node *to_spill  = spillinfo->to_spill;
+	ir_node *def_block = get_nodes_block(skip_Proj(to_spill));
+	be_lv_t *lv        = be_get_irg_liveness(env->irg);
+
+	/* the definition block gets index 0 and is fed by the source, cutting
+	 * this edge means spilling after the definition */
+	cut_get_block_index(graph, def_block);
+	cut_add_edge(graph, CUT_SOURCE, CUT_OUT(0), get_block_execfreq(def_block));
+
+	/* cutting the edge of a late spill block means keeping its late spill */
+	for (spill_t *s = spillinfo->spills; s != NULL; s = s->next) {
+		ir_node *block = get_block(s->after);
+		unsigned idx   = cut_get_block_index(graph, block);
+		if (graph->sink[idx])
+			continue;
+		graph->sink[idx] = true;
+		cut_add_edge(graph, idx == 0 ? CUT_OUT(0) : CUT_IN(idx), CUT_SINK,
+		             get_block_execfreq(block));
+	}
+
+	size_t  n_sinks   = ARR_LEN(graph->blocks);
+	size_t  n_reached = 1;
+	bool   *reached   = ALLOCANZ(bool, n_sinks);
+	reached[0] = true;
+	for (size_t i = 0; i < ARR_LEN(graph->blocks); ++i) {
+		if (graph->sink[i])
+			continue;
+		foreach_block_succ(graph->blocks[i], edge) {
+			ir_node *succ = get_edge_src_irn(edge);
+			if (succ == def_block || !be_is_live_in(lv, succ, to_spill))
+				continue;
+
+			size_t   n_blocks = ARR_LEN(graph->blocks);
+			unsigned idx      = cut_get_block_index(graph, succ);
+			if (idx == n_blocks) {
+				if (n_blocks >= MAX_CUT_BLOCKS)
+					return false;
+				/* cutting the block means spilling at its beginning */
+				cut_add_edge(graph, CUT_IN(idx), CUT_OUT(idx),
+				             get_block_execfreq(succ));
+			} else if (idx < n_sinks && !reached[idx]) {
+				reached[idx] = true;
+				++n_reached;
+			}
+			cut_add_edge(graph, CUT_OUT(i), CUT_IN(idx), HUGE_VAL);
+		}
+	}
+	return n_reached == n_sinks;
+}
+
+/**
+ * Places the spills of a value on a minimal cut, weighted by execution
+ * frequency, between its definition and the late spill points requested by
+ * the spiller. The value stays in a register until the late spill points, so
+ * it may be spilled after the definition, at the beginning of any block in
+ * between or at the late spill points themselves. This moves spills off hot
+ * paths, for example out of a loop the definition is in.
+ *
+ * @param limit  the costs of the cheapest placement known so far
+ * @returns the execution frequency of the new spills if they are cheaper than
+ *          @p limit and have been installed, else @p limit
+ */
+static double place_spills_min_cut(spill_env_t *env, spill_info_t *spillinfo,
+                                   double limit)
+{
+	if (!be_get_irg_liveness(env->irg)->sets_valid)
+		return limit;
+
+	cut_graph_t graph;
+	graph.blocks = NEW_ARR_F(ir_node*, 0);
+	graph.sink   = NEW_ARR_F(bool, 0);
+	graph.head   = NEW_ARR_F(unsigned, 2);
+	graph.edges  = NEW_ARR_F(cut_edge_t, 0);
+	graph.head[CUT_SOURCE] = CUT_NO_EDGE;
+	graph.head[CUT_SINK]   = CUT_NO_EDGE;
+
+	double flow = 0;
+	if (!cut_build_graph(env, spillinfo, &graph)) {
+		flow = limit;
+		goto end;
+	}
+
+	/* Edmonds-Karp */
+	unsigned *pred = NEW_ARR_F(unsigned, ARR_LEN(graph.head));
+	while (flow < limit && cut_find_path(&graph, pred)) {
+		double bottleneck = HUGE_VAL;
+		for (unsigned v = CUT_SINK; v != CUT_SOURCE;
+		     v = graph.edges[pred[v] ^ 1].dst) {
+			bottleneck = MIN(bottleneck, graph.edges[pred[v]].cap);
+		}
+		for (unsigned v = CUT_SINK; v != CUT_SOURCE;
+		     v = graph.edges[pred[v] ^ 1].dst) {
+			graph.edges[pred[v]].cap     -= bottleneck;
+			graph.edges[pred[v] ^ 1].cap += bottleneck;
+		}
+		flow += bottleneck;
+	}
+	if (flow >= limit) {
+		DEL_ARR_F(pred);
+		flow = limit;
+		goto end;
+	}
+
+	/* the last search marked the vertices reachable from the source, the
+	 * saturated edges leaving them form the cut */
+	bool    *keep_late = ALLOCANZ(bool, ARR_LEN(graph.blocks));
+	spill_t *spills    = NULL;
+	for (unsigned e = 0, n = ARR_LEN(graph.edges); e < n; e += 2) {
+		unsigned src = graph.edges[e ^ 1].dst;
+		unsigned dst = graph.edges[e].dst;
+		if ((src != CUT_SOURCE && pred[src] == CUT_NO_EDGE)
+		    || dst == CUT_SOURCE || pred[dst] != CUT_NO_EDGE)
+			continue;
+
+		ir_node *after;
+		if (src == CUT_SOURCE) {
+			after = determine_spill_point(spillinfo->to_spill);
+		} else if (dst == CUT_SINK) {
+			keep_late[(src - 2) / 2] = true;
+			continue;
+		} else {
+			/* spill at the beginning of the block */
+			after = graph.blocks[(src - 2) / 2];
+		}
+
+		spill_t *spill = OALLOC(&env->obst, spill_t);
+		spill->after = after;
+		spill->next  = spills;
+		spill->spill = NULL;
+		spills       = spill;
+	}
+	for (spill_t *s = spillinfo->spills, *next; s != NULL; s = next) {
+		next = s->next;
+		unsigned idx = cut_get_block_index(&graph, get_block(s->after));
+		if (keep_late[idx]) {
+			s->next = spills;
+			spills  = s;
+		}
+	}
+	DEL_ARR_F(pred);
+
+	DB((dbg, LEVEL_1, "%+F: min-cut spill placement %f\n",
+	    spillinfo->to_spill, flow * env->spill_cost));
+	spillinfo->spills = spills;
+
+end:
+	DEL_ARR_F(graph.blocks);
+	DEL_ARR_F(graph.sink);
+	DEL_ARR_F(graph.head);
+	DEL_ARR_F(graph.edges);
+	return flow;
+}
+
 /**
  * analyzes how to best spill a node and determine costs for that
  */
@@ -767,6 +1170,14 @@ static void determine_spill_costs(spill_env_t *env, spill_info_t *spillinfo)
 		    spills_execfreq * env->spill_cost,
 		    spill_execfreq * env->spill_cost));
 
+		/* a mix of both might be cheaper still */
+		double best = MIN(spills_execfreq, spill_execfreq);
+		double cut  = place_spills_min_cut(env, spillinfo, best);
+		if (cut < best) {
+			spillinfo->spill_costs = cut * env->spill_cost;
+			return;
+		}
+
 		/* multi-/latespill is advantageous -> return*/
 		if (spills_execfreq < spill_execfreq) {
 			DB((dbg, LEVEL_1, "use latespills for %+F\n", to_spill));
@@ -820,6 +1231,16 @@ void make_spill_locations_dominate_irn(spill_env_t *env, ir_node *irn)
 		be_add_spill(env, si->to_spill, si->to_spill);
 }
 
+/**
+ * Remembers the phis created by an SSA reconstruction.
+ */
+static void note_new_phis(spill_env_t *env, be_ssa_construction_env_t *senv)
+{
+	ir_node **phis = be_ssa_construction_get_new_phis(senv);
+	for (size_t i = 0, n = ARR_LEN(phis); i < n; ++i)
+		note_changed_liveness(env, phis[i]);
+}
+
 void be_insert_spills_reloads(spill_env_t *env)
 {
 	size_t n_mem_phis = ARR_LEN(env->mem_phis);
@@ -827,6 +1248,8 @@ void be_insert_spills_reloads(spill_env_t *env)
 
 	be_timer_push(T_RA_SPILL_APPLY);
 
+	ir_nodeset_init(&env->lv_changed);
+
 	/* create all phi-ms first, this is needed so, that phis, hanging on
 	   spilled phis work correctly */
 	for (i = 0; i < n_mem_phis; ++i) {
@@ -844,6 +1267,9 @@ void be_insert_spills_reloads(spill_env_t *env)
 
 		DBG((dbg, LEVEL_1, "\nhandling all reloaders of %+F:\n", to_spill));
 
+		/* the users of the value get rewired to the copies */
+		ir_nodeset_insert(&env->lv_changed, to_spill);
+
 		determine_spill_costs(env, si);
 
 		/* determine possibility of rematerialisations */
@@ -928,6 +1354,7 @@ void be_insert_spills_reloads(spill_env_t *env)
 
 			DBG((dbg, LEVEL_1, " %+F of %+F before %+F\n",
 			     copy, to_spill, rld->reloader));
+			note_changed_liveness(env, copy);
 			ARR_APP1(ir_node*, copies, copy);
 		}
 
@@ -941,6 +1368,7 @@ void be_insert_spills_reloads(spill_env_t *env)
 			be_ssa_construction_add_copy(&senv, to_spill);
 			be_ssa_construction_add_copies(&senv, copies, ARR_LEN(copies));
 			be_ssa_construction_fix_users(&senv, to_spill);
+			note_new_phis(env, &senv);
 
 			be_ssa_construction_destroy(&senv);
 		}
@@ -963,6 +1391,7 @@ void be_insert_spills_reloads(spill_env_t *env)
 			if (spill_count > 1) {
 				/* all reloads are attached to the first spill, fix them now */
 				be_ssa_construction_fix_users(&senv, si->spills->spill);
+				note_new_phis(env, &senv);
 			}
 
 			be_ssa_construction_destroy(&senv);
@@ -977,12 +1406,18 @@ void be_insert_spills_reloads(spill_env_t *env)
 	stat_ev_dbl("spill_remats", env->remat_count);
 	stat_ev_dbl("spill_spilled_phis", env->spilled_phi_count);
 
-	/* Matze: In theory be_ssa_construction should take care of the liveness...
-	 * try to disable this again in the future */
-	be_invalidate_live_sets(env->irg);
-
 	be_remove_dead_nodes_from_schedule(env->irg);
 
+	/* update the liveness of everything that changed instead of computing
+	 * it again later */
+	be_lv_t *lv = be_get_irg_liveness(env->irg);
+	if (lv->sets_valid) {
+		unsigned n_blocks = be_liveness_update_nodes(lv, &env->lv_changed);
+		stat_ev_dbl("spill_lv_updated_values", ir_nodeset_size(&env->lv_changed));
+		stat_ev_dbl("spill_lv_updated_blocks", n_blocks);
+	}
+	ir_nodeset_destroy(&env->lv_changed);
+
 	be_timer_pop(T_RA_SPILL_APPLY);
 }
 
@@ -46,7 +46,7 @@
 #include "debug.h"
 #include "error.h"
 #include "array.h"
-#include "irdom.h"
+#include "irdom_t.h"
 #include "ircons.h"
 #include "iredges_t.h"
 #include "statev_t.h"
@@ -158,7 +158,8 @@ static void introduce_use(be_ssa_construction_env_t *env, ir_node *use)
 }
 
 /**
- * Calculates the iterated dominance frontier of a set of blocks. Marks the
+ * Calculates the iterated dominance frontier of the definition blocks in the
+ * worklist without computing the dominance frontiers of the graph. Marks the
  * blocks as visited. Sets the link fields of the blocks in the dominance
  * frontier to the block itself.
  */
@@ -168,27 +169,24 @@ static void mark_iterated_dominance_frontiers(
 	stat_ev_cnt_decl(blocks);
 	DBG((dbg, LEVEL_3, "Dominance Frontier:"));
 	stat_ev_tim_push();
+	ir_node **def_blocks = NEW_ARR_F(ir_node*, 0);
 	while (!waitq_empty(env->worklist)) {
-		int i;
-		ir_node  *block    = (ir_node*)waitq_get(env->worklist);
-		ir_node **domfront = ir_get_dominance_frontier(block);
-		int domfront_len = ARR_LEN(domfront);
-
-		for (i = 0; i < domfront_len; ++i) {
-			ir_node *y = domfront[i];
-			if (Block_block_visited(y))
-				continue;
-
-			if (!irn_visited(y)) {
-				set_irn_link(y, NULL);
-				waitq_put(env->worklist, y);
-			}
-
-			DBG((dbg, LEVEL_3, " %+F", y));
-			mark_Block_block_visited(y);
-			stat_ev_cnt_inc(blocks);
-		}
+		ir_node *block = (ir_node*)waitq_get(env->worklist);
+		ARR_APP1(ir_node*, def_blocks, block);
+	}
+	ir_node **idf = ir_compute_iterated_dominance_frontier(env->irg,
+			def_blocks, ARR_LEN(def_blocks));
+	for (size_t i = 0, n = ARR_LEN(idf); i < n; ++i) {
+		ir_node *y = idf[i];
+		if (!irn_visited(y))
+			set_irn_link(y, NULL);
+
+		DBG((dbg, LEVEL_3, " %+F", y));
+		mark_Block_block_visited(y);
+		stat_ev_cnt_inc(blocks);
 	}
+	DEL_ARR_F(idf);
+	DEL_ARR_F(def_blocks);
 	stat_ev_tim_pop("bessaconstr_idf_time");
 	stat_ev_cnt_done(blocks, "bessaconstr_idf_blocks");
 	DBG((dbg, LEVEL_3, "\n"));
@@ -386,7 +384,8 @@ void be_ssa_construction_init(be_ssa_construction_env_t *env, ir_graph *irg)
 	obstack_init(&env->obst);
 
 	assure_irg_properties(env->irg,
-	                      IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE_FRONTIERS);
+	                      IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
+	                      | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
 
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_VISITED
 			| IR_RESOURCE_BLOCK_VISITED | IR_RESOURCE_IRN_LINK);
@@ -12,14 +12,15 @@
 #include "bessadestr.h"
 
 #include "debug.h"
-#include "bitset.h"
+#include "raw_bitset.h"
+#include "util.h"
 #include "irnode_t.h"
 #include "irgwalk.h"
 #include "irgmod.h"
 #include "be_types.h"
 #include "bearch.h"
 #include "beirg.h"
-#include "belive.h"
+#include "belive_t.h"
 #include "benode.h"
 #include "besched.h"
 #include "bespillutil.h"
@@ -27,6 +28,11 @@
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
+typedef struct ssadestr_env_t {
+	const arch_register_class_t *cls;
+	bool                         use_copies; /**< break cycles with copies */
+} ssadestr_env_t;
+
 /* We represent a parallel copy/register transfer graph as follows.  As usual,
  * nodes are registers and edges are move operations.
  * - We exploit the fact that each node has at most one incoming edge and
@@ -34,125 +40,211 @@ DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
  *   *source* node of n.
  * - We mark nodes that do not have an incoming edge with parcopy[n] == n_regs.
  * - Self-loops are explicitely represented as parcopy[n] == n.
- * - Additionally, we maintain a second array n_used where n_used[n] gives us
- *   the number of *outgoing* edges of node n.
+ *
+ * The parallel copy is sequentialized directly: Moves whose destination is
+ * not read by another pending move are emitted as copies first, which leaves
+ * only disjoint cycles. A cycle of length k is either implemented with k - 1
+ * transpositions (2-Perms) or, if copies are preferred and a free register is
+ * available, with k + 1 copies through that register.
  */
-static void impl_parcopy(const arch_register_class_t *cls,
-                         ir_node *before, unsigned *parcopy, unsigned *n_used,
-                         ir_node **phis, ir_node **phi_args, unsigned pred_nr)
+
+typedef struct parcopy_env_t {
+	const arch_register_class_t *cls;
+	ir_node                     *before;   /**< insert code before this node */
+	ir_node                    **phis;     /**< Phi using a register as result */
+	unsigned                     pred_nr;  /**< Phi input being processed */
+	ir_node                    **new_vals; /**< created values */
+	unsigned                     n_new_vals;
+} parcopy_env_t;
+
+static const arch_register_t *get_reg(const parcopy_env_t *env, unsigned idx)
 {
-	ir_node        *block        = get_nodes_block(before);
-	ir_graph       *irg          = get_irn_irg(block);
-	be_lv_t        *lv           = be_get_irg_liveness(irg);
-	const unsigned  n_regs       = cls->n_regs;
-	unsigned        num_restores = 0;
-	unsigned        restore_srcs[n_regs];
-	unsigned        restore_dsts[n_regs];
-
-	/* Step 1: Search register transfer graph for nodes with > 1 outgoing edge.
-	 * Goal: Establish invariant that each node has <= 1 outgoing edges by
-	 *       recording restore copies (and inserting them later). */
-	for (unsigned to_reg = 0; to_reg < n_regs; ++to_reg) {
-		const unsigned from_reg    = parcopy[to_reg];
-		unsigned       from_n_used = n_used[from_reg];
-
-		if (from_reg == n_regs)
-			continue;
+	return arch_register_for_index(env->cls, idx);
+}
 
-		/* Decide if the current edge should be kept or not.
-		 * We keep an edge if it is a self-loop or if it is the last outgoing
-		 * edge of a node with multiple outgoing edges.
-		 * TODO: More clever heuristics which edge to keep? */
-		if (from_reg == to_reg || from_n_used == 1) {
-			/* Keep from_reg -> to_reg and cut every other edge. */
-
-			for (unsigned dst = 0; dst < n_regs; ++dst) {
-				if (dst != to_reg && parcopy[dst] == from_reg) {
-					/* Note: As we insert restore copies *after* the Perm node,
-					 * we record to_reg as the source of the copy. */
-					restore_srcs[num_restores] = to_reg;
-					restore_dsts[num_restores] = dst;
-					++num_restores;
-
-					/* Mark as done. */
-					parcopy[dst] = n_regs;
-					if (dst > to_reg) {
-						--from_n_used;
-					}
-				}
-			}
+static void set_phi_arg(parcopy_env_t *env, unsigned reg, ir_node *value)
+{
+	set_irn_n(env->phis[reg], env->pred_nr, value);
+}
 
-			assert(from_n_used == 1);
-			n_used[from_reg] = 1;
-		} else {
-			--n_used[from_reg];
-		}
-	}
+static ir_node *insert_copy(parcopy_env_t *env, ir_node *value, unsigned reg)
+{
+	ir_node *block = get_nodes_block(env->before);
+	ir_node *copy  = be_new_Copy(block, value);
+	arch_set_irn_register(copy, get_reg(env, reg));
+	sched_add_before(env->before, copy);
+	env->new_vals[env->n_new_vals++] = copy;
+	return copy;
+}
 
-#ifndef NDEBUG
-	/* Check invariant. */
-	for (unsigned dst = 0; dst < n_regs; ++dst) {
-		const unsigned src = parcopy[dst];
-		assert(src == n_regs || n_used[src] == 1);
-	}
-#endif
+/**
+ * Exchanges the contents of the registers holding @p a and @p b.
+ * Returns the Proj now holding @p a, the one holding @p b is stored in
+ * @p new_b.
+ */
+static ir_node *insert_swap(parcopy_env_t *env, ir_node *a, unsigned reg_a,
+                            ir_node *b, unsigned reg_b, ir_node **new_b)
+{
+	ir_node *block = get_nodes_block(env->before);
+	ir_node *in[]  = { a, b };
+	ir_node *perm  = be_new_Perm(env->cls, block, ARRAY_SIZE(in), in);
+	sched_add_before(env->before, perm);
+
+	ir_node *proj_a = new_r_Proj(perm, get_irn_mode(a), 0);
+	arch_set_irn_register(proj_a, get_reg(env, reg_b));
+	ir_node *proj_b = new_r_Proj(perm, get_irn_mode(b), 1);
+	arch_set_irn_register(proj_b, get_reg(env, reg_a));
+
+	env->new_vals[env->n_new_vals++] = proj_a;
+	env->new_vals[env->n_new_vals++] = proj_b;
+	*new_b = proj_b;
+	return proj_a;
+}
+
+/**
+ * Returns the index of a register of the class which is neither used by the
+ * parallel copy nor holds a value live at its insertion point, or n_regs if
+ * there is none.
+ */
+static unsigned get_free_register(const parcopy_env_t *env,
+                                  const unsigned *parcopy)
+{
+	const arch_register_class_t *cls    = env->cls;
+	ir_node                     *block  = get_nodes_block(env->before);
+	ir_graph                    *irg    = get_irn_irg(block);
+	be_lv_t                     *lv     = be_get_irg_liveness(irg);
+	const unsigned              *allocatable = be_birg_from_irg(irg)->allocatable_regs;
+	const unsigned               n_regs = cls->n_regs;
+	unsigned                    *used   = rbitset_alloca(n_regs);
 
-	/* Step 2: Build Perm node and Proj node(s). */
-	unsigned  perm_size = 0;
-	ir_node  *perm_ins[n_regs];
 	for (unsigned dst = 0; dst < n_regs; ++dst) {
 		const unsigned src = parcopy[dst];
-		if (src != n_regs && src != dst) {
-			assert(phi_args[src] != NULL);
-			perm_ins[perm_size++] = phi_args[src];
-		}
+		if (src == n_regs)
+			continue;
+		rbitset_set(used, dst);
+		rbitset_set(used, src);
 	}
 
-	if (perm_size > 0) {
-		ir_node *perm = be_new_Perm(cls, block, perm_size, perm_ins);
-		stat_ev_int("phi_perm", perm_size);
-		sched_add_before(before, perm);
-
-		unsigned i = 0;
-		for (unsigned dst = 0; dst < n_regs; ++dst) {
-			const unsigned src = parcopy[dst];
-			if (src == n_regs || src == dst)
-				continue;
+	be_lv_foreach_cls(lv, block, be_lv_state_end, cls, live) {
+		rbitset_set(used, arch_get_irn_register(live)->index);
+	}
 
-			ir_node               *in   = perm_ins[i];
-			ir_mode               *mode = get_irn_mode(in);
-			ir_node               *proj = new_r_Proj(perm, mode, i);
-			const arch_register_t *reg  = arch_register_for_index(cls, dst);
-			arch_set_irn_register(proj, reg);
+	/* the nodes behind the insertion point read and write registers, too */
+	for (ir_node *node = env->before; !sched_is_end(node);
+	     node = sched_next(node)) {
+		be_foreach_definition(node, cls, value, req,
+			rbitset_set(used, arch_get_irn_register(value)->index);
+		);
+		be_foreach_use(node, cls, in_req, value, value_req,
+			rbitset_set(used, arch_get_irn_register(value)->index);
+		);
+	}
 
-			ir_node *phi = phis[dst];
-			set_irn_n(phi, pred_nr, proj);
-			phi_args[dst] = proj;
+	for (unsigned i = 0; i < n_regs; ++i) {
+		const arch_register_t *reg = arch_register_for_index(cls, i);
+		if (!rbitset_is_set(used, i)
+		    && rbitset_is_set(allocatable, reg->global_index))
+			return i;
+	}
+	return n_regs;
+}
 
-			be_liveness_introduce(lv, proj);
-			be_liveness_update(lv, in);
+static void impl_parcopy(const arch_register_class_t *cls,
+                         ir_node *before, unsigned *parcopy,
+                         ir_node **phis, ir_node **phi_args, unsigned pred_nr,
+                         bool use_copies)
+{
+	ir_node        *block  = get_nodes_block(before);
+	ir_graph       *irg    = get_irn_irg(block);
+	be_lv_t        *lv     = be_get_irg_liveness(irg);
+	const unsigned  n_regs = cls->n_regs;
+	unsigned        n_used[n_regs];
+	unsigned        ready[n_regs];
+	unsigned        n_ready = 0;
+	ir_node        *new_vals[2 * n_regs];
+
+	parcopy_env_t env = {
+		.cls        = cls,
+		.before     = before,
+		.phis       = phis,
+		.pred_nr    = pred_nr,
+		.new_vals   = new_vals,
+		.n_new_vals = 0,
+	};
+
+	/* Self-loops only keep a value alive, they need no code. */
+	memset(n_used, 0, n_regs * sizeof(n_used[0]));
+	for (unsigned dst = 0; dst < n_regs; ++dst) {
+		const unsigned src = parcopy[dst];
+		if (src == dst)
+			parcopy[dst] = n_regs;
+		else if (src != n_regs)
+			++n_used[src];
+	}
 
-			++i;
-		}
+	/* Step 1: Emit copies into registers whose old value is not needed
+	 * anymore. Afterwards only cycles remain. */
+	for (unsigned dst = 0; dst < n_regs; ++dst) {
+		if (parcopy[dst] != n_regs && n_used[dst] == 0)
+			ready[n_ready++] = dst;
 	}
+	unsigned n_copies = 0;
+	while (n_ready > 0) {
+		const unsigned dst = ready[--n_ready];
+		const unsigned src = parcopy[dst];
+		assert(phi_args[src] != NULL);
+		set_phi_arg(&env, dst, insert_copy(&env, phi_args[src], dst));
+		parcopy[dst] = n_regs;
+		++n_copies;
 
-	/* Step 3: Place restore copies. */
-	for (unsigned i = 0; i < num_restores; ++i) {
-		const unsigned  src_reg = restore_srcs[i];
-		const unsigned  dst_reg = restore_dsts[i];
-		ir_node        *src     = phi_args[src_reg];
-		ir_node        *copy    = be_new_Copy(block, src);
-		sched_add_before(before, copy);
+		if (--n_used[src] == 0 && parcopy[src] != n_regs)
+			ready[n_ready++] = src;
+	}
 
-		const arch_register_t *reg = arch_register_for_index(cls, dst_reg);
-		arch_set_irn_register(copy, reg);
+	/* Step 2: Implement the cycles. */
+	unsigned free_reg = n_regs;
+	unsigned n_swaps  = 0;
+	for (unsigned start = 0; start < n_regs; ++start) {
+		if (parcopy[start] == n_regs)
+			continue;
 
-		ir_node *phi = phis[dst_reg];
-		set_irn_n(phi, pred_nr, copy);
-		phi_args[src_reg] = copy;
+		if (use_copies && free_reg == n_regs)
+			free_reg = get_free_register(&env, parcopy);
 
-		be_liveness_introduce(lv, copy);
-		be_liveness_update(lv, src);
+		if (free_reg != n_regs) {
+			ir_node *save = insert_copy(&env, phi_args[start], free_reg);
+			unsigned dst  = start;
+			for (unsigned src; (src = parcopy[dst]) != start; dst = src) {
+				set_phi_arg(&env, dst, insert_copy(&env, phi_args[src], dst));
+				parcopy[dst] = n_regs;
+			}
+			set_phi_arg(&env, dst, insert_copy(&env, save, dst));
+			parcopy[dst] = n_regs;
+			n_copies += 2;
+		} else {
+			/* carry holds the value of start, which is passed along the cycle
+			 * until it reaches the register expecting it */
+			ir_node *carry = phi_args[start];
+			unsigned dst   = start;
+			for (unsigned src; (src = parcopy[dst]) != start; dst = src) {
+				ir_node *moved;
+				carry = insert_swap(&env, carry, dst, phi_args[src], src, &moved);
+				set_phi_arg(&env, dst, moved);
+				parcopy[dst] = n_regs;
+				++n_swaps;
+			}
+			set_phi_arg(&env, dst, carry);
+			parcopy[dst] = n_regs;
+		}
+	}
+	stat_ev_int("phi_copies", n_copies);
+	stat_ev_int("phi_swaps", n_swaps);
+
+	for (unsigned i = 0; i < env.n_new_vals; ++i)
+		be_liveness_introduce(lv, new_vals[i]);
+	for (unsigned i = 0; i < n_regs; ++i) {
+		if (phi_args[i] != NULL)
+			be_liveness_update(lv, phi_args[i]);
 	}
 }
 
@@ -161,26 +253,24 @@ static void insert_shuffle_code_walker(ir_node *block, void *data)
 	if (!is_Phi(sched_first(block)))
 		return;
 
-	const arch_register_class_t *cls    = (const arch_register_class_t*)data;
+	const ssadestr_env_t        *env    = (const ssadestr_env_t*)data;
+	const arch_register_class_t *cls    = env->cls;
 	ir_graph                    *irg    = get_irn_irg(block);
 	be_lv_t                     *lv     = be_get_irg_liveness(irg);
 	const unsigned               n_regs = cls->n_regs;
 
 	for (int pred_nr = 0; pred_nr < get_irn_arity(block); ++pred_nr) {
 		unsigned  parcopy [n_regs];
-		unsigned  n_used  [n_regs];
 		ir_node  *phis    [n_regs];
 		ir_node  *phi_args[n_regs];
-		bitset_t *keep_val = bitset_alloca(n_regs);
 
-		memset(n_used,   0, n_regs * sizeof(n_used[0]));
 		memset(phis,     0, n_regs * sizeof(phis[0]));
 		memset(phi_args, 0, n_regs * sizeof(phi_args[0]));
 		for (unsigned i = 0; i < n_regs; ++i) {
 			parcopy[i] = n_regs;
 		}
 
-		bool need_perm = false;
+		bool need_copies = false;
 		for (ir_node *phi = sched_first(block); is_Phi(phi);
 		     phi = sched_next(phi)) {
 
@@ -193,22 +283,9 @@ static void insert_shuffle_code_walker(ir_node *block, void *data)
 
 			assert(parcopy[phi_reg_idx] == n_regs);
 			parcopy[phi_reg_idx] = arg_reg_idx;
-			++n_used[arg_reg_idx];
 
 			if (phi_reg_idx != arg_reg_idx)
-				need_perm = true;
-
-			/* If arg is live, we must keep it in its current register.
-			 * This is done by adding a self-loop to the register transfer
-			 * graph.
-			 * Because we may see the same arg multiple times, we use a bitset
-			 * instead of directly incrementing n_used.
-			 */
-			if (be_is_live_in(lv, block, arg)) {
-				assert(parcopy[arg_reg_idx] == n_regs || parcopy[arg_reg_idx] == arg_reg_idx);
-				parcopy[arg_reg_idx] = arg_reg_idx;
-				bitset_set(keep_val, arg_reg_idx);
-			}
+				need_copies = true;
 
 			assert(phis[phi_reg_idx] == NULL);
 			phis[phi_reg_idx] = phi;
@@ -216,28 +293,45 @@ static void insert_shuffle_code_walker(ir_node *block, void *data)
 			phi_args[arg_reg_idx] = arg;
 		}
 
-		if (need_perm) {
-			for (unsigned i = 0; i < n_regs; ++i)
-				n_used[i] += bitset_is_set(keep_val, i);
+#ifndef NDEBUG
+		/* A live argument stays in its current register, so this register
+		 * cannot be the target of another Phi. */
+		for (unsigned dst = 0; dst < n_regs; ++dst) {
+			const unsigned src = parcopy[dst];
+			if (src == n_regs || src == dst)
+				continue;
+			assert(phis[src] == NULL || !be_is_live_in(lv, block, phi_args[src]));
+		}
+#else
+		(void)lv;
+#endif
 
+		if (need_copies) {
 			ir_node *pred   = get_Block_cfgpred_block(block, pred_nr);
 			ir_node *before = be_get_end_of_block_insertion_point(pred);
-			impl_parcopy(cls, before, parcopy, n_used, phis, phi_args, pred_nr);
+			impl_parcopy(cls, before, parcopy, phis, phi_args, pred_nr,
+			             env->use_copies);
 		}
 	}
 }
 
-void be_ssa_destruction(ir_graph *irg, const arch_register_class_t *cls)
+void be_ssa_destruction(ir_graph *irg, const arch_register_class_t *cls,
+                        bool use_copies)
 {
 	FIRM_DBG_REGISTER(dbg, "ir.be.ssadestr");
 
 	be_invalidate_live_sets(irg);
 	be_assure_live_chk(irg);
+	/* finding free registers needs the values live at the block ends */
+	if (use_copies)
+		be_assure_live_sets(irg);
 
-	irg_block_walk_graph(irg, insert_shuffle_code_walker, NULL, (void*)cls);
+	ssadestr_env_t env = { cls, use_copies };
+	irg_block_walk_graph(irg, insert_shuffle_code_walker, NULL, &env);
 
-	/* unfortunately updating doesn't work yet. */
-	be_invalidate_live_chk(irg);
+	/* unfortunately updating doesn't work yet. The liveness check only
+	 * depends on the control flow, which is not changed here. */
+	be_invalidate_live_sets(irg);
 }
 
 static void ssa_destruction_check_walker(ir_node *block, void *data)
@@ -12,13 +12,19 @@
 #ifndef FIRM_BE_BESSADESTR_H
 #define FIRM_BE_BESSADESTR_H
 
+#include <stdbool.h>
+
 #include "be_types.h"
 #include "firm_types.h"
 
 /**
  * Performs SSA destruction. Arguments get adjusted, phi nodes just stay.
+ *
+ * @param use_copies  if set, cycles are broken with copies through a free
+ *                    register instead of transpositions, if one is available
  */
-void be_ssa_destruction(ir_graph *irg, const arch_register_class_t *cls);
+void be_ssa_destruction(ir_graph *irg, const arch_register_class_t *cls,
+                        bool use_copies);
 void be_ssa_destruction_check(ir_graph *irg, const arch_register_class_t *cls);
 
 #endif /* FIRM_BE_BESSADESTR_H */
@@ -23,8 +23,11 @@
 
 #include "ircons_t.h"
 #include "irnode_t.h"
+#include "iredges_t.h"
 #include "irgwalk.h"
 #include "irgmod.h"
+#include "array.h"
+#include "xmalloc.h"
 
 int be_get_stack_entity_offset(be_stack_layout_t *frame, ir_entity *ent,
                                int bias)
@@ -118,14 +121,6 @@ static void lower_outer_frame_sels(ir_node *sel, void *ctx)
 	}
 }
 
-/**
- * A helper struct for the bias walker.
- */
-typedef struct bias_walk {
-	int      start_block_bias; /**< The bias at the end of the start block. */
-	ir_node *start_block;      /**< The start block of the current graph. */
-} bias_walk;
-
 /**
  * Fix all stack accessing operations in the block bl.
  *
@@ -202,15 +197,76 @@ static int process_stack_bias(ir_node *bl, int real_bias)
 }
 
 /**
- * Block-Walker: fix all stack offsets for all blocks
- * except the start block
+ * Returns the stack bias at the end of the block @p bl, which begins with
+ * bias @p bias.
+ */
+static int get_block_end_bias(ir_node *bl, int bias)
+{
+	sched_foreach(bl, irn) {
+		int ofs = arch_get_sp_bias(irn);
+		if (ofs == SP_BIAS_RESET) {
+			bias = 0;
+		} else {
+			bias += ofs;
+		}
+	}
+	return bias;
+}
+
+typedef int (*process_block_func)(ir_node *bl, int bias);
+
+/**
+ * Calls @p process for every block with the stack bias at its beginning, a
+ * block is visited after one of its predecessors. Blocks may begin with
+ * different biases as the stack frame need not be set up in the start block,
+ * but all predecessors of a block must agree on its bias.
+ *
+ * @return the bias at the beginning of each block indexed by block index
  */
-static void stack_bias_walker(ir_node *bl, void *data)
+static int *walk_stack_bias(ir_graph *irg, int initial_bias,
+                            process_block_func process)
 {
-	bias_walk *bw = (bias_walk*)data;
-	if (bl != bw->start_block) {
-		process_stack_bias(bl, bw->start_block_bias);
+	ir_node  *start_block = get_irg_start_block(irg);
+	ir_node  *end_block   = get_irg_end_block(irg);
+	unsigned  n_idx       = get_irg_last_idx(irg);
+	int      *biases      = XMALLOCN(int, n_idx);
+	bool     *visited     = XMALLOCNZ(bool, n_idx);
+	ir_node **worklist    = NEW_ARR_F(ir_node*, 1);
+
+	worklist[0] = start_block;
+	biases[get_irn_idx(start_block)]  = initial_bias;
+	visited[get_irn_idx(start_block)] = true;
+	while (ARR_LEN(worklist) > 0) {
+		size_t   n_work = ARR_LEN(worklist);
+		ir_node *bl     = worklist[n_work - 1];
+		ARR_SHRINKLEN(worklist, n_work - 1);
+
+		int bias = process(bl, biases[get_irn_idx(bl)]);
+		foreach_block_succ(bl, edge) {
+			ir_node *succ = get_edge_src_irn(edge);
+			unsigned idx  = get_irn_idx(succ);
+			if (succ == end_block)
+				continue;
+			if (visited[idx]) {
+				assert(biases[idx] == bias);
+				continue;
+			}
+			biases[idx]  = bias;
+			visited[idx] = true;
+			ARR_APP1(ir_node*, worklist, succ);
+		}
 	}
+
+	DEL_ARR_F(worklist);
+	free(visited);
+	return biases;
+}
+
+int *be_get_block_stack_biases(ir_graph *irg)
+{
+	be_stack_layout_t *stack_layout = be_get_irg_stack_layout(irg);
+	return walk_stack_bias(irg, stack_layout->initial_bias,
+	                       get_block_end_bias);
 }
 
 void be_abi_fix_stack_bias(ir_graph *irg)
@@ -218,16 +274,11 @@ void be_abi_fix_stack_bias(ir_graph *irg)
 	be_stack_layout_t *stack_layout = be_get_irg_stack_layout(irg);
 	ir_type           *frame_tp;
 	int                i;
-	bias_walk          bw;
 
 	stack_frame_compute_initial_offset(stack_layout);
 
-	/* Determine the stack bias at the end of the start block. */
-	bw.start_block      = get_irg_start_block(irg);
-	bw.start_block_bias = process_stack_bias(bw.start_block, stack_layout->initial_bias);
-
-	/* fix the bias is all other blocks */
-	irg_block_walk_graph(irg, stack_bias_walker, NULL, &bw);
+	/* fix the bias in all blocks */
+	free(walk_stack_bias(irg, stack_layout->initial_bias, process_stack_bias));
 
 	/* fix now inner functions: these still have Sel node to outer
 	   frame and parameter entities */
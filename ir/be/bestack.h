@@ -27,6 +27,13 @@ void be_abi_fix_stack_nodes(ir_graph *irg);
  */
 void be_abi_fix_stack_bias(ir_graph *irg);
 
+/**
+ * Returns the stack bias at the beginning of every block, indexed by block
+ * index. The stack bias must have been fixed already. Free the result with
+ * free().
+ */
+int *be_get_block_stack_biases(ir_graph *irg);
+
 int be_get_stack_entity_offset(be_stack_layout_t *frame, ir_entity *ent,
                                int bias);
 
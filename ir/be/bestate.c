@@ -471,7 +471,7 @@ void be_assure_state(ir_graph *irg, const arch_register_t *reg, void *func_env,
 	env.create_spill  = create_spill;
 	env.create_reload = create_reload;
 	env.lv            = be_get_irg_liveness(irg);
-	env.uses          = be_begin_uses(irg, env.lv);
+	env.uses          = be_begin_uses(irg, env.lv, reg->reg_class);
 	env.spills        = NULL;
 	ir_nodehashmap_init(&env.spill_infos);
 
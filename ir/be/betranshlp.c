@@ -381,14 +381,20 @@ void be_transform_graph(ir_graph *irg, arch_pretrans_nodes *func)
 
 	/* create a new obstack */
 	struct obstack old_obst = irg->obst;
-	obstack_init(&irg->obst);
+	init_irg_obstack(irg, &irg->obst, IR_GRAPH_MEMORY_NODES);
 	irg->last_node_idx = 0;
 
 	free_vrp_data(irg);
+	/* the alias cache refers to the old nodes */
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
 
 	/* create new value table for CSE */
 	new_identities(irg);
 
+	/* the transformers only inspect the users of old nodes, so do not record
+	 * the edges of the new nodes one by one but rebuild them afterwards */
+	edges_suspend(irg);
+
 	/* do the main transformation */
 	transform_nodes(irg, func);
 
@@ -400,10 +406,10 @@ void be_transform_graph(ir_graph *irg, arch_pretrans_nodes *func)
 
 	/* most analysis info is wrong after transformation */
 	be_invalidate_live_chk(irg);
-	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
 
-	/* recalculate edges */
+	/* recalculate edges, reusing the memory of the old ones */
 	edges_activate(irg);
+	confirm_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
 }
 
 bool be_upper_bits_clean(const ir_node *node, ir_mode *mode)
@@ -12,6 +12,7 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include "array_t.h"
 #include "obst.h"
 #include "pmap.h"
 #include "debug.h"
@@ -43,11 +44,26 @@ typedef struct be_use_t {
 	ir_visited_t visited;
 } be_use_t;
 
+/**
+ * The last in-block next use found for a value. As long as the schedule does
+ * not change it stays valid for all later queries in the same block up to the
+ * use itself, so walking a block forward rarely has to look at the out edges
+ * again.
+ */
+typedef struct be_block_use_t {
+	const ir_node *block;     /**< the block of the query, NULL if unset */
+	unsigned       from_step; /**< step the search started at */
+	unsigned       use_step;  /**< step of the next use or UINT_MAX if none */
+	ir_node       *use;       /**< the next use or NULL if none */
+} be_block_use_t;
+
 /**
  * The "uses" environment.
  */
 struct be_uses_t {
 	set *uses;                          /**< cache: contains all computed uses so far. */
+	be_block_use_t *block_uses;         /**< in-block next uses by value index */
+	unsigned n_block_uses;              /**< length of block_uses */
 	ir_graph *irg;                      /**< the graph for this environment. */
 	const be_lv_t *lv;                  /**< the liveness for the graph. */
 	ir_visited_t visited_counter;       /**< current search counter. */
@@ -182,34 +198,28 @@ static inline void set_step(ir_node *node, unsigned step)
 }
 
 /**
- * Find the next use of a value defined by def, starting at node from.
+ * Find the next use of def in block at or after timestep, Phis are ignored.
  *
- * @param env             the uses environment
- * @param from            the node at which we should start the search
- * @param def             the definition of the value
- * @param skip_from_uses  if non-zero, ignore from uses
+ * @return the use or NULL if there is none, its step is stored in @p use_step
  */
-static be_next_use_t get_next_use(be_uses_t *env, ir_node *from,
-								  const ir_node *def, int skip_from_uses)
+static ir_node *get_block_next_use(be_uses_t *env, const ir_node *block,
+                                   const ir_node *def, unsigned timestep,
+                                   unsigned *use_step)
 {
-	unsigned  step;
-	ir_node  *block = get_nodes_block(from);
-	ir_node  *next_use_node;
-	ir_node  *node;
-	unsigned  timestep;
-	unsigned  next_use_step;
-
-	assert(skip_from_uses == 0 || skip_from_uses == 1);
-	if (skip_from_uses) {
-		from = sched_next(from);
+	unsigned        const idx    = get_irn_idx(def);
+	be_block_use_t *const cached = idx < env->n_block_uses
+	                             ? &env->block_uses[idx] : NULL;
+	if (cached != NULL && cached->block == block
+	    && cached->from_step <= timestep && timestep <= cached->use_step) {
+		*use_step = cached->use_step;
+		return cached->use;
 	}
 
-	next_use_node = NULL;
-	next_use_step = INT_MAX;
-	timestep      = get_step(from);
+	ir_node  *next_use_node = NULL;
+	unsigned  next_use_step = UINT_MAX;
 	foreach_out_edge(def, edge) {
 		unsigned node_step;
-		node = get_edge_src_irn(edge);
+		ir_node *node = get_edge_src_irn(edge);
 
 		if (is_Anchor(node))
 			continue;
@@ -227,6 +237,42 @@ static be_next_use_t get_next_use(be_uses_t *env, ir_node *from,
 		}
 	}
 
+	if (cached != NULL) {
+		cached->block     = block;
+		cached->from_step = timestep;
+		cached->use_step  = next_use_step;
+		cached->use       = next_use_node;
+	}
+	*use_step = next_use_step;
+	return next_use_node;
+}
+
+/**
+ * Find the next use of a value defined by def, starting at node from.
+ *
+ * @param env             the uses environment
+ * @param from            the node at which we should start the search
+ * @param def             the definition of the value
+ * @param skip_from_uses  if non-zero, ignore from uses
+ */
+static be_next_use_t get_next_use(be_uses_t *env, ir_node *from,
+								  const ir_node *def, int skip_from_uses)
+{
+	unsigned  step;
+	ir_node  *block = get_nodes_block(from);
+	ir_node  *next_use_node;
+	ir_node  *node;
+	unsigned  timestep;
+	unsigned  next_use_step;
+
+	assert(skip_from_uses == 0 || skip_from_uses == 1);
+	if (skip_from_uses) {
+		from = sched_next(from);
+	}
+
+	timestep      = get_step(from);
+	next_use_node = get_block_next_use(env, block, def, timestep,
+	                                   &next_use_step);
 	if (next_use_node != NULL) {
 		be_next_use_t result;
 		result.time           = next_use_step - timestep + skip_from_uses;
@@ -345,7 +391,28 @@ static void set_sched_step_walker(ir_node *block, void *data)
 	}
 }
 
-be_uses_t *be_begin_uses(ir_graph *irg, const be_lv_t *lv)
+/**
+ * Computes the next use at the start of every block for all values of a
+ * register class which are live in there. Successors are handled before
+ * their predecessors where possible, so most entries are found in the cache
+ * when a block is summarized.
+ */
+static void compute_block_summaries(be_uses_t *env,
+                                    const arch_register_class_t *cls)
+{
+	ir_node **blocks = be_get_cfgpostorder(env->irg);
+	for (size_t i = 0, n = ARR_LEN(blocks); i < n; ++i) {
+		ir_node *block = blocks[i];
+		be_lv_foreach_cls(env->lv, block, be_lv_state_in, cls, node) {
+			++env->visited_counter;
+			(void)get_or_set_use_block(env, block, node);
+		}
+	}
+	DEL_ARR_F(blocks);
+}
+
+be_uses_t *be_begin_uses(ir_graph *irg, const be_lv_t *lv,
+                         const arch_register_class_t *cls)
 {
 	be_uses_t *env = XMALLOC(be_uses_t);
 
@@ -357,11 +424,16 @@ be_uses_t *be_begin_uses(ir_graph *irg, const be_lv_t *lv)
 	irg_block_walk_graph(irg, set_sched_step_walker, NULL, NULL);
 
 	env->uses = new_set(cmp_use, 512);
+	env->n_block_uses = get_irg_last_idx(irg);
+	env->block_uses = XMALLOCNZ(be_block_use_t, env->n_block_uses);
 	env->irg = irg;
 	env->lv = lv;
 	env->visited_counter = 0;
 	FIRM_DBG_REGISTER(env->dbg, "firm.be.uses");
 
+	if (cls != NULL)
+		compute_block_summaries(env, cls);
+
 	return env;
 }
 
@@ -369,5 +441,6 @@ void be_end_uses(be_uses_t *env)
 {
 	//clear_using_irn_link(env->irg);
 	del_set(env->uses);
+	free(env->block_uses);
 	free(env);
 }
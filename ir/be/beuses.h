@@ -45,11 +45,16 @@ be_next_use_t be_get_next_use(be_uses_t *uses, ir_node *from,
 
 /**
  * Creates a new uses environment for a graph.
+ * The environment is a snapshot of the current schedule and has to be
+ * recreated after the schedule changed.
  *
  * @param irg  the graph
  * @param lv   liveness information for the graph
+ * @param cls  if not NULL, the next uses at the start of every block are
+ *             computed up front for all live-in values of this class
  */
-be_uses_t *be_begin_uses(ir_graph *irg, const be_lv_t *lv);
+be_uses_t *be_begin_uses(ir_graph *irg, const be_lv_t *lv,
+                         const arch_register_class_t *cls);
 
 /**
  * Destroys the given uses environment.
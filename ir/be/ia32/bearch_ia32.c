@@ -52,6 +52,8 @@
 #include "belistsched.h"
 #include "beabihelper.h"
 #include "bestack.h"
+#include "bemachine.h"
+#include "bejit.h"
 
 #include "bearch_ia32_t.h"
 
@@ -84,6 +86,7 @@ static ir_type *between_type           = NULL;
 static ir_entity *old_bp_ent           = NULL;
 static ir_entity *ret_addr_ent         = NULL;
 static ir_entity *omit_fp_ret_addr_ent = NULL;
+static ir_entity *mcount               = NULL;
 static int        precise_x87_spills;
 
 typedef ir_node *(*create_const_node_func) (dbg_info *dbgi, ir_node *block);
@@ -300,6 +303,63 @@ static int ia32_get_op_estimated_cost(ir_node const *const irn)
 	return cost;
 }
 
+/**
+ * Ports and reciprocal throughput of the port classes. The model follows
+ * Haswell with four integer ports (0, 1, 5, 6), two load ports (2, 3) and a
+ * store data port (4).
+ */
+static const struct {
+	unsigned ports;
+	unsigned occupancy;
+} ia32_port_classes[] = {
+	[ia32_pc_none]      = { 0x00,  0 },
+	[ia32_pc_alu]       = { 0x63,  1 },
+	[ia32_pc_shift]     = { 0x41,  1 },
+	[ia32_pc_lea]       = { 0x22,  1 },
+	[ia32_pc_mul]       = { 0x02,  1 },
+	[ia32_pc_div]       = { 0x01, 20 },
+	[ia32_pc_branch]    = { 0x41,  1 },
+	[ia32_pc_load]      = { 0x0C,  1 },
+	[ia32_pc_store]     = { 0x10,  1 },
+	[ia32_pc_vec_add]   = { 0x03,  1 },
+	[ia32_pc_vec_mul]   = { 0x03,  1 },
+	[ia32_pc_vec_div]   = { 0x01,  4 },
+	[ia32_pc_vec_logic] = { 0x23,  1 },
+	[ia32_pc_x87]       = { 0x21,  1 },
+	[ia32_pc_x87_div]   = { 0x01, 16 },
+};
+
+/** Latency of a load hitting the L1 cache. */
+#define IA32_LOAD_LATENCY 4
+
+static void ia32_get_timing(ir_node const *const node,
+                            be_insn_timing_t *const timing)
+{
+	if (!is_ia32_irn(node)) {
+		/* Copies become moves, everything else emits no code */
+		timing->latency   = be_is_Copy(node) ? 1 : 0;
+		timing->occupancy = 1;
+		timing->ports     = be_is_Copy(node) ? ia32_port_classes[ia32_pc_alu].ports : 0;
+		return;
+	}
+
+	ia32_port_class_t const port_class = get_ia32_port_class(node);
+	timing->latency   = get_ia32_latency(node);
+	timing->occupancy = ia32_port_classes[port_class].occupancy;
+	timing->ports     = ia32_port_classes[port_class].ports;
+
+	/* address mode operands have to be loaded first, this includes the
+	 * Loads themselves which have a latency of 0 in the spec */
+	if (get_ia32_op_type(node) != ia32_Normal)
+		timing->latency += IA32_LOAD_LATENCY;
+}
+
+static const be_machine_t ia32_machine = {
+	4,               /* issue width */
+	7,               /* number of ports */
+	ia32_get_timing,
+};
+
 static ir_mode *get_spill_mode_mode(const ir_mode *mode)
 {
 	if (mode_is_float(mode))
@@ -526,6 +586,82 @@ static ir_node *flags_remat(ir_node *node, ir_node *after)
 /**
  * Called before the register allocator.
  */
+static bool flags_modifies(const ir_node *node)
+{
+	/* Lea is only marked as flags modifying to help the peephole optimizer */
+	return arch_irn_is(node, modify_flags) && !is_ia32_Lea(node);
+}
+
+/**
+ * Returns a Lea computing the same value as an Add, a Sub of a constant or a
+ * small Shl, so the flags stay intact.
+ */
+static ir_node *flags_preserve(ir_node *node)
+{
+	if (!is_ia32_irn(node) || get_irn_mode(node) == mode_T
+	    || get_ia32_op_type(node) != ia32_Normal)
+		return NULL;
+
+	ir_graph                    *irg    = get_irn_irg(node);
+	ir_node                     *noreg  = ia32_new_NoReg_gp(irg);
+	ir_node                     *base   = noreg;
+	ir_node                     *index  = noreg;
+	unsigned                     scale  = 0;
+	long                         offset = 0;
+	ir_entity                   *sc     = NULL;
+	ir_node                     *right;
+	const ia32_immediate_attr_t *attr;
+	switch (get_ia32_irn_opcode(node)) {
+	case iro_ia32_Add:
+		base  = get_irn_n(node, n_ia32_Add_left);
+		right = get_irn_n(node, n_ia32_Add_right);
+		if (!is_ia32_Immediate(right)) {
+			index = right;
+			break;
+		}
+		attr = get_ia32_immediate_attr_const(right);
+		if (attr->sc_sign)
+			return NULL;
+		offset = attr->offset;
+		sc     = attr->symconst;
+		break;
+
+	case iro_ia32_Sub:
+		base  = get_irn_n(node, n_ia32_Sub_minuend);
+		right = get_irn_n(node, n_ia32_Sub_subtrahend);
+		if (!is_ia32_Immediate(right))
+			return NULL;
+		attr = get_ia32_immediate_attr_const(right);
+		if (attr->symconst != NULL || attr->offset < -0x7FFFFFFF)
+			return NULL;
+		offset = -attr->offset;
+		break;
+
+	case iro_ia32_Shl:
+		index = get_irn_n(node, n_ia32_Shl_val);
+		right = get_irn_n(node, n_ia32_Shl_count);
+		if (!is_ia32_Immediate(right))
+			return NULL;
+		attr = get_ia32_immediate_attr_const(right);
+		if (attr->symconst != NULL || attr->offset < 1 || attr->offset > 3)
+			return NULL;
+		scale = attr->offset;
+		break;
+
+	default:
+		return NULL;
+	}
+
+	dbg_info *dbgi  = get_irn_dbg_info(node);
+	ir_node  *block = get_nodes_block(node);
+	ir_node  *lea   = new_bd_ia32_Lea(dbgi, block, base, index);
+	set_ia32_am_scale(lea, scale);
+	set_ia32_am_offs_int(lea, offset);
+	set_ia32_am_sc(lea, sc);
+	SET_IA32_ORIG_NODE(lea, node);
+	return lea;
+}
+
 static void ia32_before_ra(ir_graph *irg)
 {
 	/* setup fpu rounding modes */
@@ -533,7 +669,7 @@ static void ia32_before_ra(ir_graph *irg)
 
 	/* fixup flags */
 	be_sched_fix_flags(irg, &ia32_reg_classes[CLASS_ia32_flags],
-	                   &flags_remat, NULL);
+	                   &flags_remat, &flags_modifies, &flags_preserve);
 
 	be_add_missing_keeps(irg);
 }
@@ -1056,16 +1192,21 @@ static void ia32_emit(ir_graph *irg)
 	}
 
 	/* do peephole optimizations */
-	ia32_peephole_optimization(irg);
+	if (!be_options.fast)
+		ia32_peephole_optimization(irg);
 
 	be_remove_dead_nodes_from_schedule(irg);
 
 	/* create block schedule, this also removes empty blocks which might
 	 * produce critical edges */
 	irg_data->blk_sched = be_create_block_schedule(irg);
+	be_split_cold_fragment(irg, irg_data->blk_sched);
+
+	/* the schedule does not change anymore */
+	sched_freeze(irg);
 
 	/* emit the code */
-	if (ia32_cg_config.emit_machcode) {
+	if (ia32_cg_config.emit_machcode || be_jit_active()) {
 		ia32_emit_function_binary(irg);
 	} else {
 		ia32_emit_function(irg);
@@ -1086,7 +1227,6 @@ static void ia32_prepare_graph(ir_graph *irg)
 		/* Linux gprof implementation needs base pointer */
 		be_options.omit_fp = 0;
 
-		static ir_entity *mcount = NULL;
 		if (mcount == NULL) {
 			ir_type *tp = new_type_method(0, 0);
 			ident   *id = new_id_from_str("mcount");
@@ -1446,7 +1586,9 @@ static backend_params ia32_backend_params = {
 	12,    /* size of trampoline code */
 	4,     /* alignment of trampoline code */
 	ia32_create_trampoline_fkt,
-	4      /* alignment of stack parameter */
+	4,     /* alignment of stack parameter */
+	4,     /* issue width, as in ia32_machine */
+	16     /* branch mispredict penalty */
 };
 
 /**
@@ -1490,6 +1632,7 @@ static void ia32_init(void)
 	}
 
 	ia32_register_init();
+	ia32_init_reg_names();
 	obstack_init(&opcodes_obst);
 	ia32_create_opcodes(&ia32_irn_ops);
 }
@@ -1500,6 +1643,9 @@ static void ia32_finish(void)
 		free_type(between_type);
 		between_type = NULL;
 	}
+	mcount = NULL;
+	ia32_finish_fpu();
+	ia32_finish_transform();
 	ia32_free_opcodes();
 	obstack_free(&opcodes_obst, NULL);
 }
@@ -1521,6 +1667,8 @@ static ia32_isa_t ia32_isa_template = {
 		2,                        /* power of two stack alignment, 2^2 == 4 */
 		7,                        /* costs for a spill instruction */
 		5,                        /* costs for a reload instruction */
+		&ia32_machine,            /* machine model of the scheduler */
+		true,                     /* binary emitter supports JIT */
 	},
 	NULL,                       /* tv_ents */
 	IA32_FPU_ARCH_X87,          /* FPU architecture */
@@ -1643,6 +1791,7 @@ static void ia32_get_call_abi(ir_type *method_type, be_abi_call_t *abi)
 	/* set abi flags for calls */
 	/* call_flags.try_omit_fp                 not changed: can handle both settings */
 	call_flags.call_has_imm = false;  /* No call immediate, we handle this by ourselves */
+	call_flags.try_tail_calls = true;
 
 	/* set parameter passing style */
 	be_abi_call_set_flags(abi, call_flags, &ia32_abi_callbacks);
@@ -1756,7 +1905,7 @@ static void ia32_lower_for_target(void)
 	 *  on the callframe and we can't just use an arbitrary position on the
 	 *  stackframe)
 	 */
-	lower_calls_with_compounds(LF_RETURN_HIDDEN | LF_DONT_LOWER_ARGUMENTS);
+	lower_calls_with_compounds(LF_RETURN_HIDDEN | LF_DONT_LOWER_ARGUMENTS, NULL);
 
 	/* replace floating point operations by function calls */
 	if (ia32_cg_config.use_softfloat) {
@@ -15,6 +15,7 @@
 #include "lc_opts_enum.h"
 #include "irtools.h"
 #include "ia32_architecture.h"
+#include "be_t.h"
 #include "tv.h"
 
 #undef NATIVE_X86
@@ -46,32 +47,35 @@ typedef enum cpu_arch_features {
 	arch_nocona           = 0x00000040, /**< Nocona architecture */
 	arch_core2            = 0x00000080, /**< Core2 architecture */
 	arch_atom             = 0x00000100, /**< Atom architecture */
+	arch_corei7           = 0x00004000, /**< Core i7 (Nehalem and later) architecture */
 
 	arch_k6               = 0x00000200, /**< k6 architecture */
 	arch_geode            = 0x00000400, /**< Geode architecture */
 	arch_athlon           = 0x00000800, /**< Athlon architecture */
 	arch_k8               = 0x00001000, /**< K8/Opteron architecture */
 	arch_k10              = 0x00002000, /**< K10/Barcelona architecture */
+	arch_zen              = 0x00008000, /**< Zen architecture */
 
-	arch_mask             = 0x00003FFF,
+	arch_mask             = 0x0000FFFF,
 
 	arch_athlon_plus      = arch_athlon | arch_k8 | arch_k10,
-	arch_all_amd          = arch_k6 | arch_geode | arch_athlon_plus,
-
-	arch_feature_mmx      = 0x00004000, /**< MMX instructions */
-	arch_feature_cmov     = 0x00008000, /**< cmov instructions */
-	arch_feature_p6_insn  = 0x00010000, /**< PentiumPro instructions */
-	arch_feature_sse1     = 0x00020000, /**< SSE1 instructions */
-	arch_feature_sse2     = 0x00040000, /**< SSE2 instructions */
-	arch_feature_sse3     = 0x00080000, /**< SSE3 instructions */
-	arch_feature_ssse3    = 0x00100000, /**< SSSE3 instructions */
-	arch_feature_3DNow    = 0x00200000, /**< 3DNow! instructions */
-	arch_feature_3DNowE   = 0x00400000, /**< Enhanced 3DNow! instructions */
-	arch_feature_64bit    = 0x00800000, /**< x86_64 support */
-	arch_feature_sse4_1   = 0x01000000, /**< SSE4.1 instructions */
-	arch_feature_sse4_2   = 0x02000000, /**< SSE4.2 instructions */
-	arch_feature_sse4a    = 0x04000000, /**< SSE4a instructions */
-	arch_feature_popcnt   = 0x08000000, /**< popcnt instruction */
+	arch_all_amd          = arch_k6 | arch_geode | arch_athlon_plus | arch_zen,
+
+	arch_feature_mmx      = 0x00010000, /**< MMX instructions */
+	arch_feature_cmov     = 0x00020000, /**< cmov instructions */
+	arch_feature_p6_insn  = 0x00040000, /**< PentiumPro instructions */
+	arch_feature_sse1     = 0x00080000, /**< SSE1 instructions */
+	arch_feature_sse2     = 0x00100000, /**< SSE2 instructions */
+	arch_feature_sse3     = 0x00200000, /**< SSE3 instructions */
+	arch_feature_ssse3    = 0x00400000, /**< SSSE3 instructions */
+	arch_feature_3DNow    = 0x00800000, /**< 3DNow! instructions */
+	arch_feature_3DNowE   = 0x01000000, /**< Enhanced 3DNow! instructions */
+	arch_feature_64bit    = 0x02000000, /**< x86_64 support */
+	arch_feature_sse4_1   = 0x04000000, /**< SSE4.1 instructions */
+	arch_feature_sse4_2   = 0x08000000, /**< SSE4.2 instructions */
+	arch_feature_sse4a    = 0x10000000, /**< SSE4a instructions */
+	arch_feature_popcnt   = 0x20000000, /**< popcnt instruction */
+	arch_feature_avx2     = 0x40000000, /**< AVX2 level: BMI1, BMI2, lzcnt and FMA3 instructions */
 
 	arch_mmx_insn     = arch_feature_mmx,                         /**< MMX instructions */
 	arch_sse1_insn    = arch_feature_sse1   | arch_mmx_insn,      /**< SSE1 instructions, include MMX */
@@ -107,6 +111,9 @@ typedef enum cpu_arch_features {
 	cpu_penryn              = arch_core2 | arch_feature_cmov | arch_feature_p6_insn | arch_64bit_insn | arch_sse4_1_insn,
 	cpu_atom_generic        = arch_atom | arch_feature_p6_insn,
 	cpu_atom                = arch_atom | arch_feature_cmov | arch_feature_p6_insn | arch_ssse3_insn,
+	cpu_corei7_generic      = arch_corei7 | arch_feature_p6_insn,
+	cpu_corei7              = arch_corei7 | arch_feature_cmov | arch_feature_p6_insn | arch_feature_popcnt | arch_64bit_insn | arch_sse4_2_insn,
+	cpu_haswell             = cpu_corei7 | arch_feature_avx2,
 
 	/* AMD CPUs */
 	cpu_k6_generic     = arch_k6,
@@ -123,6 +130,8 @@ typedef enum cpu_arch_features {
 	cpu_k8_sse3        = arch_k8  | arch_3DNowE_insn | arch_feature_cmov | arch_feature_p6_insn | arch_64bit_insn | arch_sse3_insn,
 	cpu_k10_generic    = arch_k10 | arch_feature_p6_insn,
 	cpu_k10            = arch_k10 | arch_3DNowE_insn | arch_feature_cmov | arch_feature_p6_insn | arch_feature_popcnt | arch_64bit_insn | arch_sse4a_insn,
+	cpu_zen_generic    = arch_zen | arch_feature_p6_insn,
+	cpu_zen            = arch_zen | arch_feature_cmov | arch_feature_p6_insn | arch_feature_popcnt | arch_feature_avx2 | arch_64bit_insn | arch_sse4_2_insn | arch_sse4a_insn,
 
 	/* other CPUs */
 	cpu_winchip_c6  = arch_i486 | arch_feature_mmx,
@@ -177,6 +186,19 @@ static const lc_opt_enum_int_items_t arch_items[] = {
 	{ "core2",        cpu_core2 },
 	{ "penryn",       cpu_penryn },
 	{ "atom",         cpu_atom },
+	{ "nehalem",      cpu_corei7 },
+	{ "corei7",       cpu_corei7 },
+	{ "westmere",     cpu_corei7 },
+	{ "sandybridge",  cpu_corei7 },
+	{ "corei7-avx",   cpu_corei7 },
+	{ "ivybridge",    cpu_corei7 },
+	{ "core-avx-i",   cpu_corei7 },
+	{ "haswell",      cpu_haswell },
+	{ "core-avx2",    cpu_haswell },
+	{ "broadwell",    cpu_haswell },
+	{ "skylake",      cpu_haswell },
+	{ "icelake",      cpu_haswell },
+	{ "alderlake",    cpu_haswell },
 
 	{ "k6",           cpu_k6 },
 	{ "k6-2",         cpu_k6_PLUS },
@@ -196,6 +218,10 @@ static const lc_opt_enum_int_items_t arch_items[] = {
 	{ "k10",          cpu_k10 },
 	{ "barcelona",    cpu_k10 },
 	{ "amdfam10",     cpu_k10 },
+	{ "znver1",       cpu_zen },
+	{ "znver2",       cpu_zen },
+	{ "znver3",       cpu_zen },
+	{ "znver4",       cpu_zen },
 
 	{ "winchip-c6",   cpu_winchip_c6, },
 	{ "winchip2",     cpu_winchip2 },
@@ -252,6 +278,14 @@ static const lc_opt_table_entry_t ia32_architecture_options[] = {
 	LC_OPT_LAST
 };
 
+/* the amd64 backend shares the tuning tables */
+static const lc_opt_table_entry_t amd64_architecture_options[] = {
+	LC_OPT_ENT_BOOL    ("size", "optimize for size",                     &opt_size),
+	LC_OPT_ENT_ENUM_INT("arch", "select the instruction architecture",   &arch_var),
+	LC_OPT_ENT_ENUM_INT("tune", "optimize for instruction architecture", &opt_arch_var),
+	LC_OPT_LAST
+};
+
 typedef struct insn_const {
 	int      add_cost;                 /**< cost of an add instruction */
 	int      lea_cost;                 /**< cost of a lea instruction */
@@ -419,6 +453,30 @@ static const insn_const core2_cost = {
 	10,  /* maximum skip for alignment of loops labels */
 };
 
+/* costs for the Core i7 (Nehalem and later) */
+static const insn_const corei7_cost = {
+	1,   /* cost of an add instruction */
+	1,   /* cost of a lea instruction */
+	1,   /* cost of a constant shift instruction */
+	3,   /* starting cost of a multiply instruction */
+	0,   /* cost of multiply for every set bit */
+	4,   /* logarithm for alignment of function labels */
+	4,   /* logarithm for alignment of loops labels */
+	10,  /* maximum skip for alignment of loops labels */
+};
+
+/* costs for Zen; a lea with scaled index has two cycles latency */
+static const insn_const zen_cost = {
+	1,   /* cost of an add instruction */
+	2,   /* cost of a lea instruction */
+	1,   /* cost of a constant shift instruction */
+	3,   /* starting cost of a multiply instruction */
+	0,   /* cost of multiply for every set bit */
+	4,   /* logarithm for alignment of function labels */
+	4,   /* logarithm for alignment of loops labels */
+	10,  /* maximum skip for alignment of loops labels */
+};
+
 /* costs for the generic32 */
 static const insn_const generic32_cost = {
 	1,   /* cost of an add instruction */
@@ -447,18 +505,24 @@ static void set_arch_costs(void)
 	case arch_netburst:  arch_costs = &netburst_cost;   break;
 	case arch_nocona:    arch_costs = &nocona_cost;     break;
 	case arch_core2:     arch_costs = &core2_cost;      break;
+	case arch_corei7:    arch_costs = &corei7_cost;     break;
 	case arch_k6:        arch_costs = &k6_cost;         break;
 	case arch_geode:     arch_costs = &geode_cost;      break;
 	case arch_athlon:    arch_costs = &athlon_cost;     break;
 	case arch_k8:        arch_costs = &k8_cost;         break;
 	case arch_k10:       arch_costs = &k10_cost;        break;
+	case arch_zen:       arch_costs = &zen_cost;        break;
 	default:
 	case arch_generic32: arch_costs = &generic32_cost;  break;
 	}
 }
 
-/* Evaluate the costs of an instruction. */
-int ia32_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
+/**
+ * Evaluate the costs of an instruction for a machine whose registers have
+ * @p native_bits bits. Wider operations are emulated by several instructions.
+ */
+static int evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv,
+                         unsigned native_bits)
 {
 	int cost;
 
@@ -476,24 +540,23 @@ int ia32_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
 			}
 			free(bitstr);
 		}
-		if (get_mode_size_bits(mode) <= 32)
+		if (get_mode_size_bits(mode) <= native_bits)
 			return cost;
 		/* 64bit mul supported, approx 4times of a 32bit mul*/
 		return 4 * cost;
 	case LEA:
-		/* lea is only supported for 32 bit */
-		if (get_mode_size_bits(mode) <= 32)
+		if (get_mode_size_bits(mode) <= native_bits)
 			return arch_costs->lea_cost;
 		/* in 64bit mode, the Lea cost are at wort 2 shifts and one add */
 		return 2 * arch_costs->add_cost + 2 * (2 * arch_costs->const_shf_cost);
 	case ADD:
 	case SUB:
-		if (get_mode_size_bits(mode) <= 32)
+		if (get_mode_size_bits(mode) <= native_bits)
 			return arch_costs->add_cost;
 		/* 64bit add/sub supported, double the cost */
 		return 2 * arch_costs->add_cost;
 	case SHIFT:
-		if (get_mode_size_bits(mode) <= 32)
+		if (get_mode_size_bits(mode) <= native_bits)
 			return arch_costs->const_shf_cost;
 		/* 64bit shift supported, double the cost */
 		return 2 * arch_costs->const_shf_cost;
@@ -504,6 +567,18 @@ int ia32_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
 	}
 }
 
+/* Evaluate the costs of an instruction. */
+int ia32_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
+{
+	return evaluate_insn(kind, mode, tv, 32);
+}
+
+/* Evaluate the costs of an instruction on amd64. */
+int amd64_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
+{
+	return evaluate_insn(kind, mode, tv, 64);
+}
+
 /* auto detection code only works if we're on an x86 cpu obviously */
 #ifdef NATIVE_X86
 typedef struct x86_cpu_info_t {
@@ -577,6 +652,20 @@ enum {
 	CPUID_FEAT_EDX_PBE       = 1 << 31
 };
 
+enum {
+	CPUID_STRUCT_FEAT_EBX_BMI1 = 1 << 3,
+	CPUID_STRUCT_FEAT_EBX_BMI2 = 1 << 8
+};
+
+enum {
+	CPUID_EXT_FEAT_ECX_LZCNT  = 1 << 5,
+	CPUID_EXT_FEAT_ECX_SSE4A  = 1 << 6,
+
+	CPUID_EXT_FEAT_EDX_LM     = 1 << 29,
+	CPUID_EXT_FEAT_EDX_3DNOWE = 1 << 30,
+	CPUID_EXT_FEAT_EDX_3DNOW  = 1 << 31
+};
+
 static cpu_arch_features auto_detect_Intel(x86_cpu_info_t const *info)
 {
 	cpu_arch_features auto_arch = cpu_generic;
@@ -610,10 +699,20 @@ static cpu_arch_features auto_detect_Intel(x86_cpu_info_t const *info)
 		case 0x15: /* Intel EP80579 */
 		case 0x16: /* Celeron Model 16 */
 		case 0x17: /* Core2 Model 17 */
+		case 0x1D: /* Xeon MP */
 			auto_arch = cpu_core2_generic;
 			break;
+		case 0x1C: /* Atom */
+		case 0x26: /* Atom Lincroft */
+		case 0x27: /* Atom Saltwell */
+		case 0x35: /* Atom Cloverview */
+		case 0x36: /* Atom Cedarview */
+			auto_arch = cpu_atom_generic;
+			break;
 		default:
-			/* unknown */
+			/* Nehalem (0x1A) and everything after it */
+			if (model >= 0x1A)
+				auto_arch = cpu_corei7_generic;
 			break;
 		}
 		break;
@@ -627,15 +726,6 @@ static cpu_arch_features auto_detect_Intel(x86_cpu_info_t const *info)
 		case 0x06: /* Pentium 4 Model 06 */
 			auto_arch = cpu_netburst_generic;
 			break;
-		case 0x1A: /* Core i7 */
-			auto_arch = cpu_core2_generic;
-			break;
-		case 0x1C: /* Atom */
-			auto_arch = cpu_atom_generic;
-			break;
-		case 0x1D: /* Xeon MP */
-			auto_arch = cpu_core2_generic;
-			break;
 		default:
 			/* unknown */
 			break;
@@ -716,6 +806,11 @@ static cpu_arch_features auto_detect_AMD(x86_cpu_info_t const *info)
 	case 0x15: /* AMD Family 15h */
 		auto_arch = cpu_k10_generic;
 		break;
+	case 0x17: /* Zen, Zen+, Zen 2 */
+	case 0x19: /* Zen 3, Zen 4 */
+	case 0x1A: /* Zen 5 */
+		auto_arch = cpu_zen_generic;
+		break;
 	default:
 		/* unknown */
 		break;
@@ -734,6 +829,7 @@ typedef union {
 	int bulk[4];
 } cpuid_registers;
 
+/* all leaves are queried with subleaf 0 */
 static void x86_cpuid(cpuid_registers *regs, unsigned level)
 {
 #if defined(__GNUC__)
@@ -744,21 +840,39 @@ static void x86_cpuid(cpuid_registers *regs, unsigned level)
 		"movl %%ebx, %1\n\t"
 		"popl %%ebx"
 	: "=a" (regs->r.eax), "=r" (regs->r.ebx), "=c" (regs->r.ecx), "=d" (regs->r.edx)
-	: "a" (level)
+	: "a" (level), "c" (0)
 	);
 #	else
 	__asm ("cpuid\n\t"
 	: "=a" (regs->r.eax), "=b" (regs->r.ebx), "=c" (regs->r.ecx), "=d" (regs->r.edx)
-	: "a" (level)
+	: "a" (level), "c" (0)
 	);
 #	endif
 #elif defined(_MSC_VER)
-	__cpuid(regs->bulk, level);
+	__cpuidex(regs->bulk, level, 0);
 #else
 #	error CPUID is missing
 #endif
 }
 
+/* checks whether the operating system saves the AVX state */
+static bool x86_avx_enabled(unsigned ecx_features)
+{
+	if (!(ecx_features & CPUID_FEAT_ECX_OSXSAVE)
+	    || !(ecx_features & CPUID_FEAT_ECX_AVX))
+		return false;
+
+	unsigned xcr0;
+#if defined(__GNUC__)
+	unsigned edx;
+	__asm ("xgetbv" : "=a" (xcr0), "=d" (edx) : "c" (0));
+#elif defined(_MSC_VER)
+	xcr0 = (unsigned)_xgetbv(0);
+#endif
+	/* xmm and ymm state */
+	return (xcr0 & 0x6) == 0x6;
+}
+
 static bool x86_toogle_cpuid(void)
 {
 	unsigned eflags_before = 0;
@@ -813,6 +927,7 @@ static void autodetect_arch(void)
 
 		/* get vendor ID */
 		x86_cpuid(&regs, 0);
+		unsigned const max_level = regs.r.eax;
 		memcpy(&vendorid[0], &regs.r.ebx, 4);
 		memcpy(&vendorid[4], &regs.r.edx, 4);
 		memcpy(&vendorid[8], &regs.r.ecx, 4);
@@ -858,6 +973,32 @@ static void autodetect_arch(void)
 			auto_arch |= arch_feature_sse4_2;
 		if (cpu_info.ecx_features & CPUID_FEAT_ECX_POPCNT)
 			auto_arch |= arch_feature_popcnt;
+
+		/* structured extended feature bits; FMA needs AVX support of the
+		 * operating system */
+		bool has_avx2_level = false;
+		if (max_level >= 7 && (cpu_info.ecx_features & CPUID_FEAT_ECX_FMA)
+		    && x86_avx_enabled(cpu_info.ecx_features)) {
+			x86_cpuid(&regs, 7);
+			has_avx2_level = (regs.r.ebx & CPUID_STRUCT_FEAT_EBX_BMI1)
+			              && (regs.r.ebx & CPUID_STRUCT_FEAT_EBX_BMI2);
+		}
+
+		/* extended feature bits, if the cpu has them */
+		x86_cpuid(&regs, 0x80000000);
+		if (regs.r.eax >= 0x80000001) {
+			x86_cpuid(&regs, 0x80000001);
+			if (has_avx2_level && (regs.r.ecx & CPUID_EXT_FEAT_ECX_LZCNT))
+				auto_arch |= arch_feature_avx2;
+			if (regs.r.edx & CPUID_EXT_FEAT_EDX_LM)
+				auto_arch |= arch_feature_64bit;
+			if (regs.r.edx & CPUID_EXT_FEAT_EDX_3DNOW)
+				auto_arch |= arch_feature_3DNow;
+			if (regs.r.edx & CPUID_EXT_FEAT_EDX_3DNOWE)
+				auto_arch |= arch_feature_3DNowE;
+			if (regs.r.ecx & CPUID_EXT_FEAT_ECX_SSE4A)
+				auto_arch |= arch_feature_sse4a;
+		}
 	}
 
 	arch     = auto_arch;
@@ -889,33 +1030,38 @@ void ia32_setup_cg_config(void)
 	c->optimize_size        = opt_size != 0;
 	/* on newer intel cpus mov, pop is often faster than leave although it has a
 	 * longer opcode */
-	c->use_leave            = flags(opt_arch, arch_i386 | arch_all_amd | arch_core2) || opt_size;
+	c->use_leave            = flags(opt_arch, arch_i386 | arch_all_amd | arch_core2 | arch_corei7) || opt_size;
 	/* P4s don't like inc/decs because they only partially write the flags
-	 * register which produces false dependencies */
-	c->use_incdec           = !flags(opt_arch, arch_netburst | arch_nocona | arch_core2 | arch_geode) || opt_size;
+	 * register which produces false dependencies; the Core line stalls on
+	 * the partial flags merge instead */
+	c->use_incdec           = !flags(opt_arch, arch_netburst | arch_nocona | arch_core2 | arch_corei7 | arch_geode) || opt_size;
 	c->use_softfloat        = (fpu_arch & IA32_FPU_ARCH_SOFTFLOAT) != 0;
 	c->use_sse2             = (fpu_arch & IA32_FPU_ARCH_SSE2) != 0 && flags(arch, arch_feature_sse2);
 	c->use_ffreep           = flags(opt_arch, arch_athlon_plus);
 	c->use_femms            = flags(opt_arch, arch_athlon_plus) && flags(arch, arch_feature_3DNow);
 	c->use_fucomi           = flags(arch, arch_feature_p6_insn);
 	c->use_cmov             = flags(arch, arch_feature_cmov);
-	c->use_modeD_moves      = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_netburst | arch_nocona | arch_core2 | arch_ppro | arch_geode);
-	c->use_add_esp_4        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_netburst | arch_nocona | arch_core2 |             arch_geode)                         && !opt_size;
-	c->use_add_esp_8        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_netburst | arch_nocona | arch_core2 | arch_ppro | arch_geode | arch_i386 | arch_i486) && !opt_size;
-	c->use_sub_esp_4        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_netburst | arch_nocona | arch_core2 | arch_ppro)                                      && !opt_size;
-	c->use_sub_esp_8        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_netburst | arch_nocona | arch_core2 | arch_ppro |              arch_i386 | arch_i486) && !opt_size;
+	c->use_modeD_moves      = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_zen | arch_netburst | arch_nocona | arch_core2 | arch_corei7 | arch_ppro | arch_geode);
+	c->use_add_esp_4        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_zen | arch_netburst | arch_nocona | arch_core2 | arch_corei7 |             arch_geode)                         && !opt_size;
+	c->use_add_esp_8        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_zen | arch_netburst | arch_nocona | arch_core2 | arch_corei7 | arch_ppro | arch_geode | arch_i386 | arch_i486) && !opt_size;
+	c->use_sub_esp_4        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_zen | arch_netburst | arch_nocona | arch_core2 | arch_corei7 | arch_ppro)                                      && !opt_size;
+	c->use_sub_esp_8        = flags(opt_arch, arch_generic32 | arch_athlon_plus | arch_zen | arch_netburst | arch_nocona | arch_core2 | arch_corei7 | arch_ppro |              arch_i386 | arch_i486) && !opt_size;
 	c->use_imul_mem_imm32   = !flags(opt_arch, arch_k8 | arch_k10) || opt_size;
 	c->use_pxor             = flags(opt_arch, arch_netburst);
 	c->use_mov_0            = flags(opt_arch, arch_k6) && !opt_size;
 	c->use_short_sex_eax    = !flags(opt_arch, arch_k6) || opt_size;
 	c->use_pad_return       = flags(opt_arch, arch_athlon_plus) && !opt_size;
-	c->use_bt               = flags(opt_arch, arch_core2 | arch_athlon_plus) || opt_size;
+	c->use_bt               = flags(opt_arch, arch_core2 | arch_corei7 | arch_athlon_plus | arch_zen) || opt_size;
 	c->use_fisttp           = flags(opt_arch & arch, arch_feature_sse3);
 	c->use_sse_prefetch     = flags(arch, (arch_feature_3DNowE | arch_feature_sse1));
 	c->use_3dnow_prefetch   = flags(arch, arch_feature_3DNow);
 	c->use_popcnt           = flags(arch, arch_feature_popcnt);
+	c->use_bmi              = flags(arch, arch_feature_avx2);
+	c->use_fma              = flags(arch, arch_feature_avx2) && be_options.fp_contract;
 	c->use_bswap            = (arch & arch_mask) >= arch_i486;
 	c->use_cmpxchg          = (arch & arch_mask) != arch_i386;
+	/* cmp/test followed by jcc decode as a single uop */
+	c->use_macro_fusion     = flags(opt_arch, arch_core2 | arch_corei7 | arch_zen) && !opt_size;
 	c->optimize_cc          = opt_cc;
 	c->use_unsafe_floatconv = opt_unsafe_floatconv;
 	c->emit_machcode        = emit_machcode;
@@ -932,12 +1078,14 @@ void ia32_setup_cg_config(void)
 
 void ia32_init_architecture(void)
 {
-	lc_opt_entry_t *be_grp, *ia32_grp;
+	lc_opt_entry_t *be_grp, *ia32_grp, *amd64_grp;
 
 	memset(&ia32_cg_config, 0, sizeof(ia32_cg_config));
 
-	be_grp   = lc_opt_get_grp(firm_opt_get_root(), "be");
-	ia32_grp = lc_opt_get_grp(be_grp, "ia32");
+	be_grp    = lc_opt_get_grp(firm_opt_get_root(), "be");
+	ia32_grp  = lc_opt_get_grp(be_grp, "ia32");
+	amd64_grp = lc_opt_get_grp(be_grp, "amd64");
 
 	lc_opt_add_table(ia32_grp, ia32_architecture_options);
+	lc_opt_add_table(amd64_grp, amd64_architecture_options);
 }
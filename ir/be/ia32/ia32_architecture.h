@@ -65,10 +65,16 @@ typedef struct {
 	unsigned use_3dnow_prefetch:1;
 	/** use SSE4.2 or SSE4a popcnt instruction */
 	unsigned use_popcnt:1;
+	/** use BMI1, BMI2, lzcnt and tzcnt instructions */
+	unsigned use_bmi:1;
+	/** fuse floating point multiply and add into FMA3 instructions */
+	unsigned use_fma:1;
 	/** use i486 instructions */
 	unsigned use_bswap:1;
 	/** use cmpxchg */
 	unsigned use_cmpxchg:1;
+	/** schedule cmp/test directly before their jcc for macro fusion */
+	unsigned use_macro_fusion:1;
 	/** optimize calling convention where possible */
 	unsigned optimize_cc:1;
 	/**
@@ -119,4 +125,10 @@ void ia32_setup_cg_config(void);
  */
 int ia32_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv);
 
+/**
+ * Evaluate the costs of an instruction for the amd64 backend, which shares
+ * the tuning tables but has native 64bit instructions.
+ */
+int amd64_evaluate_insn(insn_kind kind, const ir_mode *mode, ir_tarval *tv);
+
 #endif
@@ -27,6 +27,7 @@
  *   pnc_Ne  => P || NE
  */
 #include <limits.h>
+#include <string.h>
 
 #include "xmalloc.h"
 #include "tv.h"
@@ -50,6 +51,8 @@
 #include "beabi.h"
 #include "bedwarf.h"
 #include "beemitter.h"
+#include "beemitter_binary.h"
+#include "bejit.h"
 #include "begnuas.h"
 #include "beutil.h"
 
@@ -74,6 +77,15 @@ static bool              sp_relative;
 static int               frame_type_size;
 static int               callframe_offset;
 
+/** A register name including the '%' prefix. */
+typedef struct reg_name_t {
+	char          str[16];
+	unsigned char len;
+} reg_name_t;
+
+/** the full register names, indexed by the global register index */
+static reg_name_t reg_names[N_IA32_REGISTERS];
+
 /** Return the next block in Block schedule */
 static ir_node *get_prev_block_sched(const ir_node *block)
 {
@@ -180,8 +192,31 @@ static void emit_register(const arch_register_t *reg, const ir_mode *mode)
 		assert(mode_is_float(mode) || size == 32);
 	}
 
-	be_emit_char('%');
-	be_emit_string(reg->name);
+	reg_name_t const *const name = &reg_names[reg->global_index];
+	be_emit_string_len(name->str, name->len);
+}
+
+void ia32_init_reg_names(void)
+{
+	for (size_t i = 0; i < N_IA32_REGISTERS; ++i) {
+		const arch_register_t *reg  = &ia32_registers[i];
+		reg_name_t            *name = &reg_names[reg->global_index];
+		size_t                 len  = strlen(reg->name);
+		assert(len + 1 < sizeof(name->str));
+		name->str[0] = '%';
+		memcpy(name->str + 1, reg->name, len);
+		name->len = (unsigned char)(len + 1);
+	}
+}
+
+/**
+ * Emit an offset with an explicit sign, like printf("%+d").
+ */
+static void emit_offset_signed(int offset)
+{
+	if (offset >= 0)
+		be_emit_char('+');
+	be_emit_int(offset);
 }
 
 static void ia32_emit_entity(ir_entity *entity, int no_pic_adjust)
@@ -213,9 +248,10 @@ static void emit_ia32_Immediate_no_prefix(const ir_node *node)
 	}
 	if (attr->symconst == NULL || attr->offset != 0) {
 		if (attr->symconst != NULL) {
-			be_emit_irprintf("%+d", attr->offset);
+			emit_offset_signed(attr->offset);
 		} else {
-			be_emit_irprintf("0x%X", attr->offset);
+			be_emit_cstring("0x");
+			be_emit_hex((unsigned)attr->offset);
 		}
 	}
 }
@@ -240,7 +276,7 @@ static void ia32_emit_mode_suffix_mode(const ir_mode *mode)
 	panic("Can't output mode_suffix for %+F", mode);
 }
 
-static void ia32_emit_x87_mode_suffix(ir_node const *const node)
+void ia32_emit_x87_mode_suffix(ir_node const *const node)
 {
 	ir_mode *mode;
 
@@ -284,7 +320,7 @@ static char get_xmm_mode_suffix(ir_mode *mode)
 	}
 }
 
-static void ia32_emit_xmm_mode_suffix(ir_node const *const node)
+void ia32_emit_xmm_mode_suffix(ir_node const *const node)
 {
 	ir_mode *mode = get_ia32_ls_mode(node);
 	assert(mode != NULL);
@@ -348,18 +384,6 @@ static void ia32_emit_condition_code(ia32_condition_code_t cc)
 	panic("Invalid ia32 condition code");
 }
 
-typedef enum ia32_emit_mod_t {
-	EMIT_NONE         = 0,
-	EMIT_RESPECT_LS   = 1U << 0,
-	EMIT_ALTERNATE_AM = 1U << 1,
-	EMIT_LONG         = 1U << 2,
-	EMIT_HIGH_REG     = 1U << 3,
-	EMIT_LOW_REG      = 1U << 4,
-	EMIT_16BIT_REG    = 1U << 5,
-	EMIT_SHIFT_COMMA  = 1U << 6,
-} ia32_emit_mod_t;
-ENUM_BITSET(ia32_emit_mod_t)
-
 /**
  * Emits address mode.
  */
@@ -389,9 +413,9 @@ static void ia32_emit_am(ir_node const *const node)
 	/* also handle special case if nothing is set */
 	if (offs != 0 || (ent == NULL && !has_base && !has_index)) {
 		if (ent != NULL) {
-			be_emit_irprintf("%+d", offs);
+			emit_offset_signed(offs);
 		} else {
-			be_emit_irprintf("%d", offs);
+			be_emit_int(offs);
 		}
 	}
 
@@ -413,7 +437,8 @@ static void ia32_emit_am(ir_node const *const node)
 
 			scale = get_ia32_am_scale(node);
 			if (scale > 0) {
-				be_emit_irprintf(",%d", 1 << scale);
+				be_emit_char(',');
+				be_emit_int(1 << scale);
 			}
 		}
 		be_emit_char(')');
@@ -422,6 +447,162 @@ static void ia32_emit_am(ir_node const *const node)
 
 static ia32_condition_code_t determine_final_cc(ir_node const *node, int flags_pos, ia32_condition_code_t cc);
 
+void ia32_emit_register(ir_node const *const node,
+                        arch_register_t const *const reg,
+                        ia32_emit_mod_t const mod)
+{
+	if (mod & EMIT_ALTERNATE_AM)
+		be_emit_char('*');
+	if (mod & EMIT_HIGH_REG) {
+		emit_8bit_register_high(reg);
+	} else if (mod & EMIT_LOW_REG) {
+		emit_8bit_register(reg);
+	} else if (mod & EMIT_16BIT_REG) {
+		emit_16bit_register(reg);
+	} else {
+		emit_register(reg, mod & EMIT_RESPECT_LS ? get_ia32_ls_mode(node) : NULL);
+	}
+	if (mod & EMIT_SHIFT_COMMA) {
+		be_emit_char(',');
+	}
+}
+
+void ia32_emit_immediate_operand(ir_node const *const imm,
+                                 ia32_emit_mod_t const mod)
+{
+	if (mod & EMIT_SHIFT_COMMA) {
+		const ia32_immediate_attr_t *attr = get_ia32_immediate_attr_const(imm);
+		if (attr->symconst == NULL && attr->offset == 1)
+			return;
+	}
+	if (!(mod & EMIT_ALTERNATE_AM))
+		be_emit_char('$');
+	emit_ia32_Immediate_no_prefix(imm);
+	if (mod & EMIT_SHIFT_COMMA) {
+		be_emit_char(',');
+	}
+}
+
+void ia32_emit_source(ir_node const *const node, int const pos,
+                      ia32_emit_mod_t const mod)
+{
+	ir_node const *const op = get_irn_n(node, pos);
+	if (is_ia32_Immediate(op)) {
+		ia32_emit_immediate_operand(op, mod);
+	} else {
+		arch_register_t const *const reg = arch_get_irn_register_in(node, pos);
+		ia32_emit_register(node, reg, mod);
+	}
+}
+
+void ia32_emit_am_operand(ir_node const *const node, ia32_emit_mod_t const mod)
+{
+	if (mod & EMIT_ALTERNATE_AM)
+		be_emit_char('*');
+	ia32_emit_am(node);
+}
+
+void ia32_emit_source_or_am(ir_node const *const node, int const pos,
+                            ia32_emit_mod_t const mod)
+{
+	if (get_ia32_op_type(node) == ia32_Normal) {
+		ia32_emit_source(node, pos, mod);
+	} else {
+		ia32_emit_am_operand(node, mod);
+	}
+}
+
+void ia32_emit_x87_operands(ir_node const *const node,
+                            ia32_emit_mod_t const mod)
+{
+	if (get_ia32_op_type(node) == ia32_Normal) {
+		ia32_x87_attr_t const *const attr = get_ia32_x87_attr_const(node);
+		char            const *const fmt  = attr->res_in_reg ? "%%st, %%%s" : "%%%s, %%st";
+		be_emit_irprintf(fmt, attr->reg->name);
+	} else {
+		ia32_emit_am_operand(node, mod);
+	}
+}
+
+void ia32_emit_binop_operands(ir_node const *const node)
+{
+	ir_node               const *const imm  = get_irn_n(node, n_ia32_binary_right);
+	ir_mode                     *const mode = get_ia32_ls_mode(node);
+	arch_register_t       const *reg;
+	if (is_ia32_Immediate(imm)) {
+		emit_ia32_Immediate(imm);
+		be_emit_cstring(", ");
+		if (get_ia32_op_type(node) != ia32_Normal) {
+			ia32_emit_am(node);
+			return;
+		}
+	} else {
+		if (get_ia32_op_type(node) == ia32_Normal) {
+			reg = arch_get_irn_register_in(node, n_ia32_binary_right);
+			emit_register(reg, mode);
+		} else {
+			ia32_emit_am(node);
+		}
+		be_emit_cstring(", ");
+	}
+	reg = arch_get_irn_register_in(node, n_ia32_binary_left);
+	emit_register(reg, mode);
+}
+
+void ia32_emit_x87_pop_suffix(ir_node const *const node)
+{
+	ia32_x87_attr_t const *const attr = get_ia32_x87_attr_const(node);
+	if (attr->pop)
+		be_emit_char('p');
+}
+
+void ia32_emit_x87_reverse_suffix(ir_node const *const node)
+{
+	/* NOTE: Work around a gas quirk for non-commutative operations if the
+	 * destination register is not %st0.  In this case r/non-r is swapped.
+	 * %st0 = %st0 - %st1 -> fsub  %st1, %st0 (as expected)
+	 * %st0 = %st1 - %st0 -> fsubr %st1, %st0 (as expected)
+	 * %st1 = %st0 - %st1 -> fsub  %st0, %st1 (expected: fsubr)
+	 * %st1 = %st1 - %st0 -> fsubr %st0, %st1 (expected: fsub)
+	 * In fact this corresponds to the encoding of the instruction:
+	 * - The r suffix selects whether %st0 is on the left (no r) or on the
+	 *   right (r) side of the executed operation.
+	 * - The placement of %st0 selects whether the result is written to
+	 *   %st0 (right) or the other register (left).
+	 * This means that it is sufficient to test whether the operands are
+	 * permuted.  In particular it is not necessary to consider wether the
+	 * result is to be placed into the explicit register operand. */
+	if (get_ia32_x87_attr_const(node)->attr.data.ins_permuted)
+		be_emit_char('r');
+}
+
+void ia32_emit_x87_register(ir_node const *const node)
+{
+	be_emit_char('%');
+	be_emit_string(get_ia32_x87_attr_const(node)->reg->name);
+}
+
+void ia32_emit_mode_suffix(ir_node const *const node, ia32_emit_mod_t const mod)
+{
+	ir_mode *mode = get_ia32_ls_mode(node);
+	if (!mode)
+		mode = mode_Iu;
+	if (mod & EMIT_RESPECT_LS) {
+		if (get_mode_size_bits(mode) == 32)
+			return;
+		be_emit_char(mode_is_signed(mode) ? 's' : 'z');
+	}
+	ia32_emit_mode_suffix_mode(mode);
+}
+
+void ia32_emit_node_condition_code(ir_node const *const node,
+                                   int const flags_pos)
+{
+	ia32_condition_code_t cc = get_ia32_condcode(node);
+	cc = determine_final_cc(node, flags_pos, cc);
+	ia32_emit_condition_code(cc);
+}
+
 void ia32_emitf(ir_node const *const node, char const *fmt, ...)
 {
 	va_list ap;
@@ -470,7 +651,7 @@ end_of_mods:
 
 		switch (*fmt++) {
 			arch_register_t const *reg;
-			ir_node         const *imm;
+			unsigned               pos;
 
 			case '%':
 				be_emit_char('%');
@@ -479,37 +660,28 @@ end_of_mods:
 			case 'A': {
 				switch (*fmt++) {
 					case 'F':
-						if (get_ia32_op_type(node) == ia32_Normal) {
-							ia32_x87_attr_t const *const attr = get_ia32_x87_attr_const(node);
-							char            const *const fmt  = attr->res_in_reg ? "%%st, %%%s" : "%%%s, %%st";
-							be_emit_irprintf(fmt, attr->reg->name);
-							break;
-						} else {
-							goto emit_AM;
-						}
+						ia32_emit_x87_operands(node, mod);
+						break;
 
-emit_AM:
 					case 'M':
-						if (mod & EMIT_ALTERNATE_AM)
-							be_emit_char('*');
-						ia32_emit_am(node);
+						ia32_emit_am_operand(node, mod);
 						break;
 
 					case 'R':
 						reg = va_arg(ap, const arch_register_t*);
 						if (get_ia32_op_type(node) == ia32_Normal) {
-							goto emit_R;
+							ia32_emit_register(node, reg, mod);
 						} else {
-							goto emit_AM;
+							ia32_emit_am_operand(node, mod);
 						}
+						break;
 
 					case 'S':
-						if (get_ia32_op_type(node) == ia32_Normal) {
-							goto emit_S;
-						} else {
-							++fmt;
-							goto emit_AM;
-						}
+						if (*fmt < '0' || '9' < *fmt)
+							goto unknown;
+						pos = *fmt++ - '0';
+						ia32_emit_source_or_am(node, pos, mod);
+						break;
 
 					default: goto unknown;
 				}
@@ -517,155 +689,62 @@ emit_AM:
 			}
 
 			case 'B':
-				imm = get_irn_n(node, n_ia32_binary_right);
-				if (is_ia32_Immediate(imm)) {
-					emit_ia32_Immediate(imm);
-					be_emit_cstring(", ");
-					if (get_ia32_op_type(node) == ia32_Normal) {
-						goto destination_operand;
-					} else {
-						ia32_emit_am(node);
-					}
-				} else {
-					if (get_ia32_op_type(node) == ia32_Normal) {
-						reg = arch_get_irn_register_in(node, n_ia32_binary_right);
-						emit_register(reg, get_ia32_ls_mode(node));
-					} else {
-						ia32_emit_am(node);
-					}
-					be_emit_cstring(", ");
-destination_operand:
-					reg = arch_get_irn_register_in(node, n_ia32_binary_left);
-					emit_register(reg, get_ia32_ls_mode(node));
-				}
+				ia32_emit_binop_operands(node);
 				break;
 
 			case 'D':
 				if (*fmt < '0' || '9' < *fmt)
 					goto unknown;
 				reg = arch_get_irn_register_out(node, *fmt++ - '0');
-				goto emit_R;
+				ia32_emit_register(node, reg, mod);
+				break;
 
 			case 'F':
-				if (*fmt == 'M') {
-					ia32_emit_x87_mode_suffix(node);
-				} else if (*fmt == 'P') {
-					ia32_x87_attr_t const *const attr = get_ia32_x87_attr_const(node);
-					if (attr->pop)
-						be_emit_char('p');
-				} else if (*fmt == 'R') {
-					/* NOTE: Work around a gas quirk for non-commutative operations if the
-					 * destination register is not %st0.  In this case r/non-r is swapped.
-					 * %st0 = %st0 - %st1 -> fsub  %st1, %st0 (as expected)
-					 * %st0 = %st1 - %st0 -> fsubr %st1, %st0 (as expected)
-					 * %st1 = %st0 - %st1 -> fsub  %st0, %st1 (expected: fsubr)
-					 * %st1 = %st1 - %st0 -> fsubr %st0, %st1 (expected: fsub)
-					 * In fact this corresponds to the encoding of the instruction:
-					 * - The r suffix selects whether %st0 is on the left (no r) or on the
-					 *   right (r) side of the executed operation.
-					 * - The placement of %st0 selects whether the result is written to
-					 *   %st0 (right) or the other register (left).
-					 * This means that it is sufficient to test whether the operands are
-					 * permuted.  In particular it is not necessary to consider wether the
-					 * result is to be placed into the explicit register operand. */
-					if (get_ia32_x87_attr_const(node)->attr.data.ins_permuted)
-						be_emit_char('r');
-				} else if (*fmt == 'X') {
-					ia32_emit_xmm_mode_suffix(node);
-				} else if (*fmt == '0') {
-					be_emit_char('%');
-					be_emit_string(get_ia32_x87_attr_const(node)->reg->name);
-				} else {
-					goto unknown;
+				switch (*fmt++) {
+				case 'M': ia32_emit_x87_mode_suffix(node);    break;
+				case 'P': ia32_emit_x87_pop_suffix(node);     break;
+				case 'R': ia32_emit_x87_reverse_suffix(node); break;
+				case 'X': ia32_emit_xmm_mode_suffix(node);    break;
+				case '0': ia32_emit_x87_register(node);       break;
+				default:  goto unknown;
 				}
-				++fmt;
 				break;
 
 			case 'I':
-				imm = node;
-emit_I:
-				if (mod & EMIT_SHIFT_COMMA) {
-					const ia32_immediate_attr_t *attr
-						= get_ia32_immediate_attr_const(imm);
-					if (attr->symconst == NULL && attr->offset == 1)
-						break;
-				}
-				if (!(mod & EMIT_ALTERNATE_AM))
-					be_emit_char('$');
-				emit_ia32_Immediate_no_prefix(imm);
-				if (mod & EMIT_SHIFT_COMMA) {
-					be_emit_char(',');
-				}
+				ia32_emit_immediate_operand(node, mod);
 				break;
 
 			case 'L':
 				ia32_emit_cfop_target(node);
 				break;
 
-			case 'M': {
-				ir_mode *mode = get_ia32_ls_mode(node);
-				if (!mode)
-					mode = mode_Iu;
-				if (mod & EMIT_RESPECT_LS) {
-					if (get_mode_size_bits(mode) == 32)
-						break;
-					be_emit_char(mode_is_signed(mode) ? 's' : 'z');
-				}
-				ia32_emit_mode_suffix_mode(mode);
+			case 'M':
+				ia32_emit_mode_suffix(node, mod);
 				break;
-			}
 
-			case 'P': {
-				ia32_condition_code_t cc;
+			case 'P':
 				if (*fmt == 'X') {
 					++fmt;
-					cc = (ia32_condition_code_t)va_arg(ap, int);
+					ia32_condition_code_t const cc = (ia32_condition_code_t)va_arg(ap, int);
+					ia32_emit_condition_code(cc);
 				} else if ('0' <= *fmt && *fmt <= '9') {
-					cc = get_ia32_condcode(node);
-					cc = determine_final_cc(node, *fmt - '0', cc);
-					++fmt;
+					ia32_emit_node_condition_code(node, *fmt++ - '0');
 				} else {
 					goto unknown;
 				}
-				ia32_emit_condition_code(cc);
 				break;
-			}
 
 			case 'R':
 				reg = va_arg(ap, const arch_register_t*);
-emit_R:
-				if (mod & EMIT_ALTERNATE_AM)
-					be_emit_char('*');
-				if (mod & EMIT_HIGH_REG) {
-					emit_8bit_register_high(reg);
-				} else if (mod & EMIT_LOW_REG) {
-					emit_8bit_register(reg);
-				} else if (mod & EMIT_16BIT_REG) {
-					emit_16bit_register(reg);
-				} else {
-					emit_register(reg, mod & EMIT_RESPECT_LS ? get_ia32_ls_mode(node) : NULL);
-				}
-				if (mod & EMIT_SHIFT_COMMA) {
-					be_emit_char(',');
-				}
+				ia32_emit_register(node, reg, mod);
 				break;
 
-emit_S:
-			case 'S': {
-				unsigned pos;
-
+			case 'S':
 				if (*fmt < '0' || '9' < *fmt)
 					goto unknown;
-
 				pos = *fmt++ - '0';
-				imm = get_irn_n(node, pos);
-				if (is_ia32_Immediate(imm)) {
-					goto emit_I;
-				} else {
-					reg = arch_get_irn_register_in(node, pos);
-					goto emit_R;
-				}
-			}
+				ia32_emit_source(node, pos, mod);
+				break;
 
 			case 's': {
 				const char *str = va_arg(ap, const char*);
@@ -676,20 +755,20 @@ emit_S:
 			case 'u':
 				if (mod & EMIT_LONG) {
 					unsigned long num = va_arg(ap, unsigned long);
-					be_emit_irprintf("%lu", num);
+					be_emit_uint(num);
 				} else {
 					unsigned num = va_arg(ap, unsigned);
-					be_emit_irprintf("%u", num);
+					be_emit_uint(num);
 				}
 				break;
 
 			case 'd':
 				if (mod & EMIT_LONG) {
 					long num = va_arg(ap, long);
-					be_emit_irprintf("%ld", num);
+					be_emit_int(num);
 				} else {
 					int num = va_arg(ap, int);
-					be_emit_irprintf("%d", num);
+					be_emit_int(num);
 				}
 				break;
 
@@ -1271,6 +1350,44 @@ static void emit_zero(const ir_node* node, const arch_register_t *reg)
 	ia32_emitf(node, "xorl %R, %R", reg, reg);
 }
 
+/**
+ * Emits an FMA3 instruction. The instruction overwrites one of its operands,
+ * so pick the form whose destination is the result register.
+ */
+static void emit_fma(const ir_node *node, const char *name)
+{
+	const arch_register_t *left   = arch_get_irn_register_in(node, n_ia32_xFmadd_left);
+	const arch_register_t *right  = arch_get_irn_register_in(node, n_ia32_xFmadd_right);
+	const arch_register_t *addend = arch_get_irn_register_in(node, n_ia32_xFmadd_addend);
+	const arch_register_t *out    = arch_get_irn_register_out(node, 0);
+
+	if (out == left) {
+		ia32_emitf(node, "%s213s%FX %R, %R, %R", name, addend, right, left);
+	} else if (out == right) {
+		ia32_emitf(node, "%s213s%FX %R, %R, %R", name, addend, left, right);
+	} else if (out == addend) {
+		ia32_emitf(node, "%s231s%FX %R, %R, %R", name, right, left, addend);
+	} else {
+		ia32_emitf(node, "movaps %R, %R", left, out);
+		ia32_emitf(node, "%s213s%FX %R, %R, %R", name, addend, right, out);
+	}
+}
+
+static void emit_ia32_xFmadd(const ir_node *node)
+{
+	emit_fma(node, "vfmadd");
+}
+
+static void emit_ia32_xFmsub(const ir_node *node)
+{
+	emit_fma(node, "vfmsub");
+}
+
+static void emit_ia32_xFnmadd(const ir_node *node)
+{
+	emit_fma(node, "vfnmadd");
+}
+
 static void emit_ia32_Minus64(const ir_node *node)
 {
 	const arch_register_t *in_lo  = arch_get_irn_register_in(node, 0);
@@ -1351,9 +1468,15 @@ static void emit_ia32_ClimbFrame(const ir_node *node)
 
 static void emit_be_Return(const ir_node *node)
 {
-	unsigned pop = be_Return_get_pop(node);
+	unsigned   pop    = be_Return_get_pop(node);
+	ir_entity *callee = be_Return_get_tail_call(node);
 
-	if (pop > 0 || be_Return_get_emit_pop(node)) {
+	if (callee != NULL) {
+		assert(pop == 0);
+		be_emit_cstring("\tjmp ");
+		be_gas_emit_entity(callee);
+		be_emit_finish_line_gas(node);
+	} else if (pop > 0 || be_Return_get_emit_pop(node)) {
 		ia32_emitf(node, "ret $%u", pop);
 	} else {
 		ia32_emitf(node, "ret");
@@ -1395,6 +1518,9 @@ static void ia32_register_emitters(void)
 	IA32_EMIT(SwitchJmp);
 	IA32_EMIT(ClimbFrame);
 	IA32_EMIT(Jmp);
+	IA32_EMIT(xFmadd);
+	IA32_EMIT(xFmsub);
+	IA32_EMIT(xFnmadd);
 
 	/* benode emitter */
 	BE_EMIT(Copy);
@@ -1541,7 +1667,9 @@ static void ia32_emit_block_header(ir_node *block)
 	if (block == get_irg_end_block(irg))
 		return;
 
-	if (ia32_cg_config.label_alignment > 0) {
+	/* the cold fragment starts a section of its own */
+	if (ia32_cg_config.label_alignment > 0
+	    && block != be_birg_from_irg(irg)->cold_block) {
 		/* align the current block if:
 		 * a) if should be aligned due to its execution frequency
 		 * b) there is no fall-through here
@@ -1591,7 +1719,7 @@ static void ia32_gen_block(ir_node *block)
 
 	/* emit the contents of the block */
 	be_dwarf_location(get_irn_dbg_info(block));
-	sched_foreach(block, node) {
+	sched_foreach_frozen(block, node) {
 		ia32_emit_node(node);
 	}
 }
@@ -1714,11 +1842,13 @@ void ia32_emit_function(ir_graph *irg)
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
 	irg_block_walk_graph(irg, ia32_gen_labels, NULL, &exc_list);
 
-	/* initialize next block links */
+	/* initialize next block links, nothing falls through into the cold
+	 * fragment */
+	ir_node *cold_block = be_birg_from_irg(irg)->cold_block;
 	n = ARR_LEN(blk_sched);
 	for (i = 0; i < n; ++i) {
 		ir_node *block = blk_sched[i];
-		ir_node *prev  = i > 0 ? blk_sched[i-1] : NULL;
+		ir_node *prev  = i > 0 && block != cold_block ? blk_sched[i-1] : NULL;
 
 		set_irn_link(block, prev);
 	}
@@ -1791,27 +1921,25 @@ enum Mod {
 
 /* Node: The following routines are supposed to append bytes, words, dwords
    to the output stream.
-   Currently the implementation is stupid in that it still creates output
-   for an "assembler" in the form of .byte, .long
-   We will change this when enough infrastructure is there to create complete
-   machine code in memory/object files */
+   Plain machine code is collected by the binary emitter and written as
+   .byte directives, references to entities and blocks still go through the
+   assembler in the form of .long expressions.
+   When JIT compiling the machine code is written to memory and references
+   are recorded as relocations instead. */
 
 static void bemit8(const unsigned char byte)
 {
-	be_emit_irprintf("\t.byte 0x%x\n", byte);
-	be_emit_write_line();
+	be_emit_code_byte(byte);
 }
 
 static void bemit16(const unsigned short u16)
 {
-	be_emit_irprintf("\t.word 0x%x\n", u16);
-	be_emit_write_line();
+	be_emit_code16(u16);
 }
 
 static void bemit32(const unsigned u32)
 {
-	be_emit_irprintf("\t.long 0x%x\n", u32);
-	be_emit_write_line();
+	be_emit_code32(u32);
 }
 
 /**
@@ -1826,8 +1954,16 @@ static void bemit_entity(ir_entity *entity, bool entity_sign, int offset,
 		return;
 	}
 
+	if (be_jit_active()) {
+		if (get_entity_owner(entity) == get_tls_type())
+			panic("TLS is not supported by the JIT");
+		be_emit_entity(entity, entity_sign, offset, is_relative);
+		return;
+	}
+
 	/* the final version should remember the position in the bytestream
 	   and patch it with the correct address at linktime... */
+	be_flush_code_bytes();
 	be_emit_cstring("\t.long ");
 	if (entity_sign)
 		be_emit_char('-');
@@ -1855,6 +1991,12 @@ static void bemit_entity(ir_entity *entity, bool entity_sign, int offset,
 
 static void bemit_jmp_destination(const ir_node *dest_block)
 {
+	if (be_jit_active()) {
+		be_jit_emit_block(dest_block, true);
+		return;
+	}
+
+	be_flush_code_bytes();
 	be_emit_cstring("\t.long ");
 	be_gas_emit_block_name(dest_block);
 	be_emit_cstring(" - . - 4\n");
@@ -2955,8 +3097,9 @@ static void bemit_switchjmp(const ir_node *node)
 	const ir_switch_table *table      = get_ia32_switch_table(node);
 
 	bemit8(0xFF); // jmp *tbl.label(,%in,4)
-	bemit_mod_am(0x05, node);
+	bemit_mod_am(0x04, node);
 
+	be_flush_code_bytes();
 	be_emit_jump_table(node, table, jump_table, get_cfop_target_block);
 }
 
@@ -2965,8 +3108,14 @@ static void bemit_switchjmp(const ir_node *node)
  */
 static void bemit_return(const ir_node *node)
 {
-	unsigned pop = be_Return_get_pop(node);
-	if (pop > 0 || be_Return_get_emit_pop(node)) {
+	unsigned   pop    = be_Return_get_pop(node);
+	ir_entity *callee = be_Return_get_tail_call(node);
+	if (callee != NULL) {
+		assert(pop == 0);
+		/* jmp rel32 */
+		bemit8(0xE9);
+		bemit_entity(callee, false, 0, true);
+	} else if (pop > 0 || be_Return_get_emit_pop(node)) {
 		bemit8(0xC2);
 		assert(pop <= 0xffff);
 		bemit16(pop);
@@ -3288,6 +3437,7 @@ static void ia32_register_binary_emitters(void)
 	/* benode emitter */
 	be_set_emitter(op_be_Copy,            bemit_copy);
 	be_set_emitter(op_be_CopyKeep,        bemit_copy);
+	be_set_emitter(op_ia32_CopyEbpEsp,    bemit_copy);
 	be_set_emitter(op_be_IncSP,           bemit_incsp);
 	be_set_emitter(op_be_Perm,            bemit_perm);
 	be_set_emitter(op_be_Return,          bemit_return);
@@ -3401,12 +3551,17 @@ static void ia32_register_binary_emitters(void)
 
 static void gen_binary_block(ir_node *block)
 {
-	ia32_emit_block_header(block);
+	if (be_jit_active()) {
+		be_jit_begin_block(block);
+	} else {
+		ia32_emit_block_header(block);
+	}
 
 	/* emit the contents of the block */
-	sched_foreach(block, node) {
+	sched_foreach_frozen(block, node) {
 		ia32_emit_node(node);
 	}
+	be_flush_code_bytes();
 }
 
 void ia32_emit_function_binary(ir_graph *irg)
@@ -3422,20 +3577,27 @@ void ia32_emit_function_binary(ir_graph *irg)
 
 	ia32_register_binary_emitters();
 
-	infos = construct_parameter_infos(irg);
-	be_gas_emit_function_prolog(entity, ia32_cg_config.function_alignment,
-	                            NULL);
-	free(infos);
+	bool const jit = be_jit_active();
+	if (jit) {
+		be_jit_begin_function(entity, 1u << ia32_cg_config.function_alignment);
+	} else {
+		infos = construct_parameter_infos(irg);
+		be_gas_emit_function_prolog(entity, ia32_cg_config.function_alignment,
+		                            NULL);
+		free(infos);
+	}
 
 	/* we use links to point to target blocks */
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
 	irg_block_walk_graph(irg, ia32_gen_labels, NULL, NULL);
 
-	/* initialize next block links */
+	/* initialize next block links, nothing falls through into the cold
+	 * fragment */
+	ir_node *cold_block = be_birg_from_irg(irg)->cold_block;
 	n = ARR_LEN(blk_sched);
 	for (i = 0; i < n; ++i) {
 		ir_node *block = blk_sched[i];
-		ir_node *prev  = i > 0 ? blk_sched[i-1] : NULL;
+		ir_node *prev  = i > 0 && block != cold_block ? blk_sched[i-1] : NULL;
 
 		set_irn_link(block, prev);
 	}
@@ -3445,7 +3607,11 @@ void ia32_emit_function_binary(ir_graph *irg)
 		gen_binary_block(block);
 	}
 
-	be_gas_emit_function_epilog(entity);
+	if (jit) {
+		be_jit_end_function();
+	} else {
+		be_gas_emit_function_epilog(entity);
+	}
 
 	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
 }
@@ -50,9 +50,48 @@
  */
 void ia32_emitf(ir_node const *node, char const *fmt, ...);
 
+typedef enum ia32_emit_mod_t {
+	EMIT_NONE         = 0,
+	EMIT_RESPECT_LS   = 1U << 0,
+	EMIT_ALTERNATE_AM = 1U << 1,
+	EMIT_LONG         = 1U << 2,
+	EMIT_HIGH_REG     = 1U << 3,
+	EMIT_LOW_REG      = 1U << 4,
+	EMIT_16BIT_REG    = 1U << 5,
+	EMIT_SHIFT_COMMA  = 1U << 6,
+} ia32_emit_mod_t;
+ENUM_BITSET(ia32_emit_mod_t)
+
+/*
+ * Emitters for single format conversions, used by ia32_emitf() and the
+ * emitters generated from the node specification.
+ */
+void ia32_emit_register(ir_node const *node, arch_register_t const *reg,
+                        ia32_emit_mod_t mod);
+void ia32_emit_immediate_operand(ir_node const *imm, ia32_emit_mod_t mod);
+void ia32_emit_source(ir_node const *node, int pos, ia32_emit_mod_t mod);
+void ia32_emit_am_operand(ir_node const *node, ia32_emit_mod_t mod);
+void ia32_emit_source_or_am(ir_node const *node, int pos,
+                            ia32_emit_mod_t mod);
+void ia32_emit_x87_operands(ir_node const *node, ia32_emit_mod_t mod);
+void ia32_emit_binop_operands(ir_node const *node);
+void ia32_emit_x87_mode_suffix(ir_node const *node);
+void ia32_emit_x87_pop_suffix(ir_node const *node);
+void ia32_emit_x87_reverse_suffix(ir_node const *node);
+void ia32_emit_x87_register(ir_node const *node);
+void ia32_emit_xmm_mode_suffix(ir_node const *node);
+void ia32_emit_mode_suffix(ir_node const *node, ia32_emit_mod_t mod);
+void ia32_emit_node_condition_code(ir_node const *node, int flags_pos);
+
 void ia32_emit_function(ir_graph *irg);
 void ia32_emit_function_binary(ir_graph *irg);
 
 /** Initializes the Emitter. */
 void ia32_init_emitter(void);
+
+/**
+ * Initializes the assembler names of the registers. Called when the ia32
+ * backend is selected.
+ */
+void ia32_init_reg_names(void);
 #endif
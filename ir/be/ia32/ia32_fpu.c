@@ -21,6 +21,8 @@
 
 #include "ircons.h"
 #include "irgwalk.h"
+#include "irnodehashmap.h"
+#include "execfreq.h"
 #include "tv.h"
 #include "array.h"
 
@@ -36,6 +38,12 @@
 static ir_entity *fpcw_round    = NULL;
 static ir_entity *fpcw_truncate = NULL;
 
+typedef struct fpu_mode_env_t {
+	/** maps a control word state to the memory of its truncating variant
+	 * which has been stored right after the state was defined */
+	ir_nodehashmap_t truncate_words;
+} fpu_mode_env_t;
+
 static ir_entity *create_ent(int value, const char *name)
 {
 	ir_mode   *mode = mode_Hu;
@@ -63,8 +71,8 @@ static ir_entity *create_ent(int value, const char *name)
 
 static void create_fpcw_entities(void)
 {
-	fpcw_round    = create_ent(0xc7f, "_fpcw_round");
-	fpcw_truncate = create_ent(0x37f, "_fpcw_truncate");
+	fpcw_round    = create_ent(0x37f, "_fpcw_round");
+	fpcw_truncate = create_ent(0xf7f, "_fpcw_truncate");
 }
 
 static ir_node *create_fpu_mode_spill(void *env, ir_node *state, int force,
@@ -77,7 +85,7 @@ static ir_node *create_fpu_mode_spill(void *env, ir_node *state, int force,
 		ir_node *block = get_nodes_block(state);
 		if (force == 1 || !is_ia32_ChangeCW(state)) {
 			ir_node *spill = new_bd_ia32_FnstCWNOP(NULL, block, state);
-			sched_add_after(after, spill);
+			sched_add_after(skip_Proj(after), spill);
 			return spill;
 		}
 		return NULL;
@@ -114,27 +122,109 @@ static ir_node *create_fldcw_ent(ir_node *block, ir_entity *entity)
 	set_ia32_op_type(reload, ia32_AddrModeS);
 	set_ia32_ls_mode(reload, ia32_reg_classes[CLASS_ia32_fp_cw].mode);
 	set_ia32_am_sc(reload, entity);
-	set_ia32_use_frame(reload);
 	arch_set_irn_register(reload, &ia32_registers[REG_FPCW]);
 
 	return reload;
 }
 
-static ir_node *create_fpu_mode_reload(void *env, ir_node *state,
-                                       ir_node *spill, ir_node *before,
-                                       ir_node *last_state)
+/**
+ * Stores a copy of the control word @p state with the rounding mode set to
+ * truncation to the frame, inserted into @p block before @p before.
+ *
+ * @return the memory of the store
+ */
+static ir_node *create_truncate_word(ir_node *block, ir_node *state,
+                                     ir_node *before)
 {
 	ir_graph *irg    = get_irn_irg(state);
-	ir_node  *block  = get_nodes_block(before);
 	ir_node  *frame  = get_irg_frame(irg);
 	ir_node  *noreg  = ia32_new_NoReg_gp(irg);
-	ir_node  *reload = NULL;
-	(void) env;
+	ir_node  *nomem  = get_irg_no_mem(irg);
+	ir_mode  *lsmode = ia32_reg_classes[CLASS_ia32_fp_cw].mode;
+
+	ir_node *cwstore = new_bd_ia32_FnstCW(NULL, block, frame, noreg, nomem,
+	                                      state);
+	set_ia32_op_type(cwstore, ia32_AddrModeD);
+	set_ia32_ls_mode(cwstore, lsmode);
+	set_ia32_use_frame(cwstore);
+	sched_add_before(before, cwstore);
+
+	ir_node *load = new_bd_ia32_Load(NULL, block, frame, noreg, cwstore);
+	set_ia32_op_type(load, ia32_AddrModeS);
+	set_ia32_ls_mode(load, lsmode);
+	set_ia32_use_frame(load);
+	sched_add_before(before, load);
+
+	ir_node *load_res = new_r_Proj(load, mode_Iu, pn_ia32_Load_res);
+
+	/* TODO: make the actual mode configurable in ChangeCW... */
+	ir_node *or_const = new_bd_ia32_Immediate(NULL, get_irg_start_block(irg),
+	                                          NULL, 0, 0, 3072);
+	arch_set_irn_register(or_const, &ia32_registers[REG_GP_NOREG]);
+	ir_node *orn = new_bd_ia32_Or(NULL, block, noreg, noreg, nomem, load_res,
+	                              or_const);
+	sched_add_before(before, orn);
+
+	ir_node *store = new_bd_ia32_Store(NULL, block, frame, noreg, nomem, orn);
+	set_ia32_op_type(store, ia32_AddrModeD);
+	/* use mode_Iu, as movl has a shorter opcode than movw */
+	set_ia32_ls_mode(store, mode_Iu);
+	set_ia32_use_frame(store);
+	sched_add_before(before, store);
+
+	return new_r_Proj(store, mode_M, pn_ia32_Store_M);
+}
+
+/**
+ * Returns the memory of a truncating copy of the control word @p state
+ * usable by a switch before @p before.
+ *
+ * The copy is computed once right after @p state is defined if that point is
+ * executed at most as often as the switch. All later switches away from
+ * @p state share it then, so switches in loops are a single fldcw and the
+ * control word computation is hoisted out of the loop.
+ */
+static ir_node *get_truncate_word(fpu_mode_env_t *env, ir_node *state,
+                                  ir_node *before)
+{
+	ir_node *mem = ir_nodehashmap_get(ir_node, &env->truncate_words, state);
+	if (mem != NULL)
+		return mem;
+
+	/* the control word in a Phi is not necessarily the current state at the
+	 * start of its block */
+	ir_node *def       = skip_Proj(state);
+	ir_node *def_block = get_nodes_block(def);
+	ir_node *block     = get_nodes_block(before);
+	if (is_Phi(def) || !sched_is_scheduled(def)
+	    || get_block_execfreq(def_block) > get_block_execfreq(block))
+		return create_truncate_word(block, state, before);
+
+	ir_node *after = def;
+	while (be_is_Keep(sched_next(after)))
+		after = sched_next(after);
+	mem = create_truncate_word(def_block, state, sched_next(after));
+	ir_nodehashmap_insert(&env->truncate_words, state, mem);
+	return mem;
+}
+
+static ir_node *create_fpu_mode_reload(void *data, ir_node *state,
+                                       ir_node *spill, ir_node *before,
+                                       ir_node *last_state)
+{
+	fpu_mode_env_t *env    = (fpu_mode_env_t*)data;
+	ir_graph       *irg    = get_irn_irg(state);
+	ir_node        *block  = get_nodes_block(before);
+	ir_node        *frame  = get_irg_frame(irg);
+	ir_node        *noreg  = ia32_new_NoReg_gp(irg);
+	ir_mode        *lsmode = ia32_reg_classes[CLASS_ia32_fp_cw].mode;
+	ir_node        *mem;
 
 	if (ia32_cg_config.use_unsafe_floatconv) {
 		if (fpcw_round == NULL) {
 			create_fpcw_entities();
 		}
+		ir_node *reload;
 		if (spill != NULL) {
 			reload = create_fldcw_ent(block, fpcw_round);
 		} else {
@@ -145,62 +235,19 @@ static ir_node *create_fpu_mode_reload(void *env, ir_node *state,
 	}
 
 	if (spill != NULL) {
-		reload = new_bd_ia32_FldCW(NULL, block, frame, noreg, spill);
-		set_ia32_op_type(reload, ia32_AddrModeS);
-		set_ia32_ls_mode(reload, ia32_reg_classes[CLASS_ia32_fp_cw].mode);
-		set_ia32_use_frame(reload);
-		arch_set_irn_register(reload, &ia32_registers[REG_FPCW]);
-
-		sched_add_before(before, reload);
+		mem = spill;
 	} else {
-		ir_mode *lsmode = ia32_reg_classes[CLASS_ia32_fp_cw].mode;
-		ir_node *nomem  = get_irg_no_mem(irg);
-		ir_node *cwstore, *load, *load_res, *orn, *store, *fldcw;
-		ir_node *store_proj;
-		ir_node *or_const;
-
 		assert(last_state != NULL);
-		cwstore = new_bd_ia32_FnstCW(NULL, block, frame, noreg, nomem,
-		                             last_state);
-		set_ia32_op_type(cwstore, ia32_AddrModeD);
-		set_ia32_ls_mode(cwstore, lsmode);
-		set_ia32_use_frame(cwstore);
-		sched_add_before(before, cwstore);
-
-		load = new_bd_ia32_Load(NULL, block, frame, noreg, cwstore);
-		set_ia32_op_type(load, ia32_AddrModeS);
-		set_ia32_ls_mode(load, lsmode);
-		set_ia32_use_frame(load);
-		sched_add_before(before, load);
-
-		load_res = new_r_Proj(load, mode_Iu, pn_ia32_Load_res);
-
-		/* TODO: make the actual mode configurable in ChangeCW... */
-		or_const = new_bd_ia32_Immediate(NULL, get_irg_start_block(irg),
-		                                 NULL, 0, 0, 3072);
-		arch_set_irn_register(or_const, &ia32_registers[REG_GP_NOREG]);
-		orn = new_bd_ia32_Or(NULL, block, noreg, noreg, nomem, load_res,
-		                    or_const);
-		sched_add_before(before, orn);
-
-		store = new_bd_ia32_Store(NULL, block, frame, noreg, nomem, orn);
-		set_ia32_op_type(store, ia32_AddrModeD);
-		/* use mode_Iu, as movl has a shorter opcode than movw */
-		set_ia32_ls_mode(store, mode_Iu);
-		set_ia32_use_frame(store);
-		store_proj = new_r_Proj(store, mode_M, pn_ia32_Store_M);
-		sched_add_before(before, store);
-
-		fldcw = new_bd_ia32_FldCW(NULL, block, frame, noreg, store_proj);
-		set_ia32_op_type(fldcw, ia32_AddrModeS);
-		set_ia32_ls_mode(fldcw, lsmode);
-		set_ia32_use_frame(fldcw);
-		arch_set_irn_register(fldcw, &ia32_registers[REG_FPCW]);
-		sched_add_before(before, fldcw);
-
-		reload = fldcw;
+		mem = get_truncate_word(env, last_state, before);
 	}
 
+	ir_node *reload = new_bd_ia32_FldCW(NULL, block, frame, noreg, mem);
+	set_ia32_op_type(reload, ia32_AddrModeS);
+	set_ia32_ls_mode(reload, lsmode);
+	set_ia32_use_frame(reload);
+	arch_set_irn_register(reload, &ia32_registers[REG_FPCW]);
+	sched_add_before(before, reload);
+
 	return reload;
 }
 
@@ -281,6 +328,15 @@ void ia32_setup_fpu_mode(ir_graph *irg)
 	rewire_fpu_mode_nodes(irg);
 
 	/* ensure correct fpu mode for operations */
+	fpu_mode_env_t env;
+	ir_nodehashmap_init(&env.truncate_words);
 	be_assure_state(irg, &ia32_registers[REG_FPCW],
-	                NULL, create_fpu_mode_spill, create_fpu_mode_reload);
+	                &env, create_fpu_mode_spill, create_fpu_mode_reload);
+	ir_nodehashmap_destroy(&env.truncate_words);
+}
+
+void ia32_finish_fpu(void)
+{
+	fpcw_round    = NULL;
+	fpcw_truncate = NULL;
 }
@@ -18,4 +18,9 @@
  */
 void ia32_setup_fpu_mode(ir_graph *irg);
 
+/**
+ * Forget the control word entities, they belong to the current program.
+ */
+void ia32_finish_fpu(void);
+
 #endif
@@ -303,7 +303,8 @@ void ia32_lower64(void)
 		1,  /* little endian */
 		64, /* doubleword size */
 		ia32_create_intrinsic_fkt,
-		NULL
+		NULL,
+		be_get_backend_param()->allow_ifconv
 	};
 
 	ir_prepare_dw_lowering(&lower_dw_params);
@@ -648,6 +648,17 @@ unsigned get_ia32_latency(const ir_node *node)
 	return op_attr->latency;
 }
 
+/**
+ * Gets the execution port class of the instruction.
+ */
+ia32_port_class_t get_ia32_port_class(const ir_node *node)
+{
+	assert(is_ia32_irn(node));
+	const ir_op *op               = get_irn_op(node);
+	const ia32_op_attr_t *op_attr = (ia32_op_attr_t*) get_op_attr(op);
+	return op_attr->port_class;
+}
+
 const ir_switch_table *get_ia32_switch_table(const ir_node *node)
 {
 	const ia32_switch_attr_t *attr = get_ia32_switch_attr_const(node);
@@ -1059,10 +1070,12 @@ static void ia32_copy_attr(ir_graph *irg, const ir_node *old_node,
 	new_info->flags = old_info->flags;
 }
 
-static void ia32_init_op(ir_op *op, unsigned latency)
+static void ia32_init_op(ir_op *op, unsigned latency,
+                         ia32_port_class_t port_class)
 {
 	ia32_op_attr_t *attr = OALLOCZ(&opcodes_obst, ia32_op_attr_t);
-	attr->latency = latency;
+	attr->latency    = latency;
+	attr->port_class = port_class;
 	set_op_attr(op, attr);
 }
 
@@ -246,6 +246,11 @@ unsigned get_ia32_copyb_size(const ir_node *node);
  */
 unsigned get_ia32_latency(const ir_node *node);
 
+/**
+ * Get the execution port class of an instruction.
+ */
+ia32_port_class_t get_ia32_port_class(const ir_node *node);
+
 /**
  * Get the exception label attribute.
  */
@@ -134,10 +134,30 @@ typedef enum {
 } match_flags_t;
 ENUM_BITSET(match_flags_t)
 
+/** The execution ports an instruction may use, see ia32_get_timing(). */
+typedef enum ia32_port_class_t {
+	ia32_pc_none,      /**< needs no execution port */
+	ia32_pc_alu,       /**< simple integer operations */
+	ia32_pc_shift,     /**< shifts, rotates and flag consumers */
+	ia32_pc_lea,       /**< address computations */
+	ia32_pc_mul,       /**< integer multiplication and bit scans */
+	ia32_pc_div,       /**< integer division */
+	ia32_pc_branch,    /**< control flow */
+	ia32_pc_load,      /**< memory loads */
+	ia32_pc_store,     /**< memory stores */
+	ia32_pc_vec_add,   /**< SSE additions, comparisons and conversions */
+	ia32_pc_vec_mul,   /**< SSE multiplication */
+	ia32_pc_vec_div,   /**< SSE division */
+	ia32_pc_vec_logic, /**< SSE logic and shifts */
+	ia32_pc_x87,       /**< x87 arithmetic */
+	ia32_pc_x87_div,   /**< x87 division */
+} ia32_port_class_t;
+
 typedef struct ia32_op_attr_t ia32_op_attr_t;
 struct ia32_op_attr_t {
 	//match_flags_t  flags;
-	unsigned       latency;
+	unsigned          latency;
+	ia32_port_class_t port_class;
 };
 
 #ifndef NDEBUG
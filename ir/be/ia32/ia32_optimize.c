@@ -1071,6 +1071,35 @@ static void register_peephole_optimization(ir_op *op, peephole_opt_func func)
 }
 
 /* Perform peephole-optimizations. */
+/**
+ * Moves the Cmp/Test producing the flags of a Jcc directly in front of it, so
+ * the processor can fuse both into a single uop.
+ */
+static void place_flags_before_jcc(ir_node *const block, void *const env)
+{
+	ir_heights_t *const heights = (ir_heights_t*)env;
+
+	ir_node *const jcc = sched_last(block);
+	if (!is_ia32_Jcc(jcc))
+		return;
+
+	ir_node *const flags = skip_Proj(get_irn_n(jcc, n_ia32_Jcc_eflags));
+	if (!is_ia32_Cmp(flags) && !is_ia32_Test(flags))
+		return;
+	/* only register operands, memory operands would have to be checked
+	 * against the stores in between */
+	if (get_nodes_block(flags) != block || get_ia32_op_type(flags) != ia32_Normal)
+		return;
+	if (sched_next(flags) == jcc)
+		return;
+	if (!be_can_move_down(heights, flags, jcc))
+		return;
+
+	DB((dbg, LEVEL_1, "move %+F before %+F for macro fusion\n", flags, jcc));
+	sched_remove(flags);
+	sched_add_before(jcc, flags);
+}
+
 void ia32_peephole_optimization(ir_graph *irg)
 {
 	/* we currently do it in 2 passes because:
@@ -1096,6 +1125,12 @@ void ia32_peephole_optimization(ir_graph *irg)
 	register_peephole_optimization(op_ia32_Test,  peephole_ia32_Test);
 	register_peephole_optimization(op_be_Return,  peephole_ia32_Return);
 	be_peephole_opt(irg);
+
+	if (ia32_cg_config.use_macro_fusion) {
+		ir_heights_t *const heights = heights_new(irg);
+		irg_block_walk_graph(irg, NULL, place_flags_before_jcc, heights);
+		heights_free(heights);
+	}
 }
 
 /**
@@ -18,9 +18,17 @@
 #include "entity_t.h"
 #include "ident_t.h"
 #include "ircons_t.h"
+#include "irdom.h"
 #include "irgwalk.h"
+#include "irloop.h"
 #include "irnode_t.h"
 
+typedef struct pic_env_t {
+	be_main_env_t *be;
+	ir_node       *start_block;
+	pmap          *got_loads; /**< the shared GOT load of each entity */
+} pic_env_t;
+
 /**
  * Create a trampoline entity for the given method.
  */
@@ -81,15 +89,90 @@ static ir_entity *get_pic_symbol(be_main_env_t *env, ir_entity *entity)
  */
 static int can_address_relative(ir_entity *entity)
 {
-	return entity_has_definition(entity) && !(get_entity_linkage(entity) & IR_LINKAGE_MERGE);
+	if (!entity_has_definition(entity))
+		return false;
+	/* the linker cannot replace a definition other units do not see, even
+	 * if it may be merged */
+	if (get_entity_visibility(entity) != ir_visibility_external)
+		return !(get_entity_linkage(entity) & IR_LINKAGE_WEAK);
+	return !(get_entity_linkage(entity) & IR_LINKAGE_MERGE);
+}
+
+/**
+ * Returns the block in which the operand pos of node is used.
+ */
+static ir_node *get_use_block(ir_node *node, int pos)
+{
+	if (is_Phi(node))
+		return get_Block_cfgpred_block(get_nodes_block(node), pos);
+	return get_nodes_block(node);
+}
+
+/**
+ * Returns the result of the GOT load of the pic symbol of entity. All uses
+ * share one load, its block is the common dominator of the uses so far.
+ */
+static ir_node *get_got_load(pic_env_t *env, ir_entity *entity, ir_mode *mode,
+                             dbg_info *dbgi, ir_node *use_block)
+{
+	/* uses in unreachable code have no dominator */
+	if (use_block != env->start_block && get_Block_idom(use_block) == NULL)
+		use_block = env->start_block;
+
+	ir_node *res = pmap_get(ir_node, env->got_loads, entity);
+	if (res != NULL && get_irn_mode(res) == mode) {
+		ir_node *const load  = get_Proj_pred(res);
+		ir_node *const block = get_nodes_block(load);
+		set_nodes_block(load,
+		                node_smallest_common_dominator(block, use_block));
+		return res;
+	}
+
+	ir_graph  *const irg        = get_irn_irg(use_block);
+	ir_node   *const pic_base   = ia32_get_pic_base(irg);
+	ir_entity *const pic_symbol = get_pic_symbol(env->be, entity);
+	ir_node   *const pic_symconst
+		= new_rd_SymConst_addr_ent(dbgi, irg, mode_P_code, pic_symbol);
+	ir_node   *const add
+		= new_r_Add(use_block, pic_base, pic_symconst, mode);
+	mark_irn_visited(add);
+
+	/* we need an extra indirection for global data outside our current
+	   module. The loads are always safe and can therefore float
+	   and need no memory input */
+	ir_node *const load
+		= new_r_Load(use_block, get_irg_no_mem(irg), add, mode, cons_floats);
+	res = new_r_Proj(load, mode, pn_Load_res);
+	if (!pmap_contains(env->got_loads, entity))
+		pmap_insert(env->got_loads, entity, res);
+	return res;
+}
+
+/**
+ * Returns the block with the smallest loop depth on the dominator path from
+ * the start block to block, the one nearest to block on ties.
+ */
+static ir_node *get_hoisted_block(const pic_env_t *env, ir_node *block)
+{
+	ir_node *best  = block;
+	unsigned depth = get_loop_depth(get_irn_loop(block));
+	while (depth > 0 && block != env->start_block) {
+		block = get_Block_idom(block);
+		unsigned block_depth = get_loop_depth(get_irn_loop(block));
+		if (block_depth < depth) {
+			best  = block;
+			depth = block_depth;
+		}
+	}
+	return best;
 }
 
 /** patches SymConsts to work in position independent code */
 static void fix_pic_symconsts(ir_node *node, void *data)
 {
-	(void) data;
+	pic_env_t     *env = (pic_env_t*)data;
 	ir_graph      *irg = get_irn_irg(node);
-	be_main_env_t *be  = be_get_irg_main_env(irg);
+	be_main_env_t *be  = env->be;
 
 	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
 		ir_node *pred = get_irn_n(node, i);
@@ -130,24 +213,32 @@ static void fix_pic_symconsts(ir_node *node, void *data)
 		}
 
 		/* get entry from pic symbol segment */
-		ir_entity *const pic_symbol = get_pic_symbol(be, entity);
-		ir_node   *const pic_symconst
-			= new_rd_SymConst_addr_ent(dbgi, irg, mode_P_code, pic_symbol);
-		ir_node   *const add = new_r_Add(block, pic_base, pic_symconst, mode);
-		mark_irn_visited(add);
-
-		/* we need an extra indirection for global data outside our current
-		   module. The loads are always safe and can therefore float
-		   and need no memory input */
-		ir_node *const load
-			= new_r_Load(block, get_irg_no_mem(irg), add, mode, cons_floats);
-		ir_node *const load_res = new_r_Proj(load, mode, pn_Load_res);
-
-		set_irn_n(node, i, load_res);
+		ir_node *const use_block = get_use_block(node, i);
+		set_irn_n(node, i, get_got_load(env, entity, mode, dbgi, use_block));
 	}
 }
 
 void ia32_adjust_pic(ir_graph *irg)
 {
-	irg_walk_graph(irg, fix_pic_symconsts, NULL, NULL);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+
+	pic_env_t env;
+	env.be          = be_get_irg_main_env(irg);
+	env.start_block = get_irg_start_block(irg);
+	env.got_loads   = pmap_create();
+	irg_walk_graph(irg, fix_pic_symconsts, NULL, &env);
+
+	/* the GOT entries are invariant, load them outside of loops but as near
+	 * to their uses as possible */
+	pmap_entry *entry;
+	foreach_pmap(env.got_loads, entry) {
+		ir_node *const load  = get_Proj_pred((ir_node*)entry->value);
+		ir_node *const block = get_hoisted_block(&env, get_nodes_block(load));
+		set_nodes_block(load, block);
+		set_nodes_block(get_Load_ptr(load), block);
+	}
+	pmap_destroy(env.got_loads);
+
+	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_CONTROL_FLOW);
 }
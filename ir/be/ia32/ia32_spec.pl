@@ -70,6 +70,33 @@ $mode_fpcw          = "ia32_mode_fpcw";
 $default_attr_type = "ia32_attr_t";
 $default_copy_attr = "ia32_copy_attr";
 
+# conversions of the emit templates, compiled by generate_emitter.pl
+%emit_modifiers = (
+	'*' => "EMIT_ALTERNATE_AM",
+	'#' => "EMIT_RESPECT_LS",
+	'l' => "EMIT_LONG",
+	'>' => "EMIT_HIGH_REG",
+	'<' => "EMIT_LOW_REG",
+	'^' => "EMIT_16BIT_REG",
+	',' => "EMIT_SHIFT_COMMA",
+);
+@emit_conversions = (
+	'AF'     => 'ia32_emit_x87_operands(node, MOD)',
+	'AM'     => 'ia32_emit_am_operand(node, MOD)',
+	'AS(\d)' => 'ia32_emit_source_or_am(node, $1, MOD)',
+	'B'      => 'ia32_emit_binop_operands(node)',
+	'D(\d)'  => 'ia32_emit_register(node, arch_get_irn_register_out(node, $1), MOD)',
+	'F0'     => 'ia32_emit_x87_register(node)',
+	'FM'     => 'ia32_emit_x87_mode_suffix(node)',
+	'FP'     => 'ia32_emit_x87_pop_suffix(node)',
+	'FR'     => 'ia32_emit_x87_reverse_suffix(node)',
+	'FX'     => 'ia32_emit_xmm_mode_suffix(node)',
+	'I'      => 'ia32_emit_immediate_operand(node, MOD)',
+	'M'      => 'ia32_emit_mode_suffix(node, MOD)',
+	'P(\d)'  => 'ia32_emit_node_condition_code(node, $1)',
+	'S(\d)'  => 'ia32_emit_source(node, $1, MOD)',
+);
+
 sub ia32_custom_init_attr {
 	my $constr = shift;
 	my $node   = shift;
@@ -1200,6 +1227,122 @@ Popcnt => {
 	modified_flags => $status_flags
 },
 
+#
+# BMI1/BMI2 and lzcnt/tzcnt instructions
+#
+Lzcnt => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in => [ "gp", "gp", "none", "gp" ],
+	               out => [ "gp", "flags", "none" ] },
+	ins       => [ "base", "index", "mem", "operand" ],
+	outs      => [ "res", "flags", "M" ],
+	am        => "source,binary",
+	emit      => "lzcnt%M %AS3, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+Tzcnt => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in => [ "gp", "gp", "none", "gp" ],
+	               out => [ "gp", "flags", "none" ] },
+	ins       => [ "base", "index", "mem", "operand" ],
+	outs      => [ "res", "flags", "M" ],
+	am        => "source,binary",
+	emit      => "tzcnt%M %AS3, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = ~left & right
+Andn => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in => [ "gp", "gp", "none", "gp", "gp" ],
+	               out => [ "gp", "flags", "none" ] },
+	ins       => [ "base", "index", "mem", "left", "right" ],
+	outs      => [ "res", "flags", "M" ],
+	am        => "source,binary",
+	emit      => "andn%M %AS4, %S3, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = operand & (operand - 1)
+Blsr => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in => [ "gp", "gp", "none", "gp" ],
+	               out => [ "gp", "flags", "none" ] },
+	ins       => [ "base", "index", "mem", "operand" ],
+	outs      => [ "res", "flags", "M" ],
+	am        => "source,binary",
+	emit      => "blsr%M %AS3, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = operand & -operand
+Blsi => {
+	irn_flags => [ "rematerializable" ],
+	state     => "exc_pinned",
+	reg_req   => { in => [ "gp", "gp", "none", "gp" ],
+	               out => [ "gp", "flags", "none" ] },
+	ins       => [ "base", "index", "mem", "operand" ],
+	outs      => [ "res", "flags", "M" ],
+	am        => "source,binary",
+	emit      => "blsi%M %AS3, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# res = val with all bits from position count upwards cleared
+Bzhi => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp", "flags" ] },
+	ins       => [ "val", "count" ],
+	outs      => [ "res", "flags" ],
+	emit      => "bzhi%M %S1, %S0, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+	modified_flags => $status_flags
+},
+
+# the shifts without count register constraint leave the flags alone
+Shlx => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	emit      => "shlx%M %S1, %S0, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+},
+
+Shrx => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	emit      => "shrx%M %S1, %S0, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+},
+
+Sarx => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "gp", "gp" ], out => [ "gp" ] },
+	ins       => [ "val", "count" ],
+	emit      => "sarx%M %S1, %S0, %D0",
+	latency   => 1,
+	mode      => $mode_gp,
+},
+
 Call => {
 	op_flags  => [ "uses_memory", "fragile" ],
 	state     => "exc_pinned",
@@ -1487,6 +1630,37 @@ xMul => {
 	mode      => $mode_xmm
 },
 
+#
+# FMA3 instructions, the emitter picks the form matching the register
+# assignment
+#
+# res = left * right + addend
+xFmadd => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	latency   => 5,
+	mode      => $mode_xmm
+},
+
+# res = left * right - addend
+xFmsub => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	latency   => 5,
+	mode      => $mode_xmm
+},
+
+# res = -(left * right) + addend
+xFnmadd => {
+	irn_flags => [ "rematerializable" ],
+	reg_req   => { in => [ "xmm", "xmm", "xmm" ], out => [ "xmm" ] },
+	ins       => [ "left", "right", "addend" ],
+	latency   => 5,
+	mode      => $mode_xmm
+},
+
 xMax => {
 	irn_flags => [ "rematerializable" ],
 	state     => "exc_pinned",
@@ -2159,6 +2333,24 @@ xxStore => {
 
 ); # end of %nodes
 
+# Execution port classes of the machine model, see ia32_get_timing().
+# Nodes not listed here use "alu" or, if they have no latency, no port.
+my %port_classes = (
+	(map { $_ => "shift" }     qw(Shl Shr Sar Rol Ror ShlD ShrD Setcc CMovcc Bt Sahf)),
+	(map { $_ => "lea" }       qw(Lea)),
+	(map { $_ => "mul" }       qw(Mul IMul IMul1OP Popcnt Bsf Bsr)),
+	(map { $_ => "div" }       qw(Div IDiv)),
+	(map { $_ => "branch" }    qw(Jcc Jmp SwitchJmp IJmp Call)),
+	(map { $_ => "load" }      qw(Load Pop PopEbp LdTls Leave xLoad xxLoad fld fild)),
+	(map { $_ => "store" }     qw(Store Push PushEax PopMem Enter xStore xStoreSimple xxStore fst fist fisttp)),
+	(map { $_ => "vec_add" }   qw(xAdd xSub xMax xMin Ucomi CvtSI2SS CvtSI2SD Conv_I2FP Conv_FP2I Conv_FP2FP)),
+	(map { $_ => "vec_mul" }   qw(xMul)),
+	(map { $_ => "vec_div" }   qw(xDiv)),
+	(map { $_ => "vec_logic" } qw(xAnd xOr xXor xAndNot xZero xPzero xAllOnes xPslld xPsllq xPsrld)),
+	(map { $_ => "x87" }       qw(fadd fmul fsub fabs fchs fldz fld1 fldpi fldln2 fldlg2 fldl2t fldl2e FucomFnstsw FucomppFnstsw Fucomi FtstFnstsw)),
+	(map { $_ => "x87_div" }   qw(fdiv fprem)),
+);
+
 # Transform some attributes
 foreach my $op (keys(%nodes)) {
 	my $node         = $nodes{$op};
@@ -2177,7 +2369,20 @@ foreach my $op (keys(%nodes)) {
 			die("Latency missing for op $op");
 		}
 	}
-	$op_attr_init .= "ia32_init_op(op, ".$node->{latency} . ");";
+	my $port_class = $node->{port_class};
+	if (!defined($port_class)) {
+		if (defined($port_classes{$op})) {
+			$port_class = $port_classes{$op};
+		} elsif ($node->{latency} == 0) {
+			$port_class = "none";
+		} elsif ($op =~ m/Mem$/) {
+			# read-modify-write instructions are bound by the store
+			$port_class = "store";
+		} else {
+			$port_class = "alu";
+		}
+	}
+	$op_attr_init .= "ia32_init_op(op, ".$node->{latency}.", ia32_pc_${port_class});";
 
 	$node->{op_attr_init} = $op_attr_init;
 }
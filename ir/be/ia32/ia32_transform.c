@@ -30,6 +30,8 @@
 #include "error.h"
 #include "array_t.h"
 #include "heights.h"
+#include "bitset.h"
+#include "constbits.h"
 
 #include "benode.h"
 #include "besched.h"
@@ -58,9 +60,11 @@
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
-static ir_node *old_initial_fpcw;
-static ir_node *initial_fpcw;
-bool            ia32_no_pic_adjust;
+static ir_node  *old_initial_fpcw;
+static ir_node  *initial_fpcw;
+bool             ia32_no_pic_adjust;
+/** values constbits proves to be in [0, 31], indexed by node index */
+static bitset_t *small_shift_counts;
 
 typedef ir_node *construct_binop_func(dbg_info *db, ir_node *block,
         ir_node *base, ir_node *index, ir_node *mem, ir_node *op1,
@@ -99,6 +103,13 @@ static ir_node *noreg_GP;
 static ir_node **call_list;
 static ir_type **call_types;
 
+/** the float[2] array types of the float modes */
+static ir_type *float_F;
+static ir_type *float_D;
+static ir_type *float_E;
+/** the entities of the known constants */
+static ir_entity *ent_cache[ia32_known_const_max];
+
 /** Return non-zero is a node represents the 0 constant. */
 static bool is_Const_0(ir_node *node)
 {
@@ -374,20 +385,14 @@ static ir_type *ia32_create_float_array(ir_type *tp)
 	ir_type *arr;
 
 	if (mode == mode_F) {
-		static ir_type *float_F;
-
 		arr = float_F;
 		if (arr == NULL)
 			arr = float_F = make_array_type(tp);
 	} else if (mode == mode_D) {
-		static ir_type *float_D;
-
 		arr = float_D;
 		if (arr == NULL)
 			arr = float_D = make_array_type(tp);
 	} else {
-		static ir_type *float_E;
-
 		arr = float_E;
 		if (arr == NULL)
 			arr = float_E = make_array_type(tp);
@@ -409,8 +414,6 @@ ir_entity *ia32_gen_fp_known_const(ia32_known_const_t kct)
 		{ "C_dfp_abs",  "0x7FFFFFFFFFFFFFFF",  1 },
 		{ "C_ull_bias", "0x10000000000000000", 2 }
 	};
-	static ir_entity *ent_cache[ia32_known_const_max];
-
 	ir_entity *ent = ent_cache[kct];
 
 	if (ent == NULL) {
@@ -1066,13 +1069,15 @@ static ir_node *gen_binop_x87_float(ir_node *node, ir_node *op1, ir_node *op2,
 /**
  * Construct a shift/rotate binary operation, sets AM and immediate if required.
  *
- * @param op1   The first operand
- * @param op2   The second operand
- * @param func  The node constructor function
+ * @param op1       The first operand
+ * @param op2       The second operand
+ * @param func      The node constructor function
+ * @param bmi_func  The constructor for a register count with BMI2, may be NULL
  * @return The constructed ia32 node.
  */
 static ir_node *gen_shift_binop(ir_node *node, ir_node *op1, ir_node *op2,
                                 construct_shift_func *func,
+                                construct_shift_func *bmi_func,
                                 match_flags_t flags)
 {
 	ir_mode *mode = get_irn_mode(node);
@@ -1118,6 +1123,11 @@ static ir_node *gen_shift_binop(ir_node *node, ir_node *op1, ir_node *op2,
 	}
 	ir_node *new_op2 = create_immediate_or_transform(op2);
 
+	/* shlx and friends take the count in any register */
+	if (bmi_func != NULL && ia32_cg_config.use_bmi
+	    && get_mode_size_bits(mode) == 32 && !is_ia32_Immediate(new_op2))
+		func = bmi_func;
+
 	dbg_info *dbgi      = get_irn_dbg_info(node);
 	ir_node  *block     = get_nodes_block(node);
 	ir_node  *new_block = be_transform_node(block);
@@ -1321,12 +1331,14 @@ static ir_node *match_64bit_shift(ir_node *node)
 
 static ir_node *gen_Rol(ir_node *node, ir_node *op1, ir_node *op2)
 {
-	return gen_shift_binop(node, op1, op2, new_bd_ia32_Rol, match_immediate);
+	return gen_shift_binop(node, op1, op2, new_bd_ia32_Rol, NULL,
+	                       match_immediate);
 }
 
 static ir_node *gen_Ror(ir_node *node, ir_node *op1, ir_node *op2)
 {
-	return gen_shift_binop(node, op1, op2, new_bd_ia32_Ror, match_immediate);
+	return gen_shift_binop(node, op1, op2, new_bd_ia32_Ror, NULL,
+	                       match_immediate);
 }
 
 /**
@@ -1334,6 +1346,38 @@ static ir_node *gen_Ror(ir_node *node, ir_node *op1, ir_node *op2)
  *
  * @return the created ia32 Add node
  */
+typedef ir_node *construct_fma_func(dbg_info *db, ir_node *block,
+        ir_node *left, ir_node *right, ir_node *addend);
+
+/**
+ * Returns true if the floating point multiplication @p node may be contracted
+ * with its only user @p user.
+ */
+static bool is_contractible_Mul(ir_node *node, ir_node *user)
+{
+	return is_Mul(node) && get_irn_n_edges(node) == 1
+	    && get_nodes_block(node) == get_nodes_block(user)
+	    && get_irn_mode(node) == get_irn_mode(user);
+}
+
+/**
+ * Creates an FMA3 node computing mul combined with addend.
+ */
+static ir_node *gen_fma(ir_node *node, ir_node *mul, ir_node *addend,
+                        construct_fma_func *func)
+{
+	dbg_info *dbgi       = get_irn_dbg_info(node);
+	ir_node  *new_block  = be_transform_node(get_nodes_block(node));
+	ir_node  *new_left   = be_transform_node(get_Mul_left(mul));
+	ir_node  *new_right  = be_transform_node(get_Mul_right(mul));
+	ir_node  *new_addend = be_transform_node(addend);
+	ir_node  *new_node   = func(dbgi, new_block, new_left, new_right,
+	                            new_addend);
+	set_ia32_ls_mode(new_node, get_irn_mode(node));
+	SET_IA32_ORIG_NODE(new_node, node);
+	return new_node;
+}
+
 static ir_node *gen_Add(ir_node *node)
 {
 	ir_mode  *mode = get_irn_mode(node);
@@ -1353,11 +1397,18 @@ static ir_node *gen_Add(ir_node *node)
 		return new_node;
 
 	if (mode_is_float(mode)) {
-		if (ia32_cg_config.use_sse2)
+		if (ia32_cg_config.use_sse2) {
+			if (ia32_cg_config.use_fma) {
+				if (is_contractible_Mul(op1, node))
+					return gen_fma(node, op1, op2, new_bd_ia32_xFmadd);
+				if (is_contractible_Mul(op2, node))
+					return gen_fma(node, op2, op1, new_bd_ia32_xFmadd);
+			}
 			return gen_binop(node, op1, op2, new_bd_ia32_xAdd,
 			                 match_commutative | match_am);
-		else
+		} else {
 			return gen_binop_x87_float(node, op1, op2, new_bd_ia32_fadd);
+		}
 	}
 
 	ia32_mark_non_am(node);
@@ -1492,12 +1543,95 @@ static ir_node *gen_Mulh(ir_node *node)
  *
  * @return The created ia32 And node
  */
+/**
+ * Transform bsf like node
+ */
+static ir_node *gen_unop_AM(ir_node *node, ir_node *op,
+                            construct_binop_dest_func *func)
+{
+	ir_node            *block = get_nodes_block(node);
+	ia32_address_mode_t am;
+	match_arguments(&am, block, NULL, op, NULL, match_am);
+
+	dbg_info       *dbgi      = get_irn_dbg_info(node);
+	ir_node        *new_block = be_transform_node(block);
+	ia32_address_t *addr      = &am.addr;
+	ir_node        *cnt       = func(dbgi, new_block, addr->base, addr->index,
+	                                 addr->mem, am.new_op2);
+	set_am_attributes(cnt, &am);
+	set_ia32_ls_mode(cnt, get_irn_mode(op));
+
+	SET_IA32_ORIG_NODE(cnt, node);
+	return fix_mem_proj(cnt, &am);
+}
+
+/**
+ * Returns x if @p node computes x - 1, NULL otherwise.
+ */
+static ir_node *get_decremented(ir_node *node)
+{
+	if (is_Add(node) && is_Const(get_Add_right(node))
+	    && tarval_is_all_one(get_Const_tarval(get_Add_right(node))))
+		return get_Add_left(node);
+	if (is_Sub(node) && is_Const_1(get_Sub_right(node)))
+		return get_Sub_left(node);
+	return NULL;
+}
+
+/**
+ * Matches the BMI forms of val & mask.
+ */
+static ir_node *match_bmi_and(ir_node *node, ir_node *val, ir_node *mask)
+{
+	/* x & (x - 1) */
+	ir_node *const decremented = get_decremented(mask);
+	if (decremented == val)
+		return gen_unop_AM(node, val, new_bd_ia32_Blsr);
+
+	/* x & -x */
+	if (is_Minus(mask) && get_Minus_op(mask) == val)
+		return gen_unop_AM(node, val, new_bd_ia32_Blsi);
+
+	/* x & ~y */
+	if (is_Not(mask)) {
+		return gen_binop(node, get_Not_op(mask), val, new_bd_ia32_Andn,
+		                 match_mode_neutral | match_am);
+	}
+
+	/* x & ((1 << n) - 1), constbits has to show n < 32 as bzhi does not take
+	 * the count modulo 32 */
+	if (decremented != NULL && is_Shl(decremented)
+	    && is_Const_1(get_Shl_left(decremented))) {
+		ir_node *const count = get_Shl_right(decremented);
+		if (!bitset_is_set(small_shift_counts, get_irn_idx(count)))
+			return NULL;
+
+		dbg_info *const dbgi      = get_irn_dbg_info(node);
+		ir_node  *const new_block = be_transform_node(get_nodes_block(node));
+		ir_node  *const new_val   = be_transform_node(val);
+		ir_node  *const new_count = be_transform_node(count);
+		ir_node  *const bzhi      = new_bd_ia32_Bzhi(dbgi, new_block, new_val,
+		                                             new_count);
+		SET_IA32_ORIG_NODE(bzhi, node);
+		return bzhi;
+	}
+	return NULL;
+}
+
 static ir_node *gen_And(ir_node *node)
 {
 	ir_node *op1 = get_And_left(node);
 	ir_node *op2 = get_And_right(node);
 	assert(!mode_is_float(get_irn_mode(node)));
 
+	if (ia32_cg_config.use_bmi && get_mode_size_bits(get_irn_mode(node)) == 32) {
+		ir_node *res = match_bmi_and(node, op1, op2);
+		if (res == NULL)
+			res = match_bmi_and(node, op2, op1);
+		if (res != NULL)
+			return res;
+	}
+
 	/* is it a zero extension? */
 	if (is_Const(op2)) {
 		ir_tarval *tv = get_Const_tarval(op2);
@@ -1571,10 +1705,17 @@ static ir_node *gen_Sub(ir_node *node)
 	ir_mode  *mode = get_irn_mode(node);
 
 	if (mode_is_float(mode)) {
-		if (ia32_cg_config.use_sse2)
+		if (ia32_cg_config.use_sse2) {
+			if (ia32_cg_config.use_fma) {
+				if (is_contractible_Mul(op1, node))
+					return gen_fma(node, op1, op2, new_bd_ia32_xFmsub);
+				if (is_contractible_Mul(op2, node))
+					return gen_fma(node, op2, op1, new_bd_ia32_xFnmadd);
+			}
 			return gen_binop(node, op1, op2, new_bd_ia32_xSub, match_am);
-		else
+		} else {
 			return gen_binop_x87_float(node, op1, op2, new_bd_ia32_fsub);
+		}
 	}
 
 	if (is_Const(op2)) {
@@ -1778,6 +1919,7 @@ static ir_node *gen_Shl(ir_node *node)
 	}
 
 	return gen_shift_binop(node, left, right, new_bd_ia32_Shl,
+	                       new_bd_ia32_Shlx,
 	                       match_mode_neutral | match_immediate);
 }
 
@@ -1792,7 +1934,7 @@ static ir_node *gen_Shr(ir_node *node)
 	ir_node *right = get_Shr_right(node);
 
 	return gen_shift_binop(node, left, right, new_bd_ia32_Shr,
-	                       match_immediate | match_zero_ext);
+	                       new_bd_ia32_Shrx, match_immediate | match_zero_ext);
 }
 
 /**
@@ -1847,7 +1989,7 @@ static ir_node *gen_Shrs(ir_node *node)
 	}
 
 	return gen_shift_binop(node, left, right, new_bd_ia32_Sar,
-	                       match_immediate | match_upconv);
+	                       new_bd_ia32_Sarx, match_immediate | match_upconv);
 }
 
 /**
@@ -4718,34 +4860,13 @@ static ir_node *gen_prefetch(ir_node *node)
 	return new_r_Proj(new_node, mode_M, pn_ia32_Prefetch_M);
 }
 
-/**
- * Transform bsf like node
- */
-static ir_node *gen_unop_AM(ir_node *node, construct_binop_dest_func *func)
-{
-	ir_node            *param = get_Builtin_param(node, 0);
-	ir_node            *block = get_nodes_block(node);
-	ia32_address_mode_t am;
-	match_arguments(&am, block, NULL, param, NULL, match_am);
-
-	dbg_info       *dbgi      = get_irn_dbg_info(node);
-	ir_node        *new_block = be_transform_node(block);
-	ia32_address_t *addr      = &am.addr;
-	ir_node        *cnt       = func(dbgi, new_block, addr->base, addr->index,
-	                                 addr->mem, am.new_op2);
-	set_am_attributes(cnt, &am);
-	set_ia32_ls_mode(cnt, get_irn_mode(param));
-
-	SET_IA32_ORIG_NODE(cnt, node);
-	return fix_mem_proj(cnt, &am);
-}
-
 /**
  * Transform builtin ffs.
  */
 static ir_node *gen_ffs(ir_node *node)
 {
-	ir_node *bsf  = gen_unop_AM(node, new_bd_ia32_Bsf);
+	ir_node *bsf  = gen_unop_AM(node, get_Builtin_param(node, 0),
+	                            new_bd_ia32_Bsf);
 	ir_node *real = skip_Proj(bsf);
 
 	/* bsf x */
@@ -4787,7 +4908,11 @@ static ir_node *gen_ffs(ir_node *node)
  */
 static ir_node *gen_clz(ir_node *node)
 {
-	ir_node  *bsr   = gen_unop_AM(node, new_bd_ia32_Bsr);
+	ir_node *param = get_Builtin_param(node, 0);
+	if (ia32_cg_config.use_bmi)
+		return gen_unop_AM(node, param, new_bd_ia32_Lzcnt);
+
+	ir_node  *bsr   = gen_unop_AM(node, param, new_bd_ia32_Bsr);
 	ir_node  *real  = skip_Proj(bsr);
 	dbg_info *dbgi  = get_irn_dbg_info(real);
 	ir_node  *block = get_nodes_block(real);
@@ -4802,7 +4927,10 @@ static ir_node *gen_clz(ir_node *node)
  */
 static ir_node *gen_ctz(ir_node *node)
 {
-	return gen_unop_AM(node, new_bd_ia32_Bsf);
+	ir_node *param = get_Builtin_param(node, 0);
+	if (ia32_cg_config.use_bmi)
+		return gen_unop_AM(node, param, new_bd_ia32_Tzcnt);
+	return gen_unop_AM(node, param, new_bd_ia32_Bsf);
 }
 
 /**
@@ -5487,6 +5615,43 @@ static void postprocess_fp_call_results(void)
 }
 
 /* do the transformation */
+static void collect_small_shift_counts(ir_node *node, void *env)
+{
+	(void)env;
+	if (!mode_is_int(get_irn_mode(node)))
+		return;
+	bitinfo const *const b = get_bitinfo(node);
+	if (b == NULL)
+		return;
+	if (tarval_is_null(tarval_shr_unsigned(b->z, 5))
+	    && tarval_is_null(tarval_shr_unsigned(b->o, 5)))
+		bitset_set(small_shift_counts, get_irn_idx(node));
+}
+
+/**
+ * Records the values constbits proves to be smaller than 32, bzhi may use
+ * them as bit count.
+ */
+static void analyze_small_shift_counts(ir_graph *irg)
+{
+	small_shift_counts = bitset_malloc(get_irg_last_idx(irg));
+	if (!ia32_cg_config.use_bmi)
+		return;
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_NO_UNREACHABLE_CODE
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+
+	struct obstack obst;
+	obstack_init(&obst);
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	constbits_analyze(irg, &obst);
+
+	irg_walk_graph(irg, NULL, collect_small_shift_counts, NULL);
+
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
+	obstack_free(&obst, NULL);
+}
+
 void ia32_transform_graph(ir_graph *irg)
 {
 	register_transformers();
@@ -5498,6 +5663,8 @@ void ia32_transform_graph(ir_graph *irg)
 
 	old_initial_fpcw = be_get_initial_reg_value(irg, &ia32_registers[REG_FPCW]);
 
+	analyze_small_shift_counts(irg);
+
 	be_timer_push(T_HEIGHTS);
 	ia32_heights = heights_new(irg);
 	be_timer_pop(T_HEIGHTS);
@@ -5522,9 +5689,19 @@ void ia32_transform_graph(ir_graph *irg)
 	ia32_free_non_address_mode_nodes();
 	heights_free(ia32_heights);
 	ia32_heights = NULL;
+	free(small_shift_counts);
+	small_shift_counts = NULL;
 }
 
 void ia32_init_transform(void)
 {
 	FIRM_DBG_REGISTER(dbg, "firm.be.ia32.transform");
 }
+
+void ia32_finish_transform(void)
+{
+	float_F = NULL;
+	float_D = NULL;
+	float_E = NULL;
+	memset(ent_cache, 0, sizeof(ent_cache));
+}
@@ -45,4 +45,10 @@ ir_node *ia32_skip_downconv(ir_node *node);
 /** Initialize the ia32 instruction selector. */
 void ia32_init_transform(void);
 
+/**
+ * Forget the types and entities cached by the instruction selector, they
+ * vanish with the program they were created in.
+ */
+void ia32_finish_transform(void);
+
 #endif
@@ -20,11 +20,11 @@
 #include "ircons.h"
 #include "irgwalk.h"
 #include "obst.h"
-#include "pmap.h"
 #include "array_t.h"
 #include "pdeq.h"
 #include "debug.h"
 #include "error.h"
+#include "execfreq.h"
 
 #include "belive_t.h"
 #include "besched.h"
@@ -88,8 +88,11 @@ typedef int (*sim_func)(x87_state *state, ir_node *n);
  * A block state: Every block has a x87 state at the beginning and at the end.
  */
 typedef struct blk_state {
-	x87_state *begin;   /**< state at the begin or NULL if not assigned */
-	x87_state *end;     /**< state at the end or NULL if not assigned */
+	x87_state *begin;      /**< state at the begin or NULL if not assigned */
+	x87_state *end;        /**< state at the end or NULL if not assigned */
+	ir_node   *begin_pred; /**< predecessor block whose end state defined the
+	                            begin state */
+	bool       uses_fp;    /**< the block contains fp instructions */
 } blk_state;
 
 /** liveness bitset for fp registers. */
@@ -100,7 +103,6 @@ typedef unsigned char fp_liveness;
  */
 struct x87_simulator {
 	struct obstack obst;       /**< An obstack for fast allocating. */
-	pmap          *blk_states; /**< Map blocks to states. */
 	be_lv_t       *lv;         /**< intrablock liveness. */
 	fp_liveness   *live;       /**< Liveness information. */
 	unsigned       n_idx;      /**< The cached get_irg_last_idx() result. */
@@ -255,24 +257,13 @@ static void x87_emms(x87_state *state)
 /**
  * Returns the block state of a block.
  *
- * @param sim    the x87 simulator handle
  * @param block  the current block
  *
  * @return the block state
  */
-static blk_state *x87_get_bl_state(x87_simulator *sim, ir_node *block)
+static blk_state *x87_get_bl_state(const ir_node *block)
 {
-	blk_state *res = pmap_get(blk_state, sim->blk_states, block);
-
-	if (res == NULL) {
-		res = OALLOC(&sim->obst, blk_state);
-		res->begin = NULL;
-		res->end   = NULL;
-
-		pmap_insert(sim->blk_states, block, res);
-	}
-
-	return res;
+	return (blk_state*)get_irn_link(block);
 }
 
 /**
@@ -603,14 +594,34 @@ static unsigned fp_live_args_after(x87_simulator *sim, const ir_node *pos, unsig
 }
 
 /**
- * Calculate the liveness for a whole block and cache it.
+ * Returns true if @p irn defines or uses a fp register.
+ */
+static bool uses_fp_regs(ir_node *irn)
+{
+	const arch_register_class_t *cls = &ia32_reg_classes[CLASS_ia32_fp];
+
+	be_foreach_definition(irn, cls, def, req,
+		(void)def;
+		return true;
+	);
+	be_foreach_use(irn, cls, in_req_, op, op_req_,
+		(void)op;
+		return true;
+	);
+	return false;
+}
+
+/**
+ * Calculate the liveness for a whole block and cache it. Also note whether
+ * the block contains instructions working on fp registers at all.
  *
  * @param sim   the simulator handle
  * @param block the block
  */
 static void update_liveness(x87_simulator *sim, ir_node *block)
 {
-	fp_liveness live = fp_liveness_end_of_block(sim, block);
+	fp_liveness live    = fp_liveness_end_of_block(sim, block);
+	bool        uses_fp = false;
 	unsigned idx;
 
 	/* now iterate through the block backward and cache the results */
@@ -623,9 +634,15 @@ static void update_liveness(x87_simulator *sim, ir_node *block)
 		sim->live[idx] = live;
 
 		live = fp_liveness_transfer(irn, live);
+		if (!uses_fp)
+			uses_fp = uses_fp_regs(irn);
 	}
 	idx = get_irn_idx(block);
 	sim->live[idx] = live;
+
+	blk_state *const bl_state = OALLOCZ(&sim->obst, blk_state);
+	bl_state->uses_fp = uses_fp;
+	set_irn_link(block, bl_state);
 }
 
 /**
@@ -1580,7 +1597,7 @@ static void x87_kill_deads(x87_simulator *const sim, ir_node *const block, x87_s
 static void x87_simulate_block(x87_simulator *sim, ir_node *block)
 {
 	ir_node *n, *next;
-	blk_state *bl_state = x87_get_bl_state(sim, block);
+	blk_state *bl_state = x87_get_bl_state(block);
 	x87_state *state = bl_state->begin;
 
 	assert(state != NULL);
@@ -1597,31 +1614,34 @@ static void x87_simulate_block(x87_simulator *sim, ir_node *block)
 	/* at block begin, kill all dead registers */
 	x87_kill_deads(sim, block, state);
 
-	/* beware, n might change */
-	for (n = sched_first(block); !sched_is_end(n); n = next) {
-		int node_inserted;
-		sim_func func;
-		ir_op *op = get_irn_op(n);
-
-		/*
-		 * get the next node to be simulated here.
-		 * n might be completely removed from the schedule-
-		 */
-		next = sched_next(n);
-		if (op->ops.generic != NULL) {
-			func = (sim_func)op->ops.generic;
-
-			/* simulate it */
-			node_inserted = (*func)(state, n);
+	/* blocks without fp instructions pass the state through */
+	if (bl_state->uses_fp) {
+		/* beware, n might change */
+		for (n = sched_first(block); !sched_is_end(n); n = next) {
+			int node_inserted;
+			sim_func func;
+			ir_op *op = get_irn_op(n);
 
 			/*
-			 * sim_func might have added an additional node after n,
-			 * so update next node
-			 * beware: n must not be changed by sim_func
-			 * (i.e. removed from schedule) in this case
+			 * get the next node to be simulated here.
+			 * n might be completely removed from the schedule-
 			 */
-			if (node_inserted != NO_NODE_ADDED)
-				next = sched_next(n);
+			next = sched_next(n);
+			if (op->ops.generic != NULL) {
+				func = (sim_func)op->ops.generic;
+
+				/* simulate it */
+				node_inserted = (*func)(state, n);
+
+				/*
+				 * sim_func might have added an additional node after n,
+				 * so update next node
+				 * beware: n must not be changed by sim_func
+				 * (i.e. removed from schedule) in this case
+				 */
+				if (node_inserted != NO_NODE_ADDED)
+					next = sched_next(n);
+			}
 		}
 	}
 
@@ -1632,14 +1652,28 @@ static void x87_simulate_block(x87_simulator *sim, ir_node *block)
 		ir_node *succ = get_edge_src_irn(edge);
 		blk_state *succ_state;
 
-		succ_state = x87_get_bl_state(sim, succ);
+		succ_state = x87_get_bl_state(succ);
 
 		if (succ_state->begin == NULL) {
 			DB((dbg, LEVEL_2, "Set begin state for succ %+F:\n", succ));
 			DEBUG_ONLY(x87_dump_stack(state);)
-			succ_state->begin = state;
+			succ_state->begin      = state;
+			succ_state->begin_pred = block;
 
 			waitq_put(sim->worklist, succ);
+		} else if (succ_state->end == NULL && succ != block
+		           && get_block_execfreq(block)
+		              > get_block_execfreq(succ_state->begin_pred)) {
+			/* The successor was not simulated yet: Let it start with the state
+			 * of the more frequently executed predecessor and do the
+			 * permutations in the other one. */
+			ir_node   *const other       = succ_state->begin_pred;
+			blk_state *const other_state = x87_get_bl_state(other);
+			DB((dbg, LEVEL_2, "succ %+F prefers state of %+F, shuffling in %+F\n",
+			    succ, block, other));
+			x87_shuffle(other, other_state->end, state);
+			succ_state->begin      = state;
+			succ_state->begin_pred = block;
 		} else {
 			DB((dbg, LEVEL_2, "succ %+F already has a state, shuffling\n", succ));
 			/* There is already a begin state for the successor, bad.
@@ -1675,7 +1709,6 @@ static void register_sim(ir_op *op, sim_func func)
 static void x87_init_simulator(x87_simulator *sim, ir_graph *irg)
 {
 	obstack_init(&sim->obst);
-	sim->blk_states = pmap_create();
 	sim->n_idx      = get_irg_last_idx(irg);
 	sim->live       = OALLOCN(&sim->obst, fp_liveness, sim->n_idx);
 
@@ -1717,7 +1750,6 @@ static void x87_init_simulator(x87_simulator *sim, ir_graph *irg)
  */
 static void x87_destroy_simulator(x87_simulator *sim)
 {
-	pmap_destroy(sim->blk_states);
 	obstack_free(&sim->obst, NULL);
 	DB((dbg, LEVEL_1, "x87 Simulator stopped\n\n"));
 }
@@ -1739,8 +1771,6 @@ static void update_liveness_walker(ir_node *block, void *data)
  */
 void ia32_x87_simulate_graph(ir_graph *irg)
 {
-	/* TODO improve code quality (less executed fxch) by using execfreqs */
-
 	ir_node       *block, *start_block;
 	blk_state     *bl_state;
 	x87_simulator sim;
@@ -1748,16 +1778,6 @@ void ia32_x87_simulate_graph(ir_graph *irg)
 	/* create the simulator */
 	x87_init_simulator(&sim, irg);
 
-	start_block = get_irg_start_block(irg);
-	bl_state    = x87_get_bl_state(&sim, start_block);
-
-	/* start with the empty state */
-	empty.sim       = &sim;
-	bl_state->begin = &empty;
-
-	sim.worklist = new_waitq();
-	waitq_put(sim.worklist, start_block);
-
 	be_assure_live_sets(irg);
 	sim.lv = be_get_irg_liveness(irg);
 
@@ -1767,8 +1787,19 @@ void ia32_x87_simulate_graph(ir_graph *irg)
 	 * On the other hand we reduce the computation amount due to
 	 * precaching from O(n^2) to O(n) at the expense of O(n) cache memory.
 	 */
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
 	irg_block_walk_graph(irg, update_liveness_walker, NULL, &sim);
 
+	start_block = get_irg_start_block(irg);
+	bl_state    = x87_get_bl_state(start_block);
+
+	/* start with the empty state */
+	empty.sim       = &sim;
+	bl_state->begin = &empty;
+
+	sim.worklist = new_waitq();
+	waitq_put(sim.worklist, start_block);
+
 	/* iterate */
 	do {
 		block = (ir_node*)waitq_get(sim.worklist);
@@ -1776,6 +1807,7 @@ void ia32_x87_simulate_graph(ir_graph *irg)
 	} while (! waitq_empty(sim.worklist));
 
 	/* kill it */
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
 	del_waitq(sim.worklist);
 	x87_destroy_simulator(&sim);
 }
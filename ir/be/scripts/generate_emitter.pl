@@ -21,7 +21,16 @@
 
 # This script generates C code which emits assembler code for the
 # assembler ir nodes. It takes a "emit" key from the node specification
-# and substitutes lines starting with . with a corresponding fprintf().
+# and compiles each template line into calls of the backend emit functions.
+# The spec file describes the format conversions:
+#   %emit_modifiers   maps modifier characters to the C flags they set; the
+#                     flags replace MOD in the conversion code
+#   @emit_conversions pairs of a regular expression matching a conversion
+#                     (without % and modifiers) and the C code emitting it;
+#                     $1, $2, ... are replaced by the captured groups
+#   $emit_indent      C code starting a line (default: a tab)
+# Template lines using conversions not described there are passed to
+# <arch>_emitf() and interpreted at runtime.
 
 use strict;
 use Data::Dumper;
@@ -31,6 +40,9 @@ our $target_dir = $ARGV[1];
 
 our $arch;
 our %nodes;
+our %emit_modifiers;
+our @emit_conversions;
+our $emit_indent = "be_emit_char('\\t');";
 
 my $return;
 
@@ -69,7 +81,12 @@ foreach my $op (keys(%nodes)) {
 	my @emit = split(/\n/, $n{"emit"});
 
 	foreach my $template (@emit) {
-		if ($template ne '') {
+		next if ($template eq '');
+
+		my $code = compile_template($template);
+		if (defined($code)) {
+			$obst_func .= $code;
+		} else {
 			$obst_func .= "\t${arch}_emitf(node, \"$template\");\n";
 		}
 	}
@@ -77,6 +94,62 @@ foreach my $op (keys(%nodes)) {
 	$obst_func .= "}\n\n";
 }
 
+# Compiles a template line into C statements, returns undef if the line uses
+# a conversion unknown to the spec.
+sub compile_template
+{
+	my ($template) = @_;
+	return undef if (!@emit_conversions);
+
+	my $code    = "\t$emit_indent\n";
+	my $literal = "";
+	my $rest    = $template;
+	while ($rest ne "") {
+		if ($rest =~ s/^([^%]+)//) {
+			$literal .= $1;
+			next;
+		}
+		if ($rest =~ s/^%%//) {
+			$literal .= "%";
+			next;
+		}
+		$rest =~ s/^%//;
+
+		my @flags;
+		while ($rest ne "" && defined($emit_modifiers{substr($rest, 0, 1)})) {
+			push(@flags, $emit_modifiers{substr($rest, 0, 1)});
+			$rest = substr($rest, 1);
+		}
+
+		my $stmt;
+		for (my $i = 0; $i < @emit_conversions; $i += 2) {
+			my $pattern = $emit_conversions[$i];
+			next if ($rest !~ /^(?:$pattern)/);
+
+			my @captures = map { substr($rest, $-[$_], $+[$_] - $-[$_]) } 1 .. $#-;
+			$rest = substr($rest, $+[0]);
+
+			$stmt = $emit_conversions[$i + 1];
+			$stmt =~ s/\$(\d)/$captures[$1 - 1]/g;
+			my $mod = @flags ? join(" | ", @flags) : "EMIT_NONE";
+			$stmt =~ s/\bMOD\b/$mod/g;
+			last;
+		}
+		return undef if (!defined($stmt));
+
+		if ($literal ne "") {
+			$code    .= "\tbe_emit_cstring(\"$literal\");\n";
+			$literal  = "";
+		}
+		$code .= "\t$stmt;\n";
+	}
+	if ($literal ne "") {
+		$code .= "\tbe_emit_cstring(\"$literal\");\n";
+	}
+	$code .= "\tbe_emit_finish_line_gas(node);\n";
+	return $code;
+}
+
 open(OUT, ">$target_h") || die("Could not open $target_h, reason: $!\n");
 
 my $creation_time = localtime(time());
@@ -78,6 +78,7 @@ if(! %compare_attr) {
 
 my $obst_limit_func  = ""; #
 my $obst_reg_reqs    = ""; #
+my $obst_in_reqs     = ""; # buffer for the input requirements table
 my $obst_opvar       = ""; # buffer for the "ir_op *op_<arch>_<op-name> = NULL;" statements
 my $obst_get_opvar   = ""; # buffer for the get_op_<arch>_<op-name>() functions
 my $obst_constructor = ""; # buffer for node constructor functions
@@ -95,7 +96,10 @@ my $n_opcodes = 0;    # number of opcodes
 my $ARITY_VARIABLE = -1;
 my $ARITY_DYNAMIC  = -2;
 my %requirements = ();
-my %limit_bitsets = ();
+my %limit_bitsets = (); # limit bitset name => initializer
+my %limit_emitted = ();
+my %in_reqs_offsets = (); # joined input requirements => offset in in_reqs table
+my $n_in_reqs = 0;
 my %reg2class = ();
 my %regclass2len = ();
 
@@ -306,14 +310,13 @@ EOF
 				die "Fatal error: Arity and number of in requirements don't match for ${op}\n";
 			}
 
-			$temp .= "\tstatic const arch_register_req_t *in_reqs[] =\n";
-			$temp .= "\t{\n";
+			my @reqstructs;
 			for ($idx = 0; $idx <= $#in; $idx++) {
 				my $req = $in[$idx];
-				my $reqstruct = generate_requirements($req, $n, "${arch}_${op}", $idx, 1);
-				$temp .= "\t\t& ${reqstruct},\n";
+				push(@reqstructs, generate_requirements($req, $n, "${arch}_${op}", $idx, 1));
 			}
-			$temp .= "\t};\n";
+			my $offset = get_in_reqs_offset(@reqstructs);
+			$temp .= "\tconst arch_register_req_t **in_reqs = &${arch}_in_reqs[${offset}];\n";
 		} else {
 			if($arity > 0) {
 				die "Fatal error: need in requirements for ${op}\n";
@@ -758,6 +761,11 @@ int get_$arch\_irn_opcode(const ir_node *node)
 
 $obst_limit_func
 $obst_reg_reqs
+
+/** input requirements of all nodes, the constructors point into this table */
+static const arch_register_req_t *${arch}_in_reqs[] = {
+$obst_in_reqs};
+
 $obst_constructor
 
 /**
@@ -1058,13 +1066,10 @@ CHECK_REQS: foreach (@regs) {
 		$limit_name = "${arch}_limit_".mangle_requirements($limit_reqs, $class);
 
 		if(defined($limit_bitsets{$limit_name})) {
-			$limit_name = $limit_bitsets{$limit_name};
 			return ($class, $limit_name, $same_pos, $different_pos);
 		}
 
-		$limit_bitsets{$limit_name} = $limit_name;
-
-		$obst_limit_func .= "static const unsigned $limit_name\[] = { ";
+		my $init  = "";
 		my $first = 1;
 		my $limitbitsetlen = $regclass2len{$class};
 		my $limitarraylen = ($limitbitsetlen+31) / 32;
@@ -1074,7 +1079,7 @@ CHECK_REQS: foreach (@regs) {
 			if($first) {
 				$first = 0;
 			} else {
-				$obst_limit_func .= ", ";
+				$init .= ", ";
 			}
 			my $temp;
 			if($neg) {
@@ -1091,14 +1096,30 @@ CHECK_REQS: foreach (@regs) {
 				my $reguc = uc($reg);
 				$temp .= "BIT(REG_${classuc}_${reguc})";
 			}
-			$obst_limit_func .= $temp || "0";
+			$init .= $temp || "0";
 		}
-		$obst_limit_func .= " };\n";
+		$limit_bitsets{$limit_name} = $init;
 	}
 
 	return ($class, $limit_name, $same_pos, $different_pos);
 }
 
+###
+# Returns the position of a list of input requirements in the table shared by
+# all constructors, appending it if it is not there yet.
+###
+sub get_in_reqs_offset {
+	my $key = join(",", @_);
+	if (!defined($in_reqs_offsets{$key})) {
+		$in_reqs_offsets{$key} = $n_in_reqs;
+		foreach my $reqstruct (@_) {
+			$obst_in_reqs .= "\t& ${reqstruct},\n";
+		}
+		$n_in_reqs += scalar(@_);
+	}
+	return $in_reqs_offsets{$key};
+}
+
 ###
 # Generate register requirements structure
 ###
@@ -1157,14 +1178,14 @@ EOF
 EOF
 
 	} else {
-		my ($regclass, $limit_bitset, $same_pos, $different_pos)
+		my ($regclass, $limit_name, $same_pos, $different_pos)
 			= build_subset_class_func($node, $op, $idx, $is_in, $reqs, $flags);
 
 		if (!defined($regclass)) {
 			die("Fatal error: Could not build subset for requirements '$reqs' of '$op' pos $idx ... exiting.\n");
 		}
 
-		if (defined($limit_bitset) && $limit_bitset ne "NULL") {
+		if (defined($limit_name)) {
 			push(@req_type_mask, "arch_register_req_type_limited");
 		}
 		if ($same_pos != 0) {
@@ -1175,11 +1196,47 @@ EOF
 		}
 		my $reqtype = join(" | ", @req_type_mask);
 
- 		if(!defined($limit_bitset)) {
-			$limit_bitset = "NULL";
+		$class = $regclass;
+
+		# the limited bitsets of classes with up to 64 registers are stored
+		# right behind their requirement
+		if (defined($limit_name) && $regclass2len{$class} <= 64) {
+			my $name = "${arch}_requirements_".mangle_requirements($reqs, $class, $flags);
+			if (!defined($requirements{$name})) {
+				$requirements{$name} = $name;
+				my $init = $limit_bitsets{$limit_name};
+				my @words = split(/, /, $init);
+				my $len   = scalar(@words);
+				$obst_reg_reqs .= <<EOF;
+static const struct {
+	arch_register_req_t req;
+	unsigned            limited[${len}];
+} ${name} = {
+	{
+		${reqtype},
+		& ${arch}_reg_classes[CLASS_${arch}_${class}],
+		${name}.limited,
+		${same_pos},        /* same pos */
+		${different_pos},       /* different pos */
+		$width             /* width */
+	},
+	{ ${init} }
+};
+
+EOF
+			}
+			return "${name}.req";
+		}
+
+		my $limit_bitset = "NULL";
+		if (defined($limit_name)) {
+			$limit_bitset = $limit_name;
+			if (!defined($limit_emitted{$limit_name})) {
+				$limit_emitted{$limit_name} = 1;
+				$obst_limit_func .= "static const unsigned $limit_name\[] = { $limit_bitsets{$limit_name} };\n";
+			}
 		}
 
-		$class  = $regclass;
 		$result = <<EOF;
 {
 	${reqtype},
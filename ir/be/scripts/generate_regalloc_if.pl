@@ -148,6 +148,12 @@ EOF
 	my $first_reg = "&${arch}_registers[REG_". uc($class[0]->{"name"}) . "]";
 	push(@regclasses, "{ $class_idx, \"$class_name\", $numregs, NULL, $first_reg, $flags_prepared, &${arch}_class_reg_req_${old_classname} }");
 
+	# the limited bitsets of classes with up to 64 registers are stored right
+	# behind their requirement (same length as get_limited_array() produces)
+	my $class_len         = $regclass2len{$old_classname};
+	my $limited_len       = int(($class_len + 62) / 32);
+	my $single_req_member = $class_len <= 64 ? ".req" : "";
+
 	my $idx = 0;
 	$reginit .= "\t$arch\_reg_classes[CLASS_".$class_name."].mode = $class_mode;\n";
 	my $lastreg;
@@ -178,14 +184,32 @@ EOF
 		REG_${classuc}_${ucname},
 		REG_${ucname},
 		${type},
-		&${arch}_single_reg_req_${old_classname}_${name},
+		&${arch}_single_reg_req_${old_classname}_${name}${single_req_member},
 		${dwarf_number},
 		${encoding}
 	},
 EOF
 
 		my $limitedarray = get_limited_array($name);
-		$single_constraints .= <<EOF;
+		if ($single_req_member ne "") {
+			$single_constraints .= <<EOF;
+static const struct {
+	arch_register_req_t req;
+	unsigned            limited[${limited_len}];
+} ${arch}_single_reg_req_${old_classname}_${name} = {
+	{
+		arch_register_req_type_limited,
+		${class_ptr},
+		${arch}_single_reg_req_${old_classname}_${name}.limited,
+		0,
+		0,
+		1
+	},
+	${limitedarray}
+};
+EOF
+		} else {
+			$single_constraints .= <<EOF;
 static const unsigned ${arch}_limited_${old_classname}_${name} [] = ${limitedarray};
 static const arch_register_req_t ${arch}_single_reg_req_${old_classname}_${name} = {
 	arch_register_req_type_limited,
@@ -196,6 +220,7 @@ static const arch_register_req_t ${arch}_single_reg_req_${old_classname}_${name}
 	1
 };
 EOF
+		}
 
 		$lastreg = $ucname;
 		$idx++;
@@ -68,6 +68,8 @@ static sparc_isa_t sparc_isa_template = {
 		                                        for calls */
 		7,                                   /* costs for a spill instruction */
 		5,                                   /* costs for a reload instruction */
+		NULL,                                /* machine model of the scheduler */
+		false,                               /* no JIT support */
 	},
 	NULL,                                  /* constants */
 };
@@ -221,9 +223,9 @@ static void sparc_before_ra(ir_graph *irg)
 {
 	/* fixup flags register */
 	be_sched_fix_flags(irg, &sparc_reg_classes[CLASS_sparc_flags_class],
-	                   NULL, sparc_modifies_flags);
+	                   NULL, sparc_modifies_flags, NULL);
 	be_sched_fix_flags(irg, &sparc_reg_classes[CLASS_sparc_fpflags_class],
-	                   NULL, sparc_modifies_fp_flags);
+	                   NULL, sparc_modifies_fp_flags, NULL);
 }
 
 /**
@@ -466,6 +468,8 @@ static void sparc_init(void)
 
 static void sparc_finish(void)
 {
+	rem  = NULL;
+	urem = NULL;
 	sparc_free_opcodes();
 }
 
@@ -493,7 +497,7 @@ static void sparc_end_codegeneration(void *self)
 
 static void sparc_lower_for_target(void)
 {
-	lower_calls_with_compounds(LF_RETURN_HIDDEN);
+	lower_calls_with_compounds(LF_RETURN_HIDDEN, NULL);
 
 	for (size_t i = 0, n_irgs = get_irp_n_irgs(); i < n_irgs; ++i) {
 		ir_graph *irg = get_irp_irg(i);
@@ -565,7 +569,9 @@ static const backend_params *sparc_get_backend_params(void)
 		0,     /* no trampoline support: size 0 */
 		0,     /* no trampoline support: align 0 */
 		NULL,  /* no trampoline support: no trampoline builder */
-		4      /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		4,     /* alignment of stack parameter: typically 4 (32bit) or 8 (64bit) */
+		0,     /* issue width: unknown */
+		0      /* branch mispredict penalty: unknown */
 	};
 
 	ir_mode *mode_long_long
@@ -13,6 +13,7 @@
 #include "sparc_cconv.h"
 #include "irmode.h"
 #include "irgwalk.h"
+#include "iredges_t.h"
 #include "typerep.h"
 #include "xmalloc.h"
 #include "util.h"
@@ -131,13 +132,95 @@ static const arch_register_t *map_i_to_o_reg(const arch_register_t *reg)
 	return &sparc_registers[idx];
 }
 
+ir_node *sparc_get_tail_call(const ir_node *ret)
+{
+	ir_node *mem = get_Return_mem(ret);
+	if (!is_Proj(mem))
+		return NULL;
+	ir_node *call = get_Proj_pred(mem);
+	if (!is_Call(call) || get_nodes_block(call) != get_nodes_block(ret))
+		return NULL;
+	if (!is_SymConst(get_Call_ptr(call)))
+		return NULL;
+
+	/* we return to our caller with "jmp %o7+8", which is wrong if one of
+	 * the functions uses the aggregate return protocol */
+	ir_graph *irg      = get_irn_irg(ret);
+	ir_type  *own_type = get_entity_type(get_irg_entity(irg));
+	ir_type  *type     = get_Call_type(call);
+	if ((get_method_calling_convention(own_type) & cc_compound_ret)
+	    || (get_method_calling_convention(type) & cc_compound_ret)
+	    || (get_method_additional_properties(type)
+	        & mtp_property_returns_twice))
+		return NULL;
+
+	/* the Return must pass on exactly the results of the call */
+	size_t n_res = get_Return_n_ress(ret);
+	if (get_method_n_ress(type) != n_res)
+		return NULL;
+	for (size_t i = 0; i < n_res; ++i) {
+		ir_node *res = get_Return_res(ret, i);
+		if (!is_Proj(res) || get_Proj_proj(res) != (long)i)
+			return NULL;
+		ir_node *res_tuple = get_Proj_pred(res);
+		if (!is_Proj(res_tuple) || get_Proj_pred(res_tuple) != call)
+			return NULL;
+	}
+
+	/* nobody else may use the call */
+	foreach_out_edge(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		switch ((pn_Call)get_Proj_proj(proj)) {
+		case pn_Call_M:
+			if (get_irn_n_edges(proj) != 1)
+				return NULL;
+			break;
+		case pn_Call_T_result:
+			foreach_out_edge(proj, res_edge) {
+				ir_node *res = get_edge_src_irn(res_edge);
+				foreach_out_edge(res, user_edge) {
+					if (get_edge_src_irn(user_edge) != ret)
+						return NULL;
+				}
+			}
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	/* the stack of our caller has no room for stack arguments */
+	calling_convention_t *cconv = sparc_decide_calling_convention(type, NULL);
+	bool stack_params = cconv->param_stack_size > 0;
+	sparc_free_calling_convention(cconv);
+	if (stack_params)
+		return NULL;
+
+	return call;
+}
+
+static bool is_tail_call(ir_node *call)
+{
+	foreach_out_edge(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (get_Proj_proj(proj) != pn_Call_M)
+			continue;
+		foreach_out_edge(proj, mem_edge) {
+			ir_node *user = get_edge_src_irn(mem_edge);
+			return is_Return(user) && sparc_get_tail_call(user) == call;
+		}
+	}
+	return false;
+}
+
 static void check_omit_fp(ir_node *node, void *env)
 {
 	/* omit-fp is not possible if:
 	 *  - we have allocations on the stack
-	 *  - we have calls (with the exception of tail-calls once we support them)
+	 *  - we have calls (with the exception of tail-calls)
 	 */
-	if (is_Alloc(node) || is_Free(node) || is_Call(node)) {
+	if (is_Alloc(node) || is_Free(node)
+	    || (is_Call(node) && !is_tail_call(node))) {
 		bool *can_omit_fp = (bool*) env;
 		*can_omit_fp = false;
 	}
@@ -163,7 +246,9 @@ calling_convention_t *sparc_decide_calling_convention(ir_type *function_type,
 {
 	bool omit_fp = false;
 	if (irg != NULL) {
-		omit_fp = be_options.omit_fp;
+		/* leaf functions run in the register window of their caller, so
+		 * they neither need save/restore nor a frame pointer */
+		omit_fp = true;
 		/* our current vaarg handling needs the standard space to store the
 		 * args 0-5 in it */
 		if (get_method_variadicity(function_type) == variadicity_variadic)
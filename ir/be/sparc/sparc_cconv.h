@@ -60,6 +60,13 @@ struct calling_convention_t
 calling_convention_t *sparc_decide_calling_convention(ir_type *function_type,
                                                       ir_graph *irg);
 
+/**
+ * Returns the Call whose results are directly returned by @p ret if it can
+ * be emitted as a tail call from a function without register window, NULL
+ * otherwise.
+ */
+ir_node *sparc_get_tail_call(const ir_node *ret);
+
 /**
  * free memory used by a calling_convention_t
  */
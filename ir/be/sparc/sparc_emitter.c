@@ -46,6 +46,9 @@ DEBUG_ONLY(static firm_dbg_module_t *dbg = NULL;)
 
 static ir_heights_t *heights;
 static unsigned     *delay_slot_fillers;
+/** jumps whose delay slot holds a copy of the first instruction of their
+ * target, and the copied instructions */
+static unsigned     *delay_slot_copies;
 static pmap         *delay_slots;
 
 static bool emitting_delay_slot;
@@ -54,7 +57,7 @@ static bool emitting_delay_slot;
  * indent before instruction. (Adds additional indentation when emitting
  * delay slots)
  */
-static void sparc_emit_indent(void)
+void sparc_emit_indent(void)
 {
 	be_emit_char('\t');
 	if (emitting_delay_slot)
@@ -80,7 +83,7 @@ static void sparc_emit_immediate(int32_t value, ir_entity *entity)
 	}
 }
 
-static void sparc_emit_high_immediate(ir_node const *node)
+void sparc_emit_high_immediate(ir_node const *node)
 {
 	const sparc_attr_t *attr   = get_sparc_attr_const(node);
 	ir_entity          *entity = attr->immediate_value_entity;
@@ -108,22 +111,33 @@ static void sparc_emit_register(const arch_register_t *const reg)
 	be_emit_string(reg->name);
 }
 
-static void sparc_emit_source_register(ir_node const *node, int const pos)
+void sparc_emit_source_register(ir_node const *node, int const pos)
 {
 	const arch_register_t *reg = arch_get_irn_register_in(node, pos);
 	sparc_emit_register(reg);
 }
 
-static void sparc_emit_dest_register(ir_node const *const node, int const pos)
+void sparc_emit_dest_register(ir_node const *const node, int const pos)
 {
 	const arch_register_t *reg = arch_get_irn_register_out(node, pos);
 	sparc_emit_register(reg);
 }
 
+void sparc_emit_source_or_immediate(ir_node const *const node, int const pos)
+{
+	if (arch_get_irn_flags(node) & (arch_irn_flags_t)sparc_arch_irn_flag_immediate_form) {
+		const sparc_attr_t *const attr = get_sparc_attr_const(node);
+		sparc_emit_immediate(attr->immediate_value,
+		                     attr->immediate_value_entity);
+	} else {
+		sparc_emit_source_register(node, pos);
+	}
+}
+
 /**
  * emit SP offset
  */
-static void sparc_emit_offset(const ir_node *node, int offset_node_pos)
+void sparc_emit_offset(const ir_node *node, int offset_node_pos)
 {
 	const sparc_load_store_attr_t *attr = get_sparc_load_store_attr_const(node);
 
@@ -150,7 +164,7 @@ static void sparc_emit_offset(const ir_node *node, int offset_node_pos)
 /**
  *  Emit load mode
  */
-static void sparc_emit_load_mode(ir_node const *const node)
+void sparc_emit_load_mode(ir_node const *const node)
 {
 	const sparc_load_store_attr_t *attr = get_sparc_load_store_attr_const(node);
 	ir_mode *mode      = attr->load_store_mode;
@@ -170,7 +184,7 @@ static void sparc_emit_load_mode(ir_node const *const node)
 /**
  * Emit store mode char
  */
-static void sparc_emit_store_mode(ir_node const *const node)
+void sparc_emit_store_mode(ir_node const *const node)
 {
 	const sparc_load_store_attr_t *attr = get_sparc_load_store_attr_const(node);
 	ir_mode *mode      = attr->load_store_mode;
@@ -186,7 +200,7 @@ static void sparc_emit_store_mode(ir_node const *const node)
 	}
 }
 
-static void emit_fp_suffix(const ir_mode *mode)
+void sparc_emit_fp_suffix(const ir_mode *mode)
 {
 	assert(mode_is_float(mode));
 	switch (get_mode_size_bits(mode)) {
@@ -257,6 +271,15 @@ static bool is_no_instruction(const ir_node *node)
 	return be_is_Keep(node) || be_is_Start(node) || is_Phi(node);
 }
 
+/**
+ * Returns true if @p node is a Return jumping to another function.
+ */
+static bool is_tail_call(const ir_node *node)
+{
+	return is_sparc_Return(node)
+	    && get_sparc_attr_const(node)->immediate_value_entity != NULL;
+}
+
 static bool has_delay_slot(const ir_node *node)
 {
 	if (is_sparc_Ba(node)) {
@@ -323,9 +346,41 @@ static bool is_legal_delay_slot_filler(const ir_node *node)
 		return false;
 	if (rbitset_is_set(delay_slot_fillers, get_irn_idx(node)))
 		return false;
+	/* a copy of this node is executed instead of the node itself when
+	 * jumping behind it, so it must stay at the start of its block */
+	if (rbitset_is_set(delay_slot_copies, get_irn_idx(node)))
+		return false;
 	return true;
 }
 
+/**
+ * Returns the first instruction of @p block if a copy of it can be put into
+ * the delay slot of a jump to @p block. The jump then targets the instruction
+ * behind it, so the copy executes exactly like the original would.
+ */
+static ir_node *pick_delay_slot_copy(const ir_node *block)
+{
+	sched_foreach_frozen(block, node) {
+		if (is_no_instruction(node))
+			continue;
+		if (emits_multiple_instructions(node))
+			return NULL;
+		/* the node has been moved away, so it is not at the block start */
+		if (rbitset_is_set(delay_slot_fillers, get_irn_idx(node)))
+			return NULL;
+		/* restore is handled specially when emitting returns */
+		if (is_sparc_Restore(node) || is_sparc_RestoreZero(node))
+			return NULL;
+		return node;
+	}
+	return NULL;
+}
+
+static bool is_delay_slot_copy(const ir_node *node)
+{
+	return rbitset_is_set(delay_slot_copies, get_irn_idx(node));
+}
+
 static bool can_move_down_into_delayslot(const ir_node *node, const ir_node *to)
 {
 	if (!is_legal_delay_slot_filler(node))
@@ -473,6 +528,10 @@ static ir_node *pick_delay_slot_for(ir_node *node)
 	static const unsigned PICK_DELAY_SLOT_MAX_DISTANCE = 10;
 	assert(has_delay_slot(node));
 
+	/* the delay slot of a tail call restores the return address */
+	if (is_tail_call(node))
+		return NULL;
+
 	if (is_sparc_Bicc(node) || is_sparc_fbfcc(node)) {
 		optimize_fallthrough(node);
 	}
@@ -551,7 +610,32 @@ static ir_node *pick_delay_slot_for(ir_node *node)
 		}
 	}
 
-	return NULL;
+	/* copy the first instruction of the jump target. Conditional jumps
+	 * annul the delay slot, so the copy only executes if we jump */
+	ir_node *target;
+	if (is_sparc_Bicc(node) || is_sparc_fbfcc(node)) {
+		ir_node *proj_true = NULL;
+		foreach_out_edge(node, edge) {
+			ir_node *proj = get_edge_src_irn(edge);
+			if (get_Proj_proj(proj) == pn_sparc_Bicc_true)
+				proj_true = proj;
+		}
+		target = get_jump_target(proj_true);
+	} else if (is_sparc_Ba(node)) {
+		target = get_jump_target(node);
+	} else {
+		return NULL;
+	}
+	ir_node *copy = pick_delay_slot_copy(target);
+	if (copy == NULL)
+		return NULL;
+	if (!is_sparc_Ba(node)) {
+		sparc_jmp_cond_attr_t *attr = get_sparc_jmp_cond_attr(node);
+		attr->annul_delay_slot = true;
+	}
+	rbitset_set(delay_slot_copies, get_irn_idx(node));
+	rbitset_set(delay_slot_copies, get_irn_idx(copy));
+	return copy;
 }
 
 void sparc_emitf(ir_node const *const node, char const *fmt, ...)
@@ -612,7 +696,7 @@ void sparc_emitf(ir_node const *const node, char const *fmt, ...)
 			case 'S': mode = get_sparc_fp_conv_attr_const(node)->src_mode;  break;
 			default:  goto unknown;
 			}
-			emit_fp_suffix(mode);
+			sparc_emit_fp_suffix(mode);
 			break;
 		}
 
@@ -656,10 +740,8 @@ void sparc_emitf(ir_node const *const node, char const *fmt, ...)
 			if (*fmt < '0' || '9' <= *fmt)
 				goto unknown;
 			unsigned const pos = *fmt++ - '0';
-			if (imm && arch_get_irn_flags(node) & (arch_irn_flags_t)sparc_arch_irn_flag_immediate_form) {
-				const sparc_attr_t *const attr = get_sparc_attr_const(node);
-				sparc_emit_immediate(attr->immediate_value,
-				                     attr->immediate_value_entity);
+			if (imm) {
+				sparc_emit_source_or_immediate(node, pos);
 			} else {
 				sparc_emit_source_register(node, pos);
 			}
@@ -1123,6 +1205,17 @@ static void emit_sparc_Return(const ir_node *node)
 	ir_entity *entity = get_irg_entity(irg);
 	ir_type   *type   = get_entity_type(entity);
 
+	/* we have no register window: the callee returns directly to our
+	 * caller if we keep %o7 intact. %g1 is free as it can't be an argument */
+	if (is_tail_call(node)) {
+		sparc_emitf(node, "mov %%o7, %%g1");
+		sparc_emitf(node, "call %E, 0");
+		emitting_delay_slot = true;
+		sparc_emitf(NULL, "mov %%g1, %%o7");
+		emitting_delay_slot = false;
+		return;
+	}
+
 	const char *destreg = "%o7";
 
 	/* hack: we don't explicitely model register changes because of the
@@ -1240,7 +1333,11 @@ static void emit_sparc_branch(const ir_node *node, get_cc_func get_cc)
 	}
 
 	/* emit the true proj */
-	sparc_emitf(node, "%s%A %L", get_cc(relation), proj_true);
+	if (is_delay_slot_copy(node)) {
+		sparc_emitf(node, "%s%A %L+4", get_cc(relation), proj_true);
+	} else {
+		sparc_emitf(node, "%s%A %L", get_cc(relation), proj_true);
+	}
 	fill_delay_slot(node);
 
 	const ir_node *block      = get_nodes_block(node);
@@ -1251,10 +1348,20 @@ static void emit_sparc_branch(const ir_node *node, get_cc_func get_cc)
 			sparc_emitf(node, "/* fallthrough to %L */", proj_false);
 		}
 	} else {
-		sparc_emitf(node, "ba %L", proj_false);
-		/* TODO: fill this slot as well */
+		/* all delay slots are picked already, so the first instruction of
+		 * the target stays where it is */
+		ir_node *copy = pick_delay_slot_copy(get_jump_target(proj_false));
+		if (copy != NULL) {
+			sparc_emitf(node, "ba %L+4", proj_false);
+		} else {
+			sparc_emitf(node, "ba %L", proj_false);
+		}
 		emitting_delay_slot = true;
-		sparc_emitf(NULL, "nop");
+		if (copy != NULL) {
+			be_emit_node(copy);
+		} else {
+			sparc_emitf(NULL, "nop");
+		}
 		emitting_delay_slot = false;
 	}
 }
@@ -1290,6 +1397,9 @@ static void emit_sparc_Ba(const ir_node *node)
 		if (be_options.verbose_asm) {
 			sparc_emitf(node, "/* fallthrough to %L */", node);
 		}
+	} else if (is_delay_slot_copy(node)) {
+		sparc_emitf(node, "ba %L+4", node);
+		fill_delay_slot(node);
 	} else {
 		sparc_emitf(node, "ba %L", node);
 		fill_delay_slot(node);
@@ -1411,7 +1521,7 @@ static void sparc_emit_block(ir_node *block, ir_node *prev)
 	bool needs_label = block_needs_label(block, prev);
 	be_gas_begin_block(block, needs_label);
 
-	sched_foreach(block, node) {
+	sched_foreach_frozen(block, node) {
 		if (rbitset_is_set(delay_slot_fillers, get_irn_idx(node)))
 			continue;
 		be_emit_node(node);
@@ -1469,13 +1579,15 @@ static void pick_delay_slots(size_t n_blocks, ir_node **blocks)
 	      cmp_block_execfreqs);
 
 	for (size_t i = 0; i < n_blocks; ++i) {
-		sched_foreach(sorted_blocks[i], node) {
+		sched_foreach_frozen(sorted_blocks[i], node) {
 			if (!has_delay_slot(node))
 				continue;
 			ir_node *filler = pick_delay_slot_for(node);
 			if (filler == NULL)
 				continue;
-			rbitset_set(delay_slot_fillers, get_irn_idx(filler));
+			/* copied instructions are emitted at their place as well */
+			if (!is_delay_slot_copy(node))
+				rbitset_set(delay_slot_fillers, get_irn_idx(filler));
 			pmap_insert(delay_slots, node, filler);
 		}
 	}
@@ -1485,6 +1597,7 @@ void sparc_emit_function(ir_graph *irg)
 {
 	heights            = heights_new(irg);
 	delay_slot_fillers = rbitset_malloc(get_irg_last_idx(irg));
+	delay_slot_copies  = rbitset_malloc(get_irg_last_idx(irg));
 	delay_slots        = pmap_create();
 
 	/* register all emitter functions */
@@ -1492,15 +1605,21 @@ void sparc_emit_function(ir_graph *irg)
 
 	/* create the block schedule. For now, we don't need it earlier. */
 	ir_node **block_schedule = be_create_block_schedule(irg);
+	be_split_cold_fragment(irg, block_schedule);
+	sched_freeze(irg);
 
 	sparc_emit_func_prolog(irg);
 	irg_block_walk_graph(irg, init_jump_links, NULL, NULL);
 
-	/* inject block scheduling links & emit code of each block */
-	size_t n_blocks = ARR_LEN(block_schedule);
+	/* inject block scheduling links & emit code of each block, nothing falls
+	 * through into the cold fragment */
+	ir_node *cold_block = be_birg_from_irg(irg)->cold_block;
+	size_t   n_blocks   = ARR_LEN(block_schedule);
 	for (size_t i = 0; i < n_blocks; ++i) {
 		ir_node *block      = block_schedule[i];
 		ir_node *next_block = i+1 < n_blocks ? block_schedule[i+1] : NULL;
+		if (next_block == cold_block)
+			next_block = NULL;
 		set_irn_link(block, next_block);
 	}
 
@@ -1508,7 +1627,7 @@ void sparc_emit_function(ir_graph *irg)
 
 	for (size_t i = 0; i < n_blocks; ++i) {
 		ir_node *block = block_schedule[i];
-		ir_node *prev  = i>=1 ? block_schedule[i-1] : NULL;
+		ir_node *prev  = i>=1 && block != cold_block ? block_schedule[i-1] : NULL;
 		if (block == get_irg_end_block(irg))
 			continue;
 		sparc_emit_block(block, prev);
@@ -1518,6 +1637,7 @@ void sparc_emit_function(ir_graph *irg)
 	sparc_emit_func_epilog(irg);
 
 	pmap_destroy(delay_slots);
+	free(delay_slot_copies);
 	free(delay_slot_fillers);
 	heights_free(heights);
 }
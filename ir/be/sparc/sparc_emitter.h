@@ -45,6 +45,20 @@
  */
 void sparc_emitf(ir_node const *node, char const *fmt, ...);
 
+/*
+ * Emitters for single format conversions, used by sparc_emitf() and the
+ * emitters generated from the node specification.
+ */
+void sparc_emit_indent(void);
+void sparc_emit_source_register(ir_node const *node, int pos);
+void sparc_emit_source_or_immediate(ir_node const *node, int pos);
+void sparc_emit_dest_register(ir_node const *node, int pos);
+void sparc_emit_high_immediate(ir_node const *node);
+void sparc_emit_offset(ir_node const *node, int offset_node_pos);
+void sparc_emit_load_mode(ir_node const *node);
+void sparc_emit_store_mode(ir_node const *node);
+void sparc_emit_fp_suffix(ir_mode const *mode);
+
 void sparc_emit_function(ir_graph *irg);
 
 void sparc_init_emitter(void);
@@ -128,6 +128,7 @@ void sparc_lower_64bit(void)
 		0,  /* big endian */
 		64, /* doubleword size */
 		create_64_intrinsic_fkt,
+		NULL,
 		NULL
 	};
 
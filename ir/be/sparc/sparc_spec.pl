@@ -104,6 +104,21 @@ $mode_fp4     = "mode_Q";
 $default_attr_type = "sparc_attr_t";
 $default_copy_attr = "sparc_copy_attr";
 
+# conversions of the emit templates, compiled by generate_emitter.pl
+$emit_indent = "sparc_emit_indent();";
+@emit_conversions = (
+	'D(\d)'  => 'sparc_emit_dest_register(node, $1)',
+	'SI(\d)' => 'sparc_emit_source_or_immediate(node, $1)',
+	'S(\d)'  => 'sparc_emit_source_register(node, $1)',
+	'O(\d)'  => 'sparc_emit_offset(node, $1)',
+	'H'      => 'sparc_emit_high_immediate(node)',
+	'ML'     => 'sparc_emit_load_mode(node)',
+	'MS'     => 'sparc_emit_store_mode(node)',
+	'FD'     => 'sparc_emit_fp_suffix(get_sparc_fp_conv_attr_const(node)->dest_mode)',
+	'FM'     => 'sparc_emit_fp_suffix(get_sparc_fp_attr_const(node)->fp_mode)',
+	'FS'     => 'sparc_emit_fp_suffix(get_sparc_fp_conv_attr_const(node)->src_mode)',
+);
+
 %init_attr = (
 	sparc_attr_t             => "\tinit_sparc_attributes(res, irn_flags_, in_reqs, n_res);",
 	sparc_load_store_attr_t  => "\tinit_sparc_attributes(res, irn_flags_, in_reqs, n_res);",
@@ -207,6 +207,11 @@ static ir_type *compute_arg_type(ir_graph *irg, calling_convention_t *cconv,
 			/* use reserved spill space on between type */
 			if (entity != NULL) {
 				long offset = SPARC_PARAMS_SPILL_OFFSET + i * SPARC_REGISTER_SIZE;
+				/* without a register window the spill space lies in the
+				 * frame of our caller, which is behind the empty between
+				 * type */
+				if (cconv->omit_fp)
+					offset -= SPARC_MIN_STACKSIZE;
 				assert(i < SPARC_N_PARAM_REGS);
 				set_entity_owner(entity, between_type);
 				set_entity_offset(entity, offset);
@@ -23,6 +23,7 @@
 #include "debug.h"
 #include "error.h"
 #include "util.h"
+#include "opt_frame.h"
 
 #include "benode.h"
 #include "beirg.h"
@@ -83,6 +84,8 @@ static const arch_register_t *const omit_fp_callee_saves[] = {
 	&sparc_registers[REG_I4],
 	&sparc_registers[REG_I5],
 };
+/** Start Projs of the callee saves, shared by all Returns */
+static ir_node *start_callee_saves[ARRAY_SIZE(omit_fp_callee_saves)];
 
 static inline bool mode_needs_gp_reg(ir_mode *mode)
 {
@@ -1862,71 +1865,6 @@ static ir_node *get_stack_pointer_for(ir_node *node)
 	return stack;
 }
 
-/**
- * transform a Return node into epilogue code + return statement
- */
-static ir_node *gen_Return(ir_node *node)
-{
-	ir_node  *block     = get_nodes_block(node);
-	ir_graph *irg       = get_irn_irg(node);
-	ir_node  *new_block = be_transform_node(block);
-	dbg_info *dbgi      = get_irn_dbg_info(node);
-	ir_node  *mem       = get_Return_mem(node);
-	ir_node  *new_mem   = be_transform_node(mem);
-	ir_node  *sp        = get_stack_pointer_for(node);
-	size_t    n_res     = get_Return_n_ress(node);
-	struct obstack *be_obst = be_get_be_obst(irg);
-
-	/* estimate number of return values */
-	size_t n_ins = 2 + n_res; /* memory + stackpointer, return values */
-	if (current_cconv->omit_fp)
-		n_ins += ARRAY_SIZE(omit_fp_callee_saves);
-
-	const arch_register_req_t **reqs
-		= OALLOCN(be_obst, const arch_register_req_t*, n_ins);
-	ir_node **in = ALLOCAN(ir_node*, n_ins);
-	size_t    p  = 0;
-
-	in[p]   = new_mem;
-	reqs[p] = arch_no_register_req;
-	++p;
-
-	in[p]   = sp;
-	reqs[p] = sp_reg->single_req;
-	++p;
-
-	/* result values */
-	for (size_t i = 0; i < n_res; ++i) {
-		ir_node                  *res_value     = get_Return_res(node, i);
-		ir_node                  *new_res_value = be_transform_node(res_value);
-		const reg_or_stackslot_t *slot          = &current_cconv->results[i];
-		assert(slot->req1 == NULL);
-		in[p]   = new_res_value;
-		reqs[p] = slot->req0;
-		++p;
-	}
-	/* callee saves */
-	if (current_cconv->omit_fp) {
-		ir_node  *start          = get_irg_start(irg);
-		size_t    n_callee_saves = ARRAY_SIZE(omit_fp_callee_saves);
-		for (size_t i = 0; i < n_callee_saves; ++i) {
-			const arch_register_t *reg   = omit_fp_callee_saves[i];
-			ir_mode               *mode  = reg->reg_class->mode;
-			ir_node               *value
-					= new_r_Proj(start, mode, i + start_callee_saves_offset);
-			in[p]   = value;
-			reqs[p] = reg->single_req;
-			++p;
-		}
-	}
-	assert(p == n_ins);
-
-	ir_node *bereturn = new_bd_sparc_Return_reg(dbgi, new_block, n_ins, in);
-	arch_set_irn_register_reqs_in(bereturn, reqs);
-
-	return bereturn;
-}
-
 static ir_node *bitcast_int_to_float(dbg_info *dbgi, ir_node *block,
                                      ir_node *value0, ir_node *value1)
 {
@@ -2014,6 +1952,123 @@ static void bitcast_float_to_int(dbg_info *dbgi, ir_node *block,
 	}
 }
 
+/**
+ * transform a Return node into epilogue code + return statement
+ */
+static ir_node *gen_Return(ir_node *node)
+{
+	ir_node  *block     = get_nodes_block(node);
+	ir_graph *irg       = get_irn_irg(node);
+	ir_node  *new_block = be_transform_node(block);
+	dbg_info *dbgi      = get_irn_dbg_info(node);
+	ir_node  *mem       = get_Return_mem(node);
+	size_t    n_res     = get_Return_n_ress(node);
+	struct obstack *be_obst = be_get_be_obst(irg);
+
+	/* a tail call jumps to the callee which returns to our caller, it
+	 * passes the call arguments instead of return values */
+	ir_node              *call  = NULL;
+	calling_convention_t *cconv = NULL;
+	if (current_cconv->omit_fp)
+		call = sparc_get_tail_call(node);
+	if (call != NULL) {
+		cconv = sparc_decide_calling_convention(get_Call_type(call), NULL);
+		mem   = get_Call_mem(call);
+		n_res = 0;
+	}
+	ir_node *new_mem = be_transform_node(mem);
+	ir_node *sp      = get_stack_pointer_for(call != NULL ? call : node);
+
+	/* estimate number of return values */
+	size_t n_ins = 2 + n_res; /* memory + stackpointer, return values */
+	if (current_cconv->omit_fp)
+		n_ins += ARRAY_SIZE(omit_fp_callee_saves);
+	if (call != NULL)
+		n_ins += cconv->n_param_regs;
+
+	const arch_register_req_t **reqs
+		= OALLOCN(be_obst, const arch_register_req_t*, n_ins);
+	ir_node **in = ALLOCAN(ir_node*, n_ins);
+	size_t    p  = 0;
+
+	in[p]   = new_mem;
+	reqs[p] = arch_no_register_req;
+	++p;
+
+	in[p]   = sp;
+	reqs[p] = sp_reg->single_req;
+	++p;
+
+	/* result values */
+	for (size_t i = 0; i < n_res; ++i) {
+		ir_node                  *res_value     = get_Return_res(node, i);
+		ir_node                  *new_res_value = be_transform_node(res_value);
+		const reg_or_stackslot_t *slot          = &current_cconv->results[i];
+		assert(slot->req1 == NULL);
+		in[p]   = new_res_value;
+		reqs[p] = slot->req0;
+		++p;
+	}
+	/* tail call arguments */
+	if (call != NULL) {
+		ir_type *type     = get_Call_type(call);
+		size_t   n_params = get_Call_n_params(call);
+		for (size_t i = 0; i < n_params; ++i) {
+			ir_node                  *value = get_Call_param(call, i);
+			ir_mode                  *mode
+				= get_type_mode(get_method_param_type(type, i));
+			const reg_or_stackslot_t *param = &cconv->parameters[i];
+			ir_node                  *new_values[2];
+
+			if (mode_is_float(mode)) {
+				bitcast_float_to_int(dbgi, new_block, value, mode, new_values);
+			} else {
+				new_values[0] = be_transform_node(value);
+				new_values[1] = NULL;
+			}
+			in[p]   = new_values[0];
+			reqs[p] = param->req0;
+			++p;
+			if (param->reg1 != NULL) {
+				in[p]   = new_values[1];
+				reqs[p] = param->req1;
+				++p;
+			}
+		}
+	}
+	/* callee saves */
+	if (current_cconv->omit_fp) {
+		ir_node  *start          = get_irg_start(irg);
+		size_t    n_callee_saves = ARRAY_SIZE(omit_fp_callee_saves);
+		for (size_t i = 0; i < n_callee_saves; ++i) {
+			const arch_register_t *reg   = omit_fp_callee_saves[i];
+			ir_mode               *mode  = reg->reg_class->mode;
+			ir_node               *value = start_callee_saves[i];
+			if (value == NULL) {
+				value = new_r_Proj(start, mode, i + start_callee_saves_offset);
+				start_callee_saves[i] = value;
+			}
+			in[p]   = value;
+			reqs[p] = reg->single_req;
+			++p;
+		}
+	}
+	assert(p == n_ins);
+
+	ir_node *bereturn;
+	if (call != NULL) {
+		ir_entity *entity = get_SymConst_entity(get_Call_ptr(call));
+		bereturn = new_bd_sparc_Return_imm(dbgi, new_block, n_ins, in, entity,
+		                                   0);
+		sparc_free_calling_convention(cconv);
+	} else {
+		bereturn = new_bd_sparc_Return_reg(dbgi, new_block, n_ins, in);
+	}
+	arch_set_irn_register_reqs_in(bereturn, reqs);
+
+	return bereturn;
+}
+
 static ir_node *gen_Call(ir_node *node)
 {
 	ir_graph        *irg          = get_irn_irg(node);
@@ -2794,6 +2849,7 @@ void sparc_transform_graph(ir_graph *irg)
 	assert(sparc_reg_classes[CLASS_sparc_fpflags_class].mode == mode_flags);
 
 	frame_base = NULL;
+	memset(start_callee_saves, 0, sizeof(start_callee_saves));
 
 	stackorder = be_collect_stacknodes(irg);
 	current_cconv
@@ -2806,12 +2862,16 @@ void sparc_transform_graph(ir_graph *irg)
 	sparc_create_stacklayout(irg, current_cconv);
 	be_add_parameter_entity_stores(irg);
 
+	/* layout the frame while its entities are still accessed by Sels */
+	ir_type *frame_type = get_irg_frame_type(irg);
+	if (get_type_state(frame_type) == layout_undefined)
+		opt_frame_share_slots(irg);
+
 	be_transform_graph(irg, NULL);
 
 	be_free_stackorder(stackorder);
 	sparc_free_calling_convention(current_cconv);
 
-	ir_type *frame_type = get_irg_frame_type(irg);
 	if (get_type_state(frame_type) == layout_undefined)
 		default_layout_compound_type(frame_type);
 
@@ -29,7 +29,7 @@
 #include "type_t.h"
 #include "entity_t.h"
 #include "firmstat.h"
-#include "irarch.h"
+#include "irarch_t.h"
 #include "irhooks.h"
 #include "iredges_t.h"
 #include "irmemory_t.h"
@@ -39,6 +39,10 @@
 #include "irtools.h"
 #include "execfreq_t.h"
 #include "firmstat_t.h"
+#include "dbginfo_t.h"
+#include "irprofile.h"
+#include "lower_dw.h"
+#include "lower_softfloat.h"
 
 /* returns the firm root */
 lc_opt_entry_t *firm_opt_get_root(void)
@@ -104,6 +108,17 @@ void ir_init(void)
 #endif
 }
 
+/**
+ * Frees the state of the library modules which refers to the current program.
+ */
+static void free_prog_caches(void)
+{
+	ir_finish_lazy_import();
+	ir_finish_dw_lowering();
+	ir_finish_softfloat_lowering();
+	ir_profile_free();
+}
+
 void ir_finish(void)
 {
 #ifdef DEBUG_libfirm
@@ -112,8 +127,11 @@ void ir_finish(void)
 	exit_execfreq();
 	firm_be_finish();
 
+	free_prog_caches();
 	free_ir_prog();
+	finish_dbg_info();
 	firm_finish_op();
+	firm_finish_arch_dep();
 	finish_tarval();
 	finish_mode();
 	finish_tpop();
@@ -121,6 +139,21 @@ void ir_finish(void)
 	finish_ident();
 }
 
+void ir_reset_prog(const char *name)
+{
+	/* the backend drops its entities and types before they are freed */
+	firm_be_reset();
+
+	free_prog_caches();
+	free_ir_prog();
+
+	reset_id_unique();
+	init_irprog_1();
+	init_mode_types();
+	init_irprog_2();
+	set_irp_prog_name(new_id_from_str(name));
+}
+
 unsigned ir_get_version_major(void)
 {
 	return libfirm_VERSION_MAJOR;
@@ -56,7 +56,7 @@ void copy_irn_to_irg(ir_node *n, ir_graph *irg)
 	/* do not copy standard nodes */
 	switch (get_irn_opcode(n)) {
 	case iro_NoMem:
-		n = get_irg_no_mem(irg);
+		nn = get_irg_no_mem(irg);
 		break;
 
 	case iro_Block:
@@ -93,9 +93,11 @@ void copy_irn_to_irg(ir_node *n, ir_graph *irg)
 		return;
 	}
 
+	/* The block is set later, until then the old one lets set_irn_n() find
+	 * a graph. */
 	nn = new_ir_node(get_irn_dbg_info(n),
 	                 irg,
-	                 NULL,            /* no block yet, will be set later */
+	                 is_Block(n) ? NULL : get_nodes_block(n),
 	                 get_irn_op(n),
 	                 get_irn_mode(n),
 	                 get_irn_arity(n),
@@ -104,7 +106,7 @@ void copy_irn_to_irg(ir_node *n, ir_graph *irg)
 
 	/* Copy the attributes.  These might point to additional data.  If this
 	   was allocated on the old obstack the pointers now are dangling.  This
-	   frees e.g. the memory of the graph_arr allocated in new_immBlock. */
+	   frees e.g. the value maps of blocks under construction. */
 	copy_node_attr(irg, n, nn);
 	set_irn_link(n, nn);
 
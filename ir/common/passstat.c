@@ -0,0 +1,187 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Per pass time, heap and node count statistics.
+ *
+ * The passes form a stack. The times are taken with ir_get_time_sec()
+ * instead of ir_timer_t, so the passes do not interfere with the timer stack
+ * of the backend timers. The numbers of a pass are emitted as statistic
+ * events and as a complete event ("ph":"X") of the Chrome trace event format
+ * when it ends. Spans are written as they finish, trace viewers sort them by
+ * time and nest them by their ranges.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "timing.h"
+#include "firmstat.h"
+#include "irgraph_t.h"
+#include "statev_t.h"
+#include "irprintf.h"
+#include "array.h"
+
+typedef struct pass_stat_t {
+	const char        *name;
+	ir_graph          *irg;
+	double             start;
+	size_t             heap_before;
+	unsigned           nodes_before;
+	unsigned long long counters_before[ir_timer_counter_last + 1];
+} pass_stat_t;
+
+static bool         pass_stat_on;
+static pass_stat_t *pass_stack;    /**< flexible array of the passes */
+static size_t       pass_depth;    /**< number of running passes */
+static FILE        *trace_file;
+static double       trace_start;   /**< time the trace was started */
+static bool         trace_first;   /**< no event written to the trace yet */
+
+/** Returns true if passes are tracked at all. */
+static bool is_recording(void)
+{
+	return pass_stat_on || trace_file != NULL;
+}
+
+static void free_pass_stack(void)
+{
+	if (pass_depth == 0 && pass_stack != NULL) {
+		DEL_ARR_F(pass_stack);
+		pass_stack = NULL;
+	}
+}
+
+/** Writes @p str as the contents of a JSON string. */
+static void write_json_chars(FILE *out, const char *str)
+{
+	for (const char *c = str; *c != '\0'; ++c) {
+		unsigned char const ch = (unsigned char)*c;
+		if (ch == '"' || ch == '\\')
+			fprintf(out, "\\%c", ch);
+		else if (ch < 0x20)
+			fprintf(out, "\\u%04x", ch);
+		else
+			fputc(ch, out);
+	}
+}
+
+static void trace_pass(const char *name, ir_graph *irg, double start,
+                       double end)
+{
+	FILE *const out = trace_file;
+	fputs(trace_first ? "\n" : ",\n", out);
+	trace_first = false;
+	fputs("{\"name\":\"", out);
+	write_json_chars(out, name);
+	/* the passes run in the main thread only */
+	fprintf(out, "\",\"cat\":\"firm\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+	        "\"ts\":%.3f,\"dur\":%.3f", (start - trace_start) * 1e6,
+	        (end - start) * 1e6);
+	if (irg != NULL) {
+		char buf[256];
+		ir_snprintf(buf, sizeof(buf), "%+F", irg);
+		fputs(",\"args\":{\"irg\":\"", out);
+		write_json_chars(out, buf);
+		fputs("\"}", out);
+	}
+	fputc('}', out);
+}
+
+int ir_pass_trace_begin(const char *filename)
+{
+	ir_pass_trace_end();
+	trace_file = fopen(filename, "w");
+	if (trace_file == NULL)
+		return 0;
+	trace_start = ir_get_time_sec();
+	trace_first = true;
+	fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", trace_file);
+	return 1;
+}
+
+void ir_pass_trace_end(void)
+{
+	if (trace_file == NULL)
+		return;
+	fputs("\n]}\n", trace_file);
+	fclose(trace_file);
+	trace_file = NULL;
+	if (!is_recording())
+		free_pass_stack();
+}
+
+void ir_pass_stat_enable(int enable)
+{
+	pass_stat_on = enable != 0;
+	if (!is_recording())
+		free_pass_stack();
+}
+
+int ir_pass_stat_enabled(void)
+{
+	return pass_stat_on && stat_ev_enabled;
+}
+
+void ir_pass_stat_begin(ir_graph *irg, const char *name)
+{
+	if (!is_recording())
+		return;
+
+	if (pass_stack == NULL)
+		pass_stack = NEW_ARR_F(pass_stat_t, 0);
+	if (pass_depth == ARR_LEN(pass_stack)) {
+		pass_stat_t const stat = { NULL, NULL, 0.0, 0, 0, { 0 } };
+		ARR_APP1(pass_stat_t, pass_stack, stat);
+	}
+	if (irg == NULL && pass_depth > 0)
+		irg = pass_stack[pass_depth - 1].irg;
+
+	pass_stat_t *const stat = &pass_stack[pass_depth++];
+	stat->name         = name;
+	stat->irg          = irg;
+	stat->nodes_before = irg != NULL ? get_irg_last_idx(irg) : 0;
+	stat->heap_before  = pass_stat_on ? ir_get_heap_used_bytes() : 0;
+	ir_get_counters(stat->counters_before);
+	stat->start        = ir_get_time_sec();
+}
+
+void ir_pass_stat_end(void)
+{
+	if (!is_recording() || pass_depth == 0)
+		return;
+
+	pass_stat_t *const stat = &pass_stack[--pass_depth];
+	double const end = ir_get_time_sec();
+	unsigned long long counters[ir_timer_counter_last + 1];
+	ir_get_counters(counters);
+	if (trace_file != NULL)
+		trace_pass(stat->name, stat->irg, stat->start, end);
+	if (!pass_stat_on || !stat_ev_enabled)
+		return;
+	double const heap_delta = (double)ir_get_heap_used_bytes()
+	                        - (double)stat->heap_before;
+
+	stat_ev_ctx_push_str("pass", stat->name);
+	if (stat->irg != NULL)
+		stat_ev_ctx_push_fmt("pass_irg", "%+F", stat->irg);
+	stat_ev_dbl("pass_time", (end - stat->start) * 1e6);
+	stat_ev_dbl("pass_heap_delta", heap_delta);
+	if (ir_timer_counters_enabled()) {
+		for (ir_timer_counter_t c = ir_timer_counter_cycles;
+		     c <= ir_timer_counter_last; ++c) {
+			char buf[64];
+			snprintf(buf, sizeof(buf), "pass_%s", ir_timer_counter_name(c));
+			stat_ev_ull(buf, counters[c] - stat->counters_before[c]);
+		}
+	}
+	if (stat->irg != NULL) {
+		stat_ev_ull("pass_nodes_before", stat->nodes_before);
+		stat_ev_ull("pass_nodes_after", get_irg_last_idx(stat->irg));
+		stat_ev_ull("pass_irg_bytes", ir_get_irg_memory_total(stat->irg));
+		stat_ev_ctx_pop("pass_irg");
+	}
+	stat_ev_ctx_pop("pass");
+}
@@ -7,6 +7,9 @@
  * @file
  * @brief   platform neutral timing utilities
  */
+/* timeradd(), timersub() and syscall() are not part of C99/POSIX */
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <string.h>
 
@@ -46,17 +49,29 @@ typedef struct timeval ir_timer_val_t;
 
 #include <stddef.h>
 
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define HAVE_PERF_EVENTS
+#endif
+
+#define N_COUNTERS (ir_timer_counter_last + 1)
+
 static inline void _time_reset(ir_timer_val_t *val);
 
 /**
  * A timer.
  */
 struct ir_timer_t {
-	ir_timer_val_t elapsed;     /**< the elapsed time so far */
-	ir_timer_val_t start;       /**< the start value of the timer */
-	ir_timer_t     *parent;     /**< parent of a timer */
-	ir_timer_t     *displaced;  /**< former timer in case of timer_push */
-	unsigned       running : 1; /**< set if this timer is running */
+	ir_timer_val_t     elapsed;     /**< the elapsed time so far */
+	ir_timer_val_t     start;       /**< the start value of the timer */
+	unsigned long long counters_elapsed[N_COUNTERS]; /**< counted events */
+	unsigned long long counters_start[N_COUNTERS];   /**< counters at start */
+	ir_timer_t         *parent;     /**< parent of a timer */
+	ir_timer_t         *displaced;  /**< former timer in case of timer_push */
+	unsigned           running : 1; /**< set if this timer is running */
+	unsigned           counting : 1; /**< counters were read at start */
 };
 
 /** The top of the timer stack */
@@ -277,7 +292,12 @@ int ir_timer_leave_high_priority(void)
 #include <malloc.h>
 size_t ir_get_heap_used_bytes(void)
 {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	/* mallinfo() is deprecated as its fields overflow beyond 2GB */
+	struct mallinfo2 mi = mallinfo2();
+#else
 	struct mallinfo mi = mallinfo();
+#endif
 	return mi.uordblks;
 }
 
@@ -306,11 +326,136 @@ size_t ir_get_heap_used_bytes(void)
 
 #endif
 
+static const char *const counter_names[N_COUNTERS] = {
+	"cycles", "instructions", "cache_misses", "branch_misses"
+};
+
+const char *ir_timer_counter_name(ir_timer_counter_t counter)
+{
+	return counter_names[counter];
+}
+
+#ifdef HAVE_PERF_EVENTS
+
+/**
+ * The counters are opened as one perf event group, so all of them are read
+ * with a single system call and count over the same intervals. Counters
+ * which the CPU or the kernel does not support are left out of the group.
+ */
+static int counter_fds[N_COUNTERS];
+static int counter_slot[N_COUNTERS]; /**< position in the group or -1 */
+static int n_counter_slots;
+
+static int open_counter(unsigned long long config, int group_fd)
+{
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof(attr));
+	attr.type           = PERF_TYPE_HARDWARE;
+	attr.size           = sizeof(attr);
+	attr.config         = config;
+	attr.disabled       = group_fd == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	attr.read_format    = PERF_FORMAT_GROUP;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+int ir_timer_enable_counters(void)
+{
+	static const unsigned long long configs[N_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES,
+	};
+
+	if (n_counter_slots > 0)
+		return 1;
+
+	int leader = -1;
+	for (int i = 0; i < N_COUNTERS; ++i) {
+		int fd = open_counter(configs[i], leader);
+		counter_fds[i]  = fd;
+		counter_slot[i] = fd >= 0 ? n_counter_slots++ : -1;
+		if (leader == -1)
+			leader = fd;
+		if (leader < 0)
+			return 0;
+	}
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	return 1;
+}
+
+void ir_timer_disable_counters(void)
+{
+	if (n_counter_slots == 0)
+		return;
+	for (int i = N_COUNTERS; i-- > 0; ) {
+		if (counter_slot[i] >= 0)
+			close(counter_fds[i]);
+		counter_slot[i] = -1;
+	}
+	n_counter_slots = 0;
+}
+
+int ir_timer_counters_enabled(void)
+{
+	return n_counter_slots > 0;
+}
+
+void ir_get_counters(unsigned long long *values)
+{
+	unsigned long long buf[1 + N_COUNTERS];
+
+	memset(values, 0, N_COUNTERS * sizeof(values[0]));
+	if (n_counter_slots == 0)
+		return;
+	/* the group leader reads the number of counters followed by them */
+	if (read(counter_fds[0], buf, sizeof(buf)) < (ssize_t)sizeof(buf[0]))
+		return;
+	for (int i = 0; i < N_COUNTERS; ++i) {
+		if (counter_slot[i] >= 0 && (unsigned long long)counter_slot[i] < buf[0])
+			values[i] = buf[1 + counter_slot[i]];
+	}
+}
+
+#else
+
+int ir_timer_enable_counters(void)
+{
+	return 0;
+}
+
+void ir_timer_disable_counters(void)
+{
+}
+
+int ir_timer_counters_enabled(void)
+{
+	return 0;
+}
+
+void ir_get_counters(unsigned long long *values)
+{
+	memset(values, 0, N_COUNTERS * sizeof(values[0]));
+}
+
+#endif
+
+double ir_get_time_sec(void)
+{
+	ir_timer_val_t val;
+	_time_get(&val);
+	return _time_to_sec(&val);
+}
+
 /* reset a timer */
 void ir_timer_reset(ir_timer_t *timer)
 {
 	_time_reset(&timer->elapsed);
 	_time_reset(&timer->start);
+	memset(timer->counters_elapsed, 0, sizeof(timer->counters_elapsed));
 	timer->running = 0;
 }
 
@@ -320,6 +465,9 @@ void ir_timer_start(ir_timer_t *timer)
 	if (timer->running)
 		panic("timer started twice");
 
+	timer->counting = ir_timer_counters_enabled();
+	if (timer->counting)
+		ir_get_counters(timer->counters_start);
 	_time_reset(&timer->start);
 	_time_get(&timer->start);
 	timer->running = 1;
@@ -352,6 +500,13 @@ void ir_timer_stop(ir_timer_t *timer)
 	_time_get(&val);
 	timer->running = 0;
 	_time_add(&timer->elapsed, &timer->elapsed, _time_sub(&tgt, &val, &timer->start));
+
+	if (timer->counting && ir_timer_counters_enabled()) {
+		unsigned long long counters[N_COUNTERS];
+		ir_get_counters(counters);
+		for (int i = 0; i < N_COUNTERS; ++i)
+			timer->counters_elapsed[i] += counters[i] - timer->counters_start[i];
+	}
 }
 
 void ir_timer_init_parent(ir_timer_t *timer)
@@ -444,3 +599,15 @@ double ir_timer_elapsed_sec(const ir_timer_t *timer)
 	}
 	return _time_to_sec(elapsed);
 }
+
+unsigned long long ir_timer_elapsed_counter(const ir_timer_t *timer,
+                                            ir_timer_counter_t counter)
+{
+	unsigned long long res = timer->counters_elapsed[counter];
+	if (timer->running && timer->counting && ir_timer_counters_enabled()) {
+		unsigned long long counters[N_COUNTERS];
+		ir_get_counters(counters);
+		res += counters[counter] - timer->counters_start[counter];
+	}
+	return res;
+}
@@ -9,11 +9,17 @@
  * @author   Goetz Lindenmaier, Michael Beck
  * @date     2001
  */
+#include <string.h>
+
 #include "dbginfo_t.h"
 #include "irnode_t.h"
 #include "type_t.h"
 #include "entity_t.h"
 #include "error.h"
+#include "array.h"
+#include "hashptr.h"
+#include "pmap.h"
+#include "util.h"
 
 merge_pair_func *__dbg_info_merge_pair = default_dbg_info_merge_pair;
 merge_sets_func *__dbg_info_merge_sets = default_dbg_info_merge_sets;
@@ -95,9 +101,86 @@ static src_loc_t default_retrieve_dbg(dbg_info const *const dbg)
 static retrieve_dbg_func      retrieve_dbg      = default_retrieve_dbg;
 static retrieve_type_dbg_func retrieve_type_dbg = NULL;
 
+/** number of entries of the direct mapped location cache, a power of 2 */
+#define LOC_CACHE_SIZE 4096
+
+typedef struct loc_cache_entry_t {
+	const dbg_info   *dbg;
+	packed_src_loc_t  loc;
+} loc_cache_entry_t;
+
+static loc_cache_entry_t loc_cache[LOC_CACHE_SIZE];
+static pmap             *file_ids;   /**< file name -> file id */
+static const char      **file_names; /**< file id - 1 -> file name */
+
+static void clear_loc_cache(void)
+{
+	memset(loc_cache, 0, sizeof(loc_cache));
+}
+
 void ir_set_debug_retrieve(retrieve_dbg_func func)
 {
 	retrieve_dbg = func ? func : default_retrieve_dbg;
+	clear_loc_cache();
+}
+
+static unsigned get_file_id(const char *file)
+{
+	if (file_ids == NULL) {
+		file_ids   = pmap_create();
+		file_names = NEW_ARR_F(const char*, 0);
+	}
+	unsigned id = PTR_TO_INT(pmap_get(void, file_ids, file));
+	if (id == 0) {
+		ARR_APP1(const char*, file_names, file);
+		id = (unsigned)ARR_LEN(file_names);
+		if (id > 0xFFFF)
+			panic("too many source files for packed source locations");
+		pmap_insert(file_ids, file, INT_TO_PTR(id));
+	}
+	return id;
+}
+
+packed_src_loc_t ir_retrieve_packed_dbg_info(const dbg_info *dbg)
+{
+	if (dbg == NULL)
+		return 0;
+
+	loc_cache_entry_t *entry
+		= &loc_cache[hash_ptr(dbg) & (LOC_CACHE_SIZE - 1)];
+	if (entry->dbg == dbg)
+		return entry->loc;
+
+	src_loc_t        const src = retrieve_dbg(dbg);
+	packed_src_loc_t       loc = 0;
+	if (src.file != NULL) {
+		unsigned const column = MIN(src.column, 0xFFFFu);
+		loc = (packed_src_loc_t)get_file_id(src.file) << 48
+		    | (packed_src_loc_t)column << 32
+		    | src.line;
+	}
+	entry->dbg = dbg;
+	entry->loc = loc;
+	return loc;
+}
+
+const char *ir_get_src_file(unsigned file_id)
+{
+	if (file_id == 0)
+		return NULL;
+	assert(file_id <= ARR_LEN(file_names));
+	return file_names[file_id - 1];
+}
+
+void finish_dbg_info(void)
+{
+	if (file_ids != NULL) {
+		pmap_destroy(file_ids);
+		DEL_ARR_F(file_names);
+		file_ids   = NULL;
+		file_names = NULL;
+	}
+	clear_loc_cache();
 }
 
 src_loc_t ir_retrieve_dbg_info(dbg_info const *const dbg)
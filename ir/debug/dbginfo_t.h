@@ -16,6 +16,7 @@
 #ifndef FIRM_DEBUG_DBGINFO_T_H
 #define FIRM_DEBUG_DBGINFO_T_H
 
+#include <stdint.h>
 #include <stdlib.h>
 #include "dbginfo.h"
 
@@ -56,4 +57,42 @@ extern merge_sets_func *__dbg_info_merge_sets;
 
 void ir_dbg_info_snprint(char *buf, size_t buf_size, const dbg_info *dbg);
 
+/**
+ * A source location packed into 64 bits: the file id in the upper 16 bits,
+ * the column in the next 16 bits and the line in the lower 32 bits. File ids
+ * start at 1, a location without file is 0. Columns beyond 0xFFFF are
+ * saturated.
+ */
+typedef uint64_t packed_src_loc_t;
+
+/**
+ * Retrieves the source location of @p dbg in packed form.
+ *
+ * The results are cached, so the retrieve function of the frontend is only
+ * called once for repeated queries. This assumes the location of a dbg_info
+ * does not change while it is in use.
+ */
+packed_src_loc_t ir_retrieve_packed_dbg_info(const dbg_info *dbg);
+
+/** Returns the file name of a file id of a packed source location. */
+const char *ir_get_src_file(unsigned file_id);
+
+static inline unsigned packed_src_loc_file_id(packed_src_loc_t loc)
+{
+	return (unsigned)(loc >> 48);
+}
+
+static inline unsigned packed_src_loc_column(packed_src_loc_t loc)
+{
+	return (unsigned)(loc >> 32) & 0xFFFF;
+}
+
+static inline unsigned packed_src_loc_line(packed_src_loc_t loc)
+{
+	return (unsigned)loc;
+}
+
+/** Frees the source location tables. */
+void finish_dbg_info(void);
+
 #endif
@@ -7,8 +7,18 @@
  * @file
  * @brief     Hash table to store names.
  * @author    Goetz Lindenmaier
+ *
+ * Identifiers are kept in an open addressing hash table split into
+ * ID_N_SHARDS independent shards. The shard is selected by the upper bits of
+ * the hash value, the bucket inside the shard by the lower bits. The string
+ * data itself lives in an obstack so the pointer returned by get_id_str()
+ * never changes once an ident has been created, no matter how often the
+ * tables get resized. Sharding keeps rehashing pauses short and gives each
+ * part of the table its own independent state so that it can be protected by
+ * its own lock.
  */
 #include <assert.h>
+#include <stdbool.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
@@ -16,23 +26,104 @@
 #include <stdlib.h>
 
 #include "ident_t.h"
-#include "set.h"
+#include "obst.h"
 #include "xmalloc.h"
 #include "hashptr.h"
 
-static set *id_set;
+/** log2 of the number of shards of the ident table */
+#define ID_SHARD_BITS 4
+/** number of shards of the ident table */
+#define ID_N_SHARDS   (1u << ID_SHARD_BITS)
+
+/** Key used to lookup an ident. */
+typedef struct ident_key_t {
+	const char *str;
+	size_t      len;
+	unsigned    hash;
+} ident_key_t;
+
+/**
+ * Every ident string in the arena is preceded by its length, so comparisons
+ * do not need to walk the string.
+ */
+static inline size_t get_id_len(const char *id)
+{
+	size_t len;
+	memcpy(&len, id - sizeof(len), sizeof(len));
+	return len;
+}
+
+static inline bool id_equals(const char *id, const ident_key_t *key)
+{
+	return get_id_len(id) == key->len && memcmp(id, key->str, key->len) == 0;
+}
+
+static char *id_store(struct obstack *obst, const ident_key_t *key)
+{
+	size_t const len = key->len;
+	obstack_grow(obst, &len, sizeof(len));
+	obstack_grow0(obst, key->str, len);
+	char *const res = (char*)obstack_finish(obst);
+	return res + sizeof(len);
+}
+
+#define HashSet                   ident_shard_t
+#define ValueType                 char*
+#define ADDITIONAL_DATA           struct obstack *obst;
+#include "hashset.h"
+#undef ADDITIONAL_DATA
+#undef ValueType
+#undef HashSet
+
+typedef struct ident_shard_t ident_shard_t;
+
+#define HashSet                   ident_shard_t
+#define ValueType                 char*
+#define NullValue                 NULL
+#define DeletedValue              ((char*)-1)
+#define KeyType                   const ident_key_t*
+#define ConstKeyType              KeyType
+#define GetKey(value)             (value)
+#define InitData(self,value,key)  (value) = id_store((self)->obst, (key))
+#define Hash(self,key)            ((key)->hash)
+#define KeysEqual(self,id,key)    id_equals((id), (key))
+#define SCALAR_RETURN
+#define SetRangeEmpty(ptr,size)   memset(ptr, 0, (size) * sizeof(HashSetEntry))
+#define hashset_init_size         ident_shard_init_size
+#define hashset_destroy           ident_shard_destroy
+#define hashset_insert            ident_shard_insert
+
+static void ident_shard_init_size(ident_shard_t *shard, size_t expected_elems);
+static void ident_shard_destroy(ident_shard_t *shard);
+static char *ident_shard_insert(ident_shard_t *shard, const ident_key_t *key);
+
+#include "hashset.c.inl"
+
+static struct obstack id_obst;
+static ident_shard_t  id_shards[ID_N_SHARDS];
+
+static inline ident_shard_t *get_shard(unsigned hash)
+{
+	return &id_shards[hash >> (sizeof(hash) * 8 - ID_SHARD_BITS)];
+}
 
 void init_ident(void)
 {
-	/* it's ok to use memcmp here, we check only strings */
-	id_set = new_set(memcmp, 128);
+	obstack_init(&id_obst);
+	for (unsigned i = 0; i < ID_N_SHARDS; ++i) {
+		ident_shard_t *shard = &id_shards[i];
+		ident_shard_init_size(shard, 128);
+		shard->obst = &id_obst;
+	}
 }
 
 ident *new_id_from_chars(const char *str, size_t len)
 {
-	unsigned   hash   = hash_data((const unsigned char*)str, len);
-	set_entry *result = set_hinsert0(id_set, str, len, hash);
-	return (ident*)result->dptr;
+	ident_key_t key;
+	key.str  = str;
+	key.len  = len;
+	key.hash = hash_data((const unsigned char*)str, len);
+	return ident_shard_insert(get_shard(key.hash), &key);
 }
 
 ident *new_id_from_str(const char *str)
@@ -48,16 +139,25 @@ const char *(get_id_str)(ident *id)
 
 void finish_ident(void)
 {
-	del_set(id_set);
-	id_set = NULL;
+	for (unsigned i = 0; i < ID_N_SHARDS; ++i) {
+		ident_shard_destroy(&id_shards[i]);
+	}
+	obstack_free(&id_obst, NULL);
 }
 
+/** the number of the next ident made by id_unique() */
+static unsigned unique_id = 0;
+
 ident *id_unique(const char *tag)
 {
-	static unsigned unique_id = 0;
 	char buf[256];
 
 	snprintf(buf, sizeof(buf), tag, unique_id);
 	unique_id++;
 	return new_id_from_str(buf);
 }
+
+void reset_id_unique(void)
+{
+	unique_id = 0;
+}
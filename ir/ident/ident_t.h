@@ -30,6 +30,12 @@ void init_ident(void);
  */
 void finish_ident(void);
 
+/**
+ * Restarts the numbering of id_unique(), so the names in a new program do not
+ * depend on the programs created before it.
+ */
+void reset_id_unique(void);
+
 /** initializes the name mangling code */
 void firm_init_mangle(void);
 
@@ -14,6 +14,8 @@
  * Implements Division and Modulo by Consts from "Hackers Delight",
  */
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 #include <assert.h>
 
 #include "irnode_t.h"
@@ -29,8 +31,9 @@
 #include "irflag_t.h"
 #include "irhooks.h"
 #include "ircons.h"
-#include "irarch.h"
+#include "irarch_t.h"
 #include "irflag.h"
+#include "pmap.h"
 #include "be.h"
 #include "error.h"
 
@@ -59,14 +62,15 @@ struct instruction {
 	instruction *in[2];      /**< the ins */
 	unsigned    shift_count; /**< shift count for LEA and SHIFT */
 	ir_node     *irn;        /**< the generated node for this instruction if any. */
-	int         costs;       /**< the costs for this instruction */
+	int         costs;       /**< the latency of the longest path from the
+	                              root to the result of this instruction */
 };
 
 /**
  * The environment for the strength reduction of multiplications.
  */
 typedef struct mul_env {
-	struct obstack obst;       /**< an obstack for local space. */
+	struct obstack *obst;      /**< the obstack for the instructions */
 	const ir_settings_arch_dep_t *params;
 	ir_mode        *mode;      /**< the mode of the multiplication constant */
 	unsigned       bits;       /**< number of bits in the mode */
@@ -79,10 +83,26 @@ typedef struct mul_env {
 	ir_mode        *shf_mode;  /**< the (unsigned) mode for the shift constants */
 	int            fail;       /**< set to 1 if the instruction sequence fails the constraints */
 	int            n_shift;    /**< maximum number of allowed shift instructions */
-
-	evaluate_costs_func evaluate;  /**< the evaluate callback */
+	bool           use_subs;   /**< use the complementary technique */
+	int            total;      /**< sum of the costs of the instructions */
+	const int     *costs;      /**< the costs of the instruction kinds */
 } mul_env;
 
+/**
+ * A cached decomposition of a multiplication by a constant. It is only valid
+ * for the backend parameters and instruction costs it was computed with.
+ */
+typedef struct mul_decomposition {
+	const ir_settings_arch_dep_t *params;
+	int          costs[MUL + 1]; /**< the costs of the instruction kinds */
+	instruction *root;           /**< the multiplied value */
+	instruction *inst;           /**< the decomposition, NULL if the Mul is
+	                                  cheaper */
+} mul_decomposition;
+
+static struct obstack mul_obst;  /**< holds the cached decompositions */
+static pmap          *mul_cache; /**< maps constants to decompositions */
+
 /**
  * Some kind of default evaluator. Return the cost of
  * instructions.
@@ -102,7 +122,7 @@ static int default_evaluate(insn_kind kind, const ir_mode *mode, ir_tarval *tv)
  */
 static instruction *emit_LEA(mul_env *env, instruction *a, instruction *b, unsigned shift)
 {
-	instruction *res = OALLOC(&env->obst, instruction);
+	instruction *res = OALLOC(env->obst, instruction);
 	res->kind = shift > 0 ? LEA : ADD;
 	res->in[0] = a;
 	res->in[1] = b;
@@ -117,7 +137,7 @@ static instruction *emit_LEA(mul_env *env, instruction *a, instruction *b, unsig
  */
 static instruction *emit_SHIFT(mul_env *env, instruction *a, unsigned shift)
 {
-	instruction *res = OALLOC(&env->obst, instruction);
+	instruction *res = OALLOC(env->obst, instruction);
 	if (shift == env->bits) {
 		/* a 2^bits with bits resolution is a zero */
 		res->kind = ZERO;
@@ -145,7 +165,7 @@ static instruction *emit_SHIFT(mul_env *env, instruction *a, unsigned shift)
  */
 static instruction *emit_SUB(mul_env *env, instruction *a, instruction *b)
 {
-	instruction *res = OALLOC(&env->obst, instruction);
+	instruction *res = OALLOC(env->obst, instruction);
 	res->kind = SUB;
 	res->in[0] = a;
 	res->in[1] = b;
@@ -160,7 +180,7 @@ static instruction *emit_SUB(mul_env *env, instruction *a, instruction *b)
  */
 static instruction *emit_ROOT(mul_env *env, ir_node *root_op)
 {
-	instruction *res = OALLOC(&env->obst, instruction);
+	instruction *res = OALLOC(env->obst, instruction);
 	res->kind = ROOT;
 	res->in[0] = NULL;
 	res->in[1] = NULL;
@@ -180,7 +200,7 @@ static unsigned char *value_to_condensed(mul_env *env, ir_tarval *tv, int *pr)
 	int     bits = get_mode_size_bits(mode);
 	char    *bitstr = get_tarval_bitpattern(tv);
 	int     i, l, r;
-	unsigned char *R = (unsigned char*)obstack_alloc(&env->obst, bits);
+	unsigned char *R = (unsigned char*)obstack_alloc(env->obst, bits);
 
 	l = r = 0;
 	for (i = 0; bitstr[i] != '\0'; ++i) {
@@ -224,7 +244,7 @@ static int calculate_gain(unsigned char *R, int r)
  */
 static unsigned char *complement_condensed(mul_env *env, unsigned char *R, int r, int gain, int *prs)
 {
-	unsigned char *value = (unsigned char*)obstack_alloc(&env->obst, env->bits);
+	unsigned char *value = (unsigned char*)obstack_alloc(env->obst, env->bits);
 	int i, l, j;
 	unsigned char c;
 
@@ -322,7 +342,7 @@ static instruction *decompose_mul(mul_env *env, unsigned char *R, int r, ir_tarv
 	if (r <= 2)
 		return decompose_simple_cases(env, R, r, N);
 
-	if (env->params->also_use_subs) {
+	if (env->use_subs) {
 		gain = calculate_gain(R, r);
 		if (gain > 0) {
 			instruction *instr1, *instr2;
@@ -331,7 +351,7 @@ static instruction *decompose_mul(mul_env *env, unsigned char *R, int r, ir_tarv
 
 			R1 = complement_condensed(env, R, r, gain, &r1);
 			r2 = r - gain + 1;
-			R2 = (unsigned char*)obstack_alloc(&env->obst, r2);
+			R2 = (unsigned char*)obstack_alloc(env->obst, r2);
 
 			k = 1;
 			for (i = 0; i < gain; ++i) {
@@ -447,7 +467,20 @@ static ir_node *build_graph(mul_env *env, instruction *inst)
 }
 
 /**
- * Calculate the costs for the given instruction sequence.
+ * Resets the nodes built for a cached instruction sequence.
+ */
+static void clear_graph(instruction *inst)
+{
+	if (inst == NULL || inst->kind == ROOT || inst->irn == NULL)
+		return;
+	inst->irn = NULL;
+	clear_graph(inst->in[0]);
+	clear_graph(inst->in[1]);
+}
+
+/**
+ * Calculate the latency of the critical path of the given instruction
+ * sequence and sum up the costs of its instructions in env->total.
  * Note that additional costs due to higher register pressure are NOT evaluated yet
  */
 static int evaluate_insn(mul_env *env, instruction *inst)
@@ -456,18 +489,20 @@ static int evaluate_insn(mul_env *env, instruction *inst)
 
 	if (inst->costs >= 0) {
 		/* was already evaluated */
-		return 0;
+		return inst->costs;
 	}
 
 	switch (inst->kind) {
 	case LEA:
 	case SUB:
-	case ADD:
-		costs  = evaluate_insn(env, inst->in[0]);
-		costs += evaluate_insn(env, inst->in[1]);
-		costs += env->evaluate(inst->kind, env->mode, NULL);
-		inst->costs = costs;
-		return costs;
+	case ADD: {
+		int const latency0 = evaluate_insn(env, inst->in[0]);
+		int const latency1 = evaluate_insn(env, inst->in[1]);
+		costs        = env->costs[inst->kind];
+		env->total  += costs;
+		inst->costs  = IMAX(latency0, latency1) + costs;
+		return inst->costs;
+	}
 	case SHIFT:
 		if (inst->shift_count > env->params->highest_shift_amount)
 			env->fail = 1;
@@ -475,12 +510,14 @@ static int evaluate_insn(mul_env *env, instruction *inst)
 			env->fail = 1;
 		else
 			--env->n_shift;
-		costs  = evaluate_insn(env, inst->in[0]);
-		costs += env->evaluate(inst->kind, env->mode, NULL);
-		inst->costs = costs;
-		return costs;
+		costs        = env->costs[inst->kind];
+		env->total  += costs;
+		inst->costs  = evaluate_insn(env, inst->in[0]) + costs;
+		return inst->costs;
 	case ZERO:
-		inst->costs = costs = env->evaluate(inst->kind, env->mode, NULL);
+		costs        = env->costs[inst->kind];
+		env->total  += costs;
+		inst->costs  = costs;
 		return costs;
 	case MUL:
 	case ROOT:
@@ -490,8 +527,99 @@ static int evaluate_insn(mul_env *env, instruction *inst)
 }
 
 /**
- * Evaluate the replacement instructions and build a new graph
- * if faster than the Mul.
+ * Decomposes the multiplication by @p tv with and without the complementary
+ * technique and returns the sequence with the shortest critical path if it
+ * beats the Mul, NULL otherwise.
+ */
+static instruction *find_decomposition(mul_env *env, ir_tarval *tv,
+                                       int mul_costs)
+{
+	/* the paper suggests 70% here */
+	int const max_latency = (mul_costs * 7 + 5) / 10;
+
+	instruction *best         = NULL;
+	int          best_latency = 0;
+	int          best_total   = 0;
+	for (int use_subs = env->params->also_use_subs; use_subs >= 0; --use_subs) {
+		int            r;
+		unsigned char *R = value_to_condensed(env, tv, &r);
+
+		env->use_subs = use_subs;
+		env->fail     = 0;
+		env->n_shift  = env->params->maximum_shifts;
+		env->total    = 0;
+		instruction *inst    = decompose_mul(env, R, r, tv);
+		int          latency = evaluate_insn(env, inst);
+
+		/* the sequence must not issue more work than the Mul either */
+		if (env->fail || latency > max_latency || env->total > mul_costs)
+			continue;
+		if (best == NULL || latency < best_latency
+		    || (latency == best_latency && env->total < best_total)) {
+			best         = inst;
+			best_latency = latency;
+			best_total   = env->total;
+		}
+	}
+	return best;
+}
+
+/**
+ * Returns the decomposition of a multiplication by @p tv for the current
+ * backend. Decompositions are cached per constant, and tarvals are unique
+ * for a value and mode.
+ */
+static mul_decomposition *get_decomposition(ir_tarval *tv)
+{
+	const ir_settings_arch_dep_t *params = be_get_backend_param()->dep_param;
+	evaluate_costs_func evaluate = params->evaluate != NULL
+		? params->evaluate : default_evaluate;
+	ir_mode *mode = get_tarval_mode(tv);
+
+	int costs[MUL + 1];
+	for (insn_kind kind = LEA; kind < MUL; ++kind)
+		costs[kind] = evaluate(kind, mode, NULL);
+	costs[MUL] = evaluate(MUL, mode, tv);
+
+	if (mul_cache == NULL) {
+		obstack_init(&mul_obst);
+		mul_cache = pmap_create();
+	}
+	mul_decomposition *decomp = pmap_get(mul_decomposition, mul_cache, tv);
+	if (decomp != NULL && decomp->params == params
+	    && memcmp(decomp->costs, costs, sizeof(costs)) == 0)
+		return decomp;
+
+	mul_env env;
+	env.obst   = &mul_obst;
+	env.params = params;
+	env.mode   = mode;
+	env.bits   = (unsigned)get_mode_size_bits(mode);
+	env.max_S  = 3;
+	env.root   = emit_ROOT(&env, NULL);
+	env.costs  = costs;
+
+	decomp = OALLOC(&mul_obst, mul_decomposition);
+	decomp->params = params;
+	memcpy(decomp->costs, costs, sizeof(costs));
+	decomp->root = env.root;
+	decomp->inst = find_decomposition(&env, tv, costs[MUL]);
+	pmap_insert(mul_cache, tv, decomp);
+	return decomp;
+}
+
+void firm_finish_arch_dep(void)
+{
+	if (mul_cache == NULL)
+		return;
+	pmap_destroy(mul_cache);
+	mul_cache = NULL;
+	obstack_free(&mul_obst, NULL);
+}
+
+/**
+ * Build the cached decomposition of the multiplication by @p tv if it is
+ * faster than the Mul.
  * Returns the root of the new graph then or irn otherwise.
  *
  * @param irn      the Mul operation
@@ -502,40 +630,24 @@ static int evaluate_insn(mul_env *env, instruction *inst)
  */
 static ir_node *do_decomposition(ir_node *irn, ir_node *operand, ir_tarval *tv)
 {
-	mul_env       env;
-	instruction   *inst;
-	unsigned char *R;
-	int           r;
-	ir_node       *res = irn;
-	int           mul_costs;
-
-	obstack_init(&env.obst);
-	env.params   = be_get_backend_param()->dep_param;
+	mul_decomposition *decomp = get_decomposition(tv);
+	if (decomp->inst == NULL)
+		return irn;
+
+	mul_env env;
 	env.mode     = get_tarval_mode(tv);
-	env.bits     = (unsigned)get_mode_size_bits(env.mode);
-	env.max_S    = 3;
-	env.root     = emit_ROOT(&env, operand);
-	env.fail     = 0;
-	env.n_shift  = env.params->maximum_shifts;
-	env.evaluate = env.params->evaluate != NULL ? env.params->evaluate : default_evaluate;
 	env.irg      = get_irn_irg(irn);
-
-	R = value_to_condensed(&env, tv, &r);
-	inst = decompose_mul(&env, R, r, tv);
-
-	/* the paper suggests 70% here */
-	mul_costs = (env.evaluate(MUL, env.mode, tv) * 7 + 5) / 10;
-	if (evaluate_insn(&env, inst) <= mul_costs && !env.fail) {
-		env.op       = operand;
-		env.blk      = get_nodes_block(irn);
-		env.dbg      = get_irn_dbg_info(irn);
-		env.shf_mode = find_unsigned_mode(env.mode);
-		if (env.shf_mode == NULL)
-			env.shf_mode = mode_Iu;
-
-		res = build_graph(&env, inst);
-	}
-	obstack_free(&env.obst, NULL);
+	env.op       = operand;
+	env.blk      = get_nodes_block(irn);
+	env.dbg      = get_irn_dbg_info(irn);
+	env.shf_mode = find_unsigned_mode(env.mode);
+	if (env.shf_mode == NULL)
+		env.shf_mode = mode_Iu;
+
+	decomp->root->irn = operand;
+	ir_node *res = build_graph(&env, decomp->inst);
+	clear_graph(decomp->inst);
+	decomp->root->irn = NULL;
 	return res;
 }
 
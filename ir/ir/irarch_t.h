@@ -0,0 +1,18 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Machine dependent Firm optimizations -- private header.
+ */
+#ifndef FIRM_IR_IRARCH_T_H
+#define FIRM_IR_IRARCH_T_H
+
+#include "irarch.h"
+
+/** Frees the cached decompositions of multiplications by constants. */
+void firm_finish_arch_dep(void);
+
+#endif
@@ -152,39 +152,104 @@ static inline ir_node *new_rd_Phi0(dbg_info *dbgi, ir_node *block,
 
 static ir_node *get_r_value_internal(ir_node *block, int pos, ir_mode *mode);
 
-static void try_remove_unnecessary_phi(ir_node *phi)
+/**
+ * Returns the current definition of value @p pos in @p block or NULL if the
+ * value has not been defined or looked up in the block yet.
+ */
+static ir_node *get_block_value(const ir_node *block, int pos)
 {
-	ir_node *phi_value = NULL;
-	int      arity     = get_irn_arity(phi);
-	int      i;
+	const block_values_t *values = block->attr.block.values;
+	if (values == NULL)
+		return NULL;
 
-	/* see if all inputs are either pointing to a single value or
-	 * are self references */
-	for (i = 0; i < arity; ++i) {
-		ir_node *in = get_irn_n(phi, i);
-		if (in == phi)
-			continue;
-		if (in == phi_value)
-			continue;
-		/** found a different value from the one we already found, can't remove
-		 * the phi (yet) */
-		if (phi_value != NULL)
+	/* value numbers are dense, so they are their own hash */
+	for (unsigned i = (unsigned)pos & values->mask;;
+	     i = (i + 1) & values->mask) {
+		const block_value_t *entry = &values->entries[i];
+		if (entry->pos == pos)
+			return entry->value;
+		if (entry->pos < 0)
+			return NULL;
+	}
+}
+
+static void insert_block_value(block_values_t *values, int pos, ir_node *value)
+{
+	for (unsigned i = (unsigned)pos & values->mask;;
+	     i = (i + 1) & values->mask) {
+		block_value_t *entry = &values->entries[i];
+		if (entry->pos == pos) {
+			entry->value = value;
 			return;
-		phi_value = in;
+		}
+		if (entry->pos < 0) {
+			entry->pos   = pos;
+			entry->value = value;
+			++values->n_used;
+			return;
+		}
 	}
-	if (phi_value == NULL)
-		return;
+}
 
-	/* if we're here then all phi inputs have been either phi_value
-	 * or self-references, we can replace the phi by phi_value.
-	 * We do this with an Id-node */
-	exchange(phi, phi_value);
+/**
+ * Sets the current definition of value @p pos in @p block. The value map is
+ * kept at most three quarters full and grows on the graph obstack.
+ */
+static void set_block_value(ir_node *block, int pos, ir_node *value)
+{
+	block_values_t *values = block->attr.block.values;
+	if (values == NULL || 4 * (values->n_used + 1) > 3 * (values->mask + 1)) {
+		unsigned const  n_slots    = values != NULL ? 2 * (values->mask + 1) : 8;
+		ir_graph *const irg        = get_Block_irg(block);
+		block_values_t *new_values = OALLOCF(get_irg_obstack(irg),
+		                                     block_values_t, entries, n_slots);
+		new_values->n_used = 0;
+		new_values->mask   = n_slots - 1;
+		for (unsigned i = 0; i < n_slots; ++i)
+			new_values->entries[i].pos = -1;
+		if (values != NULL) {
+			for (unsigned i = 0; i <= values->mask; ++i) {
+				const block_value_t *entry = &values->entries[i];
+				if (entry->pos >= 0)
+					insert_block_value(new_values, entry->pos, entry->value);
+			}
+		}
+		block->attr.block.values = values = new_values;
+	}
+	insert_block_value(values, pos, value);
+}
+
+static void try_remove_unnecessary_phi(ir_node *phi)
+{
+	/* Removing a Phi may make its value an unnecessary Phi, for example the
+	 * one in a loop header if we were the last Phi of the loop body, so
+	 * continue with the value until a necessary Phi or another node is
+	 * found. */
+	while (is_Phi(phi)) {
+		ir_node *phi_value = NULL;
+
+		/* see if all inputs are either pointing to a single value or
+		 * are self references */
+		for (int i = 0, arity = get_irn_arity(phi); i < arity; ++i) {
+			ir_node *in = get_irn_n(phi, i);
+			if (in == phi)
+				continue;
+			if (in == phi_value)
+				continue;
+			/** found a different value from the one we already found, can't
+			 * remove the phi (yet) */
+			if (phi_value != NULL)
+				return;
+			phi_value = in;
+		}
+		if (phi_value == NULL)
+			return;
 
-	/* recursively check phi_value, because it could be that we were the last
-	 * phi-node in a loop-body. Then our arguments is an unnecessary phi in
-	 * the loop header which can be eliminated now */
-	if (is_Phi(phi_value)) {
-		try_remove_unnecessary_phi(phi_value);
+		/* if we're here then all phi inputs have been either phi_value
+		 * or self-references, we can replace the phi by phi_value.
+		 * We do this with an Id-node */
+		exchange(phi, phi_value);
+		phi = phi_value;
 	}
 }
 
@@ -227,21 +292,13 @@ static ir_node *set_phi_arguments(ir_node *phi, int pos)
 }
 
 /**
- * This function returns the last definition of a value.  In case
- * this value was last defined in a previous block, Phi nodes are
- * inserted.  If the part of the firm graph containing the definition
- * is not yet constructed, a dummy Phi node is returned.
- *
- * @param block   the current block
- * @param pos     the value number of the value searched
- * @param mode    the mode of this value (needed for Phi construction)
+ * Determines the definition of a value in a block without a definition
+ * that is immature, has no or several predecessors or a Bad predecessor.
  */
-static ir_node *get_r_value_internal(ir_node *block, int pos, ir_mode *mode)
+static ir_node *get_r_value_new(ir_node *block, int pos, ir_mode *mode)
 {
-	ir_node  *res = block->attr.block.graph_arr[pos];
+	ir_node  *res;
 	ir_graph *irg = get_irn_irg(block);
-	if (res != NULL)
-		return res;
 
 	/* in a matured block we can immediately determine the phi arguments */
 	if (get_Block_matured(block)) {
@@ -261,21 +318,16 @@ static ir_node *get_r_value_internal(ir_node *block, int pos, ir_mode *mode)
 				/* unreachable block, use Bad */
 				res = new_r_Bad(irg, mode);
 			}
-		/* one predecessor just use its value */
+		/* one Bad predecessor: unreachable */
 		} else if (arity == 1) {
-			ir_node *cfgpred = get_Block_cfgpred(block, 0);
-			if (is_Bad(cfgpred)) {
-				res = new_r_Bad(irg, mode);
-			} else {
-				ir_node *cfgpred_block = get_nodes_block(cfgpred);
-				res = get_r_value_internal(cfgpred_block, pos, mode);
-			}
+			assert(is_Bad(get_Block_cfgpred(block, 0)));
+			res = new_r_Bad(irg, mode);
 		/* multiple predecessors construct Phi */
 		} else {
 			res = new_rd_Phi0(NULL, block, mode, pos);
 			/* enter phi0 into our variable value table to break cycles
 			 * arising from set_phi_arguments */
-			block->attr.block.graph_arr[pos] = res;
+			set_block_value(block, pos, res);
 			res = set_phi_arguments(res, pos);
 		}
 	} else {
@@ -285,7 +337,46 @@ static ir_node *get_r_value_internal(ir_node *block, int pos, ir_mode *mode)
 		res->attr.phi.next     = block->attr.block.phis;
 		block->attr.block.phis = res;
 	}
-	block->attr.block.graph_arr[pos] = res;
+	set_block_value(block, pos, res);
+	return res;
+}
+
+/**
+ * This function returns the last definition of a value.  In case
+ * this value was last defined in a previous block, Phi nodes are
+ * inserted.  If the part of the firm graph containing the definition
+ * is not yet constructed, a dummy Phi node is returned.
+ *
+ * @param block   the current block
+ * @param pos     the value number of the value searched
+ * @param mode    the mode of this value (needed for Phi construction)
+ */
+static ir_node *get_r_value_internal(ir_node *block, int pos, ir_mode *mode)
+{
+	ir_node *res = get_block_value(block, pos);
+	if (res != NULL)
+		return res;
+
+	/* follow chains of matured blocks with a single predecessor iteratively,
+	 * they just use the value of their predecessor */
+	ir_node *top = block;
+	while (get_Block_matured(top) && get_irn_arity(top) == 1) {
+		ir_node *cfgpred = get_Block_cfgpred(top, 0);
+		if (is_Bad(cfgpred))
+			break;
+		top = get_nodes_block(cfgpred);
+		res = get_block_value(top, pos);
+		if (res != NULL)
+			break;
+	}
+	if (res == NULL)
+		res = get_r_value_new(top, pos, mode);
+
+	/* remember the value in all blocks of the chain */
+	for (ir_node *b = block; b != top;
+	     b = get_nodes_block(get_Block_cfgpred(b, 0))) {
+		set_block_value(b, pos, res);
+	}
 	return res;
 }
 
@@ -312,8 +403,8 @@ void mature_immBlock(ir_node *block)
 
 		next = phi->attr.phi.next;
 		new_value = set_phi_arguments(phi, pos);
-		if (block->attr.block.graph_arr[pos] == phi) {
-			block->attr.block.graph_arr[pos] = new_value;
+		if (get_block_value(block, pos) == phi) {
+			set_block_value(block, pos, new_value);
 		}
 	}
 
@@ -423,9 +514,6 @@ ir_node *new_rd_immBlock(dbg_info *dbgi, ir_graph *irg)
 
 	set_Block_block_visited(res, 0);
 
-	/* Create and initialize array for Phi-node construction. */
-	res->attr.block.graph_arr = NEW_ARR_DZ(ir_node*, get_irg_obstack(irg), irg->n_loc);
-
 	/* Immature block may not be optimized! */
 	verify_new_node(irg, res);
 
@@ -511,7 +599,7 @@ static ir_mode *guess_recursively(ir_node *block, int pos)
 		return NULL;
 
 	/* already have a defintion -> we can simply look at its mode */
-	value = block->attr.block.graph_arr[pos];
+	value = get_block_value(block, pos);
 	if (value != NULL)
 		return get_irn_mode(value);
 
@@ -531,7 +619,7 @@ static ir_mode *guess_recursively(ir_node *block, int pos)
 ir_mode *ir_r_guess_mode(ir_graph *irg, int pos)
 {
 	ir_node  *block = irg->current_block;
-	ir_node  *value = block->attr.block.graph_arr[pos+1];
+	ir_node  *value = get_block_value(block, pos+1);
 	ir_mode  *mode;
 
 	/* already have a defintion -> we can simply look at its mode */
@@ -557,7 +645,7 @@ void set_r_value(ir_graph *irg, int pos, ir_node *value)
 	assert(pos >= 0);
 	assert(pos+1 < irg->n_loc);
 	assert(is_ir_node(value));
-	irg->current_block->attr.block.graph_arr[pos + 1] = value;
+	set_block_value(irg->current_block, pos + 1, value);
 }
 
 void set_value(int pos, ir_node *value)
@@ -611,7 +699,7 @@ void set_r_store(ir_graph *irg, ir_node *store)
 			}
 		}
 	}
-	irg->current_block->attr.block.graph_arr[0] = store;
+	set_block_value(irg->current_block, 0, store);
 }
 
 void set_store(ir_node *store)
@@ -631,6 +719,42 @@ void ir_set_uninitialized_local_variable_func(
 	default_initialize_local_variable = func;
 }
 
+void irg_begin_bulk_cons(ir_graph *irg)
+{
+	assert(irg_is_constrained(irg, IR_GRAPH_CONSTRAINT_CONSTRUCTION));
+	assert(!irg->in_bulk_cons);
+	irg->in_bulk_cons        = true;
+	irg->bulk_cons_first_idx = get_irg_last_idx(irg);
+}
+
+void irg_end_bulk_cons(ir_graph *irg)
+{
+	assert(irg->in_bulk_cons);
+	irg->in_bulk_cons = false;
+
+	ir_graph *rem = current_ir_graph;
+	current_ir_graph = irg;
+
+	/* Operands are created before their users, so walking the indices in
+	 * ascending order optimizes every node after its operands except for
+	 * the Phis, which have been optimized on construction already.
+	 * Replacements created here get optimized immediately. */
+	for (unsigned idx  = irg->bulk_cons_first_idx,
+	              last = get_irg_last_idx(irg); idx < last; ++idx) {
+		ir_node *node = get_idx_irn(irg, idx);
+		if (node == NULL || is_Deleted(node) || is_Id(node) || is_Phi(node)
+		    || is_End(node) || (is_Block(node) && !get_Block_matured(node)))
+			continue;
+		ir_node *optimized = optimize_in_place_2(node);
+		if (optimized != node) {
+			remove_identities(node);
+			exchange(node, optimized);
+		}
+	}
+
+	current_ir_graph = rem;
+}
+
 void irg_finalize_cons(ir_graph *irg)
 {
 	ir_node *end_block = get_irg_end_block(irg);
@@ -695,10 +819,6 @@ ir_node *new_r_Block_noopt(ir_graph *irg, int arity, ir_node *in[])
 	res->attr.block.irg.irg = irg;
 	res->attr.block.backedge = new_backedge_arr(get_irg_obstack(irg), arity);
 	set_Block_matured(res, 1);
-	/* Create and initialize array for Phi-node construction. */
-	if (irg_is_constrained(irg, IR_GRAPH_CONSTRAINT_CONSTRUCTION)) {
-		res->attr.block.graph_arr = NEW_ARR_DZ(ir_node*, get_irg_obstack(irg), irg->n_loc);
-	}
 	verify_new_node(irg, res);
 	return res;
 }
@@ -1499,6 +1499,8 @@ static void dump_graph_info(FILE *F, ir_graph *irg)
 		fprintf(F, " consistent_entity_usage");
 	if (irg_has_properties(irg, IR_GRAPH_PROPERTY_MANY_RETURNS))
 		fprintf(F, " many_returns");
+	if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK))
+		fprintf(F, " consistent_liveness_chk");
 	fprintf(F, "\"\n");
 }
 
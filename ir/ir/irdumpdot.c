@@ -0,0 +1,94 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Write graphs in GraphViz DOT format.
+ *
+ * Unlike the VCG dumper, which walks the graph once per block and once more
+ * for the edges, this dumper writes every node together with its edges in a
+ * single walk and keeps no state besides the walker's visited flags. This
+ * makes it usable for very large graphs.
+ */
+#include <limits.h>
+#include <stdbool.h>
+
+#include "irdump_t.h"
+#include "irgraph_t.h"
+#include "irnode_t.h"
+#include "irgwalk.h"
+
+static long dump_first_nr = 0;
+static long dump_last_nr  = LONG_MAX;
+
+void ir_set_dump_node_range(long first, long last)
+{
+	dump_first_nr = first;
+	dump_last_nr  = last;
+}
+
+static bool nr_in_range(const ir_node *node)
+{
+	long nr = get_irn_node_nr(node);
+	return dump_first_nr <= nr && nr <= dump_last_nr;
+}
+
+/**
+ * A node is dumped if its own number or the number of its block lies in the
+ * dump range, so a range covering a single block number dumps the block with
+ * all its nodes.
+ */
+static bool should_dump_node(const ir_node *node)
+{
+	if (nr_in_range(node))
+		return true;
+	return !is_Block(node) && nr_in_range(get_nodes_block(node));
+}
+
+static void dump_dot_edge(FILE *out, const ir_node *node, int pos,
+                          const ir_node *pred)
+{
+	fprintf(out, "\tn%ld -> n%ld [label=\"%d\"", get_irn_node_nr(node),
+	        get_irn_node_nr(pred), pos);
+	ir_mode *mode = get_irn_mode(pred);
+	if (mode == mode_M)
+		fputs(",color=blue", out);
+	else if (mode == mode_X)
+		fputs(",color=red", out);
+	fputs("];\n", out);
+}
+
+static void dump_dot_node(ir_node *node, void *env)
+{
+	FILE *out = (FILE*)env;
+
+	if (!should_dump_node(node))
+		return;
+
+	long nr = get_irn_node_nr(node);
+	fprintf(out, "\tn%ld [label=\"", nr);
+	dump_node_label(out, node);
+	fprintf(out, "\"%s];\n", is_Block(node) ? ",shape=box" : "");
+
+	if (!is_Block(node)) {
+		fprintf(out, "\tn%ld -> n%ld [style=dotted,arrowhead=none];\n", nr,
+		        get_irn_node_nr(get_nodes_block(node)));
+	}
+	for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+		dump_dot_edge(out, node, i, get_irn_n(node, i));
+	}
+	for (int i = 0, n = get_irn_deps(node); i < n; ++i) {
+		fprintf(out, "\tn%ld -> n%ld [style=dashed];\n", nr,
+		        get_irn_node_nr(get_irn_dep(node, i)));
+	}
+}
+
+void dump_ir_graph_dot(FILE *out, ir_graph *graph)
+{
+	fprintf(out, "digraph \"%s\" {\n", get_irg_dump_name(graph));
+	fputs("\tnode [fontsize=10];\n", out);
+	irg_walk_graph(graph, dump_dot_node, NULL, out);
+	fputs("}\n", out);
+}
@@ -199,7 +199,7 @@ void dump_irnode_to_file(FILE *const F, const ir_node *const n)
 			fprintf(F, "  max pdomsubtree pre num %u\n", get_Block_pdom_max_subtree_pre_num(n));
 		}
 
-		/* not dumped: graph_arr */
+		/* not dumped: values    */
 		/* not dumped: mature    */
 		break;
 	}
@@ -469,6 +469,13 @@ static void dump_ir_initializers_to_file(FILE *const F,
 			}
 		}
 		break;
+	case IR_INITIALIZER_BYTES: {
+		const char *filename = get_initializer_bytes_file(initializer);
+		fprintf(F, "\t = <BYTES %zu>", get_initializer_bytes_size(initializer));
+		if (filename != NULL)
+			fprintf(F, " \"%s\"", filename);
+		break;
+	}
 	default:
 		panic("invalid ir_initializer kind found");
 	}
@@ -144,7 +144,7 @@ void edges_init_graph_kind(ir_graph *irg, ir_edge_kind_t kind)
 			ir_edgeset_destroy(&info->edges);
 			obstack_free(&info->edges_obst, NULL);
 		}
-		obstack_init(&info->edges_obst);
+		init_irg_obstack(irg, &info->edges_obst, IR_GRAPH_MEMORY_EDGES);
 		INIT_LIST_HEAD(&info->free_edges);
 		ir_edgeset_init_size(&info->edges, amount);
 		info->allocated = 1;
@@ -519,9 +519,10 @@ void edges_activate_kind(ir_graph *irg, ir_edge_kind_t kind)
 
 	w.kind = kind;
 
-	assert(!info->activated);
+	assert(!info->activated || info->suspended);
 
 	info->activated = 1;
+	info->suspended = 0;
 	edges_init_graph_kind(irg, kind);
 	if (kind == EDGE_KIND_DEP) {
 		irg_walk_anchors(irg, init_lh_walker_dep, NULL, &w);
@@ -542,6 +543,7 @@ void edges_deactivate_kind(ir_graph *irg, ir_edge_kind_t kind)
 	irg_edge_info_t *info = get_irg_edge_info(irg, kind);
 
 	info->activated = 0;
+	info->suspended = 0;
 	if (info->allocated) {
 		obstack_free(&info->edges_obst, NULL);
 		ir_edgeset_destroy(&info->edges);
@@ -550,6 +552,16 @@ void edges_deactivate_kind(ir_graph *irg, ir_edge_kind_t kind)
 	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
 }
 
+void edges_suspend_kind(ir_graph *irg, ir_edge_kind_t kind)
+{
+	irg_edge_info_t *info = get_irg_edge_info(irg, kind);
+
+	if (!edges_activated_kind_(irg, kind))
+		return;
+	info->suspended = 1;
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+}
+
 int (edges_activated_kind)(const ir_graph *irg, ir_edge_kind_t kind)
 {
 	return edges_activated_kind_(irg, kind);
@@ -808,6 +820,13 @@ void edges_activate(ir_graph *irg)
 	edges_activate_kind(irg, EDGE_KIND_DEP);
 }
 
+void edges_suspend(ir_graph *irg)
+{
+	edges_suspend_kind(irg, EDGE_KIND_NORMAL);
+	edges_suspend_kind(irg, EDGE_KIND_BLOCK);
+	edges_suspend_kind(irg, EDGE_KIND_DEP);
+}
+
 void edges_deactivate(ir_graph *irg)
 {
 	edges_deactivate_kind(irg, EDGE_KIND_DEP);
@@ -81,7 +81,8 @@ static inline const irg_edge_info_t *get_irg_edge_info_const(
 static inline const ir_edge_t *get_irn_out_edge_first_kind_(const ir_node *irn, ir_edge_kind_t kind)
 {
 	const struct list_head *head;
-	assert(edges_activated_kind(get_irn_irg(irn), kind));
+	/* the lists stay readable while edge maintenance is suspended */
+	assert(get_irg_edge_info_const(get_irn_irg(irn), kind)->activated);
 	head = &get_irn_edge_info_const(irn, kind)->outs_head;
 	return list_empty(head) ? NULL : list_entry(head->next, ir_edge_t, list);
 }
@@ -112,7 +113,8 @@ static inline int get_irn_n_edges_kind_(const ir_node *irn, ir_edge_kind_t kind)
 
 static inline int edges_activated_kind_(const ir_graph *irg, ir_edge_kind_t kind)
 {
-	return get_irg_edge_info_const(irg, kind)->activated;
+	const irg_edge_info_t *info = get_irg_edge_info_const(irg, kind);
+	return info->activated && !info->suspended;
 }
 
 static inline int edges_activated_(const ir_graph *irg)
@@ -162,6 +162,60 @@ static void opt_walker(ir_node *n, void *env)
 	}
 }
 
+/**
+ * Optimizes the nodes in the wait queue until it is empty. Whenever a node
+ * changes, only its users are enqueued again.
+ */
+static void optimize_waitq(pdeq *waitq)
+{
+	while (!pdeq_empty(waitq)) {
+		ir_node *n = (ir_node*)pdeq_getl(waitq);
+		/* the node may have been replaced while it was waiting */
+		if (is_Deleted(n)) {
+			continue;
+		}
+		opt_walker(n, waitq);
+	}
+}
+
+/**
+ * Walker: adds a node to the value table of its graph.
+ */
+static void add_identities_walker(ir_node *n, void *env)
+{
+	(void)env;
+	add_identities(n);
+}
+
+void local_optimize_nodes(ir_graph *irg, ir_node *const *nodes, size_t n_nodes)
+{
+	pdeq     *waitq = new_pdeq();
+	ir_graph *rem   = current_ir_graph;
+	current_ir_graph = irg;
+
+	if (get_opt_global_cse())
+		set_irg_pinned(irg, op_pin_state_floats);
+
+	/* the value table has to know all nodes of the graph, else identical nodes
+	 * outside the changed region are missed by CSE */
+	new_identities(irg);
+	irg_walk_graph(irg, NULL, add_identities_walker, NULL);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
+	for (size_t i = 0; i < n_nodes; ++i) {
+		ir_node *n = nodes[i];
+		if (!is_Deleted(n))
+			enqueue_node(n, waitq);
+	}
+	optimize_waitq(waitq);
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
+	del_pdeq(waitq);
+
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+	current_ir_graph = rem;
+}
+
 int optimize_graph_df(ir_graph *irg)
 {
 	pdeq     *waitq = new_pdeq();
@@ -188,10 +242,7 @@ int optimize_graph_df(ir_graph *irg)
 	 * so if it's not empty, the graph has been changed */
 	while (!pdeq_empty(waitq)) {
 		/* finish the wait queue */
-		while (! pdeq_empty(waitq)) {
-			ir_node *n = (ir_node*)pdeq_getl(waitq);
-			opt_walker(n, waitq);
-		}
+		optimize_waitq(waitq);
 		/* Calculate dominance so we can kill unreachable code
 		 * We want this intertwined with localopts for better optimization
 		 * (phase coupling) */
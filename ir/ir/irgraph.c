@@ -29,8 +29,11 @@
 #include "iredges_t.h"
 #include "type_t.h"
 #include "irmemory.h"
+#include "irmemory_t.h"
+#include "analyze_irg_args.h"
 #include "iroptimize.h"
 #include "irgopt.h"
+#include "pagealloc.h"
 
 #define INITIAL_IDX_IRN_MAP_SIZE 1024
 /** Suffix that is added to every frame type. */
@@ -50,6 +53,9 @@ void set_current_ir_graph(ir_graph *graph)
 /** contains the suffix for frame type names */
 static ident *frame_type_suffix = NULL;
 
+/** the memory of new graphs which is mapped from the OS */
+static ir_graph_memory_t default_memory = IR_GRAPH_MEMORY_NONE;
+
 void firm_init_irgraph(void)
 {
 	frame_type_suffix = new_id_from_str(FRAME_TP_SUFFIX);
@@ -70,7 +76,8 @@ static ir_graph *alloc_graph(void)
 	/* initialize the idx->node map. */
 	res->idx_irn_map = NEW_ARR_FZ(ir_node*, INITIAL_IDX_IRN_MAP_SIZE);
 
-	obstack_init(&res->obst);
+	res->memory = default_memory;
+	init_irg_obstack(res, &res->obst, IR_GRAPH_MEMORY_NODES);
 
 	/* value table for global value numbering for optimizing use in iropt.c */
 	new_identities(res);
@@ -104,11 +111,47 @@ void irg_set_nloc(ir_graph *res, int n_loc)
 	}
 }
 
+/**
+ * Creates the nodes every graph has and a first block to continue the
+ * construction in.
+ */
+static void create_graph_skeleton(ir_graph *res)
+{
+	ir_node *first_block;
+	ir_node *start, *start_block, *initial_mem, *projX;
+
+	/* the Anchor node must be created first */
+	res->anchor = new_r_Anchor(res);
+
+	/*-- Nodes needed in every graph --*/
+	set_irg_end_block(res, new_r_immBlock(res));
+	set_irg_end(res, new_r_End(res, 0, NULL));
+
+	start_block = new_r_Block_noopt(res, 0, NULL);
+	set_irg_start_block(res, start_block);
+	set_irg_no_mem     (res, new_r_NoMem(res));
+	start = new_r_Start(res);
+	set_irg_start      (res, start);
+
+	/* Proj results of start node */
+	projX                   = new_r_Proj(start, mode_X, pn_Start_X_initial_exec);
+	set_irg_initial_exec    (res, projX);
+	set_irg_frame           (res, new_r_Proj(start, mode_P_data, pn_Start_P_frame_base));
+	set_irg_args            (res, new_r_Proj(start, mode_T,      pn_Start_T_args));
+	initial_mem             = new_r_Proj(start, mode_M, pn_Start_M);
+	set_irg_initial_mem(res, initial_mem);
+
+	set_r_cur_block(res, start_block);
+	set_r_store(res, initial_mem);
+
+	/*-- Make a block to start with --*/
+	first_block = new_r_Block(res, 1, &projX);
+	set_r_cur_block(res, first_block);
+}
+
 ir_graph *new_r_ir_graph(ir_entity *ent, int n_loc)
 {
 	ir_graph *res;
-	ir_node  *first_block;
-	ir_node  *start, *start_block, *initial_mem, *projX;
 
 	res = alloc_graph();
 
@@ -132,38 +175,12 @@ ir_graph *new_r_ir_graph(ir_entity *ent, int n_loc)
 	/*--  a class type so that it can contain "inner" methods as in Pascal. --*/
 	res->frame_type = new_type_frame();
 
-	/* the Anchor node must be created first */
-	res->anchor = new_r_Anchor(res);
-
-	/*-- Nodes needed in every graph --*/
-	set_irg_end_block(res, new_r_immBlock(res));
-	set_irg_end(res, new_r_End(res, 0, NULL));
-
-	start_block = new_r_Block_noopt(res, 0, NULL);
-	set_irg_start_block(res, start_block);
-	set_irg_no_mem     (res, new_r_NoMem(res));
-	start = new_r_Start(res);
-	set_irg_start      (res, start);
-
-	/* Proj results of start node */
-	projX                   = new_r_Proj(start, mode_X, pn_Start_X_initial_exec);
-	set_irg_initial_exec    (res, projX);
-	set_irg_frame           (res, new_r_Proj(start, mode_P_data, pn_Start_P_frame_base));
-	set_irg_args            (res, new_r_Proj(start, mode_T,      pn_Start_T_args));
-	initial_mem             = new_r_Proj(start, mode_M, pn_Start_M);
-	set_irg_initial_mem(res, initial_mem);
-
 	res->index       = get_irp_new_irg_idx();
 #ifdef DEBUG_libfirm
 	res->graph_nr    = get_irp_new_node_nr();
 #endif
 
-	set_r_cur_block(res, start_block);
-	set_r_store(res, initial_mem);
-
-	/*-- Make a block to start with --*/
-	first_block = new_r_Block(res, 1, &projX);
-	set_r_cur_block(res, first_block);
+	create_graph_skeleton(res);
 
 	res->method_execution_frequency = -1.0;
 
@@ -318,11 +335,16 @@ void free_ir_graph(ir_graph *irg)
 {
 	assert(is_ir_graph(irg));
 
+	/* there is no need to read a body just to free it */
+	free(irg->lazy_body);
+	irg->lazy_body = NULL;
+
 	remove_irp_irg(irg);
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
 
 	hook_free_graph(irg);
 	free_irg_outs(irg);
+	free_irg_alias_cache(irg);
 	del_identities(irg);
 	if (irg->ent) {
 		set_entity_irg(irg->ent, NULL);  /* not set in const code irg */
@@ -336,6 +358,34 @@ void free_ir_graph(ir_graph *irg)
 	free_graph(irg);
 }
 
+void free_irg_body(ir_graph *irg)
+{
+	assert(is_ir_graph(irg) && irg != get_const_code_irg());
+
+	free(irg->lazy_body);
+	irg->lazy_body = NULL;
+
+	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
+	free_irg_outs(irg);
+	for (ir_edge_kind_t i = EDGE_KIND_FIRST; i <= EDGE_KIND_LAST; ++i)
+		edges_deactivate_kind(irg, i);
+	del_identities(irg);
+
+	free_End(get_irg_end(irg));
+	obstack_free(&irg->obst, NULL);
+	init_irg_obstack(irg, &irg->obst, IR_GRAPH_MEMORY_NODES);
+	DEL_ARR_F(irg->idx_irn_map);
+	irg->idx_irn_map   = NEW_ARR_FZ(ir_node*, INITIAL_IDX_IRN_MAP_SIZE);
+	irg->last_node_idx = 0;
+	irg->loop          = NULL;
+	new_identities(irg);
+
+	/* build an empty graph again */
+	irg->constraints = IR_GRAPH_CONSTRAINT_CONSTRUCTION;
+	create_graph_skeleton(irg);
+	irg_finalize_cons(irg);
+}
+
 int (is_ir_graph)(const void *thing)
 {
 	return is_ir_graph_(thing);
@@ -475,6 +525,35 @@ int get_irg_n_locs(ir_graph *irg)
 	return irg->n_loc - 1;
 }
 
+void init_irg_obstack(ir_graph *irg, struct obstack *obst,
+                      ir_graph_memory_t kind)
+{
+	if (irg->memory & kind)
+		page_obstack_init(obst, irg->memory & IR_GRAPH_MEMORY_HUGE_PAGES);
+	else
+		obstack_init(obst);
+}
+
+void set_irg_default_memory(ir_graph_memory_t memory)
+{
+	default_memory = memory;
+}
+
+ir_graph_memory_t get_irg_default_memory(void)
+{
+	return default_memory;
+}
+
+void set_irg_memory(ir_graph *irg, ir_graph_memory_t memory)
+{
+	irg->memory = memory;
+}
+
+ir_graph_memory_t get_irg_memory(const ir_graph *irg)
+{
+	return irg->memory;
+}
+
 int node_is_in_irgs_storage(const ir_graph *irg, const ir_node *n)
 {
 	/* Check whether the ir_node pointer is on the obstack.
@@ -661,6 +740,8 @@ void assure_irg_properties(ir_graph *irg, ir_graph_properties_t props)
 		{ IR_GRAPH_PROPERTY_CONSISTENT_OUTS,          assure_irg_outs },
 		{ IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO,      assure_loopinfo },
 		{ IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE,  assure_irg_entity_usage_computed },
+		{ IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE,   assure_irg_alias_cache },
+		{ IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY, assure_irg_entity_summary },
 		{ IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE_FRONTIERS, ir_compute_dominance_frontiers },
 	};
 	size_t i;
@@ -13,6 +13,7 @@
 
 #include "firm_types.h"
 #include "irgraph.h"
+#include "irio.h"
 
 #include "irtypes.h"
 #include "irprog.h"
@@ -77,6 +78,12 @@ void firm_init_irgraph(void);
  */
 void irg_set_nloc(ir_graph *res, int n_loc);
 
+/**
+ * Returns true if a memory budget is set and the memory allocated for @p irg
+ * exceeds it. Expensive passes use this to fall back to cheaper variants.
+ */
+bool irg_memory_budget_exceeded(const ir_graph *irg);
+
 /**
  * Internal constructor that does not add to irp_irgs or the like.
  */
@@ -107,6 +114,13 @@ static inline void set_irg_pinned(ir_graph *irg, op_pin_state p)
 	irg->irg_pinned_state = p;
 }
 
+/**
+ * Initializes an obstack of graph @p irg holding memory of the given kind,
+ * mapped from the operating system if the graph memory setting says so.
+ */
+void init_irg_obstack(ir_graph *irg, struct obstack *obst,
+                      ir_graph_memory_t kind);
+
 /** Returns the obstack associated with the graph. */
 static inline struct obstack *get_irg_obstack(ir_graph *const irg)
 {
@@ -133,9 +147,21 @@ static inline int is_ir_graph_(const void *thing)
 	return (get_kind(thing) == k_ir_graph);
 }
 
+/**
+ * Reads the body of a lazily imported graph if this did not happen yet.
+ * All accessors of the anchor nodes do this, so the body appears as soon as
+ * somebody looks at the graph.
+ */
+static inline void assure_irg_body(const ir_graph *irg)
+{
+	if (irg->lazy_body != NULL)
+		ir_load_irg_body((ir_graph*)irg);
+}
+
 /** Returns the start block of a graph. */
 static inline ir_node *get_irg_start_block_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_start_block);
 }
 
@@ -146,6 +172,7 @@ static inline void set_irg_start_block_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_start_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_start);
 }
 
@@ -156,6 +183,7 @@ static inline void set_irg_start_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_end_block_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_end_block);
 }
 
@@ -166,6 +194,7 @@ static inline void set_irg_end_block_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_end_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_end);
 }
 
@@ -176,6 +205,7 @@ static inline void set_irg_end_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_initial_exec_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_initial_exec);
 }
 
@@ -186,6 +216,7 @@ static inline void set_irg_initial_exec_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_frame_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_frame);
 }
 
@@ -196,6 +227,7 @@ static inline void set_irg_frame_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_initial_mem_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_initial_mem);
 }
 
@@ -206,6 +238,7 @@ static inline void set_irg_initial_mem_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_args_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_args);
 }
 
@@ -216,6 +249,7 @@ static inline void set_irg_args_(ir_graph *irg, ir_node *node)
 
 static inline ir_node *get_irg_no_mem_(const ir_graph *irg)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, anchor_no_mem);
 }
 
@@ -384,6 +418,7 @@ static inline int get_irg_n_anchors(const ir_graph *irg)
  */
 static inline ir_node *get_irg_anchor(const ir_graph *irg, int idx)
 {
+	assure_irg_body(irg);
 	return get_irn_n(irg->anchor, idx);
 }
 
@@ -24,82 +24,39 @@
 
 #include "error.h"
 #include "pset_new.h"
-#include "array.h"
+#include "array_t.h"
+
+/** environment of the specialized versions of irg_walk_2 */
+typedef struct walk_2_env_t {
+	irg_walk_func *pre;
+	irg_walk_func *post;
+	void          *env;
+} walk_2_env_t;
 
 /**
  * specialized version of irg_walk_2, called if only pre callback exists
  */
-static void irg_walk_2_pre(ir_node *node, irg_walk_func *pre, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	pre(node, env);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_2_pre(pred, pre, env);
-	}
-	for (i = get_irn_arity(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_n(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_2_pre(pred, pre, env);
-	}
-}
+#define IRG_WALK_NAME             irg_walk_2_pre
+#define IRG_WALK_ENV_TYPE         walk_2_env_t const*
+#define IRG_WALK_PRE(node, env)   (env)->pre((node), (env)->env)
+#include "gen_irgwalk.c.inl"
 
 /**
  * specialized version of irg_walk_2, called if only post callback exists
  */
-static void irg_walk_2_post(ir_node *node, irg_walk_func *post, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_2_post(pred, post, env);
-	}
-	for (i = get_irn_arity(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_n(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_2_post(pred, post, env);
-	}
-
-	post(node, env);
-}
+#define IRG_WALK_NAME             irg_walk_2_post
+#define IRG_WALK_ENV_TYPE         walk_2_env_t const*
+#define IRG_WALK_POST(node, env)  (env)->post((node), (env)->env)
+#include "gen_irgwalk.c.inl"
 
 /**
  * specialized version of irg_walk_2, called if pre and post callbacks exist
  */
-static void irg_walk_2_both(ir_node *node, irg_walk_func *pre,
-                                irg_walk_func *post, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	pre(node, env);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_2_both(pred, pre, post, env);
-	}
-	for (i = get_irn_arity(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_n(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_2_both(pred, pre, post, env);
-	}
-
-	post(node, env);
-}
+#define IRG_WALK_NAME             irg_walk_2_both
+#define IRG_WALK_ENV_TYPE         walk_2_env_t const*
+#define IRG_WALK_PRE(node, env)   (env)->pre((node), (env)->env)
+#define IRG_WALK_POST(node, env)  (env)->post((node), (env)->env)
+#include "gen_irgwalk.c.inl"
 
 void irg_walk_2(ir_node *node, irg_walk_func *pre, irg_walk_func *post,
                 void *env)
@@ -107,9 +64,10 @@ void irg_walk_2(ir_node *node, irg_walk_func *pre, irg_walk_func *post,
 	if (irn_visited(node))
 		return;
 
-	if      (!post) irg_walk_2_pre (node, pre, env);
-	else if (!pre)  irg_walk_2_post(node, post, env);
-	else            irg_walk_2_both(node, pre, post, env);
+	walk_2_env_t const walk_env = { pre, post, env };
+	if      (!post) irg_walk_2_pre (node, &walk_env);
+	else if (!pre)  irg_walk_2_post(node, &walk_env);
+	else            irg_walk_2_both(node, &walk_env);
 }
 
 void irg_walk_core(ir_node *node, irg_walk_func *pre, irg_walk_func *post,
@@ -157,76 +115,33 @@ void all_irg_walk(irg_walk_func *pre, irg_walk_func *post, void *env)
 /**
  * specialized version of irg_walk_in_or_dep_2, called if only pre callback exists
  */
-static void irg_walk_in_or_dep_2_pre(ir_node *node, irg_walk_func *pre, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	pre(node, env);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_pre(pred, pre, env);
-	}
-	for (i = get_irn_ins_or_deps(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_in_or_dep(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_pre(pred, pre, env);
-	}
-}
+#define IRG_WALK_NAME              irg_walk_in_or_dep_2_pre
+#define IRG_WALK_ENV_TYPE          walk_2_env_t const*
+#define IRG_WALK_PRE(node, env)    (env)->pre((node), (env)->env)
+#define IRG_WALK_ARITY(node)       get_irn_ins_or_deps(node)
+#define IRG_WALK_GET_IN(node, pos) get_irn_in_or_dep((node), (pos))
+#include "gen_irgwalk.c.inl"
 
 /**
  * specialized version of irg_walk_in_or_dep_2, called if only post callback exists
  */
-static void irg_walk_in_or_dep_2_post(ir_node *node, irg_walk_func *post, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_post(pred, post, env);
-	}
-	for (i = get_irn_ins_or_deps(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_in_or_dep(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_post(pred, post, env);
-	}
-
-	post(node, env);
-}
+#define IRG_WALK_NAME              irg_walk_in_or_dep_2_post
+#define IRG_WALK_ENV_TYPE          walk_2_env_t const*
+#define IRG_WALK_POST(node, env)   (env)->post((node), (env)->env)
+#define IRG_WALK_ARITY(node)       get_irn_ins_or_deps(node)
+#define IRG_WALK_GET_IN(node, pos) get_irn_in_or_dep((node), (pos))
+#include "gen_irgwalk.c.inl"
 
 /**
  * specialized version of irg_walk_in_or_dep_2, called if pre and post callbacks exist
  */
-static void irg_walk_in_or_dep_2_both(ir_node *node, irg_walk_func *pre, irg_walk_func *post, void *env)
-{
-	int i;
-	ir_graph *irg = get_irn_irg(node);
-
-	set_irn_visited(node, irg->visited);
-
-	pre(node, env);
-
-	if (!is_Block(node)) {
-		ir_node *pred = get_nodes_block(node);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_both(pred, pre, post, env);
-	}
-	for (i = get_irn_ins_or_deps(node) - 1; i >= 0; --i) {
-		ir_node *pred = get_irn_in_or_dep(node, i);
-		if (pred->visited < irg->visited)
-			irg_walk_in_or_dep_2_both(pred, pre, post, env);
-	}
-
-	post(node, env);
-}
+#define IRG_WALK_NAME              irg_walk_in_or_dep_2_both
+#define IRG_WALK_ENV_TYPE          walk_2_env_t const*
+#define IRG_WALK_PRE(node, env)    (env)->pre((node), (env)->env)
+#define IRG_WALK_POST(node, env)   (env)->post((node), (env)->env)
+#define IRG_WALK_ARITY(node)       get_irn_ins_or_deps(node)
+#define IRG_WALK_GET_IN(node, pos) get_irn_in_or_dep((node), (pos))
+#include "gen_irgwalk.c.inl"
 
 /**
  * Intraprozedural graph walker. Follows dependency edges as well.
@@ -236,9 +151,10 @@ static void irg_walk_in_or_dep_2(ir_node *node, irg_walk_func *pre, irg_walk_fun
 	if (irn_visited(node))
 		return;
 
-	if      (! post) irg_walk_in_or_dep_2_pre (node, pre, env);
-	else if (! pre)  irg_walk_in_or_dep_2_post(node, post, env);
-	else             irg_walk_in_or_dep_2_both(node, pre, post, env);
+	walk_2_env_t const walk_env = { pre, post, env };
+	if      (! post) irg_walk_in_or_dep_2_pre (node, &walk_env);
+	else if (! pre)  irg_walk_in_or_dep_2_post(node, &walk_env);
+	else             irg_walk_in_or_dep_2_both(node, &walk_env);
 }
 
 void irg_walk_in_or_dep(ir_node *node, irg_walk_func *pre, irg_walk_func *post, void *env)
@@ -271,32 +187,62 @@ static ir_node *get_cf_op(ir_node *n)
 	return n;
 }
 
-static void irg_block_walk_2(ir_node *node, irg_walk_func *pre,
+/** a block on the stack of irg_block_walk_2 */
+typedef struct block_walk_frame_t {
+	ir_node *block; /**< the block whose predecessors are walked */
+	int      pos;   /**< the next control flow predecessor, -2 if not read */
+} block_walk_frame_t;
+
+/**
+ * Walks the blocks reachable backwards from block. Uses an explicit stack
+ * instead of recursion but keeps the order of the recursive formulation.
+ */
+static void irg_block_walk_2(ir_node *block, irg_walk_func *pre,
                              irg_walk_func *post, void *env)
 {
-	int i;
-
-	if (Block_block_visited(node))
+	if (Block_block_visited(block))
 		return;
-	mark_Block_block_visited(node);
 
-	if (pre)
-		pre(node, env);
+	block_walk_frame_t *stack = NEW_ARR_F(block_walk_frame_t, 0);
+	ir_node            *next  = block;
+	for (;;) {
+		if (next != NULL) {
+			mark_Block_block_visited(next);
+			if (pre)
+				pre(next, env);
+			block_walk_frame_t const frame = { next, -2 };
+			ARR_APP1(block_walk_frame_t, stack, frame);
+		}
 
-	for (i = get_Block_n_cfgpreds(node) - 1; i >= 0; --i) {
-		/* find the corresponding predecessor block. */
-		ir_node *pred = get_cf_op(get_Block_cfgpred(node, i));
-		pred = get_nodes_block(pred);
-		if (get_irn_opcode(pred) == iro_Block) {
-			/* recursion */
-			irg_block_walk_2(pred, pre, post, env);
-		} else {
-			assert(get_irn_opcode(pred) == iro_Bad);
+		size_t              const top  = ARR_LEN(stack) - 1;
+		block_walk_frame_t *const f    = &stack[top];
+		ir_node            *const node = f->block;
+		if (f->pos == -2)
+			f->pos = get_Block_n_cfgpreds(node) - 1;
+		next = NULL;
+		while (f->pos >= 0) {
+			/* find the corresponding predecessor block. */
+			ir_node *pred = get_cf_op(get_Block_cfgpred(node, f->pos--));
+			pred = get_nodes_block(pred);
+			if (get_irn_opcode(pred) == iro_Block) {
+				if (!Block_block_visited(pred)) {
+					next = pred;
+					break;
+				}
+			} else {
+				assert(get_irn_opcode(pred) == iro_Bad);
+			}
 		}
+		if (next != NULL)
+			continue;
+
+		if (post)
+			post(node, env);
+		if (top == 0)
+			break;
+		ARR_SHRINKLEN(stack, top);
 	}
-
-	if (post)
-		post(node, env);
+	DEL_ARR_F(stack);
 }
 
 void irg_block_walk(ir_node *node, irg_walk_func *pre, irg_walk_func *post,
@@ -337,6 +283,7 @@ void irg_block_walk_graph(ir_graph *irg, irg_walk_func *pre,
 
 void irg_walk_anchors(ir_graph *irg, irg_walk_func *pre, irg_walk_func *post, void *env)
 {
+	assure_irg_body(irg);
 	irg_walk(irg->anchor, pre, post, env);
 }
 
@@ -354,6 +301,7 @@ static void walk_initializer(ir_initializer_t *initializer, walk_env *env)
         return;
     case IR_INITIALIZER_TARVAL:
     case IR_INITIALIZER_NULL:
+    case IR_INITIALIZER_BYTES:
         return;
 
     case IR_INITIALIZER_COMPOUND: {
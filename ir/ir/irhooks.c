@@ -9,10 +9,14 @@
  * @author   Michael Beck
  */
 #include <assert.h>
+#include <limits.h>
 
 #include "irhooks.h"
 
+COMPILETIME_ASSERT(hook_last <= sizeof(unsigned) * CHAR_BIT, hooks_enabled)
+
 hook_entry_t *hooks[hook_last];
+unsigned      hooks_enabled;
 
 void register_hook(hook_type_t hook, hook_entry_t *entry)
 {
@@ -25,6 +29,7 @@ void register_hook(hook_type_t hook, hook_entry_t *entry)
 
   entry->next = hooks[hook];
   hooks[hook] = entry;
+  hooks_enabled |= 1u << hook;
 }
 
 void unregister_hook(hook_type_t hook, hook_entry_t *entry)
@@ -34,14 +39,16 @@ void unregister_hook(hook_type_t hook, hook_entry_t *entry)
   if (hooks[hook] == entry) {
     hooks[hook] = entry->next;
     entry->next = NULL;
-    return;
-  }
-
-  for (p = hooks[hook]; p && p->next != entry; p = p->next) {
+  } else {
+    for (p = hooks[hook]; p && p->next != entry; p = p->next) {
+    }
+
+    if (p) {
+      p->next     = entry->next;
+      entry->next = NULL;
+    }
   }
 
-  if (p) {
-    p->next     = entry->next;
-    entry->next = NULL;
-  }
+  if (hooks[hook] == NULL)
+    hooks_enabled &= ~(1u << hook);
 }
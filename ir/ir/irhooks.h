@@ -13,6 +13,7 @@
 
 #include "irop.h"
 #include "irnode.h"
+#include "compiler.h"
 
 /**
  * options for the hook_merge_nodes hook
@@ -218,16 +219,31 @@ void unregister_hook(hook_type_t hook, hook_entry_t *entry);
 /** Global list of registerd hooks. */
 extern hook_entry_t *hooks[hook_last];
 
+/** Bitset of the hook types with at least one registered entry. */
+extern unsigned hooks_enabled;
+
+/**
+ * Returns non-zero if an entry is registered for the hook type @p what.
+ * Defining DISABLE_HOOKS compiles all hook calls out, registered hooks are
+ * never executed then.
+ */
+#ifdef DISABLE_HOOKS
+#define hook_enabled(what) 0
+#else
+#define hook_enabled(what) UNLIKELY((hooks_enabled & (1u << (what))) != 0)
+#endif
+
 /**
  * Executes the hook @p what with the args @p args
  * Do not use this macro directly.
  */
-#define hook_exec(what, args) do {           \
-  hook_entry_t *_p;                          \
-  for (_p = hooks[what]; _p; _p = _p->next){ \
-    void *hook_ctx_ = _p->context;           \
-    _p->hook._##what args;                   \
-  }                                          \
+#define hook_exec(what, args) do {                            \
+  if (hook_enabled(what)) {                                   \
+    for (hook_entry_t *_p = hooks[what]; _p; _p = _p->next) { \
+      void *hook_ctx_ = _p->context;                          \
+      _p->hook._##what args;                                  \
+    }                                                         \
+  }                                                           \
 } while (0)
 
 /** Called when a new node opcode has been created */
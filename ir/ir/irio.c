@@ -12,12 +12,15 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 #include "irio.h"
 
 #include "irnode_t.h"
 #include "irprog.h"
 #include "irgraph_t.h"
+#include "irnodemap.h"
+#include "entity_t.h"
 #include "irprintf.h"
 #include "ircons_t.h"
 #include "irgmod.h"
@@ -31,9 +34,55 @@
 #include "obst.h"
 #include "pmap.h"
 #include "pdeq.h"
+#include "cpset.h"
+#include "hashptr.h"
+#include "xmalloc.h"
+#include "util.h"
 
 #define SYMERROR ((unsigned) ~0)
 
+/** Magic bytes at the start of a file in the binary format. */
+static const char binary_magic[] = "\x7f" "FIRMBIN" "\x01";
+#define BINARY_MAGIC_SIZE (sizeof(binary_magic) - 1)
+
+/**
+ * Token kinds of the binary format. The binary format is the same token
+ * stream as the textual one, but every token starts with one of these tag
+ * bytes followed by its payload:
+ *  - numbers are zig-zag encoded LEB128 varints,
+ *  - words and strings reference a string table. A reference equal to the
+ *    current size of the table introduces a new entry which follows as
+ *    varint length, the characters and a terminating zero byte,
+ *  - a section is followed by its length as a 64bit little endian number so
+ *    readers can skip whole graphs. Strings introduced inside a section are
+ *    only valid until its end, so every section can be decoded without
+ *    looking at other sections.
+ */
+typedef enum binary_token_t {
+	bt_eof,
+	bt_number,
+	bt_word,
+	bt_string,
+	bt_list_begin,
+	bt_list_end,
+	bt_scope_begin,
+	bt_scope_end,
+	bt_section,
+	bt_bytes,
+} binary_token_t;
+
+/** Size of the length field of a section. */
+#define SECTION_LENGTH_SIZE 8
+
+/** Position of a graph body which has not been read yet. */
+struct ir_lazy_body {
+	const unsigned char *begin;     /**< start of the section contents */
+	const unsigned char *end;       /**< end of the section */
+	size_t               n_strings; /**< size of the string table at the
+	                                     start of the section */
+};
+typedef struct ir_lazy_body lazy_body_t;
+
 static void register_generated_node_readers(void);
 static void register_generated_node_writers(void);
 
@@ -48,12 +97,26 @@ typedef struct delayed_pred_t {
 	long     preds[];
 } delayed_pred_t;
 
+/** An imported entity with the linker name of an entity of the program. */
+typedef struct link_pair_t {
+	ir_entity *existing;
+	ir_entity *imported;
+} link_pair_t;
+
 typedef struct read_env_t {
 	int            c;           /**< currently read char */
 	FILE          *file;
 	const char    *inputname;
 	unsigned       line;
 
+	bool                 binary;  /**< reading the binary format */
+	const unsigned char *pos;     /**< current position (binary format) */
+	const unsigned char *end;     /**< end of the input (binary format) */
+	const char         **strings; /**< string table (binary format) */
+	bool                 lazy;    /**< keep graph bodies for later */
+	const char         **global_strings; /**< strings defined outside of
+	                                          sections (lazy import) */
+
 	ir_graph      *irg;
 	set           *idset;       /**< id_entry set, which maps from file ids to
 	                                 new Firm elements */
@@ -63,12 +126,37 @@ typedef struct read_env_t {
 	struct obstack preds_obst;
 	delayed_initializer_t *delayed_initializers;
 	const delayed_pred_t **delayed_preds;
+
+	bool           link;         /**< link the input with the program */
+	pmap          *symbols;      /**< maps linker names to segment members */
+	set           *linked_types; /**< the types shared when linking */
+	link_pair_t   *link_pairs;   /**< the entities to merge */
+	size_t         first_irg;    /**< index of the first imported graph */
 } read_env_t;
 
+/** An entry in the string table of the binary writer. */
+typedef struct string_entry_t {
+	size_t index;
+	char   str[];
+} string_entry_t;
+
 typedef struct write_env_t {
 	FILE *file;
 	pdeq *write_queue;
 	pdeq *entity_queue;
+
+	bool             binary;         /**< write the binary format */
+	struct obstack   out;            /**< output buffer (binary format) */
+	struct obstack   string_obst;    /**< string table entries */
+	cpset_t          strings;        /**< string table (binary format) */
+	string_entry_t **string_list;    /**< string table entries by index */
+	size_t           section_start;  /**< start of the current section */
+	size_t           section_n_strings; /**< size of the string table at the
+	                                         start of the current section */
+
+	bool             hash;           /**< write a structural hash input */
+	ir_nodemap       node_numbers;   /**< graph local node numbers (hash) */
+	long             n_node_numbers;
 } write_env_t;
 
 typedef enum typetag_t {
@@ -106,6 +194,7 @@ typedef enum keyword_t {
 	kw_type,
 	kw_typegraph,
 	kw_unknown,
+	kw_vector_mode,
 } keyword_t;
 
 typedef struct symbol_t {
@@ -228,6 +317,7 @@ static void symtbl_init(void)
 	INSERTKEYWORD(type);
 	INSERTKEYWORD(typegraph);
 	INSERTKEYWORD(unknown);
+	INSERTKEYWORD(vector_mode);
 
 	INSERTENUM(tt_align, align_non_aligned);
 	INSERTENUM(tt_align, align_is_aligned);
@@ -257,6 +347,7 @@ static void symtbl_init(void)
 	INSERTENUM(tt_initializer, IR_INITIALIZER_TARVAL);
 	INSERTENUM(tt_initializer, IR_INITIALIZER_NULL);
 	INSERTENUM(tt_initializer, IR_INITIALIZER_COMPOUND);
+	INSERTENUM(tt_initializer, IR_INITIALIZER_BYTES);
 
 	INSERT(tt_mode_arithmetic, "none",               irma_none);
 	INSERT(tt_mode_arithmetic, "twos_complement",    irma_twos_complement);
@@ -322,34 +413,134 @@ static unsigned symbol(const char *str, typetag_t typetag)
 	return entry ? entry->code : SYMERROR;
 }
 
+static void write_byte(write_env_t *env, unsigned char byte)
+{
+	obstack_1grow(&env->out, byte);
+}
+
+static void write_varint(write_env_t *env, unsigned long value)
+{
+	while (value >= 0x80) {
+		write_byte(env, (unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	write_byte(env, (unsigned char)value);
+}
+
+static int string_entry_equal(const void *p1, const void *p2)
+{
+	const string_entry_t *e1 = (const string_entry_t*)p1;
+	const string_entry_t *e2 = (const string_entry_t*)p2;
+	return strcmp(e1->str, e2->str) == 0;
+}
+
+static unsigned string_entry_hash(const void *p)
+{
+	const string_entry_t *entry = (const string_entry_t*)p;
+	return hash_str(entry->str);
+}
+
+/**
+ * Writes a reference to a string into the binary output, adding it to the
+ * string table first if it is not in there yet.
+ */
+static void write_string_ref(write_env_t *env, const char *str)
+{
+	size_t          len   = strlen(str);
+	string_entry_t *entry = (string_entry_t*)obstack_alloc(&env->string_obst,
+			sizeof(*entry) + len + 1);
+	memcpy(entry->str, str, len + 1);
+	entry->index = ARR_LEN(env->string_list);
+
+	string_entry_t *found = (string_entry_t*)cpset_insert(&env->strings, entry);
+	if (found != entry) {
+		obstack_free(&env->string_obst, entry);
+		write_varint(env, found->index);
+		return;
+	}
+	ARR_APP1(string_entry_t*, env->string_list, entry);
+	write_varint(env, entry->index);
+	write_varint(env, len);
+	obstack_grow0(&env->out, str, len);
+}
+
+/** Writes the binary output buffer to the file. */
+static void flush_binary(write_env_t *env)
+{
+	size_t  size = obstack_object_size(&env->out);
+	char   *data = (char*)obstack_finish(&env->out);
+	fwrite(data, 1, size, env->file);
+	obstack_free(&env->out, data);
+}
+
+/**
+ * Writes a character which is only there to make the textual format
+ * readable.
+ */
+static void write_layout(write_env_t *env, char c)
+{
+	if (!env->binary)
+		fputc(c, env->file);
+}
+
 static void write_long(write_env_t *env, long value)
 {
+	if (env->binary) {
+		unsigned long uvalue = (unsigned long)value;
+		write_byte(env, bt_number);
+		write_varint(env, value < 0 ? ~(uvalue << 1) : uvalue << 1);
+		return;
+	}
 	fprintf(env->file, "%ld ", value);
 }
 
 static void write_int(write_env_t *env, int value)
 {
+	if (env->binary) {
+		write_long(env, value);
+		return;
+	}
 	fprintf(env->file, "%d ", value);
 }
 
 static void write_unsigned(write_env_t *env, unsigned value)
 {
+	if (env->binary) {
+		write_long(env, (long)value);
+		return;
+	}
 	fprintf(env->file, "%u ", value);
 }
 
 static void write_size_t(write_env_t *env, size_t value)
 {
+	if (env->binary) {
+		write_long(env, (long)value);
+		return;
+	}
 	ir_fprintf(env->file, "%zu ", value);
 }
 
 static void write_symbol(write_env_t *env, const char *symbol)
 {
+	if (env->binary) {
+		write_byte(env, bt_word);
+		write_string_ref(env, symbol);
+		return;
+	}
 	fputs(symbol, env->file);
 	fputc(' ', env->file);
 }
 
+static void write_entity_shape(write_env_t *env, ir_entity *entity);
+static void write_type_shape(write_env_t *env, ir_type *type, bool deep);
+
 static void write_entity_ref(write_env_t *env, ir_entity *entity)
 {
+	if (env->hash) {
+		write_entity_shape(env, entity);
+		return;
+	}
 	write_long(env, get_entity_nr(entity));
 }
 
@@ -365,12 +556,21 @@ static void write_type_ref(write_env_t *env, ir_type *type)
 	default:
 		break;
 	}
+	if (env->hash) {
+		write_type_shape(env, type, true);
+		return;
+	}
 	write_long(env, get_type_nr(type));
 }
 
 static void write_string(write_env_t *env, const char *string)
 {
 	const char *c;
+	if (env->binary) {
+		write_byte(env, bt_string);
+		write_string_ref(env, string);
+		return;
+	}
 	fputc('"', env->file);
 	for (c = string; *c != '\0'; ++c) {
 		switch (*c) {
@@ -391,6 +591,26 @@ static void write_string(write_env_t *env, const char *string)
 	fputc(' ', env->file);
 }
 
+/**
+ * Writes raw bytes, in the textual format as a word of hexadecimal digits.
+ */
+static void write_bytes(write_env_t *env, const unsigned char *data,
+                        size_t size)
+{
+	if (env->binary) {
+		write_byte(env, bt_bytes);
+		write_varint(env, size);
+		obstack_grow(&env->out, data, size);
+		return;
+	}
+	static const char digits[] = "0123456789abcdef";
+	for (size_t i = 0; i < size; ++i) {
+		fputc(digits[data[i] >> 4], env->file);
+		fputc(digits[data[i] & 0xf], env->file);
+	}
+	fputc(' ', env->file);
+}
+
 static void write_ident(write_env_t *env, ident *id)
 {
 	write_string(env, get_id_str(id));
@@ -399,7 +619,7 @@ static void write_ident(write_env_t *env, ident *id)
 static void write_ident_null(write_env_t *env, ident *id)
 {
 	if (id == NULL) {
-		fputs("NULL ", env->file);
+		write_symbol(env, "NULL");
 	} else {
 		write_ident(env, id);
 	}
@@ -418,27 +638,23 @@ static void write_tarval(write_env_t *env, ir_tarval *tv)
 	} else {
 		char buf[1024];
 		tarval_snprintf(buf, sizeof(buf), tv);
-		fputs(buf, env->file);
-		fputc(' ', env->file);
+		write_symbol(env, buf);
 	}
 }
 
 static void write_align(write_env_t *env, ir_align align)
 {
-	fputs(get_align_name(align), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_align_name(align));
 }
 
 static void write_builtin_kind(write_env_t *env, const ir_node *node)
 {
-	fputs(get_builtin_kind_name(get_Builtin_kind(node)), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_builtin_kind_name(get_Builtin_kind(node)));
 }
 
 static void write_cond_jmp_predicate(write_env_t *env, const ir_node *node)
 {
-	fputs(get_cond_jmp_predicate_name(get_Cond_jmp_pred(node)), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_cond_jmp_predicate_name(get_Cond_jmp_pred(node)));
 }
 
 static void write_relation(write_env_t *env, ir_relation relation)
@@ -453,36 +669,110 @@ static void write_throws(write_env_t *env, bool throws)
 
 static void write_list_begin(write_env_t *env)
 {
+	if (env->binary) {
+		write_byte(env, bt_list_begin);
+		return;
+	}
 	fputs("[", env->file);
 }
 
 static void write_list_end(write_env_t *env)
 {
+	if (env->binary) {
+		write_byte(env, bt_list_end);
+		return;
+	}
 	fputs("] ", env->file);
 }
 
 static void write_scope_begin(write_env_t *env)
 {
+	if (env->binary) {
+		write_byte(env, bt_scope_begin);
+		return;
+	}
 	fputs("{\n", env->file);
 }
 
 static void write_scope_end(write_env_t *env)
 {
+	if (env->binary) {
+		write_byte(env, bt_scope_end);
+		return;
+	}
 	fputs("}\n\n", env->file);
 }
 
+/**
+ * Starts a section in the binary format. Sections are used for the graph
+ * bodies so a reader is able to skip them. In the textual format this
+ * does nothing.
+ */
+static void write_section_begin(write_env_t *env)
+{
+	if (!env->binary)
+		return;
+	assert(env->section_start == 0);
+	write_byte(env, bt_section);
+	env->section_start     = obstack_object_size(&env->out);
+	env->section_n_strings = ARR_LEN(env->string_list);
+	for (size_t i = 0; i < SECTION_LENGTH_SIZE; ++i)
+		write_byte(env, 0);
+}
+
+static void write_section_end(write_env_t *env)
+{
+	if (!env->binary)
+		return;
+	size_t         start  = env->section_start;
+	unsigned char *data   = (unsigned char*)obstack_base(&env->out);
+	uint64_t       length = obstack_object_size(&env->out) - start
+	                        - SECTION_LENGTH_SIZE;
+	for (size_t i = 0; i < SECTION_LENGTH_SIZE; ++i)
+		data[start + i] = (unsigned char)(length >> (i * 8));
+	env->section_start = 0;
+
+	/* strings introduced in the section are local to it */
+	size_t n_strings = env->section_n_strings;
+	if (ARR_LEN(env->string_list) > n_strings) {
+		string_entry_t *first = env->string_list[n_strings];
+		for (size_t i = n_strings, n = ARR_LEN(env->string_list); i < n; ++i)
+			cpset_remove(&env->strings, env->string_list[i]);
+		ARR_SHRINKLEN(env->string_list, n_strings);
+		obstack_free(&env->string_obst, first);
+	}
+	flush_binary(env);
+}
+
+/**
+ * Returns the number of a node in the hash input. Node numbers change when
+ * unrelated graphs change, so the nodes are numbered in the order they are
+ * first mentioned instead.
+ */
+static long get_local_node_nr(write_env_t *env, const ir_node *node)
+{
+	void *nr = ir_nodemap_get(void, &env->node_numbers, node);
+	if (nr == NULL) {
+		nr = INT_TO_PTR(++env->n_node_numbers);
+		ir_nodemap_insert(&env->node_numbers, node, nr);
+	}
+	return PTR_TO_INT(nr);
+}
+
 static void write_node_ref(write_env_t *env, const ir_node *node)
 {
+	if (env->hash) {
+		write_long(env, get_local_node_nr(env, node));
+		return;
+	}
 	write_long(env, get_irn_node_nr(node));
 }
 
 static void write_initializer(write_env_t *env, ir_initializer_t *ini)
 {
-	FILE *f = env->file;
 	ir_initializer_kind_t ini_kind = get_initializer_kind(ini);
 
-	fputs(get_initializer_kind_name(ini_kind), f);
-	fputc(' ', f);
+	write_symbol(env, get_initializer_kind_name(ini_kind));
 
 	switch (ini_kind) {
 	case IR_INITIALIZER_CONST:
@@ -503,43 +793,53 @@ static void write_initializer(write_env_t *env, ir_initializer_t *ini)
 			write_initializer(env, get_initializer_compound_value(ini, i));
 		return;
 	}
+
+	case IR_INITIALIZER_BYTES: {
+		/* file backed data is read from the file again when importing */
+		const char *filename = get_initializer_bytes_file(ini);
+		if (filename != NULL) {
+			write_string(env, filename);
+			return;
+		}
+		write_symbol(env, "NULL");
+		size_t size = get_initializer_bytes_size(ini);
+		write_size_t(env, size);
+		write_bytes(env, (const unsigned char*)get_initializer_bytes_data(ini),
+		            size);
+		return;
+	}
 	}
 	panic("Unknown initializer kind");
 }
 
 static void write_pin_state(write_env_t *env, op_pin_state state)
 {
-	fputs(get_op_pin_state_name(state), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_op_pin_state_name(state));
 }
 
 static void write_volatility(write_env_t *env, ir_volatility vol)
 {
-	fputs(get_volatility_name(vol), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_volatility_name(vol));
 }
 
 static void write_type_state(write_env_t *env, ir_type_state state)
 {
-	fputs(get_type_state_name(state), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_type_state_name(state));
 }
 
 static void write_visibility(write_env_t *env, ir_visibility visibility)
 {
-	fputs(get_visibility_name(visibility), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_visibility_name(visibility));
 }
 
 static void write_mode_arithmetic(write_env_t *env, ir_mode_arithmetic arithmetic)
 {
-	fputs(get_mode_arithmetic_name(arithmetic), env->file);
-	fputc(' ', env->file);
+	write_symbol(env, get_mode_arithmetic_name(arithmetic));
 }
 
 static void write_type_common(write_env_t *env, ir_type *tp)
 {
-	fputc('\t', env->file);
+	write_layout(env, '\t');
 	write_symbol(env, "type");
 	write_long(env, get_type_nr(tp));
 	write_symbol(env, get_type_tpop_name(tp));
@@ -555,7 +855,7 @@ static void write_type_primitive(write_env_t *env, ir_type *tp)
 {
 	write_type_common(env, tp);
 	write_mode_ref(env, get_type_mode(tp));
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_type_compound(write_env_t *env, ir_type *tp)
@@ -572,7 +872,7 @@ static void write_type_compound(write_env_t *env, ir_type *tp)
 	}
 	write_type_common(env, tp);
 	write_ident_null(env, get_compound_ident(tp));
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 
 	for (i = 0; i < n_members; ++i) {
 		ir_entity *member = get_compound_member(tp, i);
@@ -611,7 +911,7 @@ static void write_type_array(write_env_t *env, ir_type *tp)
 	/* note that we just write a reference to the element entity
 	 * but never the entity itself */
 	write_entity_ref(env, element_entity);
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_type_method(write_env_t *env, ir_type *tp)
@@ -635,7 +935,7 @@ static void write_type_method(write_env_t *env, ir_type *tp)
 	for (i = 0; i < nresults; i++)
 		write_type_ref(env, get_method_res_type(tp, i));
 	write_unsigned(env, get_method_variadicity(tp));
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_type_pointer(write_env_t *env, ir_type *tp)
@@ -647,14 +947,14 @@ static void write_type_pointer(write_env_t *env, ir_type *tp)
 	write_type_common(env, tp);
 	write_mode_ref(env, get_type_mode(tp));
 	write_type_ref(env, points_to);
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_type_enumeration(write_env_t *env, ir_type *tp)
 {
 	write_type_common(env, tp);
 	write_ident_null(env, get_enumeration_ident(tp));
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_type(write_env_t *env, ir_type *tp)
@@ -699,7 +999,7 @@ static void write_entity(write_env_t *env, ir_entity *ent)
 	write_type(env, type);
 	write_type(env, owner);
 
-	fputc('\t', env->file);
+	write_layout(env, '\t');
 	switch ((ir_entity_kind)ent->entity_kind) {
 	case IR_ENTITY_NORMAL:          write_symbol(env, "entity");          break;
 	case IR_ENTITY_METHOD:          write_symbol(env, "method");          break;
@@ -775,7 +1075,7 @@ static void write_entity(write_env_t *env, ir_entity *ent)
 		break;
 	}
 
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_switch_table(write_env_t *env, const ir_switch_table *table)
@@ -809,7 +1109,7 @@ static void write_pred_refs(write_env_t *env, const ir_node *node, int from)
 
 static void write_node_nr(write_env_t *env, const ir_node *node)
 {
-	write_long(env, get_irn_node_nr(node));
+	write_node_ref(env, node);
 }
 
 static void write_ASM(write_env_t *env, const ir_node *node)
@@ -888,6 +1188,23 @@ static void write_Anchor(write_env_t *env, const ir_node *node)
 
 static void write_SymConst(write_env_t *env, const ir_node *node)
 {
+	if (env->hash) {
+		symconst_kind kind = get_SymConst_kind(node);
+		write_symbol(env, "SymConst");
+		write_node_nr(env, node);
+		write_mode_ref(env, get_irn_mode(node));
+		write_int(env, kind);
+		if (SYMCONST_HAS_ENT(kind)) {
+			write_entity_ref(env, get_SymConst_entity(node));
+		} else if (SYMCONST_HAS_TYPE(kind)) {
+			write_type_ref(env, get_SymConst_type(node));
+		} else {
+			write_ident(env, get_enumeration_const_nameid(
+				get_SymConst_enum(node)));
+		}
+		return;
+	}
+
 	/* TODO: only symconst_addr_ent implemented yet */
 	if (get_SymConst_kind(node) != symconst_addr_ent)
 		panic("Can't export %+F (only symconst_addr_ent supported)", node);
@@ -921,11 +1238,11 @@ static void write_node(const ir_node *node, write_env_t *env)
 	ir_op           *const op   = get_irn_op(node);
 	write_node_func *const func = get_generic_function_ptr(write_node_func, op);
 
-	fputc('\t', env->file);
+	write_layout(env, '\t');
 	if (func == NULL)
 		panic("No write_node_func for %+F", node);
 	func(env, node);
-	fputc('\n', env->file);
+	write_layout(env, '\n');
 }
 
 static void write_node_recursive(ir_node *node, write_env_t *env);
@@ -994,6 +1311,11 @@ static void write_mode(write_env_t *env, ir_mode *mode)
 		write_mode_arithmetic(env, get_mode_arithmetic(mode));
 		write_unsigned(env, get_mode_exponent_size(mode));
 		write_unsigned(env, get_mode_mantissa_size(mode));
+	} else if (mode_is_vector(mode)) {
+		write_symbol(env, "vector_mode");
+		write_string(env, get_mode_name(mode));
+		write_mode_ref(env, get_mode_vector_elem_mode(mode));
+		write_unsigned(env, get_mode_n_vector_elems(mode));
 	} else {
 		panic("Can't write internal modes");
 	}
@@ -1005,21 +1327,21 @@ static void write_modes(write_env_t *env)
 	size_t i;
 
 	write_symbol(env, "modes");
-	fputs("{\n", env->file);
+	write_scope_begin(env);
 
 	for (i = 0; i < n_modes; i++) {
 		ir_mode *mode = ir_get_mode(i);
 		if (!mode_is_int(mode) && !mode_is_reference(mode)
-		    && !mode_is_float(mode)) {
+		    && !mode_is_float(mode) && !mode_is_vector(mode)) {
 		    /* skip internal modes */
 		    continue;
 		}
-		fputc('\t', env->file);
+		write_layout(env, '\t');
 		write_mode(env, mode);
-		fputc('\n', env->file);
+		write_layout(env, '\n');
 	}
 
-	fputs("}\n\n", env->file);
+	write_scope_end(env);
 }
 
 static void write_program(write_env_t *env)
@@ -1031,15 +1353,15 @@ static void write_program(write_env_t *env)
 	write_symbol(env, "program");
 	write_scope_begin(env);
 	if (irp_prog_name_is_set()) {
-		fputc('\t', env->file);
+		write_layout(env, '\t');
 		write_symbol(env, "name");
 		write_string(env, get_irp_name());
-		fputc('\n', env->file);
+		write_layout(env, '\n');
 	}
 
 	for (s = IR_SEGMENT_FIRST; s <= IR_SEGMENT_LAST; ++s) {
 		ir_type *segment_type = get_segment_type(s);
-		fputc('\t', env->file);
+		write_layout(env, '\t');
 		write_symbol(env, "segment_type");
 		write_symbol(env, get_segment_name(s));
 		if (segment_type == NULL) {
@@ -1047,15 +1369,15 @@ static void write_program(write_env_t *env)
 		} else {
 			write_type_ref(env, segment_type);
 		}
-		fputc('\n', env->file);
+		write_layout(env, '\n');
 	}
 
 	for (i = 0; i < n_asms; ++i) {
 		ident *asm_text = get_irp_asm(i);
-		fputc('\t', env->file);
+		write_layout(env, '\t');
 		write_symbol(env, "asm");
 		write_ident(env, asm_text);
-		fputc('\n', env->file);
+		write_layout(env, '\n');
 	}
 	write_scope_end(env);
 }
@@ -1075,6 +1397,21 @@ int ir_export(const char *filename)
 	return res;
 }
 
+int ir_export_binary(const char *filename)
+{
+	FILE *file = fopen(filename, "wb");
+	int   res  = 0;
+	if (file == NULL) {
+		perror(filename);
+		return 1;
+	}
+
+	ir_export_binary_file(file);
+	res = ferror(file);
+	fclose(file);
+	return res;
+}
+
 static void write_node_cb(ir_node *node, void *ctx)
 {
 	write_env_t *env = (write_env_t*)ctx;
@@ -1104,12 +1441,8 @@ static void write_typegraph(write_env_t *env)
 	write_scope_end(env);
 }
 
-static void write_irg(write_env_t *env, ir_graph *irg)
+static void write_irg_nodes(write_env_t *env, ir_graph *irg)
 {
-	write_symbol(env, "irg");
-	write_entity_ref(env, get_irg_entity(irg));
-	write_type_ref(env, get_irg_frame_type(irg));
-	write_scope_begin(env);
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_VISITED);
 	inc_irg_visited(irg);
 	assert(pdeq_empty(env->write_queue));
@@ -1119,11 +1452,86 @@ static void write_irg(write_env_t *env, ir_graph *irg)
 		write_node_recursive(node, env);
 	} while (!pdeq_empty(env->write_queue));
 	ir_free_resources(irg, IR_RESOURCE_IRN_VISITED);
+}
+
+static void write_irg(write_env_t *env, ir_graph *irg)
+{
+	assure_irg_body(irg);
+	write_symbol(env, "irg");
+	write_entity_ref(env, get_irg_entity(irg));
+	write_type_ref(env, get_irg_frame_type(irg));
+	write_section_begin(env);
+	write_scope_begin(env);
+	write_irg_nodes(env, irg);
 	write_scope_end(env);
+	write_section_end(env);
 }
 
-/* Exports the whole irp to the given file in a textual form. */
-void ir_export_file(FILE *file)
+/**
+ * Writes the parts of an entity the code referencing it depends on. Global
+ * entities are known by their linker name, compound members and parameters
+ * by their layout.
+ */
+static void write_entity_shape(write_env_t *env, ir_entity *entity)
+{
+	switch (entity->entity_kind) {
+	case IR_ENTITY_PARAMETER:
+		write_size_t(env, get_entity_parameter_number(entity));
+		/* FALLTHROUGH */
+	case IR_ENTITY_COMPOUND_MEMBER:
+		write_ident(env, get_entity_ident(entity));
+		write_int(env, get_entity_offset(entity));
+		write_unsigned(env, get_entity_bitfield_offset(entity));
+		write_unsigned(env, get_entity_bitfield_size(entity));
+		write_type_shape(env, get_entity_type(entity), false);
+		return;
+	default:
+		write_ident(env, get_entity_ld_ident(entity));
+		write_visibility(env, get_entity_visibility(entity));
+		write_unsigned(env, get_entity_linkage(entity));
+		if (is_method_entity(entity))
+			write_unsigned(env, get_entity_additional_properties(entity));
+		return;
+	}
+}
+
+/**
+ * Writes the layout of a type. Method types are written with the layout of
+ * their parameters and results if @p deep is set.
+ */
+static void write_type_shape(write_env_t *env, ir_type *type, bool deep)
+{
+	write_symbol(env, get_type_tpop_name(type));
+	switch (get_type_tpop_code(type)) {
+	case tpo_unknown:
+	case tpo_code:
+		return;
+	case tpo_method:
+		if (!deep)
+			return;
+		write_unsigned(env, get_method_calling_convention(type));
+		write_unsigned(env, get_method_additional_properties(type));
+		write_int(env, get_method_variadicity(type));
+		write_list_begin(env);
+		for (size_t i = 0, n = get_method_n_params(type); i < n; ++i)
+			write_type_shape(env, get_method_param_type(type, i), false);
+		write_list_end(env);
+		write_list_begin(env);
+		for (size_t i = 0, n = get_method_n_ress(type); i < n; ++i)
+			write_type_shape(env, get_method_res_type(type, i), false);
+		write_list_end(env);
+		return;
+	case tpo_primitive:
+		write_mode_ref(env, get_type_mode(type));
+		break;
+	default:
+		break;
+	}
+	write_unsigned(env, get_type_size_bytes(type));
+	write_unsigned(env, get_type_alignment_bytes(type));
+}
+
+static void export_irp(FILE *file, bool binary)
 {
 	write_env_t my_env;
 	write_env_t *env = &my_env;
@@ -1133,6 +1541,14 @@ void ir_export_file(FILE *file)
 	env->file         = file;
 	env->write_queue  = new_pdeq();
 	env->entity_queue = new_pdeq();
+	env->binary       = binary;
+	if (binary) {
+		obstack_init(&env->out);
+		obstack_init(&env->string_obst);
+		cpset_init(&env->strings, string_entry_hash, string_entry_equal);
+		env->string_list = NEW_ARR_F(string_entry_t*, 0);
+		obstack_grow(&env->out, binary_magic, BINARY_MAGIC_SIZE);
+	}
 
 	writers_init();
 	write_modes(env);
@@ -1152,11 +1568,176 @@ void ir_export_file(FILE *file)
 
 	write_program(env);
 
+	if (binary) {
+		write_byte(env, bt_eof);
+		flush_binary(env);
+		DEL_ARR_F(env->string_list);
+		cpset_destroy(&env->strings);
+		obstack_free(&env->string_obst, NULL);
+		obstack_free(&env->out, NULL);
+	}
+
 	del_pdeq(env->entity_queue);
 	del_pdeq(env->write_queue);
 }
 
+/* Exports the whole irp to the given file in a textual form. */
+void ir_export_file(FILE *file)
+{
+	export_irp(file, false);
+}
+
+void ir_export_binary_file(FILE *file)
+{
+	export_irp(file, true);
+}
+
+uint64_t ir_hash_irg(ir_graph *irg)
+{
+	write_env_t env;
+	memset(&env, 0, sizeof(env));
+	env.binary      = true;
+	env.hash        = true;
+	env.write_queue = new_pdeq();
+	obstack_init(&env.out);
+	obstack_init(&env.string_obst);
+	cpset_init(&env.strings, string_entry_hash, string_entry_equal);
+	env.string_list = NEW_ARR_F(string_entry_t*, 0);
+	ir_nodemap_init(&env.node_numbers, irg);
+
+	writers_init();
+	assure_irg_body(irg);
+	write_entity_ref(&env, get_irg_entity(irg));
+	write_type_ref(&env, get_entity_type(get_irg_entity(irg)));
+	write_irg_nodes(&env, irg);
+
+	/* 64 bit FNV-1a over the binary format */
+	size_t               size = obstack_object_size(&env.out);
+	unsigned char const *data = (unsigned char const*)obstack_base(&env.out);
+	uint64_t             hash = UINT64_C(0xcbf29ce484222325);
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= data[i];
+		hash *= UINT64_C(0x100000001b3);
+	}
+
+	ir_nodemap_destroy(&env.node_numbers);
+	DEL_ARR_F(env.string_list);
+	cpset_destroy(&env.strings);
+	obstack_free(&env.string_obst, NULL);
+	obstack_free(&env.out, NULL);
+	del_pdeq(env.write_queue);
+	return hash;
+}
+
+
+
+static binary_token_t peek_token(read_env_t *env)
+{
+	if (env->pos >= env->end)
+		return bt_eof;
+	return (binary_token_t)*env->pos;
+}
+
+static binary_token_t read_token(read_env_t *env)
+{
+	binary_token_t token = peek_token(env);
+	if (token != bt_eof)
+		++env->pos;
+	return token;
+}
+
+static unsigned long read_varint(read_env_t *env)
+{
+	unsigned long result = 0;
+	unsigned      shift  = 0;
+	while (true) {
+		if (env->pos >= env->end) {
+			parse_error(env, "Unexpected EOF while reading number\n");
+			exit(1);
+		}
+		unsigned char byte = *env->pos++;
+		result |= (unsigned long)(byte & 0x7f) << shift;
+		if ((byte & 0x80) == 0)
+			return result;
+		shift += 7;
+	}
+}
+
+static long read_zigzag(read_env_t *env)
+{
+	unsigned long value = read_varint(env);
+	return (long)(value & 1 ? ~(value >> 1) : value >> 1);
+}
+
+/**
+ * Reads a reference into the string table. The returned string points into
+ * the input buffer.
+ */
+static const char *read_string_ref(read_env_t *env)
+{
+	size_t index     = read_varint(env);
+	size_t n_strings = ARR_LEN(env->strings);
+	if (index < n_strings)
+		return env->strings[index];
+	if (index > n_strings) {
+		parse_error(env, "Invalid string reference %lu\n", (unsigned long)index);
+		exit(1);
+	}
+
+	size_t      len = read_varint(env);
+	const char *str = (const char*)env->pos;
+	if (len >= (size_t)(env->end - env->pos) || str[len] != '\0') {
+		parse_error(env, "Invalid string\n");
+		exit(1);
+	}
+	env->pos += len + 1;
+	ARR_APP1(const char*, env->strings, str);
+	return str;
+}
+
+static char *copy_str(read_env_t *env, const char *str)
+{
+	assert(obstack_object_size(&env->obst) == 0);
+	obstack_grow0(&env->obst, str, strlen(str));
+	return (char*)obstack_finish(&env->obst);
+}
+
+/**
+ * Starts reading a section of the binary format, returns the position of
+ * its end or NULL when reading the textual format.
+ */
+static const unsigned char *read_section_begin(read_env_t *env)
+{
+	if (!env->binary)
+		return NULL;
+	if (read_token(env) != bt_section
+	    || env->end - env->pos < SECTION_LENGTH_SIZE) {
+		parse_error(env, "Expected section\n");
+		exit(1);
+	}
+	uint64_t length = 0;
+	for (size_t i = 0; i < SECTION_LENGTH_SIZE; ++i)
+		length |= (uint64_t)env->pos[i] << (i * 8);
+	env->pos += SECTION_LENGTH_SIZE;
+	if (length > (uint64_t)(env->end - env->pos)) {
+		parse_error(env, "Section exceeds input\n");
+		exit(1);
+	}
+	return env->pos + length;
+}
 
+/** Finishes a section, the strings introduced in it are no longer valid. */
+static void read_section_end(read_env_t *env, const unsigned char *end,
+                             size_t n_strings)
+{
+	if (!env->binary)
+		return;
+	if (env->pos != end) {
+		parse_error(env, "Section length mismatch\n");
+		exit(1);
+	}
+	ARR_SHRINKLEN(env->strings, n_strings);
+}
 
 static void read_c(read_env_t *env)
 {
@@ -1186,6 +1767,11 @@ static void skip_ws(read_env_t *env)
 
 static void skip_to(read_env_t *env, char to_ch)
 {
+	if (env->binary) {
+		/* there is no way to resynchronize in the binary format */
+		parse_error(env, "cannot recover from error in binary format\n");
+		exit(1);
+	}
 	while (env->c != to_ch && env->c != EOF) {
 		read_c(env);
 	}
@@ -1193,6 +1779,23 @@ static void skip_to(read_env_t *env, char to_ch)
 
 static bool expect_char(read_env_t *env, char ch)
 {
+	if (env->binary) {
+		binary_token_t token;
+		switch (ch) {
+		case '{': token = bt_scope_begin; break;
+		case '}': token = bt_scope_end;   break;
+		case '[': token = bt_list_begin;  break;
+		case ']': token = bt_list_end;    break;
+		default:  panic("no binary token for '%c'", ch);
+		}
+		if (peek_token(env) != token) {
+			parse_error(env, "Unexpected token %d, expected '%c'\n",
+			            peek_token(env), ch);
+			return false;
+		}
+		++env->pos;
+		return true;
+	}
 	skip_ws(env);
 	if (env->c != ch) {
 		parse_error(env, "Unexpected char '%c', expected '%c'\n",
@@ -1207,6 +1810,19 @@ static bool expect_char(read_env_t *env, char ch)
 
 static char *read_word(read_env_t *env)
 {
+	if (env->binary) {
+		binary_token_t token = read_token(env);
+		if (token == bt_number) {
+			/* numbers are words too in the textual format */
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%ld", read_zigzag(env));
+			return copy_str(env, buf);
+		} else if (token != bt_word && token != bt_string) {
+			parse_error(env, "Expected word, got token %d\n", token);
+			exit(1);
+		}
+		return copy_str(env, read_string_ref(env));
+	}
 	skip_ws(env);
 
 	assert(obstack_object_size(&env->obst) == 0);
@@ -1234,6 +1850,14 @@ endofword:
 
 static char *read_string(read_env_t *env)
 {
+	if (env->binary) {
+		binary_token_t token = read_token(env);
+		if (token != bt_string) {
+			parse_error(env, "Expected string, got token %d\n", token);
+			exit(1);
+		}
+		return copy_str(env, read_string_ref(env));
+	}
 	skip_ws(env);
 	if (env->c != '"') {
 		parse_error(env, "Expected string, got '%c'\n", env->c);
@@ -1294,6 +1918,15 @@ static ident *read_symbol(read_env_t *env)
  */
 static char *read_string_null(read_env_t *env)
 {
+	if (env->binary) {
+		if (peek_token(env) == bt_string)
+			return read_string(env);
+		if (read_token(env) == bt_word
+		    && strcmp(read_string_ref(env), "NULL") == 0)
+			return NULL;
+		parse_error(env, "Expected \"string\" or NULL\n");
+		exit(1);
+	}
 	skip_ws(env);
 	if (env->c == 'N') {
 		char *str = read_word(env);
@@ -1309,6 +1942,45 @@ static char *read_string_null(read_env_t *env)
 	exit(1);
 }
 
+static int read_hex_digit(read_env_t *env, int c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	parse_error(env, "Invalid hexadecimal digit '%c'\n", c);
+	exit(1);
+}
+
+/**
+ * Reads @p size raw bytes written by write_bytes(). The data is placed on
+ * @p obst.
+ */
+static unsigned char *read_bytes(read_env_t *env, struct obstack *obst,
+                                 size_t size)
+{
+	unsigned char *data = (unsigned char*)obstack_alloc(obst, size);
+	if (env->binary) {
+		if (read_token(env) != bt_bytes || read_varint(env) != size
+		    || size > (size_t)(env->end - env->pos)) {
+			parse_error(env, "Invalid bytes\n");
+			exit(1);
+		}
+		memcpy(data, env->pos, size);
+		env->pos += size;
+		return data;
+	}
+	skip_ws(env);
+	for (size_t i = 0; i < size; ++i) {
+		int hi = read_hex_digit(env, env->c);
+		read_c(env);
+		int lo = read_hex_digit(env, env->c);
+		read_c(env);
+		data[i] = (unsigned char)(hi << 4 | lo);
+	}
+	return data;
+}
+
 static ident *read_ident_null(read_env_t *env)
 {
 	ident *res;
@@ -1326,6 +1998,15 @@ static long read_long(read_env_t *env)
 	long  result;
 	char *str;
 
+	if (env->binary) {
+		binary_token_t token = read_token(env);
+		if (token != bt_number) {
+			parse_error(env, "Expected number, got token %d\n", token);
+			exit(1);
+		}
+		return read_zigzag(env);
+	}
+
 	skip_ws(env);
 	if (!isdigit(env->c) && env->c != '-') {
 		parse_error(env, "Expected number, got '%c'\n", env->c);
@@ -1364,6 +2045,13 @@ static size_t read_size_t(read_env_t *env)
 
 static void expect_list_begin(read_env_t *env)
 {
+	if (env->binary) {
+		if (read_token(env) != bt_list_begin) {
+			parse_error(env, "Expected list\n");
+			exit(1);
+		}
+		return;
+	}
 	skip_ws(env);
 	if (env->c != '[') {
 		parse_error(env, "Expected list, got '%c'\n", env->c);
@@ -1374,6 +2062,18 @@ static void expect_list_begin(read_env_t *env)
 
 static bool list_has_next(read_env_t *env)
 {
+	if (env->binary) {
+		binary_token_t token = peek_token(env);
+		if (token == bt_eof) {
+			parse_error(env, "Unexpected EOF while reading list");
+			exit(1);
+		}
+		if (token == bt_list_end) {
+			++env->pos;
+			return false;
+		}
+		return true;
+	}
 	if (feof(env->file)) {
 		parse_error(env, "Unexpected EOF while reading list");
 		exit(1);
@@ -1387,6 +2087,38 @@ static bool list_has_next(read_env_t *env)
 	return true;
 }
 
+/**
+ * Checks whether the end of the current scope is reached and consumes the
+ * closing bracket if so. If @p accept_eof is set, reaching the end of the
+ * input counts as the end of the scope as well.
+ */
+static bool scope_end(read_env_t *env, bool accept_eof)
+{
+	if (env->binary) {
+		binary_token_t token = peek_token(env);
+		if (token == bt_scope_end || (accept_eof && token == bt_eof)) {
+			++env->pos;
+			return true;
+		}
+		return false;
+	}
+	skip_ws(env);
+	if (env->c == '}' || (accept_eof && env->c == EOF)) {
+		read_c(env);
+		return true;
+	}
+	return false;
+}
+
+/** Returns true if the whole input has been read. */
+static bool input_end(read_env_t *env)
+{
+	if (env->binary)
+		return peek_token(env) == bt_eof;
+	skip_ws(env);
+	return env->c == EOF;
+}
+
 static void *get_id(read_env_t *env, long id)
 {
 	id_entry key, *entry;
@@ -1659,11 +2391,341 @@ static ir_initializer_t *read_initializer(read_env_t *env)
 		}
 		return ini;
 	}
+
+	case IR_INITIALIZER_BYTES: {
+		char *filename = read_string_null(env);
+		if (filename != NULL) {
+			ir_initializer_t *ini = create_initializer_file(filename);
+			if (ini == NULL) {
+				parse_error(env, "Could not read initializer file '%s'\n",
+				            filename);
+				exit(1);
+			}
+			obstack_free(&env->obst, filename);
+			return ini;
+		}
+		size_t          size = read_size_t(env);
+		struct obstack *obst = get_irg_obstack(get_const_code_irg());
+		unsigned char  *data = read_bytes(env, obst, size);
+		return create_initializer_bytes(data, size);
+	}
 	}
 
 	panic("Unknown initializer kind");
 }
 
+/**
+ * Returns true if @p type is shared with structurally equal types when
+ * linking. Compound types are defined by their members, which are read after
+ * the type, and array types own their element entity, so they stay apart.
+ */
+static bool is_linked_type(const ir_type *type)
+{
+	return is_Primitive_type(type) || is_Pointer_type(type)
+	    || is_Method_type(type);
+}
+
+static unsigned hash_linked_type(ir_type *type)
+{
+	unsigned hash = hash_combine(hash_ptr(get_type_tpop(type)),
+	                             hash_ptr(get_type_mode(type)));
+	hash = hash_combine(hash, get_type_size_bytes(type));
+	hash = hash_combine(hash, get_type_alignment_bytes(type));
+	if (is_Pointer_type(type)) {
+		hash = hash_combine(hash, hash_ptr(get_pointer_points_to_type(type)));
+	} else if (is_Method_type(type)) {
+		for (size_t i = 0, n = get_method_n_params(type); i < n; ++i)
+			hash = hash_combine(hash, hash_ptr(get_method_param_type(type, i)));
+		for (size_t i = 0, n = get_method_n_ress(type); i < n; ++i)
+			hash = hash_combine(hash, hash_ptr(get_method_res_type(type, i)));
+	}
+	return hash;
+}
+
+static bool linked_types_equal(ir_type *type0, ir_type *type1)
+{
+	if (get_type_tpop(type0) != get_type_tpop(type1)
+	    || get_type_mode(type0) != get_type_mode(type1)
+	    || get_type_size_bytes(type0) != get_type_size_bytes(type1)
+	    || get_type_alignment_bytes(type0) != get_type_alignment_bytes(type1)
+	    || type0->flags != type1->flags)
+		return false;
+
+	if (is_Pointer_type(type0))
+		return get_pointer_points_to_type(type0)
+		    == get_pointer_points_to_type(type1);
+	if (!is_Method_type(type0))
+		return true;
+
+	size_t n_params = get_method_n_params(type0);
+	size_t n_ress   = get_method_n_ress(type0);
+	if (n_params != get_method_n_params(type1)
+	    || n_ress != get_method_n_ress(type1)
+	    || get_method_variadicity(type0) != get_method_variadicity(type1)
+	    || get_method_calling_convention(type0)
+	       != get_method_calling_convention(type1)
+	    || get_method_additional_properties(type0)
+	       != get_method_additional_properties(type1))
+		return false;
+	for (size_t i = 0; i < n_params; ++i) {
+		if (get_method_param_type(type0, i) != get_method_param_type(type1, i))
+			return false;
+	}
+	for (size_t i = 0; i < n_ress; ++i) {
+		if (get_method_res_type(type0, i) != get_method_res_type(type1, i))
+			return false;
+	}
+	return true;
+}
+
+static int cmp_linked_type(const void *elt, const void *key, size_t size)
+{
+	(void)size;
+	ir_type *const *type0 = (ir_type *const*)elt;
+	ir_type *const *type1 = (ir_type *const*)key;
+	return !linked_types_equal(*type0, *type1);
+}
+
+/**
+ * Returns the type of the program which is structurally equal to the
+ * imported @p type. The imported type is freed if there is one.
+ */
+static ir_type *link_type(read_env_t *env, ir_type *type)
+{
+	if (!is_linked_type(type))
+		return type;
+
+	ir_type *const *found = set_insert(ir_type*, env->linked_types, &type,
+	                                   sizeof(type), hash_linked_type(type));
+	if (*found != type) {
+		free_type(type);
+		return *found;
+	}
+	return type;
+}
+
+/** Returns true if @p owner is one of the linker segments. */
+static bool is_segment(const ir_type *owner)
+{
+	return (owner->flags & tf_segment) != 0;
+}
+
+/**
+ * Returns true if @p entity is visible to other compilation units. Unlike
+ * entity_is_externally_visible() this is false for private entities.
+ */
+static bool is_external_symbol(const ir_entity *entity)
+{
+	return get_entity_visibility(entity) == ir_visibility_external;
+}
+
+/**
+ * Gives @p entity a linker name which is not used in the program yet.
+ */
+static void rename_local_entity(read_env_t *env, ir_entity *entity)
+{
+	ident *ld_name = get_entity_ld_ident(entity);
+	for (unsigned nr = 1;; ++nr) {
+		char buf[256];
+		snprintf(buf, sizeof(buf), "%s.%u", get_id_str(ld_name), nr);
+		ident *id = new_id_from_str(buf);
+		if (!pmap_contains(env->symbols, id)) {
+			set_entity_ld_ident(entity, id);
+			pmap_insert(env->symbols, id, entity);
+			return;
+		}
+	}
+}
+
+/**
+ * Resolves the linker name of an imported member of a segment. Local
+ * entities are renamed if their name is taken, externally visible ones are
+ * remembered for link_entities() if the program has an entity of the same
+ * name.
+ */
+static void link_entity(read_env_t *env, ir_entity *entity)
+{
+	ident     *ld_name  = get_entity_ld_ident(entity);
+	ir_entity *existing = pmap_get(ir_entity, env->symbols, ld_name);
+	if (existing == NULL) {
+		pmap_insert(env->symbols, ld_name, entity);
+	} else if (!is_external_symbol(entity)) {
+		rename_local_entity(env, entity);
+	} else if (!is_external_symbol(existing)) {
+		rename_local_entity(env, existing);
+		pmap_insert(env->symbols, ld_name, entity);
+	} else {
+		link_pair_t pair = { existing, entity };
+		ARR_APP1(link_pair_t, env->link_pairs, pair);
+	}
+}
+
+/**
+ * Returns 0 if @p entity only declares its symbol, 1 if it is a weak, common
+ * or inline definition which gives way to others and 2 for a definition.
+ */
+static int get_definition_strength(const ir_entity *entity)
+{
+	ir_linkage linkage = get_entity_linkage(entity);
+	if (is_method_entity(entity)) {
+		if (get_entity_irg(entity) == NULL)
+			return 0;
+		if (linkage & (IR_LINKAGE_NO_CODEGEN | IR_LINKAGE_WEAK
+		               | IR_LINKAGE_MERGE))
+			return 1;
+		return 2;
+	}
+	if (get_entity_initializer(entity) == NULL)
+		return linkage & IR_LINKAGE_MERGE ? 1 : 0;
+	return linkage & (IR_LINKAGE_WEAK | IR_LINKAGE_MERGE) ? 1 : 2;
+}
+
+/**
+ * Moves the definition of @p imported to @p existing. The graph replaced in
+ * @p existing is appended to @p dead_irgs.
+ */
+static void take_definition(ir_entity *existing, ir_entity *imported,
+                            ir_graph ***dead_irgs)
+{
+	if (is_method_entity(existing)) {
+		ir_graph *old_irg = get_entity_irg(existing);
+		if (old_irg != NULL) {
+			/* free_ir_graph() must not touch the entity anymore */
+			set_irg_entity(old_irg, NULL);
+			ARR_APP1(ir_graph*, *dead_irgs, old_irg);
+		}
+		ir_graph *irg = get_entity_irg(imported);
+		set_entity_irg(imported, NULL);
+		if (irg != NULL)
+			set_irg_entity(irg, existing);
+		set_entity_irg(existing, irg);
+	} else if (get_entity_initializer(imported) != NULL) {
+		set_entity_initializer(existing, get_entity_initializer(imported));
+	}
+
+	ir_linkage hidden = get_entity_linkage(existing) & IR_LINKAGE_HIDDEN_USER;
+	set_entity_type(existing, get_entity_type(imported));
+	set_entity_alignment(existing, get_entity_alignment(imported));
+	set_entity_linkage(existing, get_entity_linkage(imported) | hidden);
+}
+
+/** Walker, replaces references to linked entities. */
+static void replace_linked_entity(ir_node *node, void *data)
+{
+	pmap *replacements = (pmap*)data;
+	if (is_SymConst(node) && SYMCONST_HAS_ENT(get_SymConst_kind(node))) {
+		ir_entity *entity = pmap_get(ir_entity, replacements,
+		                             get_SymConst_entity(node));
+		if (entity != NULL)
+			set_SymConst_entity(node, entity);
+	} else if (is_Sel(node)) {
+		ir_entity *entity = pmap_get(ir_entity, replacements,
+		                             get_Sel_entity(node));
+		if (entity != NULL)
+			set_Sel_entity(node, entity);
+	}
+}
+
+/**
+ * Merges the imported entities which have the linker name of an entity of
+ * the program into that entity. The stronger definition survives, two
+ * normal definitions of a symbol are an error.
+ */
+static void link_entities(read_env_t *env)
+{
+	size_t n_pairs = ARR_LEN(env->link_pairs);
+	if (n_pairs == 0)
+		return;
+
+	pmap      *replacements = pmap_create();
+	ir_graph **dead_irgs    = NEW_ARR_F(ir_graph*, 0);
+	for (size_t i = 0; i < n_pairs; ++i) {
+		ir_entity *existing = env->link_pairs[i].existing;
+		ir_entity *imported = env->link_pairs[i].imported;
+		int existing_strength = get_definition_strength(existing);
+		int imported_strength = get_definition_strength(imported);
+		if (existing_strength == 2 && imported_strength == 2) {
+			parse_error(env, "multiple definitions of '%s'\n",
+			            get_id_str(get_entity_ld_ident(existing)));
+		}
+		if (imported_strength > existing_strength) {
+			take_definition(existing, imported, &dead_irgs);
+		} else if (is_method_entity(imported)
+		           && get_entity_irg(imported) != NULL) {
+			ir_graph *irg = get_entity_irg(imported);
+			set_irg_entity(irg, NULL);
+			set_entity_irg(imported, NULL);
+			ARR_APP1(ir_graph*, dead_irgs, irg);
+		}
+		pmap_insert(replacements, imported, existing);
+	}
+
+	for (size_t i = env->first_irg, n = get_irp_n_irgs(); i < n; ++i)
+		irg_walk_graph(get_irp_irg(i), replace_linked_entity, NULL,
+		               replacements);
+	walk_const_code(replace_linked_entity, NULL, replacements);
+
+	for (size_t i = 0, n = ARR_LEN(dead_irgs); i < n; ++i)
+		free_ir_graph(dead_irgs[i]);
+	for (size_t i = 0; i < n_pairs; ++i)
+		free_entity(env->link_pairs[i].imported);
+
+	DEL_ARR_F(dead_irgs);
+	pmap_destroy(replacements);
+}
+
+/**
+ * Moves the members of an imported segment type into the segment of the
+ * program.
+ */
+static void link_segment(ir_segment_t segment, ir_type *type)
+{
+	ir_type *existing = get_segment_type(segment);
+	if (existing == NULL) {
+		set_segment_type(segment, type);
+		return;
+	}
+	if (existing == type)
+		return;
+	while (get_compound_n_members(type) > 0)
+		set_entity_owner(get_compound_member(type, 0), existing);
+	free_type(type);
+}
+
+/** Prepares linking the input with the current program. */
+static void init_link(read_env_t *env)
+{
+	env->symbols      = pmap_create();
+	env->linked_types = new_set(cmp_linked_type, 64);
+	env->link_pairs   = NEW_ARR_F(link_pair_t, 0);
+	env->first_irg    = get_irp_n_irgs();
+
+	for (ir_segment_t s = IR_SEGMENT_FIRST; s <= IR_SEGMENT_LAST; ++s) {
+		ir_type *segment = get_segment_type(s);
+		if (segment == NULL)
+			continue;
+		for (size_t i = 0, n = get_compound_n_members(segment); i < n; ++i) {
+			ir_entity *member = get_compound_member(segment, i);
+			pmap_insert(env->symbols, get_entity_ld_ident(member), member);
+		}
+	}
+	for (size_t i = 0, n = get_irp_n_types(); i < n; ++i) {
+		ir_type *type = get_irp_type(i);
+		if (is_linked_type(type)) {
+			(void)set_insert(ir_type*, env->linked_types, &type, sizeof(type),
+			                 hash_linked_type(type));
+		}
+	}
+}
+
+static void finish_link(read_env_t *env)
+{
+	link_entities(env);
+	DEL_ARR_F(env->link_pairs);
+	del_set(env->linked_types);
+	pmap_destroy(env->symbols);
+}
+
 /** Reads a type description and remembers it by its id. */
 static void read_type(read_env_t *env)
 {
@@ -1794,6 +2856,9 @@ finish_type:
 	set_type_alignment_bytes(type, align);
 	type->flags = flags;
 
+	if (env->link)
+		type = link_type(env, type);
+
 	if (state == layout_fixed)
 		ARR_APP1(ir_type *, env->fixedtypes, type);
 
@@ -1902,6 +2967,10 @@ static void read_entity(read_env_t *env, ir_entity_kind kind)
 		set_array_element_entity(owner, entity);
 	}
 
+	if (env->link && owner != NULL && is_segment(owner)
+	    && (kind == IR_ENTITY_NORMAL || kind == IR_ENTITY_METHOD))
+		link_entity(env, entity);
+
 	set_id(env, entnr, entity);
 }
 
@@ -1917,11 +2986,8 @@ static void read_typegraph(read_env_t *env)
 	/* parse all types first */
 	while (true) {
 		keyword_t kwkind;
-		skip_ws(env);
-		if (env->c == '}') {
-			read_c(env);
+		if (scope_end(env, false))
 			break;
-		}
 
 		kwkind = read_keyword(env);
 		switch (kwkind) {
@@ -2136,7 +3202,10 @@ static ir_node *read_node(read_env_t *env)
 
 static void readers_init(void)
 {
-	assert(node_readers == NULL);
+	/* Only initialize once */
+	if (node_readers != NULL)
+		return;
+
 	node_readers = pmap_create();
 	register_node_reader(new_id_from_str("Anchor"),   read_Anchor);
 	register_node_reader(new_id_from_str("ASM"),      read_ASM);
@@ -2157,11 +3226,8 @@ static void read_graph(read_env_t *env, ir_graph *irg)
 
 	EXPECT('{');
 	while (true) {
-		skip_ws(env);
-		if (env->c == '}' || env->c == EOF) {
-			read_c(env);
+		if (scope_end(env, true))
 			break;
-		}
 
 		read_node(env);
 	}
@@ -2203,7 +3269,21 @@ static ir_graph *read_irg(read_env_t *env)
 	ir_graph  *irg    = new_ir_graph(irgent, 0);
 	ir_type   *frame  = read_type_ref(env);
 	set_irg_frame_type(irg, frame);
+
+	size_t               n_strings = env->binary ? ARR_LEN(env->strings) : 0;
+	const unsigned char *end       = read_section_begin(env);
+	if (env->lazy) {
+		/* remember the body and read it when it is needed */
+		lazy_body_t *body = XMALLOC(lazy_body_t);
+		body->begin     = env->pos;
+		body->end       = end;
+		body->n_strings = n_strings;
+		irg->lazy_body  = body;
+		env->pos        = end;
+		return irg;
+	}
 	read_graph(env, irg);
+	read_section_end(env, end, n_strings);
 	irg_finalize_cons(irg);
 	return irg;
 }
@@ -2215,11 +3295,8 @@ static void read_modes(read_env_t *env)
 	while (true) {
 		keyword_t kwkind;
 
-		skip_ws(env);
-		if (env->c == '}' || env->c == EOF) {
-			read_c(env);
+		if (scope_end(env, true))
 			break;
-		}
 
 		kwkind = read_keyword(env);
 		switch (kwkind) {
@@ -2255,6 +3332,14 @@ static void read_modes(read_env_t *env)
 			new_float_mode(name, arith, exponent_size, mantissa_size);
 			break;
 		}
+		case kw_vector_mode: {
+			/* the name must survive reading the element mode */
+			ident    *name      = read_ident(env);
+			ir_mode  *elem_mode = read_mode_ref(env);
+			unsigned  n_elems   = read_long(env);
+			new_vector_mode(get_id_str(name), elem_mode, n_elems);
+			break;
+		}
 
 		default:
 			skip_to(env, '\n');
@@ -2270,18 +3355,19 @@ static void read_program(read_env_t *env)
 	while (true) {
 		keyword_t kwkind;
 
-		skip_ws(env);
-		if (env->c == '}') {
-			read_c(env);
+		if (scope_end(env, false))
 			break;
-		}
 
 		kwkind = read_keyword(env);
 		switch (kwkind) {
 		case kw_segment_type: {
 			ir_segment_t  segment = (ir_segment_t) read_enum(env, tt_segment);
 			ir_type      *type    = read_type_ref(env);
-			set_segment_type(segment, type);
+			if (env->link) {
+				link_segment(segment, type);
+			} else {
+				set_segment_type(segment, type);
+			}
 			break;
 		}
 		case kw_asm: {
@@ -2311,15 +3397,8 @@ int ir_import(const char *filename)
 	return res;
 }
 
-int ir_import_file(FILE *input, const char *inputname)
+static void init_read_env(read_env_t *env, const char *inputname)
 {
-	read_env_t          myenv;
-	int                 oldoptimize = get_optimize();
-	read_env_t         *env         = &myenv;
-	size_t              i;
-	size_t              n;
-	size_t              n_delayed_initializers;
-
 	readers_init();
 	symtbl_init();
 
@@ -2329,9 +3408,42 @@ int ir_import_file(FILE *input, const char *inputname)
 	env->idset      = new_set(id_cmp, 128);
 	env->fixedtypes = NEW_ARR_F(ir_type *, 0);
 	env->inputname  = inputname;
-	env->file       = input;
 	env->line       = 1;
 	env->delayed_initializers = NEW_ARR_F(delayed_initializer_t, 0);
+}
+
+static int import_irp(read_env_t *env);
+
+static int import_buffer(read_env_t *env, const void *data, size_t size,
+                         const char *inputname, bool lazy, bool link);
+
+static int import_file(FILE *input, const char *inputname, bool link)
+{
+	read_env_t myenv;
+	read_env_t *env = &myenv;
+
+	/* binary files are read into memory completely */
+	int c = fgetc(input);
+	ungetc(c, input);
+	if (c == (unsigned char)binary_magic[0]) {
+		size_t  size = 0;
+		size_t  cap  = 4096;
+		char   *data = XMALLOCN(char, cap);
+		while (true) {
+			size += fread(data + size, 1, cap - size, input);
+			if (size < cap)
+				break;
+			cap *= 2;
+			data = XREALLOC(data, char, cap);
+		}
+		int res = import_buffer(env, data, size, inputname, false, link);
+		free(data);
+		return res;
+	}
+
+	init_read_env(env, inputname);
+	env->file = input;
+	env->link = link;
 
 	/* read first character */
 	read_c(env);
@@ -2340,13 +3452,142 @@ int ir_import_file(FILE *input, const char *inputname)
 	if (env->c == '#')
 		skip_to(env, '\n');
 
+	return import_irp(env);
+}
+
+int ir_import_file(FILE *input, const char *inputname)
+{
+	return import_file(input, inputname, false);
+}
+
+int ir_import_link(const char *filename)
+{
+	FILE *file = fopen(filename, "rt");
+	if (file == NULL) {
+		perror(filename);
+		return 1;
+	}
+
+	int res = import_file(file, filename, true);
+	fclose(file);
+	return res;
+}
+
+/** The reader state of the active lazy import, if there is one. */
+static read_env_t *lazy_env;
+
+static int import_buffer(read_env_t *env, const void *data, size_t size,
+                         const char *inputname, bool lazy, bool link)
+{
+	if (size < BINARY_MAGIC_SIZE
+	    || memcmp(data, binary_magic, BINARY_MAGIC_SIZE) != 0) {
+		fprintf(stderr, "%s: not a binary firm file\n", inputname);
+		return 1;
+	}
+
+	init_read_env(env, inputname);
+	env->binary  = true;
+	env->lazy    = lazy;
+	env->link    = link;
+	env->pos     = (const unsigned char*)data + BINARY_MAGIC_SIZE;
+	env->end     = (const unsigned char*)data + size;
+	env->strings = NEW_ARR_F(const char*, 0);
+
+	int res = import_irp(env);
+	if (lazy) {
+		/* only strings outside of sections are left now */
+		env->global_strings = env->strings;
+		env->strings        = NEW_ARR_F(const char*, 0);
+	} else {
+		DEL_ARR_F(env->strings);
+	}
+	return res;
+}
+
+int ir_import_buffer(const void *data, size_t size, const char *inputname)
+{
+	read_env_t myenv;
+	return import_buffer(&myenv, data, size, inputname, false, false);
+}
+
+int ir_import_buffer_lazy(const void *data, size_t size,
+                          const char *inputname)
+{
+	if (lazy_env != NULL)
+		panic("only one lazy import may be active at a time");
+
+	lazy_env = XMALLOC(read_env_t);
+	return import_buffer(lazy_env, data, size, inputname, true, false);
+}
+
+void ir_load_irg_body(ir_graph *irg)
+{
+	lazy_body_t *body = irg->lazy_body;
+	if (body == NULL)
+		return;
+	irg->lazy_body = NULL;
+
+	read_env_t *env = lazy_env;
+	assert(env != NULL);
+
+	/* restore the string table as it was at the start of the section */
+	size_t n_strings = body->n_strings;
+	ARR_RESIZE(const char*, env->strings, n_strings);
+	memcpy(env->strings, env->global_strings, n_strings * sizeof(*env->strings));
+	env->pos = body->begin;
+	env->end = body->end;
+
+	int oldoptimize = get_optimize();
+	set_optimize(0);
+	add_irg_constraints(irg, IR_GRAPH_CONSTRAINT_CONSTRUCTION);
+	read_graph(env, irg);
+	read_section_end(env, body->end, n_strings);
+	irg_finalize_cons(irg);
+	set_optimize(oldoptimize);
+
+	free(body);
+}
+
+void ir_finish_lazy_import(void)
+{
+	read_env_t *env = lazy_env;
+	if (env == NULL)
+		return;
+
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		free(irg->lazy_body);
+		irg->lazy_body = NULL;
+	}
+
+	DEL_ARR_F(env->strings);
+	DEL_ARR_F(env->global_strings);
+	del_set(env->idset);
+	obstack_free(&env->preds_obst, NULL);
+	obstack_free(&env->obst, NULL);
+	free(env);
+	lazy_env = NULL;
+
+	pmap_destroy(node_readers);
+	node_readers = NULL;
+}
+
+static int import_irp(read_env_t *env)
+{
+	int    oldoptimize = get_optimize();
+	size_t i;
+	size_t n;
+	size_t n_delayed_initializers;
+
 	set_optimize(0);
 
+	if (env->link)
+		init_link(env);
+
 	while (true) {
 		keyword_t kw;
 
-		skip_ws(env);
-		if (env->c == EOF)
+		if (input_end(env))
 			break;
 
 		kw = read_keyword(env);
@@ -2404,17 +3645,31 @@ int ir_import_file(FILE *input, const char *inputname)
 	DEL_ARR_F(env->delayed_initializers);
 	env->delayed_initializers = NULL;
 
-	del_set(env->idset);
+	/* graphs whose body has not been read yet are finalized later */
+	for (i = env->first_irg, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		if (irg->lazy_body == NULL)
+			irg_finalize_cons(irg);
+	}
 
-	irp_finalize_cons();
+	if (env->link)
+		finish_link(env);
 
 	set_optimize(oldoptimize);
 
+	/* a lazy import needs the reader state to read the graph bodies */
+	if (env->lazy)
+		return env->read_errors;
+
+	del_set(env->idset);
+
 	obstack_free(&env->preds_obst, NULL);
 	obstack_free(&env->obst, NULL);
 
-	pmap_destroy(node_readers);
-	node_readers = NULL;
+	if (lazy_env == NULL) {
+		pmap_destroy(node_readers);
+		node_readers = NULL;
+	}
 
 	return env->read_errors;
 }
@@ -34,7 +34,9 @@ static bool modes_are_equal(const ir_mode *m, const ir_mode *n)
 	       m->arithmetic   == n->arithmetic &&
 	       m->size         == n->size &&
 	       m->sign         == n->sign &&
-	       m->modulo_shift == n->modulo_shift;
+	       m->modulo_shift == n->modulo_shift &&
+	       m->vector_elem_mode == n->vector_elem_mode &&
+	       m->n_vector_elems == n->n_vector_elems;
 }
 
 /**
@@ -89,6 +91,7 @@ static void set_mode_values(ir_mode* mode)
 	case irms_any:
 	case irms_bad:
 	case irms_memory:
+	case irms_vector:
 		mode->min  = tarval_bad;
 		mode->max  = tarval_bad;
 		mode->null = tarval_bad;
@@ -187,6 +190,7 @@ static ir_mode *alloc_mode(const char *name, ir_mode_sort sort,
 	mode_tmpl->sign         = sign ? 1 : 0;
 	mode_tmpl->modulo_shift = modulo_shift;
 	mode_tmpl->arithmetic   = arithmetic;
+	mode_tmpl->n_vector_elems = 1;
 	mode_tmpl->link         = NULL;
 	mode_tmpl->tv_priv      = NULL;
 	return mode_tmpl;
@@ -251,6 +255,23 @@ ir_mode *new_float_mode(const char *name, ir_mode_arithmetic arithmetic,
 	return register_mode(result);
 }
 
+ir_mode *new_vector_mode(const char *name, ir_mode *elem_mode,
+                         unsigned n_elems)
+{
+	if (!mode_is_num(elem_mode) && !mode_is_reference(elem_mode))
+		panic("Vector elements must be numbers or references");
+	if (n_elems < 2)
+		panic("Vector modes need at least 2 elements");
+
+	ir_mode *result = alloc_mode(name, irms_vector,
+	                             get_mode_arithmetic(elem_mode),
+	                             n_elems * get_mode_size_bits(elem_mode),
+	                             get_mode_sign(elem_mode), 0);
+	result->vector_elem_mode = elem_mode;
+	result->n_vector_elems   = n_elems;
+	return register_mode(result);
+}
+
 ident *(get_mode_ident)(const ir_mode *mode)
 {
 	return get_mode_ident_(mode);
@@ -380,6 +401,21 @@ int (mode_is_int)(const ir_mode *mode)
 	return mode_is_int_(mode);
 }
 
+int (mode_is_vector)(const ir_mode *mode)
+{
+	return mode_is_vector_(mode);
+}
+
+unsigned (get_mode_n_vector_elems)(const ir_mode *mode)
+{
+	return get_mode_n_vector_elems_(mode);
+}
+
+ir_mode *(get_mode_vector_elem_mode)(const ir_mode *mode)
+{
+	return get_mode_vector_elem_mode_(mode);
+}
+
 int (mode_is_reference)(const ir_mode *mode)
 {
 	return mode_is_reference_(mode);
@@ -690,6 +726,14 @@ ir_mode *ir_get_mode(size_t num)
 	return mode_list[num];
 }
 
+void init_mode_types(void)
+{
+	for (size_t i = 0, n = ARR_LEN(mode_list); i < n; ++i) {
+		ir_mode *mode = mode_list[i];
+		mode->type = new_type_primitive(mode);
+	}
+}
+
 void finish_mode(void)
 {
 	obstack_free(&modes, 0);
@@ -30,6 +30,9 @@
 #define mode_is_float(mode)            mode_is_float_(mode)
 #define mode_is_int(mode)              mode_is_int_(mode)
 #define mode_is_reference(mode)        mode_is_reference_(mode)
+#define mode_is_vector(mode)           mode_is_vector_(mode)
+#define get_mode_n_vector_elems(mode)  get_mode_n_vector_elems_(mode)
+#define get_mode_vector_elem_mode(mode) get_mode_vector_elem_mode_(mode)
 #define mode_is_num(mode)              mode_is_num_(mode)
 #define mode_is_data(mode)             mode_is_data_(mode)
 #define mode_is_datab(mode)            mode_is_datab_(mode)
@@ -122,6 +125,22 @@ static inline int mode_is_reference_(const ir_mode *mode)
 	return (get_mode_sort(mode) == irms_reference);
 }
 
+static inline int mode_is_vector_(const ir_mode *mode)
+{
+	return (get_mode_sort(mode) == irms_vector);
+}
+
+static inline unsigned get_mode_n_vector_elems_(const ir_mode *mode)
+{
+	return mode->n_vector_elems;
+}
+
+static inline ir_mode *get_mode_vector_elem_mode_(const ir_mode *mode)
+{
+	return mode->vector_elem_mode != NULL ? mode->vector_elem_mode
+	                                      : (ir_mode*)mode;
+}
+
 static inline int mode_is_num_(const ir_mode *mode)
 {
 	return (get_mode_sort(mode) & irmsh_is_num);
@@ -163,4 +182,10 @@ void init_mode(void);
 /** mode module finalization. frees all memory.  */
 void finish_mode(void);
 
+/**
+ * Creates new primitive types for all modes. The types belong to the current
+ * irp, so this is needed when a new irp replaces the one they were made for.
+ */
+void init_mode_types(void);
+
 #endif
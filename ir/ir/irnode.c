@@ -11,6 +11,7 @@
 #include <string.h>
 
 #include "pset_new.h"
+#include "array_t.h"
 #include "ident.h"
 #include "irnode_t.h"
 #include "irgraph_t.h"
@@ -81,8 +82,19 @@ ir_node *new_ir_node(dbg_info *db, ir_graph *irg, ir_node *block, ir_op *op,
 	assert(op);
 	assert(mode);
 
-	size_t   const node_size = offsetof(ir_node, attr) + op->attr_size;
-	ir_node *const res       = (ir_node*)OALLOCNZ(get_irg_obstack(irg), char, node_size);
+	struct obstack *const obst = get_irg_obstack(irg);
+
+	/* The operands of nodes with a fixed number of them are stored in the
+	 * same allocation directly behind the node; only the dynamic arrays of
+	 * End and Sync and the arrays of nodes under construction live elsewhere.
+	 * Node sizes are only aligned to pointers, so this also saves the
+	 * padding the obstack would insert between two allocations. */
+	bool   const in_inline = arity >= 0 && op->opar != oparity_dynamic;
+	size_t const node_size = offsetof(ir_node, attr) + op->attr_size;
+	size_t const in_offset = (node_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	size_t const size      = in_inline
+		? in_offset + ARR_D_SIZE(ir_node*, arity + 1) : node_size;
+	ir_node *const res = (ir_node*)OALLOCNZ(obst, char, size);
 
 	res->kind     = k_ir_node;
 	res->op       = op;
@@ -95,11 +107,12 @@ ir_node *new_ir_node(dbg_info *db, ir_graph *irg, ir_node *block, ir_op *op,
 	if (arity < 0) {
 		res->in = NEW_ARR_F(ir_node *, 1);  /* 1: space for block */
 	} else {
-		/* not nice but necessary: End and Sync must always have a flexible array */
-		if (op == op_End || op == op_Sync)
+		if (in_inline) {
+			res->in = INIT_ARR_D(ir_node*, (char*)res + in_offset, arity + 1);
+		} else {
+			/* not nice but necessary: End and Sync must always have a flexible array */
 			res->in = NEW_ARR_F(ir_node *, (arity+1));
-		else
-			res->in = NEW_ARR_D(ir_node*, get_irg_obstack(irg), arity + 1);
+		}
 		memcpy(&res->in[1], in, sizeof(ir_node *) * arity);
 	}
 
@@ -160,10 +173,13 @@ void set_irn_in(ir_node *const node, int const arity, ir_node *const *const in)
 #endif
 
 	for (i = 0; i < arity; i++) {
-		if (i < (int)ARR_LEN(*pOld_in)-1)
+		if (i < (int)ARR_LEN(*pOld_in)-1) {
+			hook_set_irn_n(node, i, in[i], (*pOld_in)[i+1]);
 			edges_notify_edge(node, i, in[i], (*pOld_in)[i+1], irg);
-		else
+		} else {
+			hook_set_irn_n(node, i, in[i], NULL);
 			edges_notify_edge(node, i, in[i], NULL,            irg);
+		}
 	}
 	for (;i < (int)ARR_LEN(*pOld_in)-1; i++) {
 		edges_notify_edge(node, i, NULL, (*pOld_in)[i+1], irg);
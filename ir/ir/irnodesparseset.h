@@ -0,0 +1,141 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   A nodeset implemented as sparse set over the node indices.
+ *
+ * A dense array holds the members in insertion order while a sparse array
+ * maps node indices to positions in the dense array. Insert, remove and
+ * lookup take constant time, clearing the set takes constant time and
+ * iterating only visits the members. Both arrays grow automatically, so
+ * nodes created after initialisation may be inserted as well. This is
+ * preferable over ir_nodeset_t if the set is cleared and refilled often.
+ */
+#ifndef FIRM_IRNODESPARSESET_H
+#define FIRM_IRNODESPARSESET_H
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "firm_types.h"
+#include "array.h"
+#include "irnode.h"
+#include "irgraph.h"
+
+typedef struct ir_nodesparseset_t {
+	unsigned  *sparse; /**< maps node indices to positions in dense */
+	ir_node  **dense;  /**< the members in insertion order */
+} ir_nodesparseset_t;
+
+/**
+ * Initializes a sparse nodeset with enough room for all nodes currently in
+ * @p irg.
+ */
+static inline void ir_nodesparseset_init(ir_nodesparseset_t *set,
+                                         const ir_graph *irg)
+{
+	set->sparse = NEW_ARR_FZ(unsigned, get_irg_last_idx(irg));
+	set->dense  = NEW_ARR_F(ir_node*, 0);
+}
+
+/**
+ * Frees the memory used by the set but not the set struct itself.
+ */
+static inline void ir_nodesparseset_destroy(ir_nodesparseset_t *set)
+{
+	DEL_ARR_F(set->sparse);
+	DEL_ARR_F(set->dense);
+	set->sparse = NULL;
+	set->dense  = NULL;
+}
+
+/**
+ * Tests whether @p node is a member of the set.
+ */
+static inline bool ir_nodesparseset_contains(const ir_nodesparseset_t *set,
+                                             const ir_node *node)
+{
+	unsigned idx = get_irn_idx(node);
+	if (idx >= ARR_LEN(set->sparse))
+		return false;
+	unsigned pos = set->sparse[idx];
+	return pos < ARR_LEN(set->dense) && set->dense[pos] == node;
+}
+
+/**
+ * Inserts @p node into the set.
+ *
+ * @returns true if the node has been inserted, false if it was already there
+ */
+static inline bool ir_nodesparseset_insert(ir_nodesparseset_t *set,
+                                           ir_node *node)
+{
+	if (ir_nodesparseset_contains(set, node))
+		return false;
+
+	unsigned idx = get_irn_idx(node);
+	size_t   len = ARR_LEN(set->sparse);
+	if (idx >= len) {
+		ARR_RESIZE(unsigned, set->sparse, idx+1);
+		memset(set->sparse + len, 0, (idx+1-len) * sizeof(set->sparse[0]));
+	}
+	set->sparse[idx] = ARR_LEN(set->dense);
+	ARR_APP1(ir_node*, set->dense, node);
+	return true;
+}
+
+/**
+ * Removes @p node from the set. Does nothing if it is not a member.
+ * The last member takes the place of the removed one.
+ */
+static inline void ir_nodesparseset_remove(ir_nodesparseset_t *set,
+                                           const ir_node *node)
+{
+	if (!ir_nodesparseset_contains(set, node))
+		return;
+
+	unsigned  pos  = set->sparse[get_irn_idx(node)];
+	size_t    len  = ARR_LEN(set->dense);
+	ir_node  *last = set->dense[len-1];
+	set->dense[pos] = last;
+	set->sparse[get_irn_idx(last)] = pos;
+	ARR_SHRINKLEN(set->dense, len-1);
+}
+
+/**
+ * Removes all members from the set in constant time.
+ */
+static inline void ir_nodesparseset_clear(ir_nodesparseset_t *set)
+{
+	ARR_SHRINKLEN(set->dense, 0);
+}
+
+/**
+ * Returns the number of members of the set.
+ */
+static inline size_t ir_nodesparseset_size(const ir_nodesparseset_t *set)
+{
+	return ARR_LEN(set->dense);
+}
+
+/**
+ * Returns the members of the set in insertion order. The array is only valid
+ * until the set is modified.
+ */
+static inline ir_node **ir_nodesparseset_nodes(const ir_nodesparseset_t *set)
+{
+	return set->dense;
+}
+
+/**
+ * Iterates over all members of the set in insertion order.
+ * @attention It is not allowed to insert or remove nodes while iterating.
+ */
+#define foreach_ir_nodesparseset(set, irn) \
+	for (size_t irn##__i = 0, irn##__n = ir_nodesparseset_size(set); irn##__i < irn##__n; ++irn##__i) \
+		for (ir_node *irn = (set)->dense[irn##__i]; irn != NULL; irn = NULL)
+
+#endif
@@ -877,123 +877,24 @@ static ir_node *equivalent_node_Sub(ir_node *n)
 }
 
 
-/**
- * Optimize an "self-inverse unary op", i.e. op(op(n)) = n.
- *
- * @todo
- *   -(-a) == a, but might overflow two times.
- *   We handle it anyway here but the better way would be a
- *   flag. This would be needed for Pascal for instance.
- */
-static ir_node *equivalent_node_involution(ir_node *n, int input)
-{
-	ir_node *oldn = n;
-	ir_node *pred = get_irn_n(n, input);
-	if (get_irn_op(pred) == get_irn_op(n)) {
-		n = get_irn_n(pred, input);
-		DBG_OPT_ALGSIM2(oldn, pred, n, FS_OPT_INVOLUTION);
-	}
-	return n;
-}
-
-static ir_node *equivalent_node_Minus(ir_node *n)
-{
-	return equivalent_node_involution(n, n_Minus_op);
-}
-
-static ir_node *equivalent_node_Not(ir_node *n)
-{
-	return equivalent_node_involution(n, n_Not_op);
-}
-
-/**
- * Optimize a * 1 = 1 * a = a.
- */
-static ir_node *equivalent_node_Mul(ir_node *n)
-{
-	ir_node *oldn = n;
-	ir_node *a = get_Mul_left(n);
-
-	/* we can handle here only the n * n = n bit cases */
-	if (get_irn_mode(n) == get_irn_mode(a)) {
-		ir_node   *b = get_Mul_right(n);
-		ir_tarval *tv;
-
-		/*
-		 * Mul is commutative and has again an other neutral element.
-		 * Constants are place right, so check this case first.
-		 */
-		tv = value_of(b);
-		if (tarval_is_one(tv)) {
-			n = a;
-			DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_NEUTRAL_1);
-		} else {
-			tv = value_of(a);
-			if (tarval_is_one(tv)) {
-				n = b;
-				DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_NEUTRAL_1);
-			}
-		}
-	}
-	return n;
-}
-
-/**
- * Use algebraic simplification a | a = a | 0 = 0 | a = a.
- */
-static ir_node *equivalent_node_Or(ir_node *n)
-{
-	ir_node *oldn = n;
-
-	ir_node   *a = get_Or_left(n);
-	ir_node   *b = get_Or_right(n);
-	ir_tarval *tv;
-
-	if (a == b) {
-		n = a;    /* idempotence */
-		DBG_OPT_ALGSIM0(oldn, n, FS_OPT_OR);
-		return n;
-	}
-	/* constants are normalized to right, check this side first */
-	tv = value_of(b);
-	if (tarval_is_null(tv)) {
-		n = a;
-		DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_OR);
-		return n;
-	}
-	tv = value_of(a);
-	if (tarval_is_null(tv)) {
-		n = b;
-		DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_OR);
-		return n;
-	}
-
-	return n;
-}
+/* equivalent_node_rules_*() for the rules of scripts/ir_rules.py */
+#include "gen_irrules.c.inl"
 
 /**
- * Optimize a & 0b1...1 = 0b1...1 & a = a & a = (a|X) & a = a.
+ * Optimize Conv(a) & 0b1...1 = (a|X) & a = a, the simple cases are rules in
+ * scripts/ir_rules.py.
  */
 static ir_node *equivalent_node_And(ir_node *n)
 {
 	ir_node *oldn = n;
 
-	ir_node   *a = get_And_left(n);
-	ir_node   *b = get_And_right(n);
-	ir_tarval *tv;
-
-	if (a == b) {
-		n = a;    /* idempotence */
-		DBG_OPT_ALGSIM0(oldn, n, FS_OPT_AND);
-		return n;
-	}
-	/* constants are normalized to right, check this side first */
-	tv = value_of(b);
-	if (tarval_is_all_one(tv)) {
-		n = a;
-		DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_AND);
+	n = equivalent_node_rules_And(n);
+	if (n != oldn)
 		return n;
-	}
+
+	ir_node   *a  = get_And_left(n);
+	ir_node   *b  = get_And_right(n);
+	ir_tarval *tv = value_of(b);
 	if (tv != get_tarval_bad()) {
 		ir_mode *mode = get_irn_mode(n);
 		if (!mode_is_signed(mode) && is_Conv(a)) {
@@ -1014,12 +915,6 @@ static ir_node *equivalent_node_And(ir_node *n)
 			}
 		}
 	}
-	tv = value_of(a);
-	if (tarval_is_all_one(tv)) {
-		n = b;
-		DBG_OPT_ALGSIM1(oldn, a, b, n, FS_OPT_AND);
-		return n;
-	}
 	/* (a|X) & a => a*/
 	if ((is_Or(a) || is_Or_Eor_Add(a))
 	    && (b == get_binop_left(a) || b == get_binop_right(a))) {
@@ -5936,6 +5831,16 @@ handle_tv:
 		}
 		return false;
 	}
+	case IR_INITIALIZER_BYTES: {
+		const unsigned char *data
+			= (const unsigned char*)get_initializer_bytes_data(initializer);
+		size_t n_bytes = get_initializer_bytes_size(initializer);
+		for (unsigned b = offset <= 0 ? 0 : (unsigned)offset;
+		     b < initializer_size && b < (unsigned)offset + mode_size; ++b) {
+			buf[b-offset] = b < n_bytes ? data[b] : 0;
+		}
+		return true;
+	}
 	case IR_INITIALIZER_COMPOUND:
 		if (is_Array_type(type)) {
 			ir_type *el_type = get_array_element_type(type);
@@ -6066,6 +5971,10 @@ handle_tv:;
 		 * here, but it's unclear to me if that improves things */
 		return NULL;
 	}
+	case IR_INITIALIZER_BYTES:
+		if (offset + (long)get_mode_size_bytes(mode) > size)
+			return NULL;
+		return sim_store_load(type, initializer, offset, mode, irg);
 	case IR_INITIALIZER_COMPOUND: {
 		if (is_Array_type(type)) {
 			ir_type *el_type = get_array_element_type(type);
@@ -6422,11 +6331,11 @@ void ir_register_opt_node_ops(void)
 	register_equivalent_node_func(op_CopyB,   equivalent_node_CopyB);
 	register_equivalent_node_func(op_Eor,     equivalent_node_Eor);
 	register_equivalent_node_func(op_Id,      equivalent_node_Id);
-	register_equivalent_node_func(op_Minus,   equivalent_node_Minus);
-	register_equivalent_node_func(op_Mul,     equivalent_node_Mul);
+	register_equivalent_node_func(op_Minus,   equivalent_node_rules_Minus);
+	register_equivalent_node_func(op_Mul,     equivalent_node_rules_Mul);
 	register_equivalent_node_func(op_Mux,     equivalent_node_Mux);
-	register_equivalent_node_func(op_Not,     equivalent_node_Not);
-	register_equivalent_node_func(op_Or,      equivalent_node_Or);
+	register_equivalent_node_func(op_Not,     equivalent_node_rules_Not);
+	register_equivalent_node_func(op_Or,      equivalent_node_rules_Or);
 	register_equivalent_node_func(op_Phi,     equivalent_node_Phi);
 	register_equivalent_node_func(op_Proj,    equivalent_node_Proj);
 	register_equivalent_node_func(op_Shl,     equivalent_node_left_zero);
@@ -6548,17 +6457,48 @@ unsigned ir_node_hash(const ir_node *node)
 	return node->op->ops.hash(node);
 }
 
+/**
+ * Wrapper turning identities_cmp() into a cpset equality function.
+ */
+static int identities_equal(const void *elt, const void *key)
+{
+	return identities_cmp(elt, key) == 0;
+}
+
+static unsigned identities_hash(const void *node)
+{
+	return ir_node_hash((const ir_node*)node);
+}
+
+void free_value_table(cpset_t *value_table)
+{
+	cpset_destroy(value_table);
+	free(value_table);
+}
+
+void new_identities_custom(ir_graph *irg, cpset_cmp_function equal)
+{
+	cpset_t *value_table = irg->value_table;
+	if (value_table != NULL) {
+		cpset_destroy(value_table);
+	} else {
+		value_table = XMALLOC(cpset_t);
+	}
+	cpset_init_size(value_table, identities_hash, equal, N_IR_NODES);
+	irg->value_table = value_table;
+}
+
 void new_identities(ir_graph *irg)
 {
-	if (irg->value_table != NULL)
-		del_pset(irg->value_table);
-	irg->value_table = new_pset(identities_cmp, N_IR_NODES);
+	new_identities_custom(irg, identities_equal);
 }
 
 void del_identities(ir_graph *irg)
 {
-	if (irg->value_table != NULL)
-		del_pset(irg->value_table);
+	if (irg->value_table != NULL) {
+		free_value_table(irg->value_table);
+		irg->value_table = NULL;
+	}
 }
 
 static int cmp_node_nr(const void *a, const void *b)
@@ -6615,7 +6555,7 @@ void ir_normalize_node(ir_node *n)
 ir_node *identify_remember(ir_node *n)
 {
 	ir_graph *irg         = get_irn_irg(n);
-	pset     *value_table = irg->value_table;
+	cpset_t  *value_table = irg->value_table;
 	ir_node  *nn;
 
 	if (value_table == NULL)
@@ -6623,7 +6563,7 @@ ir_node *identify_remember(ir_node *n)
 
 	ir_normalize_node(n);
 	/* lookup or insert in hash table with given hash key. */
-	nn = (ir_node*)pset_insert(value_table, n, ir_node_hash(n));
+	nn = (ir_node*)cpset_insert(value_table, n);
 
 	if (nn != n) {
 		/* n is reachable again */
@@ -6662,12 +6602,21 @@ void add_identities(ir_node *node)
 	identify_remember(node);
 }
 
+void remove_identities(ir_node *node)
+{
+	cpset_t *value_table = get_irn_irg(node)->value_table;
+	if (value_table != NULL && cpset_find(value_table, node) == node)
+		cpset_remove(value_table, node);
+}
+
 void visit_all_identities(ir_graph *irg, irg_walk_func visit, void *env)
 {
 	ir_graph *rem = current_ir_graph;
 
 	current_ir_graph = irg;
-	foreach_pset(irg->value_table, ir_node, node) {
+	cpset_iterator_t iter;
+	cpset_iterator_init(&iter, irg->value_table);
+	for (ir_node *node; (node = (ir_node*)cpset_iterator_next(&iter)) != NULL;) {
 		visit(node, env);
 	}
 	current_ir_graph = rem;
@@ -6682,6 +6631,8 @@ ir_node *optimize_node(ir_node *n)
 
 	/* Always optimize Phi nodes: part of the construction. */
 	if ((!get_opt_optimize()) && (iro != iro_Phi)) return n;
+	/* in a bulk construction the nodes are optimized at its end */
+	if (irg->in_bulk_cons && iro != iro_Phi) return n;
 
 	/* constant expression evaluation / constant folding */
 	if (get_opt_constant_folding()) {
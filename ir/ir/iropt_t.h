@@ -16,6 +16,7 @@
 #include "iropt.h"
 #include "irnode_t.h"
 #include "tv.h"
+#include "cpset.h"
 
 /**
  * Calculate a hash value of a node.
@@ -39,6 +40,17 @@ ir_node *equivalent_node(ir_node *n);
  */
 void new_identities(ir_graph *irg);
 
+/**
+ * Replaces the value table of @p irg by an empty one which uses @p equal
+ * instead of identities_cmp() to decide whether two nodes are congruent.
+ */
+void new_identities_custom(ir_graph *irg, cpset_cmp_function equal);
+
+/**
+ * Frees a value table which is no longer attached to a graph.
+ */
+void free_value_table(cpset_t *value_table);
+
 /**
  * Deletes a identities value table.
  *
@@ -51,6 +63,13 @@ void del_identities(ir_graph *irg);
  */
 void add_identities(ir_node *node);
 
+/**
+ * Removes a node from the identities value table if it is the canonical
+ * node there. Must be done before the node is exchanged, as turning it into
+ * an Id changes its hash.
+ */
+void remove_identities(ir_node *node);
+
 /**
  * Compare function for two nodes in the hash table. Gets two
  * nodes as parameters.  Returns 0 if the nodes are a cse.
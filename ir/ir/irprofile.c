@@ -8,34 +8,87 @@
  * @brief       Code instrumentation and execution count profiling.
  * @author      Adam M. Szalkowski, Steven Schaefer
  * @date        06.04.2006, 11.11.2010
+ *
+ * Counters are placed on control flow edges following Knuth and Ball/Larus:
+ * With virtual edges from the end block to the start block and from noreturn
+ * calls to the end block the flow is conserved at every block. So only the
+ * edges not on a spanning tree of the control flow graph need a counter, the
+ * counts of the tree edges and blocks follow from the flow equations. The
+ * tree is a maximum spanning tree weighted by loop depth, which keeps the
+ * counters out of inner loops wherever possible.
  */
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 
+#include "array.h"
 #include "hashptr.h"
 #include "debug.h"
 #include "obst.h"
+#include "pmap.h"
 #include "xmalloc.h"
 #include "set.h"
 #include "irgwalk.h"
+#include "irgmod.h"
+#include "irloop.h"
 #include "irdump_t.h"
 #include "irnode_t.h"
 #include "ircons_t.h"
 #include "execfreq_t.h"
 #include "irprofile.h"
 #include "typerep.h"
+#include "unionfind.h"
+#include "util.h"
 
-/* Instrument blocks walker. */
+/* Instrument graphs walker. */
 typedef struct block_id_walker_data_t {
-	unsigned int id;   /**< current block id number */
+	unsigned int id;   /**< next counter id number */
 	ir_node *symconst; /**< the SymConst representing the counter array */
+	ir_entity *filename;        /**< the profile file name */
+	ir_entity *registered;      /**< thread local flag telling if the
+	                                 counters of the thread are registered,
+	                                 NULL for shared counters */
+	ir_entity *register_thread; /**< __firmprof_register_thread */
+	unsigned int site;          /**< next indirect call site number */
+	ir_entity *targets;         /**< the call target array */
+	ir_node *sites;             /**< the SymConst representing the call
+	                                 target array */
+	ir_entity *call_target;     /**< __firmprof_call_target */
 } block_id_walker_data_t;
 
-/* Associate counters with blocks. */
-typedef struct block_assoc_t {
-	unsigned int i;          /**< current block id number */
-	unsigned int *counters;  /**< block execution counts */
-} block_assoc_t;
+/** The call target array and the function tables naming the targets. */
+typedef struct call_target_tables_t {
+	ir_entity *targets; /**< the call target array, NULL without sites */
+	unsigned   n_sites; /**< number of indirect call sites */
+	ir_entity *funcs;   /**< the function addresses */
+	ir_entity *ids;     /**< the function ids */
+	size_t     n_funcs; /**< number of functions */
+} call_target_tables_t;
+
+/** marks edges which cannot get a counter */
+#define NO_HOST ((unsigned)-1)
+
+/** A control flow edge considered for counter placement. */
+typedef struct profile_edge_t {
+	unsigned src;     /**< index of the source block */
+	unsigned dst;     /**< index of the target block */
+	int      pos;     /**< predecessor number in the target block, -1 for
+	                       the virtual edges */
+	unsigned host;    /**< index of the block which can hold a counter for
+	                       the edge, NO_HOST if no block can */
+	unsigned weight;  /**< loop depth of the host block */
+	unsigned counter; /**< counter id relative to the graph */
+	bool     in_tree; /**< the edge is on the spanning tree */
+	bool     counted; /**< the edge has a counter */
+	int64_t  count;   /**< execution count, -1 while unknown */
+} profile_edge_t;
+
+/** The counter placement of a graph. */
+typedef struct profile_plan_t {
+	ir_node        **blocks;     /**< the blocks in walk order */
+	profile_edge_t  *edges;      /**< the edges in a fixed order */
+	unsigned         n_counters; /**< number of counted edges */
+} profile_plan_t;
 
 /* minimal execution frequency (an execfreq of 0 confuses algos) */
 #define MIN_EXECFREQ 0.00001
@@ -58,6 +111,35 @@ typedef struct execcount_t {
 	uint32_t      count; /**< execution count */
 } execcount_t;
 
+/* The edge counts are associated with the target block id and the number of
+ * the predecessor. */
+typedef struct edgecount_t {
+	unsigned long block; /**< target block id */
+	int           pos;   /**< predecessor number */
+	uint32_t      count; /**< execution count */
+} edgecount_t;
+
+/* the edge counts of the profile */
+static set *edge_profile = NULL;
+
+/* The most frequent target of an indirect call, associated with the call id.
+ * The count of the target is a lower bound only, see
+ * ir_profile_get_call_target(). */
+typedef struct call_target_t {
+	unsigned long call;   /**< Call id */
+	ir_entity    *target; /**< the most frequent callee */
+	uint32_t      count;  /**< calls of target */
+	uint32_t      total;  /**< executions of the call */
+} call_target_t;
+
+/* the call targets of the profile */
+static set *call_target_profile = NULL;
+
+/* Each indirect call site has three pointer sized slots in the call target
+ * array: the candidate target, its majority vote count and the number of
+ * executions. */
+#define CALL_SITE_SLOTS 3
+
 /**
  * Compare two execcount_t entries.
  */
@@ -69,6 +151,33 @@ static int cmp_execcount(const void *a, const void *b, size_t size)
 	return ea->block != eb->block;
 }
 
+/**
+ * Compare two edgecount_t entries.
+ */
+static int cmp_edgecount(const void *a, const void *b, size_t size)
+{
+	const edgecount_t *ea = (const edgecount_t*)a;
+	const edgecount_t *eb = (const edgecount_t*)b;
+	(void) size;
+	return ea->block != eb->block || ea->pos != eb->pos;
+}
+
+static unsigned hash_edgecount(const edgecount_t *ec)
+{
+	return hash_combine((unsigned)ec->block, (unsigned)ec->pos);
+}
+
+/**
+ * Compare two call_target_t entries.
+ */
+static int cmp_call_target(const void *a, const void *b, size_t size)
+{
+	const call_target_t *ea = (const call_target_t*)a;
+	const call_target_t *eb = (const call_target_t*)b;
+	(void) size;
+	return ea->call != eb->call;
+}
+
 uint32_t ir_profile_get_block_execcount(const ir_node *block)
 {
 	execcount_t *ec, query;
@@ -85,40 +194,308 @@ uint32_t ir_profile_get_block_execcount(const ir_node *block)
 	}
 }
 
+bool ir_profile_has_block_execcount(const ir_node *block)
+{
+	if (profile == NULL)
+		return false;
+
+	execcount_t query;
+	query.block = get_irn_node_nr(block);
+	return set_find(execcount_t, profile, &query, sizeof(query), query.block)
+	       != NULL;
+}
+
+uint32_t ir_profile_get_edge_execcount(const ir_node *block, int pos)
+{
+	edgecount_t query;
+	query.block = get_irn_node_nr(block);
+	query.pos   = pos;
+	edgecount_t *ec = set_find(edgecount_t, edge_profile, &query, sizeof(query),
+	                           hash_edgecount(&query));
+	return ec != NULL ? ec->count : 0;
+}
+
+bool ir_profile_has_edge_execcount(const ir_node *block, int pos)
+{
+	if (edge_profile == NULL)
+		return false;
+
+	edgecount_t query;
+	query.block = get_irn_node_nr(block);
+	query.pos   = pos;
+	return set_find(edgecount_t, edge_profile, &query, sizeof(query),
+	                hash_edgecount(&query)) != NULL;
+}
+
+ir_entity *ir_profile_get_call_target(const ir_node *call, uint32_t *count,
+                                      uint32_t *total)
+{
+	if (call_target_profile == NULL)
+		return NULL;
+
+	call_target_t query;
+	query.call = get_irn_node_nr(call);
+	call_target_t *ct = set_find(call_target_t, call_target_profile, &query,
+	                             sizeof(query), query.call);
+	if (ct == NULL)
+		return NULL;
+	*count = ct->count;
+	*total = ct->total;
+	return ct->target;
+}
+
 /**
- * Block walker, count number of blocks.
+ * Block walker, numbers the blocks of a plan.
  */
-static void block_counter(ir_node *bb, void *data)
+static void collect_plan_block(ir_node *bb, void *data)
+{
+	profile_plan_t *plan = (profile_plan_t*) data;
+	set_irn_link(bb, INT_TO_PTR(ARR_LEN(plan->blocks)));
+	ARR_APP1(ir_node*, plan->blocks, bb);
+}
+
+static unsigned get_plan_index(const ir_node *bb)
+{
+	return PTR_TO_INT(get_irn_link(bb));
+}
+
+static void add_plan_edge(profile_plan_t *plan, unsigned src, unsigned dst,
+                          int pos)
 {
-	unsigned *count = (unsigned*) data;
-	(void) bb;
-	++(*count);
+	profile_edge_t edge;
+	memset(&edge, 0, sizeof(edge));
+	edge.src   = src;
+	edge.dst   = dst;
+	edge.pos   = pos;
+	edge.host  = NO_HOST;
+	edge.count = -1;
+	ARR_APP1(profile_edge_t, plan->edges, edge);
 }
 
 /**
- * Returns the number of blocks the given graph.
+ * Adds the edge to the spanning tree if it does not close a cycle.
  */
-static unsigned int get_irg_n_blocks(ir_graph *irg)
+static void try_tree_edge(profile_edge_t *edge, int *uf)
 {
-	unsigned int count = 0;
-	irg_block_walk_graph(irg, block_counter, NULL, &count);
-	return count;
+	int const src = uf_find(uf, edge->src);
+	int const dst = uf_find(uf, edge->dst);
+	if (src == dst)
+		return;
+	uf_union(uf, src, dst);
+	edge->in_tree = true;
 }
 
 /**
- * Returns the number of basic blocks in the current ir program.
+ * Computes the counter placement of a graph. The placement only depends on
+ * the graph, so instrumentation and reading the profile agree on it.
  */
-static unsigned int get_irp_n_blocks(void)
+static void build_plan(ir_graph *irg, profile_plan_t *plan)
 {
-	int i, n = get_irp_n_irgs();
-	unsigned int count = 0;
+	plan->blocks     = NEW_ARR_F(ir_node*, 0);
+	plan->edges      = NEW_ARR_F(profile_edge_t, 0);
+	plan->n_counters = 0;
+
+	assure_loopinfo(irg);
+	irg_block_walk_graph(irg, collect_plan_block, NULL, plan);
+
+	size_t const n_blocks = ARR_LEN(plan->blocks);
+	for (size_t b = 0; b < n_blocks; ++b) {
+		ir_node *bb = plan->blocks[b];
+		for (int i = 0, arity = get_Block_n_cfgpreds(bb); i < arity; ++i) {
+			ir_node *pred = get_Block_cfgpred_block(bb, i);
+			if (is_Bad(pred))
+				continue;
+			add_plan_edge(plan, get_plan_index(pred), b, i);
+		}
+	}
 
-	for (i = 0; i < n; i++) {
-		ir_graph *irg = get_irp_irg(i);
-		count += get_irg_n_blocks(irg);
+	/* virtual edges conserve the flow at the start and end block */
+	ir_node  *end   = get_irg_end(irg);
+	unsigned  start = get_plan_index(get_irg_start_block(irg));
+	unsigned  endbb = get_plan_index(get_irg_end_block(irg));
+	add_plan_edge(plan, endbb, start, -1);
+	for (int i = get_End_n_keepalives(end) - 1; i >= 0; --i) {
+		ir_node *node = get_End_keepalive(end, i);
+		if (!is_Call(node))
+			continue;
+		ir_node *bb = get_nodes_block(node);
+		if (Block_block_visited(bb))
+			add_plan_edge(plan, get_plan_index(bb), endbb, -1);
 	}
 
-	return count;
+	/* a counter can go into the target block if it has no other predecessor,
+	 * else into the source block if it has no other successor */
+	size_t const n_edges = ARR_LEN(plan->edges);
+	unsigned    *n_preds = XMALLOCNZ(unsigned, n_blocks);
+	unsigned    *n_succs = XMALLOCNZ(unsigned, n_blocks);
+	for (size_t e = 0; e < n_edges; ++e) {
+		++n_succs[plan->edges[e].src];
+		++n_preds[plan->edges[e].dst];
+	}
+	unsigned max_weight = 0;
+	for (size_t e = 0; e < n_edges; ++e) {
+		profile_edge_t *edge = &plan->edges[e];
+		if (edge->pos < 0)
+			continue;
+		if (n_preds[edge->dst] == 1 && edge->dst != endbb) {
+			edge->host = edge->dst;
+		} else if (n_succs[edge->src] == 1) {
+			edge->host = edge->src;
+		} else {
+			continue;
+		}
+		ir_loop *loop = get_irn_loop(plan->blocks[edge->host]);
+		edge->weight  = loop != NULL ? get_loop_depth(loop) : 0;
+		max_weight    = MAX(max_weight, edge->weight);
+	}
+	free(n_succs);
+	free(n_preds);
+
+	/* Kruskal: the edges without a host block have to be on the tree, then
+	 * the edges in deeper loops are preferred */
+	int *uf = XMALLOCN(int, n_blocks);
+	uf_init(uf, n_blocks);
+	for (size_t e = 0; e < n_edges; ++e) {
+		if (plan->edges[e].host == NO_HOST)
+			try_tree_edge(&plan->edges[e], uf);
+	}
+	for (unsigned w = max_weight + 1; w-- > 0;) {
+		for (size_t e = 0; e < n_edges; ++e) {
+			profile_edge_t *edge = &plan->edges[e];
+			if (edge->host != NO_HOST && edge->weight == w)
+				try_tree_edge(edge, uf);
+		}
+	}
+	free(uf);
+
+	for (size_t e = 0; e < n_edges; ++e) {
+		profile_edge_t *edge = &plan->edges[e];
+		if (edge->in_tree)
+			continue;
+		if (edge->host == NO_HOST) {
+			/* parallel virtual or exception edges, we cannot count them */
+			DB((dbg, LEVEL_2, "no counter for edge %u -> %u in %+F\n",
+			    edge->src, edge->dst, irg));
+			edge->count = 0;
+			continue;
+		}
+		edge->counted = true;
+		edge->counter = plan->n_counters++;
+	}
+}
+
+static void free_plan(profile_plan_t *plan)
+{
+	DEL_ARR_F(plan->edges);
+	DEL_ARR_F(plan->blocks);
+}
+
+/**
+ * Computes the counts of the tree edges from the flow equations: the count
+ * of an edge follows once it is the only unknown edge of one of its blocks.
+ */
+static void solve_plan(profile_plan_t *plan)
+{
+	size_t const n_blocks  = ARR_LEN(plan->blocks);
+	size_t const n_edges   = ARR_LEN(plan->edges);
+	unsigned    *n_unknown = XMALLOCNZ(unsigned, n_blocks);
+	unsigned   **adj       = XMALLOCN(unsigned*, n_blocks);
+	for (size_t b = 0; b < n_blocks; ++b)
+		adj[b] = NEW_ARR_F(unsigned, 0);
+	for (size_t e = 0; e < n_edges; ++e) {
+		profile_edge_t const *edge = &plan->edges[e];
+		ARR_APP1(unsigned, adj[edge->src], e);
+		if (edge->dst != edge->src)
+			ARR_APP1(unsigned, adj[edge->dst], e);
+		if (edge->count < 0) {
+			++n_unknown[edge->src];
+			++n_unknown[edge->dst];
+		}
+	}
+
+	unsigned *worklist = NEW_ARR_F(unsigned, 0);
+	for (size_t b = 0; b < n_blocks; ++b) {
+		if (n_unknown[b] == 1)
+			ARR_APP1(unsigned, worklist, b);
+	}
+	while (ARR_LEN(worklist) > 0) {
+		unsigned const b = worklist[ARR_LEN(worklist) - 1];
+		ARR_SHRINKLEN(worklist, ARR_LEN(worklist) - 1);
+		if (n_unknown[b] != 1)
+			continue;
+
+		int64_t         in      = 0;
+		int64_t         out     = 0;
+		profile_edge_t *unknown = NULL;
+		for (size_t i = 0, n = ARR_LEN(adj[b]); i < n; ++i) {
+			profile_edge_t *edge = &plan->edges[adj[b][i]];
+			if (edge->count < 0) {
+				unknown = edge;
+				continue;
+			}
+			if (edge->dst == b)
+				in += edge->count;
+			if (edge->src == b)
+				out += edge->count;
+		}
+		/* calls not returning (exit, longjmp) disturb the balance */
+		int64_t const count = unknown->dst == b ? out - in : in - out;
+		unknown->count = MAX(count, 0);
+
+		--n_unknown[unknown->src];
+		--n_unknown[unknown->dst];
+		unsigned const other = unknown->dst == b ? unknown->src : unknown->dst;
+		if (n_unknown[other] == 1)
+			ARR_APP1(unsigned, worklist, other);
+	}
+	DEL_ARR_F(worklist);
+
+	for (size_t b = 0; b < n_blocks; ++b)
+		DEL_ARR_F(adj[b]);
+	free(adj);
+	free(n_unknown);
+}
+
+static uint32_t clamp_count(int64_t count)
+{
+	if (count < 0)
+		return 0;
+	return count > UINT32_MAX ? UINT32_MAX : (uint32_t)count;
+}
+
+/**
+ * Records the block and edge counts of a solved plan.
+ */
+static void associate_plan(const profile_plan_t *plan)
+{
+	size_t const n_blocks = ARR_LEN(plan->blocks);
+	int64_t     *counts   = XMALLOCNZ(int64_t, n_blocks);
+	for (size_t e = 0, n = ARR_LEN(plan->edges); e < n; ++e) {
+		profile_edge_t const *edge  = &plan->edges[e];
+		int64_t         const count = MAX(edge->count, 0);
+		counts[edge->dst] += count;
+		if (edge->pos < 0)
+			continue;
+
+		edgecount_t query;
+		query.block = get_irn_node_nr(plan->blocks[edge->dst]);
+		query.pos   = edge->pos;
+		query.count = clamp_count(count);
+		(void)set_insert(edgecount_t, edge_profile, &query, sizeof(query),
+		                 hash_edgecount(&query));
+	}
+
+	for (size_t b = 0; b < n_blocks; ++b) {
+		ir_node    *bb = plan->blocks[b];
+		execcount_t query;
+		query.block = get_irn_node_nr(bb);
+		query.count = clamp_count(counts[b]);
+		DBG((dbg, LEVEL_4, "execcount(%+F, %u): %u\n", bb, query.block,
+		    query.count));
+		(void)set_insert(execcount_t, profile, &query, sizeof(query),
+		                 query.block);
+	}
+	free(counts);
 }
 
 /* vcg helper */
@@ -153,29 +530,43 @@ static void add_constructor(ir_entity *method)
 }
 
 /**
- * Returns an entity representing the __init_firmprof function from libfirmprof
- * This is the equivalent of:
+ * Returns an entity representing the function @p name from libfirmprof with
+ * the given parameter types. The libfirmprof functions are:
  * extern void __init_firmprof(char *filename, uint *counters, uint size)
+ * extern void __init_firmprof_threads(char *filename, uint size)
+ * extern void __firmprof_register_thread(char *filename, uint *counters,
+ *                                        uint *registered)
+ * extern void __init_firmprof_targets(char *filename, uintptr_t *targets,
+ *                                     uint n_sites, void (**funcs)(void),
+ *                                     uint *ids, uint n_funcs)
+ * extern void __firmprof_call_target(uintptr_t *site, void (*target)(void))
  */
-static ir_entity *get_init_firmprof_ref(void)
+static ir_entity *get_firmprof_ref(const char *name, size_t n_params,
+                                   ir_type *const *params)
 {
-	ident   *init_name = new_id_from_str("__init_firmprof");
-	ir_type *init_type = new_type_method(3, 0);
-	ir_type *uint      = new_type_primitive(mode_Iu);
-	ir_type *uintptr   = new_type_pointer(uint);
-	ir_type *string    = new_type_pointer(new_type_primitive(mode_Bs));
+	ident   *func_name = new_id_from_str(name);
+	ir_type *func_type = new_type_method(n_params, 0);
 	ir_entity *result;
 
-	set_method_param_type(init_type, 0, string);
-	set_method_param_type(init_type, 1, uintptr);
-	set_method_param_type(init_type, 2, uint);
+	for (size_t i = 0; i < n_params; ++i)
+		set_method_param_type(func_type, i, params[i]);
 
-	result = new_entity(get_glob_type(), init_name, init_type);
+	result = new_entity(get_glob_type(), func_name, func_type);
 	set_entity_visibility(result, ir_visibility_external);
 
 	return result;
 }
 
+static ir_type *get_string_type(void)
+{
+	return new_type_pointer(new_type_primitive(mode_Bs));
+}
+
+static ir_type *get_uintptr_type(void)
+{
+	return new_type_pointer(new_type_primitive(mode_Iu));
+}
+
 /**
  * Generates a new irg which calls the initializer
  *
@@ -183,18 +574,32 @@ static ir_entity *get_init_firmprof_ref(void)
  *    static void __firmprof_initializer(void) __attribute__ ((constructor))
  *    {
  *        __init_firmprof(ent_filename, bblock_counts, n_blocks);
+ *        __init_firmprof_targets(ent_filename, targets, n_sites,
+ *                                funcs, ids, n_funcs);
  *    }
+ *
+ * Thread local counters cannot be passed, so with @p per_thread the
+ * initializer calls __init_firmprof_threads(ent_filename, n_blocks) instead.
  */
 static ir_graph *gen_initializer_irg(ir_entity *ent_filename,
-                                     ir_entity *bblock_counts, int n_blocks)
+                                     ir_entity *bblock_counts, int n_blocks,
+                                     bool per_thread,
+                                     const call_target_tables_t *tables)
 {
 	ir_graph *irg;
 	ir_node  *ins[3];
-	ir_node  *bb, *ret, *call, *symconst;
+	ir_node  *bb, *ret, *call, *symconst, *mem;
 	ir_type  *empty_frame_type;
 	symconst_symbol sym;
+	int       n_ins = 0;
 
-	ir_entity *init_ent = get_init_firmprof_ref();
+	ir_type *params[3];
+	params[n_ins++] = get_string_type();
+	if (!per_thread)
+		params[n_ins++] = get_uintptr_type();
+	params[n_ins++] = new_type_primitive(mode_Iu);
+	ir_entity *init_ent = get_firmprof_ref(per_thread
+		? "__init_firmprof_threads" : "__init_firmprof", n_ins, params);
 
 	ident     *name = new_id_from_str("__firmprof_initializer");
 	ir_entity *ent  = new_entity(get_glob_type(), name, new_type_method(0, 0));
@@ -206,6 +611,7 @@ static ir_graph *gen_initializer_irg(ir_entity *ent_filename,
 	set_current_ir_graph(irg);
 	empty_frame_type = get_irg_frame_type(irg);
 	set_type_size_bytes(empty_frame_type, 0);
+	set_type_alignment_bytes(empty_frame_type, 1);
 	set_type_state(empty_frame_type, layout_fixed);
 
 	bb = get_r_cur_block(irg);
@@ -213,14 +619,49 @@ static ir_graph *gen_initializer_irg(ir_entity *ent_filename,
 	sym.entity_p = init_ent;
 	symconst     = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
 
+	n_ins = 0;
 	sym.entity_p = ent_filename;
-	ins[0] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
-	sym.entity_p = bblock_counts;
-	ins[1] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
-	ins[2] = new_r_Const_long(irg, mode_Iu, n_blocks);
+	ins[n_ins++] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	if (!per_thread) {
+		sym.entity_p = bblock_counts;
+		ins[n_ins++] = new_r_SymConst(irg, mode_P_data, sym,
+		                              symconst_addr_ent);
+	}
+	ins[n_ins++] = new_r_Const_long(irg, mode_Iu, n_blocks);
 
-	call = new_r_Call(bb, get_irg_initial_mem(irg), symconst, 3, ins,
+	call = new_r_Call(bb, get_irg_initial_mem(irg), symconst, n_ins, ins,
 	        get_entity_type(init_ent));
+	mem  = new_r_Proj(call, mode_M, pn_Call_M);
+
+	ir_type *target_params[6];
+	target_params[0] = get_string_type();
+	target_params[1] = get_uintptr_type();
+	target_params[2] = new_type_primitive(mode_Iu);
+	target_params[3] = get_uintptr_type();
+	target_params[4] = get_uintptr_type();
+	target_params[5] = new_type_primitive(mode_Iu);
+	ir_entity *targets_ent = get_firmprof_ref("__init_firmprof_targets",
+		ARRAY_SIZE(target_params), target_params);
+
+	ir_node *target_ins[ARRAY_SIZE(target_params)];
+	target_ins[0] = ins[0];
+	if (tables->targets != NULL) {
+		sym.entity_p  = tables->targets;
+		target_ins[1] = new_r_SymConst(irg, mode_P_data, sym,
+		                               symconst_addr_ent);
+	} else {
+		target_ins[1] = new_r_Const(irg, get_mode_null(mode_P_data));
+	}
+	target_ins[2] = new_r_Const_long(irg, mode_Iu, tables->n_sites);
+	sym.entity_p  = tables->funcs;
+	target_ins[3] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	sym.entity_p  = tables->ids;
+	target_ins[4] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	target_ins[5] = new_r_Const_long(irg, mode_Iu, tables->n_funcs);
+	sym.entity_p  = targets_ent;
+	symconst      = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	call = new_r_Call(bb, mem, symconst, ARRAY_SIZE(target_ins), target_ins,
+	                  get_entity_type(targets_ent));
 	ret  = new_r_Return(bb, new_r_Proj(call, mode_M, pn_Call_M), 0, NULL);
 	mature_immBlock(bb);
 
@@ -236,23 +677,93 @@ static ir_graph *gen_initializer_irg(ir_entity *ent_filename,
 }
 
 /**
- * Instrument a block with code needed for profiling.
+ * Walker, collects the Calls whose callee is not known statically.
+ */
+static void collect_indirect_call(ir_node *node, void *data)
+{
+	ir_node ***calls = (ir_node***)data;
+	if (is_Call(node) && !is_SymConst_addr_ent(get_Call_ptr(node)))
+		ARR_APP1(ir_node*, *calls, node);
+}
+
+/**
+ * Returns the indirect calls of a graph, the call target array has a site for
+ * each of them in this order. Instrumentation and profile reading both see
+ * the graph before it is instrumented, so they agree on the order.
+ */
+static ir_node **get_indirect_calls(ir_graph *irg)
+{
+	ir_node **calls = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, NULL, collect_indirect_call, &calls);
+	return calls;
+}
+
+/**
+ * Returns the id naming a function in the call target profile, the hash of
+ * its linker name. 0 stands for an unknown target.
+ */
+static unsigned get_function_id(const ir_entity *entity)
+{
+	unsigned const id = hash_str(get_entity_ld_name(entity));
+	return id != 0 ? id : 1;
+}
+
+/**
+ * Records the target of an indirect call before the call:
+ *
+ *    __firmprof_call_target(&__FIRMPROF__CALL_TARGETS[3 * site], callee);
+ */
+static void instrument_call(ir_node *call, const block_id_walker_data_t *wd,
+                            unsigned site)
+{
+	ir_graph *irg   = get_irn_irg(call);
+	ir_node  *block = get_nodes_block(call);
+	ir_mode  *mode  = find_unsigned_mode(mode_P_data);
+	unsigned  size  = get_mode_size_bytes(mode) * CALL_SITE_SLOTS;
+	ir_node  *cnst  = new_r_Const_long(irg, mode_Iu, size * site);
+	ir_node  *ptr   = get_Call_ptr(call);
+	if (get_irn_mode(ptr) != mode_P_code)
+		ptr = new_r_Conv(block, ptr, mode_P_code);
+
+	ir_node *ins[2];
+	ins[0] = new_r_Add(block, wd->sites, cnst, get_modeP_data());
+	ins[1] = ptr;
+
+	symconst_symbol sym;
+	sym.entity_p = wd->call_target;
+	ir_node *callee  = new_r_SymConst(irg, mode_P_code, sym, symconst_addr_ent);
+	ir_node *profile = new_r_Call(block, get_Call_mem(call), callee,
+	                              ARRAY_SIZE(ins), ins,
+	                              get_entity_type(wd->call_target));
+	set_Call_mem(call, new_r_Proj(profile, mode_M, pn_Call_M));
+}
+
+/**
+ * Instrument a block with a counter increment.
  * This just inserts the instruction nodes, it doesn't connect the memory
- * nodes in a meaningful way.
+ * nodes in a meaningful way. Several counters in a block are chained.
  */
 static void instrument_block(ir_node *bb, ir_node *address, unsigned int id)
 {
 	ir_graph *irg = get_irn_irg(bb);
-	ir_node  *load, *store, *offset, *add, *projm, *proji, *unknown, *cnst;
+	ir_node  *load, *store, *offset, *add, *projm, *proji, *mem, *cnst;
+	ir_node  *first;
 
 	/* We can't instrument the end block */
-	if (bb == get_irg_end_block(irg))
-		return;
+	assert(bb != get_irg_end_block(irg));
+
+	/* The block link points to the last projm of the block, which links to
+	 * the first load of the block. */
+	mem   = (ir_node*) get_irn_link(bb);
+	first = NULL;
+	if (mem != NULL)
+		first = (ir_node*) get_irn_link(mem);
+	else
+		mem = new_r_Unknown(irg, mode_M);
 
-	unknown = new_r_Unknown(irg, mode_M);
 	cnst    = new_r_Const_long(irg, mode_Iu, get_mode_size_bytes(mode_Iu) * id);
 	offset  = new_r_Add(bb, address, cnst, get_modeP_data());
-	load    = new_r_Load(bb, unknown, offset, mode_Iu, cons_none);
+	load    = new_r_Load(bb, mem, offset, mode_Iu, cons_none);
 	projm   = new_r_Proj(load, mode_M, pn_Load_M);
 	proji   = new_r_Proj(load, mode_Iu, pn_Load_res);
 	cnst    = new_r_Const(irg, get_mode_one(mode_Iu));
@@ -261,7 +772,7 @@ static void instrument_block(ir_node *bb, ir_node *address, unsigned int id)
 	projm   = new_r_Proj(store, mode_M, pn_Store_M);
 
 	set_irn_link(bb, projm);
-	set_irn_link(projm, load);
+	set_irn_link(projm, first != NULL ? first : load);
 }
 
 /**
@@ -305,20 +816,24 @@ static void fix_ssa(ir_node *bb, void *data)
 
 	/* The block link fields point to the projm from the instrumentation code,
 	 * the projm in turn links to the initial load which lacks a memory
-	 * argument at this point. */
+	 * argument at this point. Blocks without counter link to a Dummy which
+	 * is replaced by the incoming memory later. */
 	proj = (ir_node*) get_irn_link(bb);
 	load = (ir_node*) get_irn_link(proj);
-	set_Load_mem(load, mem);
+	if (load != NULL)
+		set_Load_mem(load, mem);
+	else
+		set_irn_link(proj, mem);
 }
 
 /**
- * Instrument a single block.
+ * Returns the memory a Dummy of a block without counter stands for.
  */
-static void block_instrument_walker(ir_node *bb, void *data)
+static ir_node *resolve_dummy_mem(ir_node *mem)
 {
-	block_id_walker_data_t *wd = (block_id_walker_data_t*)data;
-	instrument_block(bb, wd->symconst, wd->id);
-	++wd->id;
+	while (is_Dummy(mem))
+		mem = (ir_node*) get_irn_link(mem);
+	return mem;
 }
 
 /**
@@ -333,6 +848,162 @@ static ir_node *sync_mem(ir_node *bb, ir_node *mem)
 	return new_r_Sync(bb, 2, ins);
 }
 
+/** Environment of the thread registration walkers. */
+typedef struct registration_env_t {
+	ir_node  *start_bb; /**< the start block */
+	ir_node  *check_bb; /**< the block checking the registration */
+	ir_node  *exec;     /**< the initial exec Proj of Start */
+	ir_node  *jmp;      /**< the Jmp behind the registration */
+	ir_node  *mem;      /**< the memory behind the registration */
+	ir_node **mems;     /**< memory of the start block used outside */
+} registration_env_t;
+
+/**
+ * Returns true if input @p pos of @p node is memory of the start block which
+ * has to pass the registration.
+ */
+static bool is_start_mem_use(const registration_env_t *env, ir_node *node,
+                             int pos)
+{
+	if (is_End(node) || get_nodes_block(node) == env->start_bb
+	    || get_nodes_block(node) == env->check_bb)
+		return false;
+	ir_node *pred = get_irn_n(node, pos);
+	return get_irn_mode(pred) == mode_M && !is_NoMem(pred)
+	    && get_nodes_block(pred) == env->start_bb;
+}
+
+/**
+ * Walker, collects the memory values of the start block used in other
+ * blocks.
+ */
+static void collect_start_mem(ir_node *node, void *data)
+{
+	registration_env_t *env = (registration_env_t*)data;
+	if (is_Block(node))
+		return;
+	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+		if (!is_start_mem_use(env, node, i))
+			continue;
+		ir_node *pred  = get_irn_n(node, i);
+		bool     known = false;
+		for (size_t m = 0, n = ARR_LEN(env->mems); m < n && !known; ++m)
+			known = env->mems[m] == pred;
+		if (!known)
+			ARR_APP1(ir_node*, env->mems, pred);
+	}
+}
+
+/**
+ * Walker, lets the code behind the start block begin after the registration.
+ */
+static void reroute_start(ir_node *node, void *data)
+{
+	registration_env_t *env = (registration_env_t*)data;
+	if (is_Block(node)) {
+		if (node == env->check_bb)
+			return;
+		for (int i = 0, arity = get_Block_n_cfgpreds(node); i < arity; ++i) {
+			if (get_Block_cfgpred(node, i) == env->exec)
+				set_Block_cfgpred(node, i, env->jmp);
+		}
+		return;
+	}
+	for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+		if (is_start_mem_use(env, node, i))
+			set_irn_n(node, i, env->mem);
+	}
+}
+
+/**
+ * Registers the thread local counters of the executing thread with
+ * libfirmprof the first time the thread enters the graph:
+ *
+ *    if (__FIRMPROF__REGISTERED == 0)
+ *        __firmprof_register_thread(filename, __FIRMPROF__BLOCK_COUNTS,
+ *                                   &__FIRMPROF__REGISTERED);
+ *
+ * Only Start may branch in the start block, so the check goes into a new
+ * block between the start block and its successor. The memory the start block
+ * passes on is ordered before the check.
+ */
+static void add_thread_registration(ir_graph *irg,
+                                    const block_id_walker_data_t *wd)
+{
+	registration_env_t env;
+	env.start_bb = get_irg_start_block(irg);
+	env.exec     = get_irg_initial_exec(irg);
+	env.check_bb = new_r_Block(irg, 1, &env.exec);
+	env.mems     = NEW_ARR_F(ir_node*, 0);
+
+	irg_walk_graph(irg, collect_start_mem, NULL, &env);
+
+	ir_node *mem;
+	size_t const n_mems = ARR_LEN(env.mems);
+	if (n_mems == 0) {
+		mem = get_irg_initial_mem(irg);
+	} else if (n_mems == 1) {
+		mem = env.mems[0];
+	} else {
+		mem = new_r_Sync(env.check_bb, n_mems, env.mems);
+	}
+	DEL_ARR_F(env.mems);
+
+	symconst_symbol sym;
+	sym.entity_p = wd->registered;
+	ir_node *flag_addr = new_r_SymConst(irg, mode_P_data, sym,
+	                                    symconst_addr_ent);
+	ir_node *load  = new_r_Load(env.check_bb, mem, flag_addr, mode_Iu,
+	                            cons_none);
+	ir_node *loadm = new_r_Proj(load, mode_M, pn_Load_M);
+	ir_node *flag  = new_r_Proj(load, mode_Iu, pn_Load_res);
+	ir_node *zero  = new_r_Const(irg, get_mode_null(mode_Iu));
+	ir_node *cmp   = new_r_Cmp(env.check_bb, flag, zero, ir_relation_equal);
+	ir_node *cond  = new_r_Cond(env.check_bb, cmp);
+	set_Cond_jmp_pred(cond, COND_JMP_PRED_FALSE);
+	ir_node *projt = new_r_Proj(cond, mode_X, pn_Cond_true);
+	ir_node *projf = new_r_Proj(cond, mode_X, pn_Cond_false);
+
+	/* separate blocks for both paths avoid a critical edge */
+	ir_node *reg_bb  = new_r_Block(irg, 1, &projt);
+	ir_node *skip_bb = new_r_Block(irg, 1, &projf);
+
+	ir_node *ins[3];
+	sym.entity_p = wd->register_thread;
+	ir_node *callee = new_r_SymConst(irg, mode_P_code, sym, symconst_addr_ent);
+	sym.entity_p = wd->filename;
+	ins[0] = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	ins[1] = wd->symconst;
+	ins[2] = flag_addr;
+	ir_node *call  = new_r_Call(reg_bb, loadm, callee, ARRAY_SIZE(ins), ins,
+	                            get_entity_type(wd->register_thread));
+	ir_node *callm = new_r_Proj(call, mode_M, pn_Call_M);
+
+	ir_node *jmps[2];
+	jmps[0] = new_r_Jmp(reg_bb);
+	jmps[1] = new_r_Jmp(skip_bb);
+	ir_node *join_bb = new_r_Block(irg, ARRAY_SIZE(jmps), jmps);
+	ir_node *mems[2];
+	mems[0] = callm;
+	mems[1] = loadm;
+	env.mem = new_r_Phi(join_bb, ARRAY_SIZE(mems), mems, mode_M);
+	env.jmp = new_r_Jmp(join_bb);
+	irg_walk_graph(irg, reroute_start, NULL, &env);
+
+	double const freq = get_block_execfreq(env.start_bb);
+	set_block_execfreq(env.check_bb, freq);
+	set_block_execfreq(reg_bb, freq);
+	set_block_execfreq(skip_bb, freq);
+	set_block_execfreq(join_bb, freq);
+
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_POSTDOMINANCE
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE_FRONTIERS
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_LIVENESS_CHK
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_OUTS);
+}
+
 /**
  * Instrument a single ir_graph, counters should point to the bblock
  * counters array.
@@ -344,13 +1015,42 @@ static void instrument_irg(ir_graph *irg, ir_entity *counters,
 	ir_node *endbb = get_irg_end_block(irg);
 	int i;
 
+	ir_node **calls = get_indirect_calls(irg);
+
 	/* generate a symbolic constant pointing to the count array */
 	symconst_symbol sym;
 	sym.entity_p = counters;
 	wd->symconst = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	if (ARR_LEN(calls) > 0) {
+		sym.entity_p = wd->targets;
+		wd->sites = new_r_SymConst(irg, mode_P_data, sym, symconst_addr_ent);
+	}
+
+	/* place the counters on the edges off the spanning tree */
+	profile_plan_t plan;
+	build_plan(irg, &plan);
+	for (size_t b = 0, n = ARR_LEN(plan.blocks); b < n; ++b)
+		set_irn_link(plan.blocks[b], NULL);
+	for (size_t e = 0, n = ARR_LEN(plan.edges); e < n; ++e) {
+		profile_edge_t const *edge = &plan.edges[e];
+		if (edge->counted)
+			instrument_block(plan.blocks[edge->host], wd->symconst,
+			                 wd->id + edge->counter);
+	}
+	wd->id += plan.n_counters;
+
+	ir_node **dummies = NEW_ARR_F(ir_node*, 0);
+	for (size_t b = 0, n = ARR_LEN(plan.blocks); b < n; ++b) {
+		ir_node *bb = plan.blocks[b];
+		if (bb == endbb || get_irn_link(bb) != NULL)
+			continue;
+		ir_node *dummy = new_r_Dummy(irg, mode_M);
+		set_irn_link(dummy, NULL);
+		set_irn_link(bb, dummy);
+		ARR_APP1(ir_node*, dummies, dummy);
+	}
+	free_plan(&plan);
 
-	/* instrument each block in the current irg */
-	irg_block_walk_graph(irg, block_instrument_walker, NULL, wd);
 	irg_block_walk_graph(irg, fix_ssa, NULL, NULL);
 
 	/* connect the new memory nodes to the return nodes */
@@ -388,29 +1088,120 @@ static void instrument_irg(ir_graph *irg, ir_entity *counters,
 			set_Call_mem(node, sync_mem(bb, mem));
 		}
 	}
+
+	/* blocks without counter pass their incoming memory on */
+	for (size_t d = 0, n = ARR_LEN(dummies); d < n; ++d) {
+		ir_node *dummy = dummies[d];
+		exchange(dummy, resolve_dummy_mem(dummy));
+	}
+	DEL_ARR_F(dummies);
+
+	for (size_t c = 0, n = ARR_LEN(calls); c < n; ++c)
+		instrument_call(calls[c], wd, wd->site++);
+	DEL_ARR_F(calls);
+
+	if (wd->registered != NULL)
+		add_thread_registration(irg, wd);
+}
+
+/**
+ * Returns an array type of @p size elements of type @p element_type with a
+ * fixed layout.
+ */
+static ir_type *new_fixed_array_type(ir_type *element_type, size_t size)
+{
+	unsigned const element_size = get_type_size_bytes(element_type);
+	ir_type *const array_type   = new_type_array(1, element_type);
+	set_array_bounds_int(array_type, 0, 0, size);
+	set_type_size_bytes(array_type, size * element_size);
+	set_type_alignment_bytes(array_type, element_size);
+	set_type_state(array_type, layout_fixed);
+	return array_type;
 }
 
 /**
  * Creates a new entity representing the equivalent of
- * static unsigned int name[size]
+ * static <mode> name[size]
+ * in the global or thread local segment @p owner.
  */
-static ir_entity *new_array_entity(ident *name, int size)
+static ir_entity *new_array_entity(ir_type *owner, ident *name, ir_mode *mode,
+                                   int size)
 {
 	ir_entity *result;
-	ir_type *uint_type, *array_type;
+	ir_type *element_type, *array_type;
 
-	uint_type = new_type_primitive(mode_Iu);
-	set_type_alignment_bytes(uint_type, get_type_size_bytes(uint_type));
+	element_type = new_type_primitive(mode);
+	set_type_alignment_bytes(element_type, get_type_size_bytes(element_type));
 
-	array_type = new_type_array(1, uint_type);
-	set_array_bounds_int(array_type, 0, 0, size);
-	set_type_size_bytes(array_type, size * get_mode_size_bytes(mode_Iu));
-	set_type_alignment_bytes(array_type, get_mode_size_bytes(mode_Iu));
-	set_type_state(array_type, layout_fixed);
+	array_type = new_fixed_array_type(element_type, size);
+
+	result = new_entity(owner, name, array_type);
+	set_entity_visibility(result, ir_visibility_local);
+	set_entity_compiler_generated(result, 1);
+	/* thread local entities are only emitted with an initializer */
+	if (owner == get_tls_type())
+		set_entity_initializer(result, get_initializer_null());
+
+	return result;
+}
+
+/**
+ * Creates the tables naming the targets of indirect calls for libfirmprof:
+ * __FIRMPROF__FUNCS holds the addresses of the functions of the program and
+ * __FIRMPROF__FUNC_IDS their ids in the same order.
+ */
+static void new_function_tables(call_target_tables_t *tables)
+{
+	size_t const n_funcs = get_irp_n_irgs();
+
+	ir_type *code_type = new_type_pointer(new_type_method(0, 0));
+	ir_type *id_type   = new_type_primitive(mode_Iu);
+	set_type_alignment_bytes(id_type, get_type_size_bytes(id_type));
+
+	ir_initializer_t *funcs = create_initializer_compound(n_funcs);
+	ir_initializer_t *ids   = create_initializer_compound(n_funcs);
+	ir_graph         *irg   = get_const_code_irg();
+	for (size_t i = 0; i < n_funcs; ++i) {
+		ir_entity *entity = get_irg_entity(get_irp_irg(i));
+		ir_node   *addr   = new_rd_SymConst_addr_ent(NULL, irg, mode_P_code,
+		                                             entity);
+		ir_tarval *id     = new_tarval_from_long(get_function_id(entity),
+		                                         mode_Iu);
+		set_initializer_compound_value(funcs, i,
+		                               create_initializer_const(addr));
+		set_initializer_compound_value(ids, i, create_initializer_tarval(id));
+	}
+
+	tables->n_funcs = n_funcs;
+	tables->funcs   = new_entity(get_glob_type(),
+		new_id_from_str("__FIRMPROF__FUNCS"),
+		new_fixed_array_type(code_type, n_funcs));
+	tables->ids     = new_entity(get_glob_type(),
+		new_id_from_str("__FIRMPROF__FUNC_IDS"),
+		new_fixed_array_type(id_type, n_funcs));
+	set_entity_initializer(tables->funcs, funcs);
+	set_entity_initializer(tables->ids, ids);
+	ir_entity *const entities[] = { tables->funcs, tables->ids };
+	for (size_t i = 0; i < ARRAY_SIZE(entities); ++i) {
+		set_entity_visibility(entities[i], ir_visibility_local);
+		set_entity_linkage(entities[i], IR_LINKAGE_CONSTANT);
+		set_entity_compiler_generated(entities[i], 1);
+	}
+}
 
-	result = new_entity(get_glob_type(), name, array_type);
+/**
+ * Creates a new entity representing the equivalent of
+ * static __thread unsigned int name
+ */
+static ir_entity *new_thread_flag_entity(ident *name)
+{
+	ir_type *uint_type = new_type_primitive(mode_Iu);
+	set_type_alignment_bytes(uint_type, get_type_size_bytes(uint_type));
+
+	ir_entity *result = new_entity(get_tls_type(), name, uint_type);
 	set_entity_visibility(result, ir_visibility_local);
 	set_entity_compiler_generated(result, 1);
+	set_entity_initializer(result, get_initializer_null());
 
 	return result;
 }
@@ -454,9 +1245,38 @@ static ir_entity *new_static_string_entity(ident *name, const char *string)
 	return result;
 }
 
-ir_graph *ir_profile_instrument(const char *filename)
+/**
+ * Returns the number of counters needed for the current ir program.
+ */
+static unsigned int get_irp_n_counters(void)
+{
+	unsigned int count = 0;
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		profile_plan_t plan;
+		build_plan(get_irp_irg(i), &plan);
+		count += plan.n_counters;
+		free_plan(&plan);
+	}
+	return count;
+}
+
+/**
+ * Returns the number of indirect call sites of the current ir program.
+ */
+static unsigned int get_irp_n_call_sites(void)
+{
+	unsigned int count = 0;
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_node **calls = get_indirect_calls(get_irp_irg(i));
+		count += ARR_LEN(calls);
+		DEL_ARR_F(calls);
+	}
+	return count;
+}
+
+ir_graph *ir_profile_instrument(const char *filename, bool per_thread)
 {
-	int n, n_blocks = 0;
+	int n, n_counters = 0;
 	ident *counter_id, *filename_id;
 	ir_entity *bblock_counts, *ent_filename;
 	block_id_walker_data_t wd;
@@ -467,30 +1287,132 @@ ir_graph *ir_profile_instrument(const char *filename)
 	if (get_irp_n_irgs() == 0)
 		return NULL;
 
-	/* count the number of block first */
-	n_blocks = get_irp_n_blocks();
+	/* count the number of counters first */
+	n_counters = get_irp_n_counters();
 
 	/* create all the necessary types and entities. Note that the
 	 * types must have a fixed layout, because we are already running in the
 	 * backend */
+	ir_type *owner = per_thread ? get_tls_type() : get_glob_type();
 	counter_id    = new_id_from_str("__FIRMPROF__BLOCK_COUNTS");
-	bblock_counts = new_array_entity(counter_id, n_blocks);
+	bblock_counts = new_array_entity(owner, counter_id, mode_Iu, n_counters);
+
+	/* the call target slots are shared, a lost update of the majority vote
+	 * only blurs a heuristic */
+	call_target_tables_t tables;
+	tables.n_sites = get_irp_n_call_sites();
+	tables.targets = NULL;
+	if (tables.n_sites > 0) {
+		tables.targets = new_array_entity(get_glob_type(),
+			new_id_from_str("__FIRMPROF__CALL_TARGETS"),
+			find_unsigned_mode(mode_P_data),
+			tables.n_sites * CALL_SITE_SLOTS);
+	}
+	new_function_tables(&tables);
 
 	filename_id  = new_id_from_str("__FIRMPROF__FILE_NAME");
 	ent_filename = new_static_string_entity(filename_id, filename);
 
-	/* initialize block id array and instrument blocks */
+	wd.filename        = ent_filename;
+	wd.registered      = NULL;
+	wd.register_thread = NULL;
+	if (per_thread) {
+		ir_type *params[3];
+		params[0] = get_string_type();
+		params[1] = get_uintptr_type();
+		params[2] = get_uintptr_type();
+		wd.registered = new_thread_flag_entity(
+			new_id_from_str("__FIRMPROF__REGISTERED"));
+		wd.register_thread = get_firmprof_ref("__firmprof_register_thread",
+		                                      ARRAY_SIZE(params), params);
+	}
+
+	wd.targets     = tables.targets;
+	wd.sites       = NULL;
+	wd.site        = 0;
+	wd.call_target = NULL;
+	if (tables.n_sites > 0) {
+		ir_type *params[2];
+		params[0] = get_uintptr_type();
+		params[1] = new_type_pointer(new_type_method(0, 0));
+		wd.call_target = get_firmprof_ref("__firmprof_call_target",
+		                                  ARRAY_SIZE(params), params);
+	}
+
+	/* initialize counter id array and instrument edges */
 	wd.id  = 0;
 	for (n = get_irp_n_irgs() - 1; n >= 0; --n) {
 		ir_graph *irg = get_irp_irg(n);
 		instrument_irg(irg, bblock_counts, &wd);
 	}
+	assert(wd.id == (unsigned)n_counters);
+	assert(wd.site == tables.n_sites);
+
+	return gen_initializer_irg(ent_filename, bblock_counts, n_counters,
+	                           per_thread, &tables);
+}
+
+/**
+ * Reads an unsigned LEB128 number.
+ */
+static bool read_uleb128(FILE *f, uint64_t *result)
+{
+	uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64; shift += 7) {
+		int const c = getc(f);
+		if (c == EOF)
+			return false;
+		value |= (uint64_t)(c & 0x7f) << shift;
+		if (!(c & 0x80)) {
+			*result = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Reads the call target section following the counters: the number of
+ * indirect call sites and for each site the id of its most frequent target,
+ * the count of the target and the number of executions. Returns NULL if the
+ * profile has no matching section.
+ */
+static uint64_t *parse_call_targets(FILE *f, unsigned num_sites)
+{
+	uint64_t n;
+	if (!read_uleb128(f, &n))
+		return NULL;
+	if (n != num_sites) {
+		DBG((dbg, LEVEL_2, "Profile has call targets for %u sites, not %u\n",
+			(unsigned)n, num_sites));
+		return NULL;
+	}
 
-	return gen_initializer_irg(ent_filename, bblock_counts, n_blocks);
+	size_t    n_values = (size_t)num_sites * CALL_SITE_SLOTS;
+	uint64_t *result   = XMALLOCN(uint64_t, n_values);
+	for (size_t i = 0; i < n_values; ++i) {
+		if (!read_uleb128(f, &result[i])) {
+			DBG((dbg, LEVEL_4, "Failed to read call targets\n"));
+			free(result);
+			return NULL;
+		}
+	}
+	return result;
 }
 
-static unsigned int *parse_profile(const char *filename, unsigned int num_blocks)
+/**
+ * Reads the counters of a profile. libfirmprof writes the magic "firmprf2",
+ * the number of counters and then the counter values, all numbers as unsigned
+ * LEB128, so the mostly small counts take a byte or two. Files of older
+ * versions start with "firmprof" followed by 32 bit little endian counters.
+ * The call targets of the indirect call sites follow the counters of
+ * "firmprf2" profiles, they are returned in @p sites if present.
+ */
+static uint64_t *parse_profile(const char *filename, unsigned num_counters,
+                               unsigned num_sites, uint64_t **sites)
 {
+	*sites = NULL;
+
 	FILE *f = fopen(filename, "rb");
 	if (!f) {
 		DBG((dbg, LEVEL_2, "Failed to open profile file (%s)\n", filename));
@@ -498,31 +1420,40 @@ static unsigned int *parse_profile(const char *filename, unsigned int num_blocks
 	}
 
 	/* check header */
-	uint32_t *result = NULL;
+	uint64_t *result = NULL;
 	char      buf[8];
 	size_t    ret = fread(buf, 8, 1, f);
-	if (ret == 0 || strncmp(buf, "firmprof", 8) != 0) {
+	bool      compact = ret != 0 && strncmp(buf, "firmprf2", 8) == 0;
+	if (ret == 0 || (!compact && strncmp(buf, "firmprof", 8) != 0)) {
 		DBG((dbg, LEVEL_2, "Broken fileheader in profile\n"));
 		goto end;
 	}
 
-	result = XMALLOCN(unsigned int, num_blocks);
-
-	/* The profiling output format is defined to be a sequence of integer
-	 * values stored little endian format. */
-	for (unsigned i = 0; i < num_blocks; ++i) {
-		unsigned char bytes[4];
-
-		if ((ret = fread(bytes, 1, 4, f)) < 1)
-			break;
+	result = XMALLOCN(uint64_t, num_counters);
 
-		result[i] = (bytes[0] <<  0) | (bytes[1] <<  8)
-		          | (bytes[2] << 16) | (bytes[3] << 24);
+	bool ok = true;
+	if (compact) {
+		uint64_t n;
+		ok = read_uleb128(f, &n) && n == num_counters;
+		for (unsigned i = 0; ok && i < num_counters; ++i)
+			ok = read_uleb128(f, &result[i]);
+		if (ok)
+			*sites = parse_call_targets(f, num_sites);
+	} else {
+		for (unsigned i = 0; i < num_counters; ++i) {
+			unsigned char bytes[4];
+			if (fread(bytes, 1, 4, f) != 4) {
+				ok = false;
+				break;
+			}
+			result[i] = (uint32_t)bytes[0]       | (uint32_t)bytes[1] <<  8
+			          | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+		}
 	}
 
-	if (ret < 1) {
-		DBG((dbg, LEVEL_4, "Failed to read counters... (size: %u)\n",
-			sizeof(unsigned int) * num_blocks));
+	if (!ok) {
+		DBG((dbg, LEVEL_4, "Failed to read counters... (count: %u)\n",
+			num_counters));
 		free(result);
 		result = NULL;
 	}
@@ -533,26 +1464,67 @@ end:
 }
 
 /**
- * Reads the corresponding profile info file if it exists.
+ * Derives the block and edge counts of all graphs from the counters.
  */
-static void block_associate_walker(ir_node *bb, void *env)
+static void irp_associate_blocks(const uint64_t *counters)
 {
-	block_assoc_t *b = (block_assoc_t*) env;
-	execcount_t query;
+	unsigned base = 0;
+	for (int n = get_irp_n_irgs() - 1; n >= 0; --n) {
+		ir_graph      *irg = get_irp_irg(n);
+		profile_plan_t plan;
+		build_plan(irg, &plan);
+		for (size_t e = 0, n_edges = ARR_LEN(plan.edges); e < n_edges; ++e) {
+			profile_edge_t *edge = &plan.edges[e];
+			if (edge->counted)
+				edge->count = MIN(counters[base + edge->counter],
+				                  (uint64_t)INT64_MAX);
+		}
+		base += plan.n_counters;
 
-	query.block = get_irn_node_nr(bb);
-	query.count = b->counters[(b->i)++];
-	DBG((dbg, LEVEL_4, "execcount(%+F, %u): %u\n", bb, query.block,
-	    query.count));
-	(void)set_insert(execcount_t, profile, &query, sizeof(query), query.block);
+		solve_plan(&plan);
+		associate_plan(&plan);
+		free_plan(&plan);
+	}
 }
 
-static void irp_associate_blocks(block_assoc_t *env)
+/**
+ * Associates the indirect calls of all graphs with the targets recorded for
+ * their sites. Targets are named by their function ids, so they are found
+ * among all functions the program knows of, including external ones.
+ */
+static void irp_associate_call_targets(const uint64_t *sites)
 {
+	pmap    *functions = pmap_create();
+	ir_type *glob      = get_glob_type();
+	for (size_t i = 0, n = get_compound_n_members(glob); i < n; ++i) {
+		ir_entity *entity = get_compound_member(glob, i);
+		if (is_method_entity(entity))
+			pmap_insert(functions, INT_TO_PTR(get_function_id(entity)), entity);
+	}
+
+	unsigned site = 0;
 	for (int n = get_irp_n_irgs() - 1; n >= 0; --n) {
-		ir_graph *irg = get_irp_irg(n);
-		irg_block_walk_graph(irg, block_associate_walker, NULL, env);
+		ir_node **calls = get_indirect_calls(get_irp_irg(n));
+		for (size_t c = 0, n_calls = ARR_LEN(calls); c < n_calls; ++c) {
+			const uint64_t *slots = &sites[site++ * CALL_SITE_SLOTS];
+			if (slots[0] == 0 || slots[0] > UINT_MAX)
+				continue;
+			ir_entity *target = pmap_get(ir_entity, functions,
+			                             INT_TO_PTR((unsigned)slots[0]));
+			if (target == NULL)
+				continue;
+
+			call_target_t ct;
+			ct.call   = get_irn_node_nr(calls[c]);
+			ct.target = target;
+			ct.count  = clamp_count(MIN(slots[1], (uint64_t)INT64_MAX));
+			ct.total  = clamp_count(MIN(slots[2], (uint64_t)INT64_MAX));
+			(void)set_insert(call_target_t, call_target_profile, &ct,
+			                 sizeof(ct), ct.call);
+		}
+		DEL_ARR_F(calls);
 	}
+	pmap_destroy(functions);
 }
 
 void ir_profile_free(void)
@@ -561,6 +1533,14 @@ void ir_profile_free(void)
 		del_set(profile);
 		profile = NULL;
 	}
+	if (edge_profile) {
+		del_set(edge_profile);
+		edge_profile = NULL;
+	}
+	if (call_target_profile) {
+		del_set(call_target_profile);
+		call_target_profile = NULL;
+	}
 
 	if (hook != NULL) {
 		dump_remove_node_info_callback(hook);
@@ -570,20 +1550,26 @@ void ir_profile_free(void)
 
 bool ir_profile_read(const char *filename)
 {
-	block_assoc_t env;
 	FIRM_DBG_REGISTER(dbg, "firm.ir.profile");
 
-	unsigned n_blocks = get_irp_n_blocks();
-	env.i        = 0;
-	env.counters = parse_profile(filename, n_blocks);
-	if (!env.counters)
+	unsigned  n_counters = get_irp_n_counters();
+	unsigned  n_sites    = get_irp_n_call_sites();
+	uint64_t *sites;
+	uint64_t *counters   = parse_profile(filename, n_counters, n_sites, &sites);
+	if (!counters)
 		return false;
 
 	ir_profile_free();
-	profile = new_set(cmp_execcount, 16);
-
-	irp_associate_blocks(&env);
-	free(env.counters);
+	profile      = new_set(cmp_execcount, 16);
+	edge_profile = new_set(cmp_edgecount, 16);
+
+	irp_associate_blocks(counters);
+	free(counters);
+	if (sites != NULL) {
+		call_target_profile = new_set(cmp_call_target, 16);
+		irp_associate_call_targets(sites);
+		free(sites);
+	}
 
 	/* register the vcg hook */
 	hook = dump_add_node_info_callback(dump_profile_node_info, NULL);
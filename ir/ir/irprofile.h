@@ -23,8 +23,17 @@
  * The final code will have a counter for each basic block which is
  * incremented in that block. After the program has run the info is written
  * to @p filename.
+ *
+ * With @p per_thread set the counters are thread local, so threads neither
+ * race on them nor share their cache lines. Every thread registers its
+ * counters with libfirmprof when it first enters an instrumented function
+ * and the runtime merges the counts of all threads when writing the profile.
+ * This needs thread local storage support in the backend.
+ *
+ * Indirect calls additionally record their most frequent target, see
+ * ir_profile_get_call_target().
  */
-ir_graph *ir_profile_instrument(const char *filename);
+ir_graph *ir_profile_instrument(const char *filename, bool per_thread);
 
 /**
  * Reads the corresponding profile info file if it exists and returns a
@@ -43,6 +52,34 @@ void ir_profile_free(void);
  */
 uint32_t ir_profile_get_block_execcount(const ir_node *block);
 
+/**
+ * Returns true if profile info is loaded and contains an execution count for
+ * @p block. Blocks created after the profile was read have none.
+ */
+bool ir_profile_has_block_execcount(const ir_node *block);
+
+/**
+ * Get the execution count of the control flow edge from predecessor @p pos
+ * to @p block as determined by profiling
+ */
+uint32_t ir_profile_get_edge_execcount(const ir_node *block, int pos);
+
+/**
+ * Returns true if profile info is loaded and contains an execution count for
+ * the control flow edge from predecessor @p pos to @p block.
+ */
+bool ir_profile_has_edge_execcount(const ir_node *block, int pos);
+
+/**
+ * Returns the most frequent target of the indirect call @p call as determined
+ * by profiling, or NULL if the profile knows none. The instrumentation counts
+ * the targets with a majority vote, so @p count is only a lower bound of the
+ * calls of the target, but a target called by more than half of the
+ * @p total executions of the call is always found.
+ */
+ir_entity *ir_profile_get_call_target(const ir_node *call, uint32_t *count,
+                                      uint32_t *total);
+
 /**
  * Initializes exec_freq structure for an irg based on profile data
  */
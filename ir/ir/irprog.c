@@ -99,6 +99,9 @@ void free_ir_prog(void)
 	if (irp == NULL)
 		return;
 
+	/* drop the address users index before its graphs vanish */
+	set_irp_globals_entity_usage_state(ir_entity_usage_not_computed);
+
 	size_t i;
 	/* must iterate backwards here */
 	for (i = get_irp_n_irgs(); i > 0;)
@@ -124,6 +127,8 @@ void free_ir_prog(void)
 	DEL_ARR_F(irp->global_asms);
 
 	pmap_destroy(irp->compilerlib_entities);
+	if (irp->clone_specializations != NULL)
+		del_set(irp->clone_specializations);
 	irp->name           = NULL;
 	irp->const_code_irg = NULL;
 	irp->kind           = k_BAD;
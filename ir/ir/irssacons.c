@@ -19,16 +19,14 @@ static void (*ssa_cons_walker)(ir_graph *, irg_walk_func *, irg_walk_func *, voi
 
 /**
  * Post-walker: prepare the graph nodes for new SSA construction cycle by
- * allocation new arrays.
+ * forgetting the values of the previous one.
  */
 static void prepare_blocks(ir_node *block, void *env)
 {
-	ir_graph *const irg   = get_Block_irg(block);
-	unsigned  const n_loc = irg->n_loc;
 	(void)env;
 	/* reset mature flag */
 	set_Block_matured(block, 0);
-	block->attr.block.graph_arr = NEW_ARR_DZ(ir_node*, get_irg_obstack(irg), n_loc);
+	block->attr.block.values = NULL;
 	set_Block_phis(block, NULL);
 }
 
@@ -39,9 +37,8 @@ void ssa_cons_start(ir_graph *irg, int n_loc)
 	irg_set_nloc(irg, n_loc);
 
 	/*
-	 * Note: we could try to reuse existing frag arrays, but it does not
-	 * seems worth to do this.  First, we have to check if they really exists and
-	 * then clear them.  We do not expect SSA construction is used often.
+	 * Note: the value maps of the blocks are allocated on demand, so
+	 * restarting the construction only has to forget the old ones.
 	 */
 	ssa_cons_walker(irg, NULL, prepare_blocks, NULL);
 }
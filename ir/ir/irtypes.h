@@ -26,6 +26,8 @@
 #include "bitset.h"
 
 #include "pset.h"
+#include "set.h"
+#include "cpset.h"
 #include "pmap.h"
 #include "list.h"
 #include "obst.h"
@@ -119,6 +121,9 @@ typedef enum ir_mode_sort {
 	/** A mode to represent float numbers.
 	    Floating point computations can be performed. */
 	irms_float_number     = 9 | irmsh_is_data | irmsh_is_datab | irmsh_is_dataM | irmsh_is_num,
+	/** A mode to represent vectors of numbers or references. The values can
+	    be loaded, stored and moved, computations work on the elements. */
+	irms_vector           = 10 | irmsh_is_data | irmsh_is_dataM,
 } ir_mode_sort;
 
 /**
@@ -165,6 +170,8 @@ struct ir_mode {
 	unsigned           sign:1;        /**< signedness of this mode */
 	unsigned int       modulo_shift;  /**< number of bits a values of this mode will be shifted */
 	float_descriptor_t float_desc;
+	ir_mode           *vector_elem_mode; /**< element mode of vector modes */
+	unsigned           n_vector_elems;   /**< number of elements of vector modes */
 
 	/* ---------------------------------------------------------------------- */
 	ir_tarval         *min;         /**< the minimum value that can be expressed */
@@ -206,6 +213,23 @@ typedef struct anchor_attr {
 	irg_attr  irg;
 } anchor_attr;
 
+/** The definition of a value number in a block during SSA construction. */
+typedef struct block_value_t {
+	int      pos;   /**< the value number, -1 for an unused slot */
+	ir_node *value; /**< the current definition of the value */
+} block_value_t;
+
+/**
+ * Maps value numbers to their current definition in a block during SSA
+ * construction. An open addressing hash table, so only the values actually
+ * defined or looked up in a block take memory.
+ */
+typedef struct block_values_t {
+	unsigned      n_used;    /**< number of used slots */
+	unsigned      mask;      /**< number of slots - 1, a power of two - 1 */
+	block_value_t entries[]; /**< the slots */
+} block_values_t;
+
 /** Block attributes */
 typedef struct block_attr {
 	/* General attributes */
@@ -215,7 +239,7 @@ typedef struct block_attr {
 	unsigned is_matured:1;      /**< If set, all in-nodes of the block are fixed. */
 	unsigned dynamic_ins:1;     /**< if set in-array is an ARR_F on the heap. */
 	unsigned marked:1;          /**< Can be set/unset to temporary mark a block. */
-	ir_node **graph_arr;        /**< An array to store all parameters. */
+	block_values_t *values;     /**< Current definitions of the values. */
 	/* Attributes holding analyses information */
 	ir_dom_info dom;            /**< Datastructure that holds information about dominators. */
 	ir_dom_info pdom;           /**< Datastructure that holds information about post-dominators. */
@@ -447,6 +471,7 @@ typedef struct irg_edge_info_t {
 	struct obstack   edges_obst;     /**< Obstack, where edges are allocated on. */
 	unsigned         allocated : 1;  /**< Set if edges are allocated on the obstack. */
 	unsigned         activated : 1;  /**< Set if edges are activated for the graph. */
+	unsigned         suspended : 1;  /**< Set if edge maintenance is suspended. */
 } irg_edge_info_t;
 
 typedef irg_edge_info_t irg_edges_info_t[EDGE_KIND_LAST+1];
@@ -496,6 +521,7 @@ struct ir_graph {
 	                                    Can include "inner" methods. */
 	ir_node *anchor;               /**< Pointer to the anchor node of this graph. */
 	struct obstack obst;           /**< The obstack where all of the ir_nodes live. */
+	ir_graph_memory_t memory;      /**< The memory mapped from the OS. */
 	ir_node *current_block;        /**< Current block for new_*()ly created ir_nodes. */
 
 	/* -- Fields indicating different states of irgraph -- */
@@ -510,13 +536,24 @@ struct ir_graph {
 	int n_loc;                         /**< Number of local variables in this
 	                                        procedure including procedure parameters. */
 	void **loc_descriptions;           /**< Storage for local variable descriptions. */
+	struct ir_lazy_body *lazy_body;    /**< Position of the body in a lazily
+	                                        imported file if it was not read
+	                                        yet. */
+	bool in_bulk_cons;                 /**< Set while local optimization of
+	                                        new nodes is deferred. */
+	unsigned bulk_cons_first_idx;      /**< Index of the first node created
+	                                        in the bulk construction. */
 
 	/* -- Fields for optimizations / analysis information -- */
-	pset *value_table;                 /**< Hash table for global value numbering (cse)
+	cpset_t *value_table;              /**< Hash table for global value numbering (cse)
 	                                        for optimizing use in iropt.c */
-	struct obstack   out_obst;         /**< Space for the Def-Use arrays. */
-	bool             out_obst_allocated;
+	ir_def_use_edges *outs;            /**< Def-Use edges of all nodes, packed
+	                                        in one array. */
+	size_t           outs_size;        /**< Size of outs in bytes. */
+	bool             outs_mapped;      /**< Set if outs are mapped from the
+	                                        OS. */
 	ir_vrp_info      vrp;              /**< vrp info */
+	struct ir_alias_cache_t *alias_cache; /**< cached alias queries, see irmemory.c */
 
 	ir_loop *loop;                     /**< The outermost loop for this graph. */
 	ir_dom_front_info_t domfront;      /**< dominance frontier analysis data */
@@ -617,6 +654,8 @@ struct ir_prog {
 	long max_node_nr;                    /**< to generate unique numbers for nodes. */
 	unsigned dump_nr;                    /**< number of program info dumps */
 	pmap *compilerlib_entities;          /**< maps ident* to ir_entity* of the compilerlib */
+	set *clone_specializations;          /**< clones made by proc_cloning(), see
+	                                          there */
 #ifndef NDEBUG
 	irp_resources_t reserved_resources;  /**< Bitset for tracking used global resources. */
 #endif
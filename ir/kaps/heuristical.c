@@ -91,8 +91,9 @@ void solve_pbqp_heuristical(pbqp_t *pbqp)
 	/* Reduce nodes degree ... */
 	initial_simplify_edges(pbqp);
 
-	/* ... and put node into bucket representing their degree. */
-	fill_node_buckets(pbqp);
+	/* ... and split the PBQP into its independent components. */
+	unsigned      n_components;
+	pbqp_node_t **components = split_components(pbqp, &n_components);
 
 #if KAPS_STATISTIC
 	FILE *fh = fopen("solutions.pb", "a");
@@ -100,7 +101,15 @@ void solve_pbqp_heuristical(pbqp_t *pbqp)
 	fclose(fh);
 #endif
 
-	apply_heuristic_reductions(pbqp);
+	/* Reduce the components one after another, so the selection of the
+	 * RN node only looks at the current one. */
+	pbqp_node_t **component = components;
+	for (unsigned c = 0; c < n_components; ++c) {
+		/* Put the nodes into the buckets representing their degree. */
+		component = fill_component_buckets(component);
+		apply_heuristic_reductions(pbqp);
+	}
+	DEL_ARR_F(components);
 
 	pbqp->solution = determine_solution(pbqp);
 
@@ -3,6 +3,7 @@
  * Copyright (C) 2012 Karlsruhe Institute of Technology.
  */
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include "adt/array.h"
 #include "assert.h"
@@ -321,8 +322,9 @@ void solve_pbqp_heuristical_co_ld(pbqp_t *pbqp, plist_t *rpeo)
 	/* Reduce nodes degree ... */
 	initial_simplify_edges(pbqp);
 
-	/* ... and put node into bucket representing their degree. */
-	fill_node_buckets(pbqp);
+	/* ... and split the PBQP into its independent components. */
+	unsigned      n_components;
+	pbqp_node_t **components = split_components(pbqp, &n_components);
 
 	#if KAPS_STATISTIC
 		FILE *fh = fopen("solutions.pb", "a");
@@ -330,7 +332,21 @@ void solve_pbqp_heuristical_co_ld(pbqp_t *pbqp, plist_t *rpeo)
 		fclose(fh);
 	#endif
 
-	apply_heuristic_reductions_co(pbqp, rpeo);
+	/* Reduce the components one after another, each with the part of the
+	 * elimination order belonging to it. */
+	plist_t     **rpeos     = split_rpeo(rpeo, n_components);
+	plist_t      *no_rpeo   = plist_new();
+	pbqp_node_t **component = components;
+	for (unsigned c = 0; c < n_components; ++c) {
+		/* Put the nodes into the buckets representing their degree. */
+		component = fill_component_buckets(component);
+		apply_heuristic_reductions_co(pbqp, rpeos[c] ? rpeos[c] : no_rpeo);
+		if (rpeos[c])
+			plist_free(rpeos[c]);
+	}
+	plist_free(no_rpeo);
+	free(rpeos);
+	DEL_ARR_F(components);
 
 	pbqp->solution = determine_solution(pbqp);
 
@@ -76,9 +76,7 @@ void pbqp_matrix_add(pbqp_matrix_t *sum, pbqp_matrix_t *summand)
 
 	unsigned len = sum->rows * sum->cols;
 
-	for (unsigned i = 0; i < len; ++i) {
-		sum->entries[i] = pbqp_add(sum->entries[i], summand->entries[i]);
-	}
+	pbqp_add_array(sum->entries, summand->entries, len);
 }
 
 void pbqp_matrix_set_col_value(pbqp_matrix_t *mat, unsigned col, num value)
@@ -180,11 +178,12 @@ void pbqp_matrix_sub_col_value(pbqp_matrix_t *matrix, unsigned col_index,
 
 num pbqp_matrix_get_row_min(pbqp_matrix_t *matrix, unsigned row_index, vector_t *flags)
 {
-	num      min = INF_COSTS;
 	unsigned len = flags->len;
 
 	assert(matrix->cols == len);
 
+#if KAPS_ENABLE_VECTOR_NAMES
+	num min = INF_COSTS;
 	for (unsigned col_index = 0; col_index < len; ++col_index) {
 		/* Ignore virtual deleted columns. */
 		if (flags->entries[col_index].data == INF_COSTS) continue;
@@ -197,6 +196,9 @@ num pbqp_matrix_get_row_min(pbqp_matrix_t *matrix, unsigned row_index, vector_t
 	}
 
 	return min;
+#else
+	return pbqp_min_array(&matrix->entries[row_index * len], vector_costs(flags), len);
+#endif
 }
 
 unsigned pbqp_matrix_get_row_min_index(pbqp_matrix_t *matrix, unsigned row_index, vector_t *flags)
@@ -277,10 +279,7 @@ void pbqp_matrix_add_to_all_cols(pbqp_matrix_t *mat, vector_t *vec)
 	for (unsigned row_index = 0; row_index < row_len; ++row_index) {
 		num value = vec->entries[row_index].data;
 
-		for (unsigned col_index = 0; col_index < col_len; ++col_index) {
-			mat->entries[row_index * col_len + col_index] = pbqp_add(
-					mat->entries[row_index * col_len + col_index], value);
-		}
+		pbqp_add_value_array(&mat->entries[row_index * col_len], value, col_len);
 	}
 }
 
@@ -292,10 +291,14 @@ void pbqp_matrix_add_to_all_rows(pbqp_matrix_t *mat, vector_t *vec)
 	assert(col_len == vec->len);
 
 	for (unsigned row_index = 0; row_index < row_len; ++row_index) {
+#if KAPS_ENABLE_VECTOR_NAMES
 		for (unsigned col_index = 0; col_index < col_len; ++col_index) {
 			num value = vec->entries[col_index].data;
 
 			mat->entries[row_index * col_len + col_index] = pbqp_add(mat->entries[row_index * col_len + col_index], value);
 		}
+#else
+		pbqp_add_array(&mat->entries[row_index * col_len], vector_costs(vec), col_len);
+#endif
 	}
 }
@@ -12,6 +12,7 @@
 #include <stdbool.h>
 
 #include "adt/array.h"
+#include "adt/xmalloc.h"
 #include "assert.h"
 #include "error.h"
 
@@ -115,6 +116,86 @@ void fill_node_buckets(pbqp_t *pbqp)
 	#endif
 }
 
+pbqp_node_t **split_components(pbqp_t *pbqp, unsigned *n_components)
+{
+	/* The pending simplifications may delete edges, so finish them before
+	 * looking at the connectivity. */
+	while (edge_bucket_get_length(edge_bucket) > 0)
+		apply_edge(pbqp);
+
+	unsigned node_len = pbqp->num_nodes;
+	for (unsigned node_index = 0; node_index < node_len; ++node_index) {
+		pbqp_node_t *node = get_node(pbqp, node_index);
+		if (node)
+			node->component = UINT_MAX;
+	}
+
+	/* The array is used as work queue of a breadth first search, so each
+	 * component is a consecutive run of nodes. */
+	pbqp_node_t **components = NEW_ARR_F(pbqp_node_t*, 0);
+	unsigned      n_comps    = 0;
+	for (unsigned node_index = 0; node_index < node_len; ++node_index) {
+		pbqp_node_t *node = get_node(pbqp, node_index);
+		if (!node || node->component != UINT_MAX)
+			continue;
+
+		size_t queue = ARR_LEN(components);
+		node->component = n_comps;
+		ARR_APP1(pbqp_node_t*, components, node);
+		for (; queue < ARR_LEN(components); ++queue) {
+			pbqp_node_t  *member   = components[queue];
+			pbqp_edge_t **edges    = member->edges;
+			unsigned      edge_len = pbqp_node_get_degree(member);
+			for (unsigned edge_index = 0; edge_index < edge_len; ++edge_index) {
+				pbqp_edge_t *edge     = edges[edge_index];
+				pbqp_node_t *neighbor = edge->src == member ? edge->tgt : edge->src;
+				if (neighbor->component != UINT_MAX)
+					continue;
+				neighbor->component = n_comps;
+				ARR_APP1(pbqp_node_t*, components, neighbor);
+			}
+		}
+		ARR_APP1(pbqp_node_t*, components, NULL);
+		++n_comps;
+	}
+
+	*n_components = n_comps;
+	return components;
+}
+
+pbqp_node_t **fill_component_buckets(pbqp_node_t **nodes)
+{
+	for (; *nodes != NULL; ++nodes) {
+		pbqp_node_t *node   = *nodes;
+		unsigned     degree = pbqp_node_get_degree(node);
+
+		/* We have only one bucket for nodes with arity >= 3. */
+		if (degree > 3) {
+			degree = 3;
+		}
+
+		node_bucket_insert(&node_buckets[degree], node);
+	}
+
+	buckets_filled = 1;
+
+	return nodes + 1;
+}
+
+plist_t **split_rpeo(plist_t *rpeo, unsigned n_components)
+{
+	plist_t         **rpeos = XMALLOCNZ(plist_t*, n_components);
+	plist_element_t  *element;
+	foreach_plist(rpeo, element) {
+		pbqp_node_t *node      = (pbqp_node_t*)element->data;
+		unsigned     component = node->component;
+		if (rpeos[component] == NULL)
+			rpeos[component] = plist_new();
+		plist_insert_back(rpeos[component], node);
+	}
+	return rpeos;
+}
+
 static void normalize_towards_source(pbqp_edge_t *edge)
 {
 	pbqp_matrix_t *mat          = edge->costs;
@@ -13,6 +13,7 @@
 #define KAPS_OPTIMAL_H
 
 #include "pbqp_t.h"
+#include "plist.h"
 
 extern pbqp_edge_t **edge_bucket;
 extern pbqp_node_t **node_buckets[4];
@@ -28,6 +29,25 @@ void apply_RM(pbqp_t *pbqp, pbqp_node_t *node);
 void back_propagate(pbqp_t *pbqp);
 num determine_solution(pbqp_t *pbqp);
 void fill_node_buckets(pbqp_t *pbqp);
+
+/**
+ * Splits the PBQP into its connected components after the initial
+ * simplification. Returns the nodes grouped by component in the order of
+ * their smallest node index, each component is terminated by NULL.
+ */
+pbqp_node_t **split_components(pbqp_t *pbqp, unsigned *n_components);
+
+/**
+ * Puts the nodes of the component starting at @p nodes into the buckets
+ * representing their degree and returns the start of the next component.
+ */
+pbqp_node_t **fill_component_buckets(pbqp_node_t **nodes);
+
+/**
+ * Splits the reverse perfect elimination order by the components of its
+ * nodes. Components without a node in the order get no list.
+ */
+plist_t **split_rpeo(plist_t *rpeo, unsigned n_components);
 void free_buckets(void);
 unsigned get_local_minimal_alternative(pbqp_t *pbqp, pbqp_node_t *node);
 pbqp_node_t *get_node_with_max_degree(void);
@@ -31,6 +31,7 @@ pbqp_node_t *alloc_node(pbqp_t *pbqp, unsigned node_index, vector_t *costs)
 	node->bucket_index = UINT_MAX;
 	node->solution = UINT_MAX;
 	node->index = node_index;
+	node->component = UINT_MAX;
 
 	return node;
 }
@@ -136,6 +137,7 @@ pbqp_node_t *pbqp_node_deep_copy(pbqp_t *pbqp, pbqp_node_bucket_t new_bucket,
 	copy->bucket_index = node->bucket_index;
 	copy->solution     = node->solution;
 	copy->index        = node->index;
+	copy->component    = node->component;
 
 	return copy;
 }
@@ -20,6 +20,7 @@ struct pbqp_node_t {
 	unsigned      bucket_index;
 	unsigned      solution;
 	unsigned      index;
+	unsigned      component;
 };
 
 #endif /* KAPS_PBQP_NODE_T_H */
@@ -27,6 +27,10 @@
 #if KAPS_USE_UNSIGNED
 	typedef unsigned num;
 	#define INF_COSTS UINT_MAX
+	#if defined(__SSE2__)
+		/* process four costs at once in the vector and matrix kernels */
+		#define KAPS_SSE2
+	#endif
 #else
 	typedef intmax_t num;
 	#define INF_COSTS INTMAX_MAX
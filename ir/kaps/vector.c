@@ -15,6 +15,47 @@
 
 #include "vector.h"
 
+#ifdef KAPS_SSE2
+#include <emmintrin.h>
+
+/** Number of costs processed by one vector operation. */
+#define KAPS_VEC_ELEMS (sizeof(__m128i) / sizeof(num))
+
+/** Flip the sign bits, so signed comparisons order the costs unsigned. */
+static inline __m128i vec_bias(__m128i x)
+{
+	return _mm_xor_si128(x, _mm_set1_epi32(INT_MIN));
+}
+
+/**
+ * Add costs, saturating at INF_COSTS. As INF_COSTS has all bits set, this
+ * matches pbqp_add() for all sums pbqp_add() accepts.
+ */
+static inline __m128i vec_add(__m128i x, __m128i y)
+{
+	__m128i const sum      = _mm_add_epi32(x, y);
+	/* the addition wrapped around iff the sum is smaller than x */
+	__m128i const overflow = _mm_cmpgt_epi32(vec_bias(x), vec_bias(sum));
+	return _mm_or_si128(sum, overflow);
+}
+
+static inline __m128i vec_min(__m128i x, __m128i y)
+{
+	__m128i const gt = _mm_cmpgt_epi32(vec_bias(x), vec_bias(y));
+	return _mm_or_si128(_mm_and_si128(gt, y), _mm_andnot_si128(gt, x));
+}
+
+static inline __m128i vec_load(const num *elems)
+{
+	return _mm_loadu_si128((const __m128i*)elems);
+}
+
+static inline void vec_store(num *elems, __m128i v)
+{
+	_mm_storeu_si128((__m128i*)elems, v);
+}
+#endif
+
 num pbqp_add(num x, num y)
 {
 	if (x == INF_COSTS || y == INF_COSTS)
@@ -38,6 +79,61 @@ num pbqp_add(num x, num y)
 	return res;
 }
 
+void pbqp_add_array(num *sum, const num *summand, unsigned len)
+{
+	unsigned i = 0;
+#ifdef KAPS_SSE2
+	for (; i + KAPS_VEC_ELEMS <= len; i += KAPS_VEC_ELEMS)
+		vec_store(&sum[i], vec_add(vec_load(&sum[i]), vec_load(&summand[i])));
+#endif
+	for (; i < len; ++i)
+		sum[i] = pbqp_add(sum[i], summand[i]);
+}
+
+void pbqp_add_value_array(num *sum, num value, unsigned len)
+{
+	unsigned i = 0;
+#ifdef KAPS_SSE2
+	__m128i const v = _mm_set1_epi32((int)value);
+	for (; i + KAPS_VEC_ELEMS <= len; i += KAPS_VEC_ELEMS)
+		vec_store(&sum[i], vec_add(vec_load(&sum[i]), v));
+#endif
+	for (; i < len; ++i)
+		sum[i] = pbqp_add(sum[i], value);
+}
+
+num pbqp_min_array(const num *elems, const num *flags, unsigned len)
+{
+	num      min = INF_COSTS;
+	unsigned i   = 0;
+#ifdef KAPS_SSE2
+	if (len >= KAPS_VEC_ELEMS) {
+		__m128i const inf  = _mm_set1_epi32((int)INF_COSTS);
+		__m128i       vmin = inf;
+		for (; i + KAPS_VEC_ELEMS <= len; i += KAPS_VEC_ELEMS) {
+			__m128i elem = vec_load(&elems[i]);
+			/* deleted entries become INF_COSTS, which never is the minimum */
+			if (flags != NULL)
+				elem = _mm_or_si128(elem, _mm_cmpeq_epi32(vec_load(&flags[i]), inf));
+			vmin = vec_min(vmin, elem);
+		}
+		num part[KAPS_VEC_ELEMS];
+		vec_store(part, vmin);
+		for (unsigned p = 0; p < KAPS_VEC_ELEMS; ++p) {
+			if (part[p] < min)
+				min = part[p];
+		}
+	}
+#endif
+	for (; i < len; ++i) {
+		if (flags != NULL && flags[i] == INF_COSTS)
+			continue;
+		if (elems[i] < min)
+			min = elems[i];
+	}
+	return min;
+}
+
 vector_t *vector_alloc(pbqp_t *pbqp, unsigned length)
 {
 	vector_t *vec = (vector_t *)obstack_alloc(&pbqp->obstack, sizeof(*vec) + sizeof(*vec->entries) * length);
@@ -64,9 +160,13 @@ void vector_add(vector_t *sum, vector_t *summand)
 
 	assert(len == summand->len);
 
+#if KAPS_ENABLE_VECTOR_NAMES
 	for (unsigned i = 0; i < len; ++i) {
 		sum->entries[i].data = pbqp_add(sum->entries[i].data, summand->entries[i].data);
 	}
+#else
+	pbqp_add_array(vector_costs(sum), vector_costs(summand), len);
+#endif
 }
 
 void vector_set(vector_t *vec, unsigned index, num value)
@@ -87,9 +187,13 @@ void vector_add_value(vector_t *vec, num value)
 {
 	unsigned len = vec->len;
 
+#if KAPS_ENABLE_VECTOR_NAMES
 	for (unsigned index = 0; index < len; ++index) {
 		vec->entries[index].data = pbqp_add(vec->entries[index].data, value);
 	}
+#else
+	pbqp_add_value_array(vector_costs(vec), value, len);
+#endif
 }
 
 void vector_add_matrix_col(vector_t *vec, pbqp_matrix_t *mat, unsigned col_index)
@@ -111,19 +215,23 @@ void vector_add_matrix_row(vector_t *vec, pbqp_matrix_t *mat, unsigned row_index
 	assert(len == mat->cols);
 	assert(row_index < mat->rows);
 
-
+#if KAPS_ENABLE_VECTOR_NAMES
 	for (unsigned index = 0; index < len; ++index) {
 		vec->entries[index].data = pbqp_add(vec->entries[index].data, mat->entries[row_index * mat->cols + index]);
 	}
+#else
+	pbqp_add_array(vector_costs(vec), &mat->entries[row_index * mat->cols], len);
+#endif
 }
 
 num vector_get_min(vector_t *vec)
 {
 	unsigned len = vec->len;
-	num      min = INF_COSTS;
 
 	assert(len > 0);
 
+#if KAPS_ENABLE_VECTOR_NAMES
+	num min = INF_COSTS;
 	for (unsigned index = 0; index < len; ++index) {
 		num elem = vec->entries[index].data;
 
@@ -133,6 +241,9 @@ num vector_get_min(vector_t *vec)
 	}
 
 	return min;
+#else
+	return pbqp_min_array(vector_costs(vec), NULL, len);
+#endif
 }
 
 unsigned vector_get_min_index(vector_t *vec)
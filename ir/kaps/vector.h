@@ -16,6 +16,15 @@
 
 num pbqp_add(num x, num y);
 
+/* sum[i] += summand[i] for all i < len */
+void pbqp_add_array(num *sum, const num *summand, unsigned len);
+
+/* sum[i] += value for all i < len */
+void pbqp_add_value_array(num *sum, num value, unsigned len);
+
+/* The minimum of all elems[i] with flags[i] != INF_COSTS, flags may be NULL. */
+num pbqp_min_array(const num *elems, const num *flags, unsigned len);
+
 vector_t *vector_alloc(pbqp_t *pbqp, unsigned length);
 
 /* Copy the given vector. */
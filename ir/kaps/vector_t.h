@@ -30,4 +30,12 @@ struct vector_t {
 	vec_elem_t entries[];
 };
 
+#if !KAPS_ENABLE_VECTOR_NAMES
+/** Without names the entries of a vector form a plain array of costs. */
+static inline num *vector_costs(vector_t *vec)
+{
+	return &vec->entries[0].data;
+}
+#endif
+
 #endif /* KAPS_VECTOR_T_H */
@@ -25,6 +25,66 @@
 
 static struct obstack obst;
 
+/**
+ * Open addressing hash table over all groups and options, keyed by their
+ * parent, their kind and their name. This keeps registering and looking up
+ * options independent of the number of siblings.
+ */
+static lc_opt_entry_t **entry_index;
+static size_t           entry_index_size;  /**< a power of 2 */
+static size_t           entry_index_count;
+
+static unsigned index_hash(const lc_opt_entry_t *parent, bool is_grp,
+                           unsigned name_hash)
+{
+	return hash_combine(hash_ptr(parent), name_hash) ^ is_grp;
+}
+
+static lc_opt_entry_t *index_find(const lc_opt_entry_t *parent, bool is_grp,
+                                  const char *name, size_t len)
+{
+	if (entry_index_count == 0)
+		return NULL;
+	unsigned const name_hash = hash_data((const unsigned char*)name, len);
+	size_t   const mask      = entry_index_size - 1;
+	for (size_t i = index_hash(parent, is_grp, name_hash) & mask;;
+	     i = (i + 1) & mask) {
+		lc_opt_entry_t *ent = entry_index[i];
+		if (ent == NULL)
+			return NULL;
+		if (ent->parent == parent && ent->is_grp == is_grp
+		    && ent->hash == name_hash && strncmp(ent->name, name, len) == 0
+		    && ent->name[len] == '\0')
+			return ent;
+	}
+}
+
+static void index_insert_entry(lc_opt_entry_t *ent)
+{
+	size_t const mask = entry_index_size - 1;
+	size_t       i    = index_hash(ent->parent, ent->is_grp, ent->hash) & mask;
+	while (entry_index[i] != NULL)
+		i = (i + 1) & mask;
+	entry_index[i] = ent;
+}
+
+static void index_insert(lc_opt_entry_t *ent)
+{
+	if (2 * (entry_index_count + 1) > entry_index_size) {
+		lc_opt_entry_t **old_index = entry_index;
+		size_t           old_size  = entry_index_size;
+		entry_index_size = old_size > 0 ? 2 * old_size : 256;
+		entry_index      = XMALLOCNZ(lc_opt_entry_t*, entry_index_size);
+		for (size_t i = 0; i < old_size; ++i) {
+			if (old_index[i] != NULL)
+				index_insert_entry(old_index[i]);
+		}
+		free(old_index);
+	}
+	index_insert_entry(ent);
+	++entry_index_count;
+}
+
 static void set_name(lc_opt_entry_t *ent, const char *name)
 {
 	ent->name = name;
@@ -57,8 +117,10 @@ static lc_opt_entry_t *init_grp(lc_opt_entry_t *ent)
 	INIT_LIST_HEAD(&ent->v.grp.grps);
 	INIT_LIST_HEAD(&ent->v.grp.opts);
 
-	if (ent->parent && ent->parent->is_grp)
+	if (ent->parent && ent->parent->is_grp) {
 		list_add_tail(&ent->list, &lc_get_grp_special(ent->parent)->grps);
+		index_insert(ent);
+	}
 
 	return ent;
 }
@@ -74,6 +136,7 @@ static lc_opt_entry_t *init_opt(lc_opt_entry_t *ent,
 
 	ent->is_grp = 0;
 	list_add_tail(&ent->list, &lc_get_grp_special(ent->parent)->opts);
+	index_insert(ent);
 
 	s->type      = type;
 	s->value     = val;
@@ -158,25 +221,14 @@ lc_opt_entry_t *lc_opt_add_opt(lc_opt_entry_t *parent,
 }
 
 
-static lc_opt_entry_t *lc_opt_find_ent(const struct list_head *head,
-                                       const char *name)
-{
-	unsigned hash = hash_str(name);
-	list_for_each_entry(lc_opt_entry_t, ent, head, list) {
-		if (entry_matches(ent, hash, name))
-			return ent;
-	}
-	return NULL;
-}
-
 lc_opt_entry_t *lc_opt_find_grp(const lc_opt_entry_t *grp, const char *name)
 {
-	return grp ? lc_opt_find_ent(&lc_get_grp_special(grp)->grps, name) : NULL;
+	return grp ? index_find(grp, true, name, strlen(name)) : NULL;
 }
 
 lc_opt_entry_t *lc_opt_find_opt(const lc_opt_entry_t *grp, const char *name)
 {
-	return grp ? lc_opt_find_ent(&lc_get_grp_special(grp)->opts, name) : NULL;
+	return grp ? index_find(grp, false, name, strlen(name)) : NULL;
 }
 
 static const lc_opt_entry_t *resolve_up_to_last(const lc_opt_entry_t *root,
@@ -575,42 +627,22 @@ int lc_opt_from_single_arg(const lc_opt_entry_t *root, const char *arg)
 {
 	const lc_opt_entry_t *grp = root;
 
-	/* find the next delimiter (the -) and extract the string up to
-	 * there. */
-	const char *end    = strchr(arg, OPT_DELIM);
-	const char *eqsign = strchr(arg, '=');
-	if (eqsign && eqsign < end)
-		end = NULL;
-	while (end != NULL) {
-		/* Copy the part of the option into the buffer and add the
-		 * finalizing zero. */
-		char *buf = (char*)obstack_copy0(&obst, arg, end - arg);
-
-		/* Resolve the group inside the group */
-		lc_opt_entry_t *new_grp = lc_opt_find_grp(grp, buf);
+	/* resolve the groups: --grp1-grp2-...-grpn-opt=value, a - after the =
+	 * belongs to the value */
+	const char *const name_end = arg + strcspn(arg, "=");
+	for (const char *end; (end = memchr(arg, OPT_DELIM, name_end - arg)) != NULL;) {
+		lc_opt_entry_t *new_grp = index_find(grp, true, arg, end - arg);
 		if (new_grp == NULL)
 			break;
 		grp = new_grp;
-
-		/* Find the next option part delimiter. */
-		arg    = end + 1;
-		end    = strchr(arg, OPT_DELIM);
-		eqsign = strchr(arg, '=');
-		if (eqsign && eqsign < end)
-			end = NULL;
-		obstack_free(&obst, buf);
+		arg = end + 1;
 	}
 
 	/*
-	 * Now, we are at the last option part:
-	 * --grp1-grp2-...-grpn-opt=value
-	 * Check, for the = and evaluate the option string. If the = is
-	 * missing, we should have a boolean option, but that is checked
-	 * later.
+	 * Now, we are at the last option part. If the = is missing, we should
+	 * have a boolean option, but that is checked later.
 	 */
-	end = strchr(arg, '=');
-	char *buf = (char*)obstack_copy0(&obst, arg, end ? end - arg : (int) strlen(arg));
-	lc_opt_entry_t *opt = lc_opt_find_opt(grp, buf);
+	lc_opt_entry_t *opt = index_find(grp, false, arg, name_end - arg);
 	if (opt == NULL)
 		return 0;
 
@@ -618,7 +650,7 @@ int lc_opt_from_single_arg(const lc_opt_entry_t *root, const char *arg)
 	 * Now evaluate the parameter of the option (the part after
 	 * the =) if it was given.
 	 */
-	arg = end ? end + 1 : "true";
+	arg = *name_end == '=' ? name_end + 1 : "true";
 
 	/* Set the value of the option. */
 	return lc_opt_occurs(opt, arg);
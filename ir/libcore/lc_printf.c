@@ -22,6 +22,10 @@
 #include "hashptr.h"
 #include "util.h"
 #include "set.h"
+#include "obstack.h"
+
+/** The maximum number of compiled format strings kept per environment. */
+#define MAX_COMPILED_FORMATS 1024
 
 /* printf implementation */
 
@@ -33,8 +37,41 @@ typedef struct lc_arg_t {
 	const lc_arg_handler_t *handler;
 } lc_arg_t;
 
+/** Conversions emitted without calling the handler of their argument. */
+typedef enum lc_fast_conv_t {
+	LC_FAST_NONE,   /**< call the handler */
+	LC_FAST_INT,    /**< %d, %i */
+	LC_FAST_UINT,   /**< %u */
+	LC_FAST_LONG,   /**< %ld, %li */
+	LC_FAST_ULONG,  /**< %lu */
+	LC_FAST_SIZE,   /**< %zu */
+	LC_FAST_STRING, /**< %s */
+} lc_fast_conv_t;
+
+/** A conversion of a compiled format string and the text following it. */
+typedef struct lc_fmt_conv_t {
+	lc_arg_occ_t    occ;      /**< the parsed conversion specification */
+	const lc_arg_t *arg;      /**< the argument, NULL if none is consumed */
+	lc_fast_conv_t  fast;     /**< how to emit the argument */
+	const char     *text;     /**< the text following the conversion */
+	size_t          text_len; /**< the length of text */
+} lc_fmt_conv_t;
+
+/**
+ * A format string parsed once. All pointers point into the copy of the
+ * format string stored behind the conversions.
+ */
+typedef struct lc_fmt_t {
+	const char    *fmt;       /**< the format string */
+	size_t         text_len;  /**< the length of the text before the first
+	                               conversion */
+	size_t         n_convs;   /**< the number of conversions */
+	lc_fmt_conv_t  convs[];   /**< the conversions */
+} lc_fmt_t;
+
 struct lc_arg_env_t {
 	set      *args;             /**< Map for named arguments. */
+	set      *formats;          /**< Map for compiled format strings. */
 	lc_arg_t *lower[26];        /**< Map for lower conversion specifiers. */
 	lc_arg_t *upper[26];        /**< Map for upper conversion specifiers. */
 };
@@ -64,15 +101,38 @@ static int lc_arg_cmp(const void *p1, const void *p2, size_t size)
 }
 
 
+static int lc_fmt_cmp(const void *p1, const void *p2, size_t size)
+{
+	const lc_fmt_t *f1 = *(const lc_fmt_t**)p1;
+	const lc_fmt_t *f2 = *(const lc_fmt_t**)p2;
+	(void) size;
+	return strcmp(f1->fmt, f2->fmt);
+}
+
 lc_arg_env_t *lc_arg_new_env(void)
 {
 	lc_arg_env_t *env = XMALLOCZ(lc_arg_env_t);
-	env->args = new_set(lc_arg_cmp, 16);
+	env->args    = new_set(lc_arg_cmp, 16);
+	env->formats = new_set(lc_fmt_cmp, 64);
 	return env;
 }
 
+/** Forgets all compiled format strings of an environment. */
+static void clear_formats(lc_arg_env_t *env)
+{
+	if (set_count(env->formats) == 0)
+		return;
+	foreach_set(env->formats, lc_fmt_t*, entry) {
+		free(*entry);
+	}
+	del_set(env->formats);
+	env->formats = new_set(lc_fmt_cmp, 64);
+}
+
 void lc_arg_free_env(lc_arg_env_t *env)
 {
+	clear_formats(env);
+	del_set(env->formats);
 	del_set(env->args);
 	free(env);
 }
@@ -97,6 +157,9 @@ int lc_arg_register(lc_arg_env_t *env, const char *name, char letter,
 
 	lc_arg_t *ent = set_insert(lc_arg_t, env->args, &arg, sizeof(arg), hash_str(name));
 
+	/* compiled format strings refer to the old arguments */
+	clear_formats(env);
+
 	if (ent && base != 0)
 		map[letter - base] = ent;
 
@@ -275,11 +338,13 @@ static int std_emit(lc_appendable_t *app, const lc_arg_occ_t *occ, const lc_arg_
 		}
 
 		default: {
-			int len = MAX(128, occ->width + 1);
-			char *buf = XMALLOCN(char, len);
+			char  small[128];
+			int   len = MAX((int)sizeof(small), occ->width + 1);
+			char *buf = len <= (int)sizeof(small) ? small : XMALLOCN(char, len);
 			res = dispatch_snprintf(buf, len, fmt, occ->lc_arg_type, val);
-			res = lc_appendable_snadd(app, buf, res);
-			free(buf);
+			res = lc_appendable_snadd(app, buf, MIN(res, len - 1));
+			if (buf != small)
+				free(buf);
 		}
 	}
 
@@ -323,167 +388,335 @@ static char *read_int(const char *s, int *value)
 	return endptr;
 }
 
-/* Generic printf() function. */
+/* Format string compilation */
 
-int lc_evpprintf(const lc_arg_env_t *env, lc_appendable_t *app, const char *fmt,
-                 va_list args)
+/**
+ * Determines whether the conversion occ of arg can be emitted without calling
+ * its handler.
+ */
+static lc_fast_conv_t get_fast_conv(const lc_arg_t *arg,
+                                    const lc_arg_occ_t *occ)
 {
-	int         res  = 0;
-	const char *last = fmt + strlen(fmt);
-
-	/* Find the first % */
-	const char *s = strchr(fmt, '%');
+	if (arg->handler != &std_handler || occ->width > 0 || occ->precision >= 0
+	    || occ->flag_hash || occ->flag_zero || occ->flag_minus
+	    || occ->flag_plus || occ->flag_space)
+		return LC_FAST_NONE;
 
-	/* Emit the text before the first % was found */
-	lc_appendable_snadd(app, fmt, (s ? s : last) - fmt);
+	const char *mod    = occ->modifier;
+	size_t      modlen = occ->modifier_length;
+	switch (occ->conversion) {
+	case 'd':
+	case 'i':
+		if (modlen == 0)
+			return LC_FAST_INT;
+		if (modlen == 1 && mod[0] == 'l')
+			return LC_FAST_LONG;
+		break;
+	case 'u':
+		if (modlen == 0)
+			return LC_FAST_UINT;
+		if (modlen == 1 && mod[0] == 'l')
+			return LC_FAST_ULONG;
+		if (modlen == 1 && mod[0] == 'z')
+			return LC_FAST_SIZE;
+		break;
+	case 's':
+		if (modlen == 0)
+			return LC_FAST_STRING;
+		break;
+	}
+	return LC_FAST_NONE;
+}
 
-	while (s != NULL) {
-		lc_arg_value_t val;
-
-		/* We must be at a '%' */
-		assert(*s == '%');
-
-		/* Reset the occurrence structure */
-		lc_arg_occ_t occ;
-		memset(&occ, 0, sizeof(occ));
-
-		/* Eat all flags and set the corresponding flags in the occ struct */
-		for (++s; strchr("#0-+", *s); ++s) {
-			switch (*s) {
-				case '#':
-					occ.flag_hash = 1;
-					break;
-				case '0':
-					occ.flag_zero = 1;
-					break;
-				case '-':
-					occ.flag_minus = 1;
-					break;
-				case '+':
-					occ.flag_plus = 1;
-					break;
-				case ' ':
-					occ.flag_space = 1;
-					break;
-			}
+/**
+ * Parses the conversion specification starting after the '%' at s.
+ *
+ * @return the position after the specification
+ */
+static const char *parse_conv(const lc_arg_env_t *env, const char *s,
+                              lc_fmt_conv_t *conv)
+{
+	lc_arg_occ_t *occ = &conv->occ;
+	memset(occ, 0, sizeof(*occ));
+	conv->arg  = NULL;
+	conv->fast = LC_FAST_NONE;
+
+	/* Eat all flags and set the corresponding flags in the occ struct */
+	for (; *s != '\0' && strchr("#0-+", *s); ++s) {
+		switch (*s) {
+			case '#':
+				occ->flag_hash = 1;
+				break;
+			case '0':
+				occ->flag_zero = 1;
+				break;
+			case '-':
+				occ->flag_minus = 1;
+				break;
+			case '+':
+				occ->flag_plus = 1;
+				break;
 		}
+	}
 
-		/* Read the width if given */
-		s = read_int(s, &occ.width);
+	/* Read the width if given */
+	s = read_int(s, &occ->width);
 
-		occ.precision = -1;
+	occ->precision = -1;
 
-		/* read the precision if given */
-		if (*s == '.') {
-			int precision;
-			s = read_int(s + 1, &precision);
+	/* read the precision if given */
+	if (*s == '.') {
+		int precision;
+		s = read_int(s + 1, &precision);
 
-			/* Negative or lacking precision after a '.' is treated as
-			 * precision 0. */
-			occ.precision = MAX(0, precision);
-		}
+		/* Negative or lacking precision after a '.' is treated as
+		 * precision 0. */
+		occ->precision = MAX(0, precision);
+	}
 
-		/*
-		 * Now, we can either have:
-		 * - a named argument like {node}
-		 * - some modifiers followed by a conversion specifier
-		 * - or some other character, which ends this format invalidly
-		 */
-		char            ch  = *s;
-		const lc_arg_t *arg = NULL;
-		switch (ch) {
-			case '%':
-				s++;
-				res += lc_appendable_chadd(app, '%');
-				break;
-			case '{': {
-				const char *named = ++s;
+	/*
+	 * Now, we can either have:
+	 * - a named argument like {node}
+	 * - some modifiers followed by a conversion specifier
+	 * - or some other character, which ends this format invalidly
+	 */
+	char            ch  = *s;
+	const lc_arg_t *arg = NULL;
+	switch (ch) {
+		case '%':
+			/* the '%' is emitted as part of the following text */
+			occ->conversion = '%';
+			return s;
+		case '{': {
+			const char *named = ++s;
+
+			/* Read until the closing brace or end of the string. */
+			for (ch = *s; ch != '}' && ch != '\0'; ch = *++s) {
+			}
 
-				/* Read until the closing brace or end of the string. */
-				for (ch = *s; ch != '}' && ch != '\0'; ch = *++s) {
-				}
+			if (s - named) {
+				size_t   n    = s - named;
+				char    *name = XMALLOCN(char, n + 1);
+				lc_arg_t tmp;
 
-				if (s - named) {
-					size_t n = s - named;
-					char *name;
-					lc_arg_t tmp;
+				memcpy(name, named, n);
+				name[n]  = '\0';
+				tmp.name = name;
 
-					name = (char*) malloc(sizeof(char) * (n + 1));
-					memcpy(name, named, sizeof(char) * n);
-					name[n] = '\0';
-					tmp.name = name;
+				arg = set_find(lc_arg_t, env->args, &tmp, sizeof(tmp), hash_str(name));
+				occ->modifier = "";
+				occ->modifier_length = 0;
 
-					arg = set_find(lc_arg_t, env->args, &tmp, sizeof(tmp), hash_str(named));
-					occ.modifier = "";
-					occ.modifier_length = 0;
+				/* Set the conversion specifier of the occurrence to the
+				 * letter specified in the argument description. */
+				if (arg)
+					occ->conversion = arg->letter;
 
-					/* Set the conversion specifier of the occurrence to the
-					 * letter specified in the argument description. */
-					if (arg)
-						occ.conversion = arg->letter;
+				free(name);
 
-					free(name);
+				/* If we ended with a closing brace, move the current
+				 * pointer after it, since it is not to be dumped. */
+				if (ch == '}')
+					s++;
+			}
+			break;
+		}
 
-					/* If we ended with a closing brace, move the current
-					 * pointer after it, since it is not to be dumped. */
-					if (ch == '}')
-						s++;
+		default: {
+			const char *mod = s;
+
+			/* Read, as long there are letters */
+			while (isalpha((unsigned char)ch) && !arg) {
+				int              base = 'a';
+				lc_arg_t *const *map  = env->lower;
+
+				/* If uppercase, select the uppercase map from the
+				 * environment */
+				if (isupper((unsigned char)ch)) {
+					base = 'A';
+					map = env->upper;
 				}
-				break;
-			}
 
-			default: {
-				const char *mod = s;
-
-				/* Read, as long there are letters */
-				while (isalpha((unsigned char)ch) && !arg) {
-					int              base = 'a';
-					lc_arg_t *const *map  = env->lower;
-
-					/* If uppercase, select the uppercase map from the
-					 * environment */
-					if (isupper((unsigned char)ch)) {
-						base = 'A';
-						map = env->upper;
-					}
-
-					if (map[ch - base] != NULL) {
-						occ.modifier = mod;
-						occ.modifier_length = s - mod;
-						occ.conversion = ch;
-						arg = map[ch - base];
-					}
-
-					ch = *++s;
+				if (map[ch - base] != NULL) {
+					occ->modifier = mod;
+					occ->modifier_length = s - mod;
+					occ->conversion = ch;
+					arg = map[ch - base];
 				}
+
+				ch = *++s;
 			}
 		}
+	}
 
-		/* Call the handler if an argument was determined */
-		if (arg != NULL && arg->handler != NULL) {
-			const lc_arg_handler_t *handler = arg->handler;
+	if (arg != NULL && arg->handler != NULL) {
+		/* Let the handler determine the type of the argument based on the
+		 * information gathered. */
+		occ->lc_arg_type = arg->handler->get_lc_arg_type(occ);
+		conv->arg        = arg;
+		conv->fast       = get_fast_conv(arg, occ);
+	}
+	return s;
+}
 
-			/* Let the handler determine the type of the argument based on the
-			 * information gathered. */
-			occ.lc_arg_type = handler->get_lc_arg_type(&occ);
+/**
+ * Parses a format string. The result refers to a copy of the format string
+ * and must be freed with free().
+ */
+static lc_fmt_t *compile_format(const lc_arg_env_t *env, const char *fmt)
+{
+	size_t n_convs = 0;
+	for (const char *s = strchr(fmt, '%'); s != NULL; s = strchr(s + 2, '%')) {
+		++n_convs;
+		if (s[1] == '\0')
+			break;
+	}
+
+	size_t    len  = strlen(fmt);
+	size_t    size = sizeof(lc_fmt_t) + n_convs * sizeof(lc_fmt_conv_t);
+	lc_fmt_t *res  = (lc_fmt_t*)xmalloc(size + len + 1);
+	char     *copy = (char*)res + size;
+	memcpy(copy, fmt, len + 1);
+
+	const char *last = copy + len;
+	const char *s    = strchr(copy, '%');
+	res->fmt      = copy;
+	res->text_len = (s ? s : last) - copy;
+
+	size_t n = 0;
+	while (s != NULL) {
+		lc_fmt_conv_t *conv = &res->convs[n++];
+		assert(n <= n_convs);
+		s = parse_conv(env, s + 1, conv);
+
+		/* the text of "%%" starts with its second '%' */
+		const char *text = s;
+		if (conv->arg == NULL && conv->occ.conversion == '%')
+			++s;
+		s = strchr(s, '%');
+		conv->text     = text;
+		conv->text_len = (s ? s : last) - text;
+	}
+	res->n_convs = n;
+	return res;
+}
+
+/**
+ * Returns the compiled form of a format string, compiling it if it is not
+ * known yet. The result must be freed with free() if *temporary is set.
+ */
+static const lc_fmt_t *get_format(const lc_arg_env_t *env, const char *fmt,
+                                  bool *temporary)
+{
+	lc_fmt_t        key_fmt;
+	lc_fmt_t *const key  = &key_fmt;
+	unsigned  const hash = hash_str(fmt);
+	key_fmt.fmt = fmt;
+
+	lc_fmt_t **found = set_find(lc_fmt_t*, env->formats, &key, sizeof(key), hash);
+	*temporary = false;
+	if (found != NULL)
+		return *found;
+
+	lc_fmt_t *res = compile_format(env, fmt);
+	if (set_count(env->formats) < MAX_COMPILED_FORMATS)
+		(void)set_insert(lc_fmt_t*, env->formats, &res, sizeof(res), hash);
+	else
+		*temporary = true;
+	return res;
+}
+
+/** Appends a string, writing to obstacks directly. */
+static inline int append(lc_appendable_t *app, const char *str, size_t len)
+{
+	if (app->app == lc_appendable_obstack) {
+		obstack_grow((struct obstack*)app->obj, str, len);
+		app->written += len;
+		return (int)len;
+	}
+	return lc_appendable_snadd(app, str, len);
+}
+
+/** Appends a decimal number. */
+static int append_number(lc_appendable_t *app, unsigned long long value,
+                         bool negative)
+{
+	char  buf[sizeof(value) * 3 + 1];
+	char *end = buf + sizeof(buf);
+	char *p   = end;
+	do {
+		*--p   = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	if (negative)
+		*--p = '-';
+	return append(app, p, end - p);
+}
 
-			/* Store the value according to argument information */
-			switch (occ.lc_arg_type) {
+static int append_signed(lc_appendable_t *app, long long value)
+{
+	if (value < 0)
+		return append_number(app, 0ULL - (unsigned long long)value, true);
+	return append_number(app, (unsigned long long)value, false);
+}
+
+/* Generic printf() function. */
+
+int lc_evpprintf(const lc_arg_env_t *env, lc_appendable_t *app, const char *fmt,
+                 va_list args)
+{
+	bool            temporary;
+	const lc_fmt_t *compiled = get_format(env, fmt, &temporary);
+	int             res      = append(app, compiled->fmt, compiled->text_len);
+
+	for (size_t i = 0, n = compiled->n_convs; i < n; ++i) {
+		const lc_fmt_conv_t *conv = &compiled->convs[i];
+		const lc_arg_occ_t  *occ  = &conv->occ;
+
+		switch (conv->fast) {
+		case LC_FAST_INT:
+			res += append_signed(app, va_arg(args, int));
+			break;
+		case LC_FAST_UINT:
+			res += append_number(app, va_arg(args, unsigned), false);
+			break;
+		case LC_FAST_LONG:
+			res += append_signed(app, va_arg(args, long));
+			break;
+		case LC_FAST_ULONG:
+			res += append_number(app, va_arg(args, unsigned long), false);
+			break;
+		case LC_FAST_SIZE:
+			res += append_number(app, va_arg(args, size_t), false);
+			break;
+		case LC_FAST_STRING: {
+			const char *str = va_arg(args, const char*);
+			res += append(app, str, strlen(str));
+			break;
+		}
+		case LC_FAST_NONE:
+			if (conv->arg != NULL) {
+				lc_arg_value_t val;
+
+				/* Store the value according to argument information */
+				switch (occ->lc_arg_type) {
 #define LC_ARG_TYPE(type,name,va_type) \
-			case lc_arg_type_ ## name: val.v_ ## name = va_arg(args, va_type); break;
+				case lc_arg_type_ ## name: val.v_ ## name = va_arg(args, va_type); break;
 #include "lc_printf_arg_types.def"
 #undef LC_ARG_TYPE
-			}
+				}
 
-			/* Finally, call the handler. */
-			res += handler->emit(app, &occ, &val);
+				/* Finally, call the handler. */
+				res += conv->arg->handler->emit(app, occ, &val);
+			}
+			break;
 		}
 
-		const char *old = s;
-		s = strchr(s, '%');
-		res += lc_appendable_snadd(app, old, (s ? s : last) - old);
+		res += append(app, conv->text, conv->text_len);
 	}
 
+	if (temporary)
+		free((lc_fmt_t*)compiled);
 	return res;
 }
 
@@ -19,6 +19,7 @@
 #include "ircons.h"
 #include "irgmod.h"
 #include "irgwalk.h"
+#include "iredges_t.h"
 #include "irmemory.h"
 #include "irtools.h"
 #include "iroptimize.h"
@@ -27,8 +28,9 @@
 #include "error.h"
 #include "util.h"
 
-static pmap *pointer_types;
-static pmap *lowered_mtps;
+static pmap                 *pointer_types;
+static pmap                 *lowered_mtps;
+static lower_aggregate_func  lower_aggregate;
 
 static bool needs_lowering(const ir_type *type)
 {
@@ -49,7 +51,239 @@ static ir_type *get_pointer_type(ir_type *dest_type)
 	return res;
 }
 
-static void fix_parameter_entities(ir_graph *irg, size_t n_compound_ret)
+/**
+ * Returns how a compound parameter or result type is transmitted.
+ */
+static aggregate_spec_t get_aggregate_spec(ir_type *type, bool is_result)
+{
+	aggregate_spec_t spec = { 0 };
+	if (lower_aggregate != NULL && is_compound_type(type))
+		spec = lower_aggregate(type, is_result);
+	assert(spec.length <= MAX_REGISTER_AGGREGATE_VALUES);
+	return spec;
+}
+
+/**
+ * Tests whether a parameter or result type is a compound transmitted in
+ * memory.
+ */
+static bool is_memory_compound(ir_type *type, bool is_result)
+{
+	return needs_lowering(type)
+	    && get_aggregate_spec(type, is_result).length == 0;
+}
+
+/**
+ * Tests whether a parameter or result type is a compound transmitted in
+ * registers.
+ */
+static bool is_register_compound(compound_call_lowering_flags flags,
+                                 ir_type *type, bool is_result)
+{
+	if (!is_result && (flags & LF_DONT_LOWER_ARGUMENTS))
+		return false;
+	return needs_lowering(type)
+	    && get_aggregate_spec(type, is_result).length > 0;
+}
+
+/**
+ * Computes the number of every parameter of the method type mtp in its
+ * lowered type.
+ */
+static void compute_param_map(compound_call_lowering_flags flags,
+                              ir_type *mtp, size_t *param_map)
+{
+	size_t pos = 0;
+	for (size_t i = 0, n = get_method_n_ress(mtp); i < n; ++i) {
+		if (is_memory_compound(get_method_res_type(mtp, i), true))
+			++pos;
+	}
+	for (size_t i = 0, n = get_method_n_params(mtp); i < n; ++i) {
+		ir_type *type = get_method_param_type(mtp, i);
+		param_map[i] = pos;
+		if (is_register_compound(flags, type, false))
+			pos += get_aggregate_spec(type, false).length;
+		else
+			++pos;
+	}
+}
+
+/**
+ * Computes the number of every result of the method type mtp in its lowered
+ * type.
+ */
+static void compute_result_map(compound_call_lowering_flags flags,
+                               ir_type *mtp, size_t *result_map)
+{
+	size_t pos = 0;
+	for (size_t i = 0, n = get_method_n_ress(mtp); i < n; ++i) {
+		ir_type *type = get_method_res_type(mtp, i);
+		result_map[i] = pos;
+		if (is_register_compound(flags, type, true))
+			pos += get_aggregate_spec(type, true).length;
+		else if (!needs_lowering(type) || (flags & LF_RETURN_HIDDEN))
+			++pos;
+	}
+}
+
+static ir_mode *get_unsigned_mode_for_size(unsigned size)
+{
+	switch (size) {
+	case 1: return mode_Bu;
+	case 2: return mode_Hu;
+	case 4: return mode_Iu;
+	case 8: return mode_Lu;
+	}
+	panic("no unsigned mode with %u bytes", size);
+}
+
+/**
+ * Returns the size of the next memory access for a register part, which
+ * respects the alignment of the aggregate and does not exceed the part.
+ */
+static unsigned get_piece_size(ir_mode *mode, unsigned remaining,
+                               unsigned align)
+{
+	if (!mode_is_int(mode)) {
+		assert(get_mode_size_bytes(mode) == remaining);
+		return remaining;
+	}
+	unsigned piece = MIN(get_mode_size_bytes(mode), align);
+	while (piece > remaining)
+		piece /= 2;
+	return piece;
+}
+
+/**
+ * Loads the register part of an aggregate at offset. Parts that cannot be
+ * loaded at once are assembled from smaller loads in little endian order.
+ *
+ * @param mem  the memory, updated to the memory after the loads
+ */
+static ir_node *load_part(dbg_info *dbgi, ir_node *block, ir_node **mem,
+                          ir_node *ptr, unsigned offset, unsigned size,
+                          unsigned align, ir_mode *mode)
+{
+	ir_graph *irg       = get_irn_irg(block);
+	ir_mode  *addr_mode = get_irn_mode(ptr);
+	ir_node  *res       = NULL;
+	for (unsigned done = 0; done < size; ) {
+		unsigned  piece      = get_piece_size(mode, size - done, align);
+		ir_mode  *piece_mode = piece == get_mode_size_bytes(mode)
+			? mode : get_unsigned_mode_for_size(piece);
+		ir_node  *cnst = new_r_Const_long(irg, mode_Iu, offset + done);
+		ir_node  *addr = new_rd_Add(dbgi, block, ptr, cnst, addr_mode);
+		ir_node  *load = new_rd_Load(dbgi, block, *mem, addr, piece_mode,
+		                             cons_none);
+		ir_node  *val  = new_r_Proj(load, piece_mode, pn_Load_res);
+		*mem = new_r_Proj(load, mode_M, pn_Load_M);
+
+		if (piece_mode != mode) {
+			assert(mode_is_int(mode));
+			val = new_rd_Conv(dbgi, block, val, mode);
+			if (done > 0) {
+				ir_node *amount = new_r_Const_long(irg, mode_Iu, done * 8);
+				val = new_rd_Shl(dbgi, block, val, amount, mode);
+			}
+			if (res != NULL)
+				val = new_rd_Or(dbgi, block, res, val, mode);
+		}
+		res   = val;
+		done += piece;
+	}
+	return res;
+}
+
+/**
+ * Stores the register part value of an aggregate at offset, the counterpart
+ * of load_part().
+ *
+ * @return the memory after the stores
+ */
+static ir_node *store_part(dbg_info *dbgi, ir_node *block, ir_node *mem,
+                           ir_node *ptr, unsigned offset, unsigned size,
+                           unsigned align, ir_node *value)
+{
+	ir_graph *irg       = get_irn_irg(block);
+	ir_mode  *addr_mode = get_irn_mode(ptr);
+	ir_mode  *mode      = get_irn_mode(value);
+	for (unsigned done = 0; done < size; ) {
+		unsigned  piece = get_piece_size(mode, size - done, align);
+		ir_node  *val   = value;
+		if (piece != get_mode_size_bytes(mode)) {
+			assert(mode_is_int(mode));
+			if (done > 0) {
+				ir_node *amount = new_r_Const_long(irg, mode_Iu, done * 8);
+				val = new_rd_Shr(dbgi, block, val, amount, mode);
+			}
+			val = new_rd_Conv(dbgi, block, val,
+			                  get_unsigned_mode_for_size(piece));
+		}
+		ir_node *cnst  = new_r_Const_long(irg, mode_Iu, offset + done);
+		ir_node *addr  = new_rd_Add(dbgi, block, ptr, cnst, addr_mode);
+		ir_node *store = new_rd_Store(dbgi, block, mem, addr, val, cons_none);
+		mem   = new_r_Proj(store, mode_M, pn_Store_M);
+		done += piece;
+	}
+	return mem;
+}
+
+/**
+ * Loads all register parts of the aggregate at ptr.
+ *
+ * @param mem  the memory, updated to the memory after the loads
+ */
+static void load_aggregate(dbg_info *dbgi, ir_node *block, ir_node **mem,
+                           ir_node *ptr, ir_type *type,
+                           const aggregate_spec_t *spec, ir_node **values)
+{
+	unsigned size   = get_type_size_bytes(type);
+	unsigned align  = get_type_alignment_bytes(type);
+	unsigned offset = 0;
+	for (unsigned i = 0; i < spec->length; ++i) {
+		ir_mode  *mode = spec->modes[i];
+		unsigned  part = MIN(get_mode_size_bytes(mode), size - offset);
+		values[i] = load_part(dbgi, block, mem, ptr, offset, part, align, mode);
+		offset   += part;
+	}
+}
+
+/**
+ * Stores all register parts of an aggregate to ptr.
+ *
+ * @return the memory after the stores
+ */
+static ir_node *store_aggregate(dbg_info *dbgi, ir_node *block, ir_node *mem,
+                                ir_node *ptr, ir_type *type,
+                                const aggregate_spec_t *spec,
+                                ir_node *const *values)
+{
+	unsigned size   = get_type_size_bytes(type);
+	unsigned align  = get_type_alignment_bytes(type);
+	unsigned offset = 0;
+	for (unsigned i = 0; i < spec->length; ++i) {
+		unsigned part = MIN(get_mode_size_bytes(spec->modes[i]), size - offset);
+		mem     = store_part(dbgi, block, mem, ptr, offset, part, align,
+		                     values[i]);
+		offset += part;
+	}
+	return mem;
+}
+
+/**
+ * Reroutes all users of the memory mem to last, which ends a chain of Stores
+ * starting at mem.
+ */
+static void reroute_memory(ir_node *mem, ir_node *last)
+{
+	ir_node *store = NULL;
+	for (ir_node *m = last; m != mem; m = get_Store_mem(store))
+		store = get_Proj_pred(m);
+	if (store != NULL)
+		edges_reroute_except(mem, last, store);
+}
+
+static void fix_parameter_entities(ir_graph *irg, const size_t *param_map)
 {
 	ir_type *frame_type = get_irg_frame_type(irg);
 	size_t   n_members  = get_compound_n_members(frame_type);
@@ -61,11 +295,12 @@ static void fix_parameter_entities(ir_graph *irg, size_t n_compound_ret)
 		if (!is_parameter_entity(member))
 			continue;
 
-		/* increase parameter number since we added a new parameter in front */
+		/* hidden parameters were added in front and register compounds
+		 * were split into several parameters */
 		num = get_entity_parameter_number(member);
 		if (num == IR_VA_START_PARAMETER_NUMBER)
 			continue;
-		set_entity_parameter_number(member, num + n_compound_ret);
+		set_entity_parameter_number(member, param_map[num]);
 	}
 }
 
@@ -102,6 +337,7 @@ static ir_type *lower_mtp(compound_call_lowering_flags flags, ir_type *mtp)
 	size_t    n_params;
 	size_t    nn_ress;
 	size_t    nn_params;
+	size_t    n_hidden;
 	size_t    i;
 	unsigned  cconv;
 	mtp_additional_properties mtp_properties;
@@ -135,8 +371,9 @@ static ir_type *lower_mtp(compound_call_lowering_flags flags, ir_type *mtp)
 	if (!must_be_lowered)
 		return mtp;
 
-	results   = ALLOCANZ(ir_type*, n_ress);
-	params    = ALLOCANZ(ir_type*, n_params + n_ress);
+	results   = ALLOCANZ(ir_type*, n_ress * MAX_REGISTER_AGGREGATE_VALUES);
+	params    = ALLOCANZ(ir_type*,
+	                     n_params * MAX_REGISTER_AGGREGATE_VALUES + n_ress);
 	nn_ress   = 0;
 	nn_params = 0;
 
@@ -144,7 +381,12 @@ static ir_type *lower_mtp(compound_call_lowering_flags flags, ir_type *mtp)
 	for (i = 0; i < n_ress; ++i) {
 		ir_type *res_tp = get_method_res_type(mtp, i);
 
-		if (needs_lowering(res_tp)) {
+		if (is_register_compound(flags, res_tp, true)) {
+			/* the compound is returned in registers */
+			aggregate_spec_t spec = get_aggregate_spec(res_tp, true);
+			for (unsigned p = 0; p < spec.length; ++p)
+				results[nn_ress++] = get_type_for_mode(spec.modes[p]);
+		} else if (needs_lowering(res_tp)) {
 			/* this compound will be allocated on callers stack and its
 			   address will be transmitted as a hidden parameter. */
 			ir_type *ptr_tp = get_pointer_type(res_tp);
@@ -156,17 +398,25 @@ static ir_type *lower_mtp(compound_call_lowering_flags flags, ir_type *mtp)
 			results[nn_ress++] = res_tp;
 		}
 	}
+	n_hidden = nn_params;
 	/* copy over parameter types */
 	for (i = 0; i < n_params; ++i) {
 		ir_type *param_type = get_method_param_type(mtp, i);
+		if (is_register_compound(flags, param_type, false)) {
+			/* the compound is passed in registers */
+			aggregate_spec_t spec = get_aggregate_spec(param_type, false);
+			for (unsigned p = 0; p < spec.length; ++p)
+				params[nn_params++] = get_type_for_mode(spec.modes[p]);
+			continue;
+		}
 		if (! (flags & LF_DONT_LOWER_ARGUMENTS) && needs_lowering(param_type)) {
 		    /* turn parameter into a pointer type */
 		    param_type = new_type_pointer(param_type);
 		}
 		params[nn_params++] = param_type;
 	}
-	assert(nn_ress <= n_ress);
-	assert(nn_params <= n_params + n_ress);
+	assert(nn_ress <= n_ress * MAX_REGISTER_AGGREGATE_VALUES);
+	assert(nn_params <= n_params * MAX_REGISTER_AGGREGATE_VALUES + n_ress);
 
 	/* create the new type */
 	lowered = new_d_type_method(nn_params, nn_ress, get_type_dbg_info(mtp));
@@ -180,14 +430,15 @@ static ir_type *lower_mtp(compound_call_lowering_flags flags, ir_type *mtp)
 	set_method_variadicity(lowered, get_method_variadicity(mtp));
 
 	cconv = get_method_calling_convention(mtp);
-	if (nn_params > n_params) {
+	if (n_hidden > 0) {
 		cconv |= cc_compound_ret;
 	}
 	set_method_calling_convention(lowered, cconv);
 
 	mtp_properties = get_method_additional_properties(mtp);
 	/* after lowering the call is not const anymore, since it writes to the
-	 * memory for the return value passed to it */
+	 * memory for the return value passed to it and reads the compound
+	 * parameters from memory */
 	mtp_properties &= ~mtp_property_const;
 	set_method_additional_properties(lowered, mtp_properties);
 
@@ -214,7 +465,8 @@ struct cl_entry {
  * Walker environment for fix_args_and_collect_calls().
  */
 typedef struct wlk_env_t {
-	size_t               arg_shift;        /**< The Argument index shift for parameters. */
+	const size_t         *param_map;       /**< The new numbers of the parameters if changed. */
+	pmap                 *param_copies;    /**< Maps register compound parameters to their local copies. */
 	struct obstack       obst;             /**< An obstack to allocate the data on. */
 	cl_entry             *cl_list;         /**< The call list. */
 	compound_call_lowering_flags flags;
@@ -333,14 +585,14 @@ static void fix_args_and_collect_calls(ir_node *n, void *ctx)
 		}
 		break;
 	case iro_Proj:
-		if (env->arg_shift > 0) {
+		if (env->param_map != NULL) {
 			ir_node *pred = get_Proj_pred(n);
 			ir_graph *irg = get_irn_irg(n);
 
 			/* Fix the argument numbers */
 			if (pred == get_irg_args(irg)) {
 				long pnr = get_Proj_proj(n);
-				set_Proj_proj(n, pnr + env->arg_shift);
+				set_Proj_proj(n, env->param_map[pnr]);
 				env->changed = true;
 			}
 		}
@@ -392,7 +644,8 @@ static void fix_args_and_collect_calls(ir_node *n, void *ctx)
 				ir_node *call = get_Proj_pred(proj);
 				if (is_Call(call)) {
 					ir_type *ctp = get_Call_type(call);
-					if (needs_lowering(get_method_res_type(ctp, get_Proj_proj(src)))) {
+					ir_type *type = get_method_res_type(ctp, get_Proj_proj(src));
+					if (is_memory_compound(type, true)) {
 						/* found a CopyB from compound Call result */
 						cl_entry *e = get_call_entry(call, env);
 						set_irn_link(n, e->copyb);
@@ -408,9 +661,22 @@ static void fix_args_and_collect_calls(ir_node *n, void *ctx)
 		ir_type   *type   = get_entity_type(entity);
 
 		if (is_parameter_entity(entity) && needs_lowering(type)) {
+			if (is_register_compound(env->flags, type, false)) {
+				/* the registers are stored into a local copy on entry */
+				ir_entity *copy
+					= pmap_get(ir_entity, env->param_copies, entity);
+				if (copy == NULL) {
+					ir_type *frame = get_irg_frame_type(get_irn_irg(n));
+					ident   *id    = id_unique("$register_param.%u");
+					copy = new_entity(frame, id, type);
+					pmap_insert(env->param_copies, entity, copy);
+				}
+				set_Sel_entity(n, copy);
+				break;
+			}
 			if (! (env->flags & LF_DONT_LOWER_ARGUMENTS)) {
 				/* note that num was already modified by fix_parameter_entities
-				 * so no need to add env->arg_shift again */
+				 * so no need to map it again */
 				size_t num = get_entity_parameter_number(entity);
 				ir_graph *irg  = get_irn_irg(n);
 				ir_node  *args = get_irg_args(irg);
@@ -538,7 +804,7 @@ static void add_hidden_param(ir_graph *irg, size_t n_com, ir_node **ins,
 
 		for (j = i = 0; i < get_method_n_ress(ctp); ++i) {
 			ir_type *rtp = get_method_res_type(ctp, i);
-			if (needs_lowering(rtp)) {
+			if (is_memory_compound(rtp, true)) {
 				if (ins[j] == NULL)
 					ins[j] = get_dummy_sel(irg, get_nodes_block(entry->call), rtp);
 				++j;
@@ -560,9 +826,11 @@ static void fix_compound_ret(cl_entry *entry, ir_type *ctp)
 
 	for (i = 0; i < n_res; ++i) {
 		ir_type *type = get_method_res_type(ctp, i);
-		if (needs_lowering(type))
+		if (is_memory_compound(type, true))
 			++n_com;
 	}
+	if (n_com == 0)
+		return;
 
 	new_in = ALLOCANZ(ir_node*, n_params + n_com + (n_Call_max+1));
 	new_in[pos++] = get_Call_mem(call);
@@ -591,7 +859,8 @@ static ir_entity *create_compound_arg_entity(ir_graph *irg, ir_type *type)
 	return entity;
 }
 
-static void fix_compound_params(cl_entry *entry, ir_type *ctp)
+static void fix_compound_params(compound_call_lowering_flags flags,
+                                cl_entry *entry, ir_type *ctp)
 {
 	ir_node  *call     = entry->call;
 	dbg_info *dbgi     = get_irn_dbg_info(call);
@@ -599,26 +868,169 @@ static void fix_compound_params(cl_entry *entry, ir_type *ctp)
 	ir_graph *irg      = get_irn_irg(call);
 	ir_node  *nomem    = new_r_NoMem(irg);
 	ir_node  *frame    = get_irg_frame(irg);
+	ir_node  *block    = get_nodes_block(call);
 	size_t    n_params = get_method_n_params(ctp);
+	size_t    pos      = n_Call_max+1;
+	ir_node **new_in;
 	size_t    i;
 
+	new_in = ALLOCAN(ir_node*,
+	                 n_params * MAX_REGISTER_AGGREGATE_VALUES + (n_Call_max+1));
 	for (i = 0; i < n_params; ++i) {
 		ir_type   *type = get_method_param_type(ctp, i);
-		ir_node   *block;
-		ir_node   *arg;
+		ir_node   *arg  = get_Call_param(call, i);
 		ir_node   *sel;
 		ir_entity *arg_entity;
-		if (!needs_lowering(type))
+		if (is_register_compound(flags, type, false)) {
+			/* load the register parts from the compound */
+			aggregate_spec_t spec = get_aggregate_spec(type, false);
+			load_aggregate(dbgi, block, &mem, arg, type, &spec, &new_in[pos]);
+			pos += spec.length;
 			continue;
+		}
+		if (needs_lowering(type)) {
+			arg_entity = create_compound_arg_entity(irg, type);
+			sel        = new_rd_simpleSel(dbgi, block, nomem, frame,
+			                              arg_entity);
+			mem        = new_rd_CopyB(dbgi, block, mem, sel, arg, type);
+			arg        = sel;
+		}
+		new_in[pos++] = arg;
+	}
+	new_in[n_Call_mem] = mem;
+	new_in[n_Call_ptr] = get_Call_ptr(call);
+	set_irn_in(call, pos, new_in);
+}
 
-		arg        = get_Call_param(call, i);
-		arg_entity = create_compound_arg_entity(irg, type);
-		block      = get_nodes_block(call);
-		sel        = new_rd_simpleSel(dbgi, block, nomem, frame, arg_entity);
-		mem        = new_rd_CopyB(dbgi, block, mem, sel, arg, type);
-		set_Call_param(call, i, sel);
+/**
+ * Replaces the results of a Call, that are compounds returned in registers,
+ * by the register values and renumbers all other results.
+ */
+static void fix_register_ret(compound_call_lowering_flags flags, ir_node *call,
+                             ir_type *ctp)
+{
+	ir_graph *irg      = get_irn_irg(call);
+	dbg_info *dbgi     = get_irn_dbg_info(call);
+	ir_node  *block    = get_nodes_block(call);
+	ir_node  *results  = NULL;
+	ir_node  *call_mem = NULL;
+	size_t    n_ress   = get_method_n_ress(ctp);
+	size_t   *result_map;
+	ir_node **projs;
+	size_t    n_projs  = 0;
+
+	if (lower_aggregate == NULL)
+		return;
+
+	foreach_out_edge(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (!is_Proj(proj))
+			continue;
+		if (get_Proj_proj(proj) == pn_Call_T_result)
+			results = proj;
+		else if (get_Proj_proj(proj) == pn_Call_M)
+			call_mem = proj;
+	}
+	if (results == NULL)
+		return;
+
+	result_map = ALLOCAN(size_t, n_ress);
+	compute_result_map(flags, ctp, result_map);
+
+	/* collect the result Projs first, we create new ones below */
+	projs = ALLOCAN(ir_node*, get_irn_n_edges(results));
+	foreach_out_edge(results, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (is_Proj(proj))
+			projs[n_projs++] = proj;
+	}
+
+	for (size_t i = 0; i < n_projs; ++i) {
+		ir_node          *proj = projs[i];
+		long              pn   = get_Proj_proj(proj);
+		ir_type          *type = get_method_res_type(ctp, pn);
+		aggregate_spec_t  spec;
+		ir_node          *values[MAX_REGISTER_AGGREGATE_VALUES];
+
+		if (!is_register_compound(flags, type, true)) {
+			if (!needs_lowering(type) || (flags & LF_RETURN_HIDDEN))
+				set_Proj_proj(proj, result_map[pn]);
+			continue;
+		}
+
+		spec = get_aggregate_spec(type, true);
+		for (unsigned p = 0; p < spec.length; ++p) {
+			values[p] = new_r_Proj(results, spec.modes[p], result_map[pn] + p);
+		}
+
+		/* copies of the result become stores to their destination */
+		foreach_out_edge_safe(proj, edge) {
+			ir_node *copyb = get_edge_src_irn(edge);
+			ir_node *mem;
+			if (!is_CopyB(copyb) || get_CopyB_src(copyb) != proj)
+				continue;
+			mem = store_aggregate(dbgi, get_nodes_block(copyb),
+			                      get_CopyB_mem(copyb), get_CopyB_dst(copyb),
+			                      type, &spec, values);
+			exchange(copyb, mem);
+		}
+		if (get_irn_n_edges(proj) == 0)
+			continue;
+
+		/* all other users access the result in a temporary */
+		ir_entity *tmp   = create_compound_arg_entity(irg, type);
+		ir_node   *sel   = new_rd_simpleSel(dbgi, block, get_irg_no_mem(irg),
+		                                    get_irg_frame(irg), tmp);
+		ir_node   *mem;
+		if (call_mem == NULL) {
+			call_mem = new_r_Proj(call, mode_M, pn_Call_M);
+			mem      = store_aggregate(dbgi, block, call_mem, sel, type,
+			                           &spec, values);
+			keep_alive(mem);
+		} else {
+			mem = store_aggregate(dbgi, block, call_mem, sel, type, &spec,
+			                      values);
+			reroute_memory(call_mem, mem);
+			call_mem = mem;
+		}
+		exchange(proj, sel);
 	}
-	set_Call_mem(call, mem);
+}
+
+/**
+ * Stores the compound parameters passed in registers into their local
+ * copies at the start of the graph.
+ */
+static void store_register_params(ir_graph *irg, pmap *param_copies)
+{
+	ir_node *initial_mem = get_irg_initial_mem(irg);
+	ir_node *block       = get_irg_start_block(irg);
+	ir_node *args        = get_irg_args(irg);
+	ir_node *frame       = get_irg_frame(irg);
+	ir_node *nomem       = get_irg_no_mem(irg);
+	ir_node *mem         = initial_mem;
+	ir_type *frame_type  = get_irg_frame_type(irg);
+
+	/* walk the frame type to get a deterministic order */
+	for (size_t i = 0, n = get_compound_n_members(frame_type); i < n; ++i) {
+		ir_entity *param = get_compound_member(frame_type, i);
+		ir_entity *copy  = pmap_get(ir_entity, param_copies, param);
+		if (copy == NULL)
+			continue;
+
+		ir_type          *type = get_entity_type(param);
+		size_t            num  = get_entity_parameter_number(param);
+		aggregate_spec_t  spec = get_aggregate_spec(type, false);
+		ir_node          *values[MAX_REGISTER_AGGREGATE_VALUES];
+		for (unsigned p = 0; p < spec.length; ++p)
+			values[p] = new_r_Proj(args, spec.modes[p], num + p);
+
+		ir_node *sel = new_r_simpleSel(block, nomem, frame, copy);
+		mem = store_aggregate(NULL, block, mem, sel, type, &spec, values);
+	}
+	reroute_memory(initial_mem, mem);
+	/* the anchor has been rerouted as well */
+	set_irg_initial_mem(irg, initial_mem);
 }
 
 static void fix_calls(wlk_env *env)
@@ -631,10 +1043,11 @@ static void fix_calls(wlk_env *env)
 		set_Call_type(call, lowered_mtp);
 
 		if (entry->has_compound_param) {
-			fix_compound_params(entry, ctp);
+			fix_compound_params(env->flags, entry, ctp);
 		}
 		if (entry->has_compound_ret) {
 			fix_compound_ret(entry, ctp);
+			fix_register_ret(env->flags, call, ctp);
 		}
 	}
 }
@@ -663,37 +1076,50 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 	wlk_env   env;
 
 	/* calculate the number of compound returns */
-	size_t n_ret_com = 0;
+	size_t n_ret_com  = 0;
+	size_t n_reg_ret  = 0;
+	bool   reg_params = false;
 	for (i = 0; i < n_ress; ++i) {
 		ir_type *type = get_method_res_type(mtp, i);
-		if (needs_lowering(type))
+		if (is_register_compound(flags, type, true))
+			++n_reg_ret;
+		else if (needs_lowering(type))
 			++n_ret_com;
 	}
 	for (i = 0; i < n_params; ++i) {
 		ir_type *type = get_method_param_type(mtp, i);
 		if (needs_lowering(type))
 			++n_param_com;
+		if (is_register_compound(flags, type, false))
+			reg_params = true;
 	}
 
-	if (n_ret_com > 0)
-		fix_parameter_entities(irg, n_ret_com);
+	size_t *param_map = ALLOCAN(size_t, n_params);
+	compute_param_map(flags, mtp, param_map);
+	if (n_ret_com > 0 || reg_params) {
+		/* hidden arguments are added first and register compounds are
+		 * split */
+		fix_parameter_entities(irg, param_map);
+		env.param_map = param_map;
+	} else {
+		/* we must only search for calls */
+		env.param_map = NULL;
+	}
 
-	if (n_ret_com) {
+	if (n_ret_com > 0 || n_reg_ret > 0) {
 		/* much easier if we have only one return */
 		normalize_one_return(irg);
-
-		/* hidden arguments are added first */
-		env.arg_shift = n_ret_com;
-	} else {
-		/* we must only search for calls */
-		env.arg_shift = 0;
-		lowered_mtp   = NULL;
 	}
 
 	lowered_mtp = lower_mtp(flags, mtp);
 	set_entity_type(ent, lowered_mtp);
 
+	/* register compounds are rewired using the out edges */
+	if (lower_aggregate != NULL)
+		assure_edges(irg);
+
 	obstack_init(&env.obst);
+	env.param_copies   = pmap_create();
 	env.cl_list        = NULL;
 	env.flags          = flags;
 	env.lowered_mtp    = lowered_mtp;
@@ -704,6 +1130,9 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 	irg_walk_graph(irg, firm_clear_link, NULL, &env);
 	irg_walk_graph(irg, fix_args_and_collect_calls, NULL, &env);
 
+	if (pmap_count(env.param_copies) > 0)
+		store_register_params(irg, env.param_copies);
+
 	if (n_param_com > 0 && !(flags & LF_DONT_LOWER_ARGUMENTS))
 		remove_compound_param_entities(irg);
 
@@ -713,7 +1142,7 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 		env.changed = true;
 	}
 
-	if (n_ret_com) {
+	if (n_ret_com > 0 || n_reg_ret > 0) {
 		int idx;
 
 		/* STEP 1: find the return. This is simple, we have normalized the graph. */
@@ -739,7 +1168,8 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 			 * STEP 2: fix it. For all compound return values add a CopyB,
 			 * all others are copied.
 			 */
-			NEW_ARR_A(ir_node *, new_in, n_ress + 1);
+			NEW_ARR_A(ir_node *, new_in,
+			          n_ress * MAX_REGISTER_AGGREGATE_VALUES + 1);
 
 			bl  = get_nodes_block(ret);
 			mem = get_Return_mem(ret);
@@ -751,7 +1181,18 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 				ir_node *pred = get_Return_res(ret, i);
 				tp = get_method_res_type(mtp, i);
 
-				if (needs_lowering(tp)) {
+				if (is_register_compound(flags, tp, true)) {
+					/* load the register parts of the compound */
+					aggregate_spec_t spec = get_aggregate_spec(tp, true);
+					if (is_Unknown(pred)) {
+						for (unsigned p = 0; p < spec.length; ++p)
+							new_in[j++] = new_r_Unknown(irg, spec.modes[p]);
+					} else {
+						load_aggregate(get_irn_dbg_info(ret), bl, &mem, pred,
+						               tp, &spec, &new_in[j]);
+						j += spec.length;
+					}
+				} else if (needs_lowering(tp)) {
 					ir_node *arg = get_irg_args(irg);
 					arg = new_r_Proj(arg, mode_P_data, k);
 					++k;
@@ -804,6 +1245,10 @@ static void transform_irg(compound_call_lowering_flags flags, ir_graph *irg)
 		}
 	}
 
+	if (lower_aggregate != NULL)
+		edges_deactivate(irg);
+
+	pmap_destroy(env.param_copies);
 	obstack_free(&env.obst, NULL);
 }
 
@@ -830,11 +1275,13 @@ static void lower_method_types(type_or_ent tore, void *env)
 	}
 }
 
-void lower_calls_with_compounds(compound_call_lowering_flags flags)
+void lower_calls_with_compounds(compound_call_lowering_flags flags,
+                                lower_aggregate_func aggregate_func)
 {
 	size_t i, n;
 
-	pointer_types = pmap_create();
+	lower_aggregate = aggregate_func;
+	pointer_types   = pmap_create();
 	lowered_mtps = pmap_create();
 
 	/* first step: Transform all graphs */
@@ -848,4 +1295,5 @@ void lower_calls_with_compounds(compound_call_lowering_flags flags)
 
 	pmap_destroy(lowered_mtps);
 	pmap_destroy(pointer_types);
+	lower_aggregate = NULL;
 }
@@ -11,6 +11,8 @@
 #ifndef FIRM_LOWER_CALLS_H
 #define FIRM_LOWER_CALLS_H
 
+#include <stdbool.h>
+
 #include "firm_types.h"
 
 /**
@@ -24,6 +26,26 @@ typedef enum compound_call_lowering_flags {
 } compound_call_lowering_flags;
 ENUM_BITSET(compound_call_lowering_flags)
 
+/** Maximum number of registers an aggregate may be transmitted in. */
+#define MAX_REGISTER_AGGREGATE_VALUES 2
+
+/**
+ * Describes how an aggregate is transmitted. The aggregate is split into
+ * consecutive parts, one per register, each part covering as many bytes as
+ * its mode. The last part may be shorter if the aggregate ends earlier.
+ */
+typedef struct aggregate_spec_t {
+	unsigned  length; /**< number of registers, 0 means passing in memory */
+	ir_mode  *modes[MAX_REGISTER_AGGREGATE_VALUES]; /**< modes of the parts */
+} aggregate_spec_t;
+
+/**
+ * Callback which classifies an aggregate parameter or result type according
+ * to the ABI of the target.
+ */
+typedef aggregate_spec_t (*lower_aggregate_func)(ir_type *type,
+                                                 bool is_result);
+
 /**
  * Lower calls with compound parameter and return types.
  * This function does the following transformations:
@@ -33,6 +55,10 @@ ENUM_BITSET(compound_call_lowering_flags)
  * - Copy compound parameters to a new location on the callers
  *   stack and transmit the address of this new location
  *
+ * - Compound parameters which @p lower_aggregate classifies as register
+ *   aggregate are loaded and transmitted as scalar parameters instead. The
+ *   callee stores them into a local entity.
+ *
  * If LF_COMPOUND_RETURN is set:
  *
  * - Adds a new (hidden) pointer parameter for
@@ -47,6 +73,10 @@ ENUM_BITSET(compound_call_lowering_flags)
  *
  * - Replace a possible block copy after the function call.
  *
+ * - Compound results which @p lower_aggregate classifies as register
+ *   aggregate are returned as scalar results instead, which the caller stores
+ *   into a local entity.
+ *
  * General:
  *
  * - Changes the types of methods and calls to the lowered ones
@@ -82,7 +112,12 @@ ENUM_BITSET(compound_call_lowering_flags)
      ret->a = a;
    }
    @endcode
+ *
+ * @param flags            additional lowering flags
+ * @param lower_aggregate  classifies compound types, may be NULL if all
+ *                         compounds are transmitted in memory
  */
-void lower_calls_with_compounds(compound_call_lowering_flags flags);
+void lower_calls_with_compounds(compound_call_lowering_flags flags,
+                                lower_aggregate_func lower_aggregate);
 
 #endif
@@ -91,49 +91,64 @@ static ir_mode *get_ir_mode(unsigned mode_bytes)
 	}
 }
 
+/**
+ * Copies mode sized memory at offset from src to dst.
+ *
+ * @return the memory after the copy
+ */
+static ir_node *copy_chunk(ir_node *block, ir_node *mem, ir_node *addr_src,
+                           ir_node *addr_dst, unsigned offset, ir_mode *mode)
+{
+	ir_graph *irg       = get_irn_irg(block);
+	ir_mode  *addr_mode = get_irn_mode(addr_src);
+	ir_node  *addr_const;
+	ir_node  *add;
+	ir_node  *load;
+	ir_node  *load_res;
+	ir_node  *load_mem;
+	ir_node  *store;
+
+	addr_const = new_r_Const_long(irg, mode_Iu, offset);
+	add        = new_r_Add(block, addr_src, addr_const, addr_mode);
+
+	load     = new_r_Load(block, mem, add, mode, cons_none);
+	load_res = new_r_Proj(load, mode, pn_Load_res);
+	load_mem = new_r_Proj(load, mode_M, pn_Load_M);
+
+	addr_const = new_r_Const_long(irg, mode_Iu, offset);
+	add        = new_r_Add(block, addr_dst, addr_const, addr_mode);
+
+	store = new_r_Store(block, load_mem, add, load_res, cons_none);
+	return new_r_Proj(store, mode_M, pn_Store_M);
+}
+
 /**
  * Turn a small CopyB node into a series of Load/Store nodes.
  */
 static void lower_small_copyb_node(ir_node *irn)
 {
-	ir_graph *irg        = get_irn_irg(irn);
 	ir_node  *block      = get_nodes_block(irn);
 	ir_type  *tp         = get_CopyB_type(irn);
 	ir_node  *addr_src   = get_CopyB_src(irn);
 	ir_node  *addr_dst   = get_CopyB_dst(irn);
 	ir_node  *mem        = get_CopyB_mem(irn);
-	ir_mode  *addr_mode  = get_irn_mode(addr_src);
 	unsigned  mode_bytes = allow_misalignments ? native_mode_bytes : tp->align;
 	unsigned  size       = get_type_size_bytes(tp);
 	unsigned  offset     = 0;
-	ir_mode  *mode;
 
 	while (offset < size) {
-		mode = get_ir_mode(mode_bytes);
+		ir_mode *mode = get_ir_mode(mode_bytes);
 		for (; offset + mode_bytes <= size; offset += mode_bytes) {
-			/* construct offset */
-			ir_node *addr_const;
-			ir_node *add;
-			ir_node *load;
-			ir_node *load_res;
-			ir_node *load_mem;
-			ir_node *store;
-			ir_node *store_mem;
-
-			addr_const = new_r_Const_long(irg, mode_Iu, offset);
-			add        = new_r_Add(block, addr_src, addr_const, addr_mode);
-
-			load     = new_r_Load(block, mem, add, mode, cons_none);
-			load_res = new_r_Proj(load, mode, pn_Load_res);
-			load_mem = new_r_Proj(load, mode_M, pn_Load_M);
-
-			addr_const = new_r_Const_long(irg, mode_Iu, offset);
-			add        = new_r_Add(block, addr_dst, addr_const, addr_mode);
-
-			store     = new_r_Store(block, load_mem, add, load_res, cons_none);
-			store_mem = new_r_Proj(store, mode_M, pn_Store_M);
+			mem = copy_chunk(block, mem, addr_src, addr_dst, offset, mode);
+		}
 
-			mem = store_mem;
+		/* Copy the tail with a single access overlapping the previous one
+		 * instead of several smaller ones. Source and destination of a CopyB
+		 * do not overlap, so copying some bytes twice is harmless. */
+		if (allow_misalignments && offset < size && offset >= mode_bytes) {
+			mem = copy_chunk(block, mem, addr_src, addr_dst, size - mode_bytes,
+			                 mode);
+			break;
 		}
 
 		mode_bytes /= 2;
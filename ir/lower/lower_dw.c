@@ -497,6 +497,66 @@ static ir_node *get_intrinsic_address(ir_type *method, ir_op *op,
 	return new_r_SymConst(env->irg, mode_P_code, sym, symconst_addr_ent);
 }
 
+/**
+ * Returns true if the high word of the lowered value @p node is known to be
+ * zero (for example because it is the result of a zero extension).
+ */
+static bool is_high_word_zero(ir_node *node)
+{
+	ir_node *high = get_lowered_high(node);
+	return is_Const(high) && tarval_is_null(get_Const_tarval(high));
+}
+
+/**
+ * Translate a Div or Mod whose operands have zero high words: a word
+ * operation computes the low word of the result, the high word is zero.
+ * The operation is the same for signed and unsigned modes here, as both
+ * operands are non-negative.
+ */
+static void lower_divmod_low(ir_node *node, ir_mode *mode)
+{
+	dbg_info     *dbgi      = get_irn_dbg_info(node);
+	ir_node      *block     = get_nodes_block(node);
+	ir_graph     *irg       = get_irn_irg(block);
+	ir_mode      *low_mode  = env->low_unsigned;
+	op_pin_state  pinned    = get_irn_pinned(node);
+	bool          is_div    = is_Div(node);
+	ir_node      *left      = is_div ? get_Div_left(node) : get_Mod_left(node);
+	ir_node      *right     = is_div ? get_Div_right(node) : get_Mod_right(node);
+	ir_node      *mem       = is_div ? get_Div_mem(node) : get_Mod_mem(node);
+	ir_node      *left_low  = get_lowered_low(left);
+	ir_node      *right_low = get_lowered_low(right);
+	ir_node      *res_high  = new_r_Const(irg, get_mode_null(mode));
+	ir_node      *op;
+	long          pn_res;
+
+	if (is_div) {
+		op     = new_rd_Div(dbgi, block, mem, left_low, right_low, low_mode,
+		                    pinned);
+		pn_res = pn_Div_res;
+	} else {
+		op     = new_rd_Mod(dbgi, block, mem, left_low, right_low, low_mode,
+		                    pinned);
+		pn_res = pn_Mod_res;
+	}
+	ir_set_throws_exception(op, ir_throws_exception(node));
+
+	foreach_out_edge_safe(node, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (!is_Proj(proj))
+			continue;
+
+		if (get_Proj_proj(proj) == pn_res) {
+			ir_node *res_low = new_r_Proj(op, low_mode, pn_res);
+			ir_set_dw_lowered(proj, res_low, res_high);
+		} else {
+			/* memory and control flow Projs have the same numbers */
+			set_Proj_pred(proj, op);
+		}
+		mark_irn_visited(proj);
+	}
+}
+
 /**
  * Translate a Div.
  *
@@ -515,6 +575,11 @@ static void lower_Div(ir_node *node, ir_mode *mode)
 	ir_node  *call;
 	ir_node  *resproj;
 
+	if (is_high_word_zero(left) && is_high_word_zero(right)) {
+		lower_divmod_low(node, mode);
+		return;
+	}
+
 	if (env->params->little_endian) {
 		in[0] = get_lowered_low(left);
 		in[1] = get_lowered_high(left);
@@ -587,6 +652,11 @@ static void lower_Mod(ir_node *node, ir_mode *mode)
 	ir_node  *call;
 	ir_node  *resproj;
 
+	if (is_high_word_zero(left) && is_high_word_zero(right)) {
+		lower_divmod_low(node, mode);
+		return;
+	}
+
 	if (env->params->little_endian) {
 		in[0] = get_lowered_low(left);
 		in[1] = get_lowered_high(left);
@@ -766,6 +836,111 @@ typedef ir_node* (*new_rd_shr_func)(dbg_info *dbgi, ir_node *block,
                                     ir_node *left, ir_node *right,
                                     ir_mode *mode);
 
+/**
+ * Creates a Cmp testing whether the shift amount @p right is at least one
+ * word, i.e. whether the bit @p word_bits is set.
+ */
+static ir_node *create_shift_sel(dbg_info *dbgi, ir_node *block,
+                                 ir_node *right, unsigned word_bits)
+{
+	ir_graph *irg          = get_irn_irg(block);
+	ir_mode  *low_unsigned = env->low_unsigned;
+	ir_node  *cnst         = new_r_Const_long(irg, low_unsigned, word_bits);
+	ir_node  *andn         = new_r_And(block, right, cnst, low_unsigned);
+	ir_node  *zero         = new_r_Const(irg, get_mode_null(low_unsigned));
+	return new_rd_Cmp(dbgi, block, andn, zero, ir_relation_less_greater);
+}
+
+/**
+ * Translate a right shift by a constant amount. No control flow is needed
+ * as we know statically which words are affected.
+ */
+static void lower_shr_const(ir_node *node, ir_mode *mode,
+                            new_rd_shr_func new_rd_shrs, ir_node *right)
+{
+	ir_node  *left         = get_binop_left(node);
+	ir_node  *block        = get_nodes_block(node);
+	dbg_info *dbgi         = get_irn_dbg_info(node);
+	ir_graph *irg          = get_irn_irg(node);
+	ir_mode  *low_unsigned = env->low_unsigned;
+	unsigned  word_bits    = get_mode_size_bits(low_unsigned);
+	unsigned  modulo_shift = get_mode_modulo_shift(get_irn_mode(node));
+	ir_node  *left_low     = get_lowered_low(left);
+	ir_node  *left_high    = get_lowered_high(left);
+	ir_node  *conv         = create_conv(block, left_high, low_unsigned);
+	unsigned  shift        = get_tarval_long(get_Const_tarval(right))
+	                         & (modulo_shift - 1);
+	ir_node  *res_low;
+	ir_node  *res_high;
+
+	if (shift == 0) {
+		res_low  = left_low;
+		res_high = left_high;
+	} else if (shift < word_bits) {
+		ir_node *cnst      = new_r_Const_long(irg, low_unsigned, shift);
+		ir_node *cnst_rev  = new_r_Const_long(irg, low_unsigned,
+		                                      word_bits - shift);
+		ir_node *shift_low = new_rd_Shr(dbgi, block, left_low, cnst,
+		                                low_unsigned);
+		ir_node *carry     = new_rd_Shl(dbgi, block, conv, cnst_rev,
+		                                low_unsigned);
+		res_low  = new_rd_Or(dbgi, block, shift_low, carry, low_unsigned);
+		res_high = new_rd_shrs(dbgi, block, left_high, cnst, mode);
+	} else {
+		ir_node *cnst = new_r_Const_long(irg, low_unsigned,
+		                                 shift - word_bits);
+		res_low = new_rd_shrs(dbgi, block, conv, cnst, low_unsigned);
+		if (new_rd_shrs == new_rd_Shrs) {
+			ir_node *cnst2 = new_r_Const_long(irg, low_unsigned,
+			                                  word_bits - 1);
+			res_high = new_rd_shrs(dbgi, block, left_high, cnst2, mode);
+		} else {
+			res_high = new_r_Const(irg, get_mode_null(mode));
+		}
+	}
+	ir_set_dw_lowered(node, res_low, res_high);
+}
+
+/**
+ * Translate a left shift by a constant amount.
+ */
+static void lower_shl_const(ir_node *node, ir_mode *mode, ir_node *right)
+{
+	ir_node  *left         = get_binop_left(node);
+	ir_node  *block        = get_nodes_block(node);
+	dbg_info *dbgi         = get_irn_dbg_info(node);
+	ir_graph *irg          = get_irn_irg(node);
+	ir_mode  *low_unsigned = env->low_unsigned;
+	unsigned  word_bits    = get_mode_size_bits(low_unsigned);
+	unsigned  modulo_shift = get_mode_modulo_shift(get_irn_mode(node));
+	ir_node  *left_low     = get_lowered_low(left);
+	ir_node  *left_high    = get_lowered_high(left);
+	ir_node  *conv         = create_conv(block, left_low, mode);
+	unsigned  shift        = get_tarval_long(get_Const_tarval(right))
+	                         & (modulo_shift - 1);
+	ir_node  *res_low;
+	ir_node  *res_high;
+
+	if (shift == 0) {
+		res_low  = left_low;
+		res_high = left_high;
+	} else if (shift < word_bits) {
+		ir_node *cnst       = new_r_Const_long(irg, low_unsigned, shift);
+		ir_node *cnst_rev   = new_r_Const_long(irg, low_unsigned,
+		                                       word_bits - shift);
+		ir_node *shift_high = new_rd_Shl(dbgi, block, left_high, cnst, mode);
+		ir_node *carry      = new_rd_Shr(dbgi, block, conv, cnst_rev, mode);
+		res_low  = new_rd_Shl(dbgi, block, left_low, cnst, low_unsigned);
+		res_high = new_rd_Or(dbgi, block, shift_high, carry, mode);
+	} else {
+		ir_node *cnst = new_r_Const_long(irg, low_unsigned,
+		                                 shift - word_bits);
+		res_low  = new_r_Const(irg, get_mode_null(low_unsigned));
+		res_high = new_rd_Shl(dbgi, block, conv, cnst, mode);
+	}
+	ir_set_dw_lowered(node, res_low, res_high);
+}
+
 static void lower_shr_helper(ir_node *node, ir_mode *mode,
                              new_rd_shr_func new_rd_shrs)
 {
@@ -819,6 +994,51 @@ static void lower_shr_helper(ir_node *node, ir_mode *mode,
 		right = create_conv(block, right, low_unsigned);
 	}
 
+	if (is_Const(right)) {
+		lower_shr_const(node, mode, new_rd_shrs, right);
+		return;
+	}
+
+	/* try a branch-free variant first:
+	 * the shift amounts are taken modulo the word size by the operations
+	 * anyway, so only the selection of the result words depends on whether
+	 * we shift by more than a word */
+	if (env->params->allow_ifconv != NULL) {
+		ir_node *res_high     = new_rd_shrs(dbgi, block, left_high, right,
+		                                    mode);
+		ir_node *shift_low    = new_rd_Shr(dbgi, block, left_low, right,
+		                                   low_unsigned);
+		ir_node *not_shiftval = new_rd_Not(dbgi, block, right, low_unsigned);
+		ir_node *conv         = create_conv(block, left_high, low_unsigned);
+		ir_node *one          = new_r_Const(irg, get_mode_one(low_unsigned));
+		ir_node *carry0       = new_rd_Shl(dbgi, block, conv, one,
+		                                   low_unsigned);
+		ir_node *carry1       = new_rd_Shl(dbgi, block, carry0, not_shiftval,
+		                                   low_unsigned);
+		ir_node *res_low      = new_rd_Or(dbgi, block, shift_low, carry1,
+		                                  low_unsigned);
+		ir_node *big_low      = new_rd_shrs(dbgi, block, conv, right,
+		                                    low_unsigned);
+		ir_node *big_high;
+		if (new_rd_shrs == new_rd_Shrs) {
+			ir_node *cnst2 = new_r_Const_long(irg, low_unsigned,
+			                                  modulo_shift2 - 1);
+			big_high = new_rd_shrs(dbgi, block, left_high, cnst2, mode);
+		} else {
+			big_high = new_r_Const(irg, get_mode_null(mode));
+		}
+		ir_node *sel = create_shift_sel(dbgi, block, right, modulo_shift2);
+		if (env->params->allow_ifconv(sel, res_low, big_low)
+		    && env->params->allow_ifconv(sel, res_high, big_high)) {
+			ir_node *mux_low  = new_rd_Mux(dbgi, block, sel, res_low,
+			                               big_low, low_unsigned);
+			ir_node *mux_high = new_rd_Mux(dbgi, block, sel, res_high,
+			                               big_high, mode);
+			ir_set_dw_lowered(node, mux_low, mux_high);
+			return;
+		}
+	}
+
 	lower_block = part_block_dw(node);
 	env->flags |= CF_CHANGED;
 	block = get_nodes_block(node);
@@ -952,6 +1172,42 @@ static void lower_Shl(ir_node *node, ir_mode *mode)
 		right = create_conv(lower_block, right, low_unsigned);
 	}
 
+	if (is_Const(right)) {
+		lower_shl_const(node, mode, right);
+		return;
+	}
+
+	/* try a branch-free variant first, see lower_shr_helper() */
+	if (env->params->allow_ifconv != NULL) {
+		ir_node *res_low      = new_rd_Shl(dbgi, lower_block, left_low, right,
+		                                   low_unsigned);
+		ir_node *shift_high   = new_rd_Shl(dbgi, lower_block, left_high, right,
+		                                   mode);
+		ir_node *not_shiftval = new_rd_Not(dbgi, lower_block, right,
+		                                   low_unsigned);
+		ir_node *conv         = create_conv(lower_block, left_low, mode);
+		ir_node *one          = new_r_Const(irg, get_mode_one(low_unsigned));
+		ir_node *carry0       = new_rd_Shr(dbgi, lower_block, conv, one, mode);
+		ir_node *carry1       = new_rd_Shr(dbgi, lower_block, carry0,
+		                                   not_shiftval, mode);
+		ir_node *res_high     = new_rd_Or(dbgi, lower_block, shift_high,
+		                                  carry1, mode);
+		ir_node *big_low      = new_r_Const(irg, get_mode_null(low_unsigned));
+		ir_node *big_high     = new_rd_Shl(dbgi, lower_block, conv, right,
+		                                   mode);
+		ir_node *sel          = create_shift_sel(dbgi, lower_block, right,
+		                                         modulo_shift2);
+		if (env->params->allow_ifconv(sel, res_low, big_low)
+		    && env->params->allow_ifconv(sel, res_high, big_high)) {
+			ir_node *mux_low  = new_rd_Mux(dbgi, lower_block, sel, res_low,
+			                               big_low, low_unsigned);
+			ir_node *mux_high = new_rd_Mux(dbgi, lower_block, sel, res_high,
+			                               big_high, mode);
+			ir_set_dw_lowered(node, mux_low, mux_high);
+			return;
+		}
+	}
+
 	part_block_dw(node);
 	env->flags |= CF_CHANGED;
 	block = get_nodes_block(node);
@@ -2864,6 +3120,191 @@ static void clear_node_and_phi_links(ir_node *node, void *data)
 		set_Phi_next(node, NULL);
 }
 
+/**
+ * Computes the magic multiplier m and shift l for an unsigned division of
+ * doubleword values by the constant @p d (which must not be a power of two)
+ * as described by Granlund and Montgomery:
+ *    t = mulh(m, x)
+ *    q = (t + ((x - t) >> 1)) >> (l - 1)
+ * where m = floor(2^N * (2^l - d) / d) + 1 and l = ceil(log2(d)).
+ */
+static ir_tarval *get_udiv_magic(ir_tarval *d, unsigned *shift)
+{
+	ir_mode   *mode = get_tarval_mode(d);
+	unsigned   bits = get_mode_size_bits(mode);
+	ir_tarval *one  = get_mode_one(mode);
+	unsigned   l    = get_tarval_highest_bit(tarval_sub(d, one, NULL)) + 1;
+	ir_tarval *r;
+	ir_tarval *q    = get_mode_null(mode);
+
+	/* 2^l - d, computed modulo 2^N */
+	if (l < bits)
+		r = tarval_sub(tarval_shl_unsigned(one, l), d, NULL);
+	else
+		r = tarval_neg(d);
+
+	/* long division of r * 2^N by d, r < d always holds */
+	for (unsigned i = 0; i < bits; ++i) {
+		ir_tarval *rest = tarval_sub(d, r, NULL);
+		q = tarval_shl_unsigned(q, 1);
+		if (tarval_cmp(r, rest) != ir_relation_less) {
+			r = tarval_sub(r, rest, NULL);
+			q = tarval_or(q, one);
+		} else {
+			r = tarval_add(r, r);
+		}
+	}
+
+	*shift = l;
+	return tarval_add(q, one);
+}
+
+/**
+ * Creates the upper doubleword of the product of @p x and the constant
+ * @p tv from word multiplications. The values are kept in doubleword mode,
+ * so the partial products are lowered like any other doubleword Mul whose
+ * operands have zero high words.
+ */
+static ir_node *create_dw_mulh(dbg_info *dbgi, ir_node *block, ir_node *x,
+                               ir_tarval *tv)
+{
+	ir_graph  *irg       = get_irn_irg(block);
+	ir_mode   *mode      = get_tarval_mode(tv);
+	unsigned   word_bits = get_mode_size_bits(mode) / 2;
+	ir_tarval *tv_mask   = tarval_convert_to(get_mode_all_one(env->low_unsigned),
+	                                         mode);
+	ir_node   *mask      = new_r_Const(irg, tv_mask);
+	ir_node   *cnst      = new_r_Const_long(irg, mode_Iu, word_bits);
+	ir_node   *m_low     = new_r_Const(irg, tarval_and(tv, tv_mask));
+	ir_node   *m_high    = new_r_Const(irg, tarval_shr_unsigned(tv, word_bits));
+	ir_node   *x_low     = new_rd_And(dbgi, block, x, mask, mode);
+	ir_node   *x_high    = new_rd_Shr(dbgi, block, x, cnst, mode);
+	ir_node   *p0        = new_rd_Mul(dbgi, block, x_low,  m_low,  mode);
+	ir_node   *p1        = new_rd_Mul(dbgi, block, x_low,  m_high, mode);
+	ir_node   *p2        = new_rd_Mul(dbgi, block, x_high, m_low,  mode);
+	ir_node   *p3        = new_rd_Mul(dbgi, block, x_high, m_high, mode);
+
+	/* the middle column: carries into the upper doubleword */
+	ir_node *p0_high = new_rd_Shr(dbgi, block, p0, cnst, mode);
+	ir_node *p1_low  = new_rd_And(dbgi, block, p1, mask, mode);
+	ir_node *p2_low  = new_rd_And(dbgi, block, p2, mask, mode);
+	ir_node *mid     = new_rd_Add(dbgi, block, p0_high, p1_low, mode);
+	mid              = new_rd_Add(dbgi, block, mid, p2_low, mode);
+
+	ir_node *p1_high  = new_rd_Shr(dbgi, block, p1, cnst, mode);
+	ir_node *p2_high  = new_rd_Shr(dbgi, block, p2, cnst, mode);
+	ir_node *mid_high = new_rd_Shr(dbgi, block, mid, cnst, mode);
+	ir_node *res      = new_rd_Add(dbgi, block, p3, p1_high, mode);
+	res               = new_rd_Add(dbgi, block, res, p2_high, mode);
+	return new_rd_Add(dbgi, block, res, mid_high, mode);
+}
+
+/**
+ * Collects unsigned doubleword Div and Mod nodes by constants.
+ */
+static void collect_divmod_by_const(ir_node *node, void *data)
+{
+	ir_node ***list = (ir_node***)data;
+	ir_node   *right;
+	ir_mode   *mode;
+
+	if (is_Div(node)) {
+		right = get_Div_right(node);
+		mode  = get_Div_resmode(node);
+	} else if (is_Mod(node)) {
+		right = get_Mod_right(node);
+		mode  = get_Mod_resmode(node);
+	} else {
+		return;
+	}
+	if (mode != env->high_unsigned || !is_Const(right)
+	    || ir_throws_exception(node))
+		return;
+	ir_tarval *tv = get_Const_tarval(right);
+	if (tarval_is_null(tv) || tarval_is_one(tv))
+		return;
+	ARR_APP1(ir_node*, *list, node);
+}
+
+/**
+ * Replaces an unsigned doubleword Div or Mod by a constant with a
+ * multiplication by its inverse (or a shift for powers of two). This avoids
+ * the call to the division intrinsic.
+ */
+static void replace_divmod_by_const(ir_node *node)
+{
+	dbg_info  *dbgi   = get_irn_dbg_info(node);
+	ir_node   *block  = get_nodes_block(node);
+	ir_graph  *irg    = get_irn_irg(block);
+	bool       is_div = is_Div(node);
+	ir_node   *left   = is_div ? get_Div_left(node) : get_Mod_left(node);
+	ir_node   *right  = is_div ? get_Div_right(node) : get_Mod_right(node);
+	ir_node   *mem    = is_div ? get_Div_mem(node) : get_Mod_mem(node);
+	ir_mode   *mode   = get_irn_mode(left);
+	ir_tarval *tv     = get_Const_tarval(right);
+	ir_node   *res;
+
+	if (get_tarval_popcount(tv) == 1) {
+		int shift = get_tarval_lowest_bit(tv);
+		if (is_div) {
+			ir_node *cnst = new_r_Const_long(irg, mode_Iu, shift);
+			res = new_rd_Shr(dbgi, block, left, cnst, mode);
+		} else {
+			ir_tarval *tv_mask = tarval_sub(tv, get_mode_one(mode), NULL);
+			res = new_rd_And(dbgi, block, left, new_r_Const(irg, tv_mask),
+			                 mode);
+		}
+	} else {
+		unsigned   shift;
+		ir_tarval *magic = get_udiv_magic(tv, &shift);
+		ir_node   *one   = new_r_Const(irg, get_mode_one(mode_Iu));
+		ir_node   *t     = create_dw_mulh(dbgi, block, left, magic);
+		ir_node   *sub   = new_rd_Sub(dbgi, block, left, t, mode);
+		ir_node   *half  = new_rd_Shr(dbgi, block, sub, one, mode);
+		ir_node   *sum   = new_rd_Add(dbgi, block, t, half, mode);
+		ir_node   *cnst  = new_r_Const_long(irg, mode_Iu, shift - 1);
+		res = new_rd_Shr(dbgi, block, sum, cnst, mode);
+		if (!is_div) {
+			ir_node *mul = new_rd_Mul(dbgi, block, res, right, mode);
+			res = new_rd_Sub(dbgi, block, left, mul, mode);
+		}
+	}
+
+	foreach_out_edge_safe(node, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (!is_Proj(proj))
+			continue;
+
+		switch (get_Proj_proj(proj)) {
+		case pn_Div_M:
+			exchange(proj, mem);
+			break;
+		case pn_Div_res:
+			exchange(proj, res);
+			break;
+		default:
+			panic("unexpected Proj number");
+		}
+	}
+}
+
+/**
+ * Replaces doubleword divisions by constants. Multiplications by constants
+ * are cheap compared to the division intrinsics, but only if the backend
+ * lowers doubleword multiplications inline.
+ */
+static void lower_divmod_by_const(ir_graph *irg)
+{
+	if ((lower_dw_func)op_Mul->ops.generic == lower_binop)
+		return;
+
+	ir_node **list = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, NULL, collect_divmod_by_const, &list);
+	for (size_t i = 0, n = ARR_LEN(list); i < n; ++i)
+		replace_divmod_by_const(list[i]);
+	DEL_ARR_F(list);
+}
+
 static void lower_irg(ir_graph *irg)
 {
 	ir_entity *ent;
@@ -2877,6 +3318,8 @@ static void lower_irg(ir_graph *irg)
 	current_ir_graph = irg;
 	assure_edges(irg);
 
+	lower_divmod_by_const(irg);
+
 	n_idx = get_irg_last_idx(irg);
 	n_idx = n_idx + (n_idx >> 2);  /* add 25% */
 	env->n_entries = n_idx;
@@ -3095,6 +3538,36 @@ void ir_lower_dw_ops(void)
 	env = NULL;
 }
 
+void ir_finish_dw_lowering(void)
+{
+	if (intrinsic_fkt != NULL) {
+		del_set(intrinsic_fkt);
+		intrinsic_fkt = NULL;
+	}
+	if (conv_types != NULL) {
+		del_set(conv_types);
+		conv_types = NULL;
+	}
+	if (lowered_type != NULL) {
+		pmap_destroy(lowered_type);
+		lowered_type = NULL;
+	}
+	if (lowered_builtin_type_low != NULL) {
+		pmap_destroy(lowered_builtin_type_low);
+		lowered_builtin_type_low = NULL;
+	}
+	if (lowered_builtin_type_high != NULL) {
+		pmap_destroy(lowered_builtin_type_high);
+		lowered_builtin_type_high = NULL;
+	}
+	binop_tp_u = NULL;
+	binop_tp_s = NULL;
+	unop_tp_u  = NULL;
+	unop_tp_s  = NULL;
+	tp_s       = NULL;
+	tp_u       = NULL;
+}
+
 /* Default implementation. */
 ir_entity *def_create_intrinsic_fkt(ir_type *method, const ir_op *op,
                                     const ir_mode *imode, const ir_mode *omode,
@@ -12,6 +12,7 @@
 #define FIRM_LOWER_LOWER_DW_H
 
 #include "firm_types.h"
+#include "iroptimize.h"
 
 /**
  * Every double word node will be replaced,
@@ -44,6 +45,9 @@ typedef struct lwrdw_param_t {
 	unsigned              doubleword_size;   /**< bitsize of the doubleword mode */
 	create_intrinsic_fkt *create_intrinsic;  /**< callback that creates the intrinsic entity */
 	void                 *ctx;               /**< context parameter for the creator function */
+	/** if set, shifts by a variable amount are lowered to Mux nodes accepted
+	 * by this callback instead of introducing control flow */
+	arch_allow_ifconv_func allow_ifconv;
 } lwrdw_param_t;
 
 /**
@@ -58,6 +62,12 @@ void ir_prepare_dw_lowering(const lwrdw_param_t *param);
  */
 void ir_lower_dw_ops(void);
 
+/**
+ * Forget the intrinsics and lowered types cached by ir_lower_dw_ops(), they
+ * belong to the current program and are recreated for the next one.
+ */
+void ir_finish_dw_lowering(void);
+
 typedef void (*lower_dw_func)(ir_node *node, ir_mode *mode);
 
 /**
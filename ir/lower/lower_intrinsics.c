@@ -275,14 +275,52 @@ int i_mapper_cbrt(ir_node *call)
 	return 1;
 }
 
+/** The largest exponent n for which pow(x, n) is turned into multiplications. */
+#define POW_MAX_EXPONENT 16
+
+/**
+ * Checks whether tv is a small integral exponent and returns it in *exponent.
+ */
+static bool get_pow_exponent(ir_tarval *tv, long *exponent)
+{
+	ir_tarval *itv = tarval_convert_to(tv, mode_Ls);
+	if (!tarval_is_constant(itv)
+	    || tarval_convert_to(itv, get_tarval_mode(tv)) != tv)
+		return false;
+
+	long n = get_tarval_long(itv);
+	if (n < -POW_MAX_EXPONENT || n > POW_MAX_EXPONENT)
+		return false;
+	*exponent = n;
+	return true;
+}
+
+/**
+ * Computes x^n for n > 0 with a square-and-multiply chain.
+ */
+static ir_node *build_pow_chain(dbg_info *dbg, ir_node *block, ir_node *x,
+                                unsigned long n, ir_mode *mode)
+{
+	ir_node *res = NULL;
+	for (;;) {
+		if (n & 1)
+			res = res == NULL ? x : new_rd_Mul(dbg, block, res, x, mode);
+		n >>= 1;
+		if (n == 0)
+			return res;
+		x = new_rd_Mul(dbg, block, x, x, mode);
+	}
+}
+
 int i_mapper_pow(ir_node *call)
 {
-	ir_node  *left    = get_Call_param(call, 0);
-	ir_node  *right   = get_Call_param(call, 1);
-	ir_node  *block   = get_nodes_block(call);
-	ir_graph *irg     = get_irn_irg(block);
-	ir_node  *reg_jmp = NULL;
-	ir_node  *exc_jmp = NULL;
+	ir_node  *left     = get_Call_param(call, 0);
+	ir_node  *right    = get_Call_param(call, 1);
+	ir_node  *block    = get_nodes_block(call);
+	ir_graph *irg      = get_irn_irg(block);
+	ir_node  *reg_jmp  = NULL;
+	ir_node  *exc_jmp  = NULL;
+	long      exponent = 0;
 	ir_node  *irn;
 	dbg_info *dbg;
 	ir_node  *mem;
@@ -299,8 +337,8 @@ int i_mapper_pow(ir_node *call)
 		} else if (tarval_is_one(tv)) {
 			/* pow(x, 1.0) = x */
 			irn = left;
-		} else if (tarval_is_minus_one(tv)) {
-			/* pow(x, -1.0) = 1/x */
+		} else if (get_pow_exponent(tv, &exponent)) {
+			/* pow(x, n) = x * ... * x, pow(x, -n) = 1/pow(x, n) */
 			irn = NULL;
 		} else
 			return 0;
@@ -313,7 +351,6 @@ int i_mapper_pow(ir_node *call)
 
 	if (irn == NULL) {
 		ir_mode *result_mode = get_irn_mode(left);
-		ir_node *div;
 
 		ir_mode *mode             = result_mode;
 		ir_mode *float_arithmetic = be_get_backend_param()->mode_float_arithmetic;
@@ -322,14 +359,18 @@ int i_mapper_pow(ir_node *call)
 			mode = float_arithmetic;
 		}
 
-		irn  = new_r_Const(irg, get_mode_one(mode));
-		div  = new_rd_Div(dbg, block, mem, irn, left, mode, op_pin_state_pinned);
-		mem  = new_r_Proj(div, mode_M, pn_Div_M);
-		irn  = new_r_Proj(div, mode, pn_Div_res);
-		if (ir_throws_exception(call)) {
-			reg_jmp = new_r_Proj(div, mode_X, pn_Div_X_regular);
-			exc_jmp = new_r_Proj(div, mode_X, pn_Div_X_except);
-			ir_set_throws_exception(div, true);
+		unsigned long n = exponent < 0 ? -(unsigned long)exponent : (unsigned long)exponent;
+		irn = build_pow_chain(dbg, block, left, n, mode);
+		if (exponent < 0) {
+			ir_node *one = new_r_Const(irg, get_mode_one(mode));
+			ir_node *div = new_rd_Div(dbg, block, mem, one, irn, mode, op_pin_state_pinned);
+			mem = new_r_Proj(div, mode_M, pn_Div_M);
+			irn = new_r_Proj(div, mode, pn_Div_res);
+			if (ir_throws_exception(call)) {
+				reg_jmp = new_r_Proj(div, mode_X, pn_Div_X_regular);
+				exc_jmp = new_r_Proj(div, mode_X, pn_Div_X_except);
+				ir_set_throws_exception(div, true);
+			}
 		}
 		if (result_mode != mode) {
 			irn = new_r_Conv(block, irn, result_mode);
@@ -557,6 +598,7 @@ static ir_tarval *get_initializer_value(ir_initializer_t *const init, ir_mode *c
 	}
 
 	case IR_INITIALIZER_COMPOUND:
+	case IR_INITIALIZER_BYTES:
 		break;
 	}
 
@@ -906,6 +948,24 @@ int i_mapper_strcpy(ir_node *call)
 	return 0;
 }
 
+/** maximum size of memcpy() calls with a constant size turned into CopyB */
+#define MAX_INLINE_MEMCPY 8192
+
+/**
+ * Returns an array type of @p size bytes without alignment.
+ */
+static ir_type *get_byte_array_type(unsigned size)
+{
+	ir_type *elem = get_type_for_mode(mode_Bu);
+	ir_type *tp   = new_type_array(1, elem);
+
+	set_array_bounds_int(tp, 0, 0, (int)size);
+	set_type_size_bytes(tp, size);
+	set_type_alignment_bytes(tp, 1);
+	set_type_state(tp, layout_fixed);
+	return tp;
+}
+
 int i_mapper_memcpy(ir_node *call)
 {
 	ir_node *dst = get_Call_param(call, 0);
@@ -921,6 +981,23 @@ int i_mapper_memcpy(ir_node *call)
 		replace_call(dst, call, mem, NULL, NULL);
 		return 1;
 	}
+	if (is_Const(len) && tarval_is_long(get_Const_tarval(len))) {
+		/* a memcpy(d, s, C) ==> CopyB(d, s):
+		   lower_CopyB() expands small copies inline depending on the
+		   target and turns big ones into memcpy calls again */
+		long size = get_tarval_long(get_Const_tarval(len));
+		if (size <= 0 || size > MAX_INLINE_MEMCPY)
+			return 0;
+		dbg_info *dbg   = get_irn_dbg_info(call);
+		ir_node  *mem   = get_Call_mem(call);
+		ir_node  *block = get_nodes_block(call);
+		ir_node  *copyb = new_rd_CopyB(dbg, block, mem, dst, src,
+		                               get_byte_array_type((unsigned)size));
+
+		DBG_OPT_ALGSIM0(call, copyb, FS_OPT_RTS_MEMCPY);
+		replace_call(dst, call, copyb, NULL, NULL);
+		return 1;
+	}
 	return 0;
 }
 
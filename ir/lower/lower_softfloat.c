@@ -10,6 +10,7 @@
  */
 #include <stdbool.h>
 
+#include "array.h"
 #include "be.h"
 #include "dbginfo_t.h"
 #include "debug.h"
@@ -64,6 +65,10 @@ static pmap *lowered_type;
 
 static ir_nodeset_t created_mux_nodes;
 
+/** Float operations replaced by integer operations once all modes are
+ * lowered. */
+static ir_node **inline_nodes;
+
 /**
  * @return The lowered (floating point) mode.
  */
@@ -80,6 +85,37 @@ static ir_mode *get_lowered_mode(ir_mode *mode)
 	panic("Unsupported floating point type");
 }
 
+static const tarval_mode_info hex_output = {
+	TVO_HEX,
+	"0x",
+	NULL,
+};
+
+/**
+ * @return The bit pattern of a floating point tarval in the lowered mode.
+ */
+static ir_tarval *get_lowered_tarval(ir_tarval *tv)
+{
+	ir_mode *mode         = get_tarval_mode(tv);
+	ir_mode *lowered_mode = get_lowered_mode(mode);
+
+	set_tarval_mode_output_option(mode, &hex_output);
+	char buf[100];
+	tarval_snprintf(buf, sizeof(buf), tv);
+
+	size_t len = strlen(buf);
+	return new_tarval_from_str(buf, len, lowered_mode);
+}
+
+/**
+ * @return The sign bit of a lowered floating point mode.
+ */
+static ir_tarval *get_sign_bit(ir_mode *lowered_mode)
+{
+	unsigned bits = get_mode_size_bits(lowered_mode);
+	return tarval_shl_unsigned(get_mode_one(lowered_mode), bits - 1);
+}
+
 /**
  * Adapts the mode of the given node.
  */
@@ -450,6 +486,152 @@ static void lower_Call(ir_node *node)
 	set_Call_type(node, tp);
 }
 
+/**
+ * @return true if the Cmp @p n compares against a constant such that an
+ *         integer comparison of the bits suffices, see lower_Cmp_inline()
+ */
+static bool is_inline_Cmp(ir_node *n)
+{
+	ir_node     *left     = get_Cmp_left(n);
+	ir_node     *right    = get_Cmp_right(n);
+	ir_relation  relation = get_Cmp_relation(n);
+
+	if (is_Const(left)) {
+		right    = left;
+		relation = get_inversed_relation(relation);
+	}
+	if (!is_Const(right))
+		return false;
+
+	ir_tarval *tv = get_Const_tarval(right);
+	if (tarval_is_NaN(tv))
+		return false;
+	if (relation == ir_relation_equal
+	    || relation == ir_relation_unordered_less_greater)
+		return true;
+	if (!tarval_is_null(tv) && !tarval_is_null(tarval_neg(tv)))
+		return false;
+
+	switch (relation) {
+	case ir_relation_less_equal_greater:
+	case ir_relation_unordered:
+	case ir_relation_less_greater:
+	case ir_relation_unordered_equal:
+	case ir_relation_greater:
+	case ir_relation_unordered_less_equal:
+	case ir_relation_less:
+	case ir_relation_unordered_greater_equal:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * Replaces a float Cmp accepted by is_inline_Cmp() by an integer comparison of
+ * its lowered operands: Non-zero numbers have a unique representation, so
+ * equality compares the bits directly. The other relations to zero reduce to
+ * an unsigned comparison of the bits, with the sign cleared and an offset
+ * subtracted, against the bits of infinity.
+ */
+static void lower_Cmp_inline(ir_node *n)
+{
+	ir_node     *left     = get_Cmp_left(n);
+	ir_node     *right    = get_Cmp_right(n);
+	ir_relation  relation = get_Cmp_relation(n);
+
+	if (is_Const(left)) {
+		ir_node *tmp = left;
+		left     = right;
+		right    = tmp;
+		relation = get_inversed_relation(relation);
+	}
+
+	dbg_info  *dbgi  = get_irn_dbg_info(n);
+	ir_node   *block = get_nodes_block(n);
+	ir_graph  *irg   = get_irn_irg(n);
+	ir_mode   *mode  = get_irn_mode(left);
+	ir_tarval *tv    = get_Const_tarval(right);
+	ir_tarval *sign  = get_sign_bit(mode);
+	ir_tarval *zero  = get_mode_null(mode);
+	ir_tarval *one   = get_mode_one(mode);
+
+	if (tv != zero && tv != sign) {
+		ir_relation int_relation = relation == ir_relation_equal
+			? ir_relation_equal : ir_relation_less_greater;
+		exchange(n, new_rd_Cmp(dbgi, block, left, right, int_relation));
+		return;
+	}
+
+	/* the bits of infinity are the exponent mask */
+	ir_mode   *float_mode = mode == mode_Iu ? mode_F : mode_D;
+	ir_tarval *inf        = get_lowered_tarval(get_mode_infinite(float_mode));
+
+	/* compare value - offset against bound */
+	bool        magnitude = true;
+	ir_tarval  *offset    = zero;
+	ir_tarval  *bound     = inf;
+	ir_relation int_relation;
+	switch (relation) {
+	case ir_relation_equal:
+		bound        = zero;
+		int_relation = ir_relation_equal;
+		break;
+	case ir_relation_unordered_less_greater:
+		bound        = zero;
+		int_relation = ir_relation_less_greater;
+		break;
+	case ir_relation_less_equal_greater:
+		int_relation = ir_relation_less_equal;
+		break;
+	case ir_relation_unordered:
+		int_relation = ir_relation_greater;
+		break;
+	case ir_relation_less_greater:
+		offset       = one;
+		int_relation = ir_relation_less;
+		break;
+	case ir_relation_unordered_equal:
+		offset       = one;
+		int_relation = ir_relation_greater_equal;
+		break;
+	case ir_relation_greater:
+		magnitude    = false;
+		offset       = one;
+		int_relation = ir_relation_less;
+		break;
+	case ir_relation_unordered_less_equal:
+		magnitude    = false;
+		offset       = one;
+		int_relation = ir_relation_greater_equal;
+		break;
+	case ir_relation_less:
+		magnitude    = false;
+		offset       = tarval_add(sign, one);
+		int_relation = ir_relation_less;
+		break;
+	case ir_relation_unordered_greater_equal:
+		magnitude    = false;
+		offset       = tarval_add(sign, one);
+		int_relation = ir_relation_greater_equal;
+		break;
+	default:
+		panic("unexpected relation in %+F", n);
+	}
+
+	ir_node *value = left;
+	if (magnitude) {
+		ir_node *mask = new_r_Const(irg, tarval_not(sign));
+		value = new_rd_And(dbgi, block, value, mask, mode);
+	}
+	if (offset != zero) {
+		ir_node *offset_node = new_r_Const(irg, offset);
+		value = new_rd_Sub(dbgi, block, value, offset_node, mode);
+	}
+	ir_node *bound_node = new_r_Const(irg, bound);
+	exchange(n, new_rd_Cmp(dbgi, block, value, bound_node, int_relation));
+}
+
 /**
  * Transforms a Cmp into the appropriate soft float function.
  */
@@ -470,6 +652,11 @@ static void lower_Cmp(ir_node *n)
 	if (! mode_is_float(op_mode))
 		return;
 
+	if (is_inline_Cmp(n)) {
+		ARR_APP1(ir_node*, inline_nodes, n);
+		return;
+	}
+
 	switch (relation) {
 	case ir_relation_false:
 		call_result = zero;
@@ -571,12 +758,6 @@ static void lower_Cmp(ir_node *n)
 	exchange(n, cmp);
 }
 
-static const tarval_mode_info hex_output = {
-	TVO_HEX,
-	"0x",
-	NULL,
-};
-
 /**
  * Adapts floating point constants.
  */
@@ -586,16 +767,8 @@ static void lower_Const(ir_node *n)
 	if (!mode_is_float(mode))
 		return;
 
-	ir_mode *lowered_mode = get_lowered_mode(mode);
-	set_irn_mode(n, lowered_mode);
-
-	set_tarval_mode_output_option(mode, &hex_output);
-	char buf[100];
-	tarval_snprintf(buf, sizeof(buf), get_Const_tarval(n));
-
-	size_t     len = strlen(buf);
-	ir_tarval *tv  = new_tarval_from_str(buf, len, lowered_mode);
-	set_Const_tarval(n, tv);
+	set_irn_mode(n, get_lowered_mode(mode));
+	set_Const_tarval(n, get_lowered_tarval(get_Const_tarval(n)));
 }
 
 /**
@@ -620,7 +793,35 @@ static void lower_Conv(ir_node *n)
 		exchange(n, op);
 		return;
 	}
-	else if (op_mode == mode_Hs || op_mode == mode_Bs) {
+
+	/* Fold conversions of constants, this includes selections between
+	 * constants like booleans. */
+	if (is_Const(op)) {
+		ir_tarval *tv = tarval_convert_to(get_Const_tarval(op), mode);
+		if (tv != tarval_bad) {
+			exchange(n, new_r_Const(irg, tv));
+			return;
+		}
+	} else if (is_Mux(op) && is_Const(get_Mux_false(op))
+	           && is_Const(get_Mux_true(op))) {
+		ir_node   *op_false = get_Mux_false(op);
+		ir_node   *op_true  = get_Mux_true(op);
+		ir_tarval *tv_false = tarval_convert_to(get_Const_tarval(op_false), mode);
+		ir_tarval *tv_true  = tarval_convert_to(get_Const_tarval(op_true), mode);
+		if (tv_false != tarval_bad && tv_true != tarval_bad) {
+			arch_allow_ifconv_func allow_ifconv = be_get_backend_param()->allow_ifconv;
+			ir_node *sel = get_Mux_sel(op);
+			ir_node *mux = new_rd_Mux(dbgi, block, sel,
+			                          new_r_Const(irg, tv_false),
+			                          new_r_Const(irg, tv_true), mode);
+			if (! allow_ifconv(sel, op_false, op_true))
+				ir_nodeset_insert(&created_mux_nodes, mux);
+			exchange(n, mux);
+			return;
+		}
+	}
+
+	if (op_mode == mode_Hs || op_mode == mode_Bs) {
 		op_mode = mode_Is;
 		op     = new_rd_Conv(dbgi, block, op, op_mode);
 	}
@@ -755,35 +956,27 @@ static void lower_Load(ir_node *n)
 }
 
 /**
- * Transforms a Minus into the appropriate soft float function.
+ * Defers a Minus until its operand is lowered, it becomes a flip of the sign
+ * bit then.
  */
 static void lower_Minus(ir_node *n)
 {
-	ir_node         *symconst;
-	ir_node         *block       = get_nodes_block(n);
-	ir_node         *call_result = NULL;
-	dbg_info        *dbgi        = get_irn_dbg_info(n);
-	ir_graph        *irg         = get_irn_irg(n);
-	ir_mode         *mode        = get_irn_mode(n);
-	ir_node         *op          = get_Minus_op(n);
-
-	if (! mode_is_float(mode))
-		return;
-
-	symconst = create_softfloat_symconst(n, "neg");
-
-	ir_node *call;
-	ir_node *call_results;
-	ir_node *in[1]    = {op};
-	ir_node *nomem    = get_irg_no_mem(irg);
-	ir_type *type     = get_softfloat_type(n);
-	ir_mode *res_mode = get_type_mode(get_method_res_type(type, 0));
+	if (mode_is_float(get_irn_mode(n)))
+		ARR_APP1(ir_node*, inline_nodes, n);
+}
 
-	call         = new_rd_Call(dbgi, block, nomem, symconst, 1, in, type);
-	call_results = new_r_Proj(call, mode_T, pn_Call_T_result);
-	call_result  = new_r_Proj(call_results, res_mode, 0);
+/**
+ * Replaces a lowered float Minus by a flip of the sign bit.
+ */
+static void lower_Minus_inline(ir_node *n)
+{
+	dbg_info *dbgi  = get_irn_dbg_info(n);
+	ir_node  *block = get_nodes_block(n);
+	ir_graph *irg   = get_irn_irg(n);
+	ir_mode  *mode  = get_irn_mode(n);
+	ir_node  *sign  = new_r_Const(irg, get_sign_bit(mode));
 
-	exchange(n, call_result);
+	exchange(n, new_rd_Eor(dbgi, block, get_Minus_op(n), sign, mode));
 }
 
 /**
@@ -1035,6 +1228,7 @@ void lower_floating_point(void)
 	FIRM_DBG_REGISTER(dbg, "firm.lower.softfloat");
 
 	ir_prepare_softfloat_lowering();
+	inline_nodes = NEW_ARR_F(ir_node*, 0);
 
 	ir_clear_opcodes_generic_func();
 	ir_register_softloat_lower_function(op_Add,   lower_Add);
@@ -1091,4 +1285,47 @@ void lower_floating_point(void)
 			}
 		}
 	}
+
+	/* the operands of the deferred nodes have their integer modes now */
+	for (i = 0; i < ARR_LEN(inline_nodes); ++i) {
+		ir_node *node = inline_nodes[i];
+		if (is_Minus(node))
+			lower_Minus_inline(node);
+		else
+			lower_Cmp_inline(node);
+	}
+	DEL_ARR_F(inline_nodes);
+	inline_nodes = NULL;
+}
+
+void ir_finish_softfloat_lowering(void)
+{
+	if (lowered_type != NULL) {
+		pmap_destroy(lowered_type);
+		lowered_type = NULL;
+	}
+	binop_tp_d   = NULL;
+	binop_tp_f   = NULL;
+	cmp_tp_d     = NULL;
+	cmp_tp_f     = NULL;
+	unop_tp_d    = NULL;
+	unop_tp_f    = NULL;
+	unop_tp_d_f  = NULL;
+	unop_tp_d_is = NULL;
+	unop_tp_d_iu = NULL;
+	unop_tp_d_ls = NULL;
+	unop_tp_d_lu = NULL;
+	unop_tp_f_d  = NULL;
+	unop_tp_f_is = NULL;
+	unop_tp_f_iu = NULL;
+	unop_tp_f_ls = NULL;
+	unop_tp_f_lu = NULL;
+	unop_tp_is_d = NULL;
+	unop_tp_is_f = NULL;
+	unop_tp_iu_d = NULL;
+	unop_tp_iu_f = NULL;
+	unop_tp_ls_d = NULL;
+	unop_tp_ls_f = NULL;
+	unop_tp_lu_d = NULL;
+	unop_tp_lu_f = NULL;
 }
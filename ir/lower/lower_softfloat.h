@@ -18,4 +18,10 @@
  */
 void lower_floating_point(void);
 
+/**
+ * Forget the method types cached by lower_floating_point(), they belong to
+ * the current program and are recreated for the next one.
+ */
+void ir_finish_softfloat_lowering(void);
+
 #endif
@@ -9,7 +9,10 @@
  * @author  Moritz Kroll
  */
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "array_t.h"
 #include "ircons.h"
@@ -17,9 +20,11 @@
 #include "irgwalk.h"
 #include "irnode_t.h"
 #include "irouts.h"
+#include "execfreq.h"
 #include "lowering.h"
 #include "error.h"
 #include "irnodeset.h"
+#include "util.h"
 
 #define foreach_out_irn(irn, i, outirn) for (i = get_irn_n_outs(irn) - 1;\
 	i >= 0 && (outirn = get_irn_out(irn, i)); --i)
@@ -34,19 +39,60 @@ typedef struct walk_env_t {
 
 typedef struct case_data_t {
 	const ir_switch_table_entry *entry;
-	ir_node                     *target;
+	uint64_t                     min; /**< normalized lower bound */
+	uint64_t                     max; /**< normalized upper bound */
+	double                       weight; /**< share of the executions */
 } case_data_t;
 
+typedef enum cluster_kind_t {
+	CLUSTER_CASE,     /**< a single case tested by a compare */
+	CLUSTER_TABLE,    /**< dense cases dispatched by a table Switch */
+	CLUSTER_BIT_TEST, /**< cases of few targets tested by a shifted bit */
+} cluster_kind_t;
+
+/**
+ * A run of consecutive (sorted) cases which is dispatched as a unit at a
+ * leaf of the binary search.
+ */
+typedef struct case_cluster_t {
+	cluster_kind_t  kind;
+	case_data_t    *cases;
+	unsigned        num_cases;
+} case_cluster_t;
+
 typedef struct switch_info_t {
+	walk_env_t  *env;
 	ir_node     *switchn;
 	ir_tarval   *switch_min;
 	ir_tarval   *switch_max;
 	ir_node     *default_block;
 	unsigned     num_cases;
 	case_data_t *cases;
+	bool         has_values;  /**< case bounds are available as integers */
+	unsigned     n_outs;
+	ir_node    **targets;     /**< the target block of each Switch output */
+	double      *pn_weights;  /**< frequency of each case of an output */
+	double       total_weight; /**< frequency of the Switch */
+	double       max_weight;  /**< frequency of the hottest case */
+	ir_node   ***case_preds;  /**< new control flow preds of the targets */
 	ir_node    **defusers;    /**< the Projs pointing to the default case */
 } switch_info_t;
 
+/**
+ * Returns the execution frequency of the target block of a Switch output.
+ */
+static double get_target_freq(const ir_node *block)
+{
+	double freq = get_block_execfreq(block);
+	/* blocks splitting critical edges are new and have no frequency yet,
+	 * assume they carry an equal share of their successor */
+	if (freq == 0.0 && get_Block_n_cfg_outs(block) == 1) {
+		const ir_node *succ = get_Block_cfg_out(block, 0);
+		freq = get_block_execfreq(succ) / get_Block_n_cfgpreds(succ);
+	}
+	return freq;
+}
+
 /**
  * analyze enough to decide if we should lower the switch
  */
@@ -58,6 +104,23 @@ static void analyse_switch0(switch_info_t *info, ir_node *switchn)
 	ir_tarval             *switch_min = get_mode_max(mode);
 	ir_tarval             *switch_max = get_mode_min(mode);
 	unsigned               num_cases  = 0;
+	unsigned               n_outs     = get_Switch_n_outs(switchn);
+	ir_node              **targets    = XMALLOCNZ(ir_node*, n_outs);
+	double                *weights    = XMALLOCNZ(double, n_outs);
+	unsigned              *pn_cases   = XMALLOCNZ(unsigned, n_outs);
+	double                 total      = 0.0;
+	double                 max_weight = 0.0;
+	int                    i;
+	ir_node               *proj;
+
+	foreach_out_irn(switchn, i, proj) {
+		long     pn     = get_Proj_proj(proj);
+		ir_node *target = get_irn_out(proj, 0);
+
+		assert((unsigned)pn < n_outs);
+		assert(targets[(unsigned)pn] == NULL);
+		targets[(unsigned)pn] = target;
+	}
 
 	for (size_t e = 0; e < n_entries; ++e) {
 		const ir_switch_table_entry *entry
@@ -70,13 +133,43 @@ static void analyse_switch0(switch_info_t *info, ir_node *switchn)
 		if (tarval_cmp(entry->max, switch_max) == ir_relation_greater)
 			switch_max = entry->max;
 
+		++pn_cases[entry->pn];
 		++num_cases;
 	}
 
-	info->switchn    = switchn;
-	info->switch_min = switch_min;
-	info->switch_max = switch_max;
-	info->num_cases  = num_cases;
+	/* spread the frequency of each output evenly over its cases */
+	for (unsigned pn = 0; pn < n_outs; ++pn) {
+		if (targets[pn] == NULL)
+			continue;
+		double freq = get_target_freq(targets[pn]);
+		total += freq;
+		if (pn == pn_Switch_default || pn_cases[pn] == 0)
+			continue;
+		weights[pn] = freq / pn_cases[pn];
+		if (weights[pn] > max_weight)
+			max_weight = weights[pn];
+	}
+	free(pn_cases);
+
+	info->switchn      = switchn;
+	info->switch_min   = switch_min;
+	info->switch_max   = switch_max;
+	info->num_cases    = num_cases;
+	info->n_outs       = n_outs;
+	info->targets      = targets;
+	info->pn_weights   = weights;
+	info->total_weight = total;
+	info->max_weight   = max_weight;
+}
+
+/**
+ * Returns true if a single case is executed at least as often as all others
+ * together, so it pays off to test it before dispatching the rest.
+ */
+static bool is_hot_case(const switch_info_t *info, double weight)
+{
+	return info->total_weight > 0.0 && weight > 0.0
+	    && 2 * weight >= info->total_weight;
 }
 
 static int casecmp(const void *a, const void *b)
@@ -96,6 +189,20 @@ static int casecmp(const void *a, const void *b)
 	return 1;
 }
 
+/**
+ * Returns the value of a normalized (unsigned) case bound.
+ */
+static uint64_t get_case_value(ir_tarval *tv)
+{
+	if (tarval_is_long(tv))
+		return (uint64_t)get_tarval_long(tv);
+	/* the upper half of an unsigned mode does not fit into a long */
+	ir_mode *mode = get_tarval_mode(tv);
+	uint64_t mask = UINT64_MAX >> (64 - get_mode_size_bits(mode));
+	tv = tarval_convert_to(tv, find_signed_mode(mode));
+	return (uint64_t)get_tarval_long(tv) & mask;
+}
+
 /**
  * Analyse the stuff that anayse_switch0() left out
  */
@@ -104,23 +211,17 @@ static void analyse_switch1(switch_info_t *info)
 	const ir_node         *switchn   = info->switchn;
 	const ir_switch_table *table     = get_Switch_table(switchn);
 	size_t                 n_entries = ir_switch_table_get_n_entries(table);
-	unsigned               n_outs    = get_Switch_n_outs(switchn);
-	ir_node              **targets   = XMALLOCNZ(ir_node*, n_outs);
+	unsigned               n_outs    = info->n_outs;
 	unsigned               num_cases = info->num_cases;
 	case_data_t           *cases     = XMALLOCN(case_data_t, num_cases);
+	ir_mode               *mode      = get_irn_mode(get_Switch_selector(switchn));
+	/* without frequencies all cases are equally likely */
+	bool                   uniform   = info->total_weight == 0.0;
 	unsigned               c         = 0;
 	size_t                 e;
-	int                    i;
-	ir_node               *proj;
 
-	foreach_out_irn(switchn, i, proj) {
-		long     pn     = get_Proj_proj(proj);
-		ir_node *target = get_irn_out(proj, 0);
-
-		assert((unsigned)pn < n_outs);
-		assert(targets[(unsigned)pn] == NULL);
-		targets[(unsigned)pn] = target;
-	}
+	info->has_values = get_mode_size_bits(mode) <= 64
+	                && get_mode_size_bits(mode) <= sizeof(long) * CHAR_BIT;
 
 	for (e = 0; e < n_entries; ++e) {
 		const ir_switch_table_entry *entry
@@ -129,7 +230,9 @@ static void analyse_switch1(switch_info_t *info)
 			continue;
 
 		cases[c].entry  = entry;
-		cases[c].target = targets[entry->pn];
+		cases[c].min    = info->has_values ? get_case_value(entry->min) : 0;
+		cases[c].max    = info->has_values ? get_case_value(entry->max) : 0;
+		cases[c].weight = uniform ? 1.0 : info->pn_weights[entry->pn];
 		++c;
 	}
 	assert(c == num_cases);
@@ -140,9 +243,11 @@ static void analyse_switch1(switch_info_t *info)
 	 */
 	qsort(cases, num_cases, sizeof(cases[0]), casecmp);
 
-	info->default_block = targets[pn_Switch_default];
+	info->default_block = info->targets[pn_Switch_default];
 	info->cases         = cases;
-	free(targets);
+	info->case_preds    = XMALLOCN(ir_node**, n_outs);
+	for (unsigned pn = 0; pn < n_outs; ++pn)
+		info->case_preds[pn] = NEW_ARR_F(ir_node*, 0);
 }
 
 static void normalize_table(ir_node *switchn, ir_mode *new_mode,
@@ -331,59 +436,411 @@ static ir_node *create_case_cond(const ir_switch_table_entry *entry,
 }
 
 /**
- * Creates an if cascade realizing binary search.
+ * Returns the number of single case clusters at the start of @p clusters
+ * worth merging into a bit test, or 0 if there are too few of them.
+ */
+static unsigned get_bit_test_length(const case_cluster_t *clusters,
+                                    unsigned n_clusters, unsigned word_bits)
+{
+	uint64_t min    = clusters[0].cases->min;
+	long     pns[3];
+	unsigned n_pns  = 0;
+	unsigned length = 0;
+
+	for (unsigned c = 0; c < n_clusters; ++c) {
+		const case_data_t *cas = clusters[c].cases;
+		if (clusters[c].kind != CLUSTER_CASE || cas->max - min >= word_bits)
+			break;
+
+		unsigned p = 0;
+		while (p < n_pns && pns[p] != cas->entry->pn)
+			++p;
+		if (p == n_pns) {
+			if (n_pns == ARRAY_SIZE(pns))
+				break;
+			pns[n_pns++] = cas->entry->pn;
+		}
+
+		/* a bit test costs a shift plus a test per target, so it pays off
+		 * for at least 3, 5 or 6 cases with 1, 2 or 3 targets */
+		unsigned min_cases = n_pns == 1 ? 3 : n_pns == 2 ? 5 : 6;
+		if (c + 1 >= min_cases)
+			length = c + 1;
+	}
+	return length;
+}
+
+/**
+ * Partitions the sorted cases into clusters. Dynamic programming finds the
+ * minimal number of jump tables and single cases, then runs of single cases
+ * with few targets over a small range are merged into bit tests.
+ *
+ * @return the number of clusters
+ */
+static unsigned cluster_cases(const switch_info_t *info,
+                              case_cluster_t *clusters)
+{
+	const walk_env_t *env       = info->env;
+	case_data_t      *cases     = info->cases;
+	unsigned          num_cases = info->num_cases;
+
+	if (!info->has_values) {
+		for (unsigned c = 0; c < num_cases; ++c) {
+			clusters[c].kind      = CLUSTER_CASE;
+			clusters[c].cases     = &cases[c];
+			clusters[c].num_cases = 1;
+		}
+		return num_cases;
+	}
+
+	/* min_clusters[j] is the minimal number of clusters for the first j
+	 * cases, first_case[j] the first case of the last of them */
+	unsigned *min_clusters = XMALLOCN(unsigned, num_cases + 1);
+	unsigned *first_case   = XMALLOCN(unsigned, num_cases + 1);
+	min_clusters[0] = 0;
+	for (unsigned j = 1; j <= num_cases; ++j) {
+		min_clusters[j] = min_clusters[j - 1] + 1;
+		first_case[j]   = j - 1;
+		for (unsigned i = j - 1; i-- > 0; ) {
+			/* the spare entries only grow when adding cases to the left */
+			uint64_t spare = cases[j - 1].max - cases[i].min + 1 - (j - i);
+			if (spare >= env->spare_size)
+				break;
+			if (j - i > env->small_switch
+			    && min_clusters[i] + 1 < min_clusters[j]) {
+				min_clusters[j] = min_clusters[i] + 1;
+				first_case[j]   = i;
+			}
+		}
+	}
+
+	unsigned        n_tables = min_clusters[num_cases];
+	case_cluster_t *tables   = XMALLOCN(case_cluster_t, n_tables);
+	for (unsigned j = num_cases, t = n_tables; j > 0; j = first_case[j]) {
+		case_cluster_t *cluster = &tables[--t];
+		cluster->cases     = &cases[first_case[j]];
+		cluster->num_cases = j - first_case[j];
+		cluster->kind      = cluster->num_cases > 1 ? CLUSTER_TABLE
+		                                            : CLUSTER_CASE;
+	}
+	free(first_case);
+	free(min_clusters);
+
+	unsigned word_bits = get_mode_size_bits(env->selector_mode);
+	if (word_bits > sizeof(long) * CHAR_BIT)
+		word_bits = sizeof(long) * CHAR_BIT;
+
+	unsigned n_clusters = 0;
+	for (unsigned t = 0; t < n_tables; ) {
+		unsigned length = get_bit_test_length(&tables[t], n_tables - t,
+		                                      word_bits);
+		if (length > 0) {
+			case_cluster_t *cluster = &clusters[n_clusters++];
+			cluster->kind      = CLUSTER_BIT_TEST;
+			cluster->cases     = tables[t].cases;
+			cluster->num_cases = length;
+			t += length;
+		} else {
+			clusters[n_clusters++] = tables[t++];
+		}
+	}
+	free(tables);
+	return n_clusters;
+}
+
+/**
+ * Subtracts the lower bound of @p cluster from the selector and branches to
+ * the default case if the result exceeds the cluster range, unless the
+ * binary search already guarantees that it does not.
+ *
+ * @return the offset of the selector into the cluster
+ */
+static ir_node *create_cluster_offset(switch_info_t *info, ir_node **block,
+                                      const case_cluster_t *cluster,
+                                      bool in_range)
+{
+	ir_graph  *irg      = get_irn_irg(*block);
+	dbg_info  *dbgi     = get_irn_dbg_info(info->switchn);
+	ir_node   *selector = get_Switch_selector(info->switchn);
+	ir_mode   *mode     = get_irn_mode(selector);
+	ir_tarval *min      = cluster->cases[0].entry->min;
+	ir_tarval *max      = cluster->cases[cluster->num_cases - 1].entry->max;
+	ir_node   *offset   = selector;
+
+	if (!tarval_is_null(min)) {
+		ir_node *min_const = new_r_Const(irg, min);
+		offset = new_rd_Sub(dbgi, *block, selector, min_const, mode);
+	}
+	if (!in_range) {
+		ir_node *range = new_r_Const(irg, tarval_sub(max, min, NULL));
+		ir_node *cmp   = new_rd_Cmp(dbgi, *block, offset, range,
+		                            ir_relation_less_equal);
+		ir_node *cond  = new_rd_Cond(dbgi, *block, cmp);
+		ir_node *in[1] = { new_r_Proj(cond, mode_X, pn_Cond_true) };
+
+		ARR_APP1(ir_node*, info->defusers,
+		         new_r_Proj(cond, mode_X, pn_Cond_false));
+		*block = new_r_Block(irg, 1, in);
+	}
+	return offset;
+}
+
+/**
+ * Creates a Switch dispatching the cases of a jump table cluster.
+ */
+static void create_table_cluster(switch_info_t *info, ir_node *block,
+                                 const case_cluster_t *cluster, bool in_range)
+{
+	ir_graph        *irg     = get_irn_irg(block);
+	dbg_info        *dbgi    = get_irn_dbg_info(info->switchn);
+	ir_mode         *mode    = info->env->selector_mode;
+	ir_tarval       *min     = cluster->cases[0].entry->min;
+	ir_node         *offset  = create_cluster_offset(info, &block, cluster,
+	                                                 in_range);
+	ir_switch_table *table   = ir_new_switch_table(irg, cluster->num_cases);
+	unsigned        *new_pns = XMALLOCNZ(unsigned, info->n_outs);
+	unsigned         n_outs  = pn_Switch_max + 1;
+
+	for (unsigned c = 0; c < cluster->num_cases; ++c) {
+		const ir_switch_table_entry *entry = cluster->cases[c].entry;
+		ir_tarval *entry_min = tarval_sub(entry->min, min, NULL);
+		ir_tarval *entry_max = tarval_sub(entry->max, min, NULL);
+
+		if (new_pns[entry->pn] == 0)
+			new_pns[entry->pn] = n_outs++;
+		ir_switch_table_set(table, c, tarval_convert_to(entry_min, mode),
+		                    tarval_convert_to(entry_max, mode),
+		                    new_pns[entry->pn]);
+	}
+
+	ir_node *selector = new_rd_Conv(dbgi, block, offset, mode);
+	ir_node *switchn  = new_rd_Switch(dbgi, block, selector, n_outs, table);
+	/* the new Switch is already lowered */
+	ir_nodeset_insert(&info->env->processed, switchn);
+
+	ARR_APP1(ir_node*, info->defusers,
+	         new_r_Proj(switchn, mode_X, pn_Switch_default));
+	for (unsigned pn = 0; pn < info->n_outs; ++pn) {
+		if (new_pns[pn] == 0)
+			continue;
+		ARR_APP1(ir_node*, info->case_preds[pn],
+		         new_r_Proj(switchn, mode_X, new_pns[pn]));
+	}
+	free(new_pns);
+}
+
+/**
+ * Tests the cases of a bit test cluster by shifting a bit by the selector
+ * offset and masking it with the set of cases of each target.
+ */
+static void create_bit_test_cluster(switch_info_t *info, ir_node *block,
+                                    const case_cluster_t *cluster,
+                                    bool in_range)
+{
+	ir_graph *irg    = get_irn_irg(block);
+	dbg_info *dbgi   = get_irn_dbg_info(info->switchn);
+	ir_mode  *mode   = info->env->selector_mode;
+	ir_node  *offset = create_cluster_offset(info, &block, cluster, in_range);
+	uint64_t  min    = cluster->cases[0].min;
+	uint64_t  range  = cluster->cases[cluster->num_cases - 1].max - min;
+	uint64_t  all    = UINT64_MAX >> (63 - range);
+	uint64_t  masks[3];
+	double    weights[3];
+	long      pns[3];
+	unsigned  n_pns  = 0;
+
+	for (unsigned c = 0; c < cluster->num_cases; ++c) {
+		const case_data_t *cas = &cluster->cases[c];
+		unsigned           p   = 0;
+		while (p < n_pns && pns[p] != cas->entry->pn)
+			++p;
+		if (p == n_pns) {
+			assert(n_pns < ARRAY_SIZE(pns));
+			pns[n_pns]     = cas->entry->pn;
+			masks[n_pns]   = 0;
+			weights[n_pns] = 0.0;
+			++n_pns;
+		}
+		for (uint64_t v = cas->min - min; v <= cas->max - min; ++v)
+			masks[p] |= (uint64_t)1 << v;
+		weights[p] += cas->weight;
+	}
+
+	/* test the hottest targets first */
+	for (unsigned p = 1; p < n_pns; ++p) {
+		for (unsigned q = p; q > 0 && weights[q] > weights[q - 1]; --q) {
+			long     pn     = pns[q];
+			uint64_t mask   = masks[q];
+			double   weight = weights[q];
+			pns[q]         = pns[q - 1];
+			masks[q]       = masks[q - 1];
+			weights[q]     = weights[q - 1];
+			pns[q - 1]     = pn;
+			masks[q - 1]   = mask;
+			weights[q - 1] = weight;
+		}
+	}
+
+	ir_node *one   = new_r_Const(irg, get_mode_one(mode));
+	ir_node *shift = new_rd_Conv(dbgi, block, offset, mode);
+	ir_node *bit   = new_rd_Shl(dbgi, block, one, shift, mode);
+	ir_node *zero  = new_r_Const(irg, get_mode_null(mode));
+	uint64_t tested = 0;
+	for (unsigned p = 0; p < n_pns; ++p) {
+		tested |= masks[p];
+		if (p == n_pns - 1 && tested == all) {
+			/* no holes left, the last target needs no test */
+			ARR_APP1(ir_node*, info->case_preds[pns[p]], new_r_Jmp(block));
+			break;
+		}
+
+		ir_tarval *mask = new_tarval_from_long((long)masks[p],
+		                                       find_signed_mode(mode));
+		ir_node   *mask_const = new_r_Const(irg, tarval_convert_to(mask, mode));
+		ir_node   *and  = new_rd_And(dbgi, block, bit, mask_const, mode);
+		ir_node   *cmp  = new_rd_Cmp(dbgi, block, and, zero,
+		                             ir_relation_less_greater);
+		ir_node   *cond = new_rd_Cond(dbgi, block, cmp);
+		ir_node   *in[1];
+
+		ARR_APP1(ir_node*, info->case_preds[pns[p]],
+		         new_r_Proj(cond, mode_X, pn_Cond_true));
+		in[0] = new_r_Proj(cond, mode_X, pn_Cond_false);
+		if (p == n_pns - 1) {
+			ARR_APP1(ir_node*, info->defusers, in[0]);
+		} else {
+			block = new_r_Block(irg, 1, in);
+		}
+	}
+}
+
+/**
+ * Creates the code dispatching the cases of @p cluster. The selector is
+ * known to lie in [lower, upper].
+ */
+static void create_cluster(switch_info_t *info, ir_node *block,
+                           const case_cluster_t *cluster,
+                           uint64_t lower, uint64_t upper)
+{
+	bool in_range = info->has_values
+		&& lower >= cluster->cases[0].min
+		&& upper <= cluster->cases[cluster->num_cases - 1].max;
+
+	switch (cluster->kind) {
+	case CLUSTER_CASE: {
+		const ir_switch_table_entry *entry = cluster->cases[0].entry;
+		if (in_range) {
+			ARR_APP1(ir_node*, info->case_preds[entry->pn], new_r_Jmp(block));
+			return;
+		}
+		dbg_info *dbgi      = get_irn_dbg_info(info->switchn);
+		ir_node  *selector  = get_Switch_selector(info->switchn);
+		ir_node  *cond      = create_case_cond(entry, dbgi, block, selector);
+		ir_node  *trueproj  = new_r_Proj(cond, mode_X, pn_Cond_true);
+		ir_node  *falseproj = new_r_Proj(cond, mode_X, pn_Cond_false);
+
+		ARR_APP1(ir_node*, info->case_preds[entry->pn], trueproj);
+		ARR_APP1(ir_node*, info->defusers, falseproj);
+		return;
+	}
+	case CLUSTER_TABLE:
+		create_table_cluster(info, block, cluster, in_range);
+		return;
+	case CLUSTER_BIT_TEST:
+		create_bit_test_cluster(info, block, cluster, in_range);
+		return;
+	}
+	panic("invalid switch cluster");
+}
+
+/**
+ * Returns the summed weight of the cases of @p cluster.
+ */
+static double get_cluster_weight(const case_cluster_t *cluster)
+{
+	double weight = 0.0;
+	for (unsigned c = 0; c < cluster->num_cases; ++c)
+		weight += cluster->cases[c].weight;
+	return weight;
+}
+
+/**
+ * Returns the index of the first cluster of the right half when splitting
+ * @p clusters into two halves of about equal weight. With equal weights this
+ * is the middle, otherwise hot cases end up higher in the search tree.
+ */
+static unsigned find_weighted_median(const case_cluster_t *clusters,
+                                     unsigned n_clusters)
+{
+	double total = 0.0;
+	for (unsigned c = 0; c < n_clusters; ++c)
+		total += get_cluster_weight(&clusters[c]);
+
+	unsigned best      = n_clusters / 2;
+	double   best_diff = -1.0;
+	double   left      = 0.0;
+	for (unsigned c = 1; c < n_clusters; ++c) {
+		left += get_cluster_weight(&clusters[c - 1]);
+		double diff = fabs(total - 2 * left);
+		if (best_diff < 0.0 || diff < best_diff) {
+			best      = c;
+			best_diff = diff;
+		}
+	}
+	return best;
+}
+
+/**
+ * Creates an if cascade realizing binary search over the clusters. The
+ * selector is known to lie in [lower, upper].
  */
 static void create_if_cascade(switch_info_t *info, ir_node *block,
-                              case_data_t *curcases, unsigned numcases)
+                              const case_cluster_t *clusters,
+                              unsigned n_clusters,
+                              uint64_t lower, uint64_t upper)
 {
 	ir_graph      *irg      = get_irn_irg(block);
 	const ir_node *switchn  = info->switchn;
 	dbg_info      *dbgi     = get_irn_dbg_info(switchn);
 	ir_node       *selector = get_Switch_selector(switchn);
 
-	if (numcases == 0) {
+	if (n_clusters == 0) {
 		/* zero cases: "goto default;" */
 		ARR_APP1(ir_node*, info->defusers, new_r_Jmp(block));
-	} else if (numcases == 1) {
-		/*only one case: "if (sel == val) goto target else goto default;"*/
-		const ir_switch_table_entry *entry = curcases[0].entry;
-		ir_node *cond      = create_case_cond(entry, dbgi, block, selector);
-		ir_node *trueproj  = new_r_Proj(cond, mode_X, pn_Cond_true);
-		ir_node *falseproj = new_r_Proj(cond, mode_X, pn_Cond_false);
-
-		set_Block_cfgpred(curcases[0].target, 0, trueproj);
-		ARR_APP1(ir_node*, info->defusers, falseproj);
-	} else if (numcases == 2) {
-		/* only two cases: "if (sel == val[0]) goto target[0];" */
-		const ir_switch_table_entry *entry0 = curcases[0].entry;
-		const ir_switch_table_entry *entry1 = curcases[1].entry;
+	} else if (n_clusters == 1) {
+		create_cluster(info, block, &clusters[0], lower, upper);
+	} else if (n_clusters == 2 && (clusters[0].kind == CLUSTER_CASE
+	                               || clusters[1].kind == CLUSTER_CASE)) {
+		/* two clusters: "if (sel == val[first]) goto target[first];",
+		 * testing the hotter single case first */
+		unsigned first = clusters[0].kind != CLUSTER_CASE
+		              || (clusters[1].kind == CLUSTER_CASE
+		                  && clusters[1].cases[0].weight
+		                     > clusters[0].cases[0].weight);
+		const ir_switch_table_entry *entry0 = clusters[first].cases[0].entry;
 		ir_node *cond      = create_case_cond(entry0, dbgi, block, selector);
 		ir_node *trueproj  = new_r_Proj(cond, mode_X, pn_Cond_true);
 		ir_node *falseproj = new_r_Proj(cond, mode_X, pn_Cond_false);
 		ir_node *in[1];
 		ir_node *neblock;
 
-		set_Block_cfgpred(curcases[0].target, 0, trueproj);
+		ARR_APP1(ir_node*, info->case_preds[entry0->pn], trueproj);
 
 		in[0] = falseproj;
 		neblock = new_r_Block(irg, 1, in);
 
-		/* second part: "else if (sel == val[1]) goto target[1] else goto default;" */
-		cond      = create_case_cond(entry1, dbgi, neblock, selector);
-		trueproj  = new_r_Proj(cond, mode_X, pn_Cond_true);
-		falseproj = new_r_Proj(cond, mode_X, pn_Cond_false);
-		set_Block_cfgpred(curcases[1].target, 0, trueproj);
-		ARR_APP1(ir_node*, info->defusers, falseproj);
+		/* second part: "else dispatch the other cluster" */
+		create_cluster(info, neblock, &clusters[1 - first], lower, upper);
 	} else {
-		/* recursive case: split cases in the middle */
-		unsigned midcase = numcases / 2;
-		const ir_switch_table_entry *entry = curcases[midcase].entry;
-		ir_node *val = new_r_Const(irg, entry->min);
-		ir_node *cmp = new_rd_Cmp(dbgi, block, selector, val, ir_relation_less);
-		ir_node *cond = new_rd_Cond(dbgi, block, cmp);
-		ir_node *in[1];
-		ir_node *ltblock;
-		ir_node *geblock;
+		/* recursive case: split clusters where the weight is halved */
+		unsigned   midcluster = find_weighted_median(clusters, n_clusters);
+		case_data_t *midcase  = clusters[midcluster].cases;
+		ir_node   *val  = new_r_Const(irg, midcase->entry->min);
+		ir_node   *cmp  = new_rd_Cmp(dbgi, block, selector, val, ir_relation_less);
+		ir_node   *cond = new_rd_Cond(dbgi, block, cmp);
+		ir_node   *in[1];
+		ir_node   *ltblock;
+		ir_node   *geblock;
 
 		in[0]   = new_r_Proj(cond, mode_X, pn_Cond_true);
 		ltblock = new_r_Block(irg, 1, in);
@@ -391,9 +848,80 @@ static void create_if_cascade(switch_info_t *info, ir_node *block,
 		in[0]   = new_r_Proj(cond, mode_X, pn_Cond_false);
 		geblock = new_r_Block(irg, 1, in);
 
-		create_if_cascade(info, ltblock, curcases, midcase);
-		create_if_cascade(info, geblock, curcases + midcase, numcases - midcase);
+		create_if_cascade(info, ltblock, clusters, midcluster,
+		                  lower, midcase->min - 1);
+		create_if_cascade(info, geblock, clusters + midcluster,
+		                  n_clusters - midcluster, midcase->min, upper);
+	}
+}
+
+/**
+ * Tests the cases executed at least as often as all remaining cases together
+ * (with the default) one after the other and removes them from the cases
+ * left for the binary search.
+ *
+ * @return the block dispatching the remaining cases
+ */
+static ir_node *peel_hot_cases(switch_info_t *info, ir_node *block)
+{
+	ir_graph *irg      = get_irn_irg(block);
+	dbg_info *dbgi     = get_irn_dbg_info(info->switchn);
+	ir_node  *selector = get_Switch_selector(info->switchn);
+
+	while (info->num_cases > 0) {
+		case_data_t *cases   = info->cases;
+		unsigned     hottest = 0;
+		for (unsigned c = 1; c < info->num_cases; ++c) {
+			if (cases[c].weight > cases[hottest].weight)
+				hottest = c;
+		}
+		if (!is_hot_case(info, cases[hottest].weight))
+			break;
+
+		const ir_switch_table_entry *entry = cases[hottest].entry;
+		ir_node *cond  = create_case_cond(entry, dbgi, block, selector);
+		ir_node *in[1] = { new_r_Proj(cond, mode_X, pn_Cond_false) };
+
+		ARR_APP1(ir_node*, info->case_preds[entry->pn],
+		         new_r_Proj(cond, mode_X, pn_Cond_true));
+		block = new_r_Block(irg, 1, in);
+
+		info->total_weight -= cases[hottest].weight;
+		--info->num_cases;
+		memmove(&cases[hottest], &cases[hottest + 1],
+		        (info->num_cases - hottest) * sizeof(cases[0]));
 	}
+	return block;
+}
+
+/**
+ * Sets the control flow predecessors of @p block, which had a single
+ * predecessor so far, and adapts its Phis.
+ */
+static void set_block_preds(ir_node *block, ir_node **preds)
+{
+	int      n_preds = ARR_LEN(preds);
+	int      i;
+	ir_node *out;
+
+	if (n_preds == 0) {
+		/* the Switch output was unreachable */
+		ir_node *bad = new_r_Bad(get_irn_irg(block), mode_X);
+		set_irn_in(block, 1, &bad);
+		return;
+	}
+	if (n_preds > 1) {
+		ir_node **phi_in = XMALLOCN(ir_node*, n_preds);
+		foreach_out_irn(block, i, out) {
+			if (!is_Phi(out) || get_nodes_block(out) != block)
+				continue;
+			for (int p = 0; p < n_preds; ++p)
+				phi_in[p] = get_Phi_pred(out, 0);
+			set_irn_in(out, n_preds, phi_in);
+		}
+		free(phi_in);
+	}
+	set_irn_in(block, n_preds, preds);
 }
 
 /**
@@ -424,6 +952,7 @@ static void find_switch_nodes(ir_node *block, void *ctx)
 		return;
 
 	analyse_switch0(&info, switchn);
+	info.env = env;
 
 	/*
 	 * Here we have: num_cases and [switch_min, switch_max] interval.
@@ -438,28 +967,47 @@ static void find_switch_nodes(ir_node *block, void *ctx)
 	spare = tarval_sub(spare, num_cases_minus_one, mode);
 	ir_tarval *spare_size = new_tarval_from_long(env->spare_size, mode);
 	bool lower_switch = (info.num_cases <= env->small_switch
-	 || (tarval_cmp(spare, spare_size) & ir_relation_greater_equal));
+	 || (tarval_cmp(spare, spare_size) & ir_relation_greater_equal)
+	 || is_hot_case(&info, info.max_weight));
 
 	if (!lower_switch) {
 		/* we won't decompose the switch. But we must add an out-of-bounds
 		 * check */
 		normalize_switch(&info, env->selector_mode);
+		free(info.pn_weights);
+		free(info.targets);
 		return;
 	}
 
 	normalize_switch(&info, NULL);
 	analyse_switch1(&info);
 
-	/* Now create the if cascade */
 	env->changed  = true;
 	info.defusers = NEW_ARR_F(ir_node*, 0);
-	block         = get_nodes_block(switchn);
-	create_if_cascade(&info, block, info.cases, info.num_cases);
-
-	/* Connect new default case users */
-	set_irn_in(info.default_block, ARR_LEN(info.defusers), info.defusers);
+	block         = peel_hot_cases(&info, get_nodes_block(switchn));
+
+	/* Split the cases into clusters and binary search over them */
+	case_cluster_t *clusters   = XMALLOCN(case_cluster_t, info.num_cases);
+	unsigned        n_clusters = cluster_cases(&info, clusters);
+	unsigned        mode_bits  = get_mode_size_bits(mode);
+	uint64_t        upper      = info.has_values
+		? UINT64_MAX >> (64 - mode_bits) : UINT64_MAX;
+
+	create_if_cascade(&info, block, clusters, n_clusters, 0, upper);
+
+	/* Connect new default and case users */
+	set_block_preds(info.default_block, info.defusers);
+	for (unsigned pn = 0; pn < info.n_outs; ++pn) {
+		if (pn != pn_Switch_default && info.targets[pn] != NULL)
+			set_block_preds(info.targets[pn], info.case_preds[pn]);
+		DEL_ARR_F(info.case_preds[pn]);
+	}
 
 	DEL_ARR_F(info.defusers);
+	free(info.case_preds);
+	free(info.pn_weights);
+	free(info.targets);
+	free(clusters);
 	free(info.cases);
 	clear_irg_properties(get_irn_irg(block), IR_GRAPH_PROPERTY_NO_CRITICAL_EDGES
 	                                  | IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
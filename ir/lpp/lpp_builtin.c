@@ -0,0 +1,485 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2013 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Built-in branch and bound solver for small ILPs.
+ *
+ * The problem is brought into the form
+ *
+ *    min c^T x   s.t.   A x + s = b,   lb <= (x, s) <= ub
+ *
+ * with one slack per constraint whose bounds encode the constraint type.
+ * The slacks form a dual feasible starting basis if every structural
+ * variable sits at the bound its cost prefers, so the LP relaxation is
+ * solved by the bounded dual simplex alone, on a dense tableau.
+ *
+ * Branching fixes a binary variable by changing its bounds, which keeps the
+ * basis dual feasible. Every node thus reoptimizes from the tableau its
+ * predecessor left behind, the search needs no copies of the tableau.
+ */
+#include "lpp_builtin.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sp_matrix.h"
+#include "timing.h"
+#include "util.h"
+#include "xmalloc.h"
+
+/** Tolerance for bound violations and integrality. */
+#define BNB_FEAS_EPS  1e-7
+/** Smallest tableau entry used as pivot. */
+#define BNB_PIVOT_EPS 1e-9
+/** Bound for continuous variables with negative costs. */
+#define BNB_BIG       1e9
+/** Largest tableau handled, in entries. */
+#define BNB_MAX_TABLEAU (1u << 23)
+
+typedef enum lp_result_t {
+	LP_OPTIMAL,
+	LP_INFEASIBLE,
+	LP_ABORTED,
+} lp_result_t;
+
+typedef struct bnb_t {
+	lpp_t    *lpp;
+	int       n_cols;     /**< number of structural variables */
+	int       n_rows;     /**< number of constraints */
+	int       n;          /**< number of variables including the slacks */
+	double   *tab;        /**< the tableau B^-1 (A I), row major */
+	double   *d;          /**< the reduced costs */
+	double   *x;          /**< the values of all variables */
+	double   *lb;         /**< the lower bounds */
+	double   *ub;         /**< the upper bounds */
+	double   *cost;       /**< the costs of the structural variables */
+	int      *basis;      /**< the basic variable of each row */
+	int      *row;        /**< the row of each basic variable, -1 otherwise */
+	int      *nonzero;    /**< scratch space for the pivot row */
+	bool     *binary;     /**< binary structural variables */
+	double   *best;       /**< the incumbent */
+	double    best_obj;   /**< the objective of the incumbent */
+	bool      has_best;
+	bool      integral;   /**< only integers contribute to the objective */
+	bool      aborted;    /**< the search was cut short */
+	double    deadline;   /**< the time to give up, 0 if none */
+	unsigned  iterations;
+} bnb_t;
+
+static bool out_of_time(bnb_t *bnb)
+{
+	if (bnb->deadline > 0.0 && ir_get_time_sec() > bnb->deadline)
+		bnb->aborted = true;
+	return bnb->aborted;
+}
+
+/**
+ * Moves the nonbasic variable var to value and updates the basic variables.
+ */
+static void set_nonbasic(bnb_t *bnb, int var, double value)
+{
+	double delta = value - bnb->x[var];
+	int    n     = bnb->n;
+	assert(bnb->row[var] < 0);
+	if (delta == 0.0)
+		return;
+	for (int r = 0; r < bnb->n_rows; ++r) {
+		double a = bnb->tab[r * n + var];
+		if (a != 0.0)
+			bnb->x[bnb->basis[r]] -= a * delta;
+	}
+	bnb->x[var] = value;
+}
+
+/**
+ * Exchanges the basic variable of row r, which leaves at bound, with the
+ * nonbasic variable q.
+ */
+static void pivot(bnb_t *bnb, int r, int q, double bound)
+{
+	int     n     = bnb->n;
+	double *prow  = &bnb->tab[r * n];
+	int     leave = bnb->basis[r];
+	double  step  = (bnb->x[leave] - bound) / prow[q];
+
+	for (int i = 0; i < bnb->n_rows; ++i) {
+		double a = bnb->tab[i * n + q];
+		if (a != 0.0)
+			bnb->x[bnb->basis[i]] -= a * step;
+	}
+	bnb->x[q]    += step;
+	bnb->x[leave] = bound;
+
+	/* normalize the pivot row and remember its nonzero entries */
+	double inv       = 1.0 / prow[q];
+	int    n_nonzero = 0;
+	for (int j = 0; j < n; ++j) {
+		if (prow[j] == 0.0)
+			continue;
+		prow[j] *= inv;
+		bnb->nonzero[n_nonzero++] = j;
+	}
+	prow[q] = 1.0;
+
+	for (int i = 0; i < bnb->n_rows; ++i) {
+		double *trow = &bnb->tab[i * n];
+		double  f    = trow[q];
+		if (i == r || f == 0.0)
+			continue;
+		for (int k = 0; k < n_nonzero; ++k) {
+			int j = bnb->nonzero[k];
+			trow[j] -= f * prow[j];
+		}
+		trow[q] = 0.0;
+	}
+	double f = bnb->d[q];
+	if (f != 0.0) {
+		for (int k = 0; k < n_nonzero; ++k) {
+			int j = bnb->nonzero[k];
+			bnb->d[j] -= f * prow[j];
+		}
+	}
+	bnb->d[q] = 0.0;
+
+	bnb->basis[r]    = q;
+	bnb->row[q]      = r;
+	bnb->row[leave]  = -1;
+	++bnb->iterations;
+}
+
+/**
+ * Reoptimizes the LP relaxation with the bounded dual simplex, starting from
+ * the current dual feasible basis.
+ */
+static lp_result_t dual_simplex(bnb_t *bnb)
+{
+	int      n     = bnb->n;
+	unsigned limit = 50 * (unsigned)(bnb->n_rows + n);
+	for (unsigned iter = 0;; ++iter) {
+		if ((iter & 63) == 63 && out_of_time(bnb))
+			return LP_ABORTED;
+		if (iter > limit) {
+			/* most likely cycling, give up on this problem */
+			bnb->aborted = true;
+			return LP_ABORTED;
+		}
+
+		/* the leaving variable violates its bounds the most */
+		int    r         = -1;
+		double violation = BNB_FEAS_EPS;
+		for (int i = 0; i < bnb->n_rows; ++i) {
+			int    var = bnb->basis[i];
+			double v   = MAX(bnb->lb[var] - bnb->x[var],
+			                 bnb->x[var] - bnb->ub[var]);
+			if (v > violation) {
+				violation = v;
+				r         = i;
+			}
+		}
+		if (r < 0)
+			return LP_OPTIMAL;
+
+		int     leave = bnb->basis[r];
+		bool    below = bnb->x[leave] < bnb->lb[leave];
+		double *trow  = &bnb->tab[r * n];
+
+		/* the entering variable keeps the reduced costs dual feasible */
+		int    q     = -1;
+		double ratio = HUGE_VAL;
+		double alpha = 0.0;
+		for (int j = 0; j < n; ++j) {
+			double a = trow[j];
+			if (bnb->row[j] >= 0 || bnb->lb[j] == bnb->ub[j]
+			    || fabs(a) < BNB_PIVOT_EPS)
+				continue;
+			bool at_upper = bnb->x[j] > bnb->lb[j];
+			if ((a < 0) != (below != at_upper))
+				continue;
+			double t = fabs(bnb->d[j] / a);
+			if (t < ratio || (t == ratio && fabs(a) > fabs(alpha))) {
+				ratio = t;
+				alpha = a;
+				q     = j;
+			}
+		}
+		if (q < 0)
+			return LP_INFEASIBLE;
+
+		pivot(bnb, r, q, below ? bnb->lb[leave] : bnb->ub[leave]);
+	}
+}
+
+static double get_objective(const bnb_t *bnb)
+{
+	double obj = 0.0;
+	for (int j = 0; j < bnb->n_cols; ++j)
+		obj += bnb->cost[j] * bnb->x[j];
+	return obj;
+}
+
+/**
+ * Returns true if a subproblem with the LP bound obj cannot improve the
+ * incumbent.
+ */
+static bool can_prune(const bnb_t *bnb, double obj)
+{
+	if (!bnb->has_best)
+		return false;
+	/* an integral objective rounds up to the next integer */
+	if (bnb->integral)
+		obj = ceil(obj - BNB_FEAS_EPS);
+	return obj >= bnb->best_obj - BNB_FEAS_EPS;
+}
+
+/**
+ * Changes the bounds of a binary variable and keeps the basis dual
+ * feasible. A nonbasic variable moves to the bound its reduced cost prefers.
+ */
+static void set_binary_bounds(bnb_t *bnb, int var, double lb, double ub)
+{
+	bnb->lb[var] = lb;
+	bnb->ub[var] = ub;
+	if (bnb->row[var] >= 0)
+		return;
+	double value = bnb->x[var];
+	if (lb == ub) {
+		value = lb;
+	} else if (bnb->d[var] > BNB_PIVOT_EPS) {
+		value = lb;
+	} else if (bnb->d[var] < -BNB_PIVOT_EPS) {
+		value = ub;
+	}
+	set_nonbasic(bnb, var, value);
+}
+
+/**
+ * Solves the subproblem at the current bounds and branches on the most
+ * fractional binary variable.
+ */
+static void branch(bnb_t *bnb)
+{
+	if (out_of_time(bnb) || dual_simplex(bnb) != LP_OPTIMAL)
+		return;
+
+	double obj = get_objective(bnb);
+	if (can_prune(bnb, obj))
+		return;
+
+	int    var      = -1;
+	double fraction = BNB_FEAS_EPS;
+	for (int j = 0; j < bnb->n_cols; ++j) {
+		if (!bnb->binary[j])
+			continue;
+		double v = bnb->x[j];
+		double f = MIN(v - floor(v), ceil(v) - v);
+		if (f > fraction) {
+			fraction = f;
+			var      = j;
+		}
+	}
+
+	if (var < 0) {
+		for (int j = 0; j < bnb->n_cols; ++j) {
+			double v = bnb->x[j];
+			bnb->best[j] = bnb->binary[j] ? floor(v + 0.5) : v;
+		}
+		bnb->best_obj = obj;
+		bnb->has_best = true;
+		return;
+	}
+
+	/* try the nearer value first, it more likely leads to a solution */
+	double first = bnb->x[var] >= 0.5 ? 1.0 : 0.0;
+	set_binary_bounds(bnb, var, first, first);
+	branch(bnb);
+	if (!bnb->aborted && !can_prune(bnb, obj)) {
+		set_binary_bounds(bnb, var, 1.0 - first, 1.0 - first);
+		branch(bnb);
+	}
+	set_binary_bounds(bnb, var, 0.0, 1.0);
+}
+
+/**
+ * Uses the start values as incumbent if they satisfy all constraints.
+ */
+static void use_start_values(bnb_t *bnb)
+{
+	lpp_t  *lpp      = bnb->lpp;
+	double *activity = XMALLOCNZ(double, bnb->n_rows);
+	bool    feasible = true;
+	for (int j = 0; j < bnb->n_cols && feasible; ++j) {
+		const lpp_name_t *var   = lpp->vars[1 + j];
+		double            value = var->value_kind == lpp_value_start
+		                          ? var->value : 0.0;
+		if (value < 0.0 || (bnb->binary[j] && value != 0.0 && value != 1.0)) {
+			feasible = false;
+			break;
+		}
+		bnb->best[j] = value;
+		matrix_foreach_in_col(lpp->m, 1 + j, elem) {
+			if (elem->row > 0)
+				activity[elem->row - 1] += elem->val * value;
+		}
+	}
+	for (int i = 0; i < bnb->n_rows && feasible; ++i) {
+		/* the slack a constraint needs has to be within its bounds */
+		double slack = matrix_get(lpp->m, 1 + i, 0) - activity[i];
+		int    var   = bnb->n_cols + i;
+		if (slack < bnb->lb[var] - BNB_FEAS_EPS
+		    || slack > bnb->ub[var] + BNB_FEAS_EPS)
+			feasible = false;
+	}
+	free(activity);
+
+	if (feasible) {
+		double obj = 0.0;
+		for (int j = 0; j < bnb->n_cols; ++j)
+			obj += bnb->cost[j] * bnb->best[j];
+		bnb->best_obj = obj;
+		bnb->has_best = true;
+	}
+}
+
+/**
+ * Sets up the bounds and costs, the slacks form the basis.
+ */
+static void init_problem(bnb_t *bnb)
+{
+	lpp_t *lpp    = bnb->lpp;
+	int    n_cols = bnb->n_cols;
+	double sign   = lpp->opt_type == lpp_minimize ? 1.0 : -1.0;
+
+	for (int i = 0; i < bnb->n_rows; ++i) {
+		int var = n_cols + i;
+		bnb->basis[i] = var;
+		bnb->row[var] = i;
+		bnb->x[var]   = matrix_get(lpp->m, 1 + i, 0);
+		bnb->lb[var]  = 0.0;
+		bnb->ub[var]  = 0.0;
+		switch (lpp->csts[1 + i]->type.cst_type) {
+		case lpp_less_equal:    bnb->ub[var] = HUGE_VAL;  break;
+		case lpp_greater_equal: bnb->lb[var] = -HUGE_VAL; break;
+		default:                break;
+		}
+	}
+
+	bnb->integral = true;
+	for (int j = 0; j < n_cols; ++j) {
+		double c = sign * matrix_get(lpp->m, 0, 1 + j);
+		bnb->cost[j]   = c;
+		bnb->d[j]      = c;
+		bnb->row[j]    = -1;
+		bnb->binary[j] = lpp->vars[1 + j]->type.var_type == lpp_binary;
+		bnb->lb[j]     = 0.0;
+		bnb->ub[j]     = bnb->binary[j] ? 1.0 : c < 0.0 ? BNB_BIG : HUGE_VAL;
+		if (c != 0.0 && (!bnb->binary[j] || c != floor(c)))
+			bnb->integral = false;
+	}
+}
+
+/**
+ * Fills the tableau and moves every structural variable to the bound its
+ * cost prefers.
+ */
+static void construct_tableau(bnb_t *bnb)
+{
+	lpp_t *lpp = bnb->lpp;
+	int    n   = bnb->n;
+
+	for (int i = 0; i < bnb->n_rows; ++i)
+		bnb->tab[i * n + bnb->n_cols + i] = 1.0;
+	for (int j = 0; j < bnb->n_cols; ++j) {
+		matrix_foreach_in_col(lpp->m, 1 + j, elem) {
+			if (elem->row > 0)
+				bnb->tab[(elem->row - 1) * n + j] = elem->val;
+		}
+		if (bnb->cost[j] < 0.0)
+			set_nonbasic(bnb, j, bnb->ub[j]);
+	}
+}
+
+void lpp_solve_builtin(lpp_t *lpp)
+{
+	double start  = ir_get_time_sec();
+	int    n_cols = lpp->var_next - 1;
+	int    n_rows = lpp->cst_next - 1;
+	int    n      = n_cols + n_rows;
+
+	bnb_t bnb;
+	memset(&bnb, 0, sizeof(bnb));
+	bnb.lpp      = lpp;
+	bnb.n_cols   = n_cols;
+	bnb.n_rows   = n_rows;
+	bnb.n        = n;
+	bnb.deadline = lpp->time_limit_secs > 0.0
+	               ? start + lpp->time_limit_secs : 0.0;
+	bnb.d        = XMALLOCNZ(double, n);
+	bnb.x        = XMALLOCNZ(double, n);
+	bnb.lb       = XMALLOCNZ(double, n);
+	bnb.ub       = XMALLOCNZ(double, n);
+	bnb.cost     = XMALLOCNZ(double, n_cols);
+	bnb.best     = XMALLOCNZ(double, n_cols);
+	bnb.basis    = XMALLOCNZ(int, n_rows);
+	bnb.row      = XMALLOCNZ(int, n);
+	bnb.nonzero  = XMALLOCNZ(int, n);
+	bnb.binary   = XMALLOCNZ(bool, n_cols);
+	init_problem(&bnb);
+	use_start_values(&bnb);
+
+	double bound = -HUGE_VAL;
+	if ((double)n_rows * n > BNB_MAX_TABLEAU) {
+		/* too large for a dense tableau, only the start values remain */
+		bnb.aborted = true;
+	} else {
+		bnb.tab = XMALLOCNZ(double, (size_t)n_rows * n);
+		construct_tableau(&bnb);
+		if (dual_simplex(&bnb) == LP_OPTIMAL) {
+			bound = get_objective(&bnb);
+			branch(&bnb);
+		}
+	}
+
+	if (bnb.has_best) {
+		lpp->sol_state = bnb.aborted ? lpp_feasible : lpp_optimal;
+		for (int j = 0; j < n_cols; ++j) {
+			lpp->vars[1 + j]->value      = bnb.best[j];
+			lpp->vars[1 + j]->value_kind = lpp_value_solution;
+			if (!bnb.binary[j] && bnb.best[j] >= BNB_BIG - BNB_FEAS_EPS)
+				lpp->sol_state = lpp_unbounded;
+		}
+		if (!bnb.aborted)
+			bound = bnb.best_obj;
+		double sign = lpp->opt_type == lpp_minimize ? 1.0 : -1.0;
+		lpp->objval     = sign * bnb.best_obj;
+		lpp->best_bound = sign * bound;
+	} else {
+		lpp->sol_state = bnb.aborted ? lpp_unknown : lpp_infeasible;
+	}
+	lpp->iterations = bnb.iterations;
+	lpp->sol_time   = ir_get_time_sec() - start;
+
+	if (lpp->log != NULL) {
+		fprintf(lpp->log, "builtin: %d vars, %d csts, %u iterations, %.2fs%s\n",
+		        n_cols, n_rows, bnb.iterations, lpp->sol_time,
+		        bnb.aborted ? ", aborted" : "");
+	}
+
+	free(bnb.tab);
+	free(bnb.binary);
+	free(bnb.nonzero);
+	free(bnb.row);
+	free(bnb.basis);
+	free(bnb.best);
+	free(bnb.cost);
+	free(bnb.ub);
+	free(bnb.lb);
+	free(bnb.x);
+	free(bnb.d);
+}
@@ -0,0 +1,22 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2013 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Built-in branch and bound solver for small ILPs.
+ */
+#ifndef LPP_BUILTIN_H
+#define LPP_BUILTIN_H
+
+#include "lpp.h"
+
+/**
+ * Solves the problem with a dense bounded dual simplex and a depth first
+ * branch and bound over the binary variables. Needs no external solver and
+ * obeys the time limit of the problem.
+ */
+void lpp_solve_builtin(lpp_t *lpp);
+
+#endif
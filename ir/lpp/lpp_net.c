@@ -107,16 +107,105 @@ static int connect_tcp(const char *host, uint16_t port)
 	return s;
 }
 
-char **lpp_get_solvers(const char *host)
+static void close_socket(int fd)
 {
-	int fd, n;
-	char **res = NULL;
-	lpp_comm_t *comm;
+#ifdef _WIN32
+	closesocket(fd);
+#else
+	close(fd);
+#endif
+}
+
+/**
+ * The connection to the solving server. It is kept open between requests so
+ * that solving a series of problems does not pay for a TCP handshake and a
+ * server side session setup per problem. The server processes any number of
+ * commands per session.
+ */
+static struct {
+	char       *host;   /**< the host the connection belongs to */
+	char       *solver; /**< the solver last selected on the server */
+	lpp_comm_t *comm;   /**< the connection, NULL if not connected */
+	int         fd;     /**< the socket of the connection */
+} conn;
+
+static void drop_connection(void)
+{
+	if (conn.comm == NULL)
+		return;
+	lpp_comm_free(conn.comm);
+	close_socket(conn.fd);
+	free(conn.host);
+	free(conn.solver);
+	conn.host   = NULL;
+	conn.solver = NULL;
+	conn.comm   = NULL;
+	conn.fd     = -1;
+}
+
+void lpp_net_close(void)
+{
+	if (conn.comm == NULL)
+		return;
+	lpp_writel(conn.comm, LPP_CMD_BYE);
+	lpp_flush(conn.comm);
+	drop_connection();
+}
+
+/**
+ * Check whether the server is still there. A server which closed the
+ * connection, e.g. because it has been restarted, is only noticed when data
+ * is sent, which is too late to reconnect.
+ */
+static int connection_alive(int fd)
+{
+#ifdef _WIN32
+	(void)fd;
+	return 1;
+#else
+	char c;
+	ssize_t res = recv(fd, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+	if (res == 0)
+		return 0;
+	return res > 0 || errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+/**
+ * Get a connection to @p host, reusing the open one if possible.
+ */
+static lpp_comm_t *get_connection(const char *host)
+{
+	static int registered = 0;
+	int fd;
+
+	if (conn.comm != NULL) {
+		if (strcmp(conn.host, host) == 0 && connection_alive(conn.fd))
+			return conn.comm;
+		drop_connection();
+	}
 
 	ERR_CHECK_RETURN(fd = connect_tcp(host, LPP_PORT), <, 0,
 			("could not connect to %s", host), NULL);
 
-	comm = lpp_comm_new(fd, LPP_BUFSIZE);
+	conn.fd   = fd;
+	conn.comm = lpp_comm_new(fd, LPP_BUFSIZE);
+	conn.host = xstrdup(host);
+	if (!registered) {
+		atexit(lpp_net_close);
+		registered = 1;
+	}
+	return conn.comm;
+}
+
+char **lpp_get_solvers(const char *host)
+{
+	int n;
+	char **res = NULL;
+	lpp_comm_t *comm = get_connection(host);
+
+	if (comm == NULL)
+		return NULL;
 
 	lpp_writel(comm, LPP_CMD_SOLVERS);
 	lpp_flush(comm);
@@ -130,52 +219,44 @@ char **lpp_get_solvers(const char *host)
 			res[i] = lpp_reads(comm);
 	}
 
-	lpp_writel(comm, LPP_CMD_BYE);
-	lpp_flush(comm);
-	lpp_comm_free(comm);
-	close(fd);
 	return res;
 }
 
 void lpp_set_dbg(const char *host, int mask)
 {
-	int fd;
-	lpp_comm_t *comm;
+	lpp_comm_t *comm = get_connection(host);
 
-	ERR_CHECK_RETURN_VOID(fd = connect_tcp(host, LPP_PORT), <, 0, ("could not connect to %s", host));
-
-	comm = lpp_comm_new(fd, LPP_BUFSIZE);
+	if (comm == NULL)
+		return;
 
 	lpp_writel(comm, LPP_CMD_SET_DEBUG);
 	lpp_writel(comm, mask);
 	lpp_flush(comm);
-	lpp_writel(comm, LPP_CMD_BYE);
-	lpp_flush(comm);
-	lpp_comm_free(comm);
-	close(fd);
 }
 
 void lpp_solve_net(lpp_t *lpp, const char *host, const char *solver)
 {
 	char buf[1024];
-	int n, fd, ready;
+	int n, ready;
 	lpp_comm_t *comm;
 	ir_timer_t *t_send, *t_recv;
 
-	ERR_CHECK_RETURN_VOID(fd = connect_tcp(host, LPP_PORT), <, 0,
-		("could not connect to %s", host));
-
-	comm = lpp_comm_new(fd, LPP_BUFSIZE);
-
-	/* Set the solver */
-	lpp_writel(comm, LPP_CMD_SOLVER);
-	lpp_writes(comm, solver);
-	lpp_flush(comm);
+	comm = get_connection(host);
+	if (comm == NULL)
+		return;
 
 	t_send = ir_timer_new();
 	t_recv = ir_timer_new();
 
+	/* Set the solver if it changed, it is sent together with the problem */
 	ir_timer_start(t_send);
+	if (conn.solver == NULL || strcmp(conn.solver, solver) != 0) {
+		lpp_writel(comm, LPP_CMD_SOLVER);
+		lpp_writes(comm, solver);
+		free(conn.solver);
+		conn.solver = xstrdup(solver);
+	}
+
 	lpp_writel(comm, LPP_CMD_PROBLEM);
 	lpp_serialize(comm, lpp, 1);
 	lpp_serialize_values(comm, lpp, lpp_value_start);
@@ -209,21 +290,20 @@ void lpp_solve_net(lpp_t *lpp, const char *host, const char *solver)
 				break;
 			case LPP_CMD_BAD:
 				fprintf(stderr, "solver process died unexpectedly\n");
-				goto end;
+				goto error;
 			default:
 				fprintf(stderr, "invalid command: %s(%d)\n", lpp_get_cmd_name(cmd), cmd);
-				return;
+				goto error;
 		}
 	}
 
-	lpp_writel(comm, LPP_CMD_BYE);
-	lpp_flush(comm);
+	ir_timer_free(t_send);
+	ir_timer_free(t_recv);
+	return;
 
-end:
-	lpp_comm_free(comm);
-#ifdef _WIN32
-	closesocket(fd);
-#else
-	close(fd);
-#endif
+error:
+	/* the state of the session is unknown, start over with the next problem */
+	drop_connection();
+	ir_timer_free(t_send);
+	ir_timer_free(t_recv);
 }
@@ -16,6 +16,16 @@ char **lpp_get_solvers(const char *host);
 
 void lpp_set_dbg(const char *host, int mask);
 
+/**
+ * Solve a problem on the server @p host. The connection to the server is kept
+ * open for the following requests to the same host.
+ */
 void lpp_solve_net(lpp_t *lpp, const char *host, const char *solver);
 
+/**
+ * Close the connection to the solving server if one is open. This happens
+ * automatically at program exit.
+ */
+void lpp_net_close(void);
+
 #endif
@@ -8,6 +8,7 @@
  * @author  Sebastian Hack
  */
 #include "lpp_solvers.h"
+#include "lpp_builtin.h"
 #include "lpp_cplex.h"
 #include "lpp_gurobi.h"
 
@@ -18,6 +19,7 @@ lpp_solver_t lpp_solvers[] = {
 #ifdef WITH_GUROBI
 	{ lpp_solve_gurobi,  "gurobi",  1 },
 #endif
+	{ lpp_solve_builtin, "builtin", 1 },
 	{ NULL,              NULL,      0 }
 };
 
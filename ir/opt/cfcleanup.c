@@ -0,0 +1,357 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Combined control flow cleanup.
+ *
+ * Does the work of remove_tuples(), remove_unreachable_code(), remove_bads()
+ * and the block merging part of optimize_cf() with a single graph walk:
+ * Tuples are removed while collecting the blocks, then every block is visited
+ * once to drop unreachable and Bad predecessors, to skip empty predecessor
+ * blocks and to merge it with its predecessor if it has a single one ending
+ * in a Jmp. The immediate dominators are updated along the way, so the
+ * dominance information is still valid afterwards.
+ */
+#include "iroptimize.h"
+
+#include <assert.h>
+#include <stdbool.h>
+
+#include "array_t.h"
+#include "debug.h"
+#include "irdom_t.h"
+#include "iredges.h"
+#include "irgmod.h"
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "irtools.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+typedef struct cleanup_env_t {
+	ir_node **blocks;  /**< all blocks found by the walker */
+	bool      changed; /**< set if the graph was changed */
+} cleanup_env_t;
+
+/** Blocks containing other nodes than Phis and a Jmp are marked. */
+static bool has_operations(const ir_node *block)
+{
+	return get_Block_mark(block);
+}
+
+static bool is_reachable(const ir_node *block)
+{
+	return get_Block_dom_depth(block) >= 0;
+}
+
+/** Returns the immediate dominator, following blocks merged so far. */
+static ir_node *get_idom(const ir_node *block)
+{
+	return skip_Id(get_Block_idom(block));
+}
+
+/**
+ * Pre-walker: removes Projs from Tuples and initializes the block
+ * information.
+ */
+static void remove_tuple_projs(ir_node *node, void *data)
+{
+	cleanup_env_t *env = (cleanup_env_t*)data;
+
+	if (is_Block(node)) {
+		set_Block_mark(node, false);
+		set_Block_phis(node, NULL);
+		ARR_APP1(ir_node*, env->blocks, node);
+	} else if (is_Proj(node)) {
+		ir_node *skipped = skip_Tuple(node);
+		if (skipped != node) {
+			exchange(node, skipped);
+			env->changed = true;
+		}
+	}
+}
+
+/**
+ * Post-walker: collects the Phis of each block and marks blocks containing
+ * operations.
+ */
+static void collect_block_info(ir_node *node, void *data)
+{
+	(void)data;
+
+	if (is_Phi(node)) {
+		add_Block_phi(get_nodes_block(node), node);
+	} else if (!is_Block(node) && !is_Jmp(node) && !is_Bad(node)
+	           && !is_Id(node) && !is_Tuple(node)) {
+		set_Block_mark(get_nodes_block(node), true);
+	}
+}
+
+/** Checks whether pred is an unreachable or Bad control flow predecessor. */
+static bool is_dead_pred(const ir_node *pred)
+{
+	return is_Bad(pred) || !is_reachable(get_nodes_block(pred));
+}
+
+/**
+ * Removes unreachable and Bad predecessors from a block and its Phis.
+ * Phis of blocks with a single predecessor are replaced by their operand.
+ */
+static void remove_dead_preds(cleanup_env_t *env, ir_node *block)
+{
+	int n_preds = get_Block_n_cfgpreds(block);
+	int n_alive = 0;
+	for (int i = 0; i < n_preds; ++i) {
+		if (!is_dead_pred(get_Block_cfgpred(block, i)))
+			++n_alive;
+	}
+
+	/* a reachable block keeps at least one predecessor */
+	if (n_alive > 0 && n_alive != n_preds) {
+		ir_node **in = ALLOCAN(ir_node*, n_preds);
+		for (ir_node *phi = get_Block_phis(block); phi != NULL;
+		     phi = get_Phi_next(phi)) {
+			int n = 0;
+			for (int i = 0; i < n_preds; ++i) {
+				if (!is_dead_pred(get_Block_cfgpred(block, i)))
+					in[n++] = get_Phi_pred(phi, i);
+			}
+			set_irn_in(phi, n, in);
+		}
+
+		int n = 0;
+		for (int i = 0; i < n_preds; ++i) {
+			ir_node *pred = get_Block_cfgpred(block, i);
+			if (!is_dead_pred(pred))
+				in[n++] = pred;
+		}
+		set_irn_in(block, n, in);
+		env->changed = true;
+	}
+
+	if (n_alive == 1 && get_Block_phis(block) != NULL) {
+		for (ir_node *phi = get_Block_phis(block), *next; phi != NULL;
+		     phi = next) {
+			next = get_Phi_next(phi);
+			exchange(phi, get_Phi_pred(phi, 0));
+		}
+		set_Block_phis(block, NULL);
+		env->changed = true;
+	}
+}
+
+/** Checks whether block has a predecessor in pred_block. */
+static bool has_pred_block(const ir_node *block, const ir_node *pred_block,
+                           int skip_pos)
+{
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		if (i != skip_pos && get_Block_cfgpred_block(block, i) == pred_block)
+			return true;
+	}
+	return false;
+}
+
+/**
+ * Checks whether the empty block jmp_block, which is predecessor pos of
+ * block, can be skipped.
+ */
+static bool is_skippable(cleanup_env_t *env, ir_node *block, int pos)
+{
+	ir_node *jmp = get_Block_cfgpred(block, pos);
+	if (!is_Jmp(jmp))
+		return false;
+	ir_node *jmp_block = get_nodes_block(jmp);
+	if (jmp_block == block || has_operations(jmp_block)
+	    || get_Block_entity(jmp_block) != NULL)
+		return false;
+
+	remove_dead_preds(env, jmp_block);
+	int n_jpreds = get_Block_n_cfgpreds(jmp_block);
+	if (n_jpreds == 0 || get_Block_phis(jmp_block) != NULL)
+		return false;
+	for (int i = 0, n = get_Block_n_cfgpreds(block); i < n; ++i) {
+		if (i != pos && get_Block_cfgpred(block, i) == jmp)
+			return false;
+	}
+
+	for (int j = 0; j < n_jpreds; ++j) {
+		ir_node *pred = get_Block_cfgpred(jmp_block, j);
+		if (is_unknown_jump(pred))
+			return false;
+		/* the Phis of block need distinct predecessor blocks to choose
+		 * their operands */
+		if (get_Block_phis(block) != NULL
+		    && has_pred_block(block, get_nodes_block(pred), pos))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Skips the empty predecessor pos of block: its predecessors become
+ * predecessors of block.
+ *
+ * @verbatim
+ *   A     B                A  B
+ *    \   /                 |  |
+ *  jmp_block  C    =>      |  |  C
+ *        \   /              \ | /
+ *        block              block
+ * @endverbatim
+ */
+static void skip_empty_pred(ir_node *block, int pos)
+{
+	ir_node  *jmp       = get_Block_cfgpred(block, pos);
+	ir_node  *jmp_block = get_nodes_block(jmp);
+	int       n_preds   = get_Block_n_cfgpreds(block);
+	int       n_jpreds  = get_Block_n_cfgpreds(jmp_block);
+	int       n_in      = n_preds - 1 + n_jpreds;
+	ir_node **in        = ALLOCAN(ir_node*, n_in);
+
+	for (ir_node *phi = get_Block_phis(block); phi != NULL;
+	     phi = get_Phi_next(phi)) {
+		int n = 0;
+		for (int i = 0; i < n_preds; ++i) {
+			ir_node *op = get_Phi_pred(phi, i);
+			if (i != pos) {
+				in[n++] = op;
+				continue;
+			}
+			for (int j = 0; j < n_jpreds; ++j)
+				in[n++] = op;
+		}
+		set_irn_in(phi, n_in, in);
+	}
+
+	int n = 0;
+	for (int i = 0; i < n_preds; ++i) {
+		if (i != pos) {
+			in[n++] = get_Block_cfgpred(block, i);
+			continue;
+		}
+		for (int j = 0; j < n_jpreds; ++j)
+			in[n++] = get_Block_cfgpred(jmp_block, j);
+	}
+	set_irn_in(block, n_in, in);
+
+	DB((dbg, LEVEL_2, "skipped empty %+F before %+F\n", jmp_block, block));
+	exchange(jmp, new_r_Bad(get_irn_irg(block), mode_X));
+	/* blocks dominated by jmp_block are now dominated by its immediate
+	 * dominator, which they find through the Id */
+	exchange(jmp_block, get_idom(jmp_block));
+}
+
+/**
+ * Merges block into its predecessor if that is the only one and ends in a
+ * Jmp.
+ */
+static bool merge_into_pred(ir_node *block)
+{
+	ir_graph *irg = get_irn_irg(block);
+	if (get_Block_n_cfgpreds(block) != 1 || get_Block_entity(block) != NULL
+	    || block == get_irg_end_block(irg))
+		return false;
+	ir_node *jmp = get_Block_cfgpred(block, 0);
+	if (!is_Jmp(jmp))
+		return false;
+	ir_node *pred_block = get_nodes_block(jmp);
+	if (pred_block == block)
+		return false;
+	assert(get_Block_phis(block) == NULL);
+
+	DB((dbg, LEVEL_2, "merging %+F into %+F\n", block, pred_block));
+	if (has_operations(block))
+		set_Block_mark(pred_block, true);
+	/* blocks dominated by block find pred_block through the Id */
+	exchange(block, pred_block);
+	return true;
+}
+
+static void cleanup_block(cleanup_env_t *env, ir_node *block)
+{
+	remove_dead_preds(env, block);
+
+	for (int i = 0; i < get_Block_n_cfgpreds(block); ) {
+		if (is_skippable(env, block, i)) {
+			skip_empty_pred(block, i);
+			env->changed = true;
+			/* the new predecessor at i might be empty as well */
+			continue;
+		}
+		++i;
+	}
+
+	if (merge_into_pred(block))
+		env->changed = true;
+}
+
+/** Removes keep-alives of unreachable code and Tuples. */
+static void remove_dead_keepalives(cleanup_env_t *env, ir_graph *irg)
+{
+	ir_node *end    = get_irg_end(irg);
+	int      n_kept = get_End_n_keepalives(end);
+	for (int i = get_End_n_keepalives(end); i-- > 0; ) {
+		ir_node *ka    = get_End_keepalive(end, i);
+		ir_node *block = is_Block(ka) ? ka : get_nodes_block(ka);
+		if (is_Tuple(ka) || is_Bad(ka) || is_Bad(block)
+		    || !is_reachable(block))
+			remove_End_n(end, i);
+	}
+	remove_End_Bads_and_doublets(end);
+	if (get_End_n_keepalives(end) != n_kept)
+		env->changed = true;
+}
+
+void cleanup_cf(ir_graph *irg)
+{
+	cleanup_env_t env;
+	env.blocks  = NEW_ARR_F(ir_node*, 0);
+	env.changed = false;
+
+	FIRM_DBG_REGISTER(dbg, "firm.opt.cfcleanup");
+
+	assert(get_irg_pinned(irg) != op_pin_state_floats &&
+	       "Control flow cleanup needs a pinned graph");
+
+	ir_reserve_resources(irg, IR_RESOURCE_BLOCK_MARK | IR_RESOURCE_PHI_LIST);
+	irg_walk_graph(irg, remove_tuple_projs, collect_block_info, &env);
+	/* removing Tuples may have changed the control flow */
+	if (env.changed)
+		confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+
+	for (size_t i = ARR_LEN(env.blocks); i-- > 0; ) {
+		ir_node *block = env.blocks[i];
+		if (!is_Block(block) || !is_reachable(block))
+			continue;
+		cleanup_block(&env, block);
+	}
+	ir_free_resources(irg, IR_RESOURCE_BLOCK_MARK | IR_RESOURCE_PHI_LIST);
+
+	remove_dead_keepalives(&env, irg);
+
+	if (env.changed) {
+		/* keep the remaining reachable blocks and rebuild the dominator
+		 * tree from the updated immediate dominators */
+		size_t n_blocks = 0;
+		for (size_t i = 0, n = ARR_LEN(env.blocks); i < n; ++i) {
+			ir_node *block = env.blocks[i];
+			if (is_Block(block) && is_reachable(block))
+				env.blocks[n_blocks++] = block;
+		}
+		rebuild_dom_tree(irg, env.blocks, n_blocks);
+
+		confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
+		add_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+	} else {
+		confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_ALL);
+	}
+	add_irg_properties(irg, IR_GRAPH_PROPERTY_NO_TUPLES
+	                      | IR_GRAPH_PROPERTY_NO_BADS
+	                      | IR_GRAPH_PROPERTY_NO_UNREACHABLE_CODE);
+	DEL_ARR_F(env.blocks);
+}
@@ -21,6 +21,9 @@
 #include "irnode_t.h"
 #include "iredges_t.h"
 #include "irgopt.h"
+#include "irdom.h"
+#include "irgwalk.h"
+#include "execfreq_t.h"
 
 #ifndef NDEBUG
 static bool is_block_reachable(ir_node *block)
@@ -159,6 +162,13 @@ static ir_node *calc_dom_dca(ir_node *dca, ir_node *block)
 	if (!dca)
 		return block;
 
+	/* Dominance is a constant time check, walking up the dominator tree is
+	 * linear in its depth. */
+	if (block_dominates(dca, block))
+		return dca;
+	if (block_dominates(block, dca))
+		return block;
+
 	/* Find a placement that is dominates both, dca and block. */
 	while (get_Block_dom_depth(block) > get_Block_dom_depth(dca))
 		block = get_Block_idom(block);
@@ -233,6 +243,37 @@ static void move_out_of_loops(ir_node *n, ir_node *early)
 		if (idom_depth < best_depth) {
 			best       = idom;
 			best_depth = idom_depth;
+			/* no block has a smaller loop depth */
+			if (best_depth == 0)
+				break;
+		}
+		block = idom;
+	}
+	if (best != get_nodes_block(n))
+		set_nodes_block(n, best);
+}
+
+/**
+ * Move n to the block with the smallest execution frequency on the
+ * dominator tree path between its current block and early. A node is only
+ * moved up if this strictly lowers its frequency, so a node used on a cold
+ * path only stays there even if that path is inside a loop.
+ *
+ * @param n      the node that should be moved
+ * @param early  the earliest block we can n move to
+ */
+static void move_to_coldest_block(ir_node *n, ir_node *early)
+{
+	ir_node *block     = get_nodes_block(n);
+	ir_node *best      = block;
+	double   best_freq = get_block_execfreq(best);
+
+	while (block != early) {
+		ir_node *idom      = get_Block_idom(block);
+		double   idom_freq = get_block_execfreq(idom);
+		if (idom_freq < best_freq) {
+			best      = idom;
+			best_freq = idom_freq;
 		}
 		block = idom;
 	}
@@ -310,9 +351,10 @@ static void set_projs_block(ir_node *node, ir_node *block)
  * The `optimal' block is the dominance-deepest block of those
  * with the least loop-nesting-depth.  This places N out of as many
  * loops as possible and then makes it as control dependent as
- * possible.
+ * possible. If use_freq is set, the `optimal' block is the
+ * dominance-deepest block with the smallest execution frequency instead.
  */
-static void place_floats_late(ir_node *n, pdeq *worklist)
+static void place_floats_late(ir_node *n, pdeq *worklist, bool use_freq)
 {
 	ir_node *block;
 	ir_node *dca;
@@ -332,7 +374,7 @@ static void place_floats_late(ir_node *n, pdeq *worklist)
 	/* place our users */
 	foreach_out_edge(n, edge) {
 		ir_node *succ = get_edge_src_irn(edge);
-		place_floats_late(succ, worklist);
+		place_floats_late(succ, worklist, use_freq);
 	}
 
 	/* no point in moving Projs around, they are moved with their predecessor */
@@ -353,7 +395,10 @@ static void place_floats_late(ir_node *n, pdeq *worklist)
 	dca = get_deepest_common_dom_ancestor(n, NULL);
 	if (dca != NULL) {
 		set_nodes_block(n, dca);
-		move_out_of_loops(n, block);
+		if (use_freq)
+			move_to_coldest_block(n, block);
+		else
+			move_out_of_loops(n, block);
 		if (get_irn_mode(n) == mode_T) {
 			set_projs_block(n, get_nodes_block(n));
 		}
@@ -365,25 +410,25 @@ static void place_floats_late(ir_node *n, pdeq *worklist)
  * the dominance tree.
  *
  * @param worklist   the worklist containing the nodes to place
+ * @param use_freq   place by execution frequency instead of loop depth
  */
-static void place_late(ir_graph *irg, waitq *worklist)
+static void place_late(ir_graph *irg, waitq *worklist, bool use_freq)
 {
 	assert(worklist);
 	inc_irg_visited(irg);
 
 	/* This fills the worklist initially. */
-	place_floats_late(get_irg_start_block(irg), worklist);
+	place_floats_late(get_irg_start_block(irg), worklist, use_freq);
 
 	/* And now empty the worklist again... */
 	while (!waitq_empty(worklist)) {
 		ir_node *n = (ir_node*)waitq_get(worklist);
 		if (!irn_visited(n))
-			place_floats_late(n, worklist);
+			place_floats_late(n, worklist, use_freq);
 	}
 }
 
-/* Code Placement. */
-void place_code(ir_graph *irg)
+static void do_place_code(ir_graph *irg, bool use_freq)
 {
 	waitq *worklist;
 
@@ -408,8 +453,41 @@ void place_code(ir_graph *irg)
 
 	/* Now move the nodes down in the dominator tree. This reduces the
 	   unnecessary executions of the node. */
-	place_late(irg, worklist);
+	place_late(irg, worklist, use_freq);
 
 	del_waitq(worklist);
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_CONTROL_FLOW);
 }
+
+/* Code Placement. */
+void place_code(ir_graph *irg)
+{
+	do_place_code(irg, false);
+}
+
+/**
+ * Blocks splitting critical edges have no frequency yet. Give them the
+ * frequency of their predecessor, which bounds the frequency of the edge,
+ * so they do not look like cold blocks.
+ */
+static void set_split_block_freq(ir_node *block, void *env)
+{
+	unsigned last_idx = *(unsigned*)env;
+	if (get_irn_idx(block) < last_idx || get_Block_n_cfgpreds(block) != 1)
+		return;
+	ir_node *pred = get_Block_cfgpred_block(block, 0);
+	if (!is_Bad(pred))
+		set_block_execfreq(block, get_block_execfreq(pred));
+}
+
+void place_code_profiled(ir_graph *irg)
+{
+	/* without frequencies fall back to the loop depth */
+	bool use_freq = get_block_execfreq(get_irg_start_block(irg)) > 0.0;
+	if (use_freq) {
+		unsigned last_idx = get_irg_last_idx(irg);
+		assure_irg_properties(irg, IR_GRAPH_PROPERTY_NO_CRITICAL_EDGES);
+		irg_block_walk_graph(irg, set_split_block_freq, NULL, &last_idx);
+	}
+	do_place_code(irg, use_freq);
+}
@@ -0,0 +1,204 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 Karlsruhe Institute of Technology.
+ */
+
+/**
+ * @file
+ * @brief   Combines adjacent stores of constants into wider stores.
+ *
+ * Two Stores of constants of the same integer mode which follow each other
+ * directly on the memory chain and write neighbouring, suitably aligned
+ * memory are replaced by a single Store of the combined constant in the
+ * integer mode of twice the size. The combined Stores are combined again in
+ * the next round, so the initialisation of a small array is done with as few
+ * machine word sized Stores as possible.
+ */
+#include "iroptimize.h"
+
+#include <stdbool.h>
+
+#include "be.h"
+#include "debug.h"
+#include "ircons.h"
+#include "iredges_t.h"
+#include "irgmod.h"
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "tv.h"
+#include "typerep.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+/**
+ * Splits an address into a base address and a constant byte offset.
+ */
+static ir_node *get_base_and_offset(ir_node *ptr, long *offset)
+{
+	*offset = 0;
+	for (;;) {
+		if (is_Add(ptr)) {
+			ir_node *r = get_Add_right(ptr);
+			if (!is_Const(r) || mode_is_reference(get_irn_mode(r)))
+				return ptr;
+			*offset += get_tarval_long(get_Const_tarval(r));
+			ptr      = get_Add_left(ptr);
+		} else if (is_Sel(ptr)) {
+			ir_entity *ent   = get_Sel_entity(ptr);
+			ir_type   *owner = get_entity_owner(ent);
+			if (get_Sel_n_indexs(ptr) > 0) {
+				ir_type *tp;
+				ir_node *index;
+				/* only one dimensional arrays */
+				if (!is_Array_type(owner) || get_Sel_n_indexs(ptr) != 1)
+					return ptr;
+				index = get_Sel_index(ptr, 0);
+				tp    = get_entity_type(ent);
+				if (!is_Const(index) || get_type_state(tp) != layout_fixed)
+					return ptr;
+				*offset += get_type_size_bytes(tp)
+				           * get_tarval_long(get_Const_tarval(index));
+			} else {
+				if (get_type_state(owner) != layout_fixed)
+					return ptr;
+				*offset += get_entity_offset(ent);
+			}
+			ptr = get_Sel_ptr(ptr);
+		} else {
+			return ptr;
+		}
+	}
+}
+
+/**
+ * Returns the known alignment of the memory addressed by @p base.
+ */
+static unsigned get_base_alignment(const ir_node *base)
+{
+	ir_entity *ent;
+	if (is_Sel(base) && get_Sel_n_indexs(base) == 0
+	    && get_Sel_ptr(base) == get_irg_frame(get_irn_irg(base))) {
+		ent = get_Sel_entity(base);
+	} else if (is_SymConst_addr_ent(base)) {
+		ent = get_SymConst_entity(base);
+	} else {
+		return 1;
+	}
+	unsigned const align = get_type_alignment_bytes(get_entity_type(ent));
+	unsigned const ent_align = get_entity_alignment(ent);
+	return ent_align > align ? ent_align : align;
+}
+
+/**
+ * Returns true if the Store is a candidate for combining.
+ */
+static bool is_combinable_store(const ir_node *store)
+{
+	return get_Store_volatility(store) == volatility_non_volatile
+	    && !ir_throws_exception(store)
+	    && is_Const(get_Store_value(store));
+}
+
+/**
+ * Returns the value of the Const @p c zero extended to @p mode.
+ */
+static ir_tarval *zero_extend(const ir_node *c, ir_mode *mode)
+{
+	ir_tarval *tv = get_Const_tarval(c);
+	tv = tarval_convert_to(tv, find_unsigned_mode(get_tarval_mode(tv)));
+	tv = tarval_convert_to(tv, find_unsigned_mode(mode));
+	return tarval_convert_to(tv, mode);
+}
+
+/**
+ * Post-walker, combines a Store with the Store producing its memory.
+ */
+static void combine_walker(ir_node *store, void *env)
+{
+	bool *changed = (bool*)env;
+
+	if (!is_Store(store) || !is_combinable_store(store))
+		return;
+	ir_node *mem = get_Store_mem(store);
+	if (!is_Proj(mem) || get_irn_n_edges(mem) != 1)
+		return;
+	ir_node *prev = get_Proj_pred(mem);
+	if (!is_Store(prev) || !is_combinable_store(prev))
+		return;
+
+	ir_node *value      = get_Store_value(store);
+	ir_node *prev_value = get_Store_value(prev);
+	ir_mode *mode       = get_irn_mode(value);
+	if (get_irn_mode(prev_value) != mode || !mode_is_int(mode))
+		return;
+	ir_mode *wide = find_double_bits_int_mode(mode);
+	if (wide == NULL
+	    || get_mode_size_bits(wide) > be_get_backend_param()->machine_size)
+		return;
+
+	long     offset;
+	long     prev_offset;
+	ir_node *base      = get_base_and_offset(get_Store_ptr(store), &offset);
+	ir_node *prev_base = get_base_and_offset(get_Store_ptr(prev), &prev_offset);
+	long     size      = get_mode_size_bytes(mode);
+	if (base != prev_base || (offset - prev_offset != size
+	                          && prev_offset - offset != size))
+		return;
+
+	/* the combined Store must be aligned */
+	long     low_offset = offset < prev_offset ? offset : prev_offset;
+	unsigned wide_size  = get_mode_size_bytes(wide);
+	if (low_offset % (long)wide_size != 0 || get_base_alignment(base) < wide_size)
+		return;
+
+	ir_node *low  = offset < prev_offset ? value : prev_value;
+	ir_node *high = offset < prev_offset ? prev_value : value;
+	if (be_get_backend_param()->byte_order_big_endian) {
+		ir_node *t = low;
+		low  = high;
+		high = t;
+	}
+	ir_tarval *shift = new_tarval_from_long(get_mode_size_bits(mode), mode_Iu);
+	ir_tarval *tv    = tarval_or(zero_extend(low, wide),
+	                             tarval_shl(zero_extend(high, wide), shift));
+
+	ir_graph *irg      = get_irn_irg(store);
+	ir_node  *block    = get_nodes_block(store);
+	ir_node  *ptr      = offset < prev_offset ? get_Store_ptr(store)
+	                                          : get_Store_ptr(prev);
+	ir_node  *combined = new_rd_Store(get_irn_dbg_info(store), block,
+	                                  get_Store_mem(prev), ptr,
+	                                  new_r_Const(irg, tv), cons_none);
+	ir_node  *new_mem  = new_r_Proj(combined, mode_M, pn_Store_M);
+
+	DB((dbg, LEVEL_2, "combined %+F and %+F into %+F\n", prev, store, combined));
+	foreach_out_edge_safe(store, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		assert(is_Proj(proj) && get_Proj_proj(proj) == pn_Store_M);
+		exchange(proj, new_mem);
+	}
+	/* the memory of prev must not look used by the old Store */
+	kill_node(store);
+	kill_node(mem);
+	kill_node(prev);
+	*changed = true;
+}
+
+void opt_combine_stores(ir_graph *irg)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.opt.combine_stores");
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+
+	bool changed;
+	bool any_changed = false;
+	do {
+		changed = false;
+		irg_walk_graph(irg, NULL, combine_walker, &changed);
+		any_changed |= changed;
+	} while (changed);
+
+	confirm_irg_properties(irg, any_changed
+		? IR_GRAPH_PROPERTIES_CONTROL_FLOW : IR_GRAPH_PROPERTIES_ALL);
+}
@@ -44,9 +44,11 @@
  * Firm tarval/entity, nevertheless we call it type here for "maximum compatibility".
  */
 #include <assert.h>
+#include <string.h>
 
 #include "iroptimize.h"
 #include "irflag.h"
+#include "irgopt.h"
 #include "ircons.h"
 #include "list.h"
 #include "set.h"
@@ -57,11 +59,12 @@
 #include "iropt_t.h"
 #include "irgwalk.h"
 #include "irop.h"
-#include "irouts.h"
+#include "irouts_t.h"
 #include "irgmod.h"
 #include "iropt_dbg.h"
 #include "debug.h"
 #include "array_t.h"
+#include "xmalloc.h"
 #include "error.h"
 #include "irnodeset.h"
 #include "tv_t.h"
@@ -164,6 +167,8 @@ struct partition_t {
 
 typedef struct environment_t {
 	struct obstack  obst;           /**< obstack to allocate data structures. */
+	node_t          *nodes;         /**< The nodes, indexed by node index. */
+	ir_def_use_edge *edge_buf;      /**< Scratch array for sorting Def-Use edges. */
 	partition_t     *worklist;      /**< The work list. */
 	partition_t     *cprop;         /**< The constant propagation list. */
 	partition_t     *touched;       /**< the touched set. */
@@ -574,28 +579,70 @@ static int cmp_opcode(const void *elt, const void *key, size_t size)
 	return cmp_irn_opcode(o1->irn, o2->irn);
 }
 
-/**
- * Compare two Def-Use edges for input position.
- */
-static int cmp_def_use_edge(const void *a, const void *b)
-{
-	const ir_def_use_edge *ea = (const ir_def_use_edge*)a;
-	const ir_def_use_edge *eb = (const ir_def_use_edge*)b;
-
-	/* no overrun, because range is [-1, MAXINT] */
-	return ea->pos - eb->pos;
-}
+/** Below this number of edges an insertion sort is faster. */
+#define EDGE_RADIX_SORT_MIN 16
 
 /**
- * We need the Def-Use edges sorted.
- */
-static void sort_irn_outs(node_t *node)
-{
-	ir_node *irn = node->node;
-	unsigned n_outs = get_irn_n_outs(irn);
-	qsort(irn->o.out->edges, n_outs, sizeof(irn->o.out->edges[0]),
-		  cmp_def_use_edge);
-	node->max_user_input = n_outs > 0 ? irn->o.out->edges[n_outs-1].pos : -1;
+ * Sorts Def-Use edges by input position with a byte wise LSD radix sort.
+ * The positions are in [-1, MAXINT], so they are sorted with a bias of one.
+ *
+ * @param edges  the edges
+ * @param n      the number of edges
+ * @param max    the maximum input position of the edges
+ * @param buf    a scratch array with room for n edges
+ */
+static void radix_sort_edges(ir_def_use_edge *edges, unsigned n, int max,
+                             ir_def_use_edge *buf)
+{
+	ir_def_use_edge *from = edges;
+	ir_def_use_edge *to   = buf;
+	unsigned const   max_key = (unsigned)max + 1;
+	for (unsigned shift = 0; shift < 32 && max_key >> shift != 0; shift += 8) {
+		unsigned start[257];
+		memset(start, 0, sizeof(start));
+		for (unsigned i = 0; i < n; ++i)
+			++start[(((unsigned)from[i].pos + 1) >> shift & 0xFF) + 1];
+		for (unsigned d = 1; d < 257; ++d)
+			start[d] += start[d - 1];
+		for (unsigned i = 0; i < n; ++i)
+			to[start[((unsigned)from[i].pos + 1) >> shift & 0xFF]++] = from[i];
+
+		ir_def_use_edge *const t = from;
+		from = to;
+		to   = t;
+	}
+	if (from != edges)
+		memcpy(edges, from, n * sizeof(*edges));
+}
+
+/**
+ * We need the Def-Use edges sorted by input position.
+ */
+static void sort_irn_outs(node_t *node, environment_t *env)
+{
+	ir_node         *irn    = node->node;
+	unsigned         n_outs = get_irn_n_outs(irn);
+	ir_def_use_edge *edges  = irn->o.out->edges;
+
+	if (n_outs < EDGE_RADIX_SORT_MIN) {
+		for (unsigned i = 1; i < n_outs; ++i) {
+			ir_def_use_edge const edge = edges[i];
+			unsigned              j    = i;
+			for (; j > 0 && edges[j - 1].pos > edge.pos; --j)
+				edges[j] = edges[j - 1];
+			edges[j] = edge;
+		}
+	} else {
+		int max = -1;
+		for (unsigned i = 0; i < n_outs; ++i) {
+			if (edges[i].pos > max)
+				max = edges[i].pos;
+		}
+		if (ARR_LEN(env->edge_buf) < n_outs)
+			ARR_RESIZE(ir_def_use_edge, env->edge_buf, n_outs);
+		radix_sort_edges(edges, n_outs, max, env->edge_buf);
+	}
+	node->max_user_input = n_outs > 0 ? edges[n_outs-1].pos : -1;
 }
 
 /**
@@ -709,7 +756,7 @@ static inline lattice_elem_t get_partition_type(const partition_t *X)
 static node_t *create_partition_node(ir_node *irn, partition_t *part, environment_t *env)
 {
 	/* create a partition node and place it in the partition */
-	node_t *node = OALLOC(&env->obst, node_t);
+	node_t *node = &env->nodes[get_irn_idx(irn)];
 
 	INIT_LIST_HEAD(&node->node_list);
 	INIT_LIST_HEAD(&node->cprop_list);
@@ -745,7 +792,7 @@ static void create_initial_partitions(ir_node *irn, void *ctx)
 	node_t        *node;
 
 	node = create_partition_node(irn, part, env);
-	sort_irn_outs(node);
+	sort_irn_outs(node, env);
 	if (node->max_user_input > part->max_user_inputs)
 		part->max_user_inputs = node->max_user_input;
 
@@ -3500,6 +3547,13 @@ void combo(ir_graph *irg)
 	ir_graph      *rem = current_ir_graph;
 	size_t        len;
 
+	/* combo allocates a node_t for every node on top of the graph, graphs
+	   beyond the memory budget only get the local optimizations */
+	if (irg_memory_budget_exceeded(irg)) {
+		optimize_graph_df(irg);
+		return;
+	}
+
 	assure_irg_properties(irg,
 		IR_GRAPH_PROPERTY_NO_BADS
 		| IR_GRAPH_PROPERTY_CONSISTENT_OUTS
@@ -3513,6 +3567,10 @@ void combo(ir_graph *irg)
 	DB((dbg, LEVEL_1, "Doing COMBO for %+F\n", irg));
 
 	obstack_init(&env.obst);
+	/* the nodes are accessed along the Def-Use edges, keep them in one array
+	   in node index order instead of spreading them over the obstack */
+	env.nodes          = XMALLOCN(node_t, get_irg_last_idx(irg));
+	env.edge_buf       = NEW_ARR_F(ir_def_use_edge, 0);
 	env.worklist       = NULL;
 	env.cprop          = NULL;
 	env.touched        = NULL;
@@ -3602,6 +3660,8 @@ void combo(ir_graph *irg)
 	DEBUG_ONLY(set_dump_node_vcgattr_hook(NULL);)
 
 	DEL_ARR_F(env.kept_memory);
+	DEL_ARR_F(env.edge_buf);
+	free(env.nodes);
 	del_set(env.opcode2id_map);
 	obstack_free(&env.obst, NULL);
 
@@ -24,6 +24,7 @@
 #include "iroptimize.h"
 
 #include <stdbool.h>
+#include "array.h"
 #include "debug.h"
 #include "ircons.h"
 #include "irgmod.h"
@@ -242,7 +243,7 @@ static void conv_opt_walker(ir_node *node, void *data)
 	ir_mode *pred_mode;
 	ir_mode *mode;
 	int costs;
-	bool *changed = (bool*)data;
+	ir_node ***changed = (ir_node***)data;
 
 	if (!is_Conv(node))
 		return;
@@ -266,26 +267,30 @@ static void conv_opt_walker(ir_node *node, void *data)
 	transformed = conv_transform(pred, mode);
 	if (node != transformed) {
 		exchange(node, transformed);
-		*changed = true;
+		ARR_APP1(ir_node*, *changed, transformed);
 	}
 }
 
 void conv_opt(ir_graph *irg)
 {
-	bool global_changed = false;
-	bool changed;
+	bool      global_changed = false;
+	ir_node **changed        = NEW_ARR_F(ir_node*, 0);
 	FIRM_DBG_REGISTER(dbg, "firm.opt.conv");
 
 	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
 
 	DB((dbg, LEVEL_1, "===> Performing conversion optimization on %+F\n", irg));
 
-	do {
-		changed = false;
+	for (;;) {
+		ARR_SHRINKLEN(changed, 0);
 		irg_walk_graph(irg, NULL, conv_opt_walker, &changed);
-		local_optimize_graph(irg);
-		global_changed |= changed;
-	} while (changed);
+		if (ARR_LEN(changed) == 0)
+			break;
+		/* only the transformed nodes and their users need to be revisited */
+		local_optimize_nodes(irg, changed, ARR_LEN(changed));
+		global_changed = true;
+	}
+	DEL_ARR_F(changed);
 
 	confirm_irg_properties(irg,
 		global_changed ? IR_GRAPH_PROPERTIES_NONE : IR_GRAPH_PROPERTIES_ALL);
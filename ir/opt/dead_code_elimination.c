@@ -26,21 +26,78 @@
 #include "trouts.h"
 #include "iropt_t.h"
 #include "pmap.h"
+#include "array.h"
+#include "util.h"
+#include "xmalloc.h"
 
 /**
- * Reroute the inputs of a node from nodes in the old graph to copied nodes in
- * the new graph
+ * Post-walker: collects the nodes in topological order.
  */
-static void rewire_inputs(ir_node *node, void *env)
+static void collect_node(ir_node *node, void *env)
 {
-	(void) env;
-	irn_rewire_inputs(node);
+	ir_node ***nodes = (ir_node***)env;
+	ARR_APP1(ir_node*, *nodes, node);
 }
 
-static void copy_node_dce(ir_node *node, void *env)
+/**
+ * Returns the group of a node for the copy order: Every block forms a group
+ * with the nodes in it, group 0 contains the nodes without a block.
+ */
+static size_t get_copy_group(const ir_node *node)
+{
+	if (!is_Block(node)) {
+		node = get_nodes_block(node);
+		if (!is_Block(node))
+			return 0;
+	}
+	return PTR_TO_INT(get_irn_link(node));
+}
+
+/**
+ * Returns the nodes reachable from the anchor in the order in which they are
+ * copied: Grouped by block in the order in which the blocks are reached, every
+ * block followed by its nodes in topological order. This way the nodes which
+ * are accessed together by most passes are close in memory and get
+ * neighbouring node indices.
+ */
+static ir_node **get_copy_order(ir_graph *irg, size_t *n_nodes)
+{
+	ir_node **nodes = NEW_ARR_F(ir_node*, 0);
+	irg_walk_in_or_dep(irg->anchor, NULL, collect_node, &nodes);
+
+	size_t const n        = ARR_LEN(nodes);
+	size_t       n_groups = 1;
+	for (size_t i = 0; i < n; ++i) {
+		if (is_Block(nodes[i]))
+			set_irn_link(nodes[i], INT_TO_PTR(n_groups++));
+	}
+
+	size_t *const start = XMALLOCNZ(size_t, n_groups + 1);
+	for (size_t i = 0; i < n; ++i)
+		++start[get_copy_group(nodes[i]) + 1];
+	for (size_t g = 1; g <= n_groups; ++g)
+		start[g] += start[g - 1];
+
+	/* place the blocks in front of their groups */
+	ir_node **const order = XMALLOCN(ir_node*, n);
+	for (size_t i = 0; i < n; ++i) {
+		if (is_Block(nodes[i]))
+			order[start[get_copy_group(nodes[i])]++] = nodes[i];
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (!is_Block(nodes[i]))
+			order[start[get_copy_group(nodes[i])]++] = nodes[i];
+	}
+
+	free(start);
+	DEL_ARR_F(nodes);
+	*n_nodes = n;
+	return order;
+}
+
+static void copy_node_dce(ir_node *node)
 {
-	ir_node  *new_node = exact_copy(node);
-	(void) env;
+	ir_node *new_node = exact_copy(node);
 
 	/* preserve the node numbers for easier debugging */
 	new_node->node_nr = node->node_nr;
@@ -51,8 +108,6 @@ static void copy_node_dce(ir_node *node, void *env)
 /**
  * Copies the graph reachable from the End node to the obstack
  * in irg. Then fixes the fields containing nodes of the graph.
- *
- * @param copy_node_nr  If non-zero, the node number will be copied
  */
 static void copy_graph_env(ir_graph *irg)
 {
@@ -60,7 +115,15 @@ static void copy_graph_env(ir_graph *irg)
 	ir_node *new_anchor;
 
 	/* copy nodes */
-	irg_walk_in_or_dep(anchor, copy_node_dce, rewire_inputs, NULL);
+	size_t    n_nodes;
+	ir_node **order = get_copy_order(irg, &n_nodes);
+	for (size_t i = 0; i < n_nodes; ++i)
+		copy_node_dce(order[i]);
+
+	/* reroute the inputs from the old nodes to the copied ones */
+	for (size_t i = 0; i < n_nodes; ++i)
+		irn_rewire_inputs(order[i]);
+	free(order);
 
 	/* fix the anchor */
 	new_anchor = (ir_node*)get_irn_link(anchor);
@@ -89,14 +152,15 @@ void dead_node_elimination(ir_graph *irg)
 	free_trouts();
 	free_loop_information(irg);
 	free_vrp_data(irg);
-	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE);
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                        | IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE);
 
 	/* A quiet place, where the old obstack can rest in peace,
 	   until it will be cremated. */
 	struct obstack graveyard_obst = irg->obst;
 
 	/* A new obstack, where the reachable nodes will be copied to. */
-	obstack_init(&irg->obst);
+	init_irg_obstack(irg, &irg->obst, IR_GRAPH_MEMORY_NODES);
 	irg->last_node_idx = 0;
 
 	/* We also need a new value table for CSE */
@@ -0,0 +1,318 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 Karlsruhe Institute of Technology.
+ */
+
+/**
+ * @file
+ * @brief   Devirtualization of indirect calls.
+ *
+ * A Sel of a method whose overwriting methods have no other implementation
+ * is replaced by the address of the only implementation (class hierarchy
+ * analysis).
+ *
+ * An indirect call whose most frequent target is known from a profile is
+ * guarded by a comparison of the callee with that target:
+ *
+ *    if (ptr == target)
+ *        res = target(args);
+ *    else
+ *        res = ptr(args);
+ *
+ * The direct call is a candidate for the inliner while the indirect call
+ * stays for all other targets.
+ */
+#include "iroptimize.h"
+
+#include <stdbool.h>
+
+#include "array.h"
+#include "debug.h"
+#include "ircons.h"
+#include "irgmod.h"
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "irprofile.h"
+#include "irprog_t.h"
+#include "pmap.h"
+#include "typerep.h"
+#include "util.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+typedef struct devirt_env_t {
+	ir_node **calls;     /**< the calls to devirtualize */
+	double    min_ratio; /**< minimal share of the target in the calls */
+} devirt_env_t;
+
+/**
+ * Returns the profiled target of an indirect call if it is frequent enough.
+ */
+static ir_entity *get_frequent_target(const ir_node *call, double min_ratio)
+{
+	uint32_t   count;
+	uint32_t   total;
+	ir_entity *target = ir_profile_get_call_target(call, &count, &total);
+	if (target == NULL || total == 0 || count < min_ratio * total)
+		return NULL;
+	return target;
+}
+
+/**
+ * Walker, collects the indirect calls with a frequent target.
+ */
+static void collect_calls(ir_node *node, void *data)
+{
+	devirt_env_t *env = (devirt_env_t*)data;
+	if (!is_Call(node) || is_SymConst_addr_ent(get_Call_ptr(node)))
+		return;
+	if (get_frequent_target(node, env->min_ratio) == NULL)
+		return;
+	ARR_APP1(ir_node*, env->calls, node);
+}
+
+/**
+ * Returns true if the control flow of @p call can be split: calls in the
+ * start block, calls with exception control flow and calls kept alive
+ * because they do not return are left alone.
+ */
+static bool can_split_call(ir_node *call)
+{
+	ir_graph *irg = get_irn_irg(call);
+	if (get_nodes_block(call) == get_irg_start_block(irg))
+		return false;
+
+	for (ir_node *proj = (ir_node*)get_irn_link(call); proj != NULL;
+	     proj = (ir_node*)get_irn_link(proj)) {
+		if (get_Proj_pred(proj) != call)
+			continue;
+		long const pn = get_Proj_proj(proj);
+		if (pn == pn_Call_X_regular || pn == pn_Call_X_except)
+			return false;
+	}
+
+	ir_node *end = get_irg_end(irg);
+	for (int i = 0, n = get_End_n_keepalives(end); i < n; ++i) {
+		if (get_End_keepalive(end, i) == call)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Replaces @p call by a direct call of @p target guarded by a comparison of
+ * the callee and a copy of the indirect call for the other callees. Their
+ * memory and results are merged by Phis in the block of the call.
+ */
+static void devirtualize_call(ir_node *call, ir_entity *target)
+{
+	ir_graph *irg         = get_irn_irg(call);
+	ir_node  *lower_block = get_nodes_block(call);
+	part_block(call);
+	ir_node  *upper_block = get_nodes_block(call);
+
+	symconst_symbol sym;
+	sym.entity_p = target;
+	ir_node *ptr    = get_Call_ptr(call);
+	ir_node *callee = new_r_SymConst(irg, get_irn_mode(ptr), sym,
+	                                 symconst_addr_ent);
+	ir_node *cmp    = new_r_Cmp(upper_block, ptr, callee, ir_relation_equal);
+	ir_node *cond   = new_r_Cond(upper_block, cmp);
+	set_Cond_jmp_pred(cond, COND_JMP_PRED_TRUE);
+	ir_node *proj_true  = new_r_Proj(cond, mode_X, pn_Cond_true);
+	ir_node *proj_false = new_r_Proj(cond, mode_X, pn_Cond_false);
+
+	ir_node  *mem      = get_Call_mem(call);
+	int       n_params = get_Call_n_params(call);
+	ir_node **params   = get_Call_param_arr(call);
+	ir_type  *type     = get_Call_type(call);
+	ir_node  *blocks[2];
+	ir_node  *calls[2];
+	ir_node  *jmps[2];
+	blocks[0] = new_r_Block(irg, 1, &proj_true);
+	blocks[1] = new_r_Block(irg, 1, &proj_false);
+	calls[0]  = new_r_Call(blocks[0], mem, callee, n_params, params, type);
+	calls[1]  = new_r_Call(blocks[1], mem, ptr, n_params, params, type);
+	jmps[0]   = new_r_Jmp(blocks[0]);
+	jmps[1]   = new_r_Jmp(blocks[1]);
+
+	/* Kill the jump from upper to lower block and replace the in array. */
+	assert(get_Block_n_cfgpreds(lower_block) == 1);
+	kill_node(get_Block_cfgpred(lower_block, 0));
+	set_irn_in(lower_block, ARRAY_SIZE(jmps), jmps);
+
+	/* the Proj list changes while the Projs are replaced */
+	ir_node **projs = NEW_ARR_F(ir_node*, 0);
+	for (ir_node *proj = (ir_node*)get_irn_link(call); proj != NULL;
+	     proj = (ir_node*)get_irn_link(proj)) {
+		ARR_APP1(ir_node*, projs, proj);
+	}
+
+	for (size_t p = 0, n = ARR_LEN(projs); p < n; ++p) {
+		ir_node *proj = projs[p];
+		ir_mode *mode = get_irn_mode(proj);
+		long     pn   = get_Proj_proj(proj);
+		ir_node *ins[ARRAY_SIZE(calls)];
+		if (get_Proj_pred(proj) == call) {
+			if (pn != pn_Call_M)
+				continue;
+			for (size_t i = 0; i < ARRAY_SIZE(calls); ++i)
+				ins[i] = new_r_Proj(calls[i], mode_M, pn_Call_M);
+		} else {
+			for (size_t i = 0; i < ARRAY_SIZE(calls); ++i) {
+				ir_node *results = new_r_Proj(calls[i], mode_T,
+				                              pn_Call_T_result);
+				ins[i] = new_r_Proj(results, mode, pn);
+			}
+		}
+		ir_node *phi = new_r_Phi(lower_block, ARRAY_SIZE(ins), ins, mode);
+		exchange(proj, phi);
+		/* keep the Phi list valid for the next part_block() */
+		add_Block_phi(lower_block, phi);
+	}
+	DEL_ARR_F(projs);
+
+	DB((dbg, LEVEL_2, "guarded %+F with a direct call of %+F\n", call,
+	    target));
+}
+
+void opt_speculative_devirt(ir_graph *irg, double min_ratio)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.opt.devirt");
+
+	devirt_env_t env;
+	env.calls     = NEW_ARR_F(ir_node*, 0);
+	env.min_ratio = min_ratio;
+	irg_walk_graph(irg, NULL, collect_calls, &env);
+
+	bool changed = false;
+	if (ARR_LEN(env.calls) > 0) {
+		ir_resources_t resources = IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST;
+
+		/* This is required by part_block() later. */
+		ir_reserve_resources(irg, resources);
+		collect_phiprojs(irg);
+
+		for (size_t i = 0, n = ARR_LEN(env.calls); i < n; ++i) {
+			ir_node *call = env.calls[i];
+			if (!can_split_call(call))
+				continue;
+			devirtualize_call(call, get_frequent_target(call, min_ratio));
+			changed = true;
+		}
+
+		ir_free_resources(irg, resources);
+	}
+	DEL_ARR_F(env.calls);
+
+	confirm_irg_properties(irg, changed
+		? IR_GRAPH_PROPERTIES_NONE : IR_GRAPH_PROPERTIES_ALL);
+}
+
+/**
+ * Adds the implementation of @p ent to @p impl. Returns false if @p impl
+ * already holds another implementation.
+ */
+static bool add_impl(ir_entity **impl, ir_entity *ent)
+{
+	/* abstract methods are never called */
+	if (get_entity_peculiarity(ent) == peculiarity_description)
+		return true;
+	/* inherited copies share the graph of their implementation */
+	ir_graph *irg = get_entity_irg(ent);
+	if (irg != NULL)
+		ent = get_irg_entity(irg);
+	if (*impl != NULL && *impl != ent)
+		return false;
+	*impl = ent;
+	return true;
+}
+
+/**
+ * Returns the only implementation of @p method and all methods overwriting
+ * it, NULL if there is none or more than one.
+ */
+static ir_entity *get_single_impl(ir_entity *method)
+{
+	ir_entity *impl = NULL;
+	if (!add_impl(&impl, method))
+		return NULL;
+	for (ir_entity *ent = get_entity_trans_overwrittenby_first(method);
+	     ent != NULL; ent = get_entity_trans_overwrittenby_next(method)) {
+		if (!add_impl(&impl, ent))
+			return NULL;
+	}
+	return impl;
+}
+
+typedef struct class_devirt_env_t {
+	pmap *impls;   /**< caches the result of get_single_impl() */
+	bool  changed; /**< set if the graph was changed */
+} class_devirt_env_t;
+
+/**
+ * Walker, replaces Sels of methods with a single implementation.
+ */
+static void devirt_sel(ir_node *node, void *data)
+{
+	class_devirt_env_t *env = (class_devirt_env_t*)data;
+	if (!is_Sel(node))
+		return;
+	ir_entity *entity = get_Sel_entity(node);
+	if (!is_method_entity(entity))
+		return;
+
+	/* the Sel selects a vtable entry holding the address of the method */
+	const ir_initializer_t *initializer = get_entity_initializer(entity);
+	if (initializer == NULL
+	    || get_initializer_kind(initializer) != IR_INITIALIZER_CONST)
+		return;
+	ir_node *value = get_initializer_const_value(initializer);
+	if (!is_SymConst_addr_ent(value))
+		return;
+
+	ir_entity  *method = get_SymConst_entity(value);
+	pmap_entry *entry  = pmap_find(env->impls, method);
+	ir_entity  *impl;
+	if (entry != NULL) {
+		impl = (ir_entity*)entry->value;
+	} else {
+		impl = get_single_impl(method);
+		pmap_insert(env->impls, method, impl);
+	}
+	if (impl == NULL)
+		return;
+
+	symconst_symbol sym;
+	sym.entity_p = impl;
+	ir_node *addr = new_r_SymConst(get_irn_irg(node), get_irn_mode(node), sym,
+	                               symconst_addr_ent);
+	DB((dbg, LEVEL_2, "replaced %+F by the address of %+F\n", node, impl));
+	exchange(node, addr);
+	env->changed = true;
+}
+
+void opt_class_devirt(void)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.opt.devirt");
+
+	bool own_closure = get_irp_inh_transitive_closure_state()
+	                   != inh_transitive_closure_valid;
+	if (own_closure)
+		compute_inh_transitive_closure();
+
+	class_devirt_env_t env;
+	env.impls = pmap_create();
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		env.changed = false;
+		irg_walk_graph(irg, NULL, devirt_sel, &env);
+		confirm_irg_properties(irg, env.changed
+			? IR_GRAPH_PROPERTIES_CONTROL_FLOW : IR_GRAPH_PROPERTIES_ALL);
+	}
+	pmap_destroy(env.impls);
+
+	if (own_closure)
+		free_inh_transitive_closure();
+}
@@ -16,6 +16,8 @@
 #include "type_t.h"
 #include "irgwalk.h"
 #include "irouts.h"
+#include "irloop.h"
+#include "irnodeset.h"
 #include "analyze_irg_args.h"
 #include "irgmod.h"
 #include "ircons.h"
@@ -24,6 +26,9 @@
 #include "error.h"
 #include "util.h"
 
+/** allocations up to this size in bytes are placed on the frame */
+#define MAX_FRAME_ALLOC_SIZE 1024
+
 /**
  * walker environment
  */
@@ -114,18 +119,40 @@ static ir_node *is_depend_alloc(ir_node *adr)
 /**
  * determine if a value calculated by n "escape", ie
  * is stored somewhere we could not track
+ *
+ * The callees are judged by their parameter access summary, so a pointer
+ * passed to a function which does not store or return it does not escape.
+ * If the allocation is inside a loop, a Phi might carry the pointer into the
+ * next iteration where it would alias the next allocation, so it escapes.
+ * The nodes already checked are kept in @p visited so cycles through Phis
+ * end the search. The visited flags are not used as the parameter access
+ * analysis of a callee might need them.
  */
-static int can_escape(ir_node *n)
+static int can_escape(ir_node *n, bool in_loop, ir_nodeset_t *visited)
 {
 	int i;
 
 	/* should always be pointer mode or we made some mistake */
 	assert(mode_is_reference(get_irn_mode(n)));
 
+	if (!ir_nodeset_insert(visited, n))
+		return 0;
+
 	for (i = get_irn_n_outs(n) - 1; i >= 0; --i) {
 		ir_node *succ = get_irn_out(n, i);
 
 		switch (get_irn_opcode(succ)) {
+		case iro_Phi:
+			if (in_loop)
+				return 1;
+			break;
+
+		case iro_ASM:
+		case iro_Builtin:
+		case iro_Free:
+			/* unknown uses of the pointer */
+			return 1;
+
 		case iro_Store:
 			if (get_Store_value(succ) == n) {
 				ir_node *adr = get_Store_ptr(succ);
@@ -156,7 +183,10 @@ static int can_escape(ir_node *n)
 			ir_node *ptr = get_Call_ptr(succ);
 			ir_entity *ent;
 
-			if (is_SymConst_addr_ent(ptr)) {
+			if (ptr == n) {
+				/* called?! */
+				return 1;
+			} else if (is_SymConst_addr_ent(ptr)) {
 			    size_t j;
 			    ent = get_SymConst_entity(ptr);
 
@@ -219,7 +249,7 @@ static int can_escape(ir_node *n)
 			assert(j >= 0);
 
 
-			for (k = get_irn_n_outs(succ); k >= 0; --k) {
+			for (k = get_irn_n_outs(succ) - 1; k >= 0; --k) {
 				proj = get_irn_out(succ, k);
 
 				if (get_Proj_proj(proj) == j) {
@@ -244,7 +274,7 @@ static int can_escape(ir_node *n)
 		if (! mode_is_reference(get_irn_mode(succ)))
 			continue;
 
-		if (can_escape(succ))
+		if (can_escape(succ, in_loop, visited))
 			return 1;
 	}
 	return 0;
@@ -341,9 +371,54 @@ static void find_allocation_calls(ir_node *call, void *ctx)
 		return;
 	}
 
-	if (! can_escape(adr)) {
-		set_irn_link(call, env->found_allocs);
-		env->found_allocs = call;
+	/* the candidates are checked after the walk, the parameter access
+	 * analysis of the callees must not run during it */
+	set_irn_link(call, env->found_allocs);
+	env->found_allocs = call;
+}
+
+/**
+ * Returns the address result of an allocation call.
+ */
+static ir_node *get_alloc_call_result(ir_node *call)
+{
+	for (int i = get_irn_n_outs(call) - 1; i >= 0; --i) {
+		ir_node *res_proj = get_irn_out(call, i);
+		if (get_Proj_proj(res_proj) != pn_Call_T_result)
+			continue;
+		for (int j = get_irn_n_outs(res_proj) - 1; j >= 0; --j) {
+			ir_node *proj = get_irn_out(res_proj, j);
+			if (get_Proj_proj(proj) == 0)
+				return proj;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Searches the allocation calls of a graph whose result does not escape.
+ */
+static void find_non_escaping_calls(ir_graph *irg, walk_env_t *env)
+{
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS
+	                         | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+	irg_walk_graph(irg, NULL, find_allocation_calls, env);
+
+	ir_node *candidates = env->found_allocs;
+	env->found_allocs = NULL;
+
+	for (ir_node *call = candidates, *next; call != NULL; call = next) {
+		next = (ir_node*)get_irn_link(call);
+
+		ir_loop     *loop    = get_irn_loop(get_nodes_block(call));
+		bool         in_loop = loop != NULL && get_loop_depth(loop) > 0;
+		ir_nodeset_t visited;
+		ir_nodeset_init(&visited);
+		if (! can_escape(get_alloc_call_result(call), in_loop, &visited)) {
+			set_irn_link(call, env->found_allocs);
+			env->found_allocs = call;
+		}
+		ir_nodeset_destroy(&visited);
 	}
 }
 
@@ -471,8 +546,63 @@ static void transform_alloc_calls(ir_graph *irg, walk_env_t *env)
 	}
 
 	/* convert all non-escaped heap allocs into frame variables */
+	ir_type  *frame_type = get_irg_frame_type(irg);
+	unsigned  alignment  = 2 * get_mode_size_bytes(mode_P);
 	for (call = env->found_allocs; call; call = next) {
 		next = (ir_node*)get_irn_link(call);
+
+		/* the allocation routine takes the size in bytes like malloc() */
+		if (get_Call_n_params(call) != 1)
+			continue;
+		ir_node *size = get_Call_param(call, 0);
+
+		dbg_info *dbg = get_irn_dbg_info(call);
+		ir_node  *res;
+		blk = get_nodes_block(call);
+		mem = get_Call_mem(call);
+		if (is_Const(size) && tarval_is_long(get_Const_tarval(size))
+		    && get_tarval_long(get_Const_tarval(size)) > 0
+		    && get_tarval_long(get_Const_tarval(size)) <= MAX_FRAME_ALLOC_SIZE) {
+			unsigned n_bytes = (unsigned)get_tarval_long(get_Const_tarval(size));
+
+			char name[128];
+			snprintf(name, sizeof(name), "%s_NE_%u",
+			         get_entity_name(get_irg_entity(irg)), env->nr_removed);
+			ir_type *type = new_type_array(1, get_type_for_mode(mode_Bu));
+			set_array_bounds_int(type, 0, 0, n_bytes);
+			set_type_size_bytes(type, n_bytes);
+			set_type_alignment_bytes(type, alignment);
+			set_type_state(type, layout_fixed);
+			ir_entity *ent = new_d_entity(frame_type, new_id_from_str(name),
+			                              type, dbg);
+
+			DBG((dbgHandle, LEVEL_1, "%+F allocation of %+F placed on frame\n", irg, call));
+			res = new_rd_simpleSel(dbg, blk, get_irg_no_mem(irg),
+			                       get_irg_frame(irg), ent);
+			++env->nr_removed;
+		} else {
+			ir_loop *loop = get_irn_loop(blk);
+			if (loop != NULL && get_loop_depth(loop) > 0) {
+				/* a stack allocation in a loop would grow the stack */
+				continue;
+			}
+
+			DBG((dbgHandle, LEVEL_1, "%+F allocation of %+F placed on stack\n", irg, call));
+			ir_node *alloc = new_rd_Alloc(dbg, blk, mem, size, alignment);
+			mem = new_r_Proj(alloc, mode_M, pn_Alloc_M);
+			res = new_r_Proj(alloc, get_irn_mode(get_alloc_call_result(call)),
+			                 pn_Alloc_res);
+			++env->nr_changed;
+		}
+
+		ir_node *const res_in[] = { res };
+		ir_node *const in[] = {
+			[pn_Call_M]         = mem,
+			[pn_Call_T_result]  = new_r_Tuple(blk, ARRAY_SIZE(res_in), res_in),
+			[pn_Call_X_regular] = new_r_Jmp(blk),
+			[pn_Call_X_except]  = new_r_Bad(irg, mode_X),
+		};
+		turn_into_tuple(call, ARRAY_SIZE(in), in);
 	}
 
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
@@ -490,9 +620,6 @@ void escape_enalysis_irg(ir_graph *irg, check_alloc_entity_func callback)
 		return;
 	}
 
-	if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS))
-		compute_irg_outs(irg);
-
 	env.found_allocs = NULL;
 	env.dead_allocs  = NULL;
 	env.callback     = callback;
@@ -502,9 +629,10 @@ void escape_enalysis_irg(ir_graph *irg, check_alloc_entity_func callback)
 
 	if (callback) {
 		/* search for Calls */
-		irg_walk_graph(irg, NULL, find_allocation_calls, &env);
+		find_non_escaping_calls(irg, &env);
 		transform_alloc_calls(irg, &env);
 	} else {
+		assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS);
 		/* search for Alloc nodes */
 		irg_walk_graph(irg, NULL, find_allocations, &env);
 		transform_allocs(irg, &env);
@@ -517,7 +645,6 @@ void escape_analysis(int run_scalar_replace, check_alloc_entity_func callback)
 	size_t i, n;
 	struct obstack obst;
 	walk_env_t *env, *elist;
-	(void) run_scalar_replace;
 
 	if (get_irp_callee_info_state() != irg_callee_info_consistent) {
 		assert(! "need callee info");
@@ -543,18 +670,18 @@ void escape_analysis(int run_scalar_replace, check_alloc_entity_func callback)
 	for (i = 0, n = get_irp_n_irgs(); i < n; ++i) {
 		ir_graph *irg = get_irp_irg(i);
 
-		assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS);
-
 		if (callback) {
 			/* search for Calls */
-			irg_walk_graph(irg, NULL, find_allocation_calls, env);
+			find_non_escaping_calls(irg, env);
 		} else {
 			/* search for Alloc nodes */
+			assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS);
 			irg_walk_graph(irg, NULL, find_allocations, env);
 		}
 
 		if (env->found_allocs || env->dead_allocs) {
 			env->nr_removed   = 0;
+			env->nr_changed   = 0;
 			env->nr_deads     = 0;
 			env->irg          = irg;
 			env->next         = elist;
@@ -571,6 +698,8 @@ void escape_analysis(int run_scalar_replace, check_alloc_entity_func callback)
 	if (callback) {
 		for (env = elist; env; env = env->next) {
 			transform_alloc_calls(env->irg, env);
+			if (run_scalar_replace && env->nr_removed > 0)
+				scalar_replacement_opt(env->irg);
 		}
 	} else {
 		for (env = elist; env; env = env->next) {
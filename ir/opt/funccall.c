@@ -13,6 +13,7 @@
 
 #include "irnode_t.h"
 #include "irgraph_t.h"
+#include "entity_t.h"
 #include "irgmod.h"
 #include "irgwalk.h"
 #include "dbginfo_t.h"
@@ -26,6 +27,9 @@
 #include "irtools.h"
 #include "raw_bitset.h"
 #include "debug.h"
+#include "irdom.h"
+#include "irnodeset.h"
+#include "memssa.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
@@ -166,7 +170,8 @@ static void fix_const_call_lists(ir_graph *irg, env_t *ctx)
 	if (exc_changed) {
 		/* ... including exception edges */
 		clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
-		                   | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+		                   | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO
+		                   | IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY);
 	}
 }
 
@@ -258,7 +263,8 @@ static void fix_nothrow_call_list(ir_graph *irg, ir_node **call_list)
 	if (exc_changed) {
 		/* ... including exception edges */
 		clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
-		                   | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+		                   | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO
+		                   | IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY);
 	}
 }
 
@@ -488,6 +494,323 @@ static mtp_additional_properties check_const_or_pure_function(ir_graph *irg, boo
 	return prop;
 }
 
+/**
+ * Returns the additional properties of the function called by call.
+ */
+static mtp_additional_properties get_call_properties(const ir_node *call)
+{
+	mtp_additional_properties prop
+		= get_method_additional_properties(get_Call_type(call));
+	ir_node *ptr = get_Call_ptr(call);
+	if (is_SymConst_addr_ent(ptr))
+		prop |= get_entity_additional_properties(get_SymConst_entity(ptr));
+	return prop;
+}
+
+/**
+ * Returns the memory input of the operation producing mem if the operation
+ * does not change memory a pure function can read, NULL otherwise.
+ */
+static ir_node *get_invisible_op_mem(ir_memssa_t *ssa, ir_node *mem)
+{
+	if (!is_Proj(mem))
+		return NULL;
+
+	ir_node *op = get_Proj_pred(mem);
+	switch (get_irn_opcode(op)) {
+	case iro_Load:
+		if (get_Load_volatility(op) == volatility_is_volatile)
+			return NULL;
+		return get_Load_mem(op);
+
+	case iro_Store:
+		/* a callee cannot read frame entities whose address is not taken */
+		if (get_Store_volatility(op) == volatility_is_volatile
+		    || !memssa_is_local(ssa, memssa_get_partition(ssa, op)))
+			return NULL;
+		return get_Store_mem(op);
+
+	case iro_Call:
+		if ((get_call_properties(op)
+		     & (mtp_property_const|mtp_property_pure)) == 0)
+			return NULL;
+		return get_Call_mem(op);
+
+	case iro_Div:
+		return get_Div_mem(op);
+
+	case iro_Mod:
+		return get_Mod_mem(op);
+
+	default:
+		return NULL;
+	}
+}
+
+/**
+ * Returns the single memory value all memory merged by the Phi or Sync mem
+ * comes from, if the operations on the way cannot change what a pure
+ * function reads, NULL otherwise.
+ */
+static ir_node *get_region_origin(ir_memssa_t *ssa, ir_node *mem)
+{
+	ir_node      *origin   = NULL;
+	ir_node     **worklist = NEW_ARR_F(ir_node*, 1);
+	ir_nodeset_t  visited;
+
+	worklist[0] = mem;
+	ir_nodeset_init(&visited);
+	while (ARR_LEN(worklist) > 0) {
+		ir_node *node = worklist[ARR_LEN(worklist) - 1];
+		ARR_SHRINKLEN(worklist, ARR_LEN(worklist) - 1);
+		if (!ir_nodeset_insert(&visited, node))
+			continue;
+
+		if (is_Phi(node) || is_Sync(node)) {
+			for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+				ARR_APP1(ir_node*, worklist, get_irn_n(node, i));
+			}
+			continue;
+		}
+		ir_node *next = get_invisible_op_mem(ssa, node);
+		if (next != NULL) {
+			ARR_APP1(ir_node*, worklist, next);
+		} else if (origin == NULL) {
+			origin = node;
+		} else if (origin != node) {
+			origin = NULL;
+			break;
+		}
+	}
+	ir_nodeset_destroy(&visited);
+	DEL_ARR_F(worklist);
+	return origin;
+}
+
+/**
+ * Checks whether two Calls compute the same value given the same memory.
+ */
+static bool calls_are_equal(const ir_node *a, const ir_node *b)
+{
+	if (get_Call_ptr(a) != get_Call_ptr(b)
+	    || get_Call_type(a) != get_Call_type(b))
+		return false;
+
+	int n = get_Call_n_params(a);
+	for (int i = 0; i < n; ++i) {
+		if (get_Call_param(a, i) != get_Call_param(b, i))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Skips the memory operations before mem which do not change what a pure
+ * function can read. If call is given, stops at a Call equal to it, which
+ * then dominates call and is returned in *equal.
+ */
+static ir_node *skip_invisible_mem(ir_memssa_t *ssa, ir_node *mem,
+                                   const ir_node *call, ir_node **equal)
+{
+	for (;;) {
+		if (call != NULL && is_Proj(mem)) {
+			ir_node *op = get_Proj_pred(mem);
+			if (is_Call(op) && calls_are_equal(op, call)) {
+				*equal = op;
+				return mem;
+			}
+		}
+
+		ir_node *next = get_invisible_op_mem(ssa, mem);
+		/* memory flowing around a loop without visible changes comes
+		 * from before the loop */
+		if (next == NULL && (is_Phi(mem) || is_Sync(mem)))
+			next = get_region_origin(ssa, mem);
+		if (next == NULL)
+			return mem;
+		mem = next;
+	}
+}
+
+/**
+ * Checks whether a Call may be moved: it has no exception edges and its
+ * callee terminates.
+ */
+static bool is_movable_pure_call(const ir_node *call)
+{
+	if (get_call_properties(call) & mtp_property_has_loop)
+		return false;
+	foreach_out_edge(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (get_irn_mode(proj) == mode_X)
+			return false;
+	}
+	return true;
+}
+
+/**
+ * Replaces a pure Call by an equal one dominating it.
+ */
+static void replace_pure_call(ir_node *call, ir_node *equal)
+{
+	DB((dbg, LEVEL_1, "%+F is equal to %+F\n", call, equal));
+	foreach_out_edge_safe(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (!is_Proj(proj))
+			continue;
+		switch (get_Proj_proj(proj)) {
+		case pn_Call_M:
+			exchange(proj, get_Call_mem(call));
+			break;
+		case pn_Call_T_result:
+			exchange(proj, new_r_Proj(equal, mode_T, pn_Call_T_result));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+static bool is_in_loop(const ir_node *block, const ir_loop *loop)
+{
+	for (ir_loop *l = get_irn_loop(block); l != NULL;
+	     l = get_loop_outer_loop(l)) {
+		if (l == loop)
+			return true;
+		if (get_loop_depth(l) == 0)
+			break;
+	}
+	return false;
+}
+
+/**
+ * Checks whether block dominates all blocks of loop leaving it or jumping
+ * back to header, so every iteration executes block.
+ */
+static bool dominates_iterations(const ir_node *block, const ir_loop *outer,
+                                 const ir_loop *loop, const ir_node *header)
+{
+	for (size_t i = 0, n = get_loop_n_elements(loop); i < n; ++i) {
+		loop_element e = get_loop_element(loop, i);
+		if (*e.kind == k_ir_loop) {
+			if (!dominates_iterations(block, outer, e.son, header))
+				return false;
+			continue;
+		}
+		if (*e.kind != k_ir_node || !is_Block(e.node))
+			continue;
+		foreach_block_succ(e.node, edge) {
+			ir_node *succ = get_edge_src_irn(edge);
+			if ((succ == header || !is_in_loop(succ, outer))
+			    && !block_dominates(block, e.node))
+				return false;
+		}
+	}
+	return true;
+}
+
+static void move_projs(const ir_node *node, ir_node *block)
+{
+	foreach_out_edge(node, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (!is_Proj(proj))
+			continue;
+		set_nodes_block(proj, block);
+		if (get_irn_mode(proj) == mode_T)
+			move_projs(proj, block);
+	}
+}
+
+/**
+ * Moves a pure Call out of its innermost loop if its arguments and the
+ * memory it can read do not change in the loop. The Call must be executed
+ * in every iteration, so it is not executed speculatively.
+ */
+static bool hoist_pure_call(ir_memssa_t *ssa, ir_node *call)
+{
+	ir_node *block = get_nodes_block(call);
+	ir_loop *loop  = get_irn_loop(block);
+	if (loop == NULL || get_loop_depth(loop) == 0)
+		return false;
+
+	/* the header is the outermost dominator of block inside the loop */
+	ir_node *header = block;
+	for (ir_node *idom = get_Block_idom(header);
+	     idom != NULL && is_in_loop(idom, loop); idom = get_Block_idom(idom))
+		header = idom;
+
+	/* find the single block entering the loop */
+	ir_node *pre = NULL;
+	for (int i = 0, n = get_Block_n_cfgpreds(header); i < n; ++i) {
+		ir_node *pred = get_Block_cfgpred_block(header, i);
+		if (is_in_loop(pred, loop))
+			continue;
+		if (pre != NULL)
+			return false;
+		pre = pred;
+	}
+	if (pre == NULL || get_irn_n_edges_kind(pre, EDGE_KIND_BLOCK) != 1
+	    || !block_dominates(pre, header))
+		return false;
+
+	for (int i = 0, n = get_irn_arity(call); i < n; ++i) {
+		if (i != n_Call_mem && !is_loop_invariant(get_irn_n(call, i), block))
+			return false;
+	}
+	ir_node *mem = skip_invisible_mem(ssa, get_Call_mem(call), NULL, NULL);
+	if (!is_loop_invariant(mem, block))
+		return false;
+	if (!dominates_iterations(block, loop, loop, header))
+		return false;
+
+	DB((dbg, LEVEL_1, "Moving %+F out of the loop of %+F\n", call, header));
+	foreach_out_edge_safe(call, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (is_Proj(proj) && get_Proj_proj(proj) == pn_Call_M)
+			exchange(proj, get_Call_mem(call));
+	}
+	set_Call_mem(call, mem);
+	set_nodes_block(call, pre);
+	move_projs(call, pre);
+	return true;
+}
+
+/**
+ * Removes Calls of pure functions which are equal to a dominating Call with
+ * no visible memory change in between, and moves the remaining ones out of
+ * loops which do not change their arguments or the memory they can read.
+ */
+static bool optimize_pure_calls(ir_graph *irg, ir_node **call_list)
+{
+	bool changed = false;
+
+	assure_irg_properties(irg,
+		IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
+		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		| IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO
+		| IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE);
+	ir_memssa_t *ssa = memssa_new(irg);
+
+	for (size_t i = 0, n = ARR_LEN(call_list); i < n; ++i) {
+		ir_node *call = call_list[i];
+		if (!is_movable_pure_call(call))
+			continue;
+
+		ir_node *equal = NULL;
+		(void)skip_invisible_mem(ssa, get_Call_mem(call), call, &equal);
+		if (equal != NULL) {
+			replace_pure_call(call, equal);
+			changed = true;
+			continue;
+		}
+		while (hoist_pure_call(ssa, call))
+			changed = true;
+	}
+
+	memssa_free(ssa);
+	return changed;
+}
+
 /**
  * Handle calls to const functions.
  *
@@ -509,14 +832,22 @@ static void handle_const_Calls(env_t *ctx)
 		fix_const_call_lists(irg, ctx);
 		ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
 
+		bool changed = ARR_LEN(ctx->float_const_call_list) != 0
+		            || ARR_LEN(ctx->nonfloat_const_call_list) != 0;
+		if (ARR_LEN(ctx->pure_call_list) != 0)
+			changed |= optimize_pure_calls(irg, ctx->pure_call_list);
+
 		DEL_ARR_F(ctx->pure_call_list);
 		DEL_ARR_F(ctx->nonfloat_const_call_list);
 		DEL_ARR_F(ctx->float_const_call_list);
 
-		confirm_irg_properties(irg,
-			IR_GRAPH_PROPERTIES_CONTROL_FLOW
-			| IR_GRAPH_PROPERTY_ONE_RETURN
-			| IR_GRAPH_PROPERTY_MANY_RETURNS);
+		/* an unchanged graph keeps its analyses, including the summary */
+		if (changed) {
+			confirm_irg_properties(irg,
+				IR_GRAPH_PROPERTIES_CONTROL_FLOW
+				| IR_GRAPH_PROPERTY_ONE_RETURN
+				| IR_GRAPH_PROPERTY_MANY_RETURNS);
+		}
 	}
 }
 
@@ -784,7 +1115,8 @@ static mtp_additional_properties check_nothrow_or_malloc(ir_graph *irg, bool top
 }
 
 /**
- * When a function was detected as "const", it might be moved out of loops.
+ * When a function was detected as "const" or "pure", it might be moved out of
+ * loops.
  * This might be dangerous if the graph can contain endless loops.
  */
 static void check_for_possible_endless_loops(ir_graph *irg)
@@ -804,6 +1136,32 @@ static void check_for_possible_endless_loops(ir_graph *irg)
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_ALL);
 }
 
+/**
+ * Marks the graphs whose summary still contains the given part as ready, so
+ * the properties found by an earlier run are reused from their entities.
+ */
+static void mark_summarized_ready(method_summary_t part)
+{
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		assure_irg_entity_summary(irg);
+		if (get_irg_entity(irg)->attr.mtd_attr.summary & part)
+			SET_IRG_READY(irg);
+	}
+}
+
+/**
+ * Records in the summaries of all graphs that the given part is computed.
+ */
+static void set_summarized(method_summary_t part)
+{
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		ir_graph *irg = get_irp_irg(i);
+		if (irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_SUMMARY))
+			get_irg_entity(irg)->attr.mtd_attr.summary |= part;
+	}
+}
+
 void optimize_funccalls(void)
 {
 	/* prepare: mark all graphs as not analyzed */
@@ -813,6 +1171,7 @@ void optimize_funccalls(void)
 
 	/* first step: detect, which functions are nothrow or malloc */
 	DB((dbg, LEVEL_2, "Detecting nothrow and malloc properties ...\n"));
+	mark_summarized_ready(method_summary_nothrow);
 	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
 		ir_graph *irg  = get_irp_irg(i);
 		unsigned  prop = check_nothrow_or_malloc(irg, true);
@@ -824,6 +1183,8 @@ void optimize_funccalls(void)
 		}
 	}
 
+	set_summarized(method_summary_nothrow);
+
 	/* second step: remove exception edges: this must be done before the
 	   detection of const and pure functions take place. */
 	env_t ctx;
@@ -834,6 +1195,7 @@ void optimize_funccalls(void)
 
 	/* third step: detect, which functions are const or pure */
 	DB((dbg, LEVEL_2, "Detecting const and pure properties ...\n"));
+	mark_summarized_ready(method_summary_const);
 	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
 		ir_graph *irg  = get_irp_irg(i);
 		unsigned  prop = check_const_or_pure_function(irg, true);
@@ -843,9 +1205,12 @@ void optimize_funccalls(void)
 			check_for_possible_endless_loops(irg);
 		} else if (prop & mtp_property_pure) {
 			DB((dbg, LEVEL_2, "%+F has the pure property\n", irg));
+			check_for_possible_endless_loops(irg);
 		}
 	}
 
+	set_summarized(method_summary_const);
+
 	handle_const_Calls(&ctx);
 
 	free(busy_set);
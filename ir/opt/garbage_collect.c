@@ -7,6 +7,11 @@
  * @file
  * @brief    Removal of unreachable methods.
  * @author   Matthias Braun
+ *
+ * Entities found alive are put on a worklist which is processed in order, so
+ * every graph is walked exactly once, the recursion depth does not grow with
+ * the length of reference chains and the result does not depend on anything
+ * but the order of the segment members.
  */
 #include "iroptimize.h"
 #include "typerep.h"
@@ -14,11 +19,15 @@
 #include "entity_t.h"
 #include "irprog_t.h"
 #include "irgwalk.h"
+#include "array.h"
 #include "error.h"
 #include "debug.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
+/** Entities found alive whose initializer and graph are not scanned yet. */
+static ir_entity **worklist;
+
 static void visit_entity(ir_entity *entity);
 
 static void visit_node(ir_node *node, void *env)
@@ -57,6 +66,7 @@ static void visit_initializer(ir_initializer_t *initializer)
 		return;
 	case IR_INITIALIZER_TARVAL:
 	case IR_INITIALIZER_NULL:
+	case IR_INITIALIZER_BYTES:
 		return;
 
 	case IR_INITIALIZER_COMPOUND: {
@@ -74,19 +84,29 @@ static void visit_initializer(ir_initializer_t *initializer)
 
 static void visit_entity(ir_entity *entity)
 {
-	ir_graph *irg;
-
 	if (entity_visited(entity))
 		return;
 	mark_entity_visited(entity);
+	ARR_APP1(ir_entity*, worklist, entity);
+}
 
-	if (entity->initializer != NULL) {
-		visit_initializer(entity->initializer);
-	}
+/**
+ * Scans the initializers and graphs of the entities on the worklist until no
+ * new entities are found alive.
+ */
+static void process_worklist(void)
+{
+	for (size_t i = 0; i < ARR_LEN(worklist); ++i) {
+		ir_entity *entity = worklist[i];
 
-	irg = get_entity_irg(entity);
-	if (irg != NULL) {
-		start_visit_node(get_irg_end(irg));
+		if (entity->initializer != NULL) {
+			visit_initializer(entity->initializer);
+		}
+
+		ir_graph *irg = get_entity_irg(entity);
+		if (irg != NULL) {
+			irg_walk_graph(irg, visit_node, NULL, NULL);
+		}
 	}
 }
 
@@ -134,12 +154,17 @@ void garbage_collect_entities(void)
 	inc_master_type_visited();
 	inc_max_irg_visited();
 
+	worklist = NEW_ARR_F(ir_entity*, 0);
 	for (s = IR_SEGMENT_FIRST; s <= IR_SEGMENT_LAST; ++s) {
 		ir_type *type = get_segment_type(s);
 		mark_type_visited(type);
 
 		visit_segment(type);
 	}
+	process_worklist();
+	DB((dbg, LEVEL_1, "  %zu entities alive\n", ARR_LEN(worklist)));
+	DEL_ARR_F(worklist);
+	worklist = NULL;
 
 	/* remove graphs of non-visited functions
 	 * (we have to count backwards, because freeing the graph moves the last
@@ -0,0 +1,179 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Applies a list of graph passes to every graph of the program.
+ *
+ * The passes are run graph by graph: a graph goes through the whole list
+ * before the next graph is processed, so its data stays warm in the caches
+ * and no pass ever sees the intermediate state of another graph. The graphs
+ * are independent units of work, the program-global state (types, entities,
+ * tarvals, idents) is only touched from inside the passes.
+ *
+ * graph_passes_run_bottom_up() orders the graphs by the strongly connected
+ * components of the callgraph, callees first. The graphs still run one after
+ * another: the passes share global state (current_ir_graph, the hooks, the
+ * type and entity lists), so independent components are not run in parallel.
+ */
+#include "iroptimize.h"
+#include "irgraph_t.h"
+#include "irprog_t.h"
+#include "irverify.h"
+#include "timing.h"
+#include "array_t.h"
+#include "error.h"
+#include "xmalloc.h"
+
+typedef struct graph_pass_t {
+	const char *name;
+	opt_ptr     func;
+} graph_pass_t;
+
+struct ir_graph_passes_t {
+	graph_pass_t *passes; /**< flexible array of the passes in order */
+	bool          verify; /**< verify the graph after every pass */
+};
+
+ir_graph_passes_t *new_graph_passes(void)
+{
+	ir_graph_passes_t *res = XMALLOCZ(ir_graph_passes_t);
+	res->passes = NEW_ARR_F(graph_pass_t, 0);
+	return res;
+}
+
+void free_graph_passes(ir_graph_passes_t *passes)
+{
+	DEL_ARR_F(passes->passes);
+	free(passes);
+}
+
+void graph_passes_add(ir_graph_passes_t *passes, const char *name,
+                      opt_ptr func)
+{
+	graph_pass_t const pass = { name, func };
+	ARR_APP1(graph_pass_t, passes->passes, pass);
+}
+
+void graph_passes_set_verify(ir_graph_passes_t *passes, int enable)
+{
+	passes->verify = enable != 0;
+}
+
+void graph_passes_run_irg(const ir_graph_passes_t *passes, ir_graph *irg)
+{
+	for (size_t i = 0, n = ARR_LEN(passes->passes); i < n; ++i) {
+		graph_pass_t const *const pass = &passes->passes[i];
+		ir_pass_stat_begin(irg, pass->name);
+		pass->func(irg);
+		ir_pass_stat_end();
+		if (passes->verify && !irg_verify(irg))
+			panic("verification of %+F failed after %s", irg, pass->name);
+	}
+}
+
+void graph_passes_run(const ir_graph_passes_t *passes)
+{
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i) {
+		graph_passes_run_irg(passes, get_irp_irg(i));
+	}
+}
+
+/** Tarjan state of a graph while computing the bottom-up order. */
+typedef struct scc_info_t {
+	size_t dfn;     /**< depth first number, 0 if not visited yet */
+	size_t low;     /**< smallest dfn reachable from this graph */
+	size_t callee;  /**< next callee to visit */
+	bool   on_stack;
+} scc_info_t;
+
+/**
+ * Appends the graphs of the program to @p order such that every callee comes
+ * before its callers, except for callees in the same recursion. The graphs
+ * of one strongly connected component are adjacent.
+ * This is Tarjan's algorithm with an explicit stack, which emits the
+ * components in reverse topological order of the callgraph.
+ */
+static void compute_bottom_up_order(ir_graph **order)
+{
+	size_t const n_irgs = get_irp_n_irgs();
+	scc_info_t  *info   = XMALLOCNZ(scc_info_t, get_irp_last_idx());
+	ir_graph   **dfs    = NEW_ARR_F(ir_graph*, 0);
+	ir_graph   **stack  = NEW_ARR_F(ir_graph*, 0);
+	size_t       n_dfn  = 0;
+	size_t       n_done = 0;
+
+	for (size_t i = 0; i < n_irgs; ++i) {
+		ir_graph *const root = get_irp_irg(i);
+		if (info[get_irg_idx(root)].dfn != 0)
+			continue;
+		ARR_APP1(ir_graph*, dfs, root);
+
+		while (ARR_LEN(dfs) > 0) {
+			ir_graph   *const irg = dfs[ARR_LEN(dfs) - 1];
+			scc_info_t *const ii  = &info[get_irg_idx(irg)];
+			if (ii->dfn == 0) {
+				ii->dfn      = ii->low = ++n_dfn;
+				ii->on_stack = true;
+				ARR_APP1(ir_graph*, stack, irg);
+			}
+
+			/* descend into the next unvisited callee */
+			size_t const n_callees = get_irg_n_callees(irg);
+			bool         descended = false;
+			while (ii->callee < n_callees) {
+				ir_graph   *const callee = get_irg_callee(irg, ii->callee++);
+				scc_info_t *const ci     = &info[get_irg_idx(callee)];
+				if (ci->dfn == 0) {
+					ARR_APP1(ir_graph*, dfs, callee);
+					descended = true;
+					break;
+				}
+				if (ci->on_stack && ci->dfn < ii->low)
+					ii->low = ci->dfn;
+			}
+			if (descended)
+				continue;
+
+			/* all callees done: emit the component if irg is its root */
+			ARR_SHRINKLEN(dfs, ARR_LEN(dfs) - 1);
+			if (ii->low == ii->dfn) {
+				ir_graph *member;
+				do {
+					member = stack[ARR_LEN(stack) - 1];
+					ARR_SHRINKLEN(stack, ARR_LEN(stack) - 1);
+					info[get_irg_idx(member)].on_stack = false;
+					order[n_done++] = member;
+				} while (member != irg);
+			}
+			if (ARR_LEN(dfs) > 0) {
+				scc_info_t *const pi = &info[get_irg_idx(dfs[ARR_LEN(dfs) - 1])];
+				if (ii->low < pi->low)
+					pi->low = ii->low;
+			}
+		}
+	}
+	assert(n_done == n_irgs);
+
+	DEL_ARR_F(stack);
+	DEL_ARR_F(dfs);
+	free(info);
+}
+
+void graph_passes_run_bottom_up(const ir_graph_passes_t *passes)
+{
+	assert(get_irp_callgraph_state() != irp_callgraph_none);
+
+	/* the order is fixed before the first pass runs, passes changing calls
+	 * (inlining, call optimizations) do not influence it */
+	size_t    const n_irgs = get_irp_n_irgs();
+	ir_graph **const order = XMALLOCN(ir_graph*, n_irgs);
+	compute_bottom_up_order(order);
+
+	for (size_t i = 0; i < n_irgs; ++i) {
+		graph_passes_run_irg(passes, order[i]);
+	}
+	free(order);
+}
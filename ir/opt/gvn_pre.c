@@ -10,6 +10,7 @@
  * @author  Michael Beck
  * @brief
  */
+#include "array.h"
 #include "debug.h"
 #include "ircons.h"
 #include "irdom.h"
@@ -31,6 +32,7 @@
 #include "irnode_t.h"
 #include "iropt_t.h"
 #include "plist.h"
+#include "raw_bitset.h"
 
 /* suggested by GVN-PRE authors */
 #define MAX_ANTIC_ITER 10
@@ -72,6 +74,7 @@ typedef struct block_info {
 	ir_nodehashmap_t  *trans;      /* contains translated nodes translated into block */
 	ir_node           *avail;      /* saves available node for insert node phase */
 	int                found;      /* saves kind of availability for insert_node phase */
+	unsigned           postorder;  /* postorder number of the block */
 	ir_node           *block;      /* block of the block_info */
 	struct block_info *next;       /* links all instances for easy access */
 } block_info;
@@ -96,6 +99,7 @@ typedef struct pre_env {
 	ir_node        *end_block;    /* end block of the current graph */
 	ir_node        *end_node;     /* end node of the current graph */
 	block_info     *list;         /* block_info list head */
+	ir_node       **postorder;    /* the blocks in postorder of the CFG */
 	elim_pair      *pairs;        /* elim_pair list head */
 	ir_nodeset_t   *keeps;        /* a list of to be removed phis to kill their keep alive edges */
 	unsigned        last_idx;     /* last node index of input graph */
@@ -103,8 +107,8 @@ typedef struct pre_env {
 	char            first_iter;   /* non-zero for first fixed point iteration */
 	int             iteration;    /* iteration counter */
 #if OPTIMIZE_NODES
-	pset           *value_table;   /* standard value table*/
-	pset           *gvnpre_values; /* gvnpre value table */
+	cpset_t        *value_table;   /* standard value table*/
+	cpset_t        *gvnpre_values; /* gvnpre value table */
 #endif
 } pre_env;
 
@@ -287,6 +291,11 @@ static int compare_gvn_identities(const void *elt, const void *key)
 	return 0;
 }
 
+static int gvn_identities_equal(const void *elt, const void *key)
+{
+	return compare_gvn_identities(elt, key) == 0;
+}
+
 /**
  * Identify does a lookup in the GVN valuetable.
  * To be used when no new GVN values are to be created.
@@ -420,6 +429,7 @@ static void alloc_block_info(ir_node *block, pre_env *env)
 	info->avail   = NULL;
 	info->block   = block;
 	info->found   = 1;
+	info->postorder = (unsigned)-1;
 
 	info->next = env->list;
 	env->list  = info;
@@ -981,12 +991,6 @@ static void compute_antic(ir_node *block, void *ctx)
 		int pos   = get_Block_cfgpred_pos(succ, block);
 		succ_info = get_block_info(succ);
 
-		/* initialize translated set */
-		if (env->first_iter) {
-			info->trans = XMALLOC(ir_nodehashmap_t);
-			ir_nodehashmap_init(info->trans);
-		}
-
 		foreach_valueset(succ_info->antic_in, value, expr, iter) {
 			ir_node *trans = get_translated(block, expr);
 			ir_node *trans_value;
@@ -1051,6 +1055,68 @@ static void compute_antic(ir_node *block, void *ctx)
 		env->changes |= 1;
 }
 
+/**
+ * Block-walker, numbers the blocks in postorder.
+ */
+static void collect_postorder(ir_node *block, void *ctx)
+{
+	pre_env *env = (pre_env*)ctx;
+
+	get_block_info(block)->postorder = ARR_LEN(env->postorder);
+	ARR_APP1(ir_node*, env->postorder, block);
+}
+
+/**
+ * Computes Antic_in for all blocks.
+ * Every iteration processes the pending blocks in postorder, so the
+ * successors of a block are processed before the block itself except
+ * along backedges. A block is pending again only if the antic_in of one
+ * of its successors changed, the other blocks would not change anyway.
+ *
+ * @param env  the environment
+ *
+ * @return the number of iterations
+ */
+static unsigned compute_antic_sets(pre_env *env)
+{
+	size_t    n_blocks   = ARR_LEN(env->postorder);
+	unsigned *pending    = rbitset_malloc(n_blocks);
+	unsigned  antic_iter = 0;
+
+	rbitset_set_all(pending, n_blocks);
+	env->first_iter = 1;
+	env->iteration  = 1;
+
+	/* antic_in passes */
+	do {
+		++antic_iter;
+		DB((dbg, LEVEL_2, "= Antic_in Iteration %d ========================\n", antic_iter));
+		for (size_t i = rbitset_next_max(pending, 0, n_blocks, true);
+		     i != (size_t)-1; i = rbitset_next_max(pending, i + 1, n_blocks, true)) {
+			ir_node *block = env->postorder[i];
+
+			rbitset_clear(pending, i);
+			env->changes = 0;
+			compute_antic(block, env);
+			if (env->changes == 0)
+				continue;
+
+			for (int p = get_Block_n_cfgpreds(block); p-- > 0;) {
+				ir_node  *pred  = get_Block_cfgpred_block(block, p);
+				unsigned  order = get_block_info(pred)->postorder;
+				if (order != (unsigned)-1)
+					rbitset_set(pending, order);
+			}
+		}
+		env->first_iter = 0;
+		DB((dbg, LEVEL_2, "----------------------------------------------\n"));
+		env->iteration ++;
+	} while (!rbitset_is_empty(pending, n_blocks) && antic_iter < MAX_ANTIC_ITER);
+
+	free(pending);
+	return antic_iter;
+}
+
 /* --------------------------------------------------------
  * Main algorithm Avail_out
  * --------------------------------------------------------
@@ -1872,25 +1938,24 @@ static void gvn_pre(ir_graph *irg, pre_env *env)
 	/* compute the avail_out sets for all blocks */
 	dom_tree_walk_irg(irg, compute_avail_top_down, NULL, env);
 
-	/* compute the anticipated value sets for all blocks */
-	antic_iter      = 0;
-	env->first_iter = 1;
+	ir_nodeset_init(env->keeps);
 
-	env->iteration = 1;
-	/* antic_in passes */
-	do {
-		++antic_iter;
-		DB((dbg, LEVEL_2, "= Antic_in Iteration %d ========================\n", antic_iter));
-		env->changes = 0;
-		irg_walk_blkwise_graph(irg, compute_antic, NULL, env);
-		env->first_iter = 0;
-		DB((dbg, LEVEL_2, "----------------------------------------------\n"));
-		env->iteration ++;
-	} while (env->changes != 0 && antic_iter < MAX_ANTIC_ITER);
+	/* The anticipated sets are the expensive part. Graphs beyond the memory
+	   budget only get the fully redundant values eliminated. */
+	if (irg_memory_budget_exceeded(irg)) {
+		DB((dbg, LEVEL_1, "Memory budget exceeded, skipping insertion\n"));
+		goto elimination;
+	}
+
+	/* compute the anticipated value sets for all blocks */
+	env->postorder = NEW_ARR_F(ir_node*, 0);
+	irg_out_block_walk(get_irg_start_block(irg), NULL, collect_postorder, env);
+	antic_iter = compute_antic_sets(env);
+	DEL_ARR_F(env->postorder);
 
 	DEBUG_ONLY(set_stats(gvnpre_stats->antic_iterations, antic_iter);)
+	(void)antic_iter;
 
-	ir_nodeset_init(env->keeps);
 	insert_iter       = 0;
 	env->first_iter   = 1;
 	/* compute redundant expressions */
@@ -1913,6 +1978,7 @@ static void gvn_pre(ir_graph *irg, pre_env *env)
 	dom_tree_walk_irg(irg, update_new_set_walker, NULL, env);
 #endif
 
+elimination:
 	/* Deactivate edges to prevent intelligent removal of nodes,
 	   or else we will get deleted nodes which we try to exchange. */
 	edges_deactivate(environ->graph);
@@ -1983,11 +2049,7 @@ void do_gvn_pre(ir_graph *irg)
 	   the value of a node, which is independent from
 	   its block. */
 	set_opt_global_cse(1);
-	/* new_identities() */
-	if (irg->value_table != NULL)
-		del_pset(irg->value_table);
-	/* initially assumed nodes in pset are 512 */
-	irg->value_table = new_pset(compare_gvn_identities, 512);
+	new_identities_custom(irg, gvn_identities_equal);
 #if OPTIMIZE_NODES
 	env.gvnpre_values = irg->value_table;
 #endif
@@ -2013,9 +2075,7 @@ void do_gvn_pre(ir_graph *irg)
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_NONE);
 
 #if OPTIMIZE_NODES
-	irg->value_table = env.value_table;
-	del_pset(irg->value_table);
-	irg->value_table = env.gvnpre_values;
+	free_value_table(env.value_table);
 #endif
 
 	/* TODO There seem to be optimizations that try to use the existing
@@ -21,6 +21,9 @@
 #include "irgwalk.h"
 #include "irtools.h"
 #include "array_t.h"
+#include "execfreq.h"
+#include "xmalloc.h"
+#include "util.h"
 #include "be.h"
 
 #include "irdump.h"
@@ -32,6 +35,15 @@
 typedef struct walker_env {
 	arch_allow_ifconv_func allow_ifconv;
 	bool                   changed; /**< Set if the graph was changed. */
+	unsigned               penalty; /**< branch mispredict penalty, 0 if
+	                                     every Mux is created */
+	unsigned               width;   /**< issue width of the target */
+	bool                   use_freq; /**< execution frequencies are known */
+	size_t                 n_idx;   /**< size of the arrays below */
+	unsigned              *n_nodes; /**< number of nodes per block */
+	unsigned              *depth;   /**< memoized dependency depths */
+	unsigned              *stamp;   /**< depth is valid if stamp matches */
+	unsigned               cur_stamp;
 } walker_env;
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
@@ -94,6 +106,131 @@ static ir_node* walk_to_projx(ir_node* start, const ir_node* dependency)
 }
 
 
+/**
+ * Returns the number of nodes on the path from block up to the
+ * dependency, following the same way as walk_to_projx().
+ */
+static unsigned get_path_cost(const walker_env *env, ir_node *block,
+                              const ir_node *dependency)
+{
+	unsigned idx  = get_irn_idx(block);
+	unsigned cost = idx < env->n_idx ? env->n_nodes[idx] : 0;
+
+	for (int i = 0, arity = get_irn_arity(block); i < arity; ++i) {
+		ir_node *pred       = get_irn_n(block, i);
+		ir_node *pred_block = get_nodes_block(skip_Proj(pred));
+
+		if (pred_block == dependency || is_Proj(pred))
+			break;
+		if (is_cdep_on(pred_block, dependency))
+			return cost + get_path_cost(env, pred_block, dependency);
+	}
+	return cost;
+}
+
+/**
+ * Returns the length of the longest chain of operations ending in node
+ * within the dependency block if in_dependency is set or else within the
+ * blocks controlled by it.
+ */
+static unsigned get_depth(walker_env *env, ir_node *node,
+                          const ir_node *dependency, bool in_dependency)
+{
+	ir_node *block = get_nodes_block(node);
+	if (in_dependency ? block != dependency
+	                  : block == dependency || !is_cdep_on(block, dependency))
+		return 0;
+	if (is_Phi(node))
+		return 1;
+
+	unsigned idx = get_irn_idx(node);
+	if (idx < env->n_idx && env->stamp[idx] == env->cur_stamp)
+		return env->depth[idx];
+
+	unsigned depth = 0;
+	if (is_Proj(node)) {
+		depth = get_depth(env, get_Proj_pred(node), dependency, in_dependency);
+	} else {
+		for (int i = 0, arity = get_irn_arity(node); i < arity; ++i) {
+			ir_node *pred = get_irn_n(node, i);
+			depth = MAX(depth, get_depth(env, pred, dependency, in_dependency));
+		}
+		++depth;
+	}
+
+	if (idx < env->n_idx) {
+		env->depth[idx] = depth;
+		env->stamp[idx] = env->cur_stamp;
+	}
+	return depth;
+}
+
+/**
+ * Returns the probability that the path ending in block is taken when the
+ * dependency is executed, 0.5 without execution frequencies.
+ */
+static double get_path_probability(const walker_env *env,
+                                   const ir_node *block,
+                                   const ir_node *dependency)
+{
+	double dep_freq = get_block_execfreq(dependency);
+	if (!env->use_freq || dep_freq <= 0.0)
+		return 0.5;
+	return MIN(get_block_execfreq(block) / dep_freq, 1.0);
+}
+
+/**
+ * Decides whether replacing the Phis of block for the predecessors i and j by
+ * Muxes is cheaper than the branch. The branch costs the expected arm and the
+ * misprediction penalty weighted by the probability of the less likely path,
+ * the Muxes cost both arms and extend the critical path, as the result
+ * waits for the selector and the longer arm.
+ *
+ * @param n_moved  set to the number of nodes ending up in the dependency
+ */
+static bool is_profitable(walker_env *env, ir_node *block, int i, int j,
+                          const ir_node *dependency, ir_node *sel,
+                          unsigned *n_moved)
+{
+	ir_node  *block_i = get_Block_cfgpred_block(block, i);
+	ir_node  *block_j = get_Block_cfgpred_block(block, j);
+	unsigned  n_i     = get_path_cost(env, block_i, dependency);
+	unsigned  n_j     = get_path_cost(env, block_j, dependency);
+	unsigned  n_mux   = 0;
+	unsigned  d_i     = 0;
+	unsigned  d_j     = 0;
+
+	++env->cur_stamp;
+	for (ir_node *phi = get_Block_phis(block); phi != NULL;
+	     phi = get_Phi_next(phi)) {
+		ir_node *val_i = get_Phi_pred(phi, i);
+		ir_node *val_j = get_Phi_pred(phi, j);
+		if (val_i == val_j)
+			continue;
+		++n_mux;
+		d_i = MAX(d_i, get_depth(env, val_i, dependency, false));
+		d_j = MAX(d_j, get_depth(env, val_j, dependency, false));
+	}
+	*n_moved = n_i + n_j + n_mux;
+	if (env->penalty == 0)
+		return true;
+
+	unsigned d_sel = get_depth(env, sel, dependency, true);
+	double   p_i   = get_path_probability(env, block_i, dependency);
+	double   p_j   = get_path_probability(env, block_j, dependency);
+	double   width = env->width;
+
+	double branch_cost = MIN(p_i, p_j) * env->penalty
+	                   + (p_i * n_i + p_j * n_j) / width;
+	double mux_path    = MAX(MAX(d_i, d_j), d_sel) + 1;
+	double mux_cost    = (n_i + n_j + n_mux) / width
+	                   + mux_path - (p_i * d_i + p_j * d_j);
+
+	DB((dbg, LEVEL_2, "%+F: branch cost %f (p %f/%f), mux cost %f\n",
+	    block, branch_cost, p_i, p_j, mux_cost));
+	return mux_cost <= branch_cost;
+}
+
 /**
  * Recursively copies the DAG starting at node to the i-th predecessor
  * block of src_block
@@ -288,6 +425,7 @@ restart:
 				ir_node* pred1;
 				bool     supported;
 				bool     negated;
+				unsigned n_moved;
 				dbg_info* cond_dbg;
 
 				pred1 = get_Block_cfgpred_block(block, j);
@@ -322,7 +460,9 @@ restart:
 						break;
 					}
 				}
-				if (!supported)
+				if (!supported
+				    || !is_profitable(env, block, i, j, dependency, sel,
+				                      &n_moved))
 					continue;
 
 				DB((dbg, LEVEL_1, "Found Cond %+F with proj %+F and %+F\n",
@@ -337,6 +477,8 @@ restart:
 
 				mux_block = get_nodes_block(cond);
 				cond_dbg = get_irn_dbg_info(cond);
+				if (get_irn_idx(mux_block) < env->n_idx)
+					env->n_nodes[get_irn_idx(mux_block)] += n_moved;
 				do { /* generate Mux nodes in mux_block for Phis in block */
 					ir_node* val_i = get_irn_n(phi, i);
 					ir_node* val_j = get_irn_n(phi, j);
@@ -411,9 +553,12 @@ static void init_block_link(ir_node *block, void *env)
  * Daisy-chain all Phis in a block.
  * If a non-movable node is encountered set the has_pinned flag in its block.
  */
-static void collect_phis(ir_node *node, void *env)
+static void collect_phis(ir_node *node, void *ctx)
 {
-	(void) env;
+	walker_env *env = (walker_env*)ctx;
+
+	if (!is_Block(node) && !is_Phi(node) && !is_Proj(node) && !is_cfop(node))
+		++env->n_nodes[get_irn_idx(get_nodes_block(node))];
 
 	if (is_Phi(node)) {
 		ir_node *block = get_nodes_block(node);
@@ -448,6 +593,14 @@ void opt_if_conv(ir_graph *irg)
 	/* get the parameters */
 	env.allow_ifconv = be_params->allow_ifconv;
 	env.changed      = false;
+	env.penalty      = be_params->branch_mispredict_penalty;
+	env.width        = MAX(be_params->issue_width, 1u);
+	env.use_freq     = get_block_execfreq(get_irg_start_block(irg)) > 0.0;
+	env.n_idx        = get_irg_last_idx(irg);
+	env.n_nodes      = XMALLOCNZ(unsigned, env.n_idx);
+	env.depth        = XMALLOCN(unsigned, env.n_idx);
+	env.stamp        = XMALLOCNZ(unsigned, env.n_idx);
+	env.cur_stamp    = 0;
 
 	FIRM_DBG_REGISTER(dbg, "firm.opt.ifconv");
 
@@ -458,10 +611,13 @@ void opt_if_conv(ir_graph *irg)
 	ir_reserve_resources(irg, IR_RESOURCE_BLOCK_MARK | IR_RESOURCE_PHI_LIST);
 
 	irg_block_walk_graph(irg, init_block_link, NULL, NULL);
-	irg_walk_graph(irg, collect_phis, NULL, NULL);
+	irg_walk_graph(irg, collect_phis, NULL, &env);
 	irg_block_walk_graph(irg, NULL, if_conv_walker, &env);
 
 	ir_free_resources(irg, IR_RESOURCE_BLOCK_MARK | IR_RESOURCE_PHI_LIST);
+	free(env.n_nodes);
+	free(env.depth);
+	free(env.stamp);
 
 	if (env.changed) {
 		local_optimize_graph(irg);
@@ -26,27 +26,38 @@
 #include "ircons.h"
 #include "cgana.h"
 #include "irtools.h"
+#include "irprog_t.h"
+#include "typerep.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
 /**
- * Walker: adds Call operations to a head's link list.
+ * Walker: appends the not yet marked callees of Call operations to the
+ * worklist.
  */
-static void collect_call(ir_node *node, void *env)
+static void mark_callees(ir_node *node, void *env)
 {
-	ir_node *head = (ir_node*)env;
+	ir_entity ***marked = (ir_entity***)env;
 
-	if (is_Call(node)) {
-		set_irn_link(node, get_irn_link(head));
-		set_irn_link(head, node);
+	if (!is_Call(node))
+		return;
+
+	for (size_t i = get_Call_n_callees(node); i > 0;) {
+		ir_entity *ent = get_Call_callee(node, --i);
+
+		if (get_entity_irg(ent) && !entity_visited(ent)) {
+			mark_entity_visited(ent);
+			ARR_APP1(ir_entity *, *marked, ent);
+
+			DB((dbg, LEVEL_1, "  method %+F can be called from Call %+F: kept alive.\n",
+				ent, node));
+		}
 	}
 }
 
 /* garbage collect methods: mark and remove */
 void gc_irgs(size_t n_keep, ir_entity ** keep_arr)
 {
-	void * MARK = &MARK; /* @@@ gefaehrlich!!! Aber wir markieren hoechstens zu viele ... */
-
 	FIRM_DBG_REGISTER(dbg, "firm.opt.cgopt");
 
 	if (n_keep >= get_irp_n_irgs()) {
@@ -56,59 +67,40 @@ void gc_irgs(size_t n_keep, ir_entity ** keep_arr)
 
 	DB((dbg, LEVEL_1, "dead method elimination\n"));
 
-	/* Mark entities that are alive.  */
-	if (n_keep > 0) {
-		ir_entity **marked = NEW_ARR_F(ir_entity *, n_keep);
-		size_t    idx;
-
-		for (idx = 0; idx < n_keep; ++idx) {
-			marked[idx] = keep_arr[idx];
-			set_entity_link(marked[idx], MARK);
-			DB((dbg, LEVEL_1, "  method %+F kept alive.\n", marked[idx]));
-		}
-
-		for (idx = 0; idx < ARR_LEN(marked); ++idx) {
-			ir_graph *irg = get_entity_irg(marked[idx]);
-			ir_node *node;
-
-			if (irg == NULL)
-				continue;
-
-			node = get_irg_end(irg);
-
-			/* collect calls */
-			ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
-			irg_walk_graph(irg, firm_clear_link, collect_call, node);
+	/* Mark entities that are alive. The worklist is processed in order, so
+	 * every graph is walked once. */
+	irp_reserve_resources(irp, IRP_RESOURCE_TYPE_VISITED);
+	inc_master_type_visited();
 
-			/* iterate calls */
-			for (node = (ir_node*)get_irn_link(node); node != NULL;
-			     node = (ir_node*)get_irn_link(node)) {
-				for (size_t i = get_Call_n_callees(node); i > 0;) {
-					ir_entity *ent = get_Call_callee(node, --i);
+	ir_entity **marked = NEW_ARR_F(ir_entity *, 0);
+	for (size_t idx = 0; idx < n_keep; ++idx) {
+		ir_entity *ent = keep_arr[idx];
+		if (entity_visited(ent))
+			continue;
+		mark_entity_visited(ent);
+		ARR_APP1(ir_entity *, marked, ent);
+		DB((dbg, LEVEL_1, "  method %+F kept alive.\n", ent));
+	}
 
-					if (get_entity_irg(ent) && get_entity_link(ent) != MARK) {
-						set_entity_link(ent, MARK);
-						ARR_APP1(ir_entity *, marked, ent);
+	for (size_t idx = 0; idx < ARR_LEN(marked); ++idx) {
+		ir_graph *irg = get_entity_irg(marked[idx]);
+		if (irg == NULL)
+			continue;
 
-						DB((dbg, LEVEL_1, "  method %+F can be called from Call %+F: kept alive.\n",
-							ent, node));
-					}
-				}
-			}
-			ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
-		}
-		DEL_ARR_F(marked);
+		irg_walk_graph(irg, NULL, mark_callees, &marked);
 	}
+	DEL_ARR_F(marked);
 
 	/* clean */
 	for (size_t i = get_irp_n_irgs(); i-- != 0;) {
 		ir_graph  *irg = get_irp_irg(i);
 		ir_entity *ent = get_irg_entity(irg);
 
-		if (get_entity_link(ent) == MARK)
+		if (entity_visited(ent))
 			continue;
 
 		DB((dbg, LEVEL_1, "  freeing method %+F\n", ent));
 		free_ir_graph(irg);
 	}
+	irp_free_resources(irp, IRP_RESOURCE_TYPE_VISITED);
 }
@@ -13,6 +13,8 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "array_t.h"
 #include "debug.h"
 #include "ircons.h"
@@ -29,9 +31,24 @@
 #include "iropt_dbg.h"
 #include "vrp.h"
 #include "firmstat_t.h"
+#include "execfreq.h"
+#include "statev_t.h"
+#include "util.h"
 
 #undef AVOID_PHIB
 
+/** Maximal number of Phis followed when searching a path to a constant. */
+#define MAX_PATH_LENGTH  8
+/** Maximal number of nodes duplicated for a single thread. */
+#define MAX_THREAD_COST  64
+/** Every graph may duplicate this many nodes ... */
+#define MIN_BUDGET       256
+/** ... or this percentage of its size, whatever is bigger. */
+#define BUDGET_PERCENT   25
+/** Threads starting in blocks executed less often than this (relative to the
+ * start block) are not worth duplicating code for. */
+#define MIN_THREAD_FREQ  0.01
+
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
 /**
@@ -194,7 +211,30 @@ static void split_critical_edge(ir_node *block, int pos)
 	set_Block_cfgpred(block, pos, new_jmp);
 }
 
+/** An entry of the explicit stack used to search the Phi web. */
+typedef struct path_entry_t {
+	ir_node *phi;   /**< the Phi whose predecessors are searched */
+	int      pos;   /**< the predecessor searched currently */
+	ir_node *jump;  /**< the control flow predecessor belonging to pos */
+} path_entry_t;
+
+/** Graph-wide state of the jump threading. */
+typedef struct threading_t {
+	path_entry_t *path;         /**< the search stack, shared by all searches */
+	ir_node     **searched;     /**< values visited by the current search */
+	unsigned     *no_const;     /**< generation in which no Const or Confirm
+	                                 was reachable from a value, by index */
+	unsigned      generation;   /**< incremented on every change of the graph */
+	long          budget;       /**< number of nodes we may still duplicate */
+	bool          use_freq;     /**< execution frequencies are available */
+	bool          changed;      /**< the graph was changed in this round */
+	unsigned      n_threads;    /**< number of threaded jumps */
+	unsigned      n_duplicated; /**< number of duplicated nodes */
+	unsigned      n_rejected;   /**< number of threads rejected as too costly */
+} threading_t;
+
 typedef struct jumpthreading_env_t {
+	threading_t   *thr;
 	ir_node       *true_block;
 	ir_node       *cmp;        /**< The Compare node that might be partial evaluated */
 	ir_relation    relation;   /**< The Compare mode of the Compare node. */
@@ -408,128 +448,142 @@ static ir_tarval *get_Const_or_Confirm_tarval(const ir_node *node)
 	return get_Const_tarval(node);
 }
 
-static ir_node *find_const_or_confirm(jumpthreading_env_t *env, ir_node *jump,
-                                      ir_node *value)
+/**
+ * Returns whether an earlier search found no Const or Confirm above @p value
+ * and the graph has not been changed since.
+ */
+static bool is_known_without_const(const threading_t *thr, const ir_node *value)
 {
-	ir_node *block = get_nodes_block(jump);
-
-	if (irn_visited_else_mark(value))
-		return NULL;
-
-	if (is_Const_or_Confirm(value)) {
-		if (eval_cmp(env, value) <= 0)
-			return NULL;
-
-		DB((
-			dbg, LEVEL_1,
-			"> Found jump threading candidate %+F->%+F\n",
-			block, env->true_block
-		));
-
-		/* adjust true_block to point directly towards our jump */
-		add_pred(env->true_block, jump);
-
-		split_critical_edge(env->true_block, 0);
-
-		/* we need a bigger visited nr when going back */
-		env->visited_nr++;
+	unsigned idx = get_irn_idx(value);
+	return idx < ARR_LEN(thr->no_const) && thr->no_const[idx] == thr->generation;
+}
 
-		return block;
+static void remember_without_const(threading_t *thr, const ir_node *value)
+{
+	unsigned idx = get_irn_idx(value);
+	size_t   len = ARR_LEN(thr->no_const);
+	if (idx >= len) {
+		ARR_RESIZE(unsigned, thr->no_const, idx + 1);
+		memset(thr->no_const + len, 0, (idx + 1 - len) * sizeof(*thr->no_const));
 	}
+	thr->no_const[idx] = thr->generation;
+}
 
-	if (is_Phi(value)) {
-		int i, arity;
-
-		/* the Phi has to be in the same Block as the Jmp */
-		if (get_nodes_block(value) != block)
-			return NULL;
-
-		arity = get_irn_arity(value);
-		for (i = 0; i < arity; ++i) {
-			ir_node *copy_block;
-			ir_node *phi_pred = get_Phi_pred(value, i);
-			ir_node *cfgpred  = get_Block_cfgpred(block, i);
-
-			copy_block = find_const_or_confirm(env, cfgpred, phi_pred);
-			if (copy_block == NULL)
-				continue;
-
-			/* copy duplicated nodes in copy_block and fix SSA */
-			copy_and_fix(env, block, copy_block, i);
+/**
+ * Checks whether the Const or Confirm @p value lets the condition take the
+ * edge towards env->true_block.
+ */
+static bool is_wanted_value(jumpthreading_env_t *env, ir_node *value)
+{
+	if (env->cmp != NULL)
+		return eval_cmp(env, value) > 0;
+	return get_Const_or_Confirm_tarval(value) == env->tv;
+}
 
-			if (copy_block == get_nodes_block(cfgpred)) {
-				env->cnst_pred = block;
-				env->cnst_pos  = i;
+/**
+ * Searches the Phi web above @p value for a Const or Confirm which lets the
+ * condition take the edge towards env->true_block. The web is walked with an
+ * explicit stack and at most MAX_PATH_LENGTH Phis are followed.
+ *
+ * @returns the jump behind which the value was found or NULL. On success
+ *          env->thr->path holds the Phis and predecessors leading there.
+ */
+static ir_node *search_path(jumpthreading_env_t *env, ir_node *jump,
+                            ir_node *value)
+{
+	threading_t *thr       = env->thr;
+	bool         found_any = false;
+	bool         truncated = false;
+
+	ARR_SHRINKLEN(thr->path, 0);
+	ARR_SHRINKLEN(thr->searched, 0);
+	for (;;) {
+		if (is_known_without_const(thr, value)) {
+			/* nothing to find here */
+		} else if (is_Const_or_Confirm(value)) {
+			found_any = true;
+			if (ARR_LEN(thr->path) > 0 && is_wanted_value(env, value))
+				return jump;
+		} else if (is_Phi(value)
+		           && get_nodes_block(value) == get_nodes_block(jump)
+		           && !irn_visited_else_mark(value)) {
+			/* the Phi has to be in the same Block as the Jmp */
+			if (ARR_LEN(thr->path) < MAX_PATH_LENGTH) {
+				path_entry_t entry = { value, -1, NULL };
+				ARR_APP1(path_entry_t, thr->path, entry);
+				ARR_APP1(ir_node*, thr->searched, value);
+			} else {
+				truncated = true;
 			}
+		}
 
-			/* return now as we can't process more possibilities in 1 run */
-			return copy_block;
+		/* continue with the next predecessor of the innermost Phi */
+		for (;;) {
+			size_t len = ARR_LEN(thr->path);
+			if (len == 0)
+				goto not_found;
+
+			path_entry_t *top = &thr->path[len - 1];
+			if (++top->pos < get_Phi_n_preds(top->phi)) {
+				top->jump = get_Block_cfgpred(get_nodes_block(top->phi), top->pos);
+				jump      = top->jump;
+				value     = get_Phi_pred(top->phi, top->pos);
+				break;
+			}
+			ARR_SHRINKLEN(thr->path, len - 1);
 		}
 	}
 
+not_found:
+	/* the complete web has been searched: no later query can succeed there */
+	if (!found_any && !truncated) {
+		for (size_t i = 0, n = ARR_LEN(thr->searched); i < n; ++i)
+			remember_without_const(thr, thr->searched[i]);
+	}
 	return NULL;
 }
 
-static ir_node *find_candidate(jumpthreading_env_t *env, ir_node *jump,
-                               ir_node *value)
+/**
+ * Returns the number of nodes copy_and_fix() duplicates for @p block.
+ */
+static long get_copy_cost(const ir_node *block)
 {
-	ir_node *block = get_nodes_block(jump);
-
-	if (irn_visited_else_mark(value)) {
-		return NULL;
+	long cost = 0;
+	foreach_out_edge(block, edge) {
+		ir_node *node = get_edge_src_irn(edge);
+		if (is_Phi(node) || is_End(node) || is_Cond(node) || is_Switch(node)
+		    || get_irn_mode(node) == mode_X)
+			continue;
+		++cost;
 	}
+	return cost;
+}
 
-	if (is_Const_or_Confirm(value)) {
-		ir_tarval *tv = get_Const_or_Confirm_tarval(value);
-
-		if (tv != env->tv)
-			return NULL;
-
-		DB((
-			dbg, LEVEL_1,
-			"> Found jump threading candidate %+F->%+F\n",
-			block, env->true_block
-		));
-
-		/* adjust true_block to point directly towards our jump */
-		add_pred(env->true_block, jump);
-
-		split_critical_edge(env->true_block, 0);
-
-		/* we need a bigger visited nr when going back */
-		env->visited_nr++;
-
-		return block;
+/**
+ * Decides whether the thread found by search_path() is worth its code growth.
+ */
+static bool is_thread_profitable(const jumpthreading_env_t *env,
+                                 ir_node *jump, long cost)
+{
+	const threading_t *thr = env->thr;
+
+	if (cost > MAX_THREAD_COST || cost > thr->budget)
+		return false;
+	if (cost > 0 && thr->use_freq) {
+		/* blocks created by us have no frequency yet */
+		double freq = get_block_execfreq(get_nodes_block(jump));
+		if (freq > 0.0 && freq < MIN_THREAD_FREQ)
+			return false;
 	}
-	if (is_Phi(value)) {
-		int i, arity;
-
-		/* the Phi has to be in the same Block as the Jmp */
-		if (get_nodes_block(value) != block)
-			return NULL;
-
-		arity = get_irn_arity(value);
-		for (i = 0; i < arity; ++i) {
-			ir_node *copy_block;
-			ir_node *phi_pred = get_Phi_pred(value, i);
-			ir_node *cfgpred  = get_Block_cfgpred(block, i);
-
-			copy_block = find_candidate(env, cfgpred, phi_pred);
-			if (copy_block == NULL)
-				continue;
-
-			/* copy duplicated nodes in copy_block and fix SSA */
-			copy_and_fix(env, block, copy_block, i);
+	return true;
+}
 
-			if (copy_block == get_nodes_block(cfgpred)) {
-				env->cnst_pred = block;
-				env->cnst_pos  = i;
-			}
+static ir_node *find_candidate(jumpthreading_env_t *env, ir_node *jump,
+                               ir_node *value)
+{
+	threading_t *thr = env->thr;
 
-			/* return now as we can't process more possibilities in 1 run */
-			return copy_block;
-		}
-	}
+	env->cmp = NULL;
 	if (is_Cmp(value)) {
 		ir_node    *cmp      = value;
 		ir_node    *left     = get_Cmp_left(cmp);
@@ -549,7 +603,7 @@ static ir_node *find_candidate(jumpthreading_env_t *env, ir_node *jump,
 		if (!is_Const(right))
 			return NULL;
 
-		if (get_nodes_block(left) != block)
+		if (get_nodes_block(left) != get_nodes_block(jump))
 			return NULL;
 
 		/* negate condition when we're looking for the false block */
@@ -557,19 +611,67 @@ static ir_node *find_candidate(jumpthreading_env_t *env, ir_node *jump,
 			relation = get_negated_relation(relation);
 		}
 
-		/* (recursively) look if a pred of a Phi is a constant or a Confirm */
+		/* look if a pred of a Phi is a constant or a Confirm */
 		env->cmp      = cmp;
 		env->relation = relation;
 		env->cnst     = right;
+		value         = left;
+	}
 
-		return find_const_or_confirm(env, jump, left);
+	ir_node *found = search_path(env, jump, value);
+	if (found == NULL)
+		return NULL;
+
+	long cost = 0;
+	for (size_t i = 0, n = ARR_LEN(thr->path); i < n; ++i)
+		cost += get_copy_cost(get_nodes_block(thr->path[i].phi));
+	if (!is_thread_profitable(env, found, cost)) {
+		DB((dbg, LEVEL_1, "> Rejected thread %+F->%+F (cost %ld)\n",
+		    get_nodes_block(found), env->true_block, cost));
+		++thr->n_rejected;
+		return NULL;
 	}
 
-	return NULL;
+	ir_node *copy_block = get_nodes_block(found);
+	DB((dbg, LEVEL_1, "> Found jump threading candidate %+F->%+F\n",
+	    copy_block, env->true_block));
+
+	/* adjust true_block to point directly towards our jump */
+	add_pred(env->true_block, found);
+
+	split_critical_edge(env->true_block, 0);
+
+	/* we need a bigger visited nr when going back */
+	env->visited_nr++;
+
+	/* copy duplicated nodes in copy_block and fix SSA, innermost Phi first */
+	for (size_t i = ARR_LEN(thr->path); i-- > 0;) {
+		const path_entry_t *entry = &thr->path[i];
+		ir_node            *block = get_nodes_block(entry->phi);
+
+		copy_and_fix(env, block, copy_block, entry->pos);
+
+		if (copy_block == get_nodes_block(entry->jump)) {
+			env->cnst_pred = block;
+			env->cnst_pos  = entry->pos;
+		}
+	}
+
+	thr->budget       -= cost;
+	thr->n_duplicated += cost;
+	++thr->n_threads;
+	return copy_block;
+}
+
+static void graph_changed(threading_t *thr)
+{
+	thr->changed = true;
+	/* results of earlier searches may be outdated */
+	++thr->generation;
 }
 
 /**
- * Block-walker: searches for the following construct
+ * Searches for the following construct
  *
  *  Const or Phi with constants
  *           |
@@ -580,11 +682,13 @@ static ir_node *find_candidate(jumpthreading_env_t *env, ir_node *jump,
  *       ProjX
  *        /
  *     Block
+ *
+ * @returns the new successor block of the Cond after a jump has been threaded
+ *          into @p block, NULL otherwise
  */
-static void thread_jumps(ir_node* block, void* data)
+static ir_node *thread_jumps(threading_t *thr, ir_node *block)
 {
 	jumpthreading_env_t env;
-	bool *changed = (bool*)data;
 	ir_node *selector;
 	ir_node *projx;
 	ir_node *cond;
@@ -596,17 +700,17 @@ static void thread_jumps(ir_node* block, void* data)
 
 	/* we do not deal with Phis, so restrict this to exactly one cfgpred */
 	if (get_Block_n_cfgpreds(block) != 1)
-		return;
+		return NULL;
 
 	projx = get_Block_cfgpred(block, 0);
 	if (!is_Proj(projx))
-		return;
+		return NULL;
 	assert(get_irn_mode(projx) == mode_X);
 
 	cond = get_Proj_pred(projx);
 	/* TODO handle switch Conds */
 	if (!is_Cond(cond))
-		return;
+		return NULL;
 
 	/* handle cases that can be immediately evaluated */
 	selector = get_Cond_selector(cond);
@@ -644,18 +748,19 @@ static void thread_jumps(ir_node* block, void* data)
 		ir_graph *irg = get_irn_irg(block);
 		ir_node  *bad = new_r_Bad(irg, mode_X);
 		exchange(projx, bad);
-		*changed = true;
-		return;
+		graph_changed(thr);
+		return NULL;
 	} else if (selector_evaluated == 1) {
 		dbg_info *dbgi = get_irn_dbg_info(selector);
 		ir_node  *jmp  = new_rd_Jmp(dbgi, get_nodes_block(projx));
 		DBG_OPT_JUMPTHREADING(projx, jmp);
 		exchange(projx, jmp);
-		*changed = true;
-		return;
+		graph_changed(thr);
+		return NULL;
 	}
 
-	/* (recursively) look if a pred of a Phi is a constant or a Confirm */
+	/* look if a pred of a Phi is a constant or a Confirm */
+	env.thr        = thr;
 	env.true_block = block;
 	irg = get_irn_irg(block);
 	inc_irg_visited(irg);
@@ -663,7 +768,7 @@ static void thread_jumps(ir_node* block, void* data)
 
 	copy_block = find_candidate(&env, projx, selector);
 	if (copy_block == NULL)
-		return;
+		return NULL;
 
 	/* We might thread the condition block of an infinite loop,
 	 * such that there is no path to End anymore. */
@@ -688,14 +793,39 @@ static void thread_jumps(ir_node* block, void* data)
 	set_Block_cfgpred(env.cnst_pred, cnst_pos, badX);
 
 	/* the graph is changed now */
-	*changed = true;
+	graph_changed(thr);
+
+	/* the edge from the Cond has been split off into a new block */
+	ir_node *succ = get_Block_cfgpred_block(block, 0);
+	return is_Bad(succ) ? NULL : succ;
 }
 
-void opt_jumpthreading(ir_graph* irg)
+static void collect_cond_succs(ir_node *block, void *data)
 {
-	bool changed;
-	bool rerun;
+	ir_node ***blocks = (ir_node***)data;
+
+	if (get_Block_n_cfgpreds(block) != 1)
+		return;
+	ir_node *projx = get_Block_cfgpred(block, 0);
+	if (is_Proj(projx) && is_Cond(get_Proj_pred(projx)))
+		ARR_APP1(ir_node*, *blocks, block);
+}
 
+/** Sorts blocks by decreasing execution frequency, hot threads go first. */
+static int cmp_block_freq(const void *a, const void *b)
+{
+	const ir_node *block_a = *(const ir_node**)a;
+	const ir_node *block_b = *(const ir_node**)b;
+	double         freq_a  = get_block_execfreq(block_a);
+	double         freq_b  = get_block_execfreq(block_b);
+
+	if (freq_a != freq_b)
+		return freq_a < freq_b ? 1 : -1;
+	return (int)get_irn_idx(block_a) - (int)get_irn_idx(block_b);
+}
+
+void opt_jumpthreading(ir_graph* irg)
+{
 	assure_irg_properties(irg,
 		IR_GRAPH_PROPERTY_NO_UNREACHABLE_CODE
 		| IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
@@ -707,12 +837,43 @@ void opt_jumpthreading(ir_graph* irg)
 
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_IRN_VISITED);
 
-	changed = false;
+	threading_t thr;
+	memset(&thr, 0, sizeof(thr));
+	thr.path       = NEW_ARR_F(path_entry_t, 0);
+	thr.searched   = NEW_ARR_F(ir_node*, 0);
+	thr.no_const   = NEW_ARR_FZ(unsigned, get_irg_last_idx(irg));
+	thr.generation = 1;
+	thr.budget     = MAX(MIN_BUDGET,
+	                     (long)get_irg_last_idx(irg) * BUDGET_PERCENT / 100);
+	thr.use_freq   = get_block_execfreq(get_irg_start_block(irg)) > 0.0;
+
+	ir_node **blocks  = NEW_ARR_F(ir_node*, 0);
+	bool      changed = false;
 	do {
-		rerun = false;
-		irg_block_walk_graph(irg, thread_jumps, NULL, &rerun);
-		changed |= rerun;
-	} while (rerun);
+		thr.changed = false;
+		ARR_SHRINKLEN(blocks, 0);
+		irg_block_walk_graph(irg, collect_cond_succs, NULL, &blocks);
+		if (thr.use_freq)
+			qsort(blocks, ARR_LEN(blocks), sizeof(*blocks), cmp_block_freq);
+		for (size_t i = 0, n = ARR_LEN(blocks); i < n; ++i) {
+			/* thread further jumps over the same condition right away
+			 * instead of waiting for the next round */
+			for (ir_node *block = blocks[i]; block != NULL;)
+				block = thread_jumps(&thr, block);
+		}
+		changed |= thr.changed;
+	} while (thr.changed);
+
+	DB((dbg, LEVEL_1, "===> %u threads, %u nodes duplicated, %u rejected\n",
+	    thr.n_threads, thr.n_duplicated, thr.n_rejected));
+	stat_ev_int("jumpthreading_threads", thr.n_threads);
+	stat_ev_int("jumpthreading_duplicated", thr.n_duplicated);
+	stat_ev_int("jumpthreading_rejected", thr.n_rejected);
+
+	DEL_ARR_F(blocks);
+	DEL_ARR_F(thr.no_const);
+	DEL_ARR_F(thr.searched);
+	DEL_ARR_F(thr.path);
 
 	ir_free_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_IRN_VISITED);
 
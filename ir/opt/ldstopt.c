@@ -29,10 +29,14 @@
 #include "iredges.h"
 #include "irmemory.h"
 #include "irnodehashmap.h"
+#include "irnodeset.h"
+#include "irdom.h"
+#include "irloop_t.h"
 #include "irgopt.h"
 #include "set.h"
 #include "be.h"
 #include "debug.h"
+#include "memssa.h"
 
 /** The debug handle. */
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
@@ -82,6 +86,9 @@ static unsigned master_visited = 0;
 #define MARK_NODE(info)    (info)->visited = master_visited
 #define NODE_VISITED(info) (info)->visited >= master_visited
 
+/** the memory partitions of the current graph */
+static ir_memssa_t *memssa;
+
 /**
  * get the Load/Store info of a node
  */
@@ -566,6 +573,15 @@ static int try_load_after_store(ir_node *load,
 	return res | DF_CHANGED;
 }
 
+/**
+ * Returns the operation producing the reaching access of memory partition
+ * @p part at the memory value @p mem.
+ */
+static ir_node *get_reaching_op(unsigned part, ir_node *mem)
+{
+	return skip_Proj(memssa_get_access(memssa, mem, part));
+}
+
 /**
  * Follow the memory chain as long as there are only Loads,
  * alias free Stores, and constant Calls and try to replace the
@@ -584,6 +600,7 @@ static unsigned follow_Mem_chain(ir_node *load, ir_node *curr)
 	ir_node     *ptr       = get_Load_ptr(load);
 	ir_node     *mem       = get_Load_mem(load);
 	ir_mode     *load_mode = get_Load_mode(load);
+	unsigned     part      = memssa_get_partition(memssa, load);
 
 	for (pred = curr; load != pred; ) {
 		ldst_info_t *pred_info = (ldst_info_t*)get_irn_link(pred);
@@ -677,14 +694,14 @@ static unsigned follow_Mem_chain(ir_node *load, ir_node *curr)
 			/* if the might be an alias, we cannot pass this Store */
 			if (rel != ir_no_alias)
 				break;
-			pred = skip_Proj(get_Store_mem(pred));
+			pred = get_reaching_op(part, get_Store_mem(pred));
 		} else if (is_Load(pred)) {
-			pred = skip_Proj(get_Load_mem(pred));
+			pred = get_reaching_op(part, get_Load_mem(pred));
 		} else if (is_Call(pred)) {
 			if (is_Call_pure(pred)) {
 				/* The called graph is at least pure, so there are no Store's
 				   in it. We can handle it like a Load and skip it. */
-				pred = skip_Proj(get_Call_mem(pred));
+				pred = get_reaching_op(part, get_Call_mem(pred));
 			} else {
 				/* there might be Store's in the graph, stop here */
 				break;
@@ -705,7 +722,7 @@ static unsigned follow_Mem_chain(ir_node *load, ir_node *curr)
 
 		/* handle all Sync predecessors */
 		for (i = get_Sync_n_preds(pred) - 1; i >= 0; --i) {
-			res |= follow_Mem_chain(load, skip_Proj(get_Sync_pred(pred, i)));
+			res |= follow_Mem_chain(load, get_reaching_op(part, get_Sync_pred(pred, i)));
 			if (res)
 				return res;
 		}
@@ -806,7 +823,7 @@ static unsigned optimize_load(ir_node *load)
 	 * We break such cycles using a special visited flag.
 	 */
 	INC_MASTER();
-	res = follow_Mem_chain(load, skip_Proj(mem));
+	res = follow_Mem_chain(load, get_reaching_op(memssa_get_partition(memssa, load), mem));
 	return res;
 }
 
@@ -1276,29 +1293,35 @@ static int optimize_conv_load(ir_node *conv)
  */
 static void do_load_store_optimize(ir_node *n, void *env)
 {
-	walk_env_t *wenv = (walk_env_t*)env;
+	walk_env_t *wenv    = (walk_env_t*)env;
+	unsigned    changes = 0;
 
 	switch (get_irn_opcode(n)) {
 
 	case iro_Load:
-		wenv->changes |= optimize_load(n);
+		changes = optimize_load(n);
 		break;
 
 	case iro_Store:
-		wenv->changes |= optimize_store(n);
+		changes = optimize_store(n);
 		break;
 
 	case iro_Phi:
-		wenv->changes |= optimize_phi(n, wenv);
+		changes = optimize_phi(n, wenv);
 		break;
 
 	case iro_Conv:
-		wenv->changes |= optimize_conv_load(n);
+		changes = optimize_conv_load(n);
 		break;
 
 	default:
 		break;
 	}
+
+	/* the memoized reaching accesses may refer to removed nodes now */
+	if (changes != 0)
+		memssa_invalidate(memssa);
+	wenv->changes |= changes;
 }
 
 /**
@@ -1341,6 +1364,389 @@ static void do_eliminate_dead_stores(ir_node *n, void *env) {
 	}
 }
 
+/**
+ * A memory user to check. If the walk reached it over a loop backedge, loop
+ * is a loop containing all loops whose backedges were taken, NULL otherwise.
+ */
+typedef struct dse_item_t {
+	ir_node *node;
+	ir_loop *loop;
+} dse_item_t;
+
+/** Environment for tracing the value of a Store along the memory users. */
+typedef struct dse_env_t {
+	ir_node          *ptr;      /**< the address of the Store */
+	ir_mode          *mode;     /**< the mode of the stored value */
+	unsigned          part;     /**< the memory partition of the Store */
+	bool              local;    /**< the partition dies when the graph is
+	                                 left */
+	ir_nodeset_t      visited;  /**< the users seen without a backedge */
+	ir_nodehashmap_t  crossed;  /**< the users seen behind a backedge,
+	                                 mapped to their loop */
+	dse_item_t       *worklist; /**< the memory users still to check */
+} dse_env_t;
+
+/**
+ * Checks whether two addresses are the same. Sels are not CSEd across blocks,
+ * so they are compared structurally.
+ */
+static bool is_same_address(const ir_node *a, const ir_node *b)
+{
+	if (a == b)
+		return true;
+	if (!is_Sel(a) || !is_Sel(b) || get_Sel_entity(a) != get_Sel_entity(b))
+		return false;
+
+	int n = get_Sel_n_indexs(a);
+	if (n != get_Sel_n_indexs(b))
+		return false;
+	for (int i = 0; i < n; ++i) {
+		if (get_Sel_index(a, i) != get_Sel_index(b, i))
+			return false;
+	}
+	return is_same_address(get_Sel_ptr(a), get_Sel_ptr(b));
+}
+
+/** Returns true if loop is outer or equal to the loop inner. */
+static bool loop_contains(const ir_loop *outer, ir_loop *inner)
+{
+	unsigned depth = get_loop_depth(outer);
+	while (get_loop_depth(inner) > depth)
+		inner = get_loop_outer_loop(inner);
+	return inner == outer;
+}
+
+/** Returns the innermost loop containing both loops. */
+static ir_loop *common_loop(ir_loop *a, ir_loop *b)
+{
+	while (get_loop_depth(a) > get_loop_depth(b))
+		a = get_loop_outer_loop(a);
+	while (get_loop_depth(b) > get_loop_depth(a))
+		b = get_loop_outer_loop(b);
+	while (a != b) {
+		a = get_loop_outer_loop(a);
+		b = get_loop_outer_loop(b);
+	}
+	return a;
+}
+
+/**
+ * Checks whether an address has the same value in all iterations of a loop,
+ * i.e. it and the indices of Sels are defined outside of it.
+ */
+static bool is_loop_invariant_address(const ir_node *ptr, const ir_loop *loop)
+{
+	if (loop_contains(loop, get_irn_loop(get_nodes_block(ptr))))
+		return false;
+	if (!is_Sel(ptr))
+		return true;
+
+	for (int i = 0, n = get_Sel_n_indexs(ptr); i < n; ++i) {
+		ir_node *index = get_Sel_index(ptr, i);
+		if (loop_contains(loop, get_irn_loop(get_nodes_block(index))))
+			return false;
+	}
+	return is_loop_invariant_address(get_Sel_ptr(ptr), loop);
+}
+
+/**
+ * Adds the user of a memory value at input pos to the worklist. Taking a
+ * backedge into a memory Phi moves the walk into the next iteration of
+ * the loop.
+ */
+static void dse_push_user(dse_env_t *env, ir_node *user, int pos,
+                          ir_loop *loop)
+{
+	if (is_Phi(user)) {
+		ir_node *block = get_nodes_block(user);
+		if (is_backedge(block, pos)) {
+			ir_loop *head_loop = get_irn_loop(block);
+			loop = loop == NULL ? head_loop : common_loop(loop, head_loop);
+		}
+	}
+
+	if (loop == NULL) {
+		if (!ir_nodeset_insert(&env->visited, user))
+			return;
+	} else {
+		ir_loop *seen = ir_nodehashmap_get(ir_loop, &env->crossed, user);
+		if (seen != NULL) {
+			loop = common_loop(seen, loop);
+			if (loop == seen)
+				return;
+		}
+		ir_nodehashmap_insert(&env->crossed, user, loop);
+	}
+
+	dse_item_t item = { user, loop };
+	ARR_APP1(dse_item_t, env->worklist, item);
+}
+
+static void dse_push_users(dse_env_t *env, ir_node *mem, ir_loop *loop)
+{
+	foreach_out_edge(mem, edge) {
+		dse_push_user(env, get_edge_src_irn(edge), get_edge_src_pos(edge),
+		              loop);
+	}
+}
+
+/**
+ * Checks whether a memory user may read the stored value. If it passes the
+ * value on, the users of its memory result are pushed.
+ */
+static bool dse_may_observe(dse_env_t *env, dse_item_t item)
+{
+	ir_node *user = item.node;
+	switch (get_irn_opcode(user)) {
+	case iro_Load:
+		if (env->part == MEMSSA_REST
+		    || memssa_get_partition(memssa, user) == env->part)
+			return true;
+		break;
+
+	case iro_Store:
+		/* a Store to the same address overwrites the value, unless it
+		 * raises an exception instead. Behind a loop backedge the same
+		 * address node may point somewhere else, unless it is invariant. */
+		if (is_same_address(get_Store_ptr(user), env->ptr)
+		    && is_completely_overwritten(env->mode, get_irn_mode(get_Store_value(user)))
+		    && !ir_throws_exception(user)
+		    && (item.loop == NULL
+		        || is_loop_invariant_address(get_Store_ptr(user), item.loop)))
+			return false;
+		break;
+
+	case iro_Call:
+		/* a callee cannot access frame entities whose address is not taken */
+		if (!env->local)
+			return true;
+		break;
+
+	case iro_Div:
+	case iro_Mod:
+		break;
+
+	case iro_Phi:
+	case iro_Sync:
+		dse_push_users(env, user, item.loop);
+		return false;
+
+	case iro_Return:
+		/* the frame dies here, everything else stays visible */
+		return !env->local;
+
+	case iro_End:
+		/* keep-alive edges do not read memory */
+		return false;
+
+	default:
+		return true;
+	}
+
+	foreach_out_edge(user, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+		if (get_irn_mode(proj) == mode_M)
+			dse_push_users(env, proj, item.loop);
+	}
+	return false;
+}
+
+/**
+ * Checks whether the stored value may be read behind one of the given memory
+ * users, using it at the given inputs, before it is overwritten.
+ */
+static bool dse_is_observed(dse_env_t *env, ir_node **users,
+                            const int *positions, size_t n_users)
+{
+	bool res = false;
+
+	ir_nodeset_init(&env->visited);
+	ir_nodehashmap_init(&env->crossed);
+	env->worklist = NEW_ARR_F(dse_item_t, 0);
+	for (size_t i = 0; i < n_users; ++i)
+		dse_push_user(env, users[i], positions[i], NULL);
+	while (ARR_LEN(env->worklist) > 0) {
+		dse_item_t item = env->worklist[ARR_LEN(env->worklist) - 1];
+		ARR_SHRINKLEN(env->worklist, ARR_LEN(env->worklist) - 1);
+		if (dse_may_observe(env, item)) {
+			res = true;
+			break;
+		}
+	}
+	DEL_ARR_F(env->worklist);
+	ir_nodehashmap_destroy(&env->crossed);
+	ir_nodeset_destroy(&env->visited);
+	return res;
+}
+
+/**
+ * Returns the successor of block which dominates the memory use, -1 if there
+ * is none.
+ */
+static int find_dominating_succ(ir_node **succs, size_t n_succs,
+                                const ir_node *use_block)
+{
+	for (size_t i = 0; i < n_succs; ++i) {
+		if (block_dominates(succs[i], use_block))
+			return (int)i;
+	}
+	return -1;
+}
+
+/**
+ * Sinks a Store which is the last memory operation of its block into the
+ * successors on whose paths the value may be read. Users behind the other
+ * successors get the memory before the Store.
+ */
+static unsigned sink_store(ir_node *store, dse_env_t *env, ir_node **users,
+                           int *positions, size_t n_users)
+{
+	ir_node *block   = get_nodes_block(store);
+	ir_node **succs  = NEW_ARR_F(ir_node*, 0);
+	unsigned  res    = 0;
+
+	foreach_block_succ(block, edge) {
+		ir_node *succ = get_edge_src_irn(edge);
+		if (get_Block_n_cfgpreds(succ) != 1)
+			goto end;
+		ARR_APP1(ir_node*, succs, succ);
+	}
+	size_t n_succs = ARR_LEN(succs);
+	if (n_succs < 2)
+		goto end;
+
+	/* group the users by the successor they are reached through */
+	int *group = ALLOCAN(int, n_users);
+	for (size_t i = 0; i < n_users; ++i) {
+		ir_node *user = users[i];
+		if (is_End(user))
+			goto end;
+		ir_node *use_block = is_Phi(user)
+			? get_Block_cfgpred_block(get_nodes_block(user), positions[i])
+			: get_nodes_block(user);
+		group[i] = find_dominating_succ(succs, n_succs, use_block);
+		if (group[i] < 0)
+			goto end;
+	}
+
+	bool *observed    = ALLOCANZ(bool, n_succs);
+	bool  has_dead    = false;
+	bool  has_live    = false;
+	ir_node **members    = ALLOCAN(ir_node*, n_users);
+	int      *member_pos = ALLOCAN(int, n_users);
+	for (size_t s = 0; s < n_succs; ++s) {
+		size_t n_members = 0;
+		for (size_t i = 0; i < n_users; ++i) {
+			if (group[i] == (int)s) {
+				members[n_members]    = users[i];
+				member_pos[n_members] = positions[i];
+				++n_members;
+			}
+		}
+		observed[s] = n_members > 0
+		              && dse_is_observed(env, members, member_pos, n_members);
+		has_live |= observed[s];
+		has_dead |= !observed[s];
+	}
+	if (!has_dead || !has_live)
+		goto end;
+
+	dbg_info      *dbgi  = get_irn_dbg_info(store);
+	ir_node       *mem   = get_Store_mem(store);
+	ir_node       *value = get_Store_value(store);
+	ir_cons_flags  flags = get_Store_unaligned(store) == align_non_aligned
+	                       ? cons_unaligned : cons_none;
+	for (size_t s = 0; s < n_succs; ++s) {
+		ir_node *new_mem = mem;
+		if (observed[s]) {
+			ir_node *copy = new_rd_Store(dbgi, succs[s], mem, env->ptr, value,
+			                             flags);
+			new_mem = new_r_Proj(copy, mode_M, pn_Store_M);
+			DB((dbg, LEVEL_1, "  Sinking %+F into %+F as %+F\n", store, succs[s], copy));
+		}
+		for (size_t i = 0; i < n_users; ++i) {
+			if (group[i] == (int)s)
+				set_irn_n(users[i], positions[i], new_mem);
+		}
+	}
+	kill_and_reduce_usage(store);
+	res = DF_CHANGED;
+
+end:
+	DEL_ARR_F(succs);
+	return res;
+}
+
+/**
+ * Removes a Store whose value is overwritten or dies on all paths before it
+ * is read. A Store ending its block whose value is read only behind some
+ * successors is sunk into these.
+ */
+static unsigned optimize_dead_store(ir_node *store)
+{
+	ir_node *proj = NULL;
+	foreach_out_edge(store, edge) {
+		ir_node *succ = get_edge_src_irn(edge);
+		if (is_Proj(succ) && get_Proj_proj(succ) == pn_Store_M)
+			proj = succ;
+	}
+	if (proj == NULL)
+		return 0;
+
+	dse_env_t env;
+	env.ptr   = get_Store_ptr(store);
+	env.mode  = get_irn_mode(get_Store_value(store));
+	env.part  = memssa_get_partition(memssa, store);
+	env.local = memssa_is_local(memssa, env.part);
+
+	size_t    n_users   = get_irn_n_edges(proj);
+	ir_node **users     = ALLOCAN(ir_node*, n_users);
+	int      *positions = ALLOCAN(int, n_users);
+	size_t    i         = 0;
+	foreach_out_edge(proj, edge) {
+		users[i]     = get_edge_src_irn(edge);
+		positions[i] = get_edge_src_pos(edge);
+		++i;
+	}
+
+	if (!dse_is_observed(&env, users, positions, n_users)) {
+		DB((dbg, LEVEL_1, "  Killing %+F overwritten on all paths\n", store));
+		exchange(proj, get_Store_mem(store));
+		kill_and_reduce_usage(store);
+		return DF_CHANGED;
+	}
+
+	return sink_store(store, &env, users, positions, n_users);
+}
+
+static void collect_stores(ir_node *n, void *env)
+{
+	ir_node ***stores = (ir_node***)env;
+	if (is_Store(n) && get_Store_volatility(n) != volatility_is_volatile
+	    && !ir_throws_exception(n))
+		ARR_APP1(ir_node*, *stores, n);
+}
+
+/**
+ * Removes Stores overwritten or dead on all paths and sinks the ones which
+ * are dead on some paths.
+ */
+static unsigned eliminate_global_dead_stores(ir_graph *irg)
+{
+	unsigned  changes = 0;
+	ir_node **stores  = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, NULL, collect_stores, &stores);
+
+	memssa = memssa_new(irg);
+	for (size_t i = 0, n = ARR_LEN(stores); i < n; ++i)
+		changes |= optimize_dead_store(stores[i]);
+	memssa_free(memssa);
+	memssa = NULL;
+
+	DEL_ARR_F(stores);
+	return changes;
+}
+
 /** A scc. */
 typedef struct scc {
 	ir_node *head;      /**< the head of the list */
@@ -1924,6 +2330,7 @@ void optimize_load_store(ir_graph *irg)
 	if (get_opt_alias_analysis()) {
 		assure_irp_globals_entity_usage_computed();
 	}
+	assure_irg_alias_cache(irg);
 
 	obstack_init(&env.obst);
 	env.changes = 0;
@@ -1933,14 +2340,26 @@ void optimize_load_store(ir_graph *irg)
 	irg_walk_graph(irg, firm_clear_link, collect_nodes, &env);
 
 	/* now we have collected enough information, optimize */
+	memssa = memssa_new(irg);
 	irg_walk_graph(irg, NULL, do_load_store_optimize, &env);
+	memssa_free(memssa);
+	memssa = NULL;
 
 	/* optimize_load can introduce dead stores. They are
 	 * eliminated now. */
 	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE);
 	assure_irg_entity_usage_computed(irg);
+	assure_irg_alias_cache(irg);
 	irg_walk_graph(irg, NULL, do_eliminate_dead_stores, &env);
 
+	/* removing exception edges invalidated the dominance */
+	if (env.changes & CF_CHANGED)
+		clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		                     | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                      | IR_GRAPH_PROPERTY_CONSISTENT_LOOPINFO);
+	env.changes |= eliminate_global_dead_stores(irg);
+
 	env.changes |= optimize_loops(irg);
 
 	obstack_free(&env.obst, NULL);
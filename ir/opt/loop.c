@@ -27,11 +27,14 @@
 #include "array_t.h"
 #include "beutil.h"
 #include "irdom.h"
+#include "execfreq.h"
 
 #include <math.h>
 #include "irbackedge_t.h"
 #include "irnodemap.h"
+#include "irnodeset.h"
 #include "irloop_t.h"
+#include "irgraph_t.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
@@ -93,6 +96,8 @@ typedef struct loop_stats_t {
 	unsigned constant_unroll;
 	unsigned invariant_unroll;
 
+	unsigned unswitched;
+
 	unsigned unhandled;
 } loop_stats_t;
 
@@ -117,6 +122,7 @@ static void print_stats(void)
 	DB((dbg, LEVEL_2, "u_simple_counting :   %d\n",stats.u_simple_counting_loop));
 	DB((dbg, LEVEL_2, "constant_unroll   :   %d\n",stats.constant_unroll));
 	DB((dbg, LEVEL_2, "invariant_unroll  :   %d\n",stats.invariant_unroll));
+	DB((dbg, LEVEL_2, "unswitched        :   %d\n",stats.unswitched));
 	DB((dbg, LEVEL_2, "=======================================\n"));
 }
 
@@ -135,6 +141,11 @@ unsigned max_unrolled_loop_size;    /* [nodes] */
 bool     allow_const_unrolling;
 bool     allow_invar_unrolling;
 unsigned invar_unrolling_min_size;  /* [nodes] */
+unsigned max_invar_unroll;          /* Maximum invariant unroll factor */
+unsigned max_unroll_pressure;       /* Maximum estimated live values */
+
+unsigned max_unswitch_size;         /* Maximum nodes of unswitched loop */
+double   min_unswitch_freq;         /* Minimum branch executions per entry */
 
 } loop_opt_params_t;
 
@@ -169,7 +180,8 @@ typedef struct loop_info_t {
 
 	ir_tarval *count_tar;               /* Number of loop iterations */
 
-	ir_node *duff_cond;                 /* Duff mod */
+	ir_relation relation;               /* iv relation end_val stays in loop */
+	unsigned    abs_step;               /* absolute value of step */
 	unrolling_kind_flag unroll_kind;    /* constant or invariant unrolling */
 } loop_info_t;
 
@@ -199,7 +211,8 @@ static struct obstack obst;
 typedef enum loop_op_t {
 	loop_op_inversion,
 	loop_op_unrolling,
-	loop_op_peeling
+	loop_op_peeling,
+	loop_op_unswitching
 } loop_op_t;
 
 /* Saves which loop operation to do until after basic tests. */
@@ -476,7 +489,9 @@ static void set_unroll_copy(ir_node *n, int nr, ir_node *cp)
 
 	info = ir_nodemap_get(unrolling_node_info, &map, n);
 	if (! info) {
-		ir_node **const arr = NEW_ARR_DZ(ir_node*, &obst, unroll_nr);
+		/* invariant unrolling keeps the original loop besides unroll_nr
+		 * copies */
+		ir_node **const arr = NEW_ARR_DZ(ir_node*, &obst, unroll_nr + 1);
 
 		info = OALLOCZ(&obst, unrolling_node_info);
 		info->copies = arr;
@@ -1338,36 +1353,6 @@ static void loop_inversion(ir_graph *irg)
 	ir_free_resources(irg, IR_RESOURCE_BLOCK_MARK);
 }
 
-/* Fix the original loop_heads ins for invariant unrolling case. */
-static void unrolling_fix_loop_head_inv(void)
-{
-	ir_node *ins[2];
-	ir_node *phi;
-	ir_node *proj = new_Proj(loop_info.duff_cond, mode_X, 0);
-	ir_node *head_pred = get_irn_n(loop_head, loop_info.be_src_pos);
-	ir_node *loop_condition = get_unroll_copy(head_pred, unroll_nr - 1);
-
-	/* Original loop_heads ins are:
-	 * duff block and the own backedge */
-
-	ins[0] = loop_condition;
-	ins[1] = proj;
-	set_irn_in(loop_head, 2, ins);
-	DB((dbg, LEVEL_4, "Rewire ins of block loophead %N to pred %N and duffs entry %N \n" , loop_head, ins[0], ins[1]));
-
-	for_each_phi(loop_head, phi) {
-		ir_node *pred = get_irn_n(phi, loop_info.be_src_pos);
-		/* TODO we think it is a phi, but for Mergesort it is not the case.*/
-
-		ir_node *last_pred = get_unroll_copy(pred, unroll_nr - 1);
-
-		ins[0] = last_pred;
-		ins[1] = (ir_node*)get_irn_link(phi);
-		set_irn_in(phi, 2, ins);
-		DB((dbg, LEVEL_4, "Rewire ins of loophead phi %N to pred %N and duffs entry %N \n" , phi, ins[0], ins[1]));
-	}
-}
-
 /* Removes previously created phis with only 1 in. */
 static void correct_phis(ir_node *node, void *env)
 {
@@ -1387,151 +1372,6 @@ static void correct_phis(ir_node *node, void *env)
 	}
 }
 
-/* Unrolling: Rewire floating copies. */
-static void place_copies(int copies)
-{
-	ir_node *loophead = loop_head;
-	size_t i;
-	int c;
-	int be_src_pos = loop_info.be_src_pos;
-
-	/* Serialize loops by fixing their head ins.
-	 * Processed are the copies.
-	 * The original loop is done after that, to keep backedge infos. */
-	for (c = 0; c < copies; ++c) {
-#ifdef DEBUG_libfirm
-		ir_node *upper = get_unroll_copy(loophead, c);
-#endif
-		ir_node *lower = get_unroll_copy(loophead, c + 1);
-		ir_node *phi;
-		ir_node *topmost_be_block = get_nodes_block(get_irn_n(loophead, be_src_pos));
-
-		/* Important: get the preds first and then their copy. */
-		ir_node *upper_be_block = get_unroll_copy(topmost_be_block, c);
-		ir_node *new_jmp = new_r_Jmp(upper_be_block);
-		DB((dbg, LEVEL_5, " place_copies upper %N lower %N\n", upper, lower));
-
-		DB((dbg, LEVEL_5, "topmost be block %N \n", topmost_be_block));
-
-		if (loop_info.unroll_kind == constant) {
-			ir_node *ins[1];
-			ins[0] = new_jmp;
-			set_irn_in(lower, 1, ins);
-
-			for_each_phi(loophead, phi) {
-				ir_node *topmost_def = get_irn_n(phi, be_src_pos);
-				ir_node *upper_def = get_unroll_copy(topmost_def, c);
-				ir_node *lower_phi = get_unroll_copy(phi, c + 1);
-
-				/* It is possible, that the value used
-				 * in the OWN backedge path is NOT defined in this loop. */
-				if (is_in_loop(topmost_def))
-					ins[0] = upper_def;
-				else
-					ins[0] = topmost_def;
-
-				set_irn_in(lower_phi, 1, ins);
-				/* Need to replace phis with 1 in later. */
-			}
-		} else {
-			/* Invariant case */
-			/* Every node has 2 ins. One from the duff blocks
-			 * and one from the previously unrolled loop. */
-			ir_node *ins[2];
-			/* Calculate corresponding projection of mod result for this copy c */
-			ir_node *proj = new_Proj(loop_info.duff_cond, mode_X, unroll_nr - c - 1);
-			DB((dbg, LEVEL_4, "New duff proj %N\n" , proj));
-
-			ins[0] = new_jmp;
-			ins[1] = proj;
-			set_irn_in(lower, 2, ins);
-			DB((dbg, LEVEL_4, "Rewire ins of Block %N to pred %N and duffs entry %N \n" , lower, ins[0], ins[1]));
-
-			for_each_phi(loophead, phi) {
-				ir_node *topmost_phi_pred = get_irn_n(phi, be_src_pos);
-				ir_node *upper_phi_pred;
-				ir_node *lower_phi;
-				ir_node *duff_phi;
-
-				lower_phi = get_unroll_copy(phi, c + 1);
-				duff_phi = (ir_node*)get_irn_link(phi);
-				DB((dbg, LEVEL_4, "DD Link of %N is %N\n" , phi, duff_phi));
-
-				/*  */
-				if (is_in_loop(topmost_phi_pred)) {
-					upper_phi_pred = get_unroll_copy(topmost_phi_pred, c);
-				} else {
-					upper_phi_pred = topmost_phi_pred;
-				}
-
-				ins[0] = upper_phi_pred;
-				ins[1] = duff_phi;
-				set_irn_in(lower_phi, 2, ins);
-				DB((dbg, LEVEL_4, "Rewire ins of %N to pred %N and duffs entry %N \n" , lower_phi, ins[0], ins[1]));
-			}
-		}
-	}
-
-	/* Reconnect last copy. */
-	for (i = 0; i < ARR_LEN(loop_entries); ++i) {
-		entry_edge edge = loop_entries[i];
-		/* Last copy is at the bottom */
-		ir_node *new_pred = get_unroll_copy(edge.pred, copies);
-		set_irn_n(edge.node, edge.pos, new_pred);
-	}
-
-	/* Fix original loops head.
-	 * Done in the end, as ins and be info were needed before. */
-	if (loop_info.unroll_kind == constant) {
-		ir_node *phi;
-		ir_node *head_pred = get_irn_n(loop_head, be_src_pos);
-		ir_node *loop_condition = get_unroll_copy(head_pred, unroll_nr - 1);
-
-		set_irn_n(loop_head, loop_info.be_src_pos, loop_condition);
-
-		for_each_phi(loop_head, phi) {
-			ir_node *pred = get_irn_n(phi, be_src_pos);
-			ir_node *last_pred;
-
-			/* It is possible, that the value used
-			 * in the OWN backedge path is NOT assigned in this loop. */
-			if (is_in_loop(pred))
-				last_pred = get_unroll_copy(pred, copies);
-			else
-				last_pred = pred;
-			set_irn_n(phi, be_src_pos, last_pred);
-		}
-
-	} else {
-		unrolling_fix_loop_head_inv();
-	}
-}
-
-/* Copies the cur_loop several times. */
-static void copy_loop(entry_edge *cur_loop_outs, int copies)
-{
-	int c;
-
-	ir_reserve_resources(current_ir_graph, IR_RESOURCE_IRN_VISITED);
-
-	for (c = 0; c < copies; ++c) {
-		size_t i;
-
-		inc_irg_visited(current_ir_graph);
-
-		DB((dbg, LEVEL_5, "         ### Copy_loop  copy nr: %d ###\n", c));
-		for (i = 0; i < ARR_LEN(cur_loop_outs); ++i) {
-			entry_edge entry = cur_loop_outs[i];
-			ir_node *pred = get_irn_n(entry.node, entry.pos);
-
-			copy_walk_n(pred, is_in_loop, c + 1);
-		}
-	}
-
-	ir_free_resources(current_ir_graph, IR_RESOURCE_IRN_VISITED);
-}
-
-
 /* Creates a new phi from the given phi node omitting own bes,
  * using be_block as supplier of backedge informations. */
 static ir_node *clone_phis_sans_bes(ir_node *phi, ir_node *be_block, ir_node *dest_block)
@@ -1543,7 +1383,7 @@ static ir_node *clone_phis_sans_bes(ir_node *phi, ir_node *be_block, ir_node *de
 	int const arity = get_Phi_n_preds(phi);
 	assert(arity == get_Block_n_cfgpreds(be_block));
 
-	ins = NEW_ARR_F(ir_node *, arity);
+	NEW_ARR_A(ir_node *, ins, arity);
 	for (i = 0; i < arity; ++i) {
 		if (! is_own_backedge(be_block, i)) {
 			ins[c] = get_irn_n(phi, i);
@@ -1554,7 +1394,7 @@ static ir_node *clone_phis_sans_bes(ir_node *phi, ir_node *be_block, ir_node *de
 	newphi = new_r_Phi(dest_block, c, ins, get_irn_mode(phi));
 
 	set_irn_link(phi, newphi);
-	DB((dbg, LEVEL_4, "Linking for duffs device %N to %N\n", phi, newphi));
+	DB((dbg, LEVEL_4, "Linking entry phi %N to %N\n", phi, newphi));
 
 	return newphi;
 }
@@ -1577,185 +1417,201 @@ static ir_node *clone_block_sans_bes(ir_node *node, ir_node *be_block)
 		}
 	}
 
-	return new_Block(c, ins);
+	return new_r_Block(get_irn_irg(node), c, ins);
 }
 
-/* Creates a structure to calculate absolute value of node op.
- * Returns mux node with absolute value. */
-static ir_node *new_Abs(ir_node *op, ir_mode *mode)
+/* Unrolling: Chains the copy with index nr + 1 behind the copy nr. */
+static void link_copies(int nr)
 {
-  ir_graph *irg      = get_irn_irg(op);
-  ir_node  *block    = get_nodes_block(op);
-  ir_node  *zero     = new_r_Const(irg, get_mode_null(mode));
-  ir_node  *cmp      = new_r_Cmp(block, op, zero, ir_relation_less);
-  ir_node  *minus_op = new_r_Minus(block, op, mode);
-  ir_node  *mux      = new_r_Mux(block, cmp, op, minus_op, mode);
+	int      be_src_pos = loop_info.be_src_pos;
+	ir_node *be_block   = get_nodes_block(get_irn_n(loop_head, be_src_pos));
+	ir_node *upper      = get_unroll_copy(be_block, nr);
+	ir_node *lower      = get_unroll_copy(loop_head, nr + 1);
+	ir_node *in[1];
+	ir_node *phi;
 
-  return mux;
-}
+	DB((dbg, LEVEL_5, " link_copies upper %N lower %N\n", upper, lower));
 
+	in[0] = new_r_Jmp(upper);
+	set_irn_in(lower, 1, in);
 
-/* Creates blocks for duffs device, using previously obtained
- * informations about the iv.
- * TODO split */
-static void create_duffs_block(void)
-{
-	ir_mode *mode;
+	for_each_phi(loop_head, phi) {
+		ir_node *topmost_def = get_irn_n(phi, be_src_pos);
+		ir_node *lower_phi   = get_unroll_copy(phi, nr + 1);
 
-	ir_node *block1, *count_block, *duff_block;
-	ir_node *ems, *ems_mod, *ems_div, *ems_mod_proj, *cmp_null,
-	        *ems_mode_cond, *x_true, *x_false, *const_null;
-	ir_node *true_val, *false_val;
-	ir_node *ins[2];
+		/* It is possible, that the value used
+		 * in the OWN backedge path is NOT defined in this loop. */
+		if (is_in_loop(topmost_def))
+			in[0] = get_unroll_copy(topmost_def, nr);
+		else
+			in[0] = topmost_def;
 
-	ir_node *duff_mod, *proj, *cond;
+		set_irn_in(lower_phi, 1, in);
+		/* Need to replace phis with 1 in later. */
+	}
+}
 
-	ir_node *count, *correction, *unroll_c;
-	ir_node *cmp_bad_count, *good_count, *bad_count, *count_phi, *bad_count_neg;
+/* Unrolling: Rewire floating copies. */
+static void place_copies(int copies)
+{
+	size_t i;
+	int c;
+	int be_src_pos = loop_info.be_src_pos;
 	ir_node *phi;
+	ir_node *head_pred = get_irn_n(loop_head, be_src_pos);
+	ir_node *loop_condition = get_unroll_copy(head_pred, unroll_nr - 1);
 
-	mode = get_irn_mode(loop_info.end_val);
-	const_null = new_Const(get_mode_null(mode));
-
-	/* TODO naming
-	 * 1. Calculate first approach to count.
-	 *    Condition: (end - start) % step == 0 */
-	block1 = clone_block_sans_bes(loop_head, loop_head);
-	DB((dbg, LEVEL_4, "Duff block 1 %N\n", block1));
-
-	/* Create loop entry phis in first duff block
-	 * as it becomes the loops preheader */
-	for_each_phi(loop_head, phi) {
-		/* Returns phis pred if phi would have arity 1*/
-		ir_node *new_phi = clone_phis_sans_bes(phi, loop_head, block1);
-
-		(void)new_phi;
-		DB((dbg, LEVEL_4, "HEAD %N phi %N\n", loop_head, phi));
-		DB((dbg, LEVEL_4, "BLOCK1 %N phi %N\n", block1, new_phi));
-	}
-
-	ems = new_r_Sub(block1, loop_info.end_val, loop_info.start_val,
-	        get_irn_mode(loop_info.end_val));
-		DB((dbg, LEVEL_4, "BLOCK1 sub %N\n", ems));
-
-
-	ems = new_Sub(loop_info.end_val, loop_info.start_val,
-		get_irn_mode(loop_info.end_val));
-
-	DB((dbg, LEVEL_4, "mod ins %N %N\n", ems, loop_info.step));
-	ems_mod = new_r_Mod(block1,
-		new_NoMem(),
-		ems,
-		loop_info.step,
-		mode,
-		op_pin_state_pinned);
-	ems_div = new_r_Div(block1,
-		new_NoMem(),
-		ems,
-		loop_info.step,
-		mode,
-		op_pin_state_pinned);
-
-	DB((dbg, LEVEL_4, "New module node %N\n", ems_mod));
-
-	ems_mod_proj = new_r_Proj(ems_mod, mode_Iu, pn_Mod_res);
-	cmp_null = new_r_Cmp(block1, ems_mod_proj, const_null, ir_relation_less);
-	ems_mode_cond = new_r_Cond(block1, cmp_null);
-
-	/* ems % step == 0 */
-	x_true = new_r_Proj(ems_mode_cond, mode_X, pn_Cond_true);
-	/* ems % step != 0 */
-	x_false = new_r_Proj(ems_mode_cond, mode_X, pn_Cond_false);
-
-	/* 2. Second block.
-	 * Assures, duffs device receives a valid count.
-	 * Condition:
-	 *     decreasing: count < 0
-	 *     increasing: count > 0
-	 */
-	ins[0] = x_true;
-	ins[1] = x_false;
-
-	count_block = new_Block(2, ins);
-	DB((dbg, LEVEL_4, "Duff block 2 %N\n", count_block));
-
+	/* Serialize loops by fixing their head ins.
+	 * Processed are the copies.
+	 * The original loop is done after that, to keep backedge infos. */
+	for (c = 0; c < copies; ++c)
+		link_copies(c);
 
-	/* Increase loop-taken-count depending on the loop condition
-	 * uses the latest iv to compare to. */
-	if (loop_info.latest_value == 1) {
-		/* ems % step == 0 :  +0 */
-		true_val = new_Const(get_mode_null(mode));
-		/* ems % step != 0 :  +1 */
-		false_val = new_Const(get_mode_one(mode));
-	} else {
-		ir_tarval *tv_two = new_tarval_from_long(2, mode);
-		/* ems % step == 0 :  +1 */
-		true_val = new_Const(get_mode_one(mode));
-		/* ems % step != 0 :  +2 */
-		false_val = new_Const(tv_two);
+	/* Reconnect last copy. */
+	for (i = 0; i < ARR_LEN(loop_entries); ++i) {
+		entry_edge edge = loop_entries[i];
+		/* Last copy is at the bottom */
+		ir_node *new_pred = get_unroll_copy(edge.pred, copies);
+		set_irn_n(edge.node, edge.pos, new_pred);
 	}
 
-	ins[0] = true_val;
-	ins[1] = false_val;
-
-	correction = new_r_Phi(count_block, 2, ins, mode);
+	/* Fix original loops head.
+	 * Done in the end, as ins and be info were needed before. */
+	set_irn_n(loop_head, be_src_pos, loop_condition);
 
-	count = new_r_Proj(ems_div, mode, pn_Div_res);
+	for_each_phi(loop_head, phi) {
+		ir_node *pred = get_irn_n(phi, be_src_pos);
+		ir_node *last_pred;
 
-	/* (end - start) / step  +  correction */
-	count = new_Add(count, correction, mode);
+		/* It is possible, that the value used
+		 * in the OWN backedge path is NOT assigned in this loop. */
+		if (is_in_loop(pred))
+			last_pred = get_unroll_copy(pred, copies);
+		else
+			last_pred = pred;
+		set_irn_n(phi, be_src_pos, last_pred);
+	}
+}
 
-	/* We preconditioned the loop to be tail-controlled.
-	 * So, if count is something 'wrong' like 0,
-	 * negative/positive (depending on step direction),
-	 * we may take the loop once (tail-contr.) and leave it
-	 * to the existing condition, to break; */
+/* Unrolling with invariant end value: the copies form a new loop in front of
+ * the original loop. Its head checks whether the iv stays in the loop for all
+ * copies and one more iteration, the original loop executes the remaining
+ * iterations. As it is always entered, it stays the only exit.
+ *
+ *          Pre       limit = end_val -/+ distance
+ *         /   \      enter Head unless limit wrapped
+ *  ,--> Head   |     enter Copy 1 if iv relation limit
+ *  |    /  \   |
+ *  | Copy 1 |  |
+ *  |  ...   |  |
+ *  `-Copy n |  |
+ *           Loop     original loop, remaining iterations
+ */
+static void place_copies_invariant(void)
+{
+	ir_graph   *irg        = current_ir_graph;
+	int         be_src_pos = loop_info.be_src_pos;
+	ir_node    *be_block   = get_nodes_block(get_irn_n(loop_head, be_src_pos));
+	ir_node    *end_val    = loop_info.end_val;
+	ir_mode    *mode       = get_irn_mode(end_val);
+	int         n_ins      = 0;
+	int         c;
+	ir_node    *phi;
+	ir_node    *pre, *dist, *limit, *cond, *head, *iv;
+	ir_node    *in[2];
+	ir_node    *loop_in[3];
+	ir_relation no_wrap;
+	long        steps;
+
+	for (c = 1; c < unroll_nr; ++c)
+		link_copies(c);
+
+	/* The pre block takes over the entries of the loop. A check against the
+	 * latest iv value covers all copies, otherwise one step less. */
+	pre = clone_block_sans_bes(loop_head, loop_head);
+	for_each_phi(loop_head, phi) {
+		clone_phis_sans_bes(phi, loop_head, pre);
+	}
 
-	/* Depending on step direction, we have to check for > or < 0 */
-	if (loop_info.decreasing == 1) {
-		cmp_bad_count = new_r_Cmp(count_block, count, const_null,
-		                          ir_relation_less);
+	steps = loop_info.latest_value ? unroll_nr : unroll_nr - 1;
+	dist  = new_r_Const_long(irg, mode, steps * (long)loop_info.abs_step);
+	if (loop_info.decreasing) {
+		limit   = new_r_Add(pre, end_val, dist, mode);
+		no_wrap = ir_relation_greater;
 	} else {
-		cmp_bad_count = new_r_Cmp(count_block, count, const_null,
-		                          ir_relation_greater);
+		limit   = new_r_Sub(pre, end_val, dist, mode);
+		no_wrap = ir_relation_less;
 	}
+	cond = new_r_Cond(pre, new_r_Cmp(pre, limit, end_val, no_wrap));
 
-	bad_count_neg = new_r_Cond(count_block, cmp_bad_count);
-	good_count = new_Proj(bad_count_neg, mode_X, pn_Cond_true);
-	bad_count = new_Proj(ems_mode_cond, mode_X, pn_Cond_false);
+	in[0] = new_r_Proj(cond, mode_X, pn_Cond_true);
+	in[1] = new_r_Jmp(get_unroll_copy(be_block, unroll_nr));
+	head  = new_r_Block(irg, 2, in);
+	DB((dbg, LEVEL_4, "Pre block %N, unrolled head %N\n", pre, head));
 
-	/* 3. Duff Block
-	 *    Contains module to decide which loop to start from. */
+	/* Original loop is entered from pre block and unrolled head. */
+	loop_in[n_ins++] = new_r_Proj(cond, mode_X, pn_Cond_false);
+	iv               = NULL;
+	for_each_phi(loop_head, phi) {
+		ir_node *pre_phi = (ir_node*)get_irn_link(phi);
+		ir_node *be_pred = get_irn_n(phi, be_src_pos);
+		ir_node *last    = be_pred;
+		ir_node *head_phi;
+		ir_node *phi_in[3];
+
+		if (is_in_loop(be_pred))
+			last = get_unroll_copy(be_pred, unroll_nr);
+
+		phi_in[0] = pre_phi;
+		phi_in[1] = last;
+		head_phi  = new_r_Phi(head, 2, phi_in, get_irn_mode(phi));
+		add_Block_phi(head, head_phi);
+		if (phi == loop_info.iteration_phi)
+			iv = head_phi;
+
+		set_irn_in(get_unroll_copy(phi, 1), 1, &head_phi);
+
+		phi_in[1] = head_phi;
+		phi_in[2] = be_pred;
+		set_irn_in(phi, 3, phi_in);
+	}
+	assert(iv != NULL);
+
+	cond  = new_r_Cond(head, new_r_Cmp(head, iv, limit, loop_info.relation));
+	in[0] = new_r_Proj(cond, mode_X, pn_Cond_true);
+	set_irn_in(get_unroll_copy(loop_head, 1), 1, in);
+
+	loop_in[n_ins++] = new_r_Proj(cond, mode_X, pn_Cond_false);
+	loop_in[n_ins++] = get_irn_n(loop_head, be_src_pos);
+	set_irn_in(loop_head, n_ins, loop_in);
+	set_backedge(loop_head, n_ins - 1);
+}
 
-	ins[0] = good_count;
-	ins[1] = bad_count;
-	duff_block = new_Block(2, ins);
-	DB((dbg, LEVEL_4, "Duff block 3 %N\n", duff_block));
+/* Copies the cur_loop several times. */
+static void copy_loop(entry_edge *cur_loop_outs, int copies)
+{
+	int c;
 
-	/* Get absolute value */
-	ins[0] = new_Abs(count, mode);
-	/* Manually feed the aforementioned count = 1 (bad case)*/
-	ins[1] = new_Const(get_mode_one(mode));
-	count_phi = new_r_Phi(duff_block, 2, ins, mode);
+	ir_reserve_resources(current_ir_graph, IR_RESOURCE_IRN_VISITED);
 
-	unroll_c = new_Const(new_tarval_from_long((long)unroll_nr, mode));
+	for (c = 0; c < copies; ++c) {
+		size_t i;
 
-	/* count % unroll_nr */
-	duff_mod = new_r_Mod(duff_block,
-		new_NoMem(),
-		count_phi,
-		unroll_c,
-		mode,
-		op_pin_state_pinned);
+		inc_irg_visited(current_ir_graph);
 
+		DB((dbg, LEVEL_5, "         ### Copy_loop  copy nr: %d ###\n", c));
+		for (i = 0; i < ARR_LEN(cur_loop_outs); ++i) {
+			entry_edge entry = cur_loop_outs[i];
+			ir_node *pred = get_irn_n(entry.node, entry.pos);
 
-	proj = new_Proj(duff_mod, mode, pn_Mod_res);
-	/* condition does NOT create itself in the block of the proj! */
-	cond = new_r_Cond(duff_block, proj);
+			copy_walk_n(pred, is_in_loop, c + 1);
+		}
+	}
 
-	loop_info.duff_cond = cond;
+	ir_free_resources(current_ir_graph, IR_RESOURCE_IRN_VISITED);
 }
 
+
 /* Returns 1 if given node is not in loop,
  * or if it is a phi of the loop head with only loop invariant defs.
  */
@@ -1793,43 +1649,6 @@ static unsigned is_loop_invariant_def(ir_node *node)
 	return 0;
 }
 
-/* Returns 1 if one pred of node is invariant and the other is not.
- * invar_pred and other are set analogously. */
-static unsigned get_invariant_pred(ir_node *node, ir_node **invar_pred, ir_node **other)
-{
-	ir_node *pred0 = get_irn_n(node, 0);
-	ir_node *pred1 = get_irn_n(node, 1);
-
-	*invar_pred = NULL;
-	*other = NULL;
-
-	if (is_loop_invariant_def(pred0)) {
-		DB((dbg, LEVEL_4, "pred0 invar %N\n", pred0));
-		*invar_pred = pred0;
-		*other = pred1;
-	}
-
-	if (is_loop_invariant_def(pred1)) {
-		DB((dbg, LEVEL_4, "pred1 invar %N\n", pred1));
-
-		if (*invar_pred != NULL) {
-			/* RETURN. We do not want both preds to be invariant. */
-			return 0;
-		}
-
-		*other = pred0;
-		*invar_pred = pred1;
-		return 1;
-	} else {
-		DB((dbg, LEVEL_4, "pred1 not invar %N\n", pred1));
-
-		if (*invar_pred != NULL)
-			return 1;
-		else
-			return 0;
-	}
-}
-
 /* Starts from a phi that may belong to an iv.
  * If an add forms a loop with iteration_phi,
  * and add uses a constant, 1 is returned
@@ -2062,118 +1881,179 @@ static unsigned are_mode_I(ir_node *n1, ir_node* n2, ir_node *n3)
 		return 0;
 }
 
-/* Checks if cur_loop is a simple tail-controlled counting loop
- * with start and end value loop invariant, step constant. */
-static unsigned get_unroll_decision_invariant(void)
+/* Environment for the register pressure estimation. */
+typedef struct pressure_env_t {
+	ir_nodeset_t invariants; /* data values used in but defined outside cur_loop */
+	unsigned     carried;    /* data values carried by the loop head phis */
+} pressure_env_t;
+
+/* Collects the loop carried and loop invariant values of cur_loop. */
+static void collect_pressure(ir_node *node, void *data)
 {
+	pressure_env_t *env = (pressure_env_t*)data;
+	int             i;
+
+	if (is_Block(node) || !is_in_loop(node))
+		return;
+
+	if (is_Phi(node)) {
+		if (get_nodes_block(node) == loop_head
+		    && mode_is_data(get_irn_mode(node)))
+			++env->carried;
+		return;
+	}
+
+	for (i = get_irn_arity(node) - 1; i >= 0; --i) {
+		ir_node *pred = get_irn_n(node, i);
+
+		if (!is_in_loop(pred) && mode_is_data(get_irn_mode(pred))
+		    && !is_irn_constlike(pred))
+			ir_nodeset_insert(&env->invariants, pred);
+	}
+}
 
-	ir_node   *projres, *loop_condition, *iteration_path;
-	unsigned   success;
-	ir_tarval *step_tar;
-	ir_mode   *mode;
+/* Returns the unroll factor for the invariant case: the largest power of two
+ * that keeps the node count below the limit and the estimated register
+ * pressure within max_unroll_pressure. The estimate assumes that the
+ * invariants stay live in the whole loop and that scheduling interleaves
+ * the copies, keeping the loop carried values of each copy live. */
+static unsigned get_preferred_factor_invariant(void)
+{
+	pressure_env_t env;
+	unsigned       invariants;
+	unsigned       factor = 1;
+
+	ir_nodeset_init(&env.invariants);
+	env.carried = 0;
+	irg_walk_graph(current_ir_graph, collect_pressure, NULL, &env);
+	invariants = ir_nodeset_size(&env.invariants);
+	ir_nodeset_destroy(&env.invariants);
+
+	DB((dbg, LEVEL_4, "%u invariants, %u loop carried values\n",
+	    invariants, env.carried));
+
+	/* The original loop stays besides the copies. */
+	while (factor * 2 < loop_info.max_unroll
+	       && factor * 2 <= opt_params.max_invar_unroll
+	       && invariants + factor * 2 * env.carried <= opt_params.max_unroll_pressure)
+		factor *= 2;
+
+	DB((dbg, LEVEL_4, "preferred invariant unroll factor %u\n", factor));
+	return factor;
+}
 
+/* Checks if cur_loop is a simple tail-controlled counting loop
+ * with loop invariant end value and constant step. */
+static unsigned get_unroll_decision_invariant(void)
+{
+	ir_node     *cmp, *left, *right, *iv, *other;
+	ir_relation  relation;
+	ir_tarval   *step_tar;
+	ir_mode     *mode;
+	long         step;
 
 	/* RETURN if loop is not 'simple' */
-	projres = is_simple_loop();
-	if (projres == NULL)
+	cmp = is_simple_loop();
+	if (cmp == NULL)
 		return 0;
 
 	/* Use a minimal size for the invariant unrolled loop,
-     * as duffs device produces overhead */
+	 * as the check of the unrolled loop and the remainder produce overhead */
 	if (loop_info.nodes < opt_params.invar_unrolling_min_size)
 		return 0;
 
-	loop_condition = get_irn_n(projres, 0);
-
-	success = get_invariant_pred(loop_condition, &loop_info.end_val, &iteration_path);
-	DB((dbg, LEVEL_4, "pred invar %d\n", success));
-
-	if (! success)
+	/* One operand of the loop condition is the iv, the other one the
+	 * loop invariant end_val. */
+	left     = get_Cmp_left(cmp);
+	right    = get_Cmp_right(cmp);
+	relation = get_Cmp_relation(cmp);
+	if (!is_in_loop(right)) {
+		iv                 = left;
+		loop_info.end_val  = right;
+	} else if (!is_in_loop(left)) {
+		iv                 = right;
+		loop_info.end_val  = left;
+		relation           = get_inversed_relation(relation);
+	} else {
 		return 0;
+	}
 
-	DB((dbg, LEVEL_4, "Invariant End_val %N, other %N\n", loop_info.end_val, iteration_path));
-
-	/* We may find the add or the phi first.
-	 * Until now we only have end_val. */
-	if (is_Add(iteration_path) || is_Sub(iteration_path)) {
-
-		loop_info.add = iteration_path;
-		DB((dbg, LEVEL_4, "Case 1: Got add %N (maybe not sane)\n", loop_info.add));
-
-		/* Preds of the add should be step and the iteration_phi */
-		success = get_const_pred(loop_info.add, &loop_info.step, &loop_info.iteration_phi);
-		if (! success)
-			return 0;
-
-		DB((dbg, LEVEL_4, "Got step %N\n", loop_info.step));
-
-		if (! is_Phi(loop_info.iteration_phi))
-			return 0;
-
-		DB((dbg, LEVEL_4, "Got phi %N\n", loop_info.iteration_phi));
-
-		/* Find start_val.
-		 * Does necessary sanity check of add, if it is already set.  */
-		success = get_start_and_add(loop_info.iteration_phi, invariant);
-		if (! success)
-			return 0;
-
-		DB((dbg, LEVEL_4, "Got start A  %N\n", loop_info.start_val));
-
-	} else if (is_Phi(iteration_path)) {
-		ir_node *new_iteration_phi;
-
-		loop_info.iteration_phi = iteration_path;
-		DB((dbg, LEVEL_4, "Case 2: Got phi %N\n", loop_info.iteration_phi));
-
-		/* Find start_val and add-node.
-		 * Does necessary sanity check of add, if it is already set.  */
-		success = get_start_and_add(loop_info.iteration_phi, invariant);
-		if (! success)
-			return 0;
+	/* Assure that relation is the stay-in-loop case. */
+	if (loop_info.exit_cond == 1)
+		relation = get_negated_relation(relation);
+	relation &= ~ir_relation_unordered;
 
-		DB((dbg, LEVEL_4, "Got start B %N\n", loop_info.start_val));
-		DB((dbg, LEVEL_4, "Got add or sub %N\n", loop_info.add));
+	DB((dbg, LEVEL_4, "iv %N %s end_val %N stays in loop\n", iv,
+	    get_relation_string(relation), loop_info.end_val));
 
-		success = get_const_pred(loop_info.add, &loop_info.step, &new_iteration_phi);
-		if (! success)
+	/* We compare with the value the iv had entering this run or with the
+	 * latest value. */
+	if (is_Phi(iv)) {
+		if (get_nodes_block(iv) != loop_head)
 			return 0;
+		loop_info.iteration_phi = iv;
+		loop_info.add           = get_irn_n(iv, loop_info.be_src_pos);
+		loop_info.latest_value  = 0;
+	} else {
+		loop_info.add           = iv;
+		loop_info.latest_value  = 1;
+	}
 
-		DB((dbg, LEVEL_4, "Got step (B) %N\n", loop_info.step));
-
-		if (loop_info.iteration_phi != new_iteration_phi)
+	if (is_Add(loop_info.add)) {
+		if (!get_const_pred(loop_info.add, &loop_info.step, &other))
 			return 0;
-
+	} else if (is_Sub(loop_info.add)) {
+		loop_info.step = get_Sub_right(loop_info.add);
+		other          = get_Sub_left(loop_info.add);
 	} else {
 		return 0;
 	}
 
-	mode = get_irn_mode(loop_info.end_val);
+	if (!is_Const(loop_info.step) || !is_Phi(other)
+	    || get_nodes_block(other) != loop_head
+	    || get_irn_n(other, loop_info.be_src_pos) != loop_info.add)
+		return 0;
+	if (loop_info.latest_value)
+		loop_info.iteration_phi = other;
+	else if (other != iv)
+		return 0;
 
-	DB((dbg, LEVEL_4, "start %N, end %N, step %N\n",
-				loop_info.start_val, loop_info.end_val, loop_info.step));
+	DB((dbg, LEVEL_4, "phi %N, add %N, step %N\n", loop_info.iteration_phi,
+	    loop_info.add, loop_info.step));
 
+	mode = get_irn_mode(loop_info.end_val);
 	if (mode != mode_Is && mode != mode_Iu)
 		return 0;
 
-	/* TODO necessary? */
-	if (!are_mode_I(loop_info.start_val, loop_info.step, loop_info.end_val))
-		return 0;
+	/* Interpret the step as signed value, subtracting negates it. */
+	step_tar = tarval_convert_to(get_Const_tarval(loop_info.step),
+	                             find_signed_mode(mode));
+	step = get_tarval_long(step_tar);
+	if (is_Sub(loop_info.add))
+		step = -step;
 
-	DB((dbg, LEVEL_4, "mode integer\n"));
+	/* Keep the distance covered by the unrolled loop representable. */
+	if (step == 0 || step > 0x10000 || step < -0x10000)
+		return 0;
 
-	step_tar = get_Const_tarval(loop_info.step);
+	loop_info.decreasing = step < 0;
+	loop_info.abs_step   = (unsigned)(step < 0 ? -step : step);
+	loop_info.relation   = relation;
 
-	if (tarval_is_null(step_tar)) {
-		/* TODO Might be worth a warning. */
-		return 0;
+	/* Only a monotonic iv that has to pass end_val leaves the loop. */
+	if (loop_info.decreasing) {
+		if (relation != ir_relation_greater
+		    && relation != ir_relation_greater_equal)
+			return 0;
+	} else {
+		if (relation != ir_relation_less
+		    && relation != ir_relation_less_equal)
+			return 0;
 	}
 
-	DB((dbg, LEVEL_4, "step is not 0\n"));
-
-	create_duffs_block();
+	++stats.u_simple_counting_loop;
 
-	return loop_info.max_unroll;
+	return get_preferred_factor_invariant();
 }
 
 /* Returns unroll factor,
@@ -2487,6 +2367,14 @@ static void unroll_loop(void)
 		return;
 	}
 
+	/* every unrolling copies the loop body, stop once the graph has grown
+	   beyond the memory budget */
+	if (irg_memory_budget_exceeded(current_ir_graph)) {
+		DB((dbg, LEVEL_2, "Memory budget exceeded\n"));
+		++stats.too_large;
+		return;
+	}
+
 	unroll_nr = 0;
 
 	/* get_unroll_decision_constant and invariant are completely
@@ -2528,11 +2416,17 @@ static void unroll_loop(void)
 		ir_nodemap_init(&map, current_ir_graph);
 		obstack_init(&obst);
 
-		/* Copies the loop */
-		copy_loop(loop_entries, unroll_nr - 1);
+		if (loop_info.unroll_kind == constant) {
+			/* Copies the loop */
+			copy_loop(loop_entries, unroll_nr - 1);
 
-		/* Line up the floating copies. */
-		place_copies(unroll_nr - 1);
+			/* Line up the floating copies. */
+			place_copies(unroll_nr - 1);
+		} else {
+			/* The original loop executes the remaining iterations. */
+			copy_loop(loop_entries, unroll_nr);
+			place_copies_invariant();
+		}
 
 		/* Remove phis with 1 in
 		 * If there were no nested phis, this would not be necessary.
@@ -2554,6 +2448,273 @@ static void unroll_loop(void)
 
 }
 
+/***** Unswitching *****/
+
+/* Returns the selector of cond if it is loop invariant: either defined
+ * outside of cur_loop or a floating node whose operands are. */
+static ir_node *get_invariant_selector(ir_node *cond)
+{
+	ir_node *sel = get_Cond_selector(cond);
+	int      i;
+
+	if (!is_in_loop(sel))
+		return sel;
+	if (is_Phi(sel) || get_irn_pinned(sel) != op_pin_state_floats)
+		return NULL;
+	for (i = get_irn_arity(sel) - 1; i >= 0; --i) {
+		if (is_in_loop(get_irn_n(sel, i)))
+			return NULL;
+	}
+	return sel;
+}
+
+/* Returns true if both successors of cond stay in cur_loop. */
+static bool is_inner_branch(const ir_node *cond)
+{
+	foreach_out_edge(cond, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+
+		foreach_out_edge_kind(proj, succ_edge, EDGE_KIND_BLOCK) {
+			if (!is_in_loop(get_edge_src_irn(succ_edge)))
+				return false;
+		}
+	}
+	return true;
+}
+
+/* Finds the most frequently executed Cond of cur_loop branching on a
+ * loop invariant condition inside the loop. */
+static void find_unswitch_cond(ir_node *node, void *env)
+{
+	ir_node **best = (ir_node**)env;
+
+	if (!is_Cond(node) || !is_in_loop(node))
+		return;
+	if (get_invariant_selector(node) == NULL || !is_inner_branch(node))
+		return;
+
+	if (*best == NULL
+	    || get_block_execfreq(get_nodes_block(node))
+	       > get_block_execfreq(get_nodes_block(*best)))
+		*best = node;
+}
+
+/* Returns true if the branch in cond_block is executed often enough per
+ * entry of the loop. Without execution frequencies every loop qualifies. */
+static bool is_hot_branch(ir_node *cond_block)
+{
+	double entry_freq = 0.0;
+	int    i;
+
+	if (get_block_execfreq(loop_head) <= 0.0)
+		return true;
+
+	for (i = get_Block_n_cfgpreds(loop_head) - 1; i >= 0; --i) {
+		if (!is_own_backedge(loop_head, i))
+			entry_freq += get_block_execfreq(get_Block_cfgpred_block(loop_head, i));
+	}
+	return get_block_execfreq(cond_block)
+	       >= opt_params.min_unswitch_freq * entry_freq;
+}
+
+/* Sets the ins of the loop head copy nr to entry followed by the own
+ * backedges of loop_head. The phis of the head get the phis of the pre
+ * block linked to the original phis as entry values. */
+static void unswitch_fix_head(int nr, ir_node *entry)
+{
+	ir_node  *head  = get_unroll_copy(loop_head, nr);
+	int       arity = get_Block_n_cfgpreds(loop_head);
+	int       n_ins = 0;
+	ir_node **ins;
+	ir_node  *phi;
+	int       i;
+
+	NEW_ARR_A(ir_node *, ins, arity);
+
+	for_each_phi(loop_head, phi) {
+		ir_node *head_phi = get_unroll_copy(phi, nr);
+
+		n_ins = 0;
+		ins[n_ins++] = (ir_node*)get_irn_link(phi);
+		for (i = 0; i < arity; ++i) {
+			if (is_own_backedge(loop_head, i))
+				ins[n_ins++] = get_irn_n(head_phi, i);
+		}
+		set_irn_in(head_phi, n_ins, ins);
+	}
+
+	n_ins = 0;
+	ins[n_ins++] = entry;
+	for (i = 0; i < arity; ++i) {
+		if (is_own_backedge(loop_head, i))
+			ins[n_ins++] = get_irn_n(head, i);
+	}
+	set_irn_in(head, n_ins, ins);
+	for (i = 1; i < n_ins; ++i)
+		set_backedge(head, i);
+}
+
+/* Adds the control flow from the loop copy to the blocks behind exits of
+ * cur_loop. */
+static void unswitch_fix_exit(ir_node *block)
+{
+	int       arity = get_Block_n_cfgpreds(block);
+	int       n_ins = arity;
+	ir_node **ins;
+	ir_node  *phi;
+	int       i;
+
+	NEW_ARR_A(ir_node *, ins, 2 * arity);
+
+	for_each_phi(block, phi) {
+		n_ins = arity;
+		for (i = 0; i < arity; ++i) {
+			ir_node *pred = get_irn_n(phi, i);
+
+			ins[i] = pred;
+			if (!is_in_loop(get_Block_cfgpred(block, i)))
+				continue;
+			ins[n_ins++] = is_in_loop(pred) ? get_unroll_copy(pred, 1) : pred;
+		}
+		set_irn_in(phi, n_ins, ins);
+	}
+
+	n_ins = arity;
+	for (i = 0; i < arity; ++i) {
+		ir_node *pred = get_Block_cfgpred(block, i);
+
+		ins[i] = pred;
+		if (is_in_loop(pred))
+			ins[n_ins++] = get_unroll_copy(pred, 1);
+	}
+	set_irn_in(block, n_ins, ins);
+}
+
+/* Replaces the Cond by a jump to its successor taken, the other successor
+ * loses its predecessor. */
+static void unswitch_fold_cond(ir_node *cond, long taken)
+{
+	ir_graph *irg   = get_irn_irg(cond);
+	ir_node  *block = get_nodes_block(cond);
+
+	foreach_out_edge_safe(cond, edge) {
+		ir_node *proj = get_edge_src_irn(edge);
+
+		if (get_Proj_proj(proj) == taken)
+			exchange(proj, new_r_Jmp(block));
+		else
+			exchange(proj, new_r_Bad(irg, mode_X));
+	}
+}
+
+/**
+ * Loop unswitching: Moves a branch on a loop invariant condition in front of
+ * the loop. The loop is copied, the original executes if the condition is
+ * true, the copy otherwise. The branch inside both loops is replaced by a
+ * jump to the successor it takes there.
+ */
+static void unswitch_loop(void)
+{
+	ir_graph    *irg  = current_ir_graph;
+	ir_node     *cond = NULL;
+	ir_node     *sel, *pre, *pre_cond, *phi;
+	ir_nodeset_t done;
+	size_t       i;
+
+	if (loop_info.cf_outs == 0)
+		return;
+
+	if (loop_info.nodes > opt_params.max_unswitch_size) {
+		DB((dbg, LEVEL_2, "Nodes %d > allowed nodes %d\n",
+			loop_info.nodes, opt_params.max_unswitch_size));
+		++stats.too_large;
+		return;
+	}
+
+	/* every unswitching copies the loop body, stop once the graph has grown
+	   beyond the memory budget */
+	if (irg_memory_budget_exceeded(irg)) {
+		DB((dbg, LEVEL_2, "Memory budget exceeded\n"));
+		++stats.too_large;
+		return;
+	}
+
+	irg_walk_graph(irg, find_unswitch_cond, NULL, &cond);
+	if (cond == NULL || !is_hot_branch(get_nodes_block(cond)))
+		return;
+
+	DB((dbg, LEVEL_2, " *** Unswitching %N ***\n", cond));
+
+	loop_entries = NEW_ARR_F(entry_edge, 0);
+	irg_walk_graph(irg, get_loop_entries, NULL, NULL);
+
+	unroll_nr = 1;
+	ir_nodemap_init(&map, irg);
+	obstack_init(&obst);
+
+	copy_loop(loop_entries, 1);
+
+	/* The pre block takes over the entries of the loop and branches into
+	 * the original loop or the copy. */
+	pre = clone_block_sans_bes(loop_head, loop_head);
+	for_each_phi(loop_head, phi) {
+		clone_phis_sans_bes(phi, loop_head, pre);
+	}
+
+	sel = get_invariant_selector(cond);
+	if (is_in_loop(sel)) {
+		sel = exact_copy(sel);
+		set_nodes_block(sel, pre);
+	}
+	pre_cond = new_r_Cond(pre, sel);
+
+	unswitch_fix_head(1, new_r_Proj(pre_cond, mode_X, pn_Cond_false));
+	unswitch_fix_head(0, new_r_Proj(pre_cond, mode_X, pn_Cond_true));
+
+	/* Both loops leave to the blocks behind the exits of the original. */
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_VISITED);
+	inc_irg_visited(irg);
+	for (i = 0; i < ARR_LEN(loop_entries); ++i) {
+		ir_node *node = loop_entries[i].node;
+
+		if (is_Block(node) && !irn_visited_else_mark(node))
+			unswitch_fix_exit(node);
+	}
+	ir_free_resources(irg, IR_RESOURCE_IRN_VISITED);
+
+	/* Values of the loop used behind it now have two definitions. */
+	ir_nodeset_init(&done);
+	for (i = 0; i < ARR_LEN(loop_entries); ++i) {
+		entry_edge entry = loop_entries[i];
+		ir_node   *pred  = entry.pred;
+		ir_node   *cp;
+
+		if (is_Block(entry.node) || is_End(entry.node)
+		    || get_irn_mode(pred) == mode_X
+		    || !ir_nodeset_insert(&done, pred))
+			continue;
+
+		cp = get_unroll_copy(pred, 1);
+		construct_ssa(get_nodes_block(pred), pred, get_nodes_block(cp), cp);
+	}
+	ir_nodeset_destroy(&done);
+
+	irg_walk_graph(irg, correct_phis, NULL, NULL);
+
+	unswitch_fold_cond(get_unroll_copy(cond, 1), pn_Cond_false);
+	unswitch_fold_cond(cond, pn_Cond_true);
+
+	++stats.unswitched;
+
+	clear_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+	                     | IR_GRAPH_PROPERTY_NO_BADS
+	                     | IR_GRAPH_PROPERTY_NO_UNREACHABLE_CODE);
+
+	DEL_ARR_F(loop_entries);
+	obstack_free(&obst, NULL);
+	ir_nodemap_destroy(&map);
+}
+
 /* Analyzes the loop, and checks if size is within allowed range.
  * Decides if loop will be processed. */
 static void init_analyze(ir_graph *irg, ir_loop *loop)
@@ -2596,6 +2757,10 @@ static void init_analyze(ir_graph *irg, ir_loop *loop)
 			unroll_loop();
 			break;
 
+		case loop_op_unswitching:
+			unswitch_loop();
+			break;
+
 		default:
 			panic("Loop optimization not implemented.");
 	}
@@ -2635,9 +2800,14 @@ static void set_loop_params(void)
 
 
     opt_params.allow_const_unrolling = true;
-    opt_params.allow_invar_unrolling = false;
+    opt_params.allow_invar_unrolling = true;
+
+    opt_params.invar_unrolling_min_size = 8;
+    opt_params.max_invar_unroll = 8;
+    opt_params.max_unroll_pressure = 12;
 
-    opt_params.invar_unrolling_min_size = 20;
+    opt_params.max_unswitch_size = 100;
+    opt_params.min_unswitch_freq = 2.0;
     opt_params.max_unrolled_loop_size = 400;
     opt_params.max_branches = 9999;
 }
@@ -2722,6 +2892,12 @@ void do_loop_peeling(ir_graph *irg)
 	loop_optimization(irg);
 }
 
+void do_loop_unswitching(ir_graph *irg)
+{
+	loop_op = loop_op_unswitching;
+	loop_optimization(irg);
+}
+
 void firm_init_loop_opt(void)
 {
 	FIRM_DBG_REGISTER(dbg, "firm.opt.loop");
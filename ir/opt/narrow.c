@@ -0,0 +1,326 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2013 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Narrows integer operations to the bits their users care for.
+ *
+ * The don't care analysis (dca.c) tells which bits of each value are
+ * relevant. Arithmetic, Phis and Loads whose relevant bits fit into a
+ * smaller integer mode are computed in that mode:
+ *
+ *    Conv Hu                                   Conv Hu
+ *       |                                         |
+ *    Add Is       gets transformed to          Add Hs
+ *     /   \                                    /   \
+ *  Load Is  b                             Load Hs  Conv Hs
+ *                                                    |
+ *                                                    b
+ *
+ * A node is only narrowed if each of its users is narrowed to at most the
+ * same width or truncates the value anyway, so no extensions are added and
+ * the Convs between the operations vanish.
+ *
+ * Backends which compute small modes in full registers have to extend the
+ * narrowed values again, so the smallest width is chosen by the caller.
+ */
+#include "iroptimize.h"
+
+#include <stdbool.h>
+
+#include "array.h"
+#include "be.h"
+#include "dca.h"
+#include "debug.h"
+#include "ircons.h"
+#include "iredges_t.h"
+#include "irgmod.h"
+#include "irgopt.h"
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "iropt_t.h"
+#include "tv.h"
+#include "util.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+typedef struct narrow_env_t {
+	unsigned   min_bits; /**< the smallest width to narrow to */
+	ir_node  **nodes;    /**< the nodes which may be narrowed */
+	unsigned  *bits;     /**< width of each node by index, 0 if unchanged */
+	ir_node  **narrow;   /**< the narrowed node by index */
+} narrow_env_t;
+
+/**
+ * Returns the integer mode with the signedness of mode and the given width.
+ */
+static ir_mode *get_narrow_mode(ir_mode *mode, unsigned bits)
+{
+	bool is_signed = mode_is_signed(mode);
+	switch (bits) {
+	case 8:  return is_signed ? mode_Bs : mode_Bu;
+	case 16: return is_signed ? mode_Hs : mode_Hu;
+	case 32: return is_signed ? mode_Is : mode_Iu;
+	}
+	return mode;
+}
+
+/**
+ * Returns true if the low bits of the result of node only depend on the low
+ * bits of its operands, so it may be computed in a smaller mode.
+ */
+static bool is_narrowable(const ir_node *node)
+{
+	switch (get_irn_opcode(node)) {
+	case iro_Add:
+	case iro_And:
+	case iro_Eor:
+	case iro_Minus:
+	case iro_Mul:
+	case iro_Not:
+	case iro_Or:
+	case iro_Phi:
+	case iro_Sub:
+		return true;
+	case iro_Shl:
+		/* a variable shift amount may exceed the smaller width */
+		return is_Const(get_Shl_right(node));
+	case iro_Proj: {
+		ir_node *load = get_Proj_pred(node);
+		return is_Load(load) && get_Proj_proj(node) == pn_Load_res
+		    && get_Load_volatility(load) == volatility_non_volatile;
+	}
+	default:
+		return false;
+	}
+}
+
+/**
+ * Walker, collects the nodes whose cared for bits fit into a smaller mode.
+ * The care bits of dca_analyze() are in the links.
+ */
+static void collect_nodes(ir_node *node, void *data)
+{
+	narrow_env_t *env  = (narrow_env_t*)data;
+	ir_mode      *mode = get_irn_mode(node);
+	if (!mode_is_int(mode) || !is_narrowable(node))
+		return;
+
+	ir_tarval *care = (ir_tarval*)get_irn_link(node);
+	if (get_tarval_mode(care) != mode || tarval_is_null(care))
+		return;
+
+	unsigned size    = get_mode_size_bits(mode);
+	unsigned highest = (unsigned)get_tarval_highest_bit(care);
+	unsigned bits    = env->min_bits;
+	while (bits <= highest)
+		bits *= 2;
+	if (bits >= size)
+		return;
+	/* a constant shift beyond the smaller width differs */
+	if (is_Shl(node)
+	    && get_tarval_long(get_Const_tarval(get_Shl_right(node))) >= (long)bits)
+		return;
+
+	env->bits[get_irn_idx(node)] = bits;
+	ARR_APP1(ir_node*, env->nodes, node);
+}
+
+/**
+ * Returns the width node must keep for its user at position pos.
+ */
+static unsigned get_user_bits(const narrow_env_t *env, const ir_node *user,
+                              int pos, unsigned size)
+{
+	unsigned user_bits = env->bits[get_irn_idx(user)];
+	if (user_bits != 0 && !(is_Shl(user) && pos != n_Shl_left))
+		return user_bits;
+	if (is_Conv(user)) {
+		ir_mode *mode = get_irn_mode(user);
+		/* a truncation drops the bits anyway */
+		if (mode_is_int(mode) && get_mode_size_bits(mode) < size)
+			return get_mode_size_bits(mode);
+	}
+	return size;
+}
+
+/**
+ * Widens the nodes to the width their users need until a fixpoint is
+ * reached. Nodes whose users need all bits stay unchanged.
+ */
+static void compute_widths(narrow_env_t *env)
+{
+	bool changed;
+	do {
+		changed = false;
+		for (size_t i = 0, n = ARR_LEN(env->nodes); i < n; ++i) {
+			ir_node  *node = env->nodes[i];
+			unsigned *bits = &env->bits[get_irn_idx(node)];
+			if (*bits == 0)
+				continue;
+
+			unsigned size = get_mode_size_bits(get_irn_mode(node));
+			unsigned need = *bits;
+			foreach_out_edge(node, edge) {
+				ir_node *user = get_edge_src_irn(edge);
+				need = MAX(need, get_user_bits(env, user,
+				                               get_edge_src_pos(edge), size));
+			}
+			if (need != *bits) {
+				*bits   = need >= size ? 0 : need;
+				changed = true;
+			}
+		}
+	} while (changed);
+}
+
+/**
+ * Returns the operand op converted to mode, using the narrowed node if op
+ * is narrowed as well.
+ */
+static ir_node *get_narrow_operand(const narrow_env_t *env, ir_node *op,
+                                   ir_mode *mode)
+{
+	ir_node *narrow = env->narrow[get_irn_idx(op)];
+	if (narrow != NULL)
+		op = narrow;
+	if (get_irn_mode(op) == mode)
+		return op;
+
+	if (is_Const(op)) {
+		ir_tarval *tv = tarval_convert_to(get_Const_tarval(op), mode);
+		if (tv != tarval_bad)
+			return new_r_Const(get_irn_irg(op), tv);
+	}
+	return new_r_Conv(get_nodes_block(op), op, mode);
+}
+
+/**
+ * Narrows a Load to mode, reading the low bytes of the old value.
+ */
+static void narrow_load(ir_node *load, ir_mode *mode)
+{
+	ir_mode *old_mode = get_Load_mode(load);
+	if (be_get_backend_param()->byte_order_big_endian) {
+		ir_node *ptr      = get_Load_ptr(load);
+		ir_mode *ptr_mode = get_irn_mode(ptr);
+		ir_mode *off_mode = get_reference_mode_unsigned_eq(ptr_mode);
+		long     offset   = get_mode_size_bytes(old_mode)
+		                  - get_mode_size_bytes(mode);
+		ir_node *block    = get_nodes_block(load);
+		ir_node *cnst     = new_r_Const_long(get_irn_irg(load), off_mode,
+		                                     offset);
+		set_Load_ptr(load, new_r_Add(block, ptr, cnst, ptr_mode));
+	}
+	set_Load_mode(load, mode);
+}
+
+/**
+ * Creates the narrowed node of node, its operands are set afterwards. A Load
+ * is narrowed right away.
+ */
+static ir_node *create_narrow_node(ir_node *node, ir_mode *mode)
+{
+	ir_graph *irg   = get_irn_irg(node);
+	ir_node  *block = get_nodes_block(node);
+	if (is_Proj(node)) {
+		ir_node *load = get_Proj_pred(node);
+		narrow_load(load, mode);
+		return new_r_Proj(load, mode, pn_Load_res);
+	}
+
+	int       arity = get_irn_arity(node);
+	ir_node **ins   = ALLOCAN(ir_node*, arity);
+	if (is_Phi(node)) {
+		/* the operands are set later, a Phi checks their modes right away */
+		ir_node *dummy = new_r_Dummy(irg, mode);
+		for (int i = 0; i < arity; ++i)
+			ins[i] = dummy;
+		return new_r_Phi(block, arity, ins, mode);
+	}
+	for (int i = 0; i < arity; ++i)
+		ins[i] = get_irn_n(node, i);
+
+	ir_node *res = new_ir_node(get_irn_dbg_info(node), irg, block,
+	                           get_irn_op(node), mode, arity, ins);
+	copy_node_attr(irg, node, res);
+	return res;
+}
+
+void opt_narrow_modes(ir_graph *irg, unsigned min_bits)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.opt.narrow");
+	DB((dbg, LEVEL_1, "===> Narrowing modes in %+F\n", irg));
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+
+	unsigned     n_idx = get_irg_last_idx(irg);
+	narrow_env_t env;
+	env.min_bits = 8;
+	while (env.min_bits < min_bits)
+		env.min_bits *= 2;
+	env.nodes = NEW_ARR_F(ir_node*, 0);
+	env.bits  = NEW_ARR_FZ(unsigned, n_idx);
+
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
+	dca_analyze(irg);
+	irg_walk_graph(irg, NULL, collect_nodes, &env);
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
+
+	compute_widths(&env);
+
+	/* create the narrowed nodes first, their operands may form cycles */
+	env.narrow = NEW_ARR_FZ(ir_node*, n_idx);
+	ir_node **changed = NEW_ARR_F(ir_node*, 0);
+	for (size_t i = 0, n = ARR_LEN(env.nodes); i < n; ++i) {
+		ir_node *node = env.nodes[i];
+		unsigned bits = env.bits[get_irn_idx(node)];
+		if (bits == 0)
+			continue;
+		ir_mode *mode = get_narrow_mode(get_irn_mode(node), bits);
+		DB((dbg, LEVEL_2, "narrow %+F to %+F\n", node, mode));
+		env.narrow[get_irn_idx(node)] = create_narrow_node(node, mode);
+		ARR_APP1(ir_node*, changed, node);
+	}
+
+	for (size_t i = 0, n = ARR_LEN(changed); i < n; ++i) {
+		ir_node *node   = changed[i];
+		ir_node *narrow = env.narrow[get_irn_idx(node)];
+		ir_mode *mode   = get_irn_mode(narrow);
+		if (is_Proj(node))
+			continue;
+		int arity = is_Shl(node) ? n_Shl_left + 1 : get_irn_arity(node);
+		for (int p = 0; p < arity; ++p) {
+			ir_node *op = get_irn_n(node, p);
+			set_irn_n(narrow, p, get_narrow_operand(&env, op, mode));
+		}
+	}
+
+	/* the remaining users truncate the results, so the Convs fold away */
+	ir_node **users = NEW_ARR_F(ir_node*, 0);
+	for (size_t i = 0, n = ARR_LEN(changed); i < n; ++i) {
+		ir_node *node   = changed[i];
+		ir_node *narrow = env.narrow[get_irn_idx(node)];
+		ir_node *conv   = new_r_Conv(get_nodes_block(narrow), narrow,
+		                             get_irn_mode(node));
+		exchange(node, conv);
+		foreach_out_edge(conv, edge) {
+			ARR_APP1(ir_node*, users, get_edge_src_irn(edge));
+		}
+	}
+
+	if (ARR_LEN(users) > 0)
+		local_optimize_nodes(irg, users, ARR_LEN(users));
+
+	confirm_irg_properties(irg, ARR_LEN(changed) > 0
+		? IR_GRAPH_PROPERTIES_NONE : IR_GRAPH_PROPERTIES_ALL);
+
+	DEL_ARR_F(users);
+	DEL_ARR_F(changed);
+	DEL_ARR_F(env.narrow);
+	DEL_ARR_F(env.bits);
+	DEL_ARR_F(env.nodes);
+}
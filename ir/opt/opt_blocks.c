@@ -76,6 +76,7 @@ struct block_t {
 	phi_t      *phis;        /**< The list of Phis in this block. */
 	block_t    *all_next;    /**< Links all created blocks. */
 	int        meet_input;   /**< Input number of this block in the meet-block. */
+	unsigned   signature;    /**< Hash of the normalized block contents. */
 };
 
 /** A node. */
@@ -92,6 +93,9 @@ struct environment_t {
 	set             *opcode2id_map; /**< The opcodeMode->id map. */
 	ir_node         **live_outs;    /**< Live out only nodes. */
 	block_t         *all_blocks;    /**< List of all created blocks. */
+	node_t          *sig_queue;     /**< Wait-queue for computing signatures. */
+	unsigned        *sig_marks;     /**< Visited marks for computing signatures. */
+	unsigned        sig_epoch;      /**< Current visited mark. */
 	struct obstack  obst;           /** obstack for temporary data */
 };
 
@@ -587,6 +591,100 @@ static void propagate_blocks(partition_t *part, environment_t *env)
 	listmap_term(&map);
 }
 
+/**
+ * Computes the signature of a block: a hash over the opcodes of its nodes in
+ * the order propagate_blocks() visits them. Blocks with different signatures
+ * are never congruent.
+ *
+ * @param bl   the block
+ * @param env  the environment
+ */
+static unsigned block_signature(const block_t *bl, environment_t *env)
+{
+	node_t   *queue = env->sig_queue;
+	unsigned epoch  = ++env->sig_epoch;
+	unsigned hash   = 0;
+	size_t   i;
+
+	ARR_SHRINKLEN(queue, 0);
+	list_for_each_entry(node_t, node, &bl->nodes, node_list) {
+		env->sig_marks[get_irn_idx(node->node)] = epoch;
+		ARR_APP1(node_t, queue, *node);
+	}
+
+	for (i = 0; i < ARR_LEN(queue); ++i) {
+		node_t node = queue[i];
+
+		if (! node.is_input) {
+			ir_node *irn = node.node;
+			int     j;
+
+			ir_normalize_node(irn);
+			for (j = get_irn_arity(irn) - 1; j >= 0; --j) {
+				ir_node *pred  = get_irn_n(irn, j);
+				ir_node *block = get_nodes_block(skip_Proj(pred));
+				node_t  p_node;
+
+				p_node.node     = pred;
+				p_node.is_input = 0;
+				if (block != bl->block) {
+					p_node.is_input = is_input_node(pred, irn, j);
+				} else if (env->sig_marks[get_irn_idx(pred)] != epoch) {
+					env->sig_marks[get_irn_idx(pred)] = epoch;
+				} else {
+					continue;
+				}
+				ARR_APP1(node_t, queue, p_node);
+			}
+		}
+		hash = hash_combine(hash, hash_ptr(opcode(&node, env)));
+	}
+	env->sig_queue = queue;
+	return hash_combine(hash, (unsigned)ARR_LEN(queue));
+}
+
+/**
+ * Split all partitions by the signatures of their blocks, so only blocks
+ * with colliding signatures have to be refined node by node.
+ *
+ * @param env    the environment
+ */
+static void split_by_signatures(environment_t *env)
+{
+	block_t *bl;
+
+	for (bl = env->all_blocks; bl != NULL; bl = bl->all_next) {
+		bl->signature = block_signature(bl, env);
+	}
+
+	list_for_each_entry_safe(partition_t, part, next, &env->partitions, part_list) {
+		listmap_t       map;
+		listmap_entry_t *iter;
+
+		if (part->n_blocks < 2)
+			continue;
+
+		/* Let map be an empty mapping from signatures to (local) list of blocks. */
+		listmap_init(&map);
+		list_for_each_entry(block_t, bl, &part->blocks, block_list) {
+			listmap_entry_t *entry = listmap_find(&map, INT_TO_PTR(bl->signature));
+
+			bl->next    = entry->list;
+			entry->list = bl;
+		}
+
+		/* for all sets S except one in the range of map do */
+		for (iter = map.values; iter != NULL; iter = iter->next) {
+			if (iter->next == NULL) {
+				/* this is the last entry, ignore */
+				break;
+			}
+			split(part, iter->list, env);
+		}
+		listmap_term(&map);
+	}
+}
+
 /**
  * Propagate nodes on all wait queues.
  *
@@ -1185,6 +1283,9 @@ void shape_blocks(ir_graph *irg)
 	env.live_outs = NEW_ARR_FZ(ir_node*, n);
 
 	env.all_blocks = NULL;
+	env.sig_queue  = NEW_ARR_F(node_t, 0);
+	env.sig_marks  = NEW_ARR_FZ(unsigned, n);
+	env.sig_epoch  = 0;
 
 	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK | IR_RESOURCE_PHI_LIST);
 
@@ -1212,6 +1313,7 @@ void shape_blocks(ir_graph *irg)
 #endif
 
 	propagate_live_troughs(&env);
+	split_by_signatures(&env);
 	while (! list_empty(&env.partitions))
 		propagate(&env);
 
@@ -1231,10 +1333,14 @@ void shape_blocks(ir_graph *irg)
 	}
 
 	for (bl = env.all_blocks; bl != NULL; bl = bl->all_next) {
-		DEL_ARR_F(bl->roots);
+		/* already freed by add_roots() */
+		if (bl->roots != NULL)
+			DEL_ARR_F(bl->roots);
 	}
 
 	DEL_ARR_F(env.live_outs);
+	DEL_ARR_F(env.sig_marks);
+	DEL_ARR_F(env.sig_queue);
 	del_set(env.opcode2id_map);
 	obstack_free(&env.obst, NULL);
 }
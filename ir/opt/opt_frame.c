@@ -9,14 +9,31 @@
  * @date    15.03.2006
  * @author  Michael Beck
  * @brief
- *   Optimize the frame type by removing unused type members.
+ *   Optimize the frame type by removing unused type members and by
+ *   sharing the slots of local entities with disjoint lifetimes.
  */
 #include "iroptimize.h"
+#include "opt_frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "array.h"
+#include "debug.h"
+#include "irdom.h"
 #include "irgraph_t.h"
+#include "irmemory.h"
+#include "irnode_t.h"
+#include "obst.h"
+#include "pmap.h"
+#include "raw_bitset.h"
 #include "type_t.h"
+#include "util.h"
 #include "irouts.h"
 #include "iredges.h"
 
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
 /*
  * Optimize the frame type of an irg by removing
  * never touched entities.
@@ -90,3 +107,310 @@ void opt_frame_irg(ir_graph *irg)
 		| IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE
 		| IR_GRAPH_PROPERTY_MANY_RETURNS);
 }
+
+/** A frame entity which may share its slot with other entities. */
+typedef struct slot_candidate_t {
+	ir_entity *entity;
+	ir_node  **blocks;   /**< blocks of the memory accesses */
+	unsigned  *live;     /**< blocks the entity lives in */
+	size_t     slot;     /**< index of the assigned slot */
+	bool       escapes;  /**< the address is used by other nodes */
+} slot_candidate_t;
+
+/** A stack slot shared by entities with disjoint lifetimes. */
+typedef struct frame_slot_t {
+	unsigned *live;    /**< union of the lifetimes of the members */
+	unsigned  size;
+	unsigned  align;
+	int       offset;  /**< the offset, -1 while not placed */
+} frame_slot_t;
+
+typedef struct share_env_t {
+	struct obstack obst;
+	pmap          *candidates; /**< maps entities to their slot_candidate_t */
+	unsigned       n_idx;      /**< size of the block bitsets */
+} share_env_t;
+
+/**
+ * Records the blocks of the memory operations accessing candidate through
+ * the address node.
+ */
+static void collect_accesses(slot_candidate_t *candidate, ir_node *node)
+{
+	for (int i = get_irn_n_outs(node); i-- > 0; ) {
+		ir_node *succ = get_irn_out(node, i);
+		switch (get_irn_opcode(succ)) {
+		case iro_Load:
+			ARR_APP1(ir_node*, candidate->blocks, get_nodes_block(succ));
+			break;
+		case iro_Store:
+			if (get_Store_value(succ) == node)
+				candidate->escapes = true;
+			else
+				ARR_APP1(ir_node*, candidate->blocks, get_nodes_block(succ));
+			break;
+		case iro_CopyB:
+			ARR_APP1(ir_node*, candidate->blocks, get_nodes_block(succ));
+			break;
+		case iro_Add:
+		case iro_Sub:
+		case iro_Sel:
+		case iro_Id:
+			collect_accesses(candidate, succ);
+			break;
+		default:
+			candidate->escapes = true;
+			break;
+		}
+	}
+}
+
+/**
+ * Returns true if entity may share its slot: a local variable whose address
+ * is only used for loads and stores.
+ */
+static bool is_slot_candidate(const ir_entity *entity)
+{
+	return !is_method_entity(entity) && !is_parameter_entity(entity)
+	    && get_entity_bitfield_size(entity) == 0
+	    && (get_entity_usage(entity) & ir_usage_address_taken) == 0;
+}
+
+/**
+ * Marks all blocks reachable from the blocks on the todo list in the direction
+ * given by forward in reached.
+ */
+static void mark_reachable(unsigned *reached, ir_node ***todo, bool forward)
+{
+	while (ARR_LEN(*todo) > 0) {
+		ir_node *block = (*todo)[ARR_LEN(*todo) - 1];
+		ARR_SHRINKLEN(*todo, ARR_LEN(*todo) - 1);
+
+		int n = forward ? (int)get_Block_n_cfg_outs(block)
+		                : get_Block_n_cfgpreds(block);
+		for (int i = 0; i < n; ++i) {
+			ir_node *next = forward ? get_Block_cfg_out(block, i)
+			                        : get_Block_cfgpred_block(block, i);
+			if (is_Bad(next) || rbitset_is_set(reached, get_irn_idx(next)))
+				continue;
+			rbitset_set(reached, get_irn_idx(next));
+			ARR_APP1(ir_node*, *todo, next);
+		}
+	}
+}
+
+/**
+ * Computes the lifetime of a candidate: the blocks on paths from one access
+ * to another one. The accesses are first moved up to their control
+ * equivalent dominators, the scheduler may hoist memory operations there.
+ */
+static void compute_lifetime(share_env_t *env, slot_candidate_t *candidate)
+{
+	size_t    n_blocks = ARR_LEN(candidate->blocks);
+	unsigned *forward  = rbitset_obstack_alloc(&env->obst, env->n_idx);
+	unsigned *backward = rbitset_malloc(env->n_idx);
+	ir_node **todo     = NEW_ARR_F(ir_node*, 0);
+
+	for (size_t i = 0; i < n_blocks; ++i) {
+		ir_node *block = candidate->blocks[i];
+		for (ir_node *dom = block; dom != NULL; dom = get_Block_idom(dom)) {
+			if (dom != block && !block_postdominates(block, dom))
+				break;
+			rbitset_set(forward, get_irn_idx(dom));
+			rbitset_set(backward, get_irn_idx(dom));
+			ARR_APP1(ir_node*, todo, dom);
+		}
+	}
+	/* the todo list of both walks starts with all accesses */
+	size_t    n_todo = ARR_LEN(todo);
+	ir_node **start  = NEW_ARR_F(ir_node*, n_todo);
+	memcpy(start, todo, n_todo * sizeof(*start));
+
+	mark_reachable(forward, &todo, true);
+	mark_reachable(backward, &start, false);
+	rbitset_and(forward, backward, env->n_idx);
+	candidate->live = forward;
+
+	DEL_ARR_F(start);
+	DEL_ARR_F(todo);
+	free(backward);
+}
+
+static int cmp_candidate_size(const void *a, const void *b)
+{
+	const slot_candidate_t *ca = *(const slot_candidate_t**)a;
+	const slot_candidate_t *cb = *(const slot_candidate_t**)b;
+	unsigned size_a = get_type_size_bytes(get_entity_type(ca->entity));
+	unsigned size_b = get_type_size_bytes(get_entity_type(cb->entity));
+	if (size_a != size_b)
+		return QSORT_CMP(size_b, size_a);
+	return QSORT_CMP(get_entity_nr(ca->entity), get_entity_nr(cb->entity));
+}
+
+/**
+ * Collects the candidates of the frame type and the blocks they are
+ * accessed in. Returns the number of candidates.
+ */
+static size_t collect_candidates(share_env_t *env, ir_graph *irg)
+{
+	ir_type *frame_tp = get_irg_frame_type(irg);
+	ir_node *frame    = get_irg_frame(irg);
+	for (int i = get_irn_n_outs(frame); i-- > 0; ) {
+		ir_node *sel = get_irn_out(frame, i);
+		if (!is_Sel(sel))
+			continue;
+		ir_entity *entity = get_Sel_entity(sel);
+		if (get_entity_owner(entity) != frame_tp || !is_slot_candidate(entity))
+			continue;
+
+		slot_candidate_t *candidate
+			= pmap_get(slot_candidate_t, env->candidates, entity);
+		if (candidate == NULL) {
+			candidate = OALLOCZ(&env->obst, slot_candidate_t);
+			candidate->entity = entity;
+			candidate->blocks = NEW_ARR_F(ir_node*, 0);
+			pmap_insert(env->candidates, entity, candidate);
+		}
+		collect_accesses(candidate, sel);
+	}
+
+	size_t      n = 0;
+	pmap_entry *entry;
+	foreach_pmap(env->candidates, entry) {
+		slot_candidate_t *candidate = (slot_candidate_t*)entry->value;
+		if (!candidate->escapes && ARR_LEN(candidate->blocks) > 0) {
+			compute_lifetime(env, candidate);
+			++n;
+		}
+	}
+	return n;
+}
+
+/**
+ * Assigns the shareable candidates to slots, largest first, each one to the
+ * first slot whose lifetime it does not overlap. Returns true if any slot is
+ * shared.
+ */
+static bool assign_slots(share_env_t *env, frame_slot_t **slots)
+{
+	slot_candidate_t **order = NEW_ARR_F(slot_candidate_t*, 0);
+	pmap_entry        *entry;
+	foreach_pmap(env->candidates, entry) {
+		slot_candidate_t *candidate = (slot_candidate_t*)entry->value;
+		if (candidate->live != NULL)
+			ARR_APP1(slot_candidate_t*, order, candidate);
+	}
+	qsort(order, ARR_LEN(order), sizeof(*order), cmp_candidate_size);
+
+	bool shared = false;
+	for (size_t i = 0, n = ARR_LEN(order); i < n; ++i) {
+		slot_candidate_t *candidate = order[i];
+		ir_type          *type      = get_entity_type(candidate->entity);
+		size_t            n_slots   = ARR_LEN(*slots);
+		size_t            s;
+		for (s = 0; s < n_slots; ++s) {
+			if (!rbitsets_have_common((*slots)[s].live, candidate->live,
+			                          env->n_idx))
+				break;
+		}
+		if (s < n_slots) {
+			shared = true;
+		} else {
+			frame_slot_t slot;
+			slot.live   = rbitset_obstack_alloc(&env->obst, env->n_idx);
+			slot.size   = 0;
+			slot.align  = 1;
+			slot.offset = -1;
+			ARR_APP1(frame_slot_t, *slots, slot);
+		}
+		frame_slot_t *slot = &(*slots)[s];
+		rbitset_or(slot->live, candidate->live, env->n_idx);
+		slot->size  = MAX(slot->size, get_type_size_bytes(type));
+		slot->align = MAX(slot->align, get_type_alignment_bytes(type));
+		candidate->slot = s;
+		DB((dbg, LEVEL_2, "%+F gets slot %zu\n", candidate->entity, s));
+	}
+	DEL_ARR_F(order);
+	return shared;
+}
+
+void opt_frame_share_slots(ir_graph *irg)
+{
+	ir_type *frame_tp = get_irg_frame_type(irg);
+	FIRM_DBG_REGISTER(dbg, "firm.opt.frame");
+
+	/* inner functions may access the frame in unknown ways */
+	size_t n = get_class_n_members(frame_tp);
+	for (size_t i = 0; i < n; ++i) {
+		if (is_method_entity(get_class_member(frame_tp, i))) {
+			default_layout_compound_type(frame_tp);
+			return;
+		}
+	}
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS
+		| IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		| IR_GRAPH_PROPERTY_CONSISTENT_POSTDOMINANCE);
+	assure_irg_entity_usage_computed(irg);
+
+	share_env_t env;
+	obstack_init(&env.obst);
+	env.candidates = pmap_create();
+	env.n_idx      = get_irg_last_idx(irg);
+
+	frame_slot_t *slots  = NEW_ARR_F(frame_slot_t, 0);
+	bool          shared = collect_candidates(&env, irg) > 1
+	                    && assign_slots(&env, &slots);
+	if (!shared) {
+		default_layout_compound_type(frame_tp);
+	} else {
+		/* like default_layout_compound_type() but the members of a slot
+		 * share its offset */
+		int      size      = 0;
+		unsigned align_all = 1;
+		for (size_t i = 0; i < n; ++i) {
+			ir_entity        *entity    = get_class_member(frame_tp, i);
+			ir_type          *type      = get_entity_type(entity);
+			slot_candidate_t *candidate
+				= pmap_get(slot_candidate_t, env.candidates, entity);
+			frame_slot_t     *slot      = NULL;
+			unsigned          ent_size  = get_type_size_bytes(type);
+			unsigned          align     = get_type_alignment_bytes(type);
+			if (candidate != NULL && candidate->live != NULL) {
+				slot = &slots[candidate->slot];
+				if (slot->offset >= 0) {
+					set_entity_offset(entity, slot->offset);
+					continue;
+				}
+				ent_size = slot->size;
+				align    = slot->align;
+			}
+
+			assert(get_type_state(type) == layout_fixed);
+			unsigned misalign = align ? size % align : 0;
+			size     += misalign ? align - misalign : 0;
+			align_all = MAX(align, align_all);
+			set_entity_offset(entity, size);
+			if (slot != NULL)
+				slot->offset = size;
+			size += ent_size;
+		}
+		if (size % align_all)
+			size += align_all - size % align_all;
+		if (align_all > get_type_alignment_bytes(frame_tp))
+			set_type_alignment_bytes(frame_tp, align_all);
+		set_type_size_bytes(frame_tp, size);
+		set_type_state(frame_tp, layout_fixed);
+		DB((dbg, LEVEL_1, "%+F: frame of %d bytes with shared slots\n", irg,
+		    size));
+	}
+
+	pmap_entry *entry;
+	foreach_pmap(env.candidates, entry) {
+		slot_candidate_t *candidate = (slot_candidate_t*)entry->value;
+		DEL_ARR_F(candidate->blocks);
+	}
+	DEL_ARR_F(slots);
+	pmap_destroy(env.candidates);
+	obstack_free(&env.obst, NULL);
+}
@@ -0,0 +1,28 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Layout of the frame type with shared stack slots.
+ */
+#ifndef FIRM_OPT_OPT_FRAME_H
+#define FIRM_OPT_OPT_FRAME_H
+
+#include "firm_types.h"
+
+/**
+ * Lays out the frame type of @p irg like default_layout_compound_type() but
+ * lets local entities share their offset if their lifetimes are disjoint.
+ * Only entities whose address is used by loads and stores alone take part,
+ * their lifetimes are the blocks on paths between their accesses.
+ *
+ * Must run while the frame entities are still accessed by Sel nodes, i.e.
+ * right before the backend fixes the frame layout.
+ *
+ * @param irg  the graph
+ */
+void opt_frame_share_slots(ir_graph *irg);
+
+#endif /* FIRM_OPT_OPT_FRAME_H */
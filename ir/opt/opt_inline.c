@@ -9,6 +9,7 @@
  * @author   Michael Beck, Goetz Lindenmaier
  */
 #include <limits.h>
+#include <math.h>
 #include <stdbool.h>
 #include <assert.h>
 
@@ -44,6 +45,8 @@
 #include "irtools.h"
 #include "iropt_dbg.h"
 #include "irnodemap.h"
+#include "irprofile.h"
+#include "execfreq.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
@@ -659,6 +662,13 @@ static int inline_method(ir_node *const call, ir_graph *called_graph)
 
 static struct obstack  temp_obst;
 
+/** the inline_profile_flags of the current run */
+static unsigned profile_flags;
+/** call sites executed less often than this are cold */
+static double   cold_freq;
+/** nodes which may still be added by inlining, UINT_MAX if unlimited */
+static unsigned budget_left;
+
 /** Represents a possible inlinable call in a graph. */
 typedef struct call_entry {
 	ir_node    *call;       /**< The Call node. */
@@ -666,8 +676,11 @@ typedef struct call_entry {
 	list_head  list;        /**< List head for linking the next one. */
 	int        loop_depth;  /**< The loop depth of this call. */
 	int        benefice;    /**< The calculated benefice of this call. */
+	double     freq;        /**< Execution frequency of the call relative to
+	                             its graph. */
 	unsigned   local_adr:1; /**< Set if this call gets an address of a local variable. */
 	unsigned   all_const:1; /**< Set if this call has only constant parameters. */
+	unsigned   admitted:1;  /**< Set if the call got a share of the budget. */
 } call_entry;
 
 /**
@@ -780,8 +793,10 @@ static void collect_calls2(ir_node *call, void *ctx)
 		entry->callee     = callee;
 		entry->loop_depth = get_irn_loop(get_nodes_block(call))->depth;
 		entry->benefice   = 0;
+		entry->freq       = get_block_execfreq(get_nodes_block(call));
 		entry->local_adr  = 0;
 		entry->all_const  = 0;
+		entry->admitted   = 0;
 
 		list_add_tail(&entry->list, &x->calls);
 	}
@@ -794,17 +809,22 @@ static void collect_calls2(ir_node *call, void *ctx)
  * @param new_call  the new call node
  * @param loop_depth_delta
  *                  delta value for the loop depth
+ * @param freq_factor
+ *                  execution frequency of the inlined call
  */
 static call_entry *duplicate_call_entry(const call_entry *entry,
-                                        ir_node *new_call, int loop_depth_delta)
+                                        ir_node *new_call, int loop_depth_delta,
+                                        double freq_factor)
 {
 	call_entry *nentry = OALLOC(&temp_obst, call_entry);
 	nentry->call       = new_call;
 	nentry->callee     = entry->callee;
 	nentry->benefice   = entry->benefice;
 	nentry->loop_depth = entry->loop_depth + loop_depth_delta;
+	nentry->freq       = entry->freq * freq_factor;
 	nentry->local_adr  = entry->local_adr;
 	nentry->all_const  = entry->all_const;
+	nentry->admitted   = 0;
 
 	return nentry;
 }
@@ -921,6 +941,34 @@ static unsigned get_method_local_adress_weight(ir_graph *callee, size_t pos)
 	return 0;
 }
 
+/**
+ * Returns how often the call is executed: its frequency scaled by the number
+ * of calls of the graph if an execution count profile is loaded.
+ */
+static double get_call_hotness(const call_entry *entry)
+{
+	ir_node *start = get_irg_start_block(current_ir_graph);
+	if (ir_profile_has_block_execcount(start))
+		return entry->freq * ir_profile_get_block_execcount(start);
+	return entry->freq;
+}
+
+/**
+ * Checks whether inlining the call would only bloat cold code. Inlining the
+ * only call of a local function never grows the program.
+ */
+static bool is_cold_call(const call_entry *entry)
+{
+	if (!(profile_flags & inline_profile_cold))
+		return false;
+	ir_graph       *callee     = entry->callee;
+	inline_irg_env *callee_env = (inline_irg_env*)get_irg_link(callee);
+	if (callee_env->n_callers == 1 && callee != current_ir_graph
+	    && !entity_is_externally_visible(get_irg_entity(callee)))
+		return false;
+	return get_call_hotness(entry) < cold_freq;
+}
+
 /**
  * Calculate a benefice value for inlining the given call.
  *
@@ -1017,11 +1065,22 @@ static int calc_inline_benefice(call_entry *entry, ir_graph *callee)
 	if (callee_env->n_call_nodes == 0)
 		weight += 400;
 
-	/** it's important to inline inner loops first */
-	if (entry->loop_depth > 30)
+	if (profile_flags & inline_profile_hot) {
+		/* inline hot calls first, the loop depth is a static estimate of
+		 * log10 of the frequency */
+		double hotness = get_call_hotness(entry);
+		double bonus   = hotness > 0 ? log10(hotness) : -30;
+		if (bonus > 30)
+			bonus = 30;
+		else if (bonus < -30)
+			bonus = -30;
+		weight += (int)(bonus * 1024);
+	} else if (entry->loop_depth > 30) {
+		/* it's important to inline inner loops first */
 		weight += 30 * 1024;
-	else
+	} else {
 		weight += entry->loop_depth * 1024;
+	}
 
 	/*
 	 * All arguments constant is probably a good sign, give an extra bonus
@@ -1092,13 +1151,63 @@ static void maybe_push_call(pqueue_t *pqueue, call_entry *call,
 
 	ir_entity                *ent   = get_irg_entity(callee);
 	mtp_additional_properties props = get_entity_additional_properties(ent);
-	if (!(props & mtp_property_always_inline) && benefice < inline_threshold) {
-		return;
+	if (!(props & mtp_property_always_inline)) {
+		if (benefice < inline_threshold)
+			return;
+		if (is_cold_call(call)) {
+			DB((dbg, LEVEL_2, "In %+F Call %+F to %+F is cold\n",
+			    get_irn_irg(call->call), call->call, callee));
+			return;
+		}
 	}
 
 	pqueue_put(pqueue, call, benefice);
 }
 
+/**
+ * Hands out the global budget to the call sites of all graphs, the most
+ * beneficial ones first.
+ */
+static void distribute_budget(ir_graph **irgs, size_t n_irgs,
+                              int inline_threshold)
+{
+	pqueue_t *pqueue = new_pqueue();
+	for (size_t i = 0; i < n_irgs; ++i) {
+		ir_graph       *irg = irgs[i];
+		inline_irg_env *env = (inline_irg_env*)get_irg_link(irg);
+		current_ir_graph = irg;
+		list_for_each_entry(call_entry, entry, &env->calls, list) {
+			int benefice = calc_inline_benefice(entry, entry->callee);
+			if (benefice >= inline_threshold && !is_cold_call(entry))
+				pqueue_put(pqueue, entry, benefice);
+		}
+	}
+
+	while (!pqueue_empty(pqueue)) {
+		call_entry     *entry      = (call_entry*)pqueue_pop_front(pqueue);
+		inline_irg_env *callee_env = (inline_irg_env*)get_irg_link(entry->callee);
+		if (callee_env->n_nodes > budget_left)
+			continue;
+		budget_left    -= callee_env->n_nodes;
+		entry->admitted = 1;
+	}
+	del_pqueue(pqueue);
+}
+
+/**
+ * Checks whether inlining the call fits into the global budget and takes its
+ * share.
+ */
+static bool take_budget(call_entry *entry, unsigned n_nodes)
+{
+	if (entry->admitted || budget_left == UINT_MAX)
+		return true;
+	if (n_nodes > budget_left)
+		return false;
+	budget_left -= n_nodes;
+	return true;
+}
+
 /**
  * Try to inline calls into a graph.
  *
@@ -1156,6 +1265,12 @@ static void inline_into(ir_graph *irg, unsigned maxsize,
 						env->n_nodes, callee, callee_env->n_nodes));
 			continue;
 		}
+		if (!(props & mtp_property_always_inline)
+		    && !take_budget(curr_call, callee_env->n_nodes)) {
+			DB((dbg, LEVEL_2, "%+F: budget exhausted for %+F (%d)\n", irg,
+			    callee, callee_env->n_nodes));
+			continue;
+		}
 
 		calleee = pmap_get(ir_graph, copied_graphs, callee);
 		if (calleee != NULL) {
@@ -1274,7 +1389,8 @@ static void inline_into(ir_graph *irg, unsigned maxsize,
 			}
 			assert(is_Call(new_call));
 
-			new_entry = duplicate_call_entry(centry, new_call, loop_depth);
+			new_entry = duplicate_call_entry(centry, new_call, loop_depth,
+			                                 curr_call->freq);
 			list_add_tail(&new_entry->list, &env->calls);
 			maybe_push_call(pqueue, new_entry, inline_threshold);
 		}
@@ -1287,12 +1403,9 @@ static void inline_into(ir_graph *irg, unsigned maxsize,
 	del_pqueue(pqueue);
 }
 
-/*
- * Heuristic inliner. Calculates a benefice value for every call and inlines
- * those calls with a value higher than the threshold.
- */
-void inline_functions(unsigned maxsize, int inline_threshold,
-                      opt_ptr after_inline_opt)
+void inline_functions_profiled(unsigned maxsize, int inline_threshold,
+                               unsigned flags, unsigned budget,
+                               double cold_threshold, opt_ptr after_inline_opt)
 {
 	inline_irg_env   *env;
 	size_t           i, n_irgs;
@@ -1304,6 +1417,9 @@ void inline_functions(unsigned maxsize, int inline_threshold,
 
 	rem = current_ir_graph;
 	obstack_init(&temp_obst);
+	profile_flags = flags;
+	cold_freq     = cold_threshold;
+	budget_left   = budget != 0 ? budget : UINT_MAX;
 
 	irgs = create_irg_list();
 
@@ -1321,12 +1437,18 @@ void inline_functions(unsigned maxsize, int inline_threshold,
 		ir_graph *irg = irgs[i];
 
 		free_callee_info(irg);
+		/* computing the execution frequencies leaves the out edges active,
+		 * copying from a graph with active edges is not supported */
+		edges_deactivate(irg);
 
 		wenv.x = (inline_irg_env*)get_irg_link(irg);
 		assure_loopinfo(irg);
 		irg_walk_graph(irg, NULL, collect_calls2, &wenv);
 	}
 
+	if (budget != 0)
+		distribute_budget(irgs, n_irgs, inline_threshold);
+
 	/* -- and now inline. -- */
 	for (i = 0; i < n_irgs; ++i) {
 		ir_graph *irg = irgs[i];
@@ -1366,6 +1488,17 @@ void inline_functions(unsigned maxsize, int inline_threshold,
 	current_ir_graph = rem;
 }
 
+/*
+ * Heuristic inliner. Calculates a benefice value for every call and inlines
+ * those calls with a value higher than the threshold.
+ */
+void inline_functions(unsigned maxsize, int inline_threshold,
+                      opt_ptr after_inline_opt)
+{
+	inline_functions_profiled(maxsize, inline_threshold, inline_profile_none,
+	                          0, 0.0, after_inline_opt);
+}
+
 void firm_init_inline(void)
 {
 	FIRM_DBG_REGISTER(dbg, "firm.opt.inline");
@@ -1828,6 +1828,7 @@ void opt_ldst(ir_graph *irg)
 	if (get_opt_alias_analysis()) {
 		assure_irp_globals_entity_usage_computed();
 	}
+	assure_irg_alias_cache(irg);
 
 	obstack_init(&env.obst);
 	ir_nodehashmap_init(&env.adr_map);
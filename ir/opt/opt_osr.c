@@ -34,6 +34,7 @@
 #include "array.h"
 #include "firmstat_t.h"
 #include "error.h"
+#include "statev_t.h"
 
 /** The debug handle. */
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
@@ -1412,6 +1413,9 @@ void opt_osr(ir_graph *irg, unsigned flags)
 	}
 	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
 
+	stat_ev_int("osr_replaced", env.replaced);
+	stat_ev_int("osr_lftr_replaced", env.lftr_replaced);
+
 	del_set(env.lftr_edges);
 	del_set(env.quad_map);
 	DEL_ARR_F(env.stack);
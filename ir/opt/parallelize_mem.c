@@ -19,55 +19,84 @@
 #include "irgwalk.h"
 #include "irmemory.h"
 #include "irnode.h"
-#include "irnodeset.h"
+#include "irnodesparseset.h"
 #include "obst.h"
 #include "irdump.h"
 #include "irflag_t.h"
 #include "iredges.h"
+#include "memssa.h"
+
+/**
+ * The maximum number of memory operations a Load or Store is moved across
+ * plus the number of Sync inputs visited on the way. Keeps the pass linear
+ * on long memory chains and the created Syncs small.
+ */
+#define MAX_PARALLEL_OPS 64
 
 typedef struct parallelize_info
 {
-	ir_node      *origin_block;
-	ir_node      *origin_ptr;
-	ir_mode      *origin_mode;
-	ir_nodeset_t  this_mem;
-	ir_nodeset_t  user_mem;
-	ir_nodeset_t  all_visited;
+	ir_memssa_t       *ssa;
+	ir_node           *origin_block;
+	ir_node           *origin_ptr;
+	ir_mode           *origin_mode;
+	unsigned           origin_part;
+	unsigned           budget;
+	ir_nodesparseset_t this_mem;
+	ir_nodesparseset_t user_mem;
+	ir_nodesparseset_t all_visited;
 } parallelize_info;
 
+/**
+ * Checks whether the memory operation op accessing ptr in mode cannot
+ * access the memory of the origin. Operations on different memory partitions
+ * never alias.
+ */
+static bool is_independent(parallelize_info *pi, ir_node *op, ir_node *ptr,
+                           ir_mode *mode)
+{
+	if (pi->budget == 0)
+		return false;
+	if (memssa_get_partition(pi->ssa, op) == pi->origin_part
+	    && get_alias_relation(pi->origin_ptr, pi->origin_mode, ptr, mode)
+	       != ir_no_alias)
+		return false;
+	--pi->budget;
+	return true;
+}
+
 static void parallelize_load(parallelize_info *pi, ir_node *irn)
 {
 	/* There is no point in investigating the same subgraph twice */
-	if (ir_nodeset_contains(&pi->all_visited, irn))
+	if (!ir_nodesparseset_insert(&pi->all_visited, irn))
 		return;
 
-	ir_nodeset_insert(&pi->all_visited, irn);
-
 	if (get_nodes_block(irn) == pi->origin_block) {
 		if (is_Proj(irn)) {
 			ir_node *pred = get_Proj_pred(irn);
 			if (is_Load(pred) &&
-					get_Load_volatility(pred) == volatility_non_volatile) {
+					get_Load_volatility(pred) == volatility_non_volatile &&
+					pi->budget > 0) {
 				ir_node *mem = get_Load_mem(pred);
-				ir_nodeset_insert(&pi->user_mem, irn);
+				--pi->budget;
+				ir_nodesparseset_insert(&pi->user_mem, irn);
 				parallelize_load(pi, mem);
 				return;
 			} else if (is_Store(pred) &&
 					get_Store_volatility(pred) == volatility_non_volatile) {
-				ir_mode *org_mode   = pi->origin_mode;
-				ir_node *org_ptr    = pi->origin_ptr;
 				ir_mode *store_mode = get_irn_mode(get_Store_value(pred));
 				ir_node *store_ptr  = get_Store_ptr(pred);
-				if (get_alias_relation(org_ptr, org_mode, store_ptr, store_mode) == ir_no_alias) {
+				if (is_independent(pi, pred, store_ptr, store_mode)) {
 					ir_node *mem = get_Store_mem(pred);
-					ir_nodeset_insert(&pi->user_mem, irn);
+					ir_nodesparseset_insert(&pi->user_mem, irn);
 					parallelize_load(pi, mem);
 					return;
 				}
 			}
-		} else if (is_Sync(irn)) {
+		} else if (is_Sync(irn)
+		           && (unsigned)get_Sync_n_preds(irn) <= pi->budget) {
 			int n = get_Sync_n_preds(irn);
 
+			pi->budget -= n;
 			for (int i = 0; i < n; ++i) {
 				ir_node *sync_pred = get_Sync_pred(irn, i);
 				parallelize_load(pi, sync_pred);
@@ -75,50 +104,46 @@ static void parallelize_load(parallelize_info *pi, ir_node *irn)
 			return;
 		}
 	}
-	ir_nodeset_insert(&pi->this_mem, irn);
+	ir_nodesparseset_insert(&pi->this_mem, irn);
 }
 
 static void parallelize_store(parallelize_info *pi, ir_node *irn)
 {
 	/* There is no point in investigating the same subgraph twice */
-	if (ir_nodeset_contains(&pi->all_visited, irn))
+	if (!ir_nodesparseset_insert(&pi->all_visited, irn))
 		return;
 
-	ir_nodeset_insert(&pi->all_visited, irn);
-
 	if (get_nodes_block(irn) == pi->origin_block) {
 		if (is_Proj(irn)) {
 			ir_node *pred = get_Proj_pred(irn);
 			if (is_Load(pred) &&
 					get_Load_volatility(pred) == volatility_non_volatile) {
-				ir_mode *org_mode  = pi->origin_mode;
-				ir_node *org_ptr   = pi->origin_ptr;
 				ir_mode *load_mode = get_Load_mode(pred);
 				ir_node *load_ptr  = get_Load_ptr(pred);
-				if (get_alias_relation(org_ptr, org_mode, load_ptr, load_mode) == ir_no_alias) {
+				if (is_independent(pi, pred, load_ptr, load_mode)) {
 					ir_node *mem = get_Load_mem(pred);
-					ir_nodeset_insert(&pi->user_mem, irn);
+					ir_nodesparseset_insert(&pi->user_mem, irn);
 					parallelize_store(pi, mem);
 					return;
 				}
 			} else if (is_Store(pred) &&
 					get_Store_volatility(pred) == volatility_non_volatile) {
-				ir_mode *org_mode   = pi->origin_mode;
-				ir_node *org_ptr    = pi->origin_ptr;
 				ir_mode *store_mode = get_irn_mode(get_Store_value(pred));
 				ir_node *store_ptr  = get_Store_ptr(pred);
-				if (get_alias_relation(org_ptr, org_mode, store_ptr, store_mode) == ir_no_alias) {
+				if (is_independent(pi, pred, store_ptr, store_mode)) {
 					ir_node *mem;
 
-					ir_nodeset_insert(&pi->user_mem, irn);
+					ir_nodesparseset_insert(&pi->user_mem, irn);
 					mem = get_Store_mem(pred);
 					parallelize_store(pi, mem);
 					return;
 				}
 			}
-		} else if (is_Sync(irn)) {
+		} else if (is_Sync(irn)
+		           && (unsigned)get_Sync_n_preds(irn) <= pi->budget) {
 			int n = get_Sync_n_preds(irn);
 
+			pi->budget -= n;
 			for (int i = 0; i < n; ++i) {
 				ir_node *sync_pred = get_Sync_pred(irn, i);
 				parallelize_store(pi, sync_pred);
@@ -126,20 +151,37 @@ static void parallelize_store(parallelize_info *pi, ir_node *irn)
 			return;
 		}
 	}
-	ir_nodeset_insert(&pi->this_mem, irn);
+	ir_nodesparseset_insert(&pi->this_mem, irn);
+}
+
+/**
+ * Adds the memory values in to the Sync sync, skipping the ones it already
+ * has.
+ */
+static void add_Sync_preds(ir_node *sync, size_t n, ir_node *const *in)
+{
+	int arity = get_Sync_n_preds(sync);
+	for (size_t i = 0; i < n; ++i) {
+		int p;
+		for (p = 0; p < arity; ++p) {
+			if (get_Sync_pred(sync, p) == in[i])
+				break;
+		}
+		if (p == arity)
+			add_Sync_pred(sync, in[i]);
+	}
 }
 
 static void walker(ir_node *proj, void *env)
 {
-	(void)env;
+	parallelize_info *pi = (parallelize_info*)env;
 
 	if (!is_Proj(proj)) return;
 	if (get_irn_mode(proj) != mode_M) return;
 
-	ir_node          *mem_op = get_Proj_pred(proj);
-	ir_node          *pred;
-	ir_node          *block;
-	parallelize_info  pi;
+	ir_node *mem_op = get_Proj_pred(proj);
+	ir_node *pred;
+	ir_node *block;
 
 	if (is_Load(mem_op)) {
 		if (get_Load_volatility(mem_op) != volatility_non_volatile) return;
@@ -147,69 +189,99 @@ static void walker(ir_node *proj, void *env)
 		block = get_nodes_block(mem_op);
 		pred  = get_Load_mem(mem_op);
 
-		pi.origin_block = block,
-		pi.origin_ptr   = get_Load_ptr(mem_op);
-		pi.origin_mode  = get_Load_mode(mem_op);
-		ir_nodeset_init(&pi.this_mem);
-		ir_nodeset_init(&pi.user_mem);
-		ir_nodeset_init(&pi.all_visited);
+		pi->origin_block = block,
+		pi->origin_ptr   = get_Load_ptr(mem_op);
+		pi->origin_mode  = get_Load_mode(mem_op);
+		pi->origin_part  = memssa_get_partition(pi->ssa, mem_op);
+		pi->budget       = MAX_PARALLEL_OPS;
+		ir_nodesparseset_clear(&pi->this_mem);
+		ir_nodesparseset_clear(&pi->user_mem);
+		ir_nodesparseset_clear(&pi->all_visited);
 
-		parallelize_load(&pi, pred);
+		parallelize_load(pi, pred);
 	} else if (is_Store(mem_op)) {
 		if (get_Store_volatility(mem_op) != volatility_non_volatile) return;
 
 		block = get_nodes_block(mem_op);
 		pred  = get_Store_mem(mem_op);
 
-		pi.origin_block = block,
-		pi.origin_ptr   = get_Store_ptr(mem_op);
-		pi.origin_mode  = get_irn_mode(get_Store_value(mem_op));
-		ir_nodeset_init(&pi.this_mem);
-		ir_nodeset_init(&pi.user_mem);
-		ir_nodeset_init(&pi.all_visited);
+		pi->origin_block = block,
+		pi->origin_ptr   = get_Store_ptr(mem_op);
+		pi->origin_mode  = get_irn_mode(get_Store_value(mem_op));
+		pi->origin_part  = memssa_get_partition(pi->ssa, mem_op);
+		pi->budget       = MAX_PARALLEL_OPS;
+		ir_nodesparseset_clear(&pi->this_mem);
+		ir_nodesparseset_clear(&pi->user_mem);
+		ir_nodesparseset_clear(&pi->all_visited);
 
-		parallelize_store(&pi, pred);
+		parallelize_store(pi, pred);
 	} else {
 		return;
 	}
 
-	size_t n = ir_nodeset_size(&pi.user_mem);
+	size_t n = ir_nodesparseset_size(&pi->user_mem);
 	if (n > 0) { /* nothing happened otherwise */
-		ir_node **in   = XMALLOCN(ir_node*, n+1);
+		ir_node **in = XMALLOCN(ir_node*, n+1);
 
 		size_t i = 0;
 		in[i++] = proj;
-		foreach_ir_nodeset(&pi.user_mem, node, iter) {
+		foreach_ir_nodesparseset(&pi->user_mem, node) {
 			in[i++] = node;
 		}
 		assert(i == n+1);
-		ir_node *sync = new_r_Sync(block, i, in);
+
+		/* Sync users get the parallel memory as additional inputs instead of
+		 * a nested Sync, all other users get a new Sync */
+		ir_node **users = NEW_ARR_F(ir_node*, 0);
+		foreach_out_edge(proj, edge) {
+			ARR_APP1(ir_node*, users, get_edge_src_irn(edge));
+		}
+		ir_node *sync = NULL;
+		for (size_t u = 0, n_users = ARR_LEN(users); u < n_users; ++u) {
+			ir_node *user = users[u];
+			if (is_Sync(user)
+			    && get_Sync_n_preds(user) + i <= MAX_PARALLEL_OPS) {
+				add_Sync_preds(user, i, in);
+				continue;
+			}
+			if (sync == NULL)
+				sync = new_r_Sync(block, i, in);
+			for (int p = 0, arity = get_irn_arity(user); p < arity; ++p) {
+				if (get_irn_n(user, p) == proj)
+					set_irn_n(user, p, sync);
+			}
+		}
+		DEL_ARR_F(users);
 		free(in);
-		edges_reroute_except(proj, sync, sync);
 
-		n = ir_nodeset_size(&pi.this_mem);
+		n = ir_nodesparseset_size(&pi->this_mem);
+		ir_node **this_mem = ir_nodesparseset_nodes(&pi->this_mem);
 		if (n == 1) {
-			sync = ir_nodeset_first(&pi.this_mem);
+			sync = this_mem[0];
 		} else {
-			in = XMALLOCN(ir_node*, n);
-			i = 0;
-			foreach_ir_nodeset(&pi.this_mem, node, iter) {
-				in[i++] = node;
-			}
-			assert(i == n);
-			sync = new_r_Sync(block, i, in);
+			sync = new_r_Sync(block, n, this_mem);
 		}
 		set_memop_mem(mem_op, sync);
 	}
-
-	ir_nodeset_destroy(&pi.this_mem);
-	ir_nodeset_destroy(&pi.user_mem);
-	ir_nodeset_destroy(&pi.all_visited);
 }
 
 void opt_parallelize_mem(ir_graph *irg)
 {
-	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
-	irg_walk_graph(irg, NULL, walker, NULL);
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES
+		| IR_GRAPH_PROPERTY_CONSISTENT_ALIAS_CACHE
+		| IR_GRAPH_PROPERTY_CONSISTENT_ENTITY_USAGE);
+
+	/* the sets are only cleared between memory operations */
+	parallelize_info pi;
+	pi.ssa = memssa_new(irg);
+	ir_nodesparseset_init(&pi.this_mem, irg);
+	ir_nodesparseset_init(&pi.user_mem, irg);
+	ir_nodesparseset_init(&pi.all_visited, irg);
+	irg_walk_graph(irg, NULL, walker, &pi);
+	ir_nodesparseset_destroy(&pi.all_visited);
+	ir_nodesparseset_destroy(&pi.user_mem);
+	ir_nodesparseset_destroy(&pi.this_mem);
+	memssa_free(pi.ssa);
+
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_CONTROL_FLOW);
 }
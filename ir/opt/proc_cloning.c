@@ -15,7 +15,13 @@
  * analyze. Optimize mean to make a new function with parameters, that
  * aren't be constant. The constant parameters of the function are placed
  * in the function graph. They aren't be passed as parameters.
+ *
+ * The clones are remembered in the program, so later runs redirect calls
+ * with the same constant argument to the existing clone instead of copying
+ * the method again.
  */
+#include <limits.h>
+
 #include "iroptimize.h"
 #include "tv.h"
 #include "set.h"
@@ -30,6 +36,8 @@
 #include "irtools.h"
 #include "irgmod.h"
 #include "array_t.h"
+#include "execfreq.h"
+#include "iredges.h"
 
 /**
  * This struct contains the information quadruple for a Call, which we need to
@@ -48,6 +56,7 @@ typedef struct quadruple {
 typedef struct entry {
 	quadruple_t  q;      /**< the quadruple */
 	float        weight; /**< its weight */
+	ir_entity    *clone; /**< a clone made earlier for q, or NULL */
 	struct entry *next;  /**< link to the next one */
 } entry_t;
 
@@ -55,8 +64,24 @@ typedef struct q_set {
 	struct obstack obst;        /**< an obstack containing all entries */
 	pset           *map;        /**< a hash map containing the quadruples */
 	entry_t        *heavy_uses; /**< the ordered list of heavy uses */
+	pset           *live;       /**< entities of all graphs of the program */
+	bool           use_freq;    /**< weight calls by their execution frequency */
+	unsigned       budget_left; /**< nodes the clones may still add, UINT_MAX
+	                                 for no limit */
 } q_set;
 
+/**
+ * A clone made for a quadruple, kept in the program across runs.
+ */
+typedef struct specialization_t {
+	ir_entity *ent;      /**< the cloned method */
+	size_t    pos;       /**< position of the replaced argument */
+	ir_tarval *tv;       /**< the value of the replaced argument */
+	ident     *ent_id;   /**< ident of ent */
+	ir_entity *clone;    /**< the clone */
+	ident     *clone_id; /**< ident of the clone */
+} specialization_t;
+
 /**
  * Compare two quadruplets.
  *
@@ -80,6 +105,73 @@ static unsigned hash_entry(const entry_t *entry)
 	return hash_ptr(entry->q.ent) ^ hash_ptr(entry->q.tv) ^ (unsigned)(entry->q.pos * 9);
 }
 
+static int specialization_cmp(const void *elt, const void *key, size_t size)
+{
+	const specialization_t *s1 = (const specialization_t*)elt;
+	const specialization_t *s2 = (const specialization_t*)key;
+	(void)size;
+
+	return (s1->ent != s2->ent) || (s1->pos != s2->pos) || (s1->tv != s2->tv);
+}
+
+static unsigned hash_specialization(const specialization_t *spec)
+{
+	return hash_ptr(spec->ent) ^ hash_ptr(spec->tv) ^ (unsigned)(spec->pos * 9);
+}
+
+/**
+ * Returns the clone an earlier run made for q, or NULL if there is none.
+ */
+static ir_entity *find_specialization(const q_set *hmap, const quadruple_t *q)
+{
+	set *specs = irp->clone_specializations;
+	if (specs == NULL)
+		return NULL;
+
+	specialization_t key;
+	key.ent = q->ent;
+	key.pos = q->pos;
+	key.tv  = q->tv;
+	specialization_t *spec = set_find(specialization_t, specs, &key,
+	                                  sizeof(key), hash_specialization(&key));
+	if (spec == NULL)
+		return NULL;
+
+	/* Garbage collection may have freed the clone or the original method
+	 * since, so only trust entities that still have a graph and carry the
+	 * same names. */
+	ir_entity *clone = spec->clone;
+	if (!pset_find_ptr(hmap->live, clone)
+	    || get_entity_ident(clone) != spec->clone_id
+	    || get_entity_ident(q->ent) != spec->ent_id)
+		return NULL;
+	if (get_method_n_params(get_entity_type(clone)) + 1
+	    != get_method_n_params(get_entity_type(q->ent)))
+		return NULL;
+	return clone;
+}
+
+/**
+ * Remembers the clone made for q.
+ */
+static void remember_specialization(const quadruple_t *q, ir_entity *clone)
+{
+	if (irp->clone_specializations == NULL)
+		irp->clone_specializations = new_set(specialization_cmp, 8);
+
+	specialization_t key;
+	key.ent = q->ent;
+	key.pos = q->pos;
+	key.tv  = q->tv;
+	specialization_t *spec
+		= set_insert(specialization_t, irp->clone_specializations, &key,
+		             sizeof(key), hash_specialization(&key));
+	/* overwrites a stale entry with the same key */
+	spec->ent_id   = get_entity_ident(q->ent);
+	spec->clone    = clone;
+	spec->clone_id = get_entity_ident(clone);
+}
+
 /**
  * Free memory associated with a quadruplet.
  */
@@ -129,6 +221,7 @@ static void process_call(ir_node *call, ir_entity *callee, q_set *hmap)
 			key->q.tv    = get_Const_tarval(call_param);
 			key->q.calls = NULL;
 			key->weight  = 0.0F;
+			key->clone   = NULL;
 			key->next    = NULL;
 
 			/* We insert our information in the set, where we collect the calls.*/
@@ -478,14 +571,54 @@ static void exchange_calls(quadruple_t *q, ir_entity *cloned_ent)
 /**
  * The weight formula:
  * We save one instruction in every caller and param_weight instructions
- * in the callee.
+ * in the callee. With use_freq every call counts with the execution
+ * frequency of its block.
  */
-static float calculate_weight(const entry_t *entry)
+static float calculate_weight(const q_set *hmap, const entry_t *entry)
 {
-	return ARR_LEN(entry->q.calls) *
+	float n_calls = (float)ARR_LEN(entry->q.calls);
+	if (hmap->use_freq) {
+		n_calls = 0.0F;
+		for (size_t i = 0, n = ARR_LEN(entry->q.calls); i < n; ++i) {
+			ir_node *call = skip_Id(entry->q.calls[i]);
+			n_calls += (float)get_block_execfreq(get_nodes_block(call));
+		}
+	}
+	return n_calls *
 		(float)(get_method_param_weight(entry->q.ent, entry->q.pos) + 1);
 }
 
+/**
+ * Checks whether an entry is worth cloning. Reusing an existing clone does
+ * not cost anything, so it always is.
+ */
+static bool is_heavy(const entry_t *entry, float threshold)
+{
+	return entry->clone != NULL || entry->weight >= threshold;
+}
+
+static void count_node(ir_node *node, void *env)
+{
+	(void)node;
+	++*(unsigned*)env;
+}
+
+/**
+ * Checks whether a clone of q fits into the budget and takes its share.
+ */
+static bool take_budget(q_set *hmap, const quadruple_t *q)
+{
+	if (hmap->budget_left == UINT_MAX)
+		return true;
+
+	unsigned n_nodes = 0;
+	irg_walk_graph(get_entity_irg(q->ent), count_node, NULL, &n_nodes);
+	if (n_nodes > hmap->budget_left)
+		return false;
+	hmap->budget_left -= n_nodes;
+	return true;
+}
+
 /**
  * After we exchanged all calls, some entries on the list for
  * the next cloned entity may get invalid, so we have to check
@@ -531,9 +664,9 @@ restart:
 	ARR_SHRINKLEN(entry->q.calls, len);
 
 	/* recalculate the weight and resort the heavy uses map */
-	entry->weight = calculate_weight(entry);
+	entry->weight = calculate_weight(hmap, entry);
 
-	if (len <= 0 || entry->weight < threshold) {
+	if (len <= 0 || !is_heavy(entry, threshold)) {
 		hmap->heavy_uses = entry->next;
 		kill_entry(entry);
 
@@ -561,7 +694,7 @@ restart:
  * call(..., Const, ...). If the weight is bigger than threshold,
  * clone the entity and fix the calls.
  */
-void proc_cloning(float threshold)
+static void do_proc_cloning(float threshold, bool use_freq, unsigned budget)
 {
 	entry_t *p;
 	size_t i, n;
@@ -573,12 +706,19 @@ void proc_cloning(float threshold)
 	FIRM_DBG_REGISTER(dbg, "firm.opt.proc_cloning");
 
 	obstack_init(&hmap.obst);
-	hmap.map        = NULL;
-	hmap.heavy_uses = NULL;
+	hmap.map         = NULL;
+	hmap.heavy_uses  = NULL;
+	hmap.live        = pset_new_ptr_default();
+	hmap.use_freq    = use_freq;
+	hmap.budget_left = budget != 0 ? budget : UINT_MAX;
 
 	/* initially fill our map by visiting all irgs */
 	for (i = 0, n = get_irp_n_irgs(); i < n; ++i) {
 		ir_graph *irg = get_irp_irg(i);
+		/* computing the execution frequencies leaves the out edges active,
+		 * copying from a graph with active edges is not supported */
+		edges_deactivate(irg);
+		pset_insert_ptr(hmap.live, get_irg_entity(irg));
 		irg_walk_graph(irg, collect_irg_calls, NULL, &hmap);
 	}
 
@@ -591,12 +731,13 @@ void proc_cloning(float threshold)
 		   The elements are arranged dependent of their value descending.*/
 		if (hmap.map) {
 			foreach_pset(hmap.map, entry_t, entry) {
-				entry->weight = calculate_weight(entry);
+				entry->weight = calculate_weight(&hmap, entry);
+				entry->clone  = find_specialization(&hmap, &entry->q);
 
 				/*
 				 * Do not put entry with a weight < threshold in the list
 				 */
-				if (entry->weight < threshold) {
+				if (!is_heavy(entry, threshold)) {
 					kill_entry(entry);
 					continue;
 				}
@@ -640,11 +781,23 @@ void proc_cloning(float threshold)
 		if (entry) {
 			quadruple_t *qp = &entry->q;
 
-			ir_entity *ent = clone_method(qp);
-			DB((dbg, LEVEL_1, "Cloned <%+F, %zu, %T> info %+F\n", qp->ent, qp->pos, qp->tv, ent));
-
 			hmap.heavy_uses = entry->next;
 
+			ir_entity *ent = entry->clone;
+			if (ent != NULL) {
+				DB((dbg, LEVEL_1, "Reused %+F for <%+F, %zu, %T>\n", ent, qp->ent, qp->pos, qp->tv));
+			} else if (take_budget(&hmap, qp)) {
+				ent = clone_method(qp);
+				DB((dbg, LEVEL_1, "Cloned <%+F, %zu, %T> info %+F\n", qp->ent, qp->pos, qp->tv, ent));
+				pset_insert_ptr(hmap.live, ent);
+				remember_specialization(qp, ent);
+			} else {
+				DB((dbg, LEVEL_2, "<%+F, %zu, %T> exceeds the budget\n", qp->ent, qp->pos, qp->tv));
+				kill_entry(entry);
+				reorder_weights(&hmap, threshold);
+				continue;
+			}
+
 			/* We must exchange the copies of this call in all clones too.*/
 			exchange_calls(&entry->q, ent);
 			kill_entry(entry);
@@ -657,5 +810,16 @@ void proc_cloning(float threshold)
 			reorder_weights(&hmap, threshold);
 		}
 	}
+	del_pset(hmap.live);
 	obstack_free(&hmap.obst, NULL);
 }
+
+void proc_cloning(float threshold)
+{
+	do_proc_cloning(threshold, false, 0);
+}
+
+void proc_cloning_profiled(float threshold, unsigned budget)
+{
+	do_proc_cloning(threshold, true, budget);
+}
@@ -0,0 +1,653 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2013 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Eliminates comparisons decided by dominating conditions and value
+ *          ranges.
+ *
+ * Bounds and null checks compare values whose relation mostly follows from
+ * the conditions dominating them:
+ *
+ *    for (i = 0; i < len; ++i)
+ *        if ((unsigned)i >= (unsigned)len)
+ *            throw();
+ *
+ * The conditions dominating a block and the Confirms of a value give
+ * relations between values. Integer values get ranges from constants and
+ * arithmetic, refined by these relations. The range of a Phi on a cycle is
+ * found by assuming it only grows (or only shrinks) from its entry values
+ * and checking that assumption on the values coming around the cycle, so
+ * induction variables of counted loops get bounded ranges.
+ * Comparisons whose outcome is known are replaced by constants.
+ */
+#include "iroptimize.h"
+
+#include <limits.h>
+#include <stdbool.h>
+
+#include "array.h"
+#include "debug.h"
+#include "ircons.h"
+#include "irdom.h"
+#include "iredges_t.h"
+#include "irgopt.h"
+#include "irgmod.h"
+#include "irgraph_t.h"
+#include "irgwalk.h"
+#include "irnode_t.h"
+#include "obst.h"
+#include "tv.h"
+#include "util.h"
+
+DEBUG_ONLY(static firm_dbg_module_t *dbg;)
+
+/** The range depends on no assumed Phi range. */
+#define NO_DEP     UINT_MAX
+/** Maximal recursion depth of the range computation. */
+#define MAX_DEPTH  64
+/** Maximal number of dominating conditions looked at. */
+#define MAX_FACTS  64
+
+/** An interval of integer values, including its borders. */
+typedef struct range_t {
+	ir_tarval *min;
+	ir_tarval *max;
+} range_t;
+
+/** A relation known to hold in a block: left relation right. */
+typedef struct fact_t {
+	ir_node             *left;
+	ir_node             *right;
+	ir_relation          relation;
+	const struct fact_t *next;     /**< the facts of the dominator */
+} fact_t;
+
+typedef enum range_state_t {
+	RANGE_UNKNOWN,
+	RANGE_BUSY,     /**< a Phi whose range is computed, the range is assumed */
+	RANGE_DONE,
+} range_state_t;
+
+typedef struct range_info_t {
+	range_t       range;
+	unsigned      dep;    /**< outermost assumed Phi the range depends on */
+	unsigned      epoch;  /**< the assumptions the range was computed with */
+	range_state_t state;
+} range_info_t;
+
+typedef struct range_env_t {
+	struct obstack  obst;
+	const fact_t  **facts;   /**< the facts of each block by index */
+	range_info_t   *infos;   /**< the range of each node by index */
+	unsigned        n_busy;  /**< number of Phis with assumed ranges */
+	unsigned        epoch;   /**< changes with each assumption */
+	unsigned        depth;   /**< recursion depth of the range computation */
+} range_env_t;
+
+/**
+ * Dominator tree walker, collects the relations known in a block: the ones
+ * of its dominator and the condition of its only predecessor.
+ */
+static void collect_facts(ir_node *block, void *data)
+{
+	range_env_t  *env   = (range_env_t*)data;
+	ir_node      *idom  = get_Block_idom(block);
+	const fact_t *facts = idom != NULL ? env->facts[get_irn_idx(idom)] : NULL;
+
+	if (get_Block_n_cfgpreds(block) == 1) {
+		ir_node *proj = get_Block_cfgpred(block, 0);
+		ir_node *cond = is_Proj(proj) ? get_Proj_pred(proj) : NULL;
+		if (cond != NULL && is_Cond(cond) && is_Cmp(get_Cond_selector(cond))) {
+			ir_node    *cmp      = get_Cond_selector(cond);
+			ir_relation relation = get_Cmp_relation(cmp);
+			if (get_Proj_proj(proj) == pn_Cond_false)
+				relation = get_negated_relation(relation);
+
+			fact_t *fact   = OALLOC(&env->obst, fact_t);
+			fact->left     = get_Cmp_left(cmp);
+			fact->right    = get_Cmp_right(cmp);
+			fact->relation = relation & ir_relation_less_equal_greater;
+			fact->next     = facts;
+			facts          = fact;
+		}
+	}
+	env->facts[get_irn_idx(block)] = facts;
+}
+
+static bool same_value(ir_node *a, ir_node *b)
+{
+	return skip_Confirm(a) == skip_Confirm(b);
+}
+
+static void set_full_range(range_t *range, ir_mode *mode)
+{
+	range->min = get_mode_min(mode);
+	range->max = get_mode_max(mode);
+}
+
+static bool tarval_less(ir_tarval *a, ir_tarval *b)
+{
+	return tarval_cmp(a, b) == ir_relation_less;
+}
+
+/**
+ * Returns a + b or tarval_bad if the sum is not representable.
+ */
+static ir_tarval *add_exact(ir_tarval *a, ir_tarval *b)
+{
+	ir_tarval *res = tarval_add(a, b);
+	if (res == tarval_bad || tarval_sub(res, b, NULL) != a)
+		return tarval_bad;
+	/* a wrapped sum moves against the direction of b */
+	if (tarval_is_negative(b) ? tarval_less(a, res) : tarval_less(res, a))
+		return tarval_bad;
+	return res;
+}
+
+/**
+ * Returns a - b or tarval_bad if the difference is not representable.
+ */
+static ir_tarval *sub_exact(ir_tarval *a, ir_tarval *b)
+{
+	ir_tarval *res = tarval_sub(a, b, NULL);
+	if (res == tarval_bad || tarval_add(res, b) != a)
+		return tarval_bad;
+	if (tarval_is_negative(b) ? tarval_less(res, a) : tarval_less(a, res))
+		return tarval_bad;
+	return res;
+}
+
+/**
+ * Restricts range to the values standing in relation to a value of bound.
+ * Contradicting relations leave the range unchanged, the code is
+ * unreachable then.
+ */
+static void restrict_range(range_t *range, ir_relation relation,
+                           const range_t *bound)
+{
+	ir_mode   *mode = get_tarval_mode(range->min);
+	ir_tarval *one  = get_tarval_one(mode);
+	ir_tarval *min  = range->min;
+	ir_tarval *max  = range->max;
+
+	switch (relation & ir_relation_less_equal_greater) {
+	case ir_relation_equal:
+		if (tarval_less(min, bound->min))
+			min = bound->min;
+		if (tarval_less(bound->max, max))
+			max = bound->max;
+		break;
+	case ir_relation_less: {
+		ir_tarval *limit = sub_exact(bound->max, one);
+		if (limit == tarval_bad)
+			return;
+		if (tarval_less(limit, max))
+			max = limit;
+		break;
+	}
+	case ir_relation_less_equal:
+		if (tarval_less(bound->max, max))
+			max = bound->max;
+		break;
+	case ir_relation_greater: {
+		ir_tarval *limit = add_exact(bound->min, one);
+		if (limit == tarval_bad)
+			return;
+		if (tarval_less(min, limit))
+			min = limit;
+		break;
+	}
+	case ir_relation_greater_equal:
+		if (tarval_less(min, bound->min))
+			min = bound->min;
+		break;
+	case ir_relation_less_greater:
+		/* only a border equal to a single value can be excluded */
+		if (bound->min != bound->max || min == max)
+			return;
+		if (min == bound->min)
+			min = add_exact(min, one);
+		else if (max == bound->min)
+			max = sub_exact(max, one);
+		break;
+	default:
+		return;
+	}
+	if (tarval_less(max, min))
+		return;
+	range->min = min;
+	range->max = max;
+}
+
+/**
+ * Converts range to mode if all its values are representable in mode.
+ */
+static bool convert_range(range_t *res, const range_t *range, ir_mode *mode)
+{
+	ir_tarval *min = tarval_convert_to(range->min, mode);
+	ir_tarval *max = tarval_convert_to(range->max, mode);
+	if (min == tarval_bad || max == tarval_bad)
+		return false;
+	ir_mode *src_mode = get_tarval_mode(range->min);
+	if (tarval_convert_to(min, src_mode) != range->min
+	    || tarval_convert_to(max, src_mode) != range->max
+	    || tarval_is_negative(min) != tarval_is_negative(range->min)
+	    || tarval_is_negative(max) != tarval_is_negative(range->max))
+		return false;
+	res->min = min;
+	res->max = max;
+	return true;
+}
+
+static range_t get_range(range_env_t *env, ir_node *node, unsigned *dep);
+
+/**
+ * Returns the range of node when used in block, restricted by the conditions
+ * dominating block.
+ */
+static range_t get_range_at(range_env_t *env, ir_node *node, ir_node *block,
+                            unsigned *dep)
+{
+	range_t range = get_range(env, node, dep);
+
+	unsigned n_facts = 0;
+	for (const fact_t *fact = env->facts[get_irn_idx(block)];
+	     fact != NULL && n_facts < MAX_FACTS; fact = fact->next, ++n_facts) {
+		ir_node    *other;
+		ir_relation relation;
+		if (same_value(fact->left, node)) {
+			other    = fact->right;
+			relation = fact->relation;
+		} else if (same_value(fact->right, node)) {
+			other    = fact->left;
+			relation = get_inversed_relation(fact->relation);
+		} else {
+			continue;
+		}
+		range_t bound = get_range(env, other, dep);
+		restrict_range(&range, relation, &bound);
+	}
+	return range;
+}
+
+/**
+ * Computes the range of a Phi. The values entering its cycles are known
+ * first. Assuming the Phi only grows from the smallest of them, the values
+ * coming around the cycles must be at least as big, then the Phi is bounded
+ * by the biggest of all values. The same holds for shrinking Phis.
+ */
+static range_t get_phi_range(range_env_t *env, ir_node *phi, unsigned *dep)
+{
+	range_info_t *info   = &env->infos[get_irn_idx(phi)];
+	ir_mode      *mode   = get_irn_mode(phi);
+	ir_node      *block  = get_nodes_block(phi);
+	int           arity  = get_Phi_n_preds(phi);
+	unsigned      self   = ++env->n_busy;
+	unsigned      outer  = NO_DEP;
+	bool         *cyclic = ALLOCANZ(bool, arity);
+	bool          has_input = false;
+	bool          has_entry = false;
+	bool          has_cycle = false;
+	range_t       entry;
+	range_t       range;
+
+	info->state = RANGE_BUSY;
+	info->dep   = self;
+	set_full_range(&info->range, mode);
+	++env->epoch;
+
+	/* the union of the inputs is right if the Phi may be anything */
+	set_full_range(&range, mode);
+	set_full_range(&entry, mode);
+	for (int i = 0; i < arity; ++i) {
+		if (is_Bad(get_Block_cfgpred(block, i)))
+			continue;
+		ir_node *pred_block = get_Block_cfgpred_block(block, i);
+		unsigned d          = NO_DEP;
+		range_t  r = get_range_at(env, get_Phi_pred(phi, i), pred_block, &d);
+		if (!has_input) {
+			range     = r;
+			has_input = true;
+		} else {
+			if (tarval_less(r.min, range.min))
+				range.min = r.min;
+			if (tarval_less(range.max, r.max))
+				range.max = r.max;
+		}
+		if (d != NO_DEP) {
+			cyclic[i] = true;
+			has_cycle = true;
+			if (d < self)
+				outer = MIN(outer, d);
+		} else if (!has_entry) {
+			entry     = r;
+			has_entry = true;
+		} else {
+			if (tarval_less(r.min, entry.min))
+				entry.min = r.min;
+			if (tarval_less(entry.max, r.max))
+				entry.max = r.max;
+		}
+	}
+
+	for (int growing = 0; has_entry && has_cycle && growing < 2; ++growing) {
+		info->range = entry;
+		if (growing)
+			info->range.max = get_mode_max(mode);
+		else
+			info->range.min = get_mode_min(mode);
+		++env->epoch;
+
+		range_t assumed = entry;
+		bool    holds   = true;
+		for (int i = 0; i < arity && holds; ++i) {
+			if (!cyclic[i])
+				continue;
+			ir_node *pred_block = get_Block_cfgpred_block(block, i);
+			unsigned d          = NO_DEP;
+			range_t  r = get_range_at(env, get_Phi_pred(phi, i), pred_block,
+			                          &d);
+			if (d < self)
+				outer = MIN(outer, d);
+			if (growing) {
+				holds = !tarval_less(r.min, entry.min);
+				if (tarval_less(assumed.max, r.max))
+					assumed.max = r.max;
+			} else {
+				holds = !tarval_less(entry.max, r.max);
+				if (tarval_less(r.min, assumed.min))
+					assumed.min = r.min;
+			}
+		}
+		if (!holds)
+			continue;
+		if (tarval_less(range.min, assumed.min))
+			range.min = assumed.min;
+		if (tarval_less(assumed.max, range.max))
+			range.max = assumed.max;
+	}
+
+	--env->n_busy;
+	info->state = RANGE_DONE;
+	info->range = range;
+	info->dep   = outer;
+	info->epoch = ++env->epoch;
+	*dep = MIN(*dep, outer);
+	return range;
+}
+
+/**
+ * Returns the range of an integer node. Ranges depending on assumed Phi
+ * ranges are only valid as long as the assumptions do not change.
+ */
+static range_t get_range(range_env_t *env, ir_node *node, unsigned *dep)
+{
+	ir_mode      *mode = get_irn_mode(node);
+	range_info_t *info = &env->infos[get_irn_idx(node)];
+	range_t       range;
+
+	if (info->state == RANGE_BUSY
+	    || (info->state == RANGE_DONE
+	        && (info->dep == NO_DEP || info->epoch == env->epoch))) {
+		*dep = MIN(*dep, info->dep);
+		return info->range;
+	}
+
+	set_full_range(&range, mode);
+	if (env->depth >= MAX_DEPTH)
+		return range;
+
+	++env->depth;
+	if (is_Phi(node)) {
+		range = get_phi_range(env, node, dep);
+		--env->depth;
+		return range;
+	}
+
+	ir_node  *block    = get_nodes_block(node);
+	unsigned  node_dep = NO_DEP;
+	switch (get_irn_opcode(node)) {
+	case iro_Const:
+		range.min = range.max = get_Const_tarval(node);
+		break;
+
+	case iro_Confirm: {
+		range = get_range(env, get_Confirm_value(node), &node_dep);
+		range_t bound = get_range(env, get_Confirm_bound(node), &node_dep);
+		restrict_range(&range, get_Confirm_relation(node), &bound);
+		break;
+	}
+
+	case iro_Conv: {
+		ir_node *op = get_Conv_op(node);
+		if (!mode_is_int(get_irn_mode(op)))
+			break;
+		range_t op_range = get_range_at(env, op, block, &node_dep);
+		convert_range(&range, &op_range, mode);
+		break;
+	}
+
+	case iro_Add:
+	case iro_Sub: {
+		ir_node *left  = get_binop_left(node);
+		ir_node *right = get_binop_right(node);
+		if (get_irn_mode(left) != mode || get_irn_mode(right) != mode)
+			break;
+		range_t l = get_range_at(env, left, block, &node_dep);
+		range_t r = get_range_at(env, right, block, &node_dep);
+		ir_tarval *min;
+		ir_tarval *max;
+		if (is_Add(node)) {
+			min = add_exact(l.min, r.min);
+			max = add_exact(l.max, r.max);
+		} else {
+			min = sub_exact(l.min, r.max);
+			max = sub_exact(l.max, r.min);
+		}
+		if (min != tarval_bad && max != tarval_bad) {
+			range.min = min;
+			range.max = max;
+		}
+		break;
+	}
+
+	case iro_And: {
+		/* the result has no bit an operand does not have */
+		range_t l = get_range_at(env, get_And_left(node), block, &node_dep);
+		range_t r = get_range_at(env, get_And_right(node), block, &node_dep);
+		bool    l_positive = !tarval_is_negative(l.min);
+		bool    r_positive = !tarval_is_negative(r.min);
+		if (l_positive || r_positive) {
+			range.min = get_mode_null(mode);
+			if (l_positive)
+				range.max = l.max;
+			if (r_positive && tarval_less(r.max, range.max))
+				range.max = r.max;
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+	--env->depth;
+
+	info->state = RANGE_DONE;
+	info->range = range;
+	info->dep   = node_dep;
+	info->epoch = env->epoch;
+	*dep = MIN(*dep, node_dep);
+	return range;
+}
+
+/**
+ * Returns the relations which may hold between left and right in block.
+ * The ranges of integer operands are returned in l_range and r_range.
+ */
+static ir_relation get_possible_relations(range_env_t *env, ir_node *block,
+                                          ir_node *left, ir_node *right,
+                                          range_t *l_range, range_t *r_range)
+{
+	ir_mode *mode = get_irn_mode(left);
+
+	/* conversions preserving both values do not change their relation */
+	if (is_Conv(left) && is_Conv(right)) {
+		ir_node *l_op    = get_Conv_op(left);
+		ir_node *r_op    = get_Conv_op(right);
+		ir_mode *op_mode = get_irn_mode(l_op);
+		if (mode_is_int(mode) && mode_is_int(op_mode)
+		    && get_irn_mode(r_op) == op_mode) {
+			range_t     l_op_range;
+			range_t     r_op_range;
+			ir_relation possible = get_possible_relations(env, block,
+				l_op, r_op, &l_op_range, &r_op_range);
+			if (convert_range(l_range, &l_op_range, mode)
+			    && convert_range(r_range, &r_op_range, mode))
+				return possible;
+		}
+	}
+
+	ir_relation possible = ir_relation_less_equal_greater;
+	if (same_value(left, right))
+		possible = ir_relation_equal;
+
+	unsigned n_facts = 0;
+	for (const fact_t *fact = env->facts[get_irn_idx(block)];
+	     fact != NULL && n_facts < MAX_FACTS; fact = fact->next, ++n_facts) {
+		if (same_value(fact->left, left) && same_value(fact->right, right))
+			possible &= fact->relation;
+		else if (same_value(fact->left, right) && same_value(fact->right, left))
+			possible &= get_inversed_relation(fact->relation);
+	}
+	for (ir_node *c = left; is_Confirm(c); c = get_Confirm_value(c)) {
+		if (same_value(get_Confirm_bound(c), right))
+			possible &= get_Confirm_relation(c);
+	}
+	for (ir_node *c = right; is_Confirm(c); c = get_Confirm_value(c)) {
+		if (same_value(get_Confirm_bound(c), left))
+			possible &= get_inversed_relation(get_Confirm_relation(c));
+	}
+
+	if (mode_is_reference(mode)) {
+		const ir_node *confirm;
+		if ((is_Const(right) && is_Const_null(right)
+		     && value_not_null(left, &confirm))
+		    || (is_Const(left) && is_Const_null(left)
+		        && value_not_null(right, &confirm)))
+			possible &= ~ir_relation_equal;
+		return possible;
+	}
+
+	unsigned dep = NO_DEP;
+	*l_range = get_range_at(env, left, block, &dep);
+	*r_range = get_range_at(env, right, block, &dep);
+
+	/* a known order of the values narrows their ranges */
+	range_t l = *l_range;
+	range_t r = *r_range;
+	restrict_range(l_range, possible, &r);
+	restrict_range(r_range, get_inversed_relation(possible), &l);
+
+	ir_relation ordered = ir_relation_false;
+	if (tarval_less(l_range->min, r_range->max))
+		ordered |= ir_relation_less;
+	if (tarval_less(r_range->min, l_range->max))
+		ordered |= ir_relation_greater;
+	if (!tarval_less(l_range->max, r_range->min)
+	    && !tarval_less(r_range->max, l_range->min))
+		ordered |= ir_relation_equal;
+	return possible & ordered;
+}
+
+/**
+ * Walker, collects the integer and pointer comparisons.
+ */
+static void collect_cmps(ir_node *node, void *data)
+{
+	ir_node ***cmps = (ir_node***)data;
+	if (!is_Cmp(node))
+		return;
+	ir_mode *mode = get_irn_mode(get_Cmp_left(node));
+	if (mode_is_int(mode) || mode_is_reference(mode))
+		ARR_APP1(ir_node*, *cmps, node);
+}
+
+void opt_range_checks(ir_graph *irg)
+{
+	FIRM_DBG_REGISTER(dbg, "firm.opt.rangechecks");
+	DB((dbg, LEVEL_1, "===> Eliminating range checks in %+F\n", irg));
+
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_DOMINANCE
+		| IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+
+	unsigned    n_idx = get_irg_last_idx(irg);
+	range_env_t env;
+	obstack_init(&env.obst);
+	env.facts  = XMALLOCNZ(const fact_t*, n_idx);
+	env.infos  = XMALLOCNZ(range_info_t, n_idx);
+	env.n_busy = 0;
+	env.epoch  = 0;
+	env.depth  = 0;
+	dom_tree_walk_irg(irg, collect_facts, NULL, &env);
+
+	ir_node **cmps = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, NULL, collect_cmps, &cmps);
+
+	/* decide all comparisons before the indices change */
+	size_t      n_cmps = ARR_LEN(cmps);
+	ir_tarval **values = XMALLOCNZ(ir_tarval*, n_cmps);
+	for (size_t i = 0; i < n_cmps; ++i) {
+		ir_node    *cmp      = cmps[i];
+		ir_relation relation = get_Cmp_relation(cmp)
+		                     & ir_relation_less_equal_greater;
+		range_t     l_range;
+		range_t     r_range;
+		ir_relation possible = get_possible_relations(&env,
+			get_nodes_block(cmp), get_Cmp_left(cmp), get_Cmp_right(cmp),
+			&l_range, &r_range);
+		/* nothing is possible in unreachable code */
+		if (possible == ir_relation_false)
+			continue;
+		if ((possible & ~relation) == ir_relation_false)
+			values[i] = tarval_b_true;
+		else if ((possible & relation) == ir_relation_false)
+			values[i] = tarval_b_false;
+	}
+
+	ir_node **users = NEW_ARR_F(ir_node*, 0);
+	for (size_t i = 0; i < n_cmps; ++i) {
+		if (values[i] == NULL)
+			continue;
+		ir_node *cmp = cmps[i];
+		DB((dbg, LEVEL_2, "%+F is always %T\n", cmp, values[i]));
+		foreach_out_edge(cmp, edge) {
+			ir_node *user = get_edge_src_irn(edge);
+			ARR_APP1(ir_node*, users, user);
+			/* a Cond becomes a Tuple in place, its Projs must follow */
+			if (get_irn_mode(user) == mode_T) {
+				foreach_out_edge(user, proj_edge) {
+					ARR_APP1(ir_node*, users, get_edge_src_irn(proj_edge));
+				}
+			}
+		}
+		exchange(cmp, new_r_Const(irg, values[i]));
+	}
+
+	/* Conds on constants become jumps */
+	size_t n_users = ARR_LEN(users);
+	if (n_users > 0)
+		local_optimize_nodes(irg, users, n_users);
+
+	confirm_irg_properties(irg, n_users > 0
+		? IR_GRAPH_PROPERTIES_NONE : IR_GRAPH_PROPERTIES_ALL);
+
+	DEL_ARR_F(users);
+	free(values);
+	DEL_ARR_F(cmps);
+	free(env.infos);
+	free(env.facts);
+	obstack_free(&env.obst, NULL);
+}
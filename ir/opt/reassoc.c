@@ -26,6 +26,11 @@
 #include "irloop.h"
 #include "pdeq.h"
 #include "debug.h"
+#include "array.h"
+#include "be.h"
+#include "iredges_t.h"
+#include "irtools.h"
+#include "util.h"
 
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
@@ -787,6 +792,256 @@ void optimize_reassociation(ir_graph *irg)
 	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_CONTROL_FLOW);
 }
 
+/** A value of an associative chain and the cycle it is available. */
+typedef struct chain_value_t {
+	ir_node  *node;
+	unsigned  ready;
+	bool      late;  /**< combine after the other values of the same cycle */
+} chain_value_t;
+
+/**
+ * Returns the cycle the result of node is available, counting one cycle per
+ * operation of its block. The cycles are kept in the links, operands on a
+ * cycle through a Phi may not be visited yet and count as available at 0.
+ */
+static unsigned get_ready(const ir_node *node)
+{
+	return (unsigned)PTR_TO_INT(get_irn_link(node));
+}
+
+static void set_ready(ir_node *node)
+{
+	unsigned ready = 0;
+	if (!is_Phi(node) && !is_Block(node)) {
+		ir_node *block = get_nodes_block(node);
+		for (int i = 0, n = get_irn_arity(node); i < n; ++i) {
+			ir_node *op = get_irn_n(node, i);
+			if (get_nodes_block(op) == block)
+				ready = MAX(ready, get_ready(op) + 1);
+		}
+	}
+	set_irn_link(node, INT_TO_PTR(ready));
+}
+
+/**
+ * Returns true if node is an associative operation whose chain may be
+ * rebalanced.
+ */
+static bool is_chain_op(const ir_node *node)
+{
+	switch (get_irn_opcode(node)) {
+	case iro_Add:
+	case iro_Mul: {
+		ir_mode *mode = get_irn_mode(node);
+		if (mode_is_float(mode))
+			return ir_imprecise_float_transforms_allowed();
+		return mode_is_int(mode);
+	}
+	case iro_And:
+	case iro_Eor:
+	case iro_Or:
+		return mode_is_int(get_irn_mode(node));
+	default:
+		return false;
+	}
+}
+
+/**
+ * Returns true if node is an inner node of the chain of root: the same
+ * operation in the same block whose only user is part of the chain.
+ */
+static bool is_chain_member(const ir_node *node, const ir_node *root)
+{
+	return get_irn_op(node) == get_irn_op(root)
+	    && get_irn_mode(node) == get_irn_mode(root)
+	    && get_nodes_block(node) == get_nodes_block(root)
+	    && get_irn_n_edges(node) == 1;
+}
+
+/**
+ * Returns true if node is the root of a chain, that is it is not an inner
+ * node of the chain of its user.
+ */
+static bool is_chain_root(const ir_node *node)
+{
+	if (get_irn_n_edges(node) != 1)
+		return true;
+	ir_node *user = get_edge_src_irn(get_irn_out_edge_first(node));
+	return !is_chain_member(node, user);
+}
+
+/**
+ * Collects the operands of the chain below node.
+ */
+static void collect_chain_leaves(ir_node *node, const ir_node *root,
+                                 chain_value_t **leaves)
+{
+	for (int i = 0; i < 2; ++i) {
+		ir_node *op = get_irn_n(node, i);
+		if (is_chain_member(op, root)) {
+			collect_chain_leaves(op, root, leaves);
+		} else {
+			chain_value_t value = { op, 0, false };
+			if (get_nodes_block(op) == get_nodes_block(root))
+				value.ready = get_ready(op);
+			ARR_APP1(chain_value_t, *leaves, value);
+		}
+	}
+}
+
+/**
+ * Returns the cycle the chain below node finishes when its leaves are
+ * available as given.
+ */
+static unsigned get_chain_finish(const ir_node *node, const ir_node *root,
+                                 const chain_value_t *leaves, size_t *pos)
+{
+	unsigned finish = 0;
+	for (int i = 0; i < 2; ++i) {
+		ir_node *op = get_irn_n(node, i);
+		unsigned ready;
+		if (is_chain_member(op, root)) {
+			ready = get_chain_finish(op, root, leaves, pos);
+		} else {
+			ready = leaves[(*pos)++].ready;
+		}
+		finish = MAX(finish, ready);
+	}
+	return finish + 1;
+}
+
+static int cmp_chain_value(const void *a, const void *b)
+{
+	const chain_value_t *va = (const chain_value_t*)a;
+	const chain_value_t *vb = (const chain_value_t*)b;
+	if (va->ready != vb->ready)
+		return QSORT_CMP(va->ready, vb->ready);
+	if (va->late != vb->late)
+		return QSORT_CMP(va->late, vb->late);
+	return QSORT_CMP(get_irn_idx(va->node), get_irn_idx(vb->node));
+}
+
+/**
+ * Rebalances the chain of root: the two values available first are combined
+ * until one is left, at most width operations per cycle. Loop carried Phis
+ * and constants are combined last, so a reduction only waits for one
+ * operation per iteration and constants stay at the root.
+ */
+static void rebalance_chain(ir_node *root, unsigned width)
+{
+	chain_value_t *leaves = NEW_ARR_F(chain_value_t, 0);
+	collect_chain_leaves(root, root, &leaves);
+	size_t n = ARR_LEN(leaves);
+	if (n < 4)
+		goto end;
+
+	unsigned late = 0;
+	for (size_t i = 0; i < n; ++i) {
+		ir_node *leaf = leaves[i].node;
+		if (!is_Phi(leaf) && !is_irn_constlike(leaf))
+			late = MAX(late, leaves[i].ready);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		ir_node *leaf = leaves[i].node;
+		if (is_Phi(leaf) || is_irn_constlike(leaf)) {
+			leaves[i].ready = late;
+			leaves[i].late  = true;
+		}
+	}
+
+	size_t   pos        = 0;
+	unsigned old_finish = get_chain_finish(root, root, leaves, &pos);
+
+	/* simulate the balanced tree before building it */
+	chain_value_t *values = NEW_ARR_F(chain_value_t, n);
+	unsigned       cycle  = 0;
+	unsigned       finish = 0;
+	memcpy(values, leaves, n * sizeof(*values));
+	for (size_t len = n; len > 1;) {
+		qsort(values, len, sizeof(*values), cmp_chain_value);
+		cycle = MAX(cycle, values[1].ready);
+		size_t i = 0;
+		for (unsigned issued = 0; i + 1 < len && issued < width
+		     && values[i + 1].ready <= cycle; i += 2, ++issued) {
+		}
+		for (size_t j = 0; j < i; j += 2) {
+			values[j / 2].late  = values[j].late || values[j + 1].late;
+			values[j / 2].ready = cycle + 1;
+		}
+		memmove(&values[i / 2], &values[i], (len - i) * sizeof(*values));
+		len  -= i / 2;
+		finish = ++cycle;
+	}
+	DEL_ARR_F(values);
+	if (finish >= old_finish)
+		goto end;
+
+	DB((dbg, LEVEL_2, "rebalance %+F with %zu operands, %u to %u cycles\n",
+	    root, n, old_finish, finish));
+	ir_graph *irg   = get_irn_irg(root);
+	ir_node  *block = get_nodes_block(root);
+	dbg_info *dbgi  = get_irn_dbg_info(root);
+	ir_op    *op    = get_irn_op(root);
+	ir_mode  *mode  = get_irn_mode(root);
+	cycle = 0;
+	for (size_t len = n; len > 1;) {
+		qsort(leaves, len, sizeof(*leaves), cmp_chain_value);
+		cycle = MAX(cycle, leaves[1].ready);
+		size_t i = 0;
+		for (unsigned issued = 0; i + 1 < len && issued < width
+		     && leaves[i + 1].ready <= cycle; i += 2, ++issued) {
+			ir_node *in[] = { leaves[i].node, leaves[i + 1].node };
+			ir_node *irn  = new_ir_node(dbgi, irg, block, op, mode,
+			                            ARRAY_SIZE(in), in);
+			set_irn_link(irn, INT_TO_PTR(cycle + 1));
+			leaves[i / 2].late  = leaves[i].late || leaves[i + 1].late;
+			leaves[i / 2].node  = irn;
+			leaves[i / 2].ready = cycle + 1;
+		}
+		memmove(&leaves[i / 2], &leaves[i], (len - i) * sizeof(*leaves));
+		len -= i / 2;
+		++cycle;
+	}
+	exchange(root, leaves[0].node);
+
+end:
+	DEL_ARR_F(leaves);
+}
+
+/**
+ * Walker, collects the nodes after their operands.
+ */
+static void collect_nodes(ir_node *node, void *env)
+{
+	ir_node ***nodes = (ir_node***)env;
+	ARR_APP1(ir_node*, *nodes, node);
+}
+
+void optimize_tree_height(ir_graph *irg)
+{
+	assure_irg_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUT_EDGES);
+
+	unsigned width = be_get_backend_param()->issue_width;
+	if (width == 0)
+		width = 2;
+
+	ir_reserve_resources(irg, IR_RESOURCE_IRN_LINK);
+	ir_node **nodes = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, firm_clear_link, collect_nodes, &nodes);
+
+	/* rebalanced chains are operands of the chains following them */
+	for (size_t i = 0, n = ARR_LEN(nodes); i < n; ++i) {
+		ir_node *node = nodes[i];
+		set_ready(node);
+		if (is_chain_op(node) && is_chain_root(node))
+			rebalance_chain(node, width);
+	}
+	ir_free_resources(irg, IR_RESOURCE_IRN_LINK);
+	DEL_ARR_F(nodes);
+
+	confirm_irg_properties(irg, IR_GRAPH_PROPERTIES_CONTROL_FLOW);
+}
+
 static void register_node_reassoc_func(ir_op *op, reassociate_func func)
 {
 	op->ops.reassociate = func;
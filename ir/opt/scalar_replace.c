@@ -18,6 +18,8 @@
 #include "irouts.h"
 #include "set.h"
 #include "pset.h"
+#include "pmap.h"
+#include "obst.h"
 #include "array.h"
 #include "tv.h"
 #include "ircons_t.h"
@@ -30,6 +32,9 @@
 #include "debug.h"
 #include "error.h"
 
+/** structs with more atomic fields are not split for a CopyB */
+#define MAX_COPY_FIELDS 16
+
 static unsigned get_vnum(const ir_node *node)
 {
 	return (unsigned)PTR_TO_INT(get_irn_link(node));
@@ -70,6 +75,22 @@ typedef struct scalars_t {
 	ir_entity *ent;              /**< A entity for scalar replacement. */
 } scalars_t;
 
+/**
+ * An atomic field of a struct copied by a CopyB: the members selected from
+ * the struct to reach it and its value number.
+ */
+typedef struct copy_field_t {
+	unsigned    vnum;
+	size_t      n_members;
+	ir_entity **members;
+} copy_field_t;
+
+/** The fields of a Sel copied as a whole by a CopyB. */
+typedef struct copy_fields_t {
+	size_t       n_fields;
+	copy_field_t fields[];
+} copy_fields_t;
+
 DEBUG_ONLY(static firm_dbg_module_t *dbg;)
 
 /**
@@ -158,6 +179,39 @@ static bool check_load_store_mode(ir_mode *mode, ir_mode *ent_mode)
 	return true;
 }
 
+/**
+ * Counts the atomic fields of a struct, which are nested in structs only.
+ *
+ * @return the number of fields or MAX_COPY_FIELDS + 1 if the struct contains
+ *         arrays, unions or bitfields or has too many fields
+ */
+static size_t count_copy_fields(ir_type *type)
+{
+	if (is_atomic_type(type))
+		return get_type_mode(type) != NULL ? 1 : MAX_COPY_FIELDS + 1;
+	if (!is_Struct_type(type))
+		return MAX_COPY_FIELDS + 1;
+
+	size_t n = 0;
+	for (size_t i = 0, n_members = get_struct_n_members(type);
+	     i < n_members && n <= MAX_COPY_FIELDS; ++i) {
+		ir_entity *member = get_struct_member(type, i);
+		if (get_entity_bitfield_size(member) != 0)
+			return MAX_COPY_FIELDS + 1;
+		n += count_copy_fields(get_entity_type(member));
+	}
+	return n;
+}
+
+/**
+ * Returns true if a CopyB of a value of the given type can be done field
+ * by field.
+ */
+static bool is_splittable_type(ir_type *type)
+{
+	return is_Struct_type(type) && count_copy_fields(type) <= MAX_COPY_FIELDS;
+}
+
 /*
  * Returns non-zero, if the address of an entity
  * represented by a Sel node (or its successor Sels) is taken.
@@ -214,6 +268,15 @@ bool is_address_taken(ir_node *sel)
 			break;
 		}
 
+		case iro_CopyB: {
+			/* a copy of the whole struct is done field by field, the
+			 * address does not leave the CopyB */
+			ir_type *type = get_entity_type(get_Sel_entity(sel));
+			if (get_CopyB_type(succ) != type || !is_splittable_type(type))
+				return true;
+			break;
+		}
+
 		case iro_Call:
 			/* The address of an entity is given as a parameter.
 			 * As long as we do not have analyses that can tell what
@@ -266,6 +329,7 @@ bool is_address_taken(ir_node *sel)
 static bool link_all_leave_sels(ir_entity *ent, ir_node *sel)
 {
 	bool is_leave = true;
+	bool copied   = false;
 	for (unsigned i = get_irn_n_outs(sel); i-- > 0; ) {
 		ir_node *succ = get_irn_out(sel, i);
 
@@ -275,10 +339,13 @@ static bool link_all_leave_sels(ir_entity *ent, ir_node *sel)
 			link_all_leave_sels(ent, succ);
 		} else if (is_Id(succ)) {
 			is_leave &= link_all_leave_sels(ent, succ);
+		} else if (is_CopyB(succ)) {
+			copied = true;
 		}
 	}
 
-	if (is_leave) {
+	/* a copied Sel needs value numbers for all fields below it */
+	if (is_leave || (copied && !is_Id(sel))) {
 		/* beware of Id's */
 		sel = skip_Id(sel);
 
@@ -439,7 +506,66 @@ static path_t *find_path(ir_node *sel, size_t len)
  *
  * @return the next free value number
  */
-static unsigned allocate_value_numbers(pset *sels, ir_entity *ent, unsigned vnum, ir_mode ***modes)
+/**
+ * Returns the value number of a path, allocating a new one if the path has
+ * none yet.
+ */
+static unsigned get_path_vnum(set *pathes, path_t *key, ir_mode *mode,
+                              unsigned *vnum, ir_mode ***modes)
+{
+	path_t *path = set_find(path_t, pathes, key, path_size(key), path_hash(key));
+	if (path != NULL)
+		return path->vnum;
+
+	key->vnum = (*vnum)++;
+	(void)set_insert(path_t, pathes, key, path_size(key), path_hash(key));
+	ARR_EXTO(ir_mode *, *modes, (key->vnum + 15) & ~15);
+	(*modes)[key->vnum] = mode;
+	return key->vnum;
+}
+
+/**
+ * Appends the atomic fields of a struct to the fields of a copied Sel,
+ * allocating value numbers for them.
+ *
+ * @param fields   the fields found so far
+ * @param type     the struct
+ * @param prefix   the access path of the struct
+ * @param members  the members selected so far below the copied Sel
+ */
+static void collect_copy_fields(copy_fields_t *fields, ir_type *type,
+                                path_t *prefix, ir_entity **members,
+                                size_t n_members, set *pathes,
+                                unsigned *vnum, ir_mode ***modes,
+                                struct obstack *obst)
+{
+	for (size_t i = 0, n = get_struct_n_members(type); i < n; ++i) {
+		ir_entity *member = get_struct_member(type, i);
+		ir_type   *mtype  = get_entity_type(member);
+
+		path_t *path = XMALLOCF(path_t, path, prefix->path_len + 1);
+		path->path_len = prefix->path_len + 1;
+		memcpy(path->path, prefix->path, prefix->path_len * sizeof(path->path[0]));
+		path->path[prefix->path_len].ent = member;
+		members[n_members] = member;
+
+		if (is_Struct_type(mtype)) {
+			collect_copy_fields(fields, mtype, path, members, n_members + 1,
+			                    pathes, vnum, modes, obst);
+		} else {
+			copy_field_t *field = &fields->fields[fields->n_fields++];
+			field->vnum      = get_path_vnum(pathes, path, get_type_mode(mtype),
+			                                 vnum, modes);
+			field->n_members = n_members + 1;
+			field->members   = OALLOCN(obst, ir_entity*, n_members + 1);
+			memcpy(field->members, members, (n_members + 1) * sizeof(*members));
+		}
+		free(path);
+	}
+}
+
+static unsigned allocate_value_numbers(pset *sels, ir_entity *ent, unsigned vnum, ir_mode ***modes,
+                                       pmap *copies, struct obstack *obst)
 {
 	set *pathes = new_set(path_cmp, 8);
 
@@ -450,10 +576,28 @@ static unsigned allocate_value_numbers(pset *sels, ir_entity *ent, unsigned vnum
 	     sel = next) {
 		next = (ir_node*)get_irn_link(sel);
 
+		path_t  *key  = find_path(sel, 0);
+		ir_type *type = get_entity_type(get_Sel_entity(sel));
+		if (is_Struct_type(type)) {
+			/* only used by CopyBs, which are done field by field */
+			size_t          n_fields = count_copy_fields(type);
+			copy_fields_t  *fields   = (copy_fields_t*)obstack_alloc(obst,
+				sizeof(*fields) + n_fields * sizeof(fields->fields[0]));
+			ir_entity     **members  = ALLOCAN(ir_entity*, n_fields);
+			fields->n_fields = 0;
+			/* a struct nests at most as deep as it has fields */
+			collect_copy_fields(fields, type, key, members, 0, pathes, &vnum,
+			                    modes, obst);
+			assert(fields->n_fields == n_fields);
+			pmap_insert(copies, sel, fields);
+			DB((dbg, SET_LEVEL_3, "  %+F is copied as %zu values\n", sel, n_fields));
+			free(key);
+			continue;
+		}
+
 		/* we must mark this sel for later */
 		pset_insert_ptr(sels, sel);
 
-		path_t *key  = find_path(sel, 0);
 		path_t *path = set_find(path_t, pathes, key, path_size(key), path_hash(key));
 
 		if (path) {
@@ -500,8 +644,68 @@ typedef struct env_t {
 	unsigned nvals;      /**< number of values */
 	ir_mode  **modes;    /**< the modes of the values */
 	pset     *sels;      /**< A set of all Sel nodes that have a value number */
+	pmap     *copies;    /**< the fields of the copied Sels */
 } env_t;
 
+/**
+ * Selects a field of the struct at @p ptr.
+ */
+static ir_node *new_field_sel(ir_node *block, ir_node *ptr,
+                              const copy_field_t *field)
+{
+	ir_graph *irg = get_irn_irg(block);
+	for (size_t i = 0; i < field->n_members; ++i)
+		ptr = new_r_simpleSel(block, get_irg_no_mem(irg), ptr, field->members[i]);
+	return ptr;
+}
+
+/**
+ * Replaces a CopyB from or to a scalar replaced struct by copying the
+ * fields. A side which is not replaced is accessed with Loads and Stores
+ * of the fields, so the struct is only materialized where it is copied to
+ * memory.
+ */
+static void replace_copyb(ir_node *copyb, env_t *env)
+{
+	ir_node       *dst        = get_CopyB_dst(copyb);
+	ir_node       *src        = get_CopyB_src(copyb);
+	copy_fields_t *dst_fields = pmap_get(copy_fields_t, env->copies, skip_Id(dst));
+	copy_fields_t *src_fields = pmap_get(copy_fields_t, env->copies, skip_Id(src));
+	if (dst_fields == NULL && src_fields == NULL)
+		return;
+
+	DB((dbg, SET_LEVEL_3, "  replacing %+F by field copies\n", copyb));
+	ir_node  *block  = get_nodes_block(copyb);
+	ir_node  *mem    = get_CopyB_mem(copyb);
+	dbg_info *dbgi   = get_irn_dbg_info(copyb);
+	/* both sides have the same type, so the fields are the same */
+	copy_fields_t *fields = src_fields != NULL ? src_fields : dst_fields;
+	set_cur_block(block);
+	for (size_t i = 0; i < fields->n_fields; ++i) {
+		copy_field_t const *const field = &fields->fields[i];
+		ir_mode            *const mode  = env->modes[field->vnum];
+
+		ir_node *val;
+		if (src_fields != NULL) {
+			val = get_value(src_fields->fields[i].vnum, mode);
+		} else {
+			ir_node *ptr  = new_field_sel(block, src, field);
+			ir_node *load = new_rd_Load(dbgi, block, mem, ptr, mode, cons_none);
+			mem = new_r_Proj(load, mode_M, pn_Load_M);
+			val = new_r_Proj(load, mode, pn_Load_res);
+		}
+
+		if (dst_fields != NULL) {
+			set_value(dst_fields->fields[i].vnum, val);
+		} else {
+			ir_node *ptr   = new_field_sel(block, dst, field);
+			ir_node *store = new_rd_Store(dbgi, block, mem, ptr, val, cons_none);
+			mem = new_r_Proj(store, mode_M, pn_Store_M);
+		}
+	}
+	exchange(copyb, mem);
+}
+
 /**
  * topological post-walker.
  */
@@ -510,7 +714,9 @@ static void walker(ir_node *node, void *ctx)
 	env_t    *env = (env_t*)ctx;
 	ir_graph *irg = get_irn_irg(node);
 
-	if (is_Load(node)) {
+	if (is_CopyB(node)) {
+		replace_copyb(node, env);
+	} else if (is_Load(node)) {
 		/* a load, check if we can resolve it */
 		ir_node *addr = get_Load_ptr(node);
 
@@ -605,8 +811,8 @@ static void walker(ir_node *node, void *ctx)
  * @param modes   A flexible array, containing all the modes of
  *                the value numbers.
  */
-static void do_scalar_replacements(ir_graph *irg, pset *sels, unsigned nvals,
-                                   ir_mode **modes)
+static void do_scalar_replacements(ir_graph *irg, pset *sels, pmap *copies,
+                                   unsigned nvals, ir_mode **modes)
 {
 	ssa_cons_start(irg, (int)nvals);
 
@@ -618,7 +824,8 @@ static void do_scalar_replacements(ir_graph *irg, pset *sels, unsigned nvals,
 	env_t env;
 	env.nvals = nvals;
 	env.modes = modes;
-	env.sels  = sels;
+	env.sels   = sels;
+	env.copies = copies;
 	irg_walk_blkwise_graph(irg, NULL, walker, &env);
 
 	ssa_cons_finish(irg);
@@ -649,6 +856,9 @@ void scalar_replacement_opt(ir_graph *irg)
 		ir_mode **modes     = NEW_ARR_F(ir_mode *, 16);
 		set      *set_ent   = new_set(ent_cmp, 8);
 		pset     *sels      = pset_new_ptr(8);
+		pmap     *copies    = pmap_create();
+		struct obstack obst;
+		obstack_init(&obst);
 		ir_type  *frame_tp  = get_irg_frame_type(irg);
 
 		for (unsigned i = get_irn_n_outs(irg_frame); i-- > 0; ) {
@@ -684,7 +894,8 @@ void scalar_replacement_opt(ir_graph *irg)
 				}
 #endif /* DEBUG_libfirm */
 
-				nvals = allocate_value_numbers(sels, ent, nvals, &modes);
+				nvals = allocate_value_numbers(sels, ent, nvals, &modes, copies,
+				                               &obst);
 			}
 		}
 
@@ -692,7 +903,7 @@ void scalar_replacement_opt(ir_graph *irg)
 
 		/* If scalars were found. */
 		if (nvals > 0) {
-			do_scalar_replacements(irg, sels, nvals, modes);
+			do_scalar_replacements(irg, sels, copies, nvals, modes);
 
 			foreach_set(set_ent, scalars_t, value) {
 				free_entity(value->ent);
@@ -704,6 +915,8 @@ void scalar_replacement_opt(ir_graph *irg)
 			 * consistent.
 			 */
 		}
+		obstack_free(&obst, NULL);
+		pmap_destroy(copies);
 		del_pset(sels);
 		del_set(set_ent);
 		DEL_ARR_F(modes);
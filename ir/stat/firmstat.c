@@ -200,6 +200,8 @@ static void opcode_clear_entry(node_entry_t *elem)
 	cnt_clr(&elem->new_node);
 	cnt_clr(&elem->into_Id);
 	cnt_clr(&elem->normalized);
+	for (int i = 0; i < _nmem_last; ++i)
+		cnt_clr(&elem->mem[i]);
 }
 
 /**
@@ -885,6 +887,13 @@ static void update_node_stat(ir_node *node, void *env)
 	cnt_inc(&entry->cnt_alive);
 	cnt_add_i(&graph->cnt[gcnt_edges], arity);
 
+	/* count the memory of the node */
+	unsigned mem[_nmem_last];
+	size_t   obst_bytes = stat_get_irn_memory(node, mem);
+	for (i = 0; i < _nmem_last; ++i)
+		cnt_add_i(&entry->mem[i], mem[i]);
+	cnt_add_i(&graph->cnt[gcnt_mem_live_nodes], obst_bytes);
+
 	/* count block edges */
 	undate_block_info(node, graph);
 
@@ -1094,6 +1103,15 @@ static void update_graph_stat(graph_entry_t *global, graph_entry_t *graph)
 	/* clear first the alive counter in the graph */
 	foreach_pset(graph->opcode_hash, node_entry_t, entry) {
 		cnt_clr(&entry->cnt_alive);
+		for (i = 0; i < _nmem_last; ++i)
+			cnt_clr(&entry->mem[i]);
+	}
+
+	/* where the memory of the graph goes */
+	for (ir_graph_memory_kind kind = ir_graph_memory_nodes;
+	     kind <= ir_graph_memory_last; ++kind) {
+		cnt_add_i(&graph->cnt[gcnt_mem_kind + kind],
+		          ir_get_irg_memory_used(graph->irg, kind));
 	}
 
 	/* set pessimistic values */
@@ -1124,6 +1142,8 @@ static void update_graph_stat(graph_entry_t *global, graph_entry_t *graph)
 
 		/* update the node counter */
 		cnt_add(&g_entry->cnt_alive, &entry->cnt_alive);
+		for (i = 0; i < _nmem_last; ++i)
+			cnt_add(&g_entry->mem[i], &entry->mem[i]);
 	}
 
 	/* count the number of address calculation */
@@ -209,6 +209,21 @@ typedef struct address_mark_entry_t {
   unsigned mark;                /**< the mark, a bitmask of enum adr_marker_t */
 } address_mark_entry_t;
 
+/**
+ * Node memory indexes: where the bytes of the alive nodes go.
+ */
+enum node_memory_names {
+	nmem_header,                   /**< the common part of struct ir_node */
+	nmem_attr,                     /**< the opcode specific attributes */
+	nmem_in,                       /**< the in array including the block */
+	nmem_deps,                     /**< the dependency array */
+	nmem_edges,                    /**< the out edges pointing to the node */
+	nmem_outs,                     /**< the Def-Use array of the outs */
+
+	/* --- must be the last enum constant --- */
+	_nmem_last                     /**< number of node memory counters */
+};
+
 /**
  * An entry for ir_nodes, used in ir_graph statistics.
  */
@@ -217,6 +232,7 @@ typedef struct node_entry_t {
 	counter_t   new_node;     /**< amount of new nodes for this entry */
 	counter_t   into_Id;      /**< amount of nodes that turned into Id's for this entry */
 	counter_t   normalized;   /**< amount of nodes that normalized for this entry */
+	counter_t   mem[_nmem_last]; /**< bytes used by the alive nodes of this entry */
 	const ir_op *op;          /**< the op for this entry */
 } node_entry_t;
 
@@ -255,7 +271,9 @@ enum graph_counter_names {
 	gcnt_param_adr,                /**< number of parameter load/store addresses. */
 	gcnt_this_adr,                 /**< number of this load/store addresses. */
 	gcnt_other_adr,                /**< number of other load/store addresses. */
-	gcnt_if_conv,                  /**< number of if conversions */
+	gcnt_mem_live_nodes,           /**< bytes of the alive nodes on the node obstack */
+	gcnt_mem_kind,                 /**< bytes per ir_graph_memory_kind, indexed from here */
+	gcnt_if_conv = gcnt_mem_kind + ir_graph_memory_last + 1, /**< number of if conversions */
 
 	/* --- must be the last enum constant --- */
 	_gcnt_last = gcnt_if_conv + IF_RESULT_LAST                 /**< number of counters */
@@ -554,6 +572,16 @@ typedef void (*eval_distrib_entry_fun)(const distrib_entry_t *entry, void *env);
  */
 void stat_iterate_distrib_tbl(const distrib_tbl_t *tbl, eval_distrib_entry_fun eval, void *env);
 
+/**
+ * Calculates the memory used by a node.
+ *
+ * @param node  the node
+ * @param mem   receives the bytes per enum node_memory_names
+ *
+ * @return the bytes of the node's allocation on the node obstack of its graph
+ */
+size_t stat_get_irn_memory(const ir_node *node, unsigned mem[_nmem_last]);
+
 /**
  * update info on Consts.
  *
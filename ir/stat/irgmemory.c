@@ -0,0 +1,114 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Accounting of the memory allocated per graph.
+ *
+ * The numbers are taken from the obstacks and hash sets of a graph when they
+ * are asked for, so the accounting costs nothing while the passes run.
+ */
+#include "firmstat_t.h"
+#include "array_t.h"
+#include "error.h"
+#include "irgraph_t.h"
+#include "irnode_t.h"
+#include "iredges_t.h"
+#include "beirg.h"
+
+/** the memory budget of a single graph, 0 if unlimited */
+static size_t irg_memory_budget;
+
+static size_t obstack_bytes(const struct obstack *obst)
+{
+	return (size_t)obstack_memory_used((struct obstack*)obst);
+}
+
+static size_t get_edges_memory_used(const ir_graph *irg)
+{
+	size_t res = 0;
+	for (ir_edge_kind_t kind = EDGE_KIND_FIRST; kind <= EDGE_KIND_LAST; ++kind) {
+		const irg_edge_info_t *const info = &irg->edge_info[kind];
+		if (!info->allocated)
+			continue;
+		res += obstack_bytes(&info->edges_obst)
+		     + info->edges.num_buckets * sizeof(info->edges.entries[0]);
+	}
+	return res;
+}
+
+size_t ir_get_irg_memory_used(const ir_graph *irg, ir_graph_memory_kind kind)
+{
+	switch (kind) {
+	case ir_graph_memory_nodes:
+		return obstack_bytes(&irg->obst);
+	case ir_graph_memory_edges:
+		return get_edges_memory_used(irg);
+	case ir_graph_memory_outs:
+		return irg->outs_size;
+	case ir_graph_memory_backend:
+		return be_get_birg_memory_used(irg);
+	case ir_graph_memory_liveness:
+		return be_get_irg_liveness_memory_used(irg);
+	}
+	panic("invalid graph memory kind");
+}
+
+size_t ir_get_irg_memory_total(const ir_graph *irg)
+{
+	size_t res = 0;
+	for (ir_graph_memory_kind kind = ir_graph_memory_nodes;
+	     kind <= ir_graph_memory_last; ++kind) {
+		res += ir_get_irg_memory_used(irg, kind);
+	}
+	return res;
+}
+
+size_t stat_get_irn_memory(const ir_node *node, unsigned mem[_nmem_last])
+{
+	/* mirrors the allocation in new_ir_node() */
+	const ir_op *op        = get_irn_op(node);
+	size_t const node_size = offsetof(ir_node, attr) + op->attr_size;
+	size_t const in_offset = (node_size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+	size_t const in_size   = ARR_D_SIZE(ir_node*, ARR_DESCR(node->in)->allocated);
+	bool   const in_inline = (const char*)ARR_DESCR(node->in)
+	                         == (const char*)node + in_offset;
+
+	mem[nmem_header] = offsetof(ir_node, attr);
+	mem[nmem_attr]   = op->attr_size;
+	mem[nmem_in]     = in_size;
+	mem[nmem_deps]   = node->deps != NULL
+		? ARR_D_SIZE(ir_node*, ARR_DESCR(node->deps)->allocated) : 0;
+
+	/* edges and outs are accounted at the node they point to */
+	ir_graph *irg = get_irn_irg(node);
+	mem[nmem_edges] = 0;
+	for (ir_edge_kind_t kind = EDGE_KIND_FIRST; kind <= EDGE_KIND_LAST; ++kind) {
+		if (edges_activated_kind(irg, kind))
+			mem[nmem_edges] += get_irn_n_edges_kind(node, kind) * sizeof(ir_edge_t);
+	}
+	mem[nmem_outs] = irg_has_properties(irg, IR_GRAPH_PROPERTY_CONSISTENT_OUTS)
+		? sizeof(ir_def_use_edges)
+		  + node->o.out->n_edges * sizeof(ir_def_use_edge)
+		: 0;
+
+	return in_inline ? in_offset + in_size : node_size;
+}
+
+void ir_set_irg_memory_budget(size_t bytes)
+{
+	irg_memory_budget = bytes;
+}
+
+size_t ir_get_irg_memory_budget(void)
+{
+	return irg_memory_budget;
+}
+
+bool irg_memory_budget_exceeded(const ir_graph *irg)
+{
+	return irg_memory_budget != 0
+	    && ir_get_irg_memory_total(irg) > irg_memory_budget;
+}
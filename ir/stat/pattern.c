@@ -19,6 +19,8 @@
 #include "irprog.h"
 #include "set.h"
 #include "pset.h"
+#include "array.h"
+#include "xmalloc.h"
 #include "counter.h"
 #include "pattern_dmp.h"
 #include "hashptr.h"
@@ -85,6 +87,7 @@ enum options_t {
 	OPT_ENC_DAG         = 0x00000002, /**< encode DAGs, not terms */
 	OPT_WITH_ICONST     = 0x00000004, /**< encode integer constants */
 	OPT_PERSIST_PATTERN = 0x00000008, /**< persistent pattern hash */
+	OPT_HASH_COUNT      = 0x00000010, /**< count by incremental pattern hashes */
 };
 
 
@@ -95,6 +98,7 @@ typedef struct pattern_info_t {
 	int                       enable;         /**< If non-zero, this module is enabled. */
 	struct obstack            obst;           /**< An obstack containing the counters. */
 	HASH_MAP(pattern_entry_t) *pattern_hash;  /**< A hash map containing the pattern. */
+	set                       *hash_map;      /**< Maps incremental hashes to pattern. */
 	unsigned                  bound;          /**< Lowest value for pattern output. */
 	unsigned                  options;        /**< Current option mask. */
 	unsigned                  min_depth;      /**< Minimum pattern depth. */
@@ -511,7 +515,7 @@ static int encode_node(ir_node *node, CODE_BUFFER *buf, int max_depth)
 	/* initialize the encoder environment */
 	env.buf     = buf;
 	env.curr_id = 1;  /* 0 is used for special purpose */
-	env.options = status->options;
+	env.options = status->options & ~OPT_HASH_COUNT;
 	env.dmp     = NULL;
 
 	if (env.options & OPT_ENC_DAG)
@@ -703,17 +707,16 @@ static void count_pattern(CODE_BUFFER *buf, int depth)
 }
 
 /**
- * Pre-walker for nodes pattern calculation.
+ * Encodes the pattern of depth @p max_depth rooted at @p node and counts it.
  */
-static void calc_nodes_pattern(ir_node *node, void *ctx)
+static void count_encoded_pattern(ir_node *node, int max_depth)
 {
-	pattern_env_t   *env = (pattern_env_t*)ctx;
 	BYTE            buffer[PATTERN_STORE_SIZE];
 	CODE_BUFFER     buf;
 	int             depth;
 
 	init_buf(&buf, buffer, sizeof(buffer));
-	depth = encode_node(node, &buf, env->max_depth);
+	depth = encode_node(node, &buf, max_depth);
 
 	if (buf_overrun(&buf)) {
 		lc_fprintf(stderr, "Pattern store: buffer overrun at size %zu. Pattern ignored.\n", sizeof(buffer));
@@ -721,6 +724,213 @@ static void calc_nodes_pattern(ir_node *node, void *ctx)
 		count_pattern(&buf, depth);
 }
 
+/**
+ * Pre-walker for nodes pattern calculation.
+ */
+static void calc_nodes_pattern(ir_node *node, void *ctx)
+{
+	pattern_env_t *env = (pattern_env_t*)ctx;
+	count_encoded_pattern(node, env->max_depth);
+}
+
+/**
+ * Maps an incremental pattern hash to the pattern entry of the first node
+ * seen with this hash.
+ */
+typedef struct hash_entry_t {
+	unsigned         hash;  /**< the incremental pattern hash */
+	unsigned         depth; /**< the pattern depth */
+	pattern_entry_t *entry; /**< the pattern entry */
+} hash_entry_t;
+
+static int hash_entry_cmp(const void *p1, const void *p2, size_t size)
+{
+	const hash_entry_t *e1 = (const hash_entry_t*)p1;
+	const hash_entry_t *e2 = (const hash_entry_t*)p2;
+	(void) size;
+
+	return e1->hash != e2->hash || e1->depth != e2->depth;
+}
+
+/**
+ * The incremental pattern hashes of a graph.
+ *
+ * The hash of the pattern of depth d rooted at a node is combined from the
+ * node's own code and the depth d-1 hashes of its operands, so all depths
+ * are computed level by level in time linear in the graph size. The same
+ * recurrence tracks whether a pattern reaches its full depth, which decides
+ * whether encode_node() would count it.
+ */
+typedef struct pattern_hashes_t {
+	ir_node      **nodes;  /**< all nodes of the graph */
+	unsigned       n_idx;  /**< number of node indices */
+	unsigned      *hashes; /**< hashes[(d-1) * n_idx + idx] for depth d */
+	unsigned char *reach;  /**< reach[(d-1) * n_idx + idx] if depth d reached */
+} pattern_hashes_t;
+
+static void collect_node(ir_node *node, void *ctx)
+{
+	pattern_hashes_t *ph = (pattern_hashes_t*)ctx;
+	ARR_APP1(ir_node*, ph->nodes, node);
+}
+
+/**
+ * Returns the hash of the node's own code as written by _encode_node().
+ */
+static unsigned node_code_hash(const ir_node *node)
+{
+	unsigned hash = get_irn_opcode(node);
+
+	if (status->options & OPT_WITH_MODE) {
+		ir_mode *mode = get_irn_mode(node);
+		hash = hash_combine(hash, mode != NULL ? find_mode_index(mode) + 1 : 0);
+	}
+	if ((status->options & OPT_WITH_ICONST) && is_Const(node)) {
+		ir_tarval *tv = get_Const_tarval(node);
+		if (tarval_is_long(tv))
+			hash = hash_combine(hash, (unsigned)get_tarval_long(tv));
+	}
+	return hash;
+}
+
+/**
+ * Computes the depth @p depth hashes of all nodes from the depth-1 ones.
+ */
+static void calc_depth_hashes(pattern_hashes_t *ph, unsigned depth)
+{
+	unsigned      *hashes = ph->hashes + (depth - 1) * ph->n_idx;
+	unsigned char *reach  = ph->reach  + (depth - 1) * ph->n_idx;
+	unsigned      *prev_hashes = hashes - ph->n_idx;
+	unsigned char *prev_reach  = reach  - ph->n_idx;
+
+	for (size_t i = 0, n = ARR_LEN(ph->nodes); i < n; ++i) {
+		ir_node *node  = ph->nodes[i];
+		unsigned idx   = get_irn_idx(node);
+		unsigned hash  = node_code_hash(node);
+		int      arity = get_irn_arity(node);
+
+		if (depth == 1 || arity == 0) {
+			hashes[idx] = hash_combine(hash, 0);
+			reach[idx]  = depth == 1;
+			continue;
+		}
+
+		hash = hash_combine(hash, arity);
+		bool reached = false;
+		if (is_op_commutative(get_irn_op(node))) {
+			/* order the operands like _encode_node() does, break ties by
+			 * hash to be independent of the operand order */
+			ir_node *l  = get_binop_left(node);
+			ir_node *r  = get_binop_right(node);
+			unsigned hl = prev_hashes[get_irn_idx(l)];
+			unsigned hr = prev_hashes[get_irn_idx(r)];
+			int opcode_diff = (int)get_irn_opcode(l) - (int)get_irn_opcode(r);
+			if (opcode_diff > 0 || (opcode_diff == 0 && hl > hr)) {
+				unsigned t = hl;
+				hl = hr;
+				hr = t;
+			}
+			hash = hash_combine(hash_combine(hash, hl), hr);
+			if (status->options & OPT_ENC_DAG)
+				hash = hash_combine(hash, l == r);
+			reached = prev_reach[get_irn_idx(l)] || prev_reach[get_irn_idx(r)];
+		} else {
+			for (int p = 0; p < arity; ++p) {
+				ir_node *pred = get_irn_n(node, p);
+				unsigned pidx = get_irn_idx(pred);
+				hash     = hash_combine(hash, prev_hashes[pidx]);
+				reached |= prev_reach[pidx];
+				/* a DAG encoding refers back to operands seen before */
+				if (status->options & OPT_ENC_DAG) {
+					for (int q = 0; q < p; ++q) {
+						if (get_irn_n(node, q) == pred)
+							hash = hash_combine(hash, q + 1);
+					}
+				}
+			}
+		}
+		hashes[idx] = hash;
+		reach[idx]  = reached;
+	}
+}
+
+/**
+ * Counts the pattern of depth @p depth rooted at @p node. The pattern is
+ * only encoded if its hash was not seen before.
+ */
+static void count_hashed_pattern(ir_node *node, unsigned depth, unsigned hash)
+{
+	hash_entry_t key;
+	key.hash  = hash;
+	key.depth = depth;
+	key.entry = NULL;
+
+	unsigned      set_hash = hash_combine(hash, depth);
+	hash_entry_t *he       = set_find(hash_entry_t, status->hash_map, &key,
+	                                  sizeof(key), set_hash);
+	if (he != NULL) {
+		cnt_inc(&he->entry->count);
+		return;
+	}
+
+	BYTE        buffer[PATTERN_STORE_SIZE];
+	CODE_BUFFER buf;
+
+	init_buf(&buf, buffer, sizeof(buffer));
+	int enc_depth = encode_node(node, &buf, depth);
+	if (buf_overrun(&buf)) {
+		lc_fprintf(stderr, "Pattern store: buffer overrun at size %zu. Pattern ignored.\n", sizeof(buffer));
+		return;
+	}
+	/* Patterns cut short by a reference are not counted. Such a hash is not
+	 * remembered, as other nodes with the same hash may share less. */
+	if (enc_depth <= 1)
+		return;
+
+	key.entry = pattern_get_entry(&buf, status->pattern_hash);
+	cnt_inc(&key.entry->count);
+	(void)set_insert(hash_entry_t, status->hash_map, &key, sizeof(key),
+	                 set_hash);
+}
+
+/**
+ * Counts all patterns of a graph using incremental pattern hashes.
+ */
+static void calc_hashed_pattern_history(ir_graph *irg)
+{
+	pattern_hashes_t ph;
+	unsigned         max_depth = status->max_depth;
+
+	ph.nodes  = NEW_ARR_F(ir_node*, 0);
+	irg_walk_graph(irg, collect_node, NULL, &ph);
+	ph.n_idx  = get_irg_last_idx(irg);
+	ph.hashes = XMALLOCN(unsigned, (size_t)ph.n_idx * max_depth);
+	ph.reach  = XMALLOCN(unsigned char, (size_t)ph.n_idx * max_depth);
+
+	for (unsigned depth = 1; depth <= max_depth; ++depth) {
+		calc_depth_hashes(&ph, depth);
+		if (depth < status->min_depth)
+			continue;
+
+		size_t base = (size_t)(depth - 1) * ph.n_idx;
+		for (size_t i = 0, n = ARR_LEN(ph.nodes); i < n; ++i) {
+			ir_node *node = ph.nodes[i];
+			unsigned idx  = get_irn_idx(node);
+			if (ph.reach[base + idx]) {
+				count_hashed_pattern(node, depth, ph.hashes[base + idx]);
+			} else if (status->options & OPT_ENC_DAG) {
+				/* a shallow pattern still counts if it refers to a node
+				 * twice, encoding it is cheap */
+				count_encoded_pattern(node, depth);
+			}
+		}
+	}
+
+	free(ph.reach);
+	free(ph.hashes);
+	DEL_ARR_F(ph.nodes);
+}
+
 /**
  * Store all collected patterns.
  *
@@ -864,6 +1074,11 @@ void stat_calc_pattern_history(ir_graph *irg)
 	if (irg == get_const_code_irg())
 		return;
 
+	if (status->options & OPT_HASH_COUNT) {
+		calc_hashed_pattern_history(irg);
+		return;
+	}
+
 	for (i = status->min_depth; i <= status->max_depth; ++i) {
 		env.max_depth = i;
 		irg_walk_graph(irg, calc_nodes_pattern, NULL, &env);
@@ -882,7 +1097,7 @@ void stat_init_pattern_history(int enable)
 		return;
 
 	status->bound     = 10;
-	status->options   = /* OPT_WITH_MODE | */ OPT_ENC_DAG | OPT_WITH_ICONST | OPT_PERSIST_PATTERN;
+	status->options   = /* OPT_WITH_MODE | */ OPT_ENC_DAG | OPT_WITH_ICONST | OPT_PERSIST_PATTERN | OPT_HASH_COUNT;
 	status->min_depth = 3;
 	status->max_depth = 5;
 
@@ -894,6 +1109,7 @@ void stat_init_pattern_history(int enable)
 	if (pattern_hash == NULL)
 		pattern_hash = new_pset(pattern_cmp, 8);
 	status->pattern_hash = pattern_hash;
+	status->hash_map     = new_set(hash_entry_cmp, 256);
 }
 
 /*
@@ -908,6 +1124,7 @@ void stat_finish_pattern_history(const char *fname)
 	store_pattern("pattern.fps");
 	pattern_output("pattern.vcg");
 
+	del_set(status->hash_map);
 	del_pset(status->pattern_hash);
 	obstack_free(&status->obst, NULL);
 
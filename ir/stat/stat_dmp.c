@@ -208,6 +208,73 @@ static void simple_dump_opcode_hash(dumper_t *dmp, pset *set)
 	);
 }
 
+/**
+ * dumps the memory used by the alive nodes per opcode
+ */
+static void simple_dump_opcode_memory(dumper_t *dmp, pset *set)
+{
+	static const char *const mem_names[_nmem_last] = {
+		"header", "attr", "in", "deps", "edges", "outs"
+	};
+	counter_t f_alive;
+	counter_t f_mem[_nmem_last];
+	int       i;
+
+	cnt_clr(&f_alive);
+	for (i = 0; i < _nmem_last; ++i)
+		cnt_clr(&f_mem[i]);
+
+	fprintf(dmp->f, "\n%-16s", "Opcode bytes");
+	for (i = 0; i < _nmem_last; ++i)
+		fprintf(dmp->f, " %-9s", mem_names[i]);
+	fprintf(dmp->f, " %-9s %-9s\n", "total", "per node");
+	foreach_pset(set, node_entry_t, entry) {
+		double total = 0.0;
+
+		fprintf(dmp->f, "%-16s", get_id_str(entry->op->name));
+		for (i = 0; i < _nmem_last; ++i) {
+			fprintf(dmp->f, " %9u", cnt_to_uint(&entry->mem[i]));
+			total += cnt_to_dbl(&entry->mem[i]);
+			cnt_add(&f_mem[i], &entry->mem[i]);
+		}
+		fprintf(dmp->f, " %9.0f %9.1f\n", total,
+			cnt_eq(&entry->cnt_alive, 0) ? 0.0 : total / cnt_to_dbl(&entry->cnt_alive));
+		cnt_add(&f_alive, &entry->cnt_alive);
+	}
+	fprintf(dmp->f, "-------------------------------------------\n");
+
+	double total = 0.0;
+	fprintf(dmp->f, "%-16s", "Sum");
+	for (i = 0; i < _nmem_last; ++i) {
+		fprintf(dmp->f, " %9u", cnt_to_uint(&f_mem[i]));
+		total += cnt_to_dbl(&f_mem[i]);
+	}
+	fprintf(dmp->f, " %9.0f %9.1f\n", total,
+		cnt_eq(&f_alive, 0) ? 0.0 : total / cnt_to_dbl(&f_alive));
+}
+
+/**
+ * dumps where the memory of a graph goes
+ */
+static void simple_dump_graph_memory(dumper_t *dmp, const graph_entry_t *entry)
+{
+	static const char *const kind_names[ir_graph_memory_last + 1] = {
+		"node obstack", "out edges", "outs", "backend", "liveness"
+	};
+	double nodes = cnt_to_dbl(&entry->cnt[gcnt_mem_kind + ir_graph_memory_nodes]);
+	double alive = cnt_to_dbl(&entry->cnt[gcnt_mem_live_nodes]);
+
+	fprintf(dmp->f, "\nGraph memory:\n");
+	for (int kind = 0; kind <= ir_graph_memory_last; ++kind) {
+		fprintf(dmp->f, " %-25s : %u\n", kind_names[kind],
+			cnt_to_uint(&entry->cnt[gcnt_mem_kind + kind]));
+	}
+	fprintf(dmp->f, " node obstack, alive nodes : %.0f (%.1f%%)\n", alive,
+		nodes > 0 ? 100.0 * alive / nodes : 0.0);
+	fprintf(dmp->f, " node obstack, other       : %.0f\n",
+		nodes > alive ? nodes - alive : 0.0);
+}
+
 /**
  * Return the name of an optimization.
  */
@@ -517,6 +584,8 @@ static void simple_dump_graph(dumper_t *dmp, graph_entry_t *entry)
 	);
 
 	simple_dump_opcode_hash(dmp, entry->opcode_hash);
+	simple_dump_opcode_memory(dmp, entry->opcode_hash);
+	simple_dump_graph_memory(dmp, entry);
 	simple_dump_edges(dmp, &entry->cnt[gcnt_edges]);
 
 	/* effects of optimizations */
@@ -8,23 +8,63 @@
  * @brief       Statistic events.
  * @author      Sebastian Hack
  * @date        17.06.2007
+ *
+ * Events are either written as text lines or in a compact binary format.
+ * The binary format starts with the magic "FIRMSEVB", followed by the 32bit
+ * value 0x01020304 in the byte order of the writer and the 32bit format
+ * version. Then a sequence of records follows, each starting with a tag byte
+ * and the 32bit number of its key:
+ *  - 'K' key, 16bit length, characters: defines the name of a key, written
+ *                                       before the first use of the key
+ *  - 'P' key, 16bit length, characters: pushes a context
+ *  - 'O' key:                           pops a context
+ *  - 'd' key, double:                   event with a double value
+ *  - 'i' key, 64bit signed integer:     event with an int value
+ *  - 'u' key, 64bit unsigned integer:   event with an unsigned value
+ *  - 'e' key:                           event without value
+ * The records are collected in a buffer which is written out when it is full,
+ * so the cost of an event is a lookup of the key and a memcpy. Whether a key
+ * passes the filter is decided once per key.
  */
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 #include <regex.h>
 #include <assert.h>
 
 #include "stat_timing.h"
 #include "irprintf.h"
 #include "statev_t.h"
+#include "hashptr.h"
+#include "set.h"
 #include "util.h"
+#include "xmalloc.h"
 
 #define MAX_TIMER 256
 
+/** size of the buffer for binary records */
+#define STAT_EV_BUFFER_SIZE (64 * 1024)
+/** version of the binary format */
+#define STAT_EV_BINARY_VERSION 1
+
 int (stat_ev_enabled) = 0;
 
+/** A key of the binary format. */
+typedef struct stat_ev_key_t {
+	uint32_t nr;
+	bool     matches; /**< the key passes the filter */
+	char     name[];
+} stat_ev_key_t;
+
 static FILE          *stat_ev_file     = NULL;
+static bool           stat_ev_binary;
+static set           *stat_ev_keys;
+static uint32_t       stat_ev_n_keys;
+static size_t         stat_ev_buffer_len;
+static unsigned char  stat_ev_buffer[STAT_EV_BUFFER_SIZE];
 static int            stat_ev_timer_sp = 0;
 static timing_ticks_t stat_ev_timer_elapsed[MAX_TIMER];
 static timing_ticks_t stat_ev_timer_start[MAX_TIMER];
@@ -39,8 +79,102 @@ static inline int key_matches(const char *key)
 	return regexec(filter, key, 0, NULL, 0) == 0;
 }
 
+static void stat_ev_flush(void)
+{
+	fwrite(stat_ev_buffer, 1, stat_ev_buffer_len, stat_ev_file);
+	stat_ev_buffer_len = 0;
+}
+
+static void stat_ev_put(const void *data, size_t size)
+{
+	assert(size <= sizeof(stat_ev_buffer));
+	if (stat_ev_buffer_len + size > sizeof(stat_ev_buffer))
+		stat_ev_flush();
+	memcpy(&stat_ev_buffer[stat_ev_buffer_len], data, size);
+	stat_ev_buffer_len += size;
+}
+
+static void stat_ev_put_record(char tag, uint32_t key)
+{
+	unsigned char rec[1 + sizeof(key)];
+	rec[0] = (unsigned char)tag;
+	memcpy(&rec[1], &key, sizeof(key));
+	stat_ev_put(rec, sizeof(rec));
+}
+
+static void stat_ev_put_str(const char *str)
+{
+	size_t const   len  = strlen(str);
+	uint16_t const len16 = len > UINT16_MAX ? UINT16_MAX : (uint16_t)len;
+	stat_ev_put(&len16, sizeof(len16));
+	stat_ev_put(str, len16);
+}
+
+static int cmp_key(const void *elt, const void *key, size_t size)
+{
+	(void)size;
+	return strcmp(((const stat_ev_key_t*)elt)->name,
+	              ((const stat_ev_key_t*)key)->name);
+}
+
+/**
+ * Returns the key entry of @p name, defining it in the binary stream on its
+ * first use.
+ */
+static const stat_ev_key_t *get_key(const char *name)
+{
+	size_t         const len  = strlen(name);
+	size_t         const size = sizeof(stat_ev_key_t) + len + 1;
+	unsigned       const hash = hash_str(name);
+	stat_ev_key_t *const tmpl = (stat_ev_key_t*)ALLOCAN(char, size);
+	memcpy(tmpl->name, name, len + 1);
+
+	stat_ev_key_t *key = set_find(stat_ev_key_t, stat_ev_keys, tmpl, size, hash);
+	if (key == NULL) {
+		tmpl->nr      = stat_ev_n_keys++;
+		tmpl->matches = key_matches(name);
+		key = set_insert(stat_ev_key_t, stat_ev_keys, tmpl, size, hash);
+		if (key->matches) {
+			stat_ev_put_record('K', key->nr);
+			stat_ev_put_str(name);
+		}
+	}
+	return key;
+}
+
+static void stat_ev_binary_vprintf(char ev, const char *name, const char *fmt,
+                                   va_list ap)
+{
+	const stat_ev_key_t *const key = get_key(name);
+	if (!key->matches)
+		return;
+
+	stat_ev_put_record(ev, key->nr);
+	if (fmt != NULL) {
+		char buf[256];
+		ir_vsnprintf(buf, sizeof(buf), fmt, ap);
+		stat_ev_put_str(buf);
+	}
+}
+
+/** Emits an event value of @p size bytes. */
+static void stat_ev_binary_value(char tag, const char *name, const void *value,
+                                 size_t size)
+{
+	const stat_ev_key_t *const key = get_key(name);
+	if (!key->matches)
+		return;
+	stat_ev_put_record(tag, key->nr);
+	if (size > 0)
+		stat_ev_put(value, size);
+}
+
 static void stat_ev_vprintf(char ev, const char *key, const char *fmt, va_list ap)
 {
+	if (stat_ev_binary) {
+		stat_ev_binary_vprintf(ev, key, fmt, ap);
+		return;
+	}
 	if (!key_matches(key))
 		return;
 
@@ -132,7 +266,10 @@ void (stat_ev_ctx_pop)(const char *key)
 void do_stat_ev_dbl(const char *name, double value)
 {
 	stat_ev_tim_push();
-	stat_ev_printf('E', name, "%g", value);
+	if (stat_ev_binary)
+		stat_ev_binary_value('d', name, &value, sizeof(value));
+	else
+		stat_ev_printf('E', name, "%g", value);
 	stat_ev_tim_pop(NULL);
 }
 
@@ -144,7 +281,12 @@ void (stat_ev_dbl)(const char *name, double value)
 void do_stat_ev_int(const char *name, int value)
 {
 	stat_ev_tim_push();
-	stat_ev_printf('E', name, "%d", value);
+	if (stat_ev_binary) {
+		int64_t const val = value;
+		stat_ev_binary_value('i', name, &val, sizeof(val));
+	} else {
+		stat_ev_printf('E', name, "%d", value);
+	}
 	stat_ev_tim_pop(NULL);
 }
 
@@ -156,7 +298,12 @@ void (stat_ev_int)(const char *name, int value)
 void do_stat_ev_ull(const char *name, unsigned long long value)
 {
 	stat_ev_tim_push();
-	stat_ev_printf('E', name, "%llu", value);
+	if (stat_ev_binary) {
+		uint64_t const val = value;
+		stat_ev_binary_value('u', name, &val, sizeof(val));
+	} else {
+		stat_ev_printf('E', name, "%llu", value);
+	}
 	stat_ev_tim_pop(NULL);
 }
 
@@ -168,7 +315,10 @@ void (stat_ev_ull)(const char *name, unsigned long long value)
 void do_stat_ev(const char *name)
 {
 	stat_ev_tim_push();
-	stat_ev_printf('E', name, "0.0");
+	if (stat_ev_binary)
+		stat_ev_binary_value('e', name, NULL, 0);
+	else
+		stat_ev_printf('E', name, "0.0");
 	stat_ev_tim_pop(NULL);
 }
 
@@ -177,12 +327,13 @@ void (stat_ev)(const char *name)
 	stat_ev_(name);
 }
 
-void stat_ev_begin(const char *prefix, const char *filt)
+static void stat_ev_open(const char *prefix, const char *filt, bool binary)
 {
 	char buf[512];
 
-	snprintf(buf, sizeof(buf), "%s.ev", prefix);
-	stat_ev_file = fopen(buf, "wt");
+	snprintf(buf, sizeof(buf), binary ? "%s.evb" : "%s.ev", prefix);
+	stat_ev_file   = fopen(buf, binary ? "wb" : "wt");
+	stat_ev_binary = binary;
 
 	if (filt && filt[0] != '\0') {
 		filter = NULL;
@@ -190,11 +341,36 @@ void stat_ev_begin(const char *prefix, const char *filt)
 			filter = &regex;
 	}
 
+	if (binary && stat_ev_file != NULL) {
+		uint32_t const header[] = { 0x01020304, STAT_EV_BINARY_VERSION };
+		stat_ev_keys       = new_set(cmp_key, 64);
+		stat_ev_n_keys     = 0;
+		stat_ev_buffer_len = 0;
+		stat_ev_put("FIRMSEVB", 8);
+		stat_ev_put(header, sizeof(header));
+	}
+
 	stat_ev_enabled = stat_ev_file != NULL;
 }
 
+void stat_ev_begin(const char *prefix, const char *filt)
+{
+	stat_ev_open(prefix, filt, false);
+}
+
+void stat_ev_begin_binary(const char *prefix, const char *filt)
+{
+	stat_ev_open(prefix, filt, true);
+}
+
 void stat_ev_end(void)
 {
+	if (stat_ev_keys != NULL) {
+		if (stat_ev_file != NULL)
+			stat_ev_flush();
+		del_set(stat_ev_keys);
+		stat_ev_keys = NULL;
+	}
 	if (stat_ev_file != NULL) {
 		fclose(stat_ev_file);
 		stat_ev_file    = NULL;
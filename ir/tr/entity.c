@@ -8,8 +8,16 @@
  * @brief   Representation of all program known entities.
  * @author  Martin Trapp, Christian Schaefer, Goetz Lindenmaier, Michael Beck
  */
+/* fileno is not part of C99 */
+#define _DEFAULT_SOURCE
+
 #include <stdlib.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 #include "xmalloc.h"
 #include "entity_t.h"
@@ -81,6 +89,7 @@ ir_entity *new_d_entity(ir_type *owner, ident *name, ir_type *type,
 		res->attr.mtd_attr.vtable_number = IR_VTABLE_NUM_NOT_SET;
 		res->attr.mtd_attr.param_access  = NULL;
 		res->attr.mtd_attr.param_weight  = NULL;
+		res->attr.mtd_attr.summary       = method_summary_none;
 		res->attr.mtd_attr.irg           = NULL;
 	} else if (is_compound_type(owner) && !(owner->flags & tf_segment)) {
 		res = intern_new_entity(owner, IR_ENTITY_COMPOUND_MEMBER, name, type, db);
@@ -184,6 +193,7 @@ static ir_entity *deep_entity_copy(ir_entity *old)
 		/* do NOT copy them, reanalyze. This might be the best solution */
 		newe->attr.mtd_attr.param_access = NULL;
 		newe->attr.mtd_attr.param_weight = NULL;
+		newe->attr.mtd_attr.summary      = method_summary_none;
 	}
 	newe->overwrites    = NULL;
 	newe->overwrittenby = NULL;
@@ -458,6 +468,7 @@ ir_node *get_atomic_ent_value(const ir_entity *entity)
 	case IR_INITIALIZER_CONST:
 		return get_initializer_const_value(initializer);
 	case IR_INITIALIZER_COMPOUND:
+	case IR_INITIALIZER_BYTES:
 		panic("compound initializer in atomic entity not allowed (%+F)", entity);
 	}
 
@@ -480,6 +491,7 @@ const char *get_initializer_kind_name(ir_initializer_kind_t ini)
 	X(IR_INITIALIZER_TARVAL);
 	X(IR_INITIALIZER_NULL);
 	X(IR_INITIALIZER_COMPOUND);
+	X(IR_INITIALIZER_BYTES);
 	}
 #undef X
 	return "BAD VALUE";
@@ -572,6 +584,79 @@ ir_initializer_t *get_initializer_compound_value(
 	return initializer->compound.initializers[index];
 }
 
+ir_initializer_t *create_initializer_bytes(const void *data, size_t size)
+{
+	struct obstack *obst = get_irg_obstack(get_const_code_irg());
+
+	ir_initializer_t *initializer
+		= (ir_initializer_t*)OALLOC(obst, ir_initializer_bytes_t);
+	initializer->kind           = IR_INITIALIZER_BYTES;
+	initializer->bytes.size     = size;
+	initializer->bytes.data     = (const unsigned char*)data;
+	initializer->bytes.filename = NULL;
+
+	return initializer;
+}
+
+/**
+ * Returns the contents of the file @p f. The memory is never released, just
+ * like the initializers referencing it.
+ */
+static const void *map_file(FILE *f, size_t size)
+{
+#ifndef _WIN32
+	void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fileno(f), 0);
+	if (data != MAP_FAILED)
+		return data;
+#endif
+	void *buf = xmalloc(size);
+	if (fread(buf, 1, size, f) != size) {
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+ir_initializer_t *create_initializer_file(const char *filename)
+{
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL)
+		return NULL;
+
+	ir_initializer_t *initializer = NULL;
+	if (fseek(f, 0, SEEK_END) == 0) {
+		long size = ftell(f);
+		rewind(f);
+		const void *data = size > 0 ? map_file(f, (size_t)size) : NULL;
+		if (size == 0 || (size > 0 && data != NULL)) {
+			struct obstack *obst = get_irg_obstack(get_const_code_irg());
+			initializer = create_initializer_bytes(data, (size_t)size);
+			initializer->bytes.filename
+				= (const char*)obstack_copy0(obst, filename, strlen(filename));
+		}
+	}
+	fclose(f);
+	return initializer;
+}
+
+size_t get_initializer_bytes_size(const ir_initializer_t *initializer)
+{
+	assert(initializer->kind == IR_INITIALIZER_BYTES);
+	return initializer->bytes.size;
+}
+
+const void *get_initializer_bytes_data(const ir_initializer_t *initializer)
+{
+	assert(initializer->kind == IR_INITIALIZER_BYTES);
+	return initializer->bytes.data;
+}
+
+const char *get_initializer_bytes_file(const ir_initializer_t *initializer)
+{
+	assert(initializer->kind == IR_INITIALIZER_BYTES);
+	return initializer->bytes.filename;
+}
+
 ir_initializer_kind_t get_initializer_kind(const ir_initializer_t *initializer)
 {
 	return initializer->kind;
@@ -584,6 +669,7 @@ static void check_entity_initializer(ir_entity *entity)
 	ir_type          *entity_tp   = get_entity_type(entity);
 	switch (initializer->kind) {
 	case IR_INITIALIZER_COMPOUND:
+	case IR_INITIALIZER_BYTES:
 		assert(is_compound_type(entity_tp) || is_Array_type(entity_tp));
 		break;
 	case IR_INITIALIZER_CONST:
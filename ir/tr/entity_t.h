@@ -86,14 +86,35 @@ typedef struct ir_initializer_tarval_t {
 	ir_tarval             *value;
 } ir_initializer_tarval_t ;
 
+/**
+ * An initializer containing raw bytes.
+ */
+typedef struct ir_initializer_bytes_t {
+	ir_initializer_base_t  base;
+	size_t                 size;
+	const unsigned char   *data;
+	const char            *filename; /**< the file backing the data or NULL */
+} ir_initializer_bytes_t;
+
 union ir_initializer_t {
 	ir_initializer_kind_t      kind;
 	ir_initializer_base_t      base;
 	ir_initializer_compound_t  compound;
 	ir_initializer_const_t     consti;
 	ir_initializer_tarval_t    tarval;
+	ir_initializer_bytes_t     bytes;
 };
 
+/**
+ * Parts of the interprocedural summary of a method entity which are up to
+ * date, see assure_irg_entity_summary().
+ */
+typedef enum method_summary_t {
+	method_summary_none    = 0,
+	method_summary_nothrow = 1U << 0, /**< nothrow and malloc properties */
+	method_summary_const   = 1U << 1, /**< const and pure properties */
+} method_summary_t;
+
 /** The attributes for methods. */
 typedef struct method_ent_attr {
 	ir_graph *irg;                 /**< The corresponding irg if known.
@@ -107,6 +128,8 @@ typedef struct method_ent_attr {
 	ptr_access_kind *param_access; /**< the parameter access */
 	unsigned *param_weight;        /**< The weight of method's parameters. Parameters
 	                                    with a high weight are good candidates for procedure cloning. */
+	unsigned summary;              /**< the analysed parts of the summary, a
+	                                    set of method_summary_t */
 } method_ent_attr;
 
 /** additional attributes for code entities */
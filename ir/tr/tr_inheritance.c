@@ -8,12 +8,19 @@
  * @brief   Utility routines for inheritance representation
  * @author  Goetz Lindenmaier
  */
+#include <stdlib.h>
+#include <string.h>
+
 #include "debug.h"
 #include "typerep.h"
 #include "irgraph_t.h"
 #include "irprog_t.h"
-#include "pset.h"
-#include "set.h"
+#include "array.h"
+#include "obst.h"
+#include "pmap.h"
+#include "raw_bitset.h"
+#include "util.h"
+#include "xmalloc.h"
 #include "irgwalk.h"
 #include "irflag.h"
 
@@ -108,11 +115,15 @@ static void assert_valid_state(void)
 }
 
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
-/* There is a set that extends each entity/type with two new               */
-/* fields:  one for the upwards directed relation: 'up' (supertype,        */
-/* overwrites) and one for the downwards directed relation: 'down' (sub-   */
-/* type, overwrittenby.  These fields contain psets (and maybe later       */
-/* arrays) listing all subtypes...                                         */
+/* Each of the four relations is a dag.  Its elements are numbered in the  */
+/* preorder of a depth first search that starts at the elements without   */
+/* predecessors.  If all elements reachable from an element lie in the     */
+/* preorder interval of its depth first subtree, they are exactly this     */
+/* interval and a query is a comparison of two numbers.  This holds for    */
+/* all elements whose successors have no other predecessors, i.e., for the */
+/* subtypes in single inheritance.  For the other elements the reachable   */
+/* elements are kept in a sorted array if they are few, as the supertypes  */
+/* in single inheritance, else in a bitset over the preorder numbers.      */
 /* - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - */
 
 typedef enum {
@@ -120,175 +131,289 @@ typedef enum {
 	d_down = 1,
 } dir;
 
+/** Per element data of a closure, indexed by preorder number. */
+typedef struct {
+	size_t    last;   /**< largest preorder number in the depth first
+	                       subtree */
+	size_t    n_list; /**< number of elements in list */
+	unsigned *list;   /**< the reachable elements sorted by preorder number
+	                       if they are not the subtree and few, else NULL */
+	unsigned *set;    /**< the reachable elements if they are not the
+	                       subtree and many, else NULL */
+	size_t    iter;   /**< next position of an iteration over the reachable
+	                       elements */
+} inh_node_t;
+
+/** The transitive closure of one relation. */
 typedef struct {
-	const firm_kind *kind;   /**< An entity or type. */
-	pset            *directions[2];
-} tr_inh_trans_tp;
+	pmap             *numbers; /**< maps elements to preorder number + 1 */
+	const firm_kind **elems;   /**< the elements by preorder number */
+	inh_node_t       *nodes;   /**< the element data by preorder number */
+	struct obstack    obst;    /**< holds the lists and bitsets */
+} inh_closure_t;
 
-/* We use this set for all types and entities.  */
-static set *tr_inh_trans_set = NULL;
+/** The closures of the type and the entity relations in both directions. */
+static inh_closure_t type_closures[2];
+static inh_closure_t entity_closures[2];
 
-/**
- * Compare two tr_inh_trans_tp entries.
- */
-static int tr_inh_trans_cmp(const void *e1, const void *e2, size_t size)
+static size_t get_n_succs(const firm_kind *elem, dir d)
 {
-	(void) size;
-	const tr_inh_trans_tp *ef1 = (const tr_inh_trans_tp*)e1;
-	const tr_inh_trans_tp *ef2 = (const tr_inh_trans_tp*)e2;
-	return ef1->kind != ef2->kind;
-}
-
-/**
- * calculate the hash value of an tr_inh_trans_tp
- */
-static inline unsigned int tr_inh_trans_hash(const tr_inh_trans_tp *v)
-{
-	return hash_ptr(v->kind);
+	if (is_type(elem)) {
+		const ir_type *tp = (const ir_type*)elem;
+		return d == d_down ? get_class_n_subtypes(tp)
+		                   : get_class_n_supertypes(tp);
+	}
+	const ir_entity *ent = (const ir_entity*)elem;
+	return d == d_down ? get_entity_n_overwrittenby(ent)
+	                   : get_entity_n_overwrites(ent);
 }
 
-/* This always completes successfully. */
-static tr_inh_trans_tp *get_firm_kind_entry(const firm_kind *k)
+static const firm_kind *get_succ(const firm_kind *elem, dir d, size_t pos)
 {
-	if (tr_inh_trans_set == NULL)
-		tr_inh_trans_set = new_set(tr_inh_trans_cmp, 128);
-
-	tr_inh_trans_tp a;
-	a.kind = k;
-	tr_inh_trans_tp *found = set_find(tr_inh_trans_tp, tr_inh_trans_set, &a, sizeof(a), tr_inh_trans_hash(&a));
-	if (!found) {
-		a.directions[d_up]   = pset_new_ptr(16);
-		a.directions[d_down] = pset_new_ptr(16);
-		found = set_insert(tr_inh_trans_tp, tr_inh_trans_set, &a, sizeof(a), tr_inh_trans_hash(&a));
+	if (is_type(elem)) {
+		const ir_type *tp = (const ir_type*)elem;
+		return (const firm_kind*)(d == d_down ? get_class_subtype(tp, pos)
+		                                      : get_class_supertype(tp, pos));
 	}
-	return found;
+	const ir_entity *ent = (const ir_entity*)elem;
+	return (const firm_kind*)(d == d_down ? get_entity_overwrittenby(ent, pos)
+	                                      : get_entity_overwrites(ent, pos));
 }
 
-static pset *get_entity_map(const ir_entity *ent, dir d)
+/** Returns the preorder number + 1 of an element, 0 if it is not numbered. */
+static size_t get_number(const inh_closure_t *cl, const void *elem)
 {
-	assert(is_entity(ent));
-	tr_inh_trans_tp *found = get_firm_kind_entry((const firm_kind *)ent);
-	return found->directions[d];
+	if (cl->numbers == NULL)
+		return 0;
+	return PTR_TO_INT(pmap_get(void, cl->numbers, elem));
 }
 
-static pset *get_type_map(const ir_type *tp, dir d)
+static size_t number_elem(inh_closure_t *cl, const firm_kind *elem)
 {
-	assert(is_type(tp));
-	tr_inh_trans_tp *found = get_firm_kind_entry((const firm_kind *)tp);
-	return found->directions[d];
+	size_t     pre  = ARR_LEN(cl->elems);
+	inh_node_t node = { pre, 0, NULL, NULL, 0 };
+	ARR_APP1(const firm_kind*, cl->elems, elem);
+	ARR_APP1(inh_node_t, cl->nodes, node);
+	pmap_insert(cl->numbers, elem, INT_TO_PTR(pre + 1));
+	return pre;
 }
 
+typedef struct {
+	size_t pre; /**< preorder number of the element */
+	size_t pos; /**< next successor to visit */
+} dfs_frame_t;
 
 /**
- * Walk over all types reachable from tp in the sub/supertype
- * relation and compute the closure for the two downwards directed
- * relations.
- *
- * The walk in the dag formed by the relation is tricky:  We must visit
- * all subtypes before visiting the supertypes.  So we first walk down.
- * Then we can compute the closure for this type.  Then we walk up.
- * As we call ourselves recursive, and walk in both directions, there
- * can be cycles.  So we have to make sure, that if we visit a node
- * a second time (in a walk up) we do nothing.  For this we increment
- * the master visited flag twice.
- * If the type is marked with master_flag_visited-1 it is on the stack.
- * If it is marked with master_flag_visited it is fully processed.
- *
- * Well, we still miss some candidates ... */
-static void compute_down_closure(ir_type *tp)
-{
-	ir_visited_t master_visited = get_master_type_visited();
-	set_type_visited(tp, master_visited-1);
-
-	/* Recursive descend. */
-	size_t n_subtypes = get_class_n_subtypes(tp);
-	for (size_t i = 0; i < n_subtypes; ++i) {
-		ir_type *stp = get_class_subtype(tp, i);
-		if (get_type_visited(stp) < master_visited-1) {
-			compute_down_closure(stp);
+ * Numbers all elements reachable from @p root in preorder and appends them
+ * to @p postorder after all their successors.
+ */
+static void number_from(inh_closure_t *cl, const firm_kind *root, dir d,
+                        dfs_frame_t **stack, size_t **postorder)
+{
+	dfs_frame_t frame = { number_elem(cl, root), 0 };
+	ARR_APP1(dfs_frame_t, *stack, frame);
+	while (ARR_LEN(*stack) > 0) {
+		dfs_frame_t     *top  = &(*stack)[ARR_LEN(*stack) - 1];
+		const firm_kind *elem = cl->elems[top->pre];
+		if (top->pos < get_n_succs(elem, d)) {
+			const firm_kind *succ = get_succ(elem, d, top->pos++);
+			if (get_number(cl, succ) == 0) {
+				frame.pre = number_elem(cl, succ);
+				ARR_APP1(dfs_frame_t, *stack, frame);
+			}
+		} else {
+			cl->nodes[top->pre].last = ARR_LEN(cl->elems) - 1;
+			ARR_APP1(size_t, *postorder, top->pre);
+			ARR_SHRINKLEN(*stack, ARR_LEN(*stack) - 1);
 		}
 	}
+}
 
-	/* types */
-	pset *myset = get_type_map(tp, d_down);
-	for (size_t i = 0; i < n_subtypes; ++i) {
-		ir_type *stp    = get_class_subtype(tp, i);
-		pset    *subset = get_type_map(stp, d_down);
-		pset_insert_ptr(myset, stp);
-		pset_insert_pset_ptr(myset, subset);
-	}
+/** Appends @p nr to @p reach unless it is marked for @p pre already. */
+static void add_reachable(unsigned **reach, size_t *mark, size_t pre,
+                          size_t nr)
+{
+	if (mark[nr] == pre)
+		return;
+	mark[nr] = pre;
+	ARR_APP1(unsigned, *reach, (unsigned)nr);
+}
 
-	/* entities */
-	for (size_t i = 0, n_members = get_class_n_members(tp); i < n_members; ++i) {
-		ir_entity *mem = get_class_member(tp, i);
-		size_t j, n_overwrittenby = get_entity_n_overwrittenby(mem);
-
-		myset = get_entity_map(mem, d_down);
-		for (j = 0; j < n_overwrittenby; ++j) {
-			ir_entity *ov     = get_entity_overwrittenby(mem, j);
-			pset      *subset = get_entity_map(ov, d_down);
-			pset_insert_ptr(myset, ov);
-			pset_insert_pset_ptr(myset, subset);
+static int cmp_number(const void *a, const void *b)
+{
+	unsigned na = *(const unsigned*)a;
+	unsigned nb = *(const unsigned*)b;
+	return (na > nb) - (na < nb);
+}
+
+/**
+ * Computes the closure of relation @p d over the given elements and all
+ * elements reachable from them.
+ */
+static void compute_closure(inh_closure_t *cl, const firm_kind **elems, dir d)
+{
+	cl->numbers = pmap_create();
+	cl->elems   = NEW_ARR_F(const firm_kind*, 0);
+	cl->nodes   = NEW_ARR_F(inh_node_t, 0);
+	obstack_init(&cl->obst);
+
+	/* Starting at the roots keeps the subtrees of single inheritance exact,
+	 * the second round only catches cycles. */
+	dfs_frame_t *stack     = NEW_ARR_F(dfs_frame_t, 0);
+	size_t      *postorder = NEW_ARR_F(size_t, 0);
+	for (int round = 0; round < 2; ++round) {
+		for (size_t i = 0, n = ARR_LEN(elems); i < n; ++i) {
+			const firm_kind *elem = elems[i];
+			if (get_number(cl, elem) != 0
+			    || (round == 0 && get_n_succs(elem, (dir)(1 - d)) > 0))
+				continue;
+			number_from(cl, elem, d, &stack, &postorder);
 		}
 	}
+	DEL_ARR_F(stack);
+
+	/* The smallest and largest preorder number reachable from an element
+	 * decide whether its subtree is exact. */
+	size_t    n     = ARR_LEN(cl->elems);
+	size_t   *lo    = XMALLOCN(size_t, n);
+	size_t   *hi    = XMALLOCN(size_t, n);
+	size_t   *mark  = XMALLOCN(size_t, n);
+	unsigned *reach = NEW_ARR_F(unsigned, 0);
+	for (size_t i = 0; i < n; ++i)
+		mark[i] = (size_t)-1;
+	for (size_t i = 0; i < n; ++i) {
+		size_t           pre    = postorder[i];
+		inh_node_t      *node   = &cl->nodes[pre];
+		const firm_kind *elem   = cl->elems[pre];
+		size_t           n_succ = get_n_succs(elem, d);
+		lo[pre] = (size_t)-1;
+		hi[pre] = 0;
+		for (size_t j = 0; j < n_succ; ++j) {
+			size_t succ = get_number(cl, get_succ(elem, d, j)) - 1;
+			lo[pre] = MIN(lo[pre], MIN(succ, lo[succ]));
+			hi[pre] = MAX(hi[pre], MAX(succ, hi[succ]));
+		}
+		if (lo[pre] > pre && hi[pre] <= node->last)
+			continue;
+
+		ARR_SHRINKLEN(reach, 0);
+		for (size_t j = 0; j < n_succ; ++j) {
+			size_t            succ      = get_number(cl, get_succ(elem, d, j)) - 1;
+			inh_node_t const *succ_node = &cl->nodes[succ];
+			add_reachable(&reach, mark, pre, succ);
+			if (succ_node->list != NULL) {
+				for (size_t k = 0; k < succ_node->n_list; ++k)
+					add_reachable(&reach, mark, pre, succ_node->list[k]);
+			} else if (succ_node->set != NULL) {
+				for (size_t k = rbitset_next_max(succ_node->set, 0, n, true);
+				     k != (size_t)-1;
+				     k = rbitset_next_max(succ_node->set, k + 1, n, true))
+					add_reachable(&reach, mark, pre, k);
+			} else {
+				for (size_t k = succ + 1; k <= succ_node->last; ++k)
+					add_reachable(&reach, mark, pre, k);
+			}
+		}
 
-	mark_type_visited(tp);
-
-	/* Walk up. */
-	for (size_t i = 0, n_supertypes = get_class_n_supertypes(tp);
-	     i < n_supertypes; ++i) {
-		ir_type *stp = get_class_supertype(tp, i);
-		if (get_type_visited(stp) < master_visited-1) {
-			compute_down_closure(stp);
+		/* take the smaller representation */
+		size_t n_reach = ARR_LEN(reach);
+		if (n_reach * BITS_PER_ELEM < n) {
+			qsort(reach, n_reach, sizeof(*reach), cmp_number);
+			node->n_list = n_reach;
+			node->list   = OALLOCN(&cl->obst, unsigned, n_reach);
+			memcpy(node->list, reach, n_reach * sizeof(*reach));
+		} else {
+			node->set = rbitset_obstack_alloc(&cl->obst, n);
+			for (size_t k = 0; k < n_reach; ++k)
+				rbitset_set(node->set, reach[k]);
 		}
 	}
+	DEL_ARR_F(reach);
+	free(mark);
+	free(hi);
+	free(lo);
+	DEL_ARR_F(postorder);
 }
 
-static void compute_up_closure(ir_type *tp)
+static void free_closure(inh_closure_t *cl)
 {
-	ir_visited_t master_visited = get_master_type_visited();
-	set_type_visited(tp, master_visited-1);
+	if (cl->numbers == NULL)
+		return;
+	pmap_destroy(cl->numbers);
+	DEL_ARR_F(cl->elems);
+	DEL_ARR_F(cl->nodes);
+	obstack_free(&cl->obst, NULL);
+	cl->numbers = NULL;
+}
 
-	/* Recursive descend. */
-	size_t n_supertypes = get_class_n_supertypes(tp);
-	for (size_t i = 0; i < n_supertypes; ++i) {
-		ir_type *stp = get_class_supertype(tp, i);
-		if (get_type_visited(stp) < get_master_type_visited()-1) {
-			compute_up_closure(stp);
-		}
-	}
+/** Returns true if @p to is reachable from @p from. */
+static bool closure_contains(const inh_closure_t *cl, const void *from,
+                             const void *to)
+{
+	size_t from_nr = get_number(cl, from);
+	size_t to_nr   = get_number(cl, to);
+	if (from_nr == 0 || to_nr == 0)
+		return false;
+
+	const inh_node_t *node = &cl->nodes[from_nr - 1];
+	unsigned          nr   = (unsigned)(to_nr - 1);
+	if (node->list != NULL)
+		return bsearch(&nr, node->list, node->n_list, sizeof(*node->list),
+		               cmp_number) != NULL;
+	if (node->set != NULL)
+		return rbitset_is_set(node->set, nr);
+	return from_nr - 1 < nr && nr <= node->last;
+}
 
-	/* types */
-	pset *myset = get_type_map(tp, d_up);
-	for (size_t i = 0; i < n_supertypes; ++i) {
-		ir_type *stp    = get_class_supertype(tp, i);
-		pset    *subset = get_type_map(stp, d_up);
-		pset_insert_ptr(myset, stp);
-		pset_insert_pset_ptr(myset, subset);
-	}
+static const firm_kind *closure_next(const inh_closure_t *cl, const void *elem)
+{
+	size_t nr = get_number(cl, elem);
+	if (nr == 0)
+		return NULL;
 
-	/* entities */
-	for (size_t i = 0, n_members = get_class_n_members(tp); i < n_members; ++i) {
-		ir_entity *mem   = get_class_member(tp, i);
-		pset      *myset = get_entity_map(mem, d_up);
-		for (size_t j = 0, n_overwrites = get_entity_n_overwrites(mem);
-		     j < n_overwrites; ++j) {
-			ir_entity *ov     = get_entity_overwrites(mem, j);
-			pset      *subset = get_entity_map(ov, d_up);
-			pset_insert_pset_ptr(myset, subset);
-			pset_insert_ptr(myset, ov);
+	inh_node_t *node = &cl->nodes[nr - 1];
+	size_t      n    = ARR_LEN(cl->elems);
+	size_t      next = node->iter;
+	if (node->list != NULL) {
+		if (next >= node->n_list)
+			return NULL;
+		node->iter = next + 1;
+		return cl->elems[node->list[next]];
+	} else if (next >= n) {
+		return NULL;
+	} else if (node->set != NULL) {
+		next = rbitset_next_max(node->set, next, n, true);
+		if (next == (size_t)-1) {
+			node->iter = n;
+			return NULL;
 		}
+	} else if (next > node->last) {
+		return NULL;
 	}
+	node->iter = next + 1;
+	return cl->elems[next];
+}
 
-	mark_type_visited(tp);
+static const firm_kind *closure_first(const inh_closure_t *cl,
+                                      const void *elem)
+{
+	size_t nr = get_number(cl, elem);
+	if (nr == 0)
+		return NULL;
+	/* lists and bitsets may contain elements numbered before the element */
+	inh_node_t *node = &cl->nodes[nr - 1];
+	node->iter = node->list != NULL || node->set != NULL ? 0 : nr;
+	return closure_next(cl, elem);
+}
 
-	/* Walk down. */
-	for (size_t i = 0, n_subtypes = get_class_n_subtypes(tp);
-	     i < n_subtypes; ++i) {
-		ir_type *stp = get_class_subtype(tp, i);
-		if (get_type_visited(stp) < master_visited-1) {
-			compute_up_closure(stp);
-		}
+/** Appends the members of @p tp that overwrite or are overwritten. */
+static void collect_entities(const ir_type *tp, const firm_kind ***elems)
+{
+	for (size_t i = 0, n = get_compound_n_members(tp); i < n; ++i) {
+		ir_entity *mem = get_compound_member(tp, i);
+		if (get_entity_n_overwrites(mem) > 0
+		    || get_entity_n_overwrittenby(mem) > 0)
+			ARR_APP1(const firm_kind*, *elems, (const firm_kind*)mem);
 	}
 }
 
@@ -296,70 +421,34 @@ void compute_inh_transitive_closure(void)
 {
 	free_inh_transitive_closure();
 
-	/* The 'down' relation */
-	irp_reserve_resources(irp, IRP_RESOURCE_TYPE_VISITED);
-	inc_master_type_visited();  /* Inc twice: one if on stack, second if values computed. */
-	inc_master_type_visited();
-	size_t n_types = get_irp_n_types();
-	for (size_t i = 0; i < n_types; ++i) {
+	const firm_kind **types    = NEW_ARR_F(const firm_kind*, 0);
+	const firm_kind **entities = NEW_ARR_F(const firm_kind*, 0);
+	for (size_t i = 0, n = get_irp_n_types(); i < n; ++i) {
 		ir_type *tp = get_irp_type(i);
-		if (is_Class_type(tp) && type_not_visited(tp)) { /* For others there is nothing to accumulate. */
-			size_t n_subtypes = get_class_n_subtypes(tp);
-			int has_unmarked_subtype = 0;
-
-			assert(get_type_visited(tp) < get_master_type_visited()-1);
-			for (size_t j = 0; j < n_subtypes; ++j) {
-				ir_type *stp = get_class_subtype(tp, j);
-				if (type_not_visited(stp)) {
-					has_unmarked_subtype = 1;
-					break;
-				}
-			}
-
-			/* This is a good starting point. */
-			if (!has_unmarked_subtype)
-				compute_down_closure(tp);
-		}
+		if (!is_compound_type(tp))
+			continue;
+		collect_entities(tp, &entities);
+		if (is_Class_type(tp) && (get_class_n_subtypes(tp) > 0
+		                          || get_class_n_supertypes(tp) > 0))
+			ARR_APP1(const firm_kind*, types, (const firm_kind*)tp);
 	}
 
-	/* The 'up' relation */
-	inc_master_type_visited();
-	inc_master_type_visited();
-	for (size_t i = 0; i < n_types; ++i) {
-		ir_type *tp = get_irp_type(i);
-		if (is_Class_type(tp) && type_not_visited(tp)) { /* For others there is nothing to accumulate. */
-			size_t n_supertypes = get_class_n_supertypes(tp);
-			int has_unmarked_supertype = 0;
-
-			assert(get_type_visited(tp) < get_master_type_visited()-1);
-			for (size_t j = 0; j < n_supertypes; ++j) {
-				ir_type *stp = get_class_supertype(tp, j);
-				if (type_not_visited(stp)) {
-					has_unmarked_supertype = 1;
-					break;
-				}
-			}
-
-			/* This is a good starting point. */
-			if (!has_unmarked_supertype)
-				compute_up_closure(tp);
-		}
-	}
+	compute_closure(&type_closures[d_up],     types,    d_up);
+	compute_closure(&type_closures[d_down],   types,    d_down);
+	compute_closure(&entity_closures[d_up],   entities, d_up);
+	compute_closure(&entity_closures[d_down], entities, d_down);
+	DEL_ARR_F(entities);
+	DEL_ARR_F(types);
 
 	irp->inh_trans_closure_state = inh_transitive_closure_valid;
-	irp_free_resources(irp, IRP_RESOURCE_TYPE_VISITED);
 }
 
 void free_inh_transitive_closure(void)
 {
-	if (tr_inh_trans_set) {
-		foreach_set(tr_inh_trans_set, tr_inh_trans_tp, elt) {
-			del_pset(elt->directions[d_up]);
-			del_pset(elt->directions[d_down]);
-		}
-		del_set(tr_inh_trans_set);
-		tr_inh_trans_set = NULL;
-	}
+	free_closure(&type_closures[d_up]);
+	free_closure(&type_closures[d_down]);
+	free_closure(&entity_closures[d_up]);
+	free_closure(&entity_closures[d_down]);
 	irp->inh_trans_closure_state = inh_transitive_closure_none;
 }
 
@@ -368,19 +457,19 @@ void free_inh_transitive_closure(void)
 ir_type *get_class_trans_subtype_first(const ir_type *tp)
 {
 	assert_valid_state();
-	return pset_first(ir_type, get_type_map(tp, d_down));
+	return (ir_type*)closure_first(&type_closures[d_down], tp);
 }
 
 ir_type *get_class_trans_subtype_next(const ir_type *tp)
 {
 	assert_valid_state();
-	return pset_next(ir_type, get_type_map(tp, d_down));
+	return (ir_type*)closure_next(&type_closures[d_down], tp);
 }
 
 int is_class_trans_subtype(const ir_type *tp, const ir_type *subtp)
 {
 	assert_valid_state();
-	return (pset_find_ptr(get_type_map(tp, d_down), subtp) != NULL);
+	return closure_contains(&type_closures[d_down], tp, subtp);
 }
 
 /* - supertype ----------------------------------------------------------- */
@@ -388,13 +477,13 @@ int is_class_trans_subtype(const ir_type *tp, const ir_type *subtp)
 ir_type *get_class_trans_supertype_first(const ir_type *tp)
 {
 	assert_valid_state();
-	return pset_first(ir_type, get_type_map(tp, d_up));
+	return (ir_type*)closure_first(&type_closures[d_up], tp);
 }
 
 ir_type *get_class_trans_supertype_next(const ir_type *tp)
 {
 	assert_valid_state();
-	return pset_next(ir_type, get_type_map(tp, d_up));
+	return (ir_type*)closure_next(&type_closures[d_up], tp);
 }
 
 /* - overwrittenby ------------------------------------------------------- */
@@ -402,13 +491,13 @@ ir_type *get_class_trans_supertype_next(const ir_type *tp)
 ir_entity *get_entity_trans_overwrittenby_first(const ir_entity *ent)
 {
 	assert_valid_state();
-	return pset_first(ir_entity, get_entity_map(ent, d_down));
+	return (ir_entity*)closure_first(&entity_closures[d_down], ent);
 }
 
 ir_entity *get_entity_trans_overwrittenby_next(const ir_entity *ent)
 {
 	assert_valid_state();
-	return pset_next(ir_entity, get_entity_map(ent, d_down));
+	return (ir_entity*)closure_next(&entity_closures[d_down], ent);
 }
 
 /* - overwrites ---------------------------------------------------------- */
@@ -417,13 +506,13 @@ ir_entity *get_entity_trans_overwrittenby_next(const ir_entity *ent)
 ir_entity *get_entity_trans_overwrites_first(const ir_entity *ent)
 {
 	assert_valid_state();
-	return pset_first(ir_entity, get_entity_map(ent, d_up));
+	return (ir_entity*)closure_first(&entity_closures[d_up], ent);
 }
 
 ir_entity *get_entity_trans_overwrites_next(const ir_entity *ent)
 {
 	assert_valid_state();
-	return pset_next(ir_entity, get_entity_map(ent, d_up));
+	return (ir_entity*)closure_next(&entity_closures[d_up], ent);
 }
 
 
@@ -452,8 +541,7 @@ int is_SubClass_of(ir_type *low, ir_type *high)
 		return 1;
 
 	if (get_irp_inh_transitive_closure_state() == inh_transitive_closure_valid) {
-		pset *m = get_type_map(high, d_down);
-		return pset_find_ptr(m, low) ? 1 : 0;
+		return closure_contains(&type_closures[d_down], high, low);
 	}
 	return check_is_SubClass_of(low, high);
 }
@@ -474,8 +562,7 @@ int is_overwritten_by(ir_entity *high, ir_entity *low)
 {
 	assert(is_entity(low) && is_entity(high));
 	if (get_irp_inh_transitive_closure_state() == inh_transitive_closure_valid) {
-		pset *m = get_entity_map(high, d_down);
-		return pset_find_ptr(m, low) ? 1 : 0;
+		return closure_contains(&entity_closures[d_down], high, low);
 	}
 
 	/* depth first search from high downwards. */
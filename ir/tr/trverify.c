@@ -208,6 +208,21 @@ static bool check_initializer(const ir_initializer_t *initializer,
 		}
 		return fine;
 	}
+	case IR_INITIALIZER_BYTES: {
+		size_t size = get_initializer_bytes_size(initializer);
+		if (!is_Array_type(type) && !is_compound_type(type)) {
+			report_error("bytes initializer for non-array/compound type in entity %+F",
+			             context);
+			fine = false;
+		} else if (get_type_state(type) == layout_fixed
+		           && size > get_type_size_bytes(type)
+		           && !(is_Array_type(type) && is_array_variable_size(type))) {
+			report_error("bytes initializer of %+F larger than its type",
+			             context);
+			fine = false;
+		}
+		return fine;
+	}
 	}
 	report_error("invalid initializer for entity %+F", context);
 	return false;
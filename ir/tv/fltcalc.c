@@ -22,7 +22,7 @@
 #include <assert.h>
 #include <stdbool.h>
 
-#include "xmalloc.h"
+#include "util.h"
 
 static long double string_to_long_double(const char *str)
 {
@@ -102,8 +102,11 @@ struct fp_value {
 #define _shift_right(x, y, res) sc_shr((x), (y), value_size*4, 0, (res))
 #define _shift_left(x, y, res) sc_shl((x), (y), value_size*4, 0, (res))
 
-/** A temporary buffer. */
-static fp_value *calc_buffer = NULL;
+/** Storage of the temporary buffer, every thread has its own. */
+static FIRM_THREAD_LOCAL union {
+	long double align;
+	char        data[sizeof(fp_value) + SC_MAX_PRECISION];
+} calc_buffer_storage;
 
 /** Current rounding mode.*/
 static fc_rounding_mode_t rounding_mode;
@@ -112,11 +115,20 @@ static int calc_buffer_size;
 static int value_size;
 static int max_precision;
 
-/** Exact flag. */
-static bool fc_exact = true;
+/** Exact flag of the last calculation of the current thread. */
+static FIRM_THREAD_LOCAL bool fc_exact = true;
+
+/** flag whether init_fltcalc() has run */
+static bool initialized;
 
 static float_descriptor_t long_double_desc;
 
+/** Returns the temporary buffer of the current thread. */
+static inline fp_value *get_calc_buffer(void)
+{
+	return (fp_value*)calc_buffer_storage.data;
+}
+
 /** pack machine-like */
 static void *pack(const fp_value *int_float, void *packed)
 {
@@ -725,7 +737,7 @@ static void _trunc(const fp_value *a, fp_value *result)
  ********/
 const void *fc_get_buffer(void)
 {
-	return calc_buffer;
+	return get_calc_buffer();
 }
 
 int fc_get_buffer_length(void)
@@ -775,7 +787,7 @@ fp_value *fc_val_from_ieee754(long double l, fp_value *result)
 	}
 
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	/* CLEAR the buffer, else some bits might be uninitialized */
 	memset(result, 0, fc_get_buffer_length());
@@ -890,7 +902,7 @@ fp_value *fc_cast(const fp_value *value, const float_descriptor_t *desc,
                   fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 	assert(value != result);
 
 	if (value->desc.exponent_size == desc->exponent_size &&
@@ -947,7 +959,7 @@ fp_value *fc_cast(const fp_value *value, const float_descriptor_t *desc,
 fp_value *fc_get_max(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	result->desc = *desc;
 	result->clss = FC_NORMAL;
@@ -965,7 +977,7 @@ fp_value *fc_get_max(const float_descriptor_t *desc, fp_value *result)
 fp_value *fc_get_min(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	fc_get_max(desc, result);
 	result->sign = 1;
@@ -976,7 +988,7 @@ fp_value *fc_get_min(const float_descriptor_t *desc, fp_value *result)
 fp_value *fc_get_snan(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	result->desc = *desc;
 	result->clss = FC_NAN;
@@ -993,7 +1005,7 @@ fp_value *fc_get_snan(const float_descriptor_t *desc, fp_value *result)
 fp_value *fc_get_qnan(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	result->desc = *desc;
 	result->clss = FC_NAN;
@@ -1013,7 +1025,7 @@ fp_value *fc_get_qnan(const float_descriptor_t *desc, fp_value *result)
 fp_value *fc_get_plusinf(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	result->desc = *desc;
 	result->clss = FC_INF;
@@ -1033,7 +1045,7 @@ fp_value *fc_get_plusinf(const float_descriptor_t *desc, fp_value *result)
 fp_value *fc_get_minusinf(const float_descriptor_t *desc, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	fc_get_plusinf(desc, result);
 	result->sign = 1;
@@ -1163,9 +1175,8 @@ unsigned char fc_sub_bits(const fp_value *value, unsigned num_bits,
                           unsigned byte_ofs)
 {
 	/* this is used to cache the packed version of the value */
-	static char *packed_value = NULL;
-	if (packed_value == NULL)
-		packed_value = XMALLOCN(char, value_size);
+	static FIRM_THREAD_LOCAL char packed_value[SC_MAX_PRECISION / 2];
+	assert(value_size <= (int)sizeof(packed_value));
 
 	if (value != NULL)
 		pack(value, packed_value);
@@ -1226,7 +1237,7 @@ fc_rounding_mode_t fc_get_rounding_mode(void)
 
 void init_fltcalc(int precision)
 {
-	if (calc_buffer == NULL) {
+	if (!initialized) {
 		/* does nothing if already init */
 		if (precision == 0)
 			precision = FC_DEFAULT_PRECISION;
@@ -1243,8 +1254,8 @@ void init_fltcalc(int precision)
 		value_size       = sc_get_buffer_length();
 		calc_buffer_size = sizeof(fp_value) + 2*value_size;
 
-		calc_buffer = (fp_value*) xmalloc(calc_buffer_size);
-		memset(calc_buffer, 0, calc_buffer_size);
+		assert((size_t)calc_buffer_size <= sizeof(calc_buffer_storage.data));
+		initialized = true;
 
 		const size_t long_double_size = sizeof(long double);
 #if LDBL_MANT_DIG == 64
@@ -1261,15 +1272,168 @@ void init_fltcalc(int precision)
 
 void finish_fltcalc(void)
 {
-	free(calc_buffer);
-	calc_buffer = NULL;
+	initialized = false;
 }
 
+/* The host arithmetic is only used for constant folding if it evaluates
+ * double expressions in IEEE 754 double precision without excess precision. */
+#if FLT_RADIX == 2 && FLT_MANT_DIG == 24 && DBL_MANT_DIG == 53 \
+    && FLT_MAX_EXP == 128 && DBL_MAX_EXP == 1024 \
+    && defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0 || FLT_EVAL_METHOD == 1)
+#define HAVE_HOST_IEEE_ARITH
+#endif
+
+#ifdef HAVE_HOST_IEEE_ARITH
+typedef enum host_op_t {
+	host_op_add,
+	host_op_sub,
+	host_op_mul,
+	host_op_div,
+} host_op_t;
+
+static bool is_desc(const float_descriptor_t *desc, unsigned exponent_size,
+                    unsigned mantissa_size)
+{
+	return desc->exponent_size == exponent_size
+	    && desc->mantissa_size == mantissa_size && !desc->explicit_one;
+}
+
+static bool same_desc(const float_descriptor_t *a, const float_descriptor_t *b)
+{
+	return a->exponent_size == b->exponent_size
+	    && a->mantissa_size == b->mantissa_size
+	    && a->explicit_one == b->explicit_one;
+}
+
+/**
+ * Converts a zero or normal value to a host double. Returns false if the value
+ * is not in the canonical form produced by normalize().
+ */
+static bool value_to_host(const fp_value *val, double *res)
+{
+	if (val->clss == FC_ZERO) {
+		*res = val->sign ? -0.0 : 0.0;
+		return true;
+	}
+	if (val->clss != FC_NORMAL)
+		return false;
+
+	unsigned mantissa_size = val->desc.mantissa_size;
+	uint64_t mant          = sc_val_to_uint64(_mant(val));
+	if ((mant & ((1u << ROUNDING_BITS) - 1)) != 0
+	    || mant >> (mantissa_size + ROUNDING_BITS) != 1)
+		return false;
+
+	int  bias = (1 << (val->desc.exponent_size - 1)) - 1;
+	long exp  = sc_val_to_long(_exp(val)) - bias - (long)mantissa_size;
+	double d  = ldexp((double)(mant >> ROUNDING_BITS), (int)exp);
+	*res = val->sign ? -d : d;
+	return true;
+}
+
+/** Stores the normal host double @p d as value of format @p desc. */
+static void host_to_value(double d, const float_descriptor_t *desc,
+                          fp_value *result)
+{
+	int      exp;
+	double   frac = frexp(fabs(d), &exp);
+	unsigned mantissa_size = desc->mantissa_size;
+	uint64_t mant = (uint64_t)ldexp(frac, mantissa_size + 1);
+	int      bias = (1 << (desc->exponent_size - 1)) - 1;
+
+	result->desc = *desc;
+	result->clss = FC_NORMAL;
+	result->sign = signbit(d) != 0;
+	sc_val_from_long(exp - 1 + bias, _exp(result));
+	sc_val_from_word((sc_word_t)mant << ROUNDING_BITS, false, _mant(result));
+}
+
+/**
+ * Calculates a binary operation on IEEE single or double precision values
+ * with the host floating point unit.
+ *
+ * Only zero and normal operands producing a normal result under round to
+ * nearest are handled, everything else (NaN, infinities, subnormals, other
+ * rounding modes and formats) is left to the software implementation.
+ * Single precision is calculated in double precision and rounded once more,
+ * which yields the correctly rounded result as 53 >= 2*24+2.
+ *
+ * @returns true if the result has been calculated
+ */
+static bool host_arith(host_op_t op, const fp_value *a, const fp_value *b,
+                       fp_value *result)
+{
+	if (rounding_mode != FC_TONEAREST || !same_desc(&a->desc, &b->desc))
+		return false;
+	const float_descriptor_t *desc      = &a->desc;
+	bool                      is_single = is_desc(desc, 8, 23);
+	if (!is_single && !is_desc(desc, 11, 52))
+		return false;
+
+	double x;
+	double y;
+	if (!value_to_host(a, &x) || !value_to_host(b, &y))
+		return false;
+
+	/* values below this bound may have rounding errors that underflow */
+	double const tiny = ldexp(DBL_MIN, DBL_MANT_DIG + 1);
+	double       r;
+	double       err;
+	switch (op) {
+	case host_op_sub:
+		y = -y;
+		/* FALLTHROUGH */
+	case host_op_add: {
+		/* Knuth's TwoSum gives the exact rounding error of the addition */
+		r = x + y;
+		double yv = r - x;
+		err = (x - (r - yv)) + (y - yv);
+		break;
+	}
+	case host_op_mul:
+		r   = x * y;
+		err = fma(x, y, -r);
+		break;
+	case host_op_div:
+		/* the remainder of a division by zero or of a tiny dividend is not
+		 * exact */
+		if (y == 0.0 || fabs(x) < tiny)
+			return false;
+		r   = x / y;
+		err = fma(-r, y, x);
+		break;
+	default:
+		return false;
+	}
+
+	/* the error terms are exact unless they underflow */
+	if (!isnormal(r) || fabs(r) < tiny)
+		return false;
+	bool exact = err == 0.0;
+	if (is_single) {
+		float f = (float)r;
+		if (!isnormal(f))
+			return false;
+		exact &= (double)f == r;
+		r      = f;
+	}
+
+	host_to_value(r, desc, result);
+	fc_exact = exact;
+	return true;
+}
+#endif
+
 /* definition of interface functions */
 fp_value *fc_add(const fp_value *a, const fp_value *b, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
+
+#ifdef HAVE_HOST_IEEE_ARITH
+	if (host_arith(host_op_add, a, b, result))
+		return result;
+#endif
 
 	/* make the value with the bigger exponent the first one */
 	if (sc_comp(_exp(a), _exp(b)) == ir_relation_less)
@@ -1283,7 +1447,12 @@ fp_value *fc_add(const fp_value *a, const fp_value *b, fp_value *result)
 fp_value *fc_sub(const fp_value *a, const fp_value *b, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
+
+#ifdef HAVE_HOST_IEEE_ARITH
+	if (host_arith(host_op_sub, a, b, result))
+		return result;
+#endif
 
 	fp_value *temp = (fp_value*) alloca(calc_buffer_size);
 	memcpy(temp, b, calc_buffer_size);
@@ -1299,7 +1468,12 @@ fp_value *fc_sub(const fp_value *a, const fp_value *b, fp_value *result)
 fp_value *fc_mul(const fp_value *a, const fp_value *b, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
+
+#ifdef HAVE_HOST_IEEE_ARITH
+	if (host_arith(host_op_mul, a, b, result))
+		return result;
+#endif
 
 	_fmul(a, b, result);
 
@@ -1309,7 +1483,12 @@ fp_value *fc_mul(const fp_value *a, const fp_value *b, fp_value *result)
 fp_value *fc_div(const fp_value *a, const fp_value *b, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
+
+#ifdef HAVE_HOST_IEEE_ARITH
+	if (host_arith(host_op_div, a, b, result))
+		return result;
+#endif
 
 	_fdiv(a, b, result);
 
@@ -1319,7 +1498,7 @@ fp_value *fc_div(const fp_value *a, const fp_value *b, fp_value *result)
 fp_value *fc_neg(const fp_value *a, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	if (a != result)
 		memcpy(result, a, calc_buffer_size);
@@ -1331,7 +1510,7 @@ fp_value *fc_neg(const fp_value *a, fp_value *result)
 fp_value *fc_int(const fp_value *a, fp_value *result)
 {
 	if (result == NULL)
-		result = calc_buffer;
+		result = get_calc_buffer();
 
 	_trunc(a, result);
 
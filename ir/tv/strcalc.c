@@ -18,6 +18,7 @@
 #include "strcalc.h"
 #include "xmalloc.h"
 #include "error.h"
+#include "util.h"
 
 /*
  * local definitions and macros
@@ -26,7 +27,7 @@
 #define SC_RESULT(x) ((x) & ((1U << SC_BITS) - 1U))
 #define SC_CARRY(x)  ((unsigned)(x) >> SC_BITS)
 
-#define CLEAR_BUFFER(b) assert(b); memset(b, SC_0, calc_buffer_size)
+#define CLEAR_BUFFER(b) memset(b, SC_0, calc_buffer_size)
 #define SHIFT(count) (SC_1 << (count))
 #define _val(a) ((a)-SC_0)
 #define _digit(a) ((a)+SC_0)
@@ -35,13 +36,15 @@
 /*
  * private variables
  */
-static char *calc_buffer = NULL;    /* buffer holding all results */
-static char *output_buffer = NULL;  /* buffer for output */
+/* The buffers and the carry flag are scratch state of the calculations, every
+ * thread gets its own instance. The sizes are fixed by init_strcalc(). */
+static FIRM_THREAD_LOCAL char calc_buffer[SC_MAX_PRECISION / 2 + 1];  /* buffer holding all results */
+static FIRM_THREAD_LOCAL char output_buffer[SC_MAX_PRECISION + 1];    /* buffer for output */
 static int bit_pattern_size;        /* maximum number of bits */
 static int calc_buffer_size;        /* size of internally stored values */
 static int max_value_size;          /* maximum size of values */
 
-static bool carry_flag;             /**< some computation set the carry_flag:
+static FIRM_THREAD_LOCAL bool carry_flag; /**< some computation set the carry_flag:
                                          - right shift if bits were lost due to shifting
                                          - division if there was a remainder
                                          However, the meaning of carry is machine dependent
@@ -664,6 +667,35 @@ long sc_val_to_long(const void *val)
 	return l;
 }
 
+void sc_val_from_word(sc_word_t bits, bool negative, void *buffer)
+{
+	if (buffer == NULL) buffer = calc_buffer;
+	char *pos = (char*) buffer;
+	char *end = pos + calc_buffer_size;
+
+	for (size_t i = 0; i < sizeof(bits) * 2 && pos < end; ++i) {
+		*pos++ = _digit((char)(bits & 0xf));
+		bits >>= 4;
+	}
+	while (pos < end)
+		*pos++ = negative ? SC_F : SC_0;
+}
+
+void sc_val_from_sword(sc_sword_t value, void *buffer)
+{
+	sc_val_from_word((sc_word_t)value, value < 0, buffer);
+}
+
+sc_word_t sc_val_to_word(const void *val)
+{
+	int       n   = MIN(calc_buffer_size, (int)sizeof(sc_word_t) * 2);
+	sc_word_t res = 0;
+	for (int i = n - 1; i >= 0; i--) {
+		res = (res << 4) | (sc_word_t)_val(((const char*)val)[i]);
+	}
+	return res;
+}
+
 uint64_t sc_val_to_uint64(const void *val)
 {
 	uint64_t res = 0;
@@ -1016,26 +1048,24 @@ const char *sc_print(const void *value, unsigned bits, enum base_t base, int sig
 
 void init_strcalc(int precision)
 {
-	if (calc_buffer == NULL) {
+	if (bit_pattern_size == 0) {
 		if (precision <= 0) precision = SC_DEFAULT_PRECISION;
 
 		/* round up to multiple of 4 */
 		precision = (precision + 3) & ~3;
+		if (precision > SC_MAX_PRECISION)
+			panic("precision %d exceeds the maximum of %d", precision, SC_MAX_PRECISION);
 
 		bit_pattern_size = (precision);
 		calc_buffer_size = (precision / 2);
 		max_value_size   = (precision / 4);
-
-		calc_buffer   = XMALLOCN(char, calc_buffer_size + 1);
-		output_buffer = XMALLOCN(char, bit_pattern_size + 1);
 	}
 }
 
 
 void finish_strcalc(void)
 {
-	free(calc_buffer);   calc_buffer   = NULL;
-	free(output_buffer); output_buffer = NULL;
+	bit_pattern_size = 0;
 }
 
 int sc_get_precision(void)
@@ -43,6 +43,23 @@
  */
 
 #define SC_DEFAULT_PRECISION 64
+/** maximum precision supported by init_strcalc() */
+#define SC_MAX_PRECISION     128
+
+/**
+ * The widest machine integer types available. Values of modes with at most
+ * SC_WORD_MAX_MODE_BITS bits can be calculated with them without losing any
+ * bits of the exact result, even for multiplications.
+ */
+#ifdef __SIZEOF_INT128__
+typedef unsigned __int128 sc_word_t;
+typedef __int128          sc_sword_t;
+#define SC_WORD_MAX_MODE_BITS 64
+#else
+typedef uint64_t          sc_word_t;
+typedef int64_t           sc_sword_t;
+#define SC_WORD_MAX_MODE_BITS 32
+#endif
 
 enum {
   SC_0 = 0,
@@ -203,6 +220,18 @@ void sc_val_from_ulong(unsigned long l, void *buffer);
 void sc_val_from_bytes(unsigned char const *bytes, size_t n_bytes,
                        bool big_endian, void *buffer);
 
+/**
+ * Create a value from the bits of a machine word. The digits above the word
+ * are filled with ones if @p negative is set, else with zeros.
+ */
+void sc_val_from_word(sc_word_t bits, bool negative, void *buffer);
+
+/** create a value from a signed machine word */
+void sc_val_from_sword(sc_sword_t value, void *buffer);
+
+/** returns the lowest bits of a value that fit into a machine word */
+sc_word_t sc_val_to_word(const void *val);
+
 /** converts a value to a long */
 long sc_val_to_long(const void *val);
 uint64_t sc_val_to_uint64(const void *val);
@@ -183,6 +183,26 @@ static ir_tarval *get_tarval_overflow(const void *value, size_t length,
 	return get_tarval(value, length, mode);
 }
 
+/**
+ * Returns true if integer arithmetic in a mode can be done with machine words
+ * instead of the digit by digit calculations of strcalc.
+ */
+static bool use_word_arith(const ir_mode *mode)
+{
+	return get_mode_arithmetic(mode) == irma_twos_complement
+	    && get_mode_size_bits(mode) <= SC_WORD_MAX_MODE_BITS;
+}
+
+/**
+ * Returns the value of a tarval of a mode for which use_word_arith() holds.
+ * The value is sign or zero extended according to the mode, so signed and
+ * unsigned values are exact in the signed word.
+ */
+static sc_sword_t get_tarval_sword(const ir_tarval *tv)
+{
+	return (sc_sword_t)sc_val_to_word(tv->value);
+}
+
 static ir_tarval reserved_tv[2];
 static ir_tarval nonconst_tvs[4];
 
@@ -388,6 +408,14 @@ uint64_t get_tarval_uint64(ir_tarval *tv)
 	return sc_val_to_uint64(tv->value);
 }
 
+ir_tarval *new_tarval_from_uint64(uint64_t value, ir_mode *mode)
+{
+	assert(mode_is_int(mode) && get_mode_size_bits(mode) <= 64);
+	/* get_tarval() truncates and sign extends to the mode */
+	sc_val_from_word((sc_word_t)value, false, NULL);
+	return get_tarval(sc_get_buffer(), sc_get_buffer_length(), mode);
+}
+
 ir_tarval *new_tarval_from_long_double(long double d, ir_mode *mode)
 {
 	assert(mode && (get_mode_sort(mode) == irms_float_number));
@@ -805,7 +833,10 @@ ir_tarval *tarval_neg(ir_tarval *a)
 	switch (get_mode_sort(a->mode)) {
 	case irms_int_number: {
 		char *buffer = ALLOCAN(char, sc_get_buffer_length());
-		sc_neg(a->value, buffer);
+		if (use_word_arith(a->mode))
+			sc_val_from_sword(-get_tarval_sword(a), buffer);
+		else
+			sc_neg(a->value, buffer);
 		return get_tarval_overflow(buffer, a->length, a->mode);
 	}
 
@@ -833,7 +864,10 @@ ir_tarval *tarval_add(ir_tarval *a, ir_tarval *b)
 	case irms_int_number: {
 		/* modes of a,b are equal, so result has mode of a as this might be the character */
 		char *buffer = ALLOCAN(char, sc_get_buffer_length());
-		sc_add(a->value, b->value, buffer);
+		if (use_word_arith(a->mode))
+			sc_val_from_sword(get_tarval_sword(a) + get_tarval_sword(b), buffer);
+		else
+			sc_add(a->value, b->value, buffer);
 		return get_tarval_overflow(buffer, a->length, a->mode);
 	}
 
@@ -861,7 +895,10 @@ ir_tarval *tarval_sub(ir_tarval *a, ir_tarval *b, ir_mode *dst_mode)
 	case irms_int_number: {
 		/* modes of a,b are equal, so result has mode of a as this might be the character */
 		char *buffer = ALLOCAN(char, sc_get_buffer_length());
-		sc_sub(a->value, b->value, buffer);
+		if (use_word_arith(a->mode))
+			sc_val_from_sword(get_tarval_sword(a) - get_tarval_sword(b), buffer);
+		else
+			sc_sub(a->value, b->value, buffer);
 		return get_tarval_overflow(buffer, a->length, a->mode);
 	}
 
@@ -882,7 +919,16 @@ ir_tarval *tarval_mul(ir_tarval *a, ir_tarval *b)
 	case irms_int_number: {
 		/* modes of a,b are equal */
 		char *buffer = ALLOCAN(char, sc_get_buffer_length());
-		sc_mul(a->value, b->value, buffer);
+		if (!use_word_arith(a->mode)) {
+			sc_mul(a->value, b->value, buffer);
+		} else if (mode_is_signed(a->mode)) {
+			sc_val_from_sword(get_tarval_sword(a) * get_tarval_sword(b), buffer);
+		} else {
+			/* the product of two unsigned values may need all bits of the
+			 * word, so it must not be interpreted as signed */
+			sc_word_t const res = (sc_word_t)get_tarval_sword(a) * (sc_word_t)get_tarval_sword(b);
+			sc_val_from_word(res, false, buffer);
+		}
 		return get_tarval_overflow(buffer, a->length, a->mode);
 	}
 
@@ -906,6 +952,11 @@ ir_tarval *tarval_div(ir_tarval *a, ir_tarval *b)
 			return tarval_bad;
 
 		/* modes of a,b are equal */
+		if (use_word_arith(mode)) {
+			char *buffer = ALLOCAN(char, sc_get_buffer_length());
+			sc_val_from_sword(get_tarval_sword(a) / get_tarval_sword(b), buffer);
+			return get_tarval(buffer, sc_get_buffer_length(), mode);
+		}
 		sc_div(a->value, b->value, NULL);
 		return get_tarval(sc_get_buffer(), sc_get_buffer_length(), a->mode);
 	} else {
@@ -923,6 +974,11 @@ ir_tarval *tarval_mod(ir_tarval *a, ir_tarval *b)
 	if (b == get_mode_null(b->mode))
 		return tarval_bad;
 	/* modes of a,b are equal */
+	if (use_word_arith(a->mode)) {
+		char *buffer = ALLOCAN(char, sc_get_buffer_length());
+		sc_val_from_sword(get_tarval_sword(a) % get_tarval_sword(b), buffer);
+		return get_tarval(buffer, sc_get_buffer_length(), a->mode);
+	}
 	sc_mod(a->value, b->value, NULL);
 	return get_tarval(sc_get_buffer(), sc_get_buffer_length(), a->mode);
 }
@@ -939,7 +995,14 @@ ir_tarval *tarval_divmod(ir_tarval *a, ir_tarval *b, ir_tarval **mod)
 	if (b == get_mode_null(b->mode))
 		return tarval_bad;
 	/* modes of a,b are equal */
-	sc_divmod(a->value, b->value, div_res, mod_res);
+	if (use_word_arith(a->mode)) {
+		sc_sword_t const va = get_tarval_sword(a);
+		sc_sword_t const vb = get_tarval_sword(b);
+		sc_val_from_sword(va / vb, div_res);
+		sc_val_from_sword(va % vb, mod_res);
+	} else {
+		sc_divmod(a->value, b->value, div_res, mod_res);
+	}
 	*mod = get_tarval(mod_res, len, a->mode);
 	return get_tarval(div_res, len, a->mode);
 }
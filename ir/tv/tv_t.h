@@ -118,6 +118,12 @@ static inline int _is_tarval(const void *thing)
 
 uint64_t get_tarval_uint64(ir_tarval *tv);
 
+/**
+ * Returns the tarval of an integer mode with at most 64 bits whose two's
+ * complement representation has the lower bits of @p value.
+ */
+ir_tarval *new_tarval_from_uint64(uint64_t value, ir_mode *mode);
+
 bool tarval_is_uint64(ir_tarval *tv);
 
 #endif /* FIRM_TV_TV_T_H */
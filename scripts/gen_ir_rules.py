@@ -0,0 +1,263 @@
+#!/usr/bin/env python
+#
+# This file is part of libFirm.
+# Copyright (C) 2012 Karlsruhe Institute of Technology.
+#
+# Generates the decision tree matchers for the rewrite rules in ir_rules.py.
+# The matcher of an opcode tests the mode of the node first, then the opcodes
+# of the operands, then constant values and equalities. Rules sharing a
+# prefix of these tests share the code testing it, so every test is done at
+# most once on each path through the matcher.
+import imp
+import re
+import sys
+from jinja2 import Environment, FileSystemLoader
+from spec_util import load_spec, isAbstract
+
+mode_tests = {
+	"int":       "mode_is_int(mode)",
+	"float":     "mode_is_float(mode)",
+	"reference": "mode_is_reference(mode)",
+}
+
+value_tests = {
+	"Null":   "tarval_is_null",
+	"One":    "tarval_is_one",
+	"AllOne": "tarval_is_all_one",
+}
+
+class Pattern(object):
+	def __init__(self, kind, name, operands = []):
+		self.kind     = kind   # "op", "var", "any" or "value"
+		self.name     = name
+		self.operands = operands
+
+def error(rule, message):
+	sys.stderr.write("%s: %s\n" % (rule["match"], message))
+	sys.exit(1)
+
+def parse_pattern(rule, nodes):
+	tokens = re.findall(r"[A-Za-z_][A-Za-z0-9_]*|[(),]", rule["match"])
+	pos    = [0]
+
+	def next_token():
+		if pos[0] >= len(tokens):
+			error(rule, "unexpected end of pattern")
+		token = tokens[pos[0]]
+		pos[0] += 1
+		return token
+
+	def parse():
+		name = next_token()
+		if pos[0] < len(tokens) and tokens[pos[0]] == "(":
+			pos[0] += 1
+			if name not in nodes:
+				error(rule, "unknown opcode %s" % name)
+			operands = [ parse() ]
+			while next_token() == ",":
+				operands.append(parse())
+			if len(operands) != len(nodes[name].ins):
+				error(rule, "%s needs %d operands" % (name, len(nodes[name].ins)))
+			return Pattern("op", name, operands)
+		if name == "_":
+			return Pattern("any", name)
+		if name in value_tests:
+			return Pattern("value", name)
+		return Pattern("var", name)
+
+	pattern = parse()
+	if pos[0] != len(tokens):
+		error(rule, "trailing tokens")
+	if pattern.kind != "op":
+		error(rule, "pattern must start with an opcode")
+	return pattern
+
+def commutations(pattern, nodes):
+	"""Returns the pattern with the operands of commutative nodes in all
+	orders, the written order first."""
+	if pattern.kind != "op":
+		return [ pattern ]
+	variants = [ [] ]
+	for operand in pattern.operands:
+		variants = [ v + [ o ] for v in variants
+		             for o in commutations(operand, nodes) ]
+	result = [ Pattern("op", pattern.name, v) for v in variants ]
+	if "commutative" in nodes[pattern.name].flags:
+		result += [ Pattern("op", pattern.name, list(reversed(v)))
+		            for v in variants ]
+	return result
+
+def path_name(path):
+	return "n" + "".join("_%d" % i for i in path)
+
+def collect_tests(rule, pattern):
+	"""Flattens a pattern into the ordered list of tests of one rule."""
+	ops      = []
+	values   = []
+	eqs      = []
+	bindings = {}
+	queue    = [ ((), pattern) ]
+	while queue:
+		path, p = queue.pop(0)
+		if p.kind == "op":
+			if path != ():
+				ops.append(("op", path, p.name))
+			for i, operand in enumerate(p.operands):
+				queue.append((path + (i,), operand))
+		elif p.kind == "value":
+			values.append(("value", path, p.name))
+		elif p.kind == "var":
+			if p.name in bindings:
+				eqs.append(("eq", bindings[p.name], path))
+			else:
+				bindings[p.name] = path
+
+	tests = []
+	if "mode" in rule:
+		tests.append(("mode", rule["mode"]))
+	tests += ops + values + eqs
+
+	result = rule["result"]
+	if result not in bindings:
+		error(rule, "result %s is not bound by the pattern" % result)
+	if rule.get("same_mode", False):
+		tests.append(("same_mode", bindings[result]))
+	if "cond" in rule:
+		tests.append(("cond", rule["cond"]))
+	return tests, bindings[result]
+
+class Emitter(object):
+	def __init__(self, nodes, opcode):
+		self.nodes   = nodes
+		self.opcode  = opcode
+		self.lines   = []
+		self.opcodes = { (): opcode }
+
+	def emit(self, indent, line):
+		self.lines.append("\t" * indent + line)
+
+	def getter(self, path):
+		parent = path[:-1]
+		node   = self.nodes[self.opcodes[parent]]
+		return "get_%s_%s(%s)" % (node.name, node.ins[path[-1]][0],
+		                          path_name(parent))
+
+	def declare_operands(self, indent, path, variants):
+		"""Declares the operands of the node at path as far as the variants
+		use them."""
+		used = set()
+		for tests, result, rule in variants:
+			for test in tests:
+				paths = [ test[1] ] if test[0] in ("op", "value", "same_mode") \
+				        else list(test[1:]) if test[0] == "eq" else []
+				for p in paths:
+					if len(p) > len(path) and p[:len(path)] == path:
+						used.add(p[:len(path) + 1])
+			if len(result) > len(path) and result[:len(path)] == path:
+				used.add(result[:len(path) + 1])
+		for p in sorted(used):
+			self.emit(indent, "ir_node *const %s = %s;" % (path_name(p),
+			                                                self.getter(p)))
+
+	def condition(self, test):
+		kind = test[0]
+		if kind == "mode":
+			return mode_tests[test[1]]
+		if kind == "op":
+			return "is_%s(%s)" % (test[2], path_name(test[1]))
+		if kind == "value":
+			return "%s(tv%s)" % (value_tests[test[2]], path_name(test[1])[1:])
+		if kind == "eq":
+			return "%s == %s" % (path_name(test[1]), path_name(test[2]))
+		if kind == "same_mode":
+			return "get_irn_mode(%s) == mode" % path_name(test[1])
+		return "(%s)" % test[1]
+
+	def emit_action(self, indent, result, rule):
+		res  = path_name(result)
+		kind = "FS_OPT_" + rule.get("opt", "ALGSIM")
+		self.emit(indent, "ir_node *res = %s;" % res)
+		arity = len(self.nodes[self.opcode].ins)
+		if rule.get("dbg") == "ALGSIM0" or arity == 0:
+			self.emit(indent, "DBG_OPT_ALGSIM0(n, res, %s);" % kind)
+		elif arity == 1:
+			self.emit(indent, "DBG_OPT_ALGSIM2(n, n_0, res, %s);" % kind)
+		else:
+			self.emit(indent, "DBG_OPT_ALGSIM1(n, n_0, n_1, res, %s);" % kind)
+		self.emit(indent, "return res;")
+
+	def emit_tree(self, indent, variants, values):
+		"""Emits the tests of the variants, values are the paths whose
+		constant value is already computed in the current scope."""
+		values = set(values)
+		i = 0
+		while i < len(variants):
+			tests, result, rule = variants[i]
+			if len(tests) == 0:
+				self.emit_action(indent, result, rule)
+				if i + 1 < len(variants):
+					sys.stderr.write("%s: shadows later rules\n" % rule["match"])
+				return
+			# group the following rules starting with the same test
+			j = i + 1
+			while j < len(variants) and variants[j][0][:1] == tests[:1]:
+				j += 1
+			test  = tests[0]
+			group = [ (t[1:], r, ru) for t, r, ru in variants[i:j] ]
+			if test[0] == "value" and test[1] not in values:
+				# compute the value once, right before it is needed first
+				values.add(test[1])
+				self.emit(indent, "ir_tarval *const tv%s = value_of(%s);"
+				          % (path_name(test[1])[1:], path_name(test[1])))
+			self.emit(indent, "if (%s) {" % self.condition(test))
+			if test[0] == "op":
+				self.opcodes[test[1]] = test[2]
+				self.declare_operands(indent + 1, test[1], group)
+			self.emit_tree(indent + 1, group, values)
+			self.emit(indent, "}")
+			i = j
+
+def generate_matcher(nodes, opcode, variants):
+	emitter = Emitter(nodes, opcode)
+	uses_mode = any(t[0] in ("mode", "same_mode", "cond")
+	                for tests, r, ru in variants for t in tests)
+	if uses_mode:
+		emitter.emit(1, "ir_mode *const mode = get_irn_mode(n);")
+	emitter.declare_operands(1, (), variants)
+	emitter.emit_tree(1, variants, set())
+	emitter.emit(1, "return n;")
+	return "\n".join(emitter.lines)
+
+def main(argv):
+	if len(argv) < 4:
+		sys.stderr.write("usage: %s specfile rulesfile templatefile\n" % argv[0])
+		sys.exit(1)
+
+	spec  = load_spec(argv[1])
+	nodes = dict((node.name, node) for node in spec.nodes
+	             if not isAbstract(node))
+	rules = imp.load_source('rules', argv[2]).rules
+
+	matchers = []
+	by_op    = {}
+	for rule in rules:
+		pattern = parse_pattern(rule, nodes)
+		if pattern.name not in by_op:
+			by_op[pattern.name] = []
+			matchers.append(pattern.name)
+		variants = by_op[pattern.name]
+		for variant in commutations(pattern, nodes):
+			tests, result = collect_tests(rule, variant)
+			if all(v[0] != tests for v in variants):
+				variants.append((tests, result, rule))
+
+	env = Environment(loader=FileSystemLoader("."))
+	env.globals['warning']  = "/* Warning: automatically generated file */"
+	env.globals['matchers'] = [ dict(name = op,
+	                                 body = generate_matcher(nodes, op, by_op[op]))
+	                            for op in matchers ]
+	template = env.get_template(argv[3])
+	sys.stdout.write(template.render().encode("utf-8"))
+
+if __name__ == "__main__":
+	main(sys.argv)
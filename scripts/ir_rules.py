@@ -0,0 +1,47 @@
+# This file is part of libFirm.
+# Copyright (C) 2012 Karlsruhe Institute of Technology.
+#
+# Local rewrite rules for iropt.c, processed by gen_ir_rules.py into a
+# decision tree matcher (ir/ir/gen_irrules.c.inl).
+#
+# A rule rewrites a node matching the pattern "match" to the node bound to the
+# variable "result". Patterns are written as
+#   Op(pattern, ...)  a node with opcode Op, its operands in the order of the
+#                     node specification in ir_spec.py
+#   x                 any node, bound to the variable x; a variable used more
+#                     than once matches the same node each time
+#   _                 any node
+#   Null, One, AllOne a node with a constant value of zero, one or all bits
+#                     set (see value_of())
+# Operands of commutative nodes are matched in both orders, the order written
+# down is tried first.
+#
+# Optional properties:
+#   mode      "int", "float" or "reference": class of the mode of the node
+#   same_mode the result must have the mode of the node
+#   cond      additional C condition, "n" is the node and "mode" its mode
+#   opt       suffix of the FS_OPT_* statistics kind of the rewrite
+#   dbg       "ALGSIM0" to merge only the node itself into the result, the
+#             default merges the operands of the node as well
+#
+# Rules are tried in the order they are written down, they are collected into
+# one matcher per opcode, equivalent_node_rules_<Op>().
+
+rules = [
+	# -(-a) == a, but might overflow two times. We handle it anyway here, the
+	# better way would be a flag. This would be needed for Pascal for
+	# instance.
+	dict(match="Minus(Minus(x))", result="x", opt="INVOLUTION"),
+	dict(match="Not(Not(x))",     result="x", opt="INVOLUTION"),
+
+	# a | a = a | 0 = 0 | a = a
+	dict(match="Or(x, x)",    result="x", opt="OR", dbg="ALGSIM0"),
+	dict(match="Or(x, Null)", result="x", opt="OR"),
+
+	# a & a = a & 0b1...1 = 0b1...1 & a = a
+	dict(match="And(x, x)",      result="x", opt="AND", dbg="ALGSIM0"),
+	dict(match="And(x, AllOne)", result="x", opt="AND"),
+
+	# a * 1 = 1 * a = a, only if the operands have the mode of the result
+	dict(match="Mul(x, One)", result="x", same_mode=True, opt="NEUTRAL_1"),
+]
@@ -213,11 +213,6 @@ class Block:
 	res->attr.block.irg.irg     = irg;
 	res->attr.block.backedge    = new_backedge_arr(get_irg_obstack(irg), arity);
 	set_Block_matured(res, 1);
-
-	/* Create and initialize array for Phi-node construction. */
-	if (irg_is_constrained(irg, IR_GRAPH_CONSTRAINT_CONSTRUCTION)) {
-		res->attr.block.graph_arr = NEW_ARR_DZ(ir_node*, get_irg_obstack(irg), irg->n_loc);
-	}
 	'''
 
 @op
@@ -7,9 +7,96 @@ import os
 import re
 import time
 import stat
-import fileinput
 import tempfile
 import optparse
+import struct
+
+BINARY_MAGIC = "FIRMSEVB"
+
+# binary files are decoded in blocks of this size
+BINARY_BLOCK_SIZE = 1 << 20
+# size of the largest binary record: tag, key, string length and string
+BINARY_MAX_RECORD = 1 + 4 + 2 + 0xffff
+
+# number of rows written in one transaction
+DEFAULT_BATCH_SIZE = 50000
+
+def is_binary_file(name):
+	f = open(name, "rb")
+	magic = f.read(len(BINARY_MAGIC))
+	f.close()
+	return magic == BINARY_MAGIC
+
+def open_text(name):
+	"""Opens a text event file, which may be compressed with gzip or bzip2."""
+	if name.endswith(".gz"):
+		import gzip
+		return gzip.open(name, "rb")
+	if name.endswith(".bz2"):
+		import bz2
+		return bz2.BZ2File(name, "rb")
+	return open(name, "rb")
+
+def read_binary(name):
+	"""Decodes a file written by stat_ev_begin_binary() into the lines of the
+	text format. The file is read in blocks, so it may be larger than the
+	available memory."""
+	f    = open(name, "rb")
+	data = f.read(BINARY_BLOCK_SIZE)
+	eof  = False
+
+	pos   = len(BINARY_MAGIC)
+	order = "<"
+	if struct.unpack_from("<I", data, pos)[0] != 0x01020304:
+		order = ">"
+	version = struct.unpack_from(order + "I", data, pos + 4)[0]
+	if version != 1:
+		print "%s: unsupported binary event format version %d" % (name, version)
+		sys.exit(1)
+	pos += 8
+
+	keys = dict()
+	while True:
+		# make sure the next record is in the buffer
+		if not eof and len(data) - pos < BINARY_MAX_RECORD:
+			block = f.read(BINARY_BLOCK_SIZE)
+			eof   = len(block) == 0
+			data  = data[pos:] + block
+			pos   = 0
+		if pos >= len(data):
+			break
+
+		tag = data[pos]
+		key = struct.unpack_from(order + "I", data, pos + 1)[0]
+		pos += 5
+		if tag == 'K' or tag == 'P':
+			length = struct.unpack_from(order + "H", data, pos)[0]
+			string = data[pos + 2:pos + 2 + length]
+			pos += 2 + length
+			if tag == 'K':
+				keys[key] = string
+				continue
+			yield "P;%s;%s\n" % (keys[key], string)
+		elif tag == 'O':
+			yield "O;%s\n" % keys[key]
+		elif tag == 'd':
+			value = struct.unpack_from(order + "d", data, pos)[0]
+			pos += 8
+			yield "E;%s;%r\n" % (keys[key], value)
+		elif tag == 'i':
+			value = struct.unpack_from(order + "q", data, pos)[0]
+			pos += 8
+			yield "E;%s;%d\n" % (keys[key], value)
+		elif tag == 'u':
+			value = struct.unpack_from(order + "Q", data, pos)[0]
+			pos += 8
+			yield "E;%s;%d\n" % (keys[key], value)
+		elif tag == 'e':
+			yield "E;%s;0.0\n" % keys[key]
+		else:
+			print "%s: invalid record tag" % name
+			sys.exit(1)
+	f.close()
 
 class DummyFilter:
 	def match(self, dummy):
@@ -20,25 +107,62 @@ class EmitBase:
 	ev_field_ids = {}
 	types = {}
 
+	def column(self, x, defaulttype):
+		"""Returns name and type of the column for key x."""
+		if x[0] == '$':
+			return (x[1:], "text")
+		elif x[0] == '?':
+			return (x[1:], "bool")
+		return (x, defaulttype)
+
 	def create_table(self, cols, name, defaulttype, keytype, extra=""):
 		c  = "create table if not exists `%s` (\n" % name
 		c += "\t`id` %s\n" % keytype
 
 		for x in cols:
-			name = x
-			type = self.types[defaulttype]
-			if x[0] == '$':
-				name = x[1:]
-				type = self.types["text"]
-			elif x[0] == '?':
-				name = x[1:]
-				type = self.types["bool"]
-
-			c += "\t,`%s` %s\n" % (name, type)
+			(name, type) = self.column(x, defaulttype)
+			c += "\t,`%s` %s\n" % (name, self.types[type])
 		c += extra
 		c += ");"
 		self.execute(c)
 
+	# Rows are collected and written in batches of batch_size rows. Engines
+	# assigning context ids themselves use ctx() of the base class.
+	def init_batches(self, options, first_ctxid=1):
+		self.batch_size = options.batch_size
+		self.ctxbatch   = []
+		self.evbatch    = []
+		self.contextids = dict()
+		self.next_ctxid = first_ctxid
+
+	def ev(self, curr_id, evitems):
+		self.evbatch.append((curr_id,) + tuple(evitems))
+		if len(self.evbatch) >= self.batch_size:
+			self.flush()
+
+	def ctx(self, ctxitems):
+		items = tuple(ctxitems)
+		ctxid = self.contextids.get(items)
+		if ctxid is None:
+			ctxid = self.next_ctxid
+			self.next_ctxid += 1
+			self.contextids[items] = ctxid
+			self.ctxbatch.append((ctxid,) + items)
+		return ctxid
+
+	def flush(self):
+		if self.ctxbatch or self.evbatch:
+			self.write_batch(self.ctxbatch, self.evbatch)
+		self.ctxbatch = []
+		self.evbatch  = []
+
+	def commit(self):
+		self.flush()
+		self.finish()
+
+	def finish(self):
+		pass
+
 # Abstraction for mysql sql connection and sql syntax
 class EmitMysql(EmitBase):
 	tmpfile_mode = stat.S_IREAD | stat.S_IROTH | stat.S_IWUSR
@@ -66,6 +190,7 @@ class EmitMysql(EmitBase):
 
 	def __init__(self, options, ctxcols, evcols):
 		self.connect(options)
+		self.init_batches(options)
 
 		self.types["text"] = "varchar(80) default null";
 		self.types["data"] = "double default null";
@@ -89,16 +214,14 @@ class EmitMysql(EmitBase):
 		marks = ",".join(['%s'] * len(ctxcols))
 		self.ctxinsert = "insert into `%s` (%s) values (%s)" % (self.ctxtab, keys, marks)
 
-	def ev(self, curr_id, evitems):
-		self.execute(self.evinsert, (curr_id,) + tuple(evitems))
-
 	def ctx(self, ctxitems):
-		self.execute(self.ctxinsert, tuple(ctxitems))
-		self.conn.commit()
-		id = self.cursor.lastrowid
-		return id
+		# the id is assigned by the database, the insert is committed with
+		# the next batch of events
+		self.cursor.execute(self.ctxinsert, tuple(ctxitems))
+		return self.cursor.lastrowid
 
-	def commit(self):
+	def write_batch(self, ctxrows, evrows):
+		self.cursor.executemany(self.evinsert, evrows)
 		self.conn.commit()
 
 # Abstraction for sqlite3 databases and sql syntax
@@ -134,38 +257,120 @@ class EmitSqlite3(EmitBase):
 
 		self.create_table(ctxcols, self.ctxtab, "text", "integer primary key")
 		self.create_table(evcols, self.evtab, "data", "int")
-		self.execute("CREATE INDEX IF NOT EXISTS `%sindex` ON `%s`(id)"
-				% (self.evtab, self.evtab))
 
-		keys  = "id, " + ", ".join(evcols)
+		# context ids are assigned here, so contexts are inserted in batches
+		self.execute("select max(id) from `%s`" % self.ctxtab)
+		last_ctxid = self.cursor.fetchone()[0] or 0
+		self.init_batches(options, last_ctxid + 1)
+
 		marks = ",".join(["?"] * (len(evcols)+1))
 		self.evinsert = "insert into `%s` values (%s)" % (self.evtab, marks)
 
-		keys  = ", ".join(ctxcols)
-		marks = ",".join(["?"] * len(ctxcols))
+		keys  = ", ".join(["id"] + ctxcols)
+		marks = ",".join(["?"] * (len(ctxcols)+1))
 		self.ctxinsert = "insert into `%s` (%s) values (%s)" % (self.ctxtab, keys, marks)
 
-		self.contextids = dict()
+	def write_batch(self, ctxrows, evrows):
+		self.cursor.executemany(self.ctxinsert, ctxrows)
+		self.cursor.executemany(self.evinsert, evrows)
+		self.conn.commit()
 
-	def ev(self, curr_id, evitems):
-		self.execute(self.evinsert, (curr_id,) + tuple(evitems))
+	def finish(self):
+		# building the index once is faster than updating it for every row
+		self.execute("CREATE INDEX IF NOT EXISTS `%sindex` ON `%s`(id)"
+				% (self.evtab, self.evtab))
+		self.conn.commit()
 
-	def ctx(self, ctxitems):
-		items = tuple(ctxitems)
-		if self.contextids.has_key(items):
-			return self.contextids[items]
-		else:
-			self.execute(self.ctxinsert, items)
-			self.conn.commit()
-			ctxid = self.cursor.lastrowid
-			self.contextids[items] = ctxid
-			return ctxid
+# Writes the contexts and events to <prefix>ctx.csv and <prefix>ev.csv in
+# the directory given as database
+class EmitCsv(EmitBase):
+	def __init__(self, options, ctxcols, evcols):
+		import csv
 
-	def commit(self):
-		self.conn.commit()
+		if options.update:
+			print "--update is not supported by the csv engine"
+			sys.exit(1)
+		directory = options.database or "."
+		self.init_batches(options)
+
+		self.files   = []
+		self.writers = []
+		for (name, cols, type) in [ ("ctx", ctxcols, "text"), ("ev", evcols, "data") ]:
+			f = open(os.path.join(directory, options.prefix + name + ".csv"), "wb")
+			writer = csv.writer(f)
+			writer.writerow(["id"] + [self.column(x, type)[0] for x in cols])
+			self.files.append(f)
+			self.writers.append(writer)
+
+	def write_batch(self, ctxrows, evrows):
+		self.writers[0].writerows(ctxrows)
+		self.writers[1].writerows(evrows)
+
+	def finish(self):
+		for f in self.files:
+			f.close()
+
+# Writes the contexts and events to <prefix>ctx.parquet and <prefix>ev.parquet
+# in the directory given as database, one row group per batch
+class EmitParquet(EmitBase):
+	def __init__(self, options, ctxcols, evcols):
+		try:
+			import pyarrow
+			import pyarrow.parquet
+		except ImportError:
+			print "the parquet engine needs the pyarrow module"
+			sys.exit(1)
+
+		if options.update:
+			print "--update is not supported by the parquet engine"
+			sys.exit(1)
+		directory = options.database or "."
+		self.init_batches(options)
+
+		self.pa    = pyarrow
+		self.types = { "text": pyarrow.string(), "data": pyarrow.float64(),
+		               "bool": pyarrow.bool_() }
+		self.tables = []
+		for (name, cols, type) in [ ("ctx", ctxcols, "text"), ("ev", evcols, "data") ]:
+			fields = [ pyarrow.field("id", pyarrow.int64()) ]
+			for x in cols:
+				(colname, coltype) = self.column(x, type)
+				fields.append(pyarrow.field(colname, self.types[coltype]))
+			schema = pyarrow.schema(fields)
+			path   = os.path.join(directory, options.prefix + name + ".parquet")
+			writer = pyarrow.parquet.ParquetWriter(path, schema)
+			self.tables.append((schema, writer))
+
+	def convert(self, value, type):
+		if value is None:
+			return None
+		if type == self.pa.float64():
+			return float(value)
+		if type == self.pa.bool_():
+			return float(value) != 0
+		return value
+
+	def write_rows(self, table, rows):
+		(schema, writer) = table
+		if not rows:
+			return
+		arrays = []
+		for (i, field) in enumerate(schema):
+			values = [self.convert(row[i], field.type) for row in rows]
+			arrays.append(self.pa.array(values, type=field.type))
+		writer.write_table(self.pa.Table.from_arrays(arrays, schema=schema))
+
+	def write_batch(self, ctxrows, evrows):
+		self.write_rows(self.tables[0], ctxrows)
+		self.write_rows(self.tables[1], evrows)
+
+	def finish(self):
+		for (schema, writer) in self.tables:
+			writer.close()
 
 class Conv:
-	engines = { 'sqlite3': EmitSqlite3, 'mysql': EmitMysql }
+	engines = { 'sqlite3': EmitSqlite3, 'mysql': EmitMysql, 'csv': EmitCsv,
+	            'parquet': EmitParquet }
 
 	# Pass that determines event and context types
 	def find_heads(self):
@@ -217,7 +422,13 @@ class Conv:
 		return (ctxlist, evlist)
 
 	def input(self):
-		return fileinput.FileInput(files=self.files, openhook=fileinput.hook_compressed)
+		for file in self.files:
+			if is_binary_file(file):
+				lines = read_binary(file)
+			else:
+				lines = open_text(file)
+			for line in lines:
+				yield line
 
 	def flush_events(self, id):
 		isnull = True
@@ -330,8 +541,9 @@ class Conv:
 		parser.add_option("-u", "--user",     dest="user",     help="user",               metavar="USER")
 		parser.add_option("-h", "--host",     dest="host",     help="host",               metavar="HOST")
 		parser.add_option("-p", "--password", dest="password", help="password",           metavar="PASSWORD")
-		parser.add_option("-D", "--database", dest="database", help="database",           metavar="DB")
-		parser.add_option("-e", "--engine",   dest="engine",   help="engine (sqlite3, mysql)",             metavar="ENG", default='sqlite3')
+		parser.add_option("-D", "--database", dest="database", help="database, output directory for csv and parquet", metavar="DB")
+		parser.add_option("-e", "--engine",   dest="engine",   help="engine (sqlite3, mysql, csv, parquet)", metavar="ENG", default='sqlite3')
+		parser.add_option("-b", "--batch",    dest="batch_size", help="rows per transaction", metavar="ROWS", type="int", default=DEFAULT_BATCH_SIZE)
 		parser.add_option("-P", "--prefix",   dest="prefix",   help="table prefix",       metavar="PREFIX", default='')
 		(options, args) = parser.parse_args()
 
@@ -0,0 +1,158 @@
+{{warning}}
+/**
+ * @file
+ * @brief   Template for graph walkers with inlined callbacks.
+ *
+ * Including this file defines
+ *     static void IRG_WALK_NAME(ir_node *node, IRG_WALK_ENV_TYPE env)
+ * which walks all nodes reachable from node which are not visited yet, in
+ * the same order as irg_walk_2(). The walker keeps its own stack instead of
+ * recursing, so deep graphs cannot exhaust the C stack, and the callbacks are
+ * expanded inline instead of being called through function pointers.
+ *
+ * The following macros parametrize the walker, all of them are undefined at
+ * the end of this file:
+ *  - IRG_WALK_NAME               name of the walker function (required)
+ *  - IRG_WALK_ENV_TYPE           type of the env parameter, default void*
+ *  - IRG_WALK_PRE(node, env)     executed before the operands of a node
+ *  - IRG_WALK_POST(node, env)    executed after the operands of a node
+ *  - IRG_WALK_PRE_<Op>(node, env), IRG_WALK_POST_<Op>(node, env)
+ *                                executed instead of IRG_WALK_PRE and
+ *                                IRG_WALK_POST for nodes of opcode <Op>
+ *  - IRG_WALK_ARITY(node), IRG_WALK_GET_IN(node, pos)
+ *                                the operands to follow, default are the
+ *                                normal ins of a node
+ *
+ * As with irg_walk_2() the caller has to increment the visited counter of the
+ * graph and reserve IR_RESOURCE_IRN_VISITED.
+ */
+#ifndef IRG_WALK_NAME
+#error "IRG_WALK_NAME must be defined before including gen_irgwalk.c.inl"
+#endif
+#ifndef IRG_WALK_ENV_TYPE
+#define IRG_WALK_ENV_TYPE void*
+#endif
+#ifndef IRG_WALK_ARITY
+#define IRG_WALK_ARITY(node)       get_irn_arity_(node)
+#define IRG_WALK_GET_IN(node, pos) get_irn_n_((node), (pos))
+#endif
+
+#define IRG_WALK_CONCAT2_(a, b) a##b
+#define IRG_WALK_CONCAT_(a, b)  IRG_WALK_CONCAT2_(a, b)
+#define IRG_WALK_FRAME_         IRG_WALK_CONCAT_(IRG_WALK_NAME, _frame_t)
+#define IRG_WALK_DO_PRE_        IRG_WALK_CONCAT_(IRG_WALK_NAME, _pre_)
+#define IRG_WALK_DO_POST_       IRG_WALK_CONCAT_(IRG_WALK_NAME, _post_)
+
+/** the block of the node has to be walked next */
+#define IRG_WALK_POS_BLOCK_     -3
+/** the operands of the node have to be walked next */
+#define IRG_WALK_POS_OPERANDS_  -2
+
+typedef struct IRG_WALK_FRAME_ {
+	ir_node *node; /**< the node whose operands are walked */
+	int      pos;  /**< the next operand or one of the IRG_WALK_POS_ values */
+} IRG_WALK_FRAME_;
+
+static inline void IRG_WALK_DO_PRE_(ir_node *node, IRG_WALK_ENV_TYPE env)
+{
+	switch (get_irn_opcode_(node)) {
+{%- for node in nodes %}
+#ifdef IRG_WALK_PRE_{{node.name}}
+	case {{spec.name}}o_{{node.name}}: IRG_WALK_PRE_{{node.name}}(node, env); return;
+#endif
+{%- endfor %}
+	default: break;
+	}
+#ifdef IRG_WALK_PRE
+	IRG_WALK_PRE(node, env);
+#endif
+	(void)node;
+	(void)env;
+}
+
+static inline void IRG_WALK_DO_POST_(ir_node *node, IRG_WALK_ENV_TYPE env)
+{
+	switch (get_irn_opcode_(node)) {
+{%- for node in nodes %}
+#ifdef IRG_WALK_POST_{{node.name}}
+	case {{spec.name}}o_{{node.name}}: IRG_WALK_POST_{{node.name}}(node, env); return;
+#endif
+{%- endfor %}
+	default: break;
+	}
+#ifdef IRG_WALK_POST
+	IRG_WALK_POST(node, env);
+#endif
+	(void)node;
+	(void)env;
+}
+
+static void IRG_WALK_NAME(ir_node *const root, IRG_WALK_ENV_TYPE env)
+{
+	ir_graph *const irg = get_irn_irg(root);
+	if (root->visited >= irg->visited)
+		return;
+
+	IRG_WALK_FRAME_ *stack = NEW_ARR_F(IRG_WALK_FRAME_, 0);
+	ir_node         *next  = root;
+	for (;;) {
+		if (next != NULL) {
+			next->visited = irg->visited;
+			IRG_WALK_DO_PRE_(next, env);
+			IRG_WALK_FRAME_ const frame = {
+				next, is_Block(next) ? IRG_WALK_POS_OPERANDS_ : IRG_WALK_POS_BLOCK_
+			};
+			ARR_APP1(IRG_WALK_FRAME_, stack, frame);
+		}
+
+		/* find the next operand of the topmost node which is not visited yet,
+		 * the arity is read as late as in the recursive walker */
+		size_t           const top  = ARR_LEN(stack) - 1;
+		IRG_WALK_FRAME_ *const f    = &stack[top];
+		ir_node         *const node = f->node;
+		next = NULL;
+		for (;;) {
+			ir_node *pred;
+			if (f->pos == IRG_WALK_POS_BLOCK_) {
+				f->pos = IRG_WALK_POS_OPERANDS_;
+				pred   = get_nodes_block(node);
+			} else {
+				if (f->pos == IRG_WALK_POS_OPERANDS_)
+					f->pos = IRG_WALK_ARITY(node) - 1;
+				if (f->pos < 0)
+					break;
+				pred = IRG_WALK_GET_IN(node, f->pos--);
+			}
+			if (pred->visited < irg->visited) {
+				next = pred;
+				break;
+			}
+		}
+		if (next != NULL)
+			continue;
+
+		IRG_WALK_DO_POST_(node, env);
+		if (top == 0)
+			break;
+		ARR_SHRINKLEN(stack, top);
+	}
+	DEL_ARR_F(stack);
+}
+
+#undef IRG_WALK_POS_OPERANDS_
+#undef IRG_WALK_POS_BLOCK_
+#undef IRG_WALK_DO_POST_
+#undef IRG_WALK_DO_PRE_
+#undef IRG_WALK_FRAME_
+#undef IRG_WALK_CONCAT_
+#undef IRG_WALK_CONCAT2_
+{%- for node in nodes %}
+#undef IRG_WALK_PRE_{{node.name}}
+#undef IRG_WALK_POST_{{node.name}}
+{%- endfor %}
+#undef IRG_WALK_GET_IN
+#undef IRG_WALK_ARITY
+#undef IRG_WALK_POST
+#undef IRG_WALK_PRE
+#undef IRG_WALK_ENV_TYPE
+#undef IRG_WALK_NAME
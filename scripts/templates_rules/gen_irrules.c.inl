@@ -0,0 +1,15 @@
+{{warning}}
+/**
+ * @file
+ * @brief   Matchers for the local rewrite rules in scripts/ir_rules.py.
+ *
+ * Each equivalent_node_rules_<Op>() returns the node its argument can be
+ * replaced with, or the argument itself if no rule matches. The file is
+ * included by iropt.c and uses its value_of().
+ */
+{% for matcher in matchers %}
+static ir_node *equivalent_node_rules_{{matcher.name}}(ir_node *n)
+{
+{{matcher.body}}
+}
+{% endfor %}
@@ -0,0 +1,294 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Benchmark driver measuring the compile throughput of libFirm.
+ *
+ * Loads an .ir file with ir_import(), runs a configurable list of
+ * optimizations followed by the backend and writes the time of every phase,
+ * including the library startup in ir_init(), the node throughput and the
+ * peak memory usage as JSON object to stdout.
+ * The assembler output is discarded unless requested.
+ */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <libfirm/firm.h>
+#include <libfirm/statev.h>
+
+typedef void (*opt_func)(ir_graph *irg);
+
+typedef struct opt_pass_t {
+	const char *name;
+	opt_func    func;
+} opt_pass_t;
+
+static void do_optimize_graph_df(ir_graph *irg)
+{
+	optimize_graph_df(irg);
+}
+
+static const opt_pass_t opt_passes[] = {
+	{ "bool",         opt_bool               },
+	{ "cf",           optimize_cf            },
+	{ "cfcleanup",    cleanup_cf             },
+	{ "combo",        combo                  },
+	{ "confirm",      construct_confirms     },
+	{ "conv",         conv_opt               },
+	{ "dead",         dead_node_elimination  },
+	{ "frame",        opt_frame_irg          },
+	{ "gvn-pre",      do_gvn_pre             },
+	{ "ifconv",       opt_if_conv            },
+	{ "ldst",         optimize_load_store    },
+	{ "local",        do_optimize_graph_df   },
+	{ "loop",         loop_optimization      },
+	{ "parallelize",  opt_parallelize_mem    },
+	{ "phi-cycles",   remove_phi_cycles      },
+	{ "place",        place_code             },
+	{ "reassoc",      optimize_reassociation },
+	{ "scalar",       scalar_replacement_opt },
+	{ "shape-blocks", shape_blocks           },
+	{ "tailrec",      opt_tail_rec_irg       },
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
+#define MAX_PIPELINE  64
+
+static const opt_pass_t *pipeline[MAX_PIPELINE];
+static size_t            n_pipeline;
+static ir_timer_t       *pass_timers[MAX_PIPELINE];
+
+static const char *default_pipeline = "local,cf,ldst,local,cf";
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options] file.ir\n"
+	        "  -p PASS,...  optimizations to run on every graph (default: %s)\n"
+	        "  -b ARG       pass ARG to the backend, like isa=ia32\n"
+	        "  -s PREFIX    write statistic events to PREFIX.ev\n"
+	        "  -o FILE      write the assembler output to FILE\n"
+	        "Available passes:",
+	        argv0, default_pipeline);
+	for (size_t i = 0; i < ARRAY_SIZE(opt_passes); ++i)
+		fprintf(stderr, " %s", opt_passes[i].name);
+	fputc('\n', stderr);
+}
+
+static bool parse_pipeline(const char *arg)
+{
+	n_pipeline = 0;
+	while (*arg != '\0') {
+		const char *end = strchr(arg, ',');
+		size_t      len = end != NULL ? (size_t)(end - arg) : strlen(arg);
+		if (len > 0) {
+			const opt_pass_t *pass = NULL;
+			for (size_t i = 0; i < ARRAY_SIZE(opt_passes); ++i) {
+				if (strlen(opt_passes[i].name) == len
+				    && strncmp(opt_passes[i].name, arg, len) == 0) {
+					pass = &opt_passes[i];
+					break;
+				}
+			}
+			if (pass == NULL) {
+				fprintf(stderr, "unknown pass '%.*s'\n", (int)len, arg);
+				return false;
+			}
+			if (n_pipeline >= MAX_PIPELINE) {
+				fprintf(stderr, "too many passes\n");
+				return false;
+			}
+			pipeline[n_pipeline++] = pass;
+		}
+		arg += len;
+		if (*arg == ',')
+			++arg;
+	}
+	return true;
+}
+
+/** Returns the number of node indices handed out by all graphs. */
+static unsigned long count_nodes(void)
+{
+	unsigned long n_nodes = 0;
+	for (size_t i = 0, n = get_irp_n_irgs(); i < n; ++i)
+		n_nodes += get_irg_last_idx(get_irp_irg(i));
+	return n_nodes;
+}
+
+static void print_json_string(const char *str)
+{
+	putchar('"');
+	for (const char *c = str; *c != '\0'; ++c) {
+		if (*c == '"' || *c == '\\')
+			putchar('\\');
+		putchar(*c);
+	}
+	putchar('"');
+}
+
+int main(int argc, char **argv)
+{
+	const char *input         = NULL;
+	const char *output        = NULL;
+	const char *statev_prefix = NULL;
+
+	/* timers work without ir_init(), so the startup can be measured */
+	ir_timer_t *t_init = ir_timer_new();
+	ir_timer_start(t_init);
+	ir_init();
+	ir_timer_stop(t_init);
+
+	if (!parse_pipeline(default_pipeline))
+		return EXIT_FAILURE;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (arg[0] == '-' && arg[1] != '\0' && arg[2] == '\0') {
+			if (i + 1 >= argc) {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			const char *val = argv[++i];
+			switch (arg[1]) {
+			case 'p':
+				if (!parse_pipeline(val))
+					return EXIT_FAILURE;
+				break;
+			case 'b':
+				if (!be_parse_arg(val)) {
+					fprintf(stderr, "invalid backend argument '%s'\n", val);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 's': statev_prefix = val; break;
+			case 'o': output        = val; break;
+			default:
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+		} else if (input == NULL) {
+			input = arg;
+		} else {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (input == NULL) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE *out = fopen(output != NULL ? output : "/dev/null", "w");
+	if (out == NULL) {
+		perror(output);
+		return EXIT_FAILURE;
+	}
+	if (statev_prefix != NULL) {
+		stat_ev_begin(statev_prefix, NULL);
+		ir_pass_stat_enable(1);
+	}
+
+	ir_timer_t *t_import  = ir_timer_new();
+	ir_timer_t *t_lower   = ir_timer_new();
+	ir_timer_t *t_backend = ir_timer_new();
+	ir_timer_t *t_total   = ir_timer_new();
+	for (size_t p = 0; p < n_pipeline; ++p)
+		pass_timers[p] = ir_timer_new();
+
+	ir_timer_start(t_total);
+
+	ir_timer_start(t_import);
+	if (ir_import(input) != 0) {
+		fprintf(stderr, "%s: import failed\n", input);
+		return EXIT_FAILURE;
+	}
+	ir_timer_stop(t_import);
+
+	unsigned long n_nodes = count_nodes();
+	size_t        n_irgs  = get_irp_n_irgs();
+
+	for (size_t p = 0; p < n_pipeline; ++p) {
+		const opt_pass_t *pass = pipeline[p];
+		ir_timer_start(pass_timers[p]);
+		for (size_t i = 0; i < n_irgs; ++i) {
+			ir_graph *irg = get_irp_irg(i);
+			ir_pass_stat_begin(irg, pass->name);
+			pass->func(irg);
+			ir_pass_stat_end();
+		}
+		ir_timer_stop(pass_timers[p]);
+	}
+
+	ir_timer_start(t_lower);
+	be_lower_for_target();
+	ir_timer_stop(t_lower);
+
+	unsigned long n_nodes_backend = count_nodes();
+
+	ir_timer_start(t_backend);
+	be_main(out, input);
+	ir_timer_stop(t_backend);
+
+	ir_timer_stop(t_total);
+
+	fclose(out);
+	if (statev_prefix != NULL)
+		stat_ev_end();
+
+	struct rusage usage_info;
+	getrusage(RUSAGE_SELF, &usage_info);
+
+	double total_sec   = ir_timer_elapsed_sec(t_total);
+	double backend_sec = ir_timer_elapsed_sec(t_backend);
+
+	printf("{\n\t\"input\": ");
+	print_json_string(input);
+	printf(",\n\t\"revision\": \"%s\",\n", ir_get_version_revision());
+	printf("\t\"graphs\": %zu,\n", n_irgs);
+	printf("\t\"nodes\": %lu,\n", n_nodes);
+	printf("\t\"nodes_backend\": %lu,\n", n_nodes_backend);
+	printf("\t\"phases\": {\n");
+	printf("\t\t\"init\": %.6f,\n", ir_timer_elapsed_sec(t_init));
+	printf("\t\t\"import\": %.6f,\n", ir_timer_elapsed_sec(t_import));
+	for (size_t p = 0; p < n_pipeline; ++p) {
+		printf("\t\t\"opt:%zu:%s\": %.6f,\n", p, pipeline[p]->name,
+		       ir_timer_elapsed_sec(pass_timers[p]));
+	}
+	printf("\t\t\"lower\": %.6f,\n", ir_timer_elapsed_sec(t_lower));
+	printf("\t\t\"backend\": %.6f\n", backend_sec);
+	printf("\t},\n");
+	printf("\t\"total\": %.6f,\n", total_sec);
+	printf("\t\"nodes_per_sec\": %.1f,\n",
+	       total_sec > 0 ? n_nodes / total_sec : 0.0);
+	printf("\t\"backend_nodes_per_sec\": %.1f,\n",
+	       backend_sec > 0 ? n_nodes_backend / backend_sec : 0.0);
+	/* ru_maxrss is in kilobytes on Linux and the BSDs */
+	printf("\t\"peak_rss_kb\": %ld,\n", (long)usage_info.ru_maxrss);
+	printf("\t\"heap_bytes\": %zu,\n", ir_get_heap_used_bytes());
+	printf("\t\"statev\": ");
+	if (statev_prefix != NULL) {
+		char buf[512];
+		snprintf(buf, sizeof(buf), "%s.ev", statev_prefix);
+		print_json_string(buf);
+	} else {
+		printf("null");
+	}
+	printf("\n}\n");
+
+	ir_timer_free(t_init);
+	ir_timer_free(t_import);
+	ir_timer_free(t_lower);
+	ir_timer_free(t_backend);
+	ir_timer_free(t_total);
+	for (size_t p = 0; p < n_pipeline; ++p)
+		ir_timer_free(pass_timers[p]);
+	ir_finish();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+/*
+ * This file is part of libFirm.
+ * Copyright (C) 2012 University of Karlsruhe.
+ */
+
+/**
+ * @file
+ * @brief   Compiler daemon keeping an initialized libFirm warm.
+ *
+ * The library is initialized and the options are parsed once, afterwards
+ * every request compiles one .ir file into an assembler file and resets the
+ * program with ir_reset_prog(). A request is a line "input.ir output.s", the
+ * answer is a line "ok" or "error <reason>".
+ * Requests are read from stdin unless a unix socket is given with -l, which
+ * serves the connections one after another. The "quit" request ends the
+ * daemon.
+ */
+#define _DEFAULT_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <libfirm/firm.h>
+
+typedef void (*opt_func)(ir_graph *irg);
+
+typedef struct opt_pass_t {
+	const char *name;
+	opt_func    func;
+} opt_pass_t;
+
+static void do_optimize_graph_df(ir_graph *irg)
+{
+	optimize_graph_df(irg);
+}
+
+static void do_narrow_modes(ir_graph *irg)
+{
+	/* smaller modes only pay off on targets with byte operations */
+	opt_narrow_modes(irg, 32);
+}
+
+static const opt_pass_t opt_passes[] = {
+	{ "bool",         opt_bool               },
+	{ "cf",           optimize_cf            },
+	{ "cfcleanup",    cleanup_cf             },
+	{ "combo",        combo                  },
+	{ "confirm",      construct_confirms     },
+	{ "conv",         conv_opt               },
+	{ "dead",         dead_node_elimination  },
+	{ "frame",        opt_frame_irg          },
+	{ "gvn-pre",      do_gvn_pre             },
+	{ "ifconv",       opt_if_conv            },
+	{ "ldst",         optimize_load_store    },
+	{ "local",        do_optimize_graph_df   },
+	{ "loop",         loop_optimization      },
+	{ "narrow",       do_narrow_modes        },
+	{ "parallelize",  opt_parallelize_mem    },
+	{ "phi-cycles",   remove_phi_cycles      },
+	{ "place",        place_code             },
+	{ "range-checks", opt_range_checks       },
+	{ "reassoc",      optimize_reassociation },
+	{ "scalar",       scalar_replacement_opt },
+	{ "shape-blocks", shape_blocks           },
+	{ "tailrec",      opt_tail_rec_irg       },
+	{ "tree-height",  optimize_tree_height   },
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(*(a)))
+#define MAX_PIPELINE  64
+#define MAX_REQUEST   4096
+
+static const opt_pass_t *pipeline[MAX_PIPELINE];
+static size_t            n_pipeline;
+
+static const char *default_pipeline = "local,cf,ldst,local,cf";
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+	        "Usage: %s [options]\n"
+	        "  -p PASS,...  optimizations to run on every graph (default: %s)\n"
+	        "  -b ARG       pass ARG to the backend, like isa=ia32\n"
+	        "  -l PATH      serve requests on the unix socket PATH instead of "
+	        "stdin\n"
+	        "Requests are lines \"input.ir output.s\", \"quit\" ends the "
+	        "daemon.\n"
+	        "Available passes:",
+	        argv0, default_pipeline);
+	for (size_t i = 0; i < ARRAY_SIZE(opt_passes); ++i)
+		fprintf(stderr, " %s", opt_passes[i].name);
+	fputc('\n', stderr);
+}
+
+static bool parse_pipeline(const char *arg)
+{
+	n_pipeline = 0;
+	while (*arg != '\0') {
+		const char *end = strchr(arg, ',');
+		size_t      len = end != NULL ? (size_t)(end - arg) : strlen(arg);
+		if (len > 0) {
+			const opt_pass_t *pass = NULL;
+			for (size_t i = 0; i < ARRAY_SIZE(opt_passes); ++i) {
+				if (strlen(opt_passes[i].name) == len
+				    && strncmp(opt_passes[i].name, arg, len) == 0) {
+					pass = &opt_passes[i];
+					break;
+				}
+			}
+			if (pass == NULL) {
+				fprintf(stderr, "unknown pass '%.*s'\n", (int)len, arg);
+				return false;
+			}
+			if (n_pipeline >= MAX_PIPELINE) {
+				fprintf(stderr, "too many passes\n");
+				return false;
+			}
+			pipeline[n_pipeline++] = pass;
+		}
+		arg += len;
+		if (*arg == ',')
+			++arg;
+	}
+	return true;
+}
+
+/**
+ * Compiles @p input into the assembler file @p output. Returns NULL on
+ * success or the reason of the failure. The program is reset in any case.
+ */
+static const char *compile(const char *input, const char *output)
+{
+	const char *error = NULL;
+	if (ir_import(input) != 0) {
+		error = "import failed";
+		goto reset;
+	}
+
+	FILE *out = fopen(output, "w");
+	if (out == NULL) {
+		error = "cannot open output";
+		goto reset;
+	}
+
+	size_t n_irgs = get_irp_n_irgs();
+	for (size_t p = 0; p < n_pipeline; ++p) {
+		for (size_t i = 0; i < n_irgs; ++i)
+			pipeline[p]->func(get_irp_irg(i));
+	}
+
+	be_lower_for_target();
+	be_main(out, input);
+
+	if (fclose(out) != 0)
+		error = "cannot write output";
+
+reset:
+	ir_reset_prog(input);
+	return error;
+}
+
+/**
+ * Answers the requests read from @p in on @p out until the end of the input.
+ * Returns false if the daemon should quit.
+ */
+static bool serve(FILE *in, FILE *out)
+{
+	char line[MAX_REQUEST];
+	while (fgets(line, sizeof(line), in) != NULL) {
+		char input[MAX_REQUEST];
+		char output[MAX_REQUEST];
+		char rest;
+		if (strcmp(line, "quit\n") == 0 || strcmp(line, "quit") == 0)
+			return false;
+
+		const char *error;
+		if (strchr(line, '\n') == NULL && !feof(in)) {
+			/* drop the remainder of the overlong line */
+			int c;
+			do {
+				c = getc(in);
+			} while (c != '\n' && c != EOF);
+			error = "request too long";
+		} else if (sscanf(line, "%s %s %c", input, output, &rest) != 2) {
+			error = "malformed request";
+		} else {
+			error = compile(input, output);
+		}
+
+		if (error != NULL) {
+			fprintf(out, "error %s\n", error);
+		} else {
+			fputs("ok\n", out);
+		}
+		fflush(out);
+	}
+	return true;
+}
+
+/** Serves the connections of the unix socket @p path one after another. */
+static int serve_socket(const char *path)
+{
+	struct sockaddr_un addr;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path too long: %s\n", path);
+		return EXIT_FAILURE;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (sock < 0) {
+		perror("socket");
+		return EXIT_FAILURE;
+	}
+	unlink(path);
+	if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) != 0
+	    || listen(sock, 16) != 0) {
+		perror(path);
+		close(sock);
+		return EXIT_FAILURE;
+	}
+
+	bool running = true;
+	while (running) {
+		int conn = accept(sock, NULL, NULL);
+		if (conn < 0) {
+			perror("accept");
+			break;
+		}
+		int   conn_out = dup(conn);
+		FILE *in       = fdopen(conn, "r");
+		FILE *out      = conn_out >= 0 ? fdopen(conn_out, "w") : NULL;
+		if (in == NULL || out == NULL) {
+			perror("fdopen");
+			if (in != NULL)
+				fclose(in);
+			else
+				close(conn);
+			if (conn_out >= 0)
+				close(conn_out);
+			continue;
+		}
+		running = serve(in, out);
+		fclose(in);
+		fclose(out);
+	}
+
+	close(sock);
+	unlink(path);
+	return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+	const char *socket_path = NULL;
+
+	ir_init();
+
+	if (!parse_pipeline(default_pipeline))
+		return EXIT_FAILURE;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0'
+		    || i + 1 >= argc) {
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+		const char *val = argv[++i];
+		switch (arg[1]) {
+		case 'p':
+			if (!parse_pipeline(val))
+				return EXIT_FAILURE;
+			break;
+		case 'b':
+			if (!be_parse_arg(val)) {
+				fprintf(stderr, "invalid backend argument '%s'\n", val);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'l': socket_path = val; break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	int res = EXIT_SUCCESS;
+	if (socket_path != NULL) {
+		res = serve_socket(socket_path);
+	} else {
+		serve(stdin, stdout);
+	}
+
+	ir_finish();
+	return res;
+}
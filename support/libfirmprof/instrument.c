@@ -3,69 +3,208 @@
  * This file is a supplement to libFirm. It is public domain.
  *  @author Matthias Braun, Steven Schaefer
  */
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-/* Prevent the compiler from mangling the name of this function. */
+/* Prevent the compiler from mangling the name of these functions. */
 void __init_firmprof(const char*, unsigned int*, size_t)
      asm("__init_firmprof");
+void __init_firmprof_threads(const char*, size_t)
+     asm("__init_firmprof_threads");
+void __firmprof_register_thread(const char*, unsigned int*, unsigned int*)
+     asm("__firmprof_register_thread");
+void __init_firmprof_targets(const char*, uintptr_t*, size_t,
+                             void (**)(void), unsigned int*, size_t)
+     asm("__init_firmprof_targets");
+void __firmprof_call_target(uintptr_t*, void (*)(void))
+     asm("__firmprof_call_target");
+
+struct _profile_counter_t;
+
+/** The thread local counters of a translation unit in one thread. */
+typedef struct _thread_counter_t {
+	unsigned                  *counters;
+	struct _profile_counter_t *unit;
+	struct _thread_counter_t  *next;        /**< next thread of the unit */
+	struct _thread_counter_t  *next_unit;   /**< next unit of the thread */
+} thread_counter_t;
 
 typedef struct _profile_counter_t {
 	const char *filename;
-	unsigned   *counters;
+	unsigned   *counters;  /**< shared counters, NULL for thread local ones */
+	uint64_t   *totals;    /**< counts of the exited threads */
+	thread_counter_t *threads; /**< the running threads */
 	unsigned    len;
+	uintptr_t  *sites;     /**< target, count and total of each indirect
+	                            call site */
+	unsigned    n_sites;
+	void      (**funcs)(void); /**< the functions of the unit */
+	unsigned   *ids;       /**< the ids of the functions */
+	unsigned    n_funcs;
 	struct _profile_counter_t *next;
 } profile_counter_t;
 
 static profile_counter_t *counters = NULL;
 
+/** Protects the thread lists and the totals. */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+/** Refers to the thread_counter_t list of a thread. */
+static pthread_key_t   thread_key;
+static pthread_once_t  thread_key_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Write a value as unsigned LEB128: 7 bits per byte starting with the lowest
+ * ones, the high bit is set in all but the last byte.
+ */
+static void write_uleb128(uint64_t v, FILE *f)
+{
+	do {
+		unsigned char byte = v & 0x7f;
+		v >>= 7;
+		if (v != 0)
+			byte |= 0x80;
+		putc(byte, f);
+	} while (v != 0);
+}
+
 /**
  * Write counter values to profiling output file.
- * We define our output format to be a sequence of 32-bit unsigned integer
- * values stored in little endian format.
+ * We define our output format to be the magic "firmprf2" followed by the
+ * number of counters and the counter values, all as unsigned LEB128.
  */
-void write_little_endian(unsigned *counter, unsigned len, FILE *f)
+static void write_counters(const uint64_t *counter, unsigned len, FILE *f)
 {
 	unsigned i;
 
-	for (i = 0; i < len; ++i) {
-		unsigned      v = counter[i];
-		unsigned char bytes[4];
+	fputs("firmprf2", f);
+	write_uleb128(len, f);
+	for (i = 0; i < len; ++i)
+		write_uleb128(counter[i], f);
+}
+
+/** A function known to the profile and its id. */
+typedef struct _function_id_t {
+	uintptr_t address;
+	unsigned  id;
+} function_id_t;
 
-		bytes[0] = ((v >>  0) & 0xff);
-		bytes[1] = ((v >>  8) & 0xff);
-		bytes[2] = ((v >> 16) & 0xff);
-		bytes[3] = ((v >> 24) & 0xff);
+static int cmp_function_id(const void *a, const void *b)
+{
+	uintptr_t const addr_a = ((const function_id_t*) a)->address;
+	uintptr_t const addr_b = ((const function_id_t*) b)->address;
+	return addr_a < addr_b ? -1 : addr_a > addr_b;
+}
 
-		fwrite(bytes, 1, 4, f);
+/**
+ * Collects the functions of all units sorted by address, so targets in other
+ * units are named as well. Returns NULL if there are none.
+ */
+static function_id_t *collect_functions(size_t *n_functions)
+{
+	profile_counter_t *unit;
+	function_id_t     *functions;
+	size_t             n = 0;
+
+	for (unit = counters; unit != NULL; unit = unit->next)
+		n += unit->n_funcs;
+	*n_functions = 0;
+	if (n == 0)
+		return NULL;
+	functions = (function_id_t*) malloc(n * sizeof(*functions));
+	if (functions == NULL)
+		return NULL;
+
+	for (unit = counters; unit != NULL; unit = unit->next) {
+		unsigned i;
+		for (i = 0; i < unit->n_funcs; ++i) {
+			functions[*n_functions].address = (uintptr_t) unit->funcs[i];
+			functions[*n_functions].id      = unit->ids[i];
+			++*n_functions;
+		}
+	}
+	qsort(functions, n, sizeof(*functions), cmp_function_id);
+	return functions;
+}
+
+/**
+ * Write the call targets of a unit following its counters: the number of
+ * indirect call sites and for each site the id of its target (0 if unknown),
+ * the majority vote count of the target and the number of executions.
+ */
+static void write_call_targets(const profile_counter_t *unit,
+                               const function_id_t *functions,
+                               size_t n_functions, FILE *f)
+{
+	unsigned i;
+
+	write_uleb128(unit->n_sites, f);
+	for (i = 0; i < unit->n_sites; ++i) {
+		const uintptr_t *site = &unit->sites[3 * i];
+		function_id_t    key;
+		function_id_t   *func;
+
+		key.address = site[0];
+		func = functions == NULL ? NULL : (function_id_t*) bsearch(&key,
+			functions, n_functions, sizeof(*functions), cmp_function_id);
+		write_uleb128(func != NULL ? func->id : 0, f);
+		write_uleb128(site[1], f);
+		write_uleb128(site[2], f);
 	}
 }
 
 static void write_profiles(void)
 {
-	profile_counter_t *counter = counters;
+	profile_counter_t *counter;
+	function_id_t     *functions;
+	size_t             n_functions;
+
+	pthread_mutex_lock(&lock);
+	functions = collect_functions(&n_functions);
+	counter   = counters;
 	while (counter != NULL) {
 		profile_counter_t *next = counter->next;
-		FILE *f = fopen(counter->filename, "wb");
+		uint64_t          *sums = counter->totals;
+		thread_counter_t  *thread;
+		unsigned           i;
+		FILE              *f;
+
+		if (sums == NULL)
+			sums = (uint64_t*) calloc(counter->len, sizeof(*sums));
+		if (sums == NULL) {
+			perror("Warning: couldn't merge profiling data");
+			goto next;
+		}
+		if (counter->counters != NULL) {
+			for (i = 0; i < counter->len; ++i)
+				sums[i] += counter->counters[i];
+		}
+		/* threads still running are merged as far as they have come */
+		for (thread = counter->threads; thread != NULL; thread = thread->next) {
+			for (i = 0; i < counter->len; ++i)
+				sums[i] += thread->counters[i];
+		}
+
+		f = fopen(counter->filename, "wb");
 		if (f == NULL) {
 			perror("Warning: couldn't open file for writing profiling data");
 		} else {
-			fputs("firmprof", f);
-			write_little_endian(counter->counters, counter->len, f);
+			write_counters(sums, counter->len, f);
+			write_call_targets(counter, functions, n_functions, f);
 			fclose(f);
 		}
-		free(counter);
+		free(sums);
+next:
+		counter->totals = NULL;
 		counter = next;
 	}
+	free(functions);
+	pthread_mutex_unlock(&lock);
 }
 
-/**
- * Register a new profile counter. This is called by separate constructors
- * for each translation unit. Incidentally, referring to this function as
- * "__init_firmprof" is perfectly linker friendly.
- */
-void __init_firmprof(const char *filename,
-                      unsigned int *counts, size_t len)
+static profile_counter_t *new_profile_counter(const char *filename,
+                                              unsigned *counts, size_t len)
 {
 	static int initialized = 0;
 	profile_counter_t *counter;
@@ -75,14 +214,154 @@ void __init_firmprof(const char *filename,
 		atexit(write_profiles);
 	}
 
-	counter = (profile_counter_t*) malloc(sizeof(*counter));
+	counter = (profile_counter_t*) calloc(1, sizeof(*counter));
 	if (counter == NULL)
-		return;
+		return NULL;
 
 	counter->filename = filename;
 	counter->counters = counts;
-	counter->next     = counters;
 	counter->len      = len;
 
-	counters = counter;
+	pthread_mutex_lock(&lock);
+	counter->next = counters;
+	counters      = counter;
+	pthread_mutex_unlock(&lock);
+	return counter;
+}
+
+/**
+ * Register a new profile counter. This is called by separate constructors
+ * for each translation unit. Incidentally, referring to this function as
+ * "__init_firmprof" is perfectly linker friendly.
+ */
+void __init_firmprof(const char *filename,
+                      unsigned int *counts, size_t len)
+{
+	new_profile_counter(filename, counts, len);
+}
+
+/**
+ * Register a translation unit with thread local counters. The counters are
+ * registered by each thread on its own, see __firmprof_register_thread().
+ */
+void __init_firmprof_threads(const char *filename, size_t len)
+{
+	profile_counter_t *counter = new_profile_counter(filename, NULL, len);
+	if (counter == NULL)
+		return;
+	counter->totals = (uint64_t*) calloc(len, sizeof(*counter->totals));
+}
+
+/**
+ * Adds the counts of an exiting thread to the totals of its units, the
+ * thread local counters vanish with the thread.
+ */
+static void merge_thread(void *data)
+{
+	thread_counter_t *thread = (thread_counter_t*) data;
+
+	pthread_mutex_lock(&lock);
+	while (thread != NULL) {
+		thread_counter_t  *next = thread->next_unit;
+		profile_counter_t *unit = thread->unit;
+		thread_counter_t **anchor;
+		unsigned           i;
+
+		if (unit->totals != NULL) {
+			for (i = 0; i < unit->len; ++i)
+				unit->totals[i] += thread->counters[i];
+		}
+		for (anchor = &unit->threads; *anchor != thread;
+		     anchor = &(*anchor)->next) {
+		}
+		*anchor = thread->next;
+		free(thread);
+		thread = next;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+static void create_thread_key(void)
+{
+	pthread_key_create(&thread_key, merge_thread);
+}
+
+/**
+ * Called by instrumented code the first time a thread enters a function of a
+ * unit with thread local counters. Registers the thread's @p counts with the
+ * unit and sets the thread local @p registered flag.
+ */
+void __firmprof_register_thread(const char *filename, unsigned int *counts,
+                                unsigned int *registered)
+{
+	profile_counter_t *unit;
+	thread_counter_t  *thread;
+
+	*registered = 1;
+
+	pthread_once(&thread_key_once, create_thread_key);
+
+	pthread_mutex_lock(&lock);
+	for (unit = counters; unit != NULL; unit = unit->next) {
+		if (unit->filename == filename)
+			break;
+	}
+	thread = unit != NULL
+		? (thread_counter_t*) malloc(sizeof(*thread)) : NULL;
+	if (thread != NULL) {
+		thread->counters  = counts;
+		thread->unit      = unit;
+		thread->next      = unit->threads;
+		thread->next_unit = (thread_counter_t*) pthread_getspecific(thread_key);
+		unit->threads     = thread;
+		pthread_setspecific(thread_key, thread);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Register the indirect call sites of a unit and the functions which may be
+ * their targets. Called by the constructor of the unit after its counters
+ * are registered.
+ */
+void __init_firmprof_targets(const char *filename, uintptr_t *sites,
+                             size_t n_sites, void (**funcs)(void),
+                             unsigned int *ids, size_t n_funcs)
+{
+	profile_counter_t *unit;
+
+	pthread_mutex_lock(&lock);
+	for (unit = counters; unit != NULL; unit = unit->next) {
+		if (unit->filename == filename)
+			break;
+	}
+	if (unit != NULL) {
+		unit->sites   = sites;
+		unit->n_sites = n_sites;
+		unit->funcs   = funcs;
+		unit->ids     = ids;
+		unit->n_funcs = n_funcs;
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+/**
+ * Called by instrumented code before an indirect call. Finds the most
+ * frequent target of the call site with a majority vote: the count of the
+ * candidate grows with each call of it and shrinks with each call of
+ * another target, which becomes the candidate once the count is 0.
+ */
+void __firmprof_call_target(uintptr_t *site, void (*target)(void))
+{
+	uintptr_t const value = (uintptr_t) target;
+
+	++site[2];
+	if (site[0] == value) {
+		++site[1];
+	} else if (site[1] == 0) {
+		site[0] = value;
+		site[1] = 1;
+	} else {
+		--site[1];
+	}
 }